@@ -21,12 +21,15 @@
 #include <isc/buffer.h>
 #include <isc/log.h>
 #include <isc/mem.h>
+#include <isc/mutex.h>
 #include <isc/net.h>
+#include <isc/once.h>
 #include <isc/region.h>
 #include <isc/result.h>
 #include <isc/stdio.h>
 #include <isc/string.h>
 #include <isc/symtab.h>
+#include <isc/thread.h>
 #include <isc/types.h>
 #include <isc/util.h>
 
@@ -82,18 +85,26 @@ bool docheckmx = false;
 bool dochecksrv = false;
 bool docheckns = false;
 #endif /* if CHECK_LOCAL */
-dns_zoneopt_t zone_options = DNS_ZONEOPT_CHECKNS | DNS_ZONEOPT_CHECKMX |
-			     DNS_ZONEOPT_CHECKDUPRR | DNS_ZONEOPT_CHECKSPF |
-			     DNS_ZONEOPT_MANYERRORS | DNS_ZONEOPT_CHECKNAMES |
-			     DNS_ZONEOPT_CHECKINTEGRITY |
+/* Per thread, so that several zones can be loaded at once */
+thread_local dns_zoneopt_t zone_options =
+	DNS_ZONEOPT_CHECKNS | DNS_ZONEOPT_CHECKMX | DNS_ZONEOPT_CHECKDUPRR |
+	DNS_ZONEOPT_CHECKSPF | DNS_ZONEOPT_MANYERRORS | DNS_ZONEOPT_CHECKNAMES |
+	DNS_ZONEOPT_CHECKINTEGRITY |
 #if CHECK_SIBLING
-			     DNS_ZONEOPT_CHECKSIBLING |
+	DNS_ZONEOPT_CHECKSIBLING |
 #endif /* if CHECK_SIBLING */
-			     DNS_ZONEOPT_CHECKSVCB | DNS_ZONEOPT_CHECKWILDCARD |
-			     DNS_ZONEOPT_WARNMXCNAME | DNS_ZONEOPT_WARNSRVCNAME;
+	DNS_ZONEOPT_CHECKSVCB | DNS_ZONEOPT_CHECKWILDCARD |
+	DNS_ZONEOPT_WARNMXCNAME | DNS_ZONEOPT_WARNSRVCNAME;
 
 static isc_symtab_t *symtab = NULL;
 static isc_mem_t *sym_mctx;
+static isc_mutex_t sym_lock;
+static isc_once_t sym_once = ISC_ONCE_INIT;
+
+static void
+sym_initlock(void) {
+	isc_mutex_init(&sym_lock);
+}
 
 static void
 freekey(char *key, unsigned int type, isc_symvalue_t value, void *userarg) {
@@ -107,6 +118,9 @@ add(char *key, int value) {
 	isc_result_t result;
 	isc_symvalue_t symvalue;
 
+	isc_once_do(&sym_once, sym_initlock);
+	LOCK(&sym_lock);
+
 	if (sym_mctx == NULL) {
 		isc_mem_create(&sym_mctx);
 	}
@@ -115,7 +129,7 @@ add(char *key, int value) {
 		result = isc_symtab_create(sym_mctx, 100, freekey, sym_mctx,
 					   false, &symtab);
 		if (result != ISC_R_SUCCESS) {
-			return;
+			goto unlock;
 		}
 	}
 
@@ -127,21 +141,23 @@ add(char *key, int value) {
 	if (result != ISC_R_SUCCESS) {
 		isc_mem_free(sym_mctx, key);
 	}
+
+unlock:
+	UNLOCK(&sym_lock);
 }
 
 static bool
 logged(char *key, int value) {
-	isc_result_t result;
+	isc_result_t result = ISC_R_NOTFOUND;
 
-	if (symtab == NULL) {
-		return false;
+	isc_once_do(&sym_once, sym_initlock);
+	LOCK(&sym_lock);
+	if (symtab != NULL) {
+		result = isc_symtab_lookup(symtab, key, value, NULL);
 	}
+	UNLOCK(&sym_lock);
 
-	result = isc_symtab_lookup(symtab, key, value, NULL);
-	if (result == ISC_R_SUCCESS) {
-		return true;
-	}
-	return false;
+	return result == ISC_R_SUCCESS;
 }
 
 static bool
@@ -19,6 +19,7 @@
 #include <stdbool.h>
 
 #include <isc/stdio.h>
+#include <isc/thread.h>
 #include <isc/types.h>
 
 #include <dns/masterdump.h>
@@ -44,4 +45,4 @@ extern bool nomerge;
 extern bool docheckmx;
 extern bool docheckns;
 extern bool dochecksrv;
-extern dns_zoneopt_t zone_options;
+extern thread_local dns_zoneopt_t zone_options;
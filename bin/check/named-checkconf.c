@@ -18,14 +18,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <isc/atomic.h>
 #include <isc/attributes.h>
 #include <isc/commandline.h>
 #include <isc/dir.h>
 #include <isc/hash.h>
 #include <isc/log.h>
 #include <isc/mem.h>
+#include <isc/os.h>
 #include <isc/result.h>
 #include <isc/string.h>
+#include <isc/thread.h>
 #include <isc/util.h>
 
 #include <dns/db.h>
@@ -50,6 +53,30 @@ static const char *program = "named-checkconf";
 			goto cleanup;        \
 	} while (0)
 
+/*
+ * The zones are queued for loading while the configuration is walked,
+ * and then loaded by a pool of threads.  The messages logged while a
+ * zone is loaded are collected, and printed in the order in which the
+ * zones were configured once all of them have been loaded.
+ */
+typedef struct zoneload {
+	const char *view;
+	const char *zname;
+	const char *zfile;
+	char *zclass;
+	dns_masterformat_t masterformat;
+	dns_ttl_t maxttl;
+	dns_zoneopt_t options;
+	isc_result_t result;
+	char *output;
+	size_t outputlen;
+} zoneload_t;
+
+static zoneload_t *zoneloads = NULL;
+static size_t nzoneloads = 0;
+static size_t zoneloadsize = 0;
+static atomic_size_t nextzoneload = 0;
+
 /*% usage */
 ISC_NORETURN static void
 usage(void);
@@ -456,12 +483,99 @@ configure_zone(const char *vclass, const char *view, const cfg_obj_t *zconfig,
 		zone_options |= DNS_ZONEOPT_CHECKTTL;
 	}
 
-	result = load_zone(mctx, zname, zfile, masterformat, zclass, maxttl,
-			   NULL);
-	if (result != ISC_R_SUCCESS) {
-		fprintf(stderr, "%s/%s/%s: %s\n", view, zname, zclass,
-			isc_result_totext(result));
+	if (nzoneloads == zoneloadsize) {
+		size_t newsize = ISC_MAX(2 * zoneloadsize, 64);
+		zoneloads = isc_mem_creget(mctx, zoneloads, zoneloadsize,
+					   newsize, sizeof(zoneloads[0]));
+		zoneloadsize = newsize;
+	}
+
+	/* 'vclass' doesn't outlive the view */
+	zoneloads[nzoneloads++] = (zoneload_t){
+		.view = view,
+		.zname = zname,
+		.zfile = zfile,
+		.zclass = isc_mem_strdup(mctx, zclass),
+		.masterformat = masterformat,
+		.maxttl = maxttl,
+		.options = zone_options,
+	};
+
+	return ISC_R_SUCCESS;
+}
+
+static void *
+zoneload_thread(void *arg) {
+	isc_mem_t *mctx = arg;
+
+	for (;;) {
+		size_t i = atomic_fetch_add(&nextzoneload, 1);
+		zoneload_t *zl = NULL;
+		FILE *stream = NULL;
+
+		if (i >= nzoneloads) {
+			break;
+		}
+
+		zl = &zoneloads[i];
+		stream = open_memstream(&zl->output, &zl->outputlen);
+		RUNTIME_CHECK(stream != NULL);
+
+		isc_log_setthreadstream(stream);
+		zone_options = zl->options;
+		zl->result = load_zone(mctx, zl->zname, zl->zfile,
+				       zl->masterformat, zl->zclass, zl->maxttl,
+				       NULL);
+		isc_log_setthreadstream(NULL);
+
+		(void)fclose(stream);
 	}
+
+	return NULL;
+}
+
+/*% load the queued zones, and report on them in order */
+static isc_result_t
+load_queued_zones(isc_mem_t *mctx) {
+	isc_result_t result = ISC_R_SUCCESS;
+	isc_thread_t *threads = NULL;
+	size_t nthreads = ISC_MIN((size_t)isc_os_ncpus(), nzoneloads);
+
+	if (nzoneloads == 0) {
+		return ISC_R_SUCCESS;
+	}
+
+	atomic_init(&nextzoneload, 0);
+
+	threads = isc_mem_cget(mctx, nthreads, sizeof(threads[0]));
+	for (size_t i = 0; i < nthreads; i++) {
+		isc_thread_create(zoneload_thread, mctx, &threads[i]);
+	}
+	for (size_t i = 0; i < nthreads; i++) {
+		isc_thread_join(threads[i], NULL);
+	}
+	isc_mem_cput(mctx, threads, nthreads, sizeof(threads[0]));
+
+	for (size_t i = 0; i < nzoneloads; i++) {
+		zoneload_t *zl = &zoneloads[i];
+
+		fwrite(zl->output, 1, zl->outputlen, stdout);
+		fflush(stdout);
+		free(zl->output);
+
+		if (zl->result != ISC_R_SUCCESS) {
+			fprintf(stderr, "%s/%s/%s: %s\n", zl->view, zl->zname,
+				zl->zclass, isc_result_totext(zl->result));
+			result = zl->result;
+		}
+
+		isc_mem_free(mctx, zl->zclass);
+	}
+
+	isc_mem_cput(mctx, zoneloads, zoneloadsize, sizeof(zoneloads[0]));
+	nzoneloads = 0;
+	zoneloadsize = 0;
+
 	return result;
 }
 
@@ -569,6 +683,10 @@ load_zones_fromconfig(const cfg_obj_t *config, isc_mem_t *mctx,
 	}
 
 cleanup:
+	tresult = load_queued_zones(mctx);
+	if (tresult != ISC_R_SUCCESS) {
+		result = tresult;
+	}
 	return result;
 }
 
@@ -488,7 +488,7 @@ main(int argc, char **argv) {
 			outputformat = dns_masterformat_raw;
 			rawversion = strtol(outputformatstr + 4, &end, 10);
 			if (end == outputformatstr + 4 || *end != '\0' ||
-			    rawversion > 1U)
+			    rawversion > 2U)
 			{
 				fprintf(stderr, "unknown raw format version\n");
 				exit(EXIT_FAILURE);
@@ -227,6 +227,8 @@ help(void) {
 	       "                 +[no]expire         (Request time to expire)\n"
 	       "                 +[no]fail           (Don't try next server on "
 	       "SERVFAIL)\n"
+	       "                 +[no]fanout         (Query all the servers at "
+	       "once)\n"
 	       "                 +[no]header-only    (Send query without a "
 	       "question section)\n"
 	       "                 +[no]https[=###]    (DNS-over-HTTPS mode) "
@@ -1881,8 +1883,18 @@ plus_option(char *option, bool is_batchfile, bool *need_clone,
 	case 'f': /* fail */
 		switch (cmd[1]) {
 		case 'a':
-			FULLCHECK("fail");
-			lookup->servfail_stops = state;
+			switch (cmd[2]) {
+			case 'i':
+				FULLCHECK("fail");
+				lookup->servfail_stops = state;
+				break;
+			case 'n':
+				FULLCHECK("fanout");
+				lookup->fanout = state;
+				break;
+			default:
+				goto invalid_option;
+			}
 			break;
 		case 'u':
 			FULLCHECK("fuzztime");
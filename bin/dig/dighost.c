@@ -149,6 +149,26 @@ dig_lookup_t *current_lookup = NULL;
 
 #define DIG_MAX_ADDRESSES 20
 
+/*%
+ * In +fanout mode, the query is sent to all the servers of the lookup at
+ * once and every response is printed.
+ */
+#define FANOUT(l) ((l)->fanout && !(l)->trace && !(l)->ns_search_only)
+
+/*%
+ * Are the queries of the lookup independent and started one after the
+ * other, without waiting for the responses?  This is the case for the
+ * followup lookup of +nssearch, and for +fanout.
+ */
+#define PARALLEL(l) (((l)->ns_search_only && !(l)->trace_root) || FANOUT(l))
+
+/*%
+ * The error printed when none of the parallel queries got a response.
+ */
+#define PARALLEL_UNREACHABLE(l)                         \
+	(FANOUT(l) ? "servers could not be reached"     \
+		   : "NS servers could not be reached")
+
 static void
 default_warnerr(const char *format, ...) {
 	va_list args;
@@ -773,6 +793,7 @@ clone_lookup(dig_lookup_t *lookold, bool servers) {
 	looknew->setqid = lookold->setqid;
 	looknew->qid = lookold->qid;
 	looknew->ns_search_only = lookold->ns_search_only;
+	looknew->fanout = lookold->fanout;
 	looknew->tcp_mode = lookold->tcp_mode;
 	looknew->tcp_mode_set = lookold->tcp_mode_set;
 	looknew->tls_mode = lookold->tls_mode;
@@ -2655,17 +2676,17 @@ setup_lookup(dig_lookup_t *lookup) {
 }
 
 /*%
- * NSSEARCH mode special mode handling function to start the next query in the
- * list. The lookup lock must be held by the caller. The function will detach
- * both the lookup and the query, and may cancel the lookup and clear the
- * current lookup.
+ * NSSEARCH and FANOUT mode special handling function to start the next query
+ * in the list. The lookup lock must be held by the caller. The function will
+ * detach both the lookup and the query, and may cancel the lookup and clear
+ * the current lookup.
  */
 static void
 nssearch_next(dig_lookup_t *l, dig_query_t *q) {
 	dig_query_t *next = ISC_LIST_NEXT(q, link);
 	bool tcp_mode = l->tcp_mode;
 
-	INSIST(l->ns_search_only && !l->trace_root);
+	INSIST(PARALLEL(l));
 	INSIST(l == current_lookup);
 
 	if (next == NULL) {
@@ -2676,7 +2697,7 @@ nssearch_next(dig_lookup_t *l, dig_query_t *q) {
 		 * cancel and clear the lookup.
 		 */
 		if (check_if_queries_done(l, q) && !l->ns_search_success) {
-			dighost_error("NS servers could not be reached");
+			dighost_error("%s", PARALLEL_UNREACHABLE(l));
 			if (exitcode < 9) {
 				exitcode = 9;
 			}
@@ -2738,7 +2759,7 @@ send_done(isc_nmhandle_t *handle, isc_result_t eresult, void *arg) {
 		debug("send failed: %s", isc_result_totext(eresult));
 	}
 
-	if (l->ns_search_only && !l->trace_root) {
+	if (PARALLEL(l)) {
 		nssearch_next(l, query);
 	} else {
 		query_detach(&query);
@@ -3189,12 +3210,12 @@ udp_ready(isc_nmhandle_t *handle, isc_result_t eresult, void *arg) {
 				isc_result_totext(eresult));
 
 		/*
-		 * NSSEARCH mode: if the current query failed to start properly,
-		 * then send_done() will not be called, and we want to make sure
-		 * that the next query gets a chance to start in order to not
-		 * break the chain.
+		 * NSSEARCH and FANOUT mode: if the current query failed to
+		 * start properly, then send_done() will not be called, and we
+		 * want to make sure that the next query gets a chance to start
+		 * in order to not break the chain.
 		 */
-		if (l->ns_search_only && !l->trace_root) {
+		if (PARALLEL(l)) {
 			nssearch_next(l, query);
 
 			check_if_done();
@@ -3393,6 +3414,18 @@ force_next(dig_query_t *query) {
 
 	lookup_attach(query->lookup, &l);
 
+	/*
+	 * In FANOUT mode the other servers have their own queries; skip
+	 * this one and carry on with the chain.
+	 */
+	if (FANOUT(l)) {
+		dighost_warning("couldn't get address for '%s'",
+				query->servname);
+		nssearch_next(l, query);
+		check_if_done();
+		return;
+	}
+
 	if (try_next_server(l)) {
 		lookup_detach(&l);
 		return;
@@ -3612,12 +3645,12 @@ tcp_connected(isc_nmhandle_t *handle, isc_result_t eresult, void *arg) {
 				isc_result_totext(eresult));
 
 		/*
-		 * NSSEARCH mode: if the current query failed to start properly,
-		 * then send_done() will not be called, and we want to make sure
-		 * that the next query gets a chance to start in order to not
-		 * break the chain.
+		 * NSSEARCH and FANOUT mode: if the current query failed to
+		 * start properly, then send_done() will not be called, and we
+		 * want to make sure that the next query gets a chance to start
+		 * in order to not break the chain.
 		 */
-		if (l->ns_search_only && !l->trace_root) {
+		if (PARALLEL(l)) {
 			nssearch_next(l, query);
 			check_if_done();
 			return;
@@ -3976,7 +4009,7 @@ recv_done(isc_nmhandle_t *handle, isc_result_t eresult, isc_region_t *region,
 		query->time_recv = isc_time_now();
 	}
 
-	if ((!l->pending && !l->ns_search_only) || cancel_now) {
+	if ((!l->pending && !PARALLEL(l)) || cancel_now) {
 		debug("no longer pending.  Got %s", isc_result_totext(eresult));
 
 		goto next_lookup;
@@ -3990,9 +4023,9 @@ recv_done(isc_nmhandle_t *handle, isc_result_t eresult, isc_region_t *region,
 	 * message), because there are usually more than one NS servers in the
 	 * lookup's queries list. However, if there was not a single successful
 	 * query in the followup lookup, then print an error message and exit
-	 * with a non-zero exit code.
+	 * with a non-zero exit code.  FANOUT mode works the same way.
 	 */
-	if (l->ns_search_only && !l->trace_root) {
+	if (PARALLEL(l)) {
 		if (eresult == ISC_R_SUCCESS) {
 			l->ns_search_success = true;
 		} else {
@@ -4017,8 +4050,7 @@ recv_done(isc_nmhandle_t *handle, isc_result_t eresult, isc_region_t *region,
 			 * treat the situation as an error.
 			 */
 			if (!l->ns_search_success) {
-				dighost_error(
-					"NS servers could not be reached");
+				dighost_error("%s", PARALLEL_UNREACHABLE(l));
 				if (exitcode < 9) {
 					exitcode = 9;
 				}
@@ -4371,7 +4403,7 @@ recv_done(isc_nmhandle_t *handle, isc_result_t eresult, isc_region_t *region,
 		if (l->current_query == query) {
 			query_detach(&l->current_query);
 		}
-		if (next != NULL && (!l->ns_search_only || l->trace_root)) {
+		if (next != NULL && !PARALLEL(l)) {
 			dighost_comments(l,
 					 "Got %s from %s, trying next server",
 					 err, query->servname);
@@ -4465,6 +4497,9 @@ recv_done(isc_nmhandle_t *handle, isc_result_t eresult, isc_region_t *region,
 			}
 		} else if (!l->trace && !l->ns_search_only) {
 			dighost_printmessage(query, &b, msg, true);
+			if (FANOUT(l)) {
+				docancel = check_if_queries_done(l, query);
+			}
 		} else if (l->trace) {
 			int nl = 0;
 			int count = msg->counts[DNS_SECTION_ANSWER];
@@ -4544,10 +4579,10 @@ recv_done(isc_nmhandle_t *handle, isc_result_t eresult, isc_region_t *region,
 					 query);
 		}
 
-		if (!l->ns_search_only) {
+		if (!l->ns_search_only && !FANOUT(l)) {
 			l->pending = false;
 		}
-		if (!l->ns_search_only || l->trace_root || docancel) {
+		if (!PARALLEL(l) || docancel) {
 			goto cancel_lookup;
 		}
 		goto next_lookup;
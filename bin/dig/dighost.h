@@ -104,7 +104,8 @@ struct dig_lookup {
 	isc_refcount_t references;
 	bool aaonly, adflag, badcookie, besteffort, cdflag, cleared, comments,
 		dns64prefix, dnssec, doing_xfr, done_as_is, ednsneg, expandaaaa,
-		expire, fuzzing, header_only, identify, /*%< Append an "on
+		expire, fanout, /*%< dig +fanout */
+		fuzzing, header_only, identify, /*%< Append an "on
 							   server <foo>" message
 							 */
 		identify_previous_line, /*% Prepend a "Nameserver <foo>:"
@@ -113,6 +113,11 @@ static int nsec_datatype = dns_rdatatype_nsec;
 #define BUFSIZE	  2048
 #define MAXDSKEYS 8
 
+/*%
+ * The number of nodes handed to a worker at once.
+ */
+#define WORK_BATCH 32
+
 #define SIGNER_EVENTCLASS  ISC_EVENTCLASS(0x4453)
 #define SIGNER_EVENT_WRITE (SIGNER_EVENTCLASS + 0)
 #define SIGNER_EVENT_WORK  (SIGNER_EVENTCLASS + 1)
@@ -261,13 +266,16 @@ dumpnode(dns_name_t *name, dns_dbnode_t *node) {
 }
 
 static void
-lock_and_dumpnode(dns_name_t *name, dns_dbnode_t *node) {
+lock_and_dumpnodes(dns_fixedname_t *fnames, dns_dbnode_t **nodes,
+		   size_t count) {
 	if (!output_dnssec_only) {
 		return;
 	}
 
 	LOCK(&namelock);
-	dumpnode(name, node);
+	for (size_t i = 0; i < count; i++) {
+		dumpnode(dns_fixedname_name(&fnames[i]), nodes[i]);
+	}
 	UNLOCK(&namelock);
 }
 
@@ -1557,40 +1565,19 @@ abortwork(void *arg) {
 }
 
 /*%
- * Assigns a node to a worker thread.  This is protected by the main task's
- * lock.
+ * Find the next node to sign, dumping the nodes which don't need to be
+ * signed on the way.  Returns false when there are no more nodes.
+ * This must be called with namelock held.
  */
-static void
-assignwork(void *arg) {
-	dns_fixedname_t fname;
-	dns_name_t *name = NULL;
+static bool
+nextnode(dns_name_t *name, dns_dbnode_t **nodep) {
 	dns_dbnode_t *node = NULL;
 	dns_rdataset_t nsec;
-	bool found;
+	bool found = false;
 	isc_result_t result;
 	static dns_name_t *zonecut = NULL; /* Protected by namelock. */
 	static dns_fixedname_t fzonecut;   /* Protected by namelock. */
-	static unsigned int ended = 0;	   /* Protected by namelock. */
-
-	UNUSED(arg);
-
-	if (atomic_load(&shuttingdown)) {
-		return;
-	}
 
-	LOCK(&namelock);
-	if (atomic_load(&finished)) {
-		ended++;
-		if (ended == nloops) {
-			isc_loopmgr_shutdown(loopmgr);
-		}
-		UNLOCK(&namelock);
-		return;
-	}
-
-	name = dns_fixedname_initname(&fname);
-	node = NULL;
-	found = false;
 	while (!found) {
 		result = dns_dbiterator_current(gdbiter, &node, name);
 		check_dns_dbiterator_current(result);
@@ -1655,7 +1642,38 @@ assignwork(void *arg) {
 			      isc_result_totext(result));
 		}
 	}
-	if (!found) {
+
+	*nodep = node;
+	return found;
+}
+
+/*%
+ * Assigns a batch of nodes to a worker thread, so that the workers
+ * take namelock once per batch rather than once per node.
+ */
+static void
+assignwork(void *arg) {
+	dns_fixedname_t fnames[WORK_BATCH];
+	dns_dbnode_t *nodes[WORK_BATCH];
+	size_t count = 0;
+	static unsigned int ended = 0; /* Protected by namelock. */
+
+	UNUSED(arg);
+
+	if (atomic_load(&shuttingdown)) {
+		return;
+	}
+
+	LOCK(&namelock);
+	while (count < WORK_BATCH && !atomic_load(&finished)) {
+		dns_name_t *name = dns_fixedname_initname(&fnames[count]);
+
+		if (!nextnode(name, &nodes[count])) {
+			break;
+		}
+		count++;
+	}
+	if (count == 0) {
 		ended++;
 		if (ended == nloops) {
 			isc_loopmgr_shutdown(loopmgr);
@@ -1663,16 +1681,19 @@ assignwork(void *arg) {
 		UNLOCK(&namelock);
 		return;
 	}
-
 	UNLOCK(&namelock);
 
-	signname(node, false, dns_fixedname_name(&fname));
+	for (size_t i = 0; i < count; i++) {
+		signname(nodes[i], false, dns_fixedname_name(&fnames[i]));
+	}
 
 	/*%
-	 * Write a node to the output file, and restart the worker task.
+	 * Write the nodes to the output file, and restart the worker task.
 	 */
-	lock_and_dumpnode(dns_fixedname_name(&fname), node);
-	dns_db_detachnode(gdb, &node);
+	lock_and_dumpnodes(fnames, nodes, count);
+	for (size_t i = 0; i < count; i++) {
+		dns_db_detachnode(gdb, &nodes[i]);
+	}
 
 	isc_async_current(assignwork, NULL);
 }
@@ -3802,7 +3823,7 @@ main(int argc, char *argv[]) {
 			outputformat = dns_masterformat_raw;
 			rawversion = strtol(outputformatstr + 4, &end, 10);
 			if (end == outputformatstr + 4 || *end != '\0' ||
-			    rawversion > 1U)
+			    rawversion > 2U)
 			{
 				fprintf(stderr, "unknown raw format version\n");
 				exit(EXIT_FAILURE);
@@ -4071,6 +4092,9 @@ main(int argc, char *argv[]) {
 			header.flags = DNS_MASTERRAW_SOURCESERIALSET;
 			header.sourceserial = serialnum;
 		}
+		if (rawversion == DNS_RAWFORMAT_INDEXED) {
+			header.flags |= DNS_MASTERRAW_INDEXED;
+		}
 		result = dns_master_dumptostream(mctx, gdb, gversion,
 						 masterstyle, outputformat,
 						 &header, outfp);
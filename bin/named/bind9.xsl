@@ -15,7 +15,7 @@
   <xsl:output method="html" indent="yes" version="4.0"/>
   <!-- the version number **below** must match version in bin/named/statschannel.c -->
   <!-- don't forget to update "/xml/v<STATS_XML_VERSION_MAJOR>" in the HTTP endpoints listed below -->
-  <xsl:template match="statistics[@version=&quot;3.14&quot;]">
+  <xsl:template match="statistics[@version=&quot;3.18&quot;]">
     <html>
       <head>
         <script type="text/javascript" src="https://ajax.googleapis.com/ajax/libs/jquery/3.4.1/jquery.min.js"></script>
@@ -931,6 +931,8 @@
                   <th>Messages Received</th>
                   <th>Records Received</th>
                   <th>Bytes Received</th>
+                  <th>Records Stored</th>
+                  <th>Records/s</th>
                 </tr>
               </thead>
               <tbody>
@@ -959,6 +961,8 @@
                     <td><xsl:value-of select="nmsg"/></td>
                     <td><xsl:value-of select="nrecs"/></td>
                     <td><xsl:value-of select="nbytes"/></td>
+                    <td><xsl:value-of select="napplied"/></td>
+                    <td><xsl:value-of select="nrecspersec"/></td>
                   </tr>
                 </xsl:for-each>
               </tbody>
@@ -50,7 +50,10 @@ options {\n\
 	answer-cookie true;\n\
 	automatic-interface-scan yes;\n\
 #	blackhole {none;};\n\
+	client-pool-preallocate 16;\n\
+	client-pool-size 128;\n\
 	cookie-algorithm siphash24;\n\
+	cpu-affinity no;\n\
 #	directory <none>\n\
 	dnssec-policy \"none\";\n\
 	dump-file \"named_dump.db\";\n\
@@ -91,14 +94,18 @@ options {\n\
 	http-port 80;\n\
 	https-port 443;\n\
 	http-listener-clients 300;\n\
-	http-streams-per-connection 100;\n"
+	http-streams-per-connection 100;\n\
+	http-window-size 1M;\n"
 #endif
 			    "\
+	popular-refresh-limit 0;\n\
+	popular-refresh-rate 20;\n\
 	prefetch 2 9;\n\
 #	querylog <boolean>;\n\
 	recursing-file \"named.recursing\";\n\
 	recursive-clients 1000;\n\
 	request-nsid false;\n\
+	resolver-hedge-queries false;\n\
 	resolver-query-timeout 10;\n\
 #	responselog <boolean>;\n\
 	rrset-order { order random; };\n\
@@ -114,21 +121,29 @@ options {\n\
 	statistics-file \"named.stats\";\n\
 	tcp-advertised-timeout 300;\n\
 	tcp-clients 150;\n\
+	tcp-fastopen-connect no;\n\
 	tcp-idle-timeout 300;\n\
 	tcp-initial-timeout 300;\n\
 	tcp-keepalive-timeout 300;\n\
 	tcp-listen-queue 10;\n\
 	tcp-receive-buffer 0;\n\
 	tcp-send-buffer 0;\n\
+	tcp-upstream-connections 0;\n\
+	tcp-upstream-idle-timeout 0;\n\
+	tcp-upstream-pipeline 0;\n\
 #	tkey-domain <none>\n\
 #	tkey-gssapi-credential <none>\n\
+	transfer-cache-size 0;\n\
 	transfer-message-size 20480;\n\
 	transfers-in 10;\n\
 	transfers-out 10;\n\
 	transfers-per-ns 2;\n\
 	trust-anchor-telemetry yes;\n\
+	udp-cpu-steering no;\n\
 	udp-receive-buffer 0;\n\
+	udp-segmentation-offload no;\n\
 	udp-send-buffer 0;\n\
+	udp-upstream-reuse no;\n\
 	update-quota 100;\n\
 \n\
 	/* view */\n\
@@ -142,6 +157,9 @@ options {\n\
 	allow-recursion-on { any; };\n\
 	allow-update-forwarding {none;};\n\
 	auth-nxdomain false;\n\
+	auth-response-cache no;\n\
+	cache-eviction-policy lru;\n\
+	cache-snapshot no;\n\
 	check-dup-records warn;\n\
 	check-mx warn;\n\
 	check-names primary fail;\n\
@@ -163,10 +181,12 @@ options {\n\
 #ifdef HAVE_LMDB
 			    "	lmdb-mapsize 32M;\n"
 #endif /* ifdef HAVE_LMDB */
-			    "	max-cache-size 90%;\n\
+			    "	lock-free-cache-reads no;\n\
+	max-cache-size 90%;\n\
 	max-cache-ttl 604800; /* 1 week */\n\
 	max-clients-per-query 100;\n\
 	max-ncache-ttl 10800; /* 3 hours */\n\
+	max-offloaded-validations 0;\n\
 	max-recursion-depth 7;\n\
 	max-recursion-queries 50;\n\
 	max-query-count 200;\n\
@@ -220,6 +240,7 @@ options {\n\
 #	forwarders <none>\n\
 #	inline-signing no;\n\
 	ixfr-from-differences false;\n\
+	journal-group-commit no;\n\
 	max-journal-size default;\n\
 	max-records 0;\n\
 	max-records-per-type 100;\n\
@@ -238,14 +259,17 @@ options {\n\
 	notify-to-soa no;\n\
 	send-report-channel .;\n\
 	serial-update-method increment;\n\
+	share-identical-rrsets no;\n\
 	sig-signing-nodes 100;\n\
 	sig-signing-signatures 10;\n\
 	sig-signing-type 65534;\n\
 	transfer-source *;\n\
 	transfer-source-v6 *;\n\
 	try-tcp-refresh yes; /* BIND 8 compat */\n\
+	update-batch-window 0;\n\
 	zero-no-soa-ttl yes;\n\
 	zone-statistics terse;\n\
+	zone-update-quota 0;\n\
 };\n\
 "
 
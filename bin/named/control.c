@@ -227,12 +227,18 @@ named_control_docommand(isccc_sexpr_t *message, bool readonly,
 		result = named_server_flushnode(named_g_server, lex, true);
 	} else if (command_compare(command, NAMED_COMMAND_FREEZE)) {
 		result = named_server_freeze(named_g_server, true, lex, text);
+	} else if (command_compare(command, NAMED_COMMAND_HANDOFF)) {
+		result = named_server_handoff(named_g_server, lex, text);
+	} else if (command_compare(command, NAMED_COMMAND_HITTERS)) {
+		result = named_server_hitters(named_g_server, lex, text);
 	} else if (command_compare(command, NAMED_COMMAND_SKR)) {
 		result = named_server_skr(named_g_server, lex, text);
 	} else if (command_compare(command, NAMED_COMMAND_LOADKEYS) ||
 		   command_compare(command, NAMED_COMMAND_SIGN))
 	{
 		result = named_server_rekey(named_g_server, lex, text);
+	} else if (command_compare(command, NAMED_COMMAND_LOCKSTATS)) {
+		result = named_server_lockstats(lex, text);
 	} else if (command_compare(command, NAMED_COMMAND_MKEYS)) {
 		result = named_server_mkeys(named_g_server, lex, text);
 	} else if (command_compare(command, NAMED_COMMAND_NOTIFY)) {
@@ -264,6 +270,8 @@ named_control_docommand(isccc_sexpr_t *message, bool readonly,
 	} else if (command_compare(command, NAMED_COMMAND_RETRANSFER)) {
 		result = named_server_retransfercommand(named_g_server, lex,
 							text);
+	} else if (command_compare(command, NAMED_COMMAND_SAVECACHE)) {
+		result = named_server_savecache(named_g_server, lex, text);
 	} else if (command_compare(command, NAMED_COMMAND_SCAN)) {
 		named_server_scan_interfaces(named_g_server);
 		result = ISC_R_SUCCESS;
@@ -690,6 +690,23 @@ named_controls_shutdown(named_controls_t *controls) {
 	controls_shutdown(controls);
 }
 
+size_t
+named_controls_listenerfds(named_controls_t *controls, int *fds, size_t size) {
+	size_t n = 0;
+
+	for (controllistener_t *listener = ISC_LIST_HEAD(controls->listeners);
+	     listener != NULL; listener = ISC_LIST_NEXT(listener, link))
+	{
+		if (listener->sock != NULL && !listener->shuttingdown) {
+			n += isc_nm_listenerfds(listener->sock,
+						fds + ISC_MIN(n, size),
+						size - ISC_MIN(n, size));
+		}
+	}
+
+	return n;
+}
+
 static isc_result_t
 cfgkeylist_find(const cfg_obj_t *keylist, const char *keyname,
 		const cfg_obj_t **objp) {
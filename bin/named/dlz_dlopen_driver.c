@@ -506,12 +506,28 @@ dlopen_dlz_delrdataset(const char *name, const char *type, void *driverarg,
 	return result;
 }
 
+/*
+ * Whether the answers of a module can be cached is up to the flags it
+ * returned from dlz_version().
+ */
+static bool
+dlopen_dlz_cacheable(void *driverarg, void *dbdata) {
+	dlopen_data_t *cd = (dlopen_data_t *)dbdata;
+
+	UNUSED(driverarg);
+
+	return (cd->flags & DNS_SDLZFLAG_CACHE) != 0;
+}
+
 static dns_sdlzmethods_t dlz_dlopen_methods = {
-	dlopen_dlz_create,	 dlopen_dlz_destroy,	dlopen_dlz_findzonedb,
-	dlopen_dlz_lookup,	 dlopen_dlz_authority,	dlopen_dlz_allnodes,
-	dlopen_dlz_allowzonexfr, dlopen_dlz_newversion, dlopen_dlz_closeversion,
-	dlopen_dlz_configure,	 dlopen_dlz_ssumatch,	dlopen_dlz_addrdataset,
-	dlopen_dlz_subrdataset,	 dlopen_dlz_delrdataset
+	dlopen_dlz_create,	 dlopen_dlz_destroy,
+	dlopen_dlz_findzonedb,	 dlopen_dlz_lookup,
+	dlopen_dlz_authority,	 dlopen_dlz_allnodes,
+	dlopen_dlz_allowzonexfr, dlopen_dlz_newversion,
+	dlopen_dlz_closeversion, dlopen_dlz_configure,
+	dlopen_dlz_ssumatch,	 dlopen_dlz_addrdataset,
+	dlopen_dlz_subrdataset,	 dlopen_dlz_delrdataset,
+	dlopen_dlz_cacheable
 };
 
 /*
@@ -526,7 +542,8 @@ dlz_dlopen_init(isc_mem_t *mctx) {
 	result = dns_sdlzregister("dlopen", &dlz_dlopen_methods, NULL,
 				  DNS_SDLZFLAG_RELATIVEOWNER |
 					  DNS_SDLZFLAG_RELATIVERDATA |
-					  DNS_SDLZFLAG_THREADSAFE,
+					  DNS_SDLZFLAG_THREADSAFE |
+					  DNS_SDLZFLAG_CACHE,
 				  mctx, &dlz_dlopen);
 
 	if (result != ISC_R_SUCCESS) {
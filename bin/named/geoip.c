@@ -115,6 +115,7 @@ named_geoip_load(char *dir) {
 void
 named_geoip_unload(void) {
 #ifdef HAVE_GEOIP2
+	dns_geoip_flush();
 	if (named_g_geoip->country != NULL) {
 		MMDB_close(named_g_geoip->country);
 		named_g_geoip->country = NULL;
@@ -42,7 +42,10 @@
 #define NAMED_COMMAND_FLUSHTREE	   "flushtree"
 #define NAMED_COMMAND_FREEZE	   "freeze"
 #define NAMED_COMMAND_HALT	   "halt"
+#define NAMED_COMMAND_HANDOFF	   "handoff"
+#define NAMED_COMMAND_HITTERS	   "hitters"
 #define NAMED_COMMAND_LOADKEYS	   "loadkeys"
+#define NAMED_COMMAND_LOCKSTATS	   "lockstats"
 #define NAMED_COMMAND_MKEYS	   "managed-keys"
 #define NAMED_COMMAND_MODZONE	   "modzone"
 #define NAMED_COMMAND_NOTIFY	   "notify"
@@ -56,6 +59,7 @@
 #define NAMED_COMMAND_RELOAD	   "reload"
 #define NAMED_COMMAND_RESPONSELOG  "responselog"
 #define NAMED_COMMAND_RETRANSFER   "retransfer"
+#define NAMED_COMMAND_SAVECACHE	   "savecache"
 #define NAMED_COMMAND_SCAN	   "scan"
 #define NAMED_COMMAND_SECROOTS	   "secroots"
 #define NAMED_COMMAND_SERVESTALE   "serve-stale"
@@ -105,6 +109,13 @@ named_controls_shutdown(named_controls_t *controls);
  * Initiate shutdown of all the command channels in 'controls'.
  */
 
+size_t
+named_controls_listenerfds(named_controls_t *controls, int *fds, size_t size);
+/*%<
+ * Store up to 'size' descriptors of the sockets the command channels in
+ * 'controls' listen on in 'fds', and return how many of them there are.
+ */
+
 isc_result_t
 named_control_docommand(isccc_sexpr_t *message, bool readonly,
 			isc_buffer_t **text);
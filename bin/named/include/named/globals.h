@@ -112,6 +112,13 @@ EXTERN bool named_g_nosyslog	     INIT(false);
 EXTERN unsigned int named_g_logflags INIT(0);
 EXTERN const char *named_g_logfile   INIT(NULL);
 
+/*
+ * Take over the listening sockets of a running server (-H), and the
+ * connection to it until this server is ready.
+ */
+EXTERN const char *named_g_handoff INIT(NULL);
+EXTERN int named_g_handofffd	   INIT(-1);
+
 EXTERN const char *named_g_defaultsessionkeyfile INIT(NAMED_LOCALSTATEDIR
 						      "/run/named/"
 						      "session.key");
@@ -59,6 +59,9 @@ named_os_openfile(const char *filename, mode_t mode, bool switch_user);
 void
 named_os_writepidfile(const char *filename, bool first_time);
 
+void
+named_os_forgetpidfile(void);
+
 void
 named_os_shutdown(void);
 
@@ -73,3 +76,20 @@ named_os_started(void);
 
 const char *
 named_os_uname(void);
+
+/*
+ * Hand the listening sockets over to a new server process, see
+ * "rndc handoff" and "named -H".
+ */
+isc_result_t
+named_os_handoff_send(const char *path, const int *fds, size_t nfds,
+		      int *connp);
+
+isc_result_t
+named_os_handoff_poll(int conn);
+
+isc_result_t
+named_os_handoff_receive(const char *path, isc_nm_t *netmgr, int *connp);
+
+void
+named_os_handoff_ready(int *connp);
@@ -66,10 +66,17 @@ struct named_server {
 	ns_interfacemgr_t *interfacemgr;
 	dns_db_t	  *in_roothints;
 
+	/*%
+	 * Fingerprint of the configuration without the zone statements,
+	 * see zone_confighash()
+	 */
+	uint64_t confighash;
+
 	isc_timer_t *interface_timer;
 	isc_timer_t *heartbeat_timer;
 	isc_timer_t *pps_timer;
 	isc_timer_t *tat_timer;
+	isc_timer_t *pressure_timer;
 
 	uint32_t interface_interval;
 
@@ -77,11 +84,21 @@ struct named_server {
 
 	bool flushonshutdown;
 
+	/*%
+	 * The connection to the server the listening sockets have been
+	 * handed over to, polled by 'handoff_timer' until that server is
+	 * ready; see named_server_handoff().
+	 */
+	int	     handofffd;
+	isc_timer_t *handoff_timer;
+	bool	     handedoff;
+
 	named_cachelist_t cachelist; /*%< Possibly shared caches
 				      * */
 	isc_stats_t *zonestats;	     /*% Zone management stats */
 	isc_stats_t *resolverstats;  /*% Resolver stats */
 	isc_stats_t *sockstats;	     /*%< Socket stats */
+	isc_stats_t *loopstats;	     /*%< Per-loop UDP receive stats */
 
 	named_controls_t    *controls; /*%< Control channels */
 	unsigned int	     dispatchgen;
@@ -235,12 +252,27 @@ named_server_dumpsecroots(named_server_t *server, isc_lex_t *lex,
 isc_result_t
 named_server_setdebuglevel(named_server_t *server, isc_lex_t *lex);
 
+/*%
+ * Save the snapshots of the server's cache(s)
+ */
+isc_result_t
+named_server_savecache(named_server_t *server, isc_lex_t *lex,
+		       isc_buffer_t **text);
+
 /*%
  * Flush the server's cache(s)
  */
 isc_result_t
 named_server_flushcache(named_server_t *server, isc_lex_t *lex);
 
+/*%
+ * Hand the listening sockets over to a new server started with
+ * "named -H", and shut down once it is ready.
+ */
+isc_result_t
+named_server_handoff(named_server_t *server, isc_lex_t *lex,
+		     isc_buffer_t **text);
+
 /*%
  * Flush a particular name from the server's cache.  If 'tree' is false,
  * also flush the name from the ADB and badcache.  If 'tree' is true, also
@@ -368,6 +400,22 @@ named_server_dnstap(named_server_t *server, isc_lex_t *lex,
 isc_result_t
 named_server_tcptimeouts(isc_lex_t *lex, isc_buffer_t **text);
 
+/*%
+ * Enable, disable or reset the lock contention statistics, or report the
+ * places in the source where the locks have been contended the most.
+ */
+isc_result_t
+named_server_lockstats(isc_lex_t *lex, isc_buffer_t **text);
+
+/*%
+ * Report the most frequent query names, query types and client prefixes,
+ * and the client prefixes that receive the most NXDOMAIN answers, or
+ * reset their counts.
+ */
+isc_result_t
+named_server_hitters(named_server_t *server, isc_lex_t *lex,
+		     isc_buffer_t **text);
+
 /*%
  * Control whether stale answers are served or not when configured in
  * named.conf.
@@ -304,10 +304,11 @@ static void
 usage(void) {
 	fprintf(stderr, "usage: named [-4|-6] [-c conffile] [-d debuglevel] "
 			"[-D comment]\n"
-			"             [-f|-g] [-L logfile] [-n number_of_cpus] "
-			"[-p port] [-s]\n"
-			"             [-S sockets] [-t chrootdir] [-u "
-			"username] [-U listeners]\n"
+			"             [-f|-g] [-H handoff_socket] [-L logfile] "
+			"[-n number_of_cpus]\n"
+			"             [-p port] [-s] [-S sockets] "
+			"[-t chrootdir]\n"
+			"             [-u username] [-U listeners]\n"
 			"             [-m "
 			"{usage|trace|record}]\n"
 			"             [-M fill|nofill]\n"
@@ -893,6 +894,9 @@ parse_command_line(int argc, char *argv[]) {
 			named_g_logflags = ISC_LOG_PRINTTIME | ISC_LOG_ISO8601 |
 					   ISC_LOG_TZINFO;
 			break;
+		case 'H':
+			named_g_handoff = isc_commandline_argument;
+			break;
 		case 'L':
 			named_g_logfile = isc_commandline_argument;
 			break;
@@ -1257,6 +1261,22 @@ setup(void) {
 				      isc_result_totext(result));
 	}
 
+	/*
+	 * The sockets must be in the network manager before the listeners
+	 * are created by the first load of the configuration.
+	 */
+	if (named_g_handoff != NULL) {
+		result = named_os_handoff_receive(named_g_handoff,
+						  named_g_netmgr,
+						  &named_g_handofffd);
+		if (result != ISC_R_SUCCESS) {
+			named_main_earlyfatal("unable to take over the "
+					      "listening sockets on '%s': %s",
+					      named_g_handoff,
+					      isc_result_totext(result));
+		}
+	}
+
 	named_builtin_init();
 
 	/*
@@ -15,8 +15,10 @@
 #include <stdarg.h>
 #include <stdbool.h>
 #include <sys/resource.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h> /* dev_t FreeBSD 2.1 */
+#include <sys/un.h>
 #ifdef HAVE_UNAME
 #include <sys/utsname.h>
 #endif /* ifdef HAVE_UNAME */
@@ -36,7 +38,9 @@
 #include <unistd.h>
 
 #include <isc/buffer.h>
+#include <isc/errno.h>
 #include <isc/file.h>
+#include <isc/netmgr.h>
 #include <isc/result.h>
 #include <isc/strerr.h>
 #include <isc/string.h>
@@ -191,6 +195,22 @@ linux_initialprivs(void) {
 	 */
 	SET_CAP(CAP_CHOWN);
 
+#if USE_XDP
+	/*
+	 * We need to be able to create the AF_XDP sockets, lock their
+	 * memory, and load the XDP program when the listeners are first
+	 * created.
+	 */
+	SET_CAP(CAP_NET_ADMIN);
+	SET_CAP(CAP_NET_RAW);
+	SET_CAP(CAP_IPC_LOCK);
+#ifdef CAP_BPF
+	SET_CAP(CAP_BPF);
+#else  /* ifdef CAP_BPF */
+	SET_CAP(CAP_SYS_ADMIN);
+#endif /* ifdef CAP_BPF */
+#endif /* USE_XDP */
+
 	linux_setcaps(caps);
 
 	FREE_CAP;
@@ -798,6 +818,16 @@ named_os_writepidfile(const char *filename, bool first_time) {
 	(void)fclose(fh);
 }
 
+void
+named_os_forgetpidfile(void) {
+	/*
+	 * The pid file now belongs to the process that took over the
+	 * sockets, so don't remove it on shutdown.
+	 */
+	free(pidfile);
+	pidfile = NULL;
+}
+
 void
 named_os_shutdown(void) {
 	closelog();
@@ -865,3 +895,367 @@ named_os_uname(void) {
 	}
 	return unamep;
 }
+
+/*
+ * The listening sockets are handed over on a Unix domain stream socket:
+ * the old process sends them in HANDOFF_SOCKETS messages of up to
+ * HANDOFF_BATCH descriptors each and ends with a HANDOFF_END message.  The
+ * new process answers with HANDOFF_READY when it is ready to serve, or
+ * closes the connection if it has failed to start.
+ */
+#define HANDOFF_SOCKETS 'S'
+#define HANDOFF_END	'E'
+#define HANDOFF_READY	'R'
+#define HANDOFF_BATCH	64
+
+static isc_result_t
+handoff_address(const char *path, struct sockaddr_un *sun) {
+	*sun = (struct sockaddr_un){ .sun_family = AF_UNIX };
+	if (strlcpy(sun->sun_path, path, sizeof(sun->sun_path)) >=
+	    sizeof(sun->sun_path))
+	{
+		return ISC_R_NOSPACE;
+	}
+	return ISC_R_SUCCESS;
+}
+
+/*
+ * Only a process running as root or as the user named runs as may be on
+ * the other end of the handoff socket.
+ */
+static isc_result_t
+handoff_checkpeer(int conn) {
+	uid_t uid;
+
+#if defined(SO_PEERCRED)
+	struct ucred cred;
+	socklen_t len = sizeof(cred);
+
+	if (getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0) {
+		return isc_errno_toresult(errno);
+	}
+	uid = cred.uid;
+#elif defined(HAVE_GETPEEREID)
+	gid_t gid;
+
+	if (getpeereid(conn, &uid, &gid) < 0) {
+		return isc_errno_toresult(errno);
+	}
+#else
+	UNUSED(conn);
+	return ISC_R_NOTIMPLEMENTED;
+#endif
+
+	if (uid == 0 || uid == geteuid() ||
+	    (runas_pw != NULL && uid == runas_pw->pw_uid))
+	{
+		return ISC_R_SUCCESS;
+	}
+
+	isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_MAIN,
+		      ISC_LOG_ERROR,
+		      "refusing the socket handoff with a process of uid %u",
+		      (unsigned int)uid);
+	return ISC_R_NOPERM;
+}
+
+static isc_result_t
+handoff_sendmsg(int conn, char type, const int *fds, size_t nfds) {
+	union {
+		char buf[CMSG_SPACE(HANDOFF_BATCH * sizeof(int))];
+		struct cmsghdr align;
+	} control = { 0 };
+	struct iovec iov = { .iov_base = &type, .iov_len = 1 };
+	struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1 };
+	ssize_t r;
+
+	INSIST(nfds <= HANDOFF_BATCH);
+
+	if (nfds > 0) {
+		struct cmsghdr *cmsg = NULL;
+
+		msg.msg_control = control.buf;
+		msg.msg_controllen = CMSG_SPACE(nfds * sizeof(int));
+		cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(nfds * sizeof(int));
+		memmove(CMSG_DATA(cmsg), fds, nfds * sizeof(int));
+	}
+
+	do {
+		r = sendmsg(conn, &msg, 0);
+	} while (r < 0 && errno == EINTR);
+
+	return (r < 0) ? isc_errno_toresult(errno) : ISC_R_SUCCESS;
+}
+
+isc_result_t
+named_os_handoff_send(const char *path, const int *fds, size_t nfds,
+		      int *connp) {
+	struct sockaddr_un sun;
+	isc_result_t result;
+	int conn;
+
+	REQUIRE(connp != NULL && *connp == -1);
+
+	result = handoff_address(path, &sun);
+	if (result != ISC_R_SUCCESS) {
+		return result;
+	}
+
+	conn = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (conn < 0) {
+		return isc_errno_toresult(errno);
+	}
+
+	if (connect(conn, (struct sockaddr *)&sun, sizeof(sun)) < 0) {
+		result = isc_errno_toresult(errno);
+		goto cleanup;
+	}
+
+	result = handoff_checkpeer(conn);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	for (size_t i = 0; i < nfds; i += HANDOFF_BATCH) {
+		result = handoff_sendmsg(conn, HANDOFF_SOCKETS, fds + i,
+					 ISC_MIN(nfds - i, HANDOFF_BATCH));
+		if (result != ISC_R_SUCCESS) {
+			goto cleanup;
+		}
+	}
+	result = handoff_sendmsg(conn, HANDOFF_END, NULL, 0);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	/* The answer is polled for with named_os_handoff_poll() */
+	if (fcntl(conn, F_SETFL, fcntl(conn, F_GETFL) | O_NONBLOCK) < 0) {
+		result = isc_errno_toresult(errno);
+		goto cleanup;
+	}
+
+	*connp = conn;
+	return ISC_R_SUCCESS;
+
+cleanup:
+	close(conn);
+	return result;
+}
+
+isc_result_t
+named_os_handoff_poll(int conn) {
+	char type;
+	ssize_t r;
+
+	r = read(conn, &type, 1);
+	if (r < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+			return ISC_R_WOULDBLOCK;
+		}
+		return isc_errno_toresult(errno);
+	} else if (r == 0) {
+		return ISC_R_EOF;
+	} else if (type != HANDOFF_READY) {
+		return ISC_R_UNEXPECTED;
+	}
+
+	return ISC_R_SUCCESS;
+}
+
+isc_result_t
+named_os_handoff_receive(const char *path, isc_nm_t *netmgr, int *connp) {
+	struct sockaddr_un sun;
+	isc_result_t result;
+	size_t taken = 0;
+	int listener, conn = -1;
+	mode_t mask;
+
+	REQUIRE(connp != NULL && *connp == -1);
+
+	result = handoff_address(path, &sun);
+	if (result != ISC_R_SUCCESS) {
+		return result;
+	}
+
+	listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listener < 0) {
+		return isc_errno_toresult(errno);
+	}
+
+	/*
+	 * The socket is only accessible by its owner, which is the user
+	 * named will run as, so that the running server can connect.
+	 */
+	(void)unlink(path);
+	mask = umask(0177);
+	if (bind(listener, (struct sockaddr *)&sun, sizeof(sun)) < 0) {
+		result = isc_errno_toresult(errno);
+		(void)umask(mask);
+		goto cleanup;
+	}
+	(void)umask(mask);
+	if (runas_pw != NULL && geteuid() == 0 &&
+	    chown(path, runas_pw->pw_uid, runas_pw->pw_gid) < 0)
+	{
+		result = isc_errno_toresult(errno);
+		goto cleanup;
+	}
+	if (listen(listener, 1) < 0) {
+		result = isc_errno_toresult(errno);
+		goto cleanup;
+	}
+
+	isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_MAIN,
+		      ISC_LOG_NOTICE,
+		      "waiting for the listening sockets on '%s' "
+		      "(run 'rndc handoff %s' on the running server)",
+		      path, path);
+
+	for (;;) {
+		do {
+			conn = accept(listener, NULL, NULL);
+		} while (conn < 0 && errno == EINTR);
+		if (conn < 0) {
+			result = isc_errno_toresult(errno);
+			goto cleanup;
+		}
+
+		result = handoff_checkpeer(conn);
+		if (result == ISC_R_SUCCESS) {
+			break;
+		} else if (result != ISC_R_NOPERM) {
+			goto cleanup;
+		}
+
+		/* Keep waiting for the running server */
+		close(conn);
+		conn = -1;
+	}
+
+	for (;;) {
+		union {
+			char buf[CMSG_SPACE(HANDOFF_BATCH * sizeof(int))];
+			struct cmsghdr align;
+		} control;
+		char type = 0;
+		bool truncated;
+		struct iovec iov = { .iov_base = &type, .iov_len = 1 };
+		struct msghdr msg = {
+			.msg_iov = &iov,
+			.msg_iovlen = 1,
+			.msg_control = control.buf,
+			.msg_controllen = sizeof(control.buf),
+		};
+		ssize_t r;
+
+		r = recvmsg(conn, &msg, 0);
+		if (r < 0 && errno == EINTR) {
+			continue;
+		} else if (r < 0) {
+			result = isc_errno_toresult(errno);
+			goto cleanup;
+		} else if (r == 0) {
+			result = ISC_R_EOF;
+			goto cleanup;
+		}
+
+		/*
+		 * If the descriptors did not all fit, the handoff is
+		 * incomplete; the ones that did arrive are closed.
+		 */
+		truncated = (msg.msg_flags & MSG_CTRUNC) != 0;
+		for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
+		     cmsg = CMSG_NXTHDR(&msg, cmsg))
+		{
+			if (cmsg->cmsg_level == SOL_SOCKET &&
+			    cmsg->cmsg_type == SCM_RIGHTS &&
+			    (cmsg->cmsg_len < CMSG_LEN(0) ||
+			     (cmsg->cmsg_len - CMSG_LEN(0)) % sizeof(int) != 0))
+			{
+				truncated = true;
+			}
+		}
+
+		for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
+		     cmsg = CMSG_NXTHDR(&msg, cmsg))
+		{
+			size_t n;
+
+			if (cmsg->cmsg_level != SOL_SOCKET ||
+			    cmsg->cmsg_type != SCM_RIGHTS ||
+			    cmsg->cmsg_len < CMSG_LEN(0))
+			{
+				continue;
+			}
+
+			n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+			for (size_t i = 0; i < n; i++) {
+				int fd;
+
+				memmove(&fd, CMSG_DATA(cmsg) + i * sizeof(fd),
+					sizeof(fd));
+				if (truncated) {
+					close(fd);
+				} else if (isc_nm_inheritsocket(netmgr, fd) ==
+					   ISC_R_SUCCESS)
+				{
+					taken++;
+				}
+			}
+		}
+
+		if (truncated) {
+			isc_log_write(NAMED_LOGCATEGORY_GENERAL,
+				      NAMED_LOGMODULE_MAIN, ISC_LOG_ERROR,
+				      "the listening sockets handed over on "
+				      "'%s' were truncated",
+				      path);
+			result = ISC_R_UNEXPECTEDEND;
+			goto cleanup;
+		}
+
+		if (type == HANDOFF_END) {
+			break;
+		} else if (type != HANDOFF_SOCKETS) {
+			result = ISC_R_UNEXPECTED;
+			goto cleanup;
+		}
+	}
+
+	isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_MAIN,
+		      ISC_LOG_NOTICE, "took over %zu listening sockets",
+		      taken);
+
+	*connp = conn;
+	conn = -1;
+
+cleanup:
+	if (conn >= 0) {
+		close(conn);
+	}
+	close(listener);
+	(void)unlink(path);
+	return result;
+}
+
+void
+named_os_handoff_ready(int *connp) {
+	char type = HANDOFF_READY;
+
+	REQUIRE(connp != NULL);
+
+	if (*connp < 0) {
+		return;
+	}
+
+	if (write(*connp, &type, 1) != 1) {
+		isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_MAIN,
+			      ISC_LOG_WARNING,
+			      "unable to tell the old server to exit");
+	}
+	close(*connp);
+	*connp = -1;
+}
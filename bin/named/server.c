@@ -45,10 +45,12 @@
 #include <isc/httpd.h>
 #include <isc/job.h>
 #include <isc/lex.h>
+#include <isc/lockstat.h>
 #include <isc/loop.h>
 #include <isc/meminfo.h>
 #include <isc/netmgr.h>
 #include <isc/nonce.h>
+#include <isc/os.h>
 #include <isc/parseint.h>
 #include <isc/portset.h>
 #include <isc/refcount.h>
@@ -58,6 +60,7 @@
 #include <isc/stats.h>
 #include <isc/stdio.h>
 #include <isc/string.h>
+#include <isc/thread.h>
 #include <isc/time.h>
 #include <isc/timer.h>
 #include <isc/util.h>
@@ -115,9 +118,12 @@
 #include <isccfg/namedconf.h>
 
 #include <ns/client.h>
+#include <ns/hitters.h>
 #include <ns/hooks.h>
 #include <ns/interfacemgr.h>
 #include <ns/listenlist.h>
+#include <ns/querylog.h>
+#include <ns/xfrcache.h>
 
 #include <named/config.h>
 #include <named/control.h>
@@ -242,6 +248,7 @@ struct named_cache {
 	dns_view_t *primaryview;
 	bool needflush;
 	bool adbsizeadjusted;
+	bool snapshot;
 	dns_rdataclass_t rdclass;
 	ISC_LINK(named_cache_t) link;
 };
@@ -295,6 +302,39 @@ typedef struct matching_view_ctx {
 	dns_view_t *view;
 } matching_view_ctx_t;
 
+/*
+ * With many views, matching a query against the match-clients and
+ * match-destinations of every view in turn can cost more than
+ * answering it.  For an unsigned message the matching view depends
+ * only on the addresses, the class and the RD flag, so the recent
+ * results are kept in a small cache, in thread specific memory so
+ * that it needs no locking.
+ *
+ * The cached views are not referenced: the entries are only valid for
+ * the generation of the view list they were made with, and for the
+ * generation of the ACL environment (localhost and localnets).  The
+ * view list is only replaced while the loops are paused, and replacing
+ * it bumps the generation.
+ */
+#define VIEWMATCH_CACHE_SIZE 256
+
+typedef struct viewmatch {
+	uint32_t generation;
+	uint32_t envgeneration;
+	const dns_aclenv_t *env;
+	isc_netaddr_t srcaddr;
+	isc_netaddr_t destaddr;
+	dns_rdataclass_t rdclass;
+	bool recursion;
+	isc_result_t sigresult;
+	dns_view_t *view;
+} viewmatch_t;
+
+static thread_local viewmatch_t viewmatch_cache[VIEWMATCH_CACHE_SIZE];
+
+/* Start with 1 so that the zeroed cache entries are not valid. */
+static atomic_uint_fast32_t viewmatch_generation = 1;
+
 /*%
  * Configuration context to retain for each view that allows
  * new zones to be added at runtime.
@@ -1758,10 +1798,134 @@ cache_reusable(dns_view_t *originview, dns_view_t *view,
 	return true;
 }
 
+/*
+ * The cache snapshot of a cache is named after the cache, in the working
+ * directory.
+ */
+static isc_result_t
+cache_snapshotfile(dns_cache_t *cache, char *buf, size_t buflen) {
+	return isc_file_sanitize(NULL, dns_cache_getname(cache), "csnap", buf,
+				 buflen);
+}
+
+static isc_result_t
+save_cache_snapshot(dns_cache_t *cache) {
+	isc_result_t result;
+	char filename[PATH_MAX];
+
+	result = cache_snapshotfile(cache, filename, sizeof(filename));
+	if (result == ISC_R_SUCCESS) {
+		result = dns_cache_savesnapshot(cache, filename);
+	}
+	if (result == ISC_R_SUCCESS) {
+		isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
+			      ISC_LOG_INFO, "saved cache snapshot for '%s'",
+			      dns_cache_getname(cache));
+	} else {
+		isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
+			      ISC_LOG_ERROR,
+			      "saving cache snapshot for '%s' failed: %s",
+			      dns_cache_getname(cache),
+			      isc_result_totext(result));
+	}
+
+	return result;
+}
+
+static void
+load_cache_snapshot(dns_cache_t *cache) {
+	isc_result_t result;
+	char filename[PATH_MAX];
+	size_t loaded = 0;
+
+	result = cache_snapshotfile(cache, filename, sizeof(filename));
+	if (result == ISC_R_SUCCESS) {
+		result = dns_cache_loadsnapshot(cache, filename, &loaded);
+	}
+	if (result == ISC_R_SUCCESS) {
+		isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
+			      ISC_LOG_INFO,
+			      "loaded %zu RRsets from cache snapshot '%s'",
+			      loaded, filename);
+	} else if (result != ISC_R_FILENOTFOUND) {
+		isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
+			      ISC_LOG_ERROR,
+			      "loading cache snapshot '%s' failed: %s",
+			      filename, isc_result_totext(result));
+	}
+}
+
+/*
+ * The ADB state is saved along with the cache snapshot, in a file named
+ * after the view that owns the cache.
+ */
+static isc_result_t
+adb_snapshotfile(dns_view_t *view, char *buf, size_t buflen) {
+	return isc_file_sanitize(NULL, view->name, "asnap", buf, buflen);
+}
+
+static isc_result_t
+save_adb_snapshot(dns_view_t *view) {
+	isc_result_t result;
+	dns_adb_t *adb = NULL;
+	char filename[PATH_MAX];
+
+	dns_view_getadb(view, &adb);
+	if (adb == NULL) {
+		return ISC_R_SUCCESS;
+	}
+
+	result = adb_snapshotfile(view, filename, sizeof(filename));
+	if (result == ISC_R_SUCCESS) {
+		result = dns_adb_savestate(adb, filename);
+	}
+	if (result != ISC_R_SUCCESS) {
+		isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
+			      ISC_LOG_ERROR,
+			      "saving ADB state for view '%s' failed: %s",
+			      view->name, isc_result_totext(result));
+	}
+
+	dns_adb_detach(&adb);
+	return result;
+}
+
+static void
+load_adb_snapshot(dns_view_t *view) {
+	isc_result_t result;
+	dns_adb_t *adb = NULL;
+	char filename[PATH_MAX];
+	size_t loaded = 0;
+
+	dns_view_getadb(view, &adb);
+	if (adb == NULL) {
+		return;
+	}
+
+	result = adb_snapshotfile(view, filename, sizeof(filename));
+	if (result == ISC_R_SUCCESS) {
+		result = dns_adb_loadstate(adb, filename, &loaded);
+	}
+	if (result == ISC_R_SUCCESS) {
+		isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
+			      ISC_LOG_INFO,
+			      "loaded %zu servers from ADB state '%s'", loaded,
+			      filename);
+	} else if (result != ISC_R_FILENOTFOUND) {
+		isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
+			      ISC_LOG_ERROR,
+			      "loading ADB state '%s' failed: %s", filename,
+			      isc_result_totext(result));
+	}
+
+	dns_adb_detach(&adb);
+}
+
 static bool
 cache_sharable(dns_view_t *originview, dns_view_t *view,
 	       bool new_zero_no_soattl, uint64_t new_max_cache_size,
-	       uint32_t new_stale_ttl, uint32_t new_stale_refresh_time) {
+	       uint32_t new_stale_ttl, uint32_t new_stale_refresh_time,
+	       bool new_lockfree_reads, dns_cacheevict_t new_evict_policy) {
 	/*
 	 * If the cache cannot even reused for the same view, it cannot be
 	 * shared with other views.
@@ -1777,7 +1941,10 @@ cache_sharable(dns_view_t *originview, dns_view_t *view,
 	if (dns_cache_getservestalettl(originview->cache) != new_stale_ttl ||
 	    dns_cache_getservestalerefresh(originview->cache) !=
 		    new_stale_refresh_time ||
-	    dns_cache_getcachesize(originview->cache) != new_max_cache_size)
+	    dns_cache_getcachesize(originview->cache) != new_max_cache_size ||
+	    dns_cache_getlockfreereads(originview->cache) !=
+		    new_lockfree_reads ||
+	    dns_cache_getevictionpolicy(originview->cache) != new_evict_policy)
 	{
 		return false;
 	}
@@ -2894,7 +3061,7 @@ cleanup:
 		} else {                                                    \
 			rrl->rate.r = def;                                  \
 		}                                                           \
-		rrl->rate.scaled = rrl->rate.r;                             \
+		atomic_init(&rrl->rate.scaled, rrl->rate.r);                \
 	} while (0)
 
 static isc_result_t
@@ -2903,6 +3070,7 @@ configure_rrl(dns_view_t *view, const cfg_obj_t *config, const cfg_obj_t *map) {
 	dns_rrl_t *rrl;
 	isc_result_t result;
 	int min_entries, i, j;
+	unsigned int nshards;
 
 	/*
 	 * Most DNS servers have few clients, but intentinally open
@@ -2919,7 +3087,19 @@ configure_rrl(dns_view_t *view, const cfg_obj_t *config, const cfg_obj_t *map) {
 			min_entries = 1;
 		}
 	}
-	result = dns_rrl_init(&rrl, view, min_entries);
+	/*
+	 * Split the table so that the loops rarely wait for each other.
+	 */
+	nshards = isc_loopmgr_nloops(named_g_loopmgr);
+	obj = NULL;
+	result = cfg_map_get(map, "table-shards", &obj);
+	if (result == ISC_R_SUCCESS) {
+		nshards = cfg_obj_asuint32(obj);
+		if (nshards < 1) {
+			nshards = 1;
+		}
+	}
+	result = dns_rrl_init(&rrl, view, min_entries, nshards);
 	if (result != ISC_R_SUCCESS) {
 		return result;
 	}
@@ -3587,6 +3767,14 @@ configure_dnstap(const cfg_obj_t **maps, dns_view_t *view) {
 				   cfg_obj_asstring(obj));
 	}
 
+	obj = NULL;
+	result = named_config_get(maps, "dnstap-sample", &obj);
+	if (result == ISC_R_SUCCESS) {
+		dns_dt_setsample(named_g_server->dtenv, cfg_obj_asuint32(obj));
+	} else {
+		dns_dt_setsample(named_g_server->dtenv, 0);
+	}
+
 	dns_dt_attach(named_g_server->dtenv, &view->dtenv);
 	view->dttypes = dttypes;
 
@@ -3761,6 +3949,10 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	bool auto_root = false;
 	named_cache_t *nsc = NULL;
 	bool zero_no_soattl;
+	bool lockfree_reads;
+	dns_cacheevict_t evict_policy;
+	bool cache_snapshot;
+	bool new_cache = false;
 	dns_acl_t *clients = NULL, *mapped = NULL, *excluded = NULL;
 	unsigned int query_timeout;
 	bool old_rpz_ok = false;
@@ -3846,17 +4038,27 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	}
 
 	/*
-	 * Load zone configuration
+	 * Load zone configuration; the zones are added to the zone table
+	 * in a single update.
 	 */
+	result = ISC_R_SUCCESS;
+	dns_view_beginzones(view);
 	for (element = cfg_list_first(zonelist); element != NULL;
 	     element = cfg_list_next(element))
 	{
 		const cfg_obj_t *zconfig = cfg_listelt_value(element);
-		CHECK(configure_zone(config, zconfig, vconfig, view, viewlist,
-				     kasplist, keystores, actx, false,
-				     old_rpz_ok, false, false));
+		result = configure_zone(config, zconfig, vconfig, view,
+					viewlist, kasplist, keystores, actx,
+					false, old_rpz_ok, false, false);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
 		zone_element_latest = element;
 	}
+	dns_view_endzones(view);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
 
 	/*
 	 * Check that a primary or secondary zone was found for each
@@ -3887,9 +4089,15 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	/*
 	 * If we're allowing added zones, then load zone configuration
 	 * from the newzone file for zones that were added during previous
-	 * runs.
+	 * runs.  There can be very many of them, so they too are added to
+	 * the zone table in a single update.
 	 */
-	CHECK(configure_newzones(view, config, vconfig, actx));
+	dns_view_beginzones(view);
+	result = configure_newzones(view, config, vconfig, actx);
+	dns_view_endzones(view);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
 
 	/*
 	 * Create Dynamically Loadable Zone driver.
@@ -4288,6 +4496,25 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	INSIST(result == ISC_R_SUCCESS);
 	stale_refresh_time = cfg_obj_asduration(obj);
 
+	obj = NULL;
+	result = named_config_get(maps, "lock-free-cache-reads", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	lockfree_reads = cfg_obj_asboolean(obj);
+
+	obj = NULL;
+	result = named_config_get(maps, "cache-eviction-policy", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	if (strcasecmp(cfg_obj_asstring(obj), "sieve") == 0) {
+		evict_policy = dns_cacheevict_sieve;
+	} else {
+		evict_policy = dns_cacheevict_lru;
+	}
+
+	obj = NULL;
+	result = named_config_get(maps, "cache-snapshot", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	cache_snapshot = cfg_obj_asboolean(obj);
+
 	/*
 	 * Configure the view's cache.
 	 *
@@ -4332,7 +4559,8 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	if (nsc != NULL) {
 		if (!cache_sharable(nsc->primaryview, view, zero_no_soattl,
 				    max_cache_size, max_stale_ttl,
-				    stale_refresh_time))
+				    stale_refresh_time, lockfree_reads,
+				    evict_policy))
 		{
 			isc_log_write(NAMED_LOGCATEGORY_GENERAL,
 				      NAMED_LOGMODULE_SERVER, ISC_LOG_WARNING,
@@ -4393,6 +4621,7 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 		if (cache == NULL) {
 			CHECK(dns_cache_create(named_g_loopmgr, view->rdclass,
 					       cachename, mctx, &cache));
+			new_cache = true;
 		}
 
 		nsc = isc_mem_get(mctx, sizeof(*nsc));
@@ -4406,12 +4635,31 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 		ISC_LIST_APPEND(*cachelist, nsc, link);
 	}
 
+	/*
+	 * These flush a reused cache if the settings have changed, so they
+	 * have to be done before the view picks up the cache database.
+	 */
+	CHECK(dns_cache_setlockfreereads(cache, lockfree_reads));
+	CHECK(dns_cache_setevictionpolicy(cache, evict_policy));
+
 	dns_view_setcache(view, cache, shared_cache);
 
 	dns_cache_setcachesize(cache, max_cache_size);
 	dns_cache_setservestalettl(cache, max_stale_ttl);
 	dns_cache_setservestalerefresh(cache, stale_refresh_time);
 
+	/*
+	 * Warm up a new cache from its snapshot; this has to wait until
+	 * the serve-stale settings are known, as the stale RRsets are only
+	 * kept if they can still be served.
+	 */
+	if (nsc->primaryview == view) {
+		nsc->snapshot = cache_snapshot;
+	}
+	if (new_cache && cache_snapshot) {
+		load_cache_snapshot(cache);
+	}
+
 	dns_cache_detach(&cache);
 
 	obj = NULL;
@@ -4436,7 +4684,8 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 				      dispatch4, dispatch6));
 
 	if (resstats == NULL) {
-		isc_stats_create(mctx, &resstats, dns_resstatscounter_max);
+		isc_stats_createperloop(mctx, &resstats,
+					dns_resstatscounter_max);
 	}
 	dns_resolver_setstats(view->resolver, resstats);
 	if (resquerystats == NULL) {
@@ -4476,6 +4725,14 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 		dns_adb_detach(&adb);
 	}
 
+	/*
+	 * Restore the server SRTTs and EDNS state saved along with the
+	 * cache snapshot, so that they don't have to be relearned.
+	 */
+	if (new_cache && cache_snapshot) {
+		load_adb_snapshot(view);
+	}
+
 	/*
 	 * Set up ADB quotas
 	 */
@@ -4550,6 +4807,28 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	query_timeout = cfg_obj_asuint32(obj);
 	dns_resolver_settimeout(view->resolver, query_timeout);
 
+	/*
+	 * Set whether the resolver hedges slow queries with a second
+	 * query to another server.
+	 */
+	obj = NULL;
+	result = named_config_get(maps, "resolver-hedge-queries", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	dns_resolver_sethedging(view->resolver, cfg_obj_asboolean(obj));
+
+	/*
+	 * Set how many popular RRsets the resolver refreshes before
+	 * they expire, and how fast.
+	 */
+	obj = NULL;
+	result = named_config_get(maps, "popular-refresh-limit", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	obj2 = NULL;
+	result = named_config_get(maps, "popular-refresh-rate", &obj2);
+	INSIST(result == ISC_R_SUCCESS);
+	dns_resolver_setrefresh(view->resolver, cfg_obj_asuint32(obj),
+				cfg_obj_asuint32(obj2));
+
 	/* Specify whether to use 0-TTL for negative response for SOA query */
 	dns_resolver_setzeronosoattl(view->resolver, zero_no_soattl);
 
@@ -4613,6 +4892,15 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	}
 	view->maxbits = maxbits;
 
+	/*
+	 * Set how many signature verifications can run in the thread
+	 * pool at the same time.
+	 */
+	obj = NULL;
+	result = named_config_get(maps, "max-offloaded-validations", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	view->maxoffloaded = cfg_obj_asuint32(obj);
+
 	/*
 	 * Set supported DNSSEC algorithms.
 	 */
@@ -4842,6 +5130,11 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	INSIST(result == ISC_R_SUCCESS);
 	view->auth_nxdomain = cfg_obj_asboolean(obj);
 
+	obj = NULL;
+	result = named_config_get(maps, "auth-response-cache", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	view->authrespcache = cfg_obj_asboolean(obj);
+
 	obj = NULL;
 	result = named_config_get(maps, "minimal-any", &obj);
 	INSIST(result == ISC_R_SUCCESS);
@@ -6174,6 +6467,45 @@ create_view(const cfg_obj_t *vconfig, dns_viewlist_t *viewlist,
 	return ISC_R_SUCCESS;
 }
 
+static void
+confighash_add(void *closure, const char *text, int textlen) {
+	isc_hash64_hash(closure, text, textlen, true);
+}
+
+/*
+ * Fingerprint everything in 'config' that a zone can inherit from.
+ */
+static uint64_t
+config_confighash(const cfg_obj_t *config) {
+	isc_hash64_t state;
+
+	isc_hash64_init(&state);
+	cfg_printx(config, CFG_PRINTER_ONELINE | CFG_PRINTER_NOZONES,
+		   confighash_add, &state);
+	return isc_hash64_finalize(&state);
+}
+
+/*
+ * Fingerprint the configuration of a zone: the zone statement, the
+ * view it is in, and the rest of the configuration.  When it hasn't
+ * changed, reconfiguring the zone would change nothing.
+ */
+static uint64_t
+zone_confighash(const cfg_obj_t *zconfig, dns_view_t *view) {
+	isc_hash64_t state;
+	uint64_t hash;
+
+	isc_hash64_init(&state);
+	isc_hash64_hash(&state, &named_g_server->confighash,
+			sizeof(named_g_server->confighash), true);
+	isc_hash64_hash(&state, view->name, strlen(view->name) + 1, true);
+	cfg_printx(zconfig, CFG_PRINTER_ONELINE, confighash_add, &state);
+	hash = isc_hash64_finalize(&state);
+
+	/* Zero is for unknown */
+	return hash != 0 ? hash : 1;
+}
+
 /*
  * Configure or reconfigure a zone.
  */
@@ -6207,6 +6539,8 @@ configure_zone(const cfg_obj_t *config, const cfg_obj_t *zconfig,
 	bool zone_maybe_inline = false;
 	bool inline_signing = false;
 	bool fullsign = false;
+	bool reused = false;
+	uint64_t confighash = 0;
 
 	options = NULL;
 	(void)cfg_map_get(config, "options", &options);
@@ -6466,6 +6800,7 @@ configure_zone(const cfg_obj_t *config, const cfg_obj_t *zconfig,
 		 * new view.
 		 */
 		dns_zone_setview(zone, view);
+		reused = true;
 	} else {
 		/*
 		 * We cannot reuse an existing zone, we have
@@ -6547,10 +6882,23 @@ configure_zone(const cfg_obj_t *config, const cfg_obj_t *zconfig,
 	}
 
 	/*
-	 * Configure the zone.
+	 * Configure the zone, unless it is reused and its configuration
+	 * is the same as the last time.
 	 */
-	CHECK(named_zone_configure(config, vconfig, zconfig, aclconf, kasplist,
-				   keystores, zone, raw));
+	if (!modify && named_g_server->confighash != 0) {
+		confighash = zone_confighash(zconfig, view);
+	}
+	if (reused && confighash != 0 &&
+	    dns_zone_getconfighash(zone) == confighash)
+	{
+		dns_zone_log(zone, ISC_LOG_DEBUG(1),
+			     "configuration unchanged, not reconfiguring");
+	} else {
+		dns_zone_setconfighash(zone, 0);
+		CHECK(named_zone_configure(config, vconfig, zconfig, aclconf,
+					   kasplist, keystores, zone, raw));
+		dns_zone_setconfighash(zone, confighash);
+	}
 
 	/*
 	 * Add the zone to its view in the new view list.
@@ -7037,6 +7385,13 @@ tat_timer_tick(void *arg) {
 	}
 }
 
+static void
+pressure_timer_tick(void *arg) {
+	UNUSED(arg);
+
+	isc_mem_checkpressure();
+}
+
 static void
 pps_timer_tick(void *arg) {
 	static unsigned int oldrequests = 0;
@@ -7825,6 +8180,35 @@ cleanup:
 
 #endif /* HAVE_LMDB */
 
+static void
+configure_xdp_interfaces(const cfg_obj_t **maps, ns_interfacemgr_t *mgr) {
+	const cfg_obj_t *obj = NULL;
+	const cfg_listelt_t *element = NULL;
+	const char **names = NULL;
+	size_t count = 0, i = 0;
+
+	if (named_config_get(maps, "xdp-interfaces", &obj) == ISC_R_SUCCESS) {
+		count = cfg_list_length(obj, false);
+	}
+
+	if (count > 0) {
+		names = isc_mem_cget(named_g_mctx, count, sizeof(names[0]));
+		for (element = cfg_list_first(obj); element != NULL;
+		     element = cfg_list_next(element))
+		{
+			names[i++] = cfg_obj_asstring(
+				cfg_listelt_value(element));
+		}
+	}
+
+	/* The names are copied by the interface manager */
+	ns_interfacemgr_setxdpinterfaces(mgr, names, count);
+
+	if (names != NULL) {
+		isc_mem_cput(named_g_mctx, names, count, sizeof(names[0]));
+	}
+}
+
 static isc_result_t
 load_configuration(const char *filename, named_server_t *server,
 		   bool first_time) {
@@ -7856,6 +8240,7 @@ load_configuration(const char *filename, named_server_t *server,
 	isc_portset_t *v6portset = NULL;
 	isc_result_t result;
 	uint32_t interface_interval;
+	uint32_t clientpool;
 	uint32_t udpsize;
 	uint32_t transfer_message_size;
 	uint32_t recv_tcp_buffer_size;
@@ -8011,6 +8396,13 @@ load_configuration(const char *filename, named_server_t *server,
 	result = named_config_get(maps, "http-streams-per-connection", &obj);
 	INSIST(result == ISC_R_SUCCESS);
 	named_g_http_streams_per_conn = cfg_obj_asuint32(obj);
+
+	obj = NULL;
+	result = named_config_get(maps, "http-window-size", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	isc_nm_sethttpwindow(named_g_netmgr,
+			     (uint32_t)ISC_MIN(cfg_obj_asuint64(obj),
+					       ISC_NM_HTTP_WINDOW_MAX));
 #endif
 
 	/*
@@ -8210,6 +8602,47 @@ load_configuration(const char *filename, named_server_t *server,
 	isc_nm_settimeouts(named_g_netmgr, initial, idle, keepalive,
 			   advertised);
 
+	/*
+	 * Configure pooling of outgoing TCP and TLS connections.
+	 */
+	{
+		uint32_t upstream_idle, pipeline, conns;
+
+		obj = NULL;
+		result = named_config_get(maps, "tcp-upstream-idle-timeout",
+					  &obj);
+		INSIST(result == ISC_R_SUCCESS);
+		upstream_idle = cfg_obj_asuint32(obj);
+		if (upstream_idle > MAX_KEEPALIVE_TIMEOUT / 100) {
+			cfg_obj_log(obj, ISC_LOG_WARNING,
+				    "tcp-upstream-idle-timeout value is out "
+				    "of range: lowering to %" PRIu32,
+				    MAX_KEEPALIVE_TIMEOUT / 100);
+			upstream_idle = MAX_KEEPALIVE_TIMEOUT / 100;
+		}
+
+		obj = NULL;
+		result = named_config_get(maps, "tcp-upstream-pipeline", &obj);
+		INSIST(result == ISC_R_SUCCESS);
+		pipeline = cfg_obj_asuint32(obj);
+
+		obj = NULL;
+		result = named_config_get(maps, "tcp-upstream-connections",
+					  &obj);
+		INSIST(result == ISC_R_SUCCESS);
+		conns = cfg_obj_asuint32(obj);
+
+		dns_dispatchmgr_settcppool(named_g_dispatchmgr,
+					   upstream_idle * 100, pipeline,
+					   conns);
+	}
+
+	obj = NULL;
+	result = named_config_get(maps, "udp-upstream-reuse", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	dns_dispatchmgr_setudpreuse(named_g_dispatchmgr,
+				    cfg_obj_asboolean(obj));
+
 #define CAP_IF_NOT_ZERO(v, min, max) \
 	if (v > 0 && v < min) {      \
 		v = min;             \
@@ -8248,6 +8681,33 @@ load_configuration(const char *filename, named_server_t *server,
 
 #undef CAP_IF_NOT_ZERO
 
+	obj = NULL;
+	result = named_config_get(maps, "udp-segmentation-offload", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	isc_nm_setudpgso(named_g_netmgr, cfg_obj_asboolean(obj));
+
+	obj = NULL;
+	result = named_config_get(maps, "udp-cpu-steering", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	isc_nm_setudpcpusteering(named_g_netmgr, cfg_obj_asboolean(obj));
+
+	obj = NULL;
+	result = named_config_get(maps, "cpu-affinity", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	result = isc_loopmgr_setaffinity(named_g_loopmgr,
+					 cfg_obj_asboolean(obj));
+	if (result != ISC_R_SUCCESS) {
+		isc_log_write(NAMED_LOGCATEGORY_GENERAL,
+			      NAMED_LOGMODULE_SERVER, ISC_LOG_WARNING,
+			      "cpu-affinity: unable to determine the CPUs: %s",
+			      isc_result_totext(result));
+	}
+
+	obj = NULL;
+	result = named_config_get(maps, "tcp-fastopen-connect", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	isc_nm_settcpfastopen(named_g_netmgr, cfg_obj_asboolean(obj));
+
 	/*
 	 * Configure sets of UDP query source ports.
 	 */
@@ -8332,6 +8792,11 @@ load_configuration(const char *filename, named_server_t *server,
 	server->sctx->transfer_tcp_message_size =
 		(uint16_t)transfer_message_size;
 
+	obj = NULL;
+	result = named_config_get(maps, "transfer-cache-size", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	ns_xfrcache_setmaxsize(server->sctx->xfrcache, cfg_obj_asuint64(obj));
+
 	/*
 	 * Configure the zone manager.
 	 */
@@ -8385,6 +8850,24 @@ load_configuration(const char *filename, named_server_t *server,
 	}
 	ns_interfacemgr_setbacklog(server->interfacemgr, backlog);
 
+	/*
+	 * Size the per-thread pools of idle clients.
+	 */
+	obj = NULL;
+	result = named_config_get(maps, "client-pool-preallocate", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	clientpool = cfg_obj_asuint32(obj);
+	obj = NULL;
+	result = named_config_get(maps, "client-pool-size", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	ns_interfacemgr_setclientpool(server->interfacemgr, clientpool,
+				      cfg_obj_asuint32(obj));
+
+	/*
+	 * Find the interfaces that should use the AF_XDP fast path.
+	 */
+	configure_xdp_interfaces(maps, server->interfacemgr);
+
 	obj = NULL;
 	result = named_config_get(maps, "reuseport", &obj);
 	INSIST(result == ISC_R_SUCCESS);
@@ -8533,6 +9016,10 @@ load_configuration(const char *filename, named_server_t *server,
 	isc_interval_set(&interval, named_g_tat_interval, 0);
 	isc_timer_start(server->tat_timer, isc_timertype_ticker, &interval);
 
+	isc_interval_set(&interval, 1, 0);
+	isc_timer_start(server->pressure_timer, isc_timertype_ticker,
+			&interval);
+
 	/*
 	 * Write the PID file.
 	 */
@@ -8700,6 +9187,12 @@ load_configuration(const char *filename, named_server_t *server,
 		}
 	}
 
+	/*
+	 * Fingerprint the configuration, so that the zones whose
+	 * configuration hasn't changed are not reconfigured.
+	 */
+	server->confighash = config_confighash(config);
+
 	/*
 	 * Configure and freeze all explicit views.  Explicit
 	 * views that have zones were already created at parsing
@@ -8800,6 +9293,7 @@ load_configuration(const char *filename, named_server_t *server,
 	tmpviewlist = server->viewlist;
 	server->viewlist = viewlist;
 	viewlist = tmpviewlist;
+	atomic_fetch_add_release(&viewmatch_generation, 1);
 
 	/* Make the view list available to each of the views */
 	for (dns_view_t *view = ISC_LIST_HEAD(server->viewlist); view != NULL;
@@ -9051,14 +9545,29 @@ load_configuration(const char *filename, named_server_t *server,
 	setstring(server, &server->recfile, cfg_obj_asstring(obj));
 
 	obj = NULL;
-	result = named_config_get(maps, "version", &obj);
-	if (result == ISC_R_SUCCESS) {
-		setoptstring(server, &server->version, obj);
-		server->version_set = true;
-	} else {
-		server->version_set = false;
-	}
-
+	if (named_config_get(maps, "querylog-file", &obj) == ISC_R_SUCCESS) {
+		result = ns_querylog_setfile(server->sctx->querylog,
+					     cfg_obj_asstring(obj));
+		if (result != ISC_R_SUCCESS) {
+			isc_log_write(NAMED_LOGCATEGORY_GENERAL,
+				      NAMED_LOGMODULE_SERVER, ISC_LOG_ERROR,
+				      "could not open binary query log '%s': %s",
+				      cfg_obj_asstring(obj),
+				      isc_result_totext(result));
+		}
+	} else {
+		(void)ns_querylog_setfile(server->sctx->querylog, NULL);
+	}
+
+	obj = NULL;
+	result = named_config_get(maps, "version", &obj);
+	if (result == ISC_R_SUCCESS) {
+		setoptstring(server, &server->version, obj);
+		server->version_set = true;
+	} else {
+		server->version_set = false;
+	}
+
 	obj = NULL;
 	result = named_config_get(maps, "hostname", &obj);
 	if (result == ISC_R_SUCCESS) {
@@ -9181,6 +9690,9 @@ load_configuration(const char *filename, named_server_t *server,
 	server->sctx->altsecrets = altsecrets;
 	altsecrets = tmpaltsecrets;
 
+	/* Forget the cookies verified with the previous secrets */
+	atomic_fetch_add_release(&server->sctx->cookiegen, 1);
+
 	(void)named_server_loadnta(server);
 
 	/*
@@ -9393,6 +9905,9 @@ view_loaded(void *arg) {
 
 		atomic_store(&server->reload_status, NAMED_RELOAD_DONE);
 
+		/* Let the server we took the sockets over from exit */
+		named_os_handoff_ready(&named_g_handofffd);
+
 		isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
 			      ISC_LOG_NOTICE, "running");
 	}
@@ -9497,6 +10012,9 @@ run_server(void *arg) {
 	isc_timer_create(named_g_mainloop, pps_timer_tick, server,
 			 &server->pps_timer);
 
+	isc_timer_create(named_g_mainloop, pressure_timer_tick, server,
+			 &server->pressure_timer);
+
 	CHECKFATAL(cfg_parser_create(named_g_mctx, &named_g_parser),
 		   "creating default configuration parser");
 
@@ -9506,12 +10024,25 @@ run_server(void *arg) {
 	CHECKFATAL(load_configuration(named_g_conffile, server, true),
 		   "loading configuration");
 
+	/*
+	 * Close the sockets handed over by the old server that no listener
+	 * has taken.
+	 */
+	isc_nm_inheritdone(named_g_netmgr);
+
 	CHECKFATAL(load_zones(server, false), "loading zones");
 #ifdef ENABLE_AFL
 	named_g_run_done = true;
 #endif /* ifdef ENABLE_AFL */
 }
 
+static void
+handoff_stop(named_server_t *server) {
+	isc_timer_destroy(&server->handoff_timer);
+	close(server->handofffd);
+	server->handofffd = -1;
+}
+
 void
 named_server_flushonshutdown(named_server_t *server, bool flush) {
 	REQUIRE(NAMED_SERVER_VALID(server));
@@ -9546,6 +10077,10 @@ shutdown_server(void *arg) {
 
 	named_controls_shutdown(server->controls);
 
+	if (server->handoff_timer != NULL) {
+		handoff_stop(server);
+	}
+
 	named_statschannels_shutdown(server);
 
 	isc_loopmgr_pause(named_g_loopmgr);
@@ -9582,11 +10117,25 @@ shutdown_server(void *arg) {
 		dns_keystore_detach(&keystore);
 	}
 
+	/*
+	 * Release the zone databases held by the transfer cache.
+	 */
+	ns_xfrcache_setmaxsize(server->sctx->xfrcache, 0);
+
 	for (view = ISC_LIST_HEAD(server->viewlist); view != NULL;
 	     view = view_next)
 	{
 		view_next = ISC_LIST_NEXT(view, link);
 		ISC_LIST_UNLINK(server->viewlist, view, link);
+		for (nsc = ISC_LIST_HEAD(server->cachelist); nsc != NULL;
+		     nsc = ISC_LIST_NEXT(nsc, link))
+		{
+			if (nsc->primaryview == view && nsc->snapshot &&
+			    !server->handedoff)
+			{
+				(void)save_adb_snapshot(view);
+			}
+		}
 		dns_view_flushonshutdown(view, flush);
 		dns_view_detach(&view);
 	}
@@ -9598,6 +10147,9 @@ shutdown_server(void *arg) {
 
 	while ((nsc = ISC_LIST_HEAD(server->cachelist)) != NULL) {
 		ISC_LIST_UNLINK(server->cachelist, nsc, link);
+		if (nsc->snapshot && !server->handedoff) {
+			(void)save_cache_snapshot(nsc->cache);
+		}
 		dns_cache_detach(&nsc->cache);
 		isc_mem_put(server->mctx, nsc, sizeof(*nsc));
 	}
@@ -9605,6 +10157,7 @@ shutdown_server(void *arg) {
 	isc_timer_destroy(&server->interface_timer);
 	isc_timer_destroy(&server->pps_timer);
 	isc_timer_destroy(&server->tat_timer);
+	isc_timer_destroy(&server->pressure_timer);
 
 	ns_interfacemgr_detach(&server->interfacemgr);
 
@@ -9621,11 +10174,53 @@ shutdown_server(void *arg) {
 	isc_loopmgr_resume(named_g_loopmgr);
 }
 
+static viewmatch_t *
+viewmatch_get(isc_netaddr_t *srcaddr, isc_netaddr_t *destaddr,
+	      dns_message_t *message, dns_aclenv_t *env, bool *foundp) {
+	uint32_t generation = atomic_load_acquire(&viewmatch_generation);
+	uint32_t envgeneration = atomic_load_acquire(&env->generation);
+	bool recursion = (message->flags & DNS_MESSAGEFLAG_RD) != 0;
+	viewmatch_t *entry = NULL;
+	isc_hash32_t hash;
+
+	isc_hash32_init(&hash);
+	isc_hash32_hash(&hash, &srcaddr->type,
+			srcaddr->family == AF_INET6 ? 16 : 4, true);
+	isc_hash32_hash(&hash, &destaddr->type,
+			destaddr->family == AF_INET6 ? 16 : 4, true);
+	isc_hash32_hash(&hash, &message->rdclass, sizeof(message->rdclass),
+			true);
+	entry = &viewmatch_cache[isc_hash32_finalize(&hash) %
+				 VIEWMATCH_CACHE_SIZE];
+
+	*foundp = entry->generation == generation &&
+		  entry->envgeneration == envgeneration && entry->env == env &&
+		  entry->rdclass == message->rdclass &&
+		  entry->recursion == recursion &&
+		  isc_netaddr_equal(&entry->srcaddr, srcaddr) &&
+		  isc_netaddr_equal(&entry->destaddr, destaddr);
+	if (!*foundp) {
+		*entry = (viewmatch_t){
+			.generation = generation,
+			.envgeneration = envgeneration,
+			.env = env,
+			.srcaddr = *srcaddr,
+			.destaddr = *destaddr,
+			.rdclass = message->rdclass,
+			.recursion = recursion,
+		};
+	}
+
+	return entry;
+}
+
 static isc_result_t
 get_matching_view_sync(isc_netaddr_t *srcaddr, isc_netaddr_t *destaddr,
 		       dns_message_t *message, dns_aclenv_t *env,
 		       isc_result_t *sigresult, dns_view_t **viewp) {
 	dns_view_t *view;
+	viewmatch_t *entry = NULL;
+	bool found = false;
 
 	/*
 	 * We should not be running synchronous view matching if signature
@@ -9635,6 +10230,21 @@ get_matching_view_sync(isc_netaddr_t *srcaddr, isc_netaddr_t *destaddr,
 	INSIST(message->tsigkey != NULL || message->tsig != NULL ||
 	       message->sig0 == NULL);
 
+	if (message->tsigkey == NULL && message->tsig == NULL &&
+	    message->sig0 == NULL)
+	{
+		entry = viewmatch_get(srcaddr, destaddr, message, env, &found);
+		if (found) {
+			dns_message_resetsig(message);
+			*sigresult = entry->sigresult;
+			if (entry->view == NULL) {
+				return ISC_R_NOTFOUND;
+			}
+			dns_view_attach(entry->view, viewp);
+			return ISC_R_SUCCESS;
+		}
+	}
+
 	for (view = ISC_LIST_HEAD(named_g_server->viewlist); view != NULL;
 	     view = ISC_LIST_NEXT(view, link))
 	{
@@ -9656,12 +10266,20 @@ get_matching_view_sync(isc_netaddr_t *srcaddr, isc_netaddr_t *destaddr,
 			    !(view->matchrecursiveonly &&
 			      (message->flags & DNS_MESSAGEFLAG_RD) == 0))
 			{
+				if (entry != NULL) {
+					entry->sigresult = *sigresult;
+					entry->view = view;
+				}
 				dns_view_attach(view, viewp);
 				return ISC_R_SUCCESS;
 			}
 		}
 	}
 
+	if (entry != NULL) {
+		entry->sigresult = *sigresult;
+	}
+
 	return ISC_R_NOTFOUND;
 }
 
@@ -9861,6 +10479,7 @@ named_server_create(isc_mem_t *mctx, named_server_t **serverp) {
 		.dumpfile = isc_mem_strdup(mctx, "named_dump.db"),
 		.secrootsfile = isc_mem_strdup(mctx, "named.secroots"),
 		.recfile = isc_mem_strdup(mctx, "named.recursing"),
+		.handofffd = -1,
 	};
 
 	/* Initialize server data structures. */
@@ -9907,11 +10526,15 @@ named_server_create(isc_mem_t *mctx, named_server_t **serverp) {
 			 isc_sockstatscounter_max);
 	isc_nm_setstats(named_g_netmgr, server->sockstats);
 
+	isc_stats_create(server->mctx, &server->loopstats,
+			 isc_loopmgr_nloops(named_g_loopmgr));
+	isc_nm_setloopstats(named_g_netmgr, server->loopstats);
+
 	isc_stats_create(named_g_mctx, &server->zonestats,
 			 dns_zonestatscounter_max);
 
-	isc_stats_create(named_g_mctx, &server->resolverstats,
-			 dns_resstatscounter_max);
+	isc_stats_createperloop(named_g_mctx, &server->resolverstats,
+				dns_resstatscounter_max);
 
 	CHECKFATAL(named_controls_create(server, &server->controls),
 		   "named_controls_create");
@@ -9940,6 +10563,7 @@ named_server_destroy(named_server_t **serverp) {
 
 	isc_stats_detach(&server->zonestats);
 	isc_stats_detach(&server->sockstats);
+	isc_stats_detach(&server->loopstats);
 	isc_stats_detach(&server->resolverstats);
 
 	if (server->sctx != NULL) {
@@ -10670,18 +11294,22 @@ listenelt_fromconfig(const cfg_obj_t *listener, const cfg_obj_t *config,
 	const cfg_obj_t *portobj = NULL;
 	const cfg_obj_t *http_server = NULL;
 	const cfg_obj_t *proxyobj = NULL;
+	const cfg_obj_t *fastopenobj = NULL;
 	in_port_t port = 0;
 	const char *key = NULL, *cert = NULL, *ca_file = NULL,
 		   *dhparam_file = NULL, *ciphers = NULL, *cipher_suites = NULL;
 	bool tls_prefer_server_ciphers = false,
 	     tls_prefer_server_ciphers_set = false;
 	bool tls_session_tickets = false, tls_session_tickets_set = false;
+	const char *ticket_key_file = NULL;
+	uint32_t ticket_rotation = 3600;
 	bool do_tls = false, no_tls = false, http = false;
 	ns_listenelt_t *delt = NULL;
 	uint32_t tls_protos = 0;
 	ns_listen_tls_params_t tls_params = { 0 };
 	const char *tlsname = NULL;
 	isc_nm_proxy_type_t proxy = ISC_NM_PROXY_NONE;
+	unsigned int fastopen = 0;
 
 	REQUIRE(target != NULL && *target == NULL);
 
@@ -10705,6 +11333,7 @@ listenelt_fromconfig(const cfg_obj_t *listener, const cfg_obj_t *config,
 			const cfg_obj_t *cipher_suites_obj = NULL;
 			const cfg_obj_t *prefer_server_ciphers_obj = NULL;
 			const cfg_obj_t *session_tickets_obj = NULL;
+			const cfg_obj_t *ticket_obj = NULL;
 
 			do_tls = true;
 
@@ -10786,6 +11415,19 @@ listenelt_fromconfig(const cfg_obj_t *listener, const cfg_obj_t *config,
 					cfg_obj_asboolean(session_tickets_obj);
 				tls_session_tickets_set = true;
 			}
+
+			if (cfg_map_get(tlsmap, "session-ticket-key-file",
+					&ticket_obj) == ISC_R_SUCCESS)
+			{
+				ticket_key_file = cfg_obj_asstring(ticket_obj);
+			}
+
+			ticket_obj = NULL;
+			if (cfg_map_get(tlsmap, "session-ticket-rotation",
+					&ticket_obj) == ISC_R_SUCCESS)
+			{
+				ticket_rotation = cfg_obj_asduration(ticket_obj);
+			}
 		}
 	}
 
@@ -10801,7 +11443,9 @@ listenelt_fromconfig(const cfg_obj_t *listener, const cfg_obj_t *config,
 		.prefer_server_ciphers = tls_prefer_server_ciphers,
 		.prefer_server_ciphers_set = tls_prefer_server_ciphers_set,
 		.session_tickets = tls_session_tickets,
-		.session_tickets_set = tls_session_tickets_set
+		.session_tickets_set = tls_session_tickets_set,
+		.ticket_key_file = ticket_key_file,
+		.ticket_rotation = ticket_rotation,
 	};
 
 	httpobj = cfg_tuple_get(ltup, "http");
@@ -10874,6 +11518,11 @@ listenelt_fromconfig(const cfg_obj_t *listener, const cfg_obj_t *config,
 		port = (in_port_t)cfg_obj_asuint32(portobj);
 	}
 
+	fastopenobj = cfg_tuple_get(ltup, "fastopen");
+	if (cfg_obj_isuint32(fastopenobj)) {
+		fastopen = cfg_obj_asuint32(fastopenobj);
+	}
+
 	proxyobj = cfg_tuple_get(ltup, "proxy");
 	if (proxyobj != NULL && cfg_obj_isstring(proxyobj)) {
 		const char *proxyval = cfg_obj_asstring(proxyobj);
@@ -10907,6 +11556,7 @@ listenelt_fromconfig(const cfg_obj_t *listener, const cfg_obj_t *config,
 		ns_listenelt_destroy(delt);
 		return result;
 	}
+	delt->fastopen = fastopen;
 	*target = delt;
 
 cleanup:
@@ -11631,6 +12281,71 @@ cleanup:
 	return result;
 }
 
+isc_result_t
+named_server_savecache(named_server_t *server, isc_lex_t *lex,
+		       isc_buffer_t **text) {
+	char *ptr;
+	dns_view_t *view = NULL;
+	named_cache_t *nsc;
+	isc_result_t result = ISC_R_SUCCESS;
+	bool found = false;
+
+	REQUIRE(text != NULL);
+
+	/* Skip the command name. */
+	ptr = next_token(lex, text);
+	if (ptr == NULL) {
+		return ISC_R_UNEXPECTEDEND;
+	}
+
+	/* Look for the view name. */
+	ptr = next_token(lex, text);
+	if (ptr != NULL) {
+		result = dns_viewlist_find(&server->viewlist, ptr,
+					   dns_rdataclass_in, &view);
+		if (result != ISC_R_SUCCESS) {
+			(void)putstr(text, "no such view");
+			(void)putnull(text);
+			return result;
+		}
+	}
+
+	/*
+	 * Without a view name, save the caches that have the snapshots
+	 * enabled; with one, save the cache of that view.
+	 */
+	for (nsc = ISC_LIST_HEAD(server->cachelist); nsc != NULL;
+	     nsc = ISC_LIST_NEXT(nsc, link))
+	{
+		isc_result_t tresult;
+
+		if (view != NULL ? nsc->cache != view->cache : !nsc->snapshot) {
+			continue;
+		}
+		found = true;
+		tresult = save_cache_snapshot(nsc->cache);
+		if (tresult != ISC_R_SUCCESS) {
+			result = tresult;
+		}
+		tresult = save_adb_snapshot(nsc->primaryview);
+		if (tresult != ISC_R_SUCCESS) {
+			result = tresult;
+		}
+	}
+
+	if (view != NULL) {
+		dns_view_detach(&view);
+	}
+
+	if (!found) {
+		(void)putstr(text, "no cache snapshots are enabled");
+		(void)putnull(text);
+		return ISC_R_NOTFOUND;
+	}
+
+	return result;
+}
+
 isc_result_t
 named_server_flushcache(named_server_t *server, isc_lex_t *lex) {
 	char *ptr;
@@ -11866,11 +12581,87 @@ named_server_flushnode(named_server_t *server, isc_lex_t *lex, bool tree) {
 	return result;
 }
 
+/*
+ * Print the usage of each loop's share of a per-loop quota.
+ */
+static isc_result_t
+putloopusage(isc_buffer_t **text, const char *name, isc_quota_t *quota) {
+	isc_result_t result = ISC_R_SUCCESS;
+	char line[1024];
+
+	if (isc_quota_getloops(quota) == 0) {
+		return ISC_R_SUCCESS;
+	}
+
+	snprintf(line, sizeof(line), "%s per thread:", name);
+	CHECK(putstr(text, line));
+	for (unsigned int i = 0; i < isc_quota_getloops(quota); i++) {
+		unsigned int used, max;
+		isc_quota_getloopusage(quota, i, &used, &max);
+		snprintf(line, sizeof(line), " %u/%u", used, max);
+		CHECK(putstr(text, line));
+	}
+	CHECK(putstr(text, "\n"));
+
+cleanup:
+	return result;
+}
+
+/*
+ * Print the CPU each loop is bound to and how many of the loops are on
+ * each NUMA node.
+ */
+static isc_result_t
+putaffinity(isc_buffer_t **text) {
+	isc_result_t result = ISC_R_SUCCESS;
+	uint32_t nloops = isc_loopmgr_nloops(named_g_loopmgr);
+	int maxnode = -1;
+	char line[1024];
+
+	if (isc_loop_getcpu(isc_loop_main(named_g_loopmgr)) == -1) {
+		return putstr(text, "thread CPU affinity: off\n");
+	}
+
+	CHECK(putstr(text, "thread CPUs:"));
+	for (uint32_t i = 0; i < nloops; i++) {
+		int cpu = isc_loop_getcpu(isc_loop_get(named_g_loopmgr, i));
+		snprintf(line, sizeof(line), " %d", cpu);
+		CHECK(putstr(text, line));
+		maxnode = ISC_MAX(maxnode, isc_os_cpunode(cpu));
+	}
+	CHECK(putstr(text, "\n"));
+
+	if (maxnode == -1) {
+		return ISC_R_SUCCESS;
+	}
+
+	CHECK(putstr(text, "threads per NUMA node:"));
+	for (int node = 0; node <= maxnode; node++) {
+		unsigned int count = 0;
+
+		for (uint32_t i = 0; i < nloops; i++) {
+			isc_loop_t *loop = isc_loop_get(named_g_loopmgr, i);
+			if (isc_os_cpunode(isc_loop_getcpu(loop)) == node) {
+				count++;
+			}
+		}
+		if (count > 0) {
+			snprintf(line, sizeof(line), " node%d=%u", node, count);
+			CHECK(putstr(text, line));
+		}
+	}
+	CHECK(putstr(text, "\n"));
+
+cleanup:
+	return result;
+}
+
 isc_result_t
 named_server_status(named_server_t *server, isc_buffer_t **text) {
 	isc_result_t result;
 	unsigned int zonecount, xferrunning, xferdeferred, xferfirstrefresh;
-	unsigned int soaqueries, automatic;
+	unsigned int soaqueries, automatic, scheduled, loadspending;
+	isc_nanosecs_t loadelapsed, loadexpected;
 	const char *ob = "", *cb = "", *alt = "";
 	char boottime[ISC_FORMATHTTPTIMESTAMP_SIZE];
 	char configtime[ISC_FORMATHTTPTIMESTAMP_SIZE];
@@ -11899,6 +12690,8 @@ named_server_status(named_server_t *server, isc_buffer_t **text) {
 					  DNS_ZONESTATE_SOAQUERY);
 	automatic = dns_zonemgr_getcount(server->zonemgr,
 					 DNS_ZONESTATE_AUTOMATIC);
+	scheduled = dns_zonemgr_getcount(server->zonemgr,
+					 DNS_ZONESTATE_SCHEDULED);
 
 	isc_time_formathttptimestamp(&named_g_boottime, boottime,
 				     sizeof(boottime));
@@ -11938,6 +12731,8 @@ named_server_status(named_server_t *server, isc_buffer_t **text) {
 	snprintf(line, sizeof(line), "worker threads: %u\n", named_g_cpus);
 	CHECK(putstr(text, line));
 
+	CHECK(putaffinity(text));
+
 	snprintf(line, sizeof(line), "number of zones: %u (%u automatic)\n",
 		 zonecount, automatic);
 	CHECK(putstr(text, line));
@@ -11945,6 +12740,31 @@ named_server_status(named_server_t *server, isc_buffer_t **text) {
 	snprintf(line, sizeof(line), "debug level: %u\n", named_g_debuglevel);
 	CHECK(putstr(text, line));
 
+	snprintf(line, sizeof(line), "zones with scheduled maintenance: %u\n",
+		 scheduled);
+	CHECK(putstr(text, line));
+
+	if (dns_zonemgr_getloadprogress(server->zonemgr, &loadspending,
+					&loadelapsed, &loadexpected))
+	{
+		if (loadspending == 0) {
+			snprintf(line, sizeof(line),
+				 "zone loading: done in %.3fs\n",
+				 (double)loadelapsed / NS_PER_SEC);
+		} else if (loadexpected == 0) {
+			snprintf(line, sizeof(line),
+				 "zone loading: %u pending, %.3fs elapsed\n",
+				 loadspending, (double)loadelapsed / NS_PER_SEC);
+		} else {
+			snprintf(line, sizeof(line),
+				 "zone loading: %u pending, %.3fs elapsed, "
+				 "%.3fs expected\n",
+				 loadspending, (double)loadelapsed / NS_PER_SEC,
+				 (double)loadexpected / NS_PER_SEC);
+		}
+		CHECK(putstr(text, line));
+	}
+
 	snprintf(line, sizeof(line), "xfers running: %u\n", xferrunning);
 	CHECK(putstr(text, line));
 
@@ -11977,6 +12797,9 @@ named_server_status(named_server_t *server, isc_buffer_t **text) {
 		 isc_quota_getmax(&server->sctx->recursionquota));
 	CHECK(putstr(text, line));
 
+	CHECK(putloopusage(text, "recursive clients",
+			   &server->sctx->recursionquota));
+
 	snprintf(line, sizeof(line), "recursive high-water: %u\n",
 		 (unsigned int)ns_stats_get_counter(
 			 server->sctx->nsstats,
@@ -11988,6 +12811,8 @@ named_server_status(named_server_t *server, isc_buffer_t **text) {
 		 isc_quota_getmax(&server->sctx->tcpquota));
 	CHECK(putstr(text, line));
 
+	CHECK(putloopusage(text, "tcp clients", &server->sctx->tcpquota));
+
 	snprintf(line, sizeof(line), "TCP high-water: %u\n",
 		 (unsigned int)ns_stats_get_counter(
 			 server->sctx->nsstats, ns_statscounter_tcphighwater));
@@ -12206,6 +13031,129 @@ named_server_sync(named_server_t *server, isc_lex_t *lex, isc_buffer_t **text) {
 	return result;
 }
 
+static void
+handoff_tick(void *arg) {
+	named_server_t *server = (named_server_t *)arg;
+	isc_result_t result;
+
+	result = named_os_handoff_poll(server->handofffd);
+	if (result == ISC_R_WOULDBLOCK) {
+		return;
+	}
+
+	handoff_stop(server);
+
+	if (result != ISC_R_SUCCESS) {
+		isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
+			      ISC_LOG_ERROR,
+			      "handoff: the new server has failed to start "
+			      "(%s), still serving",
+			      isc_result_totext(result));
+		return;
+	}
+
+	isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
+		      ISC_LOG_NOTICE,
+		      "handoff: the new server is ready, shutting down");
+
+	/*
+	 * The zones have been dumped and the cache saved for the new
+	 * server before the sockets were handed over, and its pid file
+	 * must stay.
+	 */
+	server->handedoff = true;
+	named_server_flushonshutdown(server, false);
+	named_os_forgetpidfile();
+	isc_loopmgr_shutdown(named_g_loopmgr);
+}
+
+isc_result_t
+named_server_handoff(named_server_t *server, isc_lex_t *lex,
+		     isc_buffer_t **text) {
+	isc_result_t result;
+	isc_interval_t interval;
+	dns_view_t *view = NULL;
+	named_cache_t *nsc = NULL;
+	const char *path = NULL;
+	char msg[128];
+	size_t nfds, n;
+	int *fds = NULL;
+
+	REQUIRE(text != NULL);
+
+	/* Skip the command name. */
+	(void)next_token(lex, text);
+
+	path = next_token(lex, text);
+	if (path == NULL) {
+		return ISC_R_UNEXPECTEDEND;
+	}
+
+	if (server->handoff_timer != NULL) {
+		(void)putstr(text, "a handoff is already in progress");
+		(void)putnull(text);
+		return ISC_R_INPROGRESS;
+	}
+
+	/*
+	 * Let the new server start with the current contents of the zones
+	 * and of the caches.
+	 */
+	isc_loopmgr_pause(named_g_loopmgr);
+	for (view = ISC_LIST_HEAD(server->viewlist); view != NULL;
+	     view = ISC_LIST_NEXT(view, link))
+	{
+		(void)dns_view_apply(view, false, NULL, synczone,
+				     &(bool){ false });
+	}
+	isc_loopmgr_resume(named_g_loopmgr);
+
+	for (nsc = ISC_LIST_HEAD(server->cachelist); nsc != NULL;
+	     nsc = ISC_LIST_NEXT(nsc, link))
+	{
+		if (nsc->snapshot) {
+			(void)save_cache_snapshot(nsc->cache);
+			(void)save_adb_snapshot(nsc->primaryview);
+		}
+	}
+
+	nfds = ns_interfacemgr_listenerfds(server->interfacemgr, NULL, 0) +
+	       named_controls_listenerfds(server->controls, NULL, 0);
+	fds = isc_mem_cget(server->mctx, ISC_MAX(nfds, 1), sizeof(fds[0]));
+	n = ns_interfacemgr_listenerfds(server->interfacemgr, fds, nfds);
+	n = ISC_MIN(n, nfds);
+	n += named_controls_listenerfds(server->controls, fds + n, nfds - n);
+	n = ISC_MIN(n, nfds);
+
+	result = named_os_handoff_send(path, fds, n, &server->handofffd);
+	isc_mem_cput(server->mctx, fds, ISC_MAX(nfds, 1), sizeof(fds[0]));
+	if (result != ISC_R_SUCCESS) {
+		snprintf(msg, sizeof(msg), "unable to hand over the sockets: %s",
+			 isc_result_totext(result));
+		(void)putstr(text, msg);
+		(void)putnull(text);
+		return result;
+	}
+
+	isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
+		      ISC_LOG_NOTICE,
+		      "handoff: handed %zu listening sockets over to '%s'", n,
+		      path);
+
+	isc_timer_create(named_g_mainloop, handoff_tick, server,
+			 &server->handoff_timer);
+	isc_interval_set(&interval, 1, 0);
+	isc_timer_start(server->handoff_timer, isc_timertype_ticker,
+			&interval);
+
+	snprintf(msg, sizeof(msg),
+		 "handed %zu sockets over, waiting for the new server", n);
+	(void)putstr(text, msg);
+	(void)putnull(text);
+
+	return ISC_R_SUCCESS;
+}
+
 /*
  * Act on a "freeze" or "thaw" command from the command channel.
  */
@@ -14181,6 +15129,55 @@ newzone_cfgctx_destroy(void **cfgp) {
 	*cfgp = NULL;
 }
 
+/*
+ * Append the progress of the NSEC3 chain creation described by the
+ * private record 'priv', if any, to 'text'.
+ */
+static isc_result_t
+nsec3chain_progress(dns_zone_t *zone, dns_rdata_t *priv, isc_buffer_t **text) {
+	isc_result_t result;
+	unsigned char buf[DNS_NSEC3PARAM_BUFFERSIZE];
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdata_nsec3param_t nsec3param;
+	uint64_t nodes, total, percent;
+	isc_stdtime_t started, now;
+	char msg[100];
+
+	if (priv->length < 5 || priv->data[0] != 0 ||
+	    !dns_nsec3param_fromprivate(priv, &rdata, buf, sizeof(buf)))
+	{
+		return ISC_R_SUCCESS;
+	}
+
+	result = dns_rdata_tostruct(&rdata, &nsec3param, NULL);
+	if (result != ISC_R_SUCCESS ||
+	    (nsec3param.flags &
+	     (DNS_NSEC3FLAG_INITIAL | DNS_NSEC3FLAG_REMOVE)) != 0)
+	{
+		return ISC_R_SUCCESS;
+	}
+
+	result = dns_zone_nsec3chainprogress(zone, &nsec3param, &nodes, &total,
+					     &started);
+	if (result != ISC_R_SUCCESS || total == 0) {
+		return ISC_R_SUCCESS;
+	}
+
+	/* The node count is an estimate, the chain isn't done yet */
+	percent = ISC_MIN(nodes * 100 / total, 99);
+	now = isc_stdtime_now();
+	if (nodes > 0 && nodes < total && now > started) {
+		snprintf(msg, sizeof(msg),
+			 " (%" PRIu64 "%% done, about %" PRIu64
+			 " seconds left)",
+			 percent, (now - started) * (total - nodes) / nodes);
+	} else {
+		snprintf(msg, sizeof(msg), " (%" PRIu64 "%% done)", percent);
+	}
+
+	return putstr(text, msg);
+}
+
 isc_result_t
 named_server_signing(named_server_t *server, isc_lex_t *lex,
 		     isc_buffer_t **text) {
@@ -14366,6 +15363,7 @@ named_server_signing(named_server_t *server, isc_lex_t *lex,
 				CHECK(putstr(text, "\n"));
 			}
 			CHECK(putstr(text, output));
+			CHECK(nsec3chain_progress(zone, &priv, text));
 			first = false;
 		}
 		if (!first) {
@@ -14768,7 +15766,8 @@ named_server_zonestatus(named_server_t *server, isc_lex_t *lex,
 	const char *type, *file;
 	char zonename[DNS_NAME_FORMATSIZE];
 	uint32_t serial, signed_serial, nodes;
-	char serbuf[16], sserbuf[16], nodebuf[16];
+	uint64_t shared;
+	char serbuf[16], sserbuf[16], nodebuf[16], sharedbuf[32];
 	char resignbuf[DNS_NAME_FORMATSIZE + DNS_RDATATYPE_FORMATSIZE + 2];
 	char lbuf[ISC_FORMATHTTPTIMESTAMP_SIZE];
 	char xbuf[ISC_FORMATHTTPTIMESTAMP_SIZE];
@@ -14835,6 +15834,10 @@ named_server_zonestatus(named_server_t *server, isc_lex_t *lex,
 	nodes = dns_db_nodecount(hasraw ? rawdb : db, dns_dbtree_main);
 	snprintf(nodebuf, sizeof(nodebuf), "%u", nodes);
 
+	/* Memory saved by sharing identical RRsets */
+	shared = dns_db_getsharedsize(hasraw ? rawdb : db);
+	snprintf(sharedbuf, sizeof(sharedbuf), "%" PRIu64, shared);
+
 	/* Security */
 	secure = dns_db_issecure(db);
 	allow = ((dns_zone_getkeyopts(zone) & DNS_ZONEKEY_ALLOW) != 0);
@@ -14931,6 +15934,11 @@ named_server_zonestatus(named_server_t *server, isc_lex_t *lex,
 	CHECK(putstr(text, "\nnodes: "));
 	CHECK(putstr(text, nodebuf));
 
+	if (shared != 0) {
+		CHECK(putstr(text, "\nshared rrset bytes: "));
+		CHECK(putstr(text, sharedbuf));
+	}
+
 	if (!isc_time_isepoch(&loadtime)) {
 		CHECK(putstr(text, "\nlast loaded: "));
 		CHECK(putstr(text, lbuf));
@@ -15858,6 +16866,133 @@ cleanup:
 	return result;
 }
 
+#define LOCKSTATS_TOP 20
+
+isc_result_t
+named_server_lockstats(isc_lex_t *lex, isc_buffer_t **text) {
+	isc_result_t result = ISC_R_SUCCESS;
+	isc_lockstat_t stats[LOCKSTATS_TOP];
+	size_t count;
+	char *ptr = NULL;
+	char msg[PATH_MAX + 128];
+
+	/* Skip the command name. */
+	ptr = next_token(lex, text);
+	if (ptr == NULL) {
+		return ISC_R_UNEXPECTEDEND;
+	}
+
+	ptr = next_token(lex, text);
+	if (ptr != NULL) {
+		const char *what = NULL;
+
+		if (!strcasecmp(ptr, "on") || !strcasecmp(ptr, "yes") ||
+		    !strcasecmp(ptr, "enable") || !strcasecmp(ptr, "true"))
+		{
+			isc_lockstat_enable(true);
+			what = "enabled";
+		} else if (!strcasecmp(ptr, "off") || !strcasecmp(ptr, "no") ||
+			   !strcasecmp(ptr, "disable") ||
+			   !strcasecmp(ptr, "false"))
+		{
+			isc_lockstat_enable(false);
+			what = "disabled";
+		} else if (!strcasecmp(ptr, "reset")) {
+			isc_lockstat_reset();
+			what = "reset";
+		} else {
+			return DNS_R_SYNTAX;
+		}
+		isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
+			      ISC_LOG_INFO, "lock statistics %s", what);
+	}
+
+	snprintf(msg, sizeof(msg), "lock statistics are %s",
+		 isc_lockstat_enabled() ? "enabled" : "disabled");
+	CHECK(putstr(text, msg));
+
+	count = isc_lockstat_get(stats, ARRAY_SIZE(stats));
+	for (size_t i = 0; i < count; i++) {
+		snprintf(msg, sizeof(msg),
+			 "\n%s:%u %s: %" PRIu64 " contended, %" PRIu64
+			 " us waited, %" PRIu64 " us longest",
+			 stats[i].file, stats[i].line,
+			 isc_lockstattype_totext(stats[i].type),
+			 stats[i].contended, stats[i].wait / NS_PER_US,
+			 stats[i].maxwait / NS_PER_US);
+		CHECK(putstr(text, msg));
+	}
+
+cleanup:
+	if (isc_buffer_usedlength(*text) > 0) {
+		(void)putnull(text);
+	}
+
+	return result;
+}
+
+#define HITTERS_DEFAULT 10
+#define HITTERS_MAX	100
+
+isc_result_t
+named_server_hitters(named_server_t *server, isc_lex_t *lex,
+		     isc_buffer_t **text) {
+	isc_result_t result = ISC_R_SUCCESS;
+	ns_hitter_t *top = NULL;
+	uint32_t ntop = HITTERS_DEFAULT;
+	size_t count;
+	char *ptr = NULL;
+	char name[DNS_NAME_FORMATSIZE];
+	char msg[DNS_NAME_FORMATSIZE + 128];
+
+	/* Skip the command name. */
+	ptr = next_token(lex, text);
+	if (ptr == NULL) {
+		return ISC_R_UNEXPECTEDEND;
+	}
+
+	ptr = next_token(lex, text);
+	if (ptr != NULL) {
+		if (!strcasecmp(ptr, "reset")) {
+			ns_hitters_reset(server->sctx->hitters);
+			isc_log_write(NAMED_LOGCATEGORY_GENERAL,
+				      NAMED_LOGMODULE_SERVER, ISC_LOG_INFO,
+				      "heavy hitters reset");
+			return ISC_R_SUCCESS;
+		}
+		result = isc_parse_uint32(&ntop, ptr, 10);
+		if (result != ISC_R_SUCCESS || ntop == 0 ||
+		    ntop > HITTERS_MAX)
+		{
+			return DNS_R_SYNTAX;
+		}
+	}
+
+	top = isc_mem_cget(named_g_mctx, ntop, sizeof(top[0]));
+	for (ns_hitterstype_t type = 0; type < ns_hitters_max; type++) {
+		count = ns_hitters_top(server->sctx->hitters, type, top, ntop);
+
+		snprintf(msg, sizeof(msg), "%s%s:", type > 0 ? "\n" : "",
+			 ns_hitterstype_totext(type));
+		CHECK(putstr(text, msg));
+		for (size_t i = 0; i < count; i++) {
+			ns_hitter_format(type, &top[i], name, sizeof(name));
+			snprintf(msg, sizeof(msg),
+				 "\n    %s: %" PRIu64 " (+/- %" PRIu64 ")", name,
+				 top[i].count, top[i].error);
+			CHECK(putstr(text, msg));
+		}
+	}
+
+cleanup:
+	isc_mem_cput(named_g_mctx, top, ntop, sizeof(top[0]));
+	if (isc_buffer_usedlength(*text) > 0) {
+		(void)putnull(text);
+	}
+
+	return result;
+}
+
 isc_result_t
 named_server_servestale(named_server_t *server, isc_lex_t *lex,
 			isc_buffer_t **text) {
@@ -15,11 +15,16 @@
 
 #include <inttypes.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #include <isc/buffer.h>
+#include <isc/histo.h>
 #include <isc/httpd.h>
+#include <isc/lockstat.h>
+#include <isc/loop.h>
 #include <isc/mem.h>
 #include <isc/once.h>
+#include <isc/parseint.h>
 #include <isc/stats.h>
 #include <isc/string.h>
 #include <isc/util.h>
@@ -38,6 +43,7 @@
 #include <dns/xfrin.h>
 #include <dns/zt.h>
 
+#include <ns/hitters.h>
 #include <ns/stats.h>
 
 #include <named/log.h>
@@ -57,11 +63,11 @@
 #include "xsl_p.h"
 
 #define STATS_XML_VERSION_MAJOR "3"
-#define STATS_XML_VERSION_MINOR "14"
+#define STATS_XML_VERSION_MINOR "18"
 #define STATS_XML_VERSION	STATS_XML_VERSION_MAJOR "." STATS_XML_VERSION_MINOR
 
 #define STATS_JSON_VERSION_MAJOR "1"
-#define STATS_JSON_VERSION_MINOR "8"
+#define STATS_JSON_VERSION_MINOR "12"
 #define STATS_JSON_VERSION	 STATS_JSON_VERSION_MAJOR "." STATS_JSON_VERSION_MINOR
 
 #define CHECK(m)                               \
@@ -187,6 +193,22 @@ static const char *gluecachestats_xmldesc[dns_gluecachestatscounter_max];
 #define gluecachestats_xmldesc	NULL
 #endif /* EXTENDED_STATS */
 
+#if defined(EXTENDED_STATS)
+static const char *latency_desc[ns_latency_max] = {
+	[ns_latency_parse] = "parse",	  [ns_latency_view] = "view",
+	[ns_latency_lookup] = "lookup",	  [ns_latency_recursion] = "recursion",
+	[ns_latency_render] = "render",	  [ns_latency_send] = "send",
+	[ns_latency_total] = "total",
+};
+
+/*%
+ * The request latency quantiles that are reported, in the decreasing
+ * order isc_histo_quantiles() requires.
+ */
+static const double latency_fractions[] = { 0.999, 0.99, 0.9, 0.5 };
+static const char *latency_quantiles[] = { "0.999", "0.99", "0.9", "0.5" };
+#endif /* EXTENDED_STATS */
+
 #define TRY0(a)                       \
 	do {                          \
 		xmlrc = (a);          \
@@ -394,6 +416,16 @@ init_desc(void) {
 		       "queries dropped due to recursive client limit",
 		       "RecLimitDropped");
 	SET_NSSTATDESC(updatequota, "Update quota exceeded", "UpdateQuota");
+	SET_NSSTATDESC(respcachehit, "responses sent from the response cache",
+		       "RespCacheHit");
+	SET_NSSTATDESC(xfrcachehit, "transfers sent from the transfer cache",
+		       "XfrCacheHit");
+	SET_NSSTATDESC(clientpoolhit, "clients reused from the client pool",
+		       "ClientPoolHit");
+	SET_NSSTATDESC(clientpoolmiss, "clients allocated for new connections",
+		       "ClientPoolMiss");
+	SET_NSSTATDESC(querylogdropped, "query log messages dropped",
+		       "QryLogDropped");
 
 	INSIST(i == ns_statscounter_max);
 
@@ -489,6 +521,25 @@ init_desc(void) {
 	SET_RESSTATDESC(priming, "priming queries", "Priming");
 	SET_RESSTATDESC(forwardonlyfail, "all forwarders failed",
 			"ForwardOnlyFail");
+	SET_RESSTATDESC(fctxrace, "fetch context lookups retried",
+			"FetchRace");
+	SET_RESSTATDESC(fcountwait, "waited for the fetch counter lock",
+			"FetchCounterWait");
+	SET_RESSTATDESC(hedgesent, "hedged queries sent", "HedgeSent");
+	SET_RESSTATDESC(hedgewon, "hedged queries answered first",
+			"HedgeWon");
+	SET_RESSTATDESC(refreshsent, "popular RRsets refreshed",
+			"RefreshSent");
+	SET_RESSTATDESC(refreshdropped, "popular RRset refreshes dropped",
+			"RefreshDropped");
+	SET_RESSTATDESC(walkshared, "waited for a shared delegation walk",
+			"WalkShared");
+	SET_RESSTATDESC(msgalloc, "response messages allocated", "MsgAlloc");
+	SET_RESSTATDESC(querycpu, "CPU time answering queries (ns)",
+			"QueryCPU");
+	SET_RESSTATDESC(resolvercpu, "CPU time resolving (ns)", "ResolverCPU");
+	SET_RESSTATDESC(validationcpu, "CPU time validating (ns)",
+			"ValidationCPU");
 
 	INSIST(i == dns_resstatscounter_max);
 
@@ -549,6 +600,11 @@ init_desc(void) {
 	SET_ZONESTATDESC(xfrsuccess, "transfer requests succeeded",
 			 "XfrSuccess");
 	SET_ZONESTATDESC(xfrfail, "transfer requests failed", "XfrFail");
+	SET_ZONESTATDESC(jnlcompact, "journal compactions", "JnlCompact");
+	SET_ZONESTATDESC(jnlcompacttime, "journal compaction time (us)",
+			 "JnlCompactTime");
+	SET_ZONESTATDESC(jnlreclaimed, "journal bytes reclaimed",
+			 "JnlReclaimed");
 	INSIST(i == dns_zonestatscounter_max);
 
 	/* Initialize socket statistics */
@@ -634,6 +690,22 @@ init_desc(void) {
 			 "TCP4Clients");
 	SET_SOCKSTATDESC(tcp6clients, "TCP/IPv6 clients currently connected",
 			 "TCP6Clients");
+	SET_SOCKSTATDESC(udp4gsosegs, "UDP/IPv4 GSO segments sent",
+			 "UDP4GSOSegs");
+	SET_SOCKSTATDESC(udp6gsosegs, "UDP/IPv6 GSO segments sent",
+			 "UDP6GSOSegs");
+	SET_SOCKSTATDESC(tcp4fastopen, "TCP/IPv4 connections accepted with TFO",
+			 "TCP4FastOpen");
+	SET_SOCKSTATDESC(tcp6fastopen, "TCP/IPv6 connections accepted with TFO",
+			 "TCP6FastOpen");
+	SET_SOCKSTATDESC(tlshandshake, "TLS full handshakes completed",
+			 "TLSHandshakes");
+	SET_SOCKSTATDESC(tlsresumed, "TLS sessions resumed", "TLSResumed");
+	SET_SOCKSTATDESC(streammsgs, "TCP/TLS/HTTP DNS messages received",
+			 "StreamMsgs");
+	SET_SOCKSTATDESC(streamcopied,
+			 "TCP/TLS/HTTP DNS message bytes copied on receive",
+			 "StreamCopiedBytes");
 	INSIST(i == isc_sockstatscounter_max);
 
 	/* Initialize DNSSEC statistics */
@@ -835,6 +907,162 @@ dump_stats(isc_stats_t *stats, isc_statsformat_t type, void *arg,
 			     values, options);
 }
 
+#define LOOPSTAT_DESCLEN sizeof("Loop4294967295")
+
+static isc_result_t
+dump_loopstats(isc_stats_t *stats, isc_statsformat_t type, void *arg,
+	       int options) {
+	isc_result_t result;
+	int ncounters = isc_stats_ncounters(stats);
+	char *names = isc_mem_cget(named_g_mctx, ncounters, LOOPSTAT_DESCLEN);
+	const char **desc = isc_mem_cget(named_g_mctx, ncounters,
+					 sizeof(desc[0]));
+	int *indices = isc_mem_cget(named_g_mctx, ncounters,
+				    sizeof(indices[0]));
+	uint64_t *values = isc_mem_cget(named_g_mctx, ncounters,
+					sizeof(values[0]));
+
+	/*
+	 * The number of the loops is only known at runtime, so the counter
+	 * names are generated on every dump.
+	 */
+	for (int i = 0; i < ncounters; i++) {
+		desc[i] = names + i * LOOPSTAT_DESCLEN;
+		snprintf(names + i * LOOPSTAT_DESCLEN, LOOPSTAT_DESCLEN,
+			 "Loop%d", i);
+		indices[i] = i;
+	}
+
+	result = dump_stats(stats, type, arg, NULL, desc, ncounters, indices,
+			    values, options);
+
+	isc_mem_cput(named_g_mctx, values, ncounters, sizeof(values[0]));
+	isc_mem_cput(named_g_mctx, indices, ncounters, sizeof(indices[0]));
+	isc_mem_cput(named_g_mctx, desc, ncounters, sizeof(desc[0]));
+	isc_mem_cput(named_g_mctx, names, ncounters, LOOPSTAT_DESCLEN);
+
+	return result;
+}
+
+/*
+ * Dump the number of the reads of each loop and the mean, median and
+ * 99th percentile of the number of datagrams received per read.
+ */
+static void
+dump_recvbatch(FILE *fp) {
+	static const double fractions[] = { 0.99, 0.5 };
+	uint32_t nloops = isc_loopmgr_nloops(named_g_loopmgr);
+
+	for (uint32_t i = 0; i < nloops; i++) {
+		isc_histo_t *hg = NULL;
+		uint64_t values[ARRAY_SIZE(fractions)];
+		double reads, mean;
+
+		isc_nm_getrecvbatch(named_g_netmgr, i, &hg);
+		isc_histo_moments(hg, &reads, &mean, NULL);
+
+		fprintf(fp, "[Loop%u]\n", i);
+		fprintf(fp, "%20" PRIu64 " reads\n", (uint64_t)reads);
+		if (reads > 0 &&
+		    isc_histo_quantiles(hg, ARRAY_SIZE(fractions), fractions,
+					values) == ISC_R_SUCCESS)
+		{
+			fprintf(fp, "%20.2f mean datagrams per read\n", mean);
+			fprintf(fp, "%20" PRIu64 " median datagrams per read\n",
+				values[1]);
+			fprintf(fp,
+				"%20" PRIu64 " 99th percentile datagrams per "
+				"read\n",
+				values[0]);
+		}
+
+		isc_histo_destroy(&hg);
+	}
+}
+
+/*
+ * The statistics of each loop, see isc_loopstats_t; the times are in
+ * nanoseconds.
+ */
+static const struct {
+	const char *name;
+	size_t offset;
+} loopusage_fields[] = {
+	{ "busy", offsetof(isc_loopstats_t, busy) },
+	{ "idle", offsetof(isc_loopstats_t, idle) },
+	{ "jobs", offsetof(isc_loopstats_t, jobs) },
+	{ "jobsqueued", offsetof(isc_loopstats_t, jobsqueued) },
+	{ "asyncs", offsetof(isc_loopstats_t, asyncs) },
+	{ "asyncsqueued", offsetof(isc_loopstats_t, asyncsqueued) },
+	{ "asyncwait", offsetof(isc_loopstats_t, asyncwait) },
+	{ "asyncmaxwait", offsetof(isc_loopstats_t, asyncmaxwait) },
+	{ "asyncwakeups", offsetof(isc_loopstats_t, asyncwakeups) },
+	{ "works", offsetof(isc_loopstats_t, works) },
+	{ "worksqueued", offsetof(isc_loopstats_t, worksqueued) },
+	{ "workwait", offsetof(isc_loopstats_t, workwait) },
+	{ "workmaxwait", offsetof(isc_loopstats_t, workmaxwait) },
+};
+
+static uint64_t
+loopusage_value(const isc_loopstats_t *stats, size_t offset) {
+	return *(const uint64_t *)((const char *)stats + offset);
+}
+
+static void
+dump_loopusage(FILE *fp) {
+	uint32_t nloops = isc_loopmgr_nloops(named_g_loopmgr);
+
+	for (uint32_t i = 0; i < nloops; i++) {
+		isc_loopstats_t stats;
+
+		isc_loop_getstats(isc_loop_get(named_g_loopmgr, i), &stats);
+
+		fprintf(fp, "[Loop%u]\n", i);
+		for (size_t j = 0; j < ARRAY_SIZE(loopusage_fields); j++) {
+			size_t offset = loopusage_fields[j].offset;
+
+			fprintf(fp, "%20" PRIu64 " %s\n",
+				loopusage_value(&stats, offset),
+				loopusage_fields[j].name);
+		}
+	}
+}
+
+static void
+dump_lockstats(FILE *fp) {
+	isc_lockstat_t stats[50];
+	size_t count = isc_lockstat_get(stats, ARRAY_SIZE(stats));
+
+	for (size_t i = 0; i < count; i++) {
+		fprintf(fp, "[%s:%u %s]\n", stats[i].file, stats[i].line,
+			isc_lockstattype_totext(stats[i].type));
+		fprintf(fp, "%20" PRIu64 " contended\n", stats[i].contended);
+		fprintf(fp, "%20" PRIu64 " wait\n", stats[i].wait);
+		fprintf(fp, "%20" PRIu64 " maxwait\n", stats[i].maxwait);
+	}
+}
+
+/*% Number of heavy hitters of each kind that are reported */
+#define HITTERS_TOP 10
+
+static void
+dump_hitters(FILE *fp, ns_server_t *sctx) {
+	ns_hitter_t top[HITTERS_TOP];
+	char buf[DNS_NAME_FORMATSIZE];
+
+	for (ns_hitterstype_t type = 0; type < ns_hitters_max; type++) {
+		size_t count = ns_hitters_top(sctx->hitters, type, top,
+					      ARRAY_SIZE(top));
+
+		fprintf(fp, "[%s]\n", ns_hitterstype_totext(type));
+		for (size_t i = 0; i < count; i++) {
+			ns_hitter_format(type, &top[i], buf, sizeof(buf));
+			fprintf(fp, "%20" PRIu64 " %s (+/- %" PRIu64 ")\n",
+				top[i].count, buf, top[i].error);
+		}
+	}
+}
+
 #if defined(EXTENDED_STATS)
 static isc_result_t
 dump_histo(isc_histomulti_t *hm, isc_statsformat_t type, void *arg,
@@ -1022,6 +1250,99 @@ cleanup:
 #endif /* ifdef HAVE_LIBXML2 */
 }
 
+static void
+rttstat_dump(const isc_sockaddr_t *addr, uint64_t samples,
+	     const uint64_t *quantiles, void *arg) {
+	static const char *names[DNS_ADB_RTTQUANTILES] = { "P99", "P95",
+							   "P50" };
+	char addrbuf[ISC_SOCKADDR_FORMATSIZE];
+	stats_dumparg_t *dumparg = arg;
+	FILE *fp;
+#ifdef HAVE_LIBXML2
+	void *writer;
+	int xmlrc;
+#endif /* ifdef HAVE_LIBXML2 */
+#ifdef HAVE_JSON_C
+	json_object *serversobj, *serverobj, *obj;
+#endif /* ifdef HAVE_JSON_C */
+
+	isc_sockaddr_format(addr, addrbuf, sizeof(addrbuf));
+
+	switch (dumparg->type) {
+	case isc_statsformat_file:
+		fp = dumparg->arg;
+		fprintf(fp, "%20" PRIu64 " %s (RTT us: p99 %" PRIu64
+			    " p95 %" PRIu64 " p50 %" PRIu64 ")\n",
+			samples, addrbuf, quantiles[0], quantiles[1],
+			quantiles[2]);
+		break;
+	case isc_statsformat_xml:
+#ifdef HAVE_LIBXML2
+		writer = dumparg->arg;
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "server"));
+		TRY0(xmlTextWriterWriteAttribute(writer, ISC_XMLCHAR "address",
+						 ISC_XMLCHAR addrbuf));
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "counter"));
+		TRY0(xmlTextWriterWriteAttribute(writer, ISC_XMLCHAR "name",
+						 ISC_XMLCHAR "Samples"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64,
+						    samples));
+		TRY0(xmlTextWriterEndElement(writer)); /* counter */
+
+		for (size_t i = 0; i < DNS_ADB_RTTQUANTILES; i++) {
+			TRY0(xmlTextWriterStartElement(writer,
+						       ISC_XMLCHAR "counter"));
+			TRY0(xmlTextWriterWriteAttribute(
+				writer, ISC_XMLCHAR "name",
+				ISC_XMLCHAR names[i]));
+			TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64,
+							    quantiles[i]));
+			TRY0(xmlTextWriterEndElement(writer)); /* counter */
+		}
+
+		TRY0(xmlTextWriterEndElement(writer)); /* server */
+#endif						       /* ifdef HAVE_LIBXML2 */
+		break;
+	case isc_statsformat_json:
+#ifdef HAVE_JSON_C
+		serversobj = (json_object *)dumparg->arg;
+		serverobj = json_object_new_object();
+		if (serverobj == NULL) {
+			dumparg->result = ISC_R_NOMEMORY;
+			return;
+		}
+		json_object_object_add(serversobj, addrbuf, serverobj);
+
+		obj = json_object_new_int64(samples);
+		if (obj == NULL) {
+			dumparg->result = ISC_R_NOMEMORY;
+			return;
+		}
+		json_object_object_add(serverobj, "Samples", obj);
+
+		for (size_t i = 0; i < DNS_ADB_RTTQUANTILES; i++) {
+			obj = json_object_new_int64(quantiles[i]);
+			if (obj == NULL) {
+				dumparg->result = ISC_R_NOMEMORY;
+				return;
+			}
+			json_object_object_add(serverobj, names[i], obj);
+		}
+#endif /* ifdef HAVE_JSON_C */
+		break;
+	}
+	return;
+#ifdef HAVE_LIBXML2
+cleanup:
+	isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
+		      ISC_LOG_ERROR, "failed at rttstat_dump()");
+	dumparg->result = ISC_R_FAILURE;
+	return;
+#endif /* ifdef HAVE_LIBXML2 */
+}
+
 static bool
 rdatastatstype_attr(dns_rdatastatstype_t type, unsigned int attr) {
 	return (DNS_RDATASTATSTYPE_ATTR(type) & attr) != 0;
@@ -1289,6 +1610,81 @@ cleanup:
 #define STATS_XML_TRAFFIC 0x20
 #define STATS_XML_ALL	  0xff
 
+static isc_result_t
+loopusage_xmlrender(xmlTextWriterPtr writer) {
+	uint32_t nloops = isc_loopmgr_nloops(named_g_loopmgr);
+	char buf[sizeof("4294967295")];
+	int xmlrc;
+
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "loops"));
+	for (uint32_t i = 0; i < nloops; i++) {
+		isc_loopstats_t stats;
+
+		isc_loop_getstats(isc_loop_get(named_g_loopmgr, i), &stats);
+
+		snprintf(buf, sizeof(buf), "%u", i);
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "loop"));
+		TRY0(xmlTextWriterWriteAttribute(writer, ISC_XMLCHAR "id",
+						 ISC_XMLCHAR buf));
+		for (size_t j = 0; j < ARRAY_SIZE(loopusage_fields); j++) {
+			size_t offset = loopusage_fields[j].offset;
+
+			TRY0(xmlTextWriterStartElement(
+				writer, ISC_XMLCHAR loopusage_fields[j].name));
+			TRY0(xmlTextWriterWriteFormatString(
+				writer, "%" PRIu64,
+				loopusage_value(&stats, offset)));
+			TRY0(xmlTextWriterEndElement(writer));
+		}
+		TRY0(xmlTextWriterEndElement(writer)); /* loop */
+	}
+	TRY0(xmlTextWriterEndElement(writer)); /* loops */
+
+	return ISC_R_SUCCESS;
+cleanup:
+	isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
+		      ISC_LOG_ERROR, "Failed at loopusage_xmlrender()");
+	return ISC_R_FAILURE;
+}
+
+static isc_result_t
+hitters_xmlrender(xmlTextWriterPtr writer, ns_server_t *sctx) {
+	ns_hitter_t top[HITTERS_TOP];
+	char buf[DNS_NAME_FORMATSIZE];
+	int xmlrc;
+
+	for (ns_hitterstype_t type = 0; type < ns_hitters_max; type++) {
+		size_t count = ns_hitters_top(sctx->hitters, type, top,
+					      ARRAY_SIZE(top));
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "hitters"));
+		TRY0(xmlTextWriterWriteAttribute(
+			writer, ISC_XMLCHAR "type",
+			ISC_XMLCHAR ns_hitterstype_totext(type)));
+		for (size_t i = 0; i < count; i++) {
+			ns_hitter_format(type, &top[i], buf, sizeof(buf));
+			TRY0(xmlTextWriterStartElement(writer,
+						       ISC_XMLCHAR "hitter"));
+			TRY0(xmlTextWriterWriteAttribute(writer,
+							 ISC_XMLCHAR "name",
+							 ISC_XMLCHAR buf));
+			TRY0(xmlTextWriterWriteFormatAttribute(
+				writer, ISC_XMLCHAR "error", "%" PRIu64,
+				top[i].error));
+			TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64,
+							    top[i].count));
+			TRY0(xmlTextWriterEndElement(writer)); /* hitter */
+		}
+		TRY0(xmlTextWriterEndElement(writer)); /* hitters */
+	}
+
+	return ISC_R_SUCCESS;
+cleanup:
+	isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
+		      ISC_LOG_ERROR, "Failed at hitters_xmlrender()");
+	return ISC_R_FAILURE;
+}
+
 static isc_result_t
 zone_xmlrender(dns_zone_t *zone, void *arg) {
 	isc_result_t result;
@@ -1487,6 +1883,8 @@ xfrin_xmlrender(dns_zone_t *zone, void *arg) {
 	bool is_first_data_received, is_ixfr;
 	unsigned int nmsg = 0;
 	unsigned int nrecs = 0;
+	unsigned int napplied = 0;
+	unsigned int nrecspersec = 0;
 	uint64_t nbytes = 0;
 
 	statlevel = dns_zone_getstatlevel(zone);
@@ -1701,7 +2099,8 @@ xfrin_xmlrender(dns_zone_t *zone, void *arg) {
 	TRY0(xmlTextWriterEndElement(writer));
 
 	if (is_running) {
-		dns_xfrin_getstats(xfr, &nmsg, &nrecs, &nbytes);
+		dns_xfrin_getstats(xfr, &nmsg, &nrecs, &nbytes, &napplied,
+				   &nrecspersec);
 	}
 	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "nmsg"));
 	TRY0(xmlTextWriterWriteFormatString(writer, "%u", nmsg));
@@ -1712,6 +2111,12 @@ xfrin_xmlrender(dns_zone_t *zone, void *arg) {
 	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "nbytes"));
 	TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64, nbytes));
 	TRY0(xmlTextWriterEndElement(writer));
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "napplied"));
+	TRY0(xmlTextWriterWriteFormatString(writer, "%u", napplied));
+	TRY0(xmlTextWriterEndElement(writer));
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "nrecspersec"));
+	TRY0(xmlTextWriterWriteFormatString(writer, "%u", nrecspersec));
+	TRY0(xmlTextWriterEndElement(writer));
 
 	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "ixfr"));
 	if (is_running && is_first_data_received) {
@@ -1907,6 +2312,17 @@ generatexml(named_server_t *server, uint32_t flags, int *buflen,
 				 sockstat_values, ISC_STATSDUMP_VERBOSE));
 
 		TRY0(xmlTextWriterEndElement(writer)); /* /sockstat */
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "counters"));
+		TRY0(xmlTextWriterWriteAttribute(writer, ISC_XMLCHAR "type",
+						 ISC_XMLCHAR "loopstat"));
+
+		CHECK(dump_loopstats(server->loopstats, isc_statsformat_xml,
+				     writer, ISC_STATSDUMP_VERBOSE));
+
+		TRY0(xmlTextWriterEndElement(writer)); /* /loopstat */
+
+		CHECK(loopusage_xmlrender(writer));
 	}
 	TRY0(xmlTextWriterEndElement(writer)); /* /server */
 
@@ -2010,6 +2426,8 @@ generatexml(named_server_t *server, uint32_t flags, int *buflen,
 		TRY0(xmlTextWriterEndElement(writer)); /* </counters> */
 		TRY0(xmlTextWriterEndElement(writer)); /* </tcp> */
 		TRY0(xmlTextWriterEndElement(writer)); /* </ipv6> */
+
+		CHECK(hitters_xmlrender(writer, server->sctx));
 		TRY0(xmlTextWriterEndElement(writer)); /* </traffic> */
 	}
 
@@ -2111,6 +2529,19 @@ generatexml(named_server_t *server, uint32_t flags, int *buflen,
 		}
 		TRY0(xmlTextWriterEndElement(writer)); /* </adbstats> */
 
+		/* <servers type="rtt"> */
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "servers"));
+		TRY0(xmlTextWriterWriteAttribute(writer, ISC_XMLCHAR "type",
+						 ISC_XMLCHAR "rtt"));
+		dns_view_getadb(view, &adb);
+		if (adb != NULL) {
+			dumparg.result = ISC_R_SUCCESS;
+			dns_adb_rttdump(adb, rttstat_dump, &dumparg);
+			dns_adb_detach(&adb);
+			CHECK(dumparg.result);
+		}
+		TRY0(xmlTextWriterEndElement(writer)); /* </servers> */
+
 		/* <cachestats> */
 		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "counters"));
 		TRY0(xmlTextWriterWriteAttribute(writer, ISC_XMLCHAR "type",
@@ -2307,6 +2738,59 @@ wrap_jsonfree(isc_buffer_t *buffer, void *arg) {
 	}
 }
 
+/*
+ * Add the heavy hitters of each kind to 'traffic', as arrays of objects
+ * with the name of the key and its count.
+ */
+static isc_result_t
+hitters_jsonrender(json_object *traffic, ns_server_t *sctx) {
+	isc_result_t result = ISC_R_SUCCESS;
+	ns_hitter_t top[HITTERS_TOP];
+	char buf[DNS_NAME_FORMATSIZE];
+	json_object *hitters = NULL, *list = NULL, *hitter = NULL;
+
+	hitters = json_object_new_object();
+	CHECKMEM(hitters);
+
+	for (ns_hitterstype_t type = 0; type < ns_hitters_max; type++) {
+		size_t count = ns_hitters_top(sctx->hitters, type, top,
+					      ARRAY_SIZE(top));
+
+		list = json_object_new_array();
+		CHECKMEM(list);
+		for (size_t i = 0; i < count; i++) {
+			ns_hitter_format(type, &top[i], buf, sizeof(buf));
+			hitter = json_object_new_object();
+			CHECKMEM(hitter);
+			json_object_object_add(hitter, "name",
+					       json_object_new_string(buf));
+			json_object_object_add(
+				hitter, "count",
+				json_object_new_int64(top[i].count));
+			json_object_object_add(
+				hitter, "error",
+				json_object_new_int64(top[i].error));
+			json_object_array_add(list, hitter);
+		}
+		json_object_object_add(hitters, ns_hitterstype_totext(type),
+				       list);
+		list = NULL;
+	}
+
+	json_object_object_add(traffic, "hitters", hitters);
+	hitters = NULL;
+
+cleanup:
+	if (list != NULL) {
+		json_object_put(list);
+	}
+	if (hitters != NULL) {
+		json_object_put(hitters);
+	}
+
+	return result;
+}
+
 static json_object *
 addzone(char *name, char *classname, const char *ztype, uint32_t serial,
 	bool add_serial) {
@@ -2330,6 +2814,16 @@ addzone(char *name, char *classname, const char *ztype, uint32_t serial,
 	return node;
 }
 
+/*%
+ * A page of the zones to render: 'skip' zones are passed over before
+ * any is added to 'zonearray', and no more than 'remaining' are added.
+ */
+typedef struct zonepage {
+	json_object *zonearray;
+	uint32_t skip;
+	uint32_t remaining;
+} zonepage_t;
+
 static isc_result_t
 zone_jsonrender(dns_zone_t *zone, void *arg) {
 	isc_result_t result = ISC_R_SUCCESS;
@@ -2339,7 +2833,8 @@ zone_jsonrender(dns_zone_t *zone, void *arg) {
 	char *class_only = NULL;
 	dns_rdataclass_t rdclass;
 	uint32_t serial;
-	json_object *zonearray = (json_object *)arg;
+	zonepage_t *page = arg;
+	json_object *zonearray = page->zonearray;
 	json_object *zoneobj = NULL;
 	dns_zonestat_level_t statlevel;
 	isc_time_t timestamp;
@@ -2349,6 +2844,16 @@ zone_jsonrender(dns_zone_t *zone, void *arg) {
 		return ISC_R_SUCCESS;
 	}
 
+	if (page->skip > 0) {
+		page->skip--;
+		return ISC_R_SUCCESS;
+	}
+	if (page->remaining == 0) {
+		/* Stop walking the zone table */
+		return ISC_R_NOMORE;
+	}
+	page->remaining--;
+
 	dns_zone_nameonly(zone, buf, sizeof(buf));
 	zone_name_only = buf;
 
@@ -2558,6 +3063,8 @@ xfrin_jsonrender(dns_zone_t *zone, void *arg) {
 	bool is_first_data_received, is_ixfr;
 	unsigned int nmsg = 0;
 	unsigned int nrecs = 0;
+	unsigned int napplied = 0;
+	unsigned int nrecspersec = 0;
 	uint64_t nbytes = 0;
 
 	statlevel = dns_zone_getstatlevel(zone);
@@ -2756,7 +3263,8 @@ xfrin_jsonrender(dns_zone_t *zone, void *arg) {
 	}
 
 	if (is_running) {
-		dns_xfrin_getstats(xfr, &nmsg, &nrecs, &nbytes);
+		dns_xfrin_getstats(xfr, &nmsg, &nrecs, &nbytes, &napplied,
+				   &nrecspersec);
 	}
 	json_object_object_add(xfrinobj, "nmsg",
 			       json_object_new_int64((int64_t)nmsg));
@@ -2766,6 +3274,10 @@ xfrin_jsonrender(dns_zone_t *zone, void *arg) {
 		xfrinobj, "nbytes",
 		json_object_new_int64(nbytes > INT64_MAX ? INT64_MAX
 							 : (int64_t)nbytes));
+	json_object_object_add(xfrinobj, "napplied",
+			       json_object_new_int64((int64_t)napplied));
+	json_object_object_add(xfrinobj, "nrecspersec",
+			       json_object_new_int64((int64_t)nrecspersec));
 
 	if (is_running && is_first_data_received) {
 		json_object_object_add(
@@ -2792,8 +3304,13 @@ cleanup:
 
 static isc_result_t
 generatejson(named_server_t *server, size_t *msglen, const char **msg,
-	     json_object **rootp, uint32_t flags) {
+	     json_object **rootp, uint32_t flags, uint32_t zoneoffset,
+	     uint32_t zonelimit) {
 	dns_view_t *view;
+	zonepage_t page = {
+		.skip = zoneoffset,
+		.remaining = (zonelimit != 0) ? zonelimit : UINT32_MAX,
+	};
 	isc_result_t result = ISC_R_SUCCESS;
 	json_object *bindstats, *viewlist, *counters, *obj;
 	json_object *traffic = NULL;
@@ -2979,6 +3496,46 @@ generatejson(named_server_t *server, size_t *msglen, const char **msg,
 			json_object_put(counters);
 		}
 
+		/* request latencies, in microseconds */
+		counters = json_object_new_object();
+		CHECKMEM(counters);
+		json_object_object_add(bindstats, "latency", counters);
+
+		for (size_t i = 0; i < ns_latency_max; i++) {
+			uint64_t values[ARRAY_SIZE(latency_fractions)];
+			isc_histo_t *hg = NULL;
+			json_object *stage = NULL;
+			double pop, mean;
+
+			isc_histomulti_merge(&hg, server->sctx->latency[i]);
+			isc_histo_moments(hg, &pop, &mean, NULL);
+			result = isc_histo_quantiles(
+				hg, ARRAY_SIZE(latency_fractions),
+				latency_fractions, values);
+			isc_histo_destroy(&hg);
+			if (result != ISC_R_SUCCESS) {
+				continue;
+			}
+
+			stage = json_object_new_object();
+			CHECKMEM(stage);
+			json_object_object_add(counters, latency_desc[i], stage);
+
+			obj = json_object_new_int64(pop);
+			CHECKMEM(obj);
+			json_object_object_add(stage, "count", obj);
+			obj = json_object_new_int64(mean);
+			CHECKMEM(obj);
+			json_object_object_add(stage, "mean", obj);
+			for (size_t j = 0; j < ARRAY_SIZE(values); j++) {
+				obj = json_object_new_int64(values[j]);
+				CHECKMEM(obj);
+				json_object_object_add(
+					stage, latency_quantiles[j], obj);
+			}
+		}
+		result = ISC_R_SUCCESS;
+
 #ifdef HAVE_DNSTAP
 		/* dnstap stat counters */
 		if (named_g_server->dtenv != NULL) {
@@ -3028,8 +3585,13 @@ generatejson(named_server_t *server, size_t *msglen, const char **msg,
 			CHECKMEM(za);
 
 			if ((flags & STATS_JSON_ZONES) != 0) {
-				CHECK(dns_view_apply(view, true, NULL,
-						     zone_jsonrender, za));
+				page.zonearray = za;
+				result = dns_view_apply(view, true, NULL,
+							zone_jsonrender, &page);
+				if (result == ISC_R_NOMORE) {
+					result = ISC_R_SUCCESS;
+				}
+				CHECK(result);
 			}
 
 			if (json_object_array_length(za) != 0) {
@@ -3164,6 +3726,30 @@ generatejson(named_server_t *server, size_t *msglen, const char **msg,
 					json_object_object_add(res, "adb",
 							       counters);
 				}
+
+				dns_view_getadb(view, &adb);
+				if (adb != NULL) {
+					counters = json_object_new_object();
+					if (counters == NULL) {
+						dns_adb_detach(&adb);
+						result = ISC_R_NOMEMORY;
+						goto cleanup;
+					}
+
+					dumparg.arg = counters;
+					dumparg.result = ISC_R_SUCCESS;
+					dns_adb_rttdump(adb, rttstat_dump,
+							&dumparg);
+					dns_adb_detach(&adb);
+					if (dumparg.result != ISC_R_SUCCESS) {
+						json_object_put(counters);
+						result = dumparg.result;
+						goto cleanup;
+					}
+
+					json_object_object_add(res, "rtt",
+							       counters);
+				}
 			}
 
 			view = ISC_LIST_NEXT(view, link);
@@ -3192,6 +3778,51 @@ generatejson(named_server_t *server, size_t *msglen, const char **msg,
 		} else {
 			json_object_put(counters);
 		}
+
+		/* per-loop receive counters */
+		counters = json_object_new_object();
+
+		result = dump_loopstats(server->loopstats, isc_statsformat_json,
+					counters, 0);
+		if (result != ISC_R_SUCCESS) {
+			json_object_put(counters);
+			goto cleanup;
+		}
+
+		if (json_object_get_object(counters)->count != 0) {
+			json_object_object_add(bindstats, "loopstats",
+					       counters);
+		} else {
+			json_object_put(counters);
+		}
+
+		/* per-loop utilisation and queues */
+		json_object *loops = json_object_new_array();
+		CHECKMEM(loops);
+		json_object_object_add(bindstats, "loops", loops);
+
+		for (uint32_t i = 0; i < isc_loopmgr_nloops(named_g_loopmgr);
+		     i++)
+		{
+			isc_loopstats_t stats;
+			json_object *loop = json_object_new_object();
+			CHECKMEM(loop);
+
+			isc_loop_getstats(isc_loop_get(named_g_loopmgr, i),
+					  &stats);
+			for (size_t j = 0; j < ARRAY_SIZE(loopusage_fields);
+			     j++)
+			{
+				size_t offset = loopusage_fields[j].offset;
+				uint64_t value = loopusage_value(&stats,
+								 offset);
+
+				json_object_object_add(
+					loop, loopusage_fields[j].name,
+					json_object_new_int64(value));
+			}
+			json_object_array_add(loops, loop);
+		}
 	}
 
 	if ((flags & STATS_JSON_MEM) != 0) {
@@ -3303,7 +3934,6 @@ generatejson(named_server_t *server, size_t *msglen, const char **msg,
 				       tcpreq6);
 		json_object_object_add(
 			traffic, "dns-tcp-responses-sizes-sent-ipv6", tcpresp6);
-		json_object_object_add(bindstats, "traffic", traffic);
 		udpreq4 = NULL;
 		udpresp4 = NULL;
 		tcpreq4 = NULL;
@@ -3312,6 +3942,9 @@ generatejson(named_server_t *server, size_t *msglen, const char **msg,
 		udpresp6 = NULL;
 		tcpreq6 = NULL;
 		tcpresp6 = NULL;
+
+		CHECK(hitters_jsonrender(traffic, server->sctx));
+		json_object_object_add(bindstats, "traffic", traffic);
 		traffic = NULL;
 	}
 
@@ -3361,10 +3994,41 @@ cleanup:
 	return result;
 }
 
+/*%
+ * Get an unsigned integer parameter from the query string of the
+ * request, or 0 if it is missing or not a number.
+ */
+static uint32_t
+httpd_uintparam(const isc_httpd_t *httpd, const char *name) {
+	const char *value = NULL;
+	size_t len = 0;
+	char buf[sizeof("4294967295")];
+	uint32_t n;
+
+	if (isc_httpd_getparam(httpd, name, &value, &len) != ISC_R_SUCCESS ||
+	    len == 0 || len >= sizeof(buf))
+	{
+		return 0;
+	}
+
+	memmove(buf, value, len);
+	buf[len] = '\0';
+	if (isc_parse_uint32(&n, buf, 10) != ISC_R_SUCCESS) {
+		return 0;
+	}
+
+	return n;
+}
+
+/*
+ * The zones can be fetched a page at a time with the "offset" and
+ * "limit" query parameters, so that a server with very many zones
+ * doesn't have to build a document with all of them at once.
+ */
 static isc_result_t
-render_json(uint32_t flags, void *arg, unsigned int *retcode,
-	    const char **retmsg, const char **mimetype, isc_buffer_t *b,
-	    isc_httpdfree_t **freecb, void **freecb_args) {
+render_json(uint32_t flags, const isc_httpd_t *httpd, void *arg,
+	    unsigned int *retcode, const char **retmsg, const char **mimetype,
+	    isc_buffer_t *b, isc_httpdfree_t **freecb, void **freecb_args) {
 	isc_result_t result;
 	json_object *bindstats = NULL;
 	named_server_t *server = arg;
@@ -3372,7 +4036,9 @@ render_json(uint32_t flags, void *arg, unsigned int *retcode,
 	size_t msglen = 0;
 	char *p;
 
-	result = generatejson(server, &msglen, &msg, &bindstats, flags);
+	result = generatejson(server, &msglen, &msg, &bindstats, flags,
+			      httpd_uintparam(httpd, "offset"),
+			      httpd_uintparam(httpd, "limit"));
 	if (result == ISC_R_SUCCESS) {
 		*retcode = 200;
 		*retmsg = "OK";
@@ -3395,10 +4061,9 @@ render_json_all(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
 		void *arg, unsigned int *retcode, const char **retmsg,
 		const char **mimetype, isc_buffer_t *b,
 		isc_httpdfree_t **freecb, void **freecb_args) {
-	UNUSED(httpd);
 	UNUSED(urlinfo);
-	return render_json(STATS_JSON_ALL, arg, retcode, retmsg, mimetype, b,
-			   freecb, freecb_args);
+	return render_json(STATS_JSON_ALL, httpd, arg, retcode, retmsg,
+			   mimetype, b, freecb, freecb_args);
 }
 
 static isc_result_t
@@ -3406,10 +4071,9 @@ render_json_status(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
 		   void *arg, unsigned int *retcode, const char **retmsg,
 		   const char **mimetype, isc_buffer_t *b,
 		   isc_httpdfree_t **freecb, void **freecb_args) {
-	UNUSED(httpd);
 	UNUSED(urlinfo);
-	return render_json(STATS_JSON_STATUS, arg, retcode, retmsg, mimetype, b,
-			   freecb, freecb_args);
+	return render_json(STATS_JSON_STATUS, httpd, arg, retcode, retmsg,
+			   mimetype, b, freecb, freecb_args);
 }
 
 static isc_result_t
@@ -3417,10 +4081,9 @@ render_json_server(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
 		   void *arg, unsigned int *retcode, const char **retmsg,
 		   const char **mimetype, isc_buffer_t *b,
 		   isc_httpdfree_t **freecb, void **freecb_args) {
-	UNUSED(httpd);
 	UNUSED(urlinfo);
-	return render_json(STATS_JSON_SERVER, arg, retcode, retmsg, mimetype, b,
-			   freecb, freecb_args);
+	return render_json(STATS_JSON_SERVER, httpd, arg, retcode, retmsg,
+			   mimetype, b, freecb, freecb_args);
 }
 
 static isc_result_t
@@ -3428,10 +4091,9 @@ render_json_zones(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
 		  void *arg, unsigned int *retcode, const char **retmsg,
 		  const char **mimetype, isc_buffer_t *b,
 		  isc_httpdfree_t **freecb, void **freecb_args) {
-	UNUSED(httpd);
 	UNUSED(urlinfo);
-	return render_json(STATS_JSON_ZONES, arg, retcode, retmsg, mimetype, b,
-			   freecb, freecb_args);
+	return render_json(STATS_JSON_ZONES, httpd, arg, retcode, retmsg,
+			   mimetype, b, freecb, freecb_args);
 }
 
 static isc_result_t
@@ -3439,10 +4101,9 @@ render_json_xfrins(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
 		   void *arg, unsigned int *retcode, const char **retmsg,
 		   const char **mimetype, isc_buffer_t *b,
 		   isc_httpdfree_t **freecb, void **freecb_args) {
-	UNUSED(httpd);
 	UNUSED(urlinfo);
-	return render_json(STATS_JSON_XFRINS, arg, retcode, retmsg, mimetype, b,
-			   freecb, freecb_args);
+	return render_json(STATS_JSON_XFRINS, httpd, arg, retcode, retmsg,
+			   mimetype, b, freecb, freecb_args);
 }
 
 static isc_result_t
@@ -3450,10 +4111,9 @@ render_json_mem(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
 		void *arg, unsigned int *retcode, const char **retmsg,
 		const char **mimetype, isc_buffer_t *b,
 		isc_httpdfree_t **freecb, void **freecb_args) {
-	UNUSED(httpd);
 	UNUSED(urlinfo);
-	return render_json(STATS_JSON_MEM, arg, retcode, retmsg, mimetype, b,
-			   freecb, freecb_args);
+	return render_json(STATS_JSON_MEM, httpd, arg, retcode, retmsg,
+			   mimetype, b, freecb, freecb_args);
 }
 
 static isc_result_t
@@ -3461,10 +4121,9 @@ render_json_net(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
 		void *arg, unsigned int *retcode, const char **retmsg,
 		const char **mimetype, isc_buffer_t *b,
 		isc_httpdfree_t **freecb, void **freecb_args) {
-	UNUSED(httpd);
 	UNUSED(urlinfo);
-	return render_json(STATS_JSON_NET, arg, retcode, retmsg, mimetype, b,
-			   freecb, freecb_args);
+	return render_json(STATS_JSON_NET, httpd, arg, retcode, retmsg,
+			   mimetype, b, freecb, freecb_args);
 }
 
 static isc_result_t
@@ -3472,14 +4131,581 @@ render_json_traffic(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
 		    void *arg, unsigned int *retcode, const char **retmsg,
 		    const char **mimetype, isc_buffer_t *b,
 		    isc_httpdfree_t **freecb, void **freecb_args) {
-	UNUSED(httpd);
 	UNUSED(urlinfo);
-	return render_json(STATS_JSON_TRAFFIC, arg, retcode, retmsg, mimetype,
-			   b, freecb, freecb_args);
+	return render_json(STATS_JSON_TRAFFIC, httpd, arg, retcode, retmsg,
+			   mimetype, b, freecb, freecb_args);
 }
 
 #endif /* HAVE_JSON_C */
 
+#if defined(EXTENDED_STATS)
+/*
+ * Which statistics to include when rendering OpenMetrics text
+ */
+#define STATS_METRICS_SERVER  0x01
+#define STATS_METRICS_ZONES   0x02
+#define STATS_METRICS_NET     0x04
+#define STATS_METRICS_TRAFFIC 0x08
+#define STATS_METRICS_ALL     0xff
+
+#define METRICS_MIMETYPE \
+	"application/openmetrics-text; version=1.0.0; charset=utf-8"
+
+/*%
+ * The OpenMetrics text is printed straight from the counters into a
+ * single dynamic buffer, one metric family after the other, without
+ * building a document first.  'labels' holds the labels shared by the
+ * samples being printed (already escaped and ending in a comma), and
+ * 'desc' the names of the counters of an isc_stats_t set.
+ */
+typedef struct metrics {
+	isc_buffer_t *b;
+	const char *family;
+	const char *labels;
+	const char **desc;
+} metrics_t;
+
+static void
+metrics_escape(isc_buffer_t *b, const char *value) {
+	for (const char *s = value; *s != '\0'; s++) {
+		switch (*s) {
+		case '\\':
+			isc_buffer_putstr(b, "\\\\");
+			break;
+		case '"':
+			isc_buffer_putstr(b, "\\\"");
+			break;
+		case '\n':
+			isc_buffer_putstr(b, "\\n");
+			break;
+		default:
+			isc_buffer_putuint8(b, *s);
+			break;
+		}
+	}
+}
+
+static void
+metrics_family(metrics_t *m, const char *family, const char *type,
+	       const char *help) {
+	m->family = family;
+	(void)isc_buffer_printf(m->b, "# TYPE %s %s\n# HELP %s %s\n", family,
+				type, family, help);
+}
+
+static void
+metrics_counter(metrics_t *m, const char *label, const char *value,
+		uint64_t val) {
+	(void)isc_buffer_printf(m->b, "%s_total{%s%s=\"", m->family,
+				m->labels, label);
+	metrics_escape(m->b, value);
+	(void)isc_buffer_printf(m->b, "\"} %" PRIu64 "\n", val);
+}
+
+static void
+metrics_stats_dump(isc_statscounter_t counter, uint64_t val, void *arg) {
+	metrics_t *m = arg;
+
+	metrics_counter(m, "counter", m->desc[counter], val);
+}
+
+static void
+metrics_stats(metrics_t *m, isc_stats_t *stats, const char **desc) {
+	m->desc = desc;
+	isc_stats_dump(stats, metrics_stats_dump, m, 0);
+}
+
+static void
+metrics_opcode_dump(dns_opcode_t code, uint64_t val, void *arg) {
+	isc_buffer_t b;
+	char codebuf[64];
+
+	isc_buffer_init(&b, codebuf, sizeof(codebuf) - 1);
+	dns_opcode_totext(code, &b);
+	codebuf[isc_buffer_usedlength(&b)] = '\0';
+
+	metrics_counter(arg, "opcode", codebuf, val);
+}
+
+static void
+metrics_rcode_dump(dns_rcode_t code, uint64_t val, void *arg) {
+	isc_buffer_t b;
+	char codebuf[64];
+
+	isc_buffer_init(&b, codebuf, sizeof(codebuf) - 1);
+	dns_rcode_totext(code, &b);
+	codebuf[isc_buffer_usedlength(&b)] = '\0';
+
+	metrics_counter(arg, "rcode", codebuf, val);
+}
+
+static void
+metrics_rdtype_dump(dns_rdatastatstype_t type, uint64_t val, void *arg) {
+	char typebuf[64];
+	const char *typestr = "Others";
+
+	if ((DNS_RDATASTATSTYPE_ATTR(type) &
+	     DNS_RDATASTATSTYPE_ATTR_OTHERTYPE) == 0)
+	{
+		dns_rdatatype_format(DNS_RDATASTATSTYPE_BASE(type), typebuf,
+				     sizeof(typebuf));
+		typestr = typebuf;
+	}
+
+	metrics_counter(arg, "type", typestr, val);
+}
+
+/*
+ * Set the labels shared by the following samples to the view name and,
+ * when 'zone' is not NULL, the zone name.
+ */
+static void
+metrics_setlabels(metrics_t *m, isc_buffer_t *lb, const dns_view_t *view,
+		  dns_zone_t *zone) {
+	char zonebuf[DNS_NAME_FORMATSIZE];
+
+	isc_buffer_clear(lb);
+	isc_buffer_putstr(lb, "view=\"");
+	metrics_escape(lb, view->name);
+	isc_buffer_putstr(lb, "\",");
+	if (zone != NULL) {
+		dns_zone_nameonly(zone, zonebuf, sizeof(zonebuf));
+		isc_buffer_putstr(lb, "zone=\"");
+		metrics_escape(lb, zonebuf);
+		isc_buffer_putstr(lb, "\",");
+	}
+	isc_buffer_putuint8(lb, '\0');
+	m->labels = isc_buffer_base(lb);
+}
+
+typedef struct metrics_zonearg {
+	metrics_t *m;
+	isc_buffer_t *lb;
+	const dns_view_t *view;
+	bool serial;
+} metrics_zonearg_t;
+
+/*
+ * Zones are walked once per family so that the samples of each family
+ * stay together, as OpenMetrics requires.
+ */
+static isc_result_t
+metrics_zone(dns_zone_t *zone, void *arg) {
+	metrics_zonearg_t *za = arg;
+	metrics_t *m = za->m;
+	dns_zonestat_level_t statlevel = dns_zone_getstatlevel(zone);
+	uint32_t serial;
+
+	if (statlevel == dns_zonestat_none) {
+		return ISC_R_SUCCESS;
+	}
+
+	if (za->serial) {
+		if (dns_zone_getserial(zone, &serial) != ISC_R_SUCCESS) {
+			return ISC_R_SUCCESS;
+		}
+		metrics_setlabels(m, za->lb, za->view, zone);
+		(void)isc_buffer_printf(m->b, "%s{%.*s} %" PRIu32 "\n",
+					m->family,
+					(int)strlen(m->labels) - 1, m->labels,
+					serial);
+		return ISC_R_SUCCESS;
+	}
+
+	if (statlevel == dns_zonestat_full) {
+		isc_stats_t *zonestats = dns_zone_getrequeststats(zone);
+		if (zonestats != NULL) {
+			metrics_setlabels(m, za->lb, za->view, zone);
+			metrics_stats(m, zonestats, nsstats_xmldesc);
+		}
+	}
+
+	return ISC_R_SUCCESS;
+}
+
+static void
+metrics_zones(metrics_t *m, isc_buffer_t *lb, named_server_t *server,
+	      bool serial) {
+	dns_view_t *view = NULL;
+
+	ISC_LIST_FOREACH (server->viewlist, view, link) {
+		metrics_zonearg_t za = {
+			.m = m,
+			.lb = lb,
+			.view = view,
+			.serial = serial,
+		};
+		(void)dns_view_apply(view, true, NULL, metrics_zone, &za);
+	}
+}
+
+/*
+ * Print a traffic size histogram.  Each bucket of the histogram counts
+ * DNS_SIZEHISTO_QUANTUM octets and the last one is unbounded, so the
+ * cumulative counts map directly onto OpenMetrics buckets.
+ */
+static void
+metrics_histo(metrics_t *m, isc_histomulti_t *hm, const char *transport,
+	      const char *family, int nbuckets) {
+	isc_histo_t *hg = NULL;
+	uint64_t count, total = 0;
+
+	isc_histomulti_merge(&hg, hm);
+	for (int i = 0; i < nbuckets; i++) {
+		isc_histo_get(hg, i, NULL, NULL, &count);
+		total += count;
+		if (i < nbuckets - 1) {
+			(void)isc_buffer_printf(
+				m->b,
+				"%s_bucket{transport=\"%s\",le=\"%d\"} "
+				"%" PRIu64 "\n",
+				family, transport,
+				(i + 1) * DNS_SIZEHISTO_QUANTUM - 1, total);
+		}
+	}
+	isc_histo_destroy(&hg);
+
+	(void)isc_buffer_printf(m->b,
+				"%s_bucket{transport=\"%s\",le=\"+Inf\"} "
+				"%" PRIu64 "\n"
+				"%s_count{transport=\"%s\"} %" PRIu64 "\n",
+				family, transport, total, family, transport,
+				total);
+}
+
+/*
+ * Print the request latency quantiles of each stage, in seconds.
+ */
+static void
+metrics_latency(metrics_t *m, ns_server_t *sctx) {
+	uint64_t values[ARRAY_SIZE(latency_fractions)];
+
+	metrics_family(m, "bind_request_latency_seconds", "summary",
+		       "Request latency per processing stage");
+	for (size_t i = 0; i < ns_latency_max; i++) {
+		isc_histo_t *hg = NULL;
+		double pop, mean;
+
+		isc_histomulti_merge(&hg, sctx->latency[i]);
+		isc_histo_moments(hg, &pop, &mean, NULL);
+		if (isc_histo_quantiles(hg, ARRAY_SIZE(latency_fractions),
+					latency_fractions,
+					values) == ISC_R_SUCCESS)
+		{
+			for (size_t j = ARRAY_SIZE(values); j-- > 0;) {
+				(void)isc_buffer_printf(
+					m->b,
+					"%s{stage=\"%s\",quantile=\"%s\"} "
+					"%.6f\n",
+					m->family, latency_desc[i],
+					latency_quantiles[j],
+					(double)values[j] / US_PER_SEC);
+			}
+		}
+		isc_histo_destroy(&hg);
+
+		(void)isc_buffer_printf(m->b,
+					"%s_count{stage=\"%s\"} %.0f\n"
+					"%s_sum{stage=\"%s\"} %.6f\n",
+					m->family, latency_desc[i], pop,
+					m->family, latency_desc[i],
+					pop * mean / US_PER_SEC);
+	}
+}
+
+/*
+ * Print the statistics of each loop: the times as counters in seconds,
+ * and the queue lengths as gauges.
+ */
+static void
+metrics_loopusage(metrics_t *m) {
+	uint32_t nloops = isc_loopmgr_nloops(named_g_loopmgr);
+	isc_loopstats_t *stats = isc_mem_cget(named_g_mctx, nloops,
+					      sizeof(stats[0]));
+	static const struct {
+		const char *family;
+		const char *type;
+		const char *help;
+		size_t offset;
+		bool seconds;
+	} families[] = {
+		{ "bind_loop_busy_seconds", "counter",
+		  "Time each loop spent running callbacks",
+		  offsetof(isc_loopstats_t, busy), true },
+		{ "bind_loop_idle_seconds", "counter",
+		  "Time each loop spent waiting for events",
+		  offsetof(isc_loopstats_t, idle), true },
+		{ "bind_loop_jobs_queued", "gauge",
+		  "Jobs waiting to run on each loop",
+		  offsetof(isc_loopstats_t, jobsqueued), false },
+		{ "bind_loop_async", "counter",
+		  "Asynchronous callbacks run on each loop",
+		  offsetof(isc_loopstats_t, asyncs), false },
+		{ "bind_loop_async_queued", "gauge",
+		  "Asynchronous callbacks waiting to run on each loop",
+		  offsetof(isc_loopstats_t, asyncsqueued), false },
+		{ "bind_loop_async_wait_seconds", "counter",
+		  "Time the asynchronous callbacks waited to run",
+		  offsetof(isc_loopstats_t, asyncwait), true },
+		{ "bind_loop_async_wakeups", "counter",
+		  "Times each loop was woken up to run asynchronous callbacks",
+		  offsetof(isc_loopstats_t, asyncwakeups), false },
+		{ "bind_loop_work", "counter",
+		  "Work offloaded from each loop to the worker threads",
+		  offsetof(isc_loopstats_t, works), false },
+		{ "bind_loop_work_queued", "gauge",
+		  "Work waiting for a worker thread",
+		  offsetof(isc_loopstats_t, worksqueued), false },
+		{ "bind_loop_work_wait_seconds", "counter",
+		  "Time the work waited for a worker thread",
+		  offsetof(isc_loopstats_t, workwait), true },
+	};
+
+	for (uint32_t i = 0; i < nloops; i++) {
+		isc_loop_getstats(isc_loop_get(named_g_loopmgr, i), &stats[i]);
+	}
+
+	for (size_t f = 0; f < ARRAY_SIZE(families); f++) {
+		bool counter = strcmp(families[f].type, "counter") == 0;
+
+		metrics_family(m, families[f].family, families[f].type,
+			       families[f].help);
+		for (uint32_t i = 0; i < nloops; i++) {
+			uint64_t value = loopusage_value(&stats[i],
+							 families[f].offset);
+
+			(void)isc_buffer_printf(m->b, "%s%s{loop=\"%u\"} ",
+						m->family,
+						counter ? "_total" : "", i);
+			if (families[f].seconds) {
+				(void)isc_buffer_printf(
+					m->b, "%.6f\n",
+					(double)value / NS_PER_SEC);
+			} else {
+				(void)isc_buffer_printf(m->b, "%" PRIu64 "\n",
+							value);
+			}
+		}
+	}
+
+	isc_mem_cput(named_g_mctx, stats, nloops, sizeof(stats[0]));
+}
+
+static void
+generatemetrics(named_server_t *server, isc_buffer_t *b, uint32_t flags) {
+	isc_buffer_t *lb = NULL;
+	dns_view_t *view = NULL;
+	metrics_t m = { .b = b, .labels = "" };
+
+	isc_buffer_allocate(named_g_mctx, &lb, 256);
+
+	if ((flags & STATS_METRICS_SERVER) != 0) {
+		metrics_family(&m, "bind_server", "counter",
+			       "Name server statistics");
+		metrics_stats(&m, ns_stats_get(server->sctx->nsstats),
+			      nsstats_xmldesc);
+
+		metrics_family(&m, "bind_opcode", "counter",
+			       "Incoming requests by opcode");
+		dns_opcodestats_dump(server->sctx->opcodestats,
+				     metrics_opcode_dump, &m, 0);
+
+		metrics_family(&m, "bind_rcode", "counter",
+			       "Outgoing responses by rcode");
+		dns_rcodestats_dump(server->sctx->rcodestats,
+				    metrics_rcode_dump, &m, 0);
+
+		metrics_family(&m, "bind_qtype", "counter",
+			       "Incoming queries by type");
+		dns_rdatatypestats_dump(server->sctx->rcvquerystats,
+					metrics_rdtype_dump, &m, 0);
+
+		metrics_family(&m, "bind_zone_maintenance", "counter",
+			       "Zone maintenance statistics");
+		metrics_stats(&m, server->zonestats, zonestats_xmldesc);
+
+		metrics_family(&m, "bind_resolver", "counter",
+			       "Resolver statistics per view");
+		ISC_LIST_FOREACH (server->viewlist, view, link) {
+			isc_stats_t *istats = NULL;
+
+			dns_resolver_getstats(view->resolver, &istats);
+			if (istats != NULL) {
+				metrics_setlabels(&m, lb, view, NULL);
+				metrics_stats(&m, istats, resstats_xmldesc);
+				isc_stats_detach(&istats);
+			}
+		}
+
+		metrics_family(&m, "bind_resolver_qtype", "counter",
+			       "Outgoing queries by type per view");
+		ISC_LIST_FOREACH (server->viewlist, view, link) {
+			dns_stats_t *dstats = NULL;
+
+			dns_resolver_getquerystats(view->resolver, &dstats);
+			if (dstats != NULL) {
+				metrics_setlabels(&m, lb, view, NULL);
+				dns_rdatatypestats_dump(
+					dstats, metrics_rdtype_dump, &m, 0);
+				dns_stats_detach(&dstats);
+			}
+		}
+		m.labels = "";
+
+		metrics_latency(&m, server->sctx);
+	}
+
+	if ((flags & STATS_METRICS_ZONES) != 0) {
+		metrics_family(&m, "bind_zone_serial", "gauge",
+			       "SOA serial of each zone");
+		metrics_zones(&m, lb, server, true);
+
+		metrics_family(&m, "bind_zone_requests", "counter",
+			       "Name server statistics per zone");
+		metrics_zones(&m, lb, server, false);
+		m.labels = "";
+	}
+
+	if ((flags & STATS_METRICS_NET) != 0) {
+		metrics_family(&m, "bind_socket", "counter",
+			       "Socket I/O statistics");
+		metrics_stats(&m, server->sockstats, sockstats_xmldesc);
+
+		metrics_loopusage(&m);
+	}
+
+	if ((flags & STATS_METRICS_TRAFFIC) != 0) {
+		static const struct {
+			const char *family;
+			const char *help;
+			bool out;
+		} histos[] = {
+			{ "bind_request_size_bytes", "Request sizes received",
+			  false },
+			{ "bind_response_size_bytes", "Response sizes sent",
+			  true },
+		};
+		ns_server_t *sctx = server->sctx;
+
+		for (size_t i = 0; i < ARRAY_SIZE(histos); i++) {
+			const char *family = histos[i].family;
+			int nbuckets = histos[i].out ? dns_sizecounter_out_max
+						     : dns_sizecounter_in_max;
+
+			metrics_family(&m, family, "histogram",
+				       histos[i].help);
+			metrics_histo(&m,
+				      histos[i].out ? sctx->udpoutstats4
+						    : sctx->udpinstats4,
+				      "udp4", family, nbuckets);
+			metrics_histo(&m,
+				      histos[i].out ? sctx->tcpoutstats4
+						    : sctx->tcpinstats4,
+				      "tcp4", family, nbuckets);
+			metrics_histo(&m,
+				      histos[i].out ? sctx->udpoutstats6
+						    : sctx->udpinstats6,
+				      "udp6", family, nbuckets);
+			metrics_histo(&m,
+				      histos[i].out ? sctx->tcpoutstats6
+						    : sctx->tcpinstats6,
+				      "tcp6", family, nbuckets);
+		}
+	}
+
+	isc_buffer_putstr(b, "# EOF\n");
+
+	isc_buffer_free(&lb);
+}
+
+static void
+wrap_metricsfree(isc_buffer_t *buffer, void *arg) {
+	isc_buffer_t *b = arg;
+
+	UNUSED(buffer);
+
+	isc_buffer_free(&b);
+}
+
+static isc_result_t
+render_metrics(uint32_t flags, void *arg, unsigned int *retcode,
+	       const char **retmsg, const char **mimetype, isc_buffer_t *b,
+	       isc_httpdfree_t **freecb, void **freecb_args) {
+	named_server_t *server = arg;
+	isc_buffer_t *text = NULL;
+
+	isc_buffer_allocate(named_g_mctx, &text, 65536);
+	generatemetrics(server, text, flags);
+
+	*retcode = 200;
+	*retmsg = "OK";
+	*mimetype = METRICS_MIMETYPE;
+	isc_buffer_reinit(b, isc_buffer_base(text),
+			  isc_buffer_usedlength(text));
+	isc_buffer_add(b, isc_buffer_usedlength(text));
+	*freecb = wrap_metricsfree;
+	*freecb_args = text;
+
+	return ISC_R_SUCCESS;
+}
+
+static isc_result_t
+render_metrics_all(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
+		   void *arg, unsigned int *retcode, const char **retmsg,
+		   const char **mimetype, isc_buffer_t *b,
+		   isc_httpdfree_t **freecb, void **freecb_args) {
+	UNUSED(httpd);
+	UNUSED(urlinfo);
+	return render_metrics(STATS_METRICS_ALL, arg, retcode, retmsg,
+			      mimetype, b, freecb, freecb_args);
+}
+
+static isc_result_t
+render_metrics_server(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
+		      void *arg, unsigned int *retcode, const char **retmsg,
+		      const char **mimetype, isc_buffer_t *b,
+		      isc_httpdfree_t **freecb, void **freecb_args) {
+	UNUSED(httpd);
+	UNUSED(urlinfo);
+	return render_metrics(STATS_METRICS_SERVER, arg, retcode, retmsg,
+			      mimetype, b, freecb, freecb_args);
+}
+
+static isc_result_t
+render_metrics_zones(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
+		     void *arg, unsigned int *retcode, const char **retmsg,
+		     const char **mimetype, isc_buffer_t *b,
+		     isc_httpdfree_t **freecb, void **freecb_args) {
+	UNUSED(httpd);
+	UNUSED(urlinfo);
+	return render_metrics(STATS_METRICS_ZONES, arg, retcode, retmsg,
+			      mimetype, b, freecb, freecb_args);
+}
+
+static isc_result_t
+render_metrics_net(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
+		   void *arg, unsigned int *retcode, const char **retmsg,
+		   const char **mimetype, isc_buffer_t *b,
+		   isc_httpdfree_t **freecb, void **freecb_args) {
+	UNUSED(httpd);
+	UNUSED(urlinfo);
+	return render_metrics(STATS_METRICS_NET, arg, retcode, retmsg,
+			      mimetype, b, freecb, freecb_args);
+}
+
+static isc_result_t
+render_metrics_traffic(const isc_httpd_t *httpd,
+		       const isc_httpdurl_t *urlinfo, void *arg,
+		       unsigned int *retcode, const char **retmsg,
+		       const char **mimetype, isc_buffer_t *b,
+		       isc_httpdfree_t **freecb, void **freecb_args) {
+	UNUSED(httpd);
+	UNUSED(urlinfo);
+	return render_metrics(STATS_METRICS_TRAFFIC, arg, retcode, retmsg,
+			      mimetype, b, freecb, freecb_args);
+}
+#endif /* defined(EXTENDED_STATS) */
+
 #if HAVE_LIBXML2
 /*
  * This is only needed if we have libxml2 and was confusingly returned if
@@ -3713,6 +4939,18 @@ add_listener(named_server_t *server, named_statschannel_t **listenerp,
 			    "/json/v" STATS_JSON_VERSION_MAJOR "/traffic",
 			    false, render_json_traffic, server);
 #endif /* ifdef HAVE_JSON_C */
+#if defined(EXTENDED_STATS)
+	isc_httpdmgr_addurl(listener->httpdmgr, "/metrics", false,
+			    render_metrics_all, server);
+	isc_httpdmgr_addurl(listener->httpdmgr, "/metrics/server", false,
+			    render_metrics_server, server);
+	isc_httpdmgr_addurl(listener->httpdmgr, "/metrics/zones", false,
+			    render_metrics_zones, server);
+	isc_httpdmgr_addurl(listener->httpdmgr, "/metrics/net", false,
+			    render_metrics_net, server);
+	isc_httpdmgr_addurl(listener->httpdmgr, "/metrics/traffic", false,
+			    render_metrics_traffic, server);
+#endif /* if defined(EXTENDED_STATS) */
 
 	*listenerp = listener;
 	isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
@@ -4020,6 +5258,25 @@ named_stats_dump(named_server_t *server, FILE *fp) {
 		isc_stats_detach(&istats);
 	}
 
+	fprintf(fp, "++ Upstream Server RTT Statistics ++\n");
+	for (view = ISC_LIST_HEAD(server->viewlist); view != NULL;
+	     view = ISC_LIST_NEXT(view, link))
+	{
+		dns_adb_t *adb = NULL;
+
+		dns_view_getadb(view, &adb);
+		if (adb == NULL) {
+			continue;
+		}
+		if (strcmp(view->name, "_default") == 0) {
+			fprintf(fp, "[View: default]\n");
+		} else {
+			fprintf(fp, "[View: %s]\n", view->name);
+		}
+		dns_adb_rttdump(adb, rttstat_dump, &dumparg);
+		dns_adb_detach(&adb);
+	}
+
 	fprintf(fp, "++ Cache Statistics ++\n");
 	for (view = ISC_LIST_HEAD(server->viewlist); view != NULL;
 	     view = ISC_LIST_NEXT(view, link))
@@ -4096,6 +5353,21 @@ named_stats_dump(named_server_t *server, FILE *fp) {
 			 sockstats_desc, isc_sockstatscounter_max,
 			 sockstats_index, sockstat_values, 0);
 
+	fprintf(fp, "++ Per-Thread Statistics ++\n");
+	(void)dump_loopstats(server->loopstats, isc_statsformat_file, fp, 0);
+
+	fprintf(fp, "++ UDP Datagrams per Read ++\n");
+	dump_recvbatch(fp);
+
+	fprintf(fp, "++ Loop Utilisation ++\n");
+	dump_loopusage(fp);
+
+	fprintf(fp, "++ Lock Contention ++\n");
+	dump_lockstats(fp);
+
+	fprintf(fp, "++ Heavy Hitters ++\n");
+	dump_hitters(fp, server->sctx);
+
 	fprintf(fp, "++ Per Zone Query Statistics ++\n");
 	zone = NULL;
 	for (result = dns_zone_first(server->zonemgr, &zone);
@@ -1096,6 +1096,17 @@ named_zone_configure(const cfg_obj_t *config, const cfg_obj_t *vconfig,
 		dns_zone_setmaxrrperset(zone, 0);
 	}
 
+	obj = NULL;
+	result = named_config_get(maps, "zone-update-quota", &obj);
+	INSIST(result == ISC_R_SUCCESS && obj != NULL);
+	dns_zone_setupdatequota(mayberaw, cfg_obj_asuint32(obj));
+
+	obj = NULL;
+	result = named_config_get(maps, "update-batch-window", &obj);
+	INSIST(result == ISC_R_SUCCESS && obj != NULL);
+	dns_zone_setupdatebatchwindow(mayberaw,
+				      ISC_MIN(cfg_obj_asuint32(obj), 1000));
+
 	obj = NULL;
 	result = named_config_get(maps, "max-types-per-name", &obj);
 	INSIST(result == ISC_R_SUCCESS && obj != NULL);
@@ -1390,6 +1401,16 @@ named_zone_configure(const cfg_obj_t *config, const cfg_obj_t *vconfig,
 					   ixfrdiff);
 		}
 
+		obj = NULL;
+		result = named_config_get(maps, "share-identical-rrsets", &obj);
+		INSIST(result == ISC_R_SUCCESS && obj != NULL);
+		if (raw != NULL) {
+			dns_zone_setoption(raw, DNS_ZONEOPT_SHARERRSETS,
+					   cfg_obj_asboolean(obj));
+		}
+		dns_zone_setoption(zone, DNS_ZONEOPT_SHARERRSETS,
+				   cfg_obj_asboolean(obj));
+
 		obj = NULL;
 		result = named_config_get(maps, "max-ixfr-ratio", &obj);
 		INSIST(result == ISC_R_SUCCESS && obj != NULL);
@@ -1720,6 +1741,26 @@ named_zone_configure(const cfg_obj_t *config, const cfg_obj_t *vconfig,
 	 * Configure primary zone functionality.
 	 */
 	if (ztype == dns_zone_primary) {
+		obj = NULL;
+		result = cfg_map_get(zoptions, "load-on-demand", &obj);
+		dns_zone_setoption(zone, DNS_ZONEOPT_LOADONDEMAND,
+				   result == ISC_R_SUCCESS &&
+					   cfg_obj_asboolean(obj));
+
+		obj = NULL;
+		result = cfg_map_get(zoptions, "load-on-demand-idle-time",
+				     &obj);
+		dns_zone_setdemandidletime(zone,
+					   result == ISC_R_SUCCESS
+						   ? cfg_obj_asduration(obj)
+						   : DNS_ZONE_DEFAULTDEMANDIDLE);
+
+		obj = NULL;
+		result = named_config_get(maps, "journal-group-commit", &obj);
+		INSIST(result == ISC_R_SUCCESS && obj != NULL);
+		dns_zone_setoption(zone, DNS_ZONEOPT_JOURNALGROUPCOMMIT,
+				   cfg_obj_asboolean(obj));
+
 		obj = NULL;
 		result = named_config_get(maps, "check-wildcard", &obj);
 		if (result == ISC_R_SUCCESS) {
@@ -1881,6 +1922,13 @@ named_zone_configure(const cfg_obj_t *config, const cfg_obj_t *vconfig,
 		}
 		dns_zone_setoption(mayberaw, DNS_ZONEOPT_MULTIMASTER, multi);
 
+		obj = NULL;
+		result = cfg_map_get(zoptions, "journal-dump-ratio", &obj);
+		dns_zone_setdumpratio(mayberaw,
+				      result == ISC_R_SUCCESS
+					      ? cfg_obj_aspercentage(obj)
+					      : 0);
+
 		obj = NULL;
 		result = named_config_get(maps, "max-transfer-time-in", &obj);
 		INSIST(result == ISC_R_SUCCESS && obj != NULL);
@@ -106,6 +106,9 @@
 /* Number of addresses to request from isc_getaddresses() */
 #define MAX_SERVERADDRS 4
 
+/* How long an idle TCP connection is kept open for the next request (ms) */
+#define TCP_IDLE_TIMEOUT 10000
+
 static uint16_t dnsport = DNSDEFAULTPORT;
 
 #ifndef RESOLV_CONF
@@ -922,6 +925,13 @@ setup_system(void *arg ISC_ATTR_UNUSED) {
 
 	set_source_ports(dispatchmgr);
 
+	/*
+	 * Keep the TCP connection to the server open between the requests,
+	 * so that a batch of updates sent over TCP or TLS doesn't set up a
+	 * new connection for each update and the SOA query before it.
+	 */
+	dns_dispatchmgr_settcppool(dispatchmgr, TCP_IDLE_TIMEOUT, 0, 0);
+
 	if (have_ipv6) {
 		isc_sockaddr_any6(&bind_any6);
 		result = dns_dispatch_createudp(dispatchmgr, &bind_any6,
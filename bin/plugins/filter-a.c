@@ -111,8 +111,6 @@ filter_respond_begin(void *arg, void *cbdata, isc_result_t *resp);
 static ns_hookresult_t
 filter_respond_any_found(void *arg, void *cbdata, isc_result_t *resp);
 static ns_hookresult_t
-filter_prep_response_begin(void *arg, void *cbdata, isc_result_t *resp);
-static ns_hookresult_t
 filter_query_done_send(void *arg, void *cbdata, isc_result_t *resp);
 static ns_hookresult_t
 filter_qctx_destroy(void *arg, void *cbdata, isc_result_t *resp);
@@ -131,18 +129,24 @@ install_hooks(ns_hooktable_t *hooktable, isc_mem_t *mctx,
 		.action_data = inst,
 	};
 
-	const ns_hook_t filter_respbegin = {
+	/*
+	 * Responses are only filtered for A queries, and for the AAAA
+	 * queries made to find out whether to filter them.
+	 */
+	const ns_hook_t filter_respbegin_a = {
 		.action = filter_respond_begin,
 		.action_data = inst,
+		.qtype = dns_rdatatype_a,
 	};
 
-	const ns_hook_t filter_respanyfound = {
-		.action = filter_respond_any_found,
+	const ns_hook_t filter_respbegin_aaaa = {
+		.action = filter_respond_begin,
 		.action_data = inst,
+		.qtype = dns_rdatatype_aaaa,
 	};
 
-	const ns_hook_t filter_prepresp = {
-		.action = filter_prep_response_begin,
+	const ns_hook_t filter_respanyfound = {
+		.action = filter_respond_any_found,
 		.action_data = inst,
 	};
 
@@ -157,11 +161,12 @@ install_hooks(ns_hooktable_t *hooktable, isc_mem_t *mctx,
 	};
 
 	ns_hook_add(hooktable, mctx, NS_QUERY_QCTX_INITIALIZED, &filter_init);
-	ns_hook_add(hooktable, mctx, NS_QUERY_RESPOND_BEGIN, &filter_respbegin);
+	ns_hook_add(hooktable, mctx, NS_QUERY_RESPOND_BEGIN,
+		    &filter_respbegin_a);
+	ns_hook_add(hooktable, mctx, NS_QUERY_RESPOND_BEGIN,
+		    &filter_respbegin_aaaa);
 	ns_hook_add(hooktable, mctx, NS_QUERY_RESPOND_ANY_FOUND,
 		    &filter_respanyfound);
-	ns_hook_add(hooktable, mctx, NS_QUERY_PREP_RESPONSE_BEGIN,
-		    &filter_prepresp);
 	ns_hook_add(hooktable, mctx, NS_QUERY_DONE_SEND, &filter_donesend);
 	ns_hook_add(hooktable, mctx, NS_QUERY_QCTX_DESTROYED, &filter_destroy);
 }
@@ -477,13 +482,14 @@ client_state_get(const query_ctx_t *qctx, filter_instance_t *inst) {
 }
 
 static void
-client_state_create(const query_ctx_t *qctx, filter_instance_t *inst) {
+client_state_create(const query_ctx_t *qctx, filter_instance_t *inst,
+		    filter_a_t mode) {
 	filter_data_t *client_state;
 	isc_result_t result;
 
 	client_state = isc_mem_get(inst->mctx, sizeof(*client_state));
 
-	client_state->mode = NONE;
+	client_state->mode = mode;
 	client_state->flags = 0;
 
 	LOCK(&inst->hlock);
@@ -621,58 +627,46 @@ process_section(const section_filter_t *filter) {
 	}
 }
 
-/*
- * Initialize filter state, fetching it from a memory pool and storing it
- * in a hash table keyed according to the client object; this enables us to
- * retrieve persistent data related to a client query for as long as the
- * object persists.
- */
-static ns_hookresult_t
-filter_qctx_initialize(void *arg, void *cbdata, isc_result_t *resp) {
-	query_ctx_t *qctx = (query_ctx_t *)arg;
-	filter_instance_t *inst = (filter_instance_t *)cbdata;
-	filter_data_t *client_state;
-
-	*resp = ISC_R_UNSET;
-
-	client_state = client_state_get(qctx, inst);
-	if (client_state == NULL) {
-		client_state_create(qctx, inst);
-	}
-
-	return NS_HOOK_CONTINUE;
-}
-
 /*
  * Determine whether this client should have A filtered or not, based on
  * the client address family and the settings of filter-a-on-v6 and
- * filter-a-on-v4.
+ * filter-a-on-v4.  If it should, initialize filter state, fetching it
+ * from a memory pool and storing it in a hash table keyed according to the
+ * client object; this enables us to retrieve persistent data related to a
+ * client query for as long as the object persists.  The clients that don't
+ * have A filtered have no state, and are skipped by the other hooks.
  */
 static ns_hookresult_t
-filter_prep_response_begin(void *arg, void *cbdata, isc_result_t *resp) {
+filter_qctx_initialize(void *arg, void *cbdata, isc_result_t *resp) {
 	query_ctx_t *qctx = (query_ctx_t *)arg;
 	filter_instance_t *inst = (filter_instance_t *)cbdata;
-	filter_data_t *client_state = client_state_get(qctx, inst);
+	filter_a_t mode = NONE;
 	isc_result_t result;
 
 	*resp = ISC_R_UNSET;
 
-	if (client_state == NULL) {
+	if (inst->v4_a == NONE && inst->v6_a == NONE) {
 		return NS_HOOK_CONTINUE;
 	}
 
-	if (inst->v4_a != NONE || inst->v6_a != NONE) {
-		result = ns_client_checkaclsilent(qctx->client, NULL,
-						  inst->a_acl, true);
-		if (result == ISC_R_SUCCESS && inst->v4_a != NONE &&
-		    is_v4_client(qctx->client))
-		{
-			client_state->mode = inst->v4_a;
-		} else if (result == ISC_R_SUCCESS && inst->v6_a != NONE &&
-			   is_v6_client(qctx->client))
-		{
-			client_state->mode = inst->v6_a;
-		}
+	if (client_state_get(qctx, inst) != NULL) {
+		return NS_HOOK_CONTINUE;
+	}
+
+	result = ns_client_checkaclsilent(qctx->client, NULL, inst->a_acl,
+					  true);
+	if (result == ISC_R_SUCCESS && inst->v4_a != NONE &&
+	    is_v4_client(qctx->client))
+	{
+		mode = inst->v4_a;
+	} else if (result == ISC_R_SUCCESS && inst->v6_a != NONE &&
+		   is_v6_client(qctx->client))
+	{
+		mode = inst->v6_a;
+	}
+
+	if (mode != NONE) {
+		client_state_create(qctx, inst, mode);
 	}
 
 	return NS_HOOK_CONTINUE;
@@ -13,6 +13,8 @@
 
 /*! \file */
 
+#include <ctype.h>
+#include <errno.h>
 #include <inttypes.h>
 #include <stdbool.h>
 #include <stdlib.h>
@@ -52,6 +54,7 @@
 
 #define SERVERADDRS  10
 #define RNDC_TIMEOUT 60 * 1000
+#define RNDC_MAXLINE 32768
 
 const char *progname = NULL;
 bool verbose;
@@ -78,6 +81,10 @@ static bool c_flag = false;
 static isc_mem_t *rndc_mctx = NULL;
 static char *command = NULL;
 static char *args = NULL;
+static size_t argslen = 0;
+static FILE *batchfp = NULL;
+static char batchline[RNDC_MAXLINE];
+static uint32_t ccnonce = 0;
 static char program[256];
 static uint32_t serial;
 static bool quiet = false;
@@ -86,6 +93,8 @@ static int32_t timeout = RNDC_TIMEOUT;
 
 static void
 rndc_startconnect(isc_sockaddr_t *addr);
+static void
+rndc_recvdone(isc_nmhandle_t *handle, isc_result_t result, void *arg);
 
 ISC_NORETURN static void
 usage(int status);
@@ -95,6 +104,10 @@ usage(int status) {
 	fprintf(stderr, "\
 Usage: %s [-b address] [-c config] [-s server] [-p port]\n\
 	[-k key-file ] [-y key] [-r] [-V] [-4 | -6] command\n\
+       %s [options] -f file\n\
+\n\
+With -f, the commands are read from file (or standard input if file\n\
+is \"-\"), one per line, and sent over a single connection.\n\
 \n\
 command is one of the following:\n\
 \n\
@@ -132,11 +145,19 @@ command is one of the following:\n\
   halt		Stop the server without saving pending updates.\n\
   halt -p	Stop the server without saving pending updates reporting\n\
 		process id.\n\
+  handoff path	Hand the listening sockets over to a server started\n\
+		with \"named -H path\", and stop once it is running.\n\
+  hitters [count | reset]\n\
+		Report the most frequent query names, types and clients,\n\
+		or reset their counts.\n\
   skr -import file zone [class [view]]\n\
 		Import a SKR file for the specified zone, for offline KSK\n\
 		signing.\n\
   loadkeys zone [class [view]]\n\
 		Update keys without signing immediately.\n\
+  lockstats [on|off|reset]\n\
+		Enable, disable or reset the lock contention statistics,\n\
+		and report the most contended locks.\n\
   managed-keys refresh [class [view]]\n\
 		Check trust anchor for RFC 5011 key changes\n\
   managed-keys status [class [view]]\n\
@@ -172,6 +193,9 @@ command is one of the following:\n\
 		Reload a single zone.\n\
   retransfer zone [class [view]]\n\
 		Retransfer a single zone without checking serial number.\n\
+  savecache [view]\n\
+		Save the cache snapshots, or the snapshot of the cache\n\
+		of the view.\n\
   scan		Scan available network interfaces for changes.\n\
   secroots [view ...]\n\
 		Write security roots to the secroots file.\n\
@@ -221,12 +245,12 @@ command is one of the following:\n\
 		Display the current status of a zone.\n\
 \n\
 Version: %s\n",
-		progname, version);
+		progname, progname, version);
 
 	exit(status);
 }
 
-#define CMDLINE_FLAGS "46b:c:hk:Mmp:qrs:t:Vy:"
+#define CMDLINE_FLAGS "46b:c:f:hk:Mmp:qrs:t:Vy:"
 
 static void
 preparse_args(int argc, char **argv) {
@@ -283,6 +307,99 @@ rndc_senddone(isc_nmhandle_t *handle ISC_ATTR_UNUSED, isc_result_t result,
 	}
 }
 
+/*
+ * Read the next command from the batch file into 'args'.  Returns false
+ * when there are no more commands to send.
+ */
+static bool
+nextcommand(void) {
+	if (batchfp == NULL) {
+		return false;
+	}
+
+	while (fgets(batchline, sizeof(batchline), batchfp) != NULL) {
+		char *line = batchline;
+		size_t len = strlen(line);
+
+		if (len > 0 && line[len - 1] == '\n') {
+			line[--len] = '\0';
+		} else if (!feof(batchfp)) {
+			fatal("command too long");
+		}
+		while (len > 0 && isspace((unsigned char)line[len - 1])) {
+			line[--len] = '\0';
+		}
+		while (isspace((unsigned char)*line)) {
+			line++;
+		}
+		if (*line == '\0' || *line == '#') {
+			continue;
+		}
+
+		command = args = line;
+		notify("%s", command);
+		return true;
+	}
+
+	if (ferror(batchfp)) {
+		fatal("reading commands failed: %s", strerror(errno));
+	}
+
+	return false;
+}
+
+/*
+ * Send the command in 'args'; the response is handled by rndc_recvdone(),
+ * which sends the next command in the batch on the same connection.
+ */
+static void
+rndc_sendcommand(isccc_ccmsg_t *ccmsg) {
+	isccc_sexpr_t *request = NULL;
+	isccc_sexpr_t *data = NULL;
+	isccc_sexpr_t *_ctrl = NULL;
+	isccc_time_t now = isc_stdtime_now();
+	isc_region_t r;
+	isc_buffer_t b;
+	isc_result_t result;
+
+	DO("create message", isccc_cc_createmessage(1, NULL, NULL, ++serial,
+						    now, now + 60, &request));
+	data = isccc_alist_lookup(request, "_data");
+	if (data == NULL) {
+		fatal("_data section missing");
+	}
+	if (isccc_cc_definestring(data, "type", args) == NULL) {
+		fatal("out of memory");
+	}
+	if (ccnonce != 0) {
+		_ctrl = isccc_alist_lookup(request, "_ctrl");
+		if (_ctrl == NULL) {
+			fatal("_ctrl section missing");
+		}
+		if (isccc_cc_defineuint32(_ctrl, "_nonce", ccnonce) == NULL) {
+			fatal("out of memory");
+		}
+	}
+
+	isc_buffer_clear(databuf);
+	/* Skip the length field (4 bytes) */
+	isc_buffer_add(databuf, 4);
+
+	DO("render message",
+	   isccc_cc_towire(request, &databuf, algorithm, &secret));
+
+	isc_buffer_init(&b, databuf->base, 4);
+	isc_buffer_putuint32(&b, databuf->used - 4);
+
+	r.base = databuf->base;
+	r.length = databuf->used;
+
+	isccc_ccmsg_readmessage(ccmsg, rndc_recvdone, ccmsg);
+	isccc_ccmsg_sendmessage(ccmsg, &r, rndc_senddone, NULL);
+
+	isccc_sexpr_free(&request);
+}
+
 static void
 rndc_recvdone(isc_nmhandle_t *handle, isc_result_t result, void *arg) {
 	isccc_ccmsg_t *ccmsg = (isccc_ccmsg_t *)arg;
@@ -291,6 +408,7 @@ rndc_recvdone(isc_nmhandle_t *handle, isc_result_t result, void *arg) {
 	isccc_region_t source;
 	char *errormsg = NULL;
 	char *textmsg = NULL;
+	bool cmdfailed = false;
 
 	REQUIRE(handle != NULL);
 	REQUIRE(ccmsg != NULL);
@@ -319,7 +437,7 @@ rndc_recvdone(isc_nmhandle_t *handle, isc_result_t result, void *arg) {
 	}
 	result = isccc_cc_lookupstring(data, "err", &errormsg);
 	if (result == ISC_R_SUCCESS) {
-		failed = true;
+		failed = cmdfailed = true;
 		fprintf(stderr, "%s: '%s' failed: %s\n", progname, command,
 			errormsg);
 	} else if (result != ISC_R_NOTFOUND) {
@@ -329,8 +447,8 @@ rndc_recvdone(isc_nmhandle_t *handle, isc_result_t result, void *arg) {
 
 	result = isccc_cc_lookupstring(data, "text", &textmsg);
 	if (result == ISC_R_SUCCESS) {
-		if ((!quiet || failed) && strlen(textmsg) != 0U) {
-			fprintf(failed ? stderr : stdout, "%s\n", textmsg);
+		if ((!quiet || cmdfailed) && strlen(textmsg) != 0U) {
+			fprintf(cmdfailed ? stderr : stdout, "%s\n", textmsg);
 		}
 	} else if (result != ISC_R_NOTFOUND) {
 		fprintf(stderr, "%s: parsing response failed: %s\n", progname,
@@ -350,6 +468,11 @@ rndc_recvdone(isc_nmhandle_t *handle, isc_result_t result, void *arg) {
 
 	isccc_sexpr_free(&response);
 
+	if (nextcommand()) {
+		rndc_sendcommand(ccmsg);
+		return;
+	}
+
 	isccc_ccmsg_disconnect(ccmsg);
 	isc_loopmgr_shutdown(loopmgr);
 }
@@ -361,12 +484,6 @@ rndc_recvnonce(isc_nmhandle_t *handle ISC_ATTR_UNUSED, isc_result_t result,
 	isccc_sexpr_t *response = NULL;
 	isccc_sexpr_t *_ctrl = NULL;
 	isccc_region_t source;
-	uint32_t nonce;
-	isccc_sexpr_t *request = NULL;
-	isccc_time_t now = isc_stdtime_now();
-	isc_region_t r;
-	isccc_sexpr_t *data = NULL;
-	isc_buffer_t b;
 
 	REQUIRE(ccmsg != NULL);
 
@@ -392,49 +509,22 @@ rndc_recvnonce(isc_nmhandle_t *handle ISC_ATTR_UNUSED, isc_result_t result,
 	if (!isccc_alist_alistp(_ctrl)) {
 		fatal("bad or missing ctrl section in response");
 	}
-	nonce = 0;
-	if (isccc_cc_lookupuint32(_ctrl, "_nonce", &nonce) != ISC_R_SUCCESS) {
-		nonce = 0;
-	}
-
-	DO("create message", isccc_cc_createmessage(1, NULL, NULL, ++serial,
-						    now, now + 60, &request));
-	data = isccc_alist_lookup(request, "_data");
-	if (data == NULL) {
-		fatal("_data section missing");
-	}
-	if (isccc_cc_definestring(data, "type", args) == NULL) {
-		fatal("out of memory");
+	/* The nonce is sent with every command on this connection */
+	ccnonce = 0;
+	if (isccc_cc_lookupuint32(_ctrl, "_nonce", &ccnonce) != ISC_R_SUCCESS)
+	{
+		ccnonce = 0;
 	}
-	if (nonce != 0) {
-		_ctrl = isccc_alist_lookup(request, "_ctrl");
-		if (_ctrl == NULL) {
-			fatal("_ctrl section missing");
-		}
-		if (isccc_cc_defineuint32(_ctrl, "_nonce", nonce) == NULL) {
-			fatal("out of memory");
-		}
-	}
-
-	isc_buffer_clear(databuf);
-	/* Skip the length field (4 bytes) */
-	isc_buffer_add(databuf, 4);
-
-	DO("render message",
-	   isccc_cc_towire(request, &databuf, algorithm, &secret));
 
-	isc_buffer_init(&b, databuf->base, 4);
-	isc_buffer_putuint32(&b, databuf->used - 4);
-
-	r.base = databuf->base;
-	r.length = databuf->used;
+	isccc_sexpr_free(&response);
 
-	isccc_ccmsg_readmessage(ccmsg, rndc_recvdone, ccmsg);
-	isccc_ccmsg_sendmessage(ccmsg, &r, rndc_senddone, NULL);
+	if (batchfp != NULL && !nextcommand()) {
+		isccc_ccmsg_disconnect(ccmsg);
+		isc_loopmgr_shutdown(loopmgr);
+		return;
+	}
 
-	isccc_sexpr_free(&response);
-	isccc_sexpr_free(&request);
-	return;
+	rndc_sendcommand(ccmsg);
 }
 
 static void
@@ -815,8 +905,8 @@ main(int argc, char **argv) {
 	const char *keyname = NULL;
 	struct in_addr in;
 	struct in6_addr in6;
+	const char *batchfile = NULL;
 	char *p = NULL;
-	size_t argslen;
 	int ch;
 	int i;
 
@@ -869,6 +959,10 @@ main(int argc, char **argv) {
 			c_flag = true;
 			break;
 
+		case 'f':
+			batchfile = isc_commandline_argument;
+			break;
+
 		case 'k':
 			admin_keyfile = isc_commandline_argument;
 			break;
@@ -938,7 +1032,20 @@ main(int argc, char **argv) {
 	argc -= isc_commandline_index;
 	argv += isc_commandline_index;
 
-	if (argv[0] == NULL) {
+	if (batchfile != NULL) {
+		if (argv[0] != NULL) {
+			usage(1);
+		}
+		if (strcmp(batchfile, "-") == 0) {
+			batchfp = stdin;
+		} else {
+			batchfp = fopen(batchfile, "r");
+			if (batchfp == NULL) {
+				fatal("couldn't open '%s': %s", batchfile,
+				      strerror(errno));
+			}
+		}
+	} else if (argv[0] == NULL) {
 		usage(1);
 	} else {
 		command = argv[0];
@@ -969,27 +1076,27 @@ main(int argc, char **argv) {
 
 	/*
 	 * Convert argc/argv into a space-delimited command string
-	 * similar to what the user might enter in interactive mode
-	 * (if that were implemented).
+	 * similar to what the user might enter in batch mode.
 	 */
-	argslen = 0;
-	for (i = 0; i < argc; i++) {
-		argslen += strlen(argv[i]) + 1;
-	}
+	if (batchfp == NULL) {
+		for (i = 0; i < argc; i++) {
+			argslen += strlen(argv[i]) + 1;
+		}
 
-	args = isc_mem_get(rndc_mctx, argslen);
+		args = isc_mem_get(rndc_mctx, argslen);
 
-	p = args;
-	for (i = 0; i < argc; i++) {
-		size_t len = strlen(argv[i]);
-		memmove(p, argv[i], len);
-		p += len;
-		*p++ = ' ';
-	}
+		p = args;
+		for (i = 0; i < argc; i++) {
+			size_t len = strlen(argv[i]);
+			memmove(p, argv[i], len);
+			p += len;
+			*p++ = ' ';
+		}
 
-	p--;
-	*p++ = '\0';
-	INSIST(p == args + argslen);
+		p--;
+		*p++ = '\0';
+		INSIST(p == args + argslen);
+	}
 
 	if (nserveraddrs == 0 && servername != NULL) {
 		get_addresses(servername, (in_port_t)remoteport);
@@ -1002,7 +1109,12 @@ main(int argc, char **argv) {
 	cfg_obj_destroy(pctx, &config);
 	cfg_parser_destroy(&pctx);
 
-	isc_mem_put(rndc_mctx, args, argslen);
+	if (argslen > 0) {
+		isc_mem_put(rndc_mctx, args, argslen);
+	}
+	if (batchfp != NULL && batchfp != stdin) {
+		(void)fclose(batchfp);
+	}
 
 	isc_buffer_free(&databuf);
 
@@ -129,6 +129,14 @@ grep "; COOKIE:.*(good)" dig.out.test$n >/dev/null || ret=1
 if [ $ret != 0 ]; then echo_i "failed"; fi
 status=$((status + ret))
 
+n=$((n + 1))
+echo_i "checking a fresh COOKIE is returned unchanged ($n)"
+ret=0
+$DIG $DIGOPTS +cookie=$cookie version.bind txt ch @10.53.0.1 >dig.out.test$n || ret=1
+grep "; COOKIE: $cookie (good)" dig.out.test$n >/dev/null || ret=1
+if [ $ret != 0 ]; then echo_i "failed"; fi
+status=$((status + ret))
+
 n=$((n + 1))
 echo_i "checking COOKIE is learnt for TCP retry ($n)"
 ret=0
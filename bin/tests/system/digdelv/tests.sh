@@ -379,6 +379,34 @@ if [ -x "$DIG" ]; then
   if [ $ret -ne 0 ]; then echo_i "failed"; fi
   status=$((status + ret))
 
+  n=$((n + 1))
+  echo_i "checking dig +fanout queries all the servers ($n)"
+  ret=0
+  dig_with_opts +fanout +norec @10.53.0.1 @10.53.0.2 SOA . >dig.out.test$n 2>&1 || ret=1
+  test "$(grep -c "status: NOERROR" dig.out.test$n)" -eq 2 || ret=1
+  grep "SERVER: 10.53.0.1#$PORT" <dig.out.test$n >/dev/null || ret=1
+  grep "SERVER: 10.53.0.2#$PORT" <dig.out.test$n >/dev/null || ret=1
+  if [ $ret -ne 0 ]; then echo_i "failed"; fi
+  status=$((status + ret))
+
+  n=$((n + 1))
+  echo_i "checking dig +fanout goes on when a server fails ($n)"
+  ret=0
+  dig_with_opts +fanout +norec +tries=1 +time=1 @10.53.0.1 @10.53.0.10 @10.53.0.2 SOA . >dig.out.test$n 2>&1 || ret=1
+  test "$(grep -c "status: NOERROR" dig.out.test$n)" -eq 2 || ret=1
+  grep "SERVER: 10.53.0.1#$PORT" <dig.out.test$n >/dev/null || ret=1
+  grep "SERVER: 10.53.0.2#$PORT" <dig.out.test$n >/dev/null || ret=1
+  if [ $ret -ne 0 ]; then echo_i "failed"; fi
+  status=$((status + ret))
+
+  n=$((n + 1))
+  echo_i "checking dig +fanout fails when no server answers ($n)"
+  ret=0
+  dig_with_opts +fanout +norec +tries=1 +time=1 @10.53.0.10 SOA . >dig.out.test$n 2>&1 && ret=1
+  grep "servers could not be reached" <dig.out.test$n >/dev/null || ret=1
+  if [ $ret -ne 0 ]; then echo_i "failed"; fi
+  status=$((status + ret))
+
   n=$((n + 1))
   echo_i "checking dig @IPv6addr -4 A a.example ($n)"
   if testsock6 fd92:7065:b8e:ffff::2 2>/dev/null; then
@@ -0,0 +1,126 @@
+# Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+#
+# SPDX-License-Identifier: MPL-2.0
+#
+# This Source Code Form is subject to the terms of the Mozilla Public
+# License, v. 2.0.  If a copy of the MPL was not distributed with this
+# file, you can obtain one at https://mozilla.org/MPL/2.0/.
+#
+# See the COPYRIGHT file distributed with this work for additional
+# information regarding copyright ownership.
+
+import os
+import stat
+import subprocess
+import threading
+import time
+
+import pytest
+
+pytest.importorskip("dns", minversion="2.0.0")
+import dns.exception
+import dns.message
+import dns.rrset
+
+import isctest
+
+pytestmark = pytest.mark.extra_artifacts(
+    [
+        "ns1/handoff.sock",
+        "ns1/named2.run",
+    ]
+)
+
+
+def query_www(udp):
+    msg = dns.message.make_query("www.handoff.example.", "A")
+    if udp:
+        res = isctest.query.udp(msg, "10.53.0.1", timeout=2, attempts=1)
+    else:
+        res = isctest.query.tcp(msg, "10.53.0.1", timeout=2, attempts=1)
+    isctest.check.noerror(res)
+    assert res.answer[0] == dns.rrset.from_text(
+        "www.handoff.example.", 300, "IN", "A", "10.53.0.80"
+    )
+
+
+def query_loop(done, answered, failed):
+    udp = True
+    while not done.is_set():
+        try:
+            query_www(udp)
+            answered.append(udp)
+        except (dns.exception.DNSException, OSError) as e:
+            failed.append(e)
+        udp = not udp
+        time.sleep(0.01)
+
+
+def pid_alive(pid):
+    try:
+        os.kill(pid, 0)
+    except ProcessLookupError:
+        return False
+    return True
+
+
+def test_handoff(servers):
+    ns1 = servers["ns1"]
+
+    with open("ns1/named.pid", encoding="utf-8") as pidfile:
+        oldpid = int(pidfile.read())
+
+    # the new server waits for the sockets before it loads its configuration;
+    # the socket path is relative to the working directory of both servers
+    named_cmdline = isctest.run.get_named_cmdline("ns1")
+    named_cmdline += ["-H", "handoff.sock"]
+
+    done = threading.Event()
+    answered = []
+    failed = []
+    querier = threading.Thread(target=query_loop, args=(done, answered, failed))
+
+    with open("ns1/named2.run", "ab") as named_log:
+        named_proc = subprocess.Popen(named_cmdline, cwd="ns1", stderr=named_log)
+        try:
+            for _ in range(10):
+                if os.path.exists("ns1/handoff.sock"):
+                    break
+                time.sleep(1)
+            mode = os.stat("ns1/handoff.sock").st_mode
+            assert stat.S_ISSOCK(mode)
+            assert stat.S_IMODE(mode) == 0o600
+
+            querier.start()
+            with ns1.watch_log_from_here() as watcher:
+                ns1.rndc("handoff handoff.sock")
+                watcher.wait_for_line(
+                    "handoff: the new server is ready, shutting down"
+                )
+
+            # the old server exits and the new one keeps answering
+            for _ in range(30):
+                if not pid_alive(oldpid):
+                    break
+                time.sleep(1)
+            assert not pid_alive(oldpid), "the old server is still running"
+            isctest.run.assert_custom_named_is_alive(named_proc, "10.53.0.1")
+            time.sleep(1)
+        except Exception:
+            named_proc.kill()
+            named_proc.wait()
+            raise
+        finally:
+            done.set()
+            if querier.is_alive():
+                querier.join()
+
+    # no query was lost while the two servers shared the sockets
+    assert answered
+    assert not failed, f"{len(failed)} queries failed: {failed[0]}"
+
+    # the new server answers rndc on the handed over control channel, and
+    # is left running for the framework to stop, as the pid file is its own
+    with open("ns1/named.pid", encoding="utf-8") as pidfile:
+        assert int(pidfile.read()) == named_proc.pid
+    ns1.rndc("status")
@@ -206,6 +206,25 @@ $JOURNALPRINT -x ns1/temp.jnl | grep -q "Header version = 2" || ret=1
 [ $ret -eq 0 ] || echo_i "failed"
 status=$((status + ret))
 
+n=$((n + 1))
+echo_i "check printing a range of serials from a journal ($n)"
+ret=0
+journal=ns1/d1212.db.jnl
+$JOURNALPRINT -x $journal | awk '$1 == "Transaction:" { print $11, $13 }' >journalprint.out.test$n.all
+[ $(wc -l <journalprint.out.test$n.all) -eq 4 ] || ret=1
+begin=$(awk 'NR == 2 { print $1 }' journalprint.out.test$n.all)
+end=$(awk 'NR == 3 { print $2 }' journalprint.out.test$n.all)
+$JOURNALPRINT -x -b $begin $journal | awk '$1 == "Transaction:" { print $11, $13 }' >journalprint.out.test$n.begin || ret=1
+tail -n 3 journalprint.out.test$n.all | diff - journalprint.out.test$n.begin >/dev/null || ret=1
+$JOURNALPRINT -x -e $end $journal | awk '$1 == "Transaction:" { print $11, $13 }' >journalprint.out.test$n.end || ret=1
+head -n 3 journalprint.out.test$n.all | diff - journalprint.out.test$n.end >/dev/null || ret=1
+$JOURNALPRINT -x -b $begin -e $end $journal | awk '$1 == "Transaction:" { print $11, $13 }' >journalprint.out.test$n.range || ret=1
+sed -n '2,3p' journalprint.out.test$n.all | diff - journalprint.out.test$n.range >/dev/null || ret=1
+# a serial that is not in the journal is an error
+$JOURNALPRINT -b 1 $journal >/dev/null 2>&1 && ret=1
+[ $ret -eq 0 ] || echo_i "failed"
+status=$((status + ret))
+
 n=$((n + 1))
 echo_i "check max-journal-size works after journal update ($n)"
 ret=0
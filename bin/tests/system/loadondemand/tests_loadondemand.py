@@ -0,0 +1,62 @@
+# Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+#
+# SPDX-License-Identifier: MPL-2.0
+#
+# This Source Code Form is subject to the terms of the Mozilla Public
+# License, v. 2.0.  If a copy of the MPL was not distributed with this
+# file, you can obtain one at https://mozilla.org/MPL/2.0/.
+#
+# See the COPYRIGHT file distributed with this work for additional
+# information regarding copyright ownership.
+
+from concurrent.futures import ThreadPoolExecutor
+import time
+
+import dns.message
+import dns.rrset
+
+import isctest
+
+
+def query_www():
+    msg = dns.message.make_query("www.demand.example.", "A")
+    return isctest.query.udp(msg, "10.53.0.1", attempts=1)
+
+
+def check_www(res):
+    isctest.check.noerror(res)
+    assert res.answer[0] == dns.rrset.from_text(
+        "www.demand.example.", 300, "IN", "A", "10.53.0.80"
+    )
+
+
+def test_loadondemand(servers):
+    ns1 = servers["ns1"]
+
+    # the zone is not loaded with the others
+    with ns1.watch_log_from_start() as watcher:
+        watcher.wait_for_line("zone demand.example/IN: load deferred")
+
+    # all the queries parked while the zone loads are answered
+    with ns1.watch_log_from_here() as watcher:
+        with ThreadPoolExecutor(max_workers=10) as executor:
+            results = [executor.submit(query_www) for _ in range(10)]
+        for result in results:
+            check_www(result.result())
+        watcher.wait_for_line("zone demand.example/IN: loading on demand")
+        watcher.wait_for_line("zone demand.example/IN: loaded serial 1")
+
+    # queries keep the zone loaded past its idle time
+    for _ in range(5):
+        check_www(query_www())
+        time.sleep(1)
+    ns1.log.prohibit("unloaded after")
+
+    # until it has no queries for the idle time
+    with ns1.watch_log_from_here() as watcher:
+        watcher.wait_for_line("zone demand.example/IN: unloaded after 3")
+
+    # an idle zone is unloaded, and the next query loads it again
+    with ns1.watch_log_from_here() as watcher:
+        check_www(query_www())
+        watcher.wait_for_line("zone demand.example/IN: loading on demand")
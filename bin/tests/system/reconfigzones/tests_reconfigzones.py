@@ -0,0 +1,52 @@
+# Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+#
+# SPDX-License-Identifier: MPL-2.0
+#
+# This Source Code Form is subject to the terms of the Mozilla Public
+# License, v. 2.0.  If a copy of the MPL was not distributed with this
+# file, you can obtain one at https://mozilla.org/MPL/2.0/.
+#
+# See the COPYRIGHT file distributed with this work for additional
+# information regarding copyright ownership.
+
+import dns.message
+
+import isctest
+
+
+def unchanged(zone):
+    msg = f"zone {zone}/IN: configuration unchanged, not reconfiguring"
+    with open("ns1/named.run", encoding="utf-8") as log:
+        return sum(1 for line in log if msg in line)
+
+
+def query_soa(zone):
+    msg = dns.message.make_query(zone, "SOA")
+    return isctest.query.tcp(msg, "10.53.0.1")
+
+
+def test_reconfigzones(servers, templates):
+    ns1 = servers["ns1"]
+
+    # nothing changed, no zone is reconfigured
+    ns1.reconfigure()
+    assert unchanged("one.example") == 1
+    assert unchanged("two.example") == 1
+
+    # only the zone whose statement changed is reconfigured
+    templates.render("ns1/named.conf", {"two_allow_query": "none"})
+    ns1.reconfigure()
+    assert unchanged("one.example") == 2
+    assert unchanged("two.example") == 1
+    isctest.check.noerror(query_soa("one.example"))
+    isctest.check.refused(query_soa("two.example"))
+
+    # a change of the options reconfigures every zone
+    templates.render(
+        "ns1/named.conf", {"two_allow_query": "none", "minimal_any": True}
+    )
+    ns1.reconfigure()
+    assert unchanged("one.example") == 2
+    assert unchanged("two.example") == 1
+    isctest.check.noerror(query_soa("one.example"))
+    isctest.check.refused(query_soa("two.example"))
@@ -0,0 +1,90 @@
+# Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+#
+# SPDX-License-Identifier: MPL-2.0
+#
+# This Source Code Form is subject to the terms of the Mozilla Public
+# License, v. 2.0.  If a copy of the MPL was not distributed with this
+# file, you can obtain one at https://mozilla.org/MPL/2.0/.
+#
+# See the COPYRIGHT file distributed with this work for additional
+# information regarding copyright ownership.
+
+from concurrent.futures import ThreadPoolExecutor
+import time
+
+import dns.message
+import dns.rrset
+import dns.update
+import pytest
+
+import isctest
+
+pytestmark = pytest.mark.extra_artifacts(
+    [
+        "ns1/batch.db.jnl",
+    ]
+)
+
+ZONE = "batch.example."
+
+
+def query(qname, qtype):
+    msg = dns.message.make_query(qname, qtype)
+    return isctest.query.tcp(msg, "10.53.0.1")
+
+
+def send(update):
+    return isctest.query.udp(update, "10.53.0.1", attempts=1)
+
+
+def test_updatebatch():
+    # the first message adds a name
+    first = dns.update.UpdateMessage(ZONE)
+    first.add(f"a.{ZONE}", 300, "A", "10.53.0.101")
+
+    # the second one requires the name added by the first one
+    second = dns.update.UpdateMessage(ZONE)
+    second.present(f"a.{ZONE}", "A")
+    second.add(f"b.{ZONE}", 300, "A", "10.53.0.102")
+
+    # the third one adds a name, then fails the name server check
+    # after its changes have been made to the shared version
+    third = dns.update.UpdateMessage(ZONE)
+    third.add(f"c.{ZONE}", 300, "A", "10.53.0.103")
+    third.add(ZONE, 300, "NS", f"missing.{ZONE}")
+
+    # the fourth one requires the name of the third one to be gone
+    fourth = dns.update.UpdateMessage(ZONE)
+    fourth.absent(f"c.{ZONE}")
+    fourth.add(f"d.{ZONE}", 300, "A", "10.53.0.104")
+
+    # send them in order, within one batch window
+    with ThreadPoolExecutor(max_workers=4) as executor:
+        results = []
+        for update in [first, second, third, fourth]:
+            results.append(executor.submit(send, update))
+            time.sleep(0.1)
+    isctest.check.noerror(results[0].result())
+    isctest.check.noerror(results[1].result())
+    isctest.check.refused(results[2].result())
+    isctest.check.noerror(results[3].result())
+
+    # only the changes of the failed message are gone
+    for name, address in [("a", "10.53.0.101"), ("b", "10.53.0.102")]:
+        res = query(f"{name}.{ZONE}", "A")
+        isctest.check.noerror(res)
+        assert res.answer[0] == dns.rrset.from_text(
+            f"{name}.{ZONE}", 300, "IN", "A", address
+        )
+    res = query(f"d.{ZONE}", "A")
+    isctest.check.noerror(res)
+    isctest.check.nxdomain(query(f"c.{ZONE}", "A"))
+    res = query(ZONE, "NS")
+    assert res.answer[0] == dns.rrset.from_text(
+        ZONE, 300, "IN", "NS", f"ns1.{ZONE}"
+    )
+
+    # the whole batch bumped the serial once
+    res = query(ZONE, "SOA")
+    isctest.check.noerror(res)
+    assert res.answer[0][0].serial == 2
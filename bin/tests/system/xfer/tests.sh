@@ -79,6 +79,18 @@ digcomp dig.out.ns2.test$n dig.out.ns3.test$n || tmp=1
 if test $tmp != 0; then echo_i "failed"; fi
 status=$((status + tmp))
 
+n=$((n + 1))
+echo_i "testing that a newer serial on a later primary is found when the first one is dead ($n)"
+tmp=0
+retry_quiet 20 wait_for_xfer soaprobe. 10.53.0.6 || tmp=1
+grep "^;" dig.out.test$n | cat_i
+grep "^soaprobe.*SOA.* 2 0 0 0 0" dig.out.test$n >/dev/null || tmp=1
+grep "^a.soaprobe.*10.53.0.2" dig.out.test$n >/dev/null || tmp=1
+grep -F "'soaprobe/IN' from 10.53.0.2#${PORT}: Transfer status: success" ns6/named.run >/dev/null || tmp=1
+grep -F "'soaprobe/IN' from 10.53.0.1#${PORT}: Transfer status" ns6/named.run >/dev/null && tmp=1
+if test $tmp != 0; then echo_i "failed"; fi
+status=$((status + tmp))
+
 echo_i "reload servers for in preparation for ixfr-from-differences tests"
 
 rndc_reload ns1 10.53.0.1
@@ -36,13 +36,17 @@
 
 #include <protobuf-c/protobuf-c.h>
 
+#include <isc/atomic.h>
 #include <isc/attributes.h>
 #include <isc/buffer.h>
 #include <isc/commandline.h>
 #include <isc/hex.h>
 #include <isc/mem.h>
+#include <isc/netaddr.h>
+#include <isc/os.h>
 #include <isc/result.h>
 #include <isc/string.h>
+#include <isc/thread.h>
 #include <isc/util.h>
 
 #include <dns/dnstap.h>
@@ -50,6 +54,7 @@
 #include <dns/masterdump.h>
 #include <dns/message.h>
 #include <dns/name.h>
+#include <dns/rcode.h>
 
 #include "dnstap.pb-c.h"
 
@@ -60,6 +65,32 @@ bool hexmessage = false;
 bool yaml = false;
 bool timestampmillis = false;
 
+/* Only print the frames that match these, see frame_match() */
+dns_fixedname_t ffiltername;
+dns_name_t *filtername = NULL;
+bool filterrcode = false;
+dns_rcode_t rcodevalue;
+bool filteraddr = false;
+isc_netaddr_t addrvalue;
+
+/*
+ * The frames are read in batches of FRAME_BATCH, decoded and printed
+ * into memory by 'nthreads' threads, and written out in order.
+ */
+#define FRAME_BATCH 4096
+
+typedef struct frame {
+	uint8_t *data;
+	size_t datalen;
+	char *text; /* from open_memstream() */
+	size_t textlen;
+} frame_t;
+
+unsigned int nthreads = 0;
+frame_t frames[FRAME_BATCH];
+unsigned int nframes = 0;
+atomic_uint_fast32_t nextframe;
+
 const char *program = "dnstap-read";
 
 #define CHECKM(op, msg)                                               \
@@ -89,9 +120,15 @@ fatal(const char *format, ...) {
 
 static void
 usage(void) {
-	fprintf(stderr, "dnstap-read [-mpxy] [filename]\n");
+	fprintf(stderr, "dnstap-read [-mptxy] [-a address] [-j threads] "
+			"[-n name] [-r rcode] [filename]\n");
+	fprintf(stderr, "\t-a\tonly print the frames to or from address\n");
+	fprintf(stderr, "\t-j\tdecode the frames on this many threads\n");
 	fprintf(stderr, "\t-m\ttrace memory allocations\n");
+	fprintf(stderr,
+		"\t-n\tonly print the frames for names at or below name\n");
 	fprintf(stderr, "\t-p\tprint the full DNS message\n");
+	fprintf(stderr, "\t-r\tonly print the responses with rcode\n");
 	fprintf(stderr,
 		"\t-t\tprint long timestamps with millisecond precision\n");
 	fprintf(stderr, "\t-x\tuse hex format to print DNS message\n");
@@ -99,7 +136,7 @@ usage(void) {
 }
 
 static void
-print_dtdata(dns_dtdata_t *dt) {
+print_dtdata(dns_dtdata_t *dt, FILE *out) {
 	isc_result_t result;
 	isc_buffer_t *b = NULL;
 
@@ -109,8 +146,8 @@ print_dtdata(dns_dtdata_t *dt) {
 	}
 
 	CHECKM(dns_dt_datatotext(dt, &b), "dns_dt_datatotext");
-	printf("%.*s\n", (int)isc_buffer_usedlength(b),
-	       (char *)isc_buffer_base(b));
+	fprintf(out, "%.*s\n", (int)isc_buffer_usedlength(b),
+		(char *)isc_buffer_base(b));
 
 cleanup:
 	if (b != NULL) {
@@ -119,7 +156,7 @@ cleanup:
 }
 
 static void
-print_hex(dns_dtdata_t *dt) {
+print_hex(dns_dtdata_t *dt, FILE *out) {
 	isc_buffer_t *b = NULL;
 	isc_result_t result;
 	size_t textlen;
@@ -137,8 +174,8 @@ print_hex(dns_dtdata_t *dt) {
 	result = isc_hex_totext(&dt->msgdata, 0, "", b);
 	CHECKM(result, "isc_hex_totext");
 
-	printf("%.*s\n", (int)isc_buffer_usedlength(b),
-	       (char *)isc_buffer_base(b));
+	fprintf(out, "%.*s\n", (int)isc_buffer_usedlength(b),
+		(char *)isc_buffer_base(b));
 
 cleanup:
 	if (b != NULL) {
@@ -147,7 +184,8 @@ cleanup:
 }
 
 static void
-print_packet(dns_dtdata_t *dt, const dns_master_style_t *style) {
+print_packet(dns_dtdata_t *dt, const dns_master_style_t *style,
+	     FILE *out) {
 	isc_buffer_t *b = NULL;
 	isc_result_t result;
 
@@ -171,8 +209,9 @@ print_packet(dns_dtdata_t *dt, const dns_master_style_t *style) {
 				textlen *= 2;
 				continue;
 			} else if (result == ISC_R_SUCCESS) {
-				printf("%.*s", (int)isc_buffer_usedlength(b),
-				       (char *)isc_buffer_base(b));
+				fprintf(out, "%.*s",
+					(int)isc_buffer_usedlength(b),
+					(char *)isc_buffer_base(b));
 				isc_buffer_free(&b);
 			} else {
 				isc_buffer_free(&b);
@@ -189,11 +228,10 @@ cleanup:
 }
 
 static void
-print_yaml(dns_dtdata_t *dt) {
+print_yaml(dns_dtdata_t *dt, FILE *out) {
 	Dnstap__Dnstap *frame = dt->frame;
 	Dnstap__Message *m = frame->message;
 	const ProtobufCEnumValue *ftype, *mtype;
-	static bool first = true;
 
 	ftype = protobuf_c_enum_descriptor_get_value(
 		&dnstap__dnstap__type__descriptor, frame->type);
@@ -201,29 +239,23 @@ print_yaml(dns_dtdata_t *dt) {
 		return;
 	}
 
-	if (!first) {
-		printf("---\n");
-	} else {
-		first = false;
-	}
-
-	printf("type: %s\n", ftype->name);
+	fprintf(out, "type: %s\n", ftype->name);
 
 	if (frame->has_identity) {
-		printf("identity: %.*s\n", (int)frame->identity.len,
-		       frame->identity.data);
+		fprintf(out, "identity: %.*s\n", (int)frame->identity.len,
+			frame->identity.data);
 	}
 
 	if (frame->has_version) {
-		printf("version: %.*s\n", (int)frame->version.len,
-		       frame->version.data);
+		fprintf(out, "version: %.*s\n", (int)frame->version.len,
+			frame->version.data);
 	}
 
 	if (frame->type != DNSTAP__DNSTAP__TYPE__MESSAGE) {
 		return;
 	}
 
-	printf("message:\n");
+	fprintf(out, "message:\n");
 
 	mtype = protobuf_c_enum_descriptor_get_value(
 		&dnstap__message__type__descriptor, m->type);
@@ -231,7 +263,7 @@ print_yaml(dns_dtdata_t *dt) {
 		return;
 	}
 
-	printf("  type: %s\n", mtype->name);
+	fprintf(out, "  type: %s\n", mtype->name);
 
 	if (!isc_time_isepoch(&dt->qtime)) {
 		char buf[100];
@@ -240,7 +272,7 @@ print_yaml(dns_dtdata_t *dt) {
 		} else {
 			isc_time_formatISO8601(&dt->qtime, buf, sizeof(buf));
 		}
-		printf("  query_time: !!timestamp %s\n", buf);
+		fprintf(out, "  query_time: !!timestamp %s\n", buf);
 	}
 
 	if (!isc_time_isepoch(&dt->rtime)) {
@@ -250,13 +282,14 @@ print_yaml(dns_dtdata_t *dt) {
 		} else {
 			isc_time_formatISO8601(&dt->rtime, buf, sizeof(buf));
 		}
-		printf("  response_time: !!timestamp %s\n", buf);
+		fprintf(out, "  response_time: !!timestamp %s\n", buf);
 	}
 
 	if (dt->msgdata.base != NULL) {
-		printf("  message_size: %zub\n", (size_t)dt->msgdata.length);
+		fprintf(out, "  message_size: %zub\n",
+			(size_t)dt->msgdata.length);
 	} else {
-		printf("  message_size: 0b\n");
+		fprintf(out, "  message_size: 0b\n");
 	}
 
 	if (m->has_socket_family) {
@@ -265,12 +298,12 @@ print_yaml(dns_dtdata_t *dt) {
 				&dnstap__socket_family__descriptor,
 				m->socket_family);
 		if (type != NULL) {
-			printf("  socket_family: %s\n", type->name);
+			fprintf(out, "  socket_family: %s\n", type->name);
 		}
 	}
 
-	printf("  socket_protocol: %s\n",
-	       dt->transport == DNS_TRANSPORT_UDP ? "UDP" : "TCP");
+	fprintf(out, "  socket_protocol: %s\n",
+		dt->transport == DNS_TRANSPORT_UDP ? "UDP" : "TCP");
 
 	if (m->has_query_address) {
 		ProtobufCBinaryData *ip = &m->query_address;
@@ -278,7 +311,7 @@ print_yaml(dns_dtdata_t *dt) {
 
 		(void)inet_ntop(ip->len == 4 ? AF_INET : AF_INET6, ip->data,
 				buf, sizeof(buf));
-		printf("  query_address: \"%s\"\n", buf);
+		fprintf(out, "  query_address: \"%s\"\n", buf);
 	}
 
 	if (m->has_response_address) {
@@ -287,15 +320,15 @@ print_yaml(dns_dtdata_t *dt) {
 
 		(void)inet_ntop(ip->len == 4 ? AF_INET : AF_INET6, ip->data,
 				buf, sizeof(buf));
-		printf("  response_address: \"%s\"\n", buf);
+		fprintf(out, "  response_address: \"%s\"\n", buf);
 	}
 
 	if (m->has_query_port) {
-		printf("  query_port: %u\n", m->query_port);
+		fprintf(out, "  query_port: %u\n", m->query_port);
 	}
 
 	if (m->has_response_port) {
-		printf("  response_port: %u\n", m->response_port);
+		fprintf(out, "  response_port: %u\n", m->response_port);
 	}
 
 	if (m->has_query_zone) {
@@ -312,45 +345,232 @@ print_yaml(dns_dtdata_t *dt) {
 		result = dns_name_fromwire(name, &b, DNS_DECOMPRESS_NEVER,
 					   NULL);
 		if (result == ISC_R_SUCCESS) {
-			printf("  query_zone: ");
-			dns_name_print(name, stdout);
-			printf("\n");
+			fprintf(out, "  query_zone: ");
+			dns_name_print(name, out);
+			fprintf(out, "\n");
 		}
 	}
 
 	if (dt->msg != NULL) {
 		dt->msg->indent.count = 2;
 		dt->msg->indent.string = "  ";
-		printf("  %s:\n", ((dt->type & DNS_DTTYPE_QUERY) != 0)
-					  ? "query_message_data"
-					  : "response_message_data");
+		fprintf(out, "  %s:\n",
+			((dt->type & DNS_DTTYPE_QUERY) != 0)
+				? "query_message_data"
+				: "response_message_data");
+
+		print_packet(dt, &dns_master_style_yaml, out);
+
+		fprintf(out, "  %s: |\n",
+			((dt->type & DNS_DTTYPE_QUERY) != 0)
+				? "query_message"
+				: "response_message");
+		print_packet(dt, &dns_master_style_indent, out);
+	}
+}
 
-		print_packet(dt, &dns_master_style_yaml);
+static bool
+frame_match(dns_dtdata_t *dt) {
+	if (filtername != NULL) {
+		dns_name_t *qname = NULL;
 
-		printf("  %s: |\n", ((dt->type & DNS_DTTYPE_QUERY) != 0)
-					    ? "query_message"
-					    : "response_message");
-		print_packet(dt, &dns_master_style_indent);
+		if (dt->msg == NULL ||
+		    dns_message_firstname(dt->msg, DNS_SECTION_QUESTION) !=
+			    ISC_R_SUCCESS)
+		{
+			return false;
+		}
+		dns_message_currentname(dt->msg, DNS_SECTION_QUESTION, &qname);
+		if (!dns_name_issubdomain(qname, filtername)) {
+			return false;
+		}
 	}
+
+	if (filterrcode) {
+		if (dt->msg == NULL || (dt->type & DNS_DTTYPE_QUERY) != 0 ||
+		    dt->msg->rcode != rcodevalue)
+		{
+			return false;
+		}
+	}
+
+	if (filteraddr) {
+		size_t len = (addrvalue.family == AF_INET) ? 4 : 16;
+
+		if (!(dt->qaddr.length == len &&
+		      memcmp(dt->qaddr.base, &addrvalue.type, len) == 0) &&
+		    !(dt->raddr.length == len &&
+		      memcmp(dt->raddr.base, &addrvalue.type, len) == 0))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void
+print_frame(dns_dtdata_t *dt, FILE *out) {
+	if (yaml) {
+		print_yaml(dt, out);
+	} else if (hexmessage) {
+		print_dtdata(dt, out);
+		print_hex(dt, out);
+	} else if (printmessage) {
+		print_dtdata(dt, out);
+		print_packet(dt, &dns_master_style_debug, out);
+	} else {
+		print_dtdata(dt, out);
+	}
+}
+
+/*
+ * Decode a frame, and print it into memory if it matches the filters.
+ */
+static void
+render_frame(frame_t *frame) {
+	isc_region_t input = { .base = frame->data, .length = frame->datalen };
+	dns_dtdata_t *dt = NULL;
+	FILE *out = NULL;
+
+	if (dns_dt_parse(mctx, &input, &dt) != ISC_R_SUCCESS) {
+		return;
+	}
+
+	if (frame_match(dt)) {
+		out = open_memstream(&frame->text, &frame->textlen);
+		if (out == NULL) {
+			fatal("out of memory");
+		}
+		print_frame(dt, out);
+		if (fclose(out) != 0) {
+			fatal("out of memory");
+		}
+	}
+
+	dns_dtdata_free(&dt);
+}
+
+static void *
+render_thread(void *arg ISC_ATTR_UNUSED) {
+	uint_fast32_t i;
+
+	while ((i = atomic_fetch_add(&nextframe, 1)) < nframes) {
+		render_frame(&frames[i]);
+	}
+
+	return NULL;
+}
+
+/*
+ * Decode the frames of the batch and write them out in order.
+ */
+static void
+flush_frames(void) {
+	static bool first = true;
+
+	atomic_store(&nextframe, 0);
+	if (nthreads > 1 && nframes > 1) {
+		isc_thread_t *threads = isc_mem_cget(mctx, nthreads,
+						     sizeof(threads[0]));
+		for (unsigned int i = 0; i < nthreads; i++) {
+			isc_thread_create(render_thread, NULL, &threads[i]);
+		}
+		for (unsigned int i = 0; i < nthreads; i++) {
+			isc_thread_join(threads[i], NULL);
+		}
+		isc_mem_cput(mctx, threads, nthreads, sizeof(threads[0]));
+	} else {
+		(void)render_thread(NULL);
+	}
+
+	for (unsigned int i = 0; i < nframes; i++) {
+		frame_t *frame = &frames[i];
+
+		if (frame->text != NULL) {
+			if (yaml && frame->textlen > 0) {
+				if (!first) {
+					fputs("---\n", stdout);
+				}
+				first = false;
+			}
+			fwrite(frame->text, 1, frame->textlen, stdout);
+			free(frame->text);
+		}
+		isc_mem_put(mctx, frame->data, frame->datalen + 1);
+		*frame = (frame_t){ 0 };
+	}
+	nframes = 0;
 }
 
 int
 main(int argc, char *argv[]) {
 	isc_result_t result;
 	dns_message_t *message = NULL;
-	dns_dtdata_t *dt = NULL;
 	dns_dthandle_t *handle = NULL;
 	int rv = 0, ch;
+	char *endp = NULL;
 
-	while ((ch = isc_commandline_parse(argc, argv, "mptxy")) != -1) {
+	while ((ch = isc_commandline_parse(argc, argv, "a:j:mn:pr:txy")) != -1)
+	{
 		switch (ch) {
+		case 'a': {
+			struct in_addr in4;
+			struct in6_addr in6;
+
+			if (inet_pton(AF_INET, isc_commandline_argument,
+				      &in4) == 1)
+			{
+				isc_netaddr_fromin(&addrvalue, &in4);
+			} else if (inet_pton(AF_INET6, isc_commandline_argument,
+					     &in6) == 1)
+			{
+				isc_netaddr_fromin6(&addrvalue, &in6);
+			} else {
+				fatal("invalid address: %s",
+				      isc_commandline_argument);
+			}
+			filteraddr = true;
+			break;
+		}
+		case 'j':
+			nthreads = strtoul(isc_commandline_argument, &endp, 10);
+			if (*endp != '\0' || nthreads == 0) {
+				fatal("invalid number of threads: %s",
+				      isc_commandline_argument);
+			}
+			break;
 		case 'm':
 			isc_mem_debugging |= ISC_MEM_DEBUGRECORD;
 			memrecord = true;
 			break;
+		case 'n':
+			filtername = dns_fixedname_initname(&ffiltername);
+			result = dns_name_fromstring(filtername,
+						     isc_commandline_argument,
+						     dns_rootname, 0, NULL);
+			if (result != ISC_R_SUCCESS) {
+				fatal("invalid name: %s",
+				      isc_commandline_argument);
+			}
+			break;
 		case 'p':
 			printmessage = true;
 			break;
+		case 'r': {
+			isc_textregion_t tr = {
+				.base = isc_commandline_argument,
+				.length = strlen(isc_commandline_argument),
+			};
+
+			result = dns_rcode_fromtext(&rcodevalue, &tr);
+			if (result != ISC_R_SUCCESS) {
+				fatal("invalid rcode: %s",
+				      isc_commandline_argument);
+			}
+			filterrcode = true;
+			break;
+		}
 		case 't':
 			timestampmillis = true;
 			break;
@@ -373,13 +593,17 @@ main(int argc, char *argv[]) {
 		fatal("no file specified");
 	}
 
+	if (nthreads == 0) {
+		nthreads = isc_os_ncpus();
+	}
+
 	isc_mem_create(&mctx);
 
 	CHECKM(dns_dt_open(argv[0], dns_dtmode_file, mctx, &handle),
 	       "dns_dt_openfile");
 
 	for (;;) {
-		isc_region_t input;
+		frame_t *frame = NULL;
 		uint8_t *data;
 		size_t datalen;
 
@@ -390,33 +614,19 @@ main(int argc, char *argv[]) {
 			CHECKM(result, "dns_dt_getframe");
 		}
 
-		input.base = data;
-		input.length = datalen;
+		/* The frame is read into a buffer that is reused */
+		frame = &frames[nframes++];
+		frame->data = isc_mem_get(mctx, datalen + 1);
+		frame->datalen = datalen;
+		memmove(frame->data, data, datalen);
 
-		result = dns_dt_parse(mctx, &input, &dt);
-		if (result != ISC_R_SUCCESS) {
-			continue;
+		if (nframes == FRAME_BATCH) {
+			flush_frames();
 		}
-
-		if (yaml) {
-			print_yaml(dt);
-		} else if (hexmessage) {
-			print_dtdata(dt);
-			print_hex(dt);
-		} else if (printmessage) {
-			print_dtdata(dt);
-			print_packet(dt, &dns_master_style_debug);
-		} else {
-			print_dtdata(dt);
-		}
-
-		dns_dtdata_free(&dt);
 	}
 
 cleanup:
-	if (dt != NULL) {
-		dns_dtdata_free(&dt);
-	}
+	flush_frames();
 	if (handle != NULL) {
 		dns_dt_close(&handle);
 	}
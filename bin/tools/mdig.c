@@ -17,11 +17,13 @@
 #include <string.h>
 #include <unistd.h>
 
+#include <isc/async.h>
 #include <isc/attributes.h>
 #include <isc/base64.h>
 #include <isc/getaddresses.h>
 #include <isc/hash.h>
 #include <isc/hex.h>
+#include <isc/histo.h>
 #include <isc/log.h>
 #include <isc/loop.h>
 #include <isc/managers.h>
@@ -36,9 +38,12 @@
 #include <isc/sockaddr.h>
 #include <isc/string.h>
 #include <isc/time.h>
+#include <isc/timer.h>
+#include <isc/tls.h>
 #include <isc/util.h>
 
 #include <dns/byaddr.h>
+#include <dns/compress.h>
 #include <dns/dispatch.h>
 #include <dns/fixedname.h>
 #include <dns/message.h>
@@ -112,6 +117,7 @@ static isc_sockaddr_t srcaddr;
 static char *server = NULL;
 static isc_sockaddr_t dstaddr;
 static in_port_t port = 53;
+static bool port_set = false;
 static unsigned char cookie_secret[33];
 static int onfly = 0;
 static char hexcookie[81];
@@ -151,6 +157,16 @@ struct query {
 static struct query default_query;
 static ISC_LIST(struct query) queries;
 
+static uint32_t load_qps = 0;
+static uint32_t load_duration = 10;
+static uint32_t load_loops = 1;
+static bool tls_mode = false;
+static bool https_mode = false;
+#if HAVE_LIBNGHTTP2
+static const char *https_path = ISC_NM_HTTP_DEFAULT_PATH;
+#endif
+static bool proxy_mode = false;
+
 #define EDNSOPTS 100U
 /*% opcode text */
 static const char *const opcodetext[] = {
@@ -573,18 +589,17 @@ compute_cookie(unsigned char *cookie, size_t len) {
 	memmove(cookie, cookie_secret, 8);
 }
 
-static isc_result_t
-sendquery(struct query *query) {
-	dns_request_t *request = NULL;
+/*
+ * Build the message of 'query', with a random ID.
+ */
+static void
+buildquery(struct query *query, dns_message_t **messagep) {
 	dns_message_t *message = NULL;
 	dns_name_t *qname = NULL;
 	dns_rdataset_t *qrdataset = NULL;
 	isc_result_t result;
 	dns_fixedname_t queryname;
 	isc_buffer_t buf;
-	unsigned int options = 0;
-
-	onfly++;
 
 	dns_fixedname_init(&queryname);
 	isc_buffer_init(&buf, query->textname, strlen(query->textname));
@@ -745,6 +760,20 @@ sendquery(struct query *query) {
 		add_opt(message, query->udpsize, query->edns, flags, opts, i);
 	}
 
+	*messagep = message;
+}
+
+static isc_result_t
+sendquery(struct query *query) {
+	dns_request_t *request = NULL;
+	dns_message_t *message = NULL;
+	isc_result_t result;
+	unsigned int options = 0;
+
+	onfly++;
+
+	buildquery(query, &message);
+
 	if (tcp_mode) {
 		options |= DNS_REQUESTOPT_TCP;
 	}
@@ -847,6 +876,18 @@ help(void) {
 	       "expanded format)\n"
 	       "                 +[no]split=##       (Split hex/base64 fields "
 	       "into chunks)\n"
+	       "                 +[no]qps=###        (Send the queries over "
+	       "and over at this rate)\n"
+	       "                 +duration=###       (Seconds to send the "
+	       "queries for with +qps) [10]\n"
+	       "                 +loops=###          (Number of loops sending "
+	       "the queries with +qps) [1]\n"
+	       "                 +[no]tls            (DNS-over-TLS mode with "
+	       "+qps)\n"
+	       "                 +[no]https[=###]    (DNS-over-HTTPS mode with "
+	       "+qps) [/dns-query]\n"
+	       "                 +[no]proxy          (Send PROXYv2 headers "
+	       "with +qps)\n"
 	       " local opt       is one of:\n"
 	       "                 -c class            (specify query class)\n"
 	       "                 -t type             (specify query type)\n"
@@ -1309,6 +1350,22 @@ plus_option(char *option, struct query *query, bool global) {
 			}
 			query->dnssec = state;
 			break;
+		case 'u': /* duration */
+			FULLCHECK("duration");
+			GLOBAL();
+			if (value == NULL) {
+				goto need_value;
+			}
+			if (!state) {
+				goto invalid_option;
+			}
+			result = parse_uint(&load_duration, value, MAXTIMEOUT,
+					    "duration");
+			CHECK("parse_uint(duration)", result);
+			if (load_duration == 0) {
+				load_duration = 1;
+			}
+			break;
 		default:
 			goto invalid_option;
 		}
@@ -1399,6 +1456,26 @@ plus_option(char *option, struct query *query, bool global) {
 			goto invalid_option;
 		}
 		break;
+	case 'h': /* https */
+		FULLCHECK("https");
+		GLOBAL();
+#if HAVE_LIBNGHTTP2
+		https_mode = state;
+		if (value != NULL) {
+			https_path = value;
+		}
+#else
+		fatal("DNS-over-HTTPS is not supported in this build");
+#endif
+		break;
+	case 'l': /* loops */
+		FULLCHECK("loops");
+		GLOBAL();
+		/* Already set by preparse_args() */
+		if (value == NULL) {
+			goto need_value;
+		}
+		break;
 	case 'm': /* multiline */
 		FULLCHECK("multiline");
 		GLOBAL();
@@ -1411,10 +1488,35 @@ plus_option(char *option, struct query *query, bool global) {
 		}
 		query->nsid = state;
 		break;
-	case 'q':
-		FULLCHECK("question");
+	case 'p': /* proxy */
+		FULLCHECK("proxy");
 		GLOBAL();
-		display_question = state;
+		proxy_mode = state;
+		break;
+	case 'q':
+		switch (cmd[1]) {
+		case 'p': /* qps */
+			FULLCHECK("qps");
+			GLOBAL();
+			if (!state) {
+				load_qps = 0;
+				break;
+			}
+			if (value == NULL) {
+				goto need_value;
+			}
+			result = parse_uint(&load_qps, value, UINT32_MAX,
+					    "qps");
+			CHECK("parse_uint(qps)", result);
+			break;
+		case 'u': /* question */
+			FULLCHECK("question");
+			GLOBAL();
+			display_question = state;
+			break;
+		default:
+			goto invalid_option;
+		}
 		break;
 	case 'r':
 		switch (cmd[1]) {
@@ -1529,6 +1631,11 @@ plus_option(char *option, struct query *query, bool global) {
 			GLOBAL();
 			tcp_mode = state;
 			break;
+		case 'l': /* tls */
+			FULLCHECK("tls");
+			GLOBAL();
+			tls_mode = state;
+			break;
 		case 'i': /* timeout */
 			FULLCHECK("timeout");
 			if (value == NULL) {
@@ -1768,6 +1875,7 @@ dash_option(const char *option, char *next, struct query *query, bool global,
 		result = parse_uint(&num, value, MAXPORT, "port number");
 		CHECK("parse_uint(port)", result);
 		port = num;
+		port_set = true;
 		return value_from_next;
 	case 't':
 		tr.base = value;
@@ -1835,6 +1943,16 @@ preparse_args(int argc, char **argv) {
 	rc = argc;
 	rv = argv;
 	for (rc--, rv++; rc > 0; rc--, rv++) {
+		/* The loops are needed before the loop manager is created */
+		if (strncasecmp(rv[0], "+loops=", 7) == 0) {
+			isc_result_t result = parse_uint(&load_loops, &rv[0][7],
+							 UINT16_MAX, "loops");
+			CHECK("parse_uint(loops)", result);
+			if (load_loops == 0) {
+				load_loops = 1;
+			}
+			continue;
+		}
 		if (rv[0][0] != '-') {
 			continue;
 		}
@@ -2035,6 +2153,431 @@ parse_args(bool is_batchfile, int argc, char **argv) {
 	}
 }
 
+/*
+ * Load generation: with +qps, every loop connects to the server and
+ * sends the queries in turn, over and over, at its share of the
+ * target rate.  The queries are sent on schedule whether or not the
+ * earlier ones were answered, so that a slow server doesn't slow down
+ * the load, and each response is matched to its query by its ID.
+ */
+struct wirequery {
+	unsigned char *base;
+	unsigned int length;
+};
+
+struct loader {
+	isc_loop_t *loop;
+	isc_nmhandle_t *handle;
+	isc_timer_t *timer;
+	uint32_t qps;
+	uint32_t next;
+	uint16_t nextid;
+	bool stopped;
+	isc_nanosecs_t start;
+	uint64_t scheduled;
+	uint64_t sent;
+	uint64_t received;
+	uint64_t unexpected;
+	uint64_t failed;
+	uint64_t rcodes[16];
+	isc_histo_t *latency;
+	/* The time each ID was sent at, or 0 if it is not in flight */
+	isc_nanosecs_t *inflight;
+};
+
+/* Significant bits of the latency histogram, about two digits */
+#define LOAD_SIGBITS 7
+
+/* The query IDs, each of which can be in flight once */
+#define LOAD_IDS 65536U
+
+/* How often the loaders send the queries that are due */
+#define LOAD_TICK (1 * NS_PER_MS)
+
+static struct wirequery *wirequeries = NULL;
+static unsigned int nwirequeries = 0;
+static struct loader *loaders = NULL;
+static unsigned int loaders_done = 0;
+static isc_tlsctx_t *load_tlsctx = NULL;
+static isc_tlsctx_client_session_cache_t *load_sess_cache = NULL;
+
+static void
+load_read(isc_nmhandle_t *handle, isc_result_t eresult, isc_region_t *region,
+	  void *arg);
+
+/*
+ * Render 'query' once, so that sending it only takes a copy with a
+ * new ID.
+ */
+static void
+renderquery(struct query *query, struct wirequery *wq) {
+	dns_message_t *message = NULL;
+	dns_compress_t cctx;
+	isc_buffer_t *buf = NULL;
+	isc_result_t result;
+
+	buildquery(query, &message);
+
+	isc_buffer_allocate(mctx, &buf, COMMSIZE);
+	dns_compress_init(&cctx, mctx, 0);
+	result = dns_message_renderbegin(message, &cctx, buf);
+	CHECK("dns_message_renderbegin", result);
+	result = dns_message_rendersection(message, DNS_SECTION_QUESTION, 0);
+	CHECK("dns_message_rendersection", result);
+	result = dns_message_rendersection(message, DNS_SECTION_ADDITIONAL,
+					   0);
+	CHECK("dns_message_rendersection", result);
+	result = dns_message_renderend(message);
+	CHECK("dns_message_renderend", result);
+
+	wq->length = isc_buffer_usedlength(buf);
+	wq->base = isc_mem_get(mctx, wq->length);
+	memmove(wq->base, isc_buffer_base(buf), wq->length);
+
+	dns_compress_invalidate(&cctx);
+	isc_buffer_free(&buf);
+	dns_message_detach(&message);
+}
+
+static void
+load_sent(isc_nmhandle_t *handle ISC_ATTR_UNUSED,
+	  isc_result_t eresult ISC_ATTR_UNUSED, void *arg) {
+	/* A query that wasn't sent is counted as lost */
+	isc_mem_free(mctx, arg);
+}
+
+static void
+load_send(struct loader *loader) {
+	struct wirequery *wq = &wirequeries[loader->next];
+	uint16_t id = loader->nextid;
+	isc_region_t r;
+
+	loader->scheduled++;
+
+	/* Skip the IDs whose queries are still in flight */
+	while (loader->inflight[id] != 0) {
+		id++;
+		if (id == loader->nextid) {
+			/* All of them are, the query can't be sent */
+			return;
+		}
+	}
+
+	r.length = wq->length;
+	r.base = isc_mem_allocate(mctx, r.length);
+	memmove(r.base, wq->base, r.length);
+	r.base[0] = id >> 8;
+	r.base[1] = id & 0xff;
+
+	loader->inflight[id] = isc_time_monotonic();
+	loader->nextid = id + 1;
+	loader->next = (loader->next + 1) % nwirequeries;
+	loader->sent++;
+
+	/* Every DoH query has its own stream, and is read on its own */
+	if (https_mode) {
+		isc_nm_read(loader->handle, load_read, loader);
+	}
+	isc_nm_send(loader->handle, &r, load_sent, r.base);
+}
+
+static void
+load_done(void *arg ISC_ATTR_UNUSED) {
+	if (++loaders_done == load_loops) {
+		isc_loopmgr_shutdown(loopmgr);
+	}
+}
+
+static void
+load_stop(struct loader *loader) {
+	loader->stopped = true;
+	isc_timer_stop(loader->timer);
+	isc_timer_destroy(&loader->timer);
+	if (loader->handle != NULL) {
+		if (!https_mode) {
+			isc_nm_read_stop(loader->handle);
+		}
+		isc_nmhandle_detach(&loader->handle);
+	}
+	isc_async_run(isc_loop_main(loopmgr), load_done, NULL);
+}
+
+static void
+load_read(isc_nmhandle_t *handle, isc_result_t eresult, isc_region_t *region,
+	  void *arg) {
+	struct loader *loader = arg;
+
+	switch (eresult) {
+	case ISC_R_SUCCESS:
+		if (region->length >= DNS_MESSAGE_HEADERLEN) {
+			uint16_t id = (region->base[0] << 8) | region->base[1];
+			isc_nanosecs_t sent = loader->inflight[id];
+
+			if (sent != 0) {
+				isc_histo_inc(loader->latency,
+					      isc_time_monotonic() - sent);
+				loader->inflight[id] = 0;
+				loader->received++;
+				loader->rcodes[region->base[3] & 0x0f]++;
+				break;
+			}
+		}
+		loader->unexpected++;
+		break;
+	case ISC_R_TIMEDOUT:
+		break;
+	case ISC_R_CONNREFUSED:
+		/* An ICMP error for one UDP query doesn't end the others */
+		if (!loader->stopped) {
+			loader->failed++;
+		}
+		if (tcp_mode || tls_mode || https_mode) {
+			return;
+		}
+		break;
+	default:
+		if (!loader->stopped) {
+			loader->failed++;
+		}
+		return;
+	}
+
+	if (!https_mode && !loader->stopped) {
+		isc_nm_read(handle, load_read, loader);
+	}
+}
+
+static void
+load_tick(void *arg) {
+	struct loader *loader = arg;
+	isc_nanosecs_t elapsed = isc_time_monotonic() - loader->start;
+	isc_nanosecs_t duration = (isc_nanosecs_t)load_duration * NS_PER_SEC;
+	isc_nanosecs_t drain = (isc_nanosecs_t)default_query.timeout *
+			       NS_PER_SEC;
+
+	if (elapsed < duration) {
+		uint64_t due = elapsed * loader->qps / NS_PER_SEC;
+
+		while (loader->scheduled < due) {
+			load_send(loader);
+		}
+		return;
+	}
+
+	/* Wait for the responses still in flight for up to a timeout */
+	if (elapsed < duration + drain && loader->received < loader->sent) {
+		return;
+	}
+
+	load_stop(loader);
+}
+
+static void
+load_connected(isc_nmhandle_t *handle, isc_result_t eresult, void *arg) {
+	struct loader *loader = arg;
+	isc_interval_t interval;
+
+	if (eresult != ISC_R_SUCCESS) {
+		fatal("couldn't connect to '%s': %s", server,
+		      isc_result_totext(eresult));
+	}
+
+	isc_nmhandle_attach(handle, &loader->handle);
+	isc_nmhandle_cleartimeout(handle);
+	if (!https_mode) {
+		isc_nm_read(handle, load_read, loader);
+	}
+
+	loader->start = isc_time_monotonic();
+	isc_interval_set(&interval, 0, LOAD_TICK);
+	isc_timer_create(loader->loop, load_tick, loader, &loader->timer);
+	isc_timer_start(loader->timer, isc_timertype_ticker, &interval);
+}
+
+static void
+load_connect(void *arg) {
+	struct loader *loader = arg;
+	isc_sockaddr_t *local = have_src ? &srcaddr : &bind_any;
+	unsigned int timeout = default_query.timeout * 1000;
+	isc_nm_proxy_type_t proxy_type = ISC_NM_PROXY_NONE;
+
+	if (proxy_mode) {
+		proxy_type = (tls_mode || https_mode) ? ISC_NM_PROXY_ENCRYPTED
+						      : ISC_NM_PROXY_PLAIN;
+	}
+
+	if (https_mode) {
+#if HAVE_LIBNGHTTP2
+		char uri[4096] = { 0 };
+
+		isc_nm_http_makeuri(true, &dstaddr, NULL, port, https_path,
+				    uri, sizeof(uri));
+		isc_nm_httpconnect(netmgr, local, &dstaddr, uri, true,
+				   load_connected, loader, load_tlsctx, NULL,
+				   load_sess_cache, timeout, proxy_type, NULL);
+#else
+		UNREACHABLE();
+#endif
+	} else if (tls_mode || tcp_mode) {
+		isc_nm_streamdnsconnect(netmgr, local, &dstaddr, load_connected,
+					loader, timeout, load_tlsctx, NULL,
+					load_sess_cache, proxy_type, NULL);
+	} else if (proxy_mode) {
+		isc_nm_proxyudpconnect(netmgr, local, &dstaddr, load_connected,
+				       loader, timeout, NULL);
+	} else {
+		isc_nm_udpconnect(netmgr, local, &dstaddr, load_connected,
+				  loader, timeout);
+	}
+}
+
+static void
+load_setup(void *arg ISC_ATTR_UNUSED) {
+	if (have_ipv4) {
+		isc_sockaddr_any(&bind_any);
+	} else {
+		isc_sockaddr_any6(&bind_any);
+	}
+
+	for (unsigned int i = 0; i < load_loops; i++) {
+		loaders[i].loop = isc_loop_get(loopmgr, i);
+		isc_async_run(loaders[i].loop, load_connect, &loaders[i]);
+	}
+}
+
+/*
+ * Prepare the loaders, each sending its share of the queries per second.
+ */
+static void
+load_prepare(void) {
+	unsigned int i = 0;
+
+	for (struct query *query = ISC_LIST_HEAD(queries); query != NULL;
+	     query = ISC_LIST_NEXT(query, link))
+	{
+		nwirequeries++;
+	}
+	if (nwirequeries == 0) {
+		fatal("no queries to send");
+	}
+	wirequeries = isc_mem_cget(mctx, nwirequeries, sizeof(wirequeries[0]));
+	for (struct query *query = ISC_LIST_HEAD(queries); query != NULL;
+	     query = ISC_LIST_NEXT(query, link))
+	{
+		renderquery(query, &wirequeries[i++]);
+	}
+
+	if (default_query.timeout == 0) {
+		default_query.timeout = tcp_mode || tls_mode || https_mode
+						? TCPTIMEOUT
+						: UDPTIMEOUT;
+	}
+
+	if (tls_mode || https_mode) {
+		isc_result_t result = isc_tlsctx_createclient(&load_tlsctx);
+		CHECK("isc_tlsctx_createclient", result);
+		if (https_mode) {
+#if HAVE_LIBNGHTTP2
+			isc_tlsctx_enable_http2client_alpn(load_tlsctx);
+#endif
+		} else {
+			isc_tlsctx_enable_dot_client_alpn(load_tlsctx);
+		}
+		isc_tlsctx_client_session_cache_create(
+			mctx, load_tlsctx,
+			ISC_TLSCTX_CLIENT_SESSION_CACHE_DEFAULT_SIZE,
+			&load_sess_cache);
+	}
+
+	loaders = isc_mem_cget(mctx, load_loops, sizeof(loaders[0]));
+	for (i = 0; i < load_loops; i++) {
+		struct loader *loader = &loaders[i];
+
+		loader->qps = load_qps / load_loops +
+			      (i < load_qps % load_loops ? 1 : 0);
+		loader->next = i % nwirequeries;
+		loader->nextid = isc_random16();
+		loader->inflight = isc_mem_cget(mctx, LOAD_IDS,
+						sizeof(loader->inflight[0]));
+		isc_histo_create(mctx, LOAD_SIGBITS, &loader->latency);
+	}
+}
+
+/*
+ * Report on the loaders, and free them.
+ */
+static void
+load_report(void) {
+	static const double fractions[] = { 0.5, 0.9, 0.99, 0.999 };
+	uint64_t values[ARRAY_SIZE(fractions)];
+	uint64_t scheduled = 0, sent = 0, received = 0;
+	uint64_t unexpected = 0, failed = 0;
+	uint64_t rcodes[16] = { 0 };
+	isc_histo_t *latency = NULL;
+	isc_result_t result;
+
+	isc_histo_create(mctx, LOAD_SIGBITS, &latency);
+	for (unsigned int i = 0; i < load_loops; i++) {
+		struct loader *loader = &loaders[i];
+
+		scheduled += loader->scheduled;
+		sent += loader->sent;
+		received += loader->received;
+		unexpected += loader->unexpected;
+		failed += loader->failed;
+		for (unsigned int r = 0; r < ARRAY_SIZE(rcodes); r++) {
+			rcodes[r] += loader->rcodes[r];
+		}
+		isc_histo_merge(&latency, loader->latency);
+		isc_histo_destroy(&loader->latency);
+		isc_mem_cput(mctx, loader->inflight, LOAD_IDS,
+			     sizeof(loader->inflight[0]));
+	}
+	isc_mem_cput(mctx, loaders, load_loops, sizeof(loaders[0]));
+
+	printf(";; %" PRIu64 " queries sent in %u s, %.0f queries/s "
+	       "(target %u)\n",
+	       sent, load_duration, (double)sent / load_duration, load_qps);
+	if (scheduled > sent) {
+		printf(";; %" PRIu64 " queries not sent, out of IDs\n",
+		       scheduled - sent);
+	}
+	printf(";; %" PRIu64 " responses received (%.2f%%), %" PRIu64
+	       " lost, %" PRIu64 " unexpected, %" PRIu64 " errors\n",
+	       received, sent > 0 ? 100.0 * received / sent : 0.0,
+	       sent - received, unexpected, failed);
+	for (unsigned int r = 0; r < ARRAY_SIZE(rcodes); r++) {
+		if (rcodes[r] != 0) {
+			printf(";; %-10s %" PRIu64 "\n", rcode_totext(r),
+			       rcodes[r]);
+		}
+	}
+	if (received > 0) {
+		result = isc_histo_quantiles(latency, ARRAY_SIZE(fractions),
+					     fractions, values);
+		CHECK("isc_histo_quantiles", result);
+		printf(";; latency");
+		for (size_t i = 0; i < ARRAY_SIZE(fractions); i++) {
+			printf(" %g%% %.3f ms", fractions[i] * 100,
+			       (double)values[i] / NS_PER_MS);
+		}
+		printf("\n");
+	}
+	isc_histo_destroy(&latency);
+
+	for (unsigned int i = 0; i < nwirequeries; i++) {
+		isc_mem_put(mctx, wirequeries[i].base, wirequeries[i].length);
+	}
+	isc_mem_cput(mctx, wirequeries, nwirequeries, sizeof(wirequeries[0]));
+
+	if (load_sess_cache != NULL) {
+		isc_tlsctx_client_session_cache_detach(&load_sess_cache);
+	}
+	if (load_tlsctx != NULL) {
+		isc_tlsctx_free(&load_tlsctx);
+	}
+}
+
 /*
  * Try honoring the operating system's preferred ephemeral port range.
  */
@@ -2126,7 +2669,7 @@ main(int argc, char *argv[]) {
 
 	preparse_args(argc, argv);
 
-	isc_managers_create(&mctx, 1, &loopmgr, &netmgr);
+	isc_managers_create(&mctx, load_loops, &loopmgr, &netmgr);
 
 	isc_nonce_buf(cookie_secret, sizeof(cookie_secret));
 
@@ -2135,6 +2678,19 @@ main(int argc, char *argv[]) {
 	if (server == NULL) {
 		fatal("a server '@xxx' is required");
 	}
+	if (load_qps == 0 &&
+	    (load_loops > 1 || tls_mode || https_mode || proxy_mode))
+	{
+		fatal("+loops, +tls, +https and +proxy require +qps");
+	}
+	if (tls_mode && https_mode) {
+		fatal("only one of +tls and +https allowed");
+	}
+	if (!port_set && tls_mode) {
+		port = 853;
+	} else if (!port_set && https_mode) {
+		port = 443;
+	}
 
 	ns = 0;
 	result = isc_getaddresses(server, port, &dstaddr, 1, &ns);
@@ -2154,10 +2710,15 @@ main(int argc, char *argv[]) {
 		fatal("can't choose between IPv4 and IPv6");
 	}
 
-	query = ISC_LIST_HEAD(queries);
-	isc_loopmgr_setup(loopmgr, setup, NULL);
-	isc_loopmgr_setup(loopmgr, sendqueries, query);
-	isc_loopmgr_teardown(loopmgr, teardown, NULL);
+	if (load_qps > 0) {
+		load_prepare();
+		isc_loop_setup(isc_loop_main(loopmgr), load_setup, NULL);
+	} else {
+		query = ISC_LIST_HEAD(queries);
+		isc_loopmgr_setup(loopmgr, setup, NULL);
+		isc_loopmgr_setup(loopmgr, sendqueries, query);
+		isc_loopmgr_teardown(loopmgr, teardown, NULL);
+	}
 
 	/*
 	 * Stall to the start of a new second.
@@ -2187,6 +2748,10 @@ main(int argc, char *argv[]) {
 
 	isc_loopmgr_run(loopmgr);
 
+	if (load_qps > 0) {
+		load_report();
+	}
+
 	query = ISC_LIST_HEAD(queries);
 	while (query != NULL) {
 		struct query *next = ISC_LIST_NEXT(query, link);
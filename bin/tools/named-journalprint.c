@@ -28,10 +28,24 @@ const char *progname = NULL;
 
 static void
 usage(void) {
-	fprintf(stderr, "Usage: %s [-dux] journal\n", progname);
+	fprintf(stderr, "Usage: %s [-dux] [-b serial] [-e serial] journal\n",
+		progname);
 	exit(EXIT_FAILURE);
 }
 
+static uint32_t
+parse_serial(const char *arg) {
+	char *endp = NULL;
+	unsigned long serial = strtoul(arg, &endp, 0);
+
+	if (endp == arg || *endp != 0 || serial > UINT32_MAX) {
+		fprintf(stderr, "invalid serial: %s\n", arg);
+		exit(EXIT_FAILURE);
+	}
+
+	return serial;
+}
+
 /*
  * Setup logging to use stderr.
  */
@@ -55,23 +69,26 @@ main(int argc, char **argv) {
 	bool downgrade = false;
 	bool upgrade = false;
 	unsigned int serial = 0;
-	char *endp = NULL;
+	uint32_t begin = 0, end = 0;
 
 	progname = argv[0];
-	while ((ch = isc_commandline_parse(argc, argv, "c:dux")) != -1) {
+	while ((ch = isc_commandline_parse(argc, argv, "b:c:de:ux")) != -1) {
 		switch (ch) {
+		case 'b':
+			flags |= DNS_JOURNAL_PRINTBEGIN;
+			begin = parse_serial(isc_commandline_argument);
+			break;
 		case 'c':
 			compact = true;
-			serial = strtoul(isc_commandline_argument, &endp, 0);
-			if (endp == isc_commandline_argument || *endp != 0) {
-				fprintf(stderr, "invalid serial: %s\n",
-					isc_commandline_argument);
-				exit(EXIT_FAILURE);
-			}
+			serial = parse_serial(isc_commandline_argument);
 			break;
 		case 'd':
 			downgrade = true;
 			break;
+		case 'e':
+			flags |= DNS_JOURNAL_PRINTEND;
+			end = parse_serial(isc_commandline_argument);
+			break;
 		case 'u':
 			upgrade = true;
 			break;
@@ -104,7 +121,10 @@ main(int argc, char **argv) {
 		flags = 0;
 		result = dns_journal_compact(mctx, file, serial, flags, 0);
 	} else {
-		result = dns_journal_print(mctx, flags, file, stdout);
+		/* The output of a large journal is written in big chunks */
+		setvbuf(stdout, NULL, _IOFBF, 64 * 1024);
+		result = dns_journal_printrange(mctx, flags, file, begin, end,
+						stdout);
 		if (result == DNS_R_NOJOURNAL) {
 			fprintf(stderr, "%s\n", isc_result_totext(result));
 		}
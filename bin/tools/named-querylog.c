@@ -0,0 +1,284 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <isc/buffer.h>
+#include <isc/commandline.h>
+#include <isc/netaddr.h>
+#include <isc/result.h>
+#include <isc/sockaddr.h>
+#include <isc/stdio.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#include <dns/compress.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rcode.h>
+#include <dns/rdataclass.h>
+#include <dns/rdatatype.h>
+
+#include <ns/querylog.h>
+
+const char *progname = NULL;
+
+static bool csv = false;
+
+static void
+usage(void) {
+	fprintf(stderr, "Usage: %s [-c] file\n", progname);
+	exit(EXIT_FAILURE);
+}
+
+static void
+flagstotext(uint16_t flags, char *buf, size_t len) {
+	isc_buffer_t b;
+
+	isc_buffer_init(&b, buf, len);
+	isc_buffer_putuint8(&b, (flags & NS_QUERYLOG_FLAG_RECURSION) != 0
+					? '+'
+					: '-');
+	if ((flags & NS_QUERYLOG_FLAG_EDNS) != 0) {
+		isc_buffer_putuint8(&b, 'E');
+	}
+	if ((flags & NS_QUERYLOG_FLAG_SIGNED) != 0) {
+		isc_buffer_putuint8(&b, 'S');
+	}
+	if ((flags & NS_QUERYLOG_FLAG_TCP) != 0) {
+		isc_buffer_putuint8(&b, 'T');
+	}
+	if ((flags & NS_QUERYLOG_FLAG_DO) != 0) {
+		isc_buffer_putuint8(&b, 'D');
+	}
+	if ((flags & NS_QUERYLOG_FLAG_CD) != 0) {
+		isc_buffer_putuint8(&b, 'C');
+	}
+	if ((flags & NS_QUERYLOG_FLAG_COOKIE) != 0) {
+		isc_buffer_putuint8(&b, 'V');
+	} else if ((flags & NS_QUERYLOG_FLAG_NEWCOOKIE) != 0) {
+		isc_buffer_putuint8(&b, 'K');
+	}
+	isc_buffer_putuint8(&b, 0);
+}
+
+/*
+ * Print a CSV field in double quotes, doubling the quotes in it.
+ */
+static void
+printquoted(const char *s) {
+	putchar('"');
+	for (; *s != '\0'; s++) {
+		if (*s == '"') {
+			putchar('"');
+		}
+		putchar(*s);
+	}
+	putchar('"');
+}
+
+static isc_result_t
+printrecord(isc_buffer_t *b) {
+	isc_result_t result;
+	dns_fixedname_t fixed;
+	dns_name_t *qname = dns_fixedname_initname(&fixed);
+	isc_netaddr_t netaddr;
+	isc_sockaddr_t sockaddr;
+	isc_time_t when;
+	char timebuf[64];
+	char namebuf[DNS_NAME_FORMATSIZE];
+	char typebuf[DNS_RDATATYPE_FORMATSIZE];
+	char classbuf[DNS_RDATACLASS_FORMATSIZE];
+	char addrbuf[ISC_SOCKADDR_FORMATSIZE];
+	char rcodebuf[64];
+	char flagsbuf[sizeof("+ESTDCV")];
+	isc_buffer_t rcodeb;
+	uint32_t seconds, nanoseconds, latency;
+	uint16_t flags, qtype, qclass, rcode, port;
+	unsigned char addr[16];
+	uint8_t family;
+
+	if (isc_buffer_remaininglength(b) < NS_QUERYLOG_RECORDSIZE) {
+		return ISC_R_UNEXPECTEDEND;
+	}
+
+	seconds = isc_buffer_getuint32(b);
+	nanoseconds = isc_buffer_getuint32(b);
+	latency = isc_buffer_getuint32(b);
+	flags = isc_buffer_getuint16(b);
+	qtype = isc_buffer_getuint16(b);
+	qclass = isc_buffer_getuint16(b);
+	rcode = isc_buffer_getuint16(b);
+	port = isc_buffer_getuint16(b);
+	family = isc_buffer_getuint8(b);
+
+	switch (family) {
+	case 4:
+		if (isc_buffer_remaininglength(b) < 4) {
+			return ISC_R_UNEXPECTEDEND;
+		}
+		memmove(addr, isc_buffer_current(b), 4);
+		isc_buffer_forward(b, 4);
+		isc_netaddr_fromin(&netaddr, (struct in_addr *)addr);
+		break;
+	case 6:
+		if (isc_buffer_remaininglength(b) < 16) {
+			return ISC_R_UNEXPECTEDEND;
+		}
+		memmove(addr, isc_buffer_current(b), 16);
+		isc_buffer_forward(b, 16);
+		isc_netaddr_fromin6(&netaddr, (struct in6_addr *)addr);
+		break;
+	default:
+		return ISC_R_FAMILYNOSUPPORT;
+	}
+	isc_sockaddr_fromnetaddr(&sockaddr, &netaddr, port);
+
+	result = dns_name_fromwire(qname, b, DNS_DECOMPRESS_NEVER, NULL);
+	if (result != ISC_R_SUCCESS) {
+		return result;
+	}
+
+	isc_time_set(&when, seconds, nanoseconds);
+	dns_name_format(qname, namebuf, sizeof(namebuf));
+	dns_rdatatype_format(qtype, typebuf, sizeof(typebuf));
+	dns_rdataclass_format(qclass, classbuf, sizeof(classbuf));
+	flagstotext(flags, flagsbuf, sizeof(flagsbuf));
+
+	isc_buffer_init(&rcodeb, rcodebuf, sizeof(rcodebuf) - 1);
+	result = dns_rcode_totext(rcode, &rcodeb);
+	if (result != ISC_R_SUCCESS) {
+		return result;
+	}
+	isc_buffer_putuint8(&rcodeb, 0);
+
+	if (csv) {
+		isc_netaddr_format(&netaddr, addrbuf, sizeof(addrbuf));
+		isc_time_formatISO8601us(&when, timebuf, sizeof(timebuf));
+		printf("%s,%s,%u,", timebuf, addrbuf, port);
+		printquoted(namebuf);
+		printf(",%s,%s,%s,%s,%" PRIu32 "\n", classbuf, typebuf,
+		       flagsbuf, rcodebuf, latency);
+	} else {
+		isc_sockaddr_format(&sockaddr, addrbuf, sizeof(addrbuf));
+		isc_time_formattimestamp(&when, timebuf, sizeof(timebuf));
+		printf("%s client %s: query: %s %s %s %s %s %" PRIu32 "us\n",
+		       timebuf, addrbuf, namebuf, classbuf, typebuf, flagsbuf,
+		       rcodebuf, latency);
+	}
+
+	return ISC_R_SUCCESS;
+}
+
+static isc_result_t
+printfile(const char *filename) {
+	isc_result_t result;
+	FILE *fp = NULL;
+	unsigned char header[6];
+	unsigned char data[UINT16_MAX];
+	isc_buffer_t b;
+	uint16_t length;
+
+	result = isc_stdio_open(filename, "rb", &fp);
+	if (result != ISC_R_SUCCESS) {
+		fprintf(stderr, "%s: %s\n", filename,
+			isc_result_totext(result));
+		return result;
+	}
+
+	result = isc_stdio_read(header, sizeof(header), 1, fp, NULL);
+	if (result != ISC_R_SUCCESS ||
+	    memcmp(header, NS_QUERYLOG_MAGIC, 4) != 0)
+	{
+		fprintf(stderr, "%s: not a binary query log\n", filename);
+		result = DNS_R_FORMERR;
+		goto cleanup;
+	}
+	if ((header[4] << 8 | header[5]) != NS_QUERYLOG_VERSION) {
+		fprintf(stderr, "%s: unsupported version %u\n", filename,
+			header[4] << 8 | header[5]);
+		result = ISC_R_NOTIMPLEMENTED;
+		goto cleanup;
+	}
+
+	if (csv) {
+		printf("time,client,port,qname,qclass,qtype,flags,rcode,"
+		       "latency\n");
+	}
+
+	for (;;) {
+		result = isc_stdio_read(data, 2, 1, fp, NULL);
+		if (result == ISC_R_EOF) {
+			result = ISC_R_SUCCESS;
+			break;
+		} else if (result != ISC_R_SUCCESS) {
+			break;
+		}
+
+		length = data[0] << 8 | data[1];
+		result = isc_stdio_read(data, length, 1, fp, NULL);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+
+		isc_buffer_init(&b, data, length);
+		isc_buffer_add(&b, length);
+		result = printrecord(&b);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+	}
+
+	if (result != ISC_R_SUCCESS) {
+		fprintf(stderr, "%s: bad record: %s\n", filename,
+			isc_result_totext(result));
+	}
+
+cleanup:
+	(void)isc_stdio_close(fp);
+	return result;
+}
+
+int
+main(int argc, char **argv) {
+	isc_result_t result;
+	int ch;
+
+	progname = argv[0];
+	while ((ch = isc_commandline_parse(argc, argv, "c")) != -1) {
+		switch (ch) {
+		case 'c':
+			csv = true;
+			break;
+		default:
+			usage();
+		}
+	}
+
+	argc -= isc_commandline_index;
+	argv += isc_commandline_index;
+
+	if (argc != 1) {
+		usage();
+	}
+
+	result = printfile(argv[0]);
+
+	return result != ISC_R_SUCCESS ? 1 : 0;
+}
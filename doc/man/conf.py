@@ -181,6 +181,13 @@ man_pages = [
         author,
         1,
     ),
+    (
+        "named-querylog",
+        "named-querylog",
+        "print a binary query log in human-readable form",
+        author,
+        1,
+    ),
     (
         "named-rrchecker",
         "named-rrchecker",
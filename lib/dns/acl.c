@@ -676,6 +676,7 @@ dns_aclenv_set(dns_aclenv_t *env, dns_acl_t *localhost, dns_acl_t *localnets) {
 	 * possibly destroy the acl objects.
 	 */
 	synchronize_rcu();
+	atomic_fetch_add_release(&env->generation, 1);
 
 	dns_acl_detach(&localhost);
 	dns_acl_detach(&localnets);
@@ -710,6 +711,7 @@ dns_aclenv_copy(dns_aclenv_t *target, dns_aclenv_t *source) {
 	 * See the comment above in dns_aclenv_set() for more detail.
 	 */
 	synchronize_rcu();
+	atomic_fetch_add_release(&target->generation, 1);
 
 	target->match_mapped = source->match_mapped;
 #if defined(HAVE_GEOIP2)
@@ -19,8 +19,10 @@
 
 #include <isc/async.h>
 #include <isc/atomic.h>
+#include <isc/buffer.h>
+#include <isc/file.h>
 #include <isc/hash.h>
-#include <isc/hashmap.h>
+#include <isc/histo.h>
 #include <isc/list.h>
 #include <isc/log.h>
 #include <isc/loop.h>
@@ -30,8 +32,10 @@
 #include <isc/result.h>
 #include <isc/rwlock.h>
 #include <isc/stats.h>
+#include <isc/stdio.h>
 #include <isc/string.h>
 #include <isc/tid.h>
+#include <isc/urcu.h>
 #include <isc/util.h>
 
 #include <dns/adb.h>
@@ -69,6 +73,9 @@
 #define ADB_HASH_BITS 12
 #endif /* ifndef ADB_HASH_BITS */
 
+#define ADB_HASH_INIT_SIZE (1 << ADB_HASH_BITS) /* Must be power of 2 */
+#define ADB_HASH_MIN_SIZE  (1 << 8)		/* Must be power of 2 */
+
 /*%
  * The period in seconds after which an ADB name entry is regarded as stale
  * and forced to be cleaned up.
@@ -80,6 +87,57 @@
 
 #define DNS_ADB_MINADBSIZE (1024U * 1024U) /*%< 1 Megabyte */
 
+/*%
+ * Each entry keeps a histogram of the round trip times measured for the
+ * server, with a 12.5% precision.  The ADB_RTTHISTO_QUANTILE of it is
+ * recomputed every ADB_RTTHISTO_UPDATE samples, once there are at least
+ * ADB_RTTHISTO_MINSAMPLES.  The histogram is restarted after
+ * ADB_RTTHISTO_WINDOW samples so that it follows the changes in the
+ * server's latency; until the new one has enough samples, the quantile
+ * of the old one is used.
+ */
+#define ADB_RTTHISTO_SIGBITS	3
+#define ADB_RTTHISTO_MINSAMPLES 32
+#define ADB_RTTHISTO_UPDATE	16
+#define ADB_RTTHISTO_WINDOW	1024
+#define ADB_RTTHISTO_QUANTILE	0.95
+
+/*
+ * The ADB state file format.  All the integers are in network byte
+ * order.  The file starts with:
+ *
+ *	uint32	ADBSTATE_MAGIC
+ *	uint32	ADBSTATE_VERSION
+ *	uint32	the time the state was saved
+ *
+ * and is followed by one record for each server address:
+ *
+ *	uint8	the address family, 4 or 6
+ *	uint16	port
+ *	4 or 16 bytes of the address
+ *	uint32	SRTT
+ *	uint32	entry flags
+ *	uint16	EDNS UDP size
+ *	uint8	EDNS responses, EDNS timeouts, plain responses and plain
+ *		timeouts (four counters)
+ *	uint8	length of the cookie, followed by the cookie
+ *
+ * When the state is loaded, the SRTT and the counters are halved for each
+ * ADBSTATE_HALFLIFE seconds since it was saved; the flags and the cookie
+ * are only restored within the first half-life.  A state saved more than
+ * ADB_CACHE_MAXIMUM seconds ago is ignored.
+ */
+#define ADBSTATE_MAGIC	  ISC_MAGIC('A', 'S', 'n', 'p')
+#define ADBSTATE_VERSION  1
+#define ADBSTATE_HALFLIFE ADB_STALE_MARGIN
+
+#define CHECK(op)                            \
+	do {                                 \
+		result = (op);               \
+		if (result != ISC_R_SUCCESS) \
+			goto cleanup;        \
+	} while (0)
+
 typedef ISC_LIST(dns_adbname_t) dns_adbnamelist_t;
 typedef struct dns_adbnamehook dns_adbnamehook_t;
 typedef ISC_LIST(dns_adbnamehook_t) dns_adbnamehooklist_t;
@@ -93,24 +151,31 @@ struct dns_adb {
 
 	isc_mutex_t lock;
 	isc_mem_t *mctx;
-	isc_mem_t *hmctx;
 	dns_view_t *view;
 	dns_resolver_t *res;
 
 	isc_refcount_t references;
 
+	/*
+	 * The names and entries are looked up in RCU hash tables without
+	 * any lock; the rwlocks are only ever write locked, to serialize
+	 * the creation and the expiry of the names and entries, and the
+	 * LRU list maintenance.
+	 */
 	dns_adbnamelist_t names_lru;
-	isc_stdtime_t names_last_update;
-	isc_hashmap_t *names;
+	_Atomic(isc_stdtime_t) names_last_update;
+	struct cds_lfht *names;
 	isc_rwlock_t names_lock;
 
 	dns_adbentrylist_t entries_lru;
-	isc_stdtime_t entries_last_update;
-	isc_hashmap_t *entries;
+	_Atomic(isc_stdtime_t) entries_last_update;
+	struct cds_lfht *entries;
 	isc_rwlock_t entries_lock;
 
 	isc_stats_t *stats;
 
+	isc_mempool_t *findpool; /* shared by the loops */
+
 	atomic_bool exiting;
 
 	uint32_t quota;
@@ -133,10 +198,12 @@ struct dns_adbname {
 	unsigned int magic;
 	isc_refcount_t references;
 	dns_adb_t *adb;
+	isc_mem_t *mctx;
 	dns_fixedname_t fname;
 	dns_name_t *name;
 	unsigned int partial_result;
 	unsigned int flags;
+	bool dead;
 	dns_name_t target;
 	isc_stdtime_t expire_target;
 	isc_stdtime_t expire_v4;
@@ -153,6 +220,9 @@ struct dns_adbname {
 	/* for LRU-based management */
 
 	ISC_LINK(dns_adbname_t) link;
+
+	struct cds_lfht_node ht_node;
+	struct rcu_head rcu_head;
 };
 
 #if DNS_ADB_TRACE
@@ -208,6 +278,7 @@ struct dns_adbentry {
 	unsigned int magic;
 
 	dns_adb_t *adb;
+	isc_mem_t *mctx;
 
 	isc_mutex_t lock;
 	isc_stdtime_t last_used;
@@ -244,7 +315,19 @@ struct dns_adbentry {
 	 * entry.
 	 */
 
+	/*%
+	 * The measured round trip times, locked by 'lock', and their
+	 * ADB_RTTHISTO_QUANTILE, which is zero until enough of them have
+	 * been measured.
+	 */
+	isc_histo_t *rtthisto;
+	unsigned int rttsamples;
+	atomic_uint rtthigh;
+
 	ISC_LINK(dns_adbentry_t) link;
+
+	struct cds_lfht_node ht_node;
+	struct rcu_head rcu_head;
 };
 
 #if DNS_ADB_TRACE
@@ -268,8 +351,8 @@ static dns_adbname_t *
 new_adbname(dns_adb_t *adb, const dns_name_t *, unsigned int flags);
 static void
 destroy_adbname(dns_adbname_t *);
-static bool
-match_adbname(void *node, const void *key);
+static int
+match_adbname(struct cds_lfht_node *ht_node, const void *key);
 static uint32_t
 hash_adbname(const dns_adbname_t *adbname);
 static dns_adbnamehook_t *
@@ -280,8 +363,8 @@ static dns_adbentry_t *
 new_adbentry(dns_adb_t *adb, const isc_sockaddr_t *addr, isc_stdtime_t now);
 static void
 destroy_adbentry(dns_adbentry_t *entry);
-static bool
-match_adbentry(void *node, const void *key);
+static int
+match_adbentry(struct cds_lfht_node *ht_node, const void *key);
 static dns_adbfind_t *
 new_adbfind(dns_adb_t *, in_port_t);
 static void
@@ -346,6 +429,8 @@ static void
 adjustsrtt(dns_adbaddrinfo_t *addr, unsigned int rtt, unsigned int factor,
 	   isc_stdtime_t now);
 static void
+record_rtt(dns_adbentry_t *entry, unsigned int rtt);
+static void
 log_quota(dns_adbentry_t *entry, const char *fmt, ...) ISC_FORMAT_PRINTF(2, 3);
 
 static bool
@@ -365,12 +450,11 @@ enum {
 #define FIND_EVENTSENT(h) (((h)->flags & FIND_EVENT_SENT) != 0)
 
 /*
- * Private flag(s) for adbname objects.
+ * The adbname flags are not changed after the name has been created, as
+ * they are part of the key matched by the lock-free lookups; whether the
+ * name is dead is kept separately, under the name lock.
  */
-enum {
-	NAME_IS_DEAD = 1 << 31,
-};
-#define NAME_DEAD(n) (((n)->flags & NAME_IS_DEAD) != 0)
+#define NAME_DEAD(n) ((n)->dead)
 
 /*
  * Private flag(s) for adbentry objects.  Note that these will also
@@ -641,18 +725,11 @@ import_rdataset(dns_adbname_t *adbname, dns_rdataset_t *rdataset,
 	return ISC_R_SUCCESS;
 }
 
-static bool
-match_ptr(void *node, const void *key) {
-	return node == key;
-}
-
 /*
  * Requires the name to be locked.
  */
 static void
 expire_name(dns_adbname_t *adbname, dns_adbstatus_t astat) {
-	isc_result_t result;
-
 	REQUIRE(DNS_ADBNAME_VALID(adbname));
 
 	dns_adb_t *adb = adbname->adb;
@@ -679,14 +756,14 @@ expire_name(dns_adbname_t *adbname, dns_adbstatus_t astat) {
 		dns_resolver_cancelfetch(adbname->fetch_aaaa->fetch);
 	}
 
-	adbname->flags |= NAME_IS_DEAD;
+	adbname->dead = true;
 
 	/*
 	 * Remove the adbname from the hashtable...
 	 */
-	result = isc_hashmap_delete(adb->names, hash_adbname(adbname),
-				    match_ptr, adbname);
-	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	rcu_read_lock();
+	RUNTIME_CHECK(!cds_lfht_del(adb->names, &adbname->ht_node));
+	rcu_read_unlock();
 	/* ... and LRU list */
 	ISC_LIST_UNLINK(adb->names_lru, adbname, link);
 
@@ -770,7 +847,11 @@ shutdown_entries(dns_adb_t *adb) {
 	     adbentry != NULL; adbentry = next)
 	{
 		next = ISC_LIST_NEXT(adbentry, link);
+		dns_adbentry_ref(adbentry);
+		LOCK(&adbentry->lock);
 		expire_entry(adbentry);
+		UNLOCK(&adbentry->lock);
+		dns_adbentry_detach(&adbentry);
 	}
 	RWUNLOCK(&adb->entries_lock, isc_rwlocktype_write);
 }
@@ -979,6 +1060,7 @@ new_adbname(dns_adb_t *adb, const dns_name_t *dnsname, unsigned int flags) {
 #endif
 	isc_refcount_init(&name->references, 1);
 
+	isc_mem_attach(adb->mctx, &name->mctx);
 	isc_mutex_init(&name->lock);
 
 	name->name = dns_fixedname_initname(&name->fname);
@@ -995,6 +1077,15 @@ ISC_REFCOUNT_TRACE_IMPL(dns_adbname, destroy_adbname);
 ISC_REFCOUNT_IMPL(dns_adbname, destroy_adbname);
 #endif
 
+static void
+free_adbname_rcu(struct rcu_head *rcu_head) {
+	dns_adbname_t *name = caa_container_of(rcu_head, dns_adbname_t,
+					       rcu_head);
+
+	isc_mutex_destroy(&name->lock);
+	isc_mem_putanddetach(&name->mctx, name, sizeof(*name));
+}
+
 static void
 destroy_adbname(dns_adbname_t *name) {
 	REQUIRE(DNS_ADBNAME_VALID(name));
@@ -1009,9 +1100,11 @@ destroy_adbname(dns_adbname_t *name) {
 
 	name->magic = 0;
 
-	isc_mutex_destroy(&name->lock);
-
-	isc_mem_put(adb->mctx, name, sizeof(*name));
+	/*
+	 * The lock-free readers might still be looking at the name,
+	 * so it can only be freed after the RCU grace period.
+	 */
+	call_rcu(&name->rcu_head, free_adbname_rcu);
 
 	dec_adbstats(adb, dns_adbstats_namescnt);
 	dns_adb_detach(&adb);
@@ -1067,6 +1160,7 @@ new_adbentry(dns_adb_t *adb, const isc_sockaddr_t *addr, isc_stdtime_t now) {
 	fprintf(stderr, "dns_adbentry__init:%s:%s:%d:%p->references = 1\n",
 		__func__, __FILE__, __LINE__ + 1, entry);
 #endif
+	isc_mem_attach(adb->mctx, &entry->mctx);
 	isc_mutex_init(&entry->lock);
 
 	inc_adbstats(adb, dns_adbstats_entriescnt);
@@ -1074,6 +1168,18 @@ new_adbentry(dns_adb_t *adb, const isc_sockaddr_t *addr, isc_stdtime_t now) {
 	return entry;
 }
 
+static void
+free_adbentry_rcu(struct rcu_head *rcu_head) {
+	dns_adbentry_t *entry = caa_container_of(rcu_head, dns_adbentry_t,
+						 rcu_head);
+
+	if (entry->rtthisto != NULL) {
+		isc_histo_destroy(&entry->rtthisto);
+	}
+	isc_mutex_destroy(&entry->lock);
+	isc_mem_putanddetach(&entry->mctx, entry, sizeof(*entry));
+}
+
 static void
 destroy_adbentry(dns_adbentry_t *entry) {
 	REQUIRE(DNS_ADBENTRY_VALID(entry));
@@ -1094,8 +1200,11 @@ destroy_adbentry(dns_adbentry_t *entry) {
 		isc_mem_put(adb->mctx, entry->cookie, entry->cookielen);
 	}
 
-	isc_mutex_destroy(&entry->lock);
-	isc_mem_put(adb->mctx, entry, sizeof(*entry));
+	/*
+	 * The sockaddr might still be compared by the lock-free readers,
+	 * so the entry can only be freed after the RCU grace period.
+	 */
+	call_rcu(&entry->rcu_head, free_adbentry_rcu);
 
 	dec_adbstats(adb, dns_adbstats_entriescnt);
 
@@ -1112,7 +1221,7 @@ static dns_adbfind_t *
 new_adbfind(dns_adb_t *adb, in_port_t port) {
 	dns_adbfind_t *find = NULL;
 
-	find = isc_mem_get(adb->mctx, sizeof(*find));
+	find = isc_mempool_get(adb->findpool);
 	*find = (dns_adbfind_t){
 		.port = port,
 		.result_v4 = ISC_R_UNEXPECTED,
@@ -1151,7 +1260,7 @@ free_adbfind(dns_adbfind_t **findp) {
 
 	isc_mutex_destroy(&find->lock);
 
-	isc_mem_put(adb->mctx, find, sizeof(*find));
+	isc_mempool_put(adb->findpool, find);
 	dns_adb_detach(&adb);
 }
 
@@ -1197,6 +1306,7 @@ new_adbaddrinfo(dns_adb_t *adb, dns_adbentry_t *entry, in_port_t port) {
 	ai = isc_mem_get(adb->mctx, sizeof(*ai));
 	*ai = (dns_adbaddrinfo_t){
 		.srtt = atomic_load(&entry->srtt),
+		.rtthigh = atomic_load_relaxed(&entry->rtthigh),
 		.flags = atomic_load(&entry->flags),
 		.publink = ISC_LINK_INITIALIZER,
 		.sockaddr = entry->sockaddr,
@@ -1230,9 +1340,10 @@ free_adbaddrinfo(dns_adb_t *adb, dns_adbaddrinfo_t **ainfo) {
 	isc_mem_put(adb->mctx, ai, sizeof(*ai));
 }
 
-static bool
-match_adbname(void *node, const void *key) {
-	const dns_adbname_t *adbname0 = node;
+static int
+match_adbname(struct cds_lfht_node *ht_node, const void *key) {
+	const dns_adbname_t *adbname0 = caa_container_of(
+		ht_node, dns_adbname_t, ht_node);
 	const dns_adbname_t *adbname1 = key;
 
 	if ((adbname0->flags & ADBNAME_FLAGS_MASK) !=
@@ -1256,102 +1367,141 @@ hash_adbname(const dns_adbname_t *adbname) {
 	return isc_hash32_finalize(&hash);
 }
 
+/*
+ * Caller must be in a RCU read-side critical section.
+ */
+static dns_adbname_t *
+lookup_adbname(dns_adb_t *adb, uint32_t hashval, const dns_adbname_t *key) {
+	struct cds_lfht_iter iter;
+
+	cds_lfht_lookup(adb->names, hashval, match_adbname, key, &iter);
+
+	return cds_lfht_entry(cds_lfht_iter_get_node(&iter), dns_adbname_t,
+			      ht_node);
+}
+
+/*
+ * Take a reference to a name or an entry found without holding any
+ * lock.  This fails if the last reference is already gone, and the object
+ * is only waiting for the RCU grace period to be freed.
+ */
+static bool
+tryref(isc_refcount_t *references) {
+	uint_fast32_t refs = isc_refcount_current(references);
+
+	do {
+		if (refs == 0) {
+			return false;
+		}
+	} while (!atomic_compare_exchange_weak_acq_rel(references, &refs,
+						       refs + 1));
+
+	return true;
+}
+
+/*
+ * The lock-free lookups can't purge the stale names and entries, so they
+ * leave that to the locked lookups when the memory is tight or when
+ * nothing has been purged for too long.
+ */
+static bool
+lockfree_ok(dns_adb_t *adb, _Atomic(isc_stdtime_t) *last_updatep,
+	    isc_stdtime_t now) {
+	return now - atomic_load_relaxed(last_updatep) <= ADB_STALE_MARGIN &&
+	       !isc_mem_isovermem(adb->mctx);
+}
+
 /*
  * Search for the name in the hash table.
  */
 static dns_adbname_t *
 get_attached_and_locked_name(dns_adb_t *adb, const dns_name_t *name,
 			     unsigned int flags, isc_stdtime_t now) {
-	isc_result_t result;
 	dns_adbname_t *adbname = NULL;
-	isc_time_t timenow;
-	isc_stdtime_t last_update;
 	dns_adbname_t key = {
 		.name = UNCONST(name),
 		.flags = flags & ADBNAME_FLAGS_MASK,
 	};
 	uint32_t hashval = hash_adbname(&key);
-	isc_rwlocktype_t locktype = isc_rwlocktype_read;
 
-	isc_time_set(&timenow, now, 0);
-
-	RWLOCK(&adb->names_lock, locktype);
-	last_update = adb->names_last_update;
+	/*
+	 * Try the lock-free lookup first; it can only be used when the
+	 * name exists and doesn't need its place in the LRU list updated.
+	 */
+	if (lockfree_ok(adb, &adb->names_last_update, now)) {
+		rcu_read_lock();
+		adbname = lookup_adbname(adb, hashval, &key);
+		if (adbname != NULL && !tryref(&adbname->references)) {
+			adbname = NULL;
+		}
+		rcu_read_unlock();
+	}
 
-	if (last_update + ADB_STALE_MARGIN >= now ||
-	    isc_mem_isovermem(adb->mctx))
-	{
-		last_update = now;
-		UPGRADELOCK(&adb->names_lock, locktype);
-		purge_stale_names(adb, now);
-		adb->names_last_update = last_update;
+	if (adbname != NULL) {
+		LOCK(&adbname->lock);
+		if (!NAME_DEAD(adbname) &&
+		    adbname->last_used + ADB_CACHE_MINIMUM > now)
+		{
+			return adbname; /* Must be unlocked by the caller */
+		}
+		UNLOCK(&adbname->lock);
+		dns_adbname_detach(&adbname);
 	}
 
-	result = isc_hashmap_find(adb->names, hashval, match_adbname,
-				  (void *)&key, (void **)&adbname);
-	switch (result) {
-	case ISC_R_NOTFOUND:
-		UPGRADELOCK(&adb->names_lock, locktype);
+	RWLOCK(&adb->names_lock, isc_rwlocktype_write);
+	purge_stale_names(adb, now);
+	atomic_store_relaxed(&adb->names_last_update, now);
+
+	rcu_read_lock();
+	adbname = lookup_adbname(adb, hashval, &key);
+	rcu_read_unlock();
 
+	if (adbname == NULL) {
 		/* Allocate a new name and add it to the hash table. */
 		adbname = new_adbname(adb, name, key.flags);
-
-		void *found = NULL;
-		result = isc_hashmap_add(adb->names, hashval, match_adbname,
-					 (void *)&key, adbname, &found);
-		if (result == ISC_R_EXISTS) {
-			destroy_adbname(adbname);
-			adbname = found;
-			result = ISC_R_SUCCESS;
-			ISC_LIST_UNLINK(adb->names_lru, adbname, link);
-		}
-		INSIST(result == ISC_R_SUCCESS);
-
-		break;
-	case ISC_R_SUCCESS:
-		if (locktype == isc_rwlocktype_write) {
-			ISC_LIST_UNLINK(adb->names_lru, adbname, link);
-		}
-		break;
-	default:
-		UNREACHABLE();
+		cds_lfht_add(adb->names, hashval, &adbname->ht_node);
+	} else {
+		ISC_LIST_UNLINK(adb->names_lru, adbname, link);
 	}
 
 	dns_adbname_ref(adbname);
 
 	LOCK(&adbname->lock); /* Must be unlocked by the caller */
-	if (adbname->last_used + ADB_CACHE_MINIMUM <= last_update) {
+	if (adbname->last_used + ADB_CACHE_MINIMUM <= now) {
 		adbname->last_used = now;
 	}
-	if (locktype == isc_rwlocktype_write) {
-		ISC_LIST_PREPEND(adb->names_lru, adbname, link);
-	}
+	ISC_LIST_PREPEND(adb->names_lru, adbname, link);
 
 	/*
 	 * The refcount is now 2 and the final detach will happen in
 	 * expire_name() - the unused adbname stored in the hashtable and lru
 	 * has always refcount == 1
 	 */
-	RWUNLOCK(&adb->names_lock, locktype);
+	RWUNLOCK(&adb->names_lock, isc_rwlocktype_write);
 
 	return adbname;
 }
 
-static void
-upgrade_entries_lock(dns_adb_t *adb, isc_rwlocktype_t *locktypep,
-		     isc_stdtime_t now) {
-	if (*locktypep == isc_rwlocktype_read) {
-		UPGRADELOCK(&adb->entries_lock, *locktypep);
-		purge_stale_entries(adb, now);
-		adb->entries_last_update = now;
-	}
+static int
+match_adbentry(struct cds_lfht_node *ht_node, const void *key) {
+	const dns_adbentry_t *adbentry = caa_container_of(
+		ht_node, dns_adbentry_t, ht_node);
+
+	return isc_sockaddr_equal(&adbentry->sockaddr, key);
 }
 
-static bool
-match_adbentry(void *node, const void *key) {
-	dns_adbentry_t *adbentry = node;
+/*
+ * Caller must be in a RCU read-side critical section.
+ */
+static dns_adbentry_t *
+lookup_adbentry(dns_adb_t *adb, uint32_t hashval,
+		const isc_sockaddr_t *addr) {
+	struct cds_lfht_iter iter;
 
-	return isc_sockaddr_equal(&adbentry->sockaddr, key);
+	cds_lfht_lookup(adb->entries, hashval, match_adbentry, addr, &iter);
+
+	return cds_lfht_entry(cds_lfht_iter_get_node(&iter), dns_adbentry_t,
+			      ht_node);
 }
 
 /*
@@ -1360,89 +1510,73 @@ match_adbentry(void *node, const void *key) {
 static dns_adbentry_t *
 get_attached_and_locked_entry(dns_adb_t *adb, isc_stdtime_t now,
 			      const isc_sockaddr_t *addr) {
-	isc_result_t result;
 	dns_adbentry_t *adbentry = NULL;
-	isc_time_t timenow;
-	isc_stdtime_t last_update;
 	uint32_t hashval = isc_sockaddr_hash(addr, true);
-	isc_rwlocktype_t locktype = isc_rwlocktype_read;
-
-	isc_time_set(&timenow, now, 0);
-
-	RWLOCK(&adb->entries_lock, locktype);
-	last_update = adb->entries_last_update;
-
-	if (now - last_update > ADB_STALE_MARGIN ||
-	    isc_mem_isovermem(adb->mctx))
-	{
-		last_update = now;
 
-		upgrade_entries_lock(adb, &locktype, now);
+	/*
+	 * Try the lock-free lookup first; it can only be used when the
+	 * entry exists, is not expired and doesn't need its place in the
+	 * LRU list updated.
+	 */
+	if (lockfree_ok(adb, &adb->entries_last_update, now)) {
+		rcu_read_lock();
+		adbentry = lookup_adbentry(adb, hashval, addr);
+		if (adbentry != NULL && !tryref(&adbentry->references)) {
+			adbentry = NULL;
+		}
+		rcu_read_unlock();
 	}
 
-	result = isc_hashmap_find(adb->entries, hashval, match_adbentry,
-				  (const unsigned char *)addr,
-				  (void **)&adbentry);
-	if (result == ISC_R_NOTFOUND) {
-		upgrade_entries_lock(adb, &locktype, now);
+	if (adbentry != NULL) {
+		LOCK(&adbentry->lock);
+		if (!ENTRY_DEAD(adbentry) && !entry_expired(adbentry, now) &&
+		    adbentry->last_used + ADB_CACHE_MINIMUM > now)
+		{
+			return adbentry; /* Must be unlocked by the caller */
+		}
+		UNLOCK(&adbentry->lock);
+		dns_adbentry_detach(&adbentry);
+	}
 
-	create:
-		INSIST(locktype == isc_rwlocktype_write);
+	RWLOCK(&adb->entries_lock, isc_rwlocktype_write);
+	purge_stale_entries(adb, now);
+	atomic_store_relaxed(&adb->entries_last_update, now);
 
-		/* Allocate a new entry and add it to the hash table. */
-		adbentry = new_adbentry(adb, addr, now);
+	rcu_read_lock();
+	adbentry = lookup_adbentry(adb, hashval, addr);
+	rcu_read_unlock();
 
-		void *found = NULL;
-		result = isc_hashmap_add(adb->entries, hashval, match_adbentry,
-					 &adbentry->sockaddr, adbentry, &found);
-		if (result == ISC_R_SUCCESS) {
-			ISC_LIST_PREPEND(adb->entries_lru, adbentry, link);
-		} else if (result == ISC_R_EXISTS) {
+	if (adbentry != NULL) {
+		/*
+		 * The dns_adbentry_ref() must stay here before trying to
+		 * expire the ADB entry, so it is not destroyed under the lock.
+		 */
+		dns_adbentry_ref(adbentry);
+		LOCK(&adbentry->lock); /* Must be unlocked by the caller */
+		if (maybe_expire_entry(adbentry, now)) {
+			UNLOCK(&adbentry->lock);
 			dns_adbentry_detach(&adbentry);
-			adbentry = found;
-			result = ISC_R_SUCCESS;
 		}
 	}
-	INSIST(result == ISC_R_SUCCESS);
 
-	/*
-	 * The dns_adbentry_ref() must stay here before trying to expire
-	 * the ADB entry, so it is not destroyed under the lock.
-	 */
-	dns_adbentry_ref(adbentry);
-	LOCK(&adbentry->lock); /* Must be unlocked by the caller */
-	switch (locktype) {
-	case isc_rwlocktype_read:
-		if (!entry_expired(adbentry, now)) {
-			break;
-		}
+	if (adbentry == NULL) {
+		/* Allocate a new entry and add it to the hash table. */
+		adbentry = new_adbentry(adb, addr, now);
+		cds_lfht_add(adb->entries, hashval, &adbentry->ht_node);
+		ISC_LIST_PREPEND(adb->entries_lru, adbentry, link);
 
-		/* We need to upgrade the LRU lock */
-		UNLOCK(&adbentry->lock);
-		upgrade_entries_lock(adb, &locktype, now);
-		LOCK(&adbentry->lock);
-		FALLTHROUGH;
-	case isc_rwlocktype_write:
-		if (ENTRY_DEAD(adbentry) || maybe_expire_entry(adbentry, now)) {
-			UNLOCK(&adbentry->lock);
-			dns_adbentry_detach(&adbentry);
-			goto create;
-		}
-		break;
-	default:
-		UNREACHABLE();
+		dns_adbentry_ref(adbentry);
+		LOCK(&adbentry->lock); /* Must be unlocked by the caller */
 	}
 
 	/* Did enough time pass to update the LRU? */
-	if (adbentry->last_used + ADB_CACHE_MINIMUM <= last_update) {
+	if (adbentry->last_used + ADB_CACHE_MINIMUM <= now) {
 		adbentry->last_used = now;
-		if (locktype == isc_rwlocktype_write) {
-			ISC_LIST_UNLINK(adb->entries_lru, adbentry, link);
-			ISC_LIST_PREPEND(adb->entries_lru, adbentry, link);
-		}
+		ISC_LIST_UNLINK(adb->entries_lru, adbentry, link);
+		ISC_LIST_PREPEND(adb->entries_lru, adbentry, link);
 	}
 
-	RWUNLOCK(&adb->entries_lock, locktype);
+	RWUNLOCK(&adb->entries_lock, isc_rwlocktype_write);
 
 	return adbentry;
 }
@@ -1551,19 +1685,20 @@ maybe_expire_name(dns_adbname_t *adbname, isc_stdtime_t now) {
 	return true;
 }
 
+/*
+ * Requires the entry to be locked and the write lock on adb->entries_lock
+ * to be held.
+ */
 static void
 expire_entry(dns_adbentry_t *adbentry) {
-	isc_result_t result;
 	dns_adb_t *adb = adbentry->adb;
 
 	if (!ENTRY_DEAD(adbentry)) {
 		(void)atomic_fetch_or(&adbentry->flags, ENTRY_IS_DEAD);
 
-		result = isc_hashmap_delete(
-			adb->entries,
-			isc_sockaddr_hash(&adbentry->sockaddr, true), match_ptr,
-			adbentry);
-		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+		rcu_read_lock();
+		RUNTIME_CHECK(!cds_lfht_del(adb->entries, &adbentry->ht_node));
+		rcu_read_unlock();
 		ISC_LIST_UNLINK(adb->entries_lru, adbentry, link);
 	}
 
@@ -1595,6 +1730,17 @@ maybe_expire_entry(dns_adbentry_t *adbentry, isc_stdtime_t now) {
 	return false;
 }
 
+/*
+ * How long a name or an entry must have been unused to be stale; this
+ * shrinks as the memory pressure rises, so the ADB is purged gradually
+ * before it is overmem.
+ */
+static isc_stdtime_t
+stale_margin(unsigned int pressure) {
+	return ADB_STALE_MARGIN -
+	       ADB_STALE_MARGIN * pressure / ISC_MEM_PRESSURE_MAX;
+}
+
 /*%
  * Examine the tail entry of the LRU list to see if it expires or is stale
  * (unused for some period); if so, the name entry will be freed.  If the ADB
@@ -1607,7 +1753,9 @@ maybe_expire_entry(dns_adbentry_t *adbentry, isc_stdtime_t now) {
  */
 static void
 purge_stale_names(dns_adb_t *adb, isc_stdtime_t now) {
-	bool overmem = isc_mem_isovermem(adb->mctx);
+	unsigned int pressure = isc_mem_pressure(adb->mctx);
+	bool overmem = (pressure >= ISC_MEM_PRESSURE_MAX);
+	isc_stdtime_t margin = stale_margin(pressure);
 	int max_removed = overmem ? 2 : 1;
 	int scans = 0, removed = 0;
 	dns_adbname_t *prev = NULL;
@@ -1655,7 +1803,7 @@ purge_stale_names(dns_adb_t *adb, isc_stdtime_t now) {
 			goto next;
 		}
 
-		if (adbname->last_used + ADB_STALE_MARGIN < now) {
+		if (adbname->last_used + margin < now) {
 			expire_name(adbname, DNS_ADB_CANCELED);
 			removed++;
 			goto next;
@@ -1663,7 +1811,7 @@ purge_stale_names(dns_adb_t *adb, isc_stdtime_t now) {
 
 		/*
 		 * We won't expire anything on the LRU list as the
-		 * .last_used + ADB_STALE_MARGIN will always be bigger
+		 * .last_used + margin will always be bigger
 		 * than `now` for all previous entries, so we just stop
 		 * the scanning.
 		 */
@@ -1712,7 +1860,9 @@ cleanup_names(dns_adb_t *adb, isc_stdtime_t now) {
  */
 static void
 purge_stale_entries(dns_adb_t *adb, isc_stdtime_t now) {
-	bool overmem = isc_mem_isovermem(adb->mctx);
+	unsigned int pressure = isc_mem_pressure(adb->mctx);
+	bool overmem = (pressure >= ISC_MEM_PRESSURE_MAX);
+	isc_stdtime_t margin = stale_margin(pressure);
 	int max_removed = overmem ? 2 : 1;
 	int scans = 0, removed = 0;
 	dns_adbentry_t *prev = NULL;
@@ -1758,7 +1908,7 @@ purge_stale_entries(dns_adb_t *adb, isc_stdtime_t now) {
 			goto next;
 		}
 
-		if (adbentry->last_used + ADB_STALE_MARGIN < now) {
+		if (adbentry->last_used + margin < now) {
 			maybe_expire_entry(adbentry, INT_MAX);
 			removed++;
 			goto next;
@@ -1766,7 +1916,7 @@ purge_stale_entries(dns_adb_t *adb, isc_stdtime_t now) {
 
 		/*
 		 * We won't expire anything on the LRU list as the
-		 * .last_used + ADB_STALE_MARGIN will always be bigger
+		 * .last_used + margin will always be bigger
 		 * than `now` for all previous entries, so we just stop
 		 * the scanning
 		 */
@@ -1803,23 +1953,22 @@ destroy(dns_adb_t *adb) {
 	adb->magic = 0;
 
 	RWLOCK(&adb->names_lock, isc_rwlocktype_write);
-	INSIST(isc_hashmap_count(adb->names) == 0);
-	isc_hashmap_destroy(&adb->names);
+	INSIST(ISC_LIST_EMPTY(adb->names_lru));
+	RUNTIME_CHECK(!cds_lfht_destroy(adb->names, NULL));
 	RWUNLOCK(&adb->names_lock, isc_rwlocktype_write);
 	isc_rwlock_destroy(&adb->names_lock);
 
 	RWLOCK(&adb->entries_lock, isc_rwlocktype_write);
 	/* There are no unassociated entries */
-	INSIST(isc_hashmap_count(adb->entries) == 0);
-	isc_hashmap_destroy(&adb->entries);
+	INSIST(ISC_LIST_EMPTY(adb->entries_lru));
+	RUNTIME_CHECK(!cds_lfht_destroy(adb->entries, NULL));
 	RWUNLOCK(&adb->entries_lock, isc_rwlocktype_write);
 	isc_rwlock_destroy(&adb->entries_lock);
 
-	isc_mem_detach(&adb->hmctx);
-
 	isc_mutex_destroy(&adb->lock);
 
 	isc_stats_detach(&adb->stats);
+	isc_mempool_destroy(&adb->findpool);
 	dns_resolver_detach(&adb->res);
 	dns_view_weakdetach(&adb->view);
 	isc_mem_putanddetach(&adb->mctx, adb, sizeof(dns_adb_t));
@@ -1862,19 +2011,26 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, dns_adb_t **newadb) {
 	dns_resolver_attach(view->resolver, &adb->res);
 	isc_mem_attach(mem, &adb->mctx);
 
-	isc_mem_create(&adb->hmctx);
-	isc_mem_setname(adb->hmctx, "ADB_hashmaps");
-
-	isc_hashmap_create(adb->hmctx, ADB_HASH_BITS, &adb->names);
+	adb->names = cds_lfht_new(ADB_HASH_INIT_SIZE, ADB_HASH_MIN_SIZE, 0,
+				  CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING,
+				  NULL);
+	INSIST(adb->names != NULL);
 	isc_rwlock_init(&adb->names_lock);
 
-	isc_hashmap_create(adb->hmctx, ADB_HASH_BITS, &adb->entries);
+	adb->entries = cds_lfht_new(ADB_HASH_INIT_SIZE, ADB_HASH_MIN_SIZE, 0,
+				    CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING,
+				    NULL);
+	INSIST(adb->entries != NULL);
 	isc_rwlock_init(&adb->entries_lock);
 
 	isc_mutex_init(&adb->lock);
 
 	isc_stats_create(adb->mctx, &adb->stats, dns_adbstats_max);
 
+	isc_mempool_create_shared(adb->mctx, sizeof(dns_adbfind_t),
+				  &adb->findpool);
+	isc_mempool_setname(adb->findpool, "adbfind");
+
 	set_adbstat(adb, 0, dns_adbstats_nnames);
 	set_adbstat(adb, 0, dns_adbstats_nentries);
 
@@ -2598,17 +2754,11 @@ isc_result_t
 dns_adb_dumpquota(dns_adb_t *adb, isc_buffer_t **buf) {
 	REQUIRE(DNS_ADB_VALID(adb));
 
-	isc_hashmap_iter_t *it = NULL;
-	isc_result_t result;
-
-	RWLOCK(&adb->entries_lock, isc_rwlocktype_read);
-	isc_hashmap_iter_create(adb->entries, &it);
-	for (result = isc_hashmap_iter_first(it); result == ISC_R_SUCCESS;
-	     result = isc_hashmap_iter_next(it))
-	{
-		dns_adbentry_t *entry = NULL;
-		isc_hashmap_iter_current(it, (void **)&entry);
+	struct cds_lfht_iter iter;
+	dns_adbentry_t *entry = NULL;
 
+	rcu_read_lock();
+	cds_lfht_for_each_entry(adb->entries, &iter, entry, ht_node) {
 		LOCK(&entry->lock);
 		char addrbuf[ISC_NETADDR_FORMATSIZE];
 		char text[ISC_NETADDR_FORMATSIZE + BUFSIZ];
@@ -2629,12 +2779,303 @@ dns_adb_dumpquota(dns_adb_t *adb, isc_buffer_t **buf) {
 	unlock:
 		UNLOCK(&entry->lock);
 	}
-	isc_hashmap_iter_destroy(&it);
-	RWUNLOCK(&adb->entries_lock, isc_rwlocktype_read);
+	rcu_read_unlock();
 
 	return ISC_R_SUCCESS;
 }
 
+void
+dns_adb_rttdump(dns_adb_t *adb, dns_adbrttdumper_t dumper, void *arg) {
+	static const double fraction[DNS_ADB_RTTQUANTILES] = { 0.99, 0.95,
+							       0.50 };
+	struct cds_lfht_iter iter;
+	dns_adbentry_t *entry = NULL;
+
+	REQUIRE(DNS_ADB_VALID(adb));
+	REQUIRE(dumper != NULL);
+
+	rcu_read_lock();
+	cds_lfht_for_each_entry(adb->entries, &iter, entry, ht_node) {
+		uint64_t quantiles[DNS_ADB_RTTQUANTILES];
+		isc_sockaddr_t sockaddr;
+		uint64_t samples;
+
+		LOCK(&entry->lock);
+		samples = entry->rttsamples;
+		if (samples < ADB_RTTHISTO_MINSAMPLES) {
+			UNLOCK(&entry->lock);
+			continue;
+		}
+		RUNTIME_CHECK(isc_histo_quantiles(entry->rtthisto,
+						  DNS_ADB_RTTQUANTILES,
+						  fraction, quantiles) ==
+			      ISC_R_SUCCESS);
+		sockaddr = entry->sockaddr;
+		UNLOCK(&entry->lock);
+
+		dumper(&sockaddr, samples, quantiles, arg);
+	}
+	rcu_read_unlock();
+}
+
+/*
+ * Requires the entry to be locked.
+ */
+static void
+savestate_entry(isc_buffer_t *b, dns_adbentry_t *entry) {
+	const isc_sockaddr_t *sa = &entry->sockaddr;
+
+	/*
+	 * Only keep the servers that have been talked to.
+	 */
+	if (entry->edns == 0 && entry->ednsto == 0 && entry->plain == 0 &&
+	    entry->plainto == 0)
+	{
+		return;
+	}
+
+	switch (sa->type.sa.sa_family) {
+	case AF_INET:
+		isc_buffer_putuint8(b, 4);
+		isc_buffer_putuint16(b, isc_sockaddr_getport(sa));
+		isc_buffer_putmem(
+			b, (const unsigned char *)&sa->type.sin.sin_addr, 4);
+		break;
+	case AF_INET6:
+		/* The scope would not mean the same after a restart */
+		if (sa->type.sin6.sin6_scope_id != 0) {
+			return;
+		}
+		isc_buffer_putuint8(b, 6);
+		isc_buffer_putuint16(b, isc_sockaddr_getport(sa));
+		isc_buffer_putmem(b, sa->type.sin6.sin6_addr.s6_addr, 16);
+		break;
+	default:
+		return;
+	}
+
+	isc_buffer_putuint32(b, atomic_load(&entry->srtt));
+	isc_buffer_putuint32(b, atomic_load(&entry->flags) & ~ENTRY_IS_DEAD);
+	isc_buffer_putuint16(b, entry->udpsize);
+	isc_buffer_putuint8(b, entry->edns);
+	isc_buffer_putuint8(b, entry->ednsto);
+	isc_buffer_putuint8(b, entry->plain);
+	isc_buffer_putuint8(b, entry->plainto);
+	if (entry->cookie != NULL && entry->cookielen <= UINT8_MAX) {
+		isc_buffer_putuint8(b, entry->cookielen);
+		isc_buffer_putmem(b, entry->cookie, entry->cookielen);
+	} else {
+		isc_buffer_putuint8(b, 0);
+	}
+}
+
+isc_result_t
+dns_adb_savestate(dns_adb_t *adb, const char *filename) {
+	isc_result_t result;
+	struct cds_lfht_iter iter;
+	dns_adbentry_t *entry = NULL;
+	isc_buffer_t *b = NULL;
+	char tempname[PATH_MAX];
+	FILE *fp = NULL;
+	bool created = false;
+
+	REQUIRE(DNS_ADB_VALID(adb));
+	REQUIRE(filename != NULL);
+
+	CHECK(isc_file_mktemplate(filename, tempname, sizeof(tempname)));
+	CHECK(isc_file_openunique(tempname, &fp));
+	created = true;
+
+	isc_buffer_allocate(adb->mctx, &b, 65536);
+	isc_buffer_putuint32(b, ADBSTATE_MAGIC);
+	isc_buffer_putuint32(b, ADBSTATE_VERSION);
+	isc_buffer_putuint32(b, isc_stdtime_now());
+
+	rcu_read_lock();
+	cds_lfht_for_each_entry(adb->entries, &iter, entry, ht_node) {
+		LOCK(&entry->lock);
+		if (!ENTRY_DEAD(entry)) {
+			savestate_entry(b, entry);
+		}
+		UNLOCK(&entry->lock);
+	}
+	rcu_read_unlock();
+
+	CHECK(isc_stdio_write(isc_buffer_base(b), 1, isc_buffer_usedlength(b),
+			      fp, NULL));
+	CHECK(isc_stdio_flush(fp));
+	CHECK(isc_stdio_sync(fp));
+	result = isc_stdio_close(fp);
+	fp = NULL;
+	if (result == ISC_R_SUCCESS) {
+		result = isc_file_rename(tempname, filename);
+	}
+
+cleanup:
+	if (fp != NULL) {
+		(void)isc_stdio_close(fp);
+	}
+	if (result != ISC_R_SUCCESS && created) {
+		(void)isc_file_remove(tempname);
+	}
+	if (b != NULL) {
+		isc_buffer_free(&b);
+	}
+	return result;
+}
+
+/*
+ * Parse one entry from 'b' and merge it into the ADB, aged by 'halvings'
+ * half-lives.
+ */
+static isc_result_t
+loadstate_entry(dns_adb_t *adb, isc_buffer_t *b, isc_stdtime_t now,
+		unsigned int halvings) {
+	isc_sockaddr_t sa;
+	dns_adbentry_t *entry = NULL;
+	unsigned int family, alen, port, cookielen;
+	uint32_t srtt, flags;
+	uint16_t udpsize;
+	unsigned char counters[4];
+	const unsigned char *cookie = NULL;
+
+	family = isc_buffer_getuint8(b);
+	switch (family) {
+	case 4:
+		alen = 4;
+		break;
+	case 6:
+		alen = 16;
+		break;
+	default:
+		return DNS_R_FORMERR;
+	}
+
+	if (isc_buffer_remaininglength(b) < alen + 17) {
+		return ISC_R_UNEXPECTEDEND;
+	}
+
+	port = isc_buffer_getuint16(b);
+	if (family == 4) {
+		struct in_addr ina;
+
+		memmove(&ina, isc_buffer_current(b), alen);
+		isc_sockaddr_fromin(&sa, &ina, port);
+	} else {
+		struct in6_addr ina6;
+
+		memmove(&ina6, isc_buffer_current(b), alen);
+		isc_sockaddr_fromin6(&sa, &ina6, port);
+	}
+	isc_buffer_forward(b, alen);
+
+	srtt = isc_buffer_getuint32(b);
+	flags = isc_buffer_getuint32(b);
+	udpsize = isc_buffer_getuint16(b);
+	for (size_t i = 0; i < sizeof(counters); i++) {
+		counters[i] = isc_buffer_getuint8(b);
+	}
+	cookielen = isc_buffer_getuint8(b);
+	if (isc_buffer_remaininglength(b) < cookielen) {
+		return ISC_R_UNEXPECTEDEND;
+	}
+	cookie = isc_buffer_current(b);
+	isc_buffer_forward(b, cookielen);
+
+	entry = get_attached_and_locked_entry(adb, now, &sa);
+
+	/*
+	 * Decay what has been measured towards the state of a new entry;
+	 * the flags and the cookie are only trusted while they're recent.
+	 */
+	srtt = (halvings < 32) ? srtt >> halvings : 0;
+	atomic_store(&entry->srtt, ISC_MAX(srtt, 1));
+	entry->edns = (halvings < 8) ? counters[0] >> halvings : 0;
+	entry->ednsto = (halvings < 8) ? counters[1] >> halvings : 0;
+	entry->plain = (halvings < 8) ? counters[2] >> halvings : 0;
+	entry->plainto = (halvings < 8) ? counters[3] >> halvings : 0;
+	if (udpsize > entry->udpsize) {
+		entry->udpsize = udpsize;
+	}
+	if (halvings == 0) {
+		atomic_store(&entry->flags, flags & ~ENTRY_IS_DEAD);
+		if (entry->cookie == NULL && cookielen > 0) {
+			entry->cookie = isc_mem_get(adb->mctx, cookielen);
+			entry->cookielen = cookielen;
+			memmove(entry->cookie, cookie, cookielen);
+		}
+	}
+
+	/*
+	 * Keep the entry until the servers are looked up again, rather
+	 * than just for the usual window for the unassociated entries.
+	 */
+	if (entry->expires < now + ADB_STALE_MARGIN) {
+		entry->expires = now + ADB_STALE_MARGIN;
+	}
+
+	UNLOCK(&entry->lock);
+	dns_adbentry_detach(&entry);
+
+	return ISC_R_SUCCESS;
+}
+
+isc_result_t
+dns_adb_loadstate(dns_adb_t *adb, const char *filename, size_t *loadedp) {
+	isc_result_t result;
+	isc_stdtime_t now = isc_stdtime_now();
+	isc_stdtime_t saved;
+	isc_buffer_t *b = NULL;
+	unsigned int halvings;
+	size_t loaded = 0;
+	FILE *fp = NULL;
+	off_t size;
+
+	REQUIRE(DNS_ADB_VALID(adb));
+	REQUIRE(filename != NULL);
+
+	CHECK(isc_file_getsize(filename, &size));
+	if (size < 12) {
+		CHECK(ISC_R_UNEXPECTEDEND);
+	}
+
+	CHECK(isc_stdio_open(filename, "rb", &fp));
+	isc_buffer_allocate(adb->mctx, &b, size);
+	CHECK(isc_stdio_read(isc_buffer_base(b), 1, size, fp, NULL));
+	isc_buffer_add(b, size);
+
+	if (isc_buffer_getuint32(b) != ADBSTATE_MAGIC ||
+	    isc_buffer_getuint32(b) != ADBSTATE_VERSION)
+	{
+		CHECK(ISC_R_NOTIMPLEMENTED);
+	}
+
+	saved = ISC_MIN(isc_buffer_getuint32(b), now);
+	if (now - saved > ADB_CACHE_MAXIMUM) {
+		/* Too old to be of any use */
+		result = ISC_R_SUCCESS;
+		goto cleanup;
+	}
+	halvings = (now - saved) / ADBSTATE_HALFLIFE;
+
+	while (isc_buffer_remaininglength(b) > 0) {
+		CHECK(loadstate_entry(adb, b, now, halvings));
+		loaded++;
+	}
+
+cleanup:
+	if (loadedp != NULL) {
+		*loadedp = loaded;
+	}
+	if (b != NULL) {
+		isc_buffer_free(&b);
+	}
+	if (fp != NULL) {
+		(void)isc_stdio_close(fp);
+	}
+	return result;
+}
+
 static isc_result_t
 dbfind_name(dns_adbname_t *adbname, isc_stdtime_t now, dns_rdatatype_t rdtype) {
 	isc_result_t result;
@@ -3048,6 +3489,8 @@ dns_adb_adjustsrtt(dns_adb_t *adb, dns_adbaddrinfo_t *addr, unsigned int rtt,
 	isc_stdtime_t now = 0;
 	if (factor == DNS_ADB_RTTADJAGE) {
 		now = isc_stdtime_now();
+	} else if (factor != DNS_ADB_RTTADJREPLACE) {
+		record_rtt(addr->entry, rtt);
 	}
 
 	adjustsrtt(addr, rtt, factor, now);
@@ -3061,6 +3504,34 @@ dns_adb_agesrtt(dns_adb_t *adb, dns_adbaddrinfo_t *addr, isc_stdtime_t now) {
 	adjustsrtt(addr, 0, DNS_ADB_RTTADJAGE, now);
 }
 
+static void
+record_rtt(dns_adbentry_t *entry, unsigned int rtt) {
+	static const double fraction[] = { ADB_RTTHISTO_QUANTILE };
+	uint64_t high;
+
+	LOCK(&entry->lock);
+	if (entry->rtthisto == NULL) {
+		isc_histo_create(entry->mctx, ADB_RTTHISTO_SIGBITS,
+				 &entry->rtthisto);
+	}
+	isc_histo_inc(entry->rtthisto, rtt);
+	entry->rttsamples++;
+
+	if (entry->rttsamples >= ADB_RTTHISTO_MINSAMPLES &&
+	    entry->rttsamples % ADB_RTTHISTO_UPDATE == 0)
+	{
+		RUNTIME_CHECK(isc_histo_quantiles(entry->rtthisto, 1, fraction,
+						  &high) == ISC_R_SUCCESS);
+		atomic_store_relaxed(&entry->rtthigh, ISC_MIN(high, UINT_MAX));
+	}
+
+	if (entry->rttsamples >= ADB_RTTHISTO_WINDOW) {
+		isc_histo_destroy(&entry->rtthisto);
+		entry->rttsamples = 0;
+	}
+	UNLOCK(&entry->lock);
+}
+
 static void
 adjustsrtt(dns_adbaddrinfo_t *addr, unsigned int rtt, unsigned int factor,
 	   isc_stdtime_t now) {
@@ -3408,7 +3879,6 @@ dns_adb_flush(dns_adb_t *adb) {
 void
 dns_adb_flushname(dns_adb_t *adb, const dns_name_t *name) {
 	dns_adbname_t *adbname = NULL;
-	isc_result_t result;
 	bool start_at_zone = false;
 	bool static_stub = false;
 	dns_adbname_t key = { .name = UNCONST(name) };
@@ -3429,9 +3899,10 @@ again:
 	key.flags = ((static_stub) ? DNS_ADBFIND_STATICSTUB : 0) |
 		    ((start_at_zone) ? DNS_ADBFIND_STARTATZONE : 0);
 
-	result = isc_hashmap_find(adb->names, hash_adbname(&key), match_adbname,
-				  (void *)&key, (void **)&adbname);
-	if (result == ISC_R_SUCCESS) {
+	rcu_read_lock();
+	adbname = lookup_adbname(adb, hash_adbname(&key), &key);
+	rcu_read_unlock();
+	if (adbname != NULL) {
 		dns_adbname_ref(adbname);
 		LOCK(&adbname->lock);
 		if (dns_name_equal(name, adbname->name)) {
@@ -3565,6 +4036,14 @@ dns_adb_endudpfetch(dns_adb_t *adb, dns_adbaddrinfo_t *addr) {
 	INSIST(active != 0);
 }
 
+unsigned int
+dns_adb_getactive(dns_adb_t *adb, dns_adbaddrinfo_t *addr) {
+	REQUIRE(DNS_ADB_VALID(adb));
+	REQUIRE(DNS_ADBADDRINFO_VALID(addr));
+
+	return atomic_load_relaxed(&addr->entry->active);
+}
+
 isc_stats_t *
 dns_adb_getstats(dns_adb_t *adb) {
 	REQUIRE(DNS_ADB_VALID(adb));
@@ -17,6 +17,7 @@
 #include <stdbool.h>
 
 #include <isc/async.h>
+#include <isc/atomic.h>
 #include <isc/buffer.h>
 #include <isc/hash.h>
 #include <isc/log.h>
@@ -45,24 +46,38 @@ typedef struct dns_bckey {
 	dns_rdatatype_t type;
 } dns__bckey_t;
 
+#define BADCACHE_MAGIC	  ISC_MAGIC('B', 'd', 'C', 'a')
+#define VALID_BADCACHE(m) ISC_MAGIC_VALID(m, BADCACHE_MAGIC)
+
+#define BADCACHE_INIT_SIZE (1 << 10) /* Must be power of 2 */
+#define BADCACHE_MIN_SIZE  (1 << 8)  /* Must be power of 2 */
+
+/*
+ * The bad cache is nearly always empty or tiny, so the lookups are
+ * prefiltered with a counting Bloom filter: every entry in the hash
+ * table increments two counters selected by its hash value, and a name
+ * whose counters are not both set can't be in the table.
+ */
+#define BADCACHE_FILTER_BITS 12
+#define BADCACHE_FILTER_SIZE (1 << BADCACHE_FILTER_BITS)
+#define BADCACHE_FILTER_MASK (BADCACHE_FILTER_SIZE - 1)
+
 struct dns_badcache {
 	unsigned int magic;
 	isc_mem_t *mctx;
 	struct cds_lfht *ht;
 	struct cds_list_head *lru;
 	uint32_t nloops;
-};
-
-#define BADCACHE_MAGIC	  ISC_MAGIC('B', 'd', 'C', 'a')
-#define VALID_BADCACHE(m) ISC_MAGIC_VALID(m, BADCACHE_MAGIC)
 
-#define BADCACHE_INIT_SIZE (1 << 10) /* Must be power of 2 */
-#define BADCACHE_MIN_SIZE  (1 << 8)  /* Must be power of 2 */
+	atomic_uint_fast32_t count;
+	atomic_uint_fast32_t filter[BADCACHE_FILTER_SIZE];
+};
 
 struct dns_bcentry {
 	isc_loop_t *loop;
 	isc_stdtime_t expire;
 	uint32_t flags;
+	uint32_t hashval;
 
 	struct cds_lfht_node ht_node;
 	struct rcu_head rcu_head;
@@ -79,7 +94,8 @@ static void
 bcentry_destroy(struct rcu_head *rcu_head);
 
 static bool
-bcentry_alive(struct cds_lfht *ht, dns_bcentry_t *bad, isc_stdtime_t now);
+bcentry_alive(dns_badcache_t *bc, struct cds_lfht *ht, dns_bcentry_t *bad,
+	      isc_stdtime_t now);
 
 dns_badcache_t *
 dns_badcache_new(isc_mem_t *mctx, isc_loopmgr_t *loopmgr) {
@@ -92,6 +108,11 @@ dns_badcache_new(isc_mem_t *mctx, isc_loopmgr_t *loopmgr) {
 		.nloops = nloops,
 	};
 
+	atomic_init(&bc->count, 0);
+	for (size_t i = 0; i < BADCACHE_FILTER_SIZE; i++) {
+		atomic_init(&bc->filter[i], 0);
+	}
+
 	bc->ht = cds_lfht_new(BADCACHE_INIT_SIZE, BADCACHE_MIN_SIZE, 0,
 			      CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING, NULL);
 	INSIST(bc->ht != NULL);
@@ -146,6 +167,37 @@ bcentry_hash(const dns__bckey_t *key) {
 	return isc_hash32_finalize(&state);
 }
 
+static void
+filter_add(dns_badcache_t *bc, uint32_t hashval) {
+	atomic_fetch_add_relaxed(&bc->count, 1);
+	atomic_fetch_add_release(&bc->filter[hashval & BADCACHE_FILTER_MASK],
+				 1);
+	atomic_fetch_add_release(
+		&bc->filter[(hashval >> BADCACHE_FILTER_BITS) &
+			    BADCACHE_FILTER_MASK],
+		1);
+}
+
+static void
+filter_del(dns_badcache_t *bc, uint32_t hashval) {
+	atomic_fetch_sub_release(&bc->filter[hashval & BADCACHE_FILTER_MASK],
+				 1);
+	atomic_fetch_sub_release(
+		&bc->filter[(hashval >> BADCACHE_FILTER_BITS) &
+			    BADCACHE_FILTER_MASK],
+		1);
+	atomic_fetch_sub_relaxed(&bc->count, 1);
+}
+
+static bool
+filter_maymatch(dns_badcache_t *bc, uint32_t hashval) {
+	return atomic_load_acquire(
+		       &bc->filter[hashval & BADCACHE_FILTER_MASK]) > 0 &&
+	       atomic_load_acquire(
+		       &bc->filter[(hashval >> BADCACHE_FILTER_BITS) &
+				   BADCACHE_FILTER_MASK]) > 0;
+}
+
 static dns_bcentry_t *
 bcentry_lookup(struct cds_lfht *ht, uint32_t hashval, dns__bckey_t *key) {
 	struct cds_lfht_iter iter;
@@ -159,13 +211,14 @@ bcentry_lookup(struct cds_lfht *ht, uint32_t hashval, dns__bckey_t *key) {
 static dns_bcentry_t *
 bcentry_new(isc_loop_t *loop, const dns_name_t *name,
 	    const dns_rdatatype_t type, const uint32_t flags,
-	    const isc_stdtime_t expire) {
+	    const isc_stdtime_t expire, const uint32_t hashval) {
 	isc_mem_t *mctx = isc_loop_getmctx(loop);
 	dns_bcentry_t *bad = isc_mem_get(mctx, sizeof(*bad));
 	*bad = (dns_bcentry_t){
 		.type = type,
 		.flags = flags,
 		.expire = expire,
+		.hashval = hashval,
 		.loop = isc_loop_ref(loop),
 		.lru_head = CDS_LIST_HEAD_INIT(bad->lru_head),
 	};
@@ -200,8 +253,10 @@ bcentry_evict_async(void *arg) {
 }
 
 static void
-bcentry_evict(struct cds_lfht *ht, dns_bcentry_t *bad) {
+bcentry_evict(dns_badcache_t *bc, struct cds_lfht *ht, dns_bcentry_t *bad) {
 	if (!cds_lfht_del(ht, &bad->ht_node)) {
+		filter_del(bc, bad->hashval);
+
 		if (bad->loop == isc_loop()) {
 			bcentry_evict_async(bad);
 			return;
@@ -212,11 +267,12 @@ bcentry_evict(struct cds_lfht *ht, dns_bcentry_t *bad) {
 }
 
 static bool
-bcentry_alive(struct cds_lfht *ht, dns_bcentry_t *bad, isc_stdtime_t now) {
+bcentry_alive(dns_badcache_t *bc, struct cds_lfht *ht, dns_bcentry_t *bad,
+	      isc_stdtime_t now) {
 	if (cds_lfht_is_node_deleted(&bad->ht_node)) {
 		return false;
 	} else if (bad->expire < now) {
-		bcentry_evict(ht, bad);
+		bcentry_evict(bc, ht, bad);
 		return false;
 	}
 
@@ -232,14 +288,28 @@ bcentry_alive(struct cds_lfht *ht, dns_bcentry_t *bad, isc_stdtime_t now) {
 	     pos = cds_lfht_entry(cds_lfht_iter_get_node(iter), \
 				  __typeof__(*(pos)), member))
 
+/*
+ * Evict a few expired entries from the head of the calling loop's LRU
+ * list.  This is only done when adding entries, so the lookups never
+ * pay for the expiration of the entries they don't ask about.
+ *
+ * As the memory pressure rises, up to three of the oldest entries are
+ * evicted even though they have not expired: from a third of the full
+ * pressure on, the bad cache stops growing, and it shrinks beyond that.
+ */
 static void
-bcentry_purge(struct cds_lfht *ht, struct cds_list_head *lru,
-	      isc_stdtime_t now) {
+bcentry_purge(dns_badcache_t *bc, struct cds_lfht *ht,
+	      struct cds_list_head *lru, isc_stdtime_t now) {
 	size_t count = 10;
+	size_t force = isc_mem_pressure(bc->mctx) * 3 / ISC_MEM_PRESSURE_MAX;
 	dns_bcentry_t *bad;
 	cds_list_for_each_entry_rcu(bad, lru, lru_head) {
-		if (bcentry_alive(ht, bad, now)) {
-			break;
+		if (bcentry_alive(bc, ht, bad, now)) {
+			if (force == 0) {
+				break;
+			}
+			force--;
+			bcentry_evict(bc, ht, bad);
 		}
 		if (--count == 0) {
 			break;
@@ -272,23 +342,29 @@ dns_badcache_add(dns_badcache_t *bc, const dns_name_t *name,
 	};
 	uint32_t hashval = bcentry_hash(&key);
 
-	/* struct cds_lfht_iter iter; */
-	dns_bcentry_t *bad = bcentry_new(loop, name, type, flags, expire);
+	dns_bcentry_t *bad = bcentry_new(loop, name, type, flags, expire,
+					 hashval);
 	struct cds_lfht_node *ht_node;
+
+	/*
+	 * Account for the new entry before it becomes visible, so that
+	 * the filter never hides an entry from dns_badcache_find().
+	 */
+	filter_add(bc, hashval);
 	do {
 		ht_node = cds_lfht_add_unique(ht, hashval, bcentry_match, &key,
 					      &bad->ht_node);
 		if (ht_node != &bad->ht_node) {
 			dns_bcentry_t *found = caa_container_of(
 				ht_node, dns_bcentry_t, ht_node);
-			bcentry_evict(ht, found);
+			bcentry_evict(bc, ht, found);
 		}
 	} while (ht_node != &bad->ht_node);
 
 	/* No locking, instead we are using per-thread lists */
 	cds_list_add_tail_rcu(&bad->lru_head, lru);
 
-	bcentry_purge(ht, lru, now);
+	bcentry_purge(bc, ht, lru, now);
 
 	rcu_read_unlock();
 }
@@ -301,9 +377,9 @@ dns_badcache_find(dns_badcache_t *bc, const dns_name_t *name,
 
 	isc_result_t result = ISC_R_NOTFOUND;
 
-	rcu_read_lock();
-	struct cds_lfht *ht = rcu_dereference(bc->ht);
-	INSIST(ht != NULL);
+	if (atomic_load_relaxed(&bc->count) == 0) {
+		return ISC_R_NOTFOUND;
+	}
 
 	dns__bckey_t key = {
 		.name = name,
@@ -311,19 +387,23 @@ dns_badcache_find(dns_badcache_t *bc, const dns_name_t *name,
 	};
 	uint32_t hashval = bcentry_hash(&key);
 
+	if (!filter_maymatch(bc, hashval)) {
+		return ISC_R_NOTFOUND;
+	}
+
+	rcu_read_lock();
+	struct cds_lfht *ht = rcu_dereference(bc->ht);
+	INSIST(ht != NULL);
+
 	dns_bcentry_t *found = bcentry_lookup(ht, hashval, &key);
 
-	if (found != NULL && bcentry_alive(ht, found, now)) {
+	if (found != NULL && bcentry_alive(bc, ht, found, now)) {
 		result = ISC_R_SUCCESS;
 		if (flagp != NULL) {
 			*flagp = found->flags;
 		}
 	}
 
-	uint32_t tid = isc_tid();
-	struct cds_list_head *lru = &bc->lru[tid];
-	bcentry_purge(ht, lru, now);
-
 	rcu_read_unlock();
 
 	return result;
@@ -341,7 +421,7 @@ dns_badcache_flush(dns_badcache_t *bc) {
 	dns_bcentry_t *bad;
 	struct cds_lfht_iter iter;
 	cds_lfht_for_each_entry(ht, &iter, bad, ht_node) {
-		bcentry_evict(ht, bad);
+		bcentry_evict(bc, ht, bad);
 	}
 
 	rcu_read_unlock();
@@ -362,12 +442,12 @@ dns_badcache_flushname(dns_badcache_t *bc, const dns_name_t *name) {
 	struct cds_lfht_iter iter;
 	cds_lfht_for_each_entry(ht, &iter, bad, ht_node) {
 		if (dns_name_equal(&bad->name, name)) {
-			bcentry_evict(ht, bad);
+			bcentry_evict(bc, ht, bad);
 			continue;
 		}
 
 		/* Flush all the expired entries */
-		(void)bcentry_alive(ht, bad, now);
+		(void)bcentry_alive(bc, ht, bad, now);
 	}
 
 	rcu_read_unlock();
@@ -388,12 +468,12 @@ dns_badcache_flushtree(dns_badcache_t *bc, const dns_name_t *name) {
 	struct cds_lfht_iter iter;
 	cds_lfht_for_each_entry(ht, &iter, bad, ht_node) {
 		if (dns_name_issubdomain(&bad->name, name)) {
-			bcentry_evict(ht, bad);
+			bcentry_evict(bc, ht, bad);
 			continue;
 		}
 
 		/* Flush all the expired entries */
-		(void)bcentry_alive(ht, bad, now);
+		(void)bcentry_alive(bc, ht, bad, now);
 	}
 
 	rcu_read_unlock();
@@ -426,7 +506,7 @@ dns_badcache_print(dns_badcache_t *bc, const char *cachename, FILE *fp) {
 
 	struct cds_lfht_iter iter;
 	cds_lfht_for_each_entry(ht, &iter, bad, ht_node) {
-		if (bcentry_alive(ht, bad, now)) {
+		if (bcentry_alive(bc, ht, bad, now)) {
 			bcentry_print(bad, now, fp);
 		}
 	}
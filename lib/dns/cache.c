@@ -13,15 +13,23 @@
 
 /*! \file */
 
+#include <fcntl.h>
 #include <inttypes.h>
 #include <stdbool.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include <isc/buffer.h>
+#include <isc/errno.h>
+#include <isc/file.h>
 #include <isc/log.h>
 #include <isc/loop.h>
 #include <isc/mem.h>
 #include <isc/refcount.h>
 #include <isc/result.h>
 #include <isc/stats.h>
+#include <isc/stdio.h>
 #include <isc/string.h>
 #include <isc/time.h>
 #include <isc/timer.h>
@@ -30,12 +38,16 @@
 #include <dns/cache.h>
 #include <dns/db.h>
 #include <dns/dbiterator.h>
+#include <dns/fixedname.h>
 #include <dns/masterdump.h>
 #include <dns/rdata.h>
+#include <dns/rdatalist.h>
 #include <dns/rdataset.h>
 #include <dns/rdatasetiter.h>
 #include <dns/stats.h>
 
+#include "qpcache_p.h"
+
 #ifdef HAVE_JSON_C
 #include <json_object.h>
 #endif /* HAVE_JSON_C */
@@ -54,6 +66,48 @@
  */
 #define DNS_CACHE_MINSIZE 2097152U /*%< Bytes.  2097152 = 2 MB */
 
+/*%
+ * The number of nodes cleartree() collects before it pauses the iterator
+ * and clears them.
+ */
+#define CLEARTREE_BATCH 256
+
+/*
+ * The cache snapshot file format.  All the integers are in network byte
+ * order.  The file starts with:
+ *
+ *	uint32	SNAPSHOT_MAGIC
+ *	uint32	SNAPSHOT_VERSION
+ *	uint16	class
+ *	uint16	reserved, zero
+ *	uint32	the time the snapshot was taken
+ *
+ * and is followed by one record for each RRset:
+ *
+ *	uint32	the time the RRset expires (or expired, if it is stale)
+ *	uint16	type
+ *	uint16	covered type
+ *	uint8	trust level
+ *	uint8	SNAPSHOT_* flags
+ *	uint16	number of rdata
+ *	uint8	length of the owner name, followed by the uncompressed name
+ *	for each rdata: uint16 length, followed by the rdata
+ */
+#define SNAPSHOT_MAGIC	 ISC_MAGIC('C', 'S', 'n', 'p')
+#define SNAPSHOT_VERSION 1
+
+#define CHECK(op)                            \
+	do {                                 \
+		result = (op);               \
+		if (result != ISC_R_SUCCESS) \
+			goto cleanup;        \
+	} while (0)
+
+#define SNAPSHOT_NEGATIVE 0x01
+#define SNAPSHOT_NXDOMAIN 0x02
+#define SNAPSHOT_OPTOUT	  0x04
+#define SNAPSHOT_STALE	  0x08
+
 /***
  ***	Types
  ***/
@@ -82,6 +136,8 @@ struct dns_cache {
 	isc_stats_t *stats;
 	uint32_t maxrrperset;
 	uint32_t maxtypepername;
+	bool lockfreereads;
+	dns_cacheevict_t evictpolicy;
 };
 
 /***
@@ -92,7 +148,7 @@ static isc_result_t
 cache_create_db(dns_cache_t *cache, dns_db_t **dbp, isc_mem_t **tmctxp,
 		isc_mem_t **hmctxp) {
 	isc_result_t result;
-	char *argv[1] = { 0 };
+	char *argv[3] = { 0 };
 	dns_db_t *db = NULL;
 	isc_mem_t *tmctx = NULL, *hmctx = NULL;
 
@@ -100,7 +156,7 @@ cache_create_db(dns_cache_t *cache, dns_db_t **dbp, isc_mem_t **tmctxp,
 	 * This will be the cache memory context, which is subject
 	 * to cleaning when the configured memory limits are exceeded.
 	 */
-	isc_mem_create(&tmctx);
+	isc_mem_create_threadaffine(&tmctx);
 	isc_mem_setname(tmctx, "cache");
 
 	/*
@@ -109,17 +165,22 @@ cache_create_db(dns_cache_t *cache, dns_db_t **dbp, isc_mem_t **tmctxp,
 	 * heavy load and could otherwise cause the cache to be cleaned too
 	 * aggressively.
 	 */
-	isc_mem_create(&hmctx);
+	isc_mem_create_threadaffine(&hmctx);
 	isc_mem_setname(hmctx, "cache_heap");
 
 	/*
 	 * For databases of type "qpcache" or "rbt" (which are the
 	 * only cache implementations currently in existence) we pass
-	 * hmctx to dns_db_create() via argv[0].
+	 * hmctx to dns_db_create() via argv[0], and the qpcache
+	 * lock-free reads mode and eviction policy via argv[1] and argv[2].
 	 */
 	argv[0] = (char *)hmctx;
+	argv[1] = cache->lockfreereads ? (char *)DNS_QPCACHE_LOCKFREE : NULL;
+	argv[2] = cache->evictpolicy == dns_cacheevict_sieve
+			  ? (char *)DNS_QPCACHE_SIEVE
+			  : NULL;
 	result = dns_db_create(tmctx, CACHEDB_DEFAULT, dns_rootname,
-			       dns_dbtype_cache, cache->rdclass, 1, argv, &db);
+			       dns_dbtype_cache, cache->rdclass, 3, argv, &db);
 	if (result != ISC_R_SUCCESS) {
 		goto cleanup_mctx;
 	}
@@ -400,11 +461,36 @@ clearnode(dns_db_t *db, dns_dbnode_t *node) {
 	return result;
 }
 
+/*
+ * Clear and detach the 'count' nodes in 'nodes'.  If clearnode() fails,
+ * record the first failure in 'answer' and move on to the next node.
+ */
+static void
+clearnodes(dns_db_t *db, dns_dbnode_t **nodes, unsigned int *countp,
+	   isc_result_t *answer) {
+	while (*countp > 0) {
+		dns_dbnode_t **nodep = &nodes[--(*countp)];
+		isc_result_t result = clearnode(db, *nodep);
+		if (result != ISC_R_SUCCESS && *answer == ISC_R_SUCCESS) {
+			*answer = result;
+		}
+		dns_db_detachnode(db, nodep);
+	}
+}
+
+/*
+ * Clear all the nodes under 'name'.  The nodes are collected in batches
+ * with the iterator, and only cleared once the iterator has been paused,
+ * so that the tree lock isn't held for the whole flush and the cache
+ * can keep taking new names while a large subtree is flushed.
+ */
 static isc_result_t
 cleartree(dns_db_t *db, const dns_name_t *name) {
 	isc_result_t result, answer = ISC_R_SUCCESS;
 	dns_dbiterator_t *iter = NULL;
-	dns_dbnode_t *node = NULL, *top = NULL;
+	dns_dbnode_t *nodes[CLEARTREE_BATCH];
+	dns_dbnode_t *top = NULL;
+	unsigned int count = 0;
 	dns_fixedname_t fnodename;
 	dns_name_t *nodename;
 
@@ -430,6 +516,8 @@ cleartree(dns_db_t *db, const dns_name_t *name) {
 	}
 
 	while (result == ISC_R_SUCCESS) {
+		dns_dbnode_t *node = NULL;
+
 		result = dns_dbiterator_current(iter, &node, nodename);
 		if (result == DNS_R_NEWORIGIN) {
 			result = ISC_R_SUCCESS;
@@ -441,30 +529,32 @@ cleartree(dns_db_t *db, const dns_name_t *name) {
 		 * Are we done?
 		 */
 		if (!dns_name_issubdomain(nodename, name)) {
-			goto cleanup;
+			dns_db_detachnode(db, &node);
+			result = ISC_R_NOMORE;
+			break;
 		}
 
-		/*
-		 * If clearnode fails record and move onto the next node.
-		 */
-		result = clearnode(db, node);
-		if (result != ISC_R_SUCCESS && answer == ISC_R_SUCCESS) {
-			answer = result;
-		}
-		dns_db_detachnode(db, &node);
+		nodes[count++] = node;
 		result = dns_dbiterator_next(iter);
+		if (result == ISC_R_SUCCESS && count < CLEARTREE_BATCH) {
+			continue;
+		}
+
+		RUNTIME_CHECK(dns_dbiterator_pause(iter) == ISC_R_SUCCESS);
+		clearnodes(db, nodes, &count, &answer);
 	}
 
 cleanup:
+	if (iter != NULL) {
+		RUNTIME_CHECK(dns_dbiterator_pause(iter) == ISC_R_SUCCESS);
+	}
+	clearnodes(db, nodes, &count, &answer);
 	if (result == ISC_R_NOMORE || result == ISC_R_NOTFOUND) {
 		result = ISC_R_SUCCESS;
 	}
 	if (result != ISC_R_SUCCESS && answer == ISC_R_SUCCESS) {
 		answer = result;
 	}
-	if (node != NULL) {
-		dns_db_detachnode(db, &node);
-	}
 	if (iter != NULL) {
 		dns_dbiterator_destroy(&iter);
 	}
@@ -570,6 +660,528 @@ dns_cache_setmaxtypepername(dns_cache_t *cache, uint32_t value) {
 	}
 }
 
+isc_result_t
+dns_cache_setlockfreereads(dns_cache_t *cache, bool value) {
+	REQUIRE(VALID_CACHE(cache));
+
+	if (cache->lockfreereads == value) {
+		return ISC_R_SUCCESS;
+	}
+
+	/*
+	 * The mode is fixed when the database is created, so switching it
+	 * means starting with a new, empty database.
+	 */
+	cache->lockfreereads = value;
+	return dns_cache_flush(cache);
+}
+
+bool
+dns_cache_getlockfreereads(dns_cache_t *cache) {
+	REQUIRE(VALID_CACHE(cache));
+
+	return cache->lockfreereads;
+}
+
+isc_result_t
+dns_cache_setevictionpolicy(dns_cache_t *cache, dns_cacheevict_t policy) {
+	REQUIRE(VALID_CACHE(cache));
+
+	if (cache->evictpolicy == policy) {
+		return ISC_R_SUCCESS;
+	}
+
+	/*
+	 * As with the lock-free reads mode, the policy is fixed when the
+	 * database is created.
+	 */
+	cache->evictpolicy = policy;
+	return dns_cache_flush(cache);
+}
+
+dns_cacheevict_t
+dns_cache_getevictionpolicy(dns_cache_t *cache) {
+	REQUIRE(VALID_CACHE(cache));
+
+	return cache->evictpolicy;
+}
+
+static void
+snapshot_rdataset(isc_buffer_t *b, const dns_name_t *name,
+		  dns_rdataset_t *rdataset, isc_stdtime_t now,
+		  dns_ttl_t stalettl) {
+	isc_result_t result;
+	unsigned int flags = 0, count = 0, countpos;
+	uint32_t expire = now + rdataset->ttl;
+
+	/*
+	 * The RRsets with the proofs attached are skipped, as the proofs
+	 * would not survive the round trip.
+	 */
+	if ((rdataset->attributes &
+	     (DNS_RDATASETATTR_ANCIENT | DNS_RDATASETATTR_NOQNAME |
+	      DNS_RDATASETATTR_CLOSEST)) != 0)
+	{
+		return;
+	}
+
+	if ((rdataset->attributes & DNS_RDATASETATTR_NEGATIVE) != 0) {
+		flags |= SNAPSHOT_NEGATIVE;
+	}
+	if ((rdataset->attributes & DNS_RDATASETATTR_NXDOMAIN) != 0) {
+		flags |= SNAPSHOT_NXDOMAIN;
+	}
+	if ((rdataset->attributes & DNS_RDATASETATTR_OPTOUT) != 0) {
+		flags |= SNAPSHOT_OPTOUT;
+	}
+	if ((rdataset->attributes & DNS_RDATASETATTR_STALE) != 0) {
+		/*
+		 * The TTL of a stale RRset counts down to the end of the
+		 * stale window; store the time the RRset expired instead.
+		 */
+		flags |= SNAPSHOT_STALE;
+		expire = now + rdataset->ttl - stalettl;
+	}
+
+	isc_buffer_putuint32(b, expire);
+	isc_buffer_putuint16(b, rdataset->type);
+	isc_buffer_putuint16(b, rdataset->covers);
+	isc_buffer_putuint8(b, rdataset->trust);
+	isc_buffer_putuint8(b, flags);
+	countpos = isc_buffer_usedlength(b);
+	isc_buffer_putuint16(b, 0);
+	isc_buffer_putuint8(b, name->length);
+	isc_buffer_putmem(b, name->ndata, name->length);
+
+	for (result = dns_rdataset_first(rdataset); result == ISC_R_SUCCESS;
+	     result = dns_rdataset_next(rdataset))
+	{
+		dns_rdata_t rdata = DNS_RDATA_INIT;
+
+		dns_rdataset_current(rdataset, &rdata);
+		isc_buffer_putuint16(b, rdata.length);
+		isc_buffer_putmem(b, rdata.data, rdata.length);
+		count++;
+	}
+
+	INSIST(count <= UINT16_MAX);
+	((unsigned char *)isc_buffer_base(b))[countpos] = count >> 8;
+	((unsigned char *)isc_buffer_base(b))[countpos + 1] = count & 0xff;
+}
+
+isc_result_t
+dns_cache_savesnapshot(dns_cache_t *cache, const char *filename) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	dns_dbiterator_t *dbiter = NULL;
+	dns_fixedname_t fixed;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	isc_buffer_t *b = NULL;
+	isc_stdtime_t now = isc_stdtime_now();
+	dns_ttl_t stalettl = 0;
+	char tempname[PATH_MAX];
+	FILE *fp = NULL;
+	bool created = false;
+
+	REQUIRE(VALID_CACHE(cache));
+	REQUIRE(filename != NULL);
+
+	CHECK(isc_file_mktemplate(filename, tempname, sizeof(tempname)));
+	CHECK(isc_file_openunique(tempname, &fp));
+	created = true;
+
+	dns_cache_attachdb(cache, &db);
+	(void)dns_db_getservestalettl(db, &stalettl);
+	CHECK(dns_db_createiterator(db, 0, &dbiter));
+
+	isc_buffer_allocate(cache->mctx, &b, 65536);
+	isc_buffer_putuint32(b, SNAPSHOT_MAGIC);
+	isc_buffer_putuint32(b, SNAPSHOT_VERSION);
+	isc_buffer_putuint16(b, cache->rdclass);
+	isc_buffer_putuint16(b, 0);
+	isc_buffer_putuint32(b, now);
+
+	for (result = dns_dbiterator_first(dbiter); result == ISC_R_SUCCESS;
+	     result = dns_dbiterator_next(dbiter))
+	{
+		dns_dbnode_t *node = NULL;
+		dns_rdatasetiter_t *rdsiter = NULL;
+
+		CHECK(dns_dbiterator_current(dbiter, &node, name));
+		RUNTIME_CHECK(dns_dbiterator_pause(dbiter) == ISC_R_SUCCESS);
+
+		result = dns_db_allrdatasets(db, node, NULL, DNS_DB_STALEOK,
+					     now, &rdsiter);
+		if (result != ISC_R_SUCCESS) {
+			dns_db_detachnode(db, &node);
+			goto cleanup;
+		}
+		for (result = dns_rdatasetiter_first(rdsiter);
+		     result == ISC_R_SUCCESS;
+		     result = dns_rdatasetiter_next(rdsiter))
+		{
+			dns_rdataset_t rdataset = DNS_RDATASET_INIT;
+
+			dns_rdatasetiter_current(rdsiter, &rdataset);
+			snapshot_rdataset(b, name, &rdataset, now, stalettl);
+			dns_rdataset_disassociate(&rdataset);
+		}
+		dns_rdatasetiter_destroy(&rdsiter);
+		dns_db_detachnode(db, &node);
+
+		/*
+		 * Write out the records in large chunks.
+		 */
+		if (isc_buffer_usedlength(b) >= 65536) {
+			CHECK(isc_stdio_write(isc_buffer_base(b), 1,
+					      isc_buffer_usedlength(b), fp,
+					      NULL));
+			isc_buffer_clear(b);
+		}
+	}
+	if (result != ISC_R_NOMORE) {
+		goto cleanup;
+	}
+
+	CHECK(isc_stdio_write(isc_buffer_base(b), 1, isc_buffer_usedlength(b),
+			      fp, NULL));
+	CHECK(isc_stdio_flush(fp));
+	CHECK(isc_stdio_sync(fp));
+	result = isc_stdio_close(fp);
+	fp = NULL;
+	if (result == ISC_R_SUCCESS) {
+		result = isc_file_rename(tempname, filename);
+	}
+
+cleanup:
+	if (fp != NULL) {
+		(void)isc_stdio_close(fp);
+	}
+	if (result != ISC_R_SUCCESS && created) {
+		(void)isc_file_remove(tempname);
+	}
+	if (b != NULL) {
+		isc_buffer_free(&b);
+	}
+	if (dbiter != NULL) {
+		dns_dbiterator_destroy(&dbiter);
+	}
+	if (db != NULL) {
+		dns_db_detach(&db);
+	}
+	return result;
+}
+
+/*
+ * Parse the ncache rdata in the remaining region of 'source' into
+ * 'target', checking the owner name and the rdata of every record in it.
+ */
+static isc_result_t
+loadsnapshot_ncache(dns_rdataclass_t rdclass, isc_buffer_t *source,
+		    isc_buffer_t *target) {
+	isc_result_t result;
+
+	while (isc_buffer_remaininglength(source) != 0) {
+		dns_fixedname_t fixed;
+		dns_name_t *name = dns_fixedname_initname(&fixed);
+		dns_rdatatype_t type;
+		unsigned int count;
+
+		result = dns_name_fromwire(name, source, DNS_DECOMPRESS_NEVER,
+					   NULL);
+		if (result != ISC_R_SUCCESS) {
+			return result;
+		}
+		if (isc_buffer_remaininglength(source) < 5 ||
+		    isc_buffer_availablelength(target) < name->length + 5)
+		{
+			return DNS_R_FORMERR;
+		}
+		isc_buffer_putmem(target, name->ndata, name->length);
+		type = isc_buffer_getuint16(source);
+		isc_buffer_putuint16(target, type);
+		isc_buffer_putuint8(target, isc_buffer_getuint8(source));
+		count = isc_buffer_getuint16(source);
+		isc_buffer_putuint16(target, count);
+
+		for (unsigned int i = 0; i < count; i++) {
+			isc_buffer_t rdata;
+			unsigned char *lengthp = NULL;
+			unsigned int length;
+
+			if (isc_buffer_remaininglength(source) < 2 ||
+			    isc_buffer_availablelength(target) < 2)
+			{
+				return DNS_R_FORMERR;
+			}
+			length = isc_buffer_getuint16(source);
+			if (isc_buffer_remaininglength(source) < length) {
+				return DNS_R_FORMERR;
+			}
+			lengthp = isc_buffer_used(target);
+			isc_buffer_putuint16(target, 0);
+
+			rdata = *source;
+			isc_buffer_setactive(&rdata, length);
+			result = dns_rdata_fromwire(NULL, rdclass, type, &rdata,
+						    DNS_DECOMPRESS_NEVER,
+						    target);
+			if (result != ISC_R_SUCCESS) {
+				return result;
+			}
+			isc_buffer_forward(source, length);
+
+			length = (unsigned char *)isc_buffer_used(target) -
+				 lengthp - 2;
+			lengthp[0] = length >> 8;
+			lengthp[1] = length & 0xff;
+		}
+	}
+
+	return ISC_R_SUCCESS;
+}
+
+/*
+ * Parse one snapshot record from 'b' and add it to 'db'.
+ */
+static isc_result_t
+loadsnapshot_record(dns_cache_t *cache, dns_db_t *db, isc_buffer_t *b,
+		    isc_stdtime_t now, dns_ttl_t stalettl, bool *loadedp) {
+	isc_result_t result;
+	uint32_t expire;
+	dns_trust_t trust;
+	unsigned int flags, count, namelen;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset = DNS_RDATASET_INIT;
+	dns_rdata_t *rdatas = NULL;
+	dns_fixedname_t fixed;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	dns_dbnode_t *node = NULL;
+	isc_buffer_t source, *target = NULL;
+	unsigned char *start = NULL;
+	unsigned int datalen = 0;
+
+	*loadedp = false;
+
+	if (isc_buffer_remaininglength(b) < 13) {
+		return ISC_R_UNEXPECTEDEND;
+	}
+
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.rdclass = cache->rdclass;
+	expire = isc_buffer_getuint32(b);
+	rdatalist.type = isc_buffer_getuint16(b);
+	rdatalist.covers = isc_buffer_getuint16(b);
+	trust = isc_buffer_getuint8(b);
+	flags = isc_buffer_getuint8(b);
+	count = isc_buffer_getuint16(b);
+	namelen = isc_buffer_getuint8(b);
+
+	if (count == 0) {
+		return DNS_R_FORMERR;
+	}
+
+	if (isc_buffer_remaininglength(b) < namelen) {
+		return ISC_R_UNEXPECTEDEND;
+	}
+	isc_buffer_init(&source, isc_buffer_current(b), namelen);
+	isc_buffer_add(&source, namelen);
+	isc_buffer_setactive(&source, namelen);
+	result = dns_name_fromwire(name, &source, DNS_DECOMPRESS_NEVER, NULL);
+	if (result != ISC_R_SUCCESS) {
+		return result;
+	}
+	if (isc_buffer_remaininglength(&source) != 0) {
+		return DNS_R_FORMERR;
+	}
+	isc_buffer_forward(b, namelen);
+
+	/*
+	 * Find where the rdata of the RRset end, so that the buffer they
+	 * are parsed into can be sized.
+	 */
+	start = isc_buffer_current(b);
+	for (unsigned int i = 0; i < count; i++) {
+		unsigned int length;
+
+		if (isc_buffer_remaininglength(b) < 2) {
+			return ISC_R_UNEXPECTEDEND;
+		}
+		length = isc_buffer_getuint16(b);
+		if (isc_buffer_remaininglength(b) < length) {
+			return ISC_R_UNEXPECTEDEND;
+		}
+		isc_buffer_forward(b, length);
+		datalen += length;
+	}
+	isc_buffer_init(&source, start,
+			(unsigned char *)isc_buffer_current(b) - start);
+	isc_buffer_add(&source, isc_buffer_length(&source));
+
+	/*
+	 * The rdata are parsed as they would be from a message, so that
+	 * a corrupt snapshot can't put malformed rdata in the cache.
+	 */
+	rdatas = isc_mem_cget(cache->mctx, count, sizeof(rdatas[0]));
+	isc_buffer_allocate(cache->mctx, &target, ISC_MAX(datalen, 1));
+	for (unsigned int i = 0; i < count; i++) {
+		unsigned int length = isc_buffer_getuint16(&source);
+
+		isc_buffer_setactive(&source, length);
+		dns_rdata_init(&rdatas[i]);
+		if (rdatalist.type == 0) {
+			isc_region_t r = { .base = isc_buffer_used(target) };
+			isc_buffer_t ncache;
+
+			isc_buffer_init(&ncache, isc_buffer_current(&source),
+					length);
+			isc_buffer_add(&ncache, length);
+			CHECK(loadsnapshot_ncache(cache->rdclass, &ncache,
+						  target));
+			isc_buffer_forward(&source, length);
+			r.length = (unsigned char *)isc_buffer_used(target) -
+				   r.base;
+			dns_rdata_fromregion(&rdatas[i], cache->rdclass, 0,
+					     &r);
+		} else {
+			CHECK(dns_rdata_fromwire(&rdatas[i], cache->rdclass,
+						 rdatalist.type, &source,
+						 DNS_DECOMPRESS_NEVER, target));
+		}
+		ISC_LIST_APPEND(rdatalist.rdata, &rdatas[i], link);
+	}
+
+	/*
+	 * Restore the remaining TTL of the active RRsets.  The stale ones
+	 * are added as if it was just before they expired, so that they are
+	 * served stale until the end of the current stale window.  The
+	 * others have expired in the meantime and are skipped.
+	 */
+	if (expire > now) {
+		rdatalist.ttl = expire - now;
+	} else if ((flags & SNAPSHOT_STALE) != 0 &&
+		   (flags & SNAPSHOT_NXDOMAIN) == 0 &&
+		   (isc_stdtime_t)(expire + stalettl) > now)
+	{
+		rdatalist.ttl = 1;
+		now = expire - 1;
+	} else {
+		result = ISC_R_SUCCESS;
+		goto cleanup;
+	}
+
+	dns_rdatalist_tordataset(&rdatalist, &rdataset);
+	rdataset.trust = trust;
+	if ((flags & SNAPSHOT_NEGATIVE) != 0) {
+		rdataset.attributes |= DNS_RDATASETATTR_NEGATIVE;
+	}
+	if ((flags & SNAPSHOT_NXDOMAIN) != 0) {
+		rdataset.attributes |= DNS_RDATASETATTR_NXDOMAIN;
+	}
+	if ((flags & SNAPSHOT_OPTOUT) != 0) {
+		rdataset.attributes |= DNS_RDATASETATTR_OPTOUT;
+	}
+
+	CHECK(dns_db_findnode(db, name, true, &node));
+	result = dns_db_addrdataset(db, node, NULL, now, &rdataset, 0, NULL);
+	dns_db_detachnode(db, &node);
+	if (result == DNS_R_UNCHANGED) {
+		result = ISC_R_SUCCESS;
+	} else if (result == ISC_R_SUCCESS) {
+		*loadedp = true;
+	}
+
+cleanup:
+	if (dns_rdataset_isassociated(&rdataset)) {
+		dns_rdataset_disassociate(&rdataset);
+	}
+	isc_buffer_free(&target);
+	isc_mem_cput(cache->mctx, rdatas, count, sizeof(rdatas[0]));
+	return result;
+}
+
+isc_result_t
+dns_cache_loadsnapshot(dns_cache_t *cache, const char *filename,
+		       size_t *loadedp) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	isc_stdtime_t now = isc_stdtime_now();
+	dns_ttl_t stalettl = 0;
+	isc_buffer_t b;
+	struct stat st;
+	void *map = MAP_FAILED;
+	size_t loaded = 0;
+	int fd;
+
+	REQUIRE(VALID_CACHE(cache));
+	REQUIRE(filename != NULL);
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		return isc_errno_toresult(errno);
+	}
+	if (fstat(fd, &st) < 0) {
+		result = isc_errno_toresult(errno);
+		goto cleanup;
+	}
+	if (st.st_size < 16) {
+		CHECK(ISC_R_UNEXPECTEDEND);
+	}
+
+	/*
+	 * The snapshot is mapped read-only and parsed in place; the RRsets
+	 * are copied into the cache database as they are added.
+	 */
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED) {
+		result = isc_errno_toresult(errno);
+		goto cleanup;
+	}
+#if defined(MADV_SEQUENTIAL)
+	(void)madvise(map, st.st_size, MADV_SEQUENTIAL);
+#endif /* if defined(MADV_SEQUENTIAL) */
+
+	isc_buffer_init(&b, map, st.st_size);
+	isc_buffer_add(&b, st.st_size);
+	if (isc_buffer_getuint32(&b) != SNAPSHOT_MAGIC ||
+	    isc_buffer_getuint32(&b) != SNAPSHOT_VERSION)
+	{
+		CHECK(ISC_R_NOTIMPLEMENTED);
+	}
+	if (isc_buffer_getuint16(&b) != cache->rdclass) {
+		CHECK(DNS_R_BADCLASS);
+	}
+	(void)isc_buffer_getuint16(&b);
+	(void)isc_buffer_getuint32(&b);
+
+	dns_cache_attachdb(cache, &db);
+	(void)dns_db_getservestalettl(db, &stalettl);
+
+	while (isc_buffer_remaininglength(&b) > 0) {
+		bool added = false;
+
+		CHECK(loadsnapshot_record(cache, db, &b, now, stalettl,
+					  &added));
+		if (added) {
+			loaded++;
+		}
+	}
+
+	if (loadedp != NULL) {
+		*loadedp = loaded;
+	}
+
+cleanup:
+	if (db != NULL) {
+		dns_db_detach(&db);
+	}
+	if (map != MAP_FAILED) {
+		(void)munmap(map, st.st_size);
+	}
+	(void)close(fd);
+	return result;
+}
+
 /*
  * XXX: Much of the following code has been copied in from statschannel.c.
  * We should refactor this into a generic function in stats.c that can be
@@ -630,12 +1242,18 @@ dns_cache_dumpstats(dns_cache_t *cache, FILE *fp) {
 	fprintf(fp, "%20" PRIu64 " %s\n",
 		values[dns_cachestatscounter_deletelru],
 		"cache records deleted due to memory exhaustion");
+	fprintf(fp, "%20" PRIu64 " %s\n",
+		values[dns_cachestatscounter_deletesieve],
+		"cache records evicted by SIEVE due to memory exhaustion");
 	fprintf(fp, "%20" PRIu64 " %s\n",
 		values[dns_cachestatscounter_deletettl],
 		"cache records deleted due to TTL expiration");
 	fprintf(fp, "%20" PRIu64 " %s\n",
 		values[dns_cachestatscounter_coveringnsec],
 		"covering nsec returned");
+	fprintf(fp, "%20" PRIu64 " %s\n",
+		values[dns_cachestatscounter_coveringnsecskip],
+		"covering nsec lookups rejected by the NSEC index");
 	fprintf(fp, "%20u %s\n", dns_db_nodecount(cache->db, dns_dbtree_main),
 		"cache database nodes");
 	fprintf(fp, "%20u %s\n", dns_db_nodecount(cache->db, dns_dbtree_nsec),
@@ -648,6 +1266,9 @@ dns_cache_dumpstats(dns_cache_t *cache, FILE *fp) {
 
 	fprintf(fp, "%20" PRIu64 " %s\n", (uint64_t)isc_mem_inuse(cache->hmctx),
 		"cache heap memory in use");
+
+	fprintf(fp, "%20" PRIu64 " %s\n", dns_db_getsharedsize(cache->db),
+		"cache negative data bytes shared");
 }
 
 #ifdef HAVE_LIBXML2
@@ -692,10 +1313,15 @@ dns_cache_renderxml(dns_cache_t *cache, void *writer0) {
 			values[dns_cachestatscounter_querymisses], writer));
 	TRY0(renderstat("DeleteLRU", values[dns_cachestatscounter_deletelru],
 			writer));
+	TRY0(renderstat("DeleteSIEVE",
+			values[dns_cachestatscounter_deletesieve], writer));
 	TRY0(renderstat("DeleteTTL", values[dns_cachestatscounter_deletettl],
 			writer));
 	TRY0(renderstat("CoveringNSEC",
 			values[dns_cachestatscounter_coveringnsec], writer));
+	TRY0(renderstat("CoveringNSECSkip",
+			values[dns_cachestatscounter_coveringnsecskip],
+			writer));
 
 	TRY0(renderstat("CacheNodes",
 			dns_db_nodecount(cache->db, dns_dbtree_main), writer));
@@ -706,6 +1332,9 @@ dns_cache_renderxml(dns_cache_t *cache, void *writer0) {
 	TRY0(renderstat("TreeMemInUse", isc_mem_inuse(cache->tmctx), writer));
 
 	TRY0(renderstat("HeapMemInUse", isc_mem_inuse(cache->hmctx), writer));
+
+	TRY0(renderstat("NegativeSharedBytes",
+			dns_db_getsharedsize(cache->db), writer));
 error:
 	return xmlrc;
 }
@@ -753,6 +1382,10 @@ dns_cache_renderjson(dns_cache_t *cache, void *cstats0) {
 	CHECKMEM(obj);
 	json_object_object_add(cstats, "DeleteLRU", obj);
 
+	obj = json_object_new_int64(values[dns_cachestatscounter_deletesieve]);
+	CHECKMEM(obj);
+	json_object_object_add(cstats, "DeleteSIEVE", obj);
+
 	obj = json_object_new_int64(values[dns_cachestatscounter_deletettl]);
 	CHECKMEM(obj);
 	json_object_object_add(cstats, "DeleteTTL", obj);
@@ -761,6 +1394,11 @@ dns_cache_renderjson(dns_cache_t *cache, void *cstats0) {
 	CHECKMEM(obj);
 	json_object_object_add(cstats, "CoveringNSEC", obj);
 
+	obj = json_object_new_int64(
+		values[dns_cachestatscounter_coveringnsecskip]);
+	CHECKMEM(obj);
+	json_object_object_add(cstats, "CoveringNSECSkip", obj);
+
 	obj = json_object_new_int64(
 		dns_db_nodecount(cache->db, dns_dbtree_main));
 	CHECKMEM(obj);
@@ -783,6 +1421,10 @@ dns_cache_renderjson(dns_cache_t *cache, void *cstats0) {
 	CHECKMEM(obj);
 	json_object_object_add(cstats, "HeapMemInUse", obj);
 
+	obj = json_object_new_int64(dns_db_getsharedsize(cache->db));
+	CHECKMEM(obj);
+	json_object_object_add(cstats, "NegativeSharedBytes", obj);
+
 	result = ISC_R_SUCCESS;
 error:
 	return result;
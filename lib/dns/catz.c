@@ -25,11 +25,13 @@
 #include <isc/mem.h>
 #include <isc/parseint.h>
 #include <isc/result.h>
+#include <isc/serial.h>
 #include <isc/util.h>
 #include <isc/work.h>
 
 #include <dns/catz.h>
 #include <dns/dbiterator.h>
+#include <dns/journal.h>
 #include <dns/rdatasetiter.h>
 #include <dns/view.h>
 #include <dns/zone.h>
@@ -96,6 +98,13 @@ struct dns_catz_zone {
 	dns_db_t *updb;		      /* zones database we're working on */
 	dns_dbversion_t *updbversion; /* version we're working on */
 
+	/*
+	 * The serial of the last version merged, from which the next
+	 * one can be processed incrementally.
+	 */
+	bool haveserial;
+	uint32_t serial;
+
 	isc_timer_t *updatetimer;
 
 	bool active;
@@ -477,6 +486,202 @@ dns_catz_zone_resetdefoptions(dns_catz_zone_t *catz) {
 
 	dns_catz_options_free(&catz->defoptions, catz->catzs->mctx);
 	dns_catz_options_init(&catz->defoptions);
+
+	/* The new options must be applied to all the members. */
+	LOCK(&catz->lock);
+	catz->haveserial = false;
+	UNLOCK(&catz->lock);
+}
+
+/*
+ * Compare the new catalog entry 'nentry' with the old one of the same
+ * 'key', if any, and schedule the member zone to be added or modified
+ * in 'toadd' or 'tomod'.  The old entry is removed from 'catz->entries',
+ * so that the entries left there afterwards are the deleted ones.
+ */
+static void
+catz_merge_entry(dns_catz_zone_t *catz, unsigned char *key, size_t keysize,
+		 dns_catz_entry_t *nentry, isc_ht_t *toadd, isc_ht_t *tomod,
+		 const char *czname) {
+	isc_result_t result, find_result;
+	dns_catz_zone_t *parentcatz = NULL;
+	dns_catz_entry_t *oentry = NULL;
+	dns_zone_t *zone = NULL;
+	char zname[DNS_NAME_FORMATSIZE];
+	dns_catz_zoneop_fn_t delzone = catz->catzs->zmm->delzone;
+
+	dns_name_format(&nentry->name, zname, DNS_NAME_FORMATSIZE);
+
+	isc_log_write(DNS_LOGCATEGORY_GENERAL, DNS_LOGMODULE_CATZ,
+		      ISC_LOG_DEBUG(3),
+		      "catz: iterating over '%s' from catalog '%s'", zname,
+		      czname);
+	dns_catz_options_setdefault(catz->catzs->mctx, &catz->zoneoptions,
+				    &nentry->opts);
+
+	/* Try to find the zone in the view */
+	find_result = dns_view_findzone(catz->catzs->view,
+					dns_catz_entry_getname(nentry),
+					DNS_ZTFIND_EXACT, &zone);
+	if (find_result == ISC_R_SUCCESS) {
+		dns_catz_coo_t *coo = NULL;
+		char pczname[DNS_NAME_FORMATSIZE];
+		bool parentcatz_locked = false;
+
+		/*
+		 * Change of ownership (coo) processing, if required
+		 */
+		parentcatz = dns_zone_get_parentcatz(zone);
+		if (parentcatz != NULL && parentcatz != catz) {
+			UNLOCK(&catz->lock);
+			LOCK(&parentcatz->lock);
+			parentcatz_locked = true;
+		}
+		if (parentcatz_locked &&
+		    isc_ht_find(parentcatz->coos, nentry->name.ndata,
+				nentry->name.length,
+				(void **)&coo) == ISC_R_SUCCESS &&
+		    dns_name_equal(&coo->name, &catz->name))
+		{
+			dns_name_format(&parentcatz->name, pczname,
+					DNS_NAME_FORMATSIZE);
+			isc_log_write(DNS_LOGCATEGORY_GENERAL,
+				      DNS_LOGMODULE_CATZ, ISC_LOG_DEBUG(3),
+				      "catz: zone '%s' "
+				      "change of ownership from "
+				      "'%s' to '%s'",
+				      zname, pczname, czname);
+			result = delzone(nentry, parentcatz,
+					 parentcatz->catzs->view,
+					 parentcatz->catzs->zmm->udata);
+			isc_log_write(DNS_LOGCATEGORY_GENERAL,
+				      DNS_LOGMODULE_CATZ, ISC_LOG_INFO,
+				      "catz: deleting zone '%s' "
+				      "from catalog '%s' - %s",
+				      zname, pczname,
+				      isc_result_totext(result));
+		}
+		if (parentcatz_locked) {
+			UNLOCK(&parentcatz->lock);
+			LOCK(&catz->lock);
+		}
+		dns_zone_detach(&zone);
+	}
+
+	/* Try to find the zone in the old catalog zone */
+	result = isc_ht_find(catz->entries, key, (uint32_t)keysize,
+			     (void **)&oentry);
+	if (result != ISC_R_SUCCESS) {
+		if (find_result == ISC_R_SUCCESS && parentcatz == catz) {
+			/*
+			 * This means that the zone's unique label
+			 * has been changed, in that case we must
+			 * reset the zone's internal state by removing
+			 * and re-adding it.
+			 *
+			 * Scheduling the addition now, the removal will
+			 * be scheduled by the caller, as the old entry is
+			 * left in 'catz->entries', and then we will
+			 * perform deletions earlier than additions and
+			 * modifications.
+			 */
+			isc_log_write(DNS_LOGCATEGORY_GENERAL,
+				      DNS_LOGMODULE_CATZ, ISC_LOG_INFO,
+				      "catz: zone '%s' unique label "
+				      "has changed, reset state",
+				      zname);
+		}
+
+		catz_entry_add_or_mod(catz, toadd, key, keysize, nentry, NULL,
+				      "adding", zname, czname);
+		return;
+	}
+
+	if (find_result != ISC_R_SUCCESS) {
+		isc_log_write(DNS_LOGCATEGORY_GENERAL, DNS_LOGMODULE_CATZ,
+			      ISC_LOG_DEBUG(3),
+			      "catz: zone '%s' was expected to exist "
+			      "but can not be found, will be restored",
+			      zname);
+		catz_entry_add_or_mod(catz, toadd, key, keysize, nentry,
+				      oentry, "adding", zname, czname);
+		return;
+	}
+
+	if (dns_catz_entry_cmp(oentry, nentry) != true) {
+		catz_entry_add_or_mod(catz, tomod, key, keysize, nentry,
+				      oentry, "modifying", zname, czname);
+		return;
+	}
+
+	/*
+	 * Delete the old entry so that it won't accidentally be
+	 * removed as a non-existing entry.
+	 */
+	dns_catz_entry_detach(catz, &oentry);
+	result = isc_ht_delete(catz->entries, key, (uint32_t)keysize);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+}
+
+/*
+ * Call 'zoneop' for all the entries of 'ht', emptying it.
+ */
+static void
+catz_zoneop_all(dns_catz_zone_t *catz, isc_ht_t *ht,
+		dns_catz_zoneop_fn_t zoneop, const char *msg,
+		const char *czname) {
+	isc_result_t result;
+	isc_ht_iter_t *iter = NULL;
+	char zname[DNS_NAME_FORMATSIZE];
+
+	isc_ht_iter_create(ht, &iter);
+	for (result = isc_ht_iter_first(iter); result == ISC_R_SUCCESS;
+	     result = isc_ht_iter_delcurrent_next(iter))
+	{
+		dns_catz_entry_t *entry = NULL;
+		isc_ht_iter_current(iter, (void **)&entry);
+
+		dns_name_format(&entry->name, zname, DNS_NAME_FORMATSIZE);
+		result = zoneop(entry, catz, catz->catzs->view,
+				catz->catzs->zmm->udata);
+		isc_log_write(DNS_LOGCATEGORY_GENERAL, DNS_LOGMODULE_CATZ,
+			      ISC_LOG_INFO,
+			      "catz: %s zone '%s' from catalog '%s' - %s", msg,
+			      zname, czname, isc_result_totext(result));
+	}
+	RUNTIME_CHECK(result == ISC_R_NOMORE);
+	isc_ht_iter_destroy(&iter);
+}
+
+/*
+ * Delete the member zones of the entries of 'ht', emptying it and
+ * detaching the entries.
+ */
+static void
+catz_delete_all(dns_catz_zone_t *catz, isc_ht_t *ht, const char *czname) {
+	isc_result_t result;
+	isc_ht_iter_t *iter = NULL;
+	char zname[DNS_NAME_FORMATSIZE];
+
+	isc_ht_iter_create(ht, &iter);
+	for (result = isc_ht_iter_first(iter); result == ISC_R_SUCCESS;
+	     result = isc_ht_iter_delcurrent_next(iter))
+	{
+		dns_catz_entry_t *entry = NULL;
+		isc_ht_iter_current(iter, (void **)&entry);
+
+		dns_name_format(&entry->name, zname, DNS_NAME_FORMATSIZE);
+		result = catz->catzs->zmm->delzone(entry, catz,
+						   catz->catzs->view,
+						   catz->catzs->zmm->udata);
+		isc_log_write(DNS_LOGCATEGORY_GENERAL, DNS_LOGMODULE_CATZ,
+			      ISC_LOG_INFO,
+			      "catz: deleting zone '%s' from catalog '%s' - %s",
+			      zname, czname, isc_result_totext(result));
+		dns_catz_entry_detach(catz, &entry);
+	}
+	RUNTIME_CHECK(result == ISC_R_NOMORE);
+	isc_ht_iter_destroy(&iter);
 }
 
 /*%<
@@ -491,13 +696,10 @@ dns_catz_zone_resetdefoptions(dns_catz_zone_t *catz) {
 static isc_result_t
 dns__catz_zones_merge(dns_catz_zone_t *catz, dns_catz_zone_t *newcatz) {
 	isc_result_t result;
-	isc_ht_iter_t *iter1 = NULL, *iter2 = NULL;
-	isc_ht_iter_t *iteradd = NULL, *itermod = NULL;
+	isc_ht_iter_t *iter1 = NULL;
 	isc_ht_t *toadd = NULL, *tomod = NULL;
 	bool delcur = false;
 	char czname[DNS_NAME_FORMATSIZE];
-	char zname[DNS_NAME_FORMATSIZE];
-	dns_catz_zoneop_fn_t addzone, modzone, delzone;
 
 	REQUIRE(DNS_CATZ_ZONE_VALID(catz));
 	REQUIRE(DNS_CATZ_ZONE_VALID(newcatz));
@@ -506,10 +708,6 @@ dns__catz_zones_merge(dns_catz_zone_t *catz, dns_catz_zone_t *newcatz) {
 
 	/* TODO verify the new zone first! */
 
-	addzone = catz->catzs->zmm->addzone;
-	modzone = catz->catzs->zmm->modzone;
-	delzone = catz->catzs->zmm->delzone;
-
 	/* Copy zoneoptions from newcatz into catz. */
 
 	dns_catz_options_free(&catz->zoneoptions, catz->catzs->mctx);
@@ -523,14 +721,6 @@ dns__catz_zones_merge(dns_catz_zone_t *catz, dns_catz_zone_t *newcatz) {
 	isc_ht_init(&toadd, catz->catzs->mctx, 1, ISC_HT_CASE_SENSITIVE);
 	isc_ht_init(&tomod, catz->catzs->mctx, 1, ISC_HT_CASE_SENSITIVE);
 	isc_ht_iter_create(newcatz->entries, &iter1);
-	isc_ht_iter_create(catz->entries, &iter2);
-
-	/*
-	 * We can create those iterators now, even though toadd and tomod are
-	 * empty
-	 */
-	isc_ht_iter_create(toadd, &iteradd);
-	isc_ht_iter_create(tomod, &itermod);
 
 	/*
 	 * First - walk the new zone and find all nodes that are not in the
@@ -540,11 +730,7 @@ dns__catz_zones_merge(dns_catz_zone_t *catz, dns_catz_zone_t *newcatz) {
 	     result = delcur ? isc_ht_iter_delcurrent_next(iter1)
 			     : isc_ht_iter_next(iter1))
 	{
-		isc_result_t find_result;
-		dns_catz_zone_t *parentcatz = NULL;
 		dns_catz_entry_t *nentry = NULL;
-		dns_catz_entry_t *oentry = NULL;
-		dns_zone_t *zone = NULL;
 		unsigned char *key = NULL;
 		size_t keysize;
 		delcur = false;
@@ -563,120 +749,8 @@ dns__catz_zones_merge(dns_catz_zone_t *catz, dns_catz_zone_t *newcatz) {
 			continue;
 		}
 
-		dns_name_format(&nentry->name, zname, DNS_NAME_FORMATSIZE);
-
-		isc_log_write(DNS_LOGCATEGORY_GENERAL, DNS_LOGMODULE_CATZ,
-			      ISC_LOG_DEBUG(3),
-			      "catz: iterating over '%s' from catalog '%s'",
-			      zname, czname);
-		dns_catz_options_setdefault(catz->catzs->mctx,
-					    &catz->zoneoptions, &nentry->opts);
-
-		/* Try to find the zone in the view */
-		find_result = dns_view_findzone(catz->catzs->view,
-						dns_catz_entry_getname(nentry),
-						DNS_ZTFIND_EXACT, &zone);
-		if (find_result == ISC_R_SUCCESS) {
-			dns_catz_coo_t *coo = NULL;
-			char pczname[DNS_NAME_FORMATSIZE];
-			bool parentcatz_locked = false;
-
-			/*
-			 * Change of ownership (coo) processing, if required
-			 */
-			parentcatz = dns_zone_get_parentcatz(zone);
-			if (parentcatz != NULL && parentcatz != catz) {
-				UNLOCK(&catz->lock);
-				LOCK(&parentcatz->lock);
-				parentcatz_locked = true;
-			}
-			if (parentcatz_locked &&
-			    isc_ht_find(parentcatz->coos, nentry->name.ndata,
-					nentry->name.length,
-					(void **)&coo) == ISC_R_SUCCESS &&
-			    dns_name_equal(&coo->name, &catz->name))
-			{
-				dns_name_format(&parentcatz->name, pczname,
-						DNS_NAME_FORMATSIZE);
-				isc_log_write(DNS_LOGCATEGORY_GENERAL,
-					      DNS_LOGMODULE_CATZ,
-					      ISC_LOG_DEBUG(3),
-					      "catz: zone '%s' "
-					      "change of ownership from "
-					      "'%s' to '%s'",
-					      zname, pczname, czname);
-				result = delzone(nentry, parentcatz,
-						 parentcatz->catzs->view,
-						 parentcatz->catzs->zmm->udata);
-				isc_log_write(DNS_LOGCATEGORY_GENERAL,
-					      DNS_LOGMODULE_CATZ, ISC_LOG_INFO,
-					      "catz: deleting zone '%s' "
-					      "from catalog '%s' - %s",
-					      zname, pczname,
-					      isc_result_totext(result));
-			}
-			if (parentcatz_locked) {
-				UNLOCK(&parentcatz->lock);
-				LOCK(&catz->lock);
-			}
-			dns_zone_detach(&zone);
-		}
-
-		/* Try to find the zone in the old catalog zone */
-		result = isc_ht_find(catz->entries, key, (uint32_t)keysize,
-				     (void **)&oentry);
-		if (result != ISC_R_SUCCESS) {
-			if (find_result == ISC_R_SUCCESS && parentcatz == catz)
-			{
-				/*
-				 * This means that the zone's unique label
-				 * has been changed, in that case we must
-				 * reset the zone's internal state by removing
-				 * and re-adding it.
-				 *
-				 * Scheduling the addition now, the removal will
-				 * be scheduled below, when walking the old
-				 * zone for remaining entries, and then we will
-				 * perform deletions earlier than additions and
-				 * modifications.
-				 */
-				isc_log_write(DNS_LOGCATEGORY_GENERAL,
-					      DNS_LOGMODULE_CATZ, ISC_LOG_INFO,
-					      "catz: zone '%s' unique label "
-					      "has changed, reset state",
-					      zname);
-			}
-
-			catz_entry_add_or_mod(catz, toadd, key, keysize, nentry,
-					      NULL, "adding", zname, czname);
-			continue;
-		}
-
-		if (find_result != ISC_R_SUCCESS) {
-			isc_log_write(DNS_LOGCATEGORY_GENERAL,
-				      DNS_LOGMODULE_CATZ, ISC_LOG_DEBUG(3),
-				      "catz: zone '%s' was expected to exist "
-				      "but can not be found, will be restored",
-				      zname);
-			catz_entry_add_or_mod(catz, toadd, key, keysize, nentry,
-					      oentry, "adding", zname, czname);
-			continue;
-		}
-
-		if (dns_catz_entry_cmp(oentry, nentry) != true) {
-			catz_entry_add_or_mod(catz, tomod, key, keysize, nentry,
-					      oentry, "modifying", zname,
-					      czname);
-			continue;
-		}
-
-		/*
-		 * Delete the old entry so that it won't accidentally be
-		 * removed as a non-existing entry below.
-		 */
-		dns_catz_entry_detach(catz, &oentry);
-		result = isc_ht_delete(catz->entries, key, (uint32_t)keysize);
-		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+		catz_merge_entry(catz, key, keysize, nentry, toadd, tomod,
+				 czname);
 	}
 	RUNTIME_CHECK(result == ISC_R_NOMORE);
 	isc_ht_iter_destroy(&iter1);
@@ -684,58 +758,15 @@ dns__catz_zones_merge(dns_catz_zone_t *catz, dns_catz_zone_t *newcatz) {
 	/*
 	 * Then - walk the old zone; only deleted entries should remain.
 	 */
-	for (result = isc_ht_iter_first(iter2); result == ISC_R_SUCCESS;
-	     result = isc_ht_iter_delcurrent_next(iter2))
-	{
-		dns_catz_entry_t *entry = NULL;
-		isc_ht_iter_current(iter2, (void **)&entry);
-
-		dns_name_format(&entry->name, zname, DNS_NAME_FORMATSIZE);
-		result = delzone(entry, catz, catz->catzs->view,
-				 catz->catzs->zmm->udata);
-		isc_log_write(DNS_LOGCATEGORY_GENERAL, DNS_LOGMODULE_CATZ,
-			      ISC_LOG_INFO,
-			      "catz: deleting zone '%s' from catalog '%s' - %s",
-			      zname, czname, isc_result_totext(result));
-		dns_catz_entry_detach(catz, &entry);
-	}
-	RUNTIME_CHECK(result == ISC_R_NOMORE);
-	isc_ht_iter_destroy(&iter2);
+	catz_delete_all(catz, catz->entries, czname);
 	/* At this moment catz->entries has to be be empty. */
 	INSIST(isc_ht_count(catz->entries) == 0);
 	isc_ht_destroy(&catz->entries);
 
-	for (result = isc_ht_iter_first(iteradd); result == ISC_R_SUCCESS;
-	     result = isc_ht_iter_delcurrent_next(iteradd))
-	{
-		dns_catz_entry_t *entry = NULL;
-		isc_ht_iter_current(iteradd, (void **)&entry);
-
-		dns_name_format(&entry->name, zname, DNS_NAME_FORMATSIZE);
-		result = addzone(entry, catz, catz->catzs->view,
-				 catz->catzs->zmm->udata);
-		isc_log_write(DNS_LOGCATEGORY_GENERAL, DNS_LOGMODULE_CATZ,
-			      ISC_LOG_INFO,
-			      "catz: adding zone '%s' from catalog "
-			      "'%s' - %s",
-			      zname, czname, isc_result_totext(result));
-	}
-
-	for (result = isc_ht_iter_first(itermod); result == ISC_R_SUCCESS;
-	     result = isc_ht_iter_delcurrent_next(itermod))
-	{
-		dns_catz_entry_t *entry = NULL;
-		isc_ht_iter_current(itermod, (void **)&entry);
-
-		dns_name_format(&entry->name, zname, DNS_NAME_FORMATSIZE);
-		result = modzone(entry, catz, catz->catzs->view,
-				 catz->catzs->zmm->udata);
-		isc_log_write(DNS_LOGCATEGORY_GENERAL, DNS_LOGMODULE_CATZ,
-			      ISC_LOG_INFO,
-			      "catz: modifying zone '%s' from catalog "
-			      "'%s' - %s",
-			      zname, czname, isc_result_totext(result));
-	}
+	catz_zoneop_all(catz, toadd, catz->catzs->zmm->addzone, "adding",
+			czname);
+	catz_zoneop_all(catz, tomod, catz->catzs->zmm->modzone, "modifying",
+			czname);
 
 	catz->entries = newcatz->entries;
 	newcatz->entries = NULL;
@@ -769,8 +800,6 @@ dns__catz_zones_merge(dns_catz_zone_t *catz, dns_catz_zone_t *newcatz) {
 
 	result = ISC_R_SUCCESS;
 
-	isc_ht_iter_destroy(&iteradd);
-	isc_ht_iter_destroy(&itermod);
 	isc_ht_destroy(&toadd);
 	isc_ht_destroy(&tomod);
 
@@ -779,6 +808,131 @@ dns__catz_zones_merge(dns_catz_zone_t *catz, dns_catz_zone_t *newcatz) {
 	return result;
 }
 
+/*%<
+ * Merge the entries of 'newcatz' for the member zone labels in 'changed'
+ * into 'catz', as dns__catz_zones_merge() does for the whole catalog.
+ * 'newcatz' only holds the entries of the changed members; the members
+ * that are not in it have been removed.
+ *
+ * Requires:
+ * \li	'catz' is a valid dns_catz_zone_t.
+ * \li	'newcatz' is a valid dns_catz_zone_t.
+ */
+static isc_result_t
+dns__catz_zones_merge_changes(dns_catz_zone_t *catz, dns_catz_zone_t *newcatz,
+			      isc_ht_t *changed) {
+	isc_result_t result;
+	isc_ht_iter_t *iter = NULL;
+	isc_ht_t *toadd = NULL, *tomod = NULL, *todel = NULL;
+	char czname[DNS_NAME_FORMATSIZE];
+
+	REQUIRE(DNS_CATZ_ZONE_VALID(catz));
+	REQUIRE(DNS_CATZ_ZONE_VALID(newcatz));
+
+	LOCK(&catz->lock);
+
+	dns_name_format(&catz->name, czname, DNS_NAME_FORMATSIZE);
+
+	isc_ht_init(&toadd, catz->catzs->mctx, 1, ISC_HT_CASE_SENSITIVE);
+	isc_ht_init(&tomod, catz->catzs->mctx, 1, ISC_HT_CASE_SENSITIVE);
+	isc_ht_init(&todel, catz->catzs->mctx, 1, ISC_HT_CASE_SENSITIVE);
+	isc_ht_iter_create(changed, &iter);
+
+	/*
+	 * Drop the change of ownership records of the old entries first,
+	 * as a member zone may have moved from one label to another.
+	 */
+	for (result = isc_ht_iter_first(iter); result == ISC_R_SUCCESS;
+	     result = isc_ht_iter_next(iter))
+	{
+		dns_catz_entry_t *oentry = NULL;
+		dns_catz_coo_t *coo = NULL;
+		unsigned char *key = NULL;
+		size_t keysize;
+
+		isc_ht_iter_currentkey(iter, &key, &keysize);
+		if (isc_ht_find(catz->entries, key, (uint32_t)keysize,
+				(void **)&oentry) == ISC_R_SUCCESS &&
+		    isc_ht_find(catz->coos, oentry->name.ndata,
+				oentry->name.length,
+				(void **)&coo) == ISC_R_SUCCESS)
+		{
+			result = isc_ht_delete(catz->coos, oentry->name.ndata,
+					       oentry->name.length);
+			RUNTIME_CHECK(result == ISC_R_SUCCESS);
+			catz_coo_detach(catz, &coo);
+		}
+	}
+	RUNTIME_CHECK(result == ISC_R_NOMORE);
+
+	for (result = isc_ht_iter_first(iter); result == ISC_R_SUCCESS;
+	     result = isc_ht_iter_next(iter))
+	{
+		dns_catz_entry_t *nentry = NULL, *oentry = NULL, *entry = NULL;
+		dns_catz_coo_t *coo = NULL;
+		unsigned char *key = NULL;
+		size_t keysize;
+
+		isc_ht_iter_currentkey(iter, &key, &keysize);
+
+		(void)isc_ht_find(newcatz->entries, key, (uint32_t)keysize,
+				  (void **)&nentry);
+		if (nentry == NULL || dns_name_countlabels(&nentry->name) == 0)
+		{
+			/* The member zone has been removed. */
+			if (isc_ht_find(catz->entries, key, (uint32_t)keysize,
+					(void **)&oentry) == ISC_R_SUCCESS)
+			{
+				result = isc_ht_delete(catz->entries, key,
+						       (uint32_t)keysize);
+				RUNTIME_CHECK(result == ISC_R_SUCCESS);
+				result = isc_ht_add(todel, key,
+						    (uint32_t)keysize, oentry);
+				RUNTIME_CHECK(result == ISC_R_SUCCESS);
+			}
+			continue;
+		}
+
+		catz_merge_entry(catz, key, keysize, nentry, toadd, tomod,
+				 czname);
+
+		dns_catz_entry_attach(nentry, &entry);
+		result = isc_ht_add(catz->entries, key, (uint32_t)keysize,
+				    entry);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+
+		if (isc_ht_find(newcatz->coos, nentry->name.ndata,
+				nentry->name.length,
+				(void **)&coo) == ISC_R_SUCCESS)
+		{
+			result = isc_ht_delete(newcatz->coos, nentry->name.ndata,
+					       nentry->name.length);
+			RUNTIME_CHECK(result == ISC_R_SUCCESS);
+			result = isc_ht_add(catz->coos, nentry->name.ndata,
+					    nentry->name.length, coo);
+			if (result != ISC_R_SUCCESS) {
+				catz_coo_detach(catz, &coo);
+			}
+		}
+	}
+	RUNTIME_CHECK(result == ISC_R_NOMORE);
+	isc_ht_iter_destroy(&iter);
+
+	catz_delete_all(catz, todel, czname);
+	catz_zoneop_all(catz, toadd, catz->catzs->zmm->addzone, "adding",
+			czname);
+	catz_zoneop_all(catz, tomod, catz->catzs->zmm->modzone, "modifying",
+			czname);
+
+	isc_ht_destroy(&toadd);
+	isc_ht_destroy(&tomod);
+	isc_ht_destroy(&todel);
+
+	UNLOCK(&catz->lock);
+
+	return ISC_R_SUCCESS;
+}
+
 dns_catz_zones_t *
 dns_catz_zones_new(isc_mem_t *mctx, isc_loopmgr_t *loopmgr,
 		   dns_catz_zonemodmethods_t *zmm) {
@@ -2216,6 +2370,333 @@ catz_rdatatype_is_processable(const dns_rdatatype_t type) {
 	       type != dns_rdatatype_cdnskey && type != dns_rdatatype_zonemd;
 }
 
+/*
+ * Process all the rdatasets of 'node' named 'name' in 'version' of 'db'
+ * into 'newcatz'.  Invalid records are logged and ignored.
+ */
+static isc_result_t
+catz_update_node(dns_catz_zone_t *newcatz, dns_db_t *db,
+		 dns_dbversion_t *version, dns_dbnode_t *node,
+		 dns_name_t *name) {
+	isc_result_t result;
+	dns_rdatasetiter_t *rdsiter = NULL;
+	dns_rdataset_t rdataset;
+	char cname[DNS_NAME_FORMATSIZE];
+
+	result = dns_db_allrdatasets(db, node, version, 0, 0, &rdsiter);
+	if (result != ISC_R_SUCCESS) {
+		isc_log_write(DNS_LOGCATEGORY_GENERAL, DNS_LOGMODULE_CATZ,
+			      ISC_LOG_ERROR,
+			      "catz: failed to fetch rrdatasets - %s",
+			      isc_result_totext(result));
+		return result;
+	}
+
+	dns_rdataset_init(&rdataset);
+	result = dns_rdatasetiter_first(rdsiter);
+	while (result == ISC_R_SUCCESS) {
+		dns_rdatasetiter_current(rdsiter, &rdataset);
+
+		/*
+		 * Skip processing DNSSEC-related and ZONEMD types,
+		 * because we are not interested in them in the context
+		 * of a catalog zone, and processing them will fail
+		 * and produce an unnecessary warning message.
+		 */
+		if (!catz_rdatatype_is_processable(rdataset.type)) {
+			goto next;
+		}
+
+		/*
+		 * Although newcatz->coos is accessed in
+		 * catz_process_coo() in the call-chain below, we don't
+		 * need to hold the newcatz->lock, because the newcatz
+		 * is still local to this thread and function and
+		 * newcatz->coos can't be accessed from the outside
+		 * until dns__catz_zones_merge() has been called.
+		 */
+		result = dns__catz_update_process(newcatz, name, &rdataset);
+		if (result != ISC_R_SUCCESS) {
+			char typebuf[DNS_RDATATYPE_FORMATSIZE];
+			char classbuf[DNS_RDATACLASS_FORMATSIZE];
+
+			dns_name_format(name, cname, DNS_NAME_FORMATSIZE);
+			dns_rdataclass_format(rdataset.rdclass, classbuf,
+					      sizeof(classbuf));
+			dns_rdatatype_format(rdataset.type, typebuf,
+					     sizeof(typebuf));
+			isc_log_write(DNS_LOGCATEGORY_GENERAL,
+				      DNS_LOGMODULE_CATZ, ISC_LOG_WARNING,
+				      "catz: invalid record in catalog "
+				      "zone - %s %s %s (%s) - ignoring",
+				      cname, classbuf, typebuf,
+				      isc_result_totext(result));
+		}
+	next:
+		dns_rdataset_disassociate(&rdataset);
+		result = dns_rdatasetiter_next(rdsiter);
+	}
+
+	dns_rdatasetiter_destroy(&rdsiter);
+
+	return ISC_R_SUCCESS;
+}
+
+/*
+ * Record in 'changed' the unique label of the member zone that a change
+ * of 'type' at 'name' applies to.  Returns ISC_R_NOTFOUND if the change
+ * is not to a member zone, and the whole catalog has to be processed.
+ */
+static isc_result_t
+catz_changed_member(dns_catz_zone_t *catz, const dns_name_t *name,
+		    dns_rdatatype_t type, isc_ht_t *changed) {
+	isc_result_t result;
+	dns_label_t label;
+	unsigned int nlabels;
+
+	if (!catz_rdatatype_is_processable(type)) {
+		return ISC_R_SUCCESS;
+	}
+
+	if (dns_name_equal(name, &catz->name)) {
+		if (type == dns_rdatatype_soa || type == dns_rdatatype_ns) {
+			return ISC_R_SUCCESS;
+		}
+		return ISC_R_NOTFOUND;
+	}
+
+	if (!dns_name_issubdomain(name, &catz->name)) {
+		return ISC_R_NOTFOUND;
+	}
+
+	/* The name must be at or below <unique-label>.zones */
+	nlabels = dns_name_countlabels(name) - dns_name_countlabels(&catz->name);
+	if (nlabels < 2) {
+		return ISC_R_NOTFOUND;
+	}
+	dns_name_getlabel(name, nlabels - 1, &label);
+	if (catz_get_option(&label) != CATZ_OPT_ZONES) {
+		return ISC_R_NOTFOUND;
+	}
+
+	dns_name_getlabel(name, nlabels - 2, &label);
+	result = isc_ht_add(changed, label.base, label.length, NULL);
+	if (result == ISC_R_EXISTS) {
+		result = ISC_R_SUCCESS;
+	}
+
+	return result;
+}
+
+/*
+ * Collect in 'changed' the unique labels of the member zones changed
+ * between the serials 'from' and 'to' of the catalog zone, using its
+ * journal.  Returns ISC_R_NOTFOUND if the journal doesn't cover the
+ * changes, or if other parts of the catalog have changed.
+ */
+static isc_result_t
+catz_journal_changes(dns_catz_zone_t *catz, uint32_t from, uint32_t to,
+		     isc_ht_t *changed) {
+	isc_result_t result;
+	dns_zone_t *zone = NULL;
+	dns_journal_t *journal = NULL;
+	const char *journalfile = NULL;
+
+	result = dns_view_findzone(catz->catzs->view, &catz->name,
+				   DNS_ZTFIND_EXACT, &zone);
+	if (result != ISC_R_SUCCESS) {
+		return ISC_R_NOTFOUND;
+	}
+
+	journalfile = dns_zone_getjournal(zone);
+	if (journalfile != NULL) {
+		result = dns_journal_open(catz->catzs->mctx, journalfile,
+					  DNS_JOURNAL_READ, &journal);
+	} else {
+		result = ISC_R_NOTFOUND;
+	}
+	dns_zone_detach(&zone);
+	if (result != ISC_R_SUCCESS) {
+		return ISC_R_NOTFOUND;
+	}
+
+	result = dns_journal_iter_init(journal, from, to, NULL);
+	if (result != ISC_R_SUCCESS) {
+		result = ISC_R_NOTFOUND;
+		goto cleanup;
+	}
+
+	for (result = dns_journal_first_rr(journal); result == ISC_R_SUCCESS;
+	     result = dns_journal_next_rr(journal))
+	{
+		dns_name_t *name = NULL;
+		dns_rdata_t *rdata = NULL;
+		uint32_t ttl;
+
+		dns_journal_current_rr(journal, &name, &ttl, &rdata);
+		result = catz_changed_member(catz, name, rdata->type, changed);
+		if (result != ISC_R_SUCCESS) {
+			goto cleanup;
+		}
+	}
+	if (result == ISC_R_NOMORE) {
+		result = ISC_R_SUCCESS;
+	} else {
+		result = ISC_R_NOTFOUND;
+	}
+
+cleanup:
+	dns_journal_destroy(&journal);
+	return result;
+}
+
+/*
+ * Process only the member zones of the catalog zone that have changed
+ * since the last processed serial, as recorded in the journal.  Returns
+ * ISC_R_NOTFOUND if the whole catalog has to be processed instead.
+ */
+static isc_result_t
+catz_update_incremental(dns_catz_zone_t *catz, dns_db_t *db,
+			dns_dbversion_t *version, uint32_t serial) {
+	isc_result_t result;
+	isc_ht_t *changed = NULL;
+	isc_ht_iter_t *iter = NULL;
+	dns_dbiterator_t *dbit = NULL;
+	dns_catz_zone_t *newcatz = NULL;
+	dns_fixedname_t fixname, fixmember;
+	dns_name_t *name = NULL, *member = NULL;
+	char bname[DNS_NAME_FORMATSIZE];
+	bool haveserial;
+	uint32_t oldserial;
+
+	LOCK(&catz->lock);
+	haveserial = catz->haveserial;
+	oldserial = catz->serial;
+	UNLOCK(&catz->lock);
+
+	if (!haveserial || !isc_serial_gt(serial, oldserial)) {
+		return ISC_R_NOTFOUND;
+	}
+
+	isc_ht_init(&changed, catz->catzs->mctx, 4, ISC_HT_CASE_SENSITIVE);
+	result = catz_journal_changes(catz, oldserial, serial, changed);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	result = dns_db_createiterator(db, DNS_DB_NONSEC3, &dbit);
+	if (result != ISC_R_SUCCESS) {
+		result = ISC_R_NOTFOUND;
+		goto cleanup;
+	}
+
+	newcatz = dns_catz_zone_new(catz->catzs, &catz->name);
+	newcatz->version = catz->version;
+	name = dns_fixedname_initname(&fixname);
+	member = dns_fixedname_initname(&fixmember);
+
+	isc_ht_iter_create(changed, &iter);
+	for (result = isc_ht_iter_first(iter); result == ISC_R_SUCCESS;
+	     result = isc_ht_iter_next(iter))
+	{
+		unsigned char wire[DNS_NAME_MAXWIRE];
+		unsigned char *key = NULL;
+		size_t keysize;
+		isc_buffer_t b;
+		isc_region_t r;
+		dns_name_t prefix;
+
+		if (atomic_load(&catz->catzs->shuttingdown)) {
+			result = ISC_R_SHUTTINGDOWN;
+			break;
+		}
+
+		/* <unique-label>.zones.<catalog> */
+		isc_ht_iter_currentkey(iter, &key, &keysize);
+		isc_buffer_init(&b, wire, sizeof(wire));
+		isc_buffer_putmem(&b, key, keysize);
+		isc_buffer_putmem(&b, (const unsigned char *)"\005zones", 6);
+		isc_buffer_usedregion(&b, &r);
+		dns_name_init(&prefix, NULL);
+		dns_name_fromregion(&prefix, &r);
+		result = dns_name_concatenate(&prefix, &catz->name, member,
+					      NULL);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+
+		/*
+		 * The records of the member zone are at and below its
+		 * name, which sort together.  If there are none, the
+		 * member zone has been removed.
+		 */
+		result = dns_dbiterator_seek(dbit, member);
+		while (result == ISC_R_SUCCESS) {
+			dns_dbnode_t *node = NULL;
+
+			result = dns_dbiterator_current(dbit, &node, name);
+			if (result != ISC_R_SUCCESS) {
+				break;
+			}
+			if (!dns_name_issubdomain(name, member)) {
+				dns_db_detachnode(db, &node);
+				break;
+			}
+
+			result = dns_dbiterator_pause(dbit);
+			RUNTIME_CHECK(result == ISC_R_SUCCESS);
+
+			result = catz_update_node(newcatz, db, version, node,
+						  name);
+			dns_db_detachnode(db, &node);
+			if (result != ISC_R_SUCCESS) {
+				goto iterdone;
+			}
+
+			result = dns_dbiterator_next(dbit);
+		}
+		result = ISC_R_SUCCESS;
+	}
+	if (result == ISC_R_NOMORE) {
+		result = ISC_R_SUCCESS;
+	}
+iterdone:
+	isc_ht_iter_destroy(&iter);
+	dns_dbiterator_destroy(&dbit);
+
+	if (result == ISC_R_SHUTTINGDOWN) {
+		goto cleanup;
+	}
+	if (result != ISC_R_SUCCESS || newcatz->broken) {
+		/* Let the full processing report the problem. */
+		result = ISC_R_NOTFOUND;
+		goto cleanup;
+	}
+
+	result = dns__catz_zones_merge_changes(catz, newcatz, changed);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	LOCK(&catz->lock);
+	catz->serial = serial;
+	UNLOCK(&catz->lock);
+
+	dns_name_format(&catz->name, bname, DNS_NAME_FORMATSIZE);
+	isc_log_write(DNS_LOGCATEGORY_GENERAL, DNS_LOGMODULE_CATZ,
+		      ISC_LOG_DEBUG(3),
+		      "catz: zone '%s': %zu member zone(s) updated from the "
+		      "journal",
+		      bname, isc_ht_count(changed));
+
+cleanup:
+	if (newcatz != NULL) {
+		dns_catz_zone_detach(&newcatz);
+	}
+	isc_ht_destroy(&changed);
+	return result;
+}
+
 /*
  * Process an updated database for a catalog zone.
  * It creates a new catz, iterates over database to fill it with content, and
@@ -2234,8 +2715,6 @@ dns__catz_update_cb(void *data) {
 	dns_dbiterator_t *updbit = NULL;
 	dns_fixedname_t fixname;
 	dns_name_t *name = NULL;
-	dns_rdatasetiter_t *rdsiter = NULL;
-	dns_rdataset_t rdataset;
 	char bname[DNS_NAME_FORMATSIZE];
 	char cname[DNS_NAME_FORMATSIZE];
 	bool is_vers_processed = false;
@@ -2301,6 +2780,16 @@ dns__catz_update_cb(void *data) {
 		      "catz: updating catalog zone '%s' with serial %" PRIu32,
 		      bname, vers);
 
+	/*
+	 * If only member zones have changed since the last processed
+	 * version, only process those.
+	 */
+	result = catz_update_incremental(oldcatz, updb, oldcatz->updbversion,
+					 vers);
+	if (result != ISC_R_NOTFOUND) {
+		goto exit;
+	}
+
 	result = dns_db_createiterator(updb, DNS_DB_NONSEC3, &updbit);
 	if (result != ISC_R_SUCCESS) {
 		isc_log_write(DNS_LOGCATEGORY_GENERAL, DNS_LOGMODULE_CATZ,
@@ -2372,70 +2861,13 @@ dns__catz_update_cb(void *data) {
 			continue;
 		}
 
-		result = dns_db_allrdatasets(updb, node, oldcatz->updbversion,
-					     0, 0, &rdsiter);
+		result = catz_update_node(newcatz, updb, oldcatz->updbversion,
+					  node, name);
+		dns_db_detachnode(updb, &node);
 		if (result != ISC_R_SUCCESS) {
-			isc_log_write(DNS_LOGCATEGORY_GENERAL,
-				      DNS_LOGMODULE_CATZ, ISC_LOG_ERROR,
-				      "catz: failed to fetch rrdatasets - %s",
-				      isc_result_totext(result));
-			dns_db_detachnode(updb, &node);
 			break;
 		}
 
-		dns_rdataset_init(&rdataset);
-		result = dns_rdatasetiter_first(rdsiter);
-		while (result == ISC_R_SUCCESS) {
-			dns_rdatasetiter_current(rdsiter, &rdataset);
-
-			/*
-			 * Skip processing DNSSEC-related and ZONEMD types,
-			 * because we are not interested in them in the context
-			 * of a catalog zone, and processing them will fail
-			 * and produce an unnecessary warning message.
-			 */
-			if (!catz_rdatatype_is_processable(rdataset.type)) {
-				goto next;
-			}
-
-			/*
-			 * Although newcatz->coos is accessed in
-			 * catz_process_coo() in the call-chain below, we don't
-			 * need to hold the newcatz->lock, because the newcatz
-			 * is still local to this thread and function and
-			 * newcatz->coos can't be accessed from the outside
-			 * until dns__catz_zones_merge() has been called.
-			 */
-			result = dns__catz_update_process(newcatz, name,
-							  &rdataset);
-			if (result != ISC_R_SUCCESS) {
-				char typebuf[DNS_RDATATYPE_FORMATSIZE];
-				char classbuf[DNS_RDATACLASS_FORMATSIZE];
-
-				dns_name_format(name, cname,
-						DNS_NAME_FORMATSIZE);
-				dns_rdataclass_format(rdataset.rdclass,
-						      classbuf,
-						      sizeof(classbuf));
-				dns_rdatatype_format(rdataset.type, typebuf,
-						     sizeof(typebuf));
-				isc_log_write(DNS_LOGCATEGORY_GENERAL,
-					      DNS_LOGMODULE_CATZ,
-					      ISC_LOG_WARNING,
-					      "catz: invalid record in catalog "
-					      "zone - %s %s %s (%s) - ignoring",
-					      cname, classbuf, typebuf,
-					      isc_result_totext(result));
-			}
-		next:
-			dns_rdataset_disassociate(&rdataset);
-			result = dns_rdatasetiter_next(rdsiter);
-		}
-
-		dns_rdatasetiter_destroy(&rdsiter);
-
-		dns_db_detachnode(updb, &node);
-
 		if (!is_vers_processed) {
 			is_vers_processed = true;
 			result = dns_dbiterator_first(updbit);
@@ -2497,6 +2929,11 @@ dns__catz_update_cb(void *data) {
 		goto exit;
 	}
 
+	LOCK(&oldcatz->lock);
+	oldcatz->haveserial = true;
+	oldcatz->serial = vers;
+	UNLOCK(&oldcatz->lock);
+
 	isc_log_write(DNS_LOGCATEGORY_GENERAL, DNS_LOGMODULE_CATZ,
 		      ISC_LOG_DEBUG(3),
 		      "catz: update_from_db: new zone merged");
@@ -49,7 +49,8 @@ dns_compress_init(dns_compress_t *cctx, isc_mem_t *mctx,
 
 	/*
 	 * The lifetime of this object is limited to the stack frame of the
-	 * caller, so we don't need to attach to the memory context.
+	 * caller, or to an object holding a reference to the memory
+	 * context, so we don't need to attach to it.
 	 */
 	*cctx = (dns_compress_t){
 		.magic = CCTX_MAGIC,
@@ -69,6 +70,17 @@ dns_compress_invalidate(dns_compress_t *cctx) {
 	*cctx = (dns_compress_t){ 0 };
 }
 
+void
+dns_compress_reset(dns_compress_t *cctx) {
+	REQUIRE(CCTX_VALID(cctx));
+
+	if (cctx->count > 0) {
+		memset(cctx->set, 0, (cctx->mask + 1) * sizeof(cctx->set[0]));
+		cctx->count = 0;
+	}
+	cctx->flags |= DNS_COMPRESS_PERMITTED;
+}
+
 void
 dns_compress_setpermitted(dns_compress_t *cctx, bool permitted) {
 	REQUIRE(CCTX_VALID(cctx));
@@ -217,18 +229,9 @@ slot_index(dns_compress_t *cctx, unsigned int hash, unsigned int probe) {
 	return (hash + probe) & cctx->mask;
 }
 
-static bool
-insert_label(dns_compress_t *cctx, isc_buffer_t *buffer, const dns_name_t *name,
-	     unsigned int label, uint16_t hash, unsigned int probe) {
-	/*
-	 * hash set entries must have valid compression offsets
-	 * and the hash set must not get too full (75% load)
-	 */
-	unsigned int prefix_len = name->offsets[label];
-	unsigned int coff = isc_buffer_usedlength(buffer) + prefix_len;
-	if (coff >= 0x4000 || cctx->count > cctx->mask * 3 / 4) {
-		return false;
-	}
+static void
+insert_slot(dns_compress_t *cctx, uint16_t hash, uint16_t coff,
+	    unsigned int probe) {
 	for (;;) {
 		unsigned int slot = slot_index(cctx, hash, probe);
 		/* we can stop when we find an empty slot */
@@ -236,7 +239,7 @@ insert_label(dns_compress_t *cctx, isc_buffer_t *buffer, const dns_name_t *name,
 			cctx->set[slot].hash = hash;
 			cctx->set[slot].coff = coff;
 			cctx->count++;
-			return true;
+			return;
 		}
 		/* he steals from the rich and gives to the poor */
 		if (probe > probe_distance(cctx, slot)) {
@@ -248,6 +251,54 @@ insert_label(dns_compress_t *cctx, isc_buffer_t *buffer, const dns_name_t *name,
 	}
 }
 
+/*
+ * Messages with more names than the small hash set can hold, such as
+ * large DNSSEC responses and referrals with many glue records, switch
+ * to a large set instead of leaving the rest of their names
+ * uncompressed. The hash values are kept in the set, so the entries can
+ * be moved without rehashing the names.
+ */
+static void
+grow(dns_compress_t *cctx) {
+	dns_compress_slot_t *old = cctx->set;
+	unsigned int oldsize = cctx->mask + 1;
+	size_t count = (1 << DNS_COMPRESS_LARGEBITS);
+
+	cctx->set = isc_mem_callocate(cctx->mctx, count, sizeof(cctx->set[0]));
+	cctx->mask = count - 1;
+	cctx->count = 0;
+
+	for (unsigned int slot = 0; slot < oldsize; slot++) {
+		if (old[slot].coff != 0) {
+			insert_slot(cctx, old[slot].hash, old[slot].coff, 0);
+		}
+	}
+}
+
+static bool
+insert_label(dns_compress_t *cctx, isc_buffer_t *buffer, const dns_name_t *name,
+	     unsigned int label, uint16_t hash, unsigned int probe) {
+	/*
+	 * hash set entries must have valid compression offsets
+	 * and the hash set must not get too full (75% load)
+	 */
+	unsigned int prefix_len = name->offsets[label];
+	unsigned int coff = isc_buffer_usedlength(buffer) + prefix_len;
+	if (coff >= 0x4000) {
+		return false;
+	}
+	if (cctx->count > cctx->mask * 3 / 4) {
+		if (cctx->set != cctx->smallset) {
+			return false;
+		}
+		grow(cctx);
+		/* the probe sequence starts afresh in the new set */
+		probe = 0;
+	}
+	insert_slot(cctx, hash, coff, probe);
+	return true;
+}
+
 /*
  * Add the unmatched prefix of the name to the hash set.
  */
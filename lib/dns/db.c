@@ -20,6 +20,7 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+#include <isc/atomic.h>
 #include <isc/buffer.h>
 #include <isc/hash.h>
 #include <isc/log.h>
@@ -67,6 +68,11 @@ struct dns_dbimplementation {
 
 unsigned int dns_pps = 0U;
 
+/*
+ * Changed whenever the contents of any zone database may have changed.
+ */
+static atomic_uint_fast64_t generation = 0;
+
 static ISC_LIST(dns_dbimplementation_t) implementations;
 static isc_rwlock_t implock;
 static isc_once_t once = ISC_ONCE_INIT;
@@ -157,6 +163,9 @@ dns_db_create(isc_mem_t *mctx, const char *db_type, const dns_name_t *origin,
 
 static void
 dns__db_destroy(dns_db_t *db) {
+	if ((db->attributes & DNS_DBATTR_CACHE) == 0) {
+		atomic_fetch_add_release(&generation, 1);
+	}
 	(db->methods->destroy)(db);
 }
 
@@ -295,6 +304,7 @@ dns_db_endload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
 	 * database has an 'endload' implementation.
 	 */
 	call_updatenotify(db);
+	atomic_fetch_add_release(&generation, 1);
 
 	if (db->methods->endload != NULL) {
 		return (db->methods->endload)(db, callbacks);
@@ -407,6 +417,7 @@ dns__db_closeversion(dns_db_t *db, dns_dbversion_t **versionp,
 
 	if (commit) {
 		call_updatenotify(db);
+		atomic_fetch_add_release(&generation, 1);
 	}
 
 	ENSURE(*versionp == NULL);
@@ -651,6 +662,46 @@ dns__db_findrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 					   sigrdataset DNS__DB_FLARG_PASS);
 }
 
+void
+dns__db_findrdatasets(dns_db_t *db, dns_dbnode_t *node,
+		      dns_dbversion_t *version, unsigned int count,
+		      const dns_rdatatype_t *types, isc_stdtime_t now,
+		      dns_rdataset_t **rdatasets, dns_rdataset_t **sigrdatasets,
+		      isc_result_t *results DNS__DB_FLARG) {
+	REQUIRE(DNS_DB_VALID(db));
+	REQUIRE(node != NULL);
+	REQUIRE(count > 0 && count <= DNS_DB_MAXFINDTYPES);
+	REQUIRE(types != NULL && rdatasets != NULL && results != NULL);
+
+	for (unsigned int i = 0; i < count; i++) {
+		REQUIRE(types[i] != dns_rdatatype_any &&
+			types[i] != dns_rdatatype_rrsig);
+		REQUIRE(DNS_RDATASET_VALID(rdatasets[i]));
+		REQUIRE(!dns_rdataset_isassociated(rdatasets[i]));
+		REQUIRE(sigrdatasets == NULL || sigrdatasets[i] == NULL ||
+			(DNS_RDATASET_VALID(sigrdatasets[i]) &&
+			 !dns_rdataset_isassociated(sigrdatasets[i])));
+	}
+
+	if (db->methods->findrdatasets != NULL) {
+		(db->methods->findrdatasets)(db, node, version, count, types,
+					     now, rdatasets, sigrdatasets,
+					     results DNS__DB_FLARG_PASS);
+		return;
+	}
+
+	for (unsigned int i = 0; i < count; i++) {
+		dns_rdataset_t *sigrdataset = NULL;
+
+		if (sigrdatasets != NULL) {
+			sigrdataset = sigrdatasets[i];
+		}
+		results[i] = (db->methods->findrdataset)(
+			db, node, version, types[i], 0, now, rdatasets[i],
+			sigrdataset DNS__DB_FLARG_PASS);
+	}
+}
+
 isc_result_t
 dns__db_allrdatasets(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 		     unsigned int options, isc_stdtime_t now,
@@ -995,6 +1046,11 @@ updatenotify_match(struct cds_lfht_node *ht_node, const void *_key) {
 /*
  * Attach a notify-on-update function the database
  */
+uint64_t
+dns_db_generation(void) {
+	return atomic_load_acquire(&generation);
+}
+
 void
 dns_db_updatenotify_register(dns_db_t *db, dns_dbupdate_callback_t fn,
 			     void *fn_arg) {
@@ -1182,6 +1238,25 @@ dns_db_setmaxtypepername(dns_db_t *db, uint32_t value) {
 	}
 }
 
+void
+dns_db_setshareslabs(dns_db_t *db, bool value) {
+	REQUIRE(DNS_DB_VALID(db));
+
+	if (db->methods->setshareslabs != NULL) {
+		(db->methods->setshareslabs)(db, value);
+	}
+}
+
+uint64_t
+dns_db_getsharedsize(dns_db_t *db) {
+	REQUIRE(DNS_DB_VALID(db));
+
+	if (db->methods->getsharedsize != NULL) {
+		return (db->methods->getsharedsize)(db);
+	}
+	return 0;
+}
+
 void
 dns__db_logtoomanyrecords(dns_db_t *db, const dns_name_t *name,
 			  dns_rdatatype_t type, const char *op,
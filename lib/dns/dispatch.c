@@ -54,13 +54,25 @@ struct dns_dispatchmgr {
 	isc_mem_t *mctx;
 	dns_acl_t *blackhole;
 	isc_stats_t *stats;
+	isc_loopmgr_t *loopmgr;
 	isc_nm_t *nm;
 
+	/* Upstream TCP connection pooling */
+	unsigned int tcpidle;	  /*%< idle timeout (ms), 0 = off */
+	unsigned int tcppipeline; /*%< max queries per connection */
+	unsigned int tcpconns;	  /*%< max connections per server */
+
+	bool udpreuse; /*%< reuse connected UDP sockets */
+
 	uint32_t nloops;
 
 	struct cds_lfht **tcps;
 
-	struct cds_lfht *qids;
+	/*
+	 * Per-loop tables of the outstanding <peer, port, query id>
+	 * tuples; a dispatch only ever touches the table of its loop.
+	 */
+	struct cds_lfht **qids;
 
 	in_port_t *v4ports;    /*%< available ports for IPv4 */
 	unsigned int nv4ports; /*%< # of available ports for IPv4 */
@@ -97,6 +109,9 @@ struct dns_dispentry {
 	dispatch_cb_t response;
 	void *arg;
 	bool reading;
+	bool reusable;		/*%< the UDP socket can be reused */
+	unsigned int uses;	/*%< queries sent over the UDP socket */
+	isc_nmhandle_t *reuse;	/*%< reused UDP socket, until connected */
 	isc_result_t result;
 	ISC_LINK(dns_dispentry_t) alink;
 	ISC_LINK(dns_dispentry_t) plink;
@@ -106,6 +121,16 @@ struct dns_dispentry {
 	struct rcu_head rcu_head;
 };
 
+typedef struct dispatch_udpsock dispatch_udpsock_t;
+struct dispatch_udpsock {
+	isc_nmhandle_t *handle;
+	isc_sockaddr_t local;
+	isc_sockaddr_t peer;
+	isc_time_t idle; /*%< when it was last used */
+	unsigned int uses;
+	ISC_LINK(dispatch_udpsock_t) link;
+};
+
 struct dns_dispatch {
 	/* Unlocked. */
 	unsigned int magic; /*%< magic */
@@ -127,6 +152,13 @@ struct dns_dispatch {
 	dns_displist_t pending;
 	dns_displist_t active;
 
+	/*
+	 * Connected UDP sockets kept for the next queries to the same
+	 * servers, most recently used first.
+	 */
+	ISC_LIST(dispatch_udpsock_t) udpsocks;
+	unsigned int nudpsocks;
+
 	uint_fast32_t requests; /*%< how many requests we have */
 
 	unsigned int timedout;
@@ -169,6 +201,16 @@ ISC_REFCOUNT_DECL(dns_dispentry);
 #define QIDS_INIT_SIZE (1 << 4) /* Must be power of 2 */
 #define QIDS_MIN_SIZE  (1 << 4) /* Must be power of 2 */
 
+/*
+ * The connected UDP sockets kept for reuse, when enabled with
+ * dns_dispatchmgr_setudpreuse(): how many per dispatch, for how long (in
+ * milliseconds), and for how many queries at most, so that the source
+ * port keeps changing for the queries to the same server.
+ */
+#define UDPSOCKS_MAX	64
+#define UDPSOCK_IDLE	2000
+#define UDPSOCK_MAXUSES 8
+
 /*
  * Statics.
  */
@@ -395,6 +437,96 @@ qid_match(struct cds_lfht_node *node, const void *key0) {
 	       isc_sockaddr_equal(&dispentry->peer, &key->peer);
 }
 
+static void
+udpsock_free(dns_dispatch_t *disp, dispatch_udpsock_t *sock) {
+	ISC_LIST_UNLINK(disp->udpsocks, sock, link);
+	disp->nudpsocks--;
+	if (sock->handle != NULL) {
+		isc_nmhandle_detach(&sock->handle);
+	}
+	isc_mem_put(disp->mctx, sock, sizeof(*sock));
+}
+
+/*%
+ * Close the pooled sockets that have not been used for UDPSOCK_IDLE.
+ */
+static void
+udpsock_expire(dns_dispatch_t *disp, const isc_time_t *now) {
+	dispatch_udpsock_t *sock = ISC_LIST_TAIL(disp->udpsocks);
+
+	while (sock != NULL &&
+	       isc_time_microdiff(now, &sock->idle) > UDPSOCK_IDLE * 1000)
+	{
+		dispatch_udpsock_t *prev = ISC_LIST_PREV(sock, link);
+		udpsock_free(disp, sock);
+		sock = prev;
+	}
+}
+
+/*%
+ * Take a socket connected to the peer of 'resp' out of the pool, and
+ * use its local address for 'resp'.
+ */
+static bool
+udpsock_get(dns_dispatch_t *disp, dns_dispentry_t *resp) {
+	isc_time_t now = isc_loop_now(resp->loop);
+	dispatch_udpsock_t *sock = NULL;
+
+	udpsock_expire(disp, &now);
+	if (!disp->mgr->udpreuse) {
+		return false;
+	}
+
+	for (sock = ISC_LIST_HEAD(disp->udpsocks); sock != NULL;
+	     sock = ISC_LIST_NEXT(sock, link))
+	{
+		if (isc_sockaddr_equal(&sock->peer, &resp->peer)) {
+			break;
+		}
+	}
+	if (sock == NULL) {
+		return false;
+	}
+
+	resp->local = sock->local;
+	resp->port = isc_sockaddr_getport(&sock->local);
+	resp->uses = sock->uses;
+	resp->reuse = sock->handle;
+	sock->handle = NULL;
+
+	udpsock_free(disp, sock);
+
+	return true;
+}
+
+/*%
+ * Keep the socket of 'resp' for the next query to the same server.
+ */
+static void
+udpsock_put(dns_dispatch_t *disp, dns_dispentry_t *resp) {
+	isc_time_t now = isc_loop_now(resp->loop);
+	dispatch_udpsock_t *sock = NULL;
+
+	udpsock_expire(disp, &now);
+	if (disp->nudpsocks >= UDPSOCKS_MAX) {
+		udpsock_free(disp, ISC_LIST_TAIL(disp->udpsocks));
+	}
+
+	sock = isc_mem_get(disp->mctx, sizeof(*sock));
+	*sock = (dispatch_udpsock_t){
+		.handle = resp->handle,
+		.local = resp->local,
+		.peer = resp->peer,
+		.idle = now,
+		.uses = resp->uses,
+		.link = ISC_LINK_INITIALIZER,
+	};
+	resp->handle = NULL;
+
+	ISC_LIST_PREPEND(disp->udpsocks, sock, link);
+	disp->nudpsocks++;
+}
+
 static void
 dispentry_destroy_rcu(struct rcu_head *rcu_head) {
 	dns_dispentry_t *resp = caa_container_of(rcu_head, dns_dispentry_t,
@@ -423,6 +555,15 @@ dispentry_destroy(dns_dispentry_t *resp) {
 
 	dispentry_log(resp, ISC_LOG_DEBUG(90), "destroying");
 
+	if (resp->handle != NULL && resp->reusable && disp->mgr->udpreuse &&
+	    resp->uses < UDPSOCK_MAXUSES &&
+	    disp->state != DNS_DISPATCHSTATE_CANCELED)
+	{
+		dispentry_log(resp, ISC_LOG_DEBUG(90),
+			      "keeping handle %p for reuse", resp->handle);
+		udpsock_put(disp, resp);
+	}
+
 	if (resp->handle != NULL) {
 		dispentry_log(resp, ISC_LOG_DEBUG(90),
 			      "detaching handle %p from %p", resp->handle,
@@ -430,6 +571,10 @@ dispentry_destroy(dns_dispentry_t *resp) {
 		isc_nmhandle_detach(&resp->handle);
 	}
 
+	if (resp->reuse != NULL) {
+		isc_nmhandle_detach(&resp->reuse);
+	}
+
 	if (resp->tlsctx_cache != NULL) {
 		isc_tlsctx_cache_detach(&resp->tlsctx_cache);
 	}
@@ -582,8 +727,10 @@ udp_recv(isc_nmhandle_t *handle, isc_result_t eresult, isc_region_t *region,
 	}
 
 	/*
-	 * We have the right resp, so call the caller back.
+	 * We have the right resp, so call the caller back.  The socket
+	 * has nothing more to receive and can be used for another query.
 	 */
+	resp->reusable = true;
 	goto done;
 
 next:
@@ -688,8 +835,8 @@ tcp_recv_success(dns_dispatch_t *disp, isc_region_t *region,
 		.port = isc_sockaddr_getport(&disp->local),
 	};
 	struct cds_lfht_iter iter;
-	cds_lfht_lookup(disp->mgr->qids, qid_hash(&key), qid_match, &key,
-			&iter);
+	cds_lfht_lookup(disp->mgr->qids[disp->tid], qid_hash(&key), qid_match,
+			&key, &iter);
 
 	dns_dispentry_t *resp = cds_lfht_entry(cds_lfht_iter_get_node(&iter),
 					       dns_dispentry_t, ht_node);
@@ -798,6 +945,17 @@ tcp_recv(isc_nmhandle_t *handle, isc_result_t result, isc_region_t *region,
 	 */
 	switch (result) {
 	case ISC_R_TIMEDOUT:
+		if (ISC_LIST_EMPTY(disp->active) && disp->timedout == 0) {
+			/*
+			 * An idle connection kept open by the pool has
+			 * expired; let it go quietly.
+			 */
+			dispatch_log(disp, ISC_LOG_DEBUG(90),
+				     "idle TCP connection timed out");
+			disp->state = DNS_DISPATCHSTATE_CANCELED;
+			break;
+		}
+
 		/*
 		 * Time out the oldest response in the active queue.
 		 */
@@ -985,6 +1143,7 @@ dns_dispatchmgr_create(isc_mem_t *mctx, isc_loopmgr_t *loopmgr, isc_nm_t *nm,
 	mgr = isc_mem_get(mctx, sizeof(dns_dispatchmgr_t));
 	*mgr = (dns_dispatchmgr_t){
 		.magic = 0,
+		.loopmgr = loopmgr,
 		.nloops = isc_loopmgr_nloops(loopmgr),
 	};
 
@@ -1012,9 +1171,12 @@ dns_dispatchmgr_create(isc_mem_t *mctx, isc_loopmgr_t *loopmgr, isc_nm_t *nm,
 	isc_portset_destroy(mgr->mctx, &v4portset);
 	isc_portset_destroy(mgr->mctx, &v6portset);
 
-	mgr->qids = cds_lfht_new(QIDS_INIT_SIZE, QIDS_MIN_SIZE, 0,
-				 CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING,
-				 NULL);
+	mgr->qids = isc_mem_cget(mgr->mctx, mgr->nloops, sizeof(mgr->qids[0]));
+	for (size_t i = 0; i < mgr->nloops; i++) {
+		mgr->qids[i] = cds_lfht_new(
+			QIDS_INIT_SIZE, QIDS_MIN_SIZE, 0,
+			CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING, NULL);
+	}
 
 	mgr->magic = DNS_DISPATCHMGR_MAGIC;
 
@@ -1043,6 +1205,28 @@ dns_dispatchmgr_getblackhole(dns_dispatchmgr_t *mgr) {
 	return mgr->blackhole;
 }
 
+void
+dns_dispatchmgr_settcppool(dns_dispatchmgr_t *mgr, unsigned int idle,
+			   unsigned int pipeline, unsigned int conns) {
+	REQUIRE(VALID_DISPATCHMGR(mgr));
+
+	mgr->tcpidle = idle;
+	mgr->tcppipeline = pipeline;
+	mgr->tcpconns = conns;
+}
+
+bool
+dns_dispatchmgr_tcppool(dns_dispatchmgr_t *mgr) {
+	REQUIRE(VALID_DISPATCHMGR(mgr));
+	return mgr->tcpidle > 0;
+}
+
+void
+dns_dispatchmgr_setudpreuse(dns_dispatchmgr_t *mgr, bool reuse) {
+	REQUIRE(VALID_DISPATCHMGR(mgr));
+	mgr->udpreuse = reuse;
+}
+
 isc_result_t
 dns_dispatchmgr_setavailports(dns_dispatchmgr_t *mgr, isc_portset_t *v4portset,
 			      isc_portset_t *v6portset) {
@@ -1058,11 +1242,11 @@ dispatchmgr_destroy(dns_dispatchmgr_t *mgr) {
 
 	mgr->magic = 0;
 
-	RUNTIME_CHECK(!cds_lfht_destroy(mgr->qids, NULL));
-
 	for (size_t i = 0; i < mgr->nloops; i++) {
+		RUNTIME_CHECK(!cds_lfht_destroy(mgr->qids[i], NULL));
 		RUNTIME_CHECK(!cds_lfht_destroy(mgr->tcps[i], NULL));
 	}
+	isc_mem_cput(mgr->mctx, mgr->qids, mgr->nloops, sizeof(mgr->qids[0]));
 	isc_mem_cput(mgr->mctx, mgr->tcps, mgr->nloops, sizeof(mgr->tcps[0]));
 
 	if (mgr->blackhole != NULL) {
@@ -1116,6 +1300,7 @@ dispatch_allocate(dns_dispatchmgr_t *mgr, isc_socktype_t type, uint32_t tid,
 		.socktype = type,
 		.active = ISC_LIST_INITIALIZER,
 		.pending = ISC_LIST_INITIALIZER,
+		.udpsocks = ISC_LIST_INITIALIZER,
 		.tid = tid,
 		.magic = DISPATCH_MAGIC,
 	};
@@ -1219,13 +1404,47 @@ dns_dispatch_createtcp(dns_dispatchmgr_t *mgr, const isc_sockaddr_t *localaddr,
 	return ISC_R_SUCCESS;
 }
 
+/*
+ * Return true if 'disp' can take on another query: it is either
+ * connecting or connected and still reading, and it hasn't reached
+ * the per-connection pipelining limit.
+ */
+static bool
+tcp_dispatch_usable(dns_dispatch_t *disp) {
+	switch (disp->state) {
+	case DNS_DISPATCHSTATE_NONE:
+		/* A dispatch in indeterminate state, skip it */
+		return false;
+	case DNS_DISPATCHSTATE_CONNECTED:
+		/*
+		 * Ignore dispatch with no responses, unless it is an idle
+		 * connection kept open by the pool.
+		 */
+		if (ISC_LIST_EMPTY(disp->active) &&
+		    (disp->mgr->tcpidle == 0 || !disp->reading))
+		{
+			return false;
+		}
+		return true;
+	case DNS_DISPATCHSTATE_CONNECTING:
+		/* Ignore dispatch with no responses */
+		return !ISC_LIST_EMPTY(disp->pending);
+	case DNS_DISPATCHSTATE_CANCELED:
+		/* A canceled dispatch, skip it. */
+		return false;
+	default:
+		UNREACHABLE();
+	}
+}
+
 isc_result_t
 dns_dispatch_gettcp(dns_dispatchmgr_t *mgr, const isc_sockaddr_t *destaddr,
 		    const isc_sockaddr_t *localaddr, dns_transport_t *transport,
 		    dns_dispatch_t **dispp) {
 	dns_dispatch_t *disp_connected = NULL;
 	dns_dispatch_t *disp_fallback = NULL;
-	isc_result_t result = ISC_R_NOTFOUND;
+	dns_dispatch_t *disp_busy = NULL;
+	unsigned int nconns = 0;
 	uint32_t tid = isc_tid();
 
 	REQUIRE(VALID_DISPATCHMGR(mgr));
@@ -1238,6 +1457,11 @@ dns_dispatch_gettcp(dns_dispatchmgr_t *mgr, const isc_sockaddr_t *destaddr,
 		.transport = transport,
 	};
 
+	/*
+	 * Prefer the least loaded connected dispatch, then a connecting
+	 * one.  Dispatches that are at the pipelining limit are only used
+	 * when the per-server connection limit has been reached.
+	 */
 	rcu_read_lock();
 	struct cds_lfht_iter iter;
 	dns_dispatch_t *disp = NULL;
@@ -1247,60 +1471,53 @@ dns_dispatch_gettcp(dns_dispatchmgr_t *mgr, const isc_sockaddr_t *destaddr,
 		INSIST(disp->tid == isc_tid());
 		INSIST(disp->socktype == isc_socktype_tcp);
 
-		switch (disp->state) {
-		case DNS_DISPATCHSTATE_NONE:
-			/* A dispatch in indeterminate state, skip it */
-			break;
-		case DNS_DISPATCHSTATE_CONNECTED:
-			if (ISC_LIST_EMPTY(disp->active)) {
-				/* Ignore dispatch with no responses */
-				break;
-			}
-			/* We found a connected dispatch */
-			dns_dispatch_attach(disp, &disp_connected);
-			break;
-		case DNS_DISPATCHSTATE_CONNECTING:
-			if (ISC_LIST_EMPTY(disp->pending)) {
-				/* Ignore dispatch with no responses */
-				break;
-			}
-			/* We found "a" dispatch, store it for later */
-			if (disp_fallback == NULL) {
-				dns_dispatch_attach(disp, &disp_fallback);
-			}
-			break;
-		case DNS_DISPATCHSTATE_CANCELED:
-			/* A canceled dispatch, skip it. */
-			break;
-		default:
-			UNREACHABLE();
+		if (!tcp_dispatch_usable(disp)) {
+			continue;
 		}
 
-		if (disp_connected != NULL) {
-			break;
+		nconns++;
+
+		if (disp_busy == NULL || disp->requests < disp_busy->requests)
+		{
+			disp_busy = disp;
+		}
+
+		if (mgr->tcppipeline > 0 && disp->requests >= mgr->tcppipeline)
+		{
+			continue;
+		}
+
+		if (disp->state == DNS_DISPATCHSTATE_CONNECTED) {
+			if (disp_connected == NULL ||
+			    disp->requests < disp_connected->requests)
+			{
+				disp_connected = disp;
+			}
+		} else if (disp_fallback == NULL) {
+			/* We found "a" dispatch, store it for later */
+			disp_fallback = disp;
 		}
 	}
-	rcu_read_unlock();
 
 	if (disp_connected != NULL) {
 		/* We found connected dispatch */
 		INSIST(disp_connected->handle != NULL);
-
-		*dispp = disp_connected;
-		disp_connected = NULL;
-
-		result = ISC_R_SUCCESS;
-
-		if (disp_fallback != NULL) {
-			dns_dispatch_detach(&disp_fallback);
-		}
+		disp = disp_connected;
 	} else if (disp_fallback != NULL) {
-		*dispp = disp_fallback;
+		disp = disp_fallback;
+	} else if (mgr->tcpconns > 0 && nconns >= mgr->tcpconns) {
+		/* No more connections allowed; queue on the least loaded */
+		disp = disp_busy;
+	} else {
+		disp = NULL;
+	}
 
-		result = ISC_R_SUCCESS;
+	if (disp != NULL) {
+		dns_dispatch_attach(disp, dispp);
 	}
+	rcu_read_unlock();
 
-	return result;
+	return disp != NULL ? ISC_R_SUCCESS : ISC_R_NOTFOUND;
 }
 
 isc_result_t
@@ -1373,11 +1590,28 @@ dispatch_destroy_rcu(struct rcu_head *rcu_head) {
 	isc_mem_putanddetach(&disp->mctx, disp, sizeof(*disp));
 }
 
+static void
+dispatch_destroy(dns_dispatch_t *disp);
+
+static void
+dispatch_destroy_async(void *arg) {
+	dispatch_destroy(arg);
+}
+
 static void
 dispatch_destroy(dns_dispatch_t *disp) {
 	dns_dispatchmgr_t *mgr = disp->mgr;
 	uint32_t tid = isc_tid();
 
+	/*
+	 * The pooled UDP sockets must be closed on their loop.
+	 */
+	if (!ISC_LIST_EMPTY(disp->udpsocks) && disp->tid != tid) {
+		isc_async_run(isc_loop_get(mgr->loopmgr, disp->tid),
+			      dispatch_destroy_async, disp);
+		return;
+	}
+
 	disp->magic = 0;
 
 	if (disp->socktype == isc_socktype_tcp &&
@@ -1392,6 +1626,10 @@ dispatch_destroy(dns_dispatch_t *disp) {
 
 	dispatch_log(disp, ISC_LOG_DEBUG(90), "destroying dispatch %p", disp);
 
+	while (!ISC_LIST_EMPTY(disp->udpsocks)) {
+		udpsock_free(disp, ISC_LIST_HEAD(disp->udpsocks));
+	}
+
 	if (disp->handle) {
 		dispatch_log(disp, ISC_LOG_DEBUG(90),
 			     "detaching TCP handle %p from %p", disp->handle,
@@ -1460,13 +1698,17 @@ dns_dispatch_add(dns_dispatch_t *disp, isc_loop_t *loop,
 	isc_refcount_init(&resp->references, 1); /* DISPENTRY000 */
 
 	if (disp->socktype == isc_socktype_udp) {
-		isc_result_t result = setup_socket(disp, resp, dest,
-						   &localport);
+		isc_result_t result = ISC_R_SUCCESS;
+
+		if (!udpsock_get(disp, resp)) {
+			result = setup_socket(disp, resp, dest, &localport);
+		}
 		if (result != ISC_R_SUCCESS) {
 			isc_mem_put(disp->mctx, resp, sizeof(*resp));
 			inc_stats(disp->mgr, dns_resstatscounter_dispsockfail);
 			return result;
 		}
+		resp->uses++;
 	}
 
 	isc_result_t result = ISC_R_NOMORE;
@@ -1483,8 +1725,9 @@ dns_dispatch_add(dns_dispatch_t *disp, isc_loop_t *loop,
 				   : (dns_messageid_t)isc_random16();
 
 		struct cds_lfht_node *node =
-			cds_lfht_add_unique(disp->mgr->qids, qid_hash(resp),
-					    qid_match, resp, &resp->ht_node);
+			cds_lfht_add_unique(disp->mgr->qids[disp->tid],
+					    qid_hash(resp), qid_match, resp,
+					    &resp->ht_node);
 
 		if (node != &resp->ht_node) {
 			if ((options & DNS_DISPATCHOPT_FIXEDID) != 0) {
@@ -1501,6 +1744,9 @@ dns_dispatch_add(dns_dispatch_t *disp, isc_loop_t *loop,
 	} while (i++ < QID_MAX_TRIES);
 fail:
 	if (result != ISC_R_SUCCESS) {
+		if (resp->reuse != NULL) {
+			isc_nmhandle_detach(&resp->reuse);
+		}
 		isc_mem_put(disp->mctx, resp, sizeof(*resp));
 		rcu_read_unlock();
 		return result;
@@ -1617,7 +1863,7 @@ udp_dispentry_cancel(dns_dispentry_t *resp, isc_result_t result) {
 
 	dec_stats(disp->mgr, dns_resstatscounter_disprequdp);
 
-	(void)cds_lfht_del(disp->mgr->qids, &resp->ht_node);
+	(void)cds_lfht_del(disp->mgr->qids[disp->tid], &resp->ht_node);
 
 	resp->state = DNS_DISPATCHSTATE_CANCELED;
 
@@ -1668,40 +1914,33 @@ tcp_dispentry_cancel(dns_dispentry_t *resp, isc_result_t result) {
 		if (ISC_LIST_EMPTY(disp->active)) {
 			INSIST(disp->handle != NULL);
 
-#if DISPATCH_TCP_KEEPALIVE
-			/*
-			 * This is an experimental code that keeps the TCP
-			 * connection open for 1 second before it is finally
-			 * closed.  By keeping the TCP connection open, it can
-			 * be reused by dns_request that uses
-			 * dns_dispatch_gettcp() to join existing TCP
-			 * connections.
-			 *
-			 * It is disabled for now, because it changes the
-			 * behaviour, but I am keeping the code here for future
-			 * reference when we improve the dns_dispatch to reuse
-			 * the TCP connections also in the resolver.
-			 *
-			 * The TCP connection reuse should be seamless and not
-			 * require any extra handling on the client side though.
-			 */
-			isc_nmhandle_cleartimeout(disp->handle);
-			isc_nmhandle_settimeout(disp->handle, 1000);
-
-			if (!disp->reading) {
-				dispentry_log(resp, ISC_LOG_DEBUG(90),
-					      "final 1 second timeout on %p",
-					      disp->handle);
-				tcp_startrecv(disp, NULL);
-			}
-#else
-			if (disp->reading) {
+			if (disp->mgr->tcpidle > 0 &&
+			    (disp->options & DNS_DISPATCHOPT_UNSHARED) == 0)
+			{
+				/*
+				 * Keep the idle TCP connection open, so it
+				 * can be reused by dns_dispatch_gettcp().  The
+				 * outstanding read holds a reference to the
+				 * dispatch until the idle timeout fires or
+				 * the server closes the connection.
+				 */
+				isc_nmhandle_cleartimeout(disp->handle);
+				isc_nmhandle_settimeout(disp->handle,
+							disp->mgr->tcpidle);
+
+				if (!disp->reading) {
+					dispentry_log(resp, ISC_LOG_DEBUG(90),
+						      "idle timeout %u on %p",
+						      disp->mgr->tcpidle,
+						      disp->handle);
+					tcp_startrecv(disp, NULL);
+				}
+			} else if (disp->reading) {
 				dispentry_log(resp, ISC_LOG_DEBUG(90),
 					      "canceling read on %p",
 					      disp->handle);
 				isc_nm_cancelread(disp->handle);
 			}
-#endif
 		}
 		break;
 
@@ -1714,7 +1953,7 @@ tcp_dispentry_cancel(dns_dispentry_t *resp, isc_result_t result) {
 
 	dec_stats(disp->mgr, dns_resstatscounter_dispreqtcp);
 
-	(void)cds_lfht_del(disp->mgr->qids, &resp->ht_node);
+	(void)cds_lfht_del(disp->mgr->qids[disp->tid], &resp->ht_node);
 
 	resp->state = DNS_DISPATCHSTATE_CANCELED;
 
@@ -1937,6 +2176,23 @@ detach:
 	dns_dispentry_detach(&resp); /* DISPENTRY004 */
 }
 
+/*
+ * A pooled socket is already connected; carry on as if the connection
+ * had just been made.
+ */
+static void
+udp_reuse_connected(void *arg) {
+	dns_dispentry_t *resp = (dns_dispentry_t *)arg;
+	isc_nmhandle_t *handle = resp->reuse;
+
+	resp->reuse = NULL;
+	if (resp->timeout > 0) {
+		isc_nmhandle_settimeout(handle, resp->timeout);
+	}
+	udp_connected(handle, ISC_R_SUCCESS, resp);
+	isc_nmhandle_detach(&handle);
+}
+
 static void
 udp_dispatch_connect(dns_dispatch_t *disp, dns_dispentry_t *resp) {
 	REQUIRE(disp->tid == isc_tid());
@@ -1945,6 +2201,11 @@ udp_dispatch_connect(dns_dispatch_t *disp, dns_dispentry_t *resp) {
 	dns_dispentry_ref(resp); /* DISPENTRY004 */
 	ISC_LIST_APPEND(disp->pending, resp, plink);
 
+	if (resp->reuse != NULL) {
+		isc_async_current(udp_reuse_connected, resp);
+		return;
+	}
+
 	isc_nm_udpconnect(disp->mgr->nm, &resp->local, &resp->peer,
 			  udp_connected, resp, resp->timeout);
 }
@@ -2029,6 +2290,12 @@ tcp_dispatch_connect(dns_dispatch_t *disp, dns_dispentry_t *resp) {
 		if (!disp->reading) {
 			/* Restart the reading */
 			tcp_startrecv(disp, resp);
+		} else if (ISC_LIST_HEAD(disp->active) == resp &&
+			   resp->timeout > 0)
+		{
+			/* Reusing an idle connection; replace its timeout */
+			isc_nmhandle_cleartimeout(disp->handle);
+			isc_nmhandle_settimeout(disp->handle, resp->timeout);
 		}
 
 		/* Already connected; call the connected cb asynchronously */
@@ -2119,6 +2386,8 @@ udp_dispatch_getnext(dns_dispentry_t *resp, int32_t timeout) {
 		return;
 	}
 
+	resp->reusable = false;
+
 	if (timeout > 0) {
 		isc_nmhandle_settimeout(resp->handle, timeout);
 	}
@@ -127,10 +127,9 @@ dns_dns64_destroy(dns_dns64_t **dns64p) {
 }
 
 isc_result_t
-dns_dns64_aaaafroma(const dns_dns64_t *dns64, const isc_netaddr_t *reqaddr,
-		    const dns_name_t *reqsigner, dns_aclenv_t *env,
-		    unsigned int flags, unsigned char *a, unsigned char *aaaa) {
-	unsigned int nbytes, i;
+dns_dns64_clientok(const dns_dns64_t *dns64, const isc_netaddr_t *reqaddr,
+		   const dns_name_t *reqsigner, dns_aclenv_t *env,
+		   unsigned int flags) {
 	isc_result_t result;
 	int match;
 
@@ -157,6 +156,22 @@ dns_dns64_aaaafroma(const dns_dns64_t *dns64, const isc_netaddr_t *reqaddr,
 		}
 	}
 
+	return ISC_R_SUCCESS;
+}
+
+isc_result_t
+dns_dns64_aaaafroma(const dns_dns64_t *dns64, const isc_netaddr_t *reqaddr,
+		    const dns_name_t *reqsigner, dns_aclenv_t *env,
+		    unsigned int flags, unsigned char *a, unsigned char *aaaa) {
+	unsigned int nbytes, i;
+	isc_result_t result;
+	int match;
+
+	result = dns_dns64_clientok(dns64, reqaddr, reqsigner, env, flags);
+	if (result != ISC_R_SUCCESS) {
+		return result;
+	}
+
 	if (dns64->mapped != NULL) {
 		struct in_addr ina;
 		isc_netaddr_t netaddr;
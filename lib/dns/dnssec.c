@@ -1285,7 +1285,7 @@ findmatchingkeys(const char *directory, char *namebuf, unsigned int len,
 		}
 
 		dstkey = NULL;
-		result = dst_key_fromnamedfile(
+		result = dst_key_fromnamedfile_cached(
 			dir.entry.name, directory,
 			DST_TYPE_PUBLIC | DST_TYPE_PRIVATE | DST_TYPE_STATE,
 			mctx, &dstkey);
@@ -56,6 +56,7 @@
 
 #include <isc/async.h>
 #include <isc/buffer.h>
+#include <isc/endian.h>
 #include <isc/file.h>
 #include <isc/log.h>
 #include <isc/mem.h>
@@ -82,11 +83,11 @@
 #define VALID_DTENV(env) ISC_MAGIC_VALID(env, DTENV_MAGIC)
 
 #define DNSTAP_CONTENT_TYPE	"protobuf:dnstap.Dnstap"
-#define DNSTAP_INITIAL_BUF_SIZE 256
 
 struct dns_dtmsg {
 	void *buf;
 	size_t len;
+	size_t msize; /*%< of the encoded 'm' */
 	Dnstap__Dnstap d;
 	Dnstap__Message m;
 };
@@ -118,6 +119,7 @@ struct dns_dtenv {
 	int rolls;
 	isc_log_rollsuffix_t suffix;
 	isc_stats_t *stats;
+	atomic_uint_fast32_t sample;
 };
 
 #define CHECK(x)                             \
@@ -421,6 +423,29 @@ dns_dt_setversion(dns_dtenv_t *env, const char *version) {
 	return toregion(env, &env->version, version);
 }
 
+void
+dns_dt_setsample(dns_dtenv_t *env, uint32_t rate) {
+	REQUIRE(VALID_DTENV(env));
+
+	atomic_store_relaxed(&env->sample, rate);
+}
+
+/*
+ * Sample the messages by their ID, so that the response to a query that
+ * is logged is logged too.
+ */
+static bool
+sampled(dns_dtenv_t *env, isc_buffer_t *buf) {
+	uint32_t rate = atomic_load_relaxed(&env->sample);
+	const uint8_t *p = isc_buffer_base(buf);
+
+	if (rate <= 1 || isc_buffer_usedlength(buf) < 2) {
+		return true;
+	}
+
+	return (p[0] << 8 | p[1]) % rate == 0;
+}
+
 static void
 set_dt_ioq(unsigned int generation, struct fstrm_iothr_queue *ioq) {
 	dt_ioq.generation = generation;
@@ -516,30 +541,183 @@ dns_dt_detach(dns_dtenv_t **envp) {
 	}
 }
 
-static isc_result_t
-pack_dt(const Dnstap__Dnstap *d, void **buf, size_t *sz) {
-	ProtobufCBufferSimple sbuf;
+/*
+ * The dnstap frames are encoded here rather than with
+ * dnstap__dnstap__pack(), which walks the field descriptors of every
+ * message and grows its output buffer as it goes.  The size of the frame
+ * is computed first, so that it is allocated once and written in one
+ * pass.  The fields are written in the order of their numbers, as
+ * protobuf-c does, so the frames are the same.
+ */
+#define PB_VARINT  0
+#define PB_FIXED32 5
+#define PB_BYTES   2
 
-	REQUIRE(d != NULL);
+static size_t
+pb_varintsize(uint64_t value) {
+	size_t size = 1;
+
+	while (value >= 0x80) {
+		value >>= 7;
+		size++;
+	}
+
+	return size;
+}
+
+static uint8_t *
+pb_putvarint(uint8_t *p, uint64_t value) {
+	while (value >= 0x80) {
+		*p++ = (value & 0x7f) | 0x80;
+		value >>= 7;
+	}
+	*p++ = value;
+
+	return p;
+}
+
+static size_t
+pb_varintfield(unsigned int field, uint64_t value) {
+	return pb_varintsize(field << 3) + pb_varintsize(value);
+}
+
+static size_t
+pb_bytesfield(unsigned int field, size_t len) {
+	return pb_varintsize(field << 3) + pb_varintsize(len) + len;
+}
+
+static size_t
+pb_fixed32field(unsigned int field) {
+	return pb_varintsize(field << 3) + 4;
+}
+
+static uint8_t *
+pb_putvarintfield(uint8_t *p, unsigned int field, uint64_t value) {
+	p = pb_putvarint(p, field << 3 | PB_VARINT);
+	return pb_putvarint(p, value);
+}
+
+static uint8_t *
+pb_putbytesfield(uint8_t *p, unsigned int field, const uint8_t *data,
+		 size_t len) {
+	p = pb_putvarint(p, field << 3 | PB_BYTES);
+	p = pb_putvarint(p, len);
+	if (len > 0) {
+		memmove(p, data, len);
+	}
+	return p + len;
+}
+
+static uint8_t *
+pb_putfixed32field(uint8_t *p, unsigned int field, uint32_t value) {
+	p = pb_putvarint(p, field << 3 | PB_FIXED32);
+	ISC_U32TO8_LE(p, value);
+	return p + 4;
+}
+
+/*
+ * Add the size of a field that is set to 'size' when 'p' is NULL, or
+ * write it at 'p'.
+ */
+#define PB_VARINT_FIELD(field, has, value)                           \
+	if (has) {                                                   \
+		if (p == NULL) {                                     \
+			size += pb_varintfield(field, value);        \
+		} else {                                             \
+			p = pb_putvarintfield(p, field, value);      \
+		}                                                    \
+	}
+#define PB_FIXED32_FIELD(field, has, value)                          \
+	if (has) {                                                   \
+		if (p == NULL) {                                     \
+			size += pb_fixed32field(field);              \
+		} else {                                             \
+			p = pb_putfixed32field(p, field, value);     \
+		}                                                    \
+	}
+#define PB_BYTES_FIELD(field, has, value)                              \
+	if (has) {                                                     \
+		if (p == NULL) {                                       \
+			size += pb_bytesfield(field, (value).len);     \
+		} else {                                               \
+			p = pb_putbytesfield(p, field, (value).data,   \
+					     (value).len);             \
+		}                                                      \
+	}
+
+/*
+ * Return the size of the encoded message 'm' when 'p' is NULL, or write it
+ * at 'p'.
+ */
+static size_t
+encode_message(const Dnstap__Message *m, uint8_t *p) {
+	size_t size = 0;
+
+	INSIST(m->policy == NULL);
+
+	PB_VARINT_FIELD(1, true, m->type);
+	PB_VARINT_FIELD(2, m->has_socket_family, m->socket_family);
+	PB_VARINT_FIELD(3, m->has_socket_protocol, m->socket_protocol);
+	PB_BYTES_FIELD(4, m->has_query_address, m->query_address);
+	PB_BYTES_FIELD(5, m->has_response_address, m->response_address);
+	PB_VARINT_FIELD(6, m->has_query_port, m->query_port);
+	PB_VARINT_FIELD(7, m->has_response_port, m->response_port);
+	PB_VARINT_FIELD(8, m->has_query_time_sec, m->query_time_sec);
+	PB_FIXED32_FIELD(9, m->has_query_time_nsec, m->query_time_nsec);
+	PB_BYTES_FIELD(10, m->has_query_message, m->query_message);
+	PB_BYTES_FIELD(11, m->has_query_zone, m->query_zone);
+	PB_VARINT_FIELD(12, m->has_response_time_sec, m->response_time_sec);
+	PB_FIXED32_FIELD(13, m->has_response_time_nsec,
+			 m->response_time_nsec);
+	PB_BYTES_FIELD(14, m->has_response_message, m->response_message);
+
+	return size;
+}
+
+/*
+ * As encode_message(), for the frame holding 'dm'; the size of the
+ * message is remembered from the first pass for the second.
+ */
+static size_t
+encode_dt(dns_dtmsg_t *dm, uint8_t *p) {
+	size_t size = 0;
+
+	INSIST(!dm->d.has_extra);
+
+	PB_BYTES_FIELD(1, dm->d.has_identity, dm->d.identity);
+	PB_BYTES_FIELD(2, dm->d.has_version, dm->d.version);
+	if (p == NULL) {
+		dm->msize = encode_message(&dm->m, NULL);
+		size += pb_bytesfield(14, dm->msize);
+	} else {
+		p = pb_putvarint(p, 14 << 3 | PB_BYTES);
+		p = pb_putvarint(p, dm->msize);
+		(void)encode_message(&dm->m, p);
+		p += dm->msize;
+	}
+	PB_VARINT_FIELD(15, true, dm->d.type);
+
+	return size;
+}
+
+#undef PB_VARINT_FIELD
+#undef PB_FIXED32_FIELD
+#undef PB_BYTES_FIELD
+
+static isc_result_t
+pack_dt(dns_dtmsg_t *dm, void **buf, size_t *sz) {
+	REQUIRE(dm != NULL);
 	REQUIRE(sz != NULL);
 
-	memset(&sbuf, 0, sizeof(sbuf));
-	sbuf.base.append = protobuf_c_buffer_simple_append;
-	sbuf.len = 0;
-	sbuf.alloced = DNSTAP_INITIAL_BUF_SIZE;
+	*sz = encode_dt(dm, NULL);
 
-	/* Need to use malloc() here because protobuf uses free() */
-	sbuf.data = malloc(sbuf.alloced);
-	if (sbuf.data == NULL) {
+	/* Need to use malloc() here because fstrm uses free() */
+	*buf = malloc(*sz);
+	if (*buf == NULL) {
 		return ISC_R_NOMEMORY;
 	}
-	sbuf.must_free_data = 1;
 
-	*sz = dnstap__dnstap__pack_to_buffer(d, (ProtobufCBuffer *)&sbuf);
-	if (sbuf.data == NULL) {
-		return ISC_R_FAILURE;
-	}
-	*buf = sbuf.data;
+	(void)encode_dt(dm, *buf);
 
 	return ISC_R_SUCCESS;
 }
@@ -761,6 +939,10 @@ dns_dt_send(dns_view_t *view, dns_dtmsgtype_t msgtype, isc_sockaddr_t *qaddr,
 
 	REQUIRE(VALID_DTENV(view->dtenv));
 
+	if (!sampled(view->dtenv, buf)) {
+		return;
+	}
+
 	if (view->dtenv->max_size != 0) {
 		check_file_size_and_maybe_reopen(view->dtenv);
 	}
@@ -855,7 +1037,7 @@ dns_dt_send(dns_view_t *view, dns_dtmsgtype_t msgtype, isc_sockaddr_t *qaddr,
 			&dm.m.has_response_port);
 	}
 
-	if (pack_dt(&dm.d, &dm.buf, &dm.len) == ISC_R_SUCCESS) {
+	if (pack_dt(&dm, &dm.buf, &dm.len) == ISC_R_SUCCESS) {
 		send_dt(view->dtenv, dm.buf, dm.len);
 	}
 }
@@ -32,17 +32,24 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
 
 #include <isc/buffer.h>
+#include <isc/cryptojob.h>
 #include <isc/dir.h>
 #include <isc/file.h>
 #include <isc/fips.h>
+#include <isc/hash.h>
+#include <isc/hashmap.h>
 #include <isc/lex.h>
+#include <isc/list.h>
 #include <isc/mem.h>
+#include <isc/mutex.h>
 #include <isc/once.h>
 #include <isc/os.h>
 #include <isc/random.h>
@@ -65,6 +72,7 @@
 #include <dns/types.h>
 
 #include "dst_internal.h"
+#include "dst_openssl.h"
 
 #define DST_AS_STR(t) ((t).value.as_textregion.base)
 
@@ -189,6 +197,93 @@ addsuffix(char *filename, int len, const char *dirname, const char *ofilename,
 
 static isc_mem_t *dst__mctx = NULL;
 
+/*%
+ * The public keys parsed by dst_key_fromdns_cached(), most recently used
+ * first.  The size of an entry is estimated from the size of the rdata
+ * plus KEYCACHE_OVERHEAD for the libcrypto key object, and the least
+ * recently used entries are dropped when the total is over KEYCACHE_SIZE.
+ */
+#define KEYCACHE_HASH_BITS 10
+#define KEYCACHE_SIZE	   (4 * 1024 * 1024)
+#define KEYCACHE_OVERHEAD  2048
+
+typedef struct keycache_entry keycache_entry_t;
+struct keycache_entry {
+	uint32_t hashval;
+	dst_key_t *key;
+	dns_rdataclass_t rdclass;
+	isc_region_t rdata;
+	size_t size;
+	ISC_LINK(keycache_entry_t) link;
+};
+
+typedef struct keycache_key {
+	const dns_name_t *name;
+	dns_rdataclass_t rdclass;
+	isc_region_t rdata;
+} keycache_key_t;
+
+static isc_mutex_t keycache_lock;
+static isc_hashmap_t *keycache = NULL;
+static ISC_LIST(keycache_entry_t) keycache_lru;
+static size_t keycache_size = 0;
+
+static void
+keycache_flush(void);
+
+/*%
+ * The keys read by dst_key_fromnamedfile_cached(), by the name of their
+ * private key file, most recently used first.  An entry remembers the
+ * identity, size and modification time of the key, private key and state
+ * files it was read from and is only used while they are unchanged, so
+ * a key that is updated on disk is read again.  Only keys that keep their
+ * libcrypto objects in 'keydata.pkeypair' are cached, as the copies that
+ * are handed out share these objects.
+ */
+#define FILECACHE_HASH_BITS 12
+#define FILECACHE_SIZE	    (256 * 1024 * 1024)
+#define FILECACHE_OVERHEAD  4096
+
+enum {
+	FILECACHE_PUBLIC,
+	FILECACHE_PRIVATE,
+	FILECACHE_STATE,
+	FILECACHE_NFILES
+};
+
+typedef struct filecache_stat {
+	bool exists;
+	dev_t dev;
+	ino_t ino;
+	off_t size;
+	time_t mtime;
+	long mtime_nsec;
+} filecache_stat_t;
+
+typedef struct filecache_entry filecache_entry_t;
+struct filecache_entry {
+	uint32_t hashval;
+	char *filename;
+	int type;
+	filecache_stat_t files[FILECACHE_NFILES];
+	dst_key_t *key;
+	size_t size;
+	ISC_LINK(filecache_entry_t) link;
+};
+
+typedef struct filecache_key {
+	const char *filename;
+	int type;
+} filecache_key_t;
+
+static isc_mutex_t filecache_lock;
+static isc_hashmap_t *filecache = NULL;
+static ISC_LIST(filecache_entry_t) filecache_lru;
+static size_t filecache_size = 0;
+
+static void
+filecache_flush(void);
+
 void
 dst__lib_init(void) ISC_CONSTRUCTOR;
 void
@@ -198,6 +293,14 @@ void
 dst__lib_init(void) {
 	isc_mem_create(&dst__mctx);
 
+	isc_mutex_init(&keycache_lock);
+	isc_hashmap_create(dst__mctx, KEYCACHE_HASH_BITS, &keycache);
+	ISC_LIST_INIT(keycache_lru);
+
+	isc_mutex_init(&filecache_lock);
+	isc_hashmap_create(dst__mctx, FILECACHE_HASH_BITS, &filecache);
+	ISC_LIST_INIT(filecache_lru);
+
 	dst__hmacmd5_init(&dst_t_func[DST_ALG_HMACMD5]);
 	dst__hmacsha1_init(&dst_t_func[DST_ALG_HMACSHA1]);
 	dst__hmacsha224_init(&dst_t_func[DST_ALG_HMACSHA224]);
@@ -231,6 +334,14 @@ dst__lib_destroy(void) {
 		}
 	}
 
+	keycache_flush();
+	isc_hashmap_destroy(&keycache);
+	isc_mutex_destroy(&keycache_lock);
+
+	filecache_flush();
+	isc_hashmap_destroy(&filecache);
+	isc_mutex_destroy(&filecache_lock);
+
 	isc_mem_destroy(&dst__mctx);
 }
 
@@ -356,6 +467,79 @@ dst_context_verify(dst_context_t *dctx, isc_region_t *sig) {
 	return dctx->key->func->verify(dctx, sig);
 }
 
+typedef struct dst_asyncop {
+	dst_context_t *dctx;
+	isc_buffer_t *sig;
+	isc_region_t *region;
+	dst_context_cb_t cb;
+	void *arg;
+} dst_asyncop_t;
+
+static isc_result_t
+asyncop_sign(void *arg) {
+	dst_asyncop_t *op = arg;
+
+	return dst_context_sign(op->dctx, op->sig);
+}
+
+static isc_result_t
+asyncop_verify(void *arg) {
+	dst_asyncop_t *op = arg;
+
+	return dst_context_verify(op->dctx, op->region);
+}
+
+static void
+asyncop_done(isc_result_t result, void *arg) {
+	dst_asyncop_t *op = arg;
+	dst_context_cb_t cb = op->cb;
+	void *cbarg = op->arg;
+
+	isc_mem_put(op->dctx->mctx, op, sizeof(*op));
+
+	cb(result, cbarg);
+}
+
+void
+dst_context_signasync(dst_context_t *dctx, isc_buffer_t *sig,
+		      isc_loop_t *loop, dst_context_cb_t cb, void *arg) {
+	dst_asyncop_t *op = NULL;
+
+	REQUIRE(VALID_CTX(dctx));
+	REQUIRE(sig != NULL);
+	REQUIRE(cb != NULL);
+
+	op = isc_mem_get(dctx->mctx, sizeof(*op));
+	*op = (dst_asyncop_t){
+		.dctx = dctx,
+		.sig = sig,
+		.cb = cb,
+		.arg = arg,
+	};
+
+	isc_cryptojob_run(loop, asyncop_sign, asyncop_done, op);
+}
+
+void
+dst_context_verifyasync(dst_context_t *dctx, isc_region_t *sig,
+			isc_loop_t *loop, dst_context_cb_t cb, void *arg) {
+	dst_asyncop_t *op = NULL;
+
+	REQUIRE(VALID_CTX(dctx));
+	REQUIRE(sig != NULL);
+	REQUIRE(cb != NULL);
+
+	op = isc_mem_get(dctx->mctx, sizeof(*op));
+	*op = (dst_asyncop_t){
+		.dctx = dctx,
+		.region = sig,
+		.cb = cb,
+		.arg = arg,
+	};
+
+	isc_cryptojob_run(loop, asyncop_verify, asyncop_done, op);
+}
+
 isc_result_t
 dst_context_verify2(dst_context_t *dctx, unsigned int maxbits,
 		    isc_region_t *sig) {
@@ -690,6 +874,288 @@ out:
 	return result;
 }
 
+/*
+ * Make a copy of 'source' in 'mctx' that shares its libcrypto objects.
+ */
+static dst_key_t *
+key_dup(const dst_key_t *source, isc_mem_t *mctx) {
+	dst_key_t *key = get_key_struct(source->key_name, source->key_alg,
+					source->key_flags, source->key_proto,
+					source->key_size, source->key_class,
+					source->key_ttl, mctx);
+
+	key->key_id = source->key_id;
+	key->key_rid = source->key_rid;
+	key->key_bits = source->key_bits;
+
+	memmove(key->times, source->times, sizeof(key->times));
+	memmove(key->timeset, source->timeset, sizeof(key->timeset));
+	memmove(key->nums, source->nums, sizeof(key->nums));
+	memmove(key->numset, source->numset, sizeof(key->numset));
+	memmove(key->bools, source->bools, sizeof(key->bools));
+	memmove(key->boolset, source->boolset, sizeof(key->boolset));
+	memmove(key->keystates, source->keystates, sizeof(key->keystates));
+	memmove(key->keystateset, source->keystateset,
+		sizeof(key->keystateset));
+
+	key->kasp = source->kasp;
+	key->inactive = source->inactive;
+	key->external = source->external;
+	key->modified = source->modified;
+	key->fmt_major = source->fmt_major;
+	key->fmt_minor = source->fmt_minor;
+
+	if (source->directory != NULL) {
+		key->directory = isc_mem_strdup(mctx, source->directory);
+	}
+	if (source->label != NULL) {
+		key->label = isc_mem_strdup(mctx, source->label);
+	}
+
+	key->keydata.pkeypair = source->keydata.pkeypair;
+	if (key->keydata.pkeypair.pub != NULL) {
+		EVP_PKEY_up_ref(key->keydata.pkeypair.pub);
+	}
+	if (key->keydata.pkeypair.priv != NULL &&
+	    key->keydata.pkeypair.priv != key->keydata.pkeypair.pub)
+	{
+		EVP_PKEY_up_ref(key->keydata.pkeypair.priv);
+	}
+
+	return key;
+}
+
+static void
+filecache_stat(const char *filename, filecache_stat_t *fst) {
+	struct stat st;
+
+	*fst = (filecache_stat_t){ .exists = false };
+	if (stat(filename, &st) != 0) {
+		return;
+	}
+
+	fst->exists = true;
+	fst->dev = st.st_dev;
+	fst->ino = st.st_ino;
+	fst->size = st.st_size;
+	fst->mtime = st.st_mtime;
+#if defined(HAVE_STAT_NSEC)
+	fst->mtime_nsec = st.st_mtim.tv_nsec;
+#endif /* if defined(HAVE_STAT_NSEC) */
+}
+
+static isc_result_t
+filecache_statfiles(const char *filename, const char *dirname, int type,
+		    filecache_stat_t *files) {
+	static const char *suffixes[FILECACHE_NFILES] = {
+		[FILECACHE_PUBLIC] = ".key",
+		[FILECACHE_PRIVATE] = ".private",
+		[FILECACHE_STATE] = ".state",
+	};
+	char path[PATH_MAX];
+
+	for (size_t i = 0; i < FILECACHE_NFILES; i++) {
+		isc_result_t result;
+
+		files[i] = (filecache_stat_t){ .exists = false };
+		if (i == FILECACHE_STATE && (type & DST_TYPE_STATE) == 0) {
+			continue;
+		}
+
+		result = addsuffix(path, sizeof(path), dirname, filename,
+				   suffixes[i]);
+		if (result != ISC_R_SUCCESS) {
+			return result;
+		}
+		filecache_stat(path, &files[i]);
+	}
+
+	return ISC_R_SUCCESS;
+}
+
+static bool
+filecache_unchanged(const filecache_stat_t *a, const filecache_stat_t *b) {
+	for (size_t i = 0; i < FILECACHE_NFILES; i++) {
+		if (a[i].exists != b[i].exists ||
+		    (a[i].exists &&
+		     (a[i].dev != b[i].dev || a[i].ino != b[i].ino ||
+		      a[i].size != b[i].size || a[i].mtime != b[i].mtime ||
+		      a[i].mtime_nsec != b[i].mtime_nsec)))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * A file modified within the last second could be modified again without
+ * a change to its modification time, so a key read from it is not cached.
+ */
+static bool
+filecache_racy(const filecache_stat_t *files) {
+	isc_stdtime_t now = isc_stdtime_now();
+
+	for (size_t i = 0; i < FILECACHE_NFILES; i++) {
+		if (files[i].exists && files[i].mtime + 1 >= (time_t)now) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool
+filecache_match(void *node, const void *arg) {
+	const filecache_entry_t *entry = node;
+	const filecache_key_t *key = arg;
+
+	return entry->type == key->type &&
+	       strcmp(entry->filename, key->filename) == 0;
+}
+
+static void
+filecache_delete(filecache_entry_t *entry) {
+	isc_result_t result;
+	filecache_key_t key = {
+		.filename = entry->filename,
+		.type = entry->type,
+	};
+
+	result = isc_hashmap_delete(filecache, entry->hashval,
+				    filecache_match, &key);
+	INSIST(result == ISC_R_SUCCESS);
+
+	ISC_LIST_UNLINK(filecache_lru, entry, link);
+	filecache_size -= entry->size;
+
+	dst_key_free(&entry->key);
+	isc_mem_free(dst__mctx, entry->filename);
+	isc_mem_put(dst__mctx, entry, sizeof(*entry));
+}
+
+static void
+filecache_flush(void) {
+	filecache_entry_t *entry = NULL;
+
+	LOCK(&filecache_lock);
+	while ((entry = ISC_LIST_HEAD(filecache_lru)) != NULL) {
+		filecache_delete(entry);
+	}
+	INSIST(filecache_size == 0);
+	UNLOCK(&filecache_lock);
+}
+
+isc_result_t
+dst_key_fromnamedfile_cached(const char *filename, const char *dirname,
+			     int type, isc_mem_t *mctx, dst_key_t **keyp) {
+	filecache_stat_t files[FILECACHE_NFILES], after[FILECACHE_NFILES];
+	filecache_entry_t *entry = NULL, *found = NULL;
+	filecache_key_t key = { .type = type };
+	char privname[PATH_MAX];
+	dst_key_t *dstkey = NULL;
+	uint32_t hashval;
+	isc_result_t result;
+
+	REQUIRE(filename != NULL);
+	REQUIRE((type & (DST_TYPE_PRIVATE | DST_TYPE_PUBLIC)) != 0);
+	REQUIRE(mctx != NULL);
+	REQUIRE(keyp != NULL && *keyp == NULL);
+
+	if (filename[0] == '/') {
+		dirname = NULL;
+	}
+
+	if (addsuffix(privname, sizeof(privname), dirname, filename,
+		      ".private") != ISC_R_SUCCESS ||
+	    filecache_statfiles(filename, dirname, type, files) !=
+		    ISC_R_SUCCESS)
+	{
+		return dst_key_fromnamedfile(filename, dirname, type, mctx,
+					     keyp);
+	}
+
+	key.filename = privname;
+	hashval = isc_hash32(privname, strlen(privname), true);
+
+	LOCK(&filecache_lock);
+	result = isc_hashmap_find(filecache, hashval, filecache_match, &key,
+				  (void **)&entry);
+	if (result == ISC_R_SUCCESS) {
+		if (filecache_unchanged(entry->files, files)) {
+			ISC_LIST_UNLINK(filecache_lru, entry, link);
+			ISC_LIST_PREPEND(filecache_lru, entry, link);
+			*keyp = key_dup(entry->key, mctx);
+		} else {
+			filecache_delete(entry);
+			result = ISC_R_NOTFOUND;
+		}
+	}
+	UNLOCK(&filecache_lock);
+
+	if (result == ISC_R_SUCCESS) {
+		return ISC_R_SUCCESS;
+	}
+
+	/* Read the key outside of the lock */
+	result = dst_key_fromnamedfile(filename, dirname, type, mctx, &dstkey);
+	if (result != ISC_R_SUCCESS) {
+		return result;
+	}
+	*keyp = dstkey;
+
+	/*
+	 * Don't cache the key if the files have changed while they were
+	 * read, or might change again unnoticed.
+	 */
+	if (dstkey->func->destroy != dst__openssl_keypair_destroy ||
+	    dstkey->key_tkeytoken != NULL || filecache_racy(files) ||
+	    filecache_statfiles(filename, dirname, type, after) !=
+		    ISC_R_SUCCESS ||
+	    !filecache_unchanged(files, after))
+	{
+		return ISC_R_SUCCESS;
+	}
+
+	entry = isc_mem_get(dst__mctx, sizeof(*entry));
+	*entry = (filecache_entry_t){
+		.hashval = hashval,
+		.filename = isc_mem_strdup(dst__mctx, privname),
+		.type = type,
+		.key = key_dup(dstkey, dst__mctx),
+		.size = sizeof(*entry) + sizeof(*dstkey) + strlen(privname) +
+			dstkey->key_name->length + FILECACHE_OVERHEAD,
+		.link = ISC_LINK_INITIALIZER,
+	};
+	memmove(entry->files, files, sizeof(entry->files));
+	key.filename = entry->filename;
+
+	LOCK(&filecache_lock);
+	result = isc_hashmap_add(filecache, hashval, filecache_match, &key,
+				 entry, (void **)&found);
+	if (result == ISC_R_SUCCESS) {
+		ISC_LIST_PREPEND(filecache_lru, entry, link);
+		filecache_size += entry->size;
+		while (filecache_size > FILECACHE_SIZE) {
+			filecache_delete(ISC_LIST_TAIL(filecache_lru));
+		}
+		entry = NULL;
+	} else {
+		/* Another thread has added the same key meanwhile */
+		INSIST(result == ISC_R_EXISTS);
+	}
+	UNLOCK(&filecache_lock);
+
+	if (entry != NULL) {
+		dst_key_free(&entry->key);
+		isc_mem_free(dst__mctx, entry->filename);
+		isc_mem_put(dst__mctx, entry, sizeof(*entry));
+	}
+
+	return ISC_R_SUCCESS;
+}
+
 isc_result_t
 dst_key_todns(const dst_key_t *key, isc_buffer_t *target) {
 	REQUIRE(VALID_KEY(key));
@@ -772,6 +1238,141 @@ dst_key_fromdns_ex(const dns_name_t *name, dns_rdataclass_t rdclass,
 	return ISC_R_SUCCESS;
 }
 
+static uint32_t
+keycache_hash(const keycache_key_t *key) {
+	isc_hash32_t state;
+
+	isc_hash32_init(&state);
+	isc_hash32_hash(&state, key->name->ndata, key->name->length, false);
+	isc_hash32_hash(&state, &key->rdclass, sizeof(key->rdclass), true);
+	isc_hash32_hash(&state, key->rdata.base, key->rdata.length, true);
+
+	return isc_hash32_finalize(&state);
+}
+
+static bool
+keycache_match(void *node, const void *arg) {
+	const keycache_entry_t *entry = node;
+	const keycache_key_t *key = arg;
+
+	return entry->rdclass == key->rdclass &&
+	       entry->rdata.length == key->rdata.length &&
+	       memcmp(entry->rdata.base, key->rdata.base,
+		      key->rdata.length) == 0 &&
+	       dns_name_equal(entry->key->key_name, key->name);
+}
+
+static void
+keycache_delete(keycache_entry_t *entry) {
+	isc_result_t result;
+	keycache_key_t key = {
+		.name = entry->key->key_name,
+		.rdclass = entry->rdclass,
+		.rdata = entry->rdata,
+	};
+
+	result = isc_hashmap_delete(keycache, entry->hashval, keycache_match,
+				    &key);
+	INSIST(result == ISC_R_SUCCESS);
+
+	ISC_LIST_UNLINK(keycache_lru, entry, link);
+	keycache_size -= entry->size;
+
+	dst_key_free(&entry->key);
+	isc_mem_put(dst__mctx, entry->rdata.base, entry->rdata.length);
+	isc_mem_put(dst__mctx, entry, sizeof(*entry));
+}
+
+static void
+keycache_flush(void) {
+	keycache_entry_t *entry = NULL;
+
+	LOCK(&keycache_lock);
+	while ((entry = ISC_LIST_HEAD(keycache_lru)) != NULL) {
+		keycache_delete(entry);
+	}
+	INSIST(keycache_size == 0);
+	UNLOCK(&keycache_lock);
+}
+
+isc_result_t
+dst_key_fromdns_cached(const dns_name_t *name, dns_rdataclass_t rdclass,
+		       isc_buffer_t *source, dst_key_t **keyp) {
+	keycache_entry_t *entry = NULL, *found = NULL;
+	keycache_key_t key = { .name = name, .rdclass = rdclass };
+	dst_key_t *dstkey = NULL;
+	uint32_t hashval;
+	isc_result_t result;
+
+	REQUIRE(dns_name_isabsolute(name));
+	REQUIRE(source != NULL);
+	REQUIRE(keyp != NULL && *keyp == NULL);
+
+	isc_buffer_remainingregion(source, &key.rdata);
+	hashval = keycache_hash(&key);
+
+	LOCK(&keycache_lock);
+	result = isc_hashmap_find(keycache, hashval, keycache_match, &key,
+				  (void **)&entry);
+	if (result == ISC_R_SUCCESS) {
+		ISC_LIST_UNLINK(keycache_lru, entry, link);
+		ISC_LIST_PREPEND(keycache_lru, entry, link);
+		dst_key_attach(entry->key, keyp);
+	}
+	UNLOCK(&keycache_lock);
+
+	if (result == ISC_R_SUCCESS) {
+		isc_buffer_forward(source, key.rdata.length);
+		return ISC_R_SUCCESS;
+	}
+
+	/* Build the key outside of the lock */
+	result = dst_key_fromdns(name, rdclass, source, dst__mctx, &dstkey);
+	if (result != ISC_R_SUCCESS) {
+		return result;
+	}
+
+	entry = isc_mem_get(dst__mctx, sizeof(*entry));
+	*entry = (keycache_entry_t){
+		.hashval = hashval,
+		.key = dstkey,
+		.rdclass = rdclass,
+		.rdata.length = key.rdata.length,
+		.size = sizeof(*entry) + sizeof(*dstkey) + name->length +
+			key.rdata.length + KEYCACHE_OVERHEAD,
+		.link = ISC_LINK_INITIALIZER,
+	};
+	entry->rdata.base = isc_mem_get(dst__mctx, key.rdata.length);
+	memmove(entry->rdata.base, key.rdata.base, key.rdata.length);
+	key.rdata = entry->rdata;
+
+	LOCK(&keycache_lock);
+	result = isc_hashmap_add(keycache, hashval, keycache_match, &key, entry,
+				 (void **)&found);
+	if (result == ISC_R_EXISTS) {
+		/* Another thread has added the same key meanwhile */
+		dst_key_attach(found->key, keyp);
+	} else {
+		INSIST(result == ISC_R_SUCCESS);
+		ISC_LIST_PREPEND(keycache_lru, entry, link);
+		keycache_size += entry->size;
+		dst_key_attach(entry->key, keyp);
+		while (keycache_size > KEYCACHE_SIZE) {
+			keycache_delete(ISC_LIST_TAIL(keycache_lru));
+		}
+		entry = NULL;
+	}
+	UNLOCK(&keycache_lock);
+
+	if (entry != NULL) {
+		dst_key_free(&entry->key);
+		isc_mem_put(dst__mctx, entry->rdata.base, entry->rdata.length);
+		isc_mem_put(dst__mctx, entry, sizeof(*entry));
+	}
+
+	return ISC_R_SUCCESS;
+}
+
 isc_result_t
 dst_key_frombuffer(const dns_name_t *name, unsigned int alg, unsigned int flags,
 		   unsigned int protocol, dns_rdataclass_t rdclass,
@@ -24,6 +24,8 @@
 #include <maxminddb.h>
 #include <netinet/in.h>
 
+#include <isc/atomic.h>
+#include <isc/hash.h>
 #include <isc/log.h>
 #include <isc/mem.h>
 #include <isc/once.h>
@@ -36,66 +38,99 @@
 #include <dns/geoip.h>
 
 /*
- * This structure preserves state from the previous GeoIP lookup,
- * so that successive lookups for the same data from the same IP
- * address will not require repeated database lookups.
- * This should improve performance somewhat.
+ * The results of the recent GeoIP lookups are kept in a small cache,
+ * so that successive lookups from the same network will not require
+ * repeated database lookups.  This is for the case when a single
+ * query has to process multiple geoip ACLs, for example when there
+ * are multiple views with match-clients statements that search for
+ * different countries, and for the queries from the same clients.
  *
- * For all lookups we preserve pointers to the MMDB_lookup_result_s
- * and MMDB_entry_s structures, a pointer to the database from which
- * the lookup was answered, and a copy of the request address.
+ * Every database lookup answers for the whole network of the record
+ * it finds, whose prefix length is returned with the record: a cached
+ * result is used for any address in that network.  The cache slot is
+ * chosen by the /24 (IPv4) or /48 (IPv6) of the address, so that the
+ * addresses of one network usually share a slot.
  *
- * If the next geoip ACL lookup is for the same database and from the
- * same address, we can reuse the MMDB entry without repeating the
- * lookup. This is for the case when a single query has to process
- * multiple geoip ACLs: for example, when there are multiple views with
- * match-clients statements that search for different countries.
- *
- * (XXX: Currently the persistent state is stored in thread specific
- * memory, but it could more simply be stored in the client object.
- * Also multiple entries could be stored in case the ACLs require
- * searching in more than one GeoIP database.)
+ * The cache is in thread specific memory, so that it needs no
+ * locking.  The entries point into the databases, and the databases
+ * are reopened in the same MMDB_s structures: dns_geoip_flush()
+ * invalidates every cache by bumping the generation number.
  */
 
+#define GEOIP_CACHE_SIZE 256
+
 typedef struct geoip_state {
-	uint16_t subtype;
 	const MMDB_s *db;
+	uint32_t generation;
 	isc_netaddr_t addr;
-	MMDB_lookup_result_s mmresult;
+	unsigned int prefixlen;
+	bool found;
 	MMDB_entry_s entry;
 } geoip_state_t;
 
-static thread_local geoip_state_t geoip_state = { 0 };
+static thread_local geoip_state_t geoip_cache[GEOIP_CACHE_SIZE];
+
+/* Start with 1 so that the zeroed cache entries are not valid. */
+static atomic_uint_fast32_t geoip_generation = 1;
+
+static geoip_state_t *
+get_slot(const MMDB_s *db, const isc_netaddr_t *addr) {
+	isc_hash32_t hash;
+	size_t len = (addr->family == AF_INET6) ? 6 : 3;
+
+	isc_hash32_init(&hash);
+	isc_hash32_hash(&hash, &db, sizeof(db), true);
+	isc_hash32_hash(&hash, &addr->type, len, true);
 
-static void
-set_state(const MMDB_s *db, const isc_netaddr_t *addr,
-	  MMDB_lookup_result_s mmresult, MMDB_entry_s entry) {
-	geoip_state.db = db;
-	geoip_state.addr = *addr;
-	geoip_state.mmresult = mmresult;
-	geoip_state.entry = entry;
+	return &geoip_cache[isc_hash32_finalize(&hash) % GEOIP_CACHE_SIZE];
 }
 
 static geoip_state_t *
 get_entry_for(MMDB_s *const db, const isc_netaddr_t *addr) {
+	uint32_t generation = atomic_load_acquire(&geoip_generation);
+	geoip_state_t *state = get_slot(db, addr);
 	isc_sockaddr_t sa;
 	MMDB_lookup_result_s match;
+	unsigned int prefixlen;
 	int err;
 
-	if (db == geoip_state.db && isc_netaddr_equal(addr, &geoip_state.addr))
+	if (state->db == db && state->generation == generation &&
+	    state->addr.family == addr->family &&
+	    isc_netaddr_eqprefix(addr, &state->addr, state->prefixlen))
 	{
-		return &geoip_state;
+		return state->found ? state : NULL;
 	}
 
 	isc_sockaddr_fromnetaddr(&sa, addr, 0);
 	match = MMDB_lookup_sockaddr(db, &sa.type.sa, &err);
-	if (err != MMDB_SUCCESS || !match.found_entry) {
+	if (err != MMDB_SUCCESS) {
 		return NULL;
 	}
 
-	set_state(db, addr, match, match.entry);
+	/*
+	 * In an IPv6 database, the IPv4 addresses are looked up in
+	 * ::/96, and the netmask includes those 96 bits.
+	 */
+	prefixlen = match.netmask;
+	if (addr->family == AF_INET && db->metadata.ip_version == 6) {
+		prefixlen = (prefixlen > 96) ? prefixlen - 96 : 0;
+	}
+
+	*state = (geoip_state_t){
+		.db = db,
+		.generation = generation,
+		.addr = *addr,
+		.prefixlen = prefixlen,
+		.found = match.found_entry,
+		.entry = match.entry,
+	};
+
+	return state->found ? state : NULL;
+}
 
-	return &geoip_state;
+void
+dns_geoip_flush(void) {
+	atomic_fetch_add_release(&geoip_generation, 1);
 }
 
 static dns_geoip_subtype_t
@@ -153,6 +153,7 @@ hmac_fromdns(const isc_md_type_t *type, dst_key_t *key, isc_buffer_t *data);
 
 struct dst_hmac_key {
 	uint8_t key[ISC_MAX_BLOCK_SIZE];
+	isc_hmac_t *ctx; /*%< Context set up with the key, to be copied */
 };
 
 static isc_result_t
@@ -175,8 +176,12 @@ hmac_createctx(const isc_md_type_t *type, const dst_key_t *key,
 	const dst_hmac_key_t *hkey = key->keydata.hmac_key;
 	isc_hmac_t *ctx = isc_hmac_new(); /* Either returns or abort()s */
 
-	result = isc_hmac_init(ctx, hkey->key, isc_md_type_get_block_size(type),
-			       type);
+	if (hkey->ctx != NULL) {
+		result = isc_hmac_copy(ctx, hkey->ctx);
+	} else {
+		result = isc_hmac_init(ctx, hkey->key,
+				       isc_md_type_get_block_size(type), type);
+	}
 	if (result != ISC_R_SUCCESS) {
 		isc_hmac_free(ctx);
 		return DST_R_UNSUPPORTEDALG;
@@ -314,6 +319,7 @@ hmac_isprivate(const dst_key_t *key) {
 static void
 hmac_destroy(dst_key_t *key) {
 	dst_hmac_key_t *hkey = key->keydata.hmac_key;
+	isc_hmac_free(hkey->ctx);
 	isc_safe_memwipe(hkey, sizeof(*hkey));
 	isc_mem_put(key->mctx, hkey, sizeof(*hkey));
 	key->keydata.hmac_key = NULL;
@@ -362,6 +368,19 @@ hmac_fromdns(const isc_md_type_t *type, dst_key_t *key, isc_buffer_t *data) {
 		keylen = r.length;
 	}
 
+	/*
+	 * Set up a context with the key once, so that the contexts for
+	 * the messages are copied from it rather than set up again.
+	 */
+	hkey->ctx = isc_hmac_new();
+	if (isc_hmac_init(hkey->ctx, hkey->key,
+			  isc_md_type_get_block_size(type),
+			  type) != ISC_R_SUCCESS)
+	{
+		isc_hmac_free(hkey->ctx);
+		hkey->ctx = NULL;
+	}
+
 	key->key_size = keylen * 8;
 	key->keydata.hmac_key = hkey;
 
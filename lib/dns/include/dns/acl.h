@@ -30,6 +30,7 @@
 
 #include <stdbool.h>
 
+#include <isc/atomic.h>
 #include <isc/magic.h>
 #include <isc/netaddr.h>
 #include <isc/refcount.h>
@@ -104,6 +105,12 @@ struct dns_aclenv {
 	dns_acl_t *localhost;
 	dns_acl_t *localnets;
 
+	/*
+	 * Bumped whenever 'localhost' or 'localnets' change, for the
+	 * users that remember the results of the ACL matches.
+	 */
+	atomic_uint_fast32_t generation;
+
 	bool match_mapped;
 #if defined(HAVE_GEOIP2)
 	dns_geoip_databases_t *geoip;
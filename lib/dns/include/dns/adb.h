@@ -202,6 +202,7 @@ struct dns_adbaddrinfo {
 
 	isc_sockaddr_t	 sockaddr; /*%< [rw] */
 	unsigned int	 srtt;	   /*%< [rw] microsecs */
+	unsigned int	 rtthigh;  /*%< [r] microsecs, 0 if unknown */
 	dns_transport_t *transport;
 
 	unsigned int	flags; /*%< [rw] */
@@ -461,6 +462,14 @@ dns_adb_adjustsrtt(dns_adb_t *adb, dns_adbaddrinfo_t *addr, unsigned int rtt,
  *
  *\li	The srtt in addr will be updated to reflect the new global
  *	srtt value.  This may include changes made by others.
+ *
+ *\li	Unless 'factor' is #DNS_ADB_RTTADJREPLACE (which is used for
+ *	an estimated rtt, e.g. after a timeout), 'rtt' is taken to be a
+ *	measured round trip time and is also added to the server's RTT
+ *	histogram; see dns_adb_rttdump().  Once enough round trips have
+ *	been measured, the 95th percentile of the recent ones is copied
+ *	to the 'rtthigh' field of the addrinfo structures created for
+ *	the server.
  */
 
 void
@@ -731,6 +740,20 @@ dns_adb_endudpfetch(dns_adb_t *adb, dns_adbaddrinfo_t *addr);
  *\li	addr be valid.
  */
 
+unsigned int
+dns_adb_getactive(dns_adb_t *adb, dns_adbaddrinfo_t *addr);
+/*%<
+ * Return the number of UDP fetches currently outstanding to the
+ * address, as counted by dns_adb_beginudpfetch() and
+ * dns_adb_endudpfetch().
+ *
+ * Requires:
+ *
+ *\li	adb be valid.
+ *
+ *\li	addr be valid.
+ */
+
 isc_stats_t *
 dns_adb_getstats(dns_adb_t *adb);
 /*%<
@@ -751,3 +774,60 @@ dns_adb_dumpquota(dns_adb_t *adb, isc_buffer_t **buf);
  * Requires:
  * \li 'adb' is valid.
  */
+
+#define DNS_ADB_RTTQUANTILES 3
+
+typedef void (*dns_adbrttdumper_t)(const isc_sockaddr_t *addr,
+				   uint64_t samples, const uint64_t *quantiles,
+				   void *arg);
+
+void
+dns_adb_rttdump(dns_adb_t *adb, dns_adbrttdumper_t dumper, void *arg);
+/*%
+ * Call 'dumper' for each server with enough recently measured round
+ * trip times, with the number of the samples and the 99th, 95th and
+ * 50th percentiles of them (in that order, in microseconds) in the
+ * 'quantiles' array of #DNS_ADB_RTTQUANTILES elements.
+ *
+ * Requires:
+ * \li 'adb' is valid.
+ * \li 'dumper' is not NULL.
+ */
+
+isc_result_t
+dns_adb_savestate(dns_adb_t *adb, const char *filename);
+/*%
+ * Write what is known about the servers that have been talked to - the
+ * SRTT, the EDNS UDP size and counters, the flags set with
+ * dns_adb_changeflags() and the server cookie - to 'filename' in a compact
+ * binary format.  The file is written to a temporary file first and
+ * renamed when complete.
+ *
+ * Requires:
+ * \li 'adb' is valid.
+ * \li 'filename' is not NULL.
+ */
+
+isc_result_t
+dns_adb_loadstate(dns_adb_t *adb, const char *filename, size_t *loadedp);
+/*%
+ * Restore the server state saved by dns_adb_savestate() from 'filename'.
+ * The older the state, the more the SRTTs and the EDNS counters are
+ * decayed; the flags and the cookies are only restored from a recent
+ * state, and a state saved more than a day ago is ignored.
+ *
+ * If 'loadedp' is not NULL, the number of servers restored is stored
+ * there.
+ *
+ * Requires:
+ * \li 'adb' is valid.
+ * \li 'filename' is not NULL.
+ *
+ * Returns:
+ * \li #ISC_R_SUCCESS
+ * \li #ISC_R_FILENOTFOUND if there is no saved state
+ * \li #ISC_R_NOTIMPLEMENTED if the file is not an ADB state, or has an
+ *	unsupported version
+ * \li #ISC_R_UNEXPECTEDEND or #DNS_R_FORMERR if the file is truncated
+ *	or malformed; the servers before the error are kept.
+ */
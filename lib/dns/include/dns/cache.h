@@ -255,6 +255,99 @@ dns_cache_setmaxtypepername(dns_cache_t *cache, uint32_t value);
  * Set the maximum resource record types per owner name that can be cached.
  */
 
+isc_result_t
+dns_cache_setlockfreereads(dns_cache_t *cache, bool value);
+/*%<
+ * Enable or disable the lock-free reads mode of the cache database, in
+ * which the common lookups don't take the database locks.  The mode is
+ * fixed when the database is created, so changing it flushes the cache.
+ *
+ * Requires:
+ *\li	'cache' to be valid.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	any error returned by dns_cache_flush()
+ */
+
+bool
+dns_cache_getlockfreereads(dns_cache_t *cache);
+/*%<
+ * Return whether the lock-free reads mode is enabled for 'cache'.
+ *
+ * Requires:
+ *\li	'cache' to be valid.
+ */
+
+isc_result_t
+dns_cache_setevictionpolicy(dns_cache_t *cache, dns_cacheevict_t policy);
+/*%<
+ * Set the policy used to evict the entries from the cache database when
+ * it is over the memory limit: the least recently used entries first
+ * (dns_cacheevict_lru, the default), or SIEVE (dns_cacheevict_sieve),
+ * which doesn't reorder the entries on the cache hits and protects the
+ * frequently used entries from the bursts of entries used only once.
+ * The policy is fixed when the database is created, so changing it
+ * flushes the cache.
+ *
+ * Requires:
+ *\li	'cache' to be valid.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	any error returned by dns_cache_flush()
+ */
+
+dns_cacheevict_t
+dns_cache_getevictionpolicy(dns_cache_t *cache);
+/*%<
+ * Return the eviction policy of 'cache'.
+ *
+ * Requires:
+ *\li	'cache' to be valid.
+ */
+
+isc_result_t
+dns_cache_savesnapshot(dns_cache_t *cache, const char *filename);
+/*%<
+ * Write a snapshot of the contents of 'cache' to 'filename' in a compact
+ * binary format, keeping the TTLs, the trust levels and whether the
+ * RRsets are stale or negative.  The RRsets carrying wildcard or NSEC3
+ * proofs are not included.  The file is written to a temporary file
+ * first and renamed when complete.
+ *
+ * Requires:
+ *\li	'cache' to be valid.
+ *\li	'filename' is not NULL.
+ */
+
+isc_result_t
+dns_cache_loadsnapshot(dns_cache_t *cache, const char *filename,
+		       size_t *loadedp);
+/*%<
+ * Add the RRsets from the snapshot 'filename', written by
+ * dns_cache_savesnapshot(), to 'cache'.  The RRsets that have expired
+ * since the snapshot was taken are skipped, unless they can still be
+ * served stale.  The snapshot is expected to be loaded into an empty
+ * cache.
+ *
+ * If 'loadedp' is not NULL, the number of RRsets added is stored there.
+ *
+ * Requires:
+ *\li	'cache' to be valid.
+ *\li	'filename' is not NULL.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_FILENOTFOUND if there is no snapshot
+ *\li	#ISC_R_NOTIMPLEMENTED if the file is not a snapshot, or has an
+ *	unsupported version
+ *\li	#DNS_R_BADCLASS if the snapshot was taken of a cache of a
+ *	different class
+ *\li	#ISC_R_UNEXPECTEDEND or #DNS_R_FORMERR if the snapshot is
+ *	truncated or malformed; the RRsets before the error are kept.
+ */
+
 #ifdef HAVE_LIBXML2
 int
 dns_cache_renderxml(dns_cache_t *cache, void *writer0);
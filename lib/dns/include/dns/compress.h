@@ -43,11 +43,12 @@
  * been written. So in fact all we need is a hash set of compression offsets.
  *
  * Typical messages do not contain more than a few dozen names, so by
- * default our hash set is small (64 entries, 256 bytes). It can be
- * enlarged when a message is likely to contain a lot of names, such as for
- * outgoing zone transfers (which are handled in lib/ns/xfrout.c) and
- * update requests (for which nsupdate uses DNS_REQUESTOPT_LARGE - see
- * request.h).
+ * default our hash set is small (64 entries, 256 bytes). When it fills up,
+ * as it can in large DNSSEC responses and referrals, it is replaced by a
+ * large set. The large set can be used from the start when a message is
+ * likely to contain a lot of names, such as for outgoing zone transfers
+ * (which are handled in lib/ns/xfrout.c) and update requests (for which
+ * nsupdate uses DNS_REQUESTOPT_LARGE - see request.h).
  */
 
 /*
@@ -121,7 +122,8 @@ dns_compress_init(dns_compress_t *cctx, isc_mem_t *mctx,
  *	(See also dns_request_create()'s options argument)
  *
  *	Requires:
- *\li		'cctx' is a dns_compress_t structure on the stack.
+ *\li		'cctx' is a dns_compress_t structure on the stack, or
+ *		in an object that does not outlive 'mctx'.
  *\li		'mctx' is an initialized memory context.
  *	Ensures:
  *\li		'cctx' is initialized.
@@ -139,6 +141,22 @@ dns_compress_invalidate(dns_compress_t *cctx);
  *\li		'cctx' is an initialized dns_compress_t
  */
 
+void
+dns_compress_reset(dns_compress_t *cctx);
+/*%<
+ *	Empty the compression table so that the context can be used for
+ *	another message, keeping its flags and the memory allocated for
+ *	it.  This is cheaper than invalidating and initializing the
+ *	context for each message when many messages are rendered, as in
+ *	an outgoing zone transfer.
+ *
+ *	Requires:
+ *\li		'cctx' is an initialized dns_compress_t
+ *
+ *	Ensures:
+ *\li		'dns_compress_getpermitted(cctx)' is true
+ */
+
 void
 dns_compress_setpermitted(dns_compress_t *cctx, bool permitted);
 
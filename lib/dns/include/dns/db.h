@@ -112,6 +112,12 @@ typedef struct dns_dbmethods {
 				     dns_rdatatype_t covers, isc_stdtime_t now,
 				     dns_rdataset_t		*rdataset,
 				     dns_rdataset_t *sigrdataset DNS__DB_FLARG);
+	void (*findrdatasets)(dns_db_t *db, dns_dbnode_t *node,
+			      dns_dbversion_t *version, unsigned int count,
+			      const dns_rdatatype_t *types, isc_stdtime_t now,
+			      dns_rdataset_t **rdatasets,
+			      dns_rdataset_t **sigrdatasets,
+			      isc_result_t *results DNS__DB_FLARG);
 	isc_result_t (*allrdatasets)(
 		dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 		unsigned int options, isc_stdtime_t now,
@@ -182,6 +188,8 @@ typedef struct dns_dbmethods {
 				     dns_name_t *name);
 	void (*setmaxrrperset)(dns_db_t *db, uint32_t value);
 	void (*setmaxtypepername)(dns_db_t *db, uint32_t value);
+	void (*setshareslabs)(dns_db_t *db, bool value);
+	uint64_t (*getsharedsize)(dns_db_t *db);
 } dns_dbmethods_t;
 
 typedef isc_result_t (*dns_dbcreatefunc_t)(isc_mem_t	    *mctx,
@@ -1170,6 +1178,63 @@ dns__db_findrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
  *	implementation used.
  */
 
+/*%
+ * The most types dns_db_findrdatasets() looks up at once.
+ */
+#define DNS_DB_MAXFINDTYPES 4
+
+#define dns_db_findrdatasets(db, node, version, count, types, now,          \
+			     rdatasets, sigrdatasets, results)              \
+	dns__db_findrdatasets(db, node, version, count, types, now,         \
+			      rdatasets, sigrdatasets, results DNS__DB_FILELINE)
+void
+dns__db_findrdatasets(dns_db_t *db, dns_dbnode_t *node,
+		      dns_dbversion_t *version, unsigned int count,
+		      const dns_rdatatype_t *types, isc_stdtime_t now,
+		      dns_rdataset_t **rdatasets, dns_rdataset_t **sigrdatasets,
+		      isc_result_t *results DNS__DB_FLARG);
+/*%<
+ * Search for the rdatasets of each of the 'count' types in 'types' at
+ * 'node' in version 'version' of 'db', as dns_db_findrdataset() would
+ * with a 'covers' of zero, and store the result of each search in the
+ * matching element of 'results'.
+ *
+ * Notes:
+ *
+ * \li	This is meant for additional section processing, which wants
+ *	the addresses of a name of every family: databases that
+ *	implement it look at the node only once, under a single lock,
+ *	instead of once per type.  Other databases fall back to calling
+ *	dns_db_findrdataset() for each type.
+ *
+ * \li	The notes for dns_db_findrdataset() apply.
+ *
+ * Requires:
+ *
+ * \li	'db' is a valid database.
+ *
+ * \li	'node' is a valid node.
+ *
+ * \li	0 < 'count' <= #DNS_DB_MAXFINDTYPES.
+ *
+ * \li	'types' contains 'count' types, none of them RRSIG or a meta-RR
+ *	type such as 'ANY' or 'OPT'.
+ *
+ * \li	'rdatasets' contains 'count' valid, disassociated rdatasets.
+ *
+ * \li	'sigrdatasets' is NULL, or contains 'count' elements that are
+ *	each NULL or a valid, disassociated rdataset.
+ *
+ * \li	'results' has room for 'count' results.
+ *
+ * Ensures:
+ *
+ * \li	Each element of 'results' is what dns_db_findrdataset() would
+ *	have returned for the matching type, and the matching elements
+ *	of 'rdatasets' and 'sigrdatasets' are associated as it would
+ *	have associated them.
+ */
+
 #define dns_db_allrdatasets(db, node, version, options, now, iteratorp) \
 	dns__db_allrdatasets(db, node, version, options, now,           \
 			     iteratorp DNS__DB_FILELINE)
@@ -1639,6 +1704,16 @@ dns_db_setcachestats(dns_db_t *db, isc_stats_t *stats);
  *	dns_rdatasetstats_create(); otherwise NULL.
  */
 
+uint64_t
+dns_db_generation(void);
+/*%<
+ * Return a counter which is changed whenever the contents of any zone
+ * database may have changed: when a new version is committed, when
+ * loading ends, and when a zone database is destroyed.  It allows the
+ * callers to invalidate data derived from the zone contents without
+ * registering an update listener on each database.
+ */
+
 void
 dns_db_updatenotify_register(dns_db_t *db, dns_dbupdate_callback_t fn,
 			     void *fn_arg);
@@ -1818,3 +1893,18 @@ dns_db_setmaxtypepername(dns_db_t *db, uint32_t value);
  * stored at a given node, then any subsequent attempt to add an rdataset
  * with a new RR type will return ISC_R_TOOMANYRECORDS.
  */
+
+void
+dns_db_setshareslabs(dns_db_t *db, bool value);
+/*%<
+ * If 'value' is true, the identical rdatasets subsequently loaded into
+ * the zone database 'db' share a single copy of their rdata.  This is a
+ * no-op for the databases that don't support it.
+ */
+
+uint64_t
+dns_db_getsharedsize(dns_db_t *db);
+/*%<
+ * Return the number of bytes of rdata saved by sharing the identical
+ * rdatasets of 'db', or 0 if the database doesn't share them.
+ */
@@ -135,6 +135,48 @@ dns_dispatchmgr_getblackhole(dns_dispatchmgr_t *mgr);
  *\li	A pointer to the current blackhole list, or NULL.
  */
 
+void
+dns_dispatchmgr_settcppool(dns_dispatchmgr_t *mgr, unsigned int idle,
+			   unsigned int pipeline, unsigned int conns);
+/*%<
+ * Configure pooling of shared outgoing TCP and TLS connections.
+ *
+ * A shared TCP dispatch whose last query has finished is kept open for
+ * 'idle' milliseconds so that dns_dispatch_gettcp() can reuse it; zero
+ * closes it immediately, as before.  dns_dispatch_gettcp() doesn't
+ * return a connection that already has 'pipeline' queries in flight
+ * unless there are 'conns' connections to the server already, in which
+ * case the least loaded one is returned.  Zero means no limit.
+ *
+ * Requires:
+ *\li	mgr is a valid dispatchmgr
+ */
+
+bool
+dns_dispatchmgr_tcppool(dns_dispatchmgr_t *mgr);
+/*%<
+ * Return true if idle TCP connections are kept open for reuse.
+ *
+ * Requires:
+ *\li	mgr is a valid dispatchmgr
+ */
+
+void
+dns_dispatchmgr_setudpreuse(dns_dispatchmgr_t *mgr, bool reuse);
+/*%<
+ * Configure the reuse of connected UDP sockets.
+ *
+ * If 'reuse' is true, the socket of a UDP query that got its response
+ * is kept for a short time, and the next query to the same server is
+ * sent over it instead of a new socket.  This saves the creation of
+ * the socket, but the queries then share their source port, so an
+ * off-path attacker has only the query ID to guess (see RFC 5452).
+ * The default is false: each query gets a new random source port.
+ *
+ * Requires:
+ *\li	mgr is a valid dispatchmgr
+ */
+
 isc_result_t
 dns_dispatchmgr_setavailports(dns_dispatchmgr_t *mgr, isc_portset_t *v4portset,
 			      isc_portset_t *v6portset);
@@ -274,6 +316,9 @@ dns_dispatch_gettcp(dns_dispatchmgr_t *mgr, const isc_sockaddr_t *destaddr,
  * for a match.  However, if transport is NULL, then the matching dispatch
  * must also have been created with a NULL transport.
  *
+ * The least loaded matching connection is returned, subject to the
+ * limits set with dns_dispatchmgr_settcppool().
+ *
  * Requires:
  *\li	mgr to be valid dispatch manager.
  *
@@ -30,7 +30,10 @@
 
 /*
  * dlz_dlopen_version() is required for all DLZ external drivers. It
- * should return DLZ_DLOPEN_VERSION
+ * should return DLZ_DLOPEN_VERSION.  It may set DNS_SDLZFLAG_THREADSAFE
+ * in '*flags' if the driver can be called from several threads at once,
+ * and DNS_SDLZFLAG_CACHE if its answers depend only on the name looked
+ * up, so that they can be cached for their TTL.
  */
 typedef int
 dlz_dlopen_version_t(unsigned int *flags);
@@ -93,6 +93,31 @@ dns_dns64_destroy(dns_dns64_t **dns64p);
  * Requires the record to not be linked.
  */
 
+isc_result_t
+dns_dns64_clientok(const dns_dns64_t *dns64, const isc_netaddr_t *reqaddr,
+		   const dns_name_t *reqsigner, dns_aclenv_t *env,
+		   unsigned int flags);
+/*
+ * dns_dns64_clientok() determines whether 'dns64' may be used to answer
+ * the request from 'reqaddr' and 'reqsigner' with 'flags', that is, does
+ * the checks of dns_dns64_aaaafroma() that don't depend on the A record.
+ * A caller that synthesises several addresses for the same request can
+ * check this once, and then pass a NULL 'reqaddr' to
+ * dns_dns64_aaaafroma().
+ *
+ * If 'reqaddr' is NULL the 'client' acl is ignored.
+ *
+ * Requires:
+ *	'dns64'		to be valid.
+ *	'reqaddr'	to be NULL or valid
+ *	'reqsigner'	to be NULL or valid.
+ *	'env'		to be valid.
+ *
+ * Returns:
+ *	ISC_R_SUCCESS		if 'dns64' may be used.
+ *	DNS_R_DISALLOWED	if it may not.
+ */
+
 isc_result_t
 dns_dns64_aaaafroma(const dns_dns64_t *dns64, const isc_netaddr_t *reqaddr,
 		    const dns_name_t *reqsigner, dns_aclenv_t *env,
@@ -213,6 +213,18 @@ dns_dt_setversion(dns_dtenv_t *env, const char *version);
  *\li	'env' is a valid dnstap environment.
  */
 
+void
+dns_dt_setsample(dns_dtenv_t *env, uint32_t rate);
+/*%<
+ * Only send one in 'rate' messages; 0 or 1 sends all the messages.  The
+ * messages are chosen by their ID, so a query and its response are both
+ * sent or both skipped.
+ *
+ * Requires:
+ *
+ *\li	'env' is a valid dnstap environment.
+ */
+
 void
 dns_dt_attach(dns_dtenv_t *source, dns_dtenv_t **destp);
 /*%<
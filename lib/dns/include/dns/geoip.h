@@ -102,5 +102,17 @@ bool
 dns_geoip_match(const isc_netaddr_t	    *reqaddr,
 		const dns_geoip_databases_t *geoip,
 		const dns_geoip_elem_t	    *elt);
+/*%<
+ * Check whether 'reqaddr' matches the GeoIP element 'elt' in the
+ * databases 'geoip'.  The results of the database lookups are cached
+ * for each thread.
+ */
+
+void
+dns_geoip_flush(void);
+/*%<
+ * Forget the cached results of the database lookups; this must be
+ * called when the databases are closed.
+ */
 
 #endif /* HAVE_GEOIP2 */
@@ -30,6 +30,7 @@
 #include <stdbool.h>
 
 #include <isc/magic.h>
+#include <isc/refcount.h>
 
 #include <dns/diff.h>
 #include <dns/name.h>
@@ -44,16 +45,24 @@
 #define DNS_JOURNAL_READ   0x00000000 /* false */
 #define DNS_JOURNAL_CREATE 0x00000001 /* true */
 #define DNS_JOURNAL_WRITE  0x00000002
+#define DNS_JOURNAL_NOSYNC 0x00000004
+#define DNS_JOURNAL_RAW	   0x00000008
 
 #define DNS_JOURNAL_SIZE_MAX INT32_MAX
 #define DNS_JOURNAL_SIZE_MIN 4096
 
 /*% Print transaction header data */
 #define DNS_JOURNAL_PRINTXHDR 0x0001
+/*% Start printing at the given serial, not the first one */
+#define DNS_JOURNAL_PRINTBEGIN 0x0002
+/*% Stop printing at the given serial, not the last one */
+#define DNS_JOURNAL_PRINTEND 0x0004
 
 /*% Rewrite whole journal file instead of compacting */
-#define DNS_JOURNAL_COMPACTALL 0x0001
-#define DNS_JOURNAL_VERSION1   0x0002
+#define DNS_JOURNAL_COMPACTALL	 0x0001
+#define DNS_JOURNAL_VERSION1	 0x0002
+/*% Leave the compacted journal for dns_journal_compact_finish() */
+#define DNS_JOURNAL_COMPACTDEFER 0x0004
 
 /***
  *** Types
@@ -70,6 +79,14 @@
  */
 typedef struct dns_journal dns_journal_t;
 
+/*%
+ * A dns_journalindex_t (see dns/types.h) holds the position of every
+ * transaction of a journal file, so that any of them can be found
+ * without scanning the journal.  It is kept in memory and shared by the
+ * dns_journal_t objects opened for that file over time; the journals add
+ * to it as they commit or read transactions.  This is an opaque type.
+ */
+
 /***
  *** Functions
  ***/
@@ -109,6 +126,20 @@ dns_journal_open(isc_mem_t *mctx, const char *filename, unsigned int mode,
  * the journal if it does not exist.
  * DNS_JOURNAL_WRITE open the journal for reading and writing.
  * DNS_JOURNAL_READ open the journal for reading only.
+ *
+ * DNS_JOURNAL_NOSYNC may be added to a writable mode: committed
+ * transactions are then handed to the operating system but not synced
+ * to stable storage, and the caller is responsible for calling
+ * dns_journal_sync() before relying on them being durable.  Until then
+ * the journal header on disk doesn't include them, and the journals
+ * opened for the file by this process read the header kept in memory.
+ *
+ * DNS_JOURNAL_RAW may be added to DNS_JOURNAL_READ: the rdata returned
+ * by dns_journal_current_rr() then points to the RR data as stored in
+ * the journal, without being checked by dns_rdata_fromwire(); only the
+ * framing of the RRs and their owner names are checked.  This is meant
+ * for copying the RRs to the wire as is, e.g. with
+ * dns_message_renderrr().
  */
 
 void
@@ -117,6 +148,64 @@ dns_journal_destroy(dns_journal_t **journalp);
  * Destroy a dns_journal_t, closing any open files and freeing its memory.
  */
 
+void
+dns_journalindex_create(isc_mem_t *mctx, dns_journalindex_t **ixp);
+/*%<
+ * Create an empty journal index.
+ *
+ * Requires:
+ *\li	'ixp' is not NULL and '*ixp' is NULL.
+ */
+
+void
+dns_journalindex_reset(dns_journalindex_t *ix);
+/*%<
+ * Empty the index 'ix', for instance because the journal file it
+ * describes was removed or rewritten.  Entries that no longer match
+ * the file are also detected and dropped when the index is used.
+ */
+
+#if DNS_JOURNALINDEX_TRACE
+#define dns_journalindex_ref(ptr) \
+	dns_journalindex__ref(ptr, __func__, __FILE__, __LINE__)
+#define dns_journalindex_unref(ptr) \
+	dns_journalindex__unref(ptr, __func__, __FILE__, __LINE__)
+#define dns_journalindex_attach(ptr, ptrp) \
+	dns_journalindex__attach(ptr, ptrp, __func__, __FILE__, __LINE__)
+#define dns_journalindex_detach(ptrp) \
+	dns_journalindex__detach(ptrp, __func__, __FILE__, __LINE__)
+ISC_REFCOUNT_TRACE_DECL(dns_journalindex);
+#else
+ISC_REFCOUNT_DECL(dns_journalindex);
+#endif
+
+void
+dns_journal_setindex(dns_journal_t *j, dns_journalindex_t *ix);
+/*%<
+ * Use the index 'ix' to find transactions in the journal 'j', and
+ * record the transactions committed to 'j' in it.  'ix' must only ever
+ * be used with the journal file 'j' was opened for.
+ *
+ * Requires:
+ *\li	'j' is a valid journal with no index set.
+ *\li	'ix' is a valid journal index.
+ */
+
+isc_result_t
+dns_journal_sync(const char *filename);
+/*%<
+ * Sync the journal file 'filename' to stable storage.  This makes the
+ * transactions committed to it by journals opened with
+ * DNS_JOURNAL_NOSYNC durable, even if those have since been destroyed:
+ * their data is synced first, then the header that includes them is
+ * written and synced in turn.
+ *
+ * Returns:
+ *\li	ISC_R_SUCCESS
+ *\li	ISC_R_NOTFOUND		the journal does not exist
+ *\li	ISC_R_UNEXPECTED	the journal could not be synced
+ */
+
 /**************************************************************************/
 /*
  * Writing transactions to journals.
@@ -239,7 +328,8 @@ void
 dns_journal_current_rr(dns_journal_t *j, dns_name_t **name, uint32_t *ttl,
 		       dns_rdata_t **rdata);
 /*%<
- * Get the name, ttl, and rdata of the current journal RR.
+ * Get the name, ttl, and rdata of the current journal RR.  The rdata
+ * has not been parsed if the journal was opened with DNS_JOURNAL_RAW.
  *
  * Requires:
  * \li     The last call to dns_journal_first_rr() or dns_journal_next_rr()
@@ -278,6 +368,23 @@ dns_journal_print(isc_mem_t *mctx, uint32_t flags, const char *filename,
 		  FILE *file);
 /* For debugging not general use */
 
+isc_result_t
+dns_journal_printrange(isc_mem_t *mctx, uint32_t flags, const char *filename,
+		       uint32_t begin, uint32_t end, FILE *file);
+/*%<
+ * Like dns_journal_print(), but only print the transactions from serial
+ * 'begin' if DNS_JOURNAL_PRINTBEGIN is set in 'flags', and up to serial
+ * 'end' if DNS_JOURNAL_PRINTEND is set.  The first transaction
+ * to print is found with the journal index, so the transactions before
+ * it are not read.
+ *
+ * Returns:
+ *\li	ISC_R_SUCCESS
+ *\li	DNS_R_NOJOURNAL if there is no journal
+ *\li	ISC_R_NOTFOUND or ISC_R_RANGE if a serial is not in the journal
+ *\li	others
+ */
+
 isc_result_t
 dns_db_diff(isc_mem_t *mctx, dns_db_t *dba, dns_dbversion_t *dbvera,
 	    dns_db_t *dbb, dns_dbversion_t *dbverb,
@@ -314,13 +421,47 @@ dns_journal_compact(isc_mem_t *mctx, char *filename, uint32_t serial,
  * If _COMPACTALL is not in use, and the journal file exists and is
  * non-empty, then 'serial' must exist in the journal.
  *
+ * If 'flags' includes DNS_JOURNAL_COMPACTDEFER, the compacted journal is
+ * written next to the journal but does not replace it yet, so that it
+ * can be written while transactions are still being committed to the
+ * journal.  The caller then stops committing and calls
+ * dns_journal_compact_finish(), or dns_journal_compact_cancel() to
+ * discard it.
+ *
  * Returns:
  *\li	ISC_R_SUCCESS
+ *\li	DNS_R_CONTINUE	the compacted journal waits to be finished
  *\li	ISC_R_RANGE	serial is outside the range existing in the journal
  *
  * Other errors may be returned from file operations.
  */
 
+isc_result_t
+dns_journal_compact_finish(isc_mem_t *mctx, char *filename);
+/*%<
+ * Finish a compaction of the journal 'filename' started with
+ * DNS_JOURNAL_COMPACTDEFER: append the transactions committed to the
+ * journal since then to the compacted journal, and replace the journal
+ * with it.  No transaction may be committed to the journal meanwhile.
+ *
+ * The compacted journal is removed whether or not this succeeds.
+ *
+ * Returns:
+ *\li	ISC_R_SUCCESS
+ *\li	ISC_R_NOTFOUND, ISC_R_RANGE
+ *			the journal was removed or replaced since it
+ *			was compacted
+ *
+ * Other errors may be returned from file operations.
+ */
+
+void
+dns_journal_compact_cancel(const char *filename);
+/*%<
+ * Discard the compacted journal written for 'filename' by
+ * dns_journal_compact() with DNS_JOURNAL_COMPACTDEFER.
+ */
+
 bool
 dns_journal_get_sourceserial(dns_journal_t *j, uint32_t *sourceserial);
 void
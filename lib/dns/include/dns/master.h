@@ -58,6 +58,7 @@
 #define DNS_MASTER_NOTTL     0x00008000 /*%< Don't require ttl. */
 #define DNS_MASTER_CHECKTTL  0x00010000 /*%< Check max-zone-ttl */
 #define DNS_MASTER_CHECKSVCB 0x00020000 /*%< Check SVBC records */
+#define DNS_MASTER_NOTHREADS 0x00040000 /*%< Parse text on one thread */
 
 /*
  * Structures that implement the "raw" format for master dump.
@@ -67,12 +68,36 @@
  */
 #define DNS_RAWFORMAT_VERSION 1
 
+/*
+ * Version 2 of the raw format keeps the RRsets of each owner name in a
+ * group, and the groups are followed by an index so that the file can be
+ * mapped into memory and checked on several threads:
+ *
+ *	group:	 32-bit length of the rest of the group,
+ *		 16-bit owner name length, owner name,
+ *		 16-bit number of RRsets, and for each RRset:
+ *		 16-bit type, 16-bit covers, 32-bit TTL,
+ *		 16-bit number of RRs, and for each RR:
+ *		 16-bit rdata length, rdata
+ *	index:	 48-bit offset of every DNS_RAWFORMAT_INDEXSTEP'th group
+ *	trailer: 48-bit offset of the index, 16-bit class,
+ *		 32-bit number of index entries, 32-bit DNS_RAWFORMAT_MAGIC
+ *
+ * The header is that of version 1.  It is written when the
+ * DNS_MASTERRAW_INDEXED flag is set.
+ */
+#define DNS_RAWFORMAT_INDEXED	 2
+#define DNS_RAWFORMAT_INDEXSTEP	 1024
+#define DNS_RAWFORMAT_TRAILERLEN 16
+#define DNS_RAWFORMAT_MAGIC	 0x52415749 /* "RAWI" */
+
 /*
  * Flags to indicate the status of the data in the raw file header
  */
 #define DNS_MASTERRAW_COMPAT	      0x01
 #define DNS_MASTERRAW_SOURCESERIALSET 0x02
 #define DNS_MASTERRAW_LASTXFRINSET    0x04
+#define DNS_MASTERRAW_INDEXED	      0x08
 
 /* Common header */
 struct dns_masterrawheader {
@@ -151,6 +176,11 @@ dns_master_loadfileasync(const char *master_file, dns_name_t *top,
  * If 'DNS_MASTER_AGETTL' is set and the master file contains one or more
  * $DATE directives, the TTLs of the data will be aged accordingly.
  *
+ * Large text files are parsed on several threads unless
+ * 'DNS_MASTER_NOTHREADS' is set; the rdatasets are still added in file
+ * order, from the calling thread, and 'callbacks->error' and
+ * 'callbacks->warn' may then be called from the parsing threads.
+ *
  * 'callbacks->commit' is assumed to call 'callbacks->error' or
  * 'callbacks->warn' to generate any error messages required.
  *
@@ -239,6 +239,10 @@ typedef enum dns_message_intent {
 #define DNS_MESSAGEPARSE_IGNORETRUNCATION \
 	0x0008 /*%< truncation errors are \
 		* not fatal. */
+#define DNS_MESSAGEPARSE_DEFER      \
+	0x0010 /*%< parse the answer and \
+		* authority sections of \
+		* queries on demand */
 
 /*
  * Control behavior of rendering
@@ -341,6 +345,8 @@ struct dns_message {
 	dns_rcode_t  sig0status;
 	isc_region_t query;
 	isc_region_t saved;
+	unsigned int deferred; /* offset of the unparsed sections in saved */
+	unsigned int deferred_options;
 
 	/*
 	 * Time to be used when fuzzing.
@@ -566,6 +572,12 @@ dns_message_parse(dns_message_t *msg, isc_buffer_t *source,
  * If #DNS_MESSAGEPARSE_IGNORETRUNCATION is set then return as many complete
  * RR's as possible, DNS_R_RECOVERABLE will be returned.
  *
+ * If #DNS_MESSAGEPARSE_DEFER is set and the opcode of the message is QUERY,
+ * the records of the answer and authority sections are only checked to be
+ * well-formed enough to find the additional section, and are parsed by
+ * dns_message_parsedeferred().  Errors in their contents are only reported
+ * then.  The option has no effect with #DNS_MESSAGEPARSE_IGNORETRUNCATION.
+ *
  * OPT and TSIG records are always handled specially, regardless of the
  * 'preserve_order' setting.
  *
@@ -588,6 +600,24 @@ dns_message_parse(dns_message_t *msg, isc_buffer_t *source,
  *\li	Many other errors possible XXXMLG
  */
 
+isc_result_t
+dns_message_parsedeferred(dns_message_t *msg);
+/*%<
+ * Parse the answer and authority sections of 'msg' if their parsing was
+ * deferred by #DNS_MESSAGEPARSE_DEFER; otherwise do nothing.  This must be
+ * called before dns_message_reply(), while the buffer the message was
+ * parsed from is still valid.
+ *
+ * Requires:
+ *\li	"msg" be valid, and parsed by dns_message_parse().
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS		-- all is well
+ *\li	#DNS_R_RECOVERABLE	-- the sections parsed properly, but contained
+ *				   errors.
+ *\li	Any error dns_message_parse() can return for these sections.
+ */
+
 isc_result_t
 dns_message_renderbegin(dns_message_t *msg, dns_compress_t *cctx,
 			isc_buffer_t *buffer);
@@ -701,6 +731,51 @@ dns_message_rendersection(dns_message_t *msg, dns_section_t section,
  *				   are records remaining for this section.
  */
 
+isc_result_t
+dns_message_renderwire(dns_message_t *msg, dns_section_t section,
+		       const isc_region_t *wire, unsigned int count);
+/*%<
+ * Append 'count' records of 'section', already rendered in 'wire', to
+ * the message.  'wire' must have been rendered at the same offset in a
+ * message with the same header and preceding sections, so that the
+ * compression pointers it contains remain valid; the names it contains
+ * are not available to compress the names rendered later.
+ *
+ * Requires:
+ *\li	'msg' be valid.
+ *
+ *\li	'section' be a valid section.
+ *
+ *\li	dns_message_renderbegin() was called.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS		-- the records were written.
+ *\li	#ISC_R_NOSPACE		-- Not enough room in the buffer.
+ */
+
+isc_result_t
+dns_message_renderrr(dns_message_t *msg, dns_section_t section,
+		     const dns_name_t *owner, dns_ttl_t ttl,
+		     const dns_rdata_t *rdata);
+/*%<
+ * Append a single record to 'section' of the message.  The owner name
+ * is compressed; the rdata is copied as is, without being parsed, so
+ * the names it contains are neither compressed nor available to
+ * compress the names rendered later.
+ *
+ * Requires:
+ *\li	'msg' be valid.
+ *
+ *\li	'section' be a valid section other than the question section.
+ *
+ *\li	dns_message_renderbegin() was called.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS		-- the record was written.
+ *\li	#ISC_R_NOSPACE		-- Not enough room in the buffer; nothing
+ *				   was written.
+ */
+
 void
 dns_message_renderheader(dns_message_t *msg, isc_buffer_t *target);
 /*%<
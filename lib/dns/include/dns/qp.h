@@ -219,6 +219,11 @@ typedef uint32_t dns_qpcell_t;
  */
 typedef dns_qpshift_t dns_qpkey_t[DNS_QP_MAXKEY];
 
+/*%
+ * The number of searches that `dns_qp_getnames()` runs side by side.
+ */
+#define DNS_QP_BATCH 16
+
 /*%
  * A QP iterator traverses a trie starting with the root and passing
  * though each leaf node in lexicographic order; it is used by
@@ -289,6 +294,32 @@ typedef struct dns_qpmethods {
 	void (*triename)(void *uctx, char *buf, size_t size);
 } dns_qpmethods_t;
 
+/*%
+ * A `dns_qpbuild_t` fills an empty qp-trie with leaves that are added
+ * in key order, see `dns_qpbuild_start()`.
+ */
+typedef struct dns_qpbuild dns_qpbuild_t;
+
+/*%
+ * A `dns_qpimage_t` is a read-only qp-trie that was saved to a file by
+ * `dns_qp_saveimage()` and mapped into memory by `dns_qpimage_open()`.
+ * The file can be shared through the page cache by any number of
+ * processes, and the trie does not need to be rebuilt when it is
+ * loaded.
+ *
+ * Leaf pointer values cannot be saved, so `dns_qp_saveimage()` calls a
+ * `dns_qpsaveleaf_t` function for each leaf to write a payload that
+ * describes it. In the image, the leaf's pointer value is the offset
+ * of its payload in the image's payload section, which can be turned
+ * back into a pointer with `dns_qpimage_payload()`. The leaf methods
+ * of an image trie must expect this.
+ */
+typedef struct dns_qpimage dns_qpimage_t;
+
+typedef isc_result_t
+dns_qpsaveleaf_t(void *arg, void *pval, uint32_t *ivalp,
+		 isc_buffer_t *payload);
+
 /*%
  * Buffers for use by the `triename()` method need to be large enough
  * to hold a zone name and a few descriptive words.
@@ -299,17 +330,21 @@ typedef struct dns_qpmethods {
  * A container for the counters returned by `dns_qp_memusage()`
  */
 typedef struct dns_qp_memusage {
-	void  *uctx;	    /*%< qp-trie method context */
-	size_t leaves;	    /*%< values in the trie */
-	size_t live;	    /*%< nodes in use */
-	size_t used;	    /*%< allocated nodes */
-	size_t hold;	    /*%< nodes retained for readers */
-	size_t free;	    /*%< nodes to be reclaimed */
-	size_t node_size;   /*%< in bytes */
-	size_t chunk_size;  /*%< nodes per chunk */
-	size_t chunk_count; /*%< allocated chunks */
-	size_t bytes;	    /*%< total memory in chunks and metadata */
-	bool   fragmented;  /*%< trie needs compaction */
+	void  *uctx;		   /*%< qp-trie method context */
+	size_t leaves;		   /*%< values in the trie */
+	size_t live;		   /*%< nodes in use */
+	size_t used;		   /*%< allocated nodes */
+	size_t hold;		   /*%< nodes retained for readers */
+	size_t free;		   /*%< nodes to be reclaimed */
+	size_t node_size;	   /*%< in bytes */
+	size_t chunk_size;	   /*%< nodes per chunk */
+	size_t chunk_count;	   /*%< allocated chunks */
+	size_t bytes;		   /*%< total memory in chunks and metadata */
+	bool   fragmented;	   /*%< trie needs compaction */
+	size_t compact_budget;	   /*%< cells per write, 0 = unlimited */
+	bool   compact_unfinished; /*%< budget ran out mid-compaction */
+	size_t region_count;	   /*%< huge page regions */
+	size_t hugepage_bytes;	   /*%< region bytes in huge page spans */
 } dns_qp_memusage_t;
 
 /*%
@@ -447,6 +482,44 @@ dns_qpmulti_memusage(dns_qpmulti_t *multi);
  * \li  a `dns_qp_memusage_t` structure described above
  */
 
+void
+dns_qp_sethugepages(dns_qp_t *qp);
+void
+dns_qpmulti_sethugepages(dns_qpmulti_t *multi);
+/*%<
+ * Once the trie has grown to a few megabytes, allocate its chunks from
+ * larger regions that the kernel is asked to back with transparent huge
+ * pages, so that lookups in a big trie cause fewer TLB misses. Small
+ * tries are not affected. The regions are still allocated from the
+ * trie's memory context.
+ *
+ * The number of regions, and how many of their bytes can be backed by
+ * huge pages, are reported by `dns_qp_memusage()`.
+ *
+ * Requires:
+ * \li  `qp` is a pointer to a valid qp-trie
+ * \li  `multi` is a pointer to a valid dns_qpmulti_t
+ */
+
+void
+dns_qpmulti_setcompactbudget(dns_qpmulti_t *multi, unsigned int cells);
+/*%<
+ * Limit the work done by the garbage collector in each light write
+ * transaction (`dns_qpmulti_write()`) to visiting roughly `cells` trie
+ * nodes. When the budget runs out, compaction stops and carries on in
+ * the next transaction, so a big trie is compacted a piece at a time
+ * instead of in one long pause. Zero (the default) means unlimited.
+ *
+ * Heavy update transactions and explicit calls to `dns_qp_compact()`
+ * are not limited.
+ *
+ * The budget, and whether a compaction is unfinished, are reported by
+ * `dns_qpmulti_memusage()`.
+ *
+ * Requires:
+ * \li  `multi` is a pointer to a valid dns_qpmulti_t
+ */
+
 /***********************************************************************
  *
  *  functions - search, modify
@@ -526,6 +599,29 @@ dns_qp_getname(dns_qpreadable_t qpr, const dns_name_t *name, void **pval_r,
  * \li  ISC_R_SUCCESS if the leaf was found
  */
 
+void
+dns_qp_getnames(dns_qpreadable_t qpr, const dns_name_t *const *names,
+		size_t count, isc_result_t *results, void **pvals,
+		uint32_t *ivals);
+/*%<
+ * Find the leaves in a qp-trie that match each of the `count` DNS names
+ * in the `names` array, like calling `dns_qp_getname()` for each one.
+ *
+ * The searches are done up to `DNS_QP_BATCH` at a time, taking turns to
+ * step one level down the trie, so that the memory accesses for one
+ * name overlap with the work on the others instead of each step
+ * waiting for its twigs to arrive from memory.
+ *
+ * The result for `names[i]` is stored in `results[i]`; the leaf values
+ * are assigned to `pvals[i]` and `ivals[i]` if the arrays are not null,
+ * and left unchanged if the name was not found.
+ *
+ * Requires:
+ * \li  `qpr` is a pointer to a readable qp-trie
+ * \li  `names` and `results` point to arrays of `count` elements
+ * \li  `pvals` and `ivals` are NULL or point to arrays of `count` elements
+ */
+
 isc_result_t
 dns_qp_lookup(dns_qpreadable_t qpr, const dns_name_t *name,
 	      dns_name_t *foundname, dns_qpiter_t *iter, dns_qpchain_t *chain,
@@ -585,6 +681,60 @@ dns_qp_insert(dns_qp_t *qp, void *pval, uint32_t ival);
  * \li  ISC_R_SUCCESS if the leaf was added to the trie
  */
 
+void
+dns_qpbuild_start(dns_qp_t *qp, dns_qpbuild_t **buildp);
+/*%<
+ * Start building the contents of an empty qp-trie from leaves in
+ * sorted order, such as the names from a raw-format zone file or a
+ * zone transfer.
+ *
+ * Instead of growing the trie one twig at a time, as dns_qp_insert()
+ * does, the builder keeps the branches along the path to the latest
+ * leaf open and allocates each twig vector once, at its final size,
+ * when the keys have moved past it. The result is as compact as after
+ * `dns_qp_compact(qp, DNS_QPGC_ALL)`, without the garbage.
+ *
+ * The leaves are not visible in the trie until `dns_qpbuild_finish()`
+ * is called, and the trie must not be used until then.
+ *
+ * Requires:
+ * \li  `qp` is a pointer to a valid qp-trie with no leaves
+ * \li  `buildp != NULL && *buildp == NULL`
+ */
+
+isc_result_t
+dns_qpbuild_add(dns_qpbuild_t *build, void *pval, uint32_t ival);
+/*%<
+ * Add a leaf to the trie that is being built. Its key must sort after
+ * the key of the previous leaf.
+ *
+ * A leaf that is rejected because it is out of order can be added with
+ * `dns_qp_insert()` after the build has finished.
+ *
+ * Requires:
+ * \li  `build` is a pointer to a valid qp-trie builder
+ * \li  `pval != NULL`
+ * \li  `alignof(pval) >= 4`
+ *
+ * Returns:
+ * \li  ISC_R_SUCCESS if the leaf was added to the trie
+ * \li  ISC_R_EXISTS if the key is the same as the previous leaf's
+ * \li  ISC_R_RANGE if the key sorts before the previous leaf's
+ */
+
+void
+dns_qpbuild_finish(dns_qpbuild_t **buildp);
+/*%<
+ * Finish building the trie, which then contains all of the leaves
+ * that were added successfully.
+ *
+ * Requires:
+ * \li  `buildp != NULL` and `*buildp` is a valid qp-trie builder
+ *
+ * Ensures:
+ * \li  `*buildp == NULL`
+ */
+
 isc_result_t
 dns_qp_deletekey(dns_qp_t *qp, const dns_qpkey_t key, size_t keylen,
 		 void **pval_r, uint32_t *ival_r);
@@ -891,4 +1041,100 @@ dns_qpmulti_rollback(dns_qpmulti_t *multi, dns_qp_t **qptp);
  * \li  `*qptp == NULL`
  */
 
+/***********************************************************************
+ *
+ *  functions - read-only images
+ */
+
+isc_result_t
+dns_qp_saveimage(dns_qpreadable_t qpr, isc_mem_t *mctx, const char *filename,
+		 dns_qpsaveleaf_t *saveleaf, void *arg);
+/*%<
+ * Save the trie to 'filename' as an image that can be used with
+ * `dns_qpimage_open()`.
+ *
+ * The trie is compacted as it is written, and the twigs are laid out
+ * in depth-first order; 'mctx' is used for the working memory, which
+ * is about as big as the trie. For each leaf, `saveleaf()` is called with
+ * 'arg', the leaf's values, and an empty buffer to which it appends
+ * the leaf's payload; it may change the leaf's integer value.
+ *
+ * The image is written to a temporary file which is renamed when it
+ * is complete, so readers of an older image are not disturbed.
+ *
+ * Requires:
+ * \li  `qpr` is a pointer to a readable qp-trie
+ * \li  `mctx` is a valid memory context
+ * \li  `filename` is not NULL
+ * \li  `saveleaf` is not NULL
+ *
+ * Returns:
+ * \li  ISC_R_SUCCESS on success
+ * \li  ISC_R_RANGE if the payloads are too big for this platform
+ * \li  errors from `saveleaf()` or from writing the file
+ */
+
+isc_result_t
+dns_qpimage_open(isc_mem_t *mctx, const char *filename,
+		 const dns_qpmethods_t *methods, void *uctx,
+		 dns_qpimage_t **imagep);
+/*%<
+ * Map the qp-trie image in 'filename' into memory, read-only.
+ *
+ * The 'methods' are called with 'uctx' like the methods of any other
+ * trie, except that the pointer values of the leaves are payload
+ * offsets (see `dns_qpimage_payload()`). The `attach` and `detach`
+ * methods are never called.
+ *
+ * The contents of an image are trusted; only the header is checked.
+ *
+ * Requires:
+ * \li  `filename` is not NULL
+ * \li  `methods` is not NULL
+ * \li  `imagep != NULL && *imagep == NULL`
+ *
+ * Returns:
+ * \li  ISC_R_SUCCESS on success
+ * \li  DNS_R_FORMERR if the file is not a valid image
+ * \li  ISC_R_NOTIMPLEMENTED if the image was saved by an incompatible
+ *       build (different version, node size, or chunk size)
+ * \li  errors from opening or mapping the file
+ */
+
+void
+dns_qpimage_destroy(dns_qpimage_t **imagep);
+/*%<
+ * Unmap the image and free its memory. There must be no remaining
+ * users of the trie returned by `dns_qpimage_reader()`.
+ *
+ * Requires:
+ * \li  `imagep != NULL && *imagep` is a valid image
+ *
+ * Ensures:
+ * \li  `*imagep == NULL`
+ */
+
+dns_qpreader_t *
+dns_qpimage_reader(dns_qpimage_t *image);
+/*%<
+ * Get the image's trie. It can be used by any thread with the
+ * functions that take a `dns_qpreadable_t`, until the image is
+ * destroyed.
+ *
+ * Requires:
+ * \li  `image` is a valid image
+ */
+
+const void *
+dns_qpimage_payload(dns_qpimage_t *image, void *pval);
+/*%<
+ * Get a pointer to the payload whose offset is the pointer value
+ * `pval` of a leaf of the image's trie. Payloads are aligned to 8
+ * bytes.
+ *
+ * Requires:
+ * \li  `image` is a valid image
+ * \li  `pval` is the pointer value of one of the image's leaves
+ */
+
 /**********************************************************************/
@@ -96,6 +96,12 @@ typedef struct dns_rdatasetmethods {
 	void (*getownercase)(const dns_rdataset_t *rdataset, dns_name_t *name);
 	isc_result_t (*addglue)(dns_rdataset_t	*rdataset,
 				dns_dbversion_t *version, dns_message_t *msg);
+	/*
+	 * Optional: the records in the rdataslab format, a 16-bit count
+	 * followed by each rdata preceded by its 16-bit length, or NULL
+	 * if they aren't stored that way.
+	 */
+	unsigned char *(*getraw)(dns_rdataset_t *rdataset);
 } dns_rdatasetmethods_t;
 
 #define DNS_RDATASET_MAGIC	ISC_MAGIC('D', 'N', 'S', 'R')
@@ -178,11 +184,13 @@ struct dns_rdataset {
 		 * memory immediately following a slabheader. (There
 		 * is an exception in the case of rdatasets returned by
 		 * the `getnoqname` and `getclosest` methods; see
-		 * comments in rbtdb.c for details.)
+		 * comments in rbtdb.c for details.) 'header' is the
+		 * slabheader the rdataset was bound from, if any.
 		 */
 		struct {
 			struct dns_db	       *db;
 			dns_dbnode_t	       *node;
+			struct dns_slabheader  *header;
 			unsigned char	       *raw;
 			unsigned char	       *iter_pos;
 			unsigned int		iter_count;
@@ -250,7 +258,7 @@ struct dns_rdataset {
 #define DNS_RDATASETATTR_CHECKNAMES   0x00008000 /*%< Used by resolver. */
 #define DNS_RDATASETATTR_REQUIRED     0x00010000
 #define DNS_RDATASETATTR_REQUIREDGLUE DNS_RDATASETATTR_REQUIRED
-#define DNS_RDATASETATTR_UNUSED1      0x00020000
+#define DNS_RDATASETATTR_POPULAR      0x00020000 /*%< Worth refreshing. */
 #define DNS_RDATASETATTR_RESIGN	      0x00040000
 #define DNS_RDATASETATTR_CLOSEST      0x00080000
 #define DNS_RDATASETATTR_OPTOUT	      0x00100000 /*%< OPTOUT proof */
@@ -65,6 +65,13 @@ struct dns_slabheader_proof {
 };
 
 struct dns_slabheader {
+	/*
+	 * The fields up to and including 'raw' are the ones that the
+	 * database lookups and binding an rdataset touch; they are kept
+	 * in the first cache line of the header (see rdataslab.c).  The
+	 * fields after them are only used by one kind of database, or
+	 * only when the header is added, expired or re-signed.
+	 */
 	_Atomic(uint16_t) attributes;
 
 	/*%
@@ -82,23 +89,18 @@ struct dns_slabheader {
 	 * when the "cyclic" rrset-order is required.
 	 */
 
-	unsigned int  resign_lsb : 1;
-	isc_stdtime_t resign;
-	unsigned int  heap_index;
+	_Atomic(uint16_t) hits;
 	/*%<
-	 * Used for TTL-based cache cleaning.
+	 * Number of times this rdataset has been bound, used to detect
+	 * popular RRsets that are worth refreshing before they expire.
 	 */
 
-	isc_stdtime_t	  last_used;
-	_Atomic(uint32_t) last_refresh_fail_ts;
+	isc_stdtime_t last_used;
 
-	dns_slabheader_proof_t *noqname;
-	dns_slabheader_proof_t *closest;
-	/*%<
+	/*%
 	 * We don't use the LIST macros, because the LIST structure has
 	 * both head and tail pointers, and is doubly linked.
 	 */
-
 	struct dns_slabheader *next;
 	/*%<
 	 * If this is the top header for an rdataset, 'next' points
@@ -120,7 +122,33 @@ struct dns_slabheader {
 	 * this rdataset, if any.
 	 */
 
-	ISC_LINK(struct dns_slabheader) link;
+	unsigned char *raw;
+	/*%<
+	 * If not NULL, the rdata of this header is not stored after it
+	 * but in a slab shared by the identical rdatasets of a zone
+	 * database, and the header is allocated on its own.
+	 */
+
+	unsigned int  resign_lsb : 1;
+	isc_stdtime_t resign;
+	unsigned int  heap_index;
+	/*%<
+	 * Used for TTL-based cache cleaning.
+	 */
+
+	_Atomic(uint32_t) last_refresh_fail_ts;
+
+	isc_heap_t *heap;
+
+	union {
+		ISC_LINK(struct dns_slabheader) link;
+		struct rcu_head rcu_head;
+	};
+	/*%<
+	 * 'link' is used for the LRU list of a cache; once the header has
+	 * been unlinked for good, the space is reused to defer freeing it
+	 * until the concurrent lock-free readers are done with it.
+	 */
 
 	/*%
 	 * Case vector.  If the bit is set then the corresponding
@@ -129,7 +157,8 @@ struct dns_slabheader {
 	 */
 	unsigned char upper[32];
 
-	isc_heap_t *heap;
+	dns_slabheader_proof_t *noqname;
+	dns_slabheader_proof_t *closest;
 
 	dns_gluelist_t *gluelist;
 };
@@ -149,6 +178,7 @@ enum {
 	DNS_SLABHEADERATTR_CASEFULLYLOWER = 1 << 11,
 	DNS_SLABHEADERATTR_ANCIENT = 1 << 12,
 	DNS_SLABHEADERATTR_STALE_WINDOW = 1 << 13,
+	DNS_SLABHEADERATTR_VISITED = 1 << 14,
 };
 
 #define DNS_SLABHEADER_GETATTR(header, attribute) \
@@ -278,7 +308,8 @@ dns_slabheader_fromrdataset(const dns_rdataset_t *rdataset);
 void *
 dns_slabheader_raw(dns_slabheader_t *header);
 /*%
- * Returns the address of the raw memory following a dns_slabheader.
+ * Returns the address of the raw memory following a dns_slabheader, or
+ * of the shared slab it refers to.
  */
 
 void
@@ -204,6 +204,27 @@ dns_remote_mark(dns_remote_t *remote, bool good);
  *		The current address index is lower than the address count.
  */
 
+void
+dns_remote_markaddr(dns_remote_t *remote, unsigned int i, bool good);
+/*%<
+ *	Mark the address at index 'i' 'good' (or not good if 'good' is
+ *	'false'), without making it the current address.
+ *
+ *	Requires:
+ *		'remote' is a valid remote structure.
+ *		'i' is lower than the address count.
+ */
+
+void
+dns_remote_select(dns_remote_t *remote, unsigned int i);
+/*%<
+ *	Make the address at index 'i' the current address.
+ *
+ *	Requires:
+ *		'remote' is a valid remote structure.
+ *		'i' is lower than the address count.
+ */
+
 bool
 dns_remote_done(dns_remote_t *remote);
 /*%<
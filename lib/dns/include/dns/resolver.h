@@ -488,6 +488,48 @@ dns_resolver_getzeronosoattl(dns_resolver_t *resolver);
 void
 dns_resolver_setzeronosoattl(dns_resolver_t *resolver, bool state);
 
+void
+dns_resolver_sethedging(dns_resolver_t *resolver, bool state);
+/*%<
+ * Enable or disable hedged queries: when a UDP query has not been
+ * answered within twice the server's smoothed RTT, a second query is
+ * sent to the next best server address, and whichever server answers
+ * first wins.
+ *
+ * Requires:
+ * \li	resolver to be valid.
+ */
+
+void
+dns_resolver_setrefresh(dns_resolver_t *resolver, unsigned int limit,
+			unsigned int rate);
+/*%<
+ * Set the maximum number of popular RRsets that can be scheduled for a
+ * refresh at the same time to 'limit', and the number of refresh fetches
+ * started per second to 'rate'.  A 'limit' of zero disables the refresh
+ * of popular RRsets.
+ *
+ * Requires:
+ * \li	resolver to be valid and not frozen.
+ */
+
+void
+dns_resolver_refresh(dns_resolver_t *resolver, const dns_name_t *name,
+		     dns_rdatatype_t type, dns_ttl_t ttl);
+/*%<
+ * Schedule a refresh of the popular RRset 'name'/'type', which expires
+ * from the cache in 'ttl' seconds.  Shortly before it expires, a
+ * prefetch is started for it, paced by the refresh rate.  Nothing is
+ * done if refreshing is disabled, the RRset expires too soon to be
+ * worth it, or too many refreshes are already scheduled.
+ *
+ * This can be called from any loop.
+ *
+ * Requires:
+ * \li	resolver to be valid and frozen.
+ * \li	'name' to be a valid name.
+ */
+
 unsigned int
 dns_resolver_getoptions(dns_resolver_t *resolver);
 /*%<
@@ -599,6 +641,17 @@ dns_resolver_incstats(dns_resolver_t *res, isc_statscounter_t counter);
  * \li	'res' is valid.
  */
 
+void
+dns_resolver_addstats(dns_resolver_t *res, isc_statscounter_t counter,
+		      uint64_t value);
+/*%<
+ * Add 'value' to the specified statistics counter in res->stats, if
+ * res->stats is set.
+ *
+ * Requires:
+ * \li	'res' is valid.
+ */
+
 void
 dns_resolver_setquerystats(dns_resolver_t *res, dns_stats_t *stats);
 /*%<
@@ -161,6 +161,14 @@ struct dns_rpz_zone {
 					 * on */
 	bool	     addsoa;		/* add soa to the additional section */
 	isc_timer_t *updatetimer;
+	char	    *journal;		/* journal of the zone, if any */
+	bool	     newdb;		/* 'db' was replaced since the last
+					 * update */
+	bool	     updfull;		/* the running update walks the
+					 * whole database */
+	bool	     haveserial;	/* 'serial' is valid */
+	uint32_t     serial;		/* serial of the last version put
+					 * into the summary */
 };
 
 /*
@@ -389,6 +397,15 @@ dns_rpz_dbupdate_unregister(dns_db_t *db, dns_rpz_zone_t *rpz);
 void
 dns_rpz_dbupdate_register(dns_db_t *db, dns_rpz_zone_t *rpz);
 
+void
+dns_rpz_setjournal(dns_rpz_zone_t *rpz, const char *journal);
+/*%<
+ * Set the journal of the policy zone 'rpz', or clear it if 'journal'
+ * is NULL.  When the journal holds the changes between the version in
+ * the summary data and a new version, only the names it mentions are
+ * checked instead of the whole database.
+ */
+
 void
 dns_rpz_zones_shutdown(dns_rpz_zones_t *rpzs);
 
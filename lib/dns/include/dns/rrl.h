@@ -20,6 +20,8 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+#include <isc/atomic.h>
+
 #include <dns/fixedname.h>
 #include <dns/rdata.h>
 #include <dns/types.h>
@@ -97,10 +99,8 @@ union dns_rrl_key {
  * This should be small to limit the total size of the table of entries.
  */
 typedef struct dns_rrl_entry dns_rrl_entry_t;
-typedef ISC_LIST(dns_rrl_entry_t) dns_rrl_bin_t;
 struct dns_rrl_entry {
 	ISC_LINK(dns_rrl_entry_t) lru;
-	ISC_LINK(dns_rrl_entry_t) hlink;
 	dns_rrl_key_t key;
 #define DNS_RRL_RESPONSE_BITS 24
 	signed int responses : DNS_RRL_RESPONSE_BITS;
@@ -112,6 +112,7 @@ struct dns_rrl_entry {
 	unsigned int ts_valid : 1;
 #define DNS_RRL_HASH_GEN_BITS 1
 	unsigned int hash_gen : DNS_RRL_HASH_GEN_BITS;
+	unsigned int hashed : 1;
 	unsigned int logged : 1;
 #define DNS_RRL_LOG_BITS 11
 	unsigned int log_secs : DNS_RRL_LOG_BITS;
@@ -151,12 +152,27 @@ struct dns_rrl_entry {
 #endif /* if DNS_RRL_STOP_LOG_SECS >= (1 << DNS_RRL_LOG_BITS) */
 
 /*
- * A hash table of rate-limit entries.
+ * A slot of a hash table of rate-limit entries.  The hash value of the
+ * key is kept next to the entry, so that most mismatches are rejected
+ * without reading the entry.
+ */
+typedef struct dns_rrl_bin {
+	uint32_t	 hval;
+	dns_rrl_entry_t *e;
+} dns_rrl_bin_t;
+
+/*
+ * An open addressing hash table of rate-limit entries, using linear
+ * probing and Robin Hood insertion to bound the length of the searches.
+ * 'next' is the next slot to move to the new table while this is the
+ * old table of a shard.
  */
 struct dns_rrl_hash {
 	isc_stdtime_t check_time;
 	unsigned int  gen : DNS_RRL_HASH_GEN_BITS;
 	int	      length;
+	int	      count;
+	int	      next;
 	dns_rrl_bin_t bins[1];
 };
 
@@ -183,18 +199,53 @@ struct dns_rrl_qname_buf {
 
 typedef struct dns_rrl_rate dns_rrl_rate_t;
 struct dns_rrl_rate {
-	int	    r;
-	int	    scaled;
-	const char *str;
+	int		    r;
+	atomic_int_fast32_t scaled;
+	const char	   *str;
+};
+
+typedef struct dns_rrl dns_rrl_t;
+
+/*
+ * A shard of the database of a view.  The entries of a client address
+ * block are all in the same shard, so the limits of each block are
+ * applied exactly as with a single table.
+ */
+typedef struct dns_rrl_shard dns_rrl_shard_t;
+struct dns_rrl_shard {
+	isc_mutex_t lock;
+	dns_rrl_t  *rrl;
+
+	int num_entries;
+
+	unsigned int probes;
+	unsigned int searches;
+
+	ISC_LIST(dns_rrl_block_t) blocks;
+	ISC_LIST(dns_rrl_entry_t) lru;
+
+	dns_rrl_hash_t *hash;
+	dns_rrl_hash_t *old_hash;
+	unsigned int	hash_gen;
+
+	unsigned int ts_gen;
+#define DNS_RRL_TS_BASES (1 << DNS_RRL_TS_GEN_BITS)
+	isc_stdtime_t ts_bases[DNS_RRL_TS_BASES];
+
+	isc_stdtime_t	 log_stops_time;
+	dns_rrl_entry_t *last_logged;
+	int		 num_logged;
+	int		 num_qnames;
+	ISC_LIST(dns_rrl_qname_buf_t) qname_free;
+#define DNS_RRL_QNAMES (1 << DNS_RRL_QNAMES_BITS)
+	dns_rrl_qname_buf_t *qnames[DNS_RRL_QNAMES];
 };
 
 /*
  * Per-view query rate limit parameters and a pointer to database.
  */
-typedef struct dns_rrl dns_rrl_t;
 struct dns_rrl {
-	isc_mutex_t lock;
-	isc_mem_t  *mctx;
+	isc_mem_t *mctx;
 
 	bool	       log_only;
 	dns_rrl_rate_t responses_per_second;
@@ -210,38 +261,18 @@ struct dns_rrl {
 
 	dns_acl_t *exempt;
 
-	int num_entries;
-
+	isc_mutex_t   qps_lock; /* covers the qps_* fields */
 	int	      qps_responses;
 	isc_stdtime_t qps_time;
 	double	      qps;
 
-	unsigned int probes;
-	unsigned int searches;
-
-	ISC_LIST(dns_rrl_block_t) blocks;
-	ISC_LIST(dns_rrl_entry_t) lru;
-
-	dns_rrl_hash_t *hash;
-	dns_rrl_hash_t *old_hash;
-	unsigned int	hash_gen;
-
-	unsigned int ts_gen;
-#define DNS_RRL_TS_BASES (1 << DNS_RRL_TS_GEN_BITS)
-	isc_stdtime_t ts_bases[DNS_RRL_TS_BASES];
-
 	int	 ipv4_prefixlen;
 	uint32_t ipv4_mask;
 	int	 ipv6_prefixlen;
 	uint32_t ipv6_mask[4];
 
-	isc_stdtime_t	 log_stops_time;
-	dns_rrl_entry_t *last_logged;
-	int		 num_logged;
-	int		 num_qnames;
-	ISC_LIST(dns_rrl_qname_buf_t) qname_free;
-#define DNS_RRL_QNAMES (1 << DNS_RRL_QNAMES_BITS)
-	dns_rrl_qname_buf_t *qnames[DNS_RRL_QNAMES];
+	unsigned int	 nshards;
+	dns_rrl_shard_t *shards;
 };
 
 typedef enum {
@@ -260,4 +291,10 @@ void
 dns_rrl_view_destroy(dns_view_t *view);
 
 isc_result_t
-dns_rrl_init(dns_rrl_t **rrlp, dns_view_t *view, int min_entries);
+dns_rrl_init(dns_rrl_t **rrlp, dns_view_t *view, int min_entries,
+	     unsigned int nshards);
+/*%<
+ * Create the rate limiting database of 'view', split into 'nshards'
+ * shards, each with its own lock.  'min_entries' and the maximum number
+ * of entries set afterwards are split evenly between the shards.
+ */
@@ -59,6 +59,13 @@
 #define DNS_SDLZFLAG_THREADSAFE	   0x00000001U
 #define DNS_SDLZFLAG_RELATIVEOWNER 0x00000002U
 #define DNS_SDLZFLAG_RELATIVERDATA 0x00000004U
+/*
+ * The answers of the driver depend only on the name looked up, not on
+ * the client, so they can be cached for their TTL.  The cached answers
+ * of a database are dropped when an update to it is committed.  See
+ * also the cacheable method.
+ */
+#define DNS_SDLZFLAG_CACHE 0x00000008U
 
 /* A simple DLZ database. */
 typedef struct dns_sdlz_db dns_sdlz_db_t;
@@ -270,6 +277,14 @@ typedef isc_result_t (*dns_sdlzdelrdataset_t)(const char *name,
  * the specified name.
  */
 
+typedef bool (*dns_sdlzcacheable_t)(void *driverarg, void *dbdata);
+/*%<
+ * Method prototype.  Drivers registered with DNS_SDLZFLAG_CACHE may
+ * supply a cacheable method, which returns true if the answers of the
+ * database 'dbdata' can be cached.  Without it, the answers of all the
+ * databases of the driver are cached.
+ */
+
 typedef struct dns_sdlzmethods {
 	dns_sdlzcreate_t	create;
 	dns_sdlzdestroy_t	destroy;
@@ -285,6 +300,7 @@ typedef struct dns_sdlzmethods {
 	dns_sdlzmodrdataset_t	addrdataset;
 	dns_sdlzmodrdataset_t	subtractrdataset;
 	dns_sdlzdelrdataset_t	delrdataset;
+	dns_sdlzcacheable_t	cacheable;
 } dns_sdlzmethods_t;
 
 isc_result_t
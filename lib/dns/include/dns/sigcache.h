@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*****
+***** Module Info
+*****/
+
+/*! \file dns/sigcache.h
+ * \brief
+ * Defines dns_sigcache_t, the "signature verification cache" object.
+ *
+ * Notes:
+ *\li	A signature verification cache remembers RRSIGs that have been
+ *	successfully verified, so that the validator can skip the
+ *	public key operation when the same RRset, signature and key
+ *	are seen again, e.g. when the RRset is re-fetched after its
+ *	TTL expired.
+ *
+ *\li	Entries are keyed by a SHA-256 digest of the owner name, the
+ *	canonically ordered RRset, the complete RRSIG rdata and the
+ *	DNSKEY, so a hit can only happen for exactly the same inputs.
+ *	The cache has a fixed number of slots and a new entry simply
+ *	replaces whatever was in its slot.
+ *
+ * Security:
+ *\li	A hit is only reported while the current time is within the
+ *	validity window of the cached signature.
+ */
+
+/***
+ ***	Imports
+ ***/
+
+#include <stdbool.h>
+
+#include <isc/mem.h>
+#include <isc/stdtime.h>
+
+#include <dns/types.h>
+
+#include <dst/dst.h>
+
+#define DNS_SIGCACHE_DIGESTLENGTH 32 /* SHA-256 */
+
+typedef struct dns_sigcachekey {
+	unsigned char digest[DNS_SIGCACHE_DIGESTLENGTH];
+	isc_stdtime_t inception;
+	isc_stdtime_t expiration;
+} dns_sigcachekey_t;
+
+/***
+ ***	Functions
+ ***/
+
+dns_sigcache_t *
+dns_sigcache_new(isc_mem_t *mctx, unsigned int size);
+/*%
+ * Allocate and initialize a signature verification cache with 'size'
+ * slots.
+ *
+ * Requires:
+ * \li	mctx != NULL
+ * \li	size > 0
+ */
+
+void
+dns_sigcache_destroy(dns_sigcache_t **scp);
+/*%
+ * Free the signature verification cache in 'scp'.  '*scp' is set to
+ * NULL on return.
+ *
+ * Requires:
+ * \li	'*scp' to be a valid sigcache
+ */
+
+isc_result_t
+dns_sigcache_makekey(dns_sigcache_t *sc, const dns_name_t *name,
+		     dns_rdataset_t *rdataset, dns_rdata_t *sigrdata,
+		     dst_key_t *key, dns_sigcachekey_t *keyp);
+/*%
+ * Compute the cache key for verifying the RRSIG 'sigrdata' covering
+ * 'rdataset' at 'name' with 'key', and store it in '*keyp'.
+ *
+ * Requires:
+ * \li	sc to be a valid sigcache.
+ * \li	name, rdataset, key and keyp != NULL
+ * \li	sigrdata to be an RRSIG rdata
+ *
+ * Returns:
+ * \li	ISC_R_SUCCESS
+ * \li	Other results if the RRSIG or the key could not be converted,
+ *	in which case the cache must not be used.
+ */
+
+bool
+dns_sigcache_find(dns_sigcache_t *sc, const dns_sigcachekey_t *key,
+		  isc_stdtime_t now);
+/*%
+ * Return true if a successful verification matching 'key' is cached
+ * and 'now' is within the validity window of the signature.
+ *
+ * Requires:
+ * \li	sc to be a valid sigcache.
+ * \li	key != NULL
+ */
+
+void
+dns_sigcache_add(dns_sigcache_t *sc, const dns_sigcachekey_t *key);
+/*%
+ * Record a successful verification of the signature identified by
+ * 'key', replacing any entry in the same slot.
+ *
+ * Requires:
+ * \li	sc to be a valid sigcache.
+ * \li	key != NULL
+ */
+
+void
+dns_sigcache_flush(dns_sigcache_t *sc);
+/*%
+ * Flush the entire signature verification cache.
+ *
+ * Requires:
+ * \li	sc to be a valid sigcache
+ */
@@ -75,7 +75,18 @@ enum {
 	dns_resstatscounter_nextitem = 44,
 	dns_resstatscounter_priming = 45,
 	dns_resstatscounter_forwardonlyfail = 46,
-	dns_resstatscounter_max = 47,
+	dns_resstatscounter_fctxrace = 47,
+	dns_resstatscounter_fcountwait = 48,
+	dns_resstatscounter_hedgesent = 49,
+	dns_resstatscounter_hedgewon = 50,
+	dns_resstatscounter_refreshsent = 51,
+	dns_resstatscounter_refreshdropped = 52,
+	dns_resstatscounter_walkshared = 53,
+	dns_resstatscounter_msgalloc = 54,
+	dns_resstatscounter_querycpu = 55,
+	dns_resstatscounter_resolvercpu = 56,
+	dns_resstatscounter_validationcpu = 57,
+	dns_resstatscounter_max = 58,
 
 	/*
 	 * DNSSEC stats.
@@ -103,8 +114,11 @@ enum {
 	dns_zonestatscounter_ixfrreqv6 = 10,
 	dns_zonestatscounter_xfrsuccess = 11,
 	dns_zonestatscounter_xfrfail = 12,
+	dns_zonestatscounter_jnlcompact = 13,
+	dns_zonestatscounter_jnlcompacttime = 14,
+	dns_zonestatscounter_jnlreclaimed = 15,
 
-	dns_zonestatscounter_max = 13,
+	dns_zonestatscounter_max = 16,
 
 	/*
 	 * Adb statistics values.
@@ -126,8 +140,10 @@ enum {
 	dns_cachestatscounter_deletelru = 5,
 	dns_cachestatscounter_deletettl = 6,
 	dns_cachestatscounter_coveringnsec = 7,
+	dns_cachestatscounter_deletesieve = 8,
+	dns_cachestatscounter_coveringnsecskip = 9,
 
-	dns_cachestatscounter_max = 8,
+	dns_cachestatscounter_max = 10,
 
 	/*%
 	 * Query statistics counters (obsolete).
@@ -282,6 +298,23 @@ dns_rdatatypestats_create(isc_mem_t *mctx, dns_stats_t **statsp);
  *\li	'statsp' != NULL && '*statsp' == NULL.
  */
 
+void
+dns_rdatatypestats_createperloop(isc_mem_t *mctx, dns_stats_t **statsp);
+void
+dns_opcodestats_createperloop(isc_mem_t *mctx, dns_stats_t **statsp);
+void
+dns_rcodestats_createperloop(isc_mem_t *mctx, dns_stats_t **statsp);
+/*%<
+ * Like dns_rdatatypestats_create(), dns_opcodestats_create() and
+ * dns_rcodestats_create(), but the counters are kept per loop, for
+ * statistics updated on every query; see isc_stats_createperloop().
+ *
+ * Requires:
+ *\li	'mctx' must be a valid memory context.
+ *
+ *\li	'statsp' != NULL && '*statsp' == NULL.
+ */
+
 void
 dns_rdatasetstats_create(isc_mem_t *mctx, dns_stats_t **statsp);
 /*%<
@@ -98,6 +98,7 @@ typedef struct dns_glue		   dns_glue_t;
 typedef struct dns_gluelist	   dns_gluelist_t;
 typedef struct dns_iptable	   dns_iptable_t;
 typedef uint32_t		   dns_iterations_t;
+typedef struct dns_journalindex dns_journalindex_t;
 typedef struct dns_kasp		   dns_kasp_t;
 typedef ISC_LIST(dns_kasp_t) dns_kasplist_t;
 typedef struct dns_kasp_digest dns_kasp_digest_t;
@@ -150,6 +151,7 @@ typedef struct dns_resolver	dns_resolver_t;
 typedef struct dns_qpnode	dns_qpnode_t;
 typedef uint8_t			dns_secalg_t;
 typedef uint8_t			dns_secproto_t;
+typedef struct dns_sigcache	dns_sigcache_t;
 typedef struct dns_signature	dns_signature_t;
 typedef struct dns_skr		dns_skr_t;
 typedef struct dns_slabheader	dns_slabheader_t;
@@ -238,8 +240,14 @@ typedef enum {
 	dns_expire_lru = 0,
 	dns_expire_ttl = 1,
 	dns_expire_flush = 2,
+	dns_expire_sieve = 3,
 } dns_expire_t;
 
+typedef enum {
+	dns_cacheevict_lru = 0,
+	dns_cacheevict_sieve = 1,
+} dns_cacheevict_t;
+
 /*
  * These are generated by gen.c.
  */
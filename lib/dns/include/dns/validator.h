@@ -50,6 +50,7 @@
 
 #include <isc/job.h>
 #include <isc/refcount.h>
+#include <isc/time.h>
 
 #include <dns/fixedname.h>
 #include <dns/rdata.h>
@@ -145,6 +146,9 @@ struct dns_validator {
 	unsigned int  authfail;
 	isc_stdtime_t start;
 
+	/* CPU time used so far, charged to the view when done */
+	isc_nanosecs_t cputime;
+
 	bool	       digest_sha1;
 	bool	       supported_algorithm;
 	dns_rdata_t    rdata;
@@ -57,6 +57,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 
+#include <isc/atomic.h>
 #include <isc/magic.h>
 #include <isc/mutex.h>
 #include <isc/net.h>
@@ -84,6 +85,7 @@ struct dns_view {
 	dns_rdataclass_t   rdclass;
 	char		  *name;
 	dns_zt_t	  *zonetable;
+	dns_zt_t	  *bulkzonetable; /* see dns_view_beginzones() */
 	dns_resolver_t	  *resolver;
 	dns_adb_t	  *adb;
 	dns_requestmgr_t  *requestmgr;
@@ -114,6 +116,7 @@ struct dns_view {
 	bool		      qminimization;
 	bool		      qmin_strict;
 	bool		      auth_nxdomain;
+	bool		      authrespcache;
 	bool		      minimal_any;
 	dns_minimaltype_t     minimalresponses;
 	bool		      enablevalidation;
@@ -169,6 +172,8 @@ struct dns_view {
 	uint16_t	      padding;
 	dns_acl_t	     *pad_acl;
 	unsigned int	      maxbits;
+	uint32_t	      maxoffloaded;
+	atomic_uint_fast32_t  offloaded;
 	dns_dns64list_t	      dns64;
 	unsigned int	      dns64cnt;
 	bool		      usedns64;
@@ -178,6 +183,7 @@ struct dns_view {
 	dns_dlzdblist_t	      dlz_unsearched;
 	uint32_t	      fail_ttl;
 	dns_badcache_t	     *failcache;
+	dns_sigcache_t	     *sigcache;
 	unsigned int	      udpsize;
 	uint32_t	      maxrrperset;
 	uint32_t	      maxtypepername;
@@ -501,6 +507,23 @@ dns_view_delzone(dns_view_t *view, dns_zone_t *zone);
  *\li	'zone' is a valid zone.
  */
 
+void
+dns_view_beginzones(dns_view_t *view);
+void
+dns_view_endzones(dns_view_t *view);
+/*%<
+ * Group the zones that the calling thread adds to and removes from
+ * 'view' in between into a single update of the zone table (see
+ * dns_zt_beginbulk()).
+ *
+ * Requires:
+ *
+ *\li	'view' is a valid view.
+ *
+ *\li	dns_view_endzones() is called by the thread that called
+ *	dns_view_beginzones().
+ */
+
 void
 dns_view_freeze(dns_view_t *view);
 /*%<
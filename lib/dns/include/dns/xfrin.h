@@ -140,11 +140,17 @@ dns_xfrin_getendserial(dns_xfrin_t *xfr);
 
 void
 dns_xfrin_getstats(dns_xfrin_t *xfr, unsigned int *nmsgp, unsigned int *nrecsp,
-		   uint64_t *nbytesp);
+		   uint64_t *nbytesp, unsigned int *nappliedp,
+		   unsigned int *nrecspersecp);
 /*%<
  * Get various statistics values of the xfrin object: number of the received
  * messages, number of the received records, number of the received bytes.
  *
+ * If 'nappliedp' is not NULL, it is set to the number of the received
+ * AXFR records already stored in the new database; the rest are still
+ * queued.  If 'nrecspersecp' is not NULL, it is set to the average number
+ * of records received per second since the transfer started.
+ *
  * Requires:
  *\li	'xfr' is a valid dns_xfrin_t.
  *
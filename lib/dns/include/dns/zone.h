@@ -25,6 +25,7 @@
 
 #include <isc/formatcheck.h>
 #include <isc/rwlock.h>
+#include <isc/time.h>
 #include <isc/tls.h>
 
 #include <dns/catz.h>
@@ -102,6 +103,9 @@ typedef enum {
 	DNS_ZONEOPT_CHECKTTL = 1 << 28,	      /*%< check max-zone-ttl */
 	DNS_ZONEOPT_AUTOEMPTY = 1 << 29,      /*%< automatic empty zone */
 	DNS_ZONEOPT_CHECKSVCB = 1 << 30,      /*%< check SVBC records */
+	DNS_ZONEOPT_LOADONDEMAND = 1ULL << 31, /*%< load-on-demand */
+	DNS_ZONEOPT_JOURNALGROUPCOMMIT = 1ULL << 32, /*%< group commit */
+	DNS_ZONEOPT_SHARERRSETS = 1ULL << 33, /*%< share identical rdata */
 	DNS_ZONEOPT___MAX = UINT64_MAX, /* trick to make the ENUM 64-bit wide */
 } dns_zoneopt_t;
 
@@ -126,6 +130,7 @@ typedef enum {
 	DNS_ZONESTATE_SOAQUERY,
 	DNS_ZONESTATE_ANY,
 	DNS_ZONESTATE_AUTOMATIC,
+	DNS_ZONESTATE_SCHEDULED,
 } dns_zonestate_t;
 
 #ifndef DNS_ZONE_MINREFRESH
@@ -148,6 +153,9 @@ typedef enum {
 	60 /*%< 1 minute, subject to \
 	    * exponential backoff */
 #endif	   /* ifndef DNS_ZONE_DEFAULTRETRY */
+#ifndef DNS_ZONE_DEFAULTDEMANDIDLE
+#define DNS_ZONE_DEFAULTDEMANDIDLE 3600 /*%< 1 hour */
+#endif					/* ifndef DNS_ZONE_DEFAULTDEMANDIDLE */
 
 /***
  ***	Functions
@@ -377,6 +385,53 @@ dns_zone_setmaxrrperset(dns_zone_t *zone, uint32_t maxrrperset);
  *\li	void
  */
 
+void
+dns_zone_setupdatequota(dns_zone_t *zone, uint32_t max);
+/*%<
+ * 	Sets the maximum number of DNS UPDATE messages that can be
+ *	processed for the zone at the same time.  0 implies unlimited.
+ *
+ * Requires:
+ *\li	'zone' to be valid initialised zone.
+ */
+
+isc_quota_t *
+dns_zone_getupdatequota(dns_zone_t *zone);
+/*%<
+ *	Returns the quota of DNS UPDATE messages being processed for the
+ *	zone, see dns_zone_setupdatequota().
+ *
+ * Requires:
+ *\li	'zone' to be valid initialised zone.
+ */
+
+void
+dns_zone_setupdatebatchwindow(dns_zone_t *zone, uint32_t window);
+uint32_t
+dns_zone_getupdatebatchwindow(dns_zone_t *zone);
+/*%<
+ *	Sets/gets the time, in milliseconds, for which DNS UPDATE messages
+ *	are collected so that they are applied to the zone in a single
+ *	version, journal transaction and SOA serial change.  0 means every
+ *	message is applied on its own.
+ *
+ * Requires:
+ *\li	'zone' to be valid initialised zone.
+ */
+
+void
+dns_zone_setupdatebatch(dns_zone_t *zone, void *batch);
+void *
+dns_zone_getupdatebatch(dns_zone_t *zone);
+/*%<
+ *	Sets/gets the batch of DNS UPDATE messages being collected for the
+ *	zone, which is opaque to the zone.
+ *
+ * Requires:
+ *\li	'zone' to be valid initialised zone.
+ *\li	The caller to be running on the zone's loop.
+ */
+
 void
 dns_zone_setmaxtypepername(dns_zone_t *zone, uint32_t maxtypepername);
 /*%<
@@ -498,6 +553,50 @@ dns_zone_asyncload(dns_zone_t *zone, bool newonly, dns_zt_callback_t done,
  *\li	#ISC_R_NOMEMORY
  */
 
+isc_result_t
+dns_zone_demandload(dns_zone_t *zone, isc_loop_t *loop, isc_job_cb cb,
+		    void *arg);
+/*%<
+ * Ask for a zone with the DNS_ZONEOPT_LOADONDEMAND option to be loaded.
+ * Such a zone is not loaded with the other zones; only its file is checked.
+ * The first request starts an asynchronous load.  Every request that
+ * returns #ISC_R_SUCCESS has 'cb' run on 'loop' with 'arg' once the load
+ * has completed, whether it succeeded or not.
+ *
+ * Require:
+ *\li	'zone' to be a valid zone.
+ *\li	'loop' to be a valid loop.
+ *\li	'cb' to be non NULL.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS		the load is in progress; 'cb' will be run.
+ *\li	#DNS_R_UPTODATE		the zone is already loaded.
+ *\li	#ISC_R_NOTIMPLEMENTED	the zone is not loaded on demand.
+ *\li	#ISC_R_FAILURE		the requested load failed.
+ */
+
+void
+dns_zone_setlastquery(dns_zone_t *zone, isc_stdtime_t now);
+/*%<
+ * Record that the zone answered a query at 'now'.  This only has an
+ * effect for zones loaded on demand, which are unloaded again when no
+ * query arrived for the time set with dns_zone_setdemandidletime().
+ *
+ * Require:
+ *\li	'zone' to be a valid zone.
+ */
+
+void
+dns_zone_setdemandidletime(dns_zone_t *zone, uint32_t seconds);
+/*%<
+ * Set the number of seconds without queries after which a zone loaded
+ * on demand is unloaded again.
+ *
+ * Require:
+ *\li	'zone' to be a valid zone.
+ *\li	'seconds' to be non zero.
+ */
+
 bool
 dns__zone_loadpending(dns_zone_t *zone);
 /*%<
@@ -506,6 +605,15 @@ dns__zone_loadpending(dns_zone_t *zone);
  * tests.)
  */
 
+uint64_t
+dns__zone_loadsize(dns_zone_t *zone);
+/*%<
+ * Returns the size in bytes of the file the zone is loaded from, or zero
+ * if it has none or it cannot be read.  For an inline-signed zone this is
+ * the size of the raw zone's file.  (Used by the zone table to schedule
+ * the largest zones first; not intended for use outside of the library.)
+ */
+
 void
 dns_zone_iattach(dns_zone_t *source, dns_zone_t **target);
 /*%<
@@ -1329,6 +1437,36 @@ dns_zone_getjournal(dns_zone_t *zone);
  *\li	'zone' to be valid initialised zone.
  */
 
+dns_journalindex_t *
+dns_zone_getjournalindex(dns_zone_t *zone);
+/*%<
+ * Returns the index of the transactions in the zone's journal, for use
+ * with dns_journal_setindex() by everything that opens the journal.
+ *
+ * Requires:
+ *\li	'zone' to be valid initialised zone.
+ */
+
+void
+dns_zone_journalsync(dns_zone_t *zone, isc_loop_t *loop, isc_job_cb cb,
+		     void *arg, isc_result_t *resultp);
+/*%<
+ * Sync the zone's journal, to which transactions were committed with
+ * DNS_JOURNAL_NOSYNC, and run 'cb' on 'loop' with 'arg' once it is
+ * durable.  If the sync fails, its result is stored in '*resultp';
+ * otherwise '*resultp' is left alone.
+ *
+ * Syncs are group committed across all the zones of the zone manager:
+ * while one batch of journals is being synced, the transactions
+ * committed in the meantime are collected, and each journal in the next
+ * batch is synced once however many of them it holds.
+ *
+ * Requires:
+ *\li	'zone' to be a valid zone.
+ *\li	'loop' to be a valid loop.
+ *\li	'cb' and 'resultp' to be non NULL.
+ */
+
 dns_zonetype_t
 dns_zone_gettype(dns_zone_t *zone);
 /*%<
@@ -1918,12 +2056,38 @@ unsigned int
 dns_zonemgr_getcount(dns_zonemgr_t *zmgr, dns_zonestate_t state);
 /*%<
  *	Returns the number of zones in the specified state.
+ *	DNS_ZONESTATE_SCHEDULED counts the zones that have maintenance
+ *	scheduled in the zone manager's timer wheels.
  *
  * Requires:
  *\li	'zmgr' to be a valid zone manager.
  *\li	'state' to be a valid DNS_ZONESTATE_ enum.
  */
 
+bool
+dns_zonemgr_getloadprogress(dns_zonemgr_t *zmgr, unsigned int *pendingp,
+			    isc_nanosecs_t *elapsedp,
+			    isc_nanosecs_t *expectedp);
+/*%<
+ *	Reports on the most recent round of asynchronous zone loads.  A round
+ *	starts when a load is scheduled while none are pending and ends when
+ *	the last pending load completes.
+ *
+ *	'*pendingp' is set to the number of loads that have not completed
+ *	yet, '*elapsedp' to the time since the round started (or its total
+ *	duration if it is over) and '*expectedp' to the estimated total
+ *	duration of the round, extrapolated from the number of bytes loaded
+ *	so far.  '*expectedp' is zero while no load of the round has
+ *	completed.
+ *
+ * Requires:
+ *\li	'zmgr' to be a valid zone manager.
+ *\li	'pendingp', 'elapsedp' and 'expectedp' to be non NULL.
+ *
+ * Returns:
+ *\li	false if no zone load has been scheduled yet, true otherwise.
+ */
+
 isc_result_t
 dns_zone_getxfr(dns_zone_t *zone, dns_xfrin_t **xfrp, bool *is_firstrefresh,
 		bool *is_running, bool *is_deferred, bool *is_presoa,
@@ -2336,6 +2500,19 @@ dns_zone_getadded(dns_zone_t *zone);
  * \li	'zone' to be valid.
  */
 
+void
+dns_zone_setconfighash(dns_zone_t *zone, uint64_t hash);
+uint64_t
+dns_zone_getconfighash(dns_zone_t *zone);
+/*%
+ * Set and get the fingerprint of the configuration that the zone was
+ * last configured from; the server uses it to skip configuring the
+ * zones whose configuration didn't change.  Zero means unknown.
+ *
+ * Requires:
+ * \li	'zone' to be valid.
+ */
+
 void
 dns_zone_setautomatic(dns_zone_t *zone, bool automatic);
 /*%
@@ -2467,6 +2644,18 @@ dns_zone_setixfrratio(dns_zone_t *zone, uint32_t ratio);
  * \li	'zone' to be valid.
  */
 
+void
+dns_zone_setdumpratio(dns_zone_t *zone, uint32_t ratio);
+/*%
+ * Sets the size of the changes journaled since the zone file of a
+ * secondary or mirror zone was last written, as a percentage of the
+ * zone file size, below which the scheduled dumps of the zone are put
+ * off.  0, the default, dumps the zone on schedule.
+ *
+ * Requires:
+ * \li	'zone' to be valid.
+ */
+
 void
 dns_zone_setserialupdatemethod(dns_zone_t *zone, dns_updatemethod_t method);
 /*%
@@ -2527,6 +2716,26 @@ dns_zone_setnsec3param(dns_zone_t *zone, uint8_t hash, uint8_t flags,
  * \li	'zone' to be valid.
  */
 
+isc_result_t
+dns_zone_nsec3chainprogress(dns_zone_t *zone,
+			    const dns_rdata_nsec3param_t *nsec3param,
+			    uint64_t *nodesp, uint64_t *totalp,
+			    isc_stdtime_t *startedp);
+/*%<
+ * Get the progress of the creation of the NSEC3 chain matching the hash,
+ * iterations and salt of 'nsec3param': the number of nodes processed so
+ * far, the number of nodes of the zone when the creation started, and
+ * the time it started at.
+ *
+ * Requires:
+ * \li	'zone' to be valid.
+ * \li	'nodesp', 'totalp' and 'startedp' are not NULL.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOTFOUND		the chain is not being created
+ */
+
 void
 dns_zone_setrawdata(dns_zone_t *zone, dns_masterrawheader_t *header);
 /*%
@@ -51,6 +51,23 @@ dns_zt_compact(dns_zt_t *zt);
  * \li	'zt' to be valid
  */
 
+void
+dns_zt_beginbulk(dns_zt_t *zt);
+void
+dns_zt_endbulk(dns_zt_t *zt);
+/*%<
+ * Open and commit a bulk update of the zone table: the zones that the
+ * calling thread mounts and unmounts in between are committed in one
+ * transaction, and become visible to the readers all at once.  Until
+ * then, dns_zt_find() and dns_zt_apply() in the calling thread see the
+ * pending changes, and the updates from the other threads wait.
+ *
+ * Requires:
+ * \li	'zt' to be valid
+ * \li	the calling thread has no other bulk update open (begin), or
+ *	has this one open (end)
+ */
+
 isc_result_t
 dns_zt_mount(dns_zt_t *zt, dns_zone_t *zone);
 /*%<
@@ -284,6 +284,27 @@ dst_context_sign(dst_context_t *dctx, isc_buffer_t *sig);
 isc_result_t
 dst_context_verify(dst_context_t *dctx, isc_region_t *sig);
 
+typedef void (*dst_context_cb_t)(isc_result_t result, void *arg);
+
+void
+dst_context_signasync(dst_context_t *dctx, isc_buffer_t *sig,
+		      isc_loop_t *loop, dst_context_cb_t cb, void *arg);
+void
+dst_context_verifyasync(dst_context_t *dctx, isc_region_t *sig,
+			isc_loop_t *loop, dst_context_cb_t cb, void *arg);
+/*%<
+ * Like dst_context_sign() and dst_context_verify(), but run as an
+ * OpenSSL asynchronous job on 'loop' (see isc/cryptojob.h), so that
+ * the loop can go on with other work while a hardware accelerator
+ * computes the signature.  'cb' is called on 'loop' with the result
+ * and 'arg'; 'dctx' and 'sig' must stay valid until then.
+ *
+ * Requires:
+ * \li	"dctx" is a valid context.
+ * \li	"sig" is a valid buffer or region.
+ * \li	"loop" is the current loop.
+ */
+
 isc_result_t
 dst_context_verify2(dst_context_t *dctx, unsigned int maxbits,
 		    isc_region_t *sig);
@@ -402,6 +423,28 @@ dst_key_fromnamedfile(const char *filename, const char *dirname, int type,
  * \li	If successful, *keyp will contain a valid key.
  */
 
+isc_result_t
+dst_key_fromnamedfile_cached(const char *filename, const char *dirname,
+			     int type, isc_mem_t *mctx, dst_key_t **keyp);
+/*%<
+ * Like dst_key_fromnamedfile(), but the key is looked up in (and added
+ * to) a process-wide cache of the keys read from files, so that a key
+ * directory that is scanned repeatedly is not parsed again each time.
+ * A cached key is only used while its key, private key and state files
+ * are unchanged on disk.  The key returned is a copy that belongs to the
+ * caller and may be modified.
+ *
+ * Requires:
+ * \li	As for dst_key_fromnamedfile().
+ *
+ * Returns:
+ * \li	ISC_R_SUCCESS
+ * \li	any other result indicates failure
+ *
+ * Ensures:
+ * \li	If successful, *keyp will contain a valid key.
+ */
+
 isc_result_t
 dst_key_read_public(const char *filename, int type, isc_mem_t *mctx,
 		    dst_key_t **keyp);
@@ -482,6 +525,31 @@ dst_key_fromdns(const dns_name_t *name, dns_rdataclass_t rdclass,
  *	pointer in data will be advanced.
  */
 
+isc_result_t
+dst_key_fromdns_cached(const dns_name_t *name, dns_rdataclass_t rdclass,
+		       isc_buffer_t *source, dst_key_t **keyp);
+/*%<
+ * Like dst_key_fromdns(), but the key is looked up in (and added to) a
+ * process-wide cache of the public keys parsed from DNSKEY rdata, so that
+ * busy keys are not rebuilt each time they are used.  The key may be
+ * shared with other callers: it must not be modified, only used and freed
+ * with dst_key_free().  The least recently used keys are dropped from the
+ * cache when it grows over its memory limit.
+ *
+ * Requires:
+ * \li	"name" is a valid absolute dns name.
+ * \li	"source" is a valid buffer.  There must be at least 4 bytes available.
+ * \li	"keyp" is not NULL and "*keyp" is NULL.
+ *
+ * Returns:
+ * \li	ISC_R_SUCCESS
+ * \li	any other result indicates failure
+ *
+ * Ensures:
+ * \li	If successful, *keyp will contain a valid key, and the consumed
+ *	pointer in data will be advanced.
+ */
+
 isc_result_t
 dst_key_todns(const dst_key_t *key, isc_buffer_t *target);
 /*%<
@@ -17,15 +17,23 @@
 #include <stdlib.h>
 #include <unistd.h>
 
+#include <sys/stat.h>
+
+#include <isc/atomic.h>
 #include <isc/dir.h>
+#include <isc/errno.h>
 #include <isc/file.h>
 #include <isc/log.h>
 #include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/once.h>
+#include <isc/os.h>
 #include <isc/overflow.h>
 #include <isc/result.h>
 #include <isc/serial.h>
 #include <isc/stdio.h>
 #include <isc/string.h>
+#include <isc/thread.h>
 #include <isc/util.h>
 
 #include <dns/compress.h>
@@ -104,6 +112,9 @@
 static isc_result_t
 index_to_disk(dns_journal_t *);
 
+static void
+index_encode(dns_journal_t *);
+
 static uint32_t
 decode_uint32(unsigned char *p) {
 	return ((uint32_t)p[0] << 24) + ((uint32_t)p[1] << 16) +
@@ -321,6 +332,12 @@ struct dns_journal {
 				      *   mode is allowed */
 	bool recovered;		     /*%< A recoverable error was found
 				      *   while reading the journal */
+	bool nosync;		     /*%< Commits are not synced, see
+				      *   DNS_JOURNAL_NOSYNC */
+	bool raw;		     /*%< RR data is not parsed, see
+				      *   DNS_JOURNAL_RAW */
+	dns_journalindex_t *fullindex; /*%< Shared index of all
+					*   transactions, if any */
 	char *filename;		     /*%< Journal file name */
 	FILE *fp;		     /*%< File handle */
 	off_t offset;		     /*%< Current file offset */
@@ -360,6 +377,114 @@ struct dns_journal {
 #define DNS_JOURNAL_MAGIC    ISC_MAGIC('J', 'O', 'U', 'R')
 #define DNS_JOURNAL_VALID(t) ISC_MAGIC_VALID(t, DNS_JOURNAL_MAGIC)
 
+/*%
+ * A transaction boundary in a full journal index: the serial number and
+ * offset at which a transaction starts, or the indexed part of the
+ * journal ends, and the number of RRs in the indexed transactions
+ * before it.
+ */
+typedef struct {
+	uint32_t serial;
+	off_t offset;
+	uint64_t rrs;
+} journal_ixpos_t;
+
+struct dns_journalindex {
+	unsigned int magic; /*%< JIDX */
+	isc_mem_t *mctx;
+	isc_refcount_t references;
+	isc_mutex_t lock;
+	journal_ixpos_t *pos; /*%< Consecutive transaction boundaries */
+	size_t count;	      /*%< Number of entries in 'pos' */
+	size_t size;	      /*%< Allocated entries in 'pos' */
+};
+
+#define DNS_JOURNALINDEX_MAGIC	   ISC_MAGIC('J', 'I', 'D', 'X')
+#define DNS_JOURNALINDEX_VALID(ix) ISC_MAGIC_VALID(ix, DNS_JOURNALINDEX_MAGIC)
+
+/*%
+ * A journal file with transactions committed with DNS_JOURNAL_NOSYNC
+ * that have not been synced yet.  The header and index on disk only
+ * describe the transactions that are on stable storage, so that a crash
+ * cannot leave a header pointing to data that was lost; 'raw' holds the
+ * header and index describing all the committed transactions, which the
+ * journals opened for the file read instead.  The file is identified by
+ * its device and inode as well as its name, so that an entry left for a
+ * file that was since removed or replaced is dropped.
+ */
+typedef struct journal_pending journal_pending_t;
+struct journal_pending {
+	isc_mem_t *mctx;
+	char *filename;
+	dev_t dev;
+	ino_t ino;
+	uint64_t generation; /*%< Generation of 'raw' */
+	uint64_t written;    /*%< Generation of the header on disk */
+	unsigned char *raw;  /*%< Raw header and index */
+	size_t size;
+	ISC_LINK(journal_pending_t) link;
+};
+
+static ISC_LIST(journal_pending_t) pending;
+static isc_mutex_t pendinglock;
+static uint64_t pendinggen; /*%< Last generation, for all the files */
+static isc_once_t pendingonce = ISC_ONCE_INIT;
+
+static void
+pending_initialize(void) {
+	isc_mutex_init(&pendinglock);
+	ISC_LIST_INIT(pending);
+}
+
+static void
+pending_free(journal_pending_t *p) {
+	isc_mem_put(p->mctx, p->raw, p->size);
+	isc_mem_free(p->mctx, p->filename);
+	isc_mem_putanddetach(&p->mctx, p, sizeof(*p));
+}
+
+static isc_result_t
+journal_fileid(FILE *fp, dev_t *devp, ino_t *inop) {
+	struct stat sb;
+
+	if (fstat(fileno(fp), &sb) != 0) {
+		return isc_errno_toresult(errno);
+	}
+	*devp = sb.st_dev;
+	*inop = sb.st_ino;
+	return ISC_R_SUCCESS;
+}
+
+/*
+ * Return the pending entry of the journal file 'filename', open as 'fp',
+ * or NULL if there is none.  'pendinglock' must be held.
+ */
+static journal_pending_t *
+pending_find(const char *filename, FILE *fp) {
+	journal_pending_t *p = NULL;
+	dev_t dev;
+	ino_t ino;
+
+	if (ISC_LIST_EMPTY(pending) ||
+	    journal_fileid(fp, &dev, &ino) != ISC_R_SUCCESS)
+	{
+		return NULL;
+	}
+
+	ISC_LIST_FOREACH (pending, p, link) {
+		if (strcmp(p->filename, filename) != 0) {
+			continue;
+		}
+		if (p->dev != dev || p->ino != ino) {
+			ISC_LIST_UNLINK(pending, p, link);
+			pending_free(p);
+			return NULL;
+		}
+		return p;
+	}
+	return NULL;
+}
+
 static void
 journal_pos_decode(journal_rawpos_t *raw, journal_pos_t *cooked) {
 	cooked->serial = decode_uint32(raw->serial);
@@ -464,6 +589,9 @@ journal_fsync(dns_journal_t *j) {
 			      isc_result_totext(result));
 		return ISC_R_UNEXPECTED;
 	}
+	if (j->nosync) {
+		return ISC_R_SUCCESS;
+	}
 	result = isc_stdio_sync(j->fp);
 	if (result != ISC_R_SUCCESS) {
 		isc_log_write(DNS_LOGCATEGORY_GENERAL, DNS_LOGMODULE_JOURNAL,
@@ -474,6 +602,101 @@ journal_fsync(dns_journal_t *j) {
 	return ISC_R_SUCCESS;
 }
 
+/*
+ * Write the header 'rawheader' and the index of 'j' to the journal file,
+ * superseding the ones kept in memory, if any.
+ */
+static isc_result_t
+header_to_disk(dns_journal_t *j, journal_rawheader_t *rawheader) {
+	isc_result_t result;
+	journal_pending_t *p = NULL;
+
+	LOCK(&pendinglock);
+	CHECK(journal_seek(j, 0));
+	CHECK(journal_write(j, rawheader, sizeof(*rawheader)));
+	CHECK(index_to_disk(j));
+	p = pending_find(j->filename, j->fp);
+	if (p != NULL) {
+		ISC_LIST_UNLINK(pending, p, link);
+		pending_free(p);
+	}
+
+failure:
+	UNLOCK(&pendinglock);
+	return result;
+}
+
+/*
+ * Keep the header 'rawheader' and the index of 'j' in memory until
+ * dns_journal_sync() has synced the transactions they describe.
+ */
+static isc_result_t
+header_to_pending(dns_journal_t *j, journal_rawheader_t *rawheader) {
+	isc_result_t result;
+	journal_pending_t *p = NULL;
+	size_t size = sizeof(*rawheader) +
+		      ISC_CHECKED_MUL(j->header.index_size,
+				      sizeof(journal_rawpos_t));
+	dev_t dev;
+	ino_t ino;
+
+	result = journal_fileid(j->fp, &dev, &ino);
+	if (result != ISC_R_SUCCESS) {
+		isc_log_write(DNS_LOGCATEGORY_GENERAL, DNS_LOGMODULE_JOURNAL,
+			      ISC_LOG_ERROR, "%s: fstat: %s", j->filename,
+			      isc_result_totext(result));
+		return ISC_R_UNEXPECTED;
+	}
+	if (j->header.index_size != 0) {
+		index_encode(j);
+	}
+
+	LOCK(&pendinglock);
+	p = pending_find(j->filename, j->fp);
+	if (p == NULL) {
+		/*
+		 * The header on disk is as recent as any header of an
+		 * earlier generation that is still to be written.
+		 */
+		p = isc_mem_get(j->mctx, sizeof(*p));
+		*p = (journal_pending_t){
+			.filename = isc_mem_strdup(j->mctx, j->filename),
+			.dev = dev,
+			.ino = ino,
+			.written = pendinggen,
+			.raw = isc_mem_get(j->mctx, size),
+			.size = size,
+			.link = ISC_LINK_INITIALIZER,
+		};
+		isc_mem_attach(j->mctx, &p->mctx);
+		ISC_LIST_APPEND(pending, p, link);
+	}
+	INSIST(p->size == size);
+	memmove(p->raw, rawheader, sizeof(*rawheader));
+	if (j->header.index_size != 0) {
+		memmove(p->raw + sizeof(*rawheader), j->rawindex,
+			size - sizeof(*rawheader));
+	}
+	p->generation = ++pendinggen;
+	UNLOCK(&pendinglock);
+
+	return ISC_R_SUCCESS;
+}
+
+/*
+ * Write the header 'rawheader' and the index of 'j', which describe the
+ * transactions just written.  With DNS_JOURNAL_NOSYNC the transactions
+ * were not synced, and the header and index are only kept in memory
+ * until dns_journal_sync() has synced them.
+ */
+static isc_result_t
+journal_write_header(dns_journal_t *j, journal_rawheader_t *rawheader) {
+	if (j->nosync) {
+		return header_to_pending(j, rawheader);
+	}
+	return header_to_disk(j, rawheader);
+}
+
 /*
  * Read/write a transaction header at the current file position.
  */
@@ -617,10 +840,15 @@ journal_open(isc_mem_t *mctx, const char *filename, bool writable, bool create,
 	FILE *fp = NULL;
 	isc_result_t result;
 	journal_rawheader_t rawheader;
+	journal_pending_t *p = NULL;
+	unsigned char *pendingraw = NULL;
+	size_t pendingsize = 0;
 	dns_journal_t *j;
 
 	REQUIRE(journalp != NULL && *journalp == NULL);
 
+	isc_once_do(&pendingonce, pending_initialize);
+
 	j = isc_mem_get(mctx, sizeof(*j));
 	*j = (dns_journal_t){ .state = JOURNAL_STATE_INVALID,
 			      .filename = isc_mem_strdup(mctx, filename),
@@ -661,6 +889,23 @@ journal_open(isc_mem_t *mctx, const char *filename, bool writable, bool create,
 	CHECK(journal_seek(j, 0));
 	CHECK(journal_read(j, &rawheader, sizeof(rawheader)));
 
+	/*
+	 * The transactions committed without being synced yet are only
+	 * described by the header and index kept in memory.
+	 */
+	LOCK(&pendinglock);
+	p = pending_find(j->filename, fp);
+	if (p != NULL) {
+		pendingsize = p->size;
+		pendingraw = isc_mem_get(mctx, pendingsize);
+		memmove(pendingraw, p->raw, pendingsize);
+	}
+	UNLOCK(&pendinglock);
+	if (pendingraw != NULL) {
+		INSIST(pendingsize >= sizeof(rawheader));
+		memmove(&rawheader, pendingraw, sizeof(rawheader));
+	}
+
 	if (memcmp(rawheader.h.format, journal_header_ver1.format,
 		   sizeof(journal_header_ver1.format)) == 0)
 	{
@@ -704,7 +949,13 @@ journal_open(isc_mem_t *mctx, const char *filename, bool writable, bool create,
 					   sizeof(journal_rawpos_t));
 		j->rawindex = isc_mem_get(mctx, rawbytes);
 
-		CHECK(journal_read(j, j->rawindex, rawbytes));
+		if (pendingraw != NULL) {
+			INSIST(pendingsize == sizeof(rawheader) + rawbytes);
+			memmove(j->rawindex, pendingraw + sizeof(rawheader),
+				rawbytes);
+		} else {
+			CHECK(journal_read(j, j->rawindex, rawbytes));
+		}
 
 		j->index = isc_mem_cget(mctx, j->header.index_size,
 					sizeof(journal_pos_t));
@@ -737,10 +988,17 @@ journal_open(isc_mem_t *mctx, const char *filename, bool writable, bool create,
 
 	j->state = writable ? JOURNAL_STATE_WRITE : JOURNAL_STATE_READ;
 
+	if (pendingraw != NULL) {
+		isc_mem_put(mctx, pendingraw, pendingsize);
+	}
+
 	*journalp = j;
 	return ISC_R_SUCCESS;
 
 failure:
+	if (pendingraw != NULL) {
+		isc_mem_put(mctx, pendingraw, pendingsize);
+	}
 	j->magic = 0;
 	if (j->rawindex != NULL) {
 		isc_mem_cput(j->mctx, j->rawindex, j->header.index_size,
@@ -786,9 +1044,101 @@ dns_journal_open(isc_mem_t *mctx, const char *filename, unsigned int mode,
 		result = journal_open(mctx, backup, writable, writable, false,
 				      journalp);
 	}
+	if (result == ISC_R_SUCCESS && writable) {
+		(*journalp)->nosync = ((mode & DNS_JOURNAL_NOSYNC) != 0);
+	}
+	if (result == ISC_R_SUCCESS && !writable) {
+		(*journalp)->raw = ((mode & DNS_JOURNAL_RAW) != 0);
+	}
 	return result;
 }
 
+isc_result_t
+dns_journal_sync(const char *filename) {
+	isc_result_t result;
+	FILE *fp = NULL;
+	journal_pending_t *p = NULL;
+	isc_mem_t *mctx = NULL;
+	unsigned char *raw = NULL;
+	size_t size = 0;
+	uint64_t generation = 0;
+
+	REQUIRE(filename != NULL);
+
+	isc_once_do(&pendingonce, pending_initialize);
+
+	result = isc_stdio_open(filename, "rb+", &fp);
+	if (result == ISC_R_FILENOTFOUND) {
+		return ISC_R_NOTFOUND;
+	}
+	if (result != ISC_R_SUCCESS) {
+		goto failure;
+	}
+
+	/*
+	 * Take a copy of the header and index describing the transactions
+	 * committed so far, and sync these transactions.
+	 */
+	LOCK(&pendinglock);
+	p = pending_find(filename, fp);
+	if (p != NULL) {
+		isc_mem_attach(p->mctx, &mctx);
+		size = p->size;
+		raw = isc_mem_get(mctx, size);
+		memmove(raw, p->raw, size);
+		generation = p->generation;
+	}
+	UNLOCK(&pendinglock);
+
+	result = isc_stdio_sync(fp);
+	if (result != ISC_R_SUCCESS || raw == NULL) {
+		goto failure;
+	}
+
+	/*
+	 * Then write the copy, unless a newer header was written in the
+	 * meantime, and sync it in turn.
+	 */
+	LOCK(&pendinglock);
+	p = pending_find(filename, fp);
+	if (p != NULL && generation > p->written) {
+		result = isc_stdio_seek(fp, 0, SEEK_SET);
+		if (result == ISC_R_SUCCESS) {
+			result = isc_stdio_write(raw, 1, size, fp, NULL);
+		}
+		if (result == ISC_R_SUCCESS) {
+			result = isc_stdio_flush(fp);
+		}
+		if (result == ISC_R_SUCCESS) {
+			p->written = generation;
+			if (p->generation == generation) {
+				ISC_LIST_UNLINK(pending, p, link);
+				pending_free(p);
+			}
+		}
+	}
+	UNLOCK(&pendinglock);
+
+	if (result == ISC_R_SUCCESS) {
+		result = isc_stdio_sync(fp);
+	}
+
+failure:
+	if (raw != NULL) {
+		isc_mem_putanddetach(&mctx, raw, size);
+	}
+	if (fp != NULL) {
+		(void)isc_stdio_close(fp);
+	}
+	if (result != ISC_R_SUCCESS) {
+		isc_log_write(DNS_LOGCATEGORY_GENERAL, DNS_LOGMODULE_JOURNAL,
+			      ISC_LOG_ERROR, "%s: fsync: %s", filename,
+			      isc_result_totext(result));
+		return ISC_R_UNEXPECTED;
+	}
+	return ISC_R_SUCCESS;
+}
+
 /*
  * A comparison function defining the sorting order for
  * entries in the IXFR-style journal file.
@@ -1094,6 +1444,284 @@ index_invalidate(dns_journal_t *j, uint32_t serial) {
 	}
 }
 
+/*
+ * Full index support.  The on-disk index above only holds a sample of
+ * the transactions, so finding one usually still means scanning the
+ * transaction headers that follow the closest sample.  A full index
+ * holds every transaction boundary of the journal file in memory.  It
+ * is shared by the journals opened for the file, extended as they
+ * commit transactions or scan for ones it does not hold yet, and
+ * searched with a binary search.
+ *
+ * The index lives longer than the journals using it, so it is checked
+ * against the journal header whenever it is used, and the boundary
+ * found is checked against the transaction header on disk.  Whenever
+ * it does not match, the index is emptied and rebuilt.
+ */
+static void
+fullindex_append(dns_journalindex_t *ix, uint32_t serial, off_t offset,
+		 uint64_t rrs) {
+	if (ix->count == ix->size) {
+		size_t size = (ix->size == 0) ? 64 : ix->size * 2;
+		ix->pos = isc_mem_creget(ix->mctx, ix->pos, ix->size, size,
+					 sizeof(ix->pos[0]));
+		ix->size = size;
+	}
+	ix->pos[ix->count++] = (journal_ixpos_t){
+		.serial = serial,
+		.offset = offset,
+		.rrs = rrs,
+	};
+}
+
+/*
+ * Binary search for 'serial'.  The indexed serial numbers increase in
+ * serial number arithmetic, so they are compared by their distance
+ * from the first one.
+ */
+static bool
+fullindex_lookup(dns_journalindex_t *ix, uint32_t serial, size_t *kp) {
+	uint32_t base = ix->pos[0].serial;
+	uint32_t key = serial - base;
+	size_t lo = 0, hi = ix->count;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (ix->pos[mid].serial - base < key) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	*kp = lo;
+	return lo < ix->count && ix->pos[lo].serial == serial;
+}
+
+/*
+ * Make the index agree with the header of the journal 'j': drop the
+ * transactions purged from it, seed an empty index with its first
+ * transaction, and empty the index if it describes another file.
+ * A journal opened before the latest purge may begin before the index
+ * does; the index is then left alone and not used for the purged part.
+ */
+static void
+fullindex_check(dns_journal_t *j, dns_journalindex_t *ix) {
+	size_t k;
+
+	if (ix->count > 0 &&
+	    fullindex_lookup(ix, j->header.end.serial, &k) &&
+	    ix->pos[k].offset != j->header.end.offset)
+	{
+		ix->count = 0;
+	}
+
+	if (ix->count > 0 &&
+	    DNS_SERIAL_GE(j->header.begin.serial, ix->pos[0].serial))
+	{
+		if (!fullindex_lookup(ix, j->header.begin.serial, &k) ||
+		    ix->pos[k].offset != j->header.begin.offset)
+		{
+			ix->count = 0;
+		} else if (k > 0) {
+			memmove(ix->pos, ix->pos + k,
+				(ix->count - k) * sizeof(ix->pos[0]));
+			ix->count -= k;
+		}
+	}
+
+	if (ix->count == 0) {
+		fullindex_append(ix, j->header.begin.serial,
+				 j->header.begin.offset, 0);
+	}
+}
+
+/*
+ * Find the transaction starting with 'serial' in the index of 'j',
+ * scanning the journal from the last indexed transaction to extend the
+ * index if needed.  The index must be locked.
+ *
+ * Returns ISC_R_SUCCESS and sets '*kp' to the index entry when found,
+ * ISC_R_NOTFOUND when no transaction starts with 'serial', and anything
+ * else when the index cannot tell and the journal has to be scanned.
+ */
+static isc_result_t
+fullindex_find(dns_journal_t *j, uint32_t serial, size_t *kp) {
+	dns_journalindex_t *ix = j->fullindex;
+	journal_xhdr_t xhdr;
+	journal_ixpos_t last;
+	isc_result_t result;
+	size_t k;
+
+	fullindex_check(j, ix);
+
+	if (DNS_SERIAL_GT(ix->pos[0].serial, serial)) {
+		return ISC_R_NOMORE;
+	}
+
+	if (fullindex_lookup(ix, serial, &k)) {
+		/*
+		 * Check that the transaction is where the index says.
+		 */
+		if (ix->pos[k].offset != j->header.end.offset) {
+			CHECK(journal_seek(j, ix->pos[k].offset));
+			CHECK(journal_read_xhdr(j, &xhdr));
+			if (xhdr.serial0 != serial) {
+				ix->count = 0;
+				return ISC_R_NOMORE;
+			}
+		}
+		*kp = k;
+		return ISC_R_SUCCESS;
+	}
+
+	last = ix->pos[ix->count - 1];
+	if (!DNS_SERIAL_GT(serial, last.serial)) {
+		return ISC_R_NOTFOUND;
+	}
+
+	while (DNS_SERIAL_GT(serial, last.serial)) {
+		if (last.serial == j->header.end.serial) {
+			return ISC_R_NOTFOUND;
+		}
+		CHECK(journal_seek(j, last.offset));
+		CHECK(journal_read_xhdr(j, &xhdr));
+		if (xhdr.serial0 != last.serial ||
+		    isc_serial_le(xhdr.serial1, xhdr.serial0))
+		{
+			/* Let the scan report the corruption. */
+			ix->count = 0;
+			return ISC_R_NOMORE;
+		}
+		fullindex_append(ix, xhdr.serial1,
+				 last.offset + sizeof(journal_rawxhdr_t) +
+					 xhdr.size,
+				 last.rrs + xhdr.count);
+		last = ix->pos[ix->count - 1];
+	}
+	if (last.serial != serial) {
+		return ISC_R_NOTFOUND;
+	}
+
+	*kp = ix->count - 1;
+	return ISC_R_SUCCESS;
+
+failure:
+	return result;
+}
+
+/*
+ * Record the transaction just committed to 'j' in its index, if it
+ * follows the last indexed one.  A commit never waits for the index:
+ * if the index is busy, it is extended by the next search instead.
+ */
+static void
+fullindex_commit(dns_journal_t *j) {
+	dns_journalindex_t *ix = j->fullindex;
+
+	if (isc_mutex_trylock(&ix->lock) != ISC_R_SUCCESS) {
+		return;
+	}
+	if (ix->count > 0) {
+		journal_ixpos_t last = ix->pos[ix->count - 1];
+		if (last.serial == j->x.pos[0].serial &&
+		    last.offset == j->x.pos[0].offset)
+		{
+			fullindex_append(ix, j->x.pos[1].serial,
+					 j->x.pos[1].offset,
+					 last.rrs + j->x.n_rr);
+		}
+	}
+	UNLOCK(&ix->lock);
+}
+
+/*
+ * Compute the IXFR size of the transactions from 'j->it.bpos' to
+ * 'j->it.epos' from the index of 'j', without reading them.
+ */
+static isc_result_t
+fullindex_xfrsize(dns_journal_t *j, size_t *xfrsizep) {
+	dns_journalindex_t *ix = j->fullindex;
+	isc_result_t result;
+	size_t b, e;
+	uint64_t size;
+
+	LOCK(&ix->lock);
+	result = fullindex_find(j, j->it.epos.serial, &e);
+	if (result == ISC_R_SUCCESS) {
+		result = fullindex_find(j, j->it.bpos.serial, &b);
+	}
+	if (result == ISC_R_SUCCESS) {
+		INSIST(b <= e);
+		size = (uint64_t)(ix->pos[e].offset - ix->pos[b].offset) -
+		       (e - b) * sizeof(journal_rawxhdr_t);
+		*xfrsizep = size - (ix->pos[e].rrs - ix->pos[b].rrs) *
+					   sizeof(journal_rawrrhdr_t);
+	}
+	UNLOCK(&ix->lock);
+
+	return result;
+}
+
+void
+dns_journalindex_create(isc_mem_t *mctx, dns_journalindex_t **ixp) {
+	dns_journalindex_t *ix = NULL;
+
+	REQUIRE(ixp != NULL && *ixp == NULL);
+
+	ix = isc_mem_get(mctx, sizeof(*ix));
+	*ix = (dns_journalindex_t){
+		.magic = DNS_JOURNALINDEX_MAGIC,
+	};
+	isc_mem_attach(mctx, &ix->mctx);
+	isc_refcount_init(&ix->references, 1);
+	isc_mutex_init(&ix->lock);
+
+	*ixp = ix;
+}
+
+static void
+journalindex_destroy(dns_journalindex_t *ix) {
+	ix->magic = 0;
+	isc_refcount_destroy(&ix->references);
+	if (ix->pos != NULL) {
+		isc_mem_cput(ix->mctx, ix->pos, ix->size, sizeof(ix->pos[0]));
+	}
+	isc_mutex_destroy(&ix->lock);
+	isc_mem_putanddetach(&ix->mctx, ix, sizeof(*ix));
+}
+
+#if DNS_JOURNALINDEX_TRACE
+ISC_REFCOUNT_TRACE_IMPL(dns_journalindex, journalindex_destroy);
+#else
+ISC_REFCOUNT_IMPL(dns_journalindex, journalindex_destroy);
+#endif
+
+void
+dns_journalindex_reset(dns_journalindex_t *ix) {
+	REQUIRE(DNS_JOURNALINDEX_VALID(ix));
+
+	LOCK(&ix->lock);
+	ix->count = 0;
+	UNLOCK(&ix->lock);
+}
+
+void
+dns_journal_setindex(dns_journal_t *j, dns_journalindex_t *ix) {
+	REQUIRE(DNS_JOURNAL_VALID(j));
+	REQUIRE(j->fullindex == NULL);
+	REQUIRE(DNS_JOURNALINDEX_VALID(ix));
+
+	/*
+	 * Journals in the old format may need their transaction
+	 * headers fixed up while reading; just scan them.
+	 */
+	if (j->header_ver1 || j->xhdr_version != XHDR_VERSION2) {
+		return;
+	}
+
+	dns_journalindex_attach(ix, &j->fullindex);
+}
+
 /*
  * Try to find a transaction with initial serial number 'serial'
  * in the journal 'j'.
@@ -1131,6 +1759,21 @@ journal_find(dns_journal_t *j, uint32_t serial, journal_pos_t *pos) {
 		return ISC_R_SUCCESS;
 	}
 
+	if (j->fullindex != NULL && !JOURNAL_EMPTY(&j->header)) {
+		size_t k;
+
+		LOCK(&j->fullindex->lock);
+		result = fullindex_find(j, serial, &k);
+		if (result == ISC_R_SUCCESS) {
+			pos->serial = serial;
+			pos->offset = j->fullindex->pos[k].offset;
+		}
+		UNLOCK(&j->fullindex->lock);
+		if (result == ISC_R_SUCCESS || result == ISC_R_NOTFOUND) {
+			return result;
+		}
+	}
+
 	current_pos = j->header.begin;
 	index_find(j, serial, &current_pos);
 
@@ -1170,6 +1813,7 @@ dns_journal_begin_transaction(dns_journal_t *j) {
 	j->x.pos[0].offset = offset;
 	j->x.pos[1].offset = offset; /* Initial value, will be incremented. */
 	j->x.n_soa = 0;
+	j->x.n_rr = 0;
 
 	CHECK(journal_seek(j, offset));
 
@@ -1266,7 +1910,7 @@ dns_journal_writediff(dns_journal_t *j, dns_diff_t *diff) {
 	INSIST(used.length == size);
 
 	j->x.pos[1].offset += used.length;
-	j->x.n_rr = rrcount;
+	j->x.n_rr += rrcount;
 
 	/*
 	 * Write the buffer contents to the journal file.
@@ -1298,8 +1942,7 @@ dns_journal_commit(dns_journal_t *j) {
 	if (j->state == JOURNAL_STATE_INLINE) {
 		CHECK(journal_fsync(j));
 		journal_header_encode(&j->header, &rawheader);
-		CHECK(journal_seek(j, 0));
-		CHECK(journal_write(j, &rawheader, sizeof(rawheader)));
+		CHECK(journal_write_header(j, &rawheader));
 		CHECK(journal_fsync(j));
 		j->state = JOURNAL_STATE_WRITE;
 		return ISC_R_SUCCESS;
@@ -1370,7 +2013,8 @@ dns_journal_commit(dns_journal_t *j) {
 #endif /* ifdef notyet */
 
 	/*
-	 * Commit the transaction data to stable storage.
+	 * Commit the transaction data to stable storage (or, without
+	 * syncing, hand it to the operating system).
 	 */
 	CHECK(journal_fsync(j));
 
@@ -1396,8 +2040,6 @@ dns_journal_commit(dns_journal_t *j) {
 	}
 	j->header.end = j->x.pos[1];
 	journal_header_encode(&j->header, &rawheader);
-	CHECK(journal_seek(j, 0));
-	CHECK(journal_write(j, &rawheader, sizeof(rawheader)));
 
 	/*
 	 * Update the index.
@@ -1405,16 +2047,20 @@ dns_journal_commit(dns_journal_t *j) {
 	index_add(j, &j->x.pos[0]);
 
 	/*
-	 * Convert the index into on-disk format and write
-	 * it to disk.
+	 * Write the header and the index in on-disk format, only once
+	 * the data they point to is on stable storage.
 	 */
-	CHECK(index_to_disk(j));
+	CHECK(journal_write_header(j, &rawheader));
 
 	/*
 	 * Commit the header to stable storage.
 	 */
 	CHECK(journal_fsync(j));
 
+	if (j->fullindex != NULL) {
+		fullindex_commit(j);
+	}
+
 	/*
 	 * We no longer have a transaction open.
 	 */
@@ -1465,6 +2111,9 @@ dns_journal_destroy(dns_journal_t **journalp) {
 	if (j->it.source.base != NULL) {
 		isc_mem_put(j->mctx, j->it.source.base, j->it.source.length);
 	}
+	if (j->fullindex != NULL) {
+		dns_journalindex_detach(&j->fullindex);
+	}
 	if (j->filename != NULL) {
 		isc_mem_free(j->mctx, j->filename);
 	}
@@ -1634,6 +2283,13 @@ failure:
 isc_result_t
 dns_journal_print(isc_mem_t *mctx, uint32_t flags, const char *filename,
 		  FILE *file) {
+	flags &= ~(DNS_JOURNAL_PRINTBEGIN | DNS_JOURNAL_PRINTEND);
+	return dns_journal_printrange(mctx, flags, filename, 0, 0, file);
+}
+
+isc_result_t
+dns_journal_printrange(isc_mem_t *mctx, uint32_t flags, const char *filename,
+		       uint32_t begin, uint32_t end, FILE *file) {
 	dns_journal_t *j = NULL;
 	isc_buffer_t source;   /* Transaction data from disk */
 	isc_buffer_t target;   /* Ditto after _fromwire check */
@@ -1643,7 +2299,9 @@ dns_journal_print(isc_mem_t *mctx, uint32_t flags, const char *filename,
 	dns_diff_t diff;
 	unsigned int n_soa = 0;
 	unsigned int n_put = 0;
+	uint32_t i = 0;
 	bool printxhdr = ((flags & DNS_JOURNAL_PRINTXHDR) != 0);
+	bool checkindex;
 
 	REQUIRE(filename != NULL);
 
@@ -1689,8 +2347,28 @@ dns_journal_print(isc_mem_t *mctx, uint32_t flags, const char *filename,
 
 	start_serial = dns_journal_first_serial(j);
 	end_serial = dns_journal_last_serial(j);
+	if ((flags & DNS_JOURNAL_PRINTBEGIN) != 0) {
+		start_serial = begin;
+	}
+	if ((flags & DNS_JOURNAL_PRINTEND) != 0) {
+		end_serial = end;
+	}
 
-	CHECK(dns_journal_iter_init(j, start_serial, end_serial, NULL));
+	/*
+	 * The offsets are only checked against the index when the whole
+	 * journal is walked from the start.
+	 */
+	checkindex = (start_serial == dns_journal_first_serial(j));
+
+	result = dns_journal_iter_init(j, start_serial, end_serial, NULL);
+	if (result == ISC_R_NOTFOUND || result == ISC_R_RANGE) {
+		isc_log_write(DNS_LOGCATEGORY_GENERAL, DNS_LOGMODULE_JOURNAL,
+			      ISC_LOG_ERROR,
+			      "%s: serials %u to %u are not in the journal",
+			      j->filename, start_serial, end_serial);
+		goto cleanup;
+	}
+	CHECK(result);
 
 	for (result = dns_journal_first_rr(j); result == ISC_R_SUCCESS;
 	     result = dns_journal_next_rr(j))
@@ -1698,7 +2376,6 @@ dns_journal_print(isc_mem_t *mctx, uint32_t flags, const char *filename,
 		dns_name_t *name = NULL;
 		dns_rdata_t *rdata = NULL;
 		dns_difftuple_t *tuple = NULL;
-		static uint32_t i = 0;
 		bool print = false;
 		uint32_t ttl;
 
@@ -1729,12 +2406,16 @@ dns_journal_print(isc_mem_t *mctx, uint32_t flags, const char *filename,
 				j->xhdr_version, (long long)j->it.cpos.offset,
 				j->curxhdr.size, j->curxhdr.count,
 				j->curxhdr.serial0, j->curxhdr.serial1);
-			if (j->it.cpos.offset > j->index[i].offset) {
+			if (checkindex &&
+			    j->it.cpos.offset > j->index[i].offset)
+			{
 				fprintf(file,
 					"ERROR: Offset mismatch, "
 					"expected %lld\n",
 					(long long)j->index[i].offset);
-			} else if (j->it.cpos.offset == j->index[i].offset) {
+			} else if (checkindex &&
+				   j->it.cpos.offset == j->index[i].offset)
+			{
 				i++;
 			}
 		}
@@ -1882,6 +2563,13 @@ dns_journal_iter_init(dns_journal_t *j, uint32_t begin_serial,
 	CHECK(journal_find(j, end_serial, &j->it.epos));
 	INSIST(j->it.epos.serial == end_serial);
 
+	if (xfrsizep != NULL && j->fullindex != NULL &&
+	    !JOURNAL_EMPTY(&j->header) &&
+	    fullindex_xfrsize(j, xfrsizep) == ISC_R_SUCCESS)
+	{
+		xfrsizep = NULL;
+	}
+
 	if (xfrsizep != NULL) {
 		journal_pos_t pos = j->it.bpos;
 		journal_xhdr_t xhdr;
@@ -2077,15 +2765,29 @@ read_one_rr(dns_journal_t *j) {
 	}
 
 	/*
-	 * Parse the rdata.
+	 * Parse the rdata, or in raw mode just point to it.  The only
+	 * rdata we look into then is the SOA serial number, so make
+	 * sure it's there.
 	 */
 	if (isc_buffer_remaininglength(&j->it.source) != rdlen) {
 		FAIL(DNS_R_FORMERR);
 	}
-	isc_buffer_setactive(&j->it.source, rdlen);
 	dns_rdata_reset(&j->it.rdata);
-	CHECK(dns_rdata_fromwire(&j->it.rdata, rdclass, rdtype, &j->it.source,
-				 j->it.dctx, &j->it.target));
+	if (j->raw) {
+		isc_region_t r;
+
+		if (rdtype == dns_rdatatype_soa && rdlen < 20) {
+			FAIL(DNS_R_FORMERR);
+		}
+		isc_buffer_remainingregion(&j->it.source, &r);
+		dns_rdata_fromregion(&j->it.rdata, rdclass, rdtype, &r);
+		isc_buffer_forward(&j->it.source, rdlen);
+	} else {
+		isc_buffer_setactive(&j->it.source, rdlen);
+		CHECK(dns_rdata_fromwire(&j->it.rdata, rdclass, rdtype,
+					 &j->it.source, j->it.dctx,
+					 &j->it.target));
+	}
 	j->it.ttl = ttl;
 
 	j->it.xpos += sizeof(journal_rawrrhdr_t) + rrhdr.size;
@@ -2132,8 +2834,8 @@ dns_journal_current_rr(dns_journal_t *j, dns_name_t **name, uint32_t *ttl,
  */
 static isc_result_t
 get_name_diff(dns_db_t *db, dns_dbversion_t *ver, isc_stdtime_t now,
-	      dns_dbiterator_t *dbit, dns_name_t *name, dns_diffop_t op,
-	      dns_diff_t *diff) {
+	      dns_dbiterator_t *dbit, const dns_name_t *end, dns_name_t *name,
+	      dns_diffop_t op, dns_diff_t *diff) {
 	isc_result_t result;
 	dns_dbnode_t *node = NULL;
 	dns_rdatasetiter_t *rdsiter = NULL;
@@ -2144,6 +2846,14 @@ get_name_diff(dns_db_t *db, dns_dbversion_t *ver, isc_stdtime_t now,
 		return result;
 	}
 
+	/*
+	 * The names from 'end' on belong to the next shard.
+	 */
+	if (end != NULL && dns_name_compare(name, end) >= 0) {
+		result = ISC_R_NOMORE;
+		goto cleanup_node;
+	}
+
 	result = dns_db_allrdatasets(db, node, ver, 0, now, &rdsiter);
 	if (result != ISC_R_SUCCESS) {
 		goto cleanup_node;
@@ -2271,12 +2981,44 @@ failure:
 	return result;
 }
 
-static isc_result_t
-diff_namespace(dns_db_t *dba, dns_dbversion_t *dbvera, dns_db_t *dbb,
-	       dns_dbversion_t *dbverb, unsigned int options,
-	       dns_diff_t *resultdiff) {
+/*%
+ * The namespaces of the databases are compared on up to DIFF_THREADS
+ * threads.  Each tree is split into shards of at least DIFF_SHARDNODES
+ * nodes, which start at names that exist in both databases, so the
+ * iterators of both can be positioned there.  The differences found in
+ * the shards are joined in the order of the shards, which is the order
+ * in which a single walk of the trees would have found them.
+ */
+#define DIFF_THREADS	8
+#define DIFF_SHARDNODES 4096
+
+typedef struct dshard {
+	dns_fixedname_t fstart;
+	dns_name_t *start; /*%< NULL to start with the first node */
+	dns_name_t *end;   /*%< NULL to stop after the last node */
+	dns_diff_t diff;
+	isc_result_t result;
+} dshard_t;
+
+typedef struct dwork {
 	dns_db_t *db[2];
 	dns_dbversion_t *ver[2];
+	unsigned int options;
+	dshard_t *shards;
+	unsigned int nshards;
+	atomic_uint_fast32_t next;
+} dwork_t;
+
+/*%
+ * Walk the names of both databases from 'shard->start' up to, but not
+ * including, 'shard->end' in lockstep, and add the differences to
+ * 'shard->diff'.
+ */
+static isc_result_t
+diff_range(dwork_t *work, dshard_t *shard) {
+	dns_db_t **db = work->db;
+	dns_dbversion_t **ver = work->ver;
+	dns_diff_t *resultdiff = &shard->diff;
 	dns_dbiterator_t *dbit[2] = { NULL, NULL };
 	bool have[2] = { false, false };
 	dns_fixedname_t fixname[2];
@@ -2284,36 +3026,44 @@ diff_namespace(dns_db_t *dba, dns_dbversion_t *dbvera, dns_db_t *dbb,
 	dns_diff_t diff[2];
 	int i, t;
 
-	db[0] = dba, db[1] = dbb;
-	ver[0] = dbvera, ver[1] = dbverb;
-
 	dns_diff_init(resultdiff->mctx, &diff[0]);
 	dns_diff_init(resultdiff->mctx, &diff[1]);
 
 	dns_fixedname_init(&fixname[0]);
 	dns_fixedname_init(&fixname[1]);
 
-	result = dns_db_createiterator(db[0], options, &dbit[0]);
+	result = dns_db_createiterator(db[0], work->options, &dbit[0]);
 	if (result != ISC_R_SUCCESS) {
 		return result;
 	}
-	result = dns_db_createiterator(db[1], options, &dbit[1]);
+	result = dns_db_createiterator(db[1], work->options, &dbit[1]);
 	if (result != ISC_R_SUCCESS) {
 		goto cleanup_iterator;
 	}
 
-	itresult[0] = dns_dbiterator_first(dbit[0]);
-	itresult[1] = dns_dbiterator_first(dbit[1]);
+	for (i = 0; i < 2; i++) {
+		if (shard->start != NULL) {
+			itresult[i] = dns_dbiterator_seek(dbit[i],
+							  shard->start);
+		} else {
+			itresult[i] = dns_dbiterator_first(dbit[i]);
+		}
+	}
 
 	for (;;) {
 		for (i = 0; i < 2; i++) {
 			if (!have[i] && itresult[i] == ISC_R_SUCCESS) {
-				CHECK(get_name_diff(
-					db[i], ver[i], 0, dbit[i],
+				result = get_name_diff(
+					db[i], ver[i], 0, dbit[i], shard->end,
 					dns_fixedname_name(&fixname[i]),
 					i == 0 ? DNS_DIFFOP_ADD
 					       : DNS_DIFFOP_DEL,
-					&diff[i]));
+					&diff[i]);
+				if (result == ISC_R_NOMORE) {
+					itresult[i] = ISC_R_NOMORE;
+					continue;
+				}
+				CHECK(result);
 				itresult[i] = dns_dbiterator_next(dbit[i]);
 				have[i] = true;
 			}
@@ -2378,6 +3128,162 @@ cleanup_iterator:
 	return result;
 }
 
+static void *
+diff_thread(void *arg) {
+	dwork_t *work = arg;
+	uint_fast32_t i;
+
+	while ((i = atomic_fetch_add_relaxed(&work->next, 1)) < work->nshards)
+	{
+		work->shards[i].result = diff_range(work, &work->shards[i]);
+	}
+
+	return NULL;
+}
+
+/*%
+ * Split the tree of 'dba' walked with the iterator 'work->options' into up
+ * to 'maxshards' shards of about the same number of nodes.
+ */
+static isc_result_t
+split_namespace(dwork_t *work, dshard_t *shards, unsigned int maxshards,
+		unsigned int *nshardsp) {
+	dns_fixedname_t fname;
+	dns_name_t *name = dns_fixedname_initname(&fname);
+	dns_dbiterator_t *dbiter = NULL;
+	uint64_t count = 0, pos = 0;
+	unsigned int nshards, n = 1;
+	isc_result_t result;
+
+	shards[0].start = NULL;
+	if (maxshards == 1) {
+		goto done;
+	}
+
+	result = dns_db_createiterator(work->db[0], work->options, &dbiter);
+	if (result != ISC_R_SUCCESS) {
+		return result;
+	}
+
+	for (result = dns_dbiterator_first(dbiter); result == ISC_R_SUCCESS;
+	     result = dns_dbiterator_next(dbiter))
+	{
+		count++;
+	}
+
+	nshards = ISC_MAX(ISC_MIN(maxshards, count / DIFF_SHARDNODES), 1);
+
+	for (result = dns_dbiterator_first(dbiter);
+	     result == ISC_R_SUCCESS && n < nshards;
+	     result = dns_dbiterator_next(dbiter), pos++)
+	{
+		dns_dbnode_t *node = NULL;
+
+		if (pos < n * count / nshards) {
+			continue;
+		}
+
+		result = dns_dbiterator_current(dbiter, &node, name);
+		if (result != ISC_R_SUCCESS && result != DNS_R_NEWORIGIN) {
+			break;
+		}
+		dns_db_detachnode(work->db[0], &node);
+
+		if (work->options == DNS_DB_NSEC3ONLY) {
+			result = dns_db_findnsec3node(work->db[1], name, false,
+						      &node);
+		} else {
+			result = dns_db_findnode(work->db[1], name, false,
+						 &node);
+		}
+		if (result != ISC_R_SUCCESS) {
+			/* Try the next name instead */
+			result = ISC_R_SUCCESS;
+			continue;
+		}
+		dns_db_detachnode(work->db[1], &node);
+
+		shards[n].start = dns_fixedname_initname(&shards[n].fstart);
+		dns_name_copy(name, shards[n].start);
+		n++;
+	}
+	dns_dbiterator_destroy(&dbiter);
+
+	if (result != ISC_R_SUCCESS && result != ISC_R_NOMORE) {
+		return result;
+	}
+
+done:
+	for (unsigned int i = 0; i < n; i++) {
+		shards[i].end = (i + 1 < n) ? shards[i + 1].start : NULL;
+	}
+	*nshardsp = n;
+
+	return ISC_R_SUCCESS;
+}
+
+static isc_result_t
+diff_namespace(dns_db_t *dba, dns_dbversion_t *dbvera, dns_db_t *dbb,
+	       dns_dbversion_t *dbverb, unsigned int options,
+	       dns_diff_t *resultdiff) {
+	unsigned int maxshards = ISC_MIN(isc_os_ncpus(), DIFF_THREADS);
+	dwork_t work = {
+		.db = { dba, dbb },
+		.ver = { dbvera, dbverb },
+		.options = options,
+	};
+	unsigned int nthreads;
+	isc_thread_t *threads = NULL;
+	isc_result_t result;
+
+	work.shards = isc_mem_cget(resultdiff->mctx, maxshards,
+				   sizeof(work.shards[0]));
+
+	result = split_namespace(&work, work.shards, maxshards, &work.nshards);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	for (unsigned int i = 0; i < work.nshards; i++) {
+		dns_diff_init(resultdiff->mctx, &work.shards[i].diff);
+		work.shards[i].result = ISC_R_UNSET;
+	}
+
+	nthreads = ISC_MIN(work.nshards, maxshards);
+	if (nthreads > 1) {
+		threads = isc_mem_cget(resultdiff->mctx, nthreads,
+				       sizeof(threads[0]));
+		for (unsigned int i = 0; i < nthreads; i++) {
+			isc_thread_create(diff_thread, &work, &threads[i]);
+		}
+		for (unsigned int i = 0; i < nthreads; i++) {
+			isc_thread_join(threads[i], NULL);
+		}
+		isc_mem_cput(resultdiff->mctx, threads, nthreads,
+			     sizeof(threads[0]));
+	} else {
+		diff_thread(&work);
+	}
+
+	for (unsigned int i = 0; i < work.nshards; i++) {
+		dshard_t *shard = &work.shards[i];
+
+		if (result == ISC_R_SUCCESS) {
+			result = shard->result;
+		}
+		if (result == ISC_R_SUCCESS) {
+			ISC_LIST_APPENDLIST(resultdiff->tuples,
+					    shard->diff.tuples, link);
+		}
+		dns_diff_clear(&shard->diff);
+	}
+
+cleanup:
+	isc_mem_cput(resultdiff->mctx, work.shards, maxshards,
+		     sizeof(work.shards[0]));
+	return result;
+}
+
 /*
  * Compare the databases 'dba' and 'dbb' and generate a journal
  * entry containing the changes to make 'dba' from 'dbb' (note
@@ -2413,8 +3319,15 @@ dns_db_diffx(dns_diff_t *diff, dns_db_t *dba, dns_dbversion_t *dbvera,
 		}
 	}
 
-	CHECK(diff_namespace(dba, dbvera, dbb, dbverb, DNS_DB_NONSEC3, diff));
-	CHECK(diff_namespace(dba, dbvera, dbb, dbverb, DNS_DB_NSEC3ONLY, diff));
+	/*
+	 * A version doesn't differ from itself.
+	 */
+	if (dba != dbb || dbvera != dbverb) {
+		CHECK(diff_namespace(dba, dbvera, dbb, dbverb, DNS_DB_NONSEC3,
+				     diff));
+		CHECK(diff_namespace(dba, dbvera, dbb, dbverb,
+				     DNS_DB_NSEC3ONLY, diff));
+	}
 
 	if (journal != NULL) {
 		if (ISC_LIST_EMPTY(diff->tuples)) {
@@ -2472,6 +3385,69 @@ check_delta(unsigned char *buf, size_t size) {
 	return true;
 }
 
+/*
+ * Compute the names of the compacted journal being written and of the
+ * backup used while replacing the journal 'filename' with it.
+ */
+static void
+journal_compact_names(const char *filename, char *newname, size_t newsize,
+		      char *backup, size_t backupsize) {
+	size_t namelen;
+	int n;
+
+	namelen = strlen(filename);
+	if (namelen > 4U && strcmp(filename + namelen - 4, ".jnl") == 0) {
+		namelen -= 4;
+	}
+
+	n = snprintf(newname, newsize, "%.*s.jnw", (int)namelen, filename);
+	RUNTIME_CHECK(n >= 0 && (size_t)n < newsize);
+
+	n = snprintf(backup, backupsize, "%.*s.jbk", (int)namelen, filename);
+	RUNTIME_CHECK(n >= 0 && (size_t)n < backupsize);
+}
+
+/*
+ * Replace the journal 'filename' with the compacted journal 'newname'.
+ *
+ * With a UFS file system this should just succeed and be atomic.
+ * Any IXFR outs will just continue and the old journal will be
+ * removed on final close.
+ *
+ * With MSDOS / NTFS we need to do a two stage rename, triggered
+ * by EEXIST.  (If any IXFR's are running in other threads, however,
+ * this will fail, and the journal will not be compacted.  But
+ * if so, hopefully they'll be finished by the next time we
+ * compact.)
+ */
+static isc_result_t
+journal_replace(const char *newname, const char *filename, const char *backup,
+		bool is_backup) {
+	isc_result_t result;
+
+	if (rename(newname, filename) == -1) {
+		if (errno == EEXIST && !is_backup) {
+			result = isc_file_remove(backup);
+			if (result != ISC_R_SUCCESS &&
+			    result != ISC_R_FILENOTFOUND)
+			{
+				return result;
+			}
+			if (rename(filename, backup) == -1) {
+				return ISC_R_FAILURE;
+			}
+			if (rename(newname, filename) == -1) {
+				return ISC_R_FAILURE;
+			}
+			(void)isc_file_remove(backup);
+		} else {
+			return ISC_R_FAILURE;
+		}
+	}
+
+	return ISC_R_SUCCESS;
+}
+
 isc_result_t
 dns_journal_compact(isc_mem_t *mctx, char *filename, uint32_t serial,
 		    uint32_t flags, uint32_t target_size) {
@@ -2482,7 +3458,6 @@ dns_journal_compact(isc_mem_t *mctx, char *filename, uint32_t serial,
 	dns_journal_t *j2 = NULL;
 	journal_rawheader_t rawheader;
 	unsigned int len;
-	size_t namelen;
 	unsigned char *buf = NULL;
 	unsigned int size = 0;
 	isc_result_t result;
@@ -2495,18 +3470,8 @@ dns_journal_compact(isc_mem_t *mctx, char *filename, uint32_t serial,
 
 	REQUIRE(filename != NULL);
 
-	namelen = strlen(filename);
-	if (namelen > 4U && strcmp(filename + namelen - 4, ".jnl") == 0) {
-		namelen -= 4;
-	}
-
-	result = snprintf(newname, sizeof(newname), "%.*s.jnw", (int)namelen,
-			  filename);
-	RUNTIME_CHECK(result < sizeof(newname));
-
-	result = snprintf(backup, sizeof(backup), "%.*s.jbk", (int)namelen,
-			  filename);
-	RUNTIME_CHECK(result < sizeof(backup));
+	journal_compact_names(filename, newname, sizeof(newname), backup,
+			      sizeof(backup));
 
 	result = journal_open(mctx, filename, false, false, false, &j1);
 	if (result == ISC_R_NOTFOUND) {
@@ -2796,38 +3761,121 @@ dns_journal_compact(isc_mem_t *mctx, char *filename, uint32_t serial,
 	dns_journal_destroy(&j1);
 	dns_journal_destroy(&j2);
 
+	if ((flags & DNS_JOURNAL_COMPACTDEFER) != 0) {
+		/*
+		 * Leave the compacted journal for
+		 * dns_journal_compact_finish().
+		 */
+		return DNS_R_CONTINUE;
+	}
+
+	CHECK(journal_replace(newname, filename, backup, is_backup));
+
+	result = ISC_R_SUCCESS;
+
+failure:
+	(void)isc_file_remove(newname);
+	if (buf != NULL) {
+		isc_mem_put(mctx, buf, size);
+	}
+	if (j1 != NULL) {
+		dns_journal_destroy(&j1);
+	}
+	if (j2 != NULL) {
+		dns_journal_destroy(&j2);
+	}
+	return result;
+}
+
+isc_result_t
+dns_journal_compact_finish(isc_mem_t *mctx, char *filename) {
+	dns_journal_t *j1 = NULL;
+	dns_journal_t *j2 = NULL;
+	journal_rawheader_t rawheader;
+	journal_pos_t pos, newpos;
+	unsigned char *buf = NULL;
+	unsigned int size = 0;
+	isc_result_t result;
+	char newname[PATH_MAX];
+	char backup[PATH_MAX];
+	bool is_backup = false;
+
+	REQUIRE(filename != NULL);
+
+	journal_compact_names(filename, newname, sizeof(newname), backup,
+			      sizeof(backup));
+
+	result = journal_open(mctx, filename, false, false, false, &j1);
+	if (result == ISC_R_NOTFOUND) {
+		is_backup = true;
+		result = journal_open(mctx, backup, false, false, false, &j1);
+	}
+	CHECK(result);
+	CHECK(journal_open(mctx, newname, true, false, false, &j2));
+
 	/*
-	 * With a UFS file system this should just succeed and be atomic.
-	 * Any IXFR outs will just continue and the old journal will be
-	 * removed on final close.
-	 *
-	 * With MSDOS / NTFS we need to do a two stage rename, triggered
-	 * by EEXIST.  (If any IXFR's are running in other threads, however,
-	 * this will fail, and the journal will not be compacted.  But
-	 * if so, hopefully they'll be finished by the next time we
-	 * compact.)
+	 * Copy the transactions committed to the journal while it was
+	 * being compacted.  The compacted journal has to end with one of
+	 * its transactions; if it does not, the journal was replaced in
+	 * the meantime and the compacted journal is of no use.
 	 */
-	if (rename(newname, filename) == -1) {
-		if (errno == EEXIST && !is_backup) {
-			result = isc_file_remove(backup);
-			if (result != ISC_R_SUCCESS &&
-			    result != ISC_R_FILENOTFOUND)
-			{
-				goto failure;
-			}
-			if (rename(filename, backup) == -1) {
-				goto maperrno;
-			}
-			if (rename(newname, filename) == -1) {
-				goto maperrno;
-			}
-			(void)isc_file_remove(backup);
-		} else {
-		maperrno:
-			result = ISC_R_FAILURE;
-			goto failure;
+	pos = j2->header.end;
+	if (pos.serial != j1->header.end.serial) {
+		CHECK(journal_find(j1, j2->header.end.serial, &pos));
+	}
+	newpos = j2->header.end;
+	while (pos.serial != j1->header.end.serial) {
+		journal_xhdr_t xhdr;
+		uint32_t count;
+
+		CHECK(journal_seek(j1, pos.offset));
+		CHECK(journal_read_xhdr(j1, &xhdr));
+		if (xhdr.serial0 != pos.serial ||
+		    isc_serial_le(xhdr.serial1, xhdr.serial0))
+		{
+			CHECK(ISC_R_UNEXPECTED);
 		}
+
+		size = xhdr.size;
+		buf = isc_mem_get(mctx, size);
+		CHECK(journal_read(j1, buf, size));
+		count = (j1->xhdr_version == XHDR_VERSION2)
+				? xhdr.count
+				: rrcount(buf, size);
+
+		index_add(j2, &newpos);
+		CHECK(journal_seek(j2, newpos.offset));
+		CHECK(journal_write_xhdr(j2, size, count, xhdr.serial0,
+					 xhdr.serial1));
+		CHECK(journal_write(j2, buf, size));
+		isc_mem_put(mctx, buf, size);
+		buf = NULL;
+
+		newpos.serial = xhdr.serial1;
+		newpos.offset = j2->offset;
+		CHECK(journal_next(j1, &pos));
 	}
+	CHECK(journal_fsync(j2));
+
+	/*
+	 * Update the journal header and index.
+	 */
+	j2->header.end = newpos;
+	j2->header.sourceserial = j1->header.sourceserial;
+	j2->header.serialset = j1->header.serialset;
+	journal_header_encode(&j2->header, &rawheader);
+	CHECK(journal_seek(j2, 0));
+	CHECK(journal_write(j2, &rawheader, sizeof(rawheader)));
+	CHECK(index_to_disk(j2));
+	CHECK(journal_fsync(j2));
+
+	/*
+	 * Close both journals before trying to rename files.
+	 */
+	dns_journal_destroy(&j1);
+	dns_journal_destroy(&j2);
+
+	CHECK(journal_replace(newname, filename, backup, is_backup));
 
 	result = ISC_R_SUCCESS;
 
@@ -2845,26 +3893,43 @@ failure:
 	return result;
 }
 
+void
+dns_journal_compact_cancel(const char *filename) {
+	char newname[PATH_MAX];
+	char backup[PATH_MAX];
+
+	REQUIRE(filename != NULL);
+
+	journal_compact_names(filename, newname, sizeof(newname), backup,
+			      sizeof(backup));
+	(void)isc_file_remove(newname);
+}
+
+static void
+index_encode(dns_journal_t *j) {
+	unsigned char *p = j->rawindex;
+
+	for (unsigned int i = 0; i < j->header.index_size; i++) {
+		encode_uint32(j->index[i].serial, p);
+		p += 4;
+		encode_uint32(j->index[i].offset, p);
+		p += 4;
+	}
+	INSIST(p == j->rawindex + ISC_CHECKED_MUL(j->header.index_size,
+						  sizeof(journal_rawpos_t)));
+}
+
 static isc_result_t
 index_to_disk(dns_journal_t *j) {
 	isc_result_t result = ISC_R_SUCCESS;
 
 	if (j->header.index_size != 0) {
-		unsigned int i;
-		unsigned char *p;
 		unsigned int rawbytes;
 
 		rawbytes = ISC_CHECKED_MUL(j->header.index_size,
 					   sizeof(journal_rawpos_t));
 
-		p = j->rawindex;
-		for (i = 0; i < j->header.index_size; i++) {
-			encode_uint32(j->index[i].serial, p);
-			p += 4;
-			encode_uint32(j->index[i].offset, p);
-			p += 4;
-		}
-		INSIST(p == j->rawindex + rawbytes);
+		index_encode(j);
 
 		CHECK(journal_seek(j, sizeof(journal_rawheader_t)));
 		CHECK(journal_write(j, j->rawindex, rawbytes));
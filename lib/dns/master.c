@@ -15,19 +15,27 @@
 
 #include <inttypes.h>
 #include <stdbool.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <isc/async.h>
 #include <isc/atomic.h>
+#include <isc/condition.h>
+#include <isc/errno.h>
+#include <isc/file.h>
 #include <isc/lex.h>
 #include <isc/loop.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/os.h>
 #include <isc/refcount.h>
 #include <isc/result.h>
 #include <isc/serial.h>
 #include <isc/stdio.h>
 #include <isc/stdtime.h>
 #include <isc/string.h>
+#include <isc/thread.h>
 #include <isc/util.h>
 #include <isc/work.h>
 
@@ -87,6 +95,17 @@
 #define DNS_MASTER_LHS 2048
 #define DNS_MASTER_RHS MINTSIZ
 
+/*%
+ * Text files of at least CHUNK_MINFILE bytes are split in chunks of about
+ * CHUNK_SIZE bytes that are parsed on up to CHUNK_THREADS threads.  Raw
+ * files with an index are split in chunks of about CHUNK_SIZE bytes
+ * whatever their size, as they are only checked by the threads.
+ */
+#define CHUNK_MINFILE (64 * 1024 * 1024)
+#define CHUNK_SIZE    (8 * 1024 * 1024)
+#define CHUNK_THREADS 8
+#define CHUNK_MAXSIZE (1024 * 1024 * 1024)
+
 #define CHECKNAMESFAIL(x) (((x) & DNS_MASTER_CHECKNAMESFAIL) != 0)
 
 typedef ISC_LIST(dns_rdatalist_t) rdatalist_head_t;
@@ -127,7 +146,9 @@ struct dns_loadctx {
 	uint32_t default_ttl;
 	dns_rdataclass_t zclass;
 	dns_fixedname_t fixed_top;
-	dns_name_t *top; /*%< top of zone */
+	dns_name_t *top;       /*%< top of zone */
+	char *chunkfile;       /*%< file to be parsed in chunks */
+	isc_buffer_t *records; /*%< rdatasets parsed from a chunk */
 
 	/* Members specific to the raw format: */
 	FILE *f;
@@ -166,6 +187,46 @@ struct dns_incctx {
 	unsigned int current_line;
 };
 
+/*%
+ * A part of a text file that starts with an owner name, parsed by one of
+ * the load_chunks() threads.  The origin and the default TTL are those in
+ * effect at the start of the chunk.
+ *
+ * In a raw file with an index, a chunk is a run of groups that is checked
+ * by one of the threads and then added to the database from the mapped
+ * file.
+ */
+typedef struct chunk {
+	off_t offset;
+	size_t length;
+	unsigned long line;
+	dns_fixedname_t origin;
+	uint32_t ttl;
+	bool done;              /*%< locked by cl->lock */
+	isc_result_t result;   /*%< set by the thread */
+	isc_buffer_t *records; /*%< set by the thread */
+} chunk_t;
+
+typedef struct chunkload {
+	dns_loadctx_t *lctx;
+	chunk_t *chunks;
+	unsigned int nchunks;
+	unsigned int maxchunks;
+	dns_rdata_t *rdata; /*%< used by the replay */
+	unsigned int nrdata;
+	unsigned char *map; /*%< the mapped raw file */
+	size_t mapsize;
+	isc_result_t (*parse)(struct chunkload *, chunk_t *);
+	isc_result_t (*replay)(struct chunkload *, chunk_t *);
+
+	isc_mutex_t lock;
+	isc_condition_t ready; /*%< a chunk has been parsed */
+	isc_condition_t space; /*%< a chunk has been replayed */
+	unsigned int next;     /*%< the next chunk to parse */
+	unsigned int window;   /*%< don't parse chunks past this one */
+	bool shutdown;
+} chunkload_t;
+
 #define DNS_LCTX_MAGIC	     ISC_MAGIC('L', 'c', 't', 'x')
 #define DNS_LCTX_VALID(lctx) ISC_MAGIC_VALID(lctx, DNS_LCTX_MAGIC)
 
@@ -177,6 +238,18 @@ openfile_text(dns_loadctx_t *lctx, const char *master_file);
 static isc_result_t
 load_text(dns_loadctx_t *lctx);
 
+static isc_result_t
+scan_chunks(dns_loadctx_t *lctx, chunkload_t *cl);
+
+static isc_result_t
+parse_chunk(chunkload_t *cl, chunk_t *chunk);
+
+static isc_result_t
+replay_chunk(chunkload_t *cl, chunk_t *chunk);
+
+static isc_result_t
+load_chunks(dns_loadctx_t *lctx, chunkload_t *cl);
+
 static isc_result_t
 openfile_raw(dns_loadctx_t *lctx, const char *master_file);
 
@@ -190,6 +263,13 @@ static isc_result_t
 commit(dns_rdatacallbacks_t *, dns_loadctx_t *, rdatalist_head_t *,
        dns_name_t *, const char *, unsigned int);
 
+static isc_result_t
+adddataset(dns_rdatacallbacks_t *, dns_name_t *, dns_rdataset_t *,
+	   const char *, unsigned int);
+
+static uint32_t
+resign_fromlist(dns_rdatalist_t *, dns_loadctx_t *);
+
 static bool
 is_glue(rdatalist_head_t *, dns_name_t *);
 
@@ -464,6 +544,13 @@ loadctx_destroy(dns_loadctx_t *lctx) {
 		isc_lex_destroy(&lctx->lex);
 	}
 
+	if (lctx->chunkfile != NULL) {
+		isc_mem_free(lctx->mctx, lctx->chunkfile);
+	}
+	if (lctx->records != NULL) {
+		isc_buffer_free(&lctx->records);
+	}
+
 	isc_mem_putanddetach(&lctx->mctx, lctx, sizeof(*lctx));
 }
 
@@ -1006,7 +1093,28 @@ check_wildcard(dns_incctx_t *ictx, const char *source, unsigned long line,
 
 static isc_result_t
 openfile_text(dns_loadctx_t *lctx, const char *master_file) {
-	return isc_lex_openfile(lctx->lex, master_file);
+	isc_result_t result;
+	off_t size;
+
+	result = isc_lex_openfile(lctx->lex, master_file);
+	if (result != ISC_R_SUCCESS) {
+		return result;
+	}
+
+	/*
+	 * Large files are parsed on several threads, see load_chunks().
+	 * This is not done for the included files.
+	 */
+	if (lctx->chunkfile == NULL && !lctx->seen_include &&
+	    (lctx->options & DNS_MASTER_NOTHREADS) == 0 &&
+	    isc_os_ncpus() > 1 &&
+	    isc_file_getsize(master_file, &size) == ISC_R_SUCCESS &&
+	    size >= CHUNK_MINFILE)
+	{
+		lctx->chunkfile = isc_mem_strdup(lctx->mctx, master_file);
+	}
+
+	return ISC_R_SUCCESS;
 }
 
 static int
@@ -1069,8 +1177,19 @@ load_text(dns_loadctx_t *lctx) {
 	char classname1[DNS_RDATACLASS_FORMATSIZE];
 	char classname2[DNS_RDATACLASS_FORMATSIZE];
 	unsigned int options = 0;
+	chunkload_t cl;
 
 	REQUIRE(DNS_LCTX_VALID(lctx));
+
+	/*
+	 * Fall back to parsing the file here when it can't be split.
+	 */
+	if (lctx->chunkfile != NULL &&
+	    scan_chunks(lctx, &cl) == ISC_R_SUCCESS)
+	{
+		return load_chunks(lctx, &cl);
+	}
+
 	callbacks = lctx->callbacks;
 	mctx = lctx->mctx;
 	ictx = lctx->inc;
@@ -2181,6 +2300,567 @@ cleanup:
 	return result;
 }
 
+/*
+ * Parallel parsing of large text files.
+ *
+ * The file is scanned once, without being parsed, to split it in chunks
+ * that start with an explicit owner name, and to track the $ORIGIN and
+ * $TTL directives so that each chunk can be parsed on its own.  The
+ * chunks are then parsed by load_text() on several threads, with
+ * commit() keeping the rdatasets rather than adding them, and the main
+ * thread adds them to the database in file order.  At most two chunks
+ * per thread are kept parsed ahead of the one being added.
+ *
+ * Files that have a $INCLUDE or a $DATE directive, or no $TTL directive
+ * before the split points, are parsed on one thread.
+ */
+
+static chunk_t *
+add_chunk(chunkload_t *cl, off_t offset, unsigned long line,
+	  dns_name_t *origin, uint32_t ttl) {
+	chunk_t *chunk = NULL;
+
+	if (cl->nchunks > 0) {
+		chunk = &cl->chunks[cl->nchunks - 1];
+		chunk->length = offset - chunk->offset;
+	}
+
+	if (cl->nchunks == cl->maxchunks) {
+		unsigned int newmax = cl->maxchunks + 64;
+		cl->chunks = isc_mem_creget(cl->lctx->mctx, cl->chunks,
+					    cl->maxchunks, newmax,
+					    sizeof(cl->chunks[0]));
+		cl->maxchunks = newmax;
+	}
+
+	chunk = &cl->chunks[cl->nchunks++];
+	*chunk = (chunk_t){
+		.offset = offset,
+		.line = line,
+		.ttl = ttl,
+		.result = ISC_R_UNSET,
+	};
+	dns_name_copy(origin, dns_fixedname_initname(&chunk->origin));
+
+	return chunk;
+}
+
+static void
+free_chunks(chunkload_t *cl) {
+	for (unsigned int i = 0; i < cl->nchunks; i++) {
+		if (cl->chunks[i].records != NULL) {
+			isc_buffer_free(&cl->chunks[i].records);
+		}
+	}
+	if (cl->chunks != NULL) {
+		isc_mem_cput(cl->lctx->mctx, cl->chunks, cl->maxchunks,
+			     sizeof(cl->chunks[0]));
+	}
+	if (cl->rdata != NULL) {
+		isc_mem_cput(cl->lctx->mctx, cl->rdata, cl->nrdata,
+			     sizeof(cl->rdata[0]));
+	}
+}
+
+/*
+ * Apply a directive line found by scan_chunks() to 'origin' and '*ttlp'.
+ * The directives that scan_chunks() can't follow return
+ * ISC_R_NOTIMPLEMENTED.
+ */
+static isc_result_t
+scan_directive(char *text, bool truncated, dns_name_t *origin,
+	       uint32_t *ttlp, bool *ttl_knownp) {
+	isc_result_t result;
+	isc_textregion_t r;
+	isc_buffer_t b;
+	dns_fixedname_t fname;
+	dns_name_t *name = NULL;
+	char *directive = NULL, *arg = NULL, *last = NULL;
+	bool origin_directive;
+
+	directive = strtok_r(text, " \t\r", &last);
+	if (directive == NULL) {
+		return ISC_R_SUCCESS;
+	}
+	if (strcasecmp(directive, "$INCLUDE") == 0 ||
+	    strcasecmp(directive, "$DATE") == 0)
+	{
+		return ISC_R_NOTIMPLEMENTED;
+	}
+
+	origin_directive = (strcasecmp(directive, "$ORIGIN") == 0);
+	if (!origin_directive && strcasecmp(directive, "$TTL") != 0) {
+		return ISC_R_SUCCESS;
+	}
+
+	/*
+	 * Leave anything but a plain argument to the parser.
+	 */
+	arg = strtok_r(NULL, " \t\r", &last);
+	if (truncated || arg == NULL || strpbrk(arg, "\\\"()") != NULL) {
+		return ISC_R_NOTIMPLEMENTED;
+	}
+
+	if (origin_directive) {
+		name = dns_fixedname_initname(&fname);
+		isc_buffer_constinit(&b, arg, strlen(arg));
+		isc_buffer_add(&b, strlen(arg));
+		result = dns_name_fromtext(name, &b, origin, 0, NULL);
+		if (result != ISC_R_SUCCESS) {
+			return ISC_R_NOTIMPLEMENTED;
+		}
+		dns_name_copy(name, origin);
+		return ISC_R_SUCCESS;
+	}
+
+	r.base = arg;
+	r.length = strlen(arg);
+	result = dns_ttl_fromtext(&r, ttlp);
+	if (result != ISC_R_SUCCESS) {
+		return ISC_R_NOTIMPLEMENTED;
+	}
+	if (*ttlp > 0x7fffffffUL) {
+		*ttlp = 0;
+	}
+	*ttl_knownp = true;
+
+	return ISC_R_SUCCESS;
+}
+
+/*
+ * Split 'lctx->chunkfile' in chunks, following the quoting, the escapes,
+ * the comments and the parentheses like the lexer does so that a chunk
+ * only starts at the first line of a record.
+ */
+static isc_result_t
+scan_chunks(dns_loadctx_t *lctx, chunkload_t *cl) {
+	isc_result_t result;
+	FILE *f = NULL;
+	unsigned char *buf = NULL;
+	size_t n;
+	off_t offset = 0;
+	unsigned long line = 1;
+	unsigned int depth = 0;
+	bool quote = false, escape = false, comment = false;
+	bool linestart = true, indirective = false, truncated = false;
+	char text[1024];
+	size_t textlen = 0;
+	dns_fixedname_t forigin;
+	dns_name_t *origin = dns_fixedname_initname(&forigin);
+	chunk_t *chunk = NULL;
+	uint32_t ttl = lctx->default_ttl;
+	bool ttl_known = lctx->default_ttl_known;
+
+	*cl = (chunkload_t){
+		.lctx = lctx,
+		.parse = parse_chunk,
+		.replay = replay_chunk,
+	};
+	dns_name_copy(lctx->inc->origin, origin);
+
+	result = isc_stdio_open(lctx->chunkfile, "r", &f);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	buf = isc_mem_get(lctx->mctx, TSIZ);
+	chunk = add_chunk(cl, 0, 1, origin, ttl);
+
+	do {
+		result = isc_stdio_read(buf, 1, TSIZ, f, &n);
+		if (result != ISC_R_SUCCESS && result != ISC_R_EOF) {
+			goto cleanup;
+		}
+
+		for (size_t i = 0; i < n; i++, offset++) {
+			unsigned char c = buf[i];
+
+			if (linestart) {
+				linestart = false;
+				if (c == '$') {
+					indirective = true;
+					truncated = false;
+					textlen = 0;
+				} else if (ttl_known &&
+					   strchr(" \t\r\n;()\"", c) == NULL &&
+					   offset - chunk->offset >= CHUNK_SIZE)
+				{
+					chunk = add_chunk(cl, offset, line,
+							  origin, ttl);
+				}
+			}
+
+			if (indirective && !comment && c != '\n' && c != ';') {
+				if (textlen < sizeof(text) - 1) {
+					text[textlen++] = c;
+				} else {
+					truncated = true;
+				}
+			}
+
+			if (escape) {
+				escape = false;
+				if (c == '\n') {
+					line++;
+				}
+				continue;
+			}
+
+			if (quote) {
+				if (c == '\\') {
+					escape = true;
+				} else if (c == '"') {
+					quote = false;
+				}
+				if (c != '\n') {
+					continue;
+				}
+				quote = false;
+			}
+
+			if (comment && c != '\n') {
+				continue;
+			}
+
+			switch (c) {
+			case '\\':
+				escape = true;
+				break;
+			case '"':
+				quote = true;
+				break;
+			case ';':
+				comment = true;
+				break;
+			case '(':
+				depth++;
+				break;
+			case ')':
+				if (depth > 0) {
+					depth--;
+				}
+				break;
+			case '\n':
+				comment = false;
+				line++;
+				if (depth > 0) {
+					break;
+				}
+				linestart = true;
+				if (!indirective) {
+					break;
+				}
+				indirective = false;
+				text[textlen] = '\0';
+				result = scan_directive(text, truncated,
+							origin, &ttl,
+							&ttl_known);
+				if (result != ISC_R_SUCCESS) {
+					goto cleanup;
+				}
+				break;
+			default:
+				break;
+			}
+		}
+	} while (result == ISC_R_SUCCESS);
+
+	if (indirective) {
+		text[textlen] = '\0';
+		result = scan_directive(text, truncated, origin, &ttl,
+					&ttl_known);
+		if (result != ISC_R_SUCCESS) {
+			goto cleanup;
+		}
+	}
+
+	chunk->length = offset - chunk->offset;
+
+	/*
+	 * Each chunk is read in a buffer of its own.
+	 */
+	result = ISC_R_SUCCESS;
+	for (unsigned int i = 0; i < cl->nchunks; i++) {
+		if (cl->chunks[i].length > CHUNK_MAXSIZE) {
+			result = ISC_R_NOTIMPLEMENTED;
+		}
+	}
+	if (cl->nchunks < 2) {
+		result = ISC_R_NOTIMPLEMENTED;
+	}
+
+cleanup:
+	if (buf != NULL) {
+		isc_mem_put(lctx->mctx, buf, TSIZ);
+	}
+	if (f != NULL) {
+		(void)isc_stdio_close(f);
+	}
+	if (result != ISC_R_SUCCESS) {
+		free_chunks(cl);
+	}
+	return result;
+}
+
+/*
+ * Parse a chunk, keeping its rdatasets in 'chunk->records'.
+ */
+static isc_result_t
+parse_chunk(chunkload_t *cl, chunk_t *chunk) {
+	isc_result_t result;
+	dns_loadctx_t *lctx = cl->lctx;
+	dns_loadctx_t *clctx = NULL;
+	dns_rdatacallbacks_t callbacks = *lctx->callbacks;
+	isc_buffer_t *text = NULL;
+	FILE *f = NULL;
+
+	/*
+	 * The database transaction is opened by load_chunks().
+	 */
+	callbacks.setup = NULL;
+	callbacks.commit = NULL;
+
+	isc_buffer_allocate(lctx->mctx, &text, chunk->length);
+	result = isc_stdio_open(lctx->chunkfile, "r", &f);
+	if (result == ISC_R_SUCCESS) {
+		result = isc_stdio_seek(f, chunk->offset, SEEK_SET);
+	}
+	if (result == ISC_R_SUCCESS) {
+		result = isc_stdio_read(isc_buffer_base(text), 1,
+					chunk->length, f, NULL);
+	}
+	if (result != ISC_R_SUCCESS) {
+		(*callbacks.error)(&callbacks, "dns_master_load: %s: %s",
+				   lctx->chunkfile, isc_result_totext(result));
+		goto cleanup;
+	}
+	isc_buffer_add(text, chunk->length);
+
+	loadctx_create(dns_masterformat_text, lctx->mctx,
+		       lctx->options | DNS_MASTER_NOINCLUDE, lctx->resign,
+		       lctx->top, lctx->zclass,
+		       dns_fixedname_name(&chunk->origin), &callbacks, NULL,
+		       NULL, NULL, NULL, NULL, &clctx);
+	clctx->maxttl = lctx->maxttl;
+	clctx->now = lctx->now;
+	clctx->ttl = chunk->ttl;
+	clctx->ttl_known = true;
+	clctx->default_ttl = chunk->ttl;
+	clctx->default_ttl_known = true;
+	isc_buffer_allocate(lctx->mctx, &clctx->records, TSIZ);
+
+	RUNTIME_CHECK(isc_lex_openbuffer(clctx->lex, text) == ISC_R_SUCCESS);
+	RUNTIME_CHECK(isc_lex_setsourcename(clctx->lex, lctx->chunkfile) ==
+		      ISC_R_SUCCESS);
+	RUNTIME_CHECK(isc_lex_setsourceline(clctx->lex, chunk->line) ==
+		      ISC_R_SUCCESS);
+
+	result = load_text(clctx);
+
+	chunk->records = clctx->records;
+	clctx->records = NULL;
+
+cleanup:
+	if (clctx != NULL) {
+		dns_loadctx_detach(&clctx);
+	}
+	if (f != NULL) {
+		(void)isc_stdio_close(f);
+	}
+	isc_buffer_free(&text);
+	return result;
+}
+
+static void *
+chunk_thread(void *arg) {
+	chunkload_t *cl = arg;
+
+	LOCK(&cl->lock);
+	while (!cl->shutdown && cl->next < cl->nchunks) {
+		chunk_t *chunk = NULL;
+
+		if (cl->next >= cl->window) {
+			WAIT(&cl->space, &cl->lock);
+			continue;
+		}
+
+		chunk = &cl->chunks[cl->next++];
+		UNLOCK(&cl->lock);
+
+		chunk->result = (cl->parse)(cl, chunk);
+
+		LOCK(&cl->lock);
+		chunk->done = true;
+		BROADCAST(&cl->ready);
+	}
+	UNLOCK(&cl->lock);
+
+	return NULL;
+}
+
+/*
+ * Add the rdatasets kept from a chunk to the database.
+ */
+static isc_result_t
+replay_chunk(chunkload_t *cl, chunk_t *chunk) {
+	isc_result_t result = ISC_R_SUCCESS;
+	dns_loadctx_t *lctx = cl->lctx;
+	isc_buffer_t *records = chunk->records;
+
+	while (records != NULL && isc_buffer_remaininglength(records) > 0) {
+		dns_name_t owner;
+		dns_rdatalist_t rdatalist;
+		dns_rdataset_t dataset;
+		isc_region_t r;
+		unsigned int line, count;
+		bool resign;
+
+		line = isc_buffer_getuint32(records);
+		r.length = isc_buffer_getuint8(records);
+		r.base = isc_buffer_current(records);
+		isc_buffer_forward(records, r.length);
+		dns_name_init(&owner, NULL);
+		dns_name_fromregion(&owner, &r);
+
+		dns_rdatalist_init(&rdatalist);
+		rdatalist.rdclass = lctx->zclass;
+		rdatalist.type = isc_buffer_getuint16(records);
+		rdatalist.covers = isc_buffer_getuint16(records);
+		rdatalist.ttl = isc_buffer_getuint32(records);
+		resign = isc_buffer_getuint8(records);
+
+		dns_rdataset_init(&dataset);
+		dataset.resign = isc_buffer_getuint32(records);
+
+		count = isc_buffer_getuint16(records);
+		if (count > cl->nrdata) {
+			cl->rdata = isc_mem_creget(lctx->mctx, cl->rdata,
+						   cl->nrdata, count,
+						   sizeof(cl->rdata[0]));
+			cl->nrdata = count;
+		}
+		for (unsigned int i = 0; i < count; i++) {
+			dns_rdata_t *rdata = &cl->rdata[i];
+
+			r.length = isc_buffer_getuint16(records);
+			r.base = isc_buffer_current(records);
+			isc_buffer_forward(records, r.length);
+			dns_rdata_init(rdata);
+			dns_rdata_fromregion(rdata, rdatalist.rdclass,
+					     rdatalist.type, &r);
+			ISC_LIST_APPEND(rdatalist.rdata, rdata, link);
+		}
+
+		dns_rdatalist_tordataset(&rdatalist, &dataset);
+		dataset.trust = dns_trust_ultimate;
+		if (resign) {
+			dataset.attributes |= DNS_RDATASETATTR_RESIGN;
+		}
+
+		result = adddataset(lctx->callbacks, &owner, &dataset,
+				    lctx->chunkfile, line);
+		if (MANYERRS(lctx, result)) {
+			SETRESULT(lctx, result);
+			result = ISC_R_SUCCESS;
+		} else if (result != ISC_R_SUCCESS) {
+			break;
+		}
+	}
+
+	return result;
+}
+
+static isc_result_t
+load_chunks(dns_loadctx_t *lctx, chunkload_t *cl) {
+	isc_result_t result = ISC_R_SUCCESS;
+	dns_rdatacallbacks_t *callbacks = lctx->callbacks;
+	unsigned int nthreads;
+	isc_thread_t *threads = NULL;
+
+	nthreads = ISC_MIN(isc_os_ncpus(), CHUNK_THREADS);
+	nthreads = ISC_MIN(nthreads, cl->nchunks);
+	cl->window = 2 * nthreads;
+	isc_mutex_init(&cl->lock);
+	isc_condition_init(&cl->ready);
+	isc_condition_init(&cl->space);
+
+	threads = isc_mem_cget(lctx->mctx, nthreads, sizeof(threads[0]));
+	for (unsigned int i = 0; i < nthreads; i++) {
+		isc_thread_create(chunk_thread, cl, &threads[i]);
+	}
+
+	/* open a database transaction */
+	if (callbacks->setup != NULL) {
+		callbacks->setup(callbacks->add_private);
+	}
+
+	for (unsigned int i = 0; i < cl->nchunks; i++) {
+		chunk_t *chunk = &cl->chunks[i];
+
+		LOCK(&cl->lock);
+		while (!chunk->done) {
+			WAIT(&cl->ready, &cl->lock);
+		}
+		UNLOCK(&cl->lock);
+
+		if (atomic_load_acquire(&lctx->canceled)) {
+			result = ISC_R_CANCELED;
+			(*callbacks->error)(callbacks, "dns_master_load: %s: %s",
+					    lctx->chunkfile,
+					    isc_result_totext(result));
+			break;
+		}
+
+		/*
+		 * The errors have been logged while parsing the chunk.
+		 */
+		result = chunk->result;
+		if (MANYERRS(lctx, result)) {
+			SETRESULT(lctx, result);
+		} else if (result != ISC_R_SUCCESS) {
+			break;
+		}
+
+		result = (cl->replay)(cl, chunk);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+		if (chunk->records != NULL) {
+			isc_buffer_free(&chunk->records);
+		}
+
+		LOCK(&cl->lock);
+		cl->window++;
+		BROADCAST(&cl->space);
+		UNLOCK(&cl->lock);
+	}
+
+	/* commit the database transaction */
+	if (callbacks->commit != NULL) {
+		callbacks->commit(callbacks->add_private);
+	}
+
+	LOCK(&cl->lock);
+	cl->shutdown = true;
+	BROADCAST(&cl->space);
+	UNLOCK(&cl->lock);
+
+	for (unsigned int i = 0; i < nthreads; i++) {
+		isc_thread_join(threads[i], NULL);
+	}
+	isc_mem_cput(lctx->mctx, threads, nthreads, sizeof(threads[0]));
+
+	isc_condition_destroy(&cl->space);
+	isc_condition_destroy(&cl->ready);
+	isc_mutex_destroy(&cl->lock);
+	free_chunks(cl);
+
+	if (result == ISC_R_SUCCESS) {
+		result = lctx->result;
+	}
+	return result;
+}
+
 static isc_result_t
 pushfile(const char *master_file, dns_name_t *origin, dns_loadctx_t *lctx) {
 	isc_result_t result;
@@ -2305,6 +2985,7 @@ load_header(dns_loadctx_t *lctx) {
 		remainder = sizeof(header.dumptime);
 		break;
 	case DNS_RAWFORMAT_VERSION:
+	case DNS_RAWFORMAT_INDEXED:
 		remainder = sizeof(header) - commonlen;
 		break;
 	default:
@@ -2323,7 +3004,7 @@ load_header(dns_loadctx_t *lctx) {
 
 	isc_buffer_add(&target, (unsigned int)remainder);
 	header.dumptime = isc_buffer_getuint32(&target);
-	if (header.version == DNS_RAWFORMAT_VERSION) {
+	if (header.version >= DNS_RAWFORMAT_VERSION) {
 		header.flags = isc_buffer_getuint32(&target);
 		header.sourceserial = isc_buffer_getuint32(&target);
 		header.lastxfrin = isc_buffer_getuint32(&target);
@@ -2345,6 +3026,365 @@ openfile_raw(dns_loadctx_t *lctx, const char *master_file) {
 				 isc_result_totext(result));
 	}
 
+	/*
+	 * Files with an index are loaded with load_chunks(), which needs
+	 * the name for its messages.
+	 */
+	if (result == ISC_R_SUCCESS && lctx->chunkfile == NULL) {
+		lctx->chunkfile = isc_mem_strdup(lctx->mctx, master_file);
+	}
+
+	return result;
+}
+
+/*
+ * Check a group of a raw file with an index: everything that
+ * replay_rawchunk() relies on, and each rdata like load_raw() does.
+ */
+static isc_result_t
+check_rawgroup(dns_loadctx_t *lctx, isc_buffer_t *group,
+	       unsigned char *scratch) {
+	isc_result_t result;
+	dns_fixedname_t fixed;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	dns_rdatacallbacks_t *callbacks = lctx->callbacks;
+	unsigned int namelen, nsets;
+
+	if (isc_buffer_remaininglength(group) < sizeof(uint16_t)) {
+		return ISC_R_RANGE;
+	}
+	namelen = isc_buffer_getuint16(group);
+	if (isc_buffer_remaininglength(group) < namelen + sizeof(uint16_t)) {
+		return ISC_R_RANGE;
+	}
+	isc_buffer_setactive(group, namelen);
+	result = dns_name_fromwire(name, group, DNS_DECOMPRESS_NEVER, NULL);
+	if (result != ISC_R_SUCCESS) {
+		return result;
+	}
+	if (isc_buffer_activelength(group) != 0) {
+		return ISC_R_RANGE;
+	}
+
+	nsets = isc_buffer_getuint16(group);
+	for (unsigned int i = 0; i < nsets; i++) {
+		dns_rdatatype_t type;
+		dns_ttl_t ttl;
+		unsigned int count;
+
+		if (isc_buffer_remaininglength(group) < 10) {
+			return ISC_R_RANGE;
+		}
+		type = isc_buffer_getuint16(group);
+		(void)isc_buffer_getuint16(group);
+		ttl = isc_buffer_getuint32(group);
+		count = isc_buffer_getuint16(group);
+		if (count == 0) {
+			return ISC_R_RANGE;
+		}
+
+		if ((lctx->options & DNS_MASTER_CHECKTTL) != 0 &&
+		    ttl > lctx->maxttl)
+		{
+			(callbacks->error)(callbacks,
+					   "dns_master_load: "
+					   "TTL %d exceeds configured "
+					   "max-zone-ttl %d",
+					   ttl, lctx->maxttl);
+			return ISC_R_RANGE;
+		}
+
+		for (unsigned int j = 0; j < count; j++) {
+			dns_rdata_t rdata = DNS_RDATA_INIT;
+			isc_buffer_t target;
+			unsigned int rdlen;
+
+			if (isc_buffer_remaininglength(group) <
+			    sizeof(uint16_t))
+			{
+				return ISC_R_RANGE;
+			}
+			rdlen = isc_buffer_getuint16(group);
+			if (isc_buffer_remaininglength(group) < rdlen) {
+				return ISC_R_RANGE;
+			}
+
+			/*
+			 * The file is mapped read-only, so the rdata is
+			 * decoded into 'scratch'.
+			 */
+			isc_buffer_setactive(group, rdlen);
+			isc_buffer_init(&target, scratch, 0xffff);
+			result = dns_rdata_fromwire(&rdata, lctx->zclass, type,
+						    group, DNS_DECOMPRESS_NEVER,
+						    &target);
+			if (result != ISC_R_SUCCESS) {
+				return result;
+			}
+			if (isc_buffer_activelength(group) != 0) {
+				return ISC_R_RANGE;
+			}
+		}
+	}
+
+	if (isc_buffer_remaininglength(group) != 0) {
+		return ISC_R_RANGE;
+	}
+
+	return ISC_R_SUCCESS;
+}
+
+static isc_result_t
+check_rawchunk(chunkload_t *cl, chunk_t *chunk) {
+	isc_result_t result = ISC_R_SUCCESS;
+	dns_loadctx_t *lctx = cl->lctx;
+	isc_buffer_t source;
+	unsigned char *scratch = isc_mem_get(lctx->mctx, 0xffff);
+
+	isc_buffer_init(&source, cl->map + chunk->offset, chunk->length);
+	isc_buffer_add(&source, chunk->length);
+
+	while (result == ISC_R_SUCCESS &&
+	       isc_buffer_remaininglength(&source) > 0)
+	{
+		isc_buffer_t group;
+		unsigned int length;
+
+		if (isc_buffer_remaininglength(&source) < sizeof(uint32_t)) {
+			result = ISC_R_RANGE;
+			break;
+		}
+		length = isc_buffer_getuint32(&source);
+		if (isc_buffer_remaininglength(&source) < length) {
+			result = ISC_R_RANGE;
+			break;
+		}
+
+		isc_buffer_init(&group, isc_buffer_current(&source), length);
+		isc_buffer_add(&group, length);
+		result = check_rawgroup(lctx, &group, scratch);
+		if (result != ISC_R_SUCCESS) {
+			(*lctx->callbacks->error)(
+				lctx->callbacks,
+				"dns_master_load: %s: offset %" PRIu64 ": %s",
+				lctx->chunkfile,
+				(uint64_t)(chunk->offset +
+					   isc_buffer_consumedlength(&source)),
+				isc_result_totext(result));
+		}
+		isc_buffer_forward(&source, length);
+	}
+
+	isc_mem_put(lctx->mctx, scratch, 0xffff);
+	return result;
+}
+
+/*
+ * Add the groups of a chunk to the database.  The names and the rdata
+ * point into the mapped file, which is only unmapped once they have all
+ * been added.
+ */
+static isc_result_t
+replay_rawchunk(chunkload_t *cl, chunk_t *chunk) {
+	isc_result_t result = ISC_R_SUCCESS;
+	dns_loadctx_t *lctx = cl->lctx;
+	isc_buffer_t source;
+
+	/*
+	 * Like in load_raw(), any error is fatal, and the groups that
+	 * haven't been checked aren't safe to walk.
+	 */
+	if (chunk->result != ISC_R_SUCCESS) {
+		return chunk->result;
+	}
+
+	isc_buffer_init(&source, cl->map + chunk->offset, chunk->length);
+	isc_buffer_add(&source, chunk->length);
+
+	while (result == ISC_R_SUCCESS &&
+	       isc_buffer_remaininglength(&source) > 0)
+	{
+		dns_name_t owner;
+		isc_region_t r;
+		unsigned int nsets;
+
+		(void)isc_buffer_getuint32(&source);
+		r.length = isc_buffer_getuint16(&source);
+		r.base = isc_buffer_current(&source);
+		isc_buffer_forward(&source, r.length);
+		dns_name_init(&owner, NULL);
+		dns_name_fromregion(&owner, &r);
+
+		nsets = isc_buffer_getuint16(&source);
+		for (unsigned int i = 0; i < nsets; i++) {
+			dns_rdatalist_t rdatalist;
+			dns_rdataset_t dataset;
+			unsigned int count;
+
+			dns_rdatalist_init(&rdatalist);
+			rdatalist.rdclass = lctx->zclass;
+			rdatalist.type = isc_buffer_getuint16(&source);
+			rdatalist.covers = isc_buffer_getuint16(&source);
+			rdatalist.ttl = isc_buffer_getuint32(&source);
+
+			count = isc_buffer_getuint16(&source);
+			if (count > cl->nrdata) {
+				cl->rdata = isc_mem_creget(
+					lctx->mctx, cl->rdata, cl->nrdata,
+					count, sizeof(cl->rdata[0]));
+				cl->nrdata = count;
+			}
+			for (unsigned int j = 0; j < count; j++) {
+				dns_rdata_t *rdata = &cl->rdata[j];
+
+				r.length = isc_buffer_getuint16(&source);
+				r.base = isc_buffer_current(&source);
+				isc_buffer_forward(&source, r.length);
+				dns_rdata_init(rdata);
+				dns_rdata_fromregion(rdata, rdatalist.rdclass,
+						     rdatalist.type, &r);
+				ISC_LIST_APPEND(rdatalist.rdata, rdata, link);
+			}
+
+			dns_rdataset_init(&dataset);
+			dns_rdatalist_tordataset(&rdatalist, &dataset);
+			dataset.trust = dns_trust_ultimate;
+			if (dataset.type == dns_rdatatype_rrsig &&
+			    (lctx->options & DNS_MASTER_RESIGN) != 0)
+			{
+				dataset.attributes |= DNS_RDATASETATTR_RESIGN;
+				dataset.resign = resign_fromlist(&rdatalist,
+								 lctx);
+			}
+
+			result = adddataset(lctx->callbacks, &owner, &dataset,
+					    NULL, 0);
+			if (MANYERRS(lctx, result)) {
+				SETRESULT(lctx, result);
+				result = ISC_R_SUCCESS;
+			} else if (result != ISC_R_SUCCESS) {
+				break;
+			}
+		}
+	}
+
+	return result;
+}
+
+/*
+ * Load a raw file with an index (version 2).  The file is mapped, its
+ * groups are checked on several threads, a chunk of groups at a time, and
+ * the checked chunks are added to the database in order without copying
+ * the data.
+ */
+static isc_result_t
+load_rawindexed(dns_loadctx_t *lctx) {
+	isc_result_t result;
+	dns_rdatacallbacks_t *callbacks = lctx->callbacks;
+	chunkload_t cl = {
+		.lctx = lctx,
+		.parse = check_rawchunk,
+		.replay = replay_rawchunk,
+	};
+	isc_buffer_t b;
+	struct stat sb;
+	off_t start;
+	uint64_t indexoffset, offset;
+	unsigned int rdclass, nentries;
+	uint32_t magic;
+	void *map = NULL;
+
+	result = isc_stdio_tell(lctx->f, &start);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+	if (fstat(fileno(lctx->f), &sb) != 0) {
+		result = isc_errno_toresult(errno);
+		goto cleanup;
+	}
+	if (sb.st_size < start + DNS_RAWFORMAT_TRAILERLEN ||
+	    (uint64_t)sb.st_size > SIZE_MAX)
+	{
+		result = ISC_R_RANGE;
+		goto cleanup;
+	}
+
+	cl.mapsize = (size_t)sb.st_size;
+	map = mmap(NULL, cl.mapsize, PROT_READ, MAP_PRIVATE, fileno(lctx->f),
+		   0);
+	if (map == MAP_FAILED) {
+		map = NULL;
+		result = isc_errno_toresult(errno);
+		goto cleanup;
+	}
+	cl.map = map;
+
+	isc_buffer_init(&b, cl.map + cl.mapsize - DNS_RAWFORMAT_TRAILERLEN,
+			DNS_RAWFORMAT_TRAILERLEN);
+	isc_buffer_add(&b, DNS_RAWFORMAT_TRAILERLEN);
+	indexoffset = isc_buffer_getuint48(&b);
+	rdclass = isc_buffer_getuint16(&b);
+	nentries = isc_buffer_getuint32(&b);
+	magic = isc_buffer_getuint32(&b);
+	if (magic != DNS_RAWFORMAT_MAGIC || indexoffset < (uint64_t)start ||
+	    indexoffset > cl.mapsize - DNS_RAWFORMAT_TRAILERLEN ||
+	    cl.mapsize - DNS_RAWFORMAT_TRAILERLEN - indexoffset !=
+		    (uint64_t)nentries * 6 ||
+	    (nentries == 0 && indexoffset != (uint64_t)start))
+	{
+		result = ISC_R_RANGE;
+		goto cleanup;
+	}
+	if (rdclass != lctx->zclass) {
+		result = DNS_R_BADCLASS;
+		goto cleanup;
+	}
+
+	/*
+	 * The index entries are group offsets; a chunk starts at the first
+	 * entry that is at least CHUNK_SIZE bytes past the previous chunk.
+	 */
+	(void)add_chunk(&cl, start, 0, dns_rootname, 0);
+	isc_buffer_init(&b, cl.map + indexoffset, nentries * 6);
+	isc_buffer_add(&b, nentries * 6);
+	for (unsigned int i = 0; i < nentries; i++) {
+		chunk_t *chunk = &cl.chunks[cl.nchunks - 1];
+
+		offset = isc_buffer_getuint48(&b);
+		if (offset < (uint64_t)chunk->offset || offset > indexoffset ||
+		    (i == 0 && offset != (uint64_t)start))
+		{
+			result = ISC_R_RANGE;
+			goto cleanup;
+		}
+		if ((lctx->options & DNS_MASTER_NOTHREADS) == 0 &&
+		    offset - chunk->offset >= CHUNK_SIZE)
+		{
+			(void)add_chunk(&cl, offset, 0, dns_rootname, 0);
+		}
+	}
+	cl.chunks[cl.nchunks - 1].length =
+		indexoffset - cl.chunks[cl.nchunks - 1].offset;
+
+	result = load_chunks(lctx, &cl);
+	cl.chunks = NULL;
+
+	if (result == ISC_R_SUCCESS && callbacks->rawdata != NULL) {
+		(*callbacks->rawdata)(callbacks->zone, &lctx->header);
+	}
+
+cleanup:
+	if (cl.chunks != NULL) {
+		free_chunks(&cl);
+	}
+	if (map != NULL) {
+		munmap(map, cl.mapsize);
+	}
+	if (result != ISC_R_SUCCESS) {
+		(*callbacks->error)(callbacks, "dns_master_load: %s",
+				    isc_result_totext(result));
+	}
+
 	return result;
 }
 
@@ -2375,6 +3415,10 @@ load_raw(dns_loadctx_t *lctx) {
 		}
 	}
 
+	if (lctx->header.version == DNS_RAWFORMAT_INDEXED) {
+		return load_rawindexed(lctx);
+	}
+
 	ISC_LIST_INIT(head);
 	ISC_LIST_INIT(dummy);
 
@@ -2725,7 +3769,7 @@ dns_master_loadfileasync(const char *master_file, dns_name_t *top,
 	}
 
 	dns_loadctx_attach(lctx, lctxp);
-	isc_work_enqueue(loop, load, load_done, lctx);
+	isc_work_enqueue_bulk(loop, load, load_done, lctx);
 
 	return ISC_R_SUCCESS;
 }
@@ -2922,6 +3966,73 @@ resign_fromlist(dns_rdatalist_t *this, dns_loadctx_t *lctx) {
  * Unlink each element as we go.
  */
 
+static isc_result_t
+adddataset(dns_rdatacallbacks_t *callbacks, dns_name_t *owner,
+	   dns_rdataset_t *dataset, const char *source, unsigned int line) {
+	isc_result_t result;
+	char namebuf[DNS_NAME_FORMATSIZE];
+	void (*error)(struct dns_rdatacallbacks *, const char *, ...);
+
+	error = callbacks->error;
+
+	result = callbacks->add(callbacks->add_private, owner,
+				dataset DNS__DB_FILELINE);
+	if (result == ISC_R_NOMEMORY) {
+		(*error)(callbacks, "dns_master_load: %s",
+			 isc_result_totext(result));
+	} else if (result != ISC_R_SUCCESS) {
+		dns_name_format(owner, namebuf, sizeof(namebuf));
+		if (source != NULL) {
+			(*error)(callbacks, "%s: %s:%lu: %s: %s",
+				 "dns_master_load", source, line, namebuf,
+				 isc_result_totext(result));
+		} else {
+			(*error)(callbacks, "%s: %s: %s", "dns_master_load",
+				 namebuf, isc_result_totext(result));
+		}
+	}
+
+	return result;
+}
+
+/*
+ * Keep an rdataset parsed from a chunk, for load_chunks() to add it to the
+ * database once the preceding chunks have been added.
+ */
+static void
+record_rdataset(isc_buffer_t *records, dns_name_t *owner,
+		dns_rdatalist_t *this, dns_rdataset_t *dataset,
+		unsigned int line) {
+	dns_rdata_t *rdata = NULL;
+	isc_region_t r;
+	unsigned int count = 0;
+
+	for (rdata = ISC_LIST_HEAD(this->rdata); rdata != NULL;
+	     rdata = ISC_LIST_NEXT(rdata, link))
+	{
+		count++;
+	}
+
+	dns_name_toregion(owner, &r);
+	isc_buffer_putuint32(records, line);
+	isc_buffer_putuint8(records, r.length);
+	isc_buffer_putmem(records, r.base, r.length);
+	isc_buffer_putuint16(records, dataset->type);
+	isc_buffer_putuint16(records, dataset->covers);
+	isc_buffer_putuint32(records, dataset->ttl);
+	isc_buffer_putuint8(records,
+			    (dataset->attributes & DNS_RDATASETATTR_RESIGN) !=
+				    0);
+	isc_buffer_putuint32(records, dataset->resign);
+	isc_buffer_putuint16(records, count);
+	for (rdata = ISC_LIST_HEAD(this->rdata); rdata != NULL;
+	     rdata = ISC_LIST_NEXT(rdata, link))
+	{
+		isc_buffer_putuint16(records, rdata->length);
+		isc_buffer_putmem(records, rdata->data, rdata->length);
+	}
+}
+
 static isc_result_t
 commit(dns_rdatacallbacks_t *callbacks, dns_loadctx_t *lctx,
        rdatalist_head_t *head, dns_name_t *owner, const char *source,
@@ -2929,11 +4040,8 @@ commit(dns_rdatacallbacks_t *callbacks, dns_loadctx_t *lctx,
 	dns_rdatalist_t *this;
 	dns_rdataset_t dataset;
 	isc_result_t result = ISC_R_SUCCESS;
-	char namebuf[DNS_NAME_FORMATSIZE];
-	void (*error)(struct dns_rdatacallbacks *, const char *, ...);
 
 	this = ISC_LIST_HEAD(*head);
-	error = callbacks->error;
 
 	while (this != NULL) {
 		dns_rdataset_init(&dataset);
@@ -2948,22 +4056,12 @@ commit(dns_rdatacallbacks_t *callbacks, dns_loadctx_t *lctx,
 			dataset.attributes |= DNS_RDATASETATTR_RESIGN;
 			dataset.resign = resign_fromlist(this, lctx);
 		}
-		result = callbacks->add(callbacks->add_private, owner,
-					&dataset DNS__DB_FILELINE);
-		if (result == ISC_R_NOMEMORY) {
-			(*error)(callbacks, "dns_master_load: %s",
-				 isc_result_totext(result));
-		} else if (result != ISC_R_SUCCESS) {
-			dns_name_format(owner, namebuf, sizeof(namebuf));
-			if (source != NULL) {
-				(*error)(callbacks, "%s: %s:%lu: %s: %s",
-					 "dns_master_load", source, line,
-					 namebuf, isc_result_totext(result));
-			} else {
-				(*error)(callbacks, "%s: %s: %s",
-					 "dns_master_load", namebuf,
-					 isc_result_totext(result));
-			}
+		if (lctx->records != NULL) {
+			record_rdataset(lctx->records, owner, this, &dataset,
+					line);
+		} else {
+			result = adddataset(callbacks, owner, &dataset, source,
+					    line);
 		}
 		if (MANYERRS(lctx, result)) {
 			SETRESULT(lctx, result);
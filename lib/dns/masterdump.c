@@ -20,15 +20,20 @@
 #include <isc/async.h>
 #include <isc/atomic.h>
 #include <isc/buffer.h>
+#include <isc/condition.h>
+#include <isc/errno.h>
 #include <isc/file.h>
 #include <isc/log.h>
 #include <isc/loop.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/os.h>
 #include <isc/refcount.h>
 #include <isc/result.h>
 #include <isc/stdio.h>
 #include <isc/string.h>
+#include <isc/thread.h>
 #include <isc/time.h>
 #include <isc/types.h>
 #include <isc/util.h>
@@ -265,12 +270,50 @@ struct dns_dumpctx {
 	char *tmpfile;
 	dns_masterformat_t format;
 	dns_masterrawheader_t header;
+	isc_buffer_t *index; /*%< raw format version 2 */
+	unsigned int ngroups;
 	isc_result_t (*dumpsets)(isc_mem_t *mctx, const dns_name_t *name,
 				 dns_rdatasetiter_t *rdsiter,
 				 dns_totext_ctx_t *ctx, isc_buffer_t *buffer,
 				 FILE *f);
 };
 
+/*%
+ * Raw format dumps are rendered on up to DUMP_THREADS threads, in chunks
+ * of DUMP_CHUNKNODES nodes, see dumptostream_chunked().  The text format
+ * can carry state from one node to the next ($ORIGIN, $TTL), and is only
+ * dumped in chunks when it doesn't, see dump_text_chunked().
+ */
+#define DUMP_THREADS	8
+#define DUMP_CHUNKNODES 4096
+
+typedef struct dumpchunk {
+	unsigned int first; /*%< the number of the first node */
+	unsigned int count;
+	dns_dbnode_t *nodes[DUMP_CHUNKNODES];
+	isc_buffer_t *names; /*%< the node names, in wire format */
+	char *data;	     /*%< the rendered nodes, from open_memstream() */
+	size_t length;
+	off_t index[DUMP_CHUNKNODES / DNS_RAWFORMAT_INDEXSTEP + 1];
+	unsigned int nindex;
+	isc_result_t result;
+	bool done; /*%< locked by dw->lock */
+} dumpchunk_t;
+
+typedef struct dumpwork {
+	dns_dumpctx_t *dctx;
+	unsigned int options; /*%< for dns_db_allrdatasets() */
+	dumpchunk_t *chunks;  /*%< 'window' chunks, used in turn */
+	unsigned int window;
+
+	isc_mutex_t lock;
+	isc_condition_t work; /*%< a chunk has been queued */
+	isc_condition_t done; /*%< a chunk has been rendered */
+	unsigned int queued;
+	unsigned int rendered;
+	bool shutdown;
+} dumpwork_t;
+
 #define NXDOMAIN(x) (((x)->attributes & DNS_RDATASETATTR_NXDOMAIN) != 0)
 
 static const dns_indent_t default_indent = { "\t", 1 };
@@ -1360,6 +1403,183 @@ dump_rdatasets_raw(isc_mem_t *mctx, const dns_name_t *owner_name,
 	return result;
 }
 
+/*
+ * Write one RRset of a group in version 2 of the raw format, or only add
+ * its length to '*lengthp' if 'f' is NULL.
+ */
+static isc_result_t
+dump_rawgroup_rdataset(dns_rdataset_t *rdataset, isc_buffer_t *buffer,
+		       FILE *f, uint64_t *lengthp) {
+	isc_result_t result;
+	unsigned int count = dns_rdataset_count(rdataset);
+
+	INSIST(count <= 0xffffU);
+
+	isc_buffer_clear(buffer);
+	isc_buffer_putuint16(buffer, rdataset->type);
+	isc_buffer_putuint16(buffer, rdataset->covers);
+	isc_buffer_putuint32(buffer, rdataset->ttl);
+	isc_buffer_putuint16(buffer, (uint16_t)count);
+	*lengthp += isc_buffer_usedlength(buffer);
+	if (f != NULL) {
+		RETERR(isc_stdio_write(buffer->base, 1,
+				       isc_buffer_usedlength(buffer), f, NULL));
+	}
+
+	for (result = dns_rdataset_first(rdataset); result == ISC_R_SUCCESS;
+	     result = dns_rdataset_next(rdataset))
+	{
+		dns_rdata_t rdata = DNS_RDATA_INIT;
+		isc_region_t r;
+
+		dns_rdataset_current(rdataset, &rdata);
+		dns_rdata_toregion(&rdata, &r);
+		INSIST(r.length <= 0xffffU);
+		*lengthp += sizeof(uint16_t) + r.length;
+		if (f != NULL) {
+			isc_buffer_clear(buffer);
+			isc_buffer_putuint16(buffer, (uint16_t)r.length);
+			RETERR(isc_stdio_write(buffer->base, 1,
+					       sizeof(uint16_t), f, NULL));
+			RETERR(isc_stdio_write(r.base, 1, r.length, f, NULL));
+		}
+	}
+
+	if (result == ISC_R_NOMORE) {
+		result = ISC_R_SUCCESS;
+	}
+
+	return result;
+}
+
+static isc_result_t
+dump_rawgroup_rdatasets(dns_rdatasetiter_t *rdsiter, dns_totext_ctx_t *ctx,
+			dns_name_t *name, isc_buffer_t *buffer, FILE *f,
+			uint64_t *lengthp, unsigned int *nsetsp) {
+	isc_result_t result;
+
+	for (result = dns_rdatasetiter_first(rdsiter); result == ISC_R_SUCCESS;
+	     result = dns_rdatasetiter_next(rdsiter))
+	{
+		dns_rdataset_t rdataset;
+
+		dns_rdataset_init(&rdataset);
+		dns_rdatasetiter_current(rdsiter, &rdataset);
+
+		dns_rdataset_getownercase(&rdataset, name);
+
+		if (((rdataset.attributes & DNS_RDATASETATTR_NEGATIVE) != 0) &&
+		    (ctx->style.flags & DNS_STYLEFLAG_NCACHE) == 0)
+		{
+			/* Omit negative cache entries */
+		} else {
+			result = dump_rawgroup_rdataset(&rdataset, buffer, f,
+							lengthp);
+			(*nsetsp)++;
+		}
+		dns_rdataset_disassociate(&rdataset);
+		if (result != ISC_R_SUCCESS) {
+			return result;
+		}
+	}
+
+	if (result == ISC_R_NOMORE) {
+		result = ISC_R_SUCCESS;
+	}
+
+	return result;
+}
+
+/*
+ * Write the RRsets of a node as a group in version 2 of the raw format.
+ * The group starts with its length, so the RRsets are walked twice: once
+ * to measure them and once to write them.
+ */
+static isc_result_t
+dump_rdatasets_rawgroup(isc_mem_t *mctx, const dns_name_t *owner_name,
+			dns_rdatasetiter_t *rdsiter, dns_totext_ctx_t *ctx,
+			isc_buffer_t *buffer, FILE *f) {
+	isc_result_t result;
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	isc_region_t r;
+	uint64_t length = 0;
+	unsigned int nsets = 0;
+
+	UNUSED(mctx);
+
+	REQUIRE(buffer->length >= 2 * sizeof(uint32_t) + DNS_NAME_MAXWIRE);
+
+	name = dns_fixedname_initname(&fixed);
+	dns_name_copy(owner_name, name);
+
+	result = dump_rawgroup_rdatasets(rdsiter, ctx, name, buffer, NULL,
+					 &length, &nsets);
+	if (result != ISC_R_SUCCESS || nsets == 0) {
+		return result;
+	}
+
+	dns_name_toregion(name, &r);
+	length += sizeof(uint16_t) + r.length + sizeof(uint16_t);
+	if (length > UINT32_MAX || nsets > 0xffffU) {
+		return ISC_R_RANGE;
+	}
+
+	isc_buffer_clear(buffer);
+	isc_buffer_putuint32(buffer, (uint32_t)length);
+	isc_buffer_putuint16(buffer, (uint16_t)r.length);
+	isc_buffer_copyregion(buffer, &r);
+	isc_buffer_putuint16(buffer, (uint16_t)nsets);
+	result = isc_stdio_write(buffer->base, 1, isc_buffer_usedlength(buffer),
+				 f, NULL);
+	if (result == ISC_R_SUCCESS) {
+		length = 0;
+		nsets = 0;
+		result = dump_rawgroup_rdatasets(rdsiter, ctx, name, buffer, f,
+						 &length, &nsets);
+	}
+
+	if (result != ISC_R_SUCCESS) {
+		UNEXPECTED_ERROR("raw master file write failed: %s",
+				 isc_result_totext(result));
+	}
+
+	return result;
+}
+
+/*
+ * Write the index and the trailer of a file in version 2 of the raw
+ * format.
+ */
+static isc_result_t
+writeindex(dns_dumpctx_t *dctx) {
+	isc_result_t result;
+	isc_buffer_t buffer;
+	unsigned char data[DNS_RAWFORMAT_TRAILERLEN];
+	isc_region_t r;
+	off_t offset;
+
+	result = isc_stdio_tell(dctx->f, &offset);
+	if (result == ISC_R_SUCCESS) {
+		isc_buffer_usedregion(dctx->index, &r);
+		result = isc_stdio_write(r.base, 1, r.length, dctx->f, NULL);
+	}
+	if (result == ISC_R_SUCCESS) {
+		isc_buffer_init(&buffer, data, sizeof(data));
+		isc_buffer_putuint48(&buffer, (uint64_t)offset);
+		isc_buffer_putuint16(&buffer, dns_db_class(dctx->db));
+		isc_buffer_putuint32(&buffer, r.length / 6);
+		isc_buffer_putuint32(&buffer, DNS_RAWFORMAT_MAGIC);
+		result = isc_stdio_write(data, 1, sizeof(data), dctx->f, NULL);
+	}
+
+	if (result != ISC_R_SUCCESS) {
+		UNEXPECTED_ERROR("raw master file index write failed: %s",
+				 isc_result_totext(result));
+	}
+	return result;
+}
+
 /*
  * Initial size of text conversion buffer.  The buffer is used
  * for several purposes: converting origin names, rdatasets,
@@ -1387,6 +1607,9 @@ dumpctx_destroy(dns_dumpctx_t *dctx) {
 	if (dctx->file != NULL) {
 		isc_mem_free(dctx->mctx, dctx->file);
 	}
+	if (dctx->index != NULL) {
+		isc_buffer_free(&dctx->index);
+	}
 	if (dctx->tmpfile != NULL) {
 		isc_mem_free(dctx->mctx, dctx->tmpfile);
 	}
@@ -1578,7 +1801,14 @@ dumpctx_create(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
 		dctx->dumpsets = dump_rdatasets_text;
 		break;
 	case dns_masterformat_raw:
-		dctx->dumpsets = dump_rdatasets_raw;
+		if ((dctx->header.flags & DNS_MASTERRAW_INDEXED) != 0 &&
+		    (dctx->header.flags & DNS_MASTERRAW_COMPAT) == 0)
+		{
+			dctx->dumpsets = dump_rdatasets_rawgroup;
+			isc_buffer_allocate(mctx, &dctx->index, 1024);
+		} else {
+			dctx->dumpsets = dump_rdatasets_raw;
+		}
 		break;
 	default:
 		UNREACHABLE();
@@ -1677,13 +1907,15 @@ writeheader(dns_dumpctx_t *dctx) {
 		rawversion = 1;
 		if ((dctx->header.flags & DNS_MASTERRAW_COMPAT) != 0) {
 			rawversion = 0;
+		} else if (dctx->index != NULL) {
+			rawversion = DNS_RAWFORMAT_INDEXED;
 		}
 
 		isc_buffer_putuint32(&buffer, dctx->format);
 		isc_buffer_putuint32(&buffer, rawversion);
 		isc_buffer_putuint32(&buffer, now32);
 
-		if (rawversion == 1) {
+		if (rawversion >= 1) {
 			isc_buffer_putuint32(&buffer, dctx->header.flags);
 			isc_buffer_putuint32(&buffer,
 					     dctx->header.sourceserial);
@@ -1707,6 +1939,295 @@ writeheader(dns_dumpctx_t *dctx) {
 	return result;
 }
 
+/*
+ * Render the nodes of a chunk into a memory stream.  The nodes are
+ * detached even if rendering fails.
+ */
+static isc_result_t
+render_chunk(dumpwork_t *dw, dumpchunk_t *chunk, isc_buffer_t *buffer) {
+	isc_result_t result = ISC_R_SUCCESS;
+	dns_dumpctx_t *dctx = dw->dctx;
+	dns_totext_ctx_t tctx = dctx->tctx;
+	FILE *f = NULL;
+
+	/*
+	 * Each chunk is rendered with its own copy of the totext context,
+	 * as the text format updates it.
+	 */
+	if (tctx.linebreak != NULL) {
+		tctx.linebreak = tctx.linebreak_buf;
+	}
+
+	chunk->data = NULL;
+	chunk->length = 0;
+	chunk->nindex = 0;
+
+	f = open_memstream(&chunk->data, &chunk->length);
+	if (f == NULL) {
+		result = isc_errno_toresult(errno);
+	}
+
+	for (unsigned int i = 0; i < chunk->count; i++) {
+		dns_rdatasetiter_t *rdsiter = NULL;
+		dns_name_t name;
+		isc_region_t r;
+
+		dns_name_init(&name, NULL);
+		isc_buffer_remainingregion(chunk->names, &r);
+		dns_name_fromregion(&name, &r);
+		isc_buffer_forward(chunk->names, name.length);
+
+		if (result == ISC_R_SUCCESS && dctx->index != NULL &&
+		    (chunk->first + i) % DNS_RAWFORMAT_INDEXSTEP == 0)
+		{
+			result = isc_stdio_tell(f, &chunk->index[chunk->nindex]);
+			chunk->nindex++;
+		}
+
+		if (result == ISC_R_SUCCESS) {
+			result = dns_db_allrdatasets(dctx->db, chunk->nodes[i],
+						     dctx->version, dw->options,
+						     dctx->now, &rdsiter);
+		}
+		if (result == ISC_R_SUCCESS) {
+			result = (dctx->dumpsets)(dctx->mctx, &name, rdsiter,
+						  &tctx, buffer, f);
+			dns_rdatasetiter_destroy(&rdsiter);
+		}
+		dns_db_detachnode(dctx->db, &chunk->nodes[i]);
+	}
+
+	if (f != NULL && fclose(f) != 0 && result == ISC_R_SUCCESS) {
+		result = isc_errno_toresult(errno);
+	}
+	if (result != ISC_R_SUCCESS) {
+		free(chunk->data);
+		chunk->data = NULL;
+	}
+
+	return result;
+}
+
+static void *
+dump_thread(void *arg) {
+	dumpwork_t *dw = arg;
+	isc_buffer_t buffer;
+	char *bufmem = isc_mem_get(dw->dctx->mctx, initial_buffer_length);
+
+	isc_buffer_init(&buffer, bufmem, initial_buffer_length);
+
+	LOCK(&dw->lock);
+	while (true) {
+		dumpchunk_t *chunk = NULL;
+
+		while (!dw->shutdown && dw->rendered == dw->queued) {
+			WAIT(&dw->work, &dw->lock);
+		}
+		if (dw->rendered == dw->queued) {
+			break;
+		}
+
+		chunk = &dw->chunks[dw->rendered++ % dw->window];
+		UNLOCK(&dw->lock);
+
+		chunk->result = render_chunk(dw, chunk, &buffer);
+
+		LOCK(&dw->lock);
+		chunk->done = true;
+		BROADCAST(&dw->done);
+	}
+	UNLOCK(&dw->lock);
+
+	/* dump_rdataset_raw() may have replaced the buffer */
+	isc_mem_put(dw->dctx->mctx, buffer.base, buffer.length);
+
+	return NULL;
+}
+
+/*
+ * Wait for a chunk to be rendered and write it out, unless an earlier
+ * chunk has failed.
+ */
+static isc_result_t
+write_chunk(dumpwork_t *dw, dumpchunk_t *chunk, isc_result_t result) {
+	dns_dumpctx_t *dctx = dw->dctx;
+	off_t offset = 0;
+
+	LOCK(&dw->lock);
+	while (!chunk->done) {
+		WAIT(&dw->done, &dw->lock);
+	}
+	UNLOCK(&dw->lock);
+
+	if (result == ISC_R_SUCCESS) {
+		result = chunk->result;
+	}
+	if (result == ISC_R_SUCCESS && dctx->index != NULL) {
+		result = isc_stdio_tell(dctx->f, &offset);
+		for (unsigned int i = 0; i < chunk->nindex; i++) {
+			uint64_t entry = offset + chunk->index[i];
+			isc_buffer_putuint48(dctx->index, entry);
+		}
+	}
+	if (result == ISC_R_SUCCESS && chunk->length > 0) {
+		result = isc_stdio_write(chunk->data, 1, chunk->length,
+					 dctx->f, NULL);
+		if (result != ISC_R_SUCCESS) {
+			UNEXPECTED_ERROR("master file write failed: %s",
+					 isc_result_totext(result));
+		}
+	}
+
+	free(chunk->data);
+	chunk->data = NULL;
+
+	return result;
+}
+
+/*
+ * Can the database be dumped in the text format in chunks?  Only a cache
+ * dump in a style that doesn't carry the TTL or the origin from one node
+ * to the next can; the class is printed again at the start of each chunk.
+ */
+static bool
+dump_text_chunked(dns_dumpctx_t *dctx) {
+	unsigned int flags = DNS_STYLEFLAG_TTL | DNS_STYLEFLAG_OMIT_TTL |
+			     DNS_STYLEFLAG_REL_OWNER | DNS_STYLEFLAG_REL_DATA;
+
+	return dctx->format == dns_masterformat_text &&
+	       dns_db_iscache(dctx->db) &&
+	       (dctx->tctx.style.flags & flags) == 0;
+}
+
+/*
+ * Dump a database on several threads.  This thread walks the database
+ * and queues the nodes in chunks; the dump_thread()s render each chunk
+ * into memory, and the chunks are written out in order by this thread,
+ * in one write each.  At most 'window' chunks are queued
+ * or waiting to be written at a time.
+ */
+static isc_result_t
+dumptostream_chunked(dns_dumpctx_t *dctx, unsigned int options,
+		     unsigned int nthreads) {
+	isc_result_t result, iresult;
+	dumpwork_t dw = {
+		.dctx = dctx,
+		.options = options,
+		.window = 2 * nthreads,
+	};
+	isc_thread_t *threads = NULL;
+	unsigned int written = 0;
+
+	result = writeheader(dctx);
+	if (result != ISC_R_SUCCESS) {
+		return result;
+	}
+
+	dw.chunks = isc_mem_cget(dctx->mctx, dw.window, sizeof(dw.chunks[0]));
+	for (unsigned int i = 0; i < dw.window; i++) {
+		isc_buffer_allocate(dctx->mctx, &dw.chunks[i].names,
+				    DUMP_CHUNKNODES * 32);
+	}
+	isc_mutex_init(&dw.lock);
+	isc_condition_init(&dw.work);
+	isc_condition_init(&dw.done);
+
+	threads = isc_mem_cget(dctx->mctx, nthreads, sizeof(threads[0]));
+	for (unsigned int i = 0; i < nthreads; i++) {
+		isc_thread_create(dump_thread, &dw, &threads[i]);
+	}
+
+	iresult = dns_dbiterator_first(dctx->dbiter);
+	while (iresult == ISC_R_SUCCESS && result == ISC_R_SUCCESS) {
+		dumpchunk_t *chunk = &dw.chunks[dw.queued % dw.window];
+
+		if (atomic_load_acquire(&dctx->canceled)) {
+			result = ISC_R_CANCELED;
+			break;
+		}
+
+		/* Reuse the oldest chunk once it has been written */
+		if (dw.queued - written == dw.window) {
+			result = write_chunk(&dw, chunk, result);
+			written++;
+			if (result != ISC_R_SUCCESS) {
+				break;
+			}
+		}
+
+		chunk->first = dw.queued * DUMP_CHUNKNODES;
+		chunk->count = 0;
+		chunk->done = false;
+		isc_buffer_clear(chunk->names);
+		while (iresult == ISC_R_SUCCESS &&
+		       chunk->count < DUMP_CHUNKNODES)
+		{
+			dns_fixedname_t fixed;
+			dns_name_t *name = dns_fixedname_initname(&fixed);
+			isc_region_t r;
+
+			iresult = dns_dbiterator_current(
+				dctx->dbiter, &chunk->nodes[chunk->count],
+				name);
+			if (iresult != ISC_R_SUCCESS &&
+			    iresult != DNS_R_NEWORIGIN)
+			{
+				break;
+			}
+			dns_name_toregion(name, &r);
+			isc_buffer_putmem(chunk->names, r.base, r.length);
+			chunk->count++;
+
+			iresult = dns_dbiterator_next(dctx->dbiter);
+		}
+		RUNTIME_CHECK(dns_dbiterator_pause(dctx->dbiter) ==
+			      ISC_R_SUCCESS);
+
+		/*
+		 * The chunk is queued even when it is empty or the walk
+		 * failed, so that its nodes are detached.
+		 */
+		LOCK(&dw.lock);
+		dw.queued++;
+		SIGNAL(&dw.work);
+		UNLOCK(&dw.lock);
+	}
+
+	if (result == ISC_R_SUCCESS && iresult != ISC_R_NOMORE) {
+		result = iresult;
+	}
+
+	while (written < dw.queued) {
+		result = write_chunk(&dw, &dw.chunks[written % dw.window],
+				     result);
+		written++;
+	}
+
+	LOCK(&dw.lock);
+	dw.shutdown = true;
+	BROADCAST(&dw.work);
+	UNLOCK(&dw.lock);
+
+	for (unsigned int i = 0; i < nthreads; i++) {
+		isc_thread_join(threads[i], NULL);
+	}
+	isc_mem_cput(dctx->mctx, threads, nthreads, sizeof(threads[0]));
+
+	isc_condition_destroy(&dw.done);
+	isc_condition_destroy(&dw.work);
+	isc_mutex_destroy(&dw.lock);
+	for (unsigned int i = 0; i < dw.window; i++) {
+		isc_buffer_free(&dw.chunks[i].names);
+	}
+	isc_mem_cput(dctx->mctx, dw.chunks, dw.window, sizeof(dw.chunks[0]));
+
+	if (result == ISC_R_SUCCESS && dctx->index != NULL) {
+		result = writeindex(dctx);
+	}
+
+	return result;
+}
+
 static isc_result_t
 dumptostream(dns_dumpctx_t *dctx) {
 	isc_result_t result = ISC_R_SUCCESS;
@@ -1715,11 +2236,19 @@ dumptostream(dns_dumpctx_t *dctx) {
 	dns_name_t *name;
 	dns_fixedname_t fixname;
 	unsigned int options = DNS_DB_STALEOK;
+	unsigned int nthreads;
 
 	if ((dctx->tctx.style.flags & DNS_STYLEFLAG_EXPIRED) != 0) {
 		options |= DNS_DB_EXPIREDOK;
 	}
 
+	nthreads = ISC_MIN(isc_os_ncpus(), DUMP_THREADS);
+	if (nthreads > 1 && (dctx->format == dns_masterformat_raw ||
+			     dump_text_chunked(dctx)))
+	{
+		return dumptostream_chunked(dctx, options, nthreads);
+	}
+
 	bufmem = isc_mem_get(dctx->mctx, initial_buffer_length);
 
 	isc_buffer_init(&buffer, bufmem, initial_buffer_length);
@@ -1763,6 +2292,19 @@ dumptostream(dns_dumpctx_t *dctx) {
 			dns_db_detachnode(dctx->db, &node);
 			goto cleanup;
 		}
+		if (dctx->index != NULL &&
+		    dctx->ngroups++ % DNS_RAWFORMAT_INDEXSTEP == 0)
+		{
+			off_t offset;
+
+			result = isc_stdio_tell(dctx->f, &offset);
+			if (result != ISC_R_SUCCESS) {
+				dns_rdatasetiter_destroy(&rdsiter);
+				dns_db_detachnode(dctx->db, &node);
+				goto cleanup;
+			}
+			isc_buffer_putuint48(dctx->index, (uint64_t)offset);
+		}
 		result = (dctx->dumpsets)(dctx->mctx, name, rdsiter,
 					  &dctx->tctx, &buffer, dctx->f);
 		dns_rdatasetiter_destroy(&rdsiter);
@@ -1777,6 +2319,9 @@ dumptostream(dns_dumpctx_t *dctx) {
 	if (result == ISC_R_NOMORE) {
 		result = ISC_R_SUCCESS;
 	}
+	if (result == ISC_R_SUCCESS && dctx->index != NULL) {
+		result = writeindex(dctx);
+	}
 cleanup:
 	RUNTIME_CHECK(dns_dbiterator_pause(dctx->dbiter) == ISC_R_SUCCESS);
 	isc_mem_put(dctx->mctx, buffer.base, buffer.length);
@@ -1805,7 +2350,7 @@ dns_master_dumptostreamasync(isc_mem_t *mctx, dns_db_t *db,
 	dctx->done_arg = done_arg;
 
 	dns_dumpctx_attach(dctx, dctxp);
-	isc_work_enqueue(loop, master_dump_cb, master_dump_done_cb, dctx);
+	isc_work_enqueue_bulk(loop, master_dump_cb, master_dump_done_cb, dctx);
 
 	return ISC_R_SUCCESS;
 }
@@ -1900,7 +2445,7 @@ dns_master_dumpasync(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
 	dctx->tmpfile = tempname;
 
 	dns_dumpctx_attach(dctx, dctxp);
-	isc_work_enqueue(loop, master_dump_cb, master_dump_done_cb, dctx);
+	isc_work_enqueue_bulk(loop, master_dump_cb, master_dump_done_cb, dctx);
 
 	return ISC_R_SUCCESS;
 
@@ -413,6 +413,8 @@ msginitprivate(dns_message_t *m) {
 	m->padding = 0;
 	m->padding_off = 0;
 	m->buffer = NULL;
+	m->deferred = 0;
+	m->deferred_options = 0;
 }
 
 static void
@@ -848,6 +850,60 @@ dns_message_findtype(const dns_name_t *name, dns_rdatatype_t type,
 	return ISC_R_NOTFOUND;
 }
 
+/*%
+ * The names parsed so far, by their offset in the message, for the owner
+ * names that are only a compression pointer to one of them: they need not
+ * be decompressed again.  Most owner names in a response point at the
+ * question name.
+ */
+#define NAMECACHE_SIZE 16
+
+typedef struct {
+	unsigned int offset;
+	dns_name_t *name;
+} namecache_t[NAMECACHE_SIZE];
+
+static void
+namecache_add(namecache_t cache, unsigned int offset, dns_name_t *name) {
+	/* Compression pointers only reach the first 16k of the message */
+	if (offset < 0x4000) {
+		cache[offset % NAMECACHE_SIZE].offset = offset;
+		cache[offset % NAMECACHE_SIZE].name = name;
+	}
+}
+
+/*
+ * If the name at the current position in "source" is a compression
+ * pointer to a name in the cache, set "name" to the cached name, which
+ * it decompresses to.
+ */
+static bool
+namecache_get(namecache_t cache, isc_buffer_t *source, dns_decompress_t dctx,
+	      dns_name_t *name) {
+	isc_region_t r;
+	unsigned int offset;
+
+	if (!dns_decompress_getpermitted(dctx)) {
+		return false;
+	}
+
+	isc_buffer_remainingregion(source, &r);
+	if (r.length < 2 || r.base[0] < 192) {
+		return false;
+	}
+
+	offset = (r.base[0] & 0x3F) * 256 + r.base[1];
+	if (cache[offset % NAMECACHE_SIZE].name == NULL ||
+	    cache[offset % NAMECACHE_SIZE].offset != offset)
+	{
+		return false;
+	}
+
+	dns_name_clone(cache[offset % NAMECACHE_SIZE].name, name);
+	isc_buffer_forward(source, 2);
+	return true;
+}
+
 /*
  * Read a name from buffer "source".
  */
@@ -886,6 +942,77 @@ getname(dns_name_t *name, isc_buffer_t *source, dns_message_t *msg,
 	UNREACHABLE();
 }
 
+/*
+ * Copy the rdata of the most common types into 'scratch' directly, and
+ * return ISC_R_NOTIMPLEMENTED for the other types and for malformed rdata,
+ * which are left to the dns_rdata_fromwire() dispatch.
+ */
+static isc_result_t
+getrdata_fast(isc_buffer_t *source, dns_decompress_t dctx,
+	      dns_rdataclass_t rdclass, dns_rdatatype_t rdtype,
+	      unsigned int rdatalen, isc_buffer_t *scratch, dns_rdata_t *rdata) {
+	isc_result_t result;
+	isc_buffer_t ss = *source, st = *scratch;
+	isc_region_t r;
+	dns_name_t name;
+	unsigned int names = 0, fixed = 0;
+
+	switch (rdtype) {
+	case dns_rdatatype_a:
+		if (rdclass != dns_rdataclass_in || rdatalen != 4) {
+			return ISC_R_NOTIMPLEMENTED;
+		}
+		fixed = 4;
+		break;
+	case dns_rdatatype_aaaa:
+		if (rdclass != dns_rdataclass_in || rdatalen != 16) {
+			return ISC_R_NOTIMPLEMENTED;
+		}
+		fixed = 16;
+		break;
+	case dns_rdatatype_ns:
+	case dns_rdatatype_cname:
+		names = 1;
+		break;
+	case dns_rdatatype_soa:
+		names = 2;
+		fixed = 20;
+		break;
+	default:
+		return ISC_R_NOTIMPLEMENTED;
+	}
+
+	dctx = dns_decompress_setpermitted(dctx, true);
+	for (unsigned int i = 0; i < names; i++) {
+		dns_name_init(&name, NULL);
+		result = dns_name_fromwire(&name, source, dctx, scratch);
+		if (result != ISC_R_SUCCESS) {
+			goto fail;
+		}
+	}
+
+	if (isc_buffer_activelength(source) != fixed) {
+		result = ISC_R_NOTIMPLEMENTED;
+		goto fail;
+	}
+	if (isc_buffer_availablelength(scratch) < fixed) {
+		result = ISC_R_NOSPACE;
+		goto fail;
+	}
+	isc_buffer_putmem(scratch, isc_buffer_current(source), fixed);
+	isc_buffer_forward(source, fixed);
+
+	r.base = isc_buffer_used(&st);
+	r.length = isc_buffer_usedlength(scratch) - isc_buffer_usedlength(&st);
+	dns_rdata_fromregion(rdata, rdclass, rdtype, &r);
+	return ISC_R_SUCCESS;
+
+fail:
+	*source = ss;
+	*scratch = st;
+	return result == ISC_R_NOSPACE ? result : ISC_R_NOTIMPLEMENTED;
+}
+
 static isc_result_t
 getrdata(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t dctx,
 	 dns_rdataclass_t rdclass, dns_rdatatype_t rdtype,
@@ -910,8 +1037,12 @@ getrdata(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t dctx,
 	trysize = 0;
 	/* XXX possibly change this to a while (tries < 2) loop */
 	for (;;) {
-		result = dns_rdata_fromwire(rdata, rdclass, rdtype, source,
-					    dctx, scratch);
+		result = getrdata_fast(source, dctx, rdclass, rdtype, rdatalen,
+				       scratch, rdata);
+		if (result == ISC_R_NOTIMPLEMENTED) {
+			result = dns_rdata_fromwire(rdata, rdclass, rdtype,
+						    source, dctx, scratch);
+		}
 
 		if (result == ISC_R_NOSPACE) {
 			if (tries == 0) {
@@ -962,7 +1093,7 @@ cleanup_name_hashmaps(dns_namelist_t *section) {
 
 static isc_result_t
 getquestions(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t dctx,
-	     unsigned int options) {
+	     namecache_t namecache, unsigned int options) {
 	isc_region_t r;
 	unsigned int count;
 	dns_name_t *name = NULL;
@@ -984,6 +1115,8 @@ getquestions(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t dctx,
 	}
 
 	for (count = 0; count < msg->counts[DNS_SECTION_QUESTION]; count++) {
+		unsigned int namestart = source->current;
+
 		name = NULL;
 		dns_message_gettempname(msg, &name);
 		name->offsets = (unsigned char *)newoffsets(msg);
@@ -1043,6 +1176,7 @@ getquestions(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t dctx,
 		}
 
 		free_name = false;
+		namecache_add(namecache, namestart, name);
 
 		/*
 		 * Get type and class.
@@ -1222,7 +1356,8 @@ auth_signed(dns_namelist_t *section) {
 
 static isc_result_t
 getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t dctx,
-	   dns_section_t sectionid, unsigned int options) {
+	   namecache_t namecache, dns_section_t sectionid,
+	   unsigned int options) {
 	isc_region_t r;
 	unsigned int count, rdatalen;
 	dns_name_t *name = NULL;
@@ -1268,9 +1403,11 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t dctx,
 		 */
 		isc_buffer_remainingregion(source, &r);
 		isc_buffer_setactive(source, r.length);
-		result = getname(name, source, msg, dctx);
-		if (result != ISC_R_SUCCESS) {
-			goto cleanup;
+		if (!namecache_get(namecache, source, dctx, name)) {
+			result = getname(name, source, msg, dctx);
+			if (result != ISC_R_SUCCESS) {
+				goto cleanup;
+			}
 		}
 
 		/*
@@ -1488,6 +1625,7 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t dctx,
 			if (!isedns && !istsig && !issigzero) {
 				ISC_LIST_APPEND(*section, name, link);
 				free_name = false;
+				namecache_add(namecache, recstart, name);
 			}
 		} else {
 			if (name_map == NULL) {
@@ -1522,6 +1660,7 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t dctx,
 				UNREACHABLE();
 			}
 			free_name = false;
+			namecache_add(namecache, recstart, name);
 		}
 
 		rdatalist = newrdatalist(msg);
@@ -1729,6 +1868,71 @@ cleanup:
 	return result;
 }
 
+/*
+ * Step over a name without decompressing it.
+ */
+static isc_result_t
+skipname(isc_buffer_t *source) {
+	unsigned int length = 0;
+
+	for (;;) {
+		unsigned int c;
+
+		if (isc_buffer_remaininglength(source) < 1) {
+			return ISC_R_UNEXPECTEDEND;
+		}
+		c = isc_buffer_getuint8(source);
+		if (c == 0) {
+			return ISC_R_SUCCESS;
+		}
+		if (c >= 192) {
+			if (isc_buffer_remaininglength(source) < 1) {
+				return ISC_R_UNEXPECTEDEND;
+			}
+			isc_buffer_forward(source, 1);
+			return ISC_R_SUCCESS;
+		}
+		if (c >= 64) {
+			return DNS_R_BADLABELTYPE;
+		}
+		length += c + 1;
+		if (length >= DNS_NAME_MAXWIRE) {
+			return DNS_R_NAMETOOLONG;
+		}
+		if (isc_buffer_remaininglength(source) < c) {
+			return ISC_R_UNEXPECTEDEND;
+		}
+		isc_buffer_forward(source, c);
+	}
+}
+
+/*
+ * Step over the records of a section whose parsing is deferred.
+ */
+static isc_result_t
+skipsection(isc_buffer_t *source, dns_message_t *msg,
+	    dns_section_t sectionid) {
+	for (unsigned int count = 0; count < msg->counts[sectionid]; count++) {
+		isc_result_t result = skipname(source);
+		unsigned int rdatalen;
+
+		if (result != ISC_R_SUCCESS) {
+			return result;
+		}
+		if (isc_buffer_remaininglength(source) < 2 + 2 + 4 + 2) {
+			return ISC_R_UNEXPECTEDEND;
+		}
+		isc_buffer_forward(source, 2 + 2 + 4);
+		rdatalen = isc_buffer_getuint16(source);
+		if (isc_buffer_remaininglength(source) < rdatalen) {
+			return ISC_R_UNEXPECTEDEND;
+		}
+		isc_buffer_forward(source, rdatalen);
+	}
+
+	return ISC_R_SUCCESS;
+}
+
 isc_result_t
 dns_message_parse(dns_message_t *msg, isc_buffer_t *source,
 		  unsigned int options) {
@@ -1739,6 +1943,7 @@ dns_message_parse(dns_message_t *msg, isc_buffer_t *source,
 	isc_buffer_t origsource;
 	bool seen_problem;
 	bool ignore_tc;
+	namecache_t namecache = { { 0 } };
 
 	REQUIRE(DNS_MESSAGE_VALID(msg));
 	REQUIRE(source != NULL);
@@ -1783,7 +1988,7 @@ dns_message_parse(dns_message_t *msg, isc_buffer_t *source,
 
 	dctx = DNS_DECOMPRESS_ALWAYS;
 
-	ret = getquestions(source, msg, dctx, options);
+	ret = getquestions(source, msg, dctx, namecache, options);
 
 	if (ret == ISC_R_UNEXPECTEDEND && ignore_tc) {
 		goto truncated;
@@ -1797,7 +2002,31 @@ dns_message_parse(dns_message_t *msg, isc_buffer_t *source,
 	}
 	msg->question_ok = 1;
 
-	ret = getsection(source, msg, dctx, DNS_SECTION_ANSWER, options);
+	/*
+	 * Only the question and the additional section of most queries
+	 * matter, so the rest can be parsed when it is needed.
+	 */
+	if ((options & DNS_MESSAGEPARSE_DEFER) != 0 && !ignore_tc &&
+	    msg->opcode == dns_opcode_query &&
+	    (msg->counts[DNS_SECTION_ANSWER] != 0 ||
+	     msg->counts[DNS_SECTION_AUTHORITY] != 0))
+	{
+		unsigned int deferred = source->current;
+
+		ret = skipsection(source, msg, DNS_SECTION_ANSWER);
+		if (ret == ISC_R_SUCCESS) {
+			ret = skipsection(source, msg, DNS_SECTION_AUTHORITY);
+		}
+		if (ret != ISC_R_SUCCESS) {
+			return ret;
+		}
+		msg->deferred = deferred;
+		msg->deferred_options = options;
+		goto additional;
+	}
+
+	ret = getsection(source, msg, dctx, namecache, DNS_SECTION_ANSWER,
+			 options);
 	if (ret == ISC_R_UNEXPECTEDEND && ignore_tc) {
 		goto truncated;
 	}
@@ -1809,7 +2038,8 @@ dns_message_parse(dns_message_t *msg, isc_buffer_t *source,
 		return ret;
 	}
 
-	ret = getsection(source, msg, dctx, DNS_SECTION_AUTHORITY, options);
+	ret = getsection(source, msg, dctx, namecache, DNS_SECTION_AUTHORITY,
+			 options);
 	if (ret == ISC_R_UNEXPECTEDEND && ignore_tc) {
 		goto truncated;
 	}
@@ -1821,7 +2051,10 @@ dns_message_parse(dns_message_t *msg, isc_buffer_t *source,
 		return ret;
 	}
 
-	ret = getsection(source, msg, dctx, DNS_SECTION_ADDITIONAL, options);
+additional:
+
+	ret = getsection(source, msg, dctx, namecache, DNS_SECTION_ADDITIONAL,
+			 options);
 	if (ret == ISC_R_UNEXPECTEDEND && ignore_tc) {
 		goto truncated;
 	}
@@ -1852,6 +2085,49 @@ truncated:
 	return ISC_R_SUCCESS;
 }
 
+isc_result_t
+dns_message_parsedeferred(dns_message_t *msg) {
+	isc_buffer_t source;
+	isc_result_t result;
+	bool seen_problem = false;
+	namecache_t namecache = { { 0 } };
+
+	REQUIRE(DNS_MESSAGE_VALID(msg));
+	REQUIRE(msg->from_to_wire == DNS_MESSAGE_INTENTPARSE);
+
+	if (msg->deferred == 0) {
+		return ISC_R_SUCCESS;
+	}
+
+	INSIST(msg->saved.base != NULL);
+	isc_buffer_init(&source, msg->saved.base, msg->saved.length);
+	isc_buffer_add(&source, msg->saved.length);
+	isc_buffer_forward(&source, msg->deferred);
+	msg->deferred = 0;
+
+	result = getsection(&source, msg, DNS_DECOMPRESS_ALWAYS, namecache,
+			    DNS_SECTION_ANSWER, msg->deferred_options);
+	if (result == DNS_R_RECOVERABLE) {
+		seen_problem = true;
+		result = ISC_R_SUCCESS;
+	}
+	if (result != ISC_R_SUCCESS) {
+		return result;
+	}
+
+	result = getsection(&source, msg, DNS_DECOMPRESS_ALWAYS, namecache,
+			    DNS_SECTION_AUTHORITY, msg->deferred_options);
+	if (result == DNS_R_RECOVERABLE) {
+		seen_problem = true;
+		result = ISC_R_SUCCESS;
+	}
+	if (result != ISC_R_SUCCESS) {
+		return result;
+	}
+
+	return seen_problem ? DNS_R_RECOVERABLE : ISC_R_SUCCESS;
+}
+
 isc_result_t
 dns_message_renderbegin(dns_message_t *msg, dns_compress_t *cctx,
 			isc_buffer_t *buffer) {
@@ -2238,6 +2514,78 @@ dns_message_rendersection(dns_message_t *msg, dns_section_t sectionid,
 	return ISC_R_SUCCESS;
 }
 
+isc_result_t
+dns_message_renderwire(dns_message_t *msg, dns_section_t sectionid,
+		       const isc_region_t *wire, unsigned int count) {
+	isc_region_t r;
+
+	REQUIRE(DNS_MESSAGE_VALID(msg));
+	REQUIRE(msg->buffer != NULL);
+	REQUIRE(VALID_NAMED_SECTION(sectionid));
+	REQUIRE(wire != NULL);
+
+	isc_buffer_availableregion(msg->buffer, &r);
+	if (r.length < msg->reserved ||
+	    r.length - msg->reserved < wire->length)
+	{
+		return ISC_R_NOSPACE;
+	}
+
+	isc_buffer_putmem(msg->buffer, wire->base, wire->length);
+	msg->counts[sectionid] += count;
+
+	return ISC_R_SUCCESS;
+}
+
+isc_result_t
+dns_message_renderrr(dns_message_t *msg, dns_section_t sectionid,
+		     const dns_name_t *owner, dns_ttl_t ttl,
+		     const dns_rdata_t *rdata) {
+	isc_buffer_t saved;
+	isc_result_t result;
+
+	REQUIRE(DNS_MESSAGE_VALID(msg));
+	REQUIRE(msg->buffer != NULL);
+	REQUIRE(VALID_NAMED_SECTION(sectionid));
+	REQUIRE(sectionid != DNS_SECTION_QUESTION);
+	REQUIRE(owner != NULL);
+	REQUIRE(rdata != NULL);
+
+	/*
+	 * Shrink the space in the buffer by the reserved amount.
+	 */
+	if (msg->buffer->length - msg->buffer->used < msg->reserved) {
+		return ISC_R_NOSPACE;
+	}
+	saved = *msg->buffer;
+	msg->buffer->length -= msg->reserved;
+
+	dns_compress_setpermitted(msg->cctx, true);
+	result = dns_name_towire(owner, msg->cctx, msg->buffer, NULL);
+	if (result != ISC_R_SUCCESS) {
+		goto rollback;
+	}
+	if (isc_buffer_availablelength(msg->buffer) < 10 + rdata->length) {
+		result = ISC_R_NOSPACE;
+		goto rollback;
+	}
+	isc_buffer_putuint16(msg->buffer, rdata->type);
+	isc_buffer_putuint16(msg->buffer, rdata->rdclass);
+	isc_buffer_putuint32(msg->buffer, ttl);
+	isc_buffer_putuint16(msg->buffer, (uint16_t)rdata->length);
+	isc_buffer_putmem(msg->buffer, rdata->data, rdata->length);
+
+	msg->buffer->length += msg->reserved;
+	msg->counts[sectionid]++;
+
+	return ISC_R_SUCCESS;
+
+rollback:
+	dns_compress_rollback(msg->cctx, saved.used);
+	*msg->buffer = saved;
+	return result;
+}
+
 void
 dns_message_renderheader(dns_message_t *msg, isc_buffer_t *target) {
 	uint16_t tmp;
@@ -2778,6 +3126,7 @@ dns_message_reply(dns_message_t *msg, bool want_question_section) {
 			return result;
 		}
 	}
+	msg->deferred = 0;
 	if (msg->saved.base != NULL) {
 		msg->query.base = msg->saved.base;
 		msg->query.length = msg->saved.length;
@@ -17,12 +17,12 @@
 #include <stdbool.h>
 
 #include <isc/async.h>
+#include <isc/brlock.h>
 #include <isc/buffer.h>
 #include <isc/log.h>
 #include <isc/loop.h>
 #include <isc/mem.h>
 #include <isc/result.h>
-#include <isc/rwlock.h>
 #include <isc/string.h>
 #include <isc/time.h>
 #include <isc/timer.h>
@@ -41,10 +41,12 @@ struct dns_ntatable {
 	unsigned int magic;
 	isc_mem_t *mctx;
 	dns_view_t *view;
-	isc_rwlock_t rwlock;
+	isc_brlock_t lock;
 	isc_loopmgr_t *loopmgr;
 	isc_refcount_t references;
 	dns_qpmulti_t *table;
+	/* The NTAs in 'table', so that an empty table isn't searched */
+	atomic_uint_fast32_t count;
 	atomic_bool shuttingdown;
 };
 
@@ -127,7 +129,7 @@ dns_ntatable_create(dns_view_t *view, isc_loopmgr_t *loopmgr,
 	isc_mem_attach(view->mctx, &ntatable->mctx);
 	dns_view_weakattach(view, &ntatable->view);
 
-	isc_rwlock_init(&ntatable->rwlock);
+	isc_brlock_init(&ntatable->lock, ntatable->mctx);
 	dns_qpmulti_create(view->mctx, &qpmethods, view, &ntatable->table);
 
 	isc_refcount_init(&ntatable->references, 1);
@@ -139,7 +141,7 @@ dns_ntatable_create(dns_view_t *view, isc_loopmgr_t *loopmgr,
 static void
 dns__ntatable_destroy(dns_ntatable_t *ntatable) {
 	ntatable->magic = 0;
-	isc_rwlock_destroy(&ntatable->rwlock);
+	isc_brlock_destroy(&ntatable->lock);
 	dns_qpmulti_destroy(&ntatable->table);
 	INSIST(ntatable->view == NULL);
 	isc_mem_putanddetach(&ntatable->mctx, ntatable, sizeof(*ntatable));
@@ -186,11 +188,11 @@ fetch_done(void *arg) {
 	case DNS_R_NXDOMAIN:
 	case DNS_R_NCACHENXRRSET:
 	case DNS_R_NXRRSET:
-		RWLOCK(&ntatable->rwlock, isc_rwlocktype_write);
+		isc_brlock_wrlock(&ntatable->lock);
 		if (nta->expiry > now) {
 			nta->expiry = now;
 		}
-		RWUNLOCK(&ntatable->rwlock, isc_rwlocktype_write);
+		isc_brlock_wrunlock(&ntatable->lock);
 		break;
 	default:
 		break;
@@ -200,11 +202,11 @@ fetch_done(void *arg) {
 	 * If we're expiring before the next recheck, we might
 	 * as well stop the timer now.
 	 */
-	RWLOCK(&ntatable->rwlock, isc_rwlocktype_read);
+	isc_brlock_rdlock(&ntatable->lock);
 	if (nta->timer != NULL && nta->expiry - now < view->nta_recheck) {
 		isc_timer_stop(nta->timer);
 	}
-	RWUNLOCK(&ntatable->rwlock, isc_rwlocktype_read);
+	isc_brlock_rdunlock(&ntatable->lock);
 
 	dns__nta_detach(&nta); /* for dns_resolver_createfetch() */
 }
@@ -308,12 +310,15 @@ dns_ntatable_add(dns_ntatable_t *ntatable, const dns_name_t *name, bool force,
 		return ISC_R_SUCCESS;
 	}
 
-	RWLOCK(&ntatable->rwlock, isc_rwlocktype_write);
+	isc_brlock_wrlock(&ntatable->lock);
 	dns_qpmulti_write(ntatable->table, &qp);
 	nta_create(ntatable, name, &nta);
 	nta->forced = force;
 
 	result = dns_qp_insert(qp, nta, 0);
+	if (result == ISC_R_SUCCESS) {
+		atomic_fetch_add_release(&ntatable->count, 1);
+	}
 	switch (result) {
 	case ISC_R_EXISTS:
 		result = dns_qp_getname(qp, &nta->name, &pval, NULL);
@@ -340,7 +345,7 @@ dns_ntatable_add(dns_ntatable_t *ntatable, const dns_name_t *name, bool force,
 
 	dns_qp_compact(qp, DNS_QPGC_MAYBE);
 	dns_qpmulti_commit(ntatable->table, &qp);
-	RWUNLOCK(&ntatable->rwlock, isc_rwlocktype_write);
+	isc_brlock_wrunlock(&ntatable->lock);
 
 	return result;
 }
@@ -358,6 +363,7 @@ dns_ntatable_delete(dns_ntatable_t *ntatable, const dns_name_t *name) {
 	result = dns_qp_deletename(qp, name, &pval, NULL);
 	if (result == ISC_R_SUCCESS) {
 		dns__nta_t *n = pval;
+		atomic_fetch_sub_release(&ntatable->count, 1);
 		dns__nta_shutdown(n);
 		dns__nta_detach(&n);
 	}
@@ -377,7 +383,7 @@ delete_expired(void *arg) {
 
 	REQUIRE(VALID_NTATABLE(ntatable));
 
-	RWLOCK(&ntatable->rwlock, isc_rwlocktype_write);
+	isc_brlock_wrlock(&ntatable->lock);
 	dns_qpmulti_write(ntatable->table, &qp);
 	result = dns_qp_getname(qp, &nta->name, &pval, NULL);
 	if (result == ISC_R_SUCCESS &&
@@ -388,12 +394,13 @@ delete_expired(void *arg) {
 		isc_log_write(DNS_LOGCATEGORY_DNSSEC, DNS_LOGMODULE_NTA,
 			      ISC_LOG_INFO, "deleting expired NTA at %s", nb);
 		dns_qp_deletename(qp, &nta->name, NULL, NULL);
+		atomic_fetch_sub_release(&ntatable->count, 1);
 		dns__nta_shutdown(nta);
 		dns__nta_unref(nta);
 	}
 	dns_qp_compact(qp, DNS_QPGC_MAYBE);
 	dns_qpmulti_commit(ntatable->table, &qp);
-	RWUNLOCK(&ntatable->rwlock, isc_rwlocktype_write);
+	isc_brlock_wrunlock(&ntatable->lock);
 	dns__nta_detach(&nta);
 	dns_ntatable_detach(&ntatable);
 }
@@ -410,7 +417,12 @@ dns_ntatable_covered(dns_ntatable_t *ntatable, isc_stdtime_t now,
 	REQUIRE(VALID_NTATABLE(ntatable));
 	REQUIRE(dns_name_isabsolute(name));
 
-	RWLOCK(&ntatable->rwlock, isc_rwlocktype_read);
+	/* Usually there are no NTAs at all */
+	if (atomic_load_acquire(&ntatable->count) == 0) {
+		return false;
+	}
+
+	isc_brlock_rdlock(&ntatable->lock);
 	dns_qpmulti_query(ntatable->table, &qpr);
 	result = dns_qp_lookup(&qpr, name, NULL, NULL, NULL, &pval, NULL);
 	nta = pval;
@@ -444,7 +456,7 @@ dns_ntatable_covered(dns_ntatable_t *ntatable, isc_stdtime_t now,
 
 	answer = true;
 done:
-	RWUNLOCK(&ntatable->rwlock, isc_rwlocktype_read);
+	isc_brlock_rdunlock(&ntatable->lock);
 	dns_qpread_destroy(ntatable->table, &qpr);
 	return answer;
 }
@@ -474,7 +486,7 @@ dns_ntatable_totext(dns_ntatable_t *ntatable, const char *view,
 
 	REQUIRE(VALID_NTATABLE(ntatable));
 
-	RWLOCK(&ntatable->rwlock, isc_rwlocktype_read);
+	isc_brlock_rdlock(&ntatable->lock);
 	dns_qpmulti_query(ntatable->table, &qpr);
 	dns_qpiter_init(&qpr, &iter);
 
@@ -515,7 +527,7 @@ dns_ntatable_totext(dns_ntatable_t *ntatable, const char *view,
 
 cleanup:
 	dns_qpread_destroy(ntatable->table, &qpr);
-	RWUNLOCK(&ntatable->rwlock, isc_rwlocktype_read);
+	isc_brlock_rdunlock(&ntatable->lock);
 	return result;
 }
 
@@ -530,7 +542,7 @@ dns_ntatable_save(dns_ntatable_t *ntatable, FILE *fp) {
 
 	REQUIRE(VALID_NTATABLE(ntatable));
 
-	RWLOCK(&ntatable->rwlock, isc_rwlocktype_read);
+	isc_brlock_rdlock(&ntatable->lock);
 	dns_qpmulti_query(ntatable->table, &qpr);
 	dns_qpiter_init(&qpr, &iter);
 
@@ -568,7 +580,7 @@ dns_ntatable_save(dns_ntatable_t *ntatable, FILE *fp) {
 	}
 
 	dns_qpread_destroy(ntatable->table, &qpr);
-	RWUNLOCK(&ntatable->rwlock, isc_rwlocktype_read);
+	isc_brlock_rdunlock(&ntatable->lock);
 
 	if (result == ISC_R_SUCCESS && !written) {
 		result = ISC_R_NOTFOUND;
@@ -615,7 +627,7 @@ dns_ntatable_shutdown(dns_ntatable_t *ntatable) {
 
 	REQUIRE(VALID_NTATABLE(ntatable));
 
-	RWLOCK(&ntatable->rwlock, isc_rwlocktype_write);
+	isc_brlock_wrlock(&ntatable->lock);
 	dns_qpmulti_query(ntatable->table, &qpr);
 	ntatable->shuttingdown = true;
 
@@ -628,7 +640,7 @@ dns_ntatable_shutdown(dns_ntatable_t *ntatable) {
 
 	dns_qpread_destroy(ntatable->table, &qpr);
 	dns_view_weakdetach(&ntatable->view);
-	RWUNLOCK(&ntatable->rwlock, isc_rwlocktype_write);
+	isc_brlock_wrunlock(&ntatable->lock);
 }
 
 static void
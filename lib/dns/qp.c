@@ -15,19 +15,26 @@
  * For an overview, see doc/design/qp-trie.md
  */
 
+#include <fcntl.h>
 #include <inttypes.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <string.h>
-
-#if FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
 #endif
 
 #include <isc/atomic.h>
 #include <isc/buffer.h>
+#include <isc/errno.h>
+#include <isc/file.h>
 #include <isc/log.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
@@ -35,6 +42,7 @@
 #include <isc/refcount.h>
 #include <isc/result.h>
 #include <isc/rwlock.h>
+#include <isc/stdio.h>
 #include <isc/tid.h>
 #include <isc/time.h>
 #include <isc/types.h>
@@ -131,6 +139,20 @@ uint16_t dns_qp_bits_for_byte[BYTE_VALUES] = { 0 };
  */
 uint8_t dns_qp_byte_for_bit[SHIFT_OFFSET] = { 0 };
 
+/*
+ * Within each of these byte ranges, every byte maps to a single bit
+ * position at a fixed distance from the byte value, so runs of them
+ * can be converted with vector arithmetic instead of table lookups.
+ * The distances are taken from the lookup table at program startup.
+ */
+static struct {
+	uint8_t lo, hi, delta;
+} qpkey_ranges[] = {
+	{ '-', '9', 0 },
+	{ 'A', 'Z', 0 },
+	{ '_', 'z', 0 },
+};
+
 /*
  * Fill in the lookup tables at program startup. (It doesn't matter
  * when this is initialized relative to other startup code.)
@@ -191,8 +213,74 @@ initialize_bits_for_byte(void) {
 		}
 	}
 	ENSURE(bit_one < SHIFT_OFFSET);
+
+	for (size_t i = 0; i < ARRAY_SIZE(qpkey_ranges); i++) {
+		uint8_t lo = qpkey_ranges[i].lo;
+		uint8_t delta = dns_qp_bits_for_byte[lo] - lo;
+		for (unsigned int byte = lo; byte <= qpkey_ranges[i].hi;
+		     byte++)
+		{
+			INSIST(dns_qp_bits_for_byte[byte] ==
+			       (uint8_t)(byte + delta));
+		}
+		qpkey_ranges[i].delta = delta;
+	}
 }
 
+/*
+ * Convert QPKEY_VECTOR bytes of a label into key bytes, assuming that
+ * they are all in the `qpkey_ranges`. Returns a bitmap of the bytes
+ * that were, so the caller knows how much of the output is valid.
+ */
+#if defined(__SSE2__)
+#define QPKEY_VECTOR 16
+static inline unsigned int
+qpkey_vector(dns_qpshift_t *key, const uint8_t *ldata) {
+	__m128i bytes = _mm_loadu_si128((const __m128i *)ldata);
+	__m128i shifts = bytes;
+	__m128i valid = _mm_setzero_si128();
+
+	/* the signed comparisons are OK with all the ranges below 0x80 */
+	for (size_t i = 0; i < ARRAY_SIZE(qpkey_ranges); i++) {
+		__m128i lo = _mm_set1_epi8(qpkey_ranges[i].lo - 1);
+		__m128i hi = _mm_set1_epi8(qpkey_ranges[i].hi + 1);
+		__m128i delta = _mm_set1_epi8(qpkey_ranges[i].delta);
+		__m128i in = _mm_and_si128(_mm_cmpgt_epi8(bytes, lo),
+					   _mm_cmplt_epi8(bytes, hi));
+		shifts = _mm_add_epi8(shifts, _mm_and_si128(in, delta));
+		valid = _mm_or_si128(valid, in);
+	}
+
+	_mm_storeu_si128((__m128i *)key, shifts);
+	return _mm_movemask_epi8(valid);
+}
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define QPKEY_VECTOR 16
+static inline unsigned int
+qpkey_vector(dns_qpshift_t *key, const uint8_t *ldata) {
+	static const uint8_t weights[16] = { 1, 2, 4, 8, 16, 32, 64, 128,
+					     1, 2, 4, 8, 16, 32, 64, 128 };
+	uint8x16_t bytes = vld1q_u8(ldata);
+	uint8x16_t shifts = bytes;
+	uint8x16_t valid = vdupq_n_u8(0);
+
+	for (size_t i = 0; i < ARRAY_SIZE(qpkey_ranges); i++) {
+		uint8x16_t in = vandq_u8(
+			vcgeq_u8(bytes, vdupq_n_u8(qpkey_ranges[i].lo)),
+			vcleq_u8(bytes, vdupq_n_u8(qpkey_ranges[i].hi)));
+		shifts = vaddq_u8(
+			shifts,
+			vandq_u8(in, vdupq_n_u8(qpkey_ranges[i].delta)));
+		valid = vorrq_u8(valid, in);
+	}
+
+	vst1q_u8(key, shifts);
+	valid = vandq_u8(valid, vld1q_u8(weights));
+	return vaddv_u8(vget_low_u8(valid)) |
+	       (unsigned int)vaddv_u8(vget_high_u8(valid)) << 8;
+}
+#endif
+
 /*
  * Convert a DNS name into a trie lookup key.
  *
@@ -233,6 +321,29 @@ dns_qpkey_fromname(dns_qpkey_t key, const dns_name_t *name) {
 	while (label-- > 0) {
 		const uint8_t *ldata = name->ndata + name->offsets[label];
 		size_t label_len = *ldata++;
+#ifdef QPKEY_VECTOR
+		/*
+		 * Convert the label a vector at a time while it is made of
+		 * hostname characters. The loads may run past the end of
+		 * the label into the rest of the name (but not past the end
+		 * of the name), and the stores past the end of the label's
+		 * part of the key; that part is then overwritten by what
+		 * comes after it, or is beyond the end of the key.
+		 */
+		const uint8_t *end = name->ndata + name->length;
+		while (label_len > 0 && end - ldata >= QPKEY_VECTOR &&
+		       len + QPKEY_VECTOR <= sizeof(dns_qpkey_t))
+		{
+			size_t count = ISC_MIN(label_len, QPKEY_VECTOR);
+			unsigned int want = (1U << count) - 1;
+			if ((qpkey_vector(&key[len], ldata) & want) != want) {
+				break;
+			}
+			ldata += count;
+			len += count;
+			label_len -= count;
+		}
+#endif
 		while (label_len-- > 0) {
 			uint16_t bits = dns_qp_bits_for_byte[*ldata++];
 			key[len++] = bits & 0xFF;	/* bit_one */
@@ -359,6 +470,211 @@ qpkey_compare(const dns_qpkey_t key_a, const size_t keylen_a,
 	return QPKEY_EQUAL;
 }
 
+/***********************************************************************
+ *
+ *  huge page regions
+ */
+
+/*
+ * When it is enabled and a trie has grown big enough, its chunks are
+ * carved out of regions of QP_REGION_BYTES allocated from the trie's
+ * memory context, and the kernel is asked to back the parts of each
+ * region that are aligned to QP_HUGEPAGE_BYTES with transparent huge
+ * pages. A lookup in a big trie then needs far fewer TLB entries than
+ * when every chunk is a separate allocation. Small tries keep using
+ * ordinary chunks so that they don't waste most of a region.
+ *
+ * The regions are kept sorted by address, so that the region a chunk
+ * belongs to can be found when the chunk is freed. A region is freed
+ * as soon as none of its chunks is in use.
+ */
+
+#define QP_HUGEPAGE_BYTES (2U * 1024 * 1024)
+/* at least two huge pages, and a whole number of bitmap words */
+#define QP_REGION_WORDS                                      \
+	((2 * QP_HUGEPAGE_BYTES + 64 * QP_CHUNK_BYTES - 1) / \
+	 (64 * QP_CHUNK_BYTES))
+#define QP_REGION_CHUNKS (QP_REGION_WORDS * 64)
+#define QP_REGION_BYTES	 (QP_REGION_CHUNKS * QP_CHUNK_BYTES)
+
+typedef struct qp_region {
+	uint8_t *base;
+	/*% chunks in use */
+	unsigned int used;
+	/*% bytes of the region that can be backed by huge pages */
+	size_t hugepage_bytes;
+	/*% a bit is set for each free chunk */
+	uint64_t free[QP_REGION_WORDS];
+} qp_region_t;
+
+struct qp_regions {
+	/*% sorted by base address */
+	qp_region_t **region;
+	size_t count, max;
+	/*% chunks in use in all the regions */
+	size_t chunks;
+	/*% total of the regions' hugepage_bytes */
+	size_t hugepage_bytes;
+};
+
+static qp_region_t *
+region_find(qp_regions_t *regions, const void *ptr) {
+	uintptr_t addr = (uintptr_t)ptr;
+	size_t lo = 0, hi = regions->count;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		qp_region_t *region = regions->region[mid];
+		uintptr_t base = (uintptr_t)region->base;
+
+		if (addr < base) {
+			hi = mid;
+		} else if (addr >= base + QP_REGION_BYTES) {
+			lo = mid + 1;
+		} else {
+			return region;
+		}
+	}
+
+	return NULL;
+}
+
+static qp_region_t *
+region_new(dns_qp_t *qp) {
+	qp_regions_t *regions = qp->regions;
+	qp_region_t *region = isc_mem_get(qp->mctx, sizeof(*region));
+	*region = (qp_region_t){
+		.base = isc_mem_get(qp->mctx, QP_REGION_BYTES),
+	};
+	memset(region->free, 0xff, sizeof(region->free));
+
+	uintptr_t base = (uintptr_t)region->base;
+	uintptr_t start = (base + QP_HUGEPAGE_BYTES - 1) &
+			  ~(uintptr_t)(QP_HUGEPAGE_BYTES - 1);
+	uintptr_t end = (base + QP_REGION_BYTES) &
+			~(uintptr_t)(QP_HUGEPAGE_BYTES - 1);
+	if (start < end) {
+		region->hugepage_bytes = end - start;
+#ifdef MADV_HUGEPAGE
+		(void)madvise((void *)start, end - start, MADV_HUGEPAGE);
+#endif /* ifdef MADV_HUGEPAGE */
+	}
+	regions->hugepage_bytes += region->hugepage_bytes;
+
+	if (regions->count == regions->max) {
+		size_t newmax = ISC_MAX(8, regions->max * 2);
+		regions->region = isc_mem_creget(qp->mctx, regions->region,
+						 regions->max, newmax,
+						 sizeof(regions->region[0]));
+		regions->max = newmax;
+	}
+
+	size_t i = regions->count;
+	while (i > 0 && (uintptr_t)regions->region[i - 1]->base > base) {
+		regions->region[i] = regions->region[i - 1];
+		i--;
+	}
+	regions->region[i] = region;
+	regions->count++;
+
+	return region;
+}
+
+static void
+region_free(dns_qp_t *qp, qp_region_t *region) {
+	qp_regions_t *regions = qp->regions;
+	size_t i = 0;
+
+	INSIST(region->used == 0);
+
+	while (regions->region[i] != region) {
+		i++;
+	}
+	regions->count--;
+	memmove(&regions->region[i], &regions->region[i + 1],
+		(regions->count - i) * sizeof(regions->region[0]));
+
+	regions->hugepage_bytes -= region->hugepage_bytes;
+	isc_mem_put(qp->mctx, region->base, QP_REGION_BYTES);
+	isc_mem_put(qp->mctx, region, sizeof(*region));
+}
+
+static void *
+region_chunk_get(dns_qp_t *qp) {
+	qp_regions_t *regions = qp->regions;
+	qp_region_t *region = NULL;
+
+	for (size_t i = 0; i < regions->count; i++) {
+		if (regions->region[i]->used < QP_REGION_CHUNKS) {
+			region = regions->region[i];
+			break;
+		}
+	}
+	if (region == NULL) {
+		region = region_new(qp);
+	}
+
+	for (size_t w = 0; w < QP_REGION_WORDS; w++) {
+		if (region->free[w] != 0) {
+			size_t bit = __builtin_ctzll(region->free[w]);
+			region->free[w] &= ~((uint64_t)1 << bit);
+			region->used++;
+			regions->chunks++;
+			return region->base + (w * 64 + bit) * QP_CHUNK_BYTES;
+		}
+	}
+
+	UNREACHABLE();
+}
+
+static void
+region_chunk_put(dns_qp_t *qp, qp_region_t *region, void *ptr) {
+	size_t chunk = ((uint8_t *)ptr - region->base) / QP_CHUNK_BYTES;
+	uint64_t mask = (uint64_t)1 << (chunk % 64);
+
+	INSIST((region->free[chunk / 64] & mask) == 0);
+	region->free[chunk / 64] |= mask;
+	region->used--;
+	qp->regions->chunks--;
+
+	if (region->used == 0) {
+		region_free(qp, region);
+	}
+}
+
+static void
+regions_destroy(dns_qp_t *qp) {
+	qp_regions_t *regions = qp->regions;
+
+	qp->regions = NULL;
+	if (regions == NULL) {
+		return;
+	}
+
+	INSIST(regions->count == 0);
+	isc_mem_cput(qp->mctx, regions->region, regions->max,
+		     sizeof(regions->region[0]));
+	isc_mem_put(qp->mctx, regions, sizeof(*regions));
+}
+
+/*
+ * Use the regions once the trie has a region's worth of nodes, and keep
+ * using them until it has shrunk to half that, so that the regions of a
+ * trie that has been emptied can drain and be freed.
+ */
+#define QP_REGION_NODES (QP_REGION_BYTES / sizeof(dns_qpnode_t))
+
+static bool
+regions_wanted(dns_qp_t *qp) {
+	if (qp->regions == NULL) {
+		return false;
+	} else if (qp->regions->count > 0) {
+		return qp->used_count >= QP_REGION_NODES / 2;
+	} else {
+		return qp->used_count >= QP_REGION_NODES;
+	}
+}
+
 /***********************************************************************
  *
  *  allocator wrappers
@@ -371,7 +687,8 @@ qpkey_compare(const dns_qpkey_t key_a, const size_t keylen_a,
  * memory protection to ensure that the shared chunks are not modified.
  * Once a chunk becomes shared, it remains read-only until it is freed.
  * POSIX says we have to use mmap() to get an allocation that we can
- * definitely pass to mprotect().
+ * definitely pass to mprotect(), so the huge page regions are not used
+ * when the chunks are write protected.
  */
 
 static size_t
@@ -380,62 +697,74 @@ chunk_size_raw(void) {
 	return ISC_MAX(size, QP_CHUNK_BYTES);
 }
 
+static void
+write_protect(dns_qp_t *qp, dns_qpchunk_t chunk) {
+	if (qp->write_protect) {
+		/* see transaction_open() wrt this special case */
+		if (qp->transaction_mode == QP_WRITE && chunk == qp->bump) {
+			return;
+		}
+		TRACE("chunk %u", chunk);
+		void *ptr = qp->base->ptr[chunk];
+		size_t size = chunk_size_raw();
+		RUNTIME_CHECK(mprotect(ptr, size, PROT_READ) >= 0);
+	}
+}
+
+#else
+
+#define write_protect(qp, chunk)
+
+#endif
+
 static void *
 chunk_get_raw(dns_qp_t *qp) {
+#if FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION
 	if (qp->write_protect) {
 		size_t size = chunk_size_raw();
 		void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
 				 MAP_ANON | MAP_PRIVATE, -1, 0);
 		RUNTIME_CHECK(ptr != MAP_FAILED);
 		return ptr;
-	} else {
-		return isc_mem_allocate(qp->mctx, QP_CHUNK_BYTES);
 	}
+#endif
+	if (regions_wanted(qp)) {
+		return region_chunk_get(qp);
+	}
+	return isc_mem_allocate(qp->mctx, QP_CHUNK_BYTES);
 }
 
 static void
 chunk_free_raw(dns_qp_t *qp, void *ptr) {
+#if FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION
 	if (qp->write_protect) {
 		RUNTIME_CHECK(munmap(ptr, chunk_size_raw()) == 0);
-	} else {
-		isc_mem_free(qp->mctx, ptr);
+		return;
+	}
+#endif
+	if (qp->regions != NULL) {
+		qp_region_t *region = region_find(qp->regions, ptr);
+		if (region != NULL) {
+			region_chunk_put(qp, region, ptr);
+			return;
+		}
 	}
+	isc_mem_free(qp->mctx, ptr);
 }
 
 static void *
 chunk_shrink_raw(dns_qp_t *qp, void *ptr, size_t bytes) {
+#if FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION
 	if (qp->write_protect) {
 		return ptr;
-	} else {
-		return isc_mem_reallocate(qp->mctx, ptr, bytes);
 	}
-}
-
-static void
-write_protect(dns_qp_t *qp, dns_qpchunk_t chunk) {
-	if (qp->write_protect) {
-		/* see transaction_open() wrt this special case */
-		if (qp->transaction_mode == QP_WRITE && chunk == qp->bump) {
-			return;
-		}
-		TRACE("chunk %u", chunk);
-		void *ptr = qp->base->ptr[chunk];
-		size_t size = chunk_size_raw();
-		RUNTIME_CHECK(mprotect(ptr, size, PROT_READ) >= 0);
+#endif
+	if (qp->regions != NULL && region_find(qp->regions, ptr) != NULL) {
+		return ptr;
 	}
+	return isc_mem_reallocate(qp->mctx, ptr, bytes);
 }
 
-#else
-
-#define chunk_get_raw(qp)	isc_mem_allocate(qp->mctx, QP_CHUNK_BYTES)
-#define chunk_free_raw(qp, ptr) isc_mem_free(qp->mctx, ptr)
-
-#define chunk_shrink_raw(qp, ptr, size) isc_mem_reallocate(qp->mctx, ptr, size)
-
-#define write_protect(qp, chunk)
-
-#endif
-
 /***********************************************************************
  *
  *  allocator
@@ -891,12 +1220,32 @@ make_twigs_mutable(dns_qp_t *qp, dns_qpnode_t *n) {
  * nothing. So the evacuation check is the only place that the
  * algorithm introduces ref changes, that then bubble up towards the
  * root through the logic inside the loop.
+ *
+ * A pass that is limited by the compaction budget stops when the budget
+ * runs out, and unwinds recording the position of the child it was about
+ * to visit at each level. When `resume` is set, the next pass skips the
+ * twigs before that position, so it carries on where the last one
+ * stopped (or near enough, if the trie has changed in the mean time).
  */
 static dns_qpref_t
-compact_recursive(dns_qp_t *qp, dns_qpnode_t *parent) {
+compact_recursive(dns_qp_t *qp, dns_qpnode_t *parent, size_t depth,
+		  bool resume) {
 	dns_qpweight_t size = branch_twigs_size(parent);
 	dns_qpref_t twigs_ref = branch_twigs_ref(parent);
 	dns_qpchunk_t chunk = ref_chunk(twigs_ref);
+	dns_qpweight_t start = 0;
+
+	INSIST(depth < ARRAY_SIZE(qp->compact_path));
+
+	/*
+	 * The nodes on the way back to where we stopped were paid for in
+	 * the last pass (and must be free now, to ensure progress)
+	 */
+	if (resume) {
+		start = ISC_MIN(qp->compact_path[depth], size);
+	} else if (qp->compact_limited) {
+		qp->compact_left -= ISC_MIN(size, qp->compact_left);
+	}
 
 	if (qp->compact_all ||
 	    (chunk != qp->bump && chunk_usage(qp, chunk) < QP_MIN_USED))
@@ -904,29 +1253,51 @@ compact_recursive(dns_qp_t *qp, dns_qpnode_t *parent) {
 		twigs_ref = evacuate(qp, parent);
 	}
 	bool immutable = cells_immutable(qp, twigs_ref);
-	for (dns_qpweight_t pos = 0; pos < size; pos++) {
+	for (dns_qpweight_t pos = start; pos < size; pos++) {
 		dns_qpnode_t *child = ref_ptr(qp, twigs_ref) + pos;
 		if (!is_branch(child)) {
 			continue;
 		}
+		if (qp->compact_limited && qp->compact_left == 0) {
+			qp->compact_path[depth] = pos;
+			qp->compact_path[depth + 1] = 0;
+			qp->compact_resume = true;
+			break;
+		}
 		dns_qpref_t old_grandtwigs = branch_twigs_ref(child);
-		dns_qpref_t new_grandtwigs = compact_recursive(qp, child);
-		if (old_grandtwigs == new_grandtwigs) {
-			continue;
+		dns_qpref_t new_grandtwigs = compact_recursive(
+			qp, child, depth + 1, resume && pos == start);
+		if (old_grandtwigs != new_grandtwigs) {
+			if (immutable) {
+				twigs_ref = evacuate(qp, parent);
+				/* the twigs have moved */
+				child = ref_ptr(qp, twigs_ref) + pos;
+				immutable = false;
+			}
+			*child = make_node(branch_index(child),
+					   new_grandtwigs);
 		}
-		if (immutable) {
-			twigs_ref = evacuate(qp, parent);
-			/* the twigs have moved */
-			child = ref_ptr(qp, twigs_ref) + pos;
-			immutable = false;
+		if (qp->compact_resume) {
+			qp->compact_path[depth] = pos;
+			break;
 		}
-		*child = make_node(branch_index(child), new_grandtwigs);
 	}
 	return twigs_ref;
 }
 
-static void
-compact(dns_qp_t *qp) {
+/*
+ * Returns false if a limited pass ran out of budget before it finished,
+ * in which case the trie may still need compaction.
+ */
+static bool
+compact(dns_qp_t *qp, bool limited) {
+	bool resume = qp->compact_resume;
+
+	limited = limited && qp->compact_budget > 0 && !qp->compact_all;
+	if (limited && qp->compact_left == 0) {
+		return false;
+	}
+
 	LOG_STATS("qp compact before leaf %u live %u used %u free %u hold %u",
 		  qp->leaf_count, qp->used_count - qp->free_count,
 		  qp->used_count, qp->free_count, qp->hold_count);
@@ -937,18 +1308,25 @@ compact(dns_qp_t *qp) {
 		alloc_reset(qp);
 	}
 
+	qp->compact_limited = limited;
+	qp->compact_resume = false;
 	if (qp->leaf_count > 0) {
-		qp->root_ref = compact_recursive(qp, MOVABLE_ROOT(qp));
+		qp->root_ref = compact_recursive(qp, MOVABLE_ROOT(qp), 0,
+						 limited && resume);
 	}
+	qp->compact_limited = false;
 	qp->compact_all = false;
 
 	isc_nanosecs_t time = isc_time_monotonic() - start;
 	atomic_fetch_add_relaxed(&compact_time, time);
 
 	LOG_STATS("qp compact" PRItime
-		  "leaf %u live %u used %u free %u hold %u",
+		  "leaf %u live %u used %u free %u hold %u%s",
 		  time, qp->leaf_count, qp->used_count - qp->free_count,
-		  qp->used_count, qp->free_count, qp->hold_count);
+		  qp->used_count, qp->free_count, qp->hold_count,
+		  qp->compact_resume ? " (unfinished)" : "");
+
+	return !qp->compact_resume;
 }
 
 void
@@ -961,7 +1339,7 @@ dns_qp_compact(dns_qp_t *qp, dns_qpgc_t mode) {
 		alloc_reset(qp);
 		qp->compact_all = true;
 	}
-	compact(qp);
+	compact(qp, false);
 	recycle(qp);
 }
 
@@ -982,14 +1360,15 @@ dns_qp_compact(dns_qp_t *qp, dns_qpgc_t mode) {
  * when garbage collection might be worthwhile. Hence we can trigger
  * collection when garbage passes a threshold.
  *
- * XXXFANF: If we need to avoid latency outliers caused by compaction in
- * write transactions, we can check qp->transaction_mode here.
+ * To avoid latency outliers in light write transactions, compaction is
+ * limited by the trie's compaction budget (if it has one) so a big trie
+ * is compacted a piece at a time over several transactions.
  */
 static inline bool
 squash_twigs(dns_qp_t *qp, dns_qpref_t twigs, dns_qpweight_t size) {
 	bool destroyed = free_twigs(qp, twigs, size);
 	if (destroyed && QP_AUTOGC(qp)) {
-		compact(qp);
+		bool finished = compact(qp, qp->transaction_mode == QP_WRITE);
 		recycle(qp);
 		/*
 		 * This shouldn't happen if the garbage collector is
@@ -997,7 +1376,7 @@ squash_twigs(dns_qp_t *qp, dns_qpref_t twigs, dns_qpweight_t size) {
 		 * time and space, but recovery should be cheaper than
 		 * letting compact+recycle fail repeatedly.
 		 */
-		if (QP_AUTOGC(qp)) {
+		if (finished && QP_AUTOGC(qp)) {
 			isc_log_write(DNS_LOGCATEGORY_DATABASE,
 				      DNS_LOGMODULE_QP, ISC_LOG_NOTICE,
 				      "qp %p uctx \"%s\" compact/recycle "
@@ -1029,6 +1408,8 @@ dns_qp_memusage(dns_qp_t *qp) {
 		.node_size = sizeof(dns_qpnode_t),
 		.chunk_size = QP_CHUNK_SIZE,
 		.fragmented = QP_NEEDGC(qp),
+		.compact_budget = qp->compact_budget,
+		.compact_unfinished = qp->compact_resume,
 	};
 
 	for (dns_qpchunk_t chunk = 0; chunk < qp->chunk_max; chunk++) {
@@ -1045,6 +1426,14 @@ dns_qp_memusage(dns_qp_t *qp) {
 			 qp->chunk_max * sizeof(qp->base->ptr[0]) +
 			 qp->chunk_max * sizeof(qp->usage[0]);
 
+	/* the regions are allocated whole */
+	if (qp->regions != NULL) {
+		memusage.region_count = qp->regions->count;
+		memusage.hugepage_bytes = qp->regions->hugepage_bytes;
+		memusage.bytes -= qp->regions->chunks * QP_CHUNK_BYTES;
+		memusage.bytes += qp->regions->count * QP_REGION_BYTES;
+	}
+
 	return memusage;
 }
 
@@ -1068,6 +1457,45 @@ dns_qpmulti_memusage(dns_qpmulti_t *multi) {
 	return memusage;
 }
 
+void
+dns_qpmulti_setcompactbudget(dns_qpmulti_t *multi, unsigned int cells) {
+	REQUIRE(QPMULTI_VALID(multi));
+	LOCK(&multi->mutex);
+
+	dns_qp_t *qp = &multi->writer;
+	INSIST(QP_VALID(qp));
+	qp->compact_budget = cells;
+
+	UNLOCK(&multi->mutex);
+}
+
+static void
+sethugepages(dns_qp_t *qp) {
+	if (qp->regions == NULL) {
+		qp->regions = isc_mem_get(qp->mctx, sizeof(*qp->regions));
+		*qp->regions = (qp_regions_t){ 0 };
+	}
+}
+
+void
+dns_qp_sethugepages(dns_qp_t *qp) {
+	REQUIRE(QP_VALID(qp));
+
+	sethugepages(qp);
+}
+
+void
+dns_qpmulti_sethugepages(dns_qpmulti_t *multi) {
+	REQUIRE(QPMULTI_VALID(multi));
+	LOCK(&multi->mutex);
+
+	dns_qp_t *qp = &multi->writer;
+	INSIST(QP_VALID(qp));
+	sethugepages(qp);
+
+	UNLOCK(&multi->mutex);
+}
+
 void
 dns_qp_gctime(isc_nanosecs_t *compact_p, isc_nanosecs_t *recycle_p,
 	      isc_nanosecs_t *rollback_p) {
@@ -1140,6 +1568,7 @@ dns_qpmulti_write(dns_qpmulti_t *multi, dns_qp_t **qptp) {
 		alloc_reset(qp);
 	}
 	qp->transaction_mode = QP_WRITE;
+	qp->compact_left = qp->compact_budget;
 }
 
 /*
@@ -1220,12 +1649,16 @@ dns_qpmulti_commit(dns_qpmulti_t *multi, dns_qp_t **qptp) {
 
 	if (qp->transaction_mode == QP_UPDATE) {
 		/* minimize memory overhead */
-		compact(qp);
+		compact(qp, false);
 		multi->reader_ref = alloc_twigs(qp, READER_SIZE);
 		qp->base->ptr[qp->bump] = chunk_shrink_raw(
 			qp, qp->base->ptr[qp->bump],
 			qp->usage[qp->bump].used * sizeof(dns_qpnode_t));
 	} else {
+		/* spend what is left of the budget on an unfinished pass */
+		if (qp->compact_resume) {
+			compact(qp, true);
+		}
 		multi->reader_ref = alloc_twigs(qp, READER_SIZE);
 	}
 
@@ -1467,6 +1900,7 @@ dns_qpmulti_create(isc_mem_t *mctx, const dns_qpmethods_t *methods, void *uctx,
 static void
 destroy_guts(dns_qp_t *qp) {
 	if (qp->chunk_max == 0) {
+		regions_destroy(qp);
 		return;
 	}
 	for (dns_qpchunk_t chunk = 0; chunk < qp->chunk_max; chunk++) {
@@ -1474,6 +1908,7 @@ destroy_guts(dns_qp_t *qp) {
 			chunk_free(qp, chunk);
 		}
 	}
+	regions_destroy(qp);
 	ENSURE(qp->used_count == 0);
 	ENSURE(qp->free_count == 0);
 	ENSURE(isc_refcount_current(&qp->base->refcount) == 1);
@@ -1766,6 +2201,168 @@ dns_qp_deletename(dns_qp_t *qp, const dns_name_t *name, void **pval_r,
 	return dns_qp_deletekey(qp, key, keylen, pval_r, ival_r);
 }
 
+/***********************************************************************
+ *
+ *  bulk construction
+ */
+
+#define QPBUILD_MAGIC	 ISC_MAGIC('q', 'p', 'b', 'd')
+#define QPBUILD_VALID(b) ISC_MAGIC_VALID(b, QPBUILD_MAGIC)
+
+/*
+ * A branch on the path to the latest leaf, whose twigs are still being
+ * collected. The twig that contains the latest leaf is not in the
+ * `twigs` array yet: it is the next level up, or the latest leaf itself.
+ */
+typedef struct qpbuild_level {
+	size_t offset;
+	uint64_t bitmap;
+	dns_qpweight_t size;
+	dns_qpnode_t twigs[SHIFT_OFFSET - SHIFT_NOBYTE];
+} qpbuild_level_t;
+
+struct dns_qpbuild {
+	unsigned int magic;
+	dns_qp_t *qp;
+	/*% the latest leaf, and its key */
+	dns_qpnode_t leaf;
+	dns_qpkey_t key;
+	size_t keylen;
+	/*% the open branches, with increasing offsets */
+	unsigned int depth;
+	qpbuild_level_t levels[DNS_QP_MAXKEY];
+};
+
+/*
+ * Add the subtree containing the latest leaf to a level. It is the
+ * level's last twig, because the keys arrive in order.
+ */
+static void
+build_append(dns_qpbuild_t *build, qpbuild_level_t *level, dns_qpnode_t n) {
+	dns_qpshift_t bit = qpkey_bit(build->key, build->keylen,
+				      level->offset);
+	INSIST(level->size < ARRAY_SIZE(level->twigs));
+	level->twigs[level->size++] = n;
+	level->bitmap |= 1ULL << bit;
+}
+
+/*
+ * Close the top level, now that no more twigs can be added to it,
+ * and return its branch node.
+ */
+static dns_qpnode_t
+build_close(dns_qpbuild_t *build, dns_qpnode_t n) {
+	dns_qp_t *qp = build->qp;
+	qpbuild_level_t *level = &build->levels[--build->depth];
+
+	build_append(build, level, n);
+
+	dns_qpref_t ref = alloc_twigs(qp, level->size);
+	move_twigs(ref_ptr(qp, ref), level->twigs, level->size);
+
+	uint64_t index = BRANCH_TAG | level->bitmap |
+			 ((uint64_t)level->offset << SHIFT_OFFSET);
+	return make_node(index, ref);
+}
+
+void
+dns_qpbuild_start(dns_qp_t *qp, dns_qpbuild_t **buildp) {
+	dns_qpbuild_t *build = NULL;
+
+	REQUIRE(QP_VALID(qp));
+	REQUIRE(qp->leaf_count == 0);
+	REQUIRE(buildp != NULL && *buildp == NULL);
+
+	build = isc_mem_get(qp->mctx, sizeof(*build));
+	build->magic = QPBUILD_MAGIC;
+	build->qp = qp;
+	build->keylen = 0;
+	build->depth = 0;
+
+	*buildp = build;
+}
+
+isc_result_t
+dns_qpbuild_add(dns_qpbuild_t *build, void *pval, uint32_t ival) {
+	dns_qpnode_t new_leaf, n;
+	dns_qpkey_t new_key;
+	size_t new_keylen, offset;
+	dns_qp_t *qp = NULL;
+
+	REQUIRE(QPBUILD_VALID(build));
+
+	qp = build->qp;
+	new_leaf = make_leaf(pval, ival);
+	new_keylen = leaf_qpkey(qp, &new_leaf, new_key);
+
+	if (qp->leaf_count > 0) {
+		offset = qpkey_compare(new_key, new_keylen, build->key,
+				       build->keylen);
+		if (offset == QPKEY_EQUAL) {
+			return ISC_R_EXISTS;
+		}
+		if (qpkey_bit(new_key, new_keylen, offset) <
+		    qpkey_bit(build->key, build->keylen, offset))
+		{
+			return ISC_R_RANGE;
+		}
+
+		/*
+		 * The branches beyond the point where the keys differ
+		 * are complete. The subtree that contains the previous
+		 * leaf is added to the branch at that point, which is
+		 * created if it does not exist yet.
+		 */
+		n = build->leaf;
+		while (build->depth > 0 &&
+		       build->levels[build->depth - 1].offset > offset)
+		{
+			n = build_close(build, n);
+		}
+		if (build->depth == 0 ||
+		    build->levels[build->depth - 1].offset < offset)
+		{
+			INSIST(build->depth < ARRAY_SIZE(build->levels));
+			build->levels[build->depth++] = (qpbuild_level_t){
+				.offset = offset,
+			};
+		}
+		build_append(build, &build->levels[build->depth - 1], n);
+	}
+
+	build->leaf = new_leaf;
+	memmove(build->key, new_key, new_keylen + 1);
+	build->keylen = new_keylen;
+	attach_leaf(qp, &new_leaf);
+	qp->leaf_count++;
+
+	return ISC_R_SUCCESS;
+}
+
+void
+dns_qpbuild_finish(dns_qpbuild_t **buildp) {
+	dns_qpbuild_t *build = NULL;
+	dns_qp_t *qp = NULL;
+
+	REQUIRE(buildp != NULL && QPBUILD_VALID(*buildp));
+
+	build = *buildp;
+	*buildp = NULL;
+	qp = build->qp;
+
+	if (qp->leaf_count > 0) {
+		dns_qpnode_t n = build->leaf;
+		while (build->depth > 0) {
+			n = build_close(build, n);
+		}
+		qp->root_ref = alloc_twigs(qp, 1);
+		*ref_ptr(qp, qp->root_ref) = n;
+	}
+
+	build->magic = 0;
+	isc_mem_put(qp->mctx, build, sizeof(*build));
+}
+
 /***********************************************************************
  *  chains
  */
@@ -2016,6 +2613,96 @@ dns_qp_getname(dns_qpreadable_t qpr, const dns_name_t *name, void **pval_r,
 	return dns_qp_getkey(qpr, key, keylen, pval_r, ival_r);
 }
 
+void
+dns_qp_getnames(dns_qpreadable_t qpr, const dns_name_t *const *names,
+		size_t count, isc_result_t *results, void **pvals,
+		uint32_t *ivals) {
+	dns_qpreader_t *qp = dns_qpreader(qpr);
+	dns_qpkey_t keys[DNS_QP_BATCH];
+	size_t keylens[DNS_QP_BATCH];
+	dns_qpnode_t *nodes[DNS_QP_BATCH];
+	dns_qpnode_t *root = NULL;
+
+	REQUIRE(QP_VALID(qp));
+	REQUIRE(count == 0 || (names != NULL && results != NULL));
+
+	root = get_root(qp);
+
+	for (size_t base = 0; base < count; base += DNS_QP_BATCH) {
+		size_t batch = ISC_MIN(count - base, DNS_QP_BATCH);
+		size_t active = 0;
+
+		for (size_t i = 0; i < batch; i++) {
+			results[base + i] = ISC_R_NOTFOUND;
+			nodes[i] = root;
+			if (root != NULL) {
+				keylens[i] = dns_qpkey_fromname(
+					keys[i], names[base + i]);
+			}
+		}
+		if (root != NULL && is_branch(root)) {
+			prefetch_twigs(qp, root);
+			active = batch;
+		}
+
+		/*
+		 * Take one step down the trie for each search in turn,
+		 * prefetching the next twig vector, so that by the time
+		 * we come back to a search its twigs are in the cache.
+		 */
+		while (active > 0) {
+			for (size_t i = 0; i < batch; i++) {
+				dns_qpnode_t *n = nodes[i];
+				dns_qpshift_t bit;
+
+				if (n == NULL || !is_branch(n)) {
+					continue;
+				}
+
+				bit = branch_keybit(n, keys[i], keylens[i]);
+				if (!branch_has_twig(n, bit)) {
+					nodes[i] = NULL;
+					active--;
+					continue;
+				}
+
+				n = branch_twig_ptr(qp, n, bit);
+				nodes[i] = n;
+				if (is_branch(n)) {
+					prefetch_twigs(qp, n);
+				} else {
+					active--;
+				}
+			}
+		}
+
+		for (size_t i = 0; i < batch; i++) {
+			dns_qpnode_t *n = nodes[i];
+			dns_qpkey_t found_key;
+			size_t found_keylen;
+
+			if (n == NULL) {
+				continue;
+			}
+
+			found_keylen = leaf_qpkey(qp, n, found_key);
+			if (qpkey_compare(keys[i], keylens[i], found_key,
+					  found_keylen) != QPKEY_EQUAL)
+			{
+				continue;
+			}
+
+			results[base + i] = ISC_R_SUCCESS;
+			if (pvals != NULL) {
+				pvals[base + i] = leaf_pval(n);
+			}
+			if (ivals != NULL) {
+				ivals[base + i] = leaf_ival(n);
+			}
+		}
+	}
+}
+
 static inline void
 add_link(dns_qpchain_t *chain, dns_qpnode_t *node, size_t offset) {
 	/* prevent duplication */
@@ -2335,4 +3022,420 @@ dns_qp_lookup(dns_qpreadable_t qpr, const dns_name_t *name,
 	return ISC_R_NOTFOUND;
 }
 
+/***********************************************************************
+ *
+ *  read-only images
+ */
+
+/*
+ * An image file contains:
+ *
+ *	the header (below), padded to 64 bytes
+ *	the leaf payloads, each aligned to 8 bytes
+ *	the chunks, page aligned, QP_CHUNK_BYTES each
+ *
+ * The chunks have the same layout as in memory, so once the `base`
+ * array points at them, the trie can be searched without any changes.
+ * All numbers are in host byte order, as the image is only meant for
+ * the build that wrote it; a foreign image fails the magic number check.
+ */
+#define QPIMAGE_MAGIC	ISC_MAGIC('Q', 'P', 'i', 'm')
+#define QPIMAGE_VERSION 1
+
+#define QPIMAGE_HEADER_SIZE 64
+#define QPIMAGE_ALIGN	    8
+#define QPIMAGE_PAGE	    4096
+
+typedef struct qpimage_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t node_size;
+	uint32_t chunk_log;
+	uint32_t root_ref;
+	uint32_t chunk_count;
+	uint32_t leaf_count;
+	uint32_t reserved;
+	uint64_t payload_size;
+	uint64_t chunk_offset;
+} qpimage_header_t;
+
+STATIC_ASSERT(sizeof(qpimage_header_t) <= QPIMAGE_HEADER_SIZE,
+	      "qp-trie image header is too big");
+
+#define QPIMAGE_VALID(p) ISC_MAGIC_VALID(p, QPIMAGE_MAGIC)
+
+struct dns_qpimage {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	void *map;
+	size_t mapsize;
+	dns_qpchunk_t chunk_count;
+	const uint8_t *payload;
+	dns_qpreader_t reader;
+};
+
+/*
+ * While an image is being saved, the new chunks are kept in memory
+ * and the payloads are written straight to the file.
+ */
+typedef struct qpimage_writer {
+	dns_qpreader_t *qp;
+	isc_mem_t *mctx;
+	FILE *fp;
+	dns_qpsaveleaf_t *saveleaf;
+	void *arg;
+	isc_buffer_t *payload;
+	uint64_t payload_size;
+	dns_qpnode_t **chunks;
+	dns_qpchunk_t chunk_count;
+	dns_qpchunk_t chunk_max;
+	dns_qpcell_t used;
+	uint32_t leaf_count;
+} qpimage_writer_t;
+
+static dns_qpnode_t *
+image_ptr(qpimage_writer_t *w, dns_qpref_t ref) {
+	return w->chunks[ref_chunk(ref)] + ref_cell(ref);
+}
+
+/*
+ * A bump allocator, like alloc_twigs(), without any garbage.
+ */
+static dns_qpref_t
+image_alloc(qpimage_writer_t *w, dns_qpweight_t size) {
+	if (w->chunk_count == 0 || w->used + size > QP_CHUNK_SIZE) {
+		if (w->chunk_count == w->chunk_max) {
+			dns_qpchunk_t newmax = GROWTH_FACTOR(w->chunk_max);
+			w->chunks = isc_mem_creget(w->mctx, w->chunks,
+						   w->chunk_max, newmax,
+						   sizeof(w->chunks[0]));
+			w->chunk_max = newmax;
+		}
+		w->chunks[w->chunk_count++] = isc_mem_cget(
+			w->mctx, QP_CHUNK_SIZE, sizeof(dns_qpnode_t));
+		w->used = 0;
+	}
+
+	dns_qpref_t ref = make_ref(w->chunk_count - 1, w->used);
+	w->used += size;
+	return ref;
+}
+
+static isc_result_t
+image_leaf(qpimage_writer_t *w, dns_qpnode_t *n, dns_qpref_t ref) {
+	isc_result_t result;
+	uint64_t offset = w->payload_size;
+	uint32_t ival = leaf_ival(n);
+	unsigned int length;
+
+	if (offset > (UINTPTR_MAX & ~TAG_MASK)) {
+		return ISC_R_RANGE;
+	}
+
+	isc_buffer_clear(w->payload);
+	result = w->saveleaf(w->arg, leaf_pval(n), &ival, w->payload);
+	if (result != ISC_R_SUCCESS) {
+		return result;
+	}
+	while (isc_buffer_usedlength(w->payload) % QPIMAGE_ALIGN != 0) {
+		isc_buffer_putuint8(w->payload, 0);
+	}
+
+	length = isc_buffer_usedlength(w->payload);
+	result = isc_stdio_write(isc_buffer_base(w->payload), 1, length,
+				 w->fp, NULL);
+	if (result != ISC_R_SUCCESS) {
+		return result;
+	}
+	w->payload_size += length;
+	w->leaf_count++;
+
+	*image_ptr(w, ref) = make_leaf((void *)(uintptr_t)offset, ival);
+	return ISC_R_SUCCESS;
+}
+
+/*
+ * Copy the node 'n' into the cell 'ref' of the image, and its
+ * descendents into new cells.
+ */
+static isc_result_t
+image_node(qpimage_writer_t *w, dns_qpnode_t *n, dns_qpref_t ref) {
+	isc_result_t result;
+
+	if (!is_branch(n)) {
+		return image_leaf(w, n, ref);
+	}
+
+	dns_qpweight_t size = branch_twigs_size(n);
+	dns_qpref_t twigs_ref = image_alloc(w, size);
+	*image_ptr(w, ref) = make_node(branch_index(n), twigs_ref);
+
+	dns_qpnode_t *twigs = branch_twigs(w->qp, n);
+	for (dns_qpweight_t pos = 0; pos < size; pos++) {
+		result = image_node(w, &twigs[pos], twigs_ref + pos);
+		if (result != ISC_R_SUCCESS) {
+			return result;
+		}
+	}
+	return ISC_R_SUCCESS;
+}
+
+static isc_result_t
+image_write(qpimage_writer_t *w) {
+	isc_result_t result;
+	dns_qpnode_t *root = get_root(w->qp);
+	dns_qpref_t root_ref = INVALID_REF;
+	uint8_t header[QPIMAGE_HEADER_SIZE] = { 0 };
+	uint8_t padding[QPIMAGE_PAGE] = { 0 };
+	uint64_t offset;
+
+	/* the header is rewritten when everything else is done */
+	result = isc_stdio_write(header, 1, sizeof(header), w->fp, NULL);
+	if (result != ISC_R_SUCCESS) {
+		return result;
+	}
+
+	if (root != NULL) {
+		root_ref = image_alloc(w, 1);
+		result = image_node(w, root, root_ref);
+		if (result != ISC_R_SUCCESS) {
+			return result;
+		}
+	}
+
+	offset = QPIMAGE_HEADER_SIZE + w->payload_size;
+	if (offset % QPIMAGE_PAGE != 0) {
+		size_t pad = QPIMAGE_PAGE - offset % QPIMAGE_PAGE;
+		result = isc_stdio_write(padding, 1, pad, w->fp, NULL);
+		if (result != ISC_R_SUCCESS) {
+			return result;
+		}
+		offset += pad;
+	}
+
+	for (dns_qpchunk_t chunk = 0; chunk < w->chunk_count; chunk++) {
+		result = isc_stdio_write(w->chunks[chunk], 1, QP_CHUNK_BYTES,
+					 w->fp, NULL);
+		if (result != ISC_R_SUCCESS) {
+			return result;
+		}
+	}
+
+	qpimage_header_t hdr = {
+		.magic = QPIMAGE_MAGIC,
+		.version = QPIMAGE_VERSION,
+		.node_size = sizeof(dns_qpnode_t),
+		.chunk_log = QP_CHUNK_LOG,
+		.root_ref = root_ref,
+		.chunk_count = w->chunk_count,
+		.leaf_count = w->leaf_count,
+		.payload_size = w->payload_size,
+		.chunk_offset = offset,
+	};
+	memmove(header, &hdr, sizeof(hdr));
+
+	result = isc_stdio_seek(w->fp, 0, SEEK_SET);
+	if (result != ISC_R_SUCCESS) {
+		return result;
+	}
+	return isc_stdio_write(header, 1, sizeof(header), w->fp, NULL);
+}
+
+isc_result_t
+dns_qp_saveimage(dns_qpreadable_t qpr, isc_mem_t *mctx, const char *filename,
+		 dns_qpsaveleaf_t *saveleaf, void *arg) {
+	dns_qpreader_t *qp = dns_qpreader(qpr);
+	isc_result_t result;
+	char tempname[PATH_MAX];
+	FILE *fp = NULL;
+
+	REQUIRE(QP_VALID(qp));
+	REQUIRE(mctx != NULL);
+	REQUIRE(filename != NULL);
+	REQUIRE(saveleaf != NULL);
+
+	result = isc_file_mktemplate(filename, tempname, sizeof(tempname));
+	if (result != ISC_R_SUCCESS) {
+		return result;
+	}
+	result = isc_file_openunique(tempname, &fp);
+	if (result != ISC_R_SUCCESS) {
+		return result;
+	}
+
+	qpimage_writer_t w = {
+		.qp = qp,
+		.mctx = mctx,
+		.fp = fp,
+		.saveleaf = saveleaf,
+		.arg = arg,
+	};
+	isc_buffer_allocate(mctx, &w.payload, 256);
+
+	result = image_write(&w);
+
+	for (dns_qpchunk_t chunk = 0; chunk < w.chunk_count; chunk++) {
+		isc_mem_cput(mctx, w.chunks[chunk], QP_CHUNK_SIZE,
+			     sizeof(dns_qpnode_t));
+	}
+	if (w.chunks != NULL) {
+		isc_mem_cput(mctx, w.chunks, w.chunk_max, sizeof(w.chunks[0]));
+	}
+	isc_buffer_free(&w.payload);
+
+	if (result == ISC_R_SUCCESS) {
+		result = isc_stdio_flush(fp);
+	}
+	if (result == ISC_R_SUCCESS) {
+		result = isc_stdio_sync(fp);
+	}
+	if (result == ISC_R_SUCCESS) {
+		result = isc_stdio_close(fp);
+	} else {
+		(void)isc_stdio_close(fp);
+	}
+	if (result == ISC_R_SUCCESS) {
+		result = isc_file_rename(tempname, filename);
+	}
+	if (result != ISC_R_SUCCESS) {
+		(void)isc_file_remove(tempname);
+	}
+	return result;
+}
+
+isc_result_t
+dns_qpimage_open(isc_mem_t *mctx, const char *filename,
+		 const dns_qpmethods_t *methods, void *uctx,
+		 dns_qpimage_t **imagep) {
+	isc_result_t result;
+	qpimage_header_t hdr;
+	dns_qpimage_t *image = NULL;
+	dns_qpbase_t *base = NULL;
+	struct stat sb;
+	void *map = NULL;
+	size_t mapsize;
+	int fd;
+
+	REQUIRE(filename != NULL);
+	REQUIRE(methods != NULL);
+	REQUIRE(imagep != NULL && *imagep == NULL);
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		return isc_errno_toresult(errno);
+	}
+	if (fstat(fd, &sb) < 0) {
+		result = isc_errno_toresult(errno);
+		close(fd);
+		return result;
+	}
+	if (sb.st_size < QPIMAGE_HEADER_SIZE || (uint64_t)sb.st_size > SIZE_MAX)
+	{
+		close(fd);
+		return DNS_R_FORMERR;
+	}
+
+	mapsize = (size_t)sb.st_size;
+	map = mmap(NULL, mapsize, PROT_READ, MAP_SHARED, fd, 0);
+	result = (map == MAP_FAILED) ? isc_errno_toresult(errno)
+				     : ISC_R_SUCCESS;
+	close(fd);
+	if (result != ISC_R_SUCCESS) {
+		return result;
+	}
+
+	memmove(&hdr, map, sizeof(hdr));
+	if (hdr.magic != QPIMAGE_MAGIC) {
+		result = DNS_R_FORMERR;
+		goto cleanup;
+	}
+	if (hdr.version != QPIMAGE_VERSION ||
+	    hdr.node_size != sizeof(dns_qpnode_t) ||
+	    hdr.chunk_log != QP_CHUNK_LOG)
+	{
+		result = ISC_R_NOTIMPLEMENTED;
+		goto cleanup;
+	}
+	if (hdr.payload_size > mapsize - QPIMAGE_HEADER_SIZE ||
+	    hdr.chunk_offset % QPIMAGE_PAGE != 0 ||
+	    hdr.chunk_offset < QPIMAGE_HEADER_SIZE + hdr.payload_size ||
+	    hdr.chunk_offset > mapsize ||
+	    (mapsize - hdr.chunk_offset) / QP_CHUNK_BYTES < hdr.chunk_count ||
+	    (hdr.root_ref == INVALID_REF
+		     ? hdr.chunk_count != 0
+		     : ref_chunk(hdr.root_ref) >= hdr.chunk_count))
+	{
+		result = DNS_R_FORMERR;
+		goto cleanup;
+	}
+
+	/*
+	 * Index and search operations will read the chunks in a random
+	 * order.
+	 */
+	(void)madvise(map, mapsize, MADV_RANDOM);
+
+	base = isc_mem_get(mctx, STRUCT_FLEX_SIZE(base, ptr, hdr.chunk_count));
+	*base = (dns_qpbase_t){
+		.magic = QPBASE_MAGIC,
+	};
+	isc_refcount_init(&base->refcount, 1);
+	for (dns_qpchunk_t chunk = 0; chunk < hdr.chunk_count; chunk++) {
+		base->ptr[chunk] = (dns_qpnode_t *)((uint8_t *)map +
+						    hdr.chunk_offset) +
+				   (size_t)chunk * QP_CHUNK_SIZE;
+	}
+
+	image = isc_mem_get(mctx, sizeof(*image));
+	*image = (dns_qpimage_t){
+		.magic = QPIMAGE_MAGIC,
+		.map = map,
+		.mapsize = mapsize,
+		.chunk_count = hdr.chunk_count,
+		.payload = (uint8_t *)map + QPIMAGE_HEADER_SIZE,
+		.reader = {
+			.magic = QP_MAGIC,
+			.root_ref = hdr.root_ref,
+			.base = base,
+			.uctx = uctx,
+			.methods = methods,
+		},
+	};
+	isc_mem_attach(mctx, &image->mctx);
+
+	*imagep = image;
+	return ISC_R_SUCCESS;
+
+cleanup:
+	munmap(map, mapsize);
+	return result;
+}
+
+void
+dns_qpimage_destroy(dns_qpimage_t **imagep) {
+	REQUIRE(imagep != NULL && QPIMAGE_VALID(*imagep));
+
+	dns_qpimage_t *image = *imagep;
+	dns_qpbase_t *base = image->reader.base;
+	*imagep = NULL;
+
+	image->magic = 0;
+	munmap(image->map, image->mapsize);
+	isc_mem_put(image->mctx, base,
+		    STRUCT_FLEX_SIZE(base, ptr, image->chunk_count));
+	isc_mem_putanddetach(&image->mctx, image, sizeof(*image));
+}
+
+dns_qpreader_t *
+dns_qpimage_reader(dns_qpimage_t *image) {
+	REQUIRE(QPIMAGE_VALID(image));
+	return &image->reader;
+}
+
+const void *
+dns_qpimage_payload(dns_qpimage_t *image, void *pval) {
+	REQUIRE(QPIMAGE_VALID(image));
+	return image->payload + (uintptr_t)pval;
+}
+
 /**********************************************************************/
@@ -282,6 +282,12 @@ typedef struct qp_usage {
 	bool snapmark : 1;
 } qp_usage_t;
 
+/*
+ * The huge page regions that the chunks of a big trie can be carved
+ * out of are described in qp.c.
+ */
+typedef struct qp_regions qp_regions_t;
+
 /*
  * The chunks are owned by the current version of the `base` array.
  * When the array is resized, the old version might still be in use by
@@ -446,6 +452,15 @@ struct dns_qpsnap {
  *    normal compaction failed to clear the QP_MAX_GARBAGE() condition.
  *    (This emergency is a bug even tho we have a rescue mechanism.)
  *
+ *  - When a `compact_budget` is set, compaction during a light write
+ *    transaction gives up after visiting that many cells, and the
+ *    `compact_left` counter tracks how much of the budget remains in the
+ *    current transaction. An unfinished pass sets `compact_resume`, and
+ *    the next pass restarts from the twig positions in `compact_path`,
+ *    one per level of the trie. The trie can change between passes so
+ *    the path might have gone stale; that is harmless, because moving any
+ *    subset of the trie is a valid compaction.
+ *
  *  - When a qp-trie is destroyed while it has pending cleanup work, its
  *    `destroy` flag is set so that it is destroyed by the reclaim worker.
  *    (Because items cannot be removed from the middle of the cleanup list.)
@@ -455,6 +470,11 @@ struct dns_qpsnap {
  *    `write_protect` flag must be set straight after the `dns_qpmulti_t`
  *    is created, then left unchanged.
  *
+ *  - The `regions` are shared with the rollback copy of a `dns_qp_t`,
+ *    like the `base` array, and are only freed when the trie is
+ *    destroyed. The chunks that are in a region are found by address,
+ *    so the regions can be enabled after the trie has some chunks.
+ *
  * Some of the dns_qp_t fields are only needed for multithreaded transactions
  * (marked [MT] below) but the same code paths are also used for single-
  * threaded writes.
@@ -479,10 +499,22 @@ struct dns_qp {
 	dns_qpcell_t hold_count;
 	/*% what kind of transaction was most recently started [MT] */
 	enum { QP_NONE, QP_WRITE, QP_UPDATE } transaction_mode : 2;
+	/*% cells compaction may visit per light write, 0 = unlimited [MT] */
+	dns_qpcell_t compact_budget;
+	/*% what remains of the budget in this transaction [MT] */
+	dns_qpcell_t compact_left;
 	/*% compact the entire trie [MT] */
 	bool compact_all : 1;
+	/*% the current compaction pass is limited by the budget [MT] */
+	bool compact_limited : 1;
+	/*% the last compaction pass ran out of budget [MT] */
+	bool compact_resume : 1;
 	/*% optionally when compiled with fuzzing support [MT] */
 	bool write_protect : 1;
+	/*% huge page regions for the chunks, if enabled (see qp.c) */
+	qp_regions_t *regions;
+	/*% where to restart an unfinished compaction pass [MT] */
+	uint8_t compact_path[DNS_QP_MAXKEY];
 };
 
 /*
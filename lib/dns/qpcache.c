@@ -46,6 +46,7 @@
 #include <dns/dbiterator.h>
 #include <dns/fixedname.h>
 #include <dns/masterdump.h>
+#include <dns/ncache.h>
 #include <dns/nsec.h>
 #include <dns/qp.h>
 #include <dns/rdata.h>
@@ -59,6 +60,7 @@
 #include <dns/zonekey.h>
 
 #include "db_p.h"
+#include "probes.h"
 #include "qpcache_p.h"
 
 #define CHECK(op)                            \
@@ -98,6 +100,9 @@
 #define ZEROTTL(header)                                \
 	((atomic_load_acquire(&(header)->attributes) & \
 	  DNS_SLABHEADERATTR_ZEROTTL) != 0)
+#define VISITED(header)                                \
+	((atomic_load_acquire(&(header)->attributes) & \
+	  DNS_SLABHEADERATTR_VISITED) != 0)
 #define ANCIENT(header)                                \
 	((atomic_load_acquire(&(header)->attributes) & \
 	  DNS_SLABHEADERATTR_ANCIENT) != 0)
@@ -118,6 +123,14 @@
 
 #define KEEPSTALE(qpdb) ((qpdb)->common.serve_stale_ttl > 0)
 
+/*%
+ * Number of times an active positive RRset has to be bound before it is
+ * flagged as popular (DNS_RDATASETATTR_POPULAR) so the caller can ask the
+ * resolver to refresh it before it expires.  Each header is flagged at
+ * most once; refreshed data has to earn its popularity again.
+ */
+#define POPULAR_HITS 16
+
 /*%
  * Note that "impmagic" is not the first four bytes of the struct, so
  * ISC_MAGIC_VALID cannot be used.
@@ -156,6 +169,45 @@
  */
 #define DNS_QPDB_EXPIRE_TTL_COUNT 10
 
+/*
+ * The number of dead nodes and of expired headers that the sweeper of a
+ * bucket cleans up in one run, before it lets the other events of its
+ * loop run.
+ */
+#define DNS_QPDB_SWEEP_COUNT 256
+
+/*%
+ * Initial and minimal sizes of the lock-free name index; must be powers
+ * of 2.
+ */
+#define QPDB_NAMES_INIT_SIZE (1 << 16)
+#define QPDB_NAMES_MIN_SIZE  (1 << 10)
+
+/*%
+ * Initial size of the table of shared negative cache slabs, in bits.
+ */
+#define QPDB_SLABS_HASH_BITS 8
+
+/*%
+ * The maximum number of entries the SIEVE hand passes in one bucket
+ * per overmem() call.
+ */
+#define QPDB_SIEVE_MAXSCAN 1024
+
+/*%
+ * The interval proven empty by the NSEC record cached at a node of the
+ * auxiliary NSEC tree: everything between the node name and 'next'.
+ * It lets find_coveringnsec() reject a predecessor that cannot cover
+ * the query name without looking at the main tree.
+ */
+typedef struct qpc_nsecrange {
+	isc_mem_t *mctx;
+	isc_stdtime_t expire;
+	dns_fixedname_t fnext;
+	dns_name_t *next;
+	struct rcu_head rcu_head;
+} qpc_nsecrange_t;
+
 /*%
  * This is the structure that is used for each node in the qp trie of trees.
  */
@@ -176,14 +228,24 @@ struct qpcnode {
 	void *data;
 
 	/*%
-	 * NOTE: The 'dirty' flag is protected by the node lock, so
-	 * this bitfield has to be separated from the one above.
+	 * Only used by the nodes of the auxiliary NSEC tree; replaced
+	 * and read without the node lock, freed after an RCU grace period.
+	 */
+	qpc_nsecrange_t *nsecrange;
+
+	/*%
+	 * NOTE: The 'dirty' and 'deleted' flags are protected by the node
+	 * lock, so this bitfield has to be separated from the one above.
 	 * We don't want it to share the same qword with bits
 	 * that can be accessed without the node lock.
+	 *
+	 * 'deleted' is set once the node has been removed from the tree;
+	 * a lock-free reader may still get hold of it afterwards.
 	 */
-	uint8_t	      : 0;
-	uint8_t dirty : 1;
-	uint8_t	      : 0;
+	uint8_t		: 0;
+	uint8_t dirty	: 1;
+	uint8_t deleted : 1;
+	uint8_t		: 0;
 
 	/*%
 	 * Used for dead nodes cleaning.  This linked list is used to mark nodes
@@ -192,8 +254,35 @@ struct qpcnode {
 	 * tree.
 	 */
 	isc_queue_node_t deadlink;
+
+	/*%
+	 * Used for the lock-free name index (see qpcache->names) and to
+	 * defer freeing the node until the lock-free readers are done.
+	 */
+	struct cds_lfht_node ht_node;
+	struct rcu_head rcu_head;
 };
 
+/*%
+ * The rdata of a negative cache entry, shared by all the identical
+ * entries in the cache; see shareslab().
+ */
+typedef struct qpc_slab {
+	uint32_t hashval;
+	unsigned int references; /* Locked by slablock */
+	unsigned int size;
+	isc_mem_t *mctx;
+	struct rcu_head rcu_head;
+	unsigned char raw[];
+} qpc_slab_t;
+
+typedef struct qpc_sweep {
+	/* Dead nodes taken off 'deadnodes'; only used by the loop */
+	isc_queue_t backlog;
+	/* A run of the sweeper is pending */
+	atomic_bool scheduled;
+} qpc_sweep_t;
+
 typedef struct qpcache qpcache_t;
 struct qpcache {
 	/* Unlocked. */
@@ -236,6 +325,16 @@ struct qpcache {
 	 */
 	atomic_uint lru_sweep;
 
+	/*
+	 * With the SIEVE eviction policy, the lists above are kept in the
+	 * insertion order and the hits only mark the headers as visited;
+	 * sieve_hand[i] is the next header on lru[i] to be considered for
+	 * eviction, or NULL to start again from the tail.  Locked by the
+	 * node lock of the bucket.
+	 */
+	bool sieve;
+	dns_slabheader_t **sieve_hand;
+
 	/*
 	 * When performing LRU cleaning limit cleaning to headers that were
 	 * last used at or before this.
@@ -248,6 +347,13 @@ struct qpcache {
 	 */
 	isc_queue_t *deadnodes;
 
+	/*%
+	 * The state of the sweeper of each bucket, which cleans up the
+	 * dead nodes and expires the headers on the TTL heap of the
+	 * bucket on its loop, so the lookups don't have to.
+	 */
+	qpc_sweep_t *sweep;
+
 	/*
 	 * Heaps.  These are used for TTL based expiry in a cache,
 	 * or for zone resigning in a zone DB.  hmctx is the memory
@@ -260,6 +366,23 @@ struct qpcache {
 	/* Locked by tree_lock. */
 	dns_qp_t *tree;
 	dns_qp_t *nsec;
+
+	/*%
+	 * In the lock-free reads mode, the nodes of the main tree are also
+	 * indexed by name in a RCU hash table, so find() can look up exact
+	 * matches without taking the tree or the node locks.  The index is
+	 * modified only with the tree write lock held.  'dname' is set once
+	 * any DNAME has been cached, after which the lock-free lookups also
+	 * have to check the ancestors of the name.
+	 */
+	bool lockfree;
+	struct cds_lfht *names;
+	atomic_bool dname;
+
+	/* Shared negative cache slabs, and the memory they saved */
+	isc_mutex_t slablock;
+	isc_hashmap_t *slabs;
+	uint64_t sharedbytes;
 };
 
 /*%
@@ -401,6 +524,12 @@ typedef struct qpc_dbit {
 static void
 free_qpdb(qpcache_t *qpdb, bool log);
 
+static bool
+expire_ttl_headers(qpcache_t *qpdb, unsigned int locknum,
+		   isc_rwlocktype_t *nlocktypep, isc_rwlocktype_t *tlocktypep,
+		   isc_stdtime_t now, bool cache_is_overmem,
+		   size_t count DNS__DB_FLARG);
+
 static dns_dbmethods_t qpdb_cachemethods;
 
 /*%
@@ -455,6 +584,19 @@ need_headerupdate(dns_slabheader_t *header, isc_stdtime_t now) {
 		return false;
 	}
 
+	if (((qpcache_t *)header->db)->sieve) {
+		/*
+		 * With the SIEVE eviction policy, a hit only needs to mark
+		 * the header as visited, which can be done right here with
+		 * any lock, so no update under the write lock is needed.
+		 */
+		if (!VISITED(header)) {
+			DNS_SLABHEADER_SETATTR(header,
+					       DNS_SLABHEADERATTR_VISITED);
+		}
+		return false;
+	}
+
 #if DNS_QPDB_LIMITLRUUPDATE
 	if (header->type == dns_rdatatype_ns ||
 	    (header->trust == dns_trust_glue &&
@@ -482,7 +624,8 @@ need_headerupdate(dns_slabheader_t *header, isc_stdtime_t now) {
 
 /*%
  * Update the timestamp of a given cache entry and move it to the head
- * of the corresponding LRU list.
+ * of the corresponding LRU list, or just mark it as visited with the
+ * SIEVE eviction policy.
  *
  * Caller must hold the node (write) lock.
  *
@@ -493,11 +636,33 @@ update_header(qpcache_t *qpdb, dns_slabheader_t *header, isc_stdtime_t now) {
 	/* To be checked: can we really assume this? XXXMLG */
 	INSIST(ISC_LINK_LINKED(header, link));
 
+	if (qpdb->sieve) {
+		DNS_SLABHEADER_SETATTR(header, DNS_SLABHEADERATTR_VISITED);
+		header->last_used = now;
+		return;
+	}
+
 	ISC_LIST_UNLINK(qpdb->lru[HEADERNODE(header)->locknum], header, link);
 	header->last_used = now;
 	ISC_LIST_PREPEND(qpdb->lru[HEADERNODE(header)->locknum], header, link);
 }
 
+/*%
+ * Unlink a given cache entry from its LRU list, moving the SIEVE hand
+ * off the entry first.
+ *
+ * Caller must hold the node (write) lock.
+ */
+static void
+unlink_header(qpcache_t *qpdb, dns_slabheader_t *header) {
+	unsigned int locknum = HEADERNODE(header)->locknum;
+
+	if (qpdb->sieve && qpdb->sieve_hand[locknum] == header) {
+		qpdb->sieve_hand[locknum] = ISC_LIST_PREV(header, link);
+	}
+	ISC_LIST_UNLINK(qpdb->lru[locknum], header, link);
+}
+
 /*
  * Locking:
  * If a routine is going to lock more than one lock in this module, then
@@ -521,12 +686,53 @@ update_header(qpcache_t *qpdb, dns_slabheader_t *header, isc_stdtime_t now) {
  */
 
 static void
-clean_stale_headers(dns_slabheader_t *top) {
+free_header_rcu(struct rcu_head *rcu_head) {
+	dns_slabheader_t *header = caa_container_of(rcu_head, dns_slabheader_t,
+						    rcu_head);
+	qpcnode_t *node = HEADERNODE(header);
+	unsigned int size = sizeof(*header);
+
+	if (!NONEXISTENT(header) && header->raw == NULL) {
+		size = dns_rdataslab_size((unsigned char *)header,
+					  sizeof(*header));
+	}
+
+	isc_mem_put(node->mctx, header, size);
+	qpcnode_unref(node);
+}
+
+/*
+ * Free a header that has been linked to a node.  In the lock-free reads
+ * mode, a reader may still be looking at the header, so only the data
+ * hanging off it is released now and the header itself is freed after
+ * the RCU grace period; the node reference keeps the memory context
+ * around until then.
+ *
+ * Caller must hold the node (write) lock.
+ */
+static void
+free_header(qpcache_t *qpdb, dns_slabheader_t **headerp) {
+	dns_slabheader_t *header = *headerp;
+
+	if (!qpdb->lockfree) {
+		dns_slabheader_destroy(headerp);
+		return;
+	}
+
+	*headerp = NULL;
+
+	dns_db_deletedata(header->db, header->node, header);
+	qpcnode_ref(HEADERNODE(header));
+	call_rcu(&header->rcu_head, free_header_rcu);
+}
+
+static void
+clean_stale_headers(qpcache_t *qpdb, dns_slabheader_t *top) {
 	dns_slabheader_t *d = NULL, *down_next = NULL;
 
 	for (d = top->down; d != NULL; d = down_next) {
 		down_next = d->down;
-		dns_slabheader_destroy(&d);
+		free_header(qpdb, &d);
 	}
 	top->down = NULL;
 }
@@ -541,7 +747,7 @@ clean_cache_node(qpcache_t *qpdb, qpcnode_t *node) {
 
 	for (current = node->data; current != NULL; current = top_next) {
 		top_next = current->next;
-		clean_stale_headers(current);
+		clean_stale_headers(qpdb, current);
 		/*
 		 * If current is nonexistent, ancient, or stale and
 		 * we are not keeping stale, we can clean it up.
@@ -554,7 +760,7 @@ clean_cache_node(qpcache_t *qpdb, qpcnode_t *node) {
 			} else {
 				node->data = current->next;
 			}
-			dns_slabheader_destroy(&current);
+			free_header(qpdb, &current);
 		} else {
 			top_prev = current;
 		}
@@ -569,6 +775,9 @@ static void
 delete_node(qpcache_t *qpdb, qpcnode_t *node) {
 	isc_result_t result = ISC_R_UNEXPECTED;
 
+	INSIST(!node->deleted);
+	node->deleted = 1;
+
 	if (isc_log_wouldlog(ISC_LOG_DEBUG(1))) {
 		char printname[DNS_NAME_FORMATSIZE];
 		dns_name_format(&node->name, printname, sizeof(printname));
@@ -594,6 +803,11 @@ delete_node(qpcache_t *qpdb, qpcnode_t *node) {
 		}
 		/* FALLTHROUGH */
 	case DNS_DB_NSEC_NORMAL:
+		if (qpdb->lockfree) {
+			rcu_read_lock();
+			INSIST(!cds_lfht_del(qpdb->names, &node->ht_node));
+			rcu_read_unlock();
+		}
 		result = dns_qp_deletename(qpdb->tree, &node->name, NULL, NULL);
 		break;
 	case DNS_DB_NSEC_NSEC:
@@ -655,7 +869,44 @@ newref(qpcache_t *qpdb, qpcnode_t *node, isc_rwlocktype_t nlocktype,
 }
 
 static void
-cleanup_deadnodes(void *arg);
+sweep_bucket(void *arg);
+
+/*
+ * Run the sweeper of bucket 'locknum' on its loop, unless a run is already
+ * pending.  The run holds a reference to the bucket, so the database can't
+ * go away under it.
+ *
+ * The caller must hold the node lock of the bucket, and a reference either
+ * to a node in the bucket or to the database.  In the latter case, as in
+ * a lookup that finds an expired header, the bucket may have no referenced
+ * nodes, but it can't be exiting.
+ */
+static void
+sweep_schedule(qpcache_t *qpdb, unsigned int locknum) {
+	db_nodelock_t *nodelock = &qpdb->node_locks[locknum];
+
+	if (atomic_exchange_acq_rel(&qpdb->sweep[locknum].scheduled, true)) {
+		return;
+	}
+
+	if (isc_refcount_increment0(&nodelock->references) == 0) {
+		INSIST(!nodelock->exiting);
+	}
+	isc_async_run(isc_loop_get(qpdb->loopmgr, locknum), sweep_bucket,
+		      qpdb);
+}
+
+/*
+ * Hand a reference to 'node' over to the sweeper of its bucket, which
+ * releases it with the tree and node locks held for writing.
+ */
+static void
+enqueue_deadnode(qpcache_t *qpdb, qpcnode_t *node) {
+	isc_queue_node_init(&node->deadlink);
+	isc_queue_enqueue_entry(&qpdb->deadnodes[node->locknum], node,
+				deadlink);
+	sweep_schedule(qpdb, node->locknum);
+}
 
 /*
  * Caller must be holding the node lock; either the read or write lock.
@@ -718,6 +969,18 @@ decref(qpcache_t *qpdb, qpcnode_t *node, isc_rwlocktype_t *nlocktypep,
 		return no_reference;
 	}
 
+	/*
+	 * The readers don't clean up: if this looks like the last
+	 * reference, it is handed over to the sweeper of the bucket
+	 * instead of upgrading the node lock here.
+	 */
+	if (*nlocktypep == isc_rwlocktype_read && !nodelock->exiting &&
+	    isc_refcount_current(&node->erefs) == 1)
+	{
+		enqueue_deadnode(qpdb, node);
+		return false;
+	}
+
 	/* Upgrade the lock? */
 	if (*nlocktypep == isc_rwlocktype_read) {
 		NODE_FORCEUPGRADE(&nodelock->lock, nlocktypep);
@@ -782,7 +1045,7 @@ decref(qpcache_t *qpdb, qpcnode_t *node, isc_rwlocktype_t *nlocktypep,
 	UNUSED(refs);
 #endif
 
-	if (KEEP_NODE(node, qpdb)) {
+	if (KEEP_NODE(node, qpdb) || node->deleted) {
 		goto restore_locks;
 	}
 
@@ -795,16 +1058,7 @@ decref(qpcache_t *qpdb, qpcnode_t *node, isc_rwlocktype_t *nlocktypep,
 		delete_node(qpdb, node);
 	} else {
 		newref(qpdb, node, *nlocktypep, *tlocktypep DNS__DB_FLARG_PASS);
-
-		isc_queue_node_init(&node->deadlink);
-		if (!isc_queue_enqueue_entry(&qpdb->deadnodes[bucket], node,
-					     deadlink))
-		{
-			/* Queue was empty, trigger new cleaning */
-			isc_loop_t *loop = isc_loop_get(qpdb->loopmgr, bucket);
-
-			isc_async_run(loop, cleanup_deadnodes, qpdb);
-		}
+		enqueue_deadnode(qpdb, node);
 	}
 
 restore_locks:
@@ -927,6 +1181,12 @@ expireheader(dns_slabheader_t *header, isc_rwlocktype_t *nlocktypep,
 	mark(header, DNS_SLABHEADERATTR_ANCIENT);
 	HEADERNODE(header)->dirty = 1;
 
+	/*
+	 * Pairs with the fence in find_lockfree(): either the lock-free
+	 * reader sees the header as ancient, or we see its reference.
+	 */
+	atomic_thread_fence(memory_order_seq_cst);
+
 	if (isc_refcount_current(&HEADERNODE(header)->erefs) == 0) {
 		qpcache_t *qpdb = (qpcache_t *)header->db;
 
@@ -953,6 +1213,10 @@ expireheader(dns_slabheader_t *header, isc_rwlocktype_t *nlocktypep,
 			isc_stats_increment(qpdb->cachestats,
 					    dns_cachestatscounter_deletelru);
 			break;
+		case dns_expire_sieve:
+			isc_stats_increment(qpdb->cachestats,
+					    dns_cachestatscounter_deletesieve);
+			break;
 		default:
 			break;
 		}
@@ -960,15 +1224,16 @@ expireheader(dns_slabheader_t *header, isc_rwlocktype_t *nlocktypep,
 }
 
 static void
-update_cachestats(qpcache_t *qpdb, isc_result_t result) {
-	if (qpdb->cachestats == NULL) {
-		return;
-	}
+update_cachestats(qpcache_t *qpdb, const dns_name_t *name,
+		  dns_rdatatype_t type, isc_result_t result) {
+	bool hit;
 
 	switch (result) {
 	case DNS_R_COVERINGNSEC:
-		isc_stats_increment(qpdb->cachestats,
-				    dns_cachestatscounter_coveringnsec);
+		if (qpdb->cachestats != NULL) {
+			isc_stats_increment(qpdb->cachestats,
+					    dns_cachestatscounter_coveringnsec);
+		}
 		FALLTHROUGH;
 	case ISC_R_SUCCESS:
 	case DNS_R_CNAME:
@@ -976,13 +1241,27 @@ update_cachestats(qpcache_t *qpdb, isc_result_t result) {
 	case DNS_R_DELEGATION:
 	case DNS_R_NCACHENXDOMAIN:
 	case DNS_R_NCACHENXRRSET:
-		isc_stats_increment(qpdb->cachestats,
-				    dns_cachestatscounter_hits);
+		hit = true;
 		break;
 	default:
-		isc_stats_increment(qpdb->cachestats,
-				    dns_cachestatscounter_misses);
+		hit = false;
+	}
+
+	if (hit) {
+		LIBDNS_CACHE_HIT(qpdb, name->ndata, name->length, type,
+				 result);
+	} else {
+		LIBDNS_CACHE_MISS(qpdb, name->ndata, name->length, type,
+				  result);
+	}
+
+	if (qpdb->cachestats == NULL) {
+		return;
 	}
+
+	isc_stats_increment(qpdb->cachestats,
+			    hit ? dns_cachestatscounter_hits
+				: dns_cachestatscounter_misses);
 }
 
 static void
@@ -1071,8 +1350,16 @@ bindrdataset(qpcache_t *qpdb, qpcnode_t *node, dns_slabheader_t *header,
 
 	rdataset->count = atomic_fetch_add_relaxed(&header->count, 1);
 
+	if (!stale && !ancient && !NEGATIVE(header) &&
+	    atomic_load_relaxed(&header->hits) < POPULAR_HITS &&
+	    atomic_fetch_add_relaxed(&header->hits, 1) == POPULAR_HITS - 1)
+	{
+		rdataset->attributes |= DNS_RDATASETATTR_POPULAR;
+	}
+
 	rdataset->slab.db = (dns_db_t *)qpdb;
 	rdataset->slab.node = (dns_dbnode_t *)node;
+	rdataset->slab.header = header;
 	rdataset->slab.raw = dns_slabheader_raw(header);
 	rdataset->slab.iter_pos = NULL;
 	rdataset->slab.iter_count = 0;
@@ -1142,7 +1429,6 @@ setup_delegation(qpc_search_t *search, dns_dbnode_t **nodep,
 
 static bool
 check_stale_header(qpcnode_t *node, dns_slabheader_t *header,
-		   isc_rwlocktype_t *nlocktypep, isc_rwlock_t *lock,
 		   qpc_search_t *search, dns_slabheader_t **header_prev) {
 	if (!ACTIVE(header, search->now)) {
 		dns_ttl_t stale = header->ttl + STALE_TTL(header, search->qpdb);
@@ -1199,48 +1485,13 @@ check_stale_header(qpcnode_t *node, dns_slabheader_t *header,
 		}
 
 		/*
-		 * This rdataset is stale.  If no one else is using the
-		 * node, we can clean it up right now, otherwise we mark
-		 * it as ancient, and the node as dirty, so it will get
-		 * cleaned up later.
+		 * This rdataset is stale.  Leave it to the sweeper of the
+		 * bucket, which expires it from the TTL heap.
 		 */
-		if ((header->ttl < search->now - QPDB_VIRTUAL) &&
-		    (*nlocktypep == isc_rwlocktype_write ||
-		     NODE_TRYUPGRADE(lock, nlocktypep) == ISC_R_SUCCESS))
-		{
-			/*
-			 * We update the node's status only when we can
-			 * get write access; otherwise, we leave others
-			 * to this work.  Periodical cleaning will
-			 * eventually take the job as the last resort.
-			 * We won't downgrade the lock, since other
-			 * rdatasets are probably stale, too.
-			 */
-
-			if (isc_refcount_current(&node->references) == 0) {
-				/*
-				 * header->down can be non-NULL if the
-				 * refcount has just decremented to 0
-				 * but decref() has not
-				 * performed clean_cache_node(), in
-				 * which case we need to purge the stale
-				 * headers first.
-				 */
-				clean_stale_headers(header);
-				if (*header_prev != NULL) {
-					(*header_prev)->next = header->next;
-				} else {
-					node->data = header->next;
-				}
-				dns_slabheader_destroy(&header);
-			} else {
-				mark(header, DNS_SLABHEADERATTR_ANCIENT);
-				HEADERNODE(header)->dirty = 1;
-				*header_prev = header;
-			}
-		} else {
-			*header_prev = header;
+		if (header->ttl < search->now - QPDB_VIRTUAL) {
+			sweep_schedule(search->qpdb, node->locknum);
 		}
+		*header_prev = header;
 		return true;
 	}
 	return false;
@@ -1266,7 +1517,7 @@ check_zonecut(qpcnode_t *node, void *arg DNS__DB_FLARG) {
 	 */
 	for (header = node->data; header != NULL; header = header_next) {
 		header_next = header->next;
-		if (check_stale_header(node, header, &nlocktype, lock, search,
+		if (check_stale_header(node, header, search,
 				       &header_prev))
 		{
 			/* Do nothing. */
@@ -1341,7 +1592,7 @@ find_deepest_zonecut(qpc_search_t *search, qpcnode_t *node,
 		for (header = node->data; header != NULL; header = header_next)
 		{
 			header_next = header->next;
-			if (check_stale_header(node, header, &nlocktype, lock,
+			if (check_stale_header(node, header,
 					       search, &header_prev))
 			{
 				/* Do nothing. */
@@ -1423,6 +1674,80 @@ find_deepest_zonecut(qpc_search_t *search, qpcnode_t *node,
 	return result;
 }
 
+static void
+nsecrange_destroy(qpc_nsecrange_t *range) {
+	isc_mem_putanddetach(&range->mctx, range, sizeof(*range));
+}
+
+static void
+nsecrange_destroy_rcu(struct rcu_head *rcu_head) {
+	qpc_nsecrange_t *range = caa_container_of(rcu_head, qpc_nsecrange_t,
+						  rcu_head);
+
+	nsecrange_destroy(range);
+}
+
+/*
+ * Record the interval proven by the NSEC 'rdataset', which has just been
+ * cached, in the auxiliary NSEC tree node 'nsecnode'.  An NSEC RRset
+ * with more than one record is not indexed.
+ */
+static void
+nsecrange_update(qpcache_t *qpdb, qpcnode_t *nsecnode,
+		 dns_rdataset_t *rdataset, isc_stdtime_t now) {
+	qpc_nsecrange_t *range = NULL, *old = NULL;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdata_nsec_t nsec;
+
+	if (dns_rdataset_count(rdataset) == 1 &&
+	    dns_rdataset_first(rdataset) == ISC_R_SUCCESS)
+	{
+		dns_rdataset_current(rdataset, &rdata);
+		RUNTIME_CHECK(dns_rdata_tostruct(&rdata, &nsec, NULL) ==
+			      ISC_R_SUCCESS);
+
+		range = isc_mem_get(qpdb->common.mctx, sizeof(*range));
+		*range = (qpc_nsecrange_t){
+			.expire = now + rdataset->ttl,
+		};
+		isc_mem_attach(qpdb->common.mctx, &range->mctx);
+		range->next = dns_fixedname_initname(&range->fnext);
+		dns_name_copy(&nsec.next, range->next);
+		dns_rdata_freestruct(&nsec);
+	}
+
+	old = rcu_xchg_pointer(&nsecnode->nsecrange, range);
+	if (old != NULL) {
+		call_rcu(&old->rcu_head, nsecrange_destroy_rcu);
+	}
+}
+
+/*
+ * Return false if the NSEC record last cached at the auxiliary NSEC
+ * tree node 'node' is still current and ends at or before 'name', so it
+ * cannot be the covering NSEC.  When in doubt, e.g. for the last NSEC
+ * of a zone whose next name wraps around to the apex, return true and
+ * let the caller check the record in the main tree.
+ */
+static bool
+nsecrange_maycover(qpcnode_t *node, const dns_name_t *name,
+		   isc_stdtime_t now) {
+	qpc_nsecrange_t *range = NULL;
+	bool maycover = true;
+
+	rcu_read_lock();
+	range = rcu_dereference(node->nsecrange);
+	if (range != NULL && range->expire > now &&
+	    dns_name_compare(range->next, &node->name) > 0 &&
+	    dns_name_compare(name, range->next) >= 0)
+	{
+		maycover = false;
+	}
+	rcu_read_unlock();
+
+	return maycover;
+}
+
 /*
  * Look for a potentially covering NSEC in the cache where `name`
  * is known not to exist.  This uses the auxiliary NSEC tree to find
@@ -1464,11 +1789,21 @@ find_coveringnsec(qpc_search_t *search, const dns_name_t *name,
 	/*
 	 * Extract predecessor from iterator.
 	 */
-	result = dns_qpiter_current(&iter, predecessor, NULL, NULL);
+	node = NULL;
+	result = dns_qpiter_current(&iter, predecessor, (void **)&node, NULL);
 	if (result != ISC_R_SUCCESS) {
 		return ISC_R_NOTFOUND;
 	}
 
+	if (!nsecrange_maycover(node, name, now)) {
+		if (search->qpdb->cachestats != NULL) {
+			isc_stats_increment(
+				search->qpdb->cachestats,
+				dns_cachestatscounter_coveringnsecskip);
+		}
+		return ISC_R_NOTFOUND;
+	}
+
 	/*
 	 * Lookup the predecessor in the main tree.
 	 */
@@ -1484,7 +1819,7 @@ find_coveringnsec(qpc_search_t *search, const dns_name_t *name,
 	NODE_RDLOCK(lock, &nlocktype);
 	for (header = node->data; header != NULL; header = header_next) {
 		header_next = header->next;
-		if (check_stale_header(node, header, &nlocktype, lock, search,
+		if (check_stale_header(node, header, search,
 				       &header_prev))
 		{
 			continue;
@@ -1529,6 +1864,279 @@ find_coveringnsec(qpc_search_t *search, const dns_name_t *name,
 	return result;
 }
 
+/*
+ * Lock-free lookups.
+ */
+
+static void
+detachnode(dns_db_t *db, dns_dbnode_t **targetp DNS__DB_FLARG);
+
+static int
+names_match(struct cds_lfht_node *ht_node, const void *key) {
+	qpcnode_t *node = caa_container_of(ht_node, qpcnode_t, ht_node);
+
+	return dns_name_equal(&node->name, key);
+}
+
+/*
+ * Caller must be in a RCU read-side critical section.
+ */
+static qpcnode_t *
+names_lookup(qpcache_t *qpdb, const dns_name_t *name) {
+	struct cds_lfht_iter iter;
+
+	cds_lfht_lookup(qpdb->names, dns_name_hash(name), names_match, name,
+			&iter);
+
+	return cds_lfht_entry(cds_lfht_iter_get_node(&iter), qpcnode_t,
+			      ht_node);
+}
+
+/*
+ * Return true if any ancestor of 'name' has a DNAME, in any state.
+ *
+ * Caller must be in a RCU read-side critical section.
+ */
+static bool
+dname_above(qpcache_t *qpdb, const dns_name_t *name) {
+	unsigned int labels = dns_name_countlabels(name);
+
+	for (unsigned int i = 1; i < labels; i++) {
+		dns_name_t suffix = DNS_NAME_INITEMPTY;
+		dns_slabheader_t *header = NULL;
+		qpcnode_t *node = NULL;
+
+		dns_name_getlabelsequence(name, i, labels - i, &suffix);
+		node = names_lookup(qpdb, &suffix);
+		if (node == NULL) {
+			continue;
+		}
+
+		for (header = rcu_dereference(node->data); header != NULL;
+		     header = rcu_dereference(header->next))
+		{
+			if (header->type == dns_rdatatype_dname ||
+			    header->type == DNS_SIGTYPE(dns_rdatatype_dname))
+			{
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+/*
+ * Whether a header found by a lock-free reader can be handed out.
+ */
+static bool
+lockfree_usable(dns_slabheader_t *header, isc_stdtime_t now) {
+	return DNS_SLABHEADER_GETATTR(header,
+				      (DNS_SLABHEADERATTR_NONEXISTENT |
+				       DNS_SLABHEADERATTR_STALE |
+				       DNS_SLABHEADERATTR_IGNORE |
+				       DNS_SLABHEADERATTR_ANCIENT)) == 0 &&
+	       ACTIVE(header, now);
+}
+
+/*
+ * Take an external reference to a node found without holding any lock.
+ * This fails if the node is already being destroyed.
+ */
+static bool
+tryref(qpcache_t *qpdb, qpcnode_t *node) {
+	uint_fast32_t refs = isc_refcount_current(&node->references);
+
+	do {
+		if (refs == 0) {
+			return false;
+		}
+	} while (!atomic_compare_exchange_weak_acq_rel(&node->references,
+						       &refs, refs + 1));
+
+	if (isc_refcount_increment0(&node->erefs) == 0) {
+		isc_refcount_increment0(
+			&qpdb->node_locks[node->locknum].references);
+	}
+
+	/*
+	 * Pairs with the fence in expireheader(): either the writer sees
+	 * our reference and leaves the headers alone, or we see the
+	 * headers it has retired as ancient when checking them again.
+	 */
+	atomic_thread_fence(memory_order_seq_cst);
+
+	return true;
+}
+
+/*
+ * Look for an exact match of 'name' and 'type' without taking the tree or
+ * the node locks.  Only the common answers are given here: the node must
+ * have an active, usable positive or negative entry for the type, or a
+ * CNAME, with no need to update the LRU.  Anything else, from stale data
+ * to delegations and covering NSEC records, is left to the locked path,
+ * which is signalled by returning DNS_R_CONTINUE.
+ *
+ * The writers only free the headers after a RCU grace period, so they can
+ * be examined here; before they are bound, a node reference is taken and
+ * the headers are checked again, to make sure that they were not retired
+ * in the meantime.
+ */
+static isc_result_t
+find_lockfree(qpc_search_t *search, const dns_name_t *name,
+	      dns_rdatatype_t type, dns_dbnode_t **nodep,
+	      dns_name_t *foundname, dns_rdataset_t *rdataset,
+	      dns_rdataset_t *sigrdataset DNS__DB_FLARG) {
+	qpcache_t *qpdb = search->qpdb;
+	isc_result_t result = DNS_R_CONTINUE;
+	qpcnode_t *node = NULL;
+	dns_dbnode_t *detach = NULL;
+	dns_slabheader_t *header = NULL;
+	dns_slabheader_t *found = NULL, *foundsig = NULL, *cnamesig = NULL;
+	dns_typepair_t sigtype = DNS_SIGTYPE(type);
+	dns_typepair_t negtype = DNS_TYPEPAIR_VALUE(0, type);
+	bool cname_ok = true;
+
+	REQUIRE(type != dns_rdatatype_any);
+
+	if (type == dns_rdatatype_key || type == dns_rdatatype_nsec) {
+		cname_ok = false;
+	}
+
+	rcu_read_lock();
+
+	if (atomic_load_acquire(&qpdb->dname) && dname_above(qpdb, name)) {
+		goto unlock;
+	}
+
+	node = names_lookup(qpdb, name);
+	if (node == NULL) {
+		goto unlock;
+	}
+
+	for (header = rcu_dereference(node->data); header != NULL;
+	     header = rcu_dereference(header->next))
+	{
+		if (ANCIENT(header)) {
+			continue;
+		}
+		if (STALE(header) || IGNORE(header) ||
+		    !ACTIVE(header, search->now))
+		{
+			goto unlock;
+		}
+		if (!EXISTS(header)) {
+			continue;
+		}
+
+		if (header->type == type ||
+		    (cname_ok && header->type == dns_rdatatype_cname))
+		{
+			found = header;
+			if (header->type == dns_rdatatype_cname && cname_ok) {
+				if (cnamesig != NULL) {
+					foundsig = cnamesig;
+				} else {
+					sigtype = DNS_SIGTYPE(
+						dns_rdatatype_cname);
+				}
+			}
+		} else if (header->type == sigtype) {
+			foundsig = header;
+		} else if (header->type == RDATATYPE_NCACHEANY ||
+			   header->type == negtype)
+		{
+			found = header;
+		} else if (cname_ok &&
+			   header->type == DNS_SIGTYPE(dns_rdatatype_cname))
+		{
+			cnamesig = header;
+		}
+	}
+
+	if (found == NULL ||
+	    (DNS_TRUST_ADDITIONAL(found->trust) &&
+	     ((search->options & DNS_DBFIND_ADDITIONALOK) == 0)) ||
+	    (found->trust == dns_trust_glue &&
+	     ((search->options & DNS_DBFIND_GLUEOK) == 0)) ||
+	    (DNS_TRUST_PENDING(found->trust) &&
+	     ((search->options & DNS_DBFIND_PENDINGOK) == 0)))
+	{
+		goto unlock;
+	}
+
+	if (NEGATIVE(found)) {
+		foundsig = NULL;
+	}
+
+	if (need_headerupdate(found, search->now) ||
+	    (foundsig != NULL && need_headerupdate(foundsig, search->now)))
+	{
+		goto unlock;
+	}
+
+	if (!tryref(qpdb, node)) {
+		goto unlock;
+	}
+
+	if (!lockfree_usable(found, search->now) ||
+	    (foundsig != NULL && !lockfree_usable(foundsig, search->now)))
+	{
+		detach = (dns_dbnode_t *)node;
+		goto unlock;
+	}
+
+	if (NEGATIVE(found)) {
+		if (NXDOMAIN(found)) {
+			result = DNS_R_NCACHENXDOMAIN;
+		} else {
+			result = DNS_R_NCACHENXRRSET;
+		}
+	} else if (type != found->type &&
+		   found->type == dns_rdatatype_cname)
+	{
+		result = DNS_R_CNAME;
+	} else {
+		result = ISC_R_SUCCESS;
+	}
+
+	if (foundname != NULL) {
+		dns_name_copy(&node->name, foundname);
+	}
+
+	bindrdataset(qpdb, node, found, search->now, isc_rwlocktype_none,
+		     isc_rwlocktype_none, rdataset DNS__DB_FLARG_PASS);
+	if (foundsig != NULL) {
+		bindrdataset(qpdb, node, foundsig, search->now,
+			     isc_rwlocktype_none, isc_rwlocktype_none,
+			     sigrdataset DNS__DB_FLARG_PASS);
+	}
+
+	if (nodep != NULL) {
+		/* The caller gets our reference. */
+		*nodep = (dns_dbnode_t *)node;
+	} else if (rdataset != NULL) {
+		/*
+		 * The rdataset holds its own reference, so ours can be
+		 * dropped without going through decref().
+		 */
+		uint_fast32_t refs = isc_refcount_decrement(&node->erefs);
+		INSIST(refs > 1);
+		qpcnode_unref(node);
+	} else {
+		detach = (dns_dbnode_t *)node;
+	}
+
+unlock:
+	rcu_read_unlock();
+
+	if (detach != NULL) {
+		detachnode((dns_db_t *)qpdb, &detach DNS__DB_FLARG_PASS);
+	}
+
+	return result;
+}
+
 static isc_result_t
 find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
      dns_rdatatype_t type, unsigned int options, isc_stdtime_t now,
@@ -1567,6 +2175,16 @@ find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 		.now = now,
 	};
 
+	if (search.qpdb->lockfree && type != dns_rdatatype_any) {
+		result = find_lockfree(&search, name, type, nodep, foundname,
+				       rdataset,
+				       sigrdataset DNS__DB_FLARG_PASS);
+		if (result != DNS_R_CONTINUE) {
+			update_cachestats(search.qpdb, name, type, result);
+			return result;
+		}
+	}
+
 	TREE_RDLOCK(&search.qpdb->tree_lock, &tlocktype);
 
 	/*
@@ -1677,7 +2295,7 @@ find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 	header_prev = NULL;
 	for (header = node->data; header != NULL; header = header_next) {
 		header_next = header->next;
-		if (check_stale_header(node, header, &nlocktype, lock, &search,
+		if (check_stale_header(node, header, &search,
 				       &header_prev))
 		{
 			/* Do nothing. */
@@ -1970,7 +2588,7 @@ tree_exit:
 		INSIST(tlocktype == isc_rwlocktype_none);
 	}
 
-	update_cachestats(search.qpdb, result);
+	update_cachestats(search.qpdb, name, type, result);
 	return result;
 }
 
@@ -2049,7 +2667,7 @@ findzonecut(dns_db_t *db, const dns_name_t *name, unsigned int options,
 
 	for (header = node->data; header != NULL; header = header_next) {
 		header_next = header->next;
-		if (check_stale_header(node, header, &nlocktype, lock, &search,
+		if (check_stale_header(node, header, &search,
 				       &header_prev))
 		{
 			/*
@@ -2188,24 +2806,11 @@ findrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	for (header = qpnode->data; header != NULL; header = header_next) {
 		header_next = header->next;
 		if (!ACTIVE(header, now)) {
-			if ((header->ttl + STALE_TTL(header, qpdb) <
-			     now - QPDB_VIRTUAL) &&
-			    (nlocktype == isc_rwlocktype_write ||
-			     NODE_TRYUPGRADE(lock, &nlocktype) ==
-				     ISC_R_SUCCESS))
+			if (header->ttl + STALE_TTL(header, qpdb) <
+			    now - QPDB_VIRTUAL)
 			{
-				/*
-				 * We update the node's status only when we
-				 * can get write access.
-				 *
-				 * We don't check if refcurrent(qpnode) == 0
-				 * and try to free like we do in find(),
-				 * because refcurrent(qpnode) must be
-				 * non-zero.  This is so because 'node' is an
-				 * argument to the function.
-				 */
-				mark(header, DNS_SLABHEADERATTR_ANCIENT);
-				HEADERNODE(header)->dirty = 1;
+				/* Leave it to the sweeper of the bucket */
+				sweep_schedule(qpdb, qpnode->locknum);
 			}
 		} else if (EXISTS(header) && !ANCIENT(header)) {
 			if (header->type == matchtype) {
@@ -2246,11 +2851,110 @@ findrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 		}
 	}
 
-	update_cachestats(qpdb, result);
+	update_cachestats(qpdb, &qpnode->name, type, result);
 
 	return result;
 }
 
+static void
+findrdatasets(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
+	      unsigned int count, const dns_rdatatype_t *types,
+	      isc_stdtime_t now, dns_rdataset_t **rdatasets,
+	      dns_rdataset_t **sigrdatasets,
+	      isc_result_t *results DNS__DB_FLARG) {
+	qpcache_t *qpdb = (qpcache_t *)db;
+	qpcnode_t *qpnode = (qpcnode_t *)node;
+	dns_slabheader_t *header = NULL, *header_next = NULL;
+	dns_slabheader_t *found[DNS_DB_MAXFINDTYPES] = { NULL };
+	dns_slabheader_t *foundsig[DNS_DB_MAXFINDTYPES] = { NULL };
+	dns_slabheader_t *nxdomain = NULL;
+	isc_rwlock_t *lock = NULL;
+	isc_rwlocktype_t nlocktype = isc_rwlocktype_none;
+
+	REQUIRE(VALID_QPDB(qpdb));
+	REQUIRE(count <= DNS_DB_MAXFINDTYPES);
+
+	UNUSED(version);
+
+	if (now == 0) {
+		now = isc_stdtime_now();
+	}
+
+	lock = &qpdb->node_locks[qpnode->locknum].lock;
+	NODE_RDLOCK(lock, &nlocktype);
+
+	/*
+	 * Walk the node once, picking out all the requested types, their
+	 * signatures and their negative cache entries.
+	 */
+	for (header = qpnode->data; header != NULL; header = header_next) {
+		header_next = header->next;
+		if (!ACTIVE(header, now)) {
+			if (header->ttl + STALE_TTL(header, qpdb) <
+			    now - QPDB_VIRTUAL)
+			{
+				/* Leave it to the sweeper of the bucket */
+				sweep_schedule(qpdb, qpnode->locknum);
+			}
+			continue;
+		}
+		if (!EXISTS(header) || ANCIENT(header)) {
+			continue;
+		}
+		if (header->type == RDATATYPE_NCACHEANY) {
+			nxdomain = header;
+			continue;
+		}
+		for (unsigned int i = 0; i < count; i++) {
+			if (header->type == DNS_TYPEPAIR_VALUE(types[i], 0) ||
+			    header->type == DNS_TYPEPAIR_VALUE(0, types[i]))
+			{
+				found[i] = header;
+				break;
+			} else if (header->type == DNS_SIGTYPE(types[i])) {
+				foundsig[i] = header;
+				break;
+			}
+		}
+	}
+
+	for (unsigned int i = 0; i < count; i++) {
+		if (nxdomain != NULL) {
+			found[i] = nxdomain;
+		}
+		if (found[i] == NULL) {
+			results[i] = ISC_R_NOTFOUND;
+			continue;
+		}
+		bindrdataset(qpdb, qpnode, found[i], now, nlocktype,
+			     isc_rwlocktype_none,
+			     rdatasets[i] DNS__DB_FLARG_PASS);
+		if (!NEGATIVE(found[i]) && foundsig[i] != NULL &&
+		    sigrdatasets != NULL)
+		{
+			bindrdataset(qpdb, qpnode, foundsig[i], now, nlocktype,
+				     isc_rwlocktype_none,
+				     sigrdatasets[i] DNS__DB_FLARG_PASS);
+		}
+		if (!NEGATIVE(found[i])) {
+			results[i] = ISC_R_SUCCESS;
+		} else if (NXDOMAIN(found[i])) {
+			results[i] = DNS_R_NCACHENXDOMAIN;
+		} else {
+			results[i] = DNS_R_NCACHENXRRSET;
+		}
+	}
+
+	NODE_UNLOCK(lock, &nlocktype);
+
+	for (unsigned int i = 0; i < count; i++) {
+		if (found[i] != NULL) {
+			update_cachestats(qpdb, &qpnode->name, types[i],
+					  results[i]);
+		}
+	}
+}
+
 static isc_result_t
 setcachestats(dns_db_t *db, isc_stats_t *stats) {
 	qpcache_t *qpdb = (qpcache_t *)db;
@@ -2330,7 +3034,7 @@ expiredata(dns_db_t *db, dns_dbnode_t *node, void *data) {
 
 static size_t
 rdataset_size(dns_slabheader_t *header) {
-	if (!NONEXISTENT(header)) {
+	if (!NONEXISTENT(header) && header->raw == NULL) {
 		return dns_rdataslab_size((unsigned char *)header,
 					  sizeof(*header));
 	}
@@ -2368,6 +3072,55 @@ expire_lru_headers(qpcache_t *qpdb, unsigned int locknum,
 	return purged;
 }
 
+/*%
+ * Move the SIEVE hand of the bucket from the oldest entries towards the
+ * newest ones, clearing the visited mark of the entries it passes and
+ * evicting those that were not visited since its last pass, until enough
+ * memory was freed.  The number of entries passed is bounded, as the
+ * lock-free readers can mark the entries visited again concurrently.
+ *
+ * Caller must hold the node (write) lock.
+ */
+static size_t
+expire_sieve_headers(qpcache_t *qpdb, unsigned int locknum,
+		     isc_rwlocktype_t *nlocktypep, isc_rwlocktype_t *tlocktypep,
+		     size_t purgesize DNS__DB_FLARG) {
+	size_t purged = 0;
+
+	for (size_t i = 0; i < QPDB_SIEVE_MAXSCAN && purged <= purgesize; i++)
+	{
+		dns_slabheader_t *header = qpdb->sieve_hand[locknum];
+		size_t header_size;
+
+		if (header == NULL) {
+			header = ISC_LIST_TAIL(qpdb->lru[locknum]);
+			if (header == NULL) {
+				break;
+			}
+		}
+
+		if (VISITED(header)) {
+			DNS_SLABHEADER_CLRATTR(header,
+					       DNS_SLABHEADERATTR_VISITED);
+			qpdb->sieve_hand[locknum] = ISC_LIST_PREV(header, link);
+			continue;
+		}
+
+		/*
+		 * See expire_lru_headers() for why the entry is unlinked
+		 * here; this also moves the hand to the next entry.
+		 */
+		header_size = rdataset_size(header);
+		qpdb->sieve_hand[locknum] = ISC_LIST_PREV(header, link);
+		ISC_LIST_UNLINK(qpdb->lru[locknum], header, link);
+		expireheader(header, nlocktypep, tlocktypep,
+			     dns_expire_sieve DNS__DB_FLARG_PASS);
+		purged += header_size;
+	}
+
+	return purged;
+}
+
 /*%
  * Purge some expired and/or stale (i.e. unused for some period) cache entries
  * due to an overmem condition.  To recover from this condition quickly,
@@ -2375,17 +3128,24 @@ expire_lru_headers(qpcache_t *qpdb, unsigned int locknum,
  * the overmem; this is accessible via newheader.
  *
  * The LRU lists tails are processed in LRU order to the nearest second.
+ * With the SIEVE eviction policy, each bucket's hand is advanced instead.
  *
- * A write lock on the tree must be held.
+ * Before the cache is overmem, the memory 'pressure' already rises, and
+ * a share of that size proportional to the pressure is purged from a
+ * single bucket on each addition, so the cache shrinks gradually instead
+ * of in bursts once it is overmem.
+ *
+ * At the full pressure, a write lock on the tree must be held.
  */
 static void
-overmem(qpcache_t *qpdb, dns_slabheader_t *newheader,
+overmem(qpcache_t *qpdb, dns_slabheader_t *newheader, unsigned int pressure,
 	isc_rwlocktype_t *tlocktypep DNS__DB_FLARG) {
 	uint32_t locknum_start = qpdb->lru_sweep++ % qpdb->node_lock_count;
 	uint32_t locknum = locknum_start;
 	size_t purgesize, purged = 0;
 	isc_stdtime_t min_last_used = 0;
-	size_t max_passes = 8;
+	bool full = (pressure >= ISC_MEM_PRESSURE_MAX);
+	size_t max_passes = full ? 8 : 0;
 
 	/*
 	 * Maximum estimated size of the data being added: The size
@@ -2398,11 +3158,24 @@ overmem(qpcache_t *qpdb, dns_slabheader_t *newheader,
 	purgesize = 2 * (sizeof(qpcnode_t) +
 			 dns_name_size(&HEADERNODE(newheader)->name)) +
 		    rdataset_size(newheader) + 12288;
+	if (!full) {
+		purgesize = purgesize * pressure / ISC_MEM_PRESSURE_MAX;
+	}
 again:
 	do {
 		isc_rwlocktype_t nlocktype = isc_rwlocktype_none;
 		NODE_WRLOCK(&qpdb->node_locks[locknum].lock, &nlocktype);
 
+		if (qpdb->sieve) {
+			purged += expire_sieve_headers(
+				qpdb, locknum, &nlocktype, tlocktypep,
+				purgesize - purged DNS__DB_FLARG_PASS);
+			NODE_UNLOCK(&qpdb->node_locks[locknum].lock,
+				    &nlocktype);
+			locknum = (locknum + 1) % qpdb->node_lock_count;
+			continue;
+		}
+
 		purged += expire_lru_headers(
 			qpdb, locknum, &nlocktype, tlocktypep,
 			purgesize - purged DNS__DB_FLARG_PASS);
@@ -2419,13 +3192,15 @@ again:
 		}
 		NODE_UNLOCK(&qpdb->node_locks[locknum].lock, &nlocktype);
 		locknum = (locknum + 1) % qpdb->node_lock_count;
-	} while (locknum != locknum_start && purged <= purgesize);
+	} while (full && locknum != locknum_start && purged <= purgesize);
 
 	/*
 	 * Update qpdb->last_used if we have walked all the list tails and have
-	 * not freed the required amount of memory.
+	 * not freed the required amount of memory.  Below the full pressure,
+	 * only one list tail has been walked, which makes the next additions
+	 * purge a bit more.
 	 */
-	if (purged < purgesize) {
+	if (purged < purgesize && !qpdb->sieve) {
 		if (min_last_used != 0) {
 			qpdb->last_used = min_last_used;
 			if (max_passes-- > 0) {
@@ -2463,6 +3238,19 @@ free_qpdb(qpcache_t *qpdb, bool log) {
 	char buf[DNS_NAME_FORMATSIZE];
 	dns_qp_t **treep = NULL;
 
+	if (qpdb->names != NULL) {
+		qpcnode_t *node = NULL;
+		struct cds_lfht_iter iter;
+
+		rcu_read_lock();
+		cds_lfht_for_each_entry(qpdb->names, &iter, node, ht_node) {
+			INSIST(!cds_lfht_del(qpdb->names, &node->ht_node));
+		}
+		rcu_read_unlock();
+		RUNTIME_CHECK(!cds_lfht_destroy(qpdb->names, NULL));
+		qpdb->names = NULL;
+	}
+
 	for (;;) {
 		/*
 		 * pick the next tree to (start to) destroy
@@ -2507,15 +3295,24 @@ free_qpdb(qpcache_t *qpdb, bool log) {
 			     qpdb->node_lock_count,
 			     sizeof(dns_slabheaderlist_t));
 	}
+	if (qpdb->sieve_hand != NULL) {
+		isc_mem_cput(qpdb->common.mctx, qpdb->sieve_hand,
+			     qpdb->node_lock_count,
+			     sizeof(qpdb->sieve_hand[0]));
+	}
 	/*
 	 * Clean up dead node buckets.
 	 */
 	for (i = 0; i < qpdb->node_lock_count; i++) {
 		INSIST(isc_queue_empty(&qpdb->deadnodes[i]));
 		isc_queue_destroy(&qpdb->deadnodes[i]);
+		INSIST(isc_queue_empty(&qpdb->sweep[i].backlog));
+		isc_queue_destroy(&qpdb->sweep[i].backlog);
 	}
 	isc_mem_cput(qpdb->common.mctx, qpdb->deadnodes, qpdb->node_lock_count,
 		     sizeof(qpdb->deadnodes[0]));
+	isc_mem_cput(qpdb->common.mctx, qpdb->sweep, qpdb->node_lock_count,
+		     sizeof(qpdb->sweep[0]));
 
 	/*
 	 * Clean up heap objects.
@@ -2544,6 +3341,9 @@ free_qpdb(qpcache_t *qpdb, bool log) {
 	isc_refcount_destroy(&qpdb->common.references);
 
 	isc_rwlock_destroy(&qpdb->lock);
+	INSIST(isc_hashmap_count(qpdb->slabs) == 0);
+	isc_hashmap_destroy(&qpdb->slabs);
+	isc_mutex_destroy(&qpdb->slablock);
 	qpdb->common.magic = 0;
 	qpdb->common.impmagic = 0;
 	isc_mem_detach(&qpdb->hmctx);
@@ -2608,40 +3408,84 @@ mark_ancient(dns_slabheader_t *header) {
 }
 
 /*%
- * Clean up dead nodes.  These are nodes which have no references, and
- * have no data.  They are dead but we could not or chose not to delete
- * them when we deleted all the data at that node because we did not want
- * to wait for the tree write lock.
+ * The sweeper of a bucket.  It cleans up dead nodes, which are nodes that
+ * have no references and no data, or that need cleaning up, but which
+ * were not cleaned up when they were released because that would have
+ * meant waiting for the write locks.  It also expires the headers at the
+ * top of the TTL heap of the bucket.  Both are done in batches of
+ * DNS_QPDB_SWEEP_COUNT, and the sweeper reschedules itself while there
+ * is more to do.
  */
 static void
-cleanup_deadnodes(void *arg) {
+sweep_bucket(void *arg) {
 	qpcache_t *qpdb = arg;
 	uint16_t locknum = isc_tid();
 	isc_rwlocktype_t tlocktype = isc_rwlocktype_none;
 	isc_rwlocktype_t nlocktype = isc_rwlocktype_none;
-	qpcnode_t *qpnode = NULL, *qpnext = NULL;
-	isc_queue_t deadnodes;
+	db_nodelock_t *nodelock = NULL;
+	qpc_sweep_t *sweep = NULL;
+	bool overmem, more, inactive = false, want_free = false;
 
 	INSIST(locknum < qpdb->node_lock_count);
 
-	isc_queue_init(&deadnodes);
+	nodelock = &qpdb->node_locks[locknum];
+	sweep = &qpdb->sweep[locknum];
+	atomic_store_release(&sweep->scheduled, false);
+
+	overmem = isc_mem_pressure(qpdb->common.mctx) >= ISC_MEM_PRESSURE_MAX;
 
 	TREE_WRLOCK(&qpdb->tree_lock, &tlocktype);
-	NODE_WRLOCK(&qpdb->node_locks[locknum].lock, &nlocktype);
+	NODE_WRLOCK(&nodelock->lock, &nlocktype);
 
-	RUNTIME_CHECK(isc_queue_splice(&deadnodes, &qpdb->deadnodes[locknum]));
-	isc_queue_for_each_entry_safe(&deadnodes, qpnode, qpnext, deadlink) {
+	if (isc_queue_empty(&sweep->backlog)) {
+		(void)isc_queue_splice(&sweep->backlog,
+				       &qpdb->deadnodes[locknum]);
+	}
+	for (size_t i = 0; i < DNS_QPDB_SWEEP_COUNT; i++) {
+		/* Nothing else dequeues from the backlog, so this can't block */
+		qpcnode_t *qpnode = isc_queue_dequeue_entry(&sweep->backlog,
+							    qpcnode_t, deadlink);
+		if (qpnode == NULL) {
+			break;
+		}
 		decref(qpdb, qpnode, &nlocktype, &tlocktype, false);
 	}
 
-	NODE_UNLOCK(&qpdb->node_locks[locknum].lock, &nlocktype);
+	more = expire_ttl_headers(qpdb, locknum, &nlocktype, &tlocktype,
+				  isc_stdtime_now(), overmem,
+				  DNS_QPDB_SWEEP_COUNT DNS__DB_FILELINE);
+	if (more || !isc_queue_empty(&sweep->backlog) ||
+	    !isc_queue_empty(&qpdb->deadnodes[locknum]))
+	{
+		sweep_schedule(qpdb, locknum);
+	}
+
+	if (isc_refcount_decrement(&nodelock->references) == 1 &&
+	    nodelock->exiting)
+	{
+		inactive = true;
+	}
+
+	NODE_UNLOCK(&nodelock->lock, &nlocktype);
 	TREE_UNLOCK(&qpdb->tree_lock, &tlocktype);
+
+	if (inactive) {
+		RWLOCK(&qpdb->lock, isc_rwlocktype_write);
+		qpdb->active--;
+		if (qpdb->active == 0) {
+			want_free = true;
+		}
+		RWUNLOCK(&qpdb->lock, isc_rwlocktype_write);
+		if (want_free) {
+			free_qpdb(qpdb, true);
+		}
+	}
 }
 
 /*
  * This function is assumed to be called when a node is newly referenced
  * and can be in the deadnode list.  In that case the node will be references
- * and cleanup_deadnodes() will remove it from the list when the cleaning
+ * and sweep_bucket() will remove it from the list when the cleaning
  * happens.
  * Note: while a new reference is gained in multiple places, there are only very
  * few cases where the node can be in the deadnode list (only empty nodes can
@@ -2702,6 +3546,12 @@ findnode(dns_db_t *db, const dns_name_t *name, bool create,
 			node = new_qpcnode(qpdb, name);
 			result = dns_qp_insert(qpdb->tree, node, 0);
 			INSIST(result == ISC_R_SUCCESS);
+			if (qpdb->lockfree) {
+				rcu_read_lock();
+				cds_lfht_add(qpdb->names, dns_name_hash(name),
+					     &node->ht_node);
+				rcu_read_unlock();
+			}
 			qpcnode_unref(node);
 		}
 	}
@@ -2730,6 +3580,58 @@ attachnode(dns_db_t *db, dns_dbnode_t *source,
 	*targetp = source;
 }
 
+/*
+ * Drop an external reference to a node without taking the node lock,
+ * which is possible in the lock-free reads mode unless the node needs
+ * cleaning up.  A header retired between the check of the 'dirty' flag
+ * and the release of the last reference is cleaned up when the node is
+ * next released with the lock held, or by the LRU expiry.
+ *
+ * Returns false if decref() has to be called instead; otherwise,
+ * '*inactivep' is set if this was the last reference to the node lock
+ * bucket of a database being destroyed.
+ */
+static bool
+unref_lockfree(qpcache_t *qpdb, qpcnode_t *node, bool *inactivep) {
+	db_nodelock_t *nodelock = &qpdb->node_locks[node->locknum];
+	uint_fast32_t refs = isc_refcount_current(&node->erefs);
+	isc_rwlocktype_t nlocktype = isc_rwlocktype_none;
+
+	if (node->nsec == DNS_DB_NSEC_NSEC) {
+		return false;
+	}
+
+	do {
+		INSIST(refs > 0);
+		if (refs == 1 && (node->dirty || node->data == NULL)) {
+			return false;
+		}
+	} while (!atomic_compare_exchange_weak_acq_rel(&node->erefs, &refs,
+						       refs - 1));
+
+	if (refs == 1) {
+		refs = isc_refcount_current(&nodelock->references);
+		do {
+			if (refs == 1) {
+				/* The bucket may become inactive. */
+				NODE_RDLOCK(&nodelock->lock, &nlocktype);
+				if (isc_refcount_decrement(
+					    &nodelock->references) == 1 &&
+				    nodelock->exiting)
+				{
+					*inactivep = true;
+				}
+				NODE_UNLOCK(&nodelock->lock, &nlocktype);
+				break;
+			}
+		} while (!atomic_compare_exchange_weak_acq_rel(
+			&nodelock->references, &refs, refs - 1));
+	}
+
+	qpcnode_unref(node);
+	return true;
+}
+
 static void
 detachnode(dns_db_t *db, dns_dbnode_t **targetp DNS__DB_FLARG) {
 	qpcache_t *qpdb = (qpcache_t *)db;
@@ -2746,6 +3648,10 @@ detachnode(dns_db_t *db, dns_dbnode_t **targetp DNS__DB_FLARG) {
 	node = (qpcnode_t *)(*targetp);
 	nodelock = &qpdb->node_locks[node->locknum];
 
+	if (qpdb->lockfree && unref_lockfree(qpdb, node, &inactive)) {
+		goto done;
+	}
+
 	NODE_RDLOCK(&nodelock->lock, &nlocktype);
 
 	if (decref(qpdb, node, &nlocktype, &tlocktype, true DNS__DB_FLARG_PASS))
@@ -2760,6 +3666,7 @@ detachnode(dns_db_t *db, dns_dbnode_t **targetp DNS__DB_FLARG) {
 	NODE_UNLOCK(&nodelock->lock, &nlocktype);
 	INSIST(tlocktype == isc_rwlocktype_none);
 
+done:
 	*targetp = NULL;
 
 	if (inactive) {
@@ -2885,6 +3792,12 @@ add(qpcache_t *qpdb, qpcnode_t *qpnode,
 
 	newheader_nx = NONEXISTENT(newheader) ? true : false;
 
+	if (newheader->type == dns_rdatatype_dname ||
+	    newheader->type == DNS_SIGTYPE(dns_rdatatype_dname))
+	{
+		atomic_store_release(&qpdb->dname, true);
+	}
+
 	if (!newheader_nx) {
 		dns_rdatatype_t rdtype = DNS_TYPEPAIR_TYPE(newheader->type);
 		dns_rdatatype_t covers = DNS_TYPEPAIR_COVERS(newheader->type);
@@ -3061,13 +3974,7 @@ find_header:
 				setttl(header, newheader->ttl);
 			}
 			if (header->last_used != now) {
-				ISC_LIST_UNLINK(
-					qpdb->lru[HEADERNODE(header)->locknum],
-					header, link);
-				header->last_used = now;
-				ISC_LIST_PREPEND(
-					qpdb->lru[HEADERNODE(header)->locknum],
-					header, link);
+				update_header(qpdb, header, now);
 			}
 			if (header->noqname == NULL &&
 			    newheader->noqname != NULL)
@@ -3123,13 +4030,7 @@ find_header:
 				setttl(header, newheader->ttl);
 			}
 			if (header->last_used != now) {
-				ISC_LIST_UNLINK(
-					qpdb->lru[HEADERNODE(header)->locknum],
-					header, link);
-				header->last_used = now;
-				ISC_LIST_PREPEND(
-					qpdb->lru[HEADERNODE(header)->locknum],
-					header, link);
+				update_header(qpdb, header, now);
 			}
 			if (header->noqname == NULL &&
 			    newheader->noqname != NULL)
@@ -3173,13 +4074,15 @@ find_header:
 			 * Since we don't generate changed records when
 			 * loading, we MUST clean up 'header' now.
 			 */
+			newheader->next = topheader->next;
 			if (topheader_prev != NULL) {
-				topheader_prev->next = newheader;
+				rcu_assign_pointer(topheader_prev->next,
+						   newheader);
 			} else {
-				qpnode->data = newheader;
+				rcu_assign_pointer(qpnode->data, newheader);
 			}
-			newheader->next = topheader->next;
-			dns_slabheader_destroy(&header);
+			mark(header, DNS_SLABHEADERATTR_ANCIENT);
+			free_header(qpdb, &header);
 		} else {
 			idx = HEADERNODE(newheader)->locknum;
 			INSIST(qpdb->heaps != NULL);
@@ -3193,13 +4096,14 @@ find_header:
 				ISC_LIST_PREPEND(qpdb->lru[idx], newheader,
 						 link);
 			}
+			newheader->next = topheader->next;
+			newheader->down = topheader;
 			if (topheader_prev != NULL) {
-				topheader_prev->next = newheader;
+				rcu_assign_pointer(topheader_prev->next,
+						   newheader);
 			} else {
-				qpnode->data = newheader;
+				rcu_assign_pointer(qpnode->data, newheader);
 			}
-			newheader->next = topheader->next;
-			newheader->down = topheader;
 			topheader->next = newheader;
 			qpnode->dirty = 1;
 			mark_ancient(header);
@@ -3240,13 +4144,14 @@ find_header:
 			 * we INSIST on it.
 			 */
 			INSIST(!loading);
+			newheader->next = topheader->next;
+			newheader->down = topheader;
 			if (topheader_prev != NULL) {
-				topheader_prev->next = newheader;
+				rcu_assign_pointer(topheader_prev->next,
+						   newheader);
 			} else {
-				qpnode->data = newheader;
+				rcu_assign_pointer(qpnode->data, newheader);
 			}
-			newheader->next = topheader->next;
-			newheader->down = topheader;
 			topheader->next = newheader;
 			qpnode->dirty = 1;
 		} else {
@@ -3258,15 +4163,15 @@ find_header:
 			if (prio_header(newheader)) {
 				/* This is a priority type, prepend it */
 				newheader->next = qpnode->data;
-				qpnode->data = newheader;
+				rcu_assign_pointer(qpnode->data, newheader);
 			} else if (prioheader != NULL) {
 				/* Append after the priority headers */
 				newheader->next = prioheader->next;
-				prioheader->next = newheader;
+				rcu_assign_pointer(prioheader->next, newheader);
 			} else {
 				/* There were no priority headers */
 				newheader->next = qpnode->data;
-				qpnode->data = newheader;
+				rcu_assign_pointer(qpnode->data, newheader);
 			}
 
 			if (overmaxtype(qpdb, ntypes)) {
@@ -3303,6 +4208,131 @@ find_header:
 	return ISC_R_SUCCESS;
 }
 
+/*
+ * A negative cache entry is shared only if it holds nothing but the SOA,
+ * as the answers from unsigned zones do, where a flood of queries for
+ * random names leaves one identical entry per name.  The DNSSEC proofs
+ * differ from name to name, and the validator updates their trust in
+ * the cached rdata in place.
+ */
+static bool
+ncache_shareable(dns_rdataset_t *rdataset) {
+	dns_rdataset_t clone = DNS_RDATASET_INIT;
+	isc_result_t result;
+	bool shareable = true;
+
+	dns_rdataset_clone(rdataset, &clone);
+	for (result = dns_rdataset_first(&clone);
+	     result == ISC_R_SUCCESS && shareable;
+	     result = dns_rdataset_next(&clone))
+	{
+		dns_rdataset_t rds = DNS_RDATASET_INIT;
+		dns_name_t name;
+
+		dns_name_init(&name, NULL);
+		dns_ncache_current(&clone, &name, &rds);
+		shareable = (rds.type == dns_rdatatype_soa);
+		dns_rdataset_disassociate(&rds);
+	}
+	dns_rdataset_disassociate(&clone);
+
+	return shareable;
+}
+
+static bool
+slab_match(void *node, const void *key) {
+	qpc_slab_t *slab = node;
+	unsigned char *raw = UNCONST(key);
+
+	return dns_rdataslab_size(raw, 0) == slab->size &&
+	       memcmp(slab->raw, raw, slab->size) == 0;
+}
+
+/*
+ * Replace the rdata of a negative header being added with a reference
+ * to an identical slab already in the cache, or share it if it is the
+ * first of its kind.  The header is reallocated on its own.
+ */
+static dns_slabheader_t *
+shareslab(qpcache_t *qpdb, dns_slabheader_t *header, unsigned int size) {
+	isc_mem_t *mctx = qpdb->common.mctx;
+	unsigned char *raw = (unsigned char *)(header + 1);
+	unsigned int rawsize = size - sizeof(*header);
+	uint32_t hashval = isc_hash32(raw, rawsize, true);
+	qpc_slab_t *slab = NULL;
+	dns_slabheader_t *newheader = NULL;
+	isc_result_t result;
+
+	LOCK(&qpdb->slablock);
+	result = isc_hashmap_find(qpdb->slabs, hashval, slab_match, raw,
+				  (void **)&slab);
+	if (result == ISC_R_SUCCESS) {
+		slab->references++;
+		qpdb->sharedbytes += rawsize;
+	} else {
+		slab = isc_mem_get(mctx, STRUCT_FLEX_SIZE(slab, raw, rawsize));
+		*slab = (qpc_slab_t){
+			.hashval = hashval,
+			.references = 1,
+			.size = rawsize,
+		};
+		isc_mem_attach(mctx, &slab->mctx);
+		memmove(slab->raw, raw, rawsize);
+		result = isc_hashmap_add(qpdb->slabs, hashval, slab_match,
+					 slab->raw, slab, NULL);
+		INSIST(result == ISC_R_SUCCESS);
+	}
+	UNLOCK(&qpdb->slablock);
+
+	newheader = isc_mem_get(mctx, sizeof(*newheader));
+	memmove(newheader, header, sizeof(*newheader));
+	newheader->raw = slab->raw;
+	isc_mem_put(mctx, header, size);
+
+	return newheader;
+}
+
+static void
+free_slab_rcu(struct rcu_head *rcu_head) {
+	qpc_slab_t *slab = caa_container_of(rcu_head, qpc_slab_t, rcu_head);
+
+	isc_mem_putanddetach(&slab->mctx, slab,
+			     STRUCT_FLEX_SIZE(slab, raw, slab->size));
+}
+
+/*
+ * Drop the reference of 'header' to its shared slab.  In the lock-free
+ * reads mode, the slab is freed after the RCU grace period, like the
+ * headers referring to it.
+ */
+static void
+unshareslab(qpcache_t *qpdb, dns_slabheader_t *header) {
+	qpc_slab_t *slab =
+		(qpc_slab_t *)(header->raw - offsetof(qpc_slab_t, raw));
+	isc_result_t result;
+
+	LOCK(&qpdb->slablock);
+	if (--slab->references > 0) {
+		qpdb->sharedbytes -= slab->size;
+		slab = NULL;
+	} else {
+		result = isc_hashmap_delete(qpdb->slabs, slab->hashval,
+					    slab_match, slab->raw);
+		INSIST(result == ISC_R_SUCCESS);
+	}
+	UNLOCK(&qpdb->slablock);
+
+	if (slab == NULL) {
+		return;
+	}
+
+	if (qpdb->lockfree) {
+		call_rcu(&slab->rcu_head, free_slab_rcu);
+	} else {
+		free_slab_rcu(&slab->rcu_head);
+	}
+}
+
 static isc_result_t
 addnoqname(isc_mem_t *mctx, dns_slabheader_t *newheader, uint32_t maxrrperset,
 	   dns_rdataset_t *rdataset) {
@@ -3380,11 +4410,6 @@ cleanup:
 	return result;
 }
 
-static void
-expire_ttl_headers(qpcache_t *qpdb, unsigned int locknum,
-		   isc_rwlocktype_t *nlocktypep, isc_rwlocktype_t *tlocktypep,
-		   isc_stdtime_t now, bool cache_is_overmem DNS__DB_FLARG);
-
 static isc_result_t
 addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	    isc_stdtime_t now, dns_rdataset_t *rdataset, unsigned int options,
@@ -3396,9 +4421,11 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	isc_result_t result;
 	bool delegating = false;
 	bool newnsec;
+	qpcnode_t *nsecnode = NULL;
 	isc_rwlocktype_t tlocktype = isc_rwlocktype_none;
 	isc_rwlocktype_t nlocktype = isc_rwlocktype_none;
 	bool cache_is_overmem = false;
+	unsigned int pressure;
 	dns_fixedname_t fixed;
 	dns_name_t *name = NULL;
 
@@ -3452,6 +4479,9 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	if ((rdataset->attributes & DNS_RDATASETATTR_OPTOUT) != 0) {
 		DNS_SLABHEADER_SETATTR(newheader, DNS_SLABHEADERATTR_OPTOUT);
 	}
+	if (NEGATIVE(newheader) && ncache_shareable(rdataset)) {
+		newheader = shareslab(qpdb, newheader, region.length);
+	}
 	if ((rdataset->attributes & DNS_RDATASETATTR_NOQNAME) != 0) {
 		result = addnoqname(qpdb->common.mctx, newheader,
 				    qpdb->maxrrperset, rdataset);
@@ -3498,15 +4528,17 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	 * not necessarily have to be acquired but it will help purge
 	 * ancient entries more effectively.
 	 */
-	if (isc_mem_isovermem(qpdb->common.mctx)) {
+	pressure = isc_mem_pressure(qpdb->common.mctx);
+	if (pressure >= ISC_MEM_PRESSURE_MAX) {
 		cache_is_overmem = true;
 	}
 	if (delegating || newnsec || cache_is_overmem) {
 		TREE_WRLOCK(&qpdb->tree_lock, &tlocktype);
 	}
 
-	if (cache_is_overmem) {
-		overmem(qpdb, newheader, &tlocktype DNS__DB_FLARG_PASS);
+	if (pressure > 0) {
+		overmem(qpdb, newheader, pressure,
+			&tlocktype DNS__DB_FLARG_PASS);
 	}
 
 	NODE_WRLOCK(&qpdb->node_locks[qpnode->locknum].lock, &nlocktype);
@@ -3518,8 +4550,9 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 				  true);
 	}
 
-	expire_ttl_headers(qpdb, qpnode->locknum, &nlocktype, &tlocktype, now,
-			   cache_is_overmem DNS__DB_FLARG_PASS);
+	(void)expire_ttl_headers(qpdb, qpnode->locknum, &nlocktype,
+				 &tlocktype, now, cache_is_overmem,
+				 DNS_QPDB_EXPIRE_TTL_COUNT DNS__DB_FLARG_PASS);
 
 	/*
 	 * If we've been holding a write lock on the tree just for
@@ -3532,8 +4565,7 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 
 	result = ISC_R_SUCCESS;
 	if (newnsec) {
-		qpcnode_t *nsecnode = NULL;
-
+		nsecnode = NULL;
 		result = dns_qp_getname(qpdb->nsec, name, (void **)&nsecnode,
 					NULL);
 		if (result == ISC_R_SUCCESS) {
@@ -3544,7 +4576,7 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 			nsecnode->nsec = DNS_DB_NSEC_NSEC;
 			result = dns_qp_insert(qpdb->nsec, nsecnode, 0);
 			INSIST(result == ISC_R_SUCCESS);
-			qpcnode_detach(&nsecnode);
+			qpcnode_unref(nsecnode);
 		}
 		qpnode->nsec = DNS_DB_NSEC_HAS_NSEC;
 	}
@@ -3560,6 +4592,23 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 
 	NODE_UNLOCK(&qpdb->node_locks[qpnode->locknum].lock, &nlocktype);
 
+	/*
+	 * The NSEC record is now the one cached at this name, so update
+	 * the interval kept in the auxiliary NSEC tree.
+	 */
+	if (result == ISC_R_SUCCESS && rdataset->type == dns_rdatatype_nsec) {
+		if (nsecnode == NULL) {
+			if (tlocktype == isc_rwlocktype_none) {
+				TREE_RDLOCK(&qpdb->tree_lock, &tlocktype);
+			}
+			(void)dns_qp_getname(qpdb->nsec, name,
+					     (void **)&nsecnode, NULL);
+		}
+		if (nsecnode != NULL) {
+			nsecrange_update(qpdb, nsecnode, rdataset, now);
+		}
+	}
+
 	if (tlocktype != isc_rwlocktype_none) {
 		TREE_UNLOCK(&qpdb->tree_lock, &tlocktype);
 	}
@@ -3694,9 +4743,28 @@ dns__qpcache_create(isc_mem_t *mctx, const dns_name_t *origin,
 	if (argc != 0) {
 		hmctx = (isc_mem_t *)argv[0];
 	}
+	for (unsigned int j = 1; j < argc; j++) {
+		if (argv[j] == NULL) {
+			continue;
+		} else if (strcmp(argv[j], DNS_QPCACHE_LOCKFREE) == 0) {
+			qpdb->lockfree = true;
+		} else if (strcmp(argv[j], DNS_QPCACHE_SIEVE) == 0) {
+			qpdb->sieve = true;
+		}
+	}
+	if (qpdb->lockfree) {
+		qpdb->names = cds_lfht_new(QPDB_NAMES_INIT_SIZE,
+					   QPDB_NAMES_MIN_SIZE, 0,
+					   CDS_LFHT_AUTO_RESIZE |
+						   CDS_LFHT_ACCOUNTING,
+					   NULL);
+		INSIST(qpdb->names != NULL);
+	}
 
 	isc_rwlock_init(&qpdb->lock);
 	TREE_INITLOCK(&qpdb->tree_lock);
+	isc_mutex_init(&qpdb->slablock);
+	isc_hashmap_create(mctx, QPDB_SLABS_HASH_BITS, &qpdb->slabs);
 
 	qpdb->node_lock_count = isc_loopmgr_nloops(qpdb->loopmgr);
 	qpdb->node_locks = isc_mem_cget(mctx, qpdb->node_lock_count,
@@ -3708,6 +4776,10 @@ dns__qpcache_create(isc_mem_t *mctx, const dns_name_t *origin,
 	for (i = 0; i < (int)qpdb->node_lock_count; i++) {
 		ISC_LIST_INIT(qpdb->lru[i]);
 	}
+	if (qpdb->sieve) {
+		qpdb->sieve_hand = isc_mem_cget(mctx, qpdb->node_lock_count,
+						sizeof(qpdb->sieve_hand[0]));
+	}
 
 	/*
 	 * Create the heaps.
@@ -3727,6 +4799,12 @@ dns__qpcache_create(isc_mem_t *mctx, const dns_name_t *origin,
 	for (i = 0; i < (int)(qpdb->node_lock_count); i++) {
 		isc_queue_init(&qpdb->deadnodes[i]);
 	}
+	qpdb->sweep = isc_mem_cget(mctx, qpdb->node_lock_count,
+				   sizeof(qpdb->sweep[0]));
+	for (i = 0; i < (int)(qpdb->node_lock_count); i++) {
+		isc_queue_init(&qpdb->sweep[i].backlog);
+		atomic_init(&qpdb->sweep[i].scheduled, false);
+	}
 
 	qpdb->active = qpdb->node_lock_count;
 
@@ -3754,6 +4832,7 @@ dns__qpcache_create(isc_mem_t *mctx, const dns_name_t *origin,
 	 */
 	dns_qp_create(mctx, &qpmethods, qpdb, &qpdb->tree);
 	dns_qp_create(mctx, &qpmethods, qpdb, &qpdb->nsec);
+	dns_qp_sethugepages(qpdb->tree);
 
 	qpdb->common.magic = DNS_DB_MAGIC;
 	qpdb->common.impmagic = QPDB_MAGIC;
@@ -4308,8 +5387,7 @@ deletedata(dns_db_t *db ISC_ATTR_UNUSED, dns_dbnode_t *node ISC_ATTR_UNUSED,
 			  atomic_load_acquire(&header->attributes), false);
 
 	if (ISC_LINK_LINKED(header, link)) {
-		int idx = HEADERNODE(header)->locknum;
-		ISC_LIST_UNLINK(qpdb->lru[idx], header, link);
+		unlink_header(qpdb, header);
 	}
 
 	if (header->noqname != NULL) {
@@ -4318,23 +5396,28 @@ deletedata(dns_db_t *db ISC_ATTR_UNUSED, dns_dbnode_t *node ISC_ATTR_UNUSED,
 	if (header->closest != NULL) {
 		dns_slabheader_freeproof(db->mctx, &header->closest);
 	}
+
+	if (header->raw != NULL) {
+		unshareslab(qpdb, header);
+	}
 }
 
 /*
  * Caller must be holding the node write lock.
  */
-static void
+static bool
 expire_ttl_headers(qpcache_t *qpdb, unsigned int locknum,
 		   isc_rwlocktype_t *nlocktypep, isc_rwlocktype_t *tlocktypep,
-		   isc_stdtime_t now, bool cache_is_overmem DNS__DB_FLARG) {
+		   isc_stdtime_t now, bool cache_is_overmem,
+		   size_t count DNS__DB_FLARG) {
 	isc_heap_t *heap = qpdb->heaps[locknum];
 
-	for (size_t i = 0; i < DNS_QPDB_EXPIRE_TTL_COUNT; i++) {
+	for (size_t i = 0; i < count; i++) {
 		dns_slabheader_t *header = isc_heap_element(heap, 1);
 
 		if (header == NULL) {
 			/* No headers left on this TTL heap; exit cleaning */
-			return;
+			return false;
 		}
 
 		dns_ttl_t ttl = header->ttl;
@@ -4351,12 +5434,14 @@ expire_ttl_headers(qpcache_t *qpdb, unsigned int locknum,
 			 * the same heap can be eligible for expiry, either;
 			 * exit cleaning.
 			 */
-			return;
+			return false;
 		}
 
 		expireheader(header, nlocktypep, tlocktypep,
 			     dns_expire_ttl DNS__DB_FLARG_PASS);
 	}
+
+	return true;
 }
 
 static void
@@ -4377,6 +5462,20 @@ setmaxtypepername(dns_db_t *db, uint32_t value) {
 	qpdb->maxtypepername = value;
 }
 
+static uint64_t
+getsharedsize(dns_db_t *db) {
+	qpcache_t *qpdb = (qpcache_t *)db;
+	uint64_t size;
+
+	REQUIRE(VALID_QPDB(qpdb));
+
+	LOCK(&qpdb->slablock);
+	size = qpdb->sharedbytes;
+	UNLOCK(&qpdb->slablock);
+
+	return size;
+}
+
 static dns_dbmethods_t qpdb_cachemethods = {
 	.destroy = qpdb_destroy,
 	.findnode = findnode,
@@ -4386,6 +5485,7 @@ static dns_dbmethods_t qpdb_cachemethods = {
 	.detachnode = detachnode,
 	.createiterator = createiterator,
 	.findrdataset = findrdataset,
+	.findrdatasets = findrdatasets,
 	.allrdatasets = allrdatasets,
 	.addrdataset = addrdataset,
 	.deleterdataset = deleterdataset,
@@ -4401,10 +5501,22 @@ static dns_dbmethods_t qpdb_cachemethods = {
 	.unlocknode = unlocknode,
 	.expiredata = expiredata,
 	.deletedata = deletedata,
+	.getsharedsize = getsharedsize,
 	.setmaxrrperset = setmaxrrperset,
 	.setmaxtypepername = setmaxtypepername,
 };
 
+static void
+qpcnode_destroy_rcu(struct rcu_head *rcu_head) {
+	qpcnode_t *data = caa_container_of(rcu_head, qpcnode_t, rcu_head);
+
+	if (data->nsecrange != NULL) {
+		nsecrange_destroy(data->nsecrange);
+	}
+	dns_name_free(&data->name, data->mctx);
+	isc_mem_putanddetach(&data->mctx, data, sizeof(qpcnode_t));
+}
+
 static void
 qpcnode_destroy(qpcnode_t *data) {
 	dns_slabheader_t *current = NULL, *next = NULL;
@@ -4422,8 +5534,11 @@ qpcnode_destroy(qpcnode_t *data) {
 		dns_slabheader_destroy(&current);
 	}
 
-	dns_name_free(&data->name, data->mctx);
-	isc_mem_putanddetach(&data->mctx, data, sizeof(qpcnode_t));
+	/*
+	 * The lock-free readers may still be looking at the node, so its
+	 * name and memory are released after the RCU grace period.
+	 */
+	call_rcu(&data->rcu_head, qpcnode_destroy_rcu);
 }
 
 #ifdef DNS_DB_NODETRACE
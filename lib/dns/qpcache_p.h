@@ -20,6 +20,25 @@
 #include <dns/qp.h>
 #include <dns/types.h>
 
+/*%
+ * Passing this string after argv[0] to dns_db_create() creates the cache
+ * in the lock-free reads mode: exact-match lookups of active positive and
+ * negative entries are then answered under RCU protection, without taking
+ * the tree or the node locks.  Everything else, including all the writes,
+ * still uses the locks.
+ */
+#define DNS_QPCACHE_LOCKFREE "lockfree-reads"
+
+/*%
+ * Passing this string after argv[0] to dns_db_create() makes the cache
+ * evict its entries using SIEVE instead of LRU when it is over the memory
+ * limit: a cache hit then only marks the entry as visited, and a "hand"
+ * sweeping each list from the oldest entries evicts the first entries not
+ * visited since its last pass, so that a burst of entries used only once
+ * cannot push out the working set.
+ */
+#define DNS_QPCACHE_SIEVE "sieve"
+
 /*****
 ***** Module Info
 *****/
@@ -39,7 +58,8 @@ dns__qpcache_create(isc_mem_t *mctx, const dns_name_t *base, dns_dbtype_t type,
  *
  * If argv[0] is set, it points to a valid memory context to be used for
  * allocation of heap memory.  Generally this is used for cache databases
- * only.
+ * only.  The following arguments, if any, select the optional modes:
+ * DNS_QPCACHE_LOCKFREE and DNS_QPCACHE_SIEVE; NULL arguments are ignored.
  *
  * Requires:
  *
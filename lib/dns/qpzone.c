@@ -21,6 +21,8 @@
 #include <isc/async.h>
 #include <isc/atomic.h>
 #include <isc/file.h>
+#include <isc/hash.h>
+#include <isc/hashmap.h>
 #include <isc/heap.h>
 #include <isc/hex.h>
 #include <isc/log.h>
@@ -38,6 +40,7 @@
 #include <isc/time.h>
 #include <isc/urcu.h>
 #include <isc/util.h>
+#include <isc/work.h>
 
 #include <dns/callbacks.h>
 #include <dns/db.h>
@@ -147,6 +150,17 @@ struct qpz_version {
 
 typedef ISC_LIST(qpz_version_t) qpz_versionlist_t;
 
+/*%
+ * An rdataslab shared by the identical rdatasets loaded into the zone;
+ * see shareslab().
+ */
+typedef struct qpz_slab {
+	uint32_t hashval;
+	unsigned int references; /* Locked by slablock */
+	unsigned int size;
+	unsigned char raw[];
+} qpz_slab_t;
+
 struct qpznode {
 	dns_name_t name;
 	isc_mem_t *mctx;
@@ -179,17 +193,26 @@ struct qpzonedb {
 	uint32_t next_serial;
 	uint32_t maxrrperset;	 /* Maximum RRs per RRset */
 	uint32_t maxtypepername; /* Maximum number of RR types per owner */
+	bool shareslabs;	 /* Share identical slabs when loading */
 	qpz_version_t *current_version;
 	qpz_version_t *future_version;
 	qpz_versionlist_t open_versions;
 	isc_loop_t *loop;
 	struct rcu_head rcu_head;
 
+	/* Glue lists are being built in the background */
+	atomic_bool warming;
+
 	isc_heap_t *heap; /* Resigning heap */
 
 	dns_qpmulti_t *tree;  /* Main QP trie for data storage */
 	dns_qpmulti_t *nsec;  /* NSEC nodes only */
 	dns_qpmulti_t *nsec3; /* NSEC3 nodes only */
+
+	/* Shared slabs, and the memory they saved */
+	isc_mutex_t slablock;
+	isc_hashmap_t *slabs;
+	uint64_t sharedbytes;
 };
 
 /*%
@@ -237,6 +260,9 @@ ISC_REFCOUNT_STATIC_TRACE_DECL(qpznode);
 ISC_REFCOUNT_STATIC_DECL(qpznode);
 #endif
 
+static void
+warmglue(qpzonedb_t *qpdb);
+
 /* QP trie methods */
 static void
 qp_attach(void *uctx, void *pval, uint32_t ival);
@@ -457,6 +483,12 @@ free_db_rcu(struct rcu_head *rcu_head) {
 		isc_stats_detach(&qpdb->gluecachestats);
 	}
 
+	if (qpdb->slabs != NULL) {
+		INSIST(isc_hashmap_count(qpdb->slabs) == 0);
+		isc_hashmap_destroy(&qpdb->slabs);
+	}
+	isc_mutex_destroy(&qpdb->slablock);
+
 	isc_mem_cput(qpdb->common.mctx, qpdb->node_locks, qpdb->node_lock_count,
 		     sizeof(db_nodelock_t));
 	isc_refcount_destroy(&qpdb->common.references);
@@ -633,6 +665,7 @@ dns__qpzone_create(isc_mem_t *mctx, const dns_name_t *origin, dns_dbtype_t type,
 	}
 
 	isc_rwlock_init(&qpdb->lock);
+	isc_mutex_init(&qpdb->slablock);
 
 	qpdb->node_locks = isc_mem_cget(mctx, qpdb->node_lock_count,
 					sizeof(db_nodelock_t));
@@ -664,6 +697,7 @@ dns__qpzone_create(isc_mem_t *mctx, const dns_name_t *origin, dns_dbtype_t type,
 	dns_qpmulti_create(mctx, &qpmethods, qpdb, &qpdb->tree);
 	dns_qpmulti_create(mctx, &qpmethods, qpdb, &qpdb->nsec);
 	dns_qpmulti_create(mctx, &qpmethods, qpdb, &qpdb->nsec3);
+	dns_qpmulti_sethugepages(qpdb->tree);
 
 	/*
 	 * Version initialization.
@@ -989,6 +1023,7 @@ bindrdataset(qpzonedb_t *qpdb, qpznode_t *node, dns_slabheader_t *header,
 
 	rdataset->slab.db = (dns_db_t *)qpdb;
 	rdataset->slab.node = (dns_dbnode_t *)node;
+	rdataset->slab.header = header;
 	rdataset->slab.raw = dns_slabheader_raw(header);
 	rdataset->slab.iter_pos = NULL;
 	rdataset->slab.iter_count = 0;
@@ -1315,19 +1350,89 @@ rollback_node(qpznode_t *node, uint32_t serial) {
 	}
 }
 
+/*
+ * Releasing the nodes changed by a large update (an AXFR/IXFR or a
+ * big dynamic update) frees every header the update made obsolete,
+ * which can take long enough to stall the caller of closeversion().
+ * On commit, only the first QPZ_CLEANUP_BATCH nodes are released
+ * there; the rest are released on the zone's loop, one batch at a
+ * time, so that other events on the loop get to run in between.
+ *
+ * A rollback is always done in full: the next writer reuses the
+ * serial number, so the rolled back headers have to be marked to be
+ * ignored before it starts.
+ */
+#define QPZ_CLEANUP_BATCH 1024
+
+typedef struct qpz_cleanup {
+	dns_db_t *db;
+	qpz_changedlist_t changed;
+	uint32_t least_serial;
+} qpz_cleanup_t;
+
+/*
+ * Release up to 'max' nodes from the head of 'list' (or all of them if
+ * 'max' is zero).
+ */
+static void
+release_changed(qpzonedb_t *qpdb, qpz_changedlist_t *list,
+		uint32_t least_serial, bool rollback, uint32_t serial,
+		size_t max DNS__DB_FLARG) {
+	qpz_changed_t *changed = NULL;
+	size_t count = 0;
+
+	while ((changed = HEAD(*list)) != NULL &&
+	       (max == 0 || count++ < max))
+	{
+		isc_rwlock_t *lock = NULL;
+		isc_rwlocktype_t nlocktype = isc_rwlocktype_none;
+		qpznode_t *node = changed->node;
+
+		ISC_LIST_UNLINK(*list, changed, link);
+		lock = &qpdb->node_locks[node->locknum].lock;
+
+		NODE_WRLOCK(lock, &nlocktype);
+		if (rollback) {
+			rollback_node(node, serial);
+		}
+		decref(qpdb, node, least_serial, &nlocktype DNS__DB_FLARG_PASS);
+
+		NODE_UNLOCK(lock, &nlocktype);
+
+		isc_mem_put(qpdb->common.mctx, changed, sizeof(*changed));
+	}
+}
+
+static void
+cleanup_cb(void *arg) {
+	qpz_cleanup_t *cleanup = arg;
+	dns_db_t *db = cleanup->db;
+	qpzonedb_t *qpdb = (qpzonedb_t *)db;
+
+	release_changed(qpdb, &cleanup->changed, cleanup->least_serial, false,
+			0, QPZ_CLEANUP_BATCH DNS__DB_FILELINE);
+
+	if (!EMPTY(cleanup->changed)) {
+		isc_async_run(qpdb->loop, cleanup_cb, cleanup);
+		return;
+	}
+
+	isc_mem_put(qpdb->common.mctx, cleanup, sizeof(*cleanup));
+	dns_db_detach(&db);
+}
+
 static void
 closeversion(dns_db_t *db, dns_dbversion_t **versionp,
 	     bool commit DNS__DB_FLARG) {
 	qpzonedb_t *qpdb = (qpzonedb_t *)db;
 	qpz_version_t *version = NULL, *cleanup_version = NULL;
 	qpz_version_t *least_greater = NULL;
-	qpznode_t *node = NULL;
 	bool rollback = false;
-	qpz_changed_t *changed = NULL, *next_changed = NULL;
 	qpz_changedlist_t cleanup_list;
 	dns_slabheaderlist_t resigned_list;
 	dns_slabheader_t *header = NULL;
 	uint32_t serial, least_serial;
+	bool committed = false;
 
 	REQUIRE(VALID_QPZONE(qpdb));
 	version = (qpz_version_t *)*versionp;
@@ -1428,6 +1533,7 @@ closeversion(dns_db_t *db, dns_dbversion_t **versionp,
 				link);
 			resigned_list = version->resigned_list;
 			ISC_LIST_INIT(version->resigned_list);
+			committed = true;
 		} else {
 			/*
 			 * We're rolling back this transaction.
@@ -1484,6 +1590,10 @@ closeversion(dns_db_t *db, dns_dbversion_t **versionp,
 	least_serial = qpdb->least_serial;
 	RWUNLOCK(&qpdb->lock, isc_rwlocktype_write);
 
+	if (committed) {
+		warmglue(qpdb);
+	}
+
 	if (cleanup_version != NULL) {
 		isc_refcount_destroy(&cleanup_version->references);
 		INSIST(EMPTY(cleanup_version->changed_list));
@@ -1520,25 +1630,24 @@ closeversion(dns_db_t *db, dns_dbversion_t **versionp,
 		return;
 	}
 
-	for (changed = HEAD(cleanup_list); changed != NULL;
-	     changed = next_changed)
-	{
-		isc_rwlock_t *lock = NULL;
-		isc_rwlocktype_t nlocktype = isc_rwlocktype_none;
-
-		next_changed = NEXT(changed, link);
-		node = changed->node;
-		lock = &qpdb->node_locks[node->locknum].lock;
-
-		NODE_WRLOCK(lock, &nlocktype);
-		if (rollback) {
-			rollback_node(node, serial);
-		}
-		decref(qpdb, node, least_serial, &nlocktype DNS__DB_FILELINE);
-
-		NODE_UNLOCK(lock, &nlocktype);
+	if (rollback || qpdb->loop == NULL) {
+		release_changed(qpdb, &cleanup_list, least_serial, rollback,
+				serial, 0 DNS__DB_FLARG_PASS);
+		*versionp = NULL;
+		return;
+	}
 
-		isc_mem_put(qpdb->common.mctx, changed, sizeof(*changed));
+	release_changed(qpdb, &cleanup_list, least_serial, false, 0,
+			QPZ_CLEANUP_BATCH DNS__DB_FLARG_PASS);
+	if (!EMPTY(cleanup_list)) {
+		qpz_cleanup_t *cleanup = isc_mem_get(qpdb->common.mctx,
+						     sizeof(*cleanup));
+		*cleanup = (qpz_cleanup_t){
+			.changed = cleanup_list,
+			.least_serial = least_serial,
+		};
+		dns_db_attach(db, &cleanup->db);
+		isc_async_run(qpdb->loop, cleanup_cb, cleanup);
 	}
 
 	*versionp = NULL;
@@ -1630,6 +1739,86 @@ findrdataset(dns_db_t *db, dns_dbnode_t *dbnode, dns_dbversion_t *dbversion,
 	return ISC_R_SUCCESS;
 }
 
+static void
+findrdatasets(dns_db_t *db, dns_dbnode_t *dbnode, dns_dbversion_t *dbversion,
+	      unsigned int count, const dns_rdatatype_t *types,
+	      isc_stdtime_t now ISC_ATTR_UNUSED, dns_rdataset_t **rdatasets,
+	      dns_rdataset_t **sigrdatasets,
+	      isc_result_t *results DNS__DB_FLARG) {
+	qpzonedb_t *qpdb = (qpzonedb_t *)db;
+	qpznode_t *node = (qpznode_t *)dbnode;
+	dns_slabheader_t *header = NULL, *header_next = NULL;
+	dns_slabheader_t *found[DNS_DB_MAXFINDTYPES] = { NULL };
+	dns_slabheader_t *foundsig[DNS_DB_MAXFINDTYPES] = { NULL };
+	uint32_t serial;
+	qpz_version_t *version = (qpz_version_t *)dbversion;
+	bool close_version = false;
+	isc_rwlocktype_t nlocktype = isc_rwlocktype_none;
+
+	REQUIRE(VALID_QPZONE(qpdb));
+	REQUIRE(count <= DNS_DB_MAXFINDTYPES);
+	INSIST(version == NULL || version->qpdb == qpdb);
+
+	if (version == NULL) {
+		currentversion(db, (dns_dbversion_t **)&version);
+		close_version = true;
+	}
+	serial = version->serial;
+
+	NODE_RDLOCK(&qpdb->node_locks[node->locknum].lock, &nlocktype);
+
+	/*
+	 * Walk the node once, picking out all the requested types and
+	 * their signatures.
+	 */
+	for (header = node->data; header != NULL; header = header_next) {
+		header_next = header->next;
+		do {
+			if (header->serial <= serial && !IGNORE(header)) {
+				if (NONEXISTENT(header)) {
+					header = NULL;
+				}
+				break;
+			} else {
+				header = header->down;
+			}
+		} while (header != NULL);
+		if (header == NULL) {
+			continue;
+		}
+		for (unsigned int i = 0; i < count; i++) {
+			if (header->type == DNS_TYPEPAIR_VALUE(types[i], 0)) {
+				found[i] = header;
+				break;
+			} else if (header->type == DNS_SIGTYPE(types[i])) {
+				foundsig[i] = header;
+				break;
+			}
+		}
+	}
+
+	for (unsigned int i = 0; i < count; i++) {
+		if (found[i] == NULL) {
+			results[i] = ISC_R_NOTFOUND;
+			continue;
+		}
+		bindrdataset(qpdb, node, found[i], 0,
+			     rdatasets[i] DNS__DB_FLARG_PASS);
+		if (foundsig[i] != NULL && sigrdatasets != NULL) {
+			bindrdataset(qpdb, node, foundsig[i], 0,
+				     sigrdatasets[i] DNS__DB_FLARG_PASS);
+		}
+		results[i] = ISC_R_SUCCESS;
+	}
+
+	NODE_UNLOCK(&qpdb->node_locks[node->locknum].lock, &nlocktype);
+
+	if (close_version) {
+		closeversion(db, (dns_dbversion_t **)&version,
+			     false DNS__DB_FLARG_PASS);
+	}
+}
+
 static bool
 delegating_type(qpzonedb_t *qpdb, qpznode_t *node, dns_typepair_t type) {
 	return type == dns_rdatatype_dname ||
@@ -1783,8 +1972,7 @@ add_changed(dns_slabheader_t *header, qpz_version_t *version DNS__DB_FLARG) {
 
 static uint64_t
 recordsize(dns_slabheader_t *header, unsigned int namelen) {
-	return dns_rdataslab_rdatasize((unsigned char *)header,
-				       sizeof(*header)) +
+	return dns_rdataslab_rdatasize(dns_slabheader_raw(header), 0) +
 	       sizeof(dns_ttl_t) + sizeof(dns_rdatatype_t) +
 	       sizeof(dns_rdataclass_t) + namelen;
 }
@@ -1792,8 +1980,7 @@ recordsize(dns_slabheader_t *header, unsigned int namelen) {
 static void
 maybe_update_recordsandsize(bool add, qpz_version_t *version,
 			    dns_slabheader_t *header, unsigned int namelen) {
-	unsigned char *hdr = (unsigned char *)header;
-	size_t hdrsize = sizeof(*header);
+	unsigned char *raw = dns_slabheader_raw(header);
 
 	if (NONEXISTENT(header)) {
 		return;
@@ -1801,15 +1988,120 @@ maybe_update_recordsandsize(bool add, qpz_version_t *version,
 
 	RWLOCK(&version->rwlock, isc_rwlocktype_write);
 	if (add) {
-		version->records += dns_rdataslab_count(hdr, hdrsize);
+		version->records += dns_rdataslab_count(raw, 0);
 		version->xfrsize += recordsize(header, namelen);
 	} else {
-		version->records -= dns_rdataslab_count(hdr, hdrsize);
+		version->records -= dns_rdataslab_count(raw, 0);
 		version->xfrsize -= recordsize(header, namelen);
 	}
 	RWUNLOCK(&version->rwlock, isc_rwlocktype_write);
 }
 
+static bool
+slab_match(void *node, const void *key) {
+	qpz_slab_t *slab = node;
+	unsigned char *raw = UNCONST(key);
+
+	return dns_rdataslab_size(raw, 0) == slab->size &&
+	       memcmp(slab->raw, raw, slab->size) == 0;
+}
+
+/*
+ * Replace the rdata of a header being loaded with a reference to an
+ * identical slab already loaded into the zone, or share it if it is
+ * the first of its kind.  The header is reallocated on its own.
+ */
+static dns_slabheader_t *
+shareslab(qpzonedb_t *qpdb, dns_slabheader_t *header, unsigned int size) {
+	isc_mem_t *mctx = qpdb->common.mctx;
+	unsigned char *raw = (unsigned char *)(header + 1);
+	unsigned int rawsize = size - sizeof(*header);
+	uint32_t hashval = isc_hash32(raw, rawsize, true);
+	qpz_slab_t *slab = NULL;
+	dns_slabheader_t *newheader = NULL;
+	isc_result_t result;
+
+	LOCK(&qpdb->slablock);
+	result = isc_hashmap_find(qpdb->slabs, hashval, slab_match, raw,
+				  (void **)&slab);
+	if (result == ISC_R_SUCCESS) {
+		slab->references++;
+		qpdb->sharedbytes += rawsize;
+	} else {
+		slab = isc_mem_get(mctx, STRUCT_FLEX_SIZE(slab, raw, rawsize));
+		*slab = (qpz_slab_t){
+			.hashval = hashval,
+			.references = 1,
+			.size = rawsize,
+		};
+		memmove(slab->raw, raw, rawsize);
+		result = isc_hashmap_add(qpdb->slabs, hashval, slab_match,
+					 slab->raw, slab, NULL);
+		INSIST(result == ISC_R_SUCCESS);
+	}
+	UNLOCK(&qpdb->slablock);
+
+	newheader = isc_mem_get(mctx, sizeof(*newheader));
+	memmove(newheader, header, sizeof(*newheader));
+	newheader->raw = slab->raw;
+	isc_mem_put(mctx, header, size);
+
+	return newheader;
+}
+
+static void
+unshareslab(qpzonedb_t *qpdb, dns_slabheader_t *header) {
+	qpz_slab_t *slab =
+		(qpz_slab_t *)(header->raw - offsetof(qpz_slab_t, raw));
+	isc_result_t result;
+
+	LOCK(&qpdb->slablock);
+	if (--slab->references > 0) {
+		qpdb->sharedbytes -= slab->size;
+		slab = NULL;
+	} else {
+		result = isc_hashmap_delete(qpdb->slabs, slab->hashval,
+					    slab_match, slab->raw);
+		INSIST(result == ISC_R_SUCCESS);
+	}
+	UNLOCK(&qpdb->slablock);
+
+	if (slab != NULL) {
+		isc_mem_put(qpdb->common.mctx, slab,
+			    STRUCT_FLEX_SIZE(slab, raw, slab->size));
+	}
+}
+
+/*
+ * dns_rdataslab_merge() and dns_rdataslab_subtract() expect the rdata
+ * to follow the header; make a contiguous copy of a shared header.
+ */
+static unsigned char *
+contiguousslab(qpzonedb_t *qpdb, dns_slabheader_t *header) {
+	unsigned char *slab = NULL;
+	unsigned int size;
+
+	if (header->raw == NULL) {
+		return (unsigned char *)header;
+	}
+
+	size = dns_rdataslab_size(header->raw, 0);
+	slab = isc_mem_get(qpdb->common.mctx, sizeof(*header) + size);
+	memmove(slab, header, sizeof(*header));
+	memmove(slab + sizeof(*header), header->raw, size);
+
+	return slab;
+}
+
+static void
+freecontiguousslab(qpzonedb_t *qpdb, dns_slabheader_t *header,
+		   unsigned char *slab) {
+	if (slab != (unsigned char *)header) {
+		isc_mem_put(qpdb->common.mctx, slab,
+			    dns_rdataslab_size(slab, sizeof(*header)));
+	}
+}
+
 static isc_result_t
 add(qpzonedb_t *qpdb, qpznode_t *node, const dns_name_t *nodename,
     qpz_version_t *version, dns_slabheader_t *newheader, unsigned int options,
@@ -1884,13 +2176,18 @@ add(qpzonedb_t *qpdb, qpznode_t *node, const dns_name_t *nodename,
 				flags |= DNS_RDATASLAB_FORCE;
 			}
 			if (result == ISC_R_SUCCESS) {
+				unsigned char *oslab =
+					contiguousslab(qpdb, header);
+				unsigned char *nslab =
+					contiguousslab(qpdb, newheader);
 				result = dns_rdataslab_merge(
-					(unsigned char *)header,
-					(unsigned char *)newheader,
+					oslab, nslab,
 					(unsigned int)(sizeof(*newheader)),
 					qpdb->common.mctx, qpdb->common.rdclass,
 					(dns_rdatatype_t)header->type, flags,
 					qpdb->maxrrperset, &merged);
+				freecontiguousslab(qpdb, header, oslab);
+				freecontiguousslab(qpdb, newheader, nslab);
 			}
 			if (result == ISC_R_SUCCESS) {
 				/*
@@ -2177,6 +2474,16 @@ loading_addrdataset(void *arg, const dns_name_t *name,
 	dns_slabheader_reset(newheader, (dns_db_t *)qpdb, (dns_dbnode_t *)node);
 	dns_slabheader_setownercase(newheader, name);
 
+	/*
+	 * The DNSSEC records and the SOA are unique to their owner name,
+	 * so they're not worth looking up.
+	 */
+	if (qpdb->shareslabs && !dns_rdatatype_isdnssec(rdataset->type) &&
+	    rdataset->type != dns_rdatatype_soa)
+	{
+		newheader = shareslab(qpdb, newheader, region.length);
+	}
+
 	if ((rdataset->attributes & DNS_RDATASETATTR_RESIGN) != 0) {
 		DNS_SLABHEADER_SETATTR(newheader, DNS_SLABHEADERATTR_RESIGN);
 		newheader->resign =
@@ -2292,6 +2599,8 @@ endload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
 
 	isc_mem_put(qpdb->common.mctx, loadctx, sizeof(*loadctx));
 
+	warmglue(qpdb);
+
 	return ISC_R_SUCCESS;
 }
 
@@ -2578,7 +2887,7 @@ matchparams(dns_slabheader_t *header, qpz_search_t *search) {
 
 	REQUIRE(header->type == dns_rdatatype_nsec3);
 
-	raw = (unsigned char *)header + sizeof(*header);
+	raw = dns_slabheader_raw(header);
 	count = raw[0] * 256 + raw[1]; /* count */
 	raw += DNS_RDATASET_COUNT + DNS_RDATASET_LENGTH;
 
@@ -4030,6 +4339,10 @@ deletedata(dns_db_t *db ISC_ATTR_UNUSED, dns_dbnode_t *node ISC_ATTR_UNUSED,
 		RWUNLOCK(&qpdb->lock, isc_rwlocktype_write);
 	}
 	header->heap_index = 0;
+
+	if (header->raw != NULL) {
+		unshareslab(qpdb, header);
+	}
 }
 
 /*
@@ -4841,13 +5154,14 @@ subtractrdataset(dns_db_t *db, dns_dbnode_t *dbnode, dns_dbversion_t *dbversion,
 			}
 		}
 		if (result == ISC_R_SUCCESS) {
+			unsigned char *mslab = contiguousslab(qpdb, header);
 			result = dns_rdataslab_subtract(
-				(unsigned char *)header,
-				(unsigned char *)newheader,
+				mslab, (unsigned char *)newheader,
 				(unsigned int)(sizeof(*newheader)),
 				qpdb->common.mctx, qpdb->common.rdclass,
 				(dns_rdatatype_t)header->type, flags,
 				&subresult);
+			freecontiguousslab(qpdb, header, mslab);
 		}
 		if (result == ISC_R_SUCCESS) {
 			dns_slabheader_destroy(&newheader);
@@ -5255,22 +5569,16 @@ create_gluelist(qpzonedb_t *qpdb, qpz_version_t *version, qpznode_t *node,
 	return gluelist;
 }
 
-static void
-addglue(dns_db_t *db, dns_dbversion_t *dbversion, dns_rdataset_t *rdataset,
-	dns_message_t *msg) {
-	qpzonedb_t *qpdb = (qpzonedb_t *)db;
-	qpz_version_t *version = (qpz_version_t *)dbversion;
-	qpznode_t *node = (qpznode_t *)rdataset->slab.node;
+/*
+ * Find the glue list for the NS 'rdataset' at 'node' in 'version',
+ * creating it if necessary. Must be called in an RCU read-side critical
+ * section, which the glue list is valid for.
+ */
+static dns_gluelist_t *
+getgluelist(qpzonedb_t *qpdb, qpz_version_t *version, qpznode_t *node,
+	    dns_rdataset_t *rdataset) {
+	dns_dbversion_t *dbversion = (dns_dbversion_t *)version;
 	dns_slabheader_t *header = dns_slabheader_fromrdataset(rdataset);
-	dns_glue_t *glue = NULL;
-	isc_statscounter_t counter = dns_gluecachestatscounter_hits_absent;
-
-	REQUIRE(rdataset->type == dns_rdatatype_ns);
-	REQUIRE(qpdb == (qpzonedb_t *)rdataset->slab.db);
-	REQUIRE(qpdb == version->qpdb);
-	REQUIRE(!IS_STUB(qpdb));
-
-	rcu_read_lock();
 
 	dns_gluelist_t *gluelist = rcu_dereference(header->gluelist);
 	if (gluelist == NULL || gluelist->version != dbversion) {
@@ -5301,6 +5609,26 @@ addglue(dns_db_t *db, dns_dbversion_t *dbversion, dns_rdataset_t *rdataset,
 		}
 	}
 
+	return gluelist;
+}
+
+static void
+addglue(dns_db_t *db, dns_dbversion_t *dbversion, dns_rdataset_t *rdataset,
+	dns_message_t *msg) {
+	qpzonedb_t *qpdb = (qpzonedb_t *)db;
+	qpz_version_t *version = (qpz_version_t *)dbversion;
+	qpznode_t *node = (qpznode_t *)rdataset->slab.node;
+	dns_glue_t *glue = NULL;
+	isc_statscounter_t counter = dns_gluecachestatscounter_hits_absent;
+
+	REQUIRE(rdataset->type == dns_rdatatype_ns);
+	REQUIRE(qpdb == (qpzonedb_t *)rdataset->slab.db);
+	REQUIRE(qpdb == version->qpdb);
+	REQUIRE(!IS_STUB(qpdb));
+
+	rcu_read_lock();
+
+	dns_gluelist_t *gluelist = getgluelist(qpdb, version, node, rdataset);
 	glue = CMM_LOAD_SHARED(gluelist->glue);
 
 	if (glue != NULL) {
@@ -5316,6 +5644,124 @@ addglue(dns_db_t *db, dns_dbversion_t *dbversion, dns_rdataset_t *rdataset,
 	}
 }
 
+/*
+ * Glue lists belong to a version of the zone, so after each change to a
+ * zone with many delegations, the first referrals to each of them would
+ * pay for the same lookups all over again. Instead, when a version
+ * becomes current, its glue lists are built in the background ahead of
+ * the queries that need them.
+ *
+ * Only one walk runs at a time. A walk gives up when its version has
+ * been superseded, and a new one starts for the latest version.
+ */
+#define WARMGLUE_CHECK 1024
+
+typedef struct qpz_warmglue {
+	dns_db_t *db;
+	dns_dbversion_t *version;
+} qpz_warmglue_t;
+
+static bool
+superseded(qpzonedb_t *qpdb, dns_dbversion_t *version) {
+	bool result;
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_read);
+	result = (dns_dbversion_t *)qpdb->current_version != version;
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_read);
+
+	return result;
+}
+
+static void
+warmglue_cb(void *arg) {
+	qpz_warmglue_t *warm = arg;
+	qpzonedb_t *qpdb = (qpzonedb_t *)warm->db;
+	qpz_version_t *version = (qpz_version_t *)warm->version;
+	dns_dbiterator_t *dbiter = NULL;
+	isc_result_t result;
+	unsigned int count = 0;
+
+	result = createiterator(warm->db, DNS_DB_NONSEC3, &dbiter);
+	if (result != ISC_R_SUCCESS) {
+		return;
+	}
+
+	for (result = dns_dbiterator_first(dbiter); result == ISC_R_SUCCESS;
+	     result = dns_dbiterator_next(dbiter))
+	{
+		dns_dbnode_t *node = NULL;
+		qpznode_t *qpnode = NULL;
+		dns_rdataset_t rdataset;
+
+		if (++count % WARMGLUE_CHECK == 0 &&
+		    superseded(qpdb, warm->version))
+		{
+			break;
+		}
+
+		result = dns_dbiterator_current(dbiter, &node, NULL);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+
+		qpnode = (qpznode_t *)node;
+		if (qpnode != qpdb->origin && atomic_load(&qpnode->delegating))
+		{
+			dns_rdataset_init(&rdataset);
+			result = findrdataset(warm->db, node, warm->version,
+					      dns_rdatatype_ns, 0, 0, &rdataset,
+					      NULL DNS__DB_FILELINE);
+			if (result == ISC_R_SUCCESS) {
+				rcu_read_lock();
+				(void)getgluelist(qpdb, version, qpnode,
+						  &rdataset);
+				rcu_read_unlock();
+				dns_rdataset_disassociate(&rdataset);
+			}
+		}
+
+		detachnode(warm->db, &node DNS__DB_FILELINE);
+	}
+
+	dns_dbiterator_destroy(&dbiter);
+}
+
+static void
+warmglue_done(void *arg) {
+	qpz_warmglue_t *warm = arg;
+	qpzonedb_t *qpdb = (qpzonedb_t *)warm->db;
+	bool again;
+
+	atomic_store(&qpdb->warming, false);
+	again = superseded(qpdb, warm->version);
+	if (again) {
+		warmglue(qpdb);
+	}
+
+	closeversion(warm->db, &warm->version, false DNS__DB_FILELINE);
+	dns_db_detach(&warm->db);
+	isc_mem_put(qpdb->common.mctx, warm, sizeof(*warm));
+}
+
+static void
+warmglue(qpzonedb_t *qpdb) {
+	qpz_warmglue_t *warm = NULL;
+
+	if (qpdb->loop == NULL || IS_STUB(qpdb) ||
+	    !atomic_compare_exchange_strong(&qpdb->warming, &(bool){ false },
+					    true))
+	{
+		return;
+	}
+
+	warm = isc_mem_get(qpdb->common.mctx, sizeof(*warm));
+	*warm = (qpz_warmglue_t){ 0 };
+	dns_db_attach((dns_db_t *)qpdb, &warm->db);
+	currentversion(warm->db, &warm->version);
+
+	isc_work_enqueue_bulk(qpdb->loop, warmglue_cb, warmglue_done, warm);
+}
+
 static void
 setmaxrrperset(dns_db_t *db, uint32_t value) {
 	qpzonedb_t *qpdb = (qpzonedb_t *)db;
@@ -5334,6 +5780,34 @@ setmaxtypepername(dns_db_t *db, uint32_t value) {
 	qpdb->maxtypepername = value;
 }
 
+static void
+setshareslabs(dns_db_t *db, bool value) {
+	qpzonedb_t *qpdb = (qpzonedb_t *)db;
+
+	REQUIRE(VALID_QPZONE(qpdb));
+
+	LOCK(&qpdb->slablock);
+	if (value && qpdb->slabs == NULL) {
+		isc_hashmap_create(qpdb->common.mctx, 8, &qpdb->slabs);
+	}
+	qpdb->shareslabs = value;
+	UNLOCK(&qpdb->slablock);
+}
+
+static uint64_t
+getsharedsize(dns_db_t *db) {
+	qpzonedb_t *qpdb = (qpzonedb_t *)db;
+	uint64_t size;
+
+	REQUIRE(VALID_QPZONE(qpdb));
+
+	LOCK(&qpdb->slablock);
+	size = qpdb->sharedbytes;
+	UNLOCK(&qpdb->slablock);
+
+	return size;
+}
+
 static dns_dbmethods_t qpdb_zonemethods = {
 	.destroy = qpdb_destroy,
 	.beginload = beginload,
@@ -5348,6 +5822,7 @@ static dns_dbmethods_t qpdb_zonemethods = {
 	.detachnode = detachnode,
 	.createiterator = createiterator,
 	.findrdataset = findrdataset,
+	.findrdatasets = findrdatasets,
 	.allrdatasets = allrdatasets,
 	.addrdataset = addrdataset,
 	.subtractrdataset = subtractrdataset,
@@ -5369,6 +5844,8 @@ static dns_dbmethods_t qpdb_zonemethods = {
 	.nodefullname = nodefullname,
 	.setmaxrrperset = setmaxrrperset,
 	.setmaxtypepername = setmaxtypepername,
+	.setshareslabs = setshareslabs,
+	.getsharedsize = getsharedsize,
 };
 
 static void
@@ -216,11 +216,6 @@ dns_rdataset_current(dns_rdataset_t *rdataset, dns_rdata_t *rdata) {
 #define WANT_RANDOM(r) (((r)->attributes & DNS_RDATASETATTR_RANDOMIZE) != 0)
 #define WANT_CYCLIC(r) (((r)->attributes & DNS_RDATASETATTR_CYCLIC) != 0)
 
-struct towire_sort {
-	int key;
-	dns_rdata_t *rdata;
-};
-
 static void
 swap_rdata(dns_rdata_t *in, unsigned int a, unsigned int b) {
 	dns_rdata_t rdata = in[a];
@@ -228,6 +223,95 @@ swap_rdata(dns_rdata_t *in, unsigned int a, unsigned int b) {
 	in[b] = rdata;
 }
 
+/*
+ * The types whose rdata contains no domain names, and is thus rendered
+ * exactly as it is stored: the length and the rdata can be copied
+ * without going through dns_rdata_towire().
+ */
+static bool
+towire_verbatim(const dns_rdataset_t *rdataset) {
+	switch (rdataset->type) {
+	case dns_rdatatype_a:
+		return rdataset->rdclass == dns_rdataclass_in;
+	case dns_rdatatype_aaaa:
+	case dns_rdatatype_txt:
+	case dns_rdatatype_ds:
+	case dns_rdatatype_sshfp:
+	case dns_rdatatype_dnskey:
+	case dns_rdatatype_tlsa:
+	case dns_rdatatype_caa:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/*
+ * Render the rdata of the common types that contain domain names
+ * directly, and leave the others to the dns_rdata_towire() dispatch.
+ * On failure 'target' is left as is; the caller rolls it back.
+ */
+static isc_result_t
+towire_rdata(dns_rdata_t *rdata, dns_compress_t *cctx, isc_buffer_t *target) {
+	isc_result_t result;
+	isc_region_t r;
+	dns_name_t name;
+	dns_offsets_t offsets;
+
+	if ((rdata->flags & DNS_RDATA_UPDATE) != 0) {
+		return dns_rdata_towire(rdata, cctx, target);
+	}
+
+	dns_rdata_toregion(rdata, &r);
+
+	switch (rdata->type) {
+	case dns_rdatatype_ns:
+	case dns_rdatatype_cname:
+		dns_compress_setpermitted(cctx, true);
+		break;
+	case dns_rdatatype_soa:
+		dns_compress_setpermitted(cctx, true);
+		dns_name_init(&name, offsets);
+		dns_name_fromregion(&name, &r);
+		isc_region_consume(&r, name.length);
+		result = dns_name_towire(&name, cctx, target, NULL);
+		if (result != ISC_R_SUCCESS) {
+			return result;
+		}
+		break;
+	case dns_rdatatype_rrsig:
+		/*
+		 * The signer name is never compressed.
+		 */
+		dns_compress_setpermitted(cctx, false);
+		if (isc_buffer_availablelength(target) < 18) {
+			return ISC_R_NOSPACE;
+		}
+		isc_buffer_putmem(target, r.base, 18);
+		isc_region_consume(&r, 18);
+		break;
+	default:
+		return dns_rdata_towire(rdata, cctx, target);
+	}
+
+	dns_name_init(&name, offsets);
+	dns_name_fromregion(&name, &r);
+	isc_region_consume(&r, name.length);
+	result = dns_name_towire(&name, cctx, target, NULL);
+	if (result != ISC_R_SUCCESS) {
+		return result;
+	}
+
+	/*
+	 * What follows the last name is copied as is.
+	 */
+	if (isc_buffer_availablelength(target) < r.length) {
+		return ISC_R_NOSPACE;
+	}
+	isc_buffer_putmem(target, r.base, r.length);
+	return ISC_R_SUCCESS;
+}
+
 static isc_result_t
 towire(dns_rdataset_t *rdataset, const dns_name_t *owner_name,
        dns_compress_t *cctx, isc_buffer_t *target, bool partial,
@@ -240,14 +324,14 @@ towire(dns_rdataset_t *rdataset, const dns_name_t *owner_name,
 	unsigned int headlen;
 	bool question = false;
 	bool shuffle = false;
-	bool want_random, want_cyclic;
+	bool want_random, want_cyclic, verbatim;
 	dns_rdata_t in_fixed[MAX_SHUFFLE];
 	dns_rdata_t *in = in_fixed;
-	struct towire_sort out_fixed[MAX_SHUFFLE];
-	struct towire_sort *out = out_fixed;
+	unsigned int start = 0;
 	dns_fixedname_t fixed;
 	dns_name_t *name = NULL;
 	uint16_t offset;
+	unsigned char *raw = NULL;
 
 	/*
 	 * Convert 'rdataset' to wire format, compressing names as specified
@@ -261,6 +345,7 @@ towire(dns_rdataset_t *rdataset, const dns_name_t *owner_name,
 
 	want_random = WANT_RANDOM(rdataset);
 	want_cyclic = WANT_CYCLIC(rdataset);
+	verbatim = towire_verbatim(rdataset);
 
 	if ((rdataset->attributes & DNS_RDATASETATTR_QUESTION) != 0) {
 		question = true;
@@ -297,20 +382,16 @@ towire(dns_rdataset_t *rdataset, const dns_name_t *owner_name,
 		}
 	}
 
-	if (shuffle) {
-		if (count > MAX_SHUFFLE) {
-			in = isc_mem_cget(cctx->mctx, count, sizeof(*in));
-			out = isc_mem_cget(cctx->mctx, count, sizeof(*out));
-			if (in == NULL || out == NULL) {
-				shuffle = false;
-			}
-		}
+	if (shuffle && count > MAX_SHUFFLE) {
+		in = isc_mem_cget(cctx->mctx, count, sizeof(*in));
 	}
 
+	/*
+	 * The order is applied to the handles of the rdata, not to the
+	 * rdata itself: the random order is a permutation of the handles,
+	 * and the cyclic order only picks the handle to start from.
+	 */
 	if (shuffle) {
-		uint32_t seed = 0;
-		unsigned int j = 0;
-
 		/*
 		 * First we get handles to all of the rdata.
 		 */
@@ -328,25 +409,17 @@ towire(dns_rdataset_t *rdataset, const dns_name_t *owner_name,
 		INSIST(i == count);
 
 		if (want_random) {
-			seed = isc_random32();
+			uint32_t seed = isc_random32();
+
+			for (i = 0; i < count; i++) {
+				swap_rdata(in, i, i + seed % (count - i));
+			}
 		}
 
 		if (want_cyclic &&
 		    (rdataset->count != DNS_RDATASET_COUNT_UNDEFINED))
 		{
-			j = rdataset->count % count;
-		}
-
-		for (i = 0; i < count; i++) {
-			if (want_random) {
-				swap_rdata(in, j, j + seed % (count - j));
-			}
-
-			out[i].key = 0;
-			out[i].rdata = &in[j];
-			if (++j == count) {
-				j = 0;
-			}
+			start = rdataset->count % count;
 		}
 	}
 
@@ -354,6 +427,19 @@ towire(dns_rdataset_t *rdataset, const dns_name_t *owner_name,
 	i = 0;
 	added = 0;
 
+	/*
+	 * Records of a name-free type that go out in the stored order are
+	 * streamed straight out of the slab.
+	 */
+	if (verbatim && !shuffle && !question &&
+	    rdataset->methods->getraw != NULL)
+	{
+		raw = (rdataset->methods->getraw)(rdataset);
+		if (raw != NULL) {
+			raw += 2;
+		}
+	}
+
 	name = dns_fixedname_initname(&fixed);
 	dns_name_copy(owner_name, name);
 	dns_rdataset_getownercase(rdataset, name);
@@ -384,39 +470,70 @@ towire(dns_rdataset_t *rdataset, const dns_name_t *owner_name,
 		}
 		isc_buffer_putuint16(target, rdataset->type);
 		isc_buffer_putuint16(target, rdataset->rdclass);
-		if (!question) {
-			dns_rdata_t rdata = DNS_RDATA_INIT;
+		if (!question && raw != NULL) {
+			unsigned int length = (raw[0] << 8) | raw[1];
 
 			isc_buffer_putuint32(target, rdataset->ttl);
 
 			/*
-			 * Save space for rdlen.
+			 * The rdlen and the rdata, as stored in the slab.
 			 */
-			rdlen = *target;
-			isc_buffer_add(target, 2);
+			if (isc_buffer_availablelength(target) < 2 + length) {
+				result = ISC_R_NOSPACE;
+				goto rollback;
+			}
+			isc_buffer_putmem(target, raw, 2 + length);
+			raw += 2 + length;
+			added++;
+		} else if (!question) {
+			dns_rdata_t rdata = DNS_RDATA_INIT;
+
+			isc_buffer_putuint32(target, rdataset->ttl);
 
-			/*
-			 * Copy out the rdata
-			 */
 			if (shuffle) {
-				rdata = *(out[i].rdata);
+				rdata = in[(start + i) % count];
 			} else {
 				dns_rdata_reset(&rdata);
 				dns_rdataset_current(rdataset, &rdata);
 			}
-			result = dns_rdata_towire(&rdata, cctx, target);
-			if (result != ISC_R_SUCCESS) {
-				goto rollback;
+
+			if (verbatim) {
+				/*
+				 * Copy out the rdlen and the rdata as is.
+				 */
+				if (isc_buffer_availablelength(target) <
+				    2 + rdata.length)
+				{
+					result = ISC_R_NOSPACE;
+					goto rollback;
+				}
+				isc_buffer_putuint16(target, rdata.length);
+				isc_buffer_putmem(target, rdata.data,
+						  rdata.length);
+			} else {
+				/*
+				 * Save space for rdlen.
+				 */
+				rdlen = *target;
+				isc_buffer_add(target, 2);
+
+				/*
+				 * Copy out the rdata
+				 */
+				result = towire_rdata(&rdata, cctx, target);
+				if (result != ISC_R_SUCCESS) {
+					goto rollback;
+				}
+				INSIST((target->used >= rdlen.used + 2) &&
+				       (target->used - rdlen.used - 2 < 65536));
+				isc_buffer_putuint16(
+					&rdlen, (uint16_t)(target->used -
+							   rdlen.used - 2));
 			}
-			INSIST((target->used >= rdlen.used + 2) &&
-			       (target->used - rdlen.used - 2 < 65536));
-			isc_buffer_putuint16(
-				&rdlen,
-				(uint16_t)(target->used - rdlen.used - 2));
 			added++;
 		}
 
-		if (shuffle) {
+		if (shuffle || raw != NULL) {
 			i++;
 			if (i == count) {
 				result = ISC_R_NOMORE;
@@ -449,10 +566,7 @@ rollback:
 	*target = savedbuffer;
 
 cleanup:
-	if (out != NULL && out != out_fixed) {
-		isc_mem_cput(cctx->mctx, out, count, sizeof(*out));
-	}
-	if (in != NULL && in != in_fixed) {
+	if (in != in_fixed) {
 		isc_mem_cput(cctx->mctx, in, count, sizeof(*in));
 	}
 	return result;
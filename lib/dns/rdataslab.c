@@ -19,6 +19,7 @@
 
 #include <isc/ascii.h>
 #include <isc/mem.h>
+#include <isc/os.h>
 #include <isc/region.h>
 #include <isc/result.h>
 #include <isc/string.h>
@@ -83,6 +84,8 @@ static isc_result_t
 rdataset_next(dns_rdataset_t *rdataset);
 static void
 rdataset_current(dns_rdataset_t *rdataset, dns_rdata_t *rdata);
+static unsigned char *
+rdataset_getraw(dns_rdataset_t *rdataset);
 static void
 rdataset_clone(dns_rdataset_t *source, dns_rdataset_t *target DNS__DB_FLARG);
 static unsigned int
@@ -776,12 +779,14 @@ dns_rdataslab_equalx(unsigned char *slab1, unsigned char *slab2,
 
 dns_slabheader_t *
 dns_slabheader_fromrdataset(const dns_rdataset_t *rdataset) {
-	dns_slabheader_t *header = (dns_slabheader_t *)rdataset->slab.raw;
-	return header - 1;
+	return rdataset->slab.header;
 }
 
 void *
 dns_slabheader_raw(dns_slabheader_t *header) {
+	if (header->raw != NULL) {
+		return header->raw;
+	}
 	return header + 1;
 }
 
@@ -827,13 +832,19 @@ dns_slabheader_reset(dns_slabheader_t *h, dns_db_t *db, dns_dbnode_t *node) {
 	h->heap = NULL;
 	h->db = db;
 	h->node = node;
+	h->raw = NULL;
 
 	atomic_init(&h->attributes, 0);
 	atomic_init(&h->last_refresh_fail_ts, 0);
+	atomic_init(&h->hits, 0);
 
 	STATIC_ASSERT((sizeof(h->attributes) == 2),
 		      "The .attributes field of dns_slabheader_t needs to be "
 		      "16-bit int type exactly.");
+	STATIC_ASSERT(offsetof(dns_slabheader_t, raw) + sizeof(h->raw) <=
+			      ISC_OS_CACHELINE_SIZE,
+		      "The fields of dns_slabheader_t used by the lookups "
+		      "need to fit in the first cache line.");
 }
 
 dns_slabheader_t *
@@ -857,15 +868,15 @@ dns_slabheader_destroy(dns_slabheader_t **headerp) {
 
 	isc_mem_t *mctx = header->db->mctx;
 
-	dns_db_deletedata(header->db, header->node, header);
-
-	if (NONEXISTENT(header)) {
+	if (NONEXISTENT(header) || header->raw != NULL) {
 		size = sizeof(*header);
 	} else {
 		size = dns_rdataslab_size((unsigned char *)header,
 					  sizeof(*header));
 	}
 
+	dns_db_deletedata(header->db, header->node, header);
+
 	isc_mem_put(mctx, header, size);
 }
 
@@ -900,6 +911,7 @@ dns_rdatasetmethods_t dns_rdataslab_rdatasetmethods = {
 	.clearprefetch = rdataset_clearprefetch,
 	.setownercase = rdataset_setownercase,
 	.getownercase = rdataset_getownercase,
+	.getraw = rdataset_getraw,
 };
 
 /* Fixed RRSet helper macros */
@@ -988,6 +1000,17 @@ rdataset_current(dns_rdataset_t *rdataset, dns_rdata_t *rdata) {
 	rdata->flags |= flags;
 }
 
+static unsigned char *
+rdataset_getraw(dns_rdataset_t *rdataset) {
+	/*
+	 * RRSIG records have an extra byte for the offline flag.
+	 */
+	if (rdataset->type == dns_rdatatype_rrsig) {
+		return NULL;
+	}
+	return rdataset->slab.raw;
+}
+
 static void
 rdataset_clone(dns_rdataset_t *source, dns_rdataset_t *target DNS__DB_FLARG) {
 	dns_db_t *db = source->slab.db;
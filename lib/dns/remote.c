@@ -370,3 +370,19 @@ dns_remote_mark(dns_remote_t *remote, bool good) {
 
 	remote->ok[remote->curraddr] = good;
 }
+
+void
+dns_remote_markaddr(dns_remote_t *remote, unsigned int i, bool good) {
+	REQUIRE(DNS_REMOTE_VALID(remote));
+	REQUIRE(i < remote->addrcnt);
+
+	remote->ok[i] = good;
+}
+
+void
+dns_remote_select(dns_remote_t *remote, unsigned int i) {
+	REQUIRE(DNS_REMOTE_VALID(remote));
+	REQUIRE(i < remote->addrcnt);
+
+	remote->curraddr = i;
+}
@@ -27,6 +27,7 @@
 #include <isc/loop.h>
 #include <isc/mutex.h>
 #include <isc/random.h>
+#include <isc/ratelimiter.h>
 #include <isc/refcount.h>
 #include <isc/result.h>
 #include <isc/rwlock.h>
@@ -36,6 +37,7 @@
 #include <isc/tid.h>
 #include <isc/time.h>
 #include <isc/timer.h>
+#include <isc/urcu.h>
 #include <isc/util.h>
 
 #include <dns/acl.h>
@@ -71,6 +73,8 @@
 #include <dns/validator.h>
 #include <dns/zone.h>
 
+#include "probes.h"
+
 #ifdef WANT_QUERYTRACE
 #define RTRACE(m)                                                       \
 	isc_log_write(DNS_LOGCATEGORY_RESOLVER, DNS_LOGMODULE_RESOLVER, \
@@ -163,6 +167,20 @@
 #define MAX_SINGLE_QUERY_TIMEOUT    9000U
 #define MAX_SINGLE_QUERY_TIMEOUT_US (MAX_SINGLE_QUERY_TIMEOUT * US_PER_MS)
 
+/*
+ * The minimum time we wait for a UDP response before sending a hedged
+ * query to another server.
+ */
+#define HEDGE_MIN_DELAY_US (100 * US_PER_MS)
+
+/*
+ * Popular RRsets are refreshed this many seconds before they expire.
+ * RRsets with less than REFRESH_MIN_TTL seconds left are not scheduled;
+ * they are left to "prefetch".
+ */
+#define REFRESH_LEAD	10U
+#define REFRESH_MIN_TTL (3 * REFRESH_LEAD)
+
 /*
  * The default maximum number of validations and validation failures per-fetch
  */
@@ -234,6 +252,9 @@ STATIC_ASSERT(NS_PROCESSING_LIMIT > NS_RR_LIMIT,
 #define RES_DOMAIN_HASH_BITS 12
 #endif /* ifndef RES_DOMAIN_HASH_BITS */
 
+#define RES_FCTXS_INIT_SIZE (1 << RES_DOMAIN_HASH_BITS) /* power of 2 */
+#define RES_FCTXS_MIN_SIZE  (1 << 8)			/* power of 2 */
+
 /*%
  * Maximum EDNS0 input packet size.
  */
@@ -292,9 +313,11 @@ struct tried {
 #define VALID_QUERY(query) ISC_MAGIC_VALID(query, QUERY_MAGIC)
 
 #define RESQUERY_ATTR_CANCELED 0x02
+#define RESQUERY_ATTR_HEDGE    0x04
 
 #define RESQUERY_CONNECTING(q) ((q)->connects > 0)
 #define RESQUERY_CANCELED(q)   (((q)->attributes & RESQUERY_ATTR_CANCELED) != 0)
+#define RESQUERY_HEDGE(q)      (((q)->attributes & RESQUERY_ATTR_HEDGE) != 0)
 #define RESQUERY_SENDING(q)    ((q)->sends > 0)
 
 typedef enum {
@@ -312,6 +335,28 @@ typedef enum {
 #define FCTXCOUNT_MAGIC		 ISC_MAGIC('F', 'C', 'n', 't')
 #define VALID_FCTXCOUNT(counter) ISC_MAGIC_VALID(counter, FCTXCOUNT_MAGIC)
 
+/*
+ * Random subdomain attack detection for fetches-per-zone.  Over each
+ * window of FCOUNT_WINDOW seconds, the names fetched in a zone are hashed
+ * into a sketch of FCOUNT_SKETCH_BITS bits, and the NXDOMAIN results of
+ * the fetches are counted.  A zone for which at least FCOUNT_ATTACK_BITS
+ * bits got set (about 350 different names) and at least
+ * FCOUNT_ATTACK_NXPCT percent of at least FCOUNT_ATTACK_MINDONE fetches
+ * ended in NXDOMAIN is considered attacked for FCOUNT_ATTACK_HOLD
+ * seconds.  In the meantime its fetch limit is divided by
+ * FCOUNT_ATTACK_SHED, and its negative answers are cached for at most
+ * FCOUNT_ATTACK_NCACHETTL seconds, so that they don't push the useful
+ * data out of the cache.
+ */
+#define FCOUNT_WINDOW		10
+#define FCOUNT_SKETCH_BITS	256
+#define FCOUNT_ATTACK_BITS	192
+#define FCOUNT_ATTACK_MINDONE	64
+#define FCOUNT_ATTACK_NXPCT	80
+#define FCOUNT_ATTACK_HOLD	60
+#define FCOUNT_ATTACK_SHED	4
+#define FCOUNT_ATTACK_NCACHETTL 5
+
 typedef struct fctxcount fctxcount_t;
 struct fctxcount {
 	unsigned int magic;
@@ -323,6 +368,14 @@ struct fctxcount {
 	uint_fast32_t allowed;
 	uint_fast32_t dropped;
 	isc_stdtime_t logged;
+
+	/* Random subdomain attack detection */
+	isc_stdtime_t window;
+	uint64_t sketch[FCOUNT_SKETCH_BITS / 64];
+	uint_fast32_t sketched;
+	uint_fast32_t done;
+	uint_fast32_t nxdomain;
+	isc_stdtime_t attacked;
 };
 
 struct fetchctx {
@@ -350,7 +403,10 @@ struct fetchctx {
 	bool hashed;
 	bool cloned;
 	bool spilled;
+	bool nxdomain; /*%< the answer is a cached NXDOMAIN */
 	ISC_LINK(struct fetchctx) link;
+	struct cds_lfht_node ht_node;
+	struct rcu_head rcu_head;
 	ISC_LIST(dns_fetchresponse_t) resps;
 	dns_edelist_t edelist;
 
@@ -360,6 +416,7 @@ struct fetchctx {
 	dns_rdataset_t nameservers;
 	atomic_uint_fast32_t attributes;
 	isc_timer_t *timer;
+	isc_timer_t *hedgetimer;
 	isc_time_t expires;
 	isc_time_t next_timeout;
 	isc_interval_t interval;
@@ -383,6 +440,8 @@ struct fetchctx {
 	isc_sockaddrlist_t bad_edns;
 	dns_validator_t *validator;
 	ISC_LIST(dns_validator_t) validators;
+	ISC_LIST(struct fetchctx) followers; /*%< see fctx_follow() */
+	ISC_LINK(struct fetchctx) flink;
 	dns_db_t *cache;
 	dns_adb_t *adb;
 	bool ns_ttl_ok;
@@ -513,7 +572,6 @@ typedef struct {
 
 struct dns_fetch {
 	unsigned int magic;
-	isc_mem_t *mctx;
 	dns_resolver_t *res;
 	fetchctx_t *private;
 };
@@ -533,6 +591,37 @@ typedef struct alternate {
 	ISC_LINK(struct alternate) link;
 } alternate_t;
 
+/*%
+ * A scheduled refresh of a popular RRset.  These are only ever touched
+ * on the main loop.
+ */
+typedef struct refresh refresh_t;
+struct refresh {
+	dns_resolver_t *res;
+	dns_fixedname_t fname;
+	dns_name_t *name;
+	dns_rdatatype_t type;
+	dns_ttl_t delay;
+	isc_timer_t *timer;
+	isc_rlevent_t *rlevent;
+	dns_fetch_t *fetch;
+	dns_rdataset_t rdataset;
+	ISC_LINK(refresh_t) link;
+};
+
+/*%
+ * Response messages kept for reuse by the next queries sent from the
+ * same loop, so that their memory blocks and scratch buffers are not
+ * freed and allocated again for every query.  Only touched on the loop
+ * they belong to.
+ */
+#define MSGCACHE_SIZE 64
+
+typedef struct msgcache {
+	unsigned int count;
+	dns_message_t *messages[MSGCACHE_SIZE];
+} msgcache_t;
+
 struct dns_resolver {
 	/* Unlocked. */
 	unsigned int magic;
@@ -549,8 +638,7 @@ struct dns_resolver {
 	dns_dispatchset_t *dispatches4;
 	dns_dispatchset_t *dispatches6;
 
-	isc_hashmap_t *fctxs;
-	isc_rwlock_t fctxs_lock;
+	struct cds_lfht *fctxs;
 
 	isc_hashmap_t *counters;
 	isc_rwlock_t counters_lock;
@@ -563,6 +651,7 @@ struct dns_resolver {
 	unsigned int spillatmin;
 	isc_timer_t *spillattimer;
 	bool zero_no_soa_ttl;
+	bool hedging;
 	unsigned int query_timeout;
 	unsigned int maxdepth;
 	unsigned int maxqueries;
@@ -589,6 +678,12 @@ struct dns_resolver {
 	/* Locked by primelock. */
 	dns_fetch_t *primefetch;
 
+	/* Refresh of popular RRsets; used on the main loop only. */
+	unsigned int refreshlimit;
+	unsigned int nrefreshes;
+	isc_ratelimiter_t *refreshrl;
+	ISC_LIST(refresh_t) refreshes;
+
 	/* Atomic. */
 	atomic_uint_fast32_t nfctx;
 
@@ -596,6 +691,11 @@ struct dns_resolver {
 
 	isc_mempool_t **namepools;
 	isc_mempool_t **rdspools;
+	msgcache_t *msgcaches;
+
+	/* Shared by the loops */
+	isc_mempool_t *fetchpool;
+	isc_mempool_t *querypool;
 };
 
 #define RES_MAGIC	    ISC_MAGIC('R', 'e', 's', '!')
@@ -645,6 +745,9 @@ resquery_send(resquery_t *query);
 static void
 resquery_response(isc_result_t eresult, isc_region_t *region, void *arg);
 static void
+resquery_response_process(isc_result_t eresult, isc_region_t *region,
+			  void *arg);
+static void
 resquery_response_continue(void *arg, isc_result_t result);
 static void
 resquery_connected(isc_result_t eresult, isc_region_t *region, void *arg);
@@ -653,6 +756,12 @@ fctx_try(fetchctx_t *fctx, bool retrying);
 static void
 fctx_shutdown(void *arg);
 static void
+fctx_releasefollowers(fetchctx_t *fctx);
+static uint32_t
+fctx_hash(fetchctx_t *fctx);
+static int
+fctx_match(struct cds_lfht_node *ht_node, const void *key);
+static void
 fctx_minimize_qname(fetchctx_t *fctx);
 static void
 fctx_destroy(fetchctx_t *fctx);
@@ -664,6 +773,8 @@ ncache_adderesult(dns_message_t *message, dns_db_t *cache, dns_dbnode_t *node,
 static void
 validated(void *arg);
 static void
+validated_process(void *arg);
+static void
 maybe_cancel_validators(fetchctx_t *fctx);
 static void
 add_bad(fetchctx_t *fctx, dns_message_t *rmessage, dns_adbaddrinfo_t *addrinfo,
@@ -942,6 +1053,60 @@ inc_stats(dns_resolver_t *res, isc_statscounter_t counter) {
 	}
 }
 
+/*%
+ * Charge the CPU time the thread has used since 'start' to the
+ * resolver statistics.
+ */
+static void
+add_cputime(dns_resolver_t *res, isc_nanosecs_t start) {
+	if (res->stats != NULL) {
+		isc_stats_add(res->stats, dns_resstatscounter_resolvercpu,
+			      isc_time_threadcpu() - start);
+	}
+}
+
+/*%
+ * Get a message to parse a response into, reusing one from the loop's
+ * message cache if there is one.
+ */
+static dns_message_t *
+getrmessage(fetchctx_t *fctx) {
+	dns_resolver_t *res = fctx->res;
+	msgcache_t *cache = &res->msgcaches[fctx->tid];
+	dns_message_t *message = NULL;
+
+	if (fctx->tid == isc_tid() && cache->count > 0) {
+		return cache->messages[--cache->count];
+	}
+
+	inc_stats(res, dns_resstatscounter_msgalloc);
+	dns_message_create(fctx->mctx, res->namepools[fctx->tid],
+			   res->rdspools[fctx->tid], DNS_MESSAGE_INTENTPARSE,
+			   &message);
+	return message;
+}
+
+/*%
+ * Return a response message to the loop's message cache, unless
+ * something else still holds a reference to it.
+ */
+static void
+putrmessage(fetchctx_t *fctx, dns_message_t **messagep) {
+	msgcache_t *cache = &fctx->res->msgcaches[fctx->tid];
+	dns_message_t *message = *messagep;
+
+	if (fctx->tid == isc_tid() && cache->count < MSGCACHE_SIZE &&
+	    isc_refcount_current(&message->references) == 1)
+	{
+		*messagep = NULL;
+		dns_message_reset(message, DNS_MESSAGE_INTENTPARSE);
+		cache->messages[cache->count++] = message;
+		return;
+	}
+
+	dns_message_detach(messagep);
+}
+
 static void
 dec_stats(dns_resolver_t *res, isc_statscounter_t counter) {
 	if (res->stats != NULL) {
@@ -1022,10 +1187,10 @@ resquery_destroy(resquery_t *query) {
 	UNLOCK(&fctx->lock);
 
 	if (query->rmessage != NULL) {
-		dns_message_detach(&query->rmessage);
+		putrmessage(fctx, &query->rmessage);
 	}
 
-	isc_mem_put(fctx->mctx, query, sizeof(*query));
+	isc_mempool_put(fctx->res->querypool, query);
 
 	fetchctx_detach(&fctx);
 }
@@ -1408,6 +1573,115 @@ fcount_logspill(fetchctx_t *fctx, fctxcount_t *counter, bool final) {
 	counter->logged = now;
 }
 
+/*
+ * Close the detection window of 'counter' if it is over, and decide
+ * whether the zone is under a random subdomain attack.  The counter must
+ * be locked.
+ */
+static void
+fcount_detect(fctxcount_t *counter, isc_stdtime_t now) {
+	char dbuf[DNS_NAME_FORMATSIZE];
+	bool attack;
+
+	if (counter->window == 0) {
+		counter->window = now;
+	}
+	if (now - counter->window < FCOUNT_WINDOW) {
+		return;
+	}
+
+	attack = counter->sketched >= FCOUNT_ATTACK_BITS &&
+		 counter->done >= FCOUNT_ATTACK_MINDONE &&
+		 counter->nxdomain * 100 >=
+			 counter->done * FCOUNT_ATTACK_NXPCT;
+
+	if (attack) {
+		if (counter->attacked == 0 && isc_log_wouldlog(ISC_LOG_INFO)) {
+			dns_name_format(counter->domain, dbuf, sizeof(dbuf));
+			isc_log_write(DNS_LOGCATEGORY_SPILL,
+				      DNS_LOGMODULE_RESOLVER, ISC_LOG_INFO,
+				      "possible random subdomain attack on %s "
+				      "(%" PRIuFAST32 " of %" PRIuFAST32
+				      " fetches NXDOMAIN); shedding fetches",
+				      dbuf, counter->nxdomain, counter->done);
+		}
+		counter->attacked = now + FCOUNT_ATTACK_HOLD;
+	} else if (counter->attacked != 0 && now >= counter->attacked) {
+		if (isc_log_wouldlog(ISC_LOG_INFO)) {
+			dns_name_format(counter->domain, dbuf, sizeof(dbuf));
+			isc_log_write(DNS_LOGCATEGORY_SPILL,
+				      DNS_LOGMODULE_RESOLVER, ISC_LOG_INFO,
+				      "random subdomain attack on %s is over",
+				      dbuf);
+		}
+		counter->attacked = 0;
+	}
+
+	counter->window = now;
+	memset(counter->sketch, 0, sizeof(counter->sketch));
+	counter->sketched = 0;
+	counter->done = 0;
+	counter->nxdomain = 0;
+}
+
+/*
+ * Add the name of 'fctx' to the sketch of 'counter'.  The counter must be
+ * locked.
+ */
+static void
+fcount_sketch(fctxcount_t *counter, fetchctx_t *fctx) {
+	uint32_t bit = dns_name_hash(fctx->name) % FCOUNT_SKETCH_BITS;
+	uint64_t mask = UINT64_C(1) << (bit % 64);
+
+	if ((counter->sketch[bit / 64] & mask) == 0) {
+		counter->sketch[bit / 64] |= mask;
+		counter->sketched++;
+	}
+}
+
+/*
+ * Record the result of 'fctx' for the random subdomain attack detection.
+ * A fetch that got a negative answer ends with ISC_R_SUCCESS, so whether
+ * the answer was NXDOMAIN is taken from 'fctx->nxdomain'.  The fetch
+ * context must be locked.
+ */
+static void
+fcount_done(fetchctx_t *fctx, isc_result_t result) {
+	fctxcount_t *counter = fctx->counter;
+
+	if (counter == NULL) {
+		return;
+	}
+
+	LOCK(&counter->lock);
+	counter->done++;
+	if (fctx->nxdomain || result == DNS_R_NCACHENXDOMAIN ||
+	    result == DNS_R_NXDOMAIN)
+	{
+		counter->nxdomain++;
+	}
+	UNLOCK(&counter->lock);
+}
+
+/*
+ * Is the zone of 'fctx' under a random subdomain attack?
+ */
+static bool
+fcount_attacked(fetchctx_t *fctx) {
+	fctxcount_t *counter = fctx->counter;
+	bool attacked;
+
+	if (counter == NULL) {
+		return false;
+	}
+
+	LOCK(&counter->lock);
+	attacked = counter->attacked != 0;
+	UNLOCK(&counter->lock);
+
+	return attacked;
+}
+
 static bool
 fcount_match(void *node, const void *key) {
 	const fctxcount_t *counter = node;
@@ -1438,7 +1712,11 @@ fcount_incr(fetchctx_t *fctx, bool force) {
 
 	hashval = dns_name_hash(fctx->domain);
 
-	RWLOCK(&res->counters_lock, locktype);
+	if (isc_rwlock_trylock(&res->counters_lock, locktype) != ISC_R_SUCCESS)
+	{
+		inc_stats(res, dns_resstatscounter_fcountwait);
+		RWLOCK(&res->counters_lock, locktype);
+	}
 	result = isc_hashmap_find(res->counters, hashval, fcount_match,
 				  fctx->domain, (void **)&counter);
 	switch (result) {
@@ -1478,6 +1756,11 @@ fcount_incr(fetchctx_t *fctx, bool force) {
 
 	INSIST(spill > 0);
 	LOCK(&counter->lock);
+	fcount_detect(counter, isc_stdtime_now());
+	fcount_sketch(counter, fctx);
+	if (counter->attacked != 0) {
+		spill = ISC_MAX(spill / FCOUNT_ATTACK_SHED, 1);
+	}
 	if (++counter->count > spill && !force) {
 		counter->count--;
 		INSIST(counter->count > 0);
@@ -1604,8 +1887,12 @@ fctx_sendevents(fetchctx_t *fctx, isc_result_t result) {
 				       ede->info_code, ede->extra_text);
 		}
 
+		/*
+		 * The clients waiting for the same fetch are spread over
+		 * all the loops; send each loop its responses at once.
+		 */
 		FCTXTRACE("post response event");
-		isc_async_run(resp->loop, resp->cb, resp);
+		isc_async_batch(resp->loop, resp->cb, resp);
 	}
 	UNLOCK(&fctx->lock);
 
@@ -1679,10 +1966,19 @@ fctx__done(fetchctx_t *fctx, isc_result_t result, const char *func,
 	}
 	fctx->state = fetchstate_done;
 	release_fctx(fctx);
+	fcount_done(fctx, result);
 
 	FCTX_ATTR_CLR(fctx, FCTX_ATTR_ADDRWAIT);
 	UNLOCK(&fctx->lock);
 
+	if (LIBDNS_FCTX_DONE_ENABLED()) {
+		isc_time_t now = isc_time_now();
+
+		LIBDNS_FCTX_DONE(fctx, fctx->name->ndata, fctx->name->length,
+				 fctx->type, result,
+				 isc_time_microdiff(&now, &fctx->start));
+	}
+
 	if (result == ISC_R_SUCCESS) {
 		if (fctx->qmin_warning != ISC_R_SUCCESS) {
 			isc_log_write(DNS_LOGCATEGORY_LAME_SERVERS,
@@ -1711,6 +2007,10 @@ fctx__done(fetchctx_t *fctx, isc_result_t result, const char *func,
 
 	fctx_cancelqueries(fctx, no_response, age_untried);
 	fctx_stoptimer(fctx);
+	if (fctx->hedgetimer != NULL) {
+		isc_timer_stop(fctx->hedgetimer);
+	}
+	fctx_releasefollowers(fctx);
 
 	/*
 	 * Cancel all pending validators.  Note that this must be done
@@ -1735,6 +2035,9 @@ fctx__done(fetchctx_t *fctx, isc_result_t result, const char *func,
 	fctx_cleanup(fctx);
 
 	isc_timer_destroy(&fctx->timer);
+	if (fctx->hedgetimer != NULL) {
+		isc_timer_destroy(&fctx->hedgetimer);
+	}
 
 	return true;
 }
@@ -1816,7 +2119,8 @@ fctx_addopt(dns_message_t *message, unsigned int version, uint16_t udpsize,
 }
 
 static void
-fctx_setretryinterval(fetchctx_t *fctx, unsigned int rtt) {
+fctx_setretryinterval(fetchctx_t *fctx, unsigned int rtt,
+		      unsigned int rtthigh) {
 	unsigned int seconds, us;
 	uint64_t limit;
 	isc_time_t now;
@@ -1832,7 +2136,18 @@ fctx_setretryinterval(fetchctx_t *fctx, unsigned int rtt) {
 		return;
 	}
 
-	us = fctx->res->retryinterval * US_PER_MS;
+	if (rtthigh != 0) {
+		/*
+		 * We have measured enough round trips to this server to
+		 * know how long its responses can take: wait for the high
+		 * quantile of its RTT with a margin, rather than for the
+		 * fixed retry interval, which is too long for a close server
+		 * and too short for a far one.
+		 */
+		us = rtthigh + rtthigh / 2;
+	} else {
+		us = fctx->res->retryinterval * US_PER_MS;
+	}
 
 	/*
 	 * Exponential backoff after the first few tries.
@@ -1893,7 +2208,7 @@ fctx_query(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo,
 	resquery_t *query = NULL;
 	isc_sockaddr_t addr, sockaddr;
 	bool have_addr = false;
-	unsigned int srtt;
+	unsigned int srtt, rtthigh;
 	isc_tlsctx_cache_t *tlsctx_cache = NULL;
 
 	FCTXTRACE("query");
@@ -1901,6 +2216,7 @@ fctx_query(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo,
 	res = fctx->res;
 
 	srtt = addrinfo->srtt;
+	rtthigh = addrinfo->rtthigh;
 
 	if (addrinfo->transport != NULL) {
 		switch (dns_transport_get_type(addrinfo->transport)) {
@@ -1924,6 +2240,7 @@ fctx_query(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo,
 	 */
 	if ((options & DNS_FETCHOPT_TCP) != 0) {
 		srtt += US_PER_SEC;
+		rtthigh = 0;
 	}
 
 	/*
@@ -1932,9 +2249,10 @@ fctx_query(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo,
 	 */
 	if (ISFORWARDER(addrinfo) && srtt < US_PER_SEC) {
 		srtt = US_PER_SEC;
+		rtthigh = 0;
 	}
 
-	fctx_setretryinterval(fctx, srtt);
+	fctx_setretryinterval(fctx, srtt, rtthigh);
 	if (isc_interval_iszero(&fctx->interval)) {
 		FCTXTRACE("fetch expired");
 		return ISC_R_TIMEDOUT;
@@ -1942,7 +2260,7 @@ fctx_query(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo,
 
 	INSIST(ISC_LIST_EMPTY(fctx->validators));
 
-	query = isc_mem_get(fctx->mctx, sizeof(*query));
+	query = isc_mempool_get(res->querypool);
 	*query = (resquery_t){
 		.options = options,
 		.addrinfo = addrinfo,
@@ -1961,9 +2279,7 @@ fctx_query(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo,
 	 * remain valid until this query is canceled.
 	 */
 
-	dns_message_create(fctx->mctx, fctx->res->namepools[fctx->tid],
-			   fctx->res->rdspools[fctx->tid],
-			   DNS_MESSAGE_INTENTPARSE, &query->rmessage);
+	query->rmessage = getrmessage(fctx);
 	query->start = isc_time_now();
 
 	/*
@@ -2050,10 +2366,29 @@ fctx_query(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo,
 		}
 		isc_sockaddr_setport(&addr, 0);
 
-		result = dns_dispatch_createtcp(res->view->dispatchmgr, &addr,
-						&sockaddr, addrinfo->transport,
-						DNS_DISPATCHOPT_UNSHARED,
-						&query->dispatch);
+		/*
+		 * When the dispatch manager pools upstream connections,
+		 * join an existing TCP or TLS connection to the server,
+		 * or create a new shared one.
+		 */
+		if (dns_dispatchmgr_tcppool(res->view->dispatchmgr)) {
+			result = dns_dispatch_gettcp(
+				res->view->dispatchmgr, &sockaddr, &addr,
+				addrinfo->transport, &query->dispatch);
+			if (result == ISC_R_SUCCESS) {
+				FCTXTRACE("reusing TCP connection");
+			} else {
+				result = dns_dispatch_createtcp(
+					res->view->dispatchmgr, &addr,
+					&sockaddr, addrinfo->transport, 0,
+					&query->dispatch);
+			}
+		} else {
+			result = dns_dispatch_createtcp(
+				res->view->dispatchmgr, &addr, &sockaddr,
+				addrinfo->transport, DNS_DISPATCHOPT_UNSHARED,
+				&query->dispatch);
+		}
 		if (result != ISC_R_SUCCESS) {
 			goto cleanup_query;
 		}
@@ -2178,8 +2513,8 @@ cleanup_dispatch:
 
 cleanup_query:
 	query->magic = 0;
-	dns_message_detach(&query->rmessage);
-	isc_mem_put(fctx->mctx, query, sizeof(*query));
+	putrmessage(fctx, &query->rmessage);
+	isc_mempool_put(fctx->res->querypool, query);
 
 	return result;
 }
@@ -3815,6 +4150,76 @@ possibly_mark(fetchctx_t *fctx, dns_adbaddrinfo_t *addr) {
 	}
 }
 
+/*
+ * The expected cost of sending a query to a forwarder: its smoothed RTT,
+ * scaled by the number of queries already waiting for it.
+ */
+static uint64_t
+forwarder_cost(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo) {
+	return ((uint64_t)addrinfo->srtt + 1) *
+	       (dns_adb_getactive(fctx->adb, addrinfo) + 1);
+}
+
+/*
+ * Pick the forwarder to try next from the unmarked ones, using the
+ * "power of two choices": the cheaper of two forwarders chosen at
+ * random.  Always starting with the forwarder with the lowest SRTT
+ * would send nearly all the queries to it; this way the load spreads
+ * across the forwarders that perform alike, the forwarders that are
+ * busy are avoided, and the slowest forwarder is never tried first.
+ */
+static dns_adbaddrinfo_t *
+fctx_pickforwarder(fetchctx_t *fctx) {
+	dns_adbaddrinfo_t *addrinfo = NULL;
+	dns_adbaddrinfo_t *first = NULL, *second = NULL;
+	uint32_t count = 0, i, j;
+
+	for (addrinfo = ISC_LIST_HEAD(fctx->forwaddrs); addrinfo != NULL;
+	     addrinfo = ISC_LIST_NEXT(addrinfo, publink))
+	{
+		if (!UNMARKED(addrinfo)) {
+			continue;
+		}
+		possibly_mark(fctx, addrinfo);
+		if (UNMARKED(addrinfo)) {
+			count++;
+		}
+	}
+
+	if (count == 0) {
+		return NULL;
+	}
+
+	i = isc_random_uniform(count);
+	j = (count > 1) ? isc_random_uniform(count - 1) : i;
+	if (count > 1 && j >= i) {
+		j++;
+	}
+
+	count = 0;
+	for (addrinfo = ISC_LIST_HEAD(fctx->forwaddrs); addrinfo != NULL;
+	     addrinfo = ISC_LIST_NEXT(addrinfo, publink))
+	{
+		if (!UNMARKED(addrinfo)) {
+			continue;
+		}
+		if (count == i) {
+			first = addrinfo;
+		}
+		if (count == j) {
+			second = addrinfo;
+		}
+		count++;
+	}
+
+	INSIST(first != NULL && second != NULL);
+
+	if (forwarder_cost(fctx, second) < forwarder_cost(fctx, first)) {
+		return second;
+	}
+	return first;
+}
+
 static dns_adbaddrinfo_t *
 fctx_nextaddress(fetchctx_t *fctx) {
 	dns_adbfind_t *find, *start;
@@ -3826,30 +4231,22 @@ fctx_nextaddress(fetchctx_t *fctx) {
 	 */
 
 	/*
-	 * Find the first unmarked forwarder (if any).
+	 * Pick one of the unmarked forwarders (if any).
 	 */
-	for (addrinfo = ISC_LIST_HEAD(fctx->forwaddrs); addrinfo != NULL;
-	     addrinfo = ISC_LIST_NEXT(addrinfo, publink))
-	{
-		if (!UNMARKED(addrinfo)) {
-			continue;
-		}
-		possibly_mark(fctx, addrinfo);
-		if (UNMARKED(addrinfo)) {
-			addrinfo->flags |= FCTX_ADDRINFO_MARK;
-			fctx->find = NULL;
-			fctx->forwarding = true;
+	addrinfo = fctx_pickforwarder(fctx);
+	if (addrinfo != NULL) {
+		addrinfo->flags |= FCTX_ADDRINFO_MARK;
+		fctx->find = NULL;
+		fctx->forwarding = true;
 
-			/*
-			 * QNAME minimization is disabled when
-			 * forwarding, and has to remain disabled if
-			 * we switch back to normal recursion; otherwise
-			 * forwarding could leave us in an inconsistent
-			 * state.
-			 */
-			fctx->minimized = false;
-			return addrinfo;
-		}
+		/*
+		 * QNAME minimization is disabled when forwarding, and
+		 * has to remain disabled if we switch back to normal
+		 * recursion; otherwise forwarding could leave us in an
+		 * inconsistent state.
+		 */
+		fctx->minimized = false;
+		return addrinfo;
 	}
 
 	/*
@@ -3981,6 +4378,102 @@ fctx_nextaddress(fetchctx_t *fctx) {
 	return addrinfo;
 }
 
+/*
+ * Arm the hedge timer for the query just sent to 'addrinfo': if it
+ * hasn't been answered after twice the server's smoothed RTT, another
+ * server is queried as well.
+ */
+static void
+fctx_starthedge(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo) {
+	isc_interval_t interval;
+	uint64_t us = 2 * (uint64_t)addrinfo->srtt;
+
+	if (us < HEDGE_MIN_DELAY_US) {
+		us = HEDGE_MIN_DELAY_US;
+	}
+
+	/*
+	 * Don't bother if the query will have timed out by then.
+	 */
+	if (us >= (uint64_t)isc_interval_ms(&fctx->interval) * US_PER_MS) {
+		isc_timer_stop(fctx->hedgetimer);
+		return;
+	}
+
+	isc_interval_set(&interval, us / US_PER_SEC,
+			 (us % US_PER_SEC) * NS_PER_US);
+	isc_timer_start(fctx->hedgetimer, isc_timertype_once, &interval);
+}
+
+/*
+ * The hedge timer fired: if the only query in flight is still waiting
+ * for its response, send the same query to the next best server.
+ * Whichever response arrives first is used, and rctx_done() cancels
+ * the other query.
+ */
+static void
+fctx_hedge(void *arg) {
+	fetchctx_t *fctx = (fetchctx_t *)arg;
+	dns_adbaddrinfo_t *addrinfo = NULL;
+	resquery_t *query = NULL;
+	isc_result_t result;
+	bool hedge;
+
+	REQUIRE(VALID_FCTX(fctx));
+	REQUIRE(fctx->tid == isc_tid());
+
+	LOCK(&fctx->lock);
+	query = ISC_LIST_HEAD(fctx->queries);
+	hedge = !SHUTTINGDOWN(fctx) && !ADDRWAIT(fctx) &&
+		!ISC_LIST_EMPTY(fctx->resps) && query != NULL &&
+		ISC_LIST_NEXT(query, link) == NULL && !RESQUERY_HEDGE(query) &&
+		(query->options & DNS_FETCHOPT_TCP) == 0;
+	UNLOCK(&fctx->lock);
+
+	if (!hedge || !ISC_LIST_EMPTY(fctx->validators)) {
+		return;
+	}
+
+	addrinfo = fctx_nextaddress(fctx);
+	while (addrinfo != NULL && dns_adb_overquota(fctx->adb, addrinfo)) {
+		addrinfo = fctx_nextaddress(fctx);
+	}
+	if (addrinfo == NULL) {
+		/* Nobody else to ask; keep waiting for the first server. */
+		return;
+	}
+	LIBDNS_FCTX_SELECT(fctx, &addrinfo->sockaddr.type.sa, addrinfo->srtt);
+
+	/*
+	 * The hedged query counts against the query limits like any
+	 * other; if they are exhausted, fctx_try() will notice when the
+	 * first query fails.
+	 */
+	if (isc_counter_increment(fctx->qc) != ISC_R_SUCCESS) {
+		return;
+	}
+	if (fctx->gqc != NULL &&
+	    isc_counter_increment(fctx->gqc) != ISC_R_SUCCESS)
+	{
+		return;
+	}
+
+	result = fctx_query(fctx, addrinfo, fctx->options);
+	if (result != ISC_R_SUCCESS) {
+		FCTXTRACE3("hedged query not sent", result);
+		return;
+	}
+
+	LOCK(&fctx->lock);
+	query = ISC_LIST_TAIL(fctx->queries);
+	INSIST(query != NULL);
+	query->attributes |= RESQUERY_ATTR_HEDGE;
+	UNLOCK(&fctx->lock);
+
+	FCTXTRACE("hedged query sent");
+	inc_stats(fctx->res, dns_resstatscounter_hedgesent);
+}
+
 static void
 fctx_try(fetchctx_t *fctx, bool retrying) {
 	isc_result_t result;
@@ -4064,6 +4557,8 @@ fctx_try(fetchctx_t *fctx, bool retrying) {
 			goto done;
 		}
 	}
+	LIBDNS_FCTX_SELECT(fctx, &addrinfo->sockaddr.type.sa, addrinfo->srtt);
+
 	/*
 	 * We're minimizing and we're not yet at the final NS -
 	 * we need to launch a query for NS for 'upper' domain
@@ -4154,6 +4649,9 @@ fctx_try(fetchctx_t *fctx, bool retrying) {
 	if (retrying) {
 		inc_stats(res, dns_resstatscounter_retry);
 	}
+	if (fctx->hedgetimer != NULL) {
+		fctx_starthedge(fctx, addrinfo);
+	}
 
 done:
 	if (result != ISC_R_SUCCESS) {
@@ -4329,6 +4827,14 @@ cleanup:
 	fetchctx_detach(&fctx);
 }
 
+static void
+fctx_free_rcu(struct rcu_head *rcu_head) {
+	fetchctx_t *fctx = caa_container_of(rcu_head, fetchctx_t, rcu_head);
+
+	isc_mutex_destroy(&fctx->lock);
+	isc_mem_putanddetach(&fctx->mctx, fctx, sizeof(*fctx));
+}
+
 static void
 fctx_destroy(fetchctx_t *fctx) {
 	dns_resolver_t *res = NULL;
@@ -4344,6 +4850,7 @@ fctx_destroy(fetchctx_t *fctx) {
 	REQUIRE(ISC_LIST_EMPTY(fctx->edelist));
 	REQUIRE(atomic_load_acquire(&fctx->pending) == 0);
 	REQUIRE(ISC_LIST_EMPTY(fctx->validators));
+	REQUIRE(ISC_LIST_EMPTY(fctx->followers));
 	REQUIRE(fctx->state != fetchstate_active);
 
 	FCTXTRACE("destroy");
@@ -4391,40 +4898,250 @@ fctx_destroy(fetchctx_t *fctx) {
 
 	dns_resolver_detach(&fctx->res);
 
-	isc_mutex_destroy(&fctx->lock);
+	isc_mem_free(fctx->mctx, fctx->info);
+
+	/* get_attached_fctx() may still be looking at the lock */
+	call_rcu(&fctx->rcu_head, fctx_free_rcu);
+}
+
+static void
+fctx_expired(void *arg) {
+	fetchctx_t *fctx = (fetchctx_t *)arg;
+
+	REQUIRE(VALID_FCTX(fctx));
+	REQUIRE(fctx->tid == isc_tid());
+
+	isc_log_write(DNS_LOGCATEGORY_RESOLVER, DNS_LOGMODULE_RESOLVER,
+		      ISC_LOG_INFO,
+		      "shut down hung fetch while resolving %p(%s)", fctx,
+		      fctx->info);
+
+	LOCK(&fctx->lock);
+	dns_ede_append(fctx->mctx, &fctx->edelist, DNS_EDE_NOREACHABLEAUTH,
+		       NULL);
+	UNLOCK(&fctx->lock);
+
+	fctx_done_detach(&fctx, DNS_R_SERVFAIL);
+}
+
+static void
+fctx_shutdown(void *arg) {
+	fetchctx_t *fctx = arg;
+
+	REQUIRE(VALID_FCTX(fctx));
+
+	fctx_done_unref(fctx, ISC_R_SHUTTINGDOWN);
+	fetchctx_detach(&fctx);
+}
+
+/*
+ * Sharing the delegation walk.
+ *
+ * Clients commonly ask for the A, AAAA and HTTPS records of a name at
+ * the same time, and on a cold cache each of the fetches would walk
+ * the delegation chain, querying the same servers at every level.
+ * Instead, a fetch that starts at the same zone cut as a concurrent
+ * fetch for one of the other types on the same loop parks on it (the
+ * "leader") until the leader gets a usable response.  By then any
+ * referral has been cached, so the follower adopts the deeper zone cut
+ * and either parks again or sends its own query.
+ *
+ * With QNAME minimization, the walk is already shared, as the
+ * minimized fetches of both fetchctxs have the same key and are
+ * joined in the fctx table.
+ */
+static const dns_rdatatype_t walktypes[] = {
+	dns_rdatatype_a,
+	dns_rdatatype_aaaa,
+	dns_rdatatype_https,
+};
+
+static bool
+walktype(dns_rdatatype_t type) {
+	for (size_t i = 0; i < ARRAY_SIZE(walktypes); i++) {
+		if (type == walktypes[i]) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool
+fctx_canlead(fetchctx_t *leader, fetchctx_t *fctx) {
+	bool shuttingdown;
+
+	if (leader->tid != fctx->tid || ISC_LINK_LINKED(leader, flink)) {
+		return false;
+	}
+
+	LOCK(&leader->lock);
+	shuttingdown = SHUTTINGDOWN(leader);
+	UNLOCK(&leader->lock);
+	if (shuttingdown) {
+		return false;
+	}
+
+	/*
+	 * The leader must be talking to the servers for our zone cut
+	 * (or looking up their addresses), not to forwarders.
+	 */
+	return leader->fwdpolicy == dns_fwdpolicy_none && !leader->forwarding &&
+	       (!ISC_LIST_EMPTY(leader->queries) || ADDRWAIT(leader)) &&
+	       dns_name_equal(leader->domain, fctx->domain);
+}
+
+/*
+ * Park 'fctx' on a concurrent fetch that is walking the same delegation
+ * chain.  Returns true if it was parked; fctx_unfollow() resumes it.
+ */
+static bool
+fctx_follow(fetchctx_t *fctx) {
+	dns_resolver_t *res = fctx->res;
+	fetchctx_t *leader = NULL;
+
+	if (!walktype(fctx->type) ||
+	    (fctx->options & DNS_FETCHOPT_QMINIMIZE) != 0 ||
+	    !ISC_LIST_EMPTY(fctx->forwarders))
+	{
+		return false;
+	}
+
+	/*
+	 * Only wait when we're at least two labels above the name, so
+	 * the response to the leader is likely a referral: waiting for
+	 * the final answer would just delay our own query.
+	 */
+	if (dns_name_countlabels(fctx->name) <
+	    dns_name_countlabels(fctx->domain) + 2)
+	{
+		return false;
+	}
+
+	rcu_read_lock();
+	for (size_t i = 0; i < ARRAY_SIZE(walktypes) && leader == NULL; i++) {
+		fetchctx_t key = {
+			.name = fctx->name,
+			.options = fctx->options,
+			.type = walktypes[i],
+		};
+		struct cds_lfht_iter iter;
+		struct cds_lfht_node *ht_node = NULL;
+
+		if (walktypes[i] == fctx->type) {
+			continue;
+		}
+
+		cds_lfht_lookup(res->fctxs, fctx_hash(&key), fctx_match, &key,
+				&iter);
+		ht_node = cds_lfht_iter_get_node(&iter);
+		if (ht_node != NULL) {
+			leader = caa_container_of(ht_node, fetchctx_t, ht_node);
+			if (!fctx_canlead(leader, fctx)) {
+				leader = NULL;
+			}
+		}
+	}
+
+	/*
+	 * The leader runs on our loop and can't go away until it is
+	 * done there, which releases its followers.
+	 */
+	if (leader != NULL) {
+		FCTXTRACE2("following", leader->info);
+		fetchctx_ref(fctx);
+		ISC_LIST_APPEND(leader->followers, fctx, flink);
+		inc_stats(res, dns_resstatscounter_walkshared);
+	}
+	rcu_read_unlock();
+
+	return leader != NULL;
+}
+
+/*
+ * Move to the deepest zone cut in the cache, if it is below the
+ * current one.
+ */
+static isc_result_t
+fctx_updatezonecut(fetchctx_t *fctx) {
+	isc_result_t result;
+	dns_fixedname_t foundname, founddc;
+	dns_name_t *fname = dns_fixedname_initname(&foundname);
+	dns_name_t *dcname = dns_fixedname_initname(&founddc);
+	dns_rdataset_t nameservers;
+
+	dns_rdataset_init(&nameservers);
+	result = dns_view_findzonecut(fctx->res->view, fctx->name, fname,
+				      dcname, fctx->now, 0, true, true,
+				      &nameservers, NULL);
+	if (result != ISC_R_SUCCESS) {
+		/* Keep going with what we have */
+		return ISC_R_SUCCESS;
+	}
+
+	if (!dns_name_issubdomain(fname, fctx->domain) ||
+	    dns_name_equal(fname, fctx->domain))
+	{
+		dns_rdataset_disassociate(&nameservers);
+		return ISC_R_SUCCESS;
+	}
+
+	fcount_decr(fctx);
+	dns_name_copy(fname, fctx->domain);
+	dns_name_copy(dcname, fctx->qmindcname);
+	result = fcount_incr(fctx, true);
+	if (result != ISC_R_SUCCESS) {
+		dns_rdataset_disassociate(&nameservers);
+		return result;
+	}
+
+	if (dns_rdataset_isassociated(&fctx->nameservers)) {
+		dns_rdataset_disassociate(&fctx->nameservers);
+	}
+	dns_rdataset_clone(&nameservers, &fctx->nameservers);
+	dns_rdataset_disassociate(&nameservers);
+	fctx->ns_ttl = fctx->nameservers.ttl;
+	fctx->ns_ttl_ok = true;
 
-	isc_mem_free(fctx->mctx, fctx->info);
-	isc_mem_putanddetach(&fctx->mctx, fctx, sizeof(*fctx));
+	return ISC_R_SUCCESS;
 }
 
 static void
-fctx_expired(void *arg) {
-	fetchctx_t *fctx = (fetchctx_t *)arg;
+fctx_unfollow(void *arg) {
+	fetchctx_t *fctx = arg;
+	isc_result_t result;
+	bool shuttingdown;
 
 	REQUIRE(VALID_FCTX(fctx));
 	REQUIRE(fctx->tid == isc_tid());
 
-	isc_log_write(DNS_LOGCATEGORY_RESOLVER, DNS_LOGMODULE_RESOLVER,
-		      ISC_LOG_INFO,
-		      "shut down hung fetch while resolving %p(%s)", fctx,
-		      fctx->info);
+	FCTXTRACE("unfollow");
 
 	LOCK(&fctx->lock);
-	dns_ede_append(fctx->mctx, &fctx->edelist, DNS_EDE_NOREACHABLEAUTH,
-		       NULL);
+	shuttingdown = SHUTTINGDOWN(fctx);
 	UNLOCK(&fctx->lock);
 
-	fctx_done_detach(&fctx, DNS_R_SERVFAIL);
+	if (!shuttingdown) {
+		result = fctx_updatezonecut(fctx);
+		if (result != ISC_R_SUCCESS) {
+			fctx_done_unref(fctx, DNS_R_SERVFAIL);
+		} else if (!fctx_follow(fctx)) {
+			fctx_try(fctx, false);
+		}
+	}
+
+	fetchctx_detach(&fctx);
 }
 
 static void
-fctx_shutdown(void *arg) {
-	fetchctx_t *fctx = arg;
+fctx_releasefollowers(fetchctx_t *fctx) {
+	fetchctx_t *follower = NULL, *next = NULL;
 
-	REQUIRE(VALID_FCTX(fctx));
+	REQUIRE(fctx->tid == isc_tid());
 
-	fctx_done_unref(fctx, ISC_R_SHUTTINGDOWN);
-	fetchctx_detach(&fctx);
+	ISC_LIST_FOREACH_SAFE (fctx->followers, follower, flink, next) {
+		ISC_LIST_UNLINK(fctx->followers, follower, flink);
+		isc_async_run(follower->loop, fctx_unfollow, follower);
+	}
 }
 
 static void
@@ -4455,7 +5172,9 @@ fctx_start(void *arg) {
 	 * while a response is being processed normally.)
 	 */
 	fctx_starttimer(fctx);
-	fctx_try(fctx, false);
+	if (!fctx_follow(fctx)) {
+		fctx_try(fctx, false);
+	}
 
 detach:
 	fetchctx_detach(&fctx);
@@ -4631,6 +5350,8 @@ fctx_create(dns_resolver_t *res, isc_loop_t *loop, const dns_name_t *name,
 	ISC_LIST_INIT(fctx->edns);
 	ISC_LIST_INIT(fctx->bad_edns);
 	ISC_LIST_INIT(fctx->validators);
+	ISC_LIST_INIT(fctx->followers);
+	ISC_LINK_INIT(fctx, flink);
 
 	atomic_init(&fctx->attributes, 0);
 
@@ -4806,7 +5527,15 @@ fctx_create(dns_resolver_t *res, isc_loop_t *loop, const dns_name_t *name,
 
 	inc_stats(res, dns_resstatscounter_nfetch);
 
-	isc_timer_create(fctx->loop, fctx_expired, fctx, &fctx->timer);
+	/* Most fetches finish before their timers fire */
+	isc_timer_create_coarse(fctx->loop, fctx_expired, fctx, &fctx->timer);
+	if (res->hedging) {
+		isc_timer_create_coarse(fctx->loop, fctx_hedge, fctx,
+					&fctx->hedgetimer);
+	}
+
+	LIBDNS_FCTX_CREATE(fctx, fctx->name->ndata, fctx->name->length,
+			   fctx->type);
 
 	*fctxp = fctx;
 
@@ -5171,8 +5900,26 @@ has_000_label(dns_rdataset_t *nsecset) {
 /*
  * The validator has finished.
  */
+/*
+ * The CPU time spent caching a validated answer, and handling a response
+ * below, is charged to the view's resolver statistics.  The fetch context
+ * can be gone by the end, so a reference to the resolver is held.
+ */
 static void
 validated(void *arg) {
+	dns_validator_t *val = (dns_validator_t *)arg;
+	dns_valarg_t *valarg = val->arg;
+	dns_resolver_t *res = dns_resolver_ref(valarg->fctx->res);
+	isc_nanosecs_t start = isc_time_threadcpu();
+
+	validated_process(arg);
+
+	add_cputime(res, start);
+	dns_resolver_detach(&res);
+}
+
+static void
+validated_process(void *arg) {
 	dns_validator_t *val = (dns_validator_t *)arg;
 	dns_adbaddrinfo_t *addrinfo = NULL;
 	dns_dbnode_t *node = NULL;
@@ -5647,6 +6394,7 @@ answer_response:
 	 */
 
 	FCTX_ATTR_SET(fctx, FCTX_ATTR_HAVEANSWER);
+	fctx->nxdomain = (eresult == DNS_R_NCACHENXDOMAIN);
 
 	if (hresp != NULL) {
 		/*
@@ -6436,7 +7184,7 @@ ncache_message(fetchctx_t *fctx, dns_message_t *message,
 	dns_rdataset_t *ardataset = NULL;
 	bool need_validation = false, secure_domain = false;
 	dns_fetchresponse_t *resp = NULL;
-	uint32_t ttl;
+	uint32_t ttl, minttl;
 	unsigned int valoptions = 0;
 	bool checknta = true;
 
@@ -6557,16 +7305,27 @@ ncache_message(fetchctx_t *fctx, dns_message_t *message,
 	{
 		ttl = 0;
 	}
+	minttl = fctx->res->view->minncachettl;
+
+	/*
+	 * Don't let the answers of a random subdomain attack fill the
+	 * cache.
+	 */
+	if (fcount_attacked(fctx)) {
+		ttl = ISC_MIN(ttl, FCOUNT_ATTACK_NCACHETTL);
+		minttl = ISC_MIN(minttl, ttl);
+	}
 
 	result = ncache_adderesult(message, fctx->cache, node, covers, now,
-				   fctx->res->view->minncachettl, ttl, false,
-				   false, ardataset, &eresult);
+				   minttl, ttl, false, false, ardataset,
+				   &eresult);
 	if (result != ISC_R_SUCCESS) {
 		goto unlock;
 	}
 
 	if (!HAVE_ANSWER(fctx)) {
 		FCTX_ATTR_SET(fctx, FCTX_ATTR_HAVEANSWER);
+		fctx->nxdomain = (eresult == DNS_R_NCACHENXDOMAIN);
 		if (resp != NULL) {
 			resp->result = eresult;
 			if (adbp != NULL && *adbp != NULL) {
@@ -7039,9 +7798,10 @@ fctx_hash(fetchctx_t *fctx) {
 	return isc_hash32_finalize(&hash32);
 }
 
-static bool
-fctx_match(void *node, const void *key) {
-	const fetchctx_t *fctx0 = node;
+static int
+fctx_match(struct cds_lfht_node *ht_node, const void *key) {
+	const fetchctx_t *fctx0 = caa_container_of(ht_node, fetchctx_t,
+						   ht_node);
 	const fetchctx_t *fctx1 = key;
 
 	return fctx0->options == fctx1->options && fctx0->type == fctx1->type &&
@@ -7051,19 +7811,16 @@ fctx_match(void *node, const void *key) {
 /* Must be fctx locked */
 static void
 release_fctx(fetchctx_t *fctx) {
-	isc_result_t result;
 	dns_resolver_t *res = fctx->res;
 
 	if (!fctx->hashed) {
 		return;
 	}
 
-	RWLOCK(&res->fctxs_lock, isc_rwlocktype_write);
-	result = isc_hashmap_delete(res->fctxs, fctx_hash(fctx), match_ptr,
-				    fctx);
-	INSIST(result == ISC_R_SUCCESS);
+	rcu_read_lock();
+	INSIST(!cds_lfht_del(res->fctxs, &fctx->ht_node));
 	fctx->hashed = false;
-	RWUNLOCK(&res->fctxs_lock, isc_rwlocktype_write);
+	rcu_read_unlock();
 }
 
 static void
@@ -7346,6 +8103,29 @@ betterreferral(respctx_t *rctx) {
  */
 static void
 resquery_response(isc_result_t eresult, isc_region_t *region, void *arg) {
+	resquery_t *query = (resquery_t *)arg;
+	dns_resolver_t *res = NULL;
+	isc_nanosecs_t start;
+
+	if (eresult == ISC_R_CANCELED) {
+		return;
+	}
+
+	REQUIRE(VALID_QUERY(query));
+	REQUIRE(VALID_FCTX(query->fctx));
+
+	res = dns_resolver_ref(query->fctx->res);
+	start = isc_time_threadcpu();
+
+	resquery_response_process(eresult, region, arg);
+
+	add_cputime(res, start);
+	dns_resolver_detach(&res);
+}
+
+static void
+resquery_response_process(isc_result_t eresult, isc_region_t *region,
+			  void *arg) {
 	isc_result_t result;
 	resquery_t *query = (resquery_t *)arg;
 	fetchctx_t *fctx = NULL;
@@ -9545,6 +10325,24 @@ rctx_nextserver(respctx_t *rctx, dns_message_t *message,
 		retrying = false;
 	}
 
+	/*
+	 * If a hedged query is still outstanding, wait for it instead
+	 * of trying yet another server; its response or its timeout will
+	 * move the fetch along.
+	 */
+	if (retrying && fctx->hedgetimer != NULL) {
+		bool pending;
+
+		LOCK(&fctx->lock);
+		pending = !ISC_LIST_EMPTY(fctx->queries);
+		UNLOCK(&fctx->lock);
+
+		if (pending) {
+			FCTXTRACE("waiting for the hedged query");
+			return;
+		}
+	}
+
 	/*
 	 * Try again.
 	 */
@@ -9641,6 +10439,7 @@ rctx_done(respctx_t *rctx, isc_result_t result) {
 	fetchctx_t *fctx = rctx->fctx;
 	dns_adbaddrinfo_t *addrinfo = query->addrinfo;
 	dns_message_t *message = NULL;
+	bool answered;
 
 	/*
 	 * Need to attach to the message until the scope
@@ -9674,9 +10473,36 @@ rctx_done(respctx_t *rctx, isc_result_t result) {
 		}
 	}
 
+	/*
+	 * Did we get a response we can use, rather than one that makes
+	 * us try again?
+	 */
+	answered = !rctx->no_response && !rctx->nextitem && !rctx->resend &&
+		   (!rctx->next_server || rctx->get_nameservers);
+	if (answered && RESQUERY_HEDGE(query)) {
+		inc_stats(fctx->res, dns_resstatscounter_hedgewon);
+	}
+
 	/* Cancel the query */
 	fctx_cancelquery(&query, rctx->finish, rctx->no_response, false);
 
+	/*
+	 * Any referral in the response has been cached by now; let the
+	 * fetches waiting on our delegation walk continue.
+	 */
+	if (answered) {
+		fctx_releasefollowers(fctx);
+	}
+
+	/*
+	 * The first usable response wins; cancel the queries still
+	 * racing it, counting them as unanswered.
+	 */
+	if (answered && fctx->hedgetimer != NULL) {
+		isc_timer_stop(fctx->hedgetimer);
+		fctx_cancelqueries(fctx, true, false);
+	}
+
 	/*
 	 * If nobody's waiting for results, don't resend or try next server.
 	 */
@@ -9945,12 +10771,16 @@ dns_resolver__destroy(dns_resolver_t *res) {
 		isc_stats_detach(&res->stats);
 	}
 
+	INSIST(ISC_LIST_EMPTY(res->refreshes));
+	if (res->refreshrl != NULL) {
+		isc_ratelimiter_shutdown(res->refreshrl);
+		isc_ratelimiter_detach(&res->refreshrl);
+	}
+
 	isc_mutex_destroy(&res->primelock);
 	isc_mutex_destroy(&res->lock);
 
-	INSIST(isc_hashmap_count(res->fctxs) == 0);
-	isc_hashmap_destroy(&res->fctxs);
-	isc_rwlock_destroy(&res->fctxs_lock);
+	RUNTIME_CHECK(!cds_lfht_destroy(res->fctxs, NULL));
 
 	INSIST(isc_hashmap_count(res->counters) == 0);
 	isc_hashmap_destroy(&res->counters);
@@ -9973,12 +10803,20 @@ dns_resolver__destroy(dns_resolver_t *res) {
 	dns_view_weakdetach(&res->view);
 
 	for (size_t i = 0; i < res->nloops; i++) {
+		msgcache_t *cache = &res->msgcaches[i];
+		while (cache->count > 0) {
+			dns_message_detach(&cache->messages[--cache->count]);
+		}
 		dns_message_destroypools(&res->namepools[i], &res->rdspools[i]);
 	}
+	isc_mem_cput(res->mctx, res->msgcaches, res->nloops,
+		     sizeof(res->msgcaches[0]));
 	isc_mem_cput(res->mctx, res->rdspools, res->nloops,
 		     sizeof(res->rdspools[0]));
 	isc_mem_cput(res->mctx, res->namepools, res->nloops,
 		     sizeof(res->namepools[0]));
+	isc_mempool_destroy(&res->fetchpool);
+	isc_mempool_destroy(&res->querypool);
 
 	isc_mem_putanddetach(&res->mctx, res, sizeof(*res));
 }
@@ -10043,6 +10881,7 @@ dns_resolver_create(dns_view_t *view, isc_loopmgr_t *loopmgr, isc_nm_t *nm,
 		.maxdepth = DEFAULT_RECURSION_DEPTH,
 		.maxqueries = DEFAULT_MAX_QUERIES,
 		.alternates = ISC_LIST_INITIALIZER,
+		.refreshes = ISC_LIST_INITIALIZER,
 		.nloops = isc_loopmgr_nloops(loopmgr),
 		.maxvalidations = DEFAULT_MAX_VALIDATIONS,
 		.maxvalidationfails = DEFAULT_MAX_VALIDATION_FAILURES,
@@ -10062,8 +10901,10 @@ dns_resolver_create(dns_view_t *view, isc_loopmgr_t *loopmgr, isc_nm_t *nm,
 #endif
 	isc_refcount_init(&res->references, 1);
 
-	isc_hashmap_create(view->mctx, RES_DOMAIN_HASH_BITS, &res->fctxs);
-	isc_rwlock_init(&res->fctxs_lock);
+	res->fctxs = cds_lfht_new(RES_FCTXS_INIT_SIZE, RES_FCTXS_MIN_SIZE, 0,
+				  CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING,
+				  NULL);
+	INSIST(res->fctxs != NULL);
 
 	isc_hashmap_create(view->mctx, RES_DOMAIN_HASH_BITS, &res->counters);
 	isc_rwlock_init(&res->counters_lock);
@@ -10090,6 +10931,8 @@ dns_resolver_create(dns_view_t *view, isc_loopmgr_t *loopmgr, isc_nm_t *nm,
 				      sizeof(res->namepools[0]));
 	res->rdspools = isc_mem_cget(res->mctx, res->nloops,
 				     sizeof(res->rdspools[0]));
+	res->msgcaches = isc_mem_cget(res->mctx, res->nloops,
+				      sizeof(res->msgcaches[0]));
 	for (size_t i = 0; i < res->nloops; i++) {
 		isc_loop_t *loop = isc_loop_get(res->loopmgr, i);
 		isc_mem_t *pool_mctx = isc_loop_getmctx(loop);
@@ -10098,6 +10941,13 @@ dns_resolver_create(dns_view_t *view, isc_loopmgr_t *loopmgr, isc_nm_t *nm,
 					&res->rdspools[i]);
 	}
 
+	isc_mempool_create_shared(res->mctx, sizeof(dns_fetch_t),
+				  &res->fetchpool);
+	isc_mempool_setname(res->fetchpool, "fetch");
+	isc_mempool_create_shared(res->mctx, sizeof(resquery_t),
+				  &res->querypool);
+	isc_mempool_setname(res->querypool, "query");
+
 	res->magic = RES_MAGIC;
 
 	*resp = res;
@@ -10199,6 +11049,165 @@ dns_resolver_prime(dns_resolver_t *res) {
 	}
 }
 
+static void
+refresh_release(refresh_t *refresh) {
+	dns_resolver_t *res = refresh->res;
+
+	INSIST(refresh->timer == NULL);
+	INSIST(refresh->rlevent == NULL);
+	INSIST(refresh->fetch == NULL);
+
+	if (ISC_LINK_LINKED(refresh, link)) {
+		ISC_LIST_UNLINK(res->refreshes, refresh, link);
+		res->nrefreshes--;
+	}
+
+	isc_mem_put(res->mctx, refresh, sizeof(*refresh));
+	dns_resolver_detach(&res);
+}
+
+static void
+refresh_done(void *arg) {
+	dns_fetchresponse_t *resp = (dns_fetchresponse_t *)arg;
+	refresh_t *refresh = resp->arg;
+
+	if (resp->node != NULL) {
+		dns_db_detachnode(resp->db, &resp->node);
+	}
+	if (resp->db != NULL) {
+		dns_db_detach(&resp->db);
+	}
+	if (dns_rdataset_isassociated(resp->rdataset)) {
+		dns_rdataset_disassociate(resp->rdataset);
+	}
+	INSIST(resp->sigrdataset == NULL);
+
+	dns_resolver_freefresp(&resp);
+	dns_resolver_destroyfetch(&refresh->fetch);
+	refresh_release(refresh);
+}
+
+/*
+ * The ratelimiter let the refresh through: start a prefetch-style fetch
+ * so the cached RRset is replaced before it expires.
+ */
+static void
+refresh_start(void *arg) {
+	refresh_t *refresh = arg;
+	dns_resolver_t *res = refresh->res;
+	bool canceled = refresh->rlevent->canceled;
+	isc_result_t result;
+
+	isc_rlevent_free(&refresh->rlevent);
+
+	if (canceled || atomic_load_acquire(&res->exiting)) {
+		refresh_release(refresh);
+		return;
+	}
+
+	dns_rdataset_init(&refresh->rdataset);
+	result = dns_resolver_createfetch(
+		res, refresh->name, refresh->type, NULL, NULL, NULL, NULL, 0,
+		DNS_FETCHOPT_PREFETCH, 0, NULL, NULL, isc_loop(), refresh_done,
+		refresh, &refresh->rdataset, NULL, &refresh->fetch);
+	if (result != ISC_R_SUCCESS) {
+		refresh_release(refresh);
+		return;
+	}
+
+	inc_stats(res, dns_resstatscounter_refreshsent);
+}
+
+static void
+refresh_timer(void *arg) {
+	refresh_t *refresh = arg;
+	dns_resolver_t *res = refresh->res;
+	isc_result_t result;
+
+	isc_timer_destroy(&refresh->timer);
+
+	result = isc_ratelimiter_enqueue(res->refreshrl, isc_loop(),
+					 refresh_start, refresh,
+					 &refresh->rlevent);
+	if (result != ISC_R_SUCCESS) {
+		refresh_release(refresh);
+	}
+}
+
+static void
+refresh_schedule(void *arg) {
+	refresh_t *refresh = arg;
+	dns_resolver_t *res = refresh->res;
+	isc_interval_t interval;
+
+	if (atomic_load_acquire(&res->exiting)) {
+		refresh_release(refresh);
+		return;
+	}
+
+	if (res->nrefreshes >= res->refreshlimit) {
+		inc_stats(res, dns_resstatscounter_refreshdropped);
+		refresh_release(refresh);
+		return;
+	}
+
+	ISC_LIST_APPEND(res->refreshes, refresh, link);
+	res->nrefreshes++;
+
+	isc_interval_set(&interval, refresh->delay, 0);
+	isc_timer_create(isc_loop(), refresh_timer, refresh, &refresh->timer);
+	isc_timer_start(refresh->timer, isc_timertype_once, &interval);
+}
+
+/*
+ * Cancel the refreshes that are still waiting for their timer.  The
+ * ones queued on the ratelimiter are canceled by shutting it down, and
+ * the fetches in progress are stopped with the rest of the fetches.
+ */
+static void
+refresh_shutdown(void *arg) {
+	dns_resolver_t *res = arg;
+	refresh_t *refresh = NULL, *next = NULL;
+
+	ISC_LIST_FOREACH_SAFE (res->refreshes, refresh, link, next) {
+		if (refresh->timer != NULL) {
+			isc_timer_stop(refresh->timer);
+			isc_timer_destroy(&refresh->timer);
+			refresh_release(refresh);
+		}
+	}
+
+	isc_ratelimiter_shutdown(res->refreshrl);
+	dns_resolver_unref(res);
+}
+
+void
+dns_resolver_refresh(dns_resolver_t *res, const dns_name_t *name,
+		     dns_rdatatype_t type, dns_ttl_t ttl) {
+	refresh_t *refresh = NULL;
+
+	REQUIRE(VALID_RESOLVER(res));
+	REQUIRE(res->frozen);
+
+	if (res->refreshlimit == 0 || ttl < REFRESH_MIN_TTL ||
+	    atomic_load_acquire(&res->exiting))
+	{
+		return;
+	}
+
+	refresh = isc_mem_get(res->mctx, sizeof(*refresh));
+	*refresh = (refresh_t){
+		.type = type,
+		.delay = ttl - REFRESH_LEAD,
+		.link = ISC_LINK_INITIALIZER,
+	};
+	refresh->name = dns_fixedname_initname(&refresh->fname);
+	dns_name_copy(name, refresh->name);
+	dns_resolver_attach(res, &refresh->res);
+
+	isc_async_run(isc_loop_main(res->loopmgr), refresh_schedule, refresh);
+}
+
 void
 dns_resolver_freeze(dns_resolver_t *res) {
 	/*
@@ -10212,7 +11221,6 @@ dns_resolver_freeze(dns_resolver_t *res) {
 
 void
 dns_resolver_shutdown(dns_resolver_t *res) {
-	isc_result_t result;
 	bool is_false = false;
 
 	REQUIRE(VALID_RESOLVER(res));
@@ -10220,32 +11228,33 @@ dns_resolver_shutdown(dns_resolver_t *res) {
 	RTRACE("shutdown");
 
 	if (atomic_compare_exchange_strong(&res->exiting, &is_false, true)) {
-		isc_hashmap_iter_t *it = NULL;
+		struct cds_lfht_iter iter;
+		fetchctx_t *fctx = NULL;
 
 		RTRACE("exiting");
 
-		RWLOCK(&res->fctxs_lock, isc_rwlocktype_write);
-		isc_hashmap_iter_create(res->fctxs, &it);
-		for (result = isc_hashmap_iter_first(it);
-		     result == ISC_R_SUCCESS;
-		     result = isc_hashmap_iter_next(it))
-		{
-			fetchctx_t *fctx = NULL;
-
-			isc_hashmap_iter_current(it, (void **)&fctx);
-			INSIST(fctx != NULL);
-
-			fetchctx_ref(fctx);
-			isc_async_run(fctx->loop, fctx_shutdown, fctx);
+		rcu_read_lock();
+		cds_lfht_for_each_entry(res->fctxs, &iter, fctx, ht_node) {
+			/* skip the fctxs that release_fctx() got to first */
+			LOCK(&fctx->lock);
+			if (!cds_lfht_is_node_deleted(&fctx->ht_node)) {
+				fetchctx_ref(fctx);
+				isc_async_run(fctx->loop, fctx_shutdown, fctx);
+			}
+			UNLOCK(&fctx->lock);
 		}
-		isc_hashmap_iter_destroy(&it);
-		RWUNLOCK(&res->fctxs_lock, isc_rwlocktype_write);
+		rcu_read_unlock();
 
 		LOCK(&res->lock);
 		if (res->spillattimer != NULL) {
 			isc_timer_async_destroy(&res->spillattimer);
 		}
 		UNLOCK(&res->lock);
+
+		if (res->refreshrl != NULL) {
+			isc_async_run(isc_loop_main(res->loopmgr),
+				      refresh_shutdown, dns_resolver_ref(res));
+		}
 	}
 }
 
@@ -10393,64 +11402,71 @@ get_attached_fctx(dns_resolver_t *res, isc_loop_t *loop, const dns_name_t *name,
 		.type = type,
 	};
 	fetchctx_t *fctx = NULL;
-	isc_rwlocktype_t locktype = isc_rwlocktype_read;
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *ht_node = NULL;
 	uint32_t hashval = fctx_hash(&key);
 
 again:
-	RWLOCK(&res->fctxs_lock, locktype);
-	result = isc_hashmap_find(res->fctxs, hashval, fctx_match, &key,
-				  (void **)&fctx);
-	switch (result) {
-	case ISC_R_SUCCESS:
-		break;
-	case ISC_R_NOTFOUND:
+	rcu_read_lock();
+	cds_lfht_lookup(res->fctxs, hashval, fctx_match, &key, &iter);
+	ht_node = cds_lfht_iter_get_node(&iter);
+	if (ht_node == NULL) {
+		rcu_read_unlock();
+
 		result = fctx_create(res, loop, name, type, domain, nameservers,
 				     client, options, depth, qc, gqc, &fctx);
 		if (result != ISC_R_SUCCESS) {
-			goto unlock;
+			return result;
 		}
 
-		UPGRADELOCK(&res->fctxs_lock, locktype);
-
-		void *found = NULL;
-		result = isc_hashmap_add(res->fctxs, hashval, fctx_match, fctx,
-					 fctx, &found);
-		if (result == ISC_R_SUCCESS) {
+		fctx->hashed = true;
+		rcu_read_lock();
+		ht_node = cds_lfht_add_unique(res->fctxs, hashval, fctx_match,
+					      fctx, &fctx->ht_node);
+		if (ht_node == &fctx->ht_node) {
 			*new_fctx = true;
-			fctx->hashed = true;
 		} else {
-			fctx_done_detach(&fctx, result);
-			fctx = found;
-			result = ISC_R_SUCCESS;
+			fctx->hashed = false;
+			fctx_done_detach(&fctx, ISC_R_EXISTS);
+			inc_stats(res, dns_resstatscounter_fctxrace);
 		}
-		INSIST(result == ISC_R_SUCCESS);
-		break;
-	default:
-		UNREACHABLE();
+	}
+	fctx = caa_container_of(ht_node, fetchctx_t, ht_node);
+
+	/*
+	 * Until the RCU read lock is released the fctx can't be freed,
+	 * but it can be removed from the table by release_fctx() and
+	 * lose its last reference, so we must check that it's still
+	 * there under the fctx lock (which release_fctx() needs) before
+	 * taking a new reference.
+	 */
+	LOCK(&fctx->lock);
+	if (cds_lfht_is_node_deleted(&fctx->ht_node)) {
+		UNLOCK(&fctx->lock);
+		rcu_read_unlock();
+		inc_stats(res, dns_resstatscounter_fctxrace);
+		goto again;
 	}
 	fetchctx_ref(fctx);
-unlock:
-	RWUNLOCK(&res->fctxs_lock, locktype);
-	if (result == ISC_R_SUCCESS) {
-		LOCK(&fctx->lock);
-		if (SHUTTINGDOWN(fctx) || fctx->cloned) {
-			/*
-			 * This is the single place where fctx might get
-			 * accesses from a different thread, so we need to
-			 * double check whether fctxs is done (or cloned) and
-			 * help with the release if the fctx has been cloned.
-			 */
-			release_fctx(fctx);
-			UNLOCK(&fctx->lock);
-			fetchctx_detach(&fctx);
-			goto again;
-		}
+	rcu_read_unlock();
 
-		INSIST(!SHUTTINGDOWN(fctx));
-		*fctxp = fctx;
+	if (SHUTTINGDOWN(fctx) || fctx->cloned) {
+		/*
+		 * This is the single place where fctx might get
+		 * accesses from a different thread, so we need to
+		 * double check whether fctxs is done (or cloned) and
+		 * help with the release if the fctx has been cloned.
+		 */
+		release_fctx(fctx);
+		UNLOCK(&fctx->lock);
+		fetchctx_detach(&fctx);
+		goto again;
 	}
 
-	return result;
+	INSIST(!SHUTTINGDOWN(fctx));
+	*fctxp = fctx;
+
+	return ISC_R_SUCCESS;
 }
 
 isc_result_t
@@ -10471,7 +11487,6 @@ dns_resolver_createfetch(dns_resolver_t *res, const dns_name_t *name,
 	unsigned int count = 0;
 	unsigned int spillat;
 	unsigned int spillatmin;
-	isc_mem_t *mctx = isc_loop_getmctx(loop);
 
 	UNUSED(forwarders);
 
@@ -10495,11 +11510,10 @@ dns_resolver_createfetch(dns_resolver_t *res, const dns_name_t *name,
 
 	log_fetch(name, type);
 
-	fetch = isc_mem_get(mctx, sizeof(*fetch));
+	fetch = isc_mempool_get(res->fetchpool);
 	*fetch = (dns_fetch_t){ 0 };
 
 	dns_resolver_attach(res, &fetch->res);
-	isc_mem_attach(mctx, &fetch->mctx);
 
 	if ((options & DNS_FETCHOPT_UNSHARED) == 0) {
 		/*
@@ -10580,7 +11594,7 @@ unlock:
 fail:
 	if (result != ISC_R_SUCCESS) {
 		dns_resolver_detach(&fetch->res);
-		isc_mem_putanddetach(&fetch->mctx, fetch, sizeof(*fetch));
+		isc_mempool_put(res->fetchpool, fetch);
 		return result;
 	}
 
@@ -10664,7 +11678,7 @@ dns_resolver_destroyfetch(dns_fetch_t **fetchp) {
 	}
 	UNLOCK(&fctx->lock);
 
-	isc_mem_putanddetach(&fetch->mctx, fetch, sizeof(*fetch));
+	isc_mempool_put(res->fetchpool, fetch);
 
 	fetchctx_detach(&fctx);
 	dns_resolver_detach(&res);
@@ -10844,6 +11858,51 @@ dns_resolver_setzeronosoattl(dns_resolver_t *resolver, bool state) {
 	resolver->zero_no_soa_ttl = state;
 }
 
+void
+dns_resolver_sethedging(dns_resolver_t *resolver, bool state) {
+	REQUIRE(VALID_RESOLVER(resolver));
+
+	resolver->hedging = state;
+}
+
+void
+dns_resolver_setrefresh(dns_resolver_t *resolver, unsigned int limit,
+			unsigned int rate) {
+	isc_interval_t interval;
+	uint32_t pertic = 1;
+
+	REQUIRE(VALID_RESOLVER(resolver));
+	REQUIRE(!resolver->frozen);
+
+	resolver->refreshlimit = limit;
+	if (limit == 0) {
+		return;
+	}
+
+	if (resolver->refreshrl == NULL) {
+		isc_ratelimiter_create(isc_loop_main(resolver->loopmgr),
+				       &resolver->refreshrl);
+	}
+
+	/*
+	 * Same pacing as the zone manager: up to ten refreshes per tick
+	 * for higher rates, so the timer doesn't fire too often.
+	 */
+	if (rate == 0) {
+		rate = 1;
+	}
+	if (rate == 1) {
+		isc_interval_set(&interval, 1, 0);
+	} else if (rate <= 10) {
+		isc_interval_set(&interval, 0, NS_PER_SEC / rate);
+	} else {
+		isc_interval_set(&interval, 0, (NS_PER_SEC / rate) * 10);
+		pertic = 10;
+	}
+	isc_ratelimiter_setinterval(resolver->refreshrl, &interval);
+	isc_ratelimiter_setpertic(resolver->refreshrl, pertic);
+}
+
 unsigned int
 dns_resolver_getoptions(dns_resolver_t *resolver) {
 	REQUIRE(VALID_RESOLVER(resolver));
@@ -11047,6 +12106,16 @@ dns_resolver_incstats(dns_resolver_t *res, isc_statscounter_t counter) {
 	isc_stats_increment(res->stats, counter);
 }
 
+void
+dns_resolver_addstats(dns_resolver_t *res, isc_statscounter_t counter,
+		      uint64_t value) {
+	REQUIRE(VALID_RESOLVER(res));
+
+	if (res->stats != NULL) {
+		isc_stats_add(res->stats, counter, value);
+	}
+}
+
 void
 dns_resolver_setquerystats(dns_resolver_t *res, dns_stats_t *stats) {
 	REQUIRE(VALID_RESOLVER(res));
@@ -36,6 +36,7 @@
 #include <dns/db.h>
 #include <dns/dbiterator.h>
 #include <dns/fixedname.h>
+#include <dns/journal.h>
 #include <dns/qp.h>
 #include <dns/rdata.h>
 #include <dns/rdataset.h>
@@ -96,6 +97,13 @@
 #define DNS_RPZ_HTSIZE_MAX 24
 #define DNS_RPZ_HTSIZE_DIV 3
 
+/*
+ * Policy zones can be big and are updated often, so the summary trie is
+ * compacted a piece at a time: this is how many cells each committed
+ * batch of changes may spend on it.
+ */
+#define DNS_RPZ_COMPACT_BUDGET (64 * 1024)
+
 static isc_result_t
 dns__rpz_shuttingdown(dns_rpz_zones_t *rpzs);
 static void
@@ -1515,6 +1523,7 @@ dns_rpz_new_zones(dns_view_t *view, isc_loopmgr_t *loopmgr,
 	isc_refcount_init(&rpzs->references, 1);
 
 	dns_qpmulti_create(mctx, &qpmethods, view, &rpzs->table);
+	dns_qpmulti_setcompactbudget(rpzs->table, DNS_RPZ_COMPACT_BUDGET);
 
 	isc_mem_attach(mctx, &rpzs->mctx);
 
@@ -1602,6 +1611,7 @@ dns_rpz_dbupdate_callback(dns_db_t *db, void *fn_arg) {
 	if (rpz->db == NULL) {
 		RUNTIME_CHECK(rpz->dbversion == NULL);
 		dns_db_attach(db, &rpz->db);
+		rpz->newdb = true;
 	}
 
 	if (!rpz->updatepending && !rpz->updaterunning) {
@@ -1645,6 +1655,21 @@ dns_rpz_dbupdate_register(dns_db_t *db, dns_rpz_zone_t *rpz) {
 
 	dns_db_updatenotify_register(db, dns_rpz_dbupdate_callback, rpz);
 }
+
+void
+dns_rpz_setjournal(dns_rpz_zone_t *rpz, const char *journal) {
+	REQUIRE(DNS_RPZ_ZONE_VALID(rpz));
+
+	LOCK(&rpz->rpzs->maint_lock);
+	if (rpz->journal != NULL) {
+		isc_mem_free(rpz->rpzs->mctx, rpz->journal);
+	}
+	if (journal != NULL) {
+		rpz->journal = isc_mem_strdup(rpz->rpzs->mctx, journal);
+	}
+	UNLOCK(&rpz->rpzs->maint_lock);
+}
+
 static void
 dns__rpz_timer_start(dns_rpz_zone_t *rpz) {
 	uint64_t tdiff;
@@ -1860,6 +1885,147 @@ cleanup:
 	return result;
 }
 
+/*
+ * Add a name to the summary data or remove it, depending on whether it
+ * has any records in the version being loaded.
+ */
+static isc_result_t
+update_name(dns_rpz_zone_t *rpz, const dns_name_t *src_name,
+	    const char *domain) {
+	isc_result_t result;
+	dns_fixedname_t fixname;
+	dns_name_t *name = dns_fixedname_initname(&fixname);
+	dns_dbnode_t *node = NULL;
+	dns_rdatasetiter_t *rdsiter = NULL;
+	char namebuf[DNS_NAME_FORMATSIZE];
+	bool exists = false, found;
+
+	dns_name_downcase(src_name, name, NULL);
+
+	result = dns_db_findnode(rpz->updb, name, false, &node);
+	if (result == ISC_R_SUCCESS) {
+		result = dns_db_allrdatasets(rpz->updb, node, rpz->updbversion,
+					     0, 0, &rdsiter);
+		if (result == ISC_R_SUCCESS) {
+			exists = (dns_rdatasetiter_first(rdsiter) ==
+				  ISC_R_SUCCESS);
+			dns_rdatasetiter_destroy(&rdsiter);
+		}
+		dns_db_detachnode(rpz->updb, &node);
+	}
+	if (result != ISC_R_SUCCESS && result != ISC_R_NOTFOUND) {
+		return result;
+	}
+
+	found = (isc_ht_find(rpz->nodes, name->ndata, name->length, NULL) ==
+		 ISC_R_SUCCESS);
+	if (exists && !found) {
+		result = isc_ht_add(rpz->nodes, name->ndata, name->length,
+				    rpz);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+
+		LOCK(&rpz->rpzs->maint_lock);
+		result = rpz_add(rpz, name);
+		UNLOCK(&rpz->rpzs->maint_lock);
+
+		if (result != ISC_R_SUCCESS) {
+			dns_name_format(name, namebuf, sizeof(namebuf));
+			isc_log_write(DNS_LOGCATEGORY_GENERAL,
+				      DNS_LOGMODULE_RPZ, ISC_LOG_ERROR,
+				      "rpz: %s: adding node %s "
+				      "to RPZ error %s",
+				      domain, namebuf,
+				      isc_result_totext(result));
+		}
+	} else if (!exists && found) {
+		isc_ht_delete(rpz->nodes, name->ndata, name->length);
+
+		LOCK(&rpz->rpzs->maint_lock);
+		rpz_del(rpz, name);
+		UNLOCK(&rpz->rpzs->maint_lock);
+	}
+
+	return ISC_R_SUCCESS;
+}
+
+/*
+ * Bring the summary data from version 'from' of the policy zone to the
+ * version being loaded by checking only the names that the journal
+ * says were changed in between, instead of walking the whole database.
+ * Any failure other than shutting down leaves rpz->nodes in step with
+ * the summary data, so that a full walk can follow.
+ */
+static isc_result_t
+update_from_journal(dns_rpz_zone_t *rpz, uint32_t from, uint32_t to) {
+	isc_result_t result;
+	dns_journal_t *journal = NULL;
+	isc_ht_t *seen = NULL;
+	char domain[DNS_NAME_FORMATSIZE];
+
+	LOCK(&rpz->rpzs->maint_lock);
+	if (rpz->journal != NULL) {
+		result = dns_journal_open(rpz->rpzs->mctx, rpz->journal,
+					  DNS_JOURNAL_READ, &journal);
+	} else {
+		result = ISC_R_NOTFOUND;
+	}
+	UNLOCK(&rpz->rpzs->maint_lock);
+	if (result != ISC_R_SUCCESS) {
+		return result;
+	}
+
+	result = dns_journal_iter_init(journal, from, to, NULL);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	dns_name_format(&rpz->origin, domain, DNS_NAME_FORMATSIZE);
+	isc_log_write(DNS_LOGCATEGORY_GENERAL, DNS_LOGMODULE_RPZ,
+		      ISC_LOG_DEBUG(1),
+		      "rpz: %s: applying the changes from serial %u to %u",
+		      domain, from, to);
+
+	/*
+	 * A name is usually in the journal more than once: check it once.
+	 */
+	isc_ht_init(&seen, rpz->rpzs->mctx, 1, ISC_HT_CASE_INSENSITIVE);
+
+	for (result = dns_journal_first_rr(journal); result == ISC_R_SUCCESS;
+	     result = dns_journal_next_rr(journal))
+	{
+		dns_name_t *name = NULL;
+		dns_rdata_t *rdata = NULL;
+		uint32_t ttl;
+
+		result = dns__rpz_shuttingdown(rpz->rpzs);
+		if (result != ISC_R_SUCCESS) {
+			goto cleanup;
+		}
+
+		dns_journal_current_rr(journal, &name, &ttl, &rdata);
+		if (isc_ht_add(seen, name->ndata, name->length, rpz) !=
+		    ISC_R_SUCCESS)
+		{
+			continue;
+		}
+
+		result = update_name(rpz, name, domain);
+		if (result != ISC_R_SUCCESS) {
+			goto cleanup;
+		}
+	}
+	if (result == ISC_R_NOMORE) {
+		result = ISC_R_SUCCESS;
+	}
+
+cleanup:
+	if (seen != NULL) {
+		isc_ht_destroy(&seen);
+	}
+	dns_journal_destroy(&journal);
+	return result;
+}
+
 static isc_result_t
 cleanup_nodes(dns_rpz_zone_t *rpz) {
 	isc_result_t result;
@@ -1922,6 +2088,8 @@ update_rpz_cb(void *data) {
 	dns_rpz_zone_t *rpz = (dns_rpz_zone_t *)data;
 	isc_result_t result = ISC_R_SUCCESS;
 	isc_ht_t *newnodes = NULL;
+	uint32_t serial = 0;
+	bool haveserial;
 
 	REQUIRE(rpz->nodes != NULL);
 
@@ -1930,6 +2098,20 @@ update_rpz_cb(void *data) {
 		goto shuttingdown;
 	}
 
+	haveserial = (dns_db_getsoaserial(rpz->updb, rpz->updbversion,
+					  &serial) == ISC_R_SUCCESS);
+
+	/*
+	 * Apply only the changes since the previous update if the
+	 * journal has them; otherwise walk the whole new version.
+	 */
+	if (!rpz->updfull && haveserial) {
+		result = update_from_journal(rpz, rpz->serial, serial);
+		if (result == ISC_R_SUCCESS || result == ISC_R_SHUTTINGDOWN) {
+			goto done;
+		}
+	}
+
 	isc_ht_init(&newnodes, rpz->rpzs->mctx, 1, ISC_HT_CASE_SENSITIVE);
 
 	result = update_nodes(rpz, newnodes);
@@ -1948,6 +2130,10 @@ update_rpz_cb(void *data) {
 cleanup:
 	isc_ht_destroy(&newnodes);
 
+done:
+	rpz->haveserial = (result == ISC_R_SUCCESS && haveserial);
+	rpz->serial = serial;
+
 shuttingdown:
 	rpz->updateresult = result;
 }
@@ -1971,6 +2157,8 @@ dns__rpz_timer_cb(void *arg) {
 	rpz->updatepending = false;
 	rpz->updaterunning = true;
 	rpz->updateresult = ISC_R_UNSET;
+	rpz->updfull = rpz->newdb || !rpz->haveserial;
+	rpz->newdb = false;
 
 	dns_db_attach(rpz->db, &rpz->updb);
 	INSIST(rpz->dbversion != NULL);
@@ -2085,6 +2273,10 @@ dns_rpz_zone_destroy(dns_rpz_zone_t **rpzp) {
 	}
 	INSIST(!rpz->updaterunning);
 
+	if (rpz->journal != NULL) {
+		isc_mem_free(rpzs->mctx, rpz->journal);
+	}
+
 	isc_ht_destroy(&rpz->nodes);
 
 	isc_mem_put(rpzs->mctx, rpz, sizeof(*rpz));
@@ -2390,13 +2582,9 @@ dns_rpz_find_ip(dns_rpz_zones_t *rpzs, dns_rpz_type_t rpz_type,
 	dns_rpz_cidr_node_t *found = NULL;
 	isc_result_t result;
 	dns_rpz_num_t rpz_num = 0;
-	dns_rpz_have_t have;
+	const dns_rpz_have_t *have = NULL;
 	int i;
 
-	RWLOCK(&rpzs->search_lock, isc_rwlocktype_read);
-	have = rpzs->have;
-	RWUNLOCK(&rpzs->search_lock, isc_rwlocktype_read);
-
 	/*
 	 * Convert IP address to CIDR tree key.
 	 */
@@ -2405,20 +2593,6 @@ dns_rpz_find_ip(dns_rpz_zones_t *rpzs, dns_rpz_type_t rpz_type,
 		tgt_ip.w[1] = 0;
 		tgt_ip.w[2] = ADDR_V4MAPPED;
 		tgt_ip.w[3] = ntohl(netaddr->type.in.s_addr);
-		switch (rpz_type) {
-		case DNS_RPZ_TYPE_CLIENT_IP:
-			zbits &= have.client_ipv4;
-			break;
-		case DNS_RPZ_TYPE_IP:
-			zbits &= have.ipv4;
-			break;
-		case DNS_RPZ_TYPE_NSIP:
-			zbits &= have.nsipv4;
-			break;
-		default:
-			UNREACHABLE();
-			break;
-		}
 	} else if (netaddr->family == AF_INET6) {
 		dns_rpz_cidr_key_t src_ip6;
 
@@ -2431,30 +2605,38 @@ dns_rpz_find_ip(dns_rpz_zones_t *rpzs, dns_rpz_type_t rpz_type,
 		for (i = 0; i < 4; i++) {
 			tgt_ip.w[i] = ntohl(src_ip6.w[i]);
 		}
-		switch (rpz_type) {
-		case DNS_RPZ_TYPE_CLIENT_IP:
-			zbits &= have.client_ipv6;
-			break;
-		case DNS_RPZ_TYPE_IP:
-			zbits &= have.ipv6;
-			break;
-		case DNS_RPZ_TYPE_NSIP:
-			zbits &= have.nsipv6;
-			break;
-		default:
-			UNREACHABLE();
-			break;
-		}
 	} else {
 		return DNS_RPZ_INVALID_NUM;
 	}
 
+	/*
+	 * Check which zones have triggers of this type and family and
+	 * search for them under the same lock.
+	 */
+	RWLOCK(&rpzs->search_lock, isc_rwlocktype_read);
+	have = &rpzs->have;
+	switch (rpz_type) {
+	case DNS_RPZ_TYPE_CLIENT_IP:
+		zbits &= (netaddr->family == AF_INET) ? have->client_ipv4
+						      : have->client_ipv6;
+		break;
+	case DNS_RPZ_TYPE_IP:
+		zbits &= (netaddr->family == AF_INET) ? have->ipv4 : have->ipv6;
+		break;
+	case DNS_RPZ_TYPE_NSIP:
+		zbits &= (netaddr->family == AF_INET) ? have->nsipv4
+						      : have->nsipv6;
+		break;
+	default:
+		UNREACHABLE();
+	}
+
 	if (zbits == 0) {
+		RWUNLOCK(&rpzs->search_lock, isc_rwlocktype_read);
 		return DNS_RPZ_INVALID_NUM;
 	}
 	make_addr_set(&tgt_set, zbits, rpz_type);
 
-	RWLOCK(&rpzs->search_lock, isc_rwlocktype_read);
 	result = search(rpzs, &tgt_ip, 128, &tgt_set, false, &found);
 	if (result == ISC_R_NOTFOUND) {
 		/*
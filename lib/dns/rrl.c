@@ -39,8 +39,8 @@
 #include <dns/zone.h>
 
 static void
-log_end(dns_rrl_t *rrl, dns_rrl_entry_t *e, bool early, char *log_buf,
-	unsigned int log_buf_len);
+log_end(dns_rrl_shard_t *shard, dns_rrl_entry_t *e, bool early,
+	char *log_buf, unsigned int log_buf_len);
 
 /*
  * Get a modulus for a hash function that is tolerably likely to be
@@ -138,21 +138,22 @@ delta_rrl_time(isc_stdtime_t ts, isc_stdtime_t now) {
 }
 
 static int
-get_age(const dns_rrl_t *rrl, const dns_rrl_entry_t *e, isc_stdtime_t now) {
+get_age(const dns_rrl_shard_t *shard, const dns_rrl_entry_t *e,
+	isc_stdtime_t now) {
 	if (!e->ts_valid) {
 		return DNS_RRL_FOREVER;
 	}
-	return delta_rrl_time(e->ts + rrl->ts_bases[e->ts_gen], now);
+	return delta_rrl_time(e->ts + shard->ts_bases[e->ts_gen], now);
 }
 
 static void
-set_age(dns_rrl_t *rrl, dns_rrl_entry_t *e, isc_stdtime_t now) {
+set_age(dns_rrl_shard_t *shard, dns_rrl_entry_t *e, isc_stdtime_t now) {
 	dns_rrl_entry_t *e_old;
 	unsigned int ts_gen;
 	int i, ts;
 
-	ts_gen = rrl->ts_gen;
-	ts = now - rrl->ts_bases[ts_gen];
+	ts_gen = shard->ts_gen;
+	ts = now - shard->ts_bases[ts_gen];
 	if (ts < 0) {
 		if (ts < -DNS_RRL_MAX_TIME_TRAVEL) {
 			ts = DNS_RRL_FOREVER;
@@ -175,26 +176,27 @@ set_age(dns_rrl_t *rrl, dns_rrl_entry_t *e, isc_stdtime_t now) {
 	 */
 	if (ts >= DNS_RRL_MAX_TS) {
 		ts_gen = (ts_gen + 1) % DNS_RRL_TS_BASES;
-		for (e_old = ISC_LIST_TAIL(rrl->lru), i = 0;
-		     e_old != NULL && (e_old->ts_gen == ts_gen ||
-				       !ISC_LINK_LINKED(e_old, hlink));
+		for (e_old = ISC_LIST_TAIL(shard->lru), i = 0;
+		     e_old != NULL &&
+		     (e_old->ts_gen == ts_gen || !e_old->hashed);
 		     e_old = ISC_LIST_PREV(e_old, lru), ++i)
 		{
 			e_old->ts_valid = false;
 		}
 		if (i != 0) {
+			isc_stdtime_t *bases = shard->ts_bases;
 			isc_log_write(
 				DNS_LOGCATEGORY_RRL, DNS_LOGMODULE_REQUEST,
 				DNS_RRL_LOG_DEBUG1,
 				"rrl new time base scanned %d entries"
 				" at %d for %d %d %d %d",
-				i, now, rrl->ts_bases[ts_gen],
-				rrl->ts_bases[(ts_gen + 1) % DNS_RRL_TS_BASES],
-				rrl->ts_bases[(ts_gen + 2) % DNS_RRL_TS_BASES],
-				rrl->ts_bases[(ts_gen + 3) % DNS_RRL_TS_BASES]);
+				i, now, bases[ts_gen],
+				bases[(ts_gen + 1) % DNS_RRL_TS_BASES],
+				bases[(ts_gen + 2) % DNS_RRL_TS_BASES],
+				bases[(ts_gen + 3) % DNS_RRL_TS_BASES]);
 		}
-		rrl->ts_gen = ts_gen;
-		rrl->ts_bases[ts_gen] = now;
+		shard->ts_gen = ts_gen;
+		shard->ts_bases[ts_gen] = now;
 		ts = 0;
 	}
 
@@ -204,17 +206,24 @@ set_age(dns_rrl_t *rrl, dns_rrl_entry_t *e, isc_stdtime_t now) {
 }
 
 static isc_result_t
-expand_entries(dns_rrl_t *rrl, int newsize) {
+expand_entries(dns_rrl_shard_t *shard, int newsize) {
+	dns_rrl_t *rrl = shard->rrl;
 	unsigned int bsize;
 	dns_rrl_block_t *b;
 	dns_rrl_entry_t *e;
 	double rate;
-	int i;
+	int i, max_entries;
 
-	if (rrl->num_entries + newsize >= rrl->max_entries &&
-	    rrl->max_entries != 0)
-	{
-		newsize = rrl->max_entries - rrl->num_entries;
+	/*
+	 * Each shard gets an even share of the maximum.
+	 */
+	max_entries = rrl->max_entries / rrl->nshards;
+	if (rrl->max_entries != 0 && max_entries == 0) {
+		max_entries = 1;
+	}
+
+	if (shard->num_entries + newsize >= max_entries && max_entries != 0) {
+		newsize = max_entries - shard->num_entries;
 		if (newsize <= 0) {
 			return ISC_R_SUCCESS;
 		}
@@ -224,17 +233,17 @@ expand_entries(dns_rrl_t *rrl, int newsize) {
 	 * Log expansions so that the user can tune max-table-size
 	 * and min-table-size.
 	 */
-	if (isc_log_wouldlog(DNS_RRL_LOG_DROP) && rrl->hash != NULL) {
-		rate = rrl->probes;
-		if (rrl->searches != 0) {
-			rate /= rrl->searches;
+	if (isc_log_wouldlog(DNS_RRL_LOG_DROP) && shard->hash != NULL) {
+		rate = shard->probes;
+		if (shard->searches != 0) {
+			rate /= shard->searches;
 		}
 		isc_log_write(DNS_LOGCATEGORY_RRL, DNS_LOGMODULE_REQUEST,
 			      DNS_RRL_LOG_DROP,
 			      "increase from %d to %d RRL entries with"
 			      " %d bins; average search length %.1f",
-			      rrl->num_entries, rrl->num_entries + newsize,
-			      rrl->hash->length, rate);
+			      shard->num_entries, shard->num_entries + newsize,
+			      shard->hash->length, rate);
 	}
 
 	bsize = sizeof(dns_rrl_block_t) +
@@ -244,123 +253,238 @@ expand_entries(dns_rrl_t *rrl, int newsize) {
 
 	e = b->entries;
 	for (i = 0; i < newsize; ++i, ++e) {
-		ISC_LINK_INIT(e, hlink);
-		ISC_LIST_INITANDAPPEND(rrl->lru, e, lru);
+		ISC_LIST_INITANDAPPEND(shard->lru, e, lru);
 	}
-	rrl->num_entries += newsize;
-	ISC_LIST_INITANDAPPEND(rrl->blocks, b, link);
+	shard->num_entries += newsize;
+	ISC_LIST_INITANDAPPEND(shard->blocks, b, link);
 
 	return ISC_R_SUCCESS;
 }
 
-static dns_rrl_bin_t *
-get_bin(dns_rrl_hash_t *hash, unsigned int hval) {
-	INSIST(hash != NULL);
-	return &hash->bins[hval % hash->length];
+/*
+ * The number of slots between the slot of a hash value and slot 'i'.
+ */
+static int
+bin_distance(const dns_rrl_hash_t *hash, uint32_t hval, int i) {
+	return (i + hash->length - (int)(hval % hash->length)) % hash->length;
+}
+
+/*
+ * Add an entry, displacing entries that are nearer to their own slot
+ * than the new one is, so that a search can stop at the first entry
+ * that is nearer to its slot than the searched one would be.
+ * There must be a free slot.
+ */
+static void
+hash_insert(dns_rrl_hash_t *hash, uint32_t hval, dns_rrl_entry_t *e) {
+	dns_rrl_bin_t new = { .hval = hval, .e = e }, tmp;
+	int i = hval % hash->length, dist = 0, d;
+
+	INSIST(hash->count < hash->length);
+
+	while (hash->bins[i].e != NULL) {
+		d = bin_distance(hash, hash->bins[i].hval, i);
+		if (d < dist) {
+			tmp = hash->bins[i];
+			hash->bins[i] = new;
+			new = tmp;
+			dist = d;
+		}
+		i = (i + 1) % hash->length;
+		++dist;
+	}
+	hash->bins[i] = new;
+	++hash->count;
+}
+
+/*
+ * Empty slot 'i', shifting the following displaced entries back
+ * instead of leaving a tombstone.
+ */
+static void
+hash_remove(dns_rrl_hash_t *hash, int i) {
+	int next = (i + 1) % hash->length;
+
+	while (hash->bins[next].e != NULL &&
+	       bin_distance(hash, hash->bins[next].hval, next) > 0)
+	{
+		hash->bins[i] = hash->bins[next];
+		i = next;
+		next = (next + 1) % hash->length;
+	}
+	hash->bins[i] = (dns_rrl_bin_t){ 0 };
+	--hash->count;
+}
+
+/*
+ * Find the slot of an entry that is in the table.
+ */
+static int
+hash_slot(const dns_rrl_hash_t *hash, uint32_t hval,
+	  const dns_rrl_entry_t *e) {
+	int i = hval % hash->length;
+
+	while (hash->bins[i].e != e) {
+		INSIST(hash->bins[i].e != NULL);
+		i = (i + 1) % hash->length;
+	}
+	return i;
 }
 
 static void
-free_old_hash(dns_rrl_t *rrl) {
+free_old_hash(dns_rrl_shard_t *shard) {
 	dns_rrl_hash_t *old_hash;
 	dns_rrl_bin_t *old_bin;
-	dns_rrl_entry_t *e, *e_next;
 
-	old_hash = rrl->old_hash;
+	old_hash = shard->old_hash;
 	for (old_bin = &old_hash->bins[0];
 	     old_bin < &old_hash->bins[old_hash->length]; ++old_bin)
 	{
-		for (e = ISC_LIST_HEAD(*old_bin); e != NULL; e = e_next) {
-			e_next = ISC_LIST_NEXT(e, hlink);
-			ISC_LINK_INIT(e, hlink);
+		if (old_bin->e != NULL) {
+			old_bin->e->hashed = false;
 		}
 	}
 
-	isc_mem_put(rrl->mctx, old_hash,
+	isc_mem_put(shard->rrl->mctx, old_hash,
 		    sizeof(*old_hash) +
 			    ISC_CHECKED_MUL((old_hash->length - 1),
 					    sizeof(old_hash->bins[0])));
-	rrl->old_hash = NULL;
+	shard->old_hash = NULL;
 }
 
 static isc_result_t
-expand_rrl_hash(dns_rrl_t *rrl, isc_stdtime_t now) {
+expand_rrl_hash(dns_rrl_shard_t *shard, isc_stdtime_t now) {
 	dns_rrl_hash_t *hash;
 	int old_bins, new_bins, hsize;
 	double rate;
 
-	if (rrl->old_hash != NULL) {
-		free_old_hash(rrl);
+	if (shard->old_hash != NULL) {
+		free_old_hash(shard);
 	}
 
 	/*
-	 * Most searches fail and so go to the end of the chain.
-	 * Use a small hash table load factor.
+	 * Most searches fail and so go to the end of the probe sequence.
+	 * Keep the load factor at most 3/4, even if all of the entries
+	 * end up in the new table.
 	 */
-	old_bins = (rrl->hash == NULL) ? 0 : rrl->hash->length;
+	old_bins = (shard->hash == NULL) ? 0 : shard->hash->length;
 	new_bins = old_bins / 8 + old_bins;
-	if (new_bins < rrl->num_entries) {
-		new_bins = rrl->num_entries;
+	if (new_bins < shard->num_entries / 3 * 4 + 4) {
+		new_bins = shard->num_entries / 3 * 4 + 4;
 	}
 	new_bins = hash_divisor(new_bins);
 
 	hsize = sizeof(dns_rrl_hash_t) +
 		ISC_CHECKED_MUL((new_bins - 1), sizeof(hash->bins[0]));
-	hash = isc_mem_cget(rrl->mctx, 1, hsize);
+	hash = isc_mem_cget(shard->rrl->mctx, 1, hsize);
 	hash->length = new_bins;
-	rrl->hash_gen ^= 1;
-	hash->gen = rrl->hash_gen;
+	shard->hash_gen ^= 1;
+	hash->gen = shard->hash_gen;
 
 	if (isc_log_wouldlog(DNS_RRL_LOG_DROP) && old_bins != 0) {
-		rate = rrl->probes;
-		if (rrl->searches != 0) {
-			rate /= rrl->searches;
+		rate = shard->probes;
+		if (shard->searches != 0) {
+			rate /= shard->searches;
 		}
 		isc_log_write(DNS_LOGCATEGORY_RRL, DNS_LOGMODULE_REQUEST,
 			      DNS_RRL_LOG_DROP,
 			      "increase from %d to %d RRL bins for"
 			      " %d entries; average search length %.1f",
-			      old_bins, new_bins, rrl->num_entries, rate);
+			      old_bins, new_bins, shard->num_entries, rate);
 	}
 
-	rrl->old_hash = rrl->hash;
-	if (rrl->old_hash != NULL) {
-		rrl->old_hash->check_time = now;
+	shard->old_hash = shard->hash;
+	if (shard->old_hash != NULL) {
+		shard->old_hash->check_time = now;
 	}
-	rrl->hash = hash;
+	shard->hash = hash;
 
 	return ISC_R_SUCCESS;
 }
 
+/*
+ * Add an entry to the current hash table, expanding the table first if
+ * it is too full for the searches to stay short.
+ */
+static void
+hash_add(dns_rrl_shard_t *shard, uint32_t hval, dns_rrl_entry_t *e,
+	 isc_stdtime_t now) {
+	if ((shard->hash->count + 1) * 4 > shard->hash->length * 3) {
+		expand_rrl_hash(shard, now);
+	}
+	hash_insert(shard->hash, hval, e);
+	e->hashed = true;
+	e->hash_gen = shard->hash_gen;
+}
+
+/*
+ * Move a few entries from the old hash table to the current one, so
+ * that the old table is emptied and freed soon after an expansion
+ * without moving all of its entries at once.  The slots before
+ * old_hash->next are empty.
+ */
+static void
+drain_old_hash(dns_rrl_shard_t *shard, isc_stdtime_t now) {
+	dns_rrl_hash_t *old_hash;
+	dns_rrl_bin_t bin;
+
+	for (int n = 0; n < 8; n++) {
+		old_hash = shard->old_hash;
+		if (old_hash == NULL) {
+			return;
+		}
+		if (old_hash->count == 0) {
+			free_old_hash(shard);
+			return;
+		}
+
+		INSIST(old_hash->next < old_hash->length);
+		bin = old_hash->bins[old_hash->next];
+		if (bin.e == NULL) {
+			++old_hash->next;
+			continue;
+		}
+		hash_remove(old_hash, old_hash->next);
+		hash_add(shard, bin.hval, bin.e, now);
+	}
+}
+
 static void
-ref_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, int probes, isc_stdtime_t now) {
+ref_entry(dns_rrl_shard_t *shard, dns_rrl_entry_t *e, int probes,
+	  isc_stdtime_t now) {
 	/*
-	 * Make the entry most recently used.
+	 * Make the entry most recently used.  The users of the LRU list
+	 * only need it in order to the second, so an entry that has
+	 * already been used this second stays where it is.
 	 */
-	if (ISC_LIST_HEAD(rrl->lru) != e) {
-		if (e == rrl->last_logged) {
-			rrl->last_logged = ISC_LIST_PREV(e, lru);
+	if (ISC_LIST_HEAD(shard->lru) != e &&
+	    (!e->ts_valid || get_age(shard, e, now) != 0))
+	{
+		if (e == shard->last_logged) {
+			shard->last_logged = ISC_LIST_PREV(e, lru);
 		}
-		ISC_LIST_UNLINK(rrl->lru, e, lru);
-		ISC_LIST_PREPEND(rrl->lru, e, lru);
+		ISC_LIST_UNLINK(shard->lru, e, lru);
+		ISC_LIST_PREPEND(shard->lru, e, lru);
 	}
 
 	/*
 	 * Expand the hash table if it is time and necessary.
-	 * This will leave the newly referenced entry in a chain in the
-	 * old hash table.  It will migrate to the new hash table the next
-	 * time it is used or be cut loose when the old hash table is destroyed.
+	 * This will leave the newly referenced entry in the old hash
+	 * table.  It will migrate to the new hash table the next time it
+	 * is used or when the old table is drained, or be cut loose when
+	 * the old hash table is destroyed.
 	 */
-	rrl->probes += probes;
-	++rrl->searches;
-	if (rrl->searches > 100 &&
-	    delta_rrl_time(rrl->hash->check_time, now) > 1)
+	shard->probes += probes;
+	++shard->searches;
+	if (shard->searches > 100 &&
+	    delta_rrl_time(shard->hash->check_time, now) > 1)
 	{
-		if (rrl->probes / rrl->searches > 2) {
-			expand_rrl_hash(rrl, now);
+		if (shard->probes / shard->searches > 2) {
+			expand_rrl_hash(shard, now);
 		}
-		rrl->hash->check_time = now;
-		rrl->probes = 0;
-		rrl->searches = 0;
+		shard->hash->check_time = now;
+		shard->probes = 0;
+		shard->searches = 0;
 	}
 }
 
@@ -372,6 +496,31 @@ key_cmp(const dns_rrl_key_t *a, const dns_rrl_key_t *b) {
 	return false;
 }
 
+/*
+ * Find the slot of the entry with a key.  The search stops at the
+ * first slot that is empty or holds an entry nearer to its own slot.
+ */
+static int
+hash_find(const dns_rrl_hash_t *hash, uint32_t hval, const dns_rrl_key_t *key,
+	  int *probesp) {
+	const dns_rrl_bin_t *bin;
+	int i = hval % hash->length;
+
+	for (int dist = 0;; ++dist) {
+		bin = &hash->bins[i];
+		if (bin->e == NULL || bin_distance(hash, bin->hval, i) < dist) {
+			return -1;
+		}
+		if (bin->hval == hval && key_cmp(&bin->e->key, key)) {
+			return i;
+		}
+		if (probesp != NULL) {
+			++*probesp;
+		}
+		i = (i + 1) % hash->length;
+	}
+}
+
 static uint32_t
 hash_key(const dns_rrl_key_t *key) {
 	uint32_t hval;
@@ -462,6 +611,24 @@ make_key(const dns_rrl_t *rrl, dns_rrl_key_t *key,
 	}
 }
 
+/*
+ * Pick the shard of the client's address block.  All the entries of
+ * a block, whatever their response type, are in the same shard, so
+ * that one lock covers all the entries a response is debited from.
+ */
+static dns_rrl_shard_t *
+get_shard(dns_rrl_t *rrl, const isc_sockaddr_t *client_addr) {
+	dns_rrl_key_t key;
+
+	if (rrl->nshards == 1) {
+		return &rrl->shards[0];
+	}
+
+	make_key(rrl, &key, client_addr, NULL, dns_rdatatype_none, NULL, 0,
+		 DNS_RRL_RTYPE_TCP);
+	return &rrl->shards[hash_key(&key) % rrl->nshards];
+}
+
 static dns_rrl_rate_t *
 get_rate(dns_rrl_t *rrl, dns_rrl_rtype_t rtype) {
 	switch (rtype) {
@@ -491,7 +658,7 @@ response_balance(dns_rrl_t *rrl, const dns_rrl_entry_t *e, int age) {
 		rate = 1;
 	} else {
 		ratep = get_rate(rrl, e->key.s.rtype);
-		rate = ratep->scaled;
+		rate = atomic_load_relaxed(&ratep->scaled);
 	}
 
 	balance = e->responses + age * rate;
@@ -505,58 +672,54 @@ response_balance(dns_rrl_t *rrl, const dns_rrl_entry_t *e, int age) {
  * Search for an entry for a response and optionally create it.
  */
 static dns_rrl_entry_t *
-get_entry(dns_rrl_t *rrl, const isc_sockaddr_t *client_addr, dns_zone_t *zone,
-	  dns_rdataclass_t qclass, dns_rdatatype_t qtype,
+get_entry(dns_rrl_shard_t *shard, const isc_sockaddr_t *client_addr,
+	  dns_zone_t *zone, dns_rdataclass_t qclass, dns_rdatatype_t qtype,
 	  const dns_name_t *qname, dns_rrl_rtype_t rtype, isc_stdtime_t now,
 	  bool create, char *log_buf, unsigned int log_buf_len) {
+	dns_rrl_t *rrl = shard->rrl;
 	dns_rrl_key_t key;
 	uint32_t hval;
 	dns_rrl_entry_t *e;
 	dns_rrl_hash_t *hash;
-	dns_rrl_bin_t *new_bin, *old_bin;
-	int probes, age;
+	int i, probes, age;
 
 	make_key(rrl, &key, client_addr, zone, qtype, qname, qclass, rtype);
 	hval = hash_key(&key);
 
+	if (shard->old_hash != NULL) {
+		drain_old_hash(shard, now);
+	}
+
 	/*
 	 * Look for the entry in the current hash table.
 	 */
-	new_bin = get_bin(rrl->hash, hval);
 	probes = 1;
-	e = ISC_LIST_HEAD(*new_bin);
-	while (e != NULL) {
-		if (key_cmp(&e->key, &key)) {
-			ref_entry(rrl, e, probes, now);
-			return e;
-		}
-		++probes;
-		e = ISC_LIST_NEXT(e, hlink);
+	i = hash_find(shard->hash, hval, &key, &probes);
+	if (i >= 0) {
+		e = shard->hash->bins[i].e;
+		ref_entry(shard, e, probes, now);
+		return e;
 	}
 
 	/*
 	 * Look in the old hash table.
 	 */
-	if (rrl->old_hash != NULL) {
-		old_bin = get_bin(rrl->old_hash, hval);
-		e = ISC_LIST_HEAD(*old_bin);
-		while (e != NULL) {
-			if (key_cmp(&e->key, &key)) {
-				ISC_LIST_UNLINK(*old_bin, e, hlink);
-				ISC_LIST_PREPEND(*new_bin, e, hlink);
-				e->hash_gen = rrl->hash_gen;
-				ref_entry(rrl, e, probes, now);
-				return e;
-			}
-			e = ISC_LIST_NEXT(e, hlink);
+	if (shard->old_hash != NULL) {
+		i = hash_find(shard->old_hash, hval, &key, NULL);
+		if (i >= 0) {
+			e = shard->old_hash->bins[i].e;
+			hash_remove(shard->old_hash, i);
+			hash_add(shard, hval, e, now);
+			ref_entry(shard, e, probes, now);
+			return e;
 		}
 
 		/*
 		 * Discard previous hash table when all of its entries are old.
 		 */
-		age = delta_rrl_time(rrl->old_hash->check_time, now);
+		age = delta_rrl_time(shard->old_hash->check_time, now);
 		if (age > rrl->window) {
-			free_old_hash(rrl);
+			free_old_hash(shard);
 		}
 	}
 
@@ -570,12 +733,13 @@ get_entry(dns_rrl_t *rrl, const isc_sockaddr_t *client_addr, dns_zone_t *zone,
 	 * Try to make more entries if none are idle.
 	 * Steal the oldest entry if we cannot create more.
 	 */
-	for (e = ISC_LIST_TAIL(rrl->lru); e != NULL; e = ISC_LIST_PREV(e, lru))
+	for (e = ISC_LIST_TAIL(shard->lru); e != NULL;
+	     e = ISC_LIST_PREV(e, lru))
 	{
-		if (!ISC_LINK_LINKED(e, hlink)) {
+		if (!e->hashed) {
 			break;
 		}
-		age = get_age(rrl, e, now);
+		age = get_age(shard, e, now);
 		if (age <= 1) {
 			e = NULL;
 			break;
@@ -585,26 +749,35 @@ get_entry(dns_rrl_t *rrl, const isc_sockaddr_t *client_addr, dns_zone_t *zone,
 		}
 	}
 	if (e == NULL) {
-		expand_entries(rrl, ISC_MIN((rrl->num_entries + 1) / 2, 1000));
-		e = ISC_LIST_TAIL(rrl->lru);
+		int grow = ISC_MIN((shard->num_entries + 1) / 2, 1000);
+
+		/*
+		 * Grow the table less as the memory pressure rises, and
+		 * steal the oldest entry when it is too high to grow it.
+		 */
+		grow -= grow * (int)isc_mem_pressure(rrl->mctx) /
+			ISC_MEM_PRESSURE_MAX;
+		if (grow > 0 || ISC_LIST_EMPTY(shard->lru)) {
+			expand_entries(shard, ISC_MAX(grow, 1));
+		}
+		e = ISC_LIST_TAIL(shard->lru);
 	}
 	if (e->logged) {
-		log_end(rrl, e, true, log_buf, log_buf_len);
+		log_end(shard, e, true, log_buf, log_buf_len);
 	}
-	if (ISC_LINK_LINKED(e, hlink)) {
-		if (e->hash_gen == rrl->hash_gen) {
-			hash = rrl->hash;
+	if (e->hashed) {
+		if (e->hash_gen == shard->hash_gen) {
+			hash = shard->hash;
 		} else {
-			hash = rrl->old_hash;
+			hash = shard->old_hash;
 		}
-		old_bin = get_bin(hash, hash_key(&e->key));
-		ISC_LIST_UNLINK(*old_bin, e, hlink);
+		hash_remove(hash, hash_slot(hash, hash_key(&e->key), e));
+		e->hashed = false;
 	}
-	ISC_LIST_PREPEND(*new_bin, e, hlink);
-	e->hash_gen = rrl->hash_gen;
 	e->key = key;
 	e->ts_valid = false;
-	ref_entry(rrl, e, probes, now);
+	hash_add(shard, hval, e, now);
+	ref_entry(shard, e, probes, now);
 	return e;
 }
 
@@ -625,9 +798,10 @@ debit_log(const dns_rrl_entry_t *e, int age, const char *action) {
 }
 
 static dns_rrl_result_t
-debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
-		const isc_sockaddr_t *client_addr, isc_stdtime_t now,
-		char *log_buf, unsigned int log_buf_len) {
+debit_rrl_entry(dns_rrl_shard_t *shard, dns_rrl_entry_t *e, double qps,
+		double scale, const isc_sockaddr_t *client_addr,
+		isc_stdtime_t now, char *log_buf, unsigned int log_buf_len) {
+	dns_rrl_t *rrl = shard->rrl;
 	int rate, new_rate, slip, new_slip, age, log_secs, min;
 	dns_rrl_rate_t *ratep;
 	dns_rrl_entry_t const *credit_e;
@@ -647,10 +821,10 @@ debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
 		 * The limit for clients that have used TCP is not scaled.
 		 */
 		credit_e = get_entry(
-			rrl, client_addr, NULL, 0, dns_rdatatype_none, NULL,
+			shard, client_addr, NULL, 0, dns_rdatatype_none, NULL,
 			DNS_RRL_RTYPE_TCP, now, false, log_buf, log_buf_len);
 		if (credit_e != NULL) {
-			age = get_age(rrl, e, now);
+			age = get_age(shard, e, now);
 			if (age < rrl->window) {
 				scale = 1.0;
 			}
@@ -661,7 +835,7 @@ debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
 		if (new_rate < 1) {
 			new_rate = 1;
 		}
-		if (ratep->scaled != new_rate) {
+		if (atomic_load_relaxed(&ratep->scaled) != new_rate) {
 			isc_log_write(DNS_LOGCATEGORY_RRL,
 				      DNS_LOGMODULE_REQUEST, DNS_RRL_LOG_DEBUG1,
 				      "%d qps scaled %s by %.2f"
@@ -669,7 +843,7 @@ debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
 				      (int)qps, ratep->str, scale, rate,
 				      new_rate);
 			rate = new_rate;
-			ratep->scaled = rate;
+			atomic_store_relaxed(&ratep->scaled, rate);
 		}
 	}
 
@@ -680,7 +854,7 @@ debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
 	 * Treat entries older than the window as if they were just created
 	 * Credit other entries.
 	 */
-	age = get_age(rrl, e, now);
+	age = get_age(shard, e, now);
 	if (age > 0) {
 		/*
 		 * Credit tokens earned during elapsed time.
@@ -712,7 +886,7 @@ debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
 			e->log_secs = log_secs;
 		}
 	}
-	set_age(rrl, e, now);
+	set_age(shard, e, now);
 
 	/*
 	 * Debit the entry for this response.
@@ -737,14 +911,14 @@ debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
 		if (new_slip < 2) {
 			new_slip = 2;
 		}
-		if (rrl->slip.scaled != new_slip) {
+		if (atomic_load_relaxed(&rrl->slip.scaled) != new_slip) {
 			isc_log_write(DNS_LOGCATEGORY_RRL,
 				      DNS_LOGMODULE_REQUEST, DNS_RRL_LOG_DEBUG1,
 				      "%d qps scaled slip"
 				      " by %.2f from %d to %d",
 				      (int)qps, scale, slip, new_slip);
 			slip = new_slip;
-			rrl->slip.scaled = slip;
+			atomic_store_relaxed(&rrl->slip.scaled, slip);
 		}
 	}
 	if (slip != 0 && e->key.s.rtype != DNS_RRL_RTYPE_ALL) {
@@ -768,10 +942,10 @@ debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
 }
 
 static dns_rrl_qname_buf_t *
-get_qname(dns_rrl_t *rrl, const dns_rrl_entry_t *e) {
+get_qname(dns_rrl_shard_t *shard, const dns_rrl_entry_t *e) {
 	dns_rrl_qname_buf_t *qbuf;
 
-	qbuf = rrl->qnames[e->log_qname];
+	qbuf = shard->qnames[e->log_qname];
 	if (qbuf == NULL || qbuf->e != e) {
 		return NULL;
 	}
@@ -779,13 +953,13 @@ get_qname(dns_rrl_t *rrl, const dns_rrl_entry_t *e) {
 }
 
 static void
-free_qname(dns_rrl_t *rrl, dns_rrl_entry_t *e) {
+free_qname(dns_rrl_shard_t *shard, dns_rrl_entry_t *e) {
 	dns_rrl_qname_buf_t *qbuf;
 
-	qbuf = get_qname(rrl, e);
+	qbuf = get_qname(shard, e);
 	if (qbuf != NULL) {
 		qbuf->e = NULL;
-		ISC_LIST_APPEND(rrl->qname_free, qbuf, link);
+		ISC_LIST_APPEND(shard->qname_free, qbuf, link);
 	}
 }
 
@@ -810,11 +984,12 @@ add_log_str(isc_buffer_t *lb, const char *str, unsigned int str_len) {
  * Build strings for the logs
  */
 static void
-make_log_buf(dns_rrl_t *rrl, dns_rrl_entry_t *e, const char *str1,
+make_log_buf(dns_rrl_shard_t *shard, dns_rrl_entry_t *e, const char *str1,
 	     const char *str2, bool plural, const dns_name_t *qname,
 	     bool save_qname, dns_rrl_result_t rrl_result,
 	     isc_result_t resp_result, char *log_buf,
 	     unsigned int log_buf_len) {
+	dns_rrl_t *rrl = shard->rrl;
 	isc_buffer_t lb;
 	dns_rrl_qname_buf_t *qbuf;
 	isc_netaddr_t cidr;
@@ -906,23 +1081,23 @@ make_log_buf(dns_rrl_t *rrl, dns_rrl_entry_t *e, const char *str1,
 	    e->key.s.rtype == DNS_RRL_RTYPE_NODATA ||
 	    e->key.s.rtype == DNS_RRL_RTYPE_NXDOMAIN)
 	{
-		qbuf = get_qname(rrl, e);
+		qbuf = get_qname(shard, e);
 		if (save_qname && qbuf == NULL && qname != NULL &&
 		    dns_name_isabsolute(qname))
 		{
 			/*
 			 * Capture the qname for the "stop limiting" message.
 			 */
-			qbuf = ISC_LIST_TAIL(rrl->qname_free);
+			qbuf = ISC_LIST_TAIL(shard->qname_free);
 			if (qbuf != NULL) {
-				ISC_LIST_UNLINK(rrl->qname_free, qbuf, link);
-			} else if (rrl->num_qnames < DNS_RRL_QNAMES) {
+				ISC_LIST_UNLINK(shard->qname_free, qbuf, link);
+			} else if (shard->num_qnames < DNS_RRL_QNAMES) {
 				qbuf = isc_mem_get(rrl->mctx, sizeof(*qbuf));
 				*qbuf = (dns_rrl_qname_buf_t){
-					.index = rrl->num_qnames,
+					.index = shard->num_qnames,
 				};
 				ISC_LINK_INIT(qbuf, link);
-				rrl->qnames[rrl->num_qnames++] = qbuf;
+				shard->qnames[shard->num_qnames++] = qbuf;
 			}
 			if (qbuf != NULL) {
 				e->log_qname = qbuf->index;
@@ -962,19 +1137,19 @@ make_log_buf(dns_rrl_t *rrl, dns_rrl_entry_t *e, const char *str1,
 }
 
 static void
-log_end(dns_rrl_t *rrl, dns_rrl_entry_t *e, bool early, char *log_buf,
-	unsigned int log_buf_len) {
+log_end(dns_rrl_shard_t *shard, dns_rrl_entry_t *e, bool early,
+	char *log_buf, unsigned int log_buf_len) {
 	if (e->logged) {
-		make_log_buf(rrl, e, early ? "*" : NULL,
-			     rrl->log_only ? "would stop limiting "
-					   : "stop limiting ",
+		make_log_buf(shard, e, early ? "*" : NULL,
+			     shard->rrl->log_only ? "would stop limiting "
+						  : "stop limiting ",
 			     true, NULL, false, DNS_RRL_RESULT_OK,
 			     ISC_R_SUCCESS, log_buf, log_buf_len);
 		isc_log_write(DNS_LOGCATEGORY_RRL, DNS_LOGMODULE_REQUEST,
 			      DNS_RRL_LOG_DROP, "%s", log_buf);
-		free_qname(rrl, e);
+		free_qname(shard, e);
 		e->logged = false;
-		--rrl->num_logged;
+		--shard->num_logged;
 	}
 }
 
@@ -982,26 +1157,26 @@ log_end(dns_rrl_t *rrl, dns_rrl_entry_t *e, bool early, char *log_buf,
  * Log messages for streams that have stopped being rate limited.
  */
 static void
-log_stops(dns_rrl_t *rrl, isc_stdtime_t now, int limit, char *log_buf,
-	  unsigned int log_buf_len) {
+log_stops(dns_rrl_shard_t *shard, isc_stdtime_t now, int limit,
+	  char *log_buf, unsigned int log_buf_len) {
 	dns_rrl_entry_t *e;
 	int age;
 
-	for (e = rrl->last_logged; e != NULL; e = ISC_LIST_PREV(e, lru)) {
+	for (e = shard->last_logged; e != NULL; e = ISC_LIST_PREV(e, lru)) {
 		if (!e->logged) {
 			continue;
 		}
 		if (now != 0) {
-			age = get_age(rrl, e, now);
+			age = get_age(shard, e, now);
 			if (age < DNS_RRL_STOP_LOG_SECS ||
-			    response_balance(rrl, e, age) < 0)
+			    response_balance(shard->rrl, e, age) < 0)
 			{
 				break;
 			}
 		}
 
-		log_end(rrl, e, now == 0, log_buf, log_buf_len);
-		if (rrl->num_logged <= 0) {
+		log_end(shard, e, now == 0, log_buf, log_buf_len);
+		if (shard->num_logged <= 0) {
 			break;
 		}
 
@@ -1009,15 +1184,15 @@ log_stops(dns_rrl_t *rrl, isc_stdtime_t now, int limit, char *log_buf,
 		 * Too many messages could stall real work.
 		 */
 		if (--limit < 0) {
-			rrl->last_logged = ISC_LIST_PREV(e, lru);
+			shard->last_logged = ISC_LIST_PREV(e, lru);
 			return;
 		}
 	}
 	if (e == NULL) {
-		INSIST(rrl->num_logged == 0);
-		rrl->log_stops_time = now;
+		INSIST(shard->num_logged == 0);
+		shard->log_stops_time = now;
 	}
-	rrl->last_logged = e;
+	shard->last_logged = e;
 }
 
 /*
@@ -1029,6 +1204,7 @@ dns_rrl(dns_view_t *view, dns_zone_t *zone, const isc_sockaddr_t *client_addr,
 	const dns_name_t *qname, isc_result_t resp_result, isc_stdtime_t now,
 	bool wouldlog, char *log_buf, unsigned int log_buf_len) {
 	dns_rrl_t *rrl;
+	dns_rrl_shard_t *shard;
 	dns_rrl_rtype_t rtype;
 	dns_rrl_entry_t *e;
 	isc_netaddr_t netclient;
@@ -1050,8 +1226,6 @@ dns_rrl(dns_view_t *view, dns_zone_t *zone, const isc_sockaddr_t *client_addr,
 		}
 	}
 
-	LOCK(&rrl->lock);
-
 	/*
 	 * Estimate total query per second rate when scaling by qps.
 	 */
@@ -1059,6 +1233,7 @@ dns_rrl(dns_view_t *view, dns_zone_t *zone, const isc_sockaddr_t *client_addr,
 		qps = 0.0;
 		scale = 1.0;
 	} else {
+		LOCK(&rrl->qps_lock);
 		++rrl->qps_responses;
 		secs = delta_rrl_time(rrl->qps_time, now);
 		if (secs <= 0) {
@@ -1083,13 +1258,17 @@ dns_rrl(dns_view_t *view, dns_zone_t *zone, const isc_sockaddr_t *client_addr,
 			}
 		}
 		scale = rrl->qps_scale / qps;
+		UNLOCK(&rrl->qps_lock);
 	}
 
+	shard = get_shard(rrl, client_addr);
+	LOCK(&shard->lock);
+
 	/*
 	 * Do maintenance once per second.
 	 */
-	if (rrl->num_logged > 0 && rrl->log_stops_time != now) {
-		log_stops(rrl, now, 8, log_buf, log_buf_len);
+	if (shard->num_logged > 0 && shard->log_stops_time != now) {
+		log_stops(shard, now, 8, log_buf, log_buf_len);
 	}
 
 	/*
@@ -1098,16 +1277,16 @@ dns_rrl(dns_view_t *view, dns_zone_t *zone, const isc_sockaddr_t *client_addr,
 	 */
 	if (is_tcp) {
 		if (scale < 1.0) {
-			e = get_entry(rrl, client_addr, NULL, 0,
+			e = get_entry(shard, client_addr, NULL, 0,
 				      dns_rdatatype_none, NULL,
 				      DNS_RRL_RTYPE_TCP, now, true, log_buf,
 				      log_buf_len);
 			if (e != NULL) {
 				e->responses = -(rrl->window + 1);
-				set_age(rrl, e, now);
+				set_age(shard, e, now);
 			}
 		}
-		UNLOCK(&rrl->lock);
+		UNLOCK(&shard->lock);
 		return DNS_RRL_RESULT_OK;
 	}
 
@@ -1132,10 +1311,10 @@ dns_rrl(dns_view_t *view, dns_zone_t *zone, const isc_sockaddr_t *client_addr,
 		rtype = DNS_RRL_RTYPE_ERROR;
 		break;
 	}
-	e = get_entry(rrl, client_addr, zone, qclass, qtype, qname, rtype, now,
+	e = get_entry(shard, client_addr, zone, qclass, qtype, qname, rtype, now,
 		      true, log_buf, log_buf_len);
 	if (e == NULL) {
-		UNLOCK(&rrl->lock);
+		UNLOCK(&shard->lock);
 		return DNS_RRL_RESULT_OK;
 	}
 
@@ -1144,14 +1323,14 @@ dns_rrl(dns_view_t *view, dns_zone_t *zone, const isc_sockaddr_t *client_addr,
 		 * Do not worry about speed or releasing the lock.
 		 * This message appears before messages from debit_rrl_entry().
 		 */
-		make_log_buf(rrl, e, "consider limiting ", NULL, false, qname,
+		make_log_buf(shard, e, "consider limiting ", NULL, false, qname,
 			     false, DNS_RRL_RESULT_OK, resp_result, log_buf,
 			     log_buf_len);
 		isc_log_write(DNS_LOGCATEGORY_RRL, DNS_LOGMODULE_REQUEST,
 			      DNS_RRL_LOG_DEBUG1, "%s", log_buf);
 	}
 
-	rrl_result = debit_rrl_entry(rrl, e, qps, scale, client_addr, now,
+	rrl_result = debit_rrl_entry(shard, e, qps, scale, client_addr, now,
 				     log_buf, log_buf_len);
 
 	if (rrl->all_per_second.r != 0) {
@@ -1166,21 +1345,21 @@ dns_rrl(dns_view_t *view, dns_zone_t *zone, const isc_sockaddr_t *client_addr,
 		dns_rrl_entry_t *e_all;
 		dns_rrl_result_t rrl_all_result;
 
-		e_all = get_entry(rrl, client_addr, zone, 0, dns_rdatatype_none,
-				  NULL, DNS_RRL_RTYPE_ALL, now, true, log_buf,
-				  log_buf_len);
+		e_all = get_entry(shard, client_addr, zone, 0,
+				  dns_rdatatype_none, NULL, DNS_RRL_RTYPE_ALL,
+				  now, true, log_buf, log_buf_len);
 		if (e_all == NULL) {
-			UNLOCK(&rrl->lock);
+			UNLOCK(&shard->lock);
 			return DNS_RRL_RESULT_OK;
 		}
-		rrl_all_result = debit_rrl_entry(rrl, e_all, qps, scale,
+		rrl_all_result = debit_rrl_entry(shard, e_all, qps, scale,
 						 client_addr, now, log_buf,
 						 log_buf_len);
 		if (rrl_all_result != DNS_RRL_RESULT_OK) {
 			e = e_all;
 			rrl_result = rrl_all_result;
 			if (isc_log_wouldlog(DNS_RRL_LOG_DEBUG1)) {
-				make_log_buf(rrl, e,
+				make_log_buf(shard, e,
 					     "prefer all-per-second limiting ",
 					     NULL, true, qname, false,
 					     DNS_RRL_RESULT_OK, resp_result,
@@ -1194,7 +1373,7 @@ dns_rrl(dns_view_t *view, dns_zone_t *zone, const isc_sockaddr_t *client_addr,
 	}
 
 	if (rrl_result == DNS_RRL_RESULT_OK) {
-		UNLOCK(&rrl->lock);
+		UNLOCK(&shard->lock);
 		return DNS_RRL_RESULT_OK;
 	}
 
@@ -1204,14 +1383,14 @@ dns_rrl(dns_view_t *view, dns_zone_t *zone, const isc_sockaddr_t *client_addr,
 	if ((!e->logged || e->log_secs >= DNS_RRL_MAX_LOG_SECS) &&
 	    isc_log_wouldlog(DNS_RRL_LOG_DROP))
 	{
-		make_log_buf(rrl, e, rrl->log_only ? "would " : NULL,
+		make_log_buf(shard, e, rrl->log_only ? "would " : NULL,
 			     e->logged ? "continue limiting " : "limit ", true,
 			     qname, true, DNS_RRL_RESULT_OK, resp_result,
 			     log_buf, log_buf_len);
 		if (!e->logged) {
 			e->logged = true;
-			if (++rrl->num_logged <= 1) {
-				rrl->last_logged = e;
+			if (++shard->num_logged <= 1) {
+				shard->last_logged = e;
 			}
 		}
 		e->log_secs = 0;
@@ -1220,7 +1399,7 @@ dns_rrl(dns_view_t *view, dns_zone_t *zone, const isc_sockaddr_t *client_addr,
 		 * Avoid holding the lock.
 		 */
 		if (!wouldlog) {
-			UNLOCK(&rrl->lock);
+			UNLOCK(&shard->lock);
 			e = NULL;
 		}
 		isc_log_write(DNS_LOGCATEGORY_RRL, DNS_LOGMODULE_REQUEST,
@@ -1231,7 +1410,7 @@ dns_rrl(dns_view_t *view, dns_zone_t *zone, const isc_sockaddr_t *client_addr,
 	 * Make a log message for the caller.
 	 */
 	if (wouldlog) {
-		make_log_buf(rrl, e,
+		make_log_buf(shard, e,
 			     rrl->log_only ? "would rate limit "
 					   : "rate limit ",
 			     NULL, false, qname, false, rrl_result, resp_result,
@@ -1244,97 +1423,129 @@ dns_rrl(dns_view_t *view, dns_zone_t *zone, const isc_sockaddr_t *client_addr,
 		 * the ending log message.
 		 */
 		if (!e->logged) {
-			free_qname(rrl, e);
+			free_qname(shard, e);
 		}
-		UNLOCK(&rrl->lock);
+		UNLOCK(&shard->lock);
 	}
 
 	return rrl_result;
 }
 
-void
-dns_rrl_view_destroy(dns_view_t *view) {
-	dns_rrl_t *rrl;
+static void
+destroy_shard(dns_rrl_shard_t *shard) {
+	dns_rrl_t *rrl = shard->rrl;
 	dns_rrl_block_t *b;
 	dns_rrl_hash_t *h;
 	char log_buf[DNS_RRL_LOG_BUF_LEN];
 	int i;
 
-	rrl = view->rrl;
-	if (rrl == NULL) {
-		return;
-	}
-	view->rrl = NULL;
-
-	/*
-	 * Assume the caller takes care of locking the view and anything else.
-	 */
-
-	if (rrl->num_logged > 0) {
-		log_stops(rrl, 0, INT32_MAX, log_buf, sizeof(log_buf));
+	if (shard->num_logged > 0) {
+		log_stops(shard, 0, INT32_MAX, log_buf, sizeof(log_buf));
 	}
 
 	for (i = 0; i < DNS_RRL_QNAMES; ++i) {
-		if (rrl->qnames[i] == NULL) {
+		if (shard->qnames[i] == NULL) {
 			break;
 		}
-		isc_mem_put(rrl->mctx, rrl->qnames[i], sizeof(*rrl->qnames[i]));
-	}
-
-	if (rrl->exempt != NULL) {
-		dns_acl_detach(&rrl->exempt);
+		isc_mem_put(rrl->mctx, shard->qnames[i],
+			    sizeof(*shard->qnames[i]));
 	}
 
-	isc_mutex_destroy(&rrl->lock);
+	isc_mutex_destroy(&shard->lock);
 
-	while (!ISC_LIST_EMPTY(rrl->blocks)) {
-		b = ISC_LIST_HEAD(rrl->blocks);
-		ISC_LIST_UNLINK(rrl->blocks, b, link);
+	while (!ISC_LIST_EMPTY(shard->blocks)) {
+		b = ISC_LIST_HEAD(shard->blocks);
+		ISC_LIST_UNLINK(shard->blocks, b, link);
 		isc_mem_put(rrl->mctx, b, b->size);
 	}
 
-	h = rrl->hash;
+	h = shard->hash;
 	if (h != NULL) {
 		isc_mem_put(rrl->mctx, h,
 			    sizeof(*h) + ISC_CHECKED_MUL((h->length - 1),
 							 sizeof(h->bins[0])));
 	}
 
-	h = rrl->old_hash;
+	h = shard->old_hash;
 	if (h != NULL) {
 		isc_mem_put(rrl->mctx, h,
 			    sizeof(*h) + ISC_CHECKED_MUL((h->length - 1),
 							 sizeof(h->bins[0])));
 	}
+}
+
+void
+dns_rrl_view_destroy(dns_view_t *view) {
+	dns_rrl_t *rrl;
+
+	rrl = view->rrl;
+	if (rrl == NULL) {
+		return;
+	}
+	view->rrl = NULL;
+
+	/*
+	 * Assume the caller takes care of locking the view and anything else.
+	 */
+
+	for (unsigned int i = 0; i < rrl->nshards; i++) {
+		destroy_shard(&rrl->shards[i]);
+	}
+	isc_mem_cput(rrl->mctx, rrl->shards, rrl->nshards,
+		     sizeof(rrl->shards[0]));
+
+	if (rrl->exempt != NULL) {
+		dns_acl_detach(&rrl->exempt);
+	}
+
+	isc_mutex_destroy(&rrl->qps_lock);
 
 	isc_mem_putanddetach(&rrl->mctx, rrl, sizeof(*rrl));
 }
 
 isc_result_t
-dns_rrl_init(dns_rrl_t **rrlp, dns_view_t *view, int min_entries) {
+dns_rrl_init(dns_rrl_t **rrlp, dns_view_t *view, int min_entries,
+	     unsigned int nshards) {
 	dns_rrl_t *rrl;
 	isc_result_t result;
+	isc_stdtime_t now = isc_stdtime_now();
+
+	REQUIRE(nshards > 0);
 
 	*rrlp = NULL;
 
 	rrl = isc_mem_get(view->mctx, sizeof(*rrl));
 	*rrl = (dns_rrl_t){
-		.ts_bases[0] = isc_stdtime_now(),
+		.nshards = nshards,
 	};
 	isc_mem_attach(view->mctx, &rrl->mctx);
-	isc_mutex_init(&rrl->lock);
+	isc_mutex_init(&rrl->qps_lock);
 
-	view->rrl = rrl;
+	rrl->shards = isc_mem_cget(rrl->mctx, nshards, sizeof(rrl->shards[0]));
+	for (unsigned int i = 0; i < nshards; i++) {
+		dns_rrl_shard_t *shard = &rrl->shards[i];
 
-	result = expand_entries(rrl, min_entries);
-	if (result != ISC_R_SUCCESS) {
-		dns_rrl_view_destroy(view);
-		return result;
+		*shard = (dns_rrl_shard_t){
+			.rrl = rrl,
+			.ts_bases[0] = now,
+		};
+		isc_mutex_init(&shard->lock);
 	}
-	result = expand_rrl_hash(rrl, 0);
-	if (result != ISC_R_SUCCESS) {
-		dns_rrl_view_destroy(view);
-		return result;
+
+	view->rrl = rrl;
+
+	for (unsigned int i = 0; i < nshards; i++) {
+		result = expand_entries(&rrl->shards[i],
+					(min_entries + nshards - 1) / nshards);
+		if (result != ISC_R_SUCCESS) {
+			dns_rrl_view_destroy(view);
+			return result;
+		}
+		result = expand_rrl_hash(&rrl->shards[i], 0);
+		if (result != ISC_R_SUCCESS) {
+			dns_rrl_view_destroy(view);
+			return result;
+		}
 	}
 
 	*rrlp = rrl;
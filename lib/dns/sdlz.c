@@ -54,6 +54,8 @@
 
 #include <isc/ascii.h>
 #include <isc/buffer.h>
+#include <isc/hash.h>
+#include <isc/hashmap.h>
 #include <isc/lex.h>
 #include <isc/log.h>
 #include <isc/magic.h>
@@ -62,6 +64,7 @@
 #include <isc/region.h>
 #include <isc/result.h>
 #include <isc/rwlock.h>
+#include <isc/stdtime.h>
 #include <isc/string.h>
 #include <isc/util.h>
 
@@ -90,6 +93,11 @@ struct dns_sdlzimplementation {
 	unsigned int flags;
 	isc_mutex_t driverlock;
 	dns_dlzimplementation_t *dlz_imp;
+
+	/* The lookup cache, with DNS_SDLZFLAG_CACHE */
+	isc_mutex_t cachelock;
+	isc_hashmap_t *cache;
+	isc_stdtime_t cachesweep;
 };
 
 struct dns_sdlz_db {
@@ -128,6 +136,26 @@ struct dns_sdlzallnodes {
 
 typedef dns_sdlzallnodes_t sdlz_dbiterator_t;
 
+/*
+ * A cached lookup result: the records of the node, in wire format, each
+ * one preceded by its type, TTL and length.  The key is the zone name
+ * and the owner name, separated by a NUL.
+ */
+typedef struct sdlz_cacheent {
+	void *dbdata;
+	isc_stdtime_t expire;
+	size_t keylen;
+	size_t datalen;
+	unsigned char *key;
+	unsigned char *data;
+} sdlz_cacheent_t;
+
+typedef struct sdlz_cachekey {
+	void *dbdata;
+	const unsigned char *key;
+	size_t keylen;
+} sdlz_cachekey_t;
+
 typedef struct sdlz_rdatasetiter {
 	dns_rdatasetiter_t common;
 	dns_rdatalist_t *current;
@@ -156,6 +184,10 @@ typedef struct sdlz_rdatasetiter {
 /* This is a reasonable value */
 #define SDLZ_DEFAULT_TTL (60 * 60 * 24)
 
+/* The size of the lookup cache */
+#define SDLZ_CACHE_BITS 12
+#define SDLZ_CACHE_MAX	65536
+
 #ifdef __COVERITY__
 #define MAYBE_LOCK(imp)	  LOCK(&imp->driverlock)
 #define MAYBE_UNLOCK(imp) UNLOCK(&imp->driverlock)
@@ -190,6 +222,9 @@ list_tordataset(dns_rdatalist_t *rdatalist, dns_db_t *db, dns_dbnode_t *node,
 static void
 detachnode(dns_db_t *db, dns_dbnode_t **targetp DNS__DB_FLARG);
 
+static void
+cache_flush(dns_sdlzimplementation_t *imp, void *dbdata);
+
 static void
 dbiterator_destroy(dns_dbiterator_t **iteratorp DNS__DB_FLARG);
 static isc_result_t
@@ -387,6 +422,10 @@ closeversion(dns_db_t *db, dns_dbversion_t **versionp,
 			 origin);
 	}
 
+	if (commit) {
+		cache_flush(sdlz->dlzimp, sdlz->dbdata);
+	}
+
 	sdlz->future_version = NULL;
 }
 
@@ -453,6 +492,214 @@ destroynode(dns_sdlznode_t *node) {
 	dns_db_detach(&db);
 }
 
+static bool
+cache_match(void *node, const void *key) {
+	const sdlz_cacheent_t *ent = node;
+	const sdlz_cachekey_t *ckey = key;
+
+	return ent->dbdata == ckey->dbdata && ent->keylen == ckey->keylen &&
+	       memcmp(ent->key, ckey->key, ent->keylen) == 0;
+}
+
+static void
+cache_freeent(dns_sdlzimplementation_t *imp, sdlz_cacheent_t *ent) {
+	isc_mem_put(imp->mctx, ent, sizeof(*ent) + ent->keylen + ent->datalen);
+}
+
+/*
+ * Remove the entries of 'dbdata' from the cache, or the expired entries
+ * if 'dbdata' is NULL.  The cache must be locked.
+ */
+static void
+cache_purge(dns_sdlzimplementation_t *imp, void *dbdata, isc_stdtime_t now) {
+	isc_hashmap_iter_t *it = NULL;
+	isc_result_t result;
+
+	isc_hashmap_iter_create(imp->cache, &it);
+	result = isc_hashmap_iter_first(it);
+	while (result == ISC_R_SUCCESS) {
+		sdlz_cacheent_t *ent = NULL;
+
+		isc_hashmap_iter_current(it, (void **)&ent);
+		if ((dbdata == NULL && ent->expire <= now) ||
+		    (dbdata != NULL && ent->dbdata == dbdata))
+		{
+			result = isc_hashmap_iter_delcurrent_next(it);
+			cache_freeent(imp, ent);
+		} else {
+			result = isc_hashmap_iter_next(it);
+		}
+	}
+	isc_hashmap_iter_destroy(&it);
+}
+
+static void
+cache_flush(dns_sdlzimplementation_t *imp, void *dbdata) {
+	if (imp->cache == NULL) {
+		return;
+	}
+
+	LOCK(&imp->cachelock);
+	cache_purge(imp, dbdata, 0);
+	UNLOCK(&imp->cachelock);
+}
+
+static size_t
+cache_makekey(unsigned char *key, const char *zonestr, const char *namestr) {
+	size_t zonelen = strlen(zonestr) + 1;
+	size_t namelen = strlen(namestr);
+
+	memmove(key, zonestr, zonelen);
+	memmove(key + zonelen, namestr, namelen);
+	return zonelen + namelen;
+}
+
+/*
+ * Fill 'node' from the cache, and return true, if the result of the
+ * lookup of 'namestr' is cached.
+ */
+static bool
+cache_fetch(dns_sdlz_db_t *sdlz, const char *zonestr, const char *namestr,
+	    dns_sdlznode_t *node) {
+	dns_sdlzimplementation_t *imp = sdlz->dlzimp;
+	isc_mem_t *mctx = sdlz->common.mctx;
+	unsigned char key[2 * (DNS_NAME_MAXTEXT + 1)];
+	sdlz_cachekey_t ckey = { .dbdata = sdlz->dbdata, .key = key };
+	sdlz_cacheent_t *ent = NULL;
+	isc_buffer_t *rdatabuf = NULL;
+	isc_stdtime_t now = isc_stdtime_now();
+	dns_ttl_t remaining = 0;
+	isc_result_t result;
+	uint32_t hashval;
+
+	ckey.keylen = cache_makekey(key, zonestr, namestr);
+	hashval = isc_hash32(key, ckey.keylen, true);
+
+	LOCK(&imp->cachelock);
+	result = isc_hashmap_find(imp->cache, hashval, cache_match, &ckey,
+				  (void **)&ent);
+	if (result == ISC_R_SUCCESS && ent->expire <= now) {
+		result = isc_hashmap_delete(imp->cache, hashval, cache_match,
+					    &ckey);
+		INSIST(result == ISC_R_SUCCESS);
+		cache_freeent(imp, ent);
+		result = ISC_R_NOTFOUND;
+	}
+	if (result == ISC_R_SUCCESS) {
+		remaining = ent->expire - now;
+		isc_buffer_allocate(mctx, &rdatabuf, ent->datalen);
+		isc_buffer_putmem(rdatabuf, ent->data, ent->datalen);
+	}
+	UNLOCK(&imp->cachelock);
+
+	if (result != ISC_R_SUCCESS) {
+		return false;
+	}
+
+	ISC_LIST_APPEND(node->buffers, rdatabuf, link);
+	while (isc_buffer_remaininglength(rdatabuf) > 0) {
+		dns_rdatatype_t type = isc_buffer_getuint16(rdatabuf);
+		dns_ttl_t ttl = isc_buffer_getuint32(rdatabuf);
+		dns_rdatalist_t *rdatalist = NULL;
+		dns_rdata_t *rdata = NULL;
+		isc_region_t region;
+
+		region.length = isc_buffer_getuint16(rdatabuf);
+		region.base = isc_buffer_current(rdatabuf);
+		isc_buffer_forward(rdatabuf, region.length);
+
+		rdatalist = ISC_LIST_TAIL(node->lists);
+		if (rdatalist == NULL || rdatalist->type != type) {
+			rdatalist = isc_mem_get(mctx, sizeof(*rdatalist));
+			dns_rdatalist_init(rdatalist);
+			rdatalist->rdclass = sdlz->common.rdclass;
+			rdatalist->type = type;
+			rdatalist->ttl = ISC_MIN(ttl, remaining);
+			ISC_LIST_APPEND(node->lists, rdatalist, link);
+		}
+
+		rdata = isc_mem_get(mctx, sizeof(*rdata));
+		dns_rdata_init(rdata);
+		dns_rdata_fromregion(rdata, rdatalist->rdclass, type, &region);
+		ISC_LIST_APPEND(rdatalist->rdata, rdata, link);
+	}
+
+	return true;
+}
+
+/*
+ * Cache the records that the lookup of 'namestr' put in 'node', for
+ * their lowest TTL.
+ */
+static void
+cache_store(dns_sdlz_db_t *sdlz, const char *zonestr, const char *namestr,
+	    dns_sdlznode_t *node) {
+	dns_sdlzimplementation_t *imp = sdlz->dlzimp;
+	unsigned char key[2 * (DNS_NAME_MAXTEXT + 1)];
+	sdlz_cachekey_t ckey = { .dbdata = sdlz->dbdata, .key = key };
+	sdlz_cacheent_t *ent = NULL;
+	dns_rdatalist_t *rdatalist = NULL;
+	dns_rdata_t *rdata = NULL;
+	isc_stdtime_t now = isc_stdtime_now();
+	dns_ttl_t ttl = UINT32_MAX;
+	size_t datalen = 0;
+	isc_buffer_t b;
+	isc_result_t result;
+	uint32_t hashval;
+
+	ISC_LIST_FOREACH (node->lists, rdatalist, link) {
+		ttl = ISC_MIN(ttl, rdatalist->ttl);
+		ISC_LIST_FOREACH (rdatalist->rdata, rdata, link) {
+			datalen += 8 + rdata->length;
+		}
+	}
+	if (datalen == 0 || ttl == 0) {
+		return;
+	}
+
+	ckey.keylen = cache_makekey(key, zonestr, namestr);
+	hashval = isc_hash32(key, ckey.keylen, true);
+
+	ent = isc_mem_get(imp->mctx, sizeof(*ent) + ckey.keylen + datalen);
+	*ent = (sdlz_cacheent_t){
+		.dbdata = sdlz->dbdata,
+		.expire = now + ttl,
+		.keylen = ckey.keylen,
+		.datalen = datalen,
+		.key = (unsigned char *)(ent + 1),
+	};
+	ent->data = ent->key + ent->keylen;
+	memmove(ent->key, key, ent->keylen);
+
+	isc_buffer_init(&b, ent->data, datalen);
+	ISC_LIST_FOREACH (node->lists, rdatalist, link) {
+		ISC_LIST_FOREACH (rdatalist->rdata, rdata, link) {
+			isc_buffer_putuint16(&b, rdatalist->type);
+			isc_buffer_putuint32(&b, rdatalist->ttl);
+			isc_buffer_putuint16(&b, rdata->length);
+			isc_buffer_putmem(&b, rdata->data, rdata->length);
+		}
+	}
+
+	LOCK(&imp->cachelock);
+	if (isc_hashmap_count(imp->cache) >= SDLZ_CACHE_MAX &&
+	    imp->cachesweep != now)
+	{
+		imp->cachesweep = now;
+		cache_purge(imp, NULL, now);
+	}
+	result = ISC_R_NOSPACE;
+	if (isc_hashmap_count(imp->cache) < SDLZ_CACHE_MAX) {
+		result = isc_hashmap_add(imp->cache, hashval, cache_match,
+					 &ckey, ent, NULL);
+	}
+	UNLOCK(&imp->cachelock);
+
+	if (result != ISC_R_SUCCESS) {
+		cache_freeent(imp, ent);
+	}
+}
+
 static isc_result_t
 getnodedata(dns_db_t *db, const dns_name_t *name, bool create,
 	    unsigned int options, dns_clientinfomethods_t *methods,
@@ -465,6 +712,7 @@ getnodedata(dns_db_t *db, const dns_name_t *name, bool create,
 	isc_buffer_t b2;
 	char zonestr[DNS_NAME_MAXTEXT + 1];
 	bool isorigin;
+	bool cacheable, wildcard = false;
 	dns_sdlzauthorityfunc_t authority;
 
 	REQUIRE(VALID_SDLZDB(sdlz));
@@ -514,6 +762,14 @@ getnodedata(dns_db_t *db, const dns_name_t *name, bool create,
 	isc_ascii_strtolower(zonestr);
 	isc_ascii_strtolower(namestr);
 
+	cacheable = !create && sdlz->dlzimp->cache != NULL &&
+		    (sdlz->dlzimp->methods->cacheable == NULL ||
+		     sdlz->dlzimp->methods->cacheable(sdlz->dlzimp->driverarg,
+						      sdlz->dbdata));
+	if (cacheable && cache_fetch(sdlz, zonestr, namestr, node)) {
+		goto found;
+	}
+
 	MAYBE_LOCK(sdlz->dlzimp);
 
 	/* try to lookup the host (namestr) */
@@ -571,6 +827,7 @@ getnodedata(dns_db_t *db, const dns_name_t *name, bool create,
 				zonestr, wildstr, sdlz->dlzimp->driverarg,
 				sdlz->dbdata, node, methods, clientinfo);
 			if (result == ISC_R_SUCCESS) {
+				wildcard = true;
 				break;
 			}
 		}
@@ -601,6 +858,15 @@ getnodedata(dns_db_t *db, const dns_name_t *name, bool create,
 		}
 	}
 
+	/*
+	 * The wildcard answers are not cached, as whether they apply
+	 * depends on DNS_DBFIND_NOWILD.
+	 */
+	if (cacheable && !wildcard) {
+		cache_store(sdlz, zonestr, namestr, node);
+	}
+
+found:
 	if (node->name == NULL) {
 		node->name = isc_mem_get(sdlz->common.mctx, sizeof(dns_name_t));
 		dns_name_init(node->name, NULL);
@@ -1510,6 +1776,8 @@ dns_sdlzdestroy(void *driverdata, void **dbdata) {
 
 	imp = driverdata;
 
+	cache_flush(imp, *dbdata);
+
 	/* If the destroy method exists, call it. */
 	if (imp->methods->destroy != NULL) {
 		MAYBE_LOCK(imp);
@@ -1869,7 +2137,7 @@ dns_sdlzregister(const char *drivername, const dns_sdlzmethods_t *methods,
 	REQUIRE(sdlzimp != NULL && *sdlzimp == NULL);
 	REQUIRE((flags &
 		 ~(DNS_SDLZFLAG_RELATIVEOWNER | DNS_SDLZFLAG_RELATIVERDATA |
-		   DNS_SDLZFLAG_THREADSAFE)) == 0);
+		   DNS_SDLZFLAG_THREADSAFE | DNS_SDLZFLAG_CACHE)) == 0);
 
 	/* Write debugging message to log */
 	sdlz_log(ISC_LOG_DEBUG(2), "Registering SDLZ driver '%s'", drivername);
@@ -1896,6 +2164,11 @@ dns_sdlzregister(const char *drivername, const dns_sdlzmethods_t *methods,
 	 */
 	isc_mutex_init(&imp->driverlock);
 
+	if ((flags & DNS_SDLZFLAG_CACHE) != 0) {
+		isc_mutex_init(&imp->cachelock);
+		isc_hashmap_create(mctx, SDLZ_CACHE_BITS, &imp->cache);
+	}
+
 	/*
 	 * register the DLZ driver.  Pass in our "extra" sdlz information as
 	 * a driverarg.  (that's why we stored the passed in driver arg in our
@@ -1917,6 +2190,10 @@ dns_sdlzregister(const char *drivername, const dns_sdlzmethods_t *methods,
 cleanup_mutex:
 	/* destroy the driver lock, we don't need it anymore */
 	isc_mutex_destroy(&imp->driverlock);
+	if (imp->cache != NULL) {
+		isc_hashmap_destroy(&imp->cache);
+		isc_mutex_destroy(&imp->cachelock);
+	}
 
 	/*
 	 * return the memory back to the available memory pool and
@@ -1947,6 +2224,12 @@ dns_sdlzunregister(dns_sdlzimplementation_t **sdlzimp) {
 	/* destroy the driver lock, we don't need it anymore */
 	isc_mutex_destroy(&imp->driverlock);
 
+	if (imp->cache != NULL) {
+		cache_purge(imp, NULL, UINT32_MAX);
+		isc_hashmap_destroy(&imp->cache);
+		isc_mutex_destroy(&imp->cachelock);
+	}
+
 	/*
 	 * return the memory back to the available memory pool and
 	 * remove it from the memory context.
@@ -0,0 +1,309 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <isc/buffer.h>
+#include <isc/md.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/serial.h>
+#include <isc/stdtime.h>
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdataset.h>
+#include <dns/rdatastruct.h>
+#include <dns/sigcache.h>
+
+#include <dst/dst.h>
+
+typedef struct dns_scentry {
+	bool used;
+	dns_sigcachekey_t key;
+} dns_scentry_t;
+
+struct dns_sigcache {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	unsigned int size;
+	dns_scentry_t *entries;
+	isc_mutex_t locks[];
+};
+
+#define SIGCACHE_MAGIC	  ISC_MAGIC('S', 'g', 'C', 'a')
+#define VALID_SIGCACHE(m) ISC_MAGIC_VALID(m, SIGCACHE_MAGIC)
+
+/*
+ * Number of locks protecting the slots; slot 'i' is protected by
+ * lock 'i % SIGCACHE_LOCKS'.
+ */
+#define SIGCACHE_LOCKS 64
+
+#define CHECK(op)                            \
+	do {                                 \
+		result = (op);               \
+		if (result != ISC_R_SUCCESS) \
+			goto cleanup;        \
+	} while (0)
+
+dns_sigcache_t *
+dns_sigcache_new(isc_mem_t *mctx, unsigned int size) {
+	dns_sigcache_t *sc = NULL;
+
+	REQUIRE(mctx != NULL);
+	REQUIRE(size > 0);
+
+	sc = isc_mem_get(mctx, STRUCT_FLEX_SIZE(sc, locks, SIGCACHE_LOCKS));
+	*sc = (dns_sigcache_t){
+		.size = size,
+	};
+
+	isc_mem_attach(mctx, &sc->mctx);
+	sc->entries = isc_mem_cget(mctx, size, sizeof(sc->entries[0]));
+	for (size_t i = 0; i < SIGCACHE_LOCKS; i++) {
+		isc_mutex_init(&sc->locks[i]);
+	}
+
+	sc->magic = SIGCACHE_MAGIC;
+
+	return sc;
+}
+
+void
+dns_sigcache_destroy(dns_sigcache_t **scp) {
+	dns_sigcache_t *sc = NULL;
+
+	REQUIRE(scp != NULL && VALID_SIGCACHE(*scp));
+
+	sc = *scp;
+	*scp = NULL;
+	sc->magic = 0;
+
+	for (size_t i = 0; i < SIGCACHE_LOCKS; i++) {
+		isc_mutex_destroy(&sc->locks[i]);
+	}
+	isc_mem_cput(sc->mctx, sc->entries, sc->size, sizeof(sc->entries[0]));
+	isc_mem_putanddetach(&sc->mctx, sc,
+			     STRUCT_FLEX_SIZE(sc, locks, SIGCACHE_LOCKS));
+}
+
+static int
+rdata_compare_wrapper(const void *rdata1, const void *rdata2) {
+	return dns_rdata_compare((const dns_rdata_t *)rdata1,
+				 (const dns_rdata_t *)rdata2);
+}
+
+static isc_result_t
+digest_region(isc_md_t *md, isc_region_t *r) {
+	return isc_md_update(md, r->base, r->length);
+}
+
+static isc_result_t
+digest_uint16(isc_md_t *md, uint16_t value) {
+	unsigned char data[2];
+
+	data[0] = (value >> 8) & 0xff;
+	data[1] = value & 0xff;
+	return isc_md_update(md, data, sizeof(data));
+}
+
+/*
+ * Digest the rdatas of 'rdataset' in canonical order, skipping
+ * duplicates, so that a re-fetched RRset matches even when the
+ * server returned the records in a different order.
+ */
+static isc_result_t
+digest_rdataset(isc_md_t *md, isc_mem_t *mctx, dns_rdataset_t *rdataset) {
+	isc_result_t result = ISC_R_SUCCESS;
+	dns_rdataset_t clone;
+	dns_rdata_t *rdatas = NULL;
+	unsigned int n, i = 0;
+
+	n = dns_rdataset_count(rdataset);
+	if (n == 0) {
+		return ISC_R_NOMORE;
+	}
+
+	rdatas = isc_mem_cget(mctx, n, sizeof(rdatas[0]));
+
+	dns_rdataset_init(&clone);
+	dns_rdataset_clone(rdataset, &clone);
+	for (result = dns_rdataset_first(&clone);
+	     result == ISC_R_SUCCESS && i < n;
+	     result = dns_rdataset_next(&clone))
+	{
+		dns_rdata_init(&rdatas[i]);
+		dns_rdataset_current(&clone, &rdatas[i++]);
+	}
+	dns_rdataset_disassociate(&clone);
+
+	qsort(rdatas, i, sizeof(rdatas[0]), rdata_compare_wrapper);
+
+	result = ISC_R_SUCCESS;
+	for (unsigned int j = 0; j < i && result == ISC_R_SUCCESS; j++) {
+		isc_region_t r;
+
+		if (j > 0 && dns_rdata_compare(&rdatas[j], &rdatas[j - 1]) == 0)
+		{
+			continue;
+		}
+
+		dns_rdata_toregion(&rdatas[j], &r);
+		result = digest_uint16(md, r.length);
+		if (result == ISC_R_SUCCESS) {
+			result = digest_region(md, &r);
+		}
+	}
+
+	isc_mem_cput(mctx, rdatas, n, sizeof(rdatas[0]));
+	return result;
+}
+
+isc_result_t
+dns_sigcache_makekey(dns_sigcache_t *sc, const dns_name_t *name,
+		     dns_rdataset_t *rdataset, dns_rdata_t *sigrdata,
+		     dst_key_t *key, dns_sigcachekey_t *keyp) {
+	isc_result_t result;
+	dns_rdata_rrsig_t sig;
+	dns_fixedname_t fixed;
+	dns_name_t *lname = NULL;
+	unsigned char keydata[DST_KEY_MAXSIZE];
+	isc_buffer_t keybuf;
+	isc_region_t r;
+	isc_md_t *md = NULL;
+	unsigned int len = 0;
+
+	REQUIRE(VALID_SIGCACHE(sc));
+	REQUIRE(name != NULL);
+	REQUIRE(DNS_RDATASET_VALID(rdataset));
+	REQUIRE(sigrdata != NULL && sigrdata->type == dns_rdatatype_rrsig);
+	REQUIRE(key != NULL);
+	REQUIRE(keyp != NULL);
+
+	result = dns_rdata_tostruct(sigrdata, &sig, NULL);
+	if (result != ISC_R_SUCCESS) {
+		return result;
+	}
+	keyp->inception = sig.timesigned;
+	keyp->expiration = sig.timeexpire;
+	dns_rdata_freestruct(&sig);
+
+	isc_buffer_init(&keybuf, keydata, sizeof(keydata));
+	result = dst_key_todns(key, &keybuf);
+	if (result != ISC_R_SUCCESS) {
+		return result;
+	}
+
+	lname = dns_fixedname_initname(&fixed);
+	RUNTIME_CHECK(dns_name_downcase(name, lname, NULL) == ISC_R_SUCCESS);
+
+	md = isc_md_new();
+	CHECK(isc_md_init(md, ISC_MD_SHA256));
+
+	/* Owner name, type and class of the RRset. */
+	dns_name_toregion(lname, &r);
+	CHECK(digest_region(md, &r));
+	CHECK(digest_uint16(md, rdataset->type));
+	CHECK(digest_uint16(md, rdataset->rdclass));
+
+	/* The whole RRSIG, including the signature. */
+	dns_rdata_toregion(sigrdata, &r);
+	CHECK(digest_uint16(md, r.length));
+	CHECK(digest_region(md, &r));
+
+	/* The key, with its algorithm and flags. */
+	isc_buffer_usedregion(&keybuf, &r);
+	CHECK(digest_uint16(md, r.length));
+	CHECK(digest_region(md, &r));
+
+	CHECK(digest_rdataset(md, sc->mctx, rdataset));
+
+	CHECK(isc_md_final(md, keyp->digest, &len));
+	INSIST(len == sizeof(keyp->digest));
+
+cleanup:
+	isc_md_free(md);
+	return result;
+}
+
+static unsigned int
+slot(dns_sigcache_t *sc, const dns_sigcachekey_t *key) {
+	uint32_t hash;
+
+	memmove(&hash, key->digest, sizeof(hash));
+	return hash % sc->size;
+}
+
+bool
+dns_sigcache_find(dns_sigcache_t *sc, const dns_sigcachekey_t *key,
+		  isc_stdtime_t now) {
+	dns_scentry_t *entry = NULL;
+	unsigned int i;
+	bool found = false;
+
+	REQUIRE(VALID_SIGCACHE(sc));
+	REQUIRE(key != NULL);
+
+	if (isc_serial_lt((uint32_t)now, key->inception) ||
+	    isc_serial_lt(key->expiration, (uint32_t)now))
+	{
+		return false;
+	}
+
+	i = slot(sc, key);
+	entry = &sc->entries[i];
+
+	LOCK(&sc->locks[i % SIGCACHE_LOCKS]);
+	found = entry->used && memcmp(entry->key.digest, key->digest,
+				      sizeof(key->digest)) == 0;
+	UNLOCK(&sc->locks[i % SIGCACHE_LOCKS]);
+
+	return found;
+}
+
+void
+dns_sigcache_add(dns_sigcache_t *sc, const dns_sigcachekey_t *key) {
+	unsigned int i;
+
+	REQUIRE(VALID_SIGCACHE(sc));
+	REQUIRE(key != NULL);
+
+	i = slot(sc, key);
+
+	LOCK(&sc->locks[i % SIGCACHE_LOCKS]);
+	sc->entries[i] = (dns_scentry_t){
+		.used = true,
+		.key = *key,
+	};
+	UNLOCK(&sc->locks[i % SIGCACHE_LOCKS]);
+}
+
+void
+dns_sigcache_flush(dns_sigcache_t *sc) {
+	REQUIRE(VALID_SIGCACHE(sc));
+
+	for (size_t l = 0; l < SIGCACHE_LOCKS; l++) {
+		LOCK(&sc->locks[l]);
+		for (size_t i = l; i < sc->size; i += SIGCACHE_LOCKS) {
+			sc->entries[i].used = false;
+		}
+		UNLOCK(&sc->locks[l]);
+	}
+}
@@ -15,6 +15,7 @@
 
 #include <stdbool.h>
 
+#include <isc/hashmap.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
 #include <isc/netaddr.h>
@@ -47,16 +48,49 @@ struct dns_ssurule {
 	dns_ssuruletype_t *types;     /*%< the data types.  Can include */
 				      /*   ANY. if NULL, defaults to all */
 				      /*   types except SIG, SOA, and NS */
+	bool anytype;		      /*%< types include ANY */
+	uint64_t typemap[4];	      /*%< bitmap of types below 256 */
 	char *debug;		      /*%< text version for debugging */
+	unsigned int index;	      /*%< position in the table */
 	ISC_LINK(dns_ssurule_t) link;
 };
 
+/*
+ * An array of rules, kept in the order they were added to the table.
+ */
+typedef struct ssurules {
+	dns_ssurule_t **rules;
+	unsigned int count;
+	unsigned int size;
+} ssurules_t;
+
+/*
+ * The rules that can only match names at or below a given name are
+ * indexed by that name, so that checking an update only has to look
+ * at the rules found at the record name and at each of its ancestors,
+ * plus the rules that depend on the signer or the client address.
+ */
+typedef struct ssunode {
+	dns_name_t name;
+	ssurules_t rules;
+} ssunode_t;
+
+typedef struct ssucursor {
+	const ssurules_t *list;
+	unsigned int pos;
+} ssucursor_t;
+
+#define SSUTABLE_HASH_BITS 4
+
 struct dns_ssutable {
 	unsigned int magic;
 	isc_mem_t *mctx;
 	isc_refcount_t references;
 	dns_dlzdb_t *dlzdatabase;
 	ISC_LIST(dns_ssurule_t) rules;
+	unsigned int nrules;
+	isc_hashmap_t *nodes;
+	ssurules_t dynamic;
 };
 
 void
@@ -71,17 +105,46 @@ dns_ssutable_create(isc_mem_t *mctx, dns_ssutable_t **tablep) {
 	table->mctx = NULL;
 	isc_mem_attach(mctx, &table->mctx);
 	ISC_LIST_INIT(table->rules);
+	table->nrules = 0;
+	table->nodes = NULL;
+	isc_hashmap_create(mctx, SSUTABLE_HASH_BITS, &table->nodes);
+	table->dynamic = (ssurules_t){ 0 };
 	table->magic = SSUTABLEMAGIC;
 	*tablep = table;
 }
 
+static void
+freerules(isc_mem_t *mctx, ssurules_t *list) {
+	if (list->rules != NULL) {
+		isc_mem_cput(mctx, list->rules, list->size,
+			     sizeof(*list->rules));
+	}
+	*list = (ssurules_t){ 0 };
+}
+
 static void
 destroy(dns_ssutable_t *table) {
 	isc_mem_t *mctx;
+	isc_hashmap_iter_t *it = NULL;
 
 	REQUIRE(VALID_SSUTABLE(table));
 
 	mctx = table->mctx;
+
+	isc_hashmap_iter_create(table->nodes, &it);
+	for (isc_result_t result = isc_hashmap_iter_first(it);
+	     result == ISC_R_SUCCESS;
+	     result = isc_hashmap_iter_delcurrent_next(it))
+	{
+		ssunode_t *node = NULL;
+		isc_hashmap_iter_current(it, (void **)&node);
+		freerules(mctx, &node->rules);
+		isc_mem_put(mctx, node, sizeof(*node));
+	}
+	isc_hashmap_iter_destroy(&it);
+	isc_hashmap_destroy(&table->nodes);
+	freerules(mctx, &table->dynamic);
+
 	while (!ISC_LIST_EMPTY(table->rules)) {
 		dns_ssurule_t *rule = ISC_LIST_HEAD(table->rules);
 		if (rule->identity != NULL) {
@@ -178,6 +241,129 @@ mtypetostring(dns_ssumatchtype_t matchtype) {
 	return "UnknownMatchType";
 }
 
+static void
+appendrule(isc_mem_t *mctx, ssurules_t *list, dns_ssurule_t *rule) {
+	if (list->count == list->size) {
+		unsigned int size = list->size == 0 ? 4 : list->size * 2;
+		list->rules = isc_mem_creget(mctx, list->rules, list->size,
+					     size, sizeof(*list->rules));
+		list->size = size;
+	}
+	list->rules[list->count++] = rule;
+}
+
+static bool
+node_match(void *node0, const void *key) {
+	ssunode_t *node = node0;
+	return dns_name_equal(&node->name, key);
+}
+
+/*
+ * Add 'rule' to the index of 'table'.  Rules are numbered in the order
+ * they are added, which is the order they have to be tried in.
+ */
+static void
+indexrule(dns_ssutable_t *table, dns_ssurule_t *rule) {
+	dns_name_t anchor = DNS_NAME_INITEMPTY;
+	ssunode_t *node = NULL;
+	isc_result_t result;
+	uint32_t hashval;
+
+	rule->index = table->nrules++;
+
+	switch (rule->matchtype) {
+	case dns_ssumatchtype_name:
+	case dns_ssumatchtype_subdomain:
+	case dns_ssumatchtype_local:
+	case dns_ssumatchtype_subdomainkrb5:
+	case dns_ssumatchtype_subdomainms:
+	case dns_ssumatchtype_subdomainselfkrb5rhs:
+	case dns_ssumatchtype_subdomainselfmsrhs:
+		dns_name_clone(rule->name, &anchor);
+		break;
+	case dns_ssumatchtype_wildcard:
+		/* A wildcard only matches names below its parent */
+		dns_name_getlabelsequence(rule->name, 1,
+					  dns_name_countlabels(rule->name) - 1,
+					  &anchor);
+		break;
+	default:
+		appendrule(table->mctx, &table->dynamic, rule);
+		return;
+	}
+
+	hashval = dns_name_hash(&anchor);
+	result = isc_hashmap_find(table->nodes, hashval, node_match, &anchor,
+				  (void **)&node);
+	if (result != ISC_R_SUCCESS) {
+		node = isc_mem_get(table->mctx, sizeof(*node));
+		*node = (ssunode_t){ .name = DNS_NAME_INITEMPTY };
+		dns_name_clone(&anchor, &node->name);
+		result = isc_hashmap_add(table->nodes, hashval, node_match,
+					 &node->name, node, NULL);
+		INSIST(result == ISC_R_SUCCESS);
+	}
+	appendrule(table->mctx, &node->rules, rule);
+}
+
+/*
+ * Point 'cursors' at the rules that may match updates to 'name', and
+ * return how many there are.  'cursors' must have room for
+ * DNS_NAME_MAXLABELS + 1 entries.
+ */
+static unsigned int
+findrules(const dns_ssutable_t *table, const dns_name_t *name,
+	  ssucursor_t *cursors) {
+	unsigned int labels = dns_name_countlabels(name);
+	unsigned int n = 0;
+
+	if (table->dynamic.count > 0) {
+		cursors[n++] = (ssucursor_t){ .list = &table->dynamic };
+	}
+
+	for (unsigned int i = 0; i < labels; i++) {
+		dns_name_t suffix = DNS_NAME_INITEMPTY;
+		ssunode_t *node = NULL;
+		isc_result_t result;
+
+		dns_name_getlabelsequence(name, i, labels - i, &suffix);
+		result = isc_hashmap_find(table->nodes, dns_name_hash(&suffix),
+					  node_match, &suffix, (void **)&node);
+		if (result == ISC_R_SUCCESS) {
+			cursors[n++] = (ssucursor_t){ .list = &node->rules };
+		}
+	}
+
+	return n;
+}
+
+/*
+ * Return the first rule, in table order, not yet returned from the
+ * lists in 'cursors', or NULL if they are all exhausted.
+ */
+static dns_ssurule_t *
+nextrule(ssucursor_t *cursors, unsigned int ncursors) {
+	ssucursor_t *best = NULL;
+
+	for (unsigned int i = 0; i < ncursors; i++) {
+		ssucursor_t *cursor = &cursors[i];
+		if (cursor->pos == cursor->list->count) {
+			continue;
+		}
+		if (best == NULL || cursor->list->rules[cursor->pos]->index <
+					    best->list->rules[best->pos]->index)
+		{
+			best = cursor;
+		}
+	}
+
+	if (best == NULL) {
+		return NULL;
+	}
+
+	return best->list->rules[best->pos++];
+}
+
 void
 dns_ssutable_addrule(dns_ssutable_t *table, bool grant,
 		     const dns_name_t *identity, dns_ssumatchtype_t matchtype,
@@ -218,13 +404,38 @@ dns_ssutable_addrule(dns_ssutable_t *table, bool grant,
 	dns_name_init(rule->name, NULL);
 	dns_name_dup(name, mctx, rule->name);
 
-	if (ntypes > 0) {
-		memmove(rule->types, types, ntypes * sizeof(*rule->types));
+	for (unsigned int i = 0; i < ntypes; i++) {
+		dns_rdatatype_t type = types[i].type;
+
+		rule->types[i] = types[i];
+		if (type == dns_rdatatype_any) {
+			rule->anytype = true;
+		} else if (type < 256) {
+			rule->typemap[type / 64] |= UINT64_C(1) << (type % 64);
+		}
 	}
 
 	rule->debug = isc_mem_strdup(mctx, debug);
 
 	ISC_LIST_INITANDAPPEND(table->rules, rule, link);
+	indexrule(table, rule);
+}
+
+static bool
+rule_coverstype(const dns_ssurule_t *rule, dns_rdatatype_t type) {
+	if (rule->anytype) {
+		return true;
+	}
+	if (type < 256) {
+		uint64_t bit = UINT64_C(1) << (type % 64);
+		return (rule->typemap[type / 64] & bit) != 0;
+	}
+	for (unsigned int i = 0; i < rule->ntypes; i++) {
+		if (rule->types[i].type == type) {
+			return true;
+		}
+	}
+	return false;
 }
 
 static bool
@@ -336,7 +547,8 @@ dns_ssutable_checkrules(dns_ssutable_t *table, const dns_name_t *signer,
 	const dns_name_t *tname;
 	int match;
 	isc_result_t result;
-	unsigned int i;
+	ssucursor_t cursors[DNS_NAME_MAXLABELS + 1];
+	unsigned int ncursors;
 	bool logit = isc_log_wouldlog(99);
 
 	REQUIRE(VALID_SSUTABLE(table));
@@ -375,8 +587,13 @@ dns_ssutable_checkrules(dns_ssutable_t *table, const dns_name_t *signer,
 		return false;
 	}
 
-	for (rule = ISC_LIST_HEAD(table->rules); rule != NULL;
-	     rule = ISC_LIST_NEXT(rule, link))
+	/*
+	 * Only the rules that can match 'name' are tried, in the same
+	 * order as they appear in the table.
+	 */
+	ncursors = findrules(table, name, cursors);
+	for (rule = nextrule(cursors, ncursors); rule != NULL;
+	     rule = nextrule(cursors, ncursors))
 	{
 		if (logit) {
 			isc_log_write(DNS_LOGCATEGORY_UPDATE_POLICY,
@@ -947,14 +1164,7 @@ dns_ssutable_checkrules(dns_ssutable_t *table, const dns_name_t *signer,
 				continue;
 			}
 		} else {
-			for (i = 0; i < rule->ntypes; i++) {
-				if (rule->types[i].type == dns_rdatatype_any ||
-				    rule->types[i].type == type)
-				{
-					break;
-				}
-			}
-			if (i == rule->ntypes) {
+			if (!rule_coverstype(rule, type)) {
 				if (logit) {
 					isc_log_write(
 						DNS_LOGCATEGORY_UPDATE_POLICY,
@@ -1079,6 +1289,7 @@ dns_ssutable_createdlz(isc_mem_t *mctx, dns_ssutable_t **tablep,
 	rule->debug = isc_mem_strdup(mctx, "grant dlz");
 
 	ISC_LIST_INITANDAPPEND(table->rules, rule, link);
+	indexrule(table, rule);
 	*tablep = table;
 }
 
@@ -166,13 +166,17 @@ dns_stats_detach(dns_stats_t **statsp) {
  */
 static void
 create_stats(isc_mem_t *mctx, dns_statstype_t type, int ncounters,
-	     dns_stats_t **statsp) {
+	     bool perloop, dns_stats_t **statsp) {
 	dns_stats_t *stats = isc_mem_get(mctx, sizeof(*stats));
 
 	stats->counters = NULL;
 	isc_refcount_init(&stats->references, 1);
 
-	isc_stats_create(mctx, &stats->counters, ncounters);
+	if (perloop) {
+		isc_stats_createperloop(mctx, &stats->counters, ncounters);
+	} else {
+		isc_stats_create(mctx, &stats->counters, ncounters);
+	}
 
 	stats->magic = DNS_STATS_MAGIC;
 	stats->type = type;
@@ -185,7 +189,7 @@ void
 dns_generalstats_create(isc_mem_t *mctx, dns_stats_t **statsp, int ncounters) {
 	REQUIRE(statsp != NULL && *statsp == NULL);
 
-	create_stats(mctx, dns_statstype_general, ncounters, statsp);
+	create_stats(mctx, dns_statstype_general, ncounters, false, statsp);
 }
 
 void
@@ -197,7 +201,15 @@ dns_rdatatypestats_create(isc_mem_t *mctx, dns_stats_t **statsp) {
 	 * plus one additional for other RRtypes.
 	 */
 	create_stats(mctx, dns_statstype_rdtype, (RDTYPECOUNTER_MAXTYPE + 1),
-		     statsp);
+		     false, statsp);
+}
+
+void
+dns_rdatatypestats_createperloop(isc_mem_t *mctx, dns_stats_t **statsp) {
+	REQUIRE(statsp != NULL && *statsp == NULL);
+
+	create_stats(mctx, dns_statstype_rdtype, (RDTYPECOUNTER_MAXTYPE + 1),
+		     true, statsp);
 }
 
 void
@@ -205,14 +217,21 @@ dns_rdatasetstats_create(isc_mem_t *mctx, dns_stats_t **statsp) {
 	REQUIRE(statsp != NULL && *statsp == NULL);
 
 	create_stats(mctx, dns_statstype_rdataset, (RDTYPECOUNTER_MAXVAL + 1),
-		     statsp);
+		     false, statsp);
 }
 
 void
 dns_opcodestats_create(isc_mem_t *mctx, dns_stats_t **statsp) {
 	REQUIRE(statsp != NULL && *statsp == NULL);
 
-	create_stats(mctx, dns_statstype_opcode, 16, statsp);
+	create_stats(mctx, dns_statstype_opcode, 16, false, statsp);
+}
+
+void
+dns_opcodestats_createperloop(isc_mem_t *mctx, dns_stats_t **statsp) {
+	REQUIRE(statsp != NULL && *statsp == NULL);
+
+	create_stats(mctx, dns_statstype_opcode, 16, true, statsp);
 }
 
 void
@@ -220,7 +239,15 @@ dns_rcodestats_create(isc_mem_t *mctx, dns_stats_t **statsp) {
 	REQUIRE(statsp != NULL && *statsp == NULL);
 
 	create_stats(mctx, dns_statstype_rcode, dns_rcode_badcookie + 1,
-		     statsp);
+		     false, statsp);
+}
+
+void
+dns_rcodestats_createperloop(isc_mem_t *mctx, dns_stats_t **statsp) {
+	REQUIRE(statsp != NULL && *statsp == NULL);
+
+	create_stats(mctx, dns_statstype_rcode, dns_rcode_badcookie + 1,
+		     true, statsp);
 }
 
 void
@@ -232,7 +259,7 @@ dns_dnssecsignstats_create(isc_mem_t *mctx, dns_stats_t **statsp) {
 	 * the actual counters for creating and refreshing signatures.
 	 */
 	create_stats(mctx, dns_statstype_dnssec,
-		     dnssecsign_num_keys * dnssecsign_block_size, statsp);
+		     dnssecsign_num_keys * dnssecsign_block_size, false, statsp);
 }
 
 /*%
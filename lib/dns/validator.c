@@ -25,8 +25,10 @@
 #include <isc/mem.h>
 #include <isc/refcount.h>
 #include <isc/result.h>
+#include <isc/stdtime.h>
 #include <isc/string.h>
 #include <isc/tid.h>
+#include <isc/time.h>
 #include <isc/util.h>
 #include <isc/work.h>
 
@@ -44,6 +46,8 @@
 #include <dns/rdataset.h>
 #include <dns/rdatatype.h>
 #include <dns/resolver.h>
+#include <dns/sigcache.h>
+#include <dns/stats.h>
 #include <dns/validator.h>
 #include <dns/view.h>
 
@@ -232,6 +236,12 @@ validator_done(dns_validator_t *val, isc_result_t result) {
 	val->attributes |= VALATTR_COMPLETE;
 	val->result = result;
 
+	if (val->view->resolver != NULL) {
+		dns_resolver_addstats(val->view->resolver,
+				      dns_resstatscounter_validationcpu,
+				      val->cputime);
+	}
+
 	isc_async_run(val->loop, val->cb, val);
 }
 
@@ -973,6 +983,20 @@ create_validator(dns_validator_t *val, dns_name_t *name, dns_rdatatype_t type,
 	return result;
 }
 
+/*%
+ * Build a public key from DNSKEY rdata, shared through the DST key cache
+ * with the other validations that use the same key.
+ */
+static isc_result_t
+keyfromrdata(const dns_name_t *name, dns_rdata_t *rdata, dst_key_t **keyp) {
+	isc_buffer_t b;
+
+	isc_buffer_init(&b, rdata->data, rdata->length);
+	isc_buffer_add(&b, rdata->length);
+
+	return dst_key_fromdns_cached(name, rdata->rdclass, &b, keyp);
+}
+
 /*%
  * Try to find a key that could have signed val->siginfo among those in
  * 'rdataset'.  If found, build a dst_key_t for it and point val->key at
@@ -1008,12 +1032,18 @@ select_signing_key(dns_validator_t *val, dns_rdataset_t *rdataset) {
 	do {
 		dns_rdataset_current(rdataset, &rdata);
 
-		isc_buffer_init(&b, rdata.data, rdata.length);
-		isc_buffer_add(&b, rdata.length);
 		INSIST(val->key == NULL);
-		result = dst_key_fromdns_ex(&siginfo->signer, rdata.rdclass, &b,
-					    val->view->mctx, no_rdata,
-					    &val->key);
+		if (no_rdata) {
+			isc_buffer_init(&b, rdata.data, rdata.length);
+			isc_buffer_add(&b, rdata.length);
+			result = dst_key_fromdns_ex(&siginfo->signer,
+						    rdata.rdclass, &b,
+						    val->view->mctx, true,
+						    &val->key);
+		} else {
+			result = keyfromrdata(&siginfo->signer, &rdata,
+					      &val->key);
+		}
 		if (result == ISC_R_SUCCESS) {
 			if (siginfo->algorithm ==
 				    (dns_secalg_t)dst_key_alg(val->key) &&
@@ -1326,8 +1356,7 @@ selfsigned_dnskey(dns_validator_t *val) {
 				return ISC_R_SUCCESS;
 			}
 
-			result = dns_dnssec_keyfromrdata(name, &keyrdata, mctx,
-							 &dstkey);
+			result = keyfromrdata(name, &keyrdata, &dstkey);
 			if (result != ISC_R_SUCCESS) {
 				continue;
 			}
@@ -1401,11 +1430,29 @@ verify(dns_validator_t *val, dst_key_t *key, dns_rdata_t *rdata,
        uint16_t keyid) {
 	isc_result_t result;
 	dns_fixedname_t fixed;
+	dns_sigcachekey_t sckey;
+	bool cacheable;
 	bool ignore = false;
 	dns_name_t *wild;
 
 	val->attributes |= VALATTR_TRIEDVERIFY;
 	wild = dns_fixedname_initname(&fixed);
+
+	/*
+	 * If this exact signature has already been verified with this
+	 * key over the same RRset, skip the public key operation.
+	 */
+	cacheable = dns_sigcache_makekey(val->view->sigcache, val->name,
+					 val->rdataset, rdata, key,
+					 &sckey) == ISC_R_SUCCESS;
+	if (cacheable &&
+	    dns_sigcache_find(val->view->sigcache, &sckey, isc_stdtime_now()))
+	{
+		validator_log(val, ISC_LOG_DEBUG(3),
+			      "verify rdataset (keyid=%u): cached", keyid);
+		return ISC_R_SUCCESS;
+	}
+
 	if (over_max_validations(val)) {
 		return ISC_R_QUOTA;
 	}
@@ -1413,6 +1460,13 @@ again:
 	result = dns_dnssec_verify(val->name, val->rdataset, key, ignore,
 				   val->view->maxbits, val->view->mctx, rdata,
 				   wild);
+	if (result == ISC_R_SUCCESS && !ignore && cacheable) {
+		/*
+		 * Wildcard expansions (DNS_R_FROMWILDCARD) are not cached,
+		 * as the closest encloser needs to be computed for them.
+		 */
+		dns_sigcache_add(val->view->sigcache, &sckey);
+	}
 	if ((result == DNS_R_SIGEXPIRED || result == DNS_R_SIGFUTURE) &&
 	    val->view->acceptexpired)
 	{
@@ -1563,6 +1617,7 @@ static void
 validate_answer_signing_key(void *arg) {
 	dns_validator_t *val = arg;
 	isc_result_t result = ISC_R_NOTFOUND;
+	isc_nanosecs_t start = isc_time_threadcpu();
 
 	if (CANCELED(val) || CANCELING(val)) {
 		val->result = ISC_R_CANCELED;
@@ -1594,6 +1649,7 @@ validate_answer_signing_key(void *arg) {
 		INSIST(val->key == NULL);
 	}
 
+	val->cputime += isc_time_threadcpu() - start;
 	(void)validate_async_run(val, validate_answer_signing_key_done);
 }
 
@@ -1618,6 +1674,7 @@ static void
 validate_answer_process(void *arg) {
 	dns_validator_t *val = arg;
 	isc_result_t result;
+	isc_nanosecs_t start = isc_time_threadcpu();
 
 	val->attributes &= ~VALATTR_OFFLOADED;
 	if (CANCELING(val)) {
@@ -1671,6 +1728,8 @@ validate_answer_process(void *arg) {
 		goto next_key;
 	}
 
+	/* Before the helper thread can update it */
+	val->cputime += isc_time_threadcpu() - start;
 	(void)validate_helper_run(val, validate_answer_signing_key);
 	return;
 
@@ -1679,6 +1738,7 @@ next_key:
 	goto cleanup;
 
 cleanup:
+	val->cputime += isc_time_threadcpu() - start;
 	validate_async_done(val, result);
 }
 
@@ -1793,10 +1853,51 @@ validate_async_run(dns_validator_t *val, isc_job_cb cb) {
 	return DNS_R_WAIT;
 }
 
+/*
+ * Take a slot for running a verification in the libuv thread pool;
+ * fails when the pool is not used or the view's limit is reached.
+ */
+static bool
+validate_work_acquire(dns_validator_t *val) {
+	uint32_t max = val->view->maxoffloaded;
+
+	if (max == 0) {
+		return false;
+	}
+
+	if (atomic_fetch_add_relaxed(&val->view->offloaded, 1) >= max) {
+		atomic_fetch_sub_release(&val->view->offloaded, 1);
+		return false;
+	}
+
+	return true;
+}
+
+static void
+validate_work_done(void *arg) {
+	dns_validator_t *val = arg;
+
+	atomic_fetch_sub_release(&val->view->offloaded, 1);
+	dns_validator_detach(&val);
+}
+
+/*
+ * Run the crypto heavy 'cb' off the loop thread: in the libuv thread
+ * pool when a slot is available, so that one expensive chain doesn't
+ * hold up the other validations on this loop, and on the loop's
+ * helper thread otherwise.  In both cases 'cb' resumes the validator
+ * on its loop with validate_async_run().  The thread pool holds an
+ * extra reference until the work is reported done.
+ */
 static isc_result_t
 validate_helper_run(dns_validator_t *val, isc_job_cb cb) {
 	val->attributes |= VALATTR_OFFLOADED;
-	isc_helper_run(val->loop, cb, val);
+	if (validate_work_acquire(val)) {
+		isc_work_enqueue(val->loop, cb, validate_work_done,
+				 dns_validator_ref(val));
+	} else {
+		isc_helper_run(val->loop, cb, val);
+	}
 	return DNS_R_WAIT;
 }
 
@@ -1845,8 +1946,7 @@ check_signer(dns_validator_t *val, dns_rdata_t *keyrdata, uint16_t keyid,
 			continue;
 		}
 		if (dstkey == NULL) {
-			result = dns_dnssec_keyfromrdata(
-				val->name, keyrdata, val->view->mctx, &dstkey);
+			result = keyfromrdata(val->name, keyrdata, &dstkey);
 			if (result != ISC_R_SUCCESS) {
 				/*
 				 * This really shouldn't happen, but...
@@ -2049,6 +2149,7 @@ validate_dnskey_dsset_next_done(void *arg);
 static void
 validate_dnskey_dsset_next(void *arg) {
 	dns_validator_t *val = arg;
+	isc_nanosecs_t start = isc_time_threadcpu();
 
 	if (CANCELED(val) || CANCELING(val)) {
 		val->result = ISC_R_CANCELED;
@@ -2061,6 +2162,7 @@ validate_dnskey_dsset_next(void *arg) {
 		val->result = validate_dnskey_dsset(val);
 	}
 
+	val->cputime += isc_time_threadcpu() - start;
 	validate_async_run(val, validate_dnskey_dsset_next_done);
 }
 
@@ -3279,6 +3381,7 @@ static void
 validator_start(void *arg) {
 	dns_validator_t *val = (dns_validator_t *)arg;
 	isc_result_t result = ISC_R_FAILURE;
+	isc_nanosecs_t start = isc_time_threadcpu();
 
 	if (CANCELED(val) || CANCELING(val)) {
 		result = ISC_R_CANCELED;
@@ -3363,6 +3466,7 @@ validator_start(void *arg) {
 	}
 
 cleanup:
+	val->cputime += isc_time_threadcpu() - start;
 	validate_async_done(val, result);
 }
 
@@ -56,6 +56,7 @@
 #include <dns/resolver.h>
 #include <dns/rpz.h>
 #include <dns/rrl.h>
+#include <dns/sigcache.h>
 #include <dns/stats.h>
 #include <dns/time.h>
 #include <dns/transport.h>
@@ -84,6 +85,11 @@
  */
 #define DEFAULT_EDNS_BUFSIZE 1232
 
+/*%
+ * Number of slots in the signature verification cache.
+ */
+#define SIGCACHE_SIZE 8192
+
 isc_result_t
 dns_view_create(isc_mem_t *mctx, isc_loopmgr_t *loopmgr,
 		dns_dispatchmgr_t *dispatchmgr, dns_rdataclass_t rdclass,
@@ -150,6 +156,7 @@ dns_view_create(isc_mem_t *mctx, isc_loopmgr_t *loopmgr,
 	dns_tsigkeyring_create(view->mctx, &view->dynamickeys);
 
 	view->failcache = dns_badcache_new(view->mctx, loopmgr);
+	view->sigcache = dns_sigcache_new(view->mctx, SIGCACHE_SIZE);
 
 	isc_mutex_init(&view->new_zone_lock);
 
@@ -180,6 +187,7 @@ cleanup_order:
 cleanup_new_zone_lock:
 	isc_mutex_destroy(&view->new_zone_lock);
 	dns_badcache_destroy(&view->failcache);
+	dns_sigcache_destroy(&view->sigcache);
 
 	if (view->dynamickeys != NULL) {
 		dns_tsigkeyring_detach(&view->dynamickeys);
@@ -192,6 +200,7 @@ cleanup_new_zone_lock:
 	isc_refcount_destroy(&view->references);
 
 	dns_fwdtable_destroy(&view->fwdtable);
+	INSIST(view->bulkzonetable == NULL);
 	dns_zt_detach(&view->zonetable);
 
 	isc_mutex_destroy(&view->lock);
@@ -407,6 +416,9 @@ destroy(dns_view_t *view) {
 	if (view->failcache != NULL) {
 		dns_badcache_destroy(&view->failcache);
 	}
+	if (view->sigcache != NULL) {
+		dns_sigcache_destroy(&view->sigcache);
+	}
 	isc_mutex_destroy(&view->new_zone_lock);
 	isc_mutex_destroy(&view->lock);
 	isc_refcount_destroy(&view->references);
@@ -772,6 +784,35 @@ dns_view_delzone(dns_view_t *view, dns_zone_t *zone) {
 	return result;
 }
 
+void
+dns_view_beginzones(dns_view_t *view) {
+	dns_zt_t *zonetable = NULL;
+
+	REQUIRE(DNS_VIEW_VALID(view));
+	REQUIRE(view->bulkzonetable == NULL);
+
+	rcu_read_lock();
+	zonetable = rcu_dereference(view->zonetable);
+	if (zonetable != NULL) {
+		dns_zt_attach(zonetable, &view->bulkzonetable);
+	}
+	rcu_read_unlock();
+
+	if (view->bulkzonetable != NULL) {
+		dns_zt_beginbulk(view->bulkzonetable);
+	}
+}
+
+void
+dns_view_endzones(dns_view_t *view) {
+	REQUIRE(DNS_VIEW_VALID(view));
+
+	if (view->bulkzonetable != NULL) {
+		dns_zt_endbulk(view->bulkzonetable);
+		dns_zt_detach(&view->bulkzonetable);
+	}
+}
+
 isc_result_t
 dns_view_findzone(dns_view_t *view, const dns_name_t *name,
 		  unsigned int options, dns_zone_t **zonep) {
@@ -1453,6 +1494,9 @@ dns_view_flushcache(dns_view_t *view, bool fixuponly) {
 	if (view->failcache != NULL) {
 		dns_badcache_flush(view->failcache);
 	}
+	if (view->sigcache != NULL) {
+		dns_sigcache_flush(view->sigcache);
+	}
 
 	rcu_read_lock();
 	adb = rcu_dereference(view->adb);
@@ -134,6 +134,9 @@ struct dns_xfrin {
 
 	/* Diff queue */
 	bool diff_running;
+	bool recv_paused; /*%< Reading stopped until the queue drains */
+	bool retry_axfr;  /*%< Retry with AXFR once the queue drains */
+	atomic_uint diff_queued; /*%< Records waiting in the queue */
 	struct __cds_wfcq_head diff_head;
 	struct cds_wfcq_tail diff_tail;
 
@@ -152,6 +155,7 @@ struct dns_xfrin {
 	 */
 	atomic_uint nmsg;	     /*%< Number of messages recvd */
 	atomic_uint nrecs;	     /*%< Number of records recvd */
+	atomic_uint napplied;	     /*%< Number of records stored */
 	atomic_uint_fast64_t nbytes; /*%< Number of bytes received */
 	_Atomic(isc_time_t) start;   /*%< Start time of the transfer */
 	_Atomic(dns_transport_type_t) soa_transport_type;
@@ -183,6 +187,8 @@ struct dns_xfrin {
 		uint32_t request_serial;
 		uint32_t current_serial;
 		dns_journal_t *journal;
+		bool intransaction; /*%< A transaction has been partly
+				     *   applied by the work thread */
 	} ixfr;
 
 	dns_rdata_t firstsoa;
@@ -210,6 +216,31 @@ typedef struct xfrin_work {
 	dns_xfrin_t *xfr;
 } xfrin_work_t;
 
+/*%
+ * A batch of changes queued to be applied to the database by
+ * a work thread.
+ */
+typedef struct xfrin_apply_data {
+	dns_diff_t diff; /*%< Pending database changes */
+	bool end;	 /*%< The last changes of an IXFR transaction */
+	struct cds_wfcq_node wfcq_node;
+} xfrin_apply_data_t;
+
+/*%
+ * The records are stored in the database by a work thread while the
+ * following messages are received and parsed.  When that many records
+ * are waiting to be stored, reading from the primary is paused until
+ * the work thread catches up.
+ */
+#define XFRIN_MAXQUEUED 65536
+
+/*%
+ * The changes of a large IXFR transaction are queued in chunks of that
+ * many records, so that they don't need to be held in memory all at
+ * once; the transaction is committed after the last one.
+ */
+#define IXFR_CHUNKSIZE 1024
+
 /**************************************************************************/
 /*
  * Forward declarations.
@@ -248,6 +279,8 @@ xfr_rr(dns_xfrin_t *xfr, dns_name_t *name, uint32_t ttl, dns_rdata_t *rdata);
 
 static isc_result_t
 xfrin_start(dns_xfrin_t *xfr);
+static isc_result_t
+xfrin_readnext(dns_xfrin_t *xfr);
 
 static void
 xfrin_connect_done(isc_result_t result, isc_region_t *region, void *arg);
@@ -260,6 +293,8 @@ xfrin_recv_done(isc_result_t result, isc_region_t *region, void *arg);
 
 static void
 xfrin_end(dns_xfrin_t *xfr, isc_result_t result);
+static void
+xfrin_reset(dns_xfrin_t *xfr);
 
 static void
 xfrin_destroy(dns_xfrin_t *xfr);
@@ -277,6 +312,94 @@ static void
 xfrin_log(dns_xfrin_t *xfr, int level, const char *fmt, ...)
 	ISC_FORMAT_PRINTF(3, 4);
 
+/**************************************************************************/
+/*
+ * Diff queue
+ */
+
+/*
+ * Queue the pending changes to be applied by 'apply' in a work thread,
+ * starting one unless it is already running.
+ */
+static void
+xfrin_enqueue(dns_xfrin_t *xfr, bool end, isc_work_cb apply,
+	      isc_after_work_cb apply_done) {
+	xfrin_apply_data_t *data = isc_mem_get(xfr->mctx, sizeof(*data));
+
+	*data = (xfrin_apply_data_t){ .end = end };
+	cds_wfcq_node_init(&data->wfcq_node);
+
+	dns_diff_init(xfr->mctx, &data->diff);
+	ISC_LIST_MOVE(data->diff.tuples, xfr->diff.tuples);
+	data->diff.size = xfr->diff.size;
+	xfr->diff.size = 0;
+
+	atomic_fetch_add_relaxed(&xfr->diff_queued, data->diff.size);
+	(void)cds_wfcq_enqueue(&xfr->diff_head, &xfr->diff_tail,
+			       &data->wfcq_node);
+
+	if (!xfr->diff_running) {
+		xfrin_work_t *work = isc_mem_get(xfr->mctx, sizeof(*work));
+		*work = (xfrin_work_t){
+			.magic = XFRIN_WORK_MAGIC,
+			.result = ISC_R_UNSET,
+			.xfr = dns_xfrin_ref(xfr),
+		};
+		xfr->diff_running = true;
+		isc_work_enqueue_bulk(xfr->loop, apply, apply_done, work);
+	}
+}
+
+/*
+ * Free a queued set of changes once it has been applied, or when
+ * giving up.
+ */
+static void
+xfrin_apply_data_free(dns_xfrin_t *xfr, xfrin_apply_data_t *data) {
+	atomic_fetch_sub_relaxed(&xfr->diff_queued, dns_diff_size(&data->diff));
+	dns_diff_clear(&data->diff);
+	isc_mem_put(xfr->mctx, data, sizeof(*data));
+}
+
+/*
+ * Called on the loop once the work thread has drained the queue:
+ * resume reading if it was paused.
+ */
+static isc_result_t
+xfrin_resume(dns_xfrin_t *xfr) {
+	isc_result_t result;
+
+	if (!xfr->recv_paused) {
+		return ISC_R_SUCCESS;
+	}
+
+	xfr->recv_paused = false;
+	dns_xfrin_ref(xfr);
+	result = xfrin_readnext(xfr);
+	if (result != ISC_R_SUCCESS) {
+		dns_xfrin_unref(xfr);
+	}
+	return result;
+}
+
+/*
+ * Retry the transfer with AXFR, as requested while the work thread was
+ * busy with the changes received so far.
+ */
+static void
+xfrin_retry(dns_xfrin_t *xfr) {
+	isc_result_t result;
+
+	xfr->retry_axfr = false;
+	xfrin_reset(xfr);
+	xfr->reqtype = dns_rdatatype_soa;
+	atomic_store(&xfr->state, XFRST_SOAQUERY);
+	result = xfrin_start(xfr);
+	if (result != ISC_R_SUCCESS) {
+		xfrin_fail(xfr, result, "failed setting up socket");
+	}
+}
+
 /**************************************************************************/
 /*
  * AXFR handling
@@ -305,7 +428,7 @@ failure:
 }
 
 static void
-axfr_apply(void *arg);
+axfr_enqueue(dns_xfrin_t *xfr);
 
 static isc_result_t
 axfr_putdata(dns_xfrin_t *xfr, dns_diffop_t op, dns_name_t *name, dns_ttl_t ttl,
@@ -322,13 +445,7 @@ axfr_putdata(dns_xfrin_t *xfr, dns_diffop_t op, dns_name_t *name, dns_ttl_t ttl,
 	if (dns_diff_size(&xfr->diff) > 128 &&
 	    dns_diff_is_boundary(&xfr->diff, name))
 	{
-		xfrin_work_t work = (xfrin_work_t){
-			.magic = XFRIN_WORK_MAGIC,
-			.result = ISC_R_UNSET,
-			.xfr = xfr,
-		};
-		axfr_apply((void *)&work);
-		CHECK(work.result);
+		axfr_enqueue(xfr);
 	}
 
 	dns_difftuple_create(xfr->diff.mctx, op, name, ttl, rdata, &tuple);
@@ -342,6 +459,26 @@ failure:
 /*
  * Store a set of AXFR RRs in the database.
  */
+static isc_result_t
+axfr_apply_one(dns_xfrin_t *xfr, xfrin_apply_data_t *data) {
+	isc_result_t result;
+	uint64_t records;
+
+	CHECK(dns_diff_load(&data->diff, &xfr->axfr));
+	atomic_fetch_add_relaxed(&xfr->napplied, dns_diff_size(&data->diff));
+	if (xfr->maxrecords != 0U) {
+		result = dns_db_getsize(xfr->db, xfr->ver, &records, NULL);
+		if (result == ISC_R_SUCCESS && records > xfr->maxrecords) {
+			result = DNS_R_TOOMANYRECORDS;
+			goto failure;
+		}
+	}
+
+	result = ISC_R_SUCCESS;
+failure:
+	return result;
+}
+
 static void
 axfr_apply(void *arg) {
 	xfrin_work_t *work = arg;
@@ -351,24 +488,34 @@ axfr_apply(void *arg) {
 	REQUIRE(VALID_XFRIN(xfr));
 
 	isc_result_t result = ISC_R_SUCCESS;
-	uint64_t records;
+	struct __cds_wfcq_head diff_head;
+	struct cds_wfcq_tail diff_tail;
 
-	if (atomic_load(&xfr->shuttingdown)) {
-		result = ISC_R_SHUTTINGDOWN;
-		goto failure;
-	}
+	/* Initialize local wfcqueue */
+	__cds_wfcq_init(&diff_head, &diff_tail);
 
-	CHECK(dns_diff_load(&xfr->diff, &xfr->axfr));
-	if (xfr->maxrecords != 0U) {
-		result = dns_db_getsize(xfr->db, xfr->ver, &records, NULL);
-		if (result == ISC_R_SUCCESS && records > xfr->maxrecords) {
-			result = DNS_R_TOOMANYRECORDS;
-			goto failure;
+	enum cds_wfcq_ret ret = __cds_wfcq_splice_blocking(
+		&diff_head, &diff_tail, &xfr->diff_head, &xfr->diff_tail);
+	INSIST(ret == CDS_WFCQ_RET_DEST_EMPTY);
+
+	struct cds_wfcq_node *node, *next;
+	__cds_wfcq_for_each_blocking_safe(&diff_head, &diff_tail, node, next) {
+		xfrin_apply_data_t *data =
+			caa_container_of(node, xfrin_apply_data_t, wfcq_node);
+
+		if (atomic_load(&xfr->shuttingdown)) {
+			result = ISC_R_SHUTTINGDOWN;
 		}
+
+		/* Apply only until first failure */
+		if (result == ISC_R_SUCCESS) {
+			result = axfr_apply_one(xfr, data);
+		}
+
+		/* We need to clear and free all data chunks */
+		xfrin_apply_data_free(xfr, data);
 	}
 
-failure:
-	dns_diff_clear(&xfr->diff);
 	work->result = result;
 }
 
@@ -385,12 +532,31 @@ axfr_apply_done(void *arg) {
 		result = ISC_R_SHUTTINGDOWN;
 	}
 
-	if (result == ISC_R_SUCCESS) {
+	if (result != ISC_R_SUCCESS) {
+		(void)dns_db_endload(xfr->db, &xfr->axfr);
+		goto failure;
+	}
+
+	result = xfrin_resume(xfr);
+	if (result != ISC_R_SUCCESS) {
+		(void)dns_db_endload(xfr->db, &xfr->axfr);
+		goto failure;
+	}
+
+	/* Reschedule */
+	if (!cds_wfcq_empty(&xfr->diff_head, &xfr->diff_tail)) {
+		isc_work_enqueue_bulk(xfr->loop, axfr_apply, axfr_apply_done,
+				      work);
+		return;
+	}
+
+	/*
+	 * The last batch has been stored, the zone is complete.
+	 */
+	if (atomic_load(&xfr->state) == XFRST_AXFR_END) {
 		CHECK(dns_db_endload(xfr->db, &xfr->axfr));
 		CHECK(dns_zone_verifydb(xfr->zone, xfr->db, NULL));
 		CHECK(axfr_finalize(xfr));
-	} else {
-		(void)dns_db_endload(xfr->db, &xfr->axfr);
 	}
 
 failure:
@@ -399,7 +565,9 @@ failure:
 	isc_mem_put(xfr->mctx, work, sizeof(*work));
 
 	if (result == ISC_R_SUCCESS) {
-		if (atomic_load(&xfr->state) == XFRST_AXFR_END) {
+		if (xfr->retry_axfr) {
+			xfrin_retry(xfr);
+		} else if (atomic_load(&xfr->state) == XFRST_AXFR_END) {
 			xfrin_end(xfr, result);
 		}
 	} else {
@@ -409,18 +577,21 @@ failure:
 	dns_xfrin_detach(&xfr);
 }
 
+/*
+ * Queue the pending AXFR RRs to be stored in the database.
+ */
 static void
-axfr_commit(dns_xfrin_t *xfr) {
-	REQUIRE(!xfr->diff_running);
+axfr_enqueue(dns_xfrin_t *xfr) {
+	xfrin_enqueue(xfr, false, axfr_apply, axfr_apply_done);
+}
 
-	xfrin_work_t *work = isc_mem_get(xfr->mctx, sizeof(*work));
-	*work = (xfrin_work_t){
-		.magic = XFRIN_WORK_MAGIC,
-		.result = ISC_R_UNSET,
-		.xfr = dns_xfrin_ref(xfr),
-	};
-	xfr->diff_running = true;
-	isc_work_enqueue(xfr->loop, axfr_apply, axfr_apply_done, work);
+/*
+ * Store the last AXFR RRs; the zone is finalized once they are in the
+ * database.
+ */
+static void
+axfr_commit(dns_xfrin_t *xfr) {
+	axfr_enqueue(xfr);
 }
 
 static isc_result_t
@@ -439,11 +610,6 @@ axfr_finalize(dns_xfrin_t *xfr) {
  * IXFR handling
  */
 
-typedef struct ixfr_apply_data {
-	dns_diff_t diff; /*%< Pending database changes */
-	struct cds_wfcq_node wfcq_node;
-} ixfr_apply_data_t;
-
 static isc_result_t
 ixfr_init(dns_xfrin_t *xfr) {
 	isc_result_t result;
@@ -462,6 +628,8 @@ ixfr_init(dns_xfrin_t *xfr) {
 	if (journalfile != NULL) {
 		CHECK(dns_journal_open(xfr->mctx, journalfile,
 				       DNS_JOURNAL_CREATE, &xfr->ixfr.journal));
+		dns_journal_setindex(xfr->ixfr.journal,
+				     dns_zone_getjournalindex(xfr->zone));
 	}
 
 	result = ISC_R_SUCCESS;
@@ -469,6 +637,13 @@ failure:
 	return result;
 }
 
+static void
+ixfr_apply(void *arg);
+static void
+ixfr_apply_done(void *arg);
+static isc_result_t
+ixfr_enqueue(dns_xfrin_t *xfr, bool end);
+
 static isc_result_t
 ixfr_putdata(dns_xfrin_t *xfr, dns_diffop_t op, dns_name_t *name, dns_ttl_t ttl,
 	     dns_rdata_t *rdata) {
@@ -487,6 +662,13 @@ ixfr_putdata(dns_xfrin_t *xfr, dns_diffop_t op, dns_name_t *name, dns_ttl_t ttl,
 	dns_diff_append(&xfr->diff, &tuple);
 
 	xfr->ixfr.diffs++;
+
+	/*
+	 * Stream large transactions to the database in chunks.
+	 */
+	if (dns_diff_size(&xfr->diff) >= IXFR_CHUNKSIZE) {
+		CHECK(ixfr_enqueue(xfr, false));
+	}
 failure:
 	return result;
 }
@@ -515,12 +697,24 @@ failure:
 	return result;
 }
 
+/*
+ * Apply a chunk of an IXFR transaction to the database and append it
+ * to the journal, beginning the transaction with the first chunk and
+ * committing it with the last one.
+ *
+ * On failure, the transaction is left uncommitted: the journal header
+ * is not updated, so the partly written transaction is ignored, and
+ * the caller discards the database version.
+ */
 static isc_result_t
-ixfr_apply_one(dns_xfrin_t *xfr, ixfr_apply_data_t *data) {
+ixfr_apply_one(dns_xfrin_t *xfr, xfrin_apply_data_t *data) {
 	isc_result_t result = ISC_R_SUCCESS;
 	uint64_t records;
 
-	CHECK(ixfr_begin_transaction(xfr));
+	if (!xfr->ixfr.intransaction) {
+		CHECK(ixfr_begin_transaction(xfr));
+		xfr->ixfr.intransaction = true;
+	}
 
 	CHECK(dns_diff_apply(&data->diff, xfr->db, xfr->ver));
 	if (xfr->maxrecords != 0U) {
@@ -534,13 +728,13 @@ ixfr_apply_one(dns_xfrin_t *xfr, ixfr_apply_data_t *data) {
 		CHECK(dns_journal_writediff(xfr->ixfr.journal, &data->diff));
 	}
 
-	result = ixfr_end_transaction(xfr);
+	if (data->end) {
+		xfr->ixfr.intransaction = false;
+		CHECK(ixfr_end_transaction(xfr));
+	}
 
-	return result;
+	result = ISC_R_SUCCESS;
 failure:
-	/* We need to end the transaction, but keep the previous error */
-	(void)ixfr_end_transaction(xfr);
-
 	return result;
 }
 
@@ -565,8 +759,8 @@ ixfr_apply(void *arg) {
 
 	struct cds_wfcq_node *node, *next;
 	__cds_wfcq_for_each_blocking_safe(&diff_head, &diff_tail, node, next) {
-		ixfr_apply_data_t *data =
-			caa_container_of(node, ixfr_apply_data_t, wfcq_node);
+		xfrin_apply_data_t *data =
+			caa_container_of(node, xfrin_apply_data_t, wfcq_node);
 
 		if (atomic_load(&xfr->shuttingdown)) {
 			result = ISC_R_SHUTTINGDOWN;
@@ -579,8 +773,7 @@ ixfr_apply(void *arg) {
 		}
 
 		/* We need to clear and free all data chunks */
-		dns_diff_clear(&data->diff);
-		isc_mem_put(xfr->mctx, data, sizeof(*data));
+		xfrin_apply_data_free(xfr, data);
 	}
 
 	work->result = result;
@@ -604,9 +797,12 @@ ixfr_apply_done(void *arg) {
 		goto failure;
 	}
 
+	CHECK(xfrin_resume(xfr));
+
 	/* Reschedule */
 	if (!cds_wfcq_empty(&xfr->diff_head, &xfr->diff_tail)) {
-		isc_work_enqueue(xfr->loop, ixfr_apply, ixfr_apply_done, work);
+		isc_work_enqueue_bulk(xfr->loop, ixfr_apply, ixfr_apply_done,
+				      work);
 		return;
 	}
 
@@ -615,9 +811,17 @@ failure:
 
 	isc_mem_put(xfr->mctx, work, sizeof(*work));
 
-	if (result == ISC_R_SUCCESS) {
-		dns_db_closeversion(xfr->db, &xfr->ver, true);
-		dns_zone_markdirty(xfr->zone);
+	if (result == ISC_R_SUCCESS && xfr->retry_axfr) {
+		xfrin_retry(xfr);
+	} else if (result == ISC_R_SUCCESS) {
+		/*
+		 * Wait for the rest of a transaction before making the
+		 * new version visible.
+		 */
+		if (!xfr->ixfr.intransaction) {
+			dns_db_closeversion(xfr->db, &xfr->ver, true);
+			dns_zone_markdirty(xfr->zone);
+		}
 
 		if (atomic_load(&xfr->state) == XFRST_IXFR_END) {
 			xfrin_end(xfr, result);
@@ -632,42 +836,31 @@ failure:
 }
 
 /*
- * Apply a set of IXFR changes to the database.
+ * Queue the pending IXFR changes to be applied to the database;
+ * 'end' is true if they complete a transaction.
  */
 static isc_result_t
-ixfr_commit(dns_xfrin_t *xfr) {
+ixfr_enqueue(dns_xfrin_t *xfr, bool end) {
 	isc_result_t result = ISC_R_SUCCESS;
-	ixfr_apply_data_t *data = isc_mem_get(xfr->mctx, sizeof(*data));
-
-	*data = (ixfr_apply_data_t){ 0 };
-	cds_wfcq_node_init(&data->wfcq_node);
 
 	if (xfr->ver == NULL) {
 		CHECK(dns_db_newversion(xfr->db, &xfr->ver));
 	}
 
-	dns_diff_init(xfr->mctx, &data->diff);
-	/* FIXME: Should we add dns_diff_move() */
-	ISC_LIST_MOVE(data->diff.tuples, xfr->diff.tuples);
-
-	(void)cds_wfcq_enqueue(&xfr->diff_head, &xfr->diff_tail,
-			       &data->wfcq_node);
-
-	if (!xfr->diff_running) {
-		xfrin_work_t *work = isc_mem_get(xfr->mctx, sizeof(*work));
-		*work = (xfrin_work_t){
-			.magic = XFRIN_WORK_MAGIC,
-			.result = ISC_R_UNSET,
-			.xfr = dns_xfrin_ref(xfr),
-		};
-		xfr->diff_running = true;
-		isc_work_enqueue(xfr->loop, ixfr_apply, ixfr_apply_done, work);
-	}
+	xfrin_enqueue(xfr, end, ixfr_apply, ixfr_apply_done);
 
 failure:
 	return result;
 }
 
+/*
+ * Apply a set of IXFR changes to the database.
+ */
+static isc_result_t
+ixfr_commit(dns_xfrin_t *xfr) {
+	return ixfr_enqueue(xfr, true);
+}
+
 /**************************************************************************/
 /*
  * Common AXFR/IXFR protocol code
@@ -1024,13 +1217,27 @@ dns_xfrin_getendserial(dns_xfrin_t *xfr) {
 
 void
 dns_xfrin_getstats(dns_xfrin_t *xfr, unsigned int *nmsgp, unsigned int *nrecsp,
-		   uint64_t *nbytesp) {
+		   uint64_t *nbytesp, unsigned int *nappliedp,
+		   unsigned int *nrecspersecp) {
 	REQUIRE(VALID_XFRIN(xfr));
 	REQUIRE(nmsgp != NULL && nrecsp != NULL && nbytesp != NULL);
 
 	SET_IF_NOT_NULL(nmsgp, atomic_load_relaxed(&xfr->nmsg));
 	SET_IF_NOT_NULL(nrecsp, atomic_load_relaxed(&xfr->nrecs));
 	SET_IF_NOT_NULL(nbytesp, atomic_load_relaxed(&xfr->nbytes));
+	SET_IF_NOT_NULL(nappliedp, atomic_load_relaxed(&xfr->napplied));
+
+	if (nrecspersecp != NULL) {
+		isc_time_t start = atomic_load_relaxed(&xfr->start);
+		isc_time_t now = isc_time_now();
+		uint64_t msecs = isc_time_microdiff(&now, &start) / 1000;
+
+		if (msecs == 0) {
+			msecs = 1;
+		}
+		*nrecspersecp = (unsigned int)(
+			(atomic_load_relaxed(&xfr->nrecs) * 1000ULL) / msecs);
+	}
 }
 
 const isc_sockaddr_t *
@@ -1126,6 +1333,7 @@ xfrin_reset(dns_xfrin_t *xfr) {
 
 	dns_diff_clear(&xfr->diff);
 	xfr->ixfr.diffs = 0;
+	xfr->ixfr.intransaction = false;
 
 	if (xfr->ixfr.journal != NULL) {
 		dns_journal_destroy(&xfr->ixfr.journal);
@@ -1810,6 +2018,16 @@ xfrin_recv_done(isc_result_t result, isc_region_t *region, void *arg) {
 	try_axfr:
 		LIBDNS_XFRIN_RECV_TRY_AXFR(xfr, xfr->info, result);
 		dns_message_detach(&msg);
+		if (xfr->diff_running) {
+			/*
+			 * The transfer can't be reset while the work
+			 * thread is applying the changes received so far;
+			 * stop reading and retry once it is done.
+			 */
+			xfr->retry_axfr = true;
+			dns_xfrin_detach(&xfr);
+			return;
+		}
 		xfrin_reset(xfr);
 		xfr->reqtype = dns_rdatatype_soa;
 		atomic_store(&xfr->state, XFRST_SOAQUERY);
@@ -2010,19 +2228,27 @@ xfrin_recv_done(isc_result_t result, isc_region_t *region, void *arg) {
 		xfrin_cancelio(xfr);
 		break;
 	default:
+		dns_message_detach(&msg);
+
 		/*
-		 * Read the next message.
+		 * If the database is too far behind, stop reading until
+		 * the work thread has drained the queue; it holds a
+		 * reference to the transfer meanwhile.
 		 */
-		dns_message_detach(&msg);
-		result = dns_dispatch_getnext(xfr->dispentry);
-		if (result != ISC_R_SUCCESS) {
-			goto failure;
+		if (xfr->diff_running &&
+		    atomic_load_relaxed(&xfr->diff_queued) > XFRIN_MAXQUEUED)
+		{
+			xfrin_log(xfr, ISC_LOG_DEBUG(10),
+				  "pausing until the queued records are "
+				  "stored");
+			xfr->recv_paused = true;
+			break;
 		}
 
-		isc_interval_t interval;
-		isc_interval_set(&interval, dns_zone_getidlein(xfr->zone), 0);
-		isc_timer_start(xfr->max_idle_timer, isc_timertype_once,
-				&interval);
+		/*
+		 * Read the next message.
+		 */
+		CHECK(xfrin_readnext(xfr));
 
 		LIBDNS_XFRIN_READ(xfr, xfr->info, result);
 		return;
@@ -2040,6 +2266,25 @@ failure:
 	LIBDNS_XFRIN_RECV_DONE(xfr, xfr->info, result);
 }
 
+/*
+ * Read the next message, and restart the idle timer.
+ */
+static isc_result_t
+xfrin_readnext(dns_xfrin_t *xfr) {
+	isc_result_t result;
+	isc_interval_t interval;
+
+	result = dns_dispatch_getnext(xfr->dispentry);
+	if (result != ISC_R_SUCCESS) {
+		return result;
+	}
+
+	isc_interval_set(&interval, dns_zone_getidlein(xfr->zone), 0);
+	isc_timer_start(xfr->max_idle_timer, isc_timertype_once, &interval);
+
+	return ISC_R_SUCCESS;
+}
+
 static void
 xfrin_destroy(dns_xfrin_t *xfr) {
 	uint64_t msecs, persec;
@@ -2089,15 +2334,14 @@ xfrin_destroy(dns_xfrin_t *xfr) {
 		  (unsigned int)persec, atomic_load_relaxed(&xfr->end_serial),
 		  sep, expireopt);
 
-	/* Cleanup unprocessed IXFR data */
+	/* Cleanup unprocessed IXFR and AXFR data */
 	struct cds_wfcq_node *node, *next;
 	__cds_wfcq_for_each_blocking_safe(&xfr->diff_head, &xfr->diff_tail,
 					  node, next) {
-		ixfr_apply_data_t *data =
-			caa_container_of(node, ixfr_apply_data_t, wfcq_node);
+		xfrin_apply_data_t *data =
+			caa_container_of(node, xfrin_apply_data_t, wfcq_node);
 		/* We need to clear and free all data chunks */
-		dns_diff_clear(&data->diff);
-		isc_mem_put(xfr->mctx, data, sizeof(*data));
+		xfrin_apply_data_free(xfr, data);
 	}
 
 	/* Cleanup unprocessed AXFR data */
@@ -15,6 +15,7 @@
 
 #include <errno.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <stdbool.h>
 
 #include <isc/async.h>
@@ -28,6 +29,7 @@
 #include <isc/md.h>
 #include <isc/mutex.h>
 #include <isc/overflow.h>
+#include <isc/quota.h>
 #include <isc/random.h>
 #include <isc/ratelimiter.h>
 #include <isc/refcount.h>
@@ -43,6 +45,7 @@
 #include <isc/timer.h>
 #include <isc/tls.h>
 #include <isc/util.h>
+#include <isc/work.h>
 
 #include <dns/acl.h>
 #include <dns/adb.h>
@@ -159,6 +162,25 @@
 #define MAX_XFER_TIME	    (2 * 3600) /*%< Documented default is 2 hours */
 #define RESIGN_DELAY	    3600       /*%< 1 hour */
 
+/*%
+ * The number of NOTIFY messages or SOA queries queued for the same
+ * server that are sent together, counting as one against the
+ * notify-rate and serial-query-rate limits.  This lets a bulk change
+ * to many zones converge in bursts rather than one message per server
+ * at a time.
+ */
+#define PEER_BURST 32
+
+/*%
+ * While a refresh queries one primary, SOA queries are sent to all the
+ * others at once.  As soon as SOAPROBE_QUORUM of them have answered
+ * and one of the answers has a newer serial, the refresh stops waiting
+ * for the current primary and transfers the zone from the fastest
+ * primary with the highest serial.
+ */
+#define SOAPROBE_QUORUM 2
+#define SOAPROBE_NONE	UINT_MAX
+
 #ifndef DNS_MAX_EXPIRE
 #define DNS_MAX_EXPIRE 14515200 /*%< 24 weeks */
 #endif				/* ifndef DNS_MAX_EXPIRE */
@@ -167,11 +189,18 @@
 #define DNS_DUMP_DELAY 900 /*%< 15 minutes */
 #endif			   /* ifndef DNS_DUMP_DELAY */
 
+/*%
+ * How long a pass of incremental re-signing may keep going past
+ * sig-signing-signatures RRsets when the re-signing has fallen behind.
+ */
+#define RESIGN_CATCHUP_TIME (200 * NS_PER_MS)
+
 typedef struct dns_notify dns_notify_t;
 typedef struct dns_checkds dns_checkds_t;
 typedef struct dns_stub dns_stub_t;
 typedef struct dns_load dns_load_t;
 typedef struct dns_forward dns_forward_t;
+typedef struct dns_soaprobe dns_soaprobe_t;
 typedef ISC_LIST(dns_forward_t) dns_forwardlist_t;
 typedef struct dns_keymgmt dns_keymgmt_t;
 typedef struct dns_signing dns_signing_t;
@@ -181,6 +210,10 @@ typedef ISC_LIST(dns_nsec3chain_t) dns_nsec3chainlist_t;
 typedef struct dns_nsfetch dns_nsfetch_t;
 typedef struct dns_keyfetch dns_keyfetch_t;
 typedef struct dns_asyncload dns_asyncload_t;
+typedef struct dns_jnlcompact dns_jnlcompact_t;
+typedef struct dns_demandwaiter dns_demandwaiter_t;
+typedef struct dns_syncwaiter dns_syncwaiter_t;
+typedef struct dns_syncfile dns_syncfile_t;
 typedef struct dns_include dns_include_t;
 
 #define DNS_ZONE_CHECKLOCK
@@ -274,8 +307,34 @@ struct dns_zone {
 	dns_zonemgr_t *zmgr;
 	ISC_LINK(dns_zone_t) link; /* Used by zmgr. */
 	isc_loop_t *loop;
-	isc_timer_t *timer;
 	isc_refcount_t irefs;
+
+	/*
+	 * The zone timer, in the zone manager's timer wheel of the
+	 * zone's loop.  Only used on that loop.
+	 */
+	bool timerref; /* An internal reference is held for the timer */
+	uint64_t timertick;
+	unsigned int timerslot;
+	ISC_LINK(dns_zone_t) timerlink;
+
+	/*
+	 * Set while a scheduled load is counted in the zone manager's
+	 * load progress, together with the size of the file it loads.
+	 */
+	bool loadcounted;
+	uint64_t loadsize;
+
+	/*
+	 * Load on demand: the queries waiting for the load, the time of
+	 * the last query, and how long the zone may go without queries
+	 * before it is unloaded at 'unloadtime'.
+	 */
+	ISC_LIST(dns_demandwaiter_t) demandwaiters;
+	atomic_uint_fast32_t lastquery;
+	uint32_t demandidle;
+	isc_time_t unloadtime;
+
 	dns_name_t origin;
 	dns_name_t rad;
 	char *masterfile;
@@ -287,6 +346,7 @@ struct dns_zone {
 	const dns_master_style_t *masterstyle;
 	char *journal;
 	int32_t journalsize;
+	dns_journalindex_t *journalindex;
 	dns_rdataclass_t rdclass;
 	dns_zonetype_t type;
 	atomic_uint_fast64_t flags;
@@ -326,6 +386,10 @@ struct dns_zone {
 	uint32_t maxrrperset;
 	uint32_t maxtypepername;
 
+	isc_quota_t updquota; /*%< UPDATE messages being processed */
+	uint32_t updatebatchwindow; /*%< in milliseconds */
+	void *updatebatch;	    /*%< UPDATE messages being batched */
+
 	dns_remote_t primaries;
 
 	dns_remote_t parentals;
@@ -359,6 +423,12 @@ struct dns_zone {
 	ISC_LIST(dns_notify_t) notifies;
 	ISC_LIST(dns_checkds_t) checkds_requests;
 	dns_request_t *request;
+	ISC_LIST(dns_soaprobe_t) soaprobes;
+	bool soaprobed;
+	bool soaprobetakeover;
+	unsigned int soaprobeanswers;
+	unsigned int soaprobebest;
+	uint32_t soaprobeserial;
 	dns_loadctx_t *loadctx;
 	dns_dumpctx_t *dumpctx;
 	uint32_t maxxfrin;
@@ -413,6 +483,16 @@ struct dns_zone {
 	 * Serial number for deferred journal compaction.
 	 */
 	uint32_t compact_serial;
+	/*%
+	 * The serial and the journal size at the last dump.  'dumpbase'
+	 * is true while the zone file and the journal together hold the
+	 * zone, so that dumping can be put off until the changes journaled
+	 * since then reach 'dumpratio' percent of the zone file.
+	 */
+	uint32_t dumpratio;
+	uint32_t dumpserial;
+	off_t dumpjournal;
+	bool dumpbase;
 	/*%
 	 * Keys that are signing the zone for the first time.
 	 */
@@ -439,6 +519,11 @@ struct dns_zone {
 	 */
 	bool added;
 
+	/*%
+	 * Fingerprint of the configuration the zone was configured from
+	 */
+	uint64_t confighash;
+
 	/*%
 	 * True if added by automatically by named.
 	 */
@@ -567,6 +652,10 @@ typedef enum {
 						      * just being loaded for
 						      * the first time. */
 	DNS_ZONEFLG_FIRSTREFRESH = 0x100000000U, /*%< First refresh pending */
+	DNS_ZONEFLG_DEMANDED = 0x200000000U,	 /*%< Load on demand was
+						  * requested */
+	DNS_ZONEFLG_COMPACTING = 0x400000000U,	 /*%< journal compaction
+						  * running */
 	DNS_ZONEFLG___MAX = UINT64_MAX, /* trick to make the ENUM 64-bit wide */
 } dns_zoneflg_t;
 
@@ -604,6 +693,40 @@ struct dns_unreachable {
 	uint32_t count;
 };
 
+/*%
+ * Hierarchical timer wheel running the zone timers of one loop.
+ *
+ * The wheel advances in one second ticks of the monotonic clock, so
+ * like the loop timers it is not affected by changes of the wall
+ * clock time.  Level 'n' has
+ * ZONEWHEEL_SLOTS slots, each covering ZONEWHEEL_SLOTS^n ticks; a zone
+ * is placed at the lowest level that can hold its due time and moves
+ * down ("cascades") when the wheel reaches the start of its slot.
+ * Zones due further ahead than the wheel can hold are parked in the
+ * last slot of the top level and placed again when it cascades.
+ * A single timer per loop fires at the next tick that has zones to run
+ * or has to cascade, so the cost depends on the number of due zones
+ * and not on the number of zones.
+ */
+#define ZONEWHEEL_BITS	 6
+#define ZONEWHEEL_SLOTS	 (1 << ZONEWHEEL_BITS)
+#define ZONEWHEEL_MASK	 (ZONEWHEEL_SLOTS - 1)
+#define ZONEWHEEL_LEVELS 4
+#define ZONEWHEEL_SPAN	 (UINT64_C(1) << (ZONEWHEEL_BITS * ZONEWHEEL_LEVELS))
+#define ZONEWHEEL_DUE	 (ZONEWHEEL_LEVELS * ZONEWHEEL_SLOTS)
+
+#define ZONEWHEEL_LEVELMASK(level) \
+	((UINT64_C(1) << (ZONEWHEEL_BITS * (level))) - 1)
+
+typedef struct zonewheel {
+	isc_timer_t *timer;
+	uint64_t tick;	 /* Last tick processed */
+	uint64_t wakeup; /* Tick the timer is set to fire at */
+	atomic_uint_fast32_t count;
+	dns_zonelist_t due;
+	dns_zonelist_t slots[ZONEWHEEL_LEVELS][ZONEWHEEL_SLOTS];
+} zonewheel_t;
+
 struct dns_zonemgr {
 	unsigned int magic;
 	isc_mem_t *mctx;
@@ -612,6 +735,7 @@ struct dns_zonemgr {
 	isc_nm_t *netmgr;
 	uint32_t workers;
 	isc_mem_t **mctxpool;
+	zonewheel_t *wheels;
 	isc_ratelimiter_t *checkdsrl;
 	isc_ratelimiter_t *notifyrl;
 	isc_ratelimiter_t *refreshrl;
@@ -634,6 +758,20 @@ struct dns_zonemgr {
 	unsigned int serialqueryrate;
 	unsigned int startupserialqueryrate;
 
+	/* Load progress, locked by loadlock. */
+	isc_mutex_t loadlock;
+	unsigned int loadspending;
+	uint64_t loadbytes;
+	uint64_t loadedbytes;
+	isc_nanosecs_t loadstart;
+	isc_nanosecs_t loadend;
+
+	/* Journal group commit, locked by synclock. */
+	isc_mutex_t synclock;
+	bool syncrunning;
+	ISC_LIST(dns_syncfile_t) syncpending;
+	ISC_LIST(dns_syncfile_t) syncbatch; /* owned by the running sync */
+
 	/* Locked by urlock. */
 	/* LRU cache */
 	struct dns_unreachable unreachable[UNREACH_CACHE_SIZE];
@@ -731,6 +869,17 @@ struct dns_forward {
 	ISC_LINK(dns_forward_t) link;
 };
 
+/*%
+ *	Hold state for an SOA query sent to one of the other primaries
+ *	during a refresh.
+ */
+struct dns_soaprobe {
+	dns_zone_t *zone;
+	dns_request_t *request;
+	unsigned int index;
+	ISC_LINK(dns_soaprobe_t) link;
+};
+
 /*%
  *	Hold state for when we are signing a zone with a new
  *	DNSKEY as result of an update.
@@ -756,6 +905,10 @@ struct dns_nsec3chain {
 	bool seen_nsec;
 	bool delete_nsec;
 	bool save_delete_nsec;
+	/* Progress of the chain creation, for 'rndc signing -list' */
+	uint64_t nodes;
+	uint64_t total;
+	isc_stdtime_t started;
 	ISC_LINK(dns_nsec3chain_t) link;
 };
 
@@ -812,6 +965,49 @@ struct dns_asyncload {
 	void *loaded_arg;
 };
 
+/*%
+ * Hold state for a journal compaction running in the background
+ */
+struct dns_jnlcompact {
+	dns_zone_t *zone;
+	char *journal;
+	uint32_t serial;
+	uint32_t journalsize;
+	isc_result_t result;
+	isc_nanosecs_t start;
+};
+
+/*%
+ * A caller waiting for a zone to be loaded on demand
+ */
+struct dns_demandwaiter {
+	isc_loop_t *loop;
+	isc_job_cb cb;
+	void *arg;
+	ISC_LINK(dns_demandwaiter_t) link;
+};
+
+/*%
+ * A caller waiting for its journal writes to be synced to disk
+ */
+struct dns_syncwaiter {
+	isc_loop_t *loop;
+	isc_job_cb cb;
+	void *arg;
+	isc_result_t *resultp;
+	ISC_LINK(dns_syncwaiter_t) link;
+};
+
+/*%
+ * A journal file to be synced in a group commit, with its waiters
+ */
+struct dns_syncfile {
+	char *filename;
+	isc_result_t result;
+	ISC_LIST(dns_syncwaiter_t) waiters;
+	ISC_LINK(dns_syncfile_t) link;
+};
+
 /*%
  * Reference to an include file encountered during loading
  */
@@ -837,6 +1033,8 @@ unsigned int dns_zone_mkey_month = MONTH;
 
 static void
 zone_timer_set(dns_zone_t *zone, isc_time_t *next, isc_time_t *now);
+static void
+zone_timer_release(dns_zone_t *zone);
 
 typedef struct zone_settimer {
 	dns_zone_t *zone;
@@ -917,6 +1115,10 @@ stub_callback(void *arg);
 static void
 queue_soa_query(dns_zone_t *zone);
 static void
+send_soaprobes(dns_zone_t *zone);
+static void
+cancel_soaprobes(dns_zone_t *zone);
+static void
 soa_query(void *arg);
 static void
 ns_query(dns_zone_t *zone, dns_rdataset_t *soardataset, dns_stub_t *stub);
@@ -982,6 +1184,8 @@ static void
 zone_notify(dns_zone_t *zone, isc_time_t *now);
 static void
 dump_done(void *arg, isc_result_t result);
+static bool
+zone_dumpdefer(dns_zone_t *zone);
 static isc_result_t
 zone_signwithkey(dns_zone_t *zone, dns_secalg_t algorithm, uint16_t keyid,
 		 bool deleteit);
@@ -1152,12 +1356,17 @@ dns_zone_create(dns_zone_t **zonep, isc_mem_t *mctx, unsigned int tid) {
 		.newincludes = ISC_LIST_INITIALIZER,
 		.notifies = ISC_LIST_INITIALIZER,
 		.checkds_requests = ISC_LIST_INITIALIZER,
+		.soaprobes = ISC_LIST_INITIALIZER,
+		.soaprobebest = SOAPROBE_NONE,
 		.signing = ISC_LIST_INITIALIZER,
 		.nsec3chain = ISC_LIST_INITIALIZER,
 		.setnsec3param_queue = ISC_LIST_INITIALIZER,
 		.forwards = ISC_LIST_INITIALIZER,
+		.demandwaiters = ISC_LIST_INITIALIZER,
+		.demandidle = DNS_ZONE_DEFAULTDEMANDIDLE,
 		.link = ISC_LINK_INITIALIZER,
 		.statelink = ISC_LINK_INITIALIZER,
+		.timerlink = ISC_LINK_INITIALIZER,
 	};
 	dns_remote_t r = {
 		.magic = DNS_REMOTE_MAGIC,
@@ -1169,6 +1378,8 @@ dns_zone_create(dns_zone_t **zonep, isc_mem_t *mctx, unsigned int tid) {
 
 	isc_refcount_init(&zone->references, 1);
 	isc_refcount_init(&zone->irefs, 0);
+	isc_quota_init(&zone->updquota, 0);
+	dns_journalindex_create(mctx, &zone->journalindex);
 	dns_name_init(&zone->origin, NULL);
 	dns_name_init(&zone->rad, NULL);
 	isc_sockaddr_any(&zone->notifysrc4);
@@ -1217,8 +1428,9 @@ zone_free(dns_zone_t *zone) {
 
 	REQUIRE(DNS_ZONE_VALID(zone));
 	REQUIRE(!LOCKED_ZONE(zone));
-	REQUIRE(zone->timer == NULL);
+	REQUIRE(!zone->timerref);
 	REQUIRE(zone->zmgr == NULL);
+	REQUIRE(ISC_LIST_EMPTY(zone->demandwaiters));
 
 	isc_refcount_destroy(&zone->references);
 	isc_refcount_destroy(&zone->irefs);
@@ -1301,6 +1513,7 @@ zone_free(dns_zone_t *zone) {
 		isc_mem_free(zone->mctx, zone->journal);
 	}
 	zone->journal = NULL;
+	dns_journalindex_detach(&zone->journalindex);
 	if (zone->stats != NULL) {
 		isc_stats_detach(&zone->stats);
 	}
@@ -1374,6 +1587,8 @@ zone_free(dns_zone_t *zone) {
 		isc_stats_detach(&zone->gluecachestats);
 	}
 
+	isc_quota_destroy(&zone->updquota);
+
 	/* last stuff */
 	ZONEDB_DESTROYLOCK(&zone->dblock);
 	isc_mutex_destroy(&zone->lock);
@@ -1840,6 +2055,7 @@ dns_zone_setjournal(dns_zone_t *zone, const char *myjournal) {
 
 	LOCK_ZONE(zone);
 	result = dns_zone_setstring(zone, &zone->journal, myjournal);
+	dns_journalindex_reset(zone->journalindex);
 	UNLOCK_ZONE(zone);
 
 	return result;
@@ -1852,6 +2068,159 @@ dns_zone_getjournal(dns_zone_t *zone) {
 	return zone->journal;
 }
 
+dns_journalindex_t *
+dns_zone_getjournalindex(dns_zone_t *zone) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	return zone->journalindex;
+}
+
+static void
+zonemgr_syncstart(dns_zonemgr_t *zmgr, isc_loop_t *loop);
+
+/*
+ * Sync every journal file of the current batch.  Runs on an offload
+ * thread; each file is synced once however many transactions wait on it.
+ */
+static void
+zonemgr_sync(void *arg) {
+	dns_zonemgr_t *zmgr = arg;
+	dns_syncfile_t *file = NULL;
+
+	ISC_LIST_FOREACH (zmgr->syncbatch, file, link) {
+		file->result = dns_journal_sync(file->filename);
+	}
+}
+
+static void
+zonemgr_syncdone(void *arg) {
+	dns_zonemgr_t *zmgr = arg;
+	dns_syncfile_t *file = NULL;
+	dns_syncwaiter_t *waiter = NULL;
+	unsigned int nfiles = 0, nwaiters = 0;
+	bool done;
+
+	while ((file = ISC_LIST_HEAD(zmgr->syncbatch)) != NULL) {
+		ISC_LIST_UNLINK(zmgr->syncbatch, file, link);
+		while ((waiter = ISC_LIST_HEAD(file->waiters)) != NULL) {
+			ISC_LIST_UNLINK(file->waiters, waiter, link);
+			if (file->result != ISC_R_SUCCESS) {
+				*waiter->resultp = file->result;
+			}
+			isc_async_run(waiter->loop, waiter->cb, waiter->arg);
+			isc_loop_detach(&waiter->loop);
+			isc_mem_put(zmgr->mctx, waiter, sizeof(*waiter));
+			nwaiters++;
+		}
+		isc_mem_free(zmgr->mctx, file->filename);
+		isc_mem_put(zmgr->mctx, file, sizeof(*file));
+		nfiles++;
+	}
+
+	isc_log_write(DNS_LOGCATEGORY_GENERAL, DNS_LOGMODULE_ZONE,
+		      ISC_LOG_DEBUG(3),
+		      "journal group commit: %u transaction(s) in %u file(s)",
+		      nwaiters, nfiles);
+
+	/*
+	 * Whatever was committed while this batch was being synced forms
+	 * the next batch.
+	 */
+	LOCK(&zmgr->synclock);
+	done = ISC_LIST_EMPTY(zmgr->syncpending);
+	if (done) {
+		zmgr->syncrunning = false;
+	} else {
+		zonemgr_syncstart(zmgr, isc_loop());
+	}
+	UNLOCK(&zmgr->synclock);
+
+	if (done) {
+		dns_zonemgr_detach(&zmgr);
+	}
+}
+
+/*
+ * Start syncing the pending journal files.  'synclock' must be held.
+ */
+static void
+zonemgr_syncstart(dns_zonemgr_t *zmgr, isc_loop_t *loop) {
+	INSIST(ISC_LIST_EMPTY(zmgr->syncbatch));
+
+	ISC_LIST_MOVE(zmgr->syncbatch, zmgr->syncpending);
+	isc_work_enqueue(loop, zonemgr_sync, zonemgr_syncdone, zmgr);
+}
+
+void
+dns_zone_journalsync(dns_zone_t *zone, isc_loop_t *loop, isc_job_cb cb,
+		     void *arg, isc_result_t *resultp) {
+	dns_zonemgr_t *zmgr = NULL;
+	dns_syncfile_t *file = NULL, *f = NULL;
+	dns_syncwaiter_t *waiter = NULL;
+
+	REQUIRE(DNS_ZONE_VALID(zone));
+	REQUIRE(loop != NULL);
+	REQUIRE(cb != NULL);
+	REQUIRE(resultp != NULL);
+
+	LOCK_ZONE(zone);
+	zmgr = zone->zmgr;
+	if (zmgr == NULL || zone->journal == NULL) {
+		/* Nothing to batch with; sync right away. */
+		if (zone->journal != NULL) {
+			isc_result_t result = dns_journal_sync(zone->journal);
+			if (result != ISC_R_SUCCESS) {
+				*resultp = result;
+			}
+		}
+		UNLOCK_ZONE(zone);
+		isc_async_run(loop, cb, arg);
+		return;
+	}
+
+	waiter = isc_mem_get(zmgr->mctx, sizeof(*waiter));
+	*waiter = (dns_syncwaiter_t){
+		.cb = cb,
+		.arg = arg,
+		.resultp = resultp,
+		.link = ISC_LINK_INITIALIZER,
+	};
+	isc_loop_attach(loop, &waiter->loop);
+
+	LOCK(&zmgr->synclock);
+	ISC_LIST_FOREACH (zmgr->syncpending, f, link) {
+		if (strcmp(f->filename, zone->journal) == 0) {
+			file = f;
+			break;
+		}
+	}
+	if (file == NULL) {
+		file = isc_mem_get(zmgr->mctx, sizeof(*file));
+		*file = (dns_syncfile_t){
+			.filename = isc_mem_strdup(zmgr->mctx, zone->journal),
+			.result = ISC_R_SUCCESS,
+			.waiters = ISC_LIST_INITIALIZER,
+			.link = ISC_LINK_INITIALIZER,
+		};
+		ISC_LIST_APPEND(zmgr->syncpending, file, link);
+	}
+	ISC_LIST_APPEND(file->waiters, waiter, link);
+
+	/*
+	 * If no sync is running, start one now.  Otherwise this
+	 * transaction joins the batch that starts when it completes.
+	 */
+	if (!zmgr->syncrunning) {
+		dns_zonemgr_t *ref = NULL;
+
+		zmgr->syncrunning = true;
+		dns_zonemgr_attach(zmgr, &ref);
+		zonemgr_syncstart(zmgr, isc_loop());
+	}
+	UNLOCK(&zmgr->synclock);
+	UNLOCK_ZONE(zone);
+}
+
 /*
  * Return true iff the zone is "dynamic", in the sense that the zone's
  * master file (if any) is written by the server, rather than being
@@ -1928,6 +2297,7 @@ dns_zone_rpz_enable_db(dns_zone_t *zone, dns_db_t *db) {
 		return;
 	}
 	REQUIRE(zone->rpzs != NULL);
+	dns_rpz_setjournal(zone->rpzs->zones[zone->rpz_num], zone->journal);
 	dns_rpz_dbupdate_register(db, zone->rpzs->zones[zone->rpz_num]);
 }
 
@@ -2160,6 +2530,31 @@ zone_load(dns_zone_t *zone, unsigned int flags, bool locked) {
 		goto cleanup;
 	}
 
+	/*
+	 * A zone that is loaded on demand only has its file checked
+	 * until the first query for it asks for the load.
+	 */
+	if (zone->db == NULL && zone->masterfile != NULL &&
+	    DNS_ZONE_OPTION(zone, DNS_ZONEOPT_LOADONDEMAND) &&
+	    !DNS_ZONE_FLAG(zone, DNS_ZONEFLG_DEMANDED))
+	{
+		isc_time_t filetime;
+
+		result = isc_file_getmodtime(zone->masterfile, &filetime);
+		if (result == ISC_R_SUCCESS) {
+			dns_zone_logc(zone, DNS_LOGCATEGORY_ZONELOAD,
+				      ISC_LOG_DEBUG(1),
+				      "load deferred until first query");
+		} else {
+			dns_zone_logc(zone, DNS_LOGCATEGORY_ZONELOAD,
+				      ISC_LOG_ERROR,
+				      "loading from master file %s failed: %s",
+				      zone->masterfile,
+				      isc_result_totext(result));
+		}
+		goto cleanup;
+	}
+
 	/*
 	 * Store the current time before the zone is loaded, so that if the
 	 * file changes between the time of the load and the time that
@@ -2371,6 +2766,75 @@ dns_zone_load(dns_zone_t *zone, bool newonly) {
 	return zone_load(zone, newonly ? DNS_ZONELOADFLAG_NOSTAT : 0, false);
 }
 
+/*
+ * Count a scheduled load of 'zone' in the zone manager's load progress.
+ * Scheduling a load while none are pending starts a new round.
+ * The zone must be locked.
+ */
+static void
+zone_loadstarted(dns_zone_t *zone, uint64_t size) {
+	dns_zonemgr_t *zmgr = zone->zmgr;
+
+	if (zone->loadcounted) {
+		return;
+	}
+
+	zone->loadcounted = true;
+	zone->loadsize = size;
+
+	LOCK(&zmgr->loadlock);
+	if (zmgr->loadspending++ == 0) {
+		zmgr->loadbytes = 0;
+		zmgr->loadedbytes = 0;
+		zmgr->loadstart = isc_time_monotonic();
+		zmgr->loadend = 0;
+	}
+	zmgr->loadbytes += size;
+	UNLOCK(&zmgr->loadlock);
+}
+
+/*
+ * Run the callbacks of everything waiting for 'zone' to be loaded on
+ * demand.  The zone must be locked.
+ */
+static void
+zone_demandwake(dns_zone_t *zone) {
+	dns_demandwaiter_t *waiter = NULL, *next = NULL;
+
+	for (waiter = ISC_LIST_HEAD(zone->demandwaiters); waiter != NULL;
+	     waiter = next)
+	{
+		next = ISC_LIST_NEXT(waiter, link);
+		ISC_LIST_UNLINK(zone->demandwaiters, waiter, link);
+		isc_async_run(waiter->loop, waiter->cb, waiter->arg);
+		isc_loop_detach(&waiter->loop);
+		isc_mem_put(zone->mctx, waiter, sizeof(*waiter));
+	}
+}
+
+/*
+ * Complete the counted load of 'zone', ending the round if it was the
+ * last one pending.  The zone must be locked.
+ */
+static void
+zone_loadfinished(dns_zone_t *zone) {
+	dns_zonemgr_t *zmgr = zone->zmgr;
+
+	if (!zone->loadcounted) {
+		return;
+	}
+
+	zone->loadcounted = false;
+
+	LOCK(&zmgr->loadlock);
+	INSIST(zmgr->loadspending > 0);
+	zmgr->loadedbytes += zone->loadsize;
+	if (--zmgr->loadspending == 0) {
+		zmgr->loadend = isc_time_monotonic();
+	}
+	UNLOCK(&zmgr->loadlock);
+}
+
 static void
 zone_asyncload(void *arg) {
 	dns_asyncload_t *asl = arg;
@@ -2383,6 +2847,8 @@ zone_asyncload(void *arg) {
 	result = zone_load(zone, asl->flags, true);
 	if (result != DNS_R_CONTINUE) {
 		DNS_ZONE_CLRFLAG(zone, DNS_ZONEFLG_LOADPENDING);
+		zone_loadfinished(zone);
+		zone_demandwake(zone);
 	}
 	UNLOCK_ZONE(zone);
 
@@ -2395,10 +2861,35 @@ zone_asyncload(void *arg) {
 	dns_zone_idetach(&zone);
 }
 
+/*
+ * Schedule an asynchronous load of 'zone'.  The zone must be locked
+ * and must not have a load pending.
+ */
+static void
+zone_startasyncload(dns_zone_t *zone, unsigned int flags,
+		    dns_zt_callback_t *done, void *arg, uint64_t size) {
+	dns_asyncload_t *asl = NULL;
+
+	REQUIRE(LOCKED_ZONE(zone));
+	REQUIRE(!DNS_ZONE_FLAG(zone, DNS_ZONEFLG_LOADPENDING));
+
+	asl = isc_mem_get(zone->mctx, sizeof(*asl));
+
+	asl->zone = NULL;
+	asl->flags = flags;
+	asl->loaded = done;
+	asl->loaded_arg = arg;
+
+	zone_iattach(zone, &asl->zone);
+	DNS_ZONE_SETFLAG(zone, DNS_ZONEFLG_LOADPENDING);
+	zone_loadstarted(zone, size);
+	isc_async_run(zone->loop, zone_asyncload, asl);
+}
+
 isc_result_t
 dns_zone_asyncload(dns_zone_t *zone, bool newonly, dns_zt_callback_t *done,
 		   void *arg) {
-	dns_asyncload_t *asl = NULL;
+	uint64_t size;
 
 	REQUIRE(DNS_ZONE_VALID(zone));
 
@@ -2406,6 +2897,8 @@ dns_zone_asyncload(dns_zone_t *zone, bool newonly, dns_zt_callback_t *done,
 		return ISC_R_FAILURE;
 	}
 
+	size = dns__zone_loadsize(zone);
+
 	/* If we already have a load pending, stop now */
 	LOCK_ZONE(zone);
 	if (DNS_ZONE_FLAG(zone, DNS_ZONEFLG_LOADPENDING)) {
@@ -2413,19 +2906,96 @@ dns_zone_asyncload(dns_zone_t *zone, bool newonly, dns_zt_callback_t *done,
 		return ISC_R_ALREADYRUNNING;
 	}
 
-	asl = isc_mem_get(zone->mctx, sizeof(*asl));
+	zone_startasyncload(zone, newonly ? DNS_ZONELOADFLAG_NOSTAT : 0, done,
+			    arg, size);
+	UNLOCK_ZONE(zone);
 
-	asl->zone = NULL;
-	asl->flags = newonly ? DNS_ZONELOADFLAG_NOSTAT : 0;
-	asl->loaded = done;
-	asl->loaded_arg = arg;
+	return ISC_R_SUCCESS;
+}
 
-	zone_iattach(zone, &asl->zone);
-	DNS_ZONE_SETFLAG(zone, DNS_ZONEFLG_LOADPENDING);
-	isc_async_run(zone->loop, zone_asyncload, asl);
+isc_result_t
+dns_zone_demandload(dns_zone_t *zone, isc_loop_t *loop, isc_job_cb cb,
+		    void *arg) {
+	isc_result_t result = ISC_R_SUCCESS;
+	dns_demandwaiter_t *waiter = NULL;
+	uint64_t size = 0;
+	bool start = false;
+
+	REQUIRE(DNS_ZONE_VALID(zone));
+	REQUIRE(loop != NULL);
+	REQUIRE(cb != NULL);
+
+	if (!DNS_ZONE_FLAG(zone, DNS_ZONEFLG_DEMANDED)) {
+		size = dns__zone_loadsize(zone);
+	}
+
+	LOCK_ZONE(zone);
+	if (!DNS_ZONE_OPTION(zone, DNS_ZONEOPT_LOADONDEMAND) ||
+	    zone->zmgr == NULL)
+	{
+		result = ISC_R_NOTIMPLEMENTED;
+		goto unlock;
+	}
+	if (DNS_ZONE_FLAG(zone, DNS_ZONEFLG_LOADED)) {
+		result = DNS_R_UPTODATE;
+		goto unlock;
+	}
+	if (DNS_ZONE_FLAG(zone, DNS_ZONEFLG_DEMANDED) &&
+	    !DNS_ZONE_FLAG(zone, DNS_ZONEFLG_LOADPENDING))
+	{
+		/*
+		 * The load has already been asked for and it failed; it is
+		 * not retried until the zone is reloaded.
+		 */
+		result = ISC_R_FAILURE;
+		goto unlock;
+	}
+
+	if (!DNS_ZONE_FLAG(zone, DNS_ZONEFLG_DEMANDED)) {
+		DNS_ZONE_SETFLAG(zone, DNS_ZONEFLG_DEMANDED);
+		start = !DNS_ZONE_FLAG(zone, DNS_ZONEFLG_LOADPENDING);
+	}
+
+	waiter = isc_mem_get(zone->mctx, sizeof(*waiter));
+	*waiter = (dns_demandwaiter_t){
+		.cb = cb,
+		.arg = arg,
+		.link = ISC_LINK_INITIALIZER,
+	};
+	isc_loop_attach(loop, &waiter->loop);
+	ISC_LIST_APPEND(zone->demandwaiters, waiter, link);
+
+	if (start) {
+		dns_zone_logc(zone, DNS_LOGCATEGORY_ZONELOAD, ISC_LOG_INFO,
+			      "loading on demand");
+		zone_startasyncload(zone, 0, NULL, NULL, size);
+	}
+
+unlock:
 	UNLOCK_ZONE(zone);
 
-	return ISC_R_SUCCESS;
+	return result;
+}
+
+void
+dns_zone_setlastquery(dns_zone_t *zone, isc_stdtime_t now) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	if (DNS_ZONE_OPTION(zone, DNS_ZONEOPT_LOADONDEMAND) &&
+	    atomic_load_relaxed(&zone->lastquery) != now)
+	{
+		atomic_store_relaxed(&zone->lastquery, now);
+	}
+}
+
+void
+dns_zone_setdemandidletime(dns_zone_t *zone, uint32_t seconds) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+	REQUIRE(seconds > 0);
+
+	LOCK_ZONE(zone);
+	zone->demandidle = seconds;
+	UNLOCK_ZONE(zone);
 }
 
 bool
@@ -2435,6 +3005,26 @@ dns__zone_loadpending(dns_zone_t *zone) {
 	return DNS_ZONE_FLAG(zone, DNS_ZONEFLG_LOADPENDING);
 }
 
+uint64_t
+dns__zone_loadsize(dns_zone_t *zone) {
+	dns_zone_t *raw = NULL;
+	const char *file = NULL;
+	off_t size = 0;
+
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	dns_zone_getraw(zone, &raw);
+	file = (raw != NULL) ? raw->masterfile : zone->masterfile;
+	if (file == NULL || isc_file_getsize(file, &size) != ISC_R_SUCCESS) {
+		size = 0;
+	}
+	if (raw != NULL) {
+		dns_zone_detach(&raw);
+	}
+
+	return (uint64_t)size;
+}
+
 isc_result_t
 dns_zone_loadandthaw(dns_zone_t *zone) {
 	isc_result_t result;
@@ -3745,6 +4335,9 @@ zone_addnsec3chain(dns_zone_t *zone, dns_rdata_nsec3param_t *nsec3param) {
 	nsec3chain->seen_nsec = false;
 	nsec3chain->delete_nsec = false;
 	nsec3chain->save_delete_nsec = false;
+	nsec3chain->nodes = 0;
+	nsec3chain->total = dns_db_nodecount(db, dns_dbtree_main);
+	nsec3chain->started = isc_stdtime_now();
 
 	/*
 	 * Log NSEC3 parameters defined by supplied NSEC3PARAM RDATA.
@@ -4520,6 +5113,8 @@ zone_journal(dns_zone_t *zone, dns_diff_t *diff, uint32_t *sourceserial,
 			return result;
 		}
 
+		dns_journal_setindex(journal, zone->journalindex);
+
 		if (sourceserial != NULL) {
 			dns_journal_set_sourceserial(journal, *sourceserial);
 		}
@@ -5084,6 +5679,8 @@ zone_postload(dns_zone_t *zone, dns_db_t *db, isc_time_t loadtime,
 					      "journal file is out of date: "
 					      "removing journal file");
 			}
+			dns_journalindex_reset(zone->journalindex);
+			zone->dumpbase = false;
 			if (remove(zone->journal) < 0 && errno != ENOENT) {
 				char strbuf[ISC_STRERRORSIZE];
 				strerror_r(errno, strbuf, sizeof(strbuf));
@@ -5505,6 +6102,17 @@ cleanup:
 
 done:
 	DNS_ZONE_CLRFLAG(zone, DNS_ZONEFLG_LOADPENDING);
+	zone_loadfinished(zone);
+	zone_demandwake(zone);
+	if (DNS_ZONE_OPTION(zone, DNS_ZONEOPT_LOADONDEMAND) &&
+	    DNS_ZONE_FLAG(zone, DNS_ZONEFLG_LOADED))
+	{
+		atomic_store_relaxed(&zone->lastquery, isc_time_seconds(&now));
+		DNS_ZONE_TIME_ADD(&now, zone->demandidle, &zone->unloadtime);
+		if (zone->loop != NULL) {
+			zone_settimer(zone, &now);
+		}
+	}
 	/*
 	 * If this is an inline-signed zone and we were called for the raw
 	 * zone, we need to clear DNS_ZONEFLG_LOADPENDING for the secure zone
@@ -5517,6 +6125,7 @@ done:
 	if (inline_raw(zone) && DNS_ZONE_FLAG(zone->secure, DNS_ZONEFLG_LOADED))
 	{
 		DNS_ZONE_CLRFLAG(zone->secure, DNS_ZONEFLG_LOADPENDING);
+		zone_loadfinished(zone->secure);
 		/*
 		 * Re-start zone maintenance if it had been stalled
 		 * due to DNS_ZONEFLG_LOADPENDING being set when
@@ -6217,6 +6826,7 @@ dns_zone_setprimaries(dns_zone_t *zone, isc_sockaddr_t *addresses,
 		if (zone->request != NULL) {
 			dns_request_cancel(zone->request);
 		}
+		cancel_soaprobes(zone);
 	} else {
 		goto unlock;
 	}
@@ -7270,6 +7880,7 @@ zone_resigninc(dns_zone_t *zone) {
 	unsigned int i;
 	unsigned int nkeys = 0;
 	isc_stdtime_t resign;
+	isc_nanosecs_t catchup = 0;
 
 	ENTER;
 
@@ -7326,6 +7937,21 @@ zone_resigninc(dns_zone_t *zone) {
 			     isc_result_totext(result));
 	}
 
+	/*
+	 * If the oldest signature is more than 5 minutes late, the zone
+	 * has more signatures to refresh than the passes keep up with.
+	 * Re-sign more RRsets in this pass, so that the cost of
+	 * re-signing the SOA and of writing the journal is spread over
+	 * more of them, for a bounded time.
+	 */
+	if (result == ISC_R_SUCCESS &&
+	    resign - dns_zone_getsigresigninginterval(zone) < now - 300)
+	{
+		dns_zone_log(zone, ISC_LOG_DEBUG(3),
+			     "zone_resigninc: re-signing is late, catching up");
+		catchup = isc_time_monotonic() + RESIGN_CATCHUP_TIME;
+	}
+
 	i = 0;
 	while (result == ISC_R_SUCCESS) {
 		dns_rdatatype_t covers = DNS_TYPEPAIR_COVERS(typepair);
@@ -7337,10 +7963,14 @@ zone_resigninc(dns_zone_t *zone) {
 		 * entire zone.  The SOA record should always be the most
 		 * recent signature.
 		 */
-		/* XXXMPA increase number of RRsets signed pre call */
 		if ((covers == dns_rdatatype_soa &&
 		     dns_name_equal(name, &zone->origin)) ||
-		    i++ > zone->signatures || resign > stop)
+		    resign > stop)
+		{
+			break;
+		}
+		if (i++ > zone->signatures &&
+		    (catchup == 0 || isc_time_monotonic() > catchup))
 		{
 			break;
 		}
@@ -8686,6 +9316,7 @@ zone_nsec3chain(dns_zone_t *zone) {
 		 * Process one node.
 		 */
 		dns_dbiterator_pause(nsec3chain->dbiterator);
+		nsec3chain->nodes++;
 		result = dns_nsec3_addnsec3(
 			db, version, name, &nsec3chain->nsec3param,
 			zone_nsecttl(zone), unsecure, &nsec3_diff);
@@ -9233,6 +9864,7 @@ failure:
 			RUNTIME_CHECK(result == ISC_R_SUCCESS);
 			dns_dbiterator_pause(nsec3chain->dbiterator);
 			nsec3chain->delete_nsec = nsec3chain->save_delete_nsec;
+			nsec3chain->nodes = 0;
 		}
 	}
 
@@ -9254,6 +9886,7 @@ failure:
 			RUNTIME_CHECK(result == ISC_R_SUCCESS);
 			dns_dbiterator_pause(nsec3chain->dbiterator);
 			nsec3chain->delete_nsec = nsec3chain->save_delete_nsec;
+			nsec3chain->nodes = 0;
 		}
 		nsec3chain = ISC_LIST_TAIL(cleanup);
 	}
@@ -11266,6 +11899,45 @@ failure:
 	INSIST(ver == NULL);
 }
 
+/*
+ * Unload 'zone', which is loaded on demand, if it has not been queried
+ * for its idle time; otherwise move 'unloadtime' to when it will have
+ * been idle for that long.  The zone must be locked.
+ */
+static void
+zone_idleunload(dns_zone_t *zone, isc_time_t *now) {
+	isc_stdtime_t lastquery = atomic_load_relaxed(&zone->lastquery);
+	isc_stdtime_t idleuntil = lastquery + zone->demandidle;
+
+	REQUIRE(LOCKED_ZONE(zone));
+
+	isc_time_settoepoch(&zone->unloadtime);
+	if (!DNS_ZONE_FLAG(zone, DNS_ZONEFLG_LOADED)) {
+		return;
+	}
+
+	if (DNS_ZONE_FLAG(zone, DNS_ZONEFLG_NEEDDUMP) ||
+	    DNS_ZONE_FLAG(zone, DNS_ZONEFLG_DUMPING) ||
+	    DNS_ZONE_FLAG(zone, DNS_ZONEFLG_NEEDNOTIFY) ||
+	    DNS_ZONE_FLAG(zone, DNS_ZONEFLG_NEEDSTARTUPNOTIFY))
+	{
+		/* Try again after the pending work is done. */
+		DNS_ZONE_TIME_ADD(now, zone->demandidle, &zone->unloadtime);
+		return;
+	}
+
+	if (idleuntil > isc_time_seconds(now)) {
+		isc_time_set(&zone->unloadtime, idleuntil, 0);
+		return;
+	}
+
+	dns_zone_logc(zone, DNS_LOGCATEGORY_ZONELOAD, ISC_LOG_INFO,
+		      "unloaded after %u seconds without queries",
+		      zone->demandidle);
+	zone_unload(zone);
+	DNS_ZONE_CLRFLAG(zone, DNS_ZONEFLG_DEMANDED);
+}
+
 static void
 zone_maintenance(dns_zone_t *zone) {
 	isc_time_t now;
@@ -11301,7 +11973,7 @@ zone_maintenance(dns_zone_t *zone) {
 	now = isc_time_now();
 
 	/*
-	 * Expire check.
+	 * Expire check; idle check for zones loaded on demand.
 	 */
 	switch (zone->type) {
 	case dns_zone_redirect:
@@ -11321,6 +11993,15 @@ zone_maintenance(dns_zone_t *zone) {
 		}
 		UNLOCK_ZONE(zone);
 		break;
+	case dns_zone_primary:
+		LOCK_ZONE(zone);
+		if (!isc_time_isepoch(&zone->unloadtime) &&
+		    isc_time_compare(&now, &zone->unloadtime) >= 0)
+		{
+			zone_idleunload(zone, &now);
+		}
+		UNLOCK_ZONE(zone);
+		break;
 	default:
 		break;
 	}
@@ -11383,6 +12064,10 @@ zone_maintenance(dns_zone_t *zone) {
 		} else {
 			dumping = true;
 		}
+		if (!dumping && zone_dumpdefer(zone)) {
+			DNS_ZONE_TIME_ADD(&now, DNS_DUMP_DELAY, &zone->dumptime);
+			dumping = true;
+		}
 		UNLOCK_ZONE(zone);
 		if (!dumping) {
 			result = zone_dump(zone, true); /* loop locked */
@@ -11667,6 +12352,7 @@ zone_refresh(dns_zone_t *zone) {
 	}
 
 	dns_remote_reset(&zone->primaries, true);
+	cancel_soaprobes(zone);
 
 	/* initiate soa query */
 	queue_soa_query(zone);
@@ -11767,6 +12453,204 @@ zone_journal_rollforward(dns_zone_t *zone, dns_db_t *db, bool *needdump,
 	}
 }
 
+/*
+ * Log the result of a journal compaction, and if the journal was
+ * 'replaced', account for the compaction that took from 'start' and
+ * shrank it from 'before' to 'after' bytes.
+ */
+static void
+zone_journal_compacted(dns_zone_t *zone, isc_result_t result, bool replaced,
+		       isc_nanosecs_t start, off_t before, off_t after) {
+	switch (result) {
+	case ISC_R_SUCCESS:
+	case ISC_R_NOSPACE:
+	case ISC_R_NOTFOUND:
+		dns_zone_log(zone, ISC_LOG_DEBUG(3), "dns_journal_compact: %s",
+			     isc_result_totext(result));
+		break;
+	default:
+		dns_zone_log(zone, ISC_LOG_ERROR,
+			     "dns_journal_compact failed: %s",
+			     isc_result_totext(result));
+		break;
+	}
+
+	if (result != ISC_R_SUCCESS || !replaced) {
+		return;
+	}
+
+	/*
+	 * Only transactions older than the last dump are discarded.
+	 */
+	if (before > after) {
+		zone->dumpjournal -= ISC_MIN(zone->dumpjournal, before - after);
+	}
+
+	if (zone->stats == NULL) {
+		return;
+	}
+
+	isc_stats_increment(zone->stats, dns_zonestatscounter_jnlcompact);
+	isc_stats_add(zone->stats, dns_zonestatscounter_jnlcompacttime,
+		      (isc_time_monotonic() - start) / NS_PER_US);
+	if (before > after) {
+		isc_stats_add(zone->stats, dns_zonestatscounter_jnlreclaimed,
+			      (uint64_t)(before - after));
+	}
+}
+
+static off_t
+zone_journal_size(dns_zone_t *zone) {
+	off_t size = 0;
+
+	if (isc_file_getsize(zone->journal, &size) != ISC_R_SUCCESS) {
+		return 0;
+	}
+	return size;
+}
+
+/*
+ * Secondary zones are loaded from the zone file and the journal, so the
+ * zone file doesn't need to be rewritten after each transfer as long as
+ * the journal holds every transaction since it was dumped.  Return true
+ * if the scheduled dump can be put off because those transactions are
+ * still small compared with the zone file.
+ */
+static bool
+zone_dumpdefer(dns_zone_t *zone) {
+	isc_result_t result;
+	dns_journal_t *journal = NULL;
+	uint32_t serial;
+	off_t filesize = 0, delta;
+	bool defer;
+
+	INSIST(LOCKED_ZONE(zone));
+
+	if (zone->dumpratio == 0 || !zone->dumpbase || zone->journal == NULL ||
+	    (zone->type != dns_zone_secondary &&
+	     zone->type != dns_zone_mirror) ||
+	    DNS_ZONE_FLAG(zone, DNS_ZONEFLG_FLUSH))
+	{
+		return false;
+	}
+
+	result = isc_file_getsize(zone->masterfile, &filesize);
+	if (result != ISC_R_SUCCESS || filesize == 0) {
+		return false;
+	}
+
+	delta = zone_journal_size(zone) - zone->dumpjournal;
+	if (delta < 0) {
+		delta = 0;
+	}
+	if ((uint64_t)delta * 100 >= (uint64_t)filesize * zone->dumpratio ||
+	    (zone->journalsize != -1 && delta >= zone->journalsize / 2))
+	{
+		return false;
+	}
+
+	ZONEDB_LOCK(&zone->dblock, isc_rwlocktype_read);
+	if (zone->db != NULL) {
+		result = dns_db_getsoaserial(zone->db, NULL, &serial);
+	} else {
+		result = ISC_R_NOTFOUND;
+	}
+	ZONEDB_UNLOCK(&zone->dblock, isc_rwlocktype_read);
+	if (result != ISC_R_SUCCESS) {
+		return false;
+	}
+
+	result = dns_journal_open(zone->mctx, zone->journal, DNS_JOURNAL_READ,
+				  &journal);
+	if (result != ISC_R_SUCCESS) {
+		return false;
+	}
+	defer = isc_serial_le(dns_journal_first_serial(journal),
+			      zone->dumpserial) &&
+		dns_journal_last_serial(journal) == serial;
+	dns_journal_destroy(&journal);
+
+	if (defer) {
+		dns_zone_log(zone, ISC_LOG_DEBUG(1),
+			     "dump deferred: %" PRId64
+			     " bytes journaled since serial %u",
+			     (int64_t)delta, zone->dumpserial);
+	}
+	return defer;
+}
+
+static void
+zone_journal_compact_work(void *arg) {
+	dns_jnlcompact_t *jc = arg;
+
+	jc->result = dns_journal_compact(jc->zone->mctx, jc->journal,
+					 jc->serial, DNS_JOURNAL_COMPACTDEFER,
+					 jc->journalsize);
+}
+
+/*
+ * Switch over to the journal compacted in the background.  This runs on
+ * the zone's loop, like everything else that commits to the journal, so
+ * nothing is committed to it while the transactions committed during
+ * the compaction are appended to the compacted journal.
+ */
+static void
+zone_journal_compact_done(void *arg) {
+	dns_jnlcompact_t *jc = arg;
+	dns_zone_t *zone = jc->zone;
+	isc_result_t result = jc->result;
+	off_t before = 0, after = 0;
+	bool replaced = false;
+
+	LOCK_ZONE(zone);
+	DNS_ZONE_CLRFLAG(zone, DNS_ZONEFLG_COMPACTING);
+	if (result == DNS_R_CONTINUE) {
+		if (zone->journal == NULL ||
+		    strcmp(zone->journal, jc->journal) != 0)
+		{
+			/* The journal was renamed meanwhile. */
+			dns_journal_compact_cancel(jc->journal);
+			result = ISC_R_SUCCESS;
+		} else if (zone->xfr != NULL) {
+			/*
+			 * An incoming transfer may be committing to the
+			 * journal from another thread; compact again once
+			 * it is done.
+			 */
+			dns_journal_compact_cancel(jc->journal);
+			DNS_ZONE_SETFLAG(zone, DNS_ZONEFLG_NEEDCOMPACT);
+			zone->compact_serial = jc->serial;
+			result = ISC_R_SUCCESS;
+		} else {
+			before = zone_journal_size(zone);
+			result = dns_journal_compact_finish(zone->mctx,
+							    zone->journal);
+			after = zone_journal_size(zone);
+			dns_journalindex_reset(zone->journalindex);
+			replaced = true;
+			if (result == ISC_R_RANGE) {
+				/* The journal was replaced meanwhile. */
+				result = ISC_R_NOTFOUND;
+			}
+		}
+	}
+	zone_journal_compacted(zone, result, replaced, jc->start, before,
+			       after);
+	UNLOCK_ZONE(zone);
+
+	isc_mem_free(zone->mctx, jc->journal);
+	isc_mem_put(zone->mctx, jc, sizeof(*jc));
+	dns_zone_idetach(&zone);
+}
+
+static void
+zone_journal_compact_start(void *arg) {
+	dns_jnlcompact_t *jc = arg;
+
+	isc_work_enqueue_bulk(jc->zone->loop, zone_journal_compact_work,
+			      zone_journal_compact_done, jc);
+}
+
 static void
 zone_journal_compact(dns_zone_t *zone, dns_db_t *db, uint32_t serial) {
 	isc_result_t result;
@@ -11774,12 +12658,20 @@ zone_journal_compact(dns_zone_t *zone, dns_db_t *db, uint32_t serial) {
 	dns_dbversion_t *ver = NULL;
 	uint64_t dbsize;
 	uint32_t options = 0;
+	dns_jnlcompact_t *jc = NULL;
+	isc_nanosecs_t start = isc_time_monotonic();
+	off_t before, after;
 
 	INSIST(LOCKED_ZONE(zone));
 	if (inline_raw(zone)) {
 		INSIST(LOCKED_ZONE(zone->secure));
 	}
 
+	if (DNS_ZONE_FLAG(zone, DNS_ZONEFLG_COMPACTING)) {
+		zone_debuglog(zone, __func__, 1, "compaction already running");
+		return;
+	}
+
 	journalsize = zone->journalsize;
 	if (journalsize == -1) {
 		journalsize = DNS_JOURNAL_SIZE_MAX;
@@ -11802,22 +12694,35 @@ zone_journal_compact(dns_zone_t *zone, dns_db_t *db, uint32_t serial) {
 	} else {
 		zone_debuglog(zone, __func__, 1, "target journal size %d",
 			      journalsize);
+
+		/*
+		 * Copy the retained part of the journal in the background;
+		 * zone_journal_compact_done() switches over to it.
+		 */
+		jc = isc_mem_get(zone->mctx, sizeof(*jc));
+		*jc = (dns_jnlcompact_t){
+			.journal = isc_mem_strdup(zone->mctx, zone->journal),
+			.serial = serial,
+			.journalsize = journalsize,
+			.start = start,
+		};
+		zone_iattach(zone, &jc->zone);
+		DNS_ZONE_SETFLAG(zone, DNS_ZONEFLG_COMPACTING);
+		isc_async_run(zone->loop, zone_journal_compact_start, jc);
+		return;
 	}
-	result = dns_journal_compact(zone->mctx, zone->journal, serial, options,
-				     journalsize);
-	switch (result) {
-	case ISC_R_SUCCESS:
-	case ISC_R_NOSPACE:
-	case ISC_R_NOTFOUND:
-		dns_zone_log(zone, ISC_LOG_DEBUG(3), "dns_journal_compact: %s",
-			     isc_result_totext(result));
-		break;
-	default:
-		dns_zone_log(zone, ISC_LOG_ERROR,
-			     "dns_journal_compact failed: %s",
-			     isc_result_totext(result));
-		break;
-	}
+
+	/*
+	 * A journal being repaired is rewritten in place, before anything
+	 * else commits to it.
+	 */
+	before = zone_journal_size(zone);
+	result = dns_journal_compact(zone->mctx, zone->journal, serial, options,
+				     journalsize);
+	after = zone_journal_size(zone);
+	dns_journalindex_reset(zone->journalindex);
+	zone_journal_compacted(zone, result, before != after, start, before,
+			       after);
 }
 
 isc_result_t
@@ -11906,7 +12811,7 @@ dump_done(void *arg, isc_result_t result) {
 	dns_dbversion_t *version;
 	bool again = false;
 	bool compact = false;
-	uint32_t serial;
+	uint32_t serial, dumpserial;
 	isc_result_t tresult;
 
 	REQUIRE(DNS_ZONE_VALID(zone));
@@ -11941,6 +12846,7 @@ dump_done(void *arg, isc_result_t result) {
 		db = dns_dumpctx_db(zone->dumpctx);
 		version = dns_dumpctx_version(zone->dumpctx);
 		tresult = dns_db_getsoaserial(db, version, &serial);
+		dumpserial = serial;
 
 		/*
 		 * Handle lock order inversion.
@@ -11979,6 +12885,11 @@ dump_done(void *arg, isc_result_t result) {
 			}
 			ZONEDB_UNLOCK(&secure->dblock, isc_rwlocktype_read);
 		}
+		if (tresult == ISC_R_SUCCESS) {
+			zone->dumpserial = dumpserial;
+			zone->dumpjournal = zone_journal_size(zone);
+			zone->dumpbase = true;
+		}
 		if (tresult == ISC_R_SUCCESS && zone->xfr == NULL) {
 			dns_db_t *zdb = NULL;
 			if (dns_zone_getdb(zone, &zdb) == ISC_R_SUCCESS) {
@@ -12210,6 +13121,9 @@ dumptostream(dns_zone_t *zone, FILE *fd, const dns_master_style_t *style,
 		rawdata.flags = DNS_MASTERRAW_SOURCESERIALSET;
 		rawdata.sourceserial = zone->sourceserial;
 	}
+	if (rawversion == DNS_RAWFORMAT_INDEXED) {
+		rawdata.flags |= DNS_MASTERRAW_INDEXED;
+	}
 	result = dns_master_dumptostream(zone->mctx, db, version, style, format,
 					 &rawdata, fd);
 	dns_db_closeversion(db, &version, false);
@@ -12380,6 +13294,50 @@ dns_zone_setmaxrrperset(dns_zone_t *zone, uint32_t val) {
 	}
 }
 
+void
+dns_zone_setupdatequota(dns_zone_t *zone, uint32_t val) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	isc_quota_max(&zone->updquota, val);
+}
+
+isc_quota_t *
+dns_zone_getupdatequota(dns_zone_t *zone) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	return &zone->updquota;
+}
+
+void
+dns_zone_setupdatebatchwindow(dns_zone_t *zone, uint32_t window) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	zone->updatebatchwindow = window;
+}
+
+uint32_t
+dns_zone_getupdatebatchwindow(dns_zone_t *zone) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	return zone->updatebatchwindow;
+}
+
+void
+dns_zone_setupdatebatch(dns_zone_t *zone, void *batch) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+	REQUIRE(zone->loop == isc_loop());
+
+	zone->updatebatch = batch;
+}
+
+void *
+dns_zone_getupdatebatch(dns_zone_t *zone) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+	REQUIRE(zone->loop == isc_loop());
+
+	return zone->updatebatch;
+}
+
 void
 dns_zone_setmaxtypepername(dns_zone_t *zone, uint32_t val) {
 	REQUIRE(DNS_ZONE_VALID(zone));
@@ -12434,8 +13392,9 @@ requeue:
 		}
 
 		notify->flags &= ~DNS_NOTIFY_STARTUP;
-		result = isc_ratelimiter_enqueue(
+		result = isc_ratelimiter_enqueuegroup(
 			notify->zone->zmgr->notifyrl, notify->zone->loop,
+			isc_sockaddr_hash(&notify->dst, true),
 			notify_send_toaddr, notify, &notify->rlevent);
 		if (result != ISC_R_SUCCESS) {
 			return false;
@@ -12633,13 +13592,17 @@ destroy:
 	notify_destroy(notify, false);
 }
 
+/*
+ * Queue the NOTIFY to be sent by the rate limiter, along with the
+ * other NOTIFY messages queued for the same server.
+ */
 static isc_result_t
 notify_send_queue(dns_notify_t *notify, bool startup) {
-	return isc_ratelimiter_enqueue(
+	return isc_ratelimiter_enqueuegroup(
 		startup ? notify->zone->zmgr->startupnotifyrl
 			: notify->zone->zmgr->notifyrl,
-		notify->zone->loop, notify_send_toaddr, notify,
-		&notify->rlevent);
+		notify->zone->loop, isc_sockaddr_hash(&notify->dst, true),
+		notify_send_toaddr, notify, &notify->rlevent);
 }
 
 static void
@@ -14064,6 +15027,14 @@ refresh_callback(void *arg) {
 		goto exiting;
 	}
 
+	/*
+	 * An SOA probe has found a newer serial before this query was
+	 * answered.
+	 */
+	if (zone->soaprobetakeover) {
+		goto soaprobe_transfer;
+	}
+
 	/*
 	 * If timeout, log and try the next primary
 	 */
@@ -14341,6 +15312,11 @@ refresh_callback(void *arg) {
 	    DNS_ZONE_FLAG(zone, DNS_ZONEFLG_FORCEXFER) ||
 	    isc_serial_gt(serial, oldserial))
 	{
+		if (zone->soaprobebest != SOAPROBE_NONE &&
+		    isc_serial_gt(zone->soaprobeserial, serial))
+		{
+			goto soaprobe_transfer;
+		}
 		if (dns_zonemgr_unreachable(zone->zmgr, &curraddr,
 					    &zone->sourceaddr, &now))
 		{
@@ -14418,12 +15394,20 @@ next_primary:
 		dns_message_detach(&msg);
 	}
 	dns_request_destroy(&zone->request);
+	/*
+	 * Rather than trying the next primary, transfer from the one
+	 * an SOA probe found with a newer serial.
+	 */
+	if (zone->soaprobebest != SOAPROBE_NONE) {
+		goto soaprobe_transfer;
+	}
 	/*
 	 * Skip to next failed / untried primary.
 	 */
 	dns_remote_next(&zone->primaries, true);
 	DNS_ZONE_CLRFLAG(zone, DNS_ZONEFLG_NOEDNS);
 	if (dns_remote_done(&zone->primaries)) {
+		cancel_soaprobes(zone);
 		DNS_ZONE_CLRFLAG(zone, DNS_ZONEFLG_REFRESH);
 		if (DNS_ZONE_FLAG(zone, DNS_ZONEFLG_NEEDREFRESH)) {
 			DNS_ZONE_CLRFLAG(zone, DNS_ZONEFLG_NEEDREFRESH);
@@ -14438,6 +15422,21 @@ next_primary:
 
 exiting:
 	dns_request_destroy(&zone->request);
+	cancel_soaprobes(zone);
+	goto detach;
+
+soaprobe_transfer:
+	if (msg != NULL) {
+		dns_message_detach(&msg);
+	}
+	dns_request_destroy(&zone->request);
+	dns_remote_select(&zone->primaries, zone->soaprobebest);
+	curraddr = dns_remote_curraddr(&zone->primaries);
+	isc_sockaddr_format(&curraddr, primary, sizeof(primary));
+	dns_zone_logc(zone, DNS_LOGCATEGORY_XFER_IN, ISC_LOG_INFO,
+		      "refresh: primary %s has the newest serial (%u)",
+		      primary, zone->soaprobeserial);
+	do_queue_xfrin = true;
 	goto detach;
 
 same_primary:
@@ -14451,6 +15450,7 @@ detach:
 	if (do_queue_xfrin) {
 		/* Shows in the statistics channel the duration of the step. */
 		zone->xfrintime = isc_time_now();
+		cancel_soaprobes(zone);
 	}
 	UNLOCK_ZONE(zone);
 	if (do_queue_xfrin) {
@@ -14469,6 +15469,7 @@ static void
 queue_soa_query(dns_zone_t *zone) {
 	isc_result_t result;
 	struct soaquery *sq = NULL;
+	uint32_t group = 0;
 
 	ENTER;
 	/*
@@ -14491,8 +15492,17 @@ queue_soa_query(dns_zone_t *zone) {
 	 * Attach so that we won't clean up until the event is delivered.
 	 */
 	zone_iattach(zone, &sq->zone);
-	result = isc_ratelimiter_enqueue(zone->zmgr->refreshrl, zone->loop,
-					 soa_query, sq, &sq->rlevent);
+
+	/*
+	 * The SOA queries queued for the same primary are sent together.
+	 */
+	if (!dns_remote_done(&zone->primaries)) {
+		isc_sockaddr_t primary = dns_remote_curraddr(&zone->primaries);
+		group = isc_sockaddr_hash(&primary, true);
+	}
+	result = isc_ratelimiter_enqueuegroup(zone->zmgr->refreshrl,
+					      zone->loop, group, soa_query, sq,
+					      &sq->rlevent);
 	if (result != ISC_R_SUCCESS) {
 		zone_idetach(&sq->zone);
 		isc_mem_put(zone->mctx, sq, sizeof(*sq));
@@ -14530,6 +15540,17 @@ soa_query(void *arg) {
 		goto cleanup;
 	}
 
+	/*
+	 * An SOA probe has already found a newer serial.
+	 */
+	if (zone->soaprobebest != SOAPROBE_NONE) {
+		dns_remote_select(&zone->primaries, zone->soaprobebest);
+		do_queue_xfrin = true;
+		cancel = false;
+		result = ISC_R_SUCCESS;
+		goto cleanup;
+	}
+
 again:
 	dns_zone_logc(
 		zone, DNS_LOGCATEGORY_XFER_IN, ISC_LOG_DEBUG(3),
@@ -14663,89 +15684,362 @@ again:
 		goto cleanup;
 	}
 
-	create_query(zone, dns_rdatatype_soa, &zone->origin, &message);
+	create_query(zone, dns_rdatatype_soa, &zone->origin, &message);
+
+	if (!DNS_ZONE_FLAG(zone, DNS_ZONEFLG_NOEDNS)) {
+		result = add_opt(message, udpsize, reqnsid, reqexpire);
+		if (result != ISC_R_SUCCESS) {
+			zone_debuglogc(zone, DNS_LOGCATEGORY_XFER_IN, __func__,
+				       1, "unable to add opt record: %s",
+				       isc_result_totext(result));
+		}
+	}
+
+	zone_iattach(zone, &(dns_zone_t *){ NULL });
+
+	int timeout = 5;
+	result = dns_request_create(
+		zone->view->requestmgr, message, &zone->sourceaddr, &curraddr,
+		NULL, NULL, options, key, timeout * 3 + 1, timeout, 2,
+		zone->loop, refresh_callback, zone, &zone->request);
+	if (result != ISC_R_SUCCESS) {
+		zone_idetach(&(dns_zone_t *){ zone });
+		zone_debuglogc(zone, DNS_LOGCATEGORY_XFER_IN, __func__, 1,
+			       "dns_request_create() failed: %s",
+			       isc_result_totext(result));
+		goto skip_primary;
+	} else {
+		/* Shows in the statistics channel the duration of the query. */
+		zone->xfrintime = isc_time_now();
+
+		if (isc_sockaddr_pf(&curraddr) == PF_INET) {
+			inc_stats(zone, dns_zonestatscounter_soaoutv4);
+		} else {
+			inc_stats(zone, dns_zonestatscounter_soaoutv6);
+		}
+
+		send_soaprobes(zone);
+	}
+	cancel = false;
+cleanup:
+	if (transport != NULL) {
+		dns_transport_detach(&transport);
+	}
+	if (key != NULL) {
+		dns_tsigkey_detach(&key);
+	}
+	if (result != ISC_R_SUCCESS) {
+		DNS_ZONE_CLRFLAG(zone, DNS_ZONEFLG_REFRESH);
+	}
+	if (message != NULL) {
+		dns_message_detach(&message);
+	}
+	if (cancel) {
+		cancel_refresh(zone);
+	}
+	if (do_queue_xfrin) {
+		/* Shows in the statistics channel the duration of the step. */
+		zone->xfrintime = isc_time_now();
+		cancel_soaprobes(zone);
+	}
+	UNLOCK_ZONE(zone);
+	if (do_queue_xfrin) {
+		queue_xfrin(zone);
+	}
+	isc_rlevent_free(&sq->rlevent);
+	isc_mem_put(zone->mctx, sq, sizeof(*sq));
+	dns_zone_idetach(&zone);
+	return;
+
+skip_primary:
+	if (transport != NULL) {
+		dns_transport_detach(&transport);
+	}
+	if (key != NULL) {
+		dns_tsigkey_detach(&key);
+	}
+	if (message != NULL) {
+		dns_message_detach(&message);
+	}
+	/*
+	 * Skip to next failed / untried primary.
+	 */
+	dns_remote_next(&zone->primaries, true);
+	if (!dns_remote_done(&zone->primaries)) {
+		goto again;
+	}
+	dns_remote_reset(&zone->primaries, false);
+	goto cleanup;
+}
+
+/*
+ * Get the serial from the answer to an SOA probe.  Unlike
+ * refresh_callback(), anything but a plain authoritative answer is
+ * just ignored: the primary will get its turn in the refresh anyway.
+ */
+static isc_result_t
+soaprobe_serial(dns_zone_t *zone, dns_request_t *request, uint32_t *serialp) {
+	dns_message_t *msg = NULL;
+	dns_rdataset_t *rdataset = NULL;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdata_soa_t soa;
+	isc_result_t result;
+
+	result = dns_request_getresult(request);
+	if (result != ISC_R_SUCCESS) {
+		return result;
+	}
+
+	dns_message_create(zone->mctx, NULL, NULL, DNS_MESSAGE_INTENTPARSE,
+			   &msg);
+	CHECK(dns_request_getresponse(request, msg, 0));
+
+	if (msg->opcode != dns_opcode_query ||
+	    msg->rcode != dns_rcode_noerror ||
+	    (msg->flags & DNS_MESSAGEFLAG_TC) != 0 ||
+	    (msg->flags & DNS_MESSAGEFLAG_AA) == 0 ||
+	    message_count(msg, DNS_SECTION_ANSWER, dns_rdatatype_cname) != 0 ||
+	    message_count(msg, DNS_SECTION_ANSWER, dns_rdatatype_soa) != 1)
+	{
+		CHECK(DNS_R_UNEXPECTEDRCODE);
+	}
+
+	CHECK(dns_message_findname(msg, DNS_SECTION_ANSWER, &zone->origin,
+				   dns_rdatatype_soa, dns_rdatatype_none, NULL,
+				   &rdataset));
+	CHECK(dns_rdataset_first(rdataset));
+	dns_rdataset_current(rdataset, &rdata);
+	result = dns_rdata_tostruct(&rdata, &soa, NULL);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	*serialp = soa.serial;
+
+failure:
+	dns_message_detach(&msg);
+	return result;
+}
+
+/*
+ * An SOA probe has finished (successfully or not).
+ */
+static void
+soaprobe_callback(void *arg) {
+	dns_request_t *request = (dns_request_t *)arg;
+	dns_soaprobe_t *probe = dns_request_getarg(request);
+	dns_zone_t *zone = probe->zone;
+	char primary[ISC_SOCKADDR_FORMATSIZE];
+	isc_sockaddr_t addr;
+	isc_result_t result;
+	uint32_t serial = 0, oldserial = 0;
+
+	INSIST(DNS_ZONE_VALID(zone));
+
+	ENTER;
+
+	LOCK_ZONE(zone);
+
+	/*
+	 * The refresh that sent the probe is over.
+	 */
+	if (!ISC_LINK_LINKED(probe, link)) {
+		goto cleanup;
+	}
+	ISC_LIST_UNLINK(zone->soaprobes, probe, link);
+
+	if (DNS_ZONE_FLAG(zone, DNS_ZONEFLG_EXITING)) {
+		goto cleanup;
+	}
+
+	addr = dns_remote_addr(&zone->primaries, probe->index);
+	isc_sockaddr_format(&addr, primary, sizeof(primary));
+
+	result = soaprobe_serial(zone, request, &serial);
+	if (result != ISC_R_SUCCESS) {
+		zone_debuglogc(zone, DNS_LOGCATEGORY_XFER_IN, __func__, 1,
+			       "no serial from primary %s: %s", primary,
+			       isc_result_totext(result));
+		goto takeover;
+	}
+
+	zone->soaprobeanswers++;
+	if (DNS_ZONE_FLAG(zone, DNS_ZONEFLG_LOADED)) {
+		result = zone_get_from_db(zone, zone->db, NULL, NULL, NULL,
+					  &oldserial, NULL, NULL, NULL, NULL,
+					  NULL);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	}
+	zone_debuglogc(zone, DNS_LOGCATEGORY_XFER_IN, __func__, 1,
+		       "serial from primary %s: new %u, old %u", primary,
+		       serial, oldserial);
+
+	if (DNS_ZONE_FLAG(zone, DNS_ZONEFLG_LOADED) &&
+	    !DNS_ZONE_FLAG(zone, DNS_ZONEFLG_FORCEXFER) &&
+	    !isc_serial_gt(serial, oldserial))
+	{
+		/*
+		 * Nothing to transfer from this primary; don't query it
+		 * again in this refresh.
+		 */
+		dns_remote_markaddr(&zone->primaries, probe->index, true);
+	} else if (zone->soaprobebest == SOAPROBE_NONE ||
+		   isc_serial_gt(serial, zone->soaprobeserial))
+	{
+		zone->soaprobebest = probe->index;
+		zone->soaprobeserial = serial;
+	}
+
+takeover:
+	/*
+	 * Stop waiting for the current primary.  refresh_callback()
+	 * starts the transfer when the query is cancelled.
+	 */
+	if (zone->soaprobebest != SOAPROBE_NONE && !zone->soaprobetakeover &&
+	    zone->request != NULL &&
+	    (zone->soaprobeanswers >= SOAPROBE_QUORUM ||
+	     ISC_LIST_EMPTY(zone->soaprobes)))
+	{
+		zone->soaprobetakeover = true;
+		dns_request_cancel(zone->request);
+	}
+
+cleanup:
+	dns_request_destroy(&probe->request);
+	UNLOCK_ZONE(zone);
+	isc_mem_put(zone->mctx, probe, sizeof(*probe));
+	dns_zone_idetach(&zone);
+}
+
+/*
+ * Send SOA queries to all the primaries but the current one, once per
+ * refresh.  Only zones that are transferred in are probed, and only
+ * the primaries that can be queried over UDP.
+ */
+static void
+send_soaprobes(dns_zone_t *zone) {
+	isc_sockaddr_t *sources = NULL;
+	dns_name_t **keynames = NULL, **tlsnames = NULL;
+	unsigned int count, timeout = 5;
+
+	REQUIRE(LOCKED_ZONE(zone));
+
+	if (zone->soaprobed) {
+		return;
+	}
+	zone->soaprobed = true;
+
+	count = dns_remote_count(&zone->primaries);
+	if (count < 2 ||
+	    (zone->type != dns_zone_secondary &&
+	     zone->type != dns_zone_mirror && zone->type != dns_zone_redirect))
+	{
+		return;
+	}
+
+	sources = dns_remote_sources(&zone->primaries);
+	keynames = dns_remote_keynames(&zone->primaries);
+	tlsnames = dns_remote_tlsnames(&zone->primaries);
+
+	for (unsigned int i = 0; i < count; i++) {
+		dns_soaprobe_t *probe = NULL;
+		dns_message_t *message = NULL;
+		dns_tsigkey_t *key = NULL;
+		isc_sockaddr_t addr, source, any;
+		isc_netaddr_t primaryip;
+		isc_result_t result;
+
+		addr = dns_remote_addr(&zone->primaries, i);
+		if (i == zone->primaries.curraddr ||
+		    isc_sockaddr_disabled(&addr) ||
+		    (tlsnames != NULL && tlsnames[i] != NULL))
+		{
+			continue;
+		}
+
+		source = sources[i];
+		if (isc_sockaddr_pf(&addr) == PF_INET) {
+			isc_sockaddr_any(&any);
+			if (isc_sockaddr_equal(&source, &any)) {
+				source = zone->xfrsource4;
+			}
+		} else {
+			isc_sockaddr_any6(&any);
+			if (isc_sockaddr_equal(&source, &any)) {
+				source = zone->xfrsource6;
+			}
+		}
 
-	if (!DNS_ZONE_FLAG(zone, DNS_ZONEFLG_NOEDNS)) {
-		result = add_opt(message, udpsize, reqnsid, reqexpire);
+		/*
+		 * soa_query() logs a missing key when it is the primary's
+		 * turn.
+		 */
+		if (keynames != NULL && keynames[i] != NULL) {
+			result = dns_view_gettsig(zone->view, keynames[i],
+						  &key);
+		} else {
+			isc_netaddr_fromsockaddr(&primaryip, &addr);
+			result = dns_view_getpeertsig(zone->view, &primaryip,
+						      &key);
+			if (result == ISC_R_NOTFOUND) {
+				result = ISC_R_SUCCESS;
+			}
+		}
 		if (result != ISC_R_SUCCESS) {
-			zone_debuglogc(zone, DNS_LOGCATEGORY_XFER_IN, __func__,
-				       1, "unable to add opt record: %s",
-				       isc_result_totext(result));
+			continue;
 		}
-	}
 
-	zone_iattach(zone, &(dns_zone_t *){ NULL });
+		create_query(zone, dns_rdatatype_soa, &zone->origin, &message);
+		if (!DNS_ZONE_FLAG(zone, DNS_ZONEFLG_NOEDNS)) {
+			(void)add_opt(message, SEND_BUFFER_SIZE, false, false);
+		}
 
-	int timeout = 5;
-	result = dns_request_create(
-		zone->view->requestmgr, message, &zone->sourceaddr, &curraddr,
-		NULL, NULL, options, key, timeout * 3 + 1, timeout, 2,
-		zone->loop, refresh_callback, zone, &zone->request);
-	if (result != ISC_R_SUCCESS) {
-		zone_idetach(&(dns_zone_t *){ zone });
-		zone_debuglogc(zone, DNS_LOGCATEGORY_XFER_IN, __func__, 1,
-			       "dns_request_create() failed: %s",
-			       isc_result_totext(result));
-		goto skip_primary;
-	} else {
-		/* Shows in the statistics channel the duration of the query. */
-		zone->xfrintime = isc_time_now();
+		probe = isc_mem_get(zone->mctx, sizeof(*probe));
+		*probe = (dns_soaprobe_t){
+			.index = i,
+			.link = ISC_LINK_INITIALIZER,
+		};
+		zone_iattach(zone, &probe->zone);
 
-		if (isc_sockaddr_pf(&curraddr) == PF_INET) {
+		result = dns_request_create(
+			zone->view->requestmgr, message, &source, &addr, NULL,
+			NULL, 0, key, timeout * 3 + 1, timeout, 2, zone->loop,
+			soaprobe_callback, probe, &probe->request);
+		dns_message_detach(&message);
+		if (key != NULL) {
+			dns_tsigkey_detach(&key);
+		}
+		if (result != ISC_R_SUCCESS) {
+			zone_idetach(&probe->zone);
+			isc_mem_put(zone->mctx, probe, sizeof(*probe));
+			continue;
+		}
+
+		ISC_LIST_APPEND(zone->soaprobes, probe, link);
+		if (isc_sockaddr_pf(&addr) == PF_INET) {
 			inc_stats(zone, dns_zonestatscounter_soaoutv4);
 		} else {
 			inc_stats(zone, dns_zonestatscounter_soaoutv6);
 		}
 	}
-	cancel = false;
-cleanup:
-	if (transport != NULL) {
-		dns_transport_detach(&transport);
-	}
-	if (key != NULL) {
-		dns_tsigkey_detach(&key);
-	}
-	if (result != ISC_R_SUCCESS) {
-		DNS_ZONE_CLRFLAG(zone, DNS_ZONEFLG_REFRESH);
-	}
-	if (message != NULL) {
-		dns_message_detach(&message);
-	}
-	if (cancel) {
-		cancel_refresh(zone);
-	}
-	if (do_queue_xfrin) {
-		/* Shows in the statistics channel the duration of the step. */
-		zone->xfrintime = isc_time_now();
-	}
-	UNLOCK_ZONE(zone);
-	if (do_queue_xfrin) {
-		queue_xfrin(zone);
-	}
-	isc_rlevent_free(&sq->rlevent);
-	isc_mem_put(zone->mctx, sq, sizeof(*sq));
-	dns_zone_idetach(&zone);
-	return;
+}
 
-skip_primary:
-	if (transport != NULL) {
-		dns_transport_detach(&transport);
-	}
-	if (key != NULL) {
-		dns_tsigkey_detach(&key);
-	}
-	if (message != NULL) {
-		dns_message_detach(&message);
-	}
-	/*
-	 * Skip to next failed / untried primary.
-	 */
-	dns_remote_next(&zone->primaries, true);
-	if (!dns_remote_done(&zone->primaries)) {
-		goto again;
+/*
+ * End the probing of a refresh, cancelling the probes that are still
+ * outstanding.
+ */
+static void
+cancel_soaprobes(dns_zone_t *zone) {
+	dns_soaprobe_t *probe = NULL;
+
+	REQUIRE(LOCKED_ZONE(zone));
+
+	while ((probe = ISC_LIST_HEAD(zone->soaprobes)) != NULL) {
+		ISC_LIST_UNLINK(zone->soaprobes, probe, link);
+		dns_request_cancel(probe->request);
 	}
-	dns_remote_reset(&zone->primaries, false);
-	goto cleanup;
+
+	zone->soaprobed = false;
+	zone->soaprobetakeover = false;
+	zone->soaprobeanswers = 0;
+	zone->soaprobebest = SOAPROBE_NONE;
 }
 
 static void
@@ -15059,6 +16353,7 @@ zone_shutdown(void *arg) {
 	if (zone->request != NULL) {
 		dns_request_cancel(zone->request);
 	}
+	cancel_soaprobes(zone);
 
 	if (zone->loadctx != NULL) {
 		dns_loadctx_cancel(zone->loadctx);
@@ -15078,9 +16373,8 @@ zone_shutdown(void *arg) {
 
 	forward_cancel(zone);
 
-	if (zone->timer != NULL) {
-		isc_refcount_decrement(&zone->irefs);
-		isc_timer_destroy(&zone->timer);
+	if (zone->timerref) {
+		zone_timer_release(zone);
 	}
 
 	/*
@@ -15125,43 +16419,226 @@ zone_shutdown(void *arg) {
 }
 
 static void
-zone_timer(void *arg) {
-	dns_zone_t *zone = (dns_zone_t *)arg;
-
+zone_timer(dns_zone_t *zone) {
 	REQUIRE(DNS_ZONE_VALID(zone));
 
 	zone_maintenance(zone);
 }
 
+static dns_zonelist_t *
+zonewheel_list(zonewheel_t *wheel, unsigned int slot) {
+	if (slot == ZONEWHEEL_DUE) {
+		return &wheel->due;
+	}
+	return &wheel->slots[slot / ZONEWHEEL_SLOTS][slot % ZONEWHEEL_SLOTS];
+}
+
+/*
+ * Place 'zone' in the wheel according to zone->timertick.  Return the
+ * tick the wheel timer has to fire at for it, or UINT64_MAX if the
+ * zone does not need an earlier wakeup than the wheel has planned.
+ */
+static uint64_t
+zonewheel_place(zonewheel_t *wheel, dns_zone_t *zone) {
+	uint64_t due = zone->timertick;
+	uint64_t delta;
+	unsigned int level = 0;
+
+	if (due <= wheel->tick) {
+		zone->timerslot = ZONEWHEEL_DUE;
+		ISC_LIST_APPEND(wheel->due, zone, timerlink);
+		return 0;
+	}
+
+	delta = due - wheel->tick;
+	if (delta >= ZONEWHEEL_SPAN) {
+		due = wheel->tick + ZONEWHEEL_SPAN - 1;
+		delta = ZONEWHEEL_SPAN - 1;
+	}
+	while (delta > ZONEWHEEL_LEVELMASK(level + 1)) {
+		level++;
+	}
+
+	zone->timerslot = level * ZONEWHEEL_SLOTS +
+			  ((due >> (ZONEWHEEL_BITS * level)) & ZONEWHEEL_MASK);
+	ISC_LIST_APPEND(*zonewheel_list(wheel, zone->timerslot), zone,
+			timerlink);
+
+	return level == 0 ? due : UINT64_MAX;
+}
+
+/*
+ * The first tick after wheel->tick that has zones to run, or that
+ * cascades the upper levels.
+ */
+static uint64_t
+zonewheel_next(zonewheel_t *wheel) {
+	uint64_t tick;
+
+	if (!ISC_LIST_EMPTY(wheel->due)) {
+		return 0;
+	}
+
+	for (tick = wheel->tick + 1; (tick & ZONEWHEEL_MASK) != 0; tick++) {
+		if (!ISC_LIST_EMPTY(wheel->slots[0][tick & ZONEWHEEL_MASK])) {
+			break;
+		}
+	}
+
+	return tick;
+}
+
+static void
+zonewheel_arm(zonewheel_t *wheel, uint64_t tick) {
+	isc_interval_t interval;
+	isc_nanosecs_t now = isc_time_monotonic();
+	uint64_t ms = 0;
+
+	if (tick * NS_PER_SEC > now) {
+		ms = (tick * NS_PER_SEC - now + NS_PER_MS - 1) / NS_PER_MS;
+	}
+
+	isc_interval_set(&interval, ms / 1000, (ms % 1000) * NS_PER_MS);
+	isc_timer_start(wheel->timer, isc_timertype_once, &interval);
+	wheel->wakeup = tick;
+}
+
+static void
+zonewheel_unlink(zonewheel_t *wheel, dns_zone_t *zone) {
+	ISC_LIST_UNLINK(*zonewheel_list(wheel, zone->timerslot), zone,
+			timerlink);
+	atomic_fetch_sub_relaxed(&wheel->count, 1);
+}
+
+static void
+zonewheel_cascade(zonewheel_t *wheel, unsigned int level) {
+	dns_zonelist_t *list = NULL;
+	dns_zone_t *zone = NULL, *next = NULL;
+	unsigned int slot;
+
+	slot = (wheel->tick >> (ZONEWHEEL_BITS * level)) & ZONEWHEEL_MASK;
+	list = &wheel->slots[level][slot];
+	ISC_LIST_FOREACH_SAFE (*list, zone, timerlink, next) {
+		ISC_LIST_UNLINK(*list, zone, timerlink);
+		(void)zonewheel_place(wheel, zone);
+	}
+}
+
+static void
+zonewheel_run(void *arg) {
+	zonewheel_t *wheel = arg;
+	uint64_t nowtick = isc_time_monotonic() / NS_PER_SEC;
+	dns_zone_t *zone = NULL;
+
+	while (wheel->tick < nowtick) {
+		wheel->tick++;
+		for (unsigned int level = 1; level < ZONEWHEEL_LEVELS; level++)
+		{
+			if ((wheel->tick & ZONEWHEEL_LEVELMASK(level)) != 0) {
+				break;
+			}
+			zonewheel_cascade(wheel, level);
+		}
+		ISC_LIST_APPENDLIST(
+			wheel->due,
+			wheel->slots[0][wheel->tick & ZONEWHEEL_MASK],
+			timerlink);
+	}
+
+	ISC_LIST_FOREACH (wheel->due, zone, timerlink) {
+		zone->timerslot = ZONEWHEEL_DUE;
+	}
+
+	while ((zone = ISC_LIST_HEAD(wheel->due)) != NULL) {
+		zonewheel_unlink(wheel, zone);
+		zone_timer(zone);
+	}
+
+	if (atomic_load_relaxed(&wheel->count) == 0) {
+		isc_timer_destroy(&wheel->timer);
+	} else {
+		zonewheel_arm(wheel, zonewheel_next(wheel));
+	}
+}
+
+static zonewheel_t *
+zone_wheel(dns_zone_t *zone) {
+	REQUIRE(zone->tid == isc_tid());
+
+	return &zone->zmgr->wheels[zone->tid];
+}
+
 static void
 zone_timer_stop(dns_zone_t *zone) {
+	zonewheel_t *wheel = NULL;
+
 	zone_debuglog(zone, __func__, 10, "stop zone timer");
-	if (zone->timer != NULL) {
-		isc_timer_stop(zone->timer);
+	if (!ISC_LINK_LINKED(zone, timerlink)) {
+		return;
+	}
+
+	wheel = zone_wheel(zone);
+	zonewheel_unlink(wheel, zone);
+	if (atomic_load_relaxed(&wheel->count) == 0) {
+		isc_timer_destroy(&wheel->timer);
 	}
 }
 
 static void
 zone_timer_set(dns_zone_t *zone, isc_time_t *next, isc_time_t *now) {
+	zonewheel_t *wheel = NULL;
 	isc_interval_t interval;
+	isc_nanosecs_t mono = isc_time_monotonic();
+	uint64_t wakeup;
+
+	if (zone->loop == NULL) {
+		zone_debuglog(zone, __func__, 10, "zone is not managed");
+		return;
+	}
+
+	if (!zone->timerref) {
+		isc_refcount_increment0(&zone->irefs);
+		zone->timerref = true;
+	}
+
+	wheel = zone_wheel(zone);
+	if (ISC_LINK_LINKED(zone, timerlink)) {
+		zonewheel_unlink(wheel, zone);
+	}
+
+	if (wheel->timer == NULL) {
+		isc_timer_create(zone->loop, zonewheel_run, wheel,
+				 &wheel->timer);
+		wheel->tick = mono / NS_PER_SEC;
+		wheel->wakeup = UINT64_MAX;
+	}
 
 	if (isc_time_compare(next, now) <= 0) {
-		isc_interval_set(&interval, 0, 0);
+		zone->timertick = 0;
 	} else {
 		isc_time_subtract(next, now, &interval);
+		mono += (isc_nanosecs_t)isc_interval_ms(&interval) * NS_PER_MS;
+		zone->timertick = (mono + NS_PER_SEC - 1) / NS_PER_SEC;
 	}
 
-	if (zone->loop == NULL) {
-		zone_debuglog(zone, __func__, 10, "zone is not managed");
-	} else if (zone->timer == NULL) {
-		isc_refcount_increment0(&zone->irefs);
-		isc_timer_create(zone->loop, zone_timer, zone, &zone->timer);
+	atomic_fetch_add_relaxed(&wheel->count, 1);
+	wakeup = zonewheel_place(wheel, zone);
+	if (wheel->wakeup == UINT64_MAX) {
+		/* The timer has just been created. */
+		wakeup = zonewheel_next(wheel);
 	}
-	if (zone->timer != NULL) {
-		isc_timer_start(zone->timer, isc_timertype_once, &interval);
+	if (wakeup < wheel->wakeup) {
+		zonewheel_arm(wheel, wakeup);
 	}
 }
 
+static void
+zone_timer_release(dns_zone_t *zone) {
+	zone_timer_stop(zone);
+	zone->timerref = false;
+	isc_refcount_decrement(&zone->irefs);
+}
+
 static void
 zone__settimer(void *arg) {
 	zone_settimer_t *data = arg;
@@ -15241,6 +16718,13 @@ zone__settimer(void *arg) {
 				next = zone->nsec3chaintime;
 			}
 		}
+		if (!isc_time_isepoch(&zone->unloadtime)) {
+			if (isc_time_isepoch(&next) ||
+			    isc_time_compare(&zone->unloadtime, &next) < 0)
+			{
+				next = zone->unloadtime;
+			}
+		}
 		break;
 
 	case dns_zone_secondary:
@@ -15354,6 +16838,7 @@ cancel_refresh(dns_zone_t *zone) {
 
 	ENTER;
 
+	cancel_soaprobes(zone);
 	DNS_ZONE_CLRFLAG(zone, DNS_ZONEFLG_REFRESH);
 	now = isc_time_now();
 	zone_settimer(zone, &now);
@@ -17851,6 +19336,8 @@ zone_replacedb(dns_zone_t *zone, dns_db_t *db, bool dump) {
 			isc_log_write(DNS_LOGCATEGORY_GENERAL,
 				      DNS_LOGMODULE_ZONE, ISC_LOG_DEBUG(3),
 				      "removing journal file");
+			dns_journalindex_reset(zone->journalindex);
+			zone->dumpbase = false;
 			if (remove(zone->journal) < 0 && errno != ENOENT) {
 				char strbuf[ISC_STRERRORSIZE];
 				strerror_r(errno, strbuf, sizeof(strbuf));
@@ -17879,6 +19366,8 @@ zone_replacedb(dns_zone_t *zone, dns_db_t *db, bool dump) {
 	dns_db_setloop(zone->db, zone->loop);
 	dns_db_setmaxrrperset(zone->db, zone->maxrrperset);
 	dns_db_setmaxtypepername(zone->db, zone->maxtypepername);
+	dns_db_setshareslabs(zone->db,
+			     DNS_ZONE_OPTION(zone, DNS_ZONEOPT_SHARERRSETS));
 	DNS_ZONE_SETFLAG(zone, DNS_ZONEFLG_LOADED | DNS_ZONEFLG_NEEDNOTIFY);
 	return ISC_R_SUCCESS;
 
@@ -19193,12 +20682,31 @@ dns_zonemgr_create(isc_mem_t *mctx, isc_nm_t *netmgr, dns_zonemgr_t **zmgrp) {
 	/* Unreachable lock. */
 	isc_rwlock_init(&zmgr->urlock);
 
+	isc_mutex_init(&zmgr->loadlock);
+	isc_mutex_init(&zmgr->synclock);
+	ISC_LIST_INIT(zmgr->syncpending);
+	ISC_LIST_INIT(zmgr->syncbatch);
+
 	isc_ratelimiter_create(loop, &zmgr->checkdsrl);
 	isc_ratelimiter_create(loop, &zmgr->notifyrl);
 	isc_ratelimiter_create(loop, &zmgr->refreshrl);
 	isc_ratelimiter_create(loop, &zmgr->startupnotifyrl);
 	isc_ratelimiter_create(loop, &zmgr->startuprefreshrl);
 
+	zmgr->wheels = isc_mem_cget(zmgr->mctx, zmgr->workers,
+				    sizeof(zmgr->wheels[0]));
+	for (size_t i = 0; i < zmgr->workers; i++) {
+		zonewheel_t *wheel = &zmgr->wheels[i];
+
+		atomic_init(&wheel->count, 0);
+		ISC_LIST_INIT(wheel->due);
+		for (size_t l = 0; l < ZONEWHEEL_LEVELS; l++) {
+			for (size_t s = 0; s < ZONEWHEEL_SLOTS; s++) {
+				ISC_LIST_INIT(wheel->slots[l][s]);
+			}
+		}
+	}
+
 	zmgr->mctxpool = isc_mem_cget(zmgr->mctx, zmgr->workers,
 				      sizeof(zmgr->mctxpool[0]));
 	for (size_t i = 0; i < zmgr->workers; i++) {
@@ -19217,6 +20725,9 @@ dns_zonemgr_create(isc_mem_t *mctx, isc_nm_t *netmgr, dns_zonemgr_t **zmgrp) {
 	setrl(zmgr->startuprefreshrl, &zmgr->startupserialqueryrate, 20);
 	isc_ratelimiter_setpushpop(zmgr->startupnotifyrl, true);
 	isc_ratelimiter_setpushpop(zmgr->startuprefreshrl, true);
+	isc_ratelimiter_setburst(zmgr->notifyrl, PEER_BURST);
+	isc_ratelimiter_setburst(zmgr->startupnotifyrl, PEER_BURST);
+	isc_ratelimiter_setburst(zmgr->refreshrl, PEER_BURST);
 
 	zmgr->tlsctx_cache = NULL;
 	isc_rwlock_init(&zmgr->tlsctx_cache_rwlock);
@@ -19260,7 +20771,7 @@ dns_zonemgr_managezone(dns_zonemgr_t *zmgr, dns_zone_t *zone) {
 
 	RWLOCK(&zmgr->rwlock, isc_rwlocktype_write);
 	LOCK_ZONE(zone);
-	REQUIRE(zone->timer == NULL);
+	REQUIRE(!zone->timerref);
 	REQUIRE(zone->zmgr == NULL);
 
 	isc_loop_t *loop = isc_loop_get(zmgr->loopmgr, zone->tid);
@@ -19295,11 +20806,13 @@ dns_zonemgr_releasezone(dns_zonemgr_t *zmgr, dns_zone_t *zone) {
 		ENSURE(zone->kfio == NULL);
 	}
 
-	if (zone->timer != NULL) {
-		isc_refcount_decrement(&zone->irefs);
-		isc_timer_destroy(&zone->timer);
+	if (zone->timerref) {
+		zone_timer_release(zone);
 	}
 
+	zone_loadfinished(zone);
+	zone_demandwake(zone);
+
 	isc_loop_detach(&zone->loop);
 
 	/* Detach below, outside of the write lock. */
@@ -19407,6 +20920,17 @@ zonemgr_free(dns_zonemgr_t *zmgr) {
 	isc_mem_cput(zmgr->mctx, zmgr->mctxpool, zmgr->workers,
 		     sizeof(zmgr->mctxpool[0]));
 
+	for (size_t i = 0; i < zmgr->workers; i++) {
+		INSIST(atomic_load_relaxed(&zmgr->wheels[i].count) == 0);
+		INSIST(zmgr->wheels[i].timer == NULL);
+	}
+	isc_mem_cput(zmgr->mctx, zmgr->wheels, zmgr->workers,
+		     sizeof(zmgr->wheels[0]));
+
+	INSIST(!zmgr->syncrunning);
+	INSIST(ISC_LIST_EMPTY(zmgr->syncpending));
+	isc_mutex_destroy(&zmgr->synclock);
+	isc_mutex_destroy(&zmgr->loadlock);
 	isc_rwlock_destroy(&zmgr->urlock);
 	isc_rwlock_destroy(&zmgr->rwlock);
 	isc_rwlock_destroy(&zmgr->tlsctx_cache_rwlock);
@@ -20072,6 +21596,11 @@ dns_zonemgr_getcount(dns_zonemgr_t *zmgr, dns_zonestate_t state) {
 			}
 		}
 		break;
+	case DNS_ZONESTATE_SCHEDULED:
+		for (size_t i = 0; i < zmgr->workers; i++) {
+			count += atomic_load_relaxed(&zmgr->wheels[i].count);
+		}
+		break;
 	default:
 		UNREACHABLE();
 	}
@@ -20081,6 +21610,48 @@ dns_zonemgr_getcount(dns_zonemgr_t *zmgr, dns_zonestate_t state) {
 	return count;
 }
 
+bool
+dns_zonemgr_getloadprogress(dns_zonemgr_t *zmgr, unsigned int *pendingp,
+			    isc_nanosecs_t *elapsedp,
+			    isc_nanosecs_t *expectedp) {
+	isc_nanosecs_t now = isc_time_monotonic();
+	isc_nanosecs_t elapsed = 0, expected = 0;
+	unsigned int pending;
+	bool started;
+
+	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
+	REQUIRE(pendingp != NULL);
+	REQUIRE(elapsedp != NULL);
+	REQUIRE(expectedp != NULL);
+
+	LOCK(&zmgr->loadlock);
+	started = (zmgr->loadstart != 0);
+	pending = zmgr->loadspending;
+	if (started && pending == 0) {
+		elapsed = zmgr->loadend - zmgr->loadstart;
+		expected = elapsed;
+	} else if (started) {
+		elapsed = now - zmgr->loadstart;
+		if (zmgr->loadedbytes > 0) {
+			/*
+			 * Loads run in parallel on the offload threads, so
+			 * the bytes loaded so far are a fair measure of the
+			 * throughput for the rest of the round.
+			 */
+			expected = (isc_nanosecs_t)((double)elapsed *
+						    (double)zmgr->loadbytes /
+						    (double)zmgr->loadedbytes);
+		}
+	}
+	UNLOCK(&zmgr->loadlock);
+
+	*pendingp = pending;
+	*elapsedp = elapsed;
+	*expectedp = expected;
+
+	return started;
+}
+
 isc_result_t
 dns_zone_getxfr(dns_zone_t *zone, dns_xfrin_t **xfrp, bool *is_firstrefresh,
 		bool *is_running, bool *is_deferred, bool *is_presoa,
@@ -23341,6 +24912,28 @@ dns_zone_getadded(dns_zone_t *zone) {
 	return zone->added;
 }
 
+void
+dns_zone_setconfighash(dns_zone_t *zone, uint64_t hash) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	LOCK_ZONE(zone);
+	zone->confighash = hash;
+	UNLOCK_ZONE(zone);
+}
+
+uint64_t
+dns_zone_getconfighash(dns_zone_t *zone) {
+	uint64_t hash;
+
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	LOCK_ZONE(zone);
+	hash = zone->confighash;
+	UNLOCK_ZONE(zone);
+
+	return hash;
+}
+
 isc_result_t
 dns_zone_dlzpostload(dns_zone_t *zone, dns_db_t *db) {
 	isc_time_t loadtime;
@@ -23428,6 +25021,12 @@ dns_zone_getixfrratio(dns_zone_t *zone) {
 	return zone->ixfr_ratio;
 }
 
+void
+dns_zone_setdumpratio(dns_zone_t *zone, uint32_t ratio) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+	zone->dumpratio = ratio;
+}
+
 void
 dns_zone_setrequestexpire(dns_zone_t *zone, bool flag) {
 	REQUIRE(DNS_ZONE_VALID(zone));
@@ -24341,6 +25940,44 @@ failure:
 	return result;
 }
 
+isc_result_t
+dns_zone_nsec3chainprogress(dns_zone_t *zone,
+			    const dns_rdata_nsec3param_t *nsec3param,
+			    uint64_t *nodesp, uint64_t *totalp,
+			    isc_stdtime_t *startedp) {
+	isc_result_t result = ISC_R_NOTFOUND;
+	dns_nsec3chain_t *nsec3chain = NULL;
+
+	REQUIRE(DNS_ZONE_VALID(zone));
+	REQUIRE(nsec3param != NULL);
+	REQUIRE(nodesp != NULL && totalp != NULL && startedp != NULL);
+
+	LOCK_ZONE(zone);
+	for (nsec3chain = ISC_LIST_HEAD(zone->nsec3chain); nsec3chain != NULL;
+	     nsec3chain = ISC_LIST_NEXT(nsec3chain, link))
+	{
+		if (!nsec3chain->done &&
+		    !NSEC3REMOVE(nsec3chain->nsec3param.flags) &&
+		    nsec3chain->nsec3param.hash == nsec3param->hash &&
+		    nsec3chain->nsec3param.iterations ==
+			    nsec3param->iterations &&
+		    nsec3chain->nsec3param.salt_length ==
+			    nsec3param->salt_length &&
+		    memcmp(nsec3chain->nsec3param.salt, nsec3param->salt,
+			   nsec3param->salt_length) == 0)
+		{
+			*nodesp = nsec3chain->nodes;
+			*totalp = nsec3chain->total;
+			*startedp = nsec3chain->started;
+			result = ISC_R_SUCCESS;
+			break;
+		}
+	}
+	UNLOCK_ZONE(zone);
+
+	return result;
+}
+
 isc_result_t
 dns_zone_getloadtime(dns_zone_t *zone, isc_time_t *loadtime) {
 	REQUIRE(DNS_ZONE_VALID(zone));
@@ -24718,6 +26355,7 @@ dns_zone_makedb(dns_zone_t *zone, dns_db_t **dbp) {
 	dns_db_setloop(db, zone->loop);
 	dns_db_setmaxrrperset(db, zone->maxrrperset);
 	dns_db_setmaxtypepername(db, zone->maxtypepername);
+	dns_db_setshareslabs(db, DNS_ZONE_OPTION(zone, DNS_ZONEOPT_SHARERRSETS));
 
 	*dbp = db;
 
@@ -19,14 +19,17 @@
 #include <stdio.h>
 #include <string.h>
 
+#include <isc/atomic.h>
 #include <isc/base32.h>
 #include <isc/buffer.h>
 #include <isc/heap.h>
 #include <isc/iterated_hash.h>
 #include <isc/log.h>
 #include <isc/mem.h>
+#include <isc/os.h>
 #include <isc/region.h>
 #include <isc/result.h>
+#include <isc/thread.h>
 #include <isc/types.h>
 #include <isc/util.h>
 
@@ -1688,56 +1691,190 @@ determine_active_algorithms(vctx_t *vctx, bool ignore_kskflag,
 }
 
 /*%
- * Check that all the records not yet verified were signed by keys that are
- * present in the DNSKEY RRset.
+ * The nodes are verified on up to VERIFY_THREADS threads.  Each tree of
+ * the database is split into shards of at least VERIFY_SHARDNODES nodes,
+ * which are verified with their own copy of the verification context, see
+ * verify_nodes().
+ */
+#define VERIFY_THREADS	  8
+#define VERIFY_SHARDNODES 4096
+
+typedef struct vshard {
+	vctx_t vctx;
+	bool nsec3;	      /*%< walking the NSEC3 tree */
+	dns_fixedname_t fstart;
+	dns_name_t *start;    /*%< NULL to start with the first node */
+	dns_name_t *end;      /*%< NULL to stop after the last node */
+	dns_fixedname_t flast;
+	dns_name_t *last;     /*%< the last node verified */
+	bool startdelegation; /*%< the first node is a delegation */
+	isc_result_t result;
+	isc_result_t vresult;
+} vshard_t;
+
+typedef struct vwork {
+	vshard_t *shards;
+	unsigned int nshards;
+	atomic_uint_fast32_t next;
+} vwork_t;
+
+/*%
+ * Return true if 'name' is below a zone cut or a DNAME.
+ */
+static bool
+is_occluded(const vctx_t *vctx, const dns_name_t *name) {
+	unsigned int labels = dns_name_countlabels(name);
+	dns_name_t suffix;
+
+	dns_name_init(&suffix, NULL);
+	for (unsigned int i = dns_name_countlabels(vctx->origin); i < labels;
+	     i++)
+	{
+		dns_dbnode_t *node = NULL;
+		bool cut;
+
+		dns_name_getlabelsequence(name, labels - i, i, &suffix);
+		if (dns_db_findnode(vctx->db, &suffix, false, &node) !=
+		    ISC_R_SUCCESS)
+		{
+			continue;
+		}
+		cut = is_delegation(vctx, &suffix, node, NULL) ||
+		      has_dname(vctx, node);
+		dns_db_detachnode(vctx->db, &node);
+		if (cut) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*%
+ * Split the tree walked with the iterator 'options' into up to 'maxshards'
+ * shards of about the same number of nodes.  verify_range() checks each
+ * node against the next one in the NSEC chain, so in the normal tree a
+ * shard can only start at a node it would not skip: a non-empty node in
+ * the zone that is not below a zone cut.
  */
 static isc_result_t
-verify_nodes(vctx_t *vctx, isc_result_t *vresult) {
-	dns_fixedname_t fname, fnextname, fprevname, fzonecut;
+split_tree(const vctx_t *vctx, unsigned int options, vshard_t *shards,
+	   unsigned int maxshards, unsigned int *nshardsp) {
+	dns_fixedname_t fname;
+	dns_name_t *name = dns_fixedname_initname(&fname);
+	dns_dbiterator_t *dbiter = NULL;
+	uint64_t count = 0, pos = 0;
+	unsigned int nshards, n = 1;
+	isc_result_t result;
+
+	result = dns_db_createiterator(vctx->db, options, &dbiter);
+	if (result != ISC_R_SUCCESS) {
+		zoneverify_log_error(vctx, "dns_db_createiterator(): %s",
+				     isc_result_totext(result));
+		return result;
+	}
+
+	for (result = dns_dbiterator_first(dbiter); result == ISC_R_SUCCESS;
+	     result = dns_dbiterator_next(dbiter))
+	{
+		count++;
+	}
+
+	nshards = ISC_MAX(ISC_MIN(maxshards, count / VERIFY_SHARDNODES), 1);
+
+	for (result = dns_dbiterator_first(dbiter);
+	     result == ISC_R_SUCCESS && n < nshards;
+	     result = dns_dbiterator_next(dbiter), pos++)
+	{
+		dns_dbnode_t *node = NULL;
+		bool boundary = true;
+
+		if (pos < n * count / nshards) {
+			continue;
+		}
+
+		result = dns_dbiterator_current(dbiter, &node, name);
+		if (result != ISC_R_SUCCESS && result != DNS_R_NEWORIGIN) {
+			break;
+		}
+		if (options == DNS_DB_NONSEC3) {
+			RUNTIME_CHECK(dns_dbiterator_pause(dbiter) ==
+				      ISC_R_SUCCESS);
+			boundary = dns_name_issubdomain(name, vctx->origin) &&
+				   is_empty(vctx, node) == ISC_R_SUCCESS &&
+				   !is_occluded(vctx, name);
+		}
+		dns_db_detachnode(vctx->db, &node);
+		if (boundary) {
+			shards[n].start = dns_fixedname_initname(
+				&shards[n].fstart);
+			dns_name_copy(name, shards[n].start);
+			n++;
+		}
+	}
+	dns_dbiterator_destroy(&dbiter);
+
+	if (result != ISC_R_SUCCESS && result != ISC_R_NOMORE) {
+		zoneverify_log_error(vctx,
+				     "iterating through the database "
+				     "failed: %s",
+				     isc_result_totext(result));
+		return result;
+	}
+
+	for (unsigned int i = 0; i < n; i++) {
+		shards[i].nsec3 = (options == DNS_DB_NSEC3ONLY);
+		shards[i].end = (i + 1 < n) ? shards[i + 1].start : NULL;
+	}
+	*nshardsp = n;
+
+	return ISC_R_SUCCESS;
+}
+
+/*%
+ * Verify the nodes of the normal tree from 'shard->start' up to, but not
+ * including, 'shard->end'.
+ */
+static isc_result_t
+verify_range(vshard_t *shard, dst_key_t **dstkeys, size_t nkeys) {
+	vctx_t *vctx = &shard->vctx;
+	dns_fixedname_t fname, fnextname, fzonecut;
 	dns_name_t *name, *nextname, *prevname, *zonecut;
 	dns_dbnode_t *node = NULL, *nextnode;
 	dns_dbiterator_t *dbiter = NULL;
-	dst_key_t **dstkeys;
-	size_t count, nkeys = 0;
 	bool done = false;
 	isc_result_t tvresult = ISC_R_UNSET;
 	isc_result_t result;
 
 	name = dns_fixedname_initname(&fname);
 	nextname = dns_fixedname_initname(&fnextname);
-	dns_fixedname_init(&fprevname);
+	dns_fixedname_init(&shard->flast);
 	prevname = NULL;
 	dns_fixedname_init(&fzonecut);
 	zonecut = NULL;
 
-	count = dns_rdataset_count(&vctx->keyset);
-	dstkeys = isc_mem_cget(vctx->mctx, count, sizeof(*dstkeys));
-
-	for (result = dns_rdataset_first(&vctx->keyset);
-	     result == ISC_R_SUCCESS; result = dns_rdataset_next(&vctx->keyset))
-	{
-		dns_rdata_t rdata = DNS_RDATA_INIT;
-		dns_rdataset_current(&vctx->keyset, &rdata);
-		dstkeys[nkeys] = NULL;
-		result = dns_dnssec_keyfromrdata(vctx->origin, &rdata,
-						 vctx->mctx, &dstkeys[nkeys]);
-		if (result == ISC_R_SUCCESS) {
-			nkeys++;
-		}
-	}
-
 	result = dns_db_createiterator(vctx->db, DNS_DB_NONSEC3, &dbiter);
 	if (result != ISC_R_SUCCESS) {
 		zoneverify_log_error(vctx, "dns_db_createiterator(): %s",
 				     isc_result_totext(result));
-		goto done;
+		return result;
 	}
 
-	result = dns_dbiterator_first(dbiter);
-	if (result != ISC_R_SUCCESS) {
-		zoneverify_log_error(vctx, "dns_dbiterator_first(): %s",
-				     isc_result_totext(result));
-		goto done;
+	if (shard->start != NULL) {
+		result = dns_dbiterator_seek(dbiter, shard->start);
+		if (result != ISC_R_SUCCESS) {
+			zoneverify_log_error(vctx, "dns_dbiterator_seek(): %s",
+					     isc_result_totext(result));
+			goto done;
+		}
+	} else {
+		result = dns_dbiterator_first(dbiter);
+		if (result != ISC_R_SUCCESS) {
+			zoneverify_log_error(vctx,
+					     "dns_dbiterator_first(): %s",
+					     isc_result_totext(result));
+			goto done;
+		}
 	}
 
 	while (!done) {
@@ -1830,6 +1967,11 @@ verify_nodes(vctx_t *vctx, isc_result_t *vresult) {
 					     isc_result_totext(result));
 			dns_db_detachnode(vctx->db, &node);
 			goto done;
+		} else if (shard->end != NULL &&
+			   dns_name_equal(nextname, shard->end))
+		{
+			/* The next shard starts with the next node */
+			done = true;
 		}
 		result = verifynode(vctx, name, node, isdelegation, dstkeys,
 				    nkeys, &vctx->nsecset, &vctx->nsec3paramset,
@@ -1838,11 +1980,11 @@ verify_nodes(vctx_t *vctx, isc_result_t *vresult) {
 			dns_db_detachnode(vctx->db, &node);
 			goto done;
 		}
-		if (*vresult == ISC_R_UNSET) {
-			*vresult = ISC_R_SUCCESS;
+		if (shard->vresult == ISC_R_UNSET) {
+			shard->vresult = ISC_R_SUCCESS;
 		}
-		if (*vresult == ISC_R_SUCCESS) {
-			*vresult = tvresult;
+		if (shard->vresult == ISC_R_SUCCESS) {
+			shard->vresult = tvresult;
 		}
 		if (prevname != NULL) {
 			result = verifyemptynodes(
@@ -1853,17 +1995,38 @@ verify_nodes(vctx_t *vctx, isc_result_t *vresult) {
 				goto done;
 			}
 		} else {
-			prevname = dns_fixedname_name(&fprevname);
+			prevname = dns_fixedname_name(&shard->flast);
+			shard->startdelegation = isdelegation;
 		}
 		dns_name_copy(name, prevname);
-		if (*vresult == ISC_R_SUCCESS) {
-			*vresult = tvresult;
+		if (shard->vresult == ISC_R_SUCCESS) {
+			shard->vresult = tvresult;
 		}
 		dns_db_detachnode(vctx->db, &node);
 	}
 
+	shard->last = prevname;
+	result = ISC_R_SUCCESS;
+
+done:
 	dns_dbiterator_destroy(&dbiter);
 
+	return result;
+}
+
+/*%
+ * Verify the NSEC3 records from 'shard->start' up to, but not including,
+ * 'shard->end'.
+ */
+static isc_result_t
+verify_nsec3_range(vshard_t *shard, dst_key_t **dstkeys, size_t nkeys) {
+	vctx_t *vctx = &shard->vctx;
+	dns_fixedname_t fname;
+	dns_name_t *name = dns_fixedname_initname(&fname);
+	dns_dbnode_t *node = NULL;
+	dns_dbiterator_t *dbiter = NULL;
+	isc_result_t result;
+
 	result = dns_db_createiterator(vctx->db, DNS_DB_NSEC3ONLY, &dbiter);
 	if (result != ISC_R_SUCCESS) {
 		zoneverify_log_error(vctx, "dns_db_createiterator(): %s",
@@ -1871,8 +2034,10 @@ verify_nodes(vctx_t *vctx, isc_result_t *vresult) {
 		return result;
 	}
 
-	for (result = dns_dbiterator_first(dbiter); result == ISC_R_SUCCESS;
-	     result = dns_dbiterator_next(dbiter))
+	for (result = (shard->start != NULL)
+			      ? dns_dbiterator_seek(dbiter, shard->start)
+			      : dns_dbiterator_first(dbiter);
+	     result == ISC_R_SUCCESS; result = dns_dbiterator_next(dbiter))
 	{
 		result = dns_dbiterator_current(dbiter, &node, name);
 		if (result != ISC_R_SUCCESS && result != DNS_R_NEWORIGIN) {
@@ -1881,6 +2046,10 @@ verify_nodes(vctx_t *vctx, isc_result_t *vresult) {
 					     isc_result_totext(result));
 			goto done;
 		}
+		if (shard->end != NULL && dns_name_equal(name, shard->end)) {
+			dns_db_detachnode(vctx->db, &node);
+			break;
+		}
 		result = verifynode(vctx, name, node, false, dstkeys, nkeys,
 				    NULL, NULL, NULL, NULL);
 		if (result != ISC_R_SUCCESS) {
@@ -1899,13 +2068,191 @@ verify_nodes(vctx_t *vctx, isc_result_t *vresult) {
 	result = ISC_R_SUCCESS;
 
 done:
+	dns_dbiterator_destroy(&dbiter);
+
+	return result;
+}
+
+static void
+verify_shard(vshard_t *shard) {
+	vctx_t *vctx = &shard->vctx;
+	dst_key_t **dstkeys;
+	size_t count, nkeys = 0;
+	isc_result_t result;
+
+	count = dns_rdataset_count(&vctx->keyset);
+	dstkeys = isc_mem_cget(vctx->mctx, count, sizeof(*dstkeys));
+
+	for (result = dns_rdataset_first(&vctx->keyset);
+	     result == ISC_R_SUCCESS; result = dns_rdataset_next(&vctx->keyset))
+	{
+		dns_rdata_t rdata = DNS_RDATA_INIT;
+		dns_rdataset_current(&vctx->keyset, &rdata);
+		dstkeys[nkeys] = NULL;
+		result = dns_dnssec_keyfromrdata(vctx->origin, &rdata,
+						 vctx->mctx, &dstkeys[nkeys]);
+		if (result == ISC_R_SUCCESS) {
+			nkeys++;
+		}
+	}
+
+	if (shard->nsec3) {
+		shard->result = verify_nsec3_range(shard, dstkeys, nkeys);
+	} else {
+		shard->result = verify_range(shard, dstkeys, nkeys);
+	}
+
 	while (nkeys-- > 0U) {
 		dst_key_free(&dstkeys[nkeys]);
 	}
 	isc_mem_cput(vctx->mctx, dstkeys, count, sizeof(*dstkeys));
-	if (dbiter != NULL) {
-		dns_dbiterator_destroy(&dbiter);
+}
+
+static void *
+verify_thread(void *arg) {
+	vwork_t *work = arg;
+	uint_fast32_t i;
+
+	while ((i = atomic_fetch_add_relaxed(&work->next, 1)) < work->nshards)
+	{
+		verify_shard(&work->shards[i]);
+	}
+
+	return NULL;
+}
+
+/*%
+ * Give 'shard' its own copy of the parts of 'vctx' that change while the
+ * nodes are verified: the rdatasets that are iterated over, the found and
+ * expected NSEC3 chains and the algorithms missing signatures.
+ */
+static void
+shard_init(vctx_t *vctx, vshard_t *shard) {
+	vctx_init(&shard->vctx, vctx->mctx, vctx->zone, vctx->db, vctx->ver,
+		  vctx->origin, vctx->secroots);
+	memmove(shard->vctx.act_algorithms, vctx->act_algorithms,
+		sizeof(vctx->act_algorithms));
+	dns_rdataset_clone(&vctx->keyset, &shard->vctx.keyset);
+	if (dns_rdataset_isassociated(&vctx->nsecset)) {
+		dns_rdataset_clone(&vctx->nsecset, &shard->vctx.nsecset);
+	}
+	if (dns_rdataset_isassociated(&vctx->nsec3paramset)) {
+		dns_rdataset_clone(&vctx->nsec3paramset,
+				   &shard->vctx.nsec3paramset);
+	}
+	shard->result = ISC_R_UNSET;
+	shard->vresult = ISC_R_UNSET;
+}
+
+static void
+move_chains(isc_heap_t *from, isc_heap_t *to) {
+	void *element = NULL;
+
+	while ((element = isc_heap_element(from, 1)) != NULL) {
+		isc_heap_delete(from, 1);
+		isc_heap_insert(to, element);
+	}
+}
+
+/*%
+ * Check that all the records not yet verified were signed by keys that are
+ * present in the DNSKEY RRset.
+ *
+ * The shards are verified independently; the NSEC chain is checked across
+ * the shard boundaries by verify_range(), which checks the last node of a
+ * shard against the first node of the next one, and the empty
+ * non-terminals between two shards are checked here afterwards.
+ */
+static isc_result_t
+verify_nodes(vctx_t *vctx, isc_result_t *vresult) {
+	unsigned int maxshards = ISC_MIN(isc_os_ncpus(), VERIFY_THREADS);
+	vwork_t work = { 0 };
+	unsigned int nnodes = 0, nnsec3 = 0, nthreads;
+	isc_thread_t *threads = NULL;
+	isc_result_t tvresult = ISC_R_UNSET;
+	isc_result_t result;
+
+	work.shards = isc_mem_cget(vctx->mctx, 2 * maxshards,
+				   sizeof(work.shards[0]));
+
+	result = split_tree(vctx, DNS_DB_NONSEC3, work.shards, maxshards,
+			    &nnodes);
+	if (result != ISC_R_SUCCESS) {
+		goto free;
+	}
+	result = split_tree(vctx, DNS_DB_NSEC3ONLY, work.shards + nnodes,
+			    maxshards, &nnsec3);
+	if (result != ISC_R_SUCCESS) {
+		goto free;
 	}
+	work.nshards = nnodes + nnsec3;
+
+	for (unsigned int i = 0; i < work.nshards; i++) {
+		shard_init(vctx, &work.shards[i]);
+	}
+
+	nthreads = ISC_MIN(work.nshards, maxshards);
+	if (nthreads > 1) {
+		threads = isc_mem_cget(vctx->mctx, nthreads,
+				       sizeof(threads[0]));
+		for (unsigned int i = 0; i < nthreads; i++) {
+			isc_thread_create(verify_thread, &work, &threads[i]);
+		}
+		for (unsigned int i = 0; i < nthreads; i++) {
+			isc_thread_join(threads[i], NULL);
+		}
+		isc_mem_cput(vctx->mctx, threads, nthreads,
+			     sizeof(threads[0]));
+	} else {
+		verify_thread(&work);
+	}
+
+	for (unsigned int i = 0; i < work.nshards; i++) {
+		vshard_t *shard = &work.shards[i];
+
+		if (result == ISC_R_SUCCESS) {
+			result = shard->result;
+		}
+		if (shard->vresult != ISC_R_UNSET &&
+		    (*vresult == ISC_R_UNSET || *vresult == ISC_R_SUCCESS))
+		{
+			*vresult = shard->vresult;
+		}
+		for (size_t j = 0; j < ARRAY_SIZE(vctx->bad_algorithms); j++) {
+			vctx->bad_algorithms[j] |=
+				shard->vctx.bad_algorithms[j];
+		}
+		move_chains(shard->vctx.expected_chains,
+			    vctx->expected_chains);
+		move_chains(shard->vctx.found_chains, vctx->found_chains);
+	}
+
+	/*
+	 * Check the empty non-terminals between the last node of each
+	 * shard of the normal tree and the first node of the next one.
+	 */
+	for (unsigned int i = 1; i < nnodes && result == ISC_R_SUCCESS; i++) {
+		vshard_t *prev = &work.shards[i - 1];
+		vshard_t *shard = &work.shards[i];
+
+		if (prev->last == NULL) {
+			continue;
+		}
+		result = verifyemptynodes(vctx, shard->start, prev->last,
+					  shard->startdelegation,
+					  &vctx->nsec3paramset, &tvresult);
+		if (result == ISC_R_SUCCESS && *vresult == ISC_R_SUCCESS) {
+			*vresult = tvresult;
+		}
+	}
+
+	for (unsigned int i = 0; i < work.nshards; i++) {
+		vctx_destroy(&work.shards[i].vctx);
+	}
+
+free:
+	isc_mem_cput(vctx->mctx, work.shards, 2 * maxshards,
+		     sizeof(work.shards[0]));
 
 	return result;
 }
@@ -15,6 +15,7 @@
 
 #include <inttypes.h>
 #include <stdbool.h>
+#include <stdlib.h>
 
 #include <isc/atomic.h>
 #include <isc/file.h>
@@ -41,6 +42,9 @@ struct dns_zt {
 	isc_mem_t *mctx;
 	dns_qpmulti_t *multi;
 
+	/* The open bulk update; only used by the thread in 'bulkzt' */
+	dns_qp_t *bulk;
+
 	atomic_bool flush;
 	isc_refcount_t references;
 	isc_refcount_t loads_pending;
@@ -53,6 +57,16 @@ struct zt_load_params {
 	bool newonly;
 };
 
+struct zt_load_plan {
+	isc_mem_t *mctx;
+	struct zt_load_entry {
+		dns_zone_t *zone;
+		uint64_t size;
+	} *entries;
+	size_t count;
+	size_t alloc;
+};
+
 struct zt_freeze_params {
 	dns_view_t *view;
 	bool freeze;
@@ -93,6 +107,14 @@ static dns_qpmethods_t ztqpmethods = {
 	ztqptriename,
 };
 
+/*
+ * The zone table that the current thread has a bulk update open on.
+ * The other threads don't look at the open transaction: they keep
+ * reading the last committed version, and their updates wait for the
+ * bulk update to be committed.
+ */
+static thread_local dns_zt_t *bulkzt = NULL;
+
 void
 dns_zt_create(isc_mem_t *mctx, dns_view_t *view, dns_zt_t **ztp) {
 	dns_qpmulti_t *multi = NULL;
@@ -133,6 +155,48 @@ dns_zt_compact(dns_zt_t *zt) {
 	dns_qpmulti_commit(zt->multi, &qp);
 }
 
+void
+dns_zt_beginbulk(dns_zt_t *zt) {
+	REQUIRE(VALID_ZT(zt));
+	REQUIRE(bulkzt == NULL);
+
+	dns_qpmulti_write(zt->multi, &zt->bulk);
+	bulkzt = zt;
+}
+
+void
+dns_zt_endbulk(dns_zt_t *zt) {
+	REQUIRE(VALID_ZT(zt));
+	REQUIRE(bulkzt == zt);
+
+	bulkzt = NULL;
+	dns_qp_compact(zt->bulk, DNS_QPGC_MAYBE);
+	dns_qpmulti_commit(zt->multi, &zt->bulk);
+}
+
+static dns_qp_t *
+zt_write(dns_zt_t *zt) {
+	dns_qp_t *qp = NULL;
+
+	if (bulkzt == zt) {
+		return zt->bulk;
+	}
+
+	dns_qpmulti_write(zt->multi, &qp);
+	return qp;
+}
+
+static void
+zt_commit(dns_zt_t *zt, dns_qp_t *qp) {
+	if (bulkzt == zt) {
+		/* Committed by dns_zt_endbulk() */
+		return;
+	}
+
+	dns_qp_compact(qp, DNS_QPGC_MAYBE);
+	dns_qpmulti_commit(zt->multi, &qp);
+}
+
 isc_result_t
 dns_zt_mount(dns_zt_t *zt, dns_zone_t *zone) {
 	isc_result_t result;
@@ -140,10 +204,9 @@ dns_zt_mount(dns_zt_t *zt, dns_zone_t *zone) {
 
 	REQUIRE(VALID_ZT(zt));
 
-	dns_qpmulti_write(zt->multi, &qp);
+	qp = zt_write(zt);
 	result = dns_qp_insert(qp, zone, 0);
-	dns_qp_compact(qp, DNS_QPGC_MAYBE);
-	dns_qpmulti_commit(zt->multi, &qp);
+	zt_commit(zt, qp);
 
 	return result;
 }
@@ -155,10 +218,9 @@ dns_zt_unmount(dns_zt_t *zt, dns_zone_t *zone) {
 
 	REQUIRE(VALID_ZT(zt));
 
-	dns_qpmulti_write(zt->multi, &qp);
+	qp = zt_write(zt);
 	result = dns_qp_deletename(qp, dns_zone_getorigin(zone), NULL, NULL);
-	dns_qp_compact(qp, DNS_QPGC_MAYBE);
-	dns_qpmulti_commit(zt->multi, &qp);
+	zt_commit(zt, qp);
 
 	return result;
 }
@@ -168,6 +230,7 @@ dns_zt_find(dns_zt_t *zt, const dns_name_t *name, dns_ztfind_t options,
 	    dns_zone_t **zonep) {
 	isc_result_t result;
 	dns_qpread_t qpr;
+	dns_qpreadable_t reader = { .qpr = &qpr };
 	void *pval = NULL;
 	dns_ztfind_t exactmask = DNS_ZTFIND_NOEXACT | DNS_ZTFIND_EXACT;
 	dns_ztfind_t exactopts = options & exactmask;
@@ -176,12 +239,17 @@ dns_zt_find(dns_zt_t *zt, const dns_name_t *name, dns_ztfind_t options,
 	REQUIRE(VALID_ZT(zt));
 	REQUIRE(exactopts != exactmask);
 
-	dns_qpmulti_query(zt->multi, &qpr);
+	/* A bulk update sees its own changes */
+	if (bulkzt == zt) {
+		reader = (dns_qpreadable_t){ .qpt = zt->bulk };
+	} else {
+		dns_qpmulti_query(zt->multi, &qpr);
+	}
 
 	if (exactopts == DNS_ZTFIND_EXACT) {
-		result = dns_qp_getname(&qpr, name, &pval, NULL);
+		result = dns_qp_getname(reader, name, &pval, NULL);
 	} else {
-		result = dns_qp_lookup(&qpr, name, NULL, NULL, &chain, &pval,
+		result = dns_qp_lookup(reader, name, NULL, NULL, &chain, &pval,
 				       NULL);
 		if (exactopts == DNS_ZTFIND_NOEXACT && result == ISC_R_SUCCESS)
 		{
@@ -196,7 +264,9 @@ dns_zt_find(dns_zt_t *zt, const dns_name_t *name, dns_ztfind_t options,
 			}
 		}
 	}
-	dns_qpread_destroy(zt->multi, &qpr);
+	if (reader.qpr == &qpr) {
+		dns_qpread_destroy(zt->multi, &qpr);
+	}
 
 	if (result == ISC_R_SUCCESS || result == DNS_R_PARTIALMATCH) {
 		dns_zone_t *zone = pval;
@@ -255,6 +325,7 @@ zt_destroy(dns_zt_t *zt) {
 		(void)dns_zt_apply(zt, false, NULL, flush, NULL);
 	}
 
+	INSIST(zt->bulk == NULL);
 	dns_qpmulti_destroy(&zt->multi);
 	zt->magic = 0;
 	isc_mem_putanddetach(&zt->mctx, zt, sizeof(*zt));
@@ -358,12 +429,49 @@ asyncload(dns_zone_t *zone, void *uap) {
 	return ISC_R_SUCCESS;
 }
 
+/*
+ * Add zone 'zone' and the size of its file to the load plan.
+ */
+static isc_result_t
+planload(dns_zone_t *zone, void *uap) {
+	struct zt_load_plan *plan = uap;
+	struct zt_load_entry *entry = NULL;
+
+	if (plan->count == plan->alloc) {
+		size_t alloc = ISC_MAX(plan->alloc * 2, 64);
+		plan->entries = isc_mem_creget(plan->mctx, plan->entries,
+					       plan->alloc, alloc,
+					       sizeof(plan->entries[0]));
+		plan->alloc = alloc;
+	}
+
+	entry = &plan->entries[plan->count++];
+	*entry = (struct zt_load_entry){ .size = dns__zone_loadsize(zone) };
+	dns_zone_attach(zone, &entry->zone);
+
+	return ISC_R_SUCCESS;
+}
+
+static int
+planload_compare(const void *a, const void *b) {
+	const struct zt_load_entry *ea = a;
+	const struct zt_load_entry *eb = b;
+
+	if (ea->size > eb->size) {
+		return -1;
+	} else if (ea->size < eb->size) {
+		return 1;
+	}
+	return 0;
+}
+
 isc_result_t
 dns_zt_asyncload(dns_zt_t *zt, bool newonly, dns_zt_callback_t *loaddone,
 		 void *arg) {
 	isc_result_t result;
 	uint_fast32_t loads_pending;
 	struct zt_load_params *params = NULL;
+	struct zt_load_plan plan = { .mctx = zt->mctx };
 
 	REQUIRE(VALID_ZT(zt));
 
@@ -383,7 +491,24 @@ dns_zt_asyncload(dns_zt_t *zt, bool newonly, dns_zt_callback_t *loaddone,
 		.loaddone_arg = arg,
 	};
 
-	result = dns_zt_apply(zt, false, NULL, asyncload, params);
+	/*
+	 * Schedule the largest zones first.  The loads themselves run in
+	 * parallel on the offload threads, so starting the longest ones
+	 * early shortens the time until the last zone is loaded.
+	 */
+	result = dns_zt_apply(zt, false, NULL, planload, &plan);
+	if (plan.count > 1) {
+		qsort(plan.entries, plan.count, sizeof(plan.entries[0]),
+		      planload_compare);
+	}
+	for (size_t i = 0; i < plan.count; i++) {
+		(void)asyncload(plan.entries[i].zone, params);
+		dns_zone_detach(&plan.entries[i].zone);
+	}
+	if (plan.entries != NULL) {
+		isc_mem_cput(zt->mctx, plan.entries, plan.alloc,
+			     sizeof(plan.entries[0]));
+	}
 
 	/*
 	 * Have all the loads completed?
@@ -517,13 +642,18 @@ dns_zt_apply(dns_zt_t *zt, bool stop, isc_result_t *sub,
 	isc_result_t tresult = ISC_R_SUCCESS;
 	dns_qpiter_t qpi;
 	dns_qpread_t qpr;
+	dns_qpreadable_t reader = { .qpr = &qpr };
 	void *zone = NULL;
 
 	REQUIRE(VALID_ZT(zt));
 	REQUIRE(action != NULL);
 
-	dns_qpmulti_query(zt->multi, &qpr);
-	dns_qpiter_init(&qpr, &qpi);
+	if (bulkzt == zt) {
+		reader = (dns_qpreadable_t){ .qpt = zt->bulk };
+	} else {
+		dns_qpmulti_query(zt->multi, &qpr);
+	}
+	dns_qpiter_init(reader, &qpi);
 
 	while (dns_qpiter_next(&qpi, NULL, &zone, NULL) == ISC_R_SUCCESS) {
 		result = action(zone, uap);
@@ -534,7 +664,9 @@ dns_zt_apply(dns_zt_t *zt, bool stop, isc_result_t *sub,
 			break;
 		}
 	}
-	dns_qpread_destroy(zt->multi, &qpr);
+	if (reader.qpr == &qpr) {
+		dns_qpread_destroy(zt->multi, &qpr);
+	}
 
 	SET_IF_NOT_NULL(sub, tresult);
 
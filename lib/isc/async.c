@@ -29,6 +29,7 @@
 #include <isc/signal.h>
 #include <isc/strerr.h>
 #include <isc/thread.h>
+#include <isc/time.h>
 #include <isc/util.h>
 #include <isc/uv.h>
 #include <isc/work.h>
@@ -37,19 +38,37 @@
 #include "job_p.h"
 #include "loop_p.h"
 
-void
-isc_async_run(isc_loop_t *loop, isc_job_cb cb, void *cbarg) {
-	REQUIRE(VALID_LOOP(loop));
-	REQUIRE(cb != NULL);
-
+static isc_job_t *
+async_job(isc_loop_t *loop, isc_job_cb cb, void *cbarg) {
 	isc_job_t *job = isc_mem_get(loop->mctx, sizeof(*job));
 	*job = (isc_job_t){
 		.cb = cb,
 		.cbarg = cbarg,
+		.enqueued = isc_time_monotonic(),
 	};
 
 	cds_wfcq_node_init(&job->wfcq_node);
 
+	atomic_fetch_add_relaxed(&loop->asyncssent, 1);
+
+	return job;
+}
+
+static void
+async_wakeup(isc_loop_t *loop) {
+	atomic_fetch_add_relaxed(&loop->asyncwakeups, 1);
+
+	int r = uv_async_send(&loop->async_trigger);
+	UV_RUNTIME_CHECK(uv_async_send, r);
+}
+
+void
+isc_async_run(isc_loop_t *loop, isc_job_cb cb, void *cbarg) {
+	REQUIRE(VALID_LOOP(loop));
+	REQUIRE(cb != NULL);
+
+	isc_job_t *job = async_job(loop, cb, cbarg);
+
 	/*
 	 * cds_wfcq_enqueue() is non-blocking and enqueues the job to async
 	 * queue.
@@ -60,11 +79,88 @@ isc_async_run(isc_loop_t *loop, isc_job_cb cb, void *cbarg) {
 	if (!cds_wfcq_enqueue(&loop->async_jobs.head, &loop->async_jobs.tail,
 			      &job->wfcq_node))
 	{
-		int r = uv_async_send(&loop->async_trigger);
-		UV_RUNTIME_CHECK(uv_async_send, r);
+		async_wakeup(loop);
 	}
 }
 
+void
+isc_async_batch(isc_loop_t *loop, isc_job_cb cb, void *cbarg) {
+	isc_loop_t *current = isc__loop_local;
+	isc_jobqueue_t *batch = NULL;
+
+	REQUIRE(VALID_LOOP(loop));
+	REQUIRE(cb != NULL);
+
+	/*
+	 * Only a running loop flushes the jobs it holds back, and only
+	 * the jobs for its sibling loops are held back.
+	 */
+	if (current == NULL || current->async_batch == NULL ||
+	    current->shuttingdown || loop->loopmgr != current->loopmgr ||
+	    loop != LOOP(loop->loopmgr, loop->tid))
+	{
+		isc_async_run(loop, cb, cbarg);
+		return;
+	}
+
+	isc_job_t *job = async_job(loop, cb, cbarg);
+
+	batch = &current->async_batch[loop->tid];
+	if (cds_wfcq_empty(&batch->head, &batch->tail)) {
+		current->async_dirty[current->async_ndirty++] = loop->tid;
+	}
+	(void)cds_wfcq_enqueue(&batch->head, &batch->tail, &job->wfcq_node);
+}
+
+void
+isc__async_flush(isc_loop_t *loop) {
+	for (uint32_t i = 0; i < loop->async_ndirty; i++) {
+		isc_loop_t *dest = LOOP(loop->loopmgr, loop->async_dirty[i]);
+		isc_jobqueue_t *batch = &loop->async_batch[dest->tid];
+
+		/*
+		 * Like cds_wfcq_enqueue(), splicing into the async queue
+		 * of the other loop needs no synchronization; the batch
+		 * queue is only used by this loop.
+		 */
+		enum cds_wfcq_ret ret = __cds_wfcq_splice_blocking(
+			&dest->async_jobs.head, &dest->async_jobs.tail,
+			&batch->head, &batch->tail);
+		INSIST(ret != CDS_WFCQ_RET_WOULDBLOCK &&
+		       ret != CDS_WFCQ_RET_SRC_EMPTY);
+		if (ret == CDS_WFCQ_RET_DEST_EMPTY) {
+			async_wakeup(dest);
+		}
+	}
+	loop->async_ndirty = 0;
+}
+
+void
+isc__async_batch_create(isc_loop_t *loop) {
+	isc_loopmgr_t *loopmgr = loop->loopmgr;
+
+	loop->async_batch = isc_mem_cget(loopmgr->mctx, loopmgr->nloops,
+					 sizeof(loop->async_batch[0]));
+	loop->async_dirty = isc_mem_cget(loopmgr->mctx, loopmgr->nloops,
+					 sizeof(loop->async_dirty[0]));
+	for (size_t i = 0; i < loopmgr->nloops; i++) {
+		__cds_wfcq_init(&loop->async_batch[i].head,
+				&loop->async_batch[i].tail);
+	}
+}
+
+void
+isc__async_batch_destroy(isc_loop_t *loop) {
+	isc_loopmgr_t *loopmgr = loop->loopmgr;
+
+	INSIST(loop->async_ndirty == 0);
+
+	isc_mem_cput(loopmgr->mctx, loop->async_batch, loopmgr->nloops,
+		     sizeof(loop->async_batch[0]));
+	isc_mem_cput(loopmgr->mctx, loop->async_dirty, loopmgr->nloops,
+		     sizeof(loop->async_dirty[0]));
+}
+
 void
 isc__async_cb(uv_async_t *handle) {
 	isc_loop_t *loop = uv_handle_get_data(handle);
@@ -108,6 +204,22 @@ isc__async_cb(uv_async_t *handle) {
 	__cds_wfcq_for_each_blocking_safe(&jobs.head, &jobs.tail, node, next) {
 		isc_job_t *job = caa_container_of(node, isc_job_t, wfcq_node);
 
+		/*
+		 * The setup and teardown jobs are queued here too, but
+		 * they are not counted.
+		 */
+		if (job->enqueued != 0) {
+			uint64_t wait = isc_time_monotonic() - job->enqueued;
+
+			atomic_store_relaxed(
+				&loop->asyncwait,
+				atomic_load_relaxed(&loop->asyncwait) + wait);
+			isc__loop_statmax(&loop->asyncmaxwait, wait);
+			atomic_store_relaxed(&loop->asyncs,
+					     atomic_load_relaxed(&loop->asyncs) +
+						     1);
+		}
+
 		job->cb(job->cbarg);
 
 		isc_mem_put(loop->mctx, job, sizeof(*job));
@@ -24,3 +24,19 @@ isc__async_cb(uv_async_t *handle);
 
 void
 isc__async_close(uv_handle_t *handle);
+
+void
+isc__async_batch_create(isc_loop_t *loop);
+/*%<
+ * Set up the queues for the jobs 'loop' sends with isc_async_batch().
+ */
+
+void
+isc__async_batch_destroy(isc_loop_t *loop);
+
+void
+isc__async_flush(isc_loop_t *loop);
+/*%<
+ * Pass the jobs held back by isc_async_batch() to their loops, waking
+ * up each loop once.
+ */
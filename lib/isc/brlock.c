@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/atomic.h>
+#include <isc/brlock.h>
+#include <isc/lockstat.h>
+#include <isc/mem.h>
+#include <isc/pause.h>
+#include <isc/tid.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+/*
+ * The reader arrives at its counter and then checks for a writer, and
+ * the writer takes the lock and then checks the counters, so at least
+ * one of them sees the other; both use sequentially consistent atomics
+ * for that.
+ */
+
+/*
+ * The memory allocator doesn't align to cache lines, so the slots are
+ * allocated with one more cache line and start at the first cache line
+ * boundary in it.
+ */
+#define SLOTS_SIZE(n) ((n) * sizeof(isc__brlockslot_t) + ISC_OS_CACHELINE_SIZE)
+
+static isc__brlockslot_t *
+ownslot(isc_brlock_t *brl) {
+	uint32_t tid = isc_tid();
+
+	return &brl->slots[tid < brl->nslots - 1 ? tid : brl->nslots - 1];
+}
+
+static bool
+writers_lock_islocked(isc_brlock_t *brl) {
+	return atomic_load(&brl->writers_lock);
+}
+
+static void
+wait_end(isc_nanosecs_t start, const char *file, unsigned int line,
+	 isc_lockstattype_t type) {
+	if (start != 0) {
+		isc__lockstat_record(file, line, type,
+				     isc_time_monotonic() - start);
+	}
+}
+
+void
+isc_brlock_init(isc_brlock_t *brl, isc_mem_t *mctx) {
+	REQUIRE(brl != NULL);
+
+	*brl = (isc_brlock_t){
+		/* One for each loop, and one for all the other threads */
+		.nslots = isc_tid_count() + 1,
+	};
+	isc_mem_attach(mctx, &brl->mctx);
+
+	brl->base = isc_mem_get(brl->mctx, SLOTS_SIZE(brl->nslots));
+	brl->slots = (isc__brlockslot_t *)ISC_ALIGN((uintptr_t)brl->base,
+						    ISC_OS_CACHELINE_SIZE);
+	for (uint32_t i = 0; i < brl->nslots; i++) {
+		atomic_init(&brl->slots[i].readers, 0);
+	}
+	atomic_init(&brl->writers_lock, false);
+}
+
+void
+isc_brlock_destroy(isc_brlock_t *brl) {
+	REQUIRE(brl != NULL && brl->slots != NULL);
+	REQUIRE(!writers_lock_islocked(brl));
+
+	for (uint32_t i = 0; i < brl->nslots; i++) {
+		REQUIRE(atomic_load(&brl->slots[i].readers) == 0);
+	}
+
+	isc_mem_put(brl->mctx, brl->base, SLOTS_SIZE(brl->nslots));
+	brl->slots = NULL;
+	isc_mem_detach(&brl->mctx);
+}
+
+void
+isc__brlock_rdlock(isc_brlock_t *brl, const char *file, unsigned int line) {
+	isc__brlockslot_t *slot = ownslot(brl);
+	isc_nanosecs_t start = 0;
+
+	for (;;) {
+		atomic_fetch_add(&slot->readers, 1);
+		if (!writers_lock_islocked(brl)) {
+			break;
+		}
+
+		/* Let the writer in, and wait for it to finish */
+		atomic_fetch_sub(&slot->readers, 1);
+		if (start == 0 && isc_lockstat_enabled()) {
+			start = isc_time_monotonic();
+		}
+		while (writers_lock_islocked(brl)) {
+			isc_pause();
+		}
+	}
+
+	wait_end(start, file, line, isc_lockstattype_read);
+}
+
+void
+isc_brlock_rdunlock(isc_brlock_t *brl) {
+	atomic_fetch_sub_release(&ownslot(brl)->readers, 1);
+}
+
+void
+isc__brlock_wrlock(isc_brlock_t *brl, const char *file, unsigned int line) {
+	isc_nanosecs_t start = 0;
+
+	while (!atomic_compare_exchange_weak(&brl->writers_lock,
+					     &(bool){ false }, true))
+	{
+		if (start == 0 && isc_lockstat_enabled()) {
+			start = isc_time_monotonic();
+		}
+		isc_pause();
+	}
+
+	for (uint32_t i = 0; i < brl->nslots; i++) {
+		while (atomic_load(&brl->slots[i].readers) > 0) {
+			if (start == 0 && isc_lockstat_enabled()) {
+				start = isc_time_monotonic();
+			}
+			isc_pause();
+		}
+	}
+
+	wait_end(start, file, line, isc_lockstattype_write);
+}
+
+void
+isc_brlock_wrunlock(isc_brlock_t *brl) {
+	REQUIRE(atomic_compare_exchange_strong(&brl->writers_lock,
+					       &(bool){ true }, false));
+}
@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <stdbool.h>
+
+#include <openssl/async.h>
+#include <openssl/err.h>
+
+#include <isc/async.h>
+#include <isc/cryptojob.h>
+#include <isc/loop.h>
+#include <isc/mem.h>
+#include <isc/util.h>
+#include <isc/uv.h>
+
+#include "loop_p.h"
+
+typedef struct isc_cryptojob {
+	isc_loop_t *loop;
+	isc_cryptojob_fn fn;
+	isc_cryptojob_cb cb;
+	void *arg;
+	isc_result_t result;
+	ASYNC_JOB *job;
+	ASYNC_WAIT_CTX *waitctx;
+	bool started;
+	bool polling;
+	OSSL_ASYNC_FD fd;
+	uv_poll_t poll;
+} isc_cryptojob_t;
+
+static void
+cryptojob_resume(isc_cryptojob_t *job);
+
+static int
+cryptojob_start(void *arg) {
+	isc_cryptojob_t *job = *(isc_cryptojob_t **)arg;
+
+	job->result = job->fn(job->arg);
+
+	return 1;
+}
+
+static void
+cryptojob_free(isc_cryptojob_t *job) {
+	isc_loop_t *loop = job->loop;
+
+	job->cb(job->result, job->arg);
+
+	ASYNC_WAIT_CTX_free(job->waitctx);
+	isc_mem_put(loop->mctx, job, sizeof(*job));
+	isc_loop_detach(&loop);
+}
+
+static void
+cryptojob_close_cb(uv_handle_t *handle) {
+	cryptojob_free(uv_handle_get_data(handle));
+}
+
+static void
+cryptojob_done(isc_cryptojob_t *job) {
+	if (job->polling) {
+		uv_poll_stop(&job->poll);
+		uv_close(&job->poll, cryptojob_close_cb);
+		return;
+	}
+
+	cryptojob_free(job);
+}
+
+static void
+cryptojob_resume_cb(void *arg) {
+	cryptojob_resume(arg);
+}
+
+static void
+cryptojob_poll_cb(uv_poll_t *handle, int status, int events) {
+	isc_cryptojob_t *job = uv_handle_get_data(handle);
+
+	UNUSED(status);
+	UNUSED(events);
+
+	uv_poll_stop(&job->poll);
+	cryptojob_resume(job);
+}
+
+/*
+ * Wait until the paused job can be resumed: the engine or provider
+ * signals it on a file descriptor.  If there is none, or it cannot be
+ * polled, try again on the next turn of the loop.
+ */
+static void
+cryptojob_wait(isc_cryptojob_t *job) {
+	OSSL_ASYNC_FD fd;
+	size_t numfds = 0;
+	int r;
+
+	if (ASYNC_WAIT_CTX_get_all_fds(job->waitctx, NULL, &numfds) != 1 ||
+	    numfds != 1 ||
+	    ASYNC_WAIT_CTX_get_all_fds(job->waitctx, &fd, &numfds) != 1)
+	{
+		goto retry;
+	}
+
+	if (job->polling && job->fd != fd) {
+		goto retry;
+	}
+
+	if (!job->polling) {
+		r = uv_poll_init(&job->loop->loop, &job->poll, fd);
+		if (r != 0) {
+			goto retry;
+		}
+		uv_handle_set_data(&job->poll, job);
+		job->polling = true;
+		job->fd = fd;
+	}
+
+	r = uv_poll_start(&job->poll, UV_READABLE, cryptojob_poll_cb);
+	if (r == 0) {
+		return;
+	}
+
+retry:
+	isc_async_run(job->loop, cryptojob_resume_cb, job);
+}
+
+static void
+cryptojob_resume(isc_cryptojob_t *job) {
+	int ret = 0;
+
+	switch (ASYNC_start_job(&job->job, job->waitctx, &ret, cryptojob_start,
+				&job, sizeof(job)))
+	{
+	case ASYNC_FINISH:
+		break;
+	case ASYNC_PAUSE:
+		job->started = true;
+		cryptojob_wait(job);
+		return;
+	default:
+		ERR_clear_error();
+		if (!job->started) {
+			/* No asynchronous jobs here: do it at once. */
+			job->result = job->fn(job->arg);
+		} else {
+			job->result = ISC_R_CRYPTOFAILURE;
+		}
+		break;
+	}
+
+	cryptojob_done(job);
+}
+
+void
+isc_cryptojob_run(isc_loop_t *loop, isc_cryptojob_fn fn, isc_cryptojob_cb cb,
+		  void *arg) {
+	isc_cryptojob_t *job = NULL;
+
+	REQUIRE(loop == isc_loop());
+	REQUIRE(fn != NULL);
+	REQUIRE(cb != NULL);
+
+	job = isc_mem_get(loop->mctx, sizeof(*job));
+	*job = (isc_cryptojob_t){
+		.fn = fn,
+		.cb = cb,
+		.arg = arg,
+		.result = ISC_R_UNSET,
+		.waitctx = ASYNC_WAIT_CTX_new(),
+	};
+	isc_loop_attach(loop, &job->loop);
+
+	if (job->waitctx == NULL) {
+		ERR_clear_error();
+		job->result = fn(arg);
+		cryptojob_free(job);
+		return;
+	}
+
+	cryptojob_resume(job);
+}
@@ -12,24 +12,34 @@
  */
 
 /*
- * This is an implementation of the Robin Hood hash table algorithm as
- * described in [a] with simple linear searching, and backwards shift
- * deletion algorithm as described in [b] and [c].
+ * This is an implementation of the "Swiss table" open addressing hash
+ * table described in [a].  The slots are split into groups of sixteen,
+ * and every slot has a control byte that holds either seven bits of the
+ * hash value of its entry, or a mark for an empty or a deleted slot.  The
+ * rest of the hash value picks the group where the search starts, and
+ * the search then probes whole groups: the sixteen control bytes of a
+ * group are compared at once with SIMD instructions where available, so
+ * only the entries with matching hash bits are looked at.  A search stops
+ * at the first group with an empty slot.
  *
- * Further work:
- * 1. Implement 4.1 Speeding up Searches - 4.4 Smart Search [a]
- * 2. Implement A Fast Concurrent and Resizable Robin Hood Hash Table [b]
+ * The table is resized incrementally: a new table is created next to the
+ * old one, every add or delete moves one group of entries from the old
+ * table to the new one, and searches look into both tables until the old
+ * one is empty.
  *
- * a. https://cs.uwaterloo.ca/research/tr/1986/CS-86-14.pdf paper.
- * b. https://dspace.mit.edu/bitstream/handle/1721.1/130693/1251799942-MIT.pdf
- * c.
- * https://codecapsule.com/2013/11/17/robin-hood-hashing-backward-shift-deletion/
+ * a. https://abseil.io/about/design/swisstables
  */
 
 #include <ctype.h>
 #include <inttypes.h>
 #include <string.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #include <isc/ascii.h>
 #include <isc/atomic.h>
 #include <isc/entropy.h>
@@ -41,19 +51,9 @@
 #include <isc/types.h>
 #include <isc/util.h>
 
-#define APPROX_99_PERCENT(x) (((x) * 1013) >> 10)
-#define APPROX_95_PERCENT(x) (((x) * 972) >> 10)
-#define APPROX_90_PERCENT(x) (((x) * 921) >> 10)
-#define APPROX_85_PERCENT(x) (((x) * 870) >> 10)
+#define APPROX_87_PERCENT(x) ((x) - ((x) >> 3))
 #define APPROX_40_PERCENT(x) (((x) * 409) >> 10)
-#define APPROX_35_PERCENT(x) (((x) * 359) >> 10)
-#define APPROX_30_PERCENT(x) (((x) * 308) >> 10)
-#define APPROX_25_PERCENT(x) (((x) * 256) >> 10)
 #define APPROX_20_PERCENT(x) (((x) * 205) >> 10)
-#define APPROX_15_PERCENT(x) (((x) * 154) >> 10)
-#define APPROX_10_PERCENT(x) (((x) * 103) >> 10)
-#define APPROX_05_PERCENT(x) (((x) * 52) >> 10)
-#define APPROX_01_PERCENT(x) (((x) * 11) >> 10)
 
 #define ISC_HASHMAP_MAGIC	   ISC_MAGIC('H', 'M', 'a', 'p')
 #define ISC_HASHMAP_VALID(hashmap) ISC_MAGIC_VALID(hashmap, ISC_HASHMAP_MAGIC)
@@ -67,24 +67,39 @@
 #define HASHMAP_MIN_BITS 1U
 #define HASHMAP_MAX_BITS 32U
 
+/* The slots are probed in groups of 16, the smallest table is one group */
+#define GROUP_BITS  4U
+#define GROUP_WIDTH (1U << GROUP_BITS)
+
+/*
+ * The control byte of a full slot has the high bit clear and holds the
+ * low seven bits of the hash value; the empty and deleted slots have the
+ * high bit set.
+ */
+#define CTRL_EMPTY    0x80
+#define CTRL_DELETED  0xfe
+#define CTRL_FULL(c)  (((c) & 0x80) == 0)
+#define CTRL_HASH(hv) ((uint8_t)((hv) & 0x7f))
+
 typedef struct hashmap_node {
 	const void *key;
 	void *value;
 	uint32_t hashval;
-	uint32_t psl;
 } hashmap_node_t;
 
 typedef struct hashmap_table {
 	size_t size;
 	uint8_t hashbits;
-	uint32_t hashmask;
+	uint32_t groupmask;
+	size_t used; /* full and deleted slots */
+	uint8_t *ctrl;
 	hashmap_node_t *table;
 } hashmap_table_t;
 
 struct isc_hashmap {
 	unsigned int magic;
 	uint8_t hindex;
-	uint32_t hiter; /* rehashing iterator */
+	size_t hiter; /* rehashing iterator */
 	isc_mem_t *mctx;
 	size_t count;
 	hashmap_table_t tables[HASHMAP_NUM_TABLES];
@@ -99,22 +114,6 @@ struct isc_hashmap_iter {
 	hashmap_node_t *cur;
 };
 
-static isc_result_t
-hashmap_add(isc_hashmap_t *hashmap, const uint32_t hashval,
-	    isc_hashmap_match_fn match, const uint8_t *key, void *value,
-	    void **foundp, uint8_t idx);
-
-static void
-hashmap_rehash_one(isc_hashmap_t *hashmap);
-static void
-hashmap_rehash_start_grow(isc_hashmap_t *hashmap);
-static void
-hashmap_rehash_start_shrink(isc_hashmap_t *hashmap);
-static bool
-over_threshold(isc_hashmap_t *hashmap);
-static bool
-under_threshold(isc_hashmap_t *hashmap);
-
 static uint8_t
 hashmap_nexttable(uint8_t idx) {
 	return (idx == 0) ? 1 : 0;
@@ -131,34 +130,105 @@ try_nexttable(const isc_hashmap_t *hashmap, uint8_t idx) {
 	return idx == hashmap->hindex && rehashing_in_progress(hashmap);
 }
 
-static void
-hashmap_node_init(hashmap_node_t *node, const uint32_t hashval,
-		  const uint8_t *key, void *value) {
-	*node = (hashmap_node_t){
-		.value = value,
-		.hashval = hashval,
-		.key = key,
-		.psl = 0,
-	};
+/*
+ * Return a bitmask with one bit for each slot of the group at 'ctrl'
+ * that matches: the slots with control byte 'c', the empty slots, and
+ * the slots that are not full.
+ */
+#if defined(__SSE2__)
+
+static inline unsigned int
+group_match(const uint8_t *ctrl, uint8_t c) {
+	__m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(c)));
+}
+
+static inline unsigned int
+group_match_free(const uint8_t *ctrl) {
+	return _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl));
+}
+
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+
+static inline unsigned int
+group_movemask(uint8x16_t cmp) {
+	static const uint8_t weights[16] = { 1, 2, 4, 8, 16, 32, 64, 128,
+					     1, 2, 4, 8, 16, 32, 64, 128 };
+	uint8x16_t bits = vandq_u8(cmp, vld1q_u8(weights));
+	return vaddv_u8(vget_low_u8(bits)) |
+	       (unsigned int)vaddv_u8(vget_high_u8(bits)) << 8;
+}
+
+static inline unsigned int
+group_match(const uint8_t *ctrl, uint8_t c) {
+	return group_movemask(vceqq_u8(vld1q_u8(ctrl), vdupq_n_u8(c)));
+}
+
+static inline unsigned int
+group_match_free(const uint8_t *ctrl) {
+	return group_movemask(vcgeq_u8(vld1q_u8(ctrl), vdupq_n_u8(0x80)));
+}
+
+#else
+
+static inline unsigned int
+group_match(const uint8_t *ctrl, uint8_t c) {
+	unsigned int mask = 0;
+	for (unsigned int i = 0; i < GROUP_WIDTH; i++) {
+		mask |= (unsigned int)(ctrl[i] == c) << i;
+	}
+	return mask;
+}
+
+static inline unsigned int
+group_match_free(const uint8_t *ctrl) {
+	unsigned int mask = 0;
+	for (unsigned int i = 0; i < GROUP_WIDTH; i++) {
+		mask |= (unsigned int)!CTRL_FULL(ctrl[i]) << i;
+	}
+	return mask;
+}
+
+#endif
+
+static inline unsigned int
+group_match_empty(const uint8_t *ctrl) {
+	return group_match(ctrl, CTRL_EMPTY);
+}
+
+/*
+ * The first group to probe; the probe sequence then steps 1, 2, 3, ...
+ * groups, which visits every group when their number is a power of two.
+ */
+static inline uint32_t
+hashmap_group(const hashmap_table_t *table, const uint32_t hashval) {
+	if (table->hashbits == GROUP_BITS) {
+		return 0;
+	}
+	return isc_hash_bits32(hashval, table->hashbits - GROUP_BITS);
 }
 
 ISC_ATTR_UNUSED static void
 hashmap_dump_table(const isc_hashmap_t *hashmap, const uint8_t idx) {
+	const hashmap_table_t *table = &hashmap->tables[idx];
+
 	fprintf(stderr,
-		"====== %" PRIu8 " (bits = %" PRIu8 ", size = %zu =====\n", idx,
-		hashmap->tables[idx].hashbits, hashmap->tables[idx].size);
-	for (size_t i = 0; i < hashmap->tables[idx].size; i++) {
-		hashmap_node_t *node = &hashmap->tables[idx].table[i];
-		if (node->key != NULL) {
-			uint32_t hash = isc_hash_bits32(
-				node->hashval, hashmap->tables[idx].hashbits);
+		"====== %" PRIu8 " (bits = %" PRIu8 ", size = %zu, used = %zu"
+		" =====\n",
+		idx, table->hashbits, table->size, table->used);
+	for (size_t i = 0; i < table->size; i++) {
+		hashmap_node_t *node = &table->table[i];
+		if (CTRL_FULL(table->ctrl[i])) {
 			fprintf(stderr,
 				"%p: %zu -> %p"
 				", value = %p"
-				", hash = %" PRIu32 ", hashval = %" PRIu32
-				", psl = %" PRIu32 ", key = %s\n",
-				hashmap, i, node, node->value, hash,
-				node->hashval, node->psl, (char *)node->key);
+				", group = %" PRIu32 ", hashval = %" PRIu32
+				", key = %s\n",
+				hashmap, i, node, node->value,
+				hashmap_group(table, node->hashval),
+				node->hashval, (char *)node->key);
+		} else if (table->ctrl[i] == CTRL_DELETED) {
+			fprintf(stderr, "%p: %zu deleted\n", hashmap, i);
 		}
 	}
 	fprintf(stderr, "================\n\n");
@@ -169,15 +239,19 @@ hashmap_create_table(isc_hashmap_t *hashmap, const uint8_t idx,
 		     const uint8_t bits) {
 	REQUIRE(hashmap->tables[idx].hashbits == HASHMAP_NO_BITS);
 	REQUIRE(hashmap->tables[idx].table == NULL);
-	REQUIRE(bits >= HASHMAP_MIN_BITS);
+	REQUIRE(bits >= GROUP_BITS);
 	REQUIRE(bits <= HASHMAP_MAX_BITS);
 
 	hashmap->tables[idx] = (hashmap_table_t){
 		.hashbits = bits,
-		.hashmask = HASHSIZE(bits) - 1,
+		.groupmask = (HASHSIZE(bits) >> GROUP_BITS) - 1,
 		.size = HASHSIZE(bits),
 	};
 
+	hashmap->tables[idx].ctrl = isc_mem_get(hashmap->mctx,
+						hashmap->tables[idx].size);
+	memset(hashmap->tables[idx].ctrl, CTRL_EMPTY,
+	       hashmap->tables[idx].size);
 	hashmap->tables[idx].table =
 		isc_mem_cget(hashmap->mctx, hashmap->tables[idx].size,
 			     sizeof(hashmap->tables[idx].table[0]));
@@ -189,14 +263,14 @@ hashmap_free_table(isc_hashmap_t *hashmap, const uint8_t idx, bool cleanup) {
 
 	if (cleanup) {
 		for (size_t i = 0; i < hashmap->tables[idx].size; i++) {
-			hashmap_node_t *node = &hashmap->tables[idx].table[i];
-			if (node->key != NULL) {
-				*node = (hashmap_node_t){ 0 };
+			if (CTRL_FULL(hashmap->tables[idx].ctrl[i])) {
 				hashmap->count--;
 			}
 		}
 	}
 
+	isc_mem_put(hashmap->mctx, hashmap->tables[idx].ctrl,
+		    hashmap->tables[idx].size);
 	size = hashmap->tables[idx].size *
 	       sizeof(hashmap->tables[idx].table[0]);
 	isc_mem_put(hashmap->mctx, hashmap->tables[idx].table, size);
@@ -219,7 +293,7 @@ isc_hashmap_create(isc_mem_t *mctx, uint8_t bits, isc_hashmap_t **hashmapp) {
 	};
 	isc_mem_attach(mctx, &hashmap->mctx);
 
-	hashmap_create_table(hashmap, 0, bits);
+	hashmap_create_table(hashmap, 0, ISC_MAX(bits, GROUP_BITS));
 
 	hashmap->magic = ISC_HASHMAP_MAGIC;
 
@@ -250,37 +324,40 @@ isc_hashmap_destroy(isc_hashmap_t **hashmapp) {
 
 static hashmap_node_t *
 hashmap_find(const isc_hashmap_t *hashmap, const uint32_t hashval,
-	     isc_hashmap_match_fn match, const uint8_t *key, uint32_t *pslp,
+	     isc_hashmap_match_fn match, const uint8_t *key, size_t *posp,
 	     uint8_t *idxp) {
-	uint32_t hash;
-	uint32_t psl;
+	const hashmap_table_t *table = NULL;
 	uint8_t idx = *idxp;
-	uint32_t pos;
+	uint32_t group;
 
 nexttable:
-	psl = 0;
-	hash = isc_hash_bits32(hashval, hashmap->tables[idx].hashbits);
+	table = &hashmap->tables[idx];
+	group = hashmap_group(table, hashval);
 
-	while (true) {
-		hashmap_node_t *node = NULL;
+	for (uint32_t step = 1; step <= table->groupmask + 1; step++) {
+		size_t base = (size_t)group * GROUP_WIDTH;
+		const uint8_t *ctrl = &table->ctrl[base];
+		unsigned int mask = group_match(ctrl, CTRL_HASH(hashval));
 
-		pos = (hash + psl) & hashmap->tables[idx].hashmask;
+		while (mask != 0) {
+			size_t pos = base + __builtin_ctz(mask);
+			hashmap_node_t *node = &table->table[pos];
 
-		node = &hashmap->tables[idx].table[pos];
-
-		if (node->key == NULL || psl > node->psl) {
-			break;
-		}
-
-		if (node->hashval == hashval) {
-			if (match(node->value, key)) {
-				*pslp = psl;
+			if (node->hashval == hashval && match(node->value, key))
+			{
+				*posp = pos;
 				*idxp = idx;
 				return node;
 			}
+
+			mask &= mask - 1;
 		}
 
-		psl++;
+		if (group_match_empty(ctrl) != 0) {
+			break;
+		}
+
+		group = (group + step) & table->groupmask;
 	}
 	if (try_nexttable(hashmap, idx)) {
 		idx = hashmap_nexttable(idx);
@@ -298,7 +375,7 @@ isc_hashmap_find(const isc_hashmap_t *hashmap, const uint32_t hashval,
 
 	uint8_t idx = hashmap->hindex;
 	hashmap_node_t *node = hashmap_find(hashmap, hashval, match, key,
-					    &(uint32_t){ 0 }, &idx);
+					    &(size_t){ 0 }, &idx);
 	if (node == NULL) {
 		return ISC_R_NOTFOUND;
 	}
@@ -308,106 +385,116 @@ isc_hashmap_find(const isc_hashmap_t *hashmap, const uint32_t hashval,
 	return ISC_R_SUCCESS;
 }
 
-static bool
-hashmap_delete_node(isc_hashmap_t *hashmap, hashmap_node_t *entry,
-		    uint32_t hashval, uint32_t psl, const uint8_t idx,
-		    size_t size) {
-	uint32_t pos;
-	uint32_t hash;
-	bool last = false;
+static void
+hashmap_delete_node(isc_hashmap_t *hashmap, const uint8_t idx,
+		    const size_t pos) {
+	hashmap_table_t *table = &hashmap->tables[idx];
+	const uint8_t *ctrl = &table->ctrl[pos & ~(size_t)(GROUP_WIDTH - 1)];
 
-	hashmap->count--;
+	INSIST(CTRL_FULL(table->ctrl[pos]));
 
-	hash = isc_hash_bits32(hashval, hashmap->tables[idx].hashbits);
-	pos = (hash + psl) & hashmap->tables[idx].hashmask;
+	hashmap->count--;
+	table->table[pos] = (hashmap_node_t){ 0 };
 
-	while (true) {
-		hashmap_node_t *node = NULL;
+	/*
+	 * The searches stop at a group with an empty slot, so if there is
+	 * one in this group already, no search needs to get past this slot
+	 * and it can be emptied too; otherwise it has to be marked deleted.
+	 */
+	if (group_match_empty(ctrl) != 0) {
+		table->ctrl[pos] = CTRL_EMPTY;
+		table->used--;
+	} else {
+		table->ctrl[pos] = CTRL_DELETED;
+	}
+}
 
-		pos = (pos + 1) & hashmap->tables[idx].hashmask;
-		INSIST(pos < hashmap->tables[idx].size);
+static void
+hashmap_insert(isc_hashmap_t *hashmap, const uint8_t idx,
+	       const uint32_t hashval, const uint8_t *key, void *value) {
+	hashmap_table_t *table = &hashmap->tables[idx];
+	uint32_t group = hashmap_group(table, hashval);
+	unsigned int mask;
+	size_t base, pos;
 
-		node = &hashmap->tables[idx].table[pos];
+	INSIST(atomic_load_acquire(&hashmap->iterators) == 0);
+	INSIST(table->used < table->size);
 
-		if (node->key == NULL || node->psl == 0) {
+	/* Take the first empty or deleted slot on the probe sequence */
+	for (uint32_t step = 1;; step++) {
+		base = (size_t)group * GROUP_WIDTH;
+		mask = group_match_free(&table->ctrl[base]);
+		if (mask != 0) {
 			break;
 		}
+		group = (group + step) & table->groupmask;
+	}
 
-		if ((pos % size) == 0) {
-			last = true;
-		}
-
-		node->psl--;
-		*entry = *node;
-		entry = &hashmap->tables[idx].table[pos];
+	pos = base + __builtin_ctz(mask);
+	if (table->ctrl[pos] == CTRL_EMPTY) {
+		table->used++;
 	}
 
-	*entry = (hashmap_node_t){ 0 };
-	return last;
+	table->ctrl[pos] = CTRL_HASH(hashval);
+	table->table[pos] = (hashmap_node_t){
+		.key = key,
+		.value = value,
+		.hashval = hashval,
+	};
+	hashmap->count++;
 }
 
 static void
 hashmap_rehash_one(isc_hashmap_t *hashmap) {
 	uint8_t oldidx = hashmap_nexttable(hashmap->hindex);
-	uint32_t oldsize = hashmap->tables[oldidx].size;
-	hashmap_node_t *oldtable = hashmap->tables[oldidx].table;
-	hashmap_node_t node;
+	hashmap_table_t *oldtable = &hashmap->tables[oldidx];
+	size_t end = hashmap->hiter + GROUP_WIDTH;
 
 	/* Don't rehash when iterating */
 	INSIST(atomic_load_acquire(&hashmap->iterators) == 0);
 
-	/* Find first non-empty node */
-	while (hashmap->hiter < oldsize && oldtable[hashmap->hiter].key == NULL)
-	{
-		hashmap->hiter++;
+	/* Move the entries of the next group from old table to new table */
+	for (; hashmap->hiter < end; hashmap->hiter++) {
+		hashmap_node_t node;
+
+		if (!CTRL_FULL(oldtable->ctrl[hashmap->hiter])) {
+			continue;
+		}
+
+		node = oldtable->table[hashmap->hiter];
+		hashmap_delete_node(hashmap, oldidx, hashmap->hiter);
+		hashmap_insert(hashmap, hashmap->hindex, node.hashval, node.key,
+			       node.value);
 	}
 
 	/* Rehashing complete */
-	if (hashmap->hiter == oldsize) {
-		hashmap_free_table(hashmap, hashmap_nexttable(hashmap->hindex),
-				   false);
+	if (hashmap->hiter == oldtable->size) {
+		hashmap_free_table(hashmap, oldidx, false);
 		hashmap->hiter = 0;
-		return;
 	}
-
-	/* Move the first non-empty node from old table to new table */
-	node = oldtable[hashmap->hiter];
-
-	(void)hashmap_delete_node(hashmap, &oldtable[hashmap->hiter],
-				  node.hashval, node.psl, oldidx, UINT32_MAX);
-
-	isc_result_t result = hashmap_add(hashmap, node.hashval, NULL, node.key,
-					  node.value, NULL, hashmap->hindex);
-	INSIST(result == ISC_R_SUCCESS);
-
-	/*
-	 * we don't increase the hiter here because the table has been reordered
-	 * when we deleted the old node
-	 */
 }
 
 static uint32_t
 grow_bits(isc_hashmap_t *hashmap) {
-	uint32_t newbits = hashmap->tables[hashmap->hindex].hashbits + 1;
-	size_t newsize = HASHSIZE(newbits);
+	uint32_t bits = hashmap->tables[hashmap->hindex].hashbits;
 
-	while (hashmap->count > APPROX_40_PERCENT(newsize)) {
-		newbits += 1;
-		newsize = HASHSIZE(newbits);
-	}
-	if (newbits > HASHMAP_MAX_BITS) {
-		newbits = HASHMAP_MAX_BITS;
+	/*
+	 * When the table is filled up with deleted slots rather than with
+	 * entries, rebuild it at the same size to get rid of them.
+	 */
+	if (hashmap->count <= APPROX_40_PERCENT(HASHSIZE(bits))) {
+		return bits;
 	}
 
-	return newbits;
+	return bits + 1;
 }
 
 static uint32_t
 shrink_bits(isc_hashmap_t *hashmap) {
 	uint32_t newbits = hashmap->tables[hashmap->hindex].hashbits - 1;
 
-	if (newbits <= HASHMAP_MIN_BITS) {
-		newbits = HASHMAP_MIN_BITS;
+	if (newbits <= GROUP_BITS) {
+		newbits = GROUP_BITS;
 	}
 
 	return newbits;
@@ -417,17 +504,14 @@ static void
 hashmap_rehash_start_grow(isc_hashmap_t *hashmap) {
 	uint32_t newbits;
 	uint8_t oldindex = hashmap->hindex;
-	uint32_t oldbits = hashmap->tables[oldindex].hashbits;
 	uint8_t newindex = hashmap_nexttable(oldindex);
 
 	REQUIRE(!rehashing_in_progress(hashmap));
 
 	newbits = grow_bits(hashmap);
 
-	if (newbits > oldbits) {
-		hashmap_create_table(hashmap, newindex, newbits);
-		hashmap->hindex = newindex;
-	}
+	hashmap_create_table(hashmap, newindex, newbits);
+	hashmap->hindex = newindex;
 }
 
 static void
@@ -447,6 +531,25 @@ hashmap_rehash_start_shrink(isc_hashmap_t *hashmap) {
 	}
 }
 
+static bool
+over_threshold(isc_hashmap_t *hashmap) {
+	hashmap_table_t *table = &hashmap->tables[hashmap->hindex];
+	if (table->hashbits == HASHMAP_MAX_BITS) {
+		return false;
+	}
+	return table->used >= APPROX_87_PERCENT(table->size);
+}
+
+static bool
+under_threshold(isc_hashmap_t *hashmap) {
+	uint32_t bits = hashmap->tables[hashmap->hindex].hashbits;
+	if (bits == GROUP_BITS) {
+		return false;
+	}
+	size_t threshold = APPROX_20_PERCENT(HASHSIZE(bits));
+	return hashmap->count < threshold;
+}
+
 isc_result_t
 isc_hashmap_delete(isc_hashmap_t *hashmap, const uint32_t hashval,
 		   isc_hashmap_match_fn match, const void *key) {
@@ -455,114 +558,31 @@ isc_hashmap_delete(isc_hashmap_t *hashmap, const uint32_t hashval,
 
 	hashmap_node_t *node;
 	isc_result_t result = ISC_R_NOTFOUND;
-	uint32_t psl = 0;
+	size_t pos = 0;
 	uint8_t idx;
 
 	if (rehashing_in_progress(hashmap)) {
 		hashmap_rehash_one(hashmap);
 	} else if (under_threshold(hashmap)) {
 		hashmap_rehash_start_shrink(hashmap);
-		hashmap_rehash_one(hashmap);
+		if (rehashing_in_progress(hashmap)) {
+			hashmap_rehash_one(hashmap);
+		}
 	}
 
 	/* Initialize idx after possible shrink start */
 	idx = hashmap->hindex;
 
-	node = hashmap_find(hashmap, hashval, match, key, &psl, &idx);
+	node = hashmap_find(hashmap, hashval, match, key, &pos, &idx);
 	if (node != NULL) {
 		INSIST(node->key != NULL);
-		(void)hashmap_delete_node(hashmap, node, hashval, psl, idx,
-					  UINT32_MAX);
+		hashmap_delete_node(hashmap, idx, pos);
 		result = ISC_R_SUCCESS;
 	}
 
 	return result;
 }
 
-static bool
-over_threshold(isc_hashmap_t *hashmap) {
-	uint32_t bits = hashmap->tables[hashmap->hindex].hashbits;
-	if (bits == HASHMAP_MAX_BITS) {
-		return false;
-	}
-	size_t threshold = APPROX_90_PERCENT(HASHSIZE(bits));
-	return hashmap->count > threshold;
-}
-
-static bool
-under_threshold(isc_hashmap_t *hashmap) {
-	uint32_t bits = hashmap->tables[hashmap->hindex].hashbits;
-	if (bits == HASHMAP_MIN_BITS) {
-		return false;
-	}
-	size_t threshold = APPROX_20_PERCENT(HASHSIZE(bits));
-	return hashmap->count < threshold;
-}
-
-static isc_result_t
-hashmap_add(isc_hashmap_t *hashmap, const uint32_t hashval,
-	    isc_hashmap_match_fn match, const uint8_t *key, void *value,
-	    void **foundp, uint8_t idx) {
-	uint32_t hash;
-	uint32_t psl = 0;
-	hashmap_node_t node;
-	hashmap_node_t *current = NULL;
-	uint32_t pos;
-
-	INSIST(atomic_load_acquire(&hashmap->iterators) == 0);
-
-	hash = isc_hash_bits32(hashval, hashmap->tables[idx].hashbits);
-
-	/* Initialize the node to be store to 'node' */
-	hashmap_node_init(&node, hashval, key, value);
-
-	psl = 0;
-	while (true) {
-		pos = (hash + psl) & hashmap->tables[idx].hashmask;
-
-		current = &hashmap->tables[idx].table[pos];
-
-		/* Found an empty node */
-		if (current->key == NULL) {
-			break;
-		}
-
-		if (current->hashval == hashval) {
-			if (match != NULL && match(current->value, key)) {
-				SET_IF_NOT_NULL(foundp, current->value);
-				return ISC_R_EXISTS;
-			}
-		}
-
-		/* Found rich node */
-		if (node.psl > current->psl) {
-			/* Swap the poor with the rich node */
-			ISC_SWAP(*current, node);
-		}
-
-		node.psl++;
-		psl++;
-	}
-
-	/*
-	 * Possible optimalization - start growing when the poor node is too far
-	 */
-#if ISC_HASHMAP_GROW_FAST
-	if (psl > hashmap->hashbits[idx]) {
-		if (!rehashing_in_progress(hashmap)) {
-			hashmap_rehash_start_grow(hashmap);
-		}
-	}
-#endif
-
-	hashmap->count++;
-
-	/* We found an empty place, store entry into current node */
-	*current = node;
-
-	return ISC_R_SUCCESS;
-}
-
 isc_result_t
 isc_hashmap_add(isc_hashmap_t *hashmap, const uint32_t hashval,
 		isc_hashmap_match_fn match, const void *key, void *value,
@@ -570,6 +590,9 @@ isc_hashmap_add(isc_hashmap_t *hashmap, const uint32_t hashval,
 	REQUIRE(ISC_HASHMAP_VALID(hashmap));
 	REQUIRE(key != NULL);
 
+	hashmap_node_t *found = NULL;
+	uint8_t idx;
+
 	if (rehashing_in_progress(hashmap)) {
 		hashmap_rehash_one(hashmap);
 	} else if (over_threshold(hashmap)) {
@@ -577,22 +600,19 @@ isc_hashmap_add(isc_hashmap_t *hashmap, const uint32_t hashval,
 		hashmap_rehash_one(hashmap);
 	}
 
-	if (rehashing_in_progress(hashmap)) {
-		uint8_t fidx = hashmap_nexttable(hashmap->hindex);
-		uint32_t psl;
-
-		/* Look for the value in the old table */
-		hashmap_node_t *found = hashmap_find(hashmap, hashval, match,
-						     key, &psl, &fidx);
-		if (found != NULL) {
-			INSIST(found->key != NULL);
-			SET_IF_NOT_NULL(foundp, found->value);
-			return ISC_R_EXISTS;
-		}
+	/* Look for the value in both tables */
+	idx = hashmap->hindex;
+	found = hashmap_find(hashmap, hashval, match, key, &(size_t){ 0 },
+			     &idx);
+	if (found != NULL) {
+		INSIST(found->key != NULL);
+		SET_IF_NOT_NULL(foundp, found->value);
+		return ISC_R_EXISTS;
 	}
 
-	return hashmap_add(hashmap, hashval, match, key, value, foundp,
-			   hashmap->hindex);
+	hashmap_insert(hashmap, hashmap->hindex, hashval, key, value);
+
+	return ISC_R_SUCCESS;
 }
 
 void
@@ -633,7 +653,7 @@ isc__hashmap_iter_next(isc_hashmap_iter_t *iter) {
 	isc_hashmap_t *hashmap = iter->hashmap;
 
 	while (iter->i < iter->size &&
-	       hashmap->tables[iter->hindex].table[iter->i].key == NULL)
+	       !CTRL_FULL(hashmap->tables[iter->hindex].ctrl[iter->i]))
 	{
 		iter->i++;
 	}
@@ -680,19 +700,9 @@ isc_hashmap_iter_delcurrent_next(isc_hashmap_iter_t *iter) {
 	REQUIRE(iter != NULL);
 	REQUIRE(iter->cur != NULL);
 
-	hashmap_node_t *node =
-		&iter->hashmap->tables[iter->hindex].table[iter->i];
-
-	if (hashmap_delete_node(iter->hashmap, node, node->hashval, node->psl,
-				iter->hindex, iter->size))
-	{
-		/*
-		 * We have seen the new last element so reduce the size
-		 * so we don't iterate over it twice.
-		 */
-		INSIST(iter->size != 0);
-		iter->size--;
-	}
+	/* The deletion doesn't move the other entries around */
+	hashmap_delete_node(iter->hashmap, iter->hindex, iter->i);
+	iter->i++;
 
 	return isc__hashmap_iter_next(iter);
 }
@@ -83,6 +83,19 @@ isc_hmac_reset(isc_hmac_t *hmac_st) {
 	return ISC_R_SUCCESS;
 }
 
+isc_result_t
+isc_hmac_copy(isc_hmac_t *hmac_st, isc_hmac_t *source) {
+	REQUIRE(hmac_st != NULL);
+	REQUIRE(source != NULL);
+
+	if (EVP_MD_CTX_copy_ex(hmac_st, source) != 1) {
+		ERR_clear_error();
+		return ISC_R_CRYPTOFAILURE;
+	}
+
+	return ISC_R_SUCCESS;
+}
+
 isc_result_t
 isc_hmac_update(isc_hmac_t *hmac_st, const unsigned char *buf,
 		const size_t len) {
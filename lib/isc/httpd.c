@@ -1119,3 +1119,41 @@ const isc_time_t *
 isc_httpd_if_modified_since(const isc_httpd_t *httpd) {
 	return (const isc_time_t *)&httpd->if_modified_since;
 }
+
+isc_result_t
+isc_httpd_getparam(const isc_httpd_t *httpd, const char *name,
+		   const char **valuep, size_t *lenp) {
+	const char *query = NULL, *end = NULL;
+	size_t namelen;
+
+	REQUIRE(VALID_HTTPD(httpd));
+	REQUIRE(name != NULL);
+	REQUIRE(valuep != NULL && lenp != NULL);
+
+	if ((httpd->up.field_set & (1 << ISC_UF_QUERY)) == 0) {
+		return ISC_R_NOTFOUND;
+	}
+
+	namelen = strlen(name);
+	query = &httpd->path[httpd->up.field_data[ISC_UF_QUERY].off];
+	end = query + httpd->up.field_data[ISC_UF_QUERY].len;
+
+	while (query < end) {
+		const char *next = memchr(query, '&', end - query);
+		if (next == NULL) {
+			next = end;
+		}
+
+		if ((size_t)(next - query) > namelen &&
+		    strncmp(query, name, namelen) == 0 && query[namelen] == '=')
+		{
+			*valuep = query + namelen + 1;
+			*lenp = next - *valuep;
+			return ISC_R_SUCCESS;
+		}
+
+		query = next + 1;
+	}
+
+	return ISC_R_NOTFOUND;
+}
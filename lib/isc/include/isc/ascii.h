@@ -118,7 +118,7 @@ isc_ascii_tolower4(uint32_t octets) {
 }
 
 /*
- * Helper function to do an unaligned load of 8 bytes in host byte order
+ * Helper functions to do an unaligned load of 8 or 4 bytes in host byte order
  */
 static inline uint64_t
 isc__ascii_load8(const uint8_t *ptr) {
@@ -127,21 +127,58 @@ isc__ascii_load8(const uint8_t *ptr) {
 	return bytes;
 }
 
+static inline uint32_t
+isc__ascii_load4(const uint8_t *ptr) {
+	uint32_t bytes = 0;
+	memmove(&bytes, ptr, sizeof(bytes));
+	return bytes;
+}
+
+/*
+ * The tail of the strings that is shorter than a word is handled by
+ * loading the last word of the strings again, overlapping the previous
+ * one: the overlapping bytes are equal, so they do not affect the result.
+ * Strings shorter than 8 bytes are compared as two overlapping 4 byte
+ * words, and only those shorter than 4 bytes one byte at a time.
+ */
+
 /*
  * Compare `len` bytes at `a` and `b` for case-insensitive equality
  */
 static inline bool
 isc_ascii_lowerequal(const uint8_t *a, const uint8_t *b, unsigned int len) {
 	uint64_t a8 = 0, b8 = 0;
-	while (len >= 8) {
-		a8 = isc_ascii_tolower8(isc__ascii_load8(a));
-		b8 = isc_ascii_tolower8(isc__ascii_load8(b));
-		if (a8 != b8) {
+	uint32_t a4 = 0, b4 = 0;
+
+	if (len >= 8) {
+		const uint8_t *alast = a + len - 8;
+		const uint8_t *blast = b + len - 8;
+		while (len >= 8) {
+			a8 = isc_ascii_tolower8(isc__ascii_load8(a));
+			b8 = isc_ascii_tolower8(isc__ascii_load8(b));
+			if (a8 != b8) {
+				return false;
+			}
+			len -= 8;
+			a += 8;
+			b += 8;
+		}
+		if (len == 0) {
+			return true;
+		}
+		a8 = isc_ascii_tolower8(isc__ascii_load8(alast));
+		b8 = isc_ascii_tolower8(isc__ascii_load8(blast));
+		return a8 == b8;
+	}
+	if (len >= 4) {
+		a4 = isc_ascii_tolower4(isc__ascii_load4(a));
+		b4 = isc_ascii_tolower4(isc__ascii_load4(b));
+		if (a4 != b4) {
 			return false;
 		}
-		len -= 8;
-		a += 8;
-		b += 8;
+		a4 = isc_ascii_tolower4(isc__ascii_load4(a + len - 4));
+		b4 = isc_ascii_tolower4(isc__ascii_load4(b + len - 4));
+		return a4 == b4;
 	}
 	while (len-- > 0) {
 		if (isc_ascii_tolower(*a++) != isc_ascii_tolower(*b++)) {
@@ -160,15 +197,37 @@ isc_ascii_lowerequal(const uint8_t *a, const uint8_t *b, unsigned int len) {
 static inline int
 isc_ascii_lowercmp(const uint8_t *a, const uint8_t *b, unsigned int len) {
 	uint64_t a8 = 0, b8 = 0;
-	while (len >= 8) {
-		a8 = isc_ascii_tolower8(htobe64(isc__ascii_load8(a)));
-		b8 = isc_ascii_tolower8(htobe64(isc__ascii_load8(b)));
+
+	if (len >= 8) {
+		const uint8_t *alast = a + len - 8;
+		const uint8_t *blast = b + len - 8;
+		while (len >= 8) {
+			a8 = isc_ascii_tolower8(htobe64(isc__ascii_load8(a)));
+			b8 = isc_ascii_tolower8(htobe64(isc__ascii_load8(b)));
+			if (a8 != b8) {
+				goto ret;
+			}
+			len -= 8;
+			a += 8;
+			b += 8;
+		}
+		if (len > 0) {
+			a8 = isc_ascii_tolower8(htobe64(isc__ascii_load8(alast)));
+			b8 = isc_ascii_tolower8(htobe64(isc__ascii_load8(blast)));
+		}
+		goto ret;
+	}
+	if (len >= 4) {
+		a8 = isc_ascii_tolower4(htobe32(isc__ascii_load4(a)));
+		b8 = isc_ascii_tolower4(htobe32(isc__ascii_load4(b)));
 		if (a8 != b8) {
 			goto ret;
 		}
-		len -= 8;
-		a += 8;
-		b += 8;
+		a8 = isc_ascii_tolower4(
+			htobe32(isc__ascii_load4(a + len - 4)));
+		b8 = isc_ascii_tolower4(
+			htobe32(isc__ascii_load4(b + len - 4)));
+		goto ret;
 	}
 	while (len-- > 0) {
 		a8 = isc_ascii_tolower(*a++);
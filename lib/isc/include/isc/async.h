@@ -42,6 +42,25 @@ isc_async_run(isc_loop_t *loop, isc_job_cb cb, void *cbarg);
  *\li	'cbarg' is passed to the 'cb' as the only argument, may be NULL
  */
 
+void
+isc_async_batch(isc_loop_t *loop, isc_job_cb cb, void *cbarg);
+/*%<
+ * Schedule the job callback 'cb' to be run on the 'loop' event loop,
+ * like isc_async_run(), but when called from a running loop, hold the
+ * job back until the current loop iteration ends.  All the jobs held
+ * back for the same loop are then passed to it at once, with a single
+ * wakeup, which is cheaper when sending many jobs to a few loops.
+ *
+ * The jobs sent to a loop with isc_async_batch() run in the order they
+ * were sent, but may run after the jobs sent later with isc_async_run().
+ *
+ * Requires:
+ *
+ *\li	'loop' is a valid isc event loop
+ *\li	'cb' is a callback function, must be non-NULL
+ *\li	'cbarg' is passed to the 'cb' as the only argument, may be NULL
+ */
+
 #define isc_async_current(cb, cbarg) isc_async_run(isc_loop(), cb, cbarg)
 /*%<
  * Helper macro to run the job on the current loop
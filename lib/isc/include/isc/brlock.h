@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*! \file isc/brlock.h
+ *
+ * \brief A reader-writer lock for data that is read all the time and
+ * written rarely.
+ *
+ * Every loop has a reader counter of its own, on a cache line of its
+ * own, so taking the lock for reading doesn't write to memory that the
+ * other loops use.  The threads that don't run a loop share one extra
+ * counter.  In exchange, a writer has to look at all the counters, and
+ * the lock takes a cache line for each loop.
+ *
+ * Writers are preferred: a reader waits while a writer holds the lock
+ * or waits for it.  The lock is not recursive, and a read lock must be
+ * released by the thread that took it.
+ */
+
+#include <inttypes.h>
+
+#include <isc/atomic.h>
+#include <isc/os.h>
+#include <isc/types.h>
+
+typedef struct isc__brlockslot {
+	atomic_uint_fast32_t readers;
+	uint8_t __padding[ISC_OS_CACHELINE_SIZE - sizeof(atomic_uint_fast32_t)];
+} isc__brlockslot_t;
+
+typedef struct isc_brlock {
+	isc_mem_t	  *mctx;
+	uint32_t	   nslots;
+	void		  *base;
+	isc__brlockslot_t *slots;
+	atomic_bool	   writers_lock;
+} isc_brlock_t;
+
+void
+isc_brlock_init(isc_brlock_t *brl, isc_mem_t *mctx);
+/*%<
+ * Initialize 'brl', with a reader counter for each loop.  Create it
+ * after the loop manager, or all the readers share a single counter.
+ *
+ * Requires:
+ *\li	'brl' is not NULL
+ *\li	'mctx' is a valid memory context
+ */
+
+void
+isc_brlock_destroy(isc_brlock_t *brl);
+/*%<
+ * Free the reader counters of 'brl', which must be unlocked.
+ */
+
+void
+isc__brlock_rdlock(isc_brlock_t *brl, const char *file, unsigned int line);
+
+void
+isc__brlock_wrlock(isc_brlock_t *brl, const char *file, unsigned int line);
+/*%<
+ * Take 'brl'; when the acquisition has to wait, the wait is counted in
+ * the lock contention statistics (see isc/lockstat.h) of 'file' and
+ * 'line'.
+ */
+
+#define isc_brlock_rdlock(brl) isc__brlock_rdlock(brl, __FILE__, __LINE__)
+#define isc_brlock_wrlock(brl) isc__brlock_wrlock(brl, __FILE__, __LINE__)
+
+void
+isc_brlock_rdunlock(isc_brlock_t *brl);
+
+void
+isc_brlock_wrunlock(isc_brlock_t *brl);
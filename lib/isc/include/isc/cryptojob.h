@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file isc/cryptojob.h
+ * \brief The isc_cryptojob unit runs cryptographic operations as OpenSSL
+ * asynchronous jobs on an isc event loop.
+ *
+ * When the operation is done by an engine or provider that supports
+ * asynchronous jobs, such as a hardware accelerator, the job is paused
+ * while the accelerator works, and the loop goes on with other work
+ * until the job can be resumed.  Otherwise, the operation is run to
+ * completion at once.
+ */
+
+#pragma once
+
+#include <isc/loop.h>
+#include <isc/result.h>
+#include <isc/types.h>
+
+typedef isc_result_t (*isc_cryptojob_fn)(void *arg);
+typedef void (*isc_cryptojob_cb)(isc_result_t result, void *arg);
+
+void
+isc_cryptojob_run(isc_loop_t *loop, isc_cryptojob_fn fn, isc_cryptojob_cb cb,
+		  void *arg);
+/*%<
+ * Run 'fn(arg)' as an asynchronous job on 'loop', and call 'cb' with
+ * its result and 'arg' on 'loop' when it is done.  'cb' may be called
+ * before isc_cryptojob_run() returns.
+ *
+ * 'fn' runs on a separate, small stack: it should only call the
+ * cryptographic functions and not use large local buffers.
+ *
+ * Requires:
+ *
+ *\li	'loop' is the current event loop
+ *\li	'fn' and 'cb' are non-NULL
+ */
@@ -104,6 +104,8 @@ struct isc_dnsstream_assembler {
 			    the callback). */
 	isc_result_t result; /*<! The last passed to the callback processing
 				status value. */
+	size_t copied; /*<! The amount of data copied into the internal
+			  buffer, i.e. not processed in place. */
 	isc_mem_t *mctx;
 };
 
@@ -212,6 +214,18 @@ isc_dnsstream_assembler_remaininglength(
  *\li	'dnsasm' is not NULL.
  */
 
+static inline size_t
+isc_dnsstream_assembler_copiedlength(
+	const isc_dnsstream_assembler_t *restrict dnsasm);
+/*!<
+ * \brief Return the total amount of incoming data the given
+ * 'isc_dnsstream_assembler_t' object had to copy into its internal
+ * buffer, rather than process in place.
+ *
+ * Requires:
+ *\li	'dnsasm' is not NULL.
+ */
+
 static inline void
 isc_dnsstream_assembler_clear(isc_dnsstream_assembler_t *restrict dnsasm);
 /*!<
@@ -309,6 +323,15 @@ isc__dnsstream_assembler_callcb(isc_dnsstream_assembler_t *restrict dnsasm,
 	return ret;
 }
 
+static inline void
+isc__dnsstream_assembler_putmem(isc_dnsstream_assembler_t *restrict dnsasm,
+				const void *restrict buf, size_t buf_size) {
+	INSIST(dnsasm->current == &dnsasm->dnsbuf);
+
+	isc_buffer_putmem(dnsasm->current, buf, buf_size);
+	dnsasm->copied += buf_size;
+}
+
 static inline bool
 isc__dnsstream_assembler_handle_message(
 	isc_dnsstream_assembler_t *restrict dnsasm, void *userarg) {
@@ -405,8 +428,8 @@ isc__dnsstream_assembler_incoming_direct(
 		 * into the internal buffer for processing
 		 * later.
 		 */
-		isc_buffer_putmem(dnsasm->current, remaining.base,
-				  remaining.length);
+		isc__dnsstream_assembler_putmem(dnsasm, remaining.base,
+						remaining.length);
 	}
 }
 
@@ -447,7 +470,7 @@ isc__dnsstream_assembler_incoming_direct_non_empty(
 		uint8_t *unprocessed_buf = NULL;
 		size_t	 unprocessed_size;
 
-		isc_buffer_putmem(dnsasm->current, buf, until_complete);
+		isc__dnsstream_assembler_putmem(dnsasm, buf, until_complete);
 		unprocessed_buf = ((uint8_t *)buf + until_complete);
 		unprocessed_size = buf_size - until_complete;
 
@@ -474,8 +497,8 @@ isc__dnsstream_assembler_incoming_direct_non_empty(
 			 * remaining data into the internal buffer to process it
 			 * later.
 			 */
-			isc_buffer_putmem(dnsasm->current, unprocessed_buf,
-					  unprocessed_size);
+			isc__dnsstream_assembler_putmem(dnsasm, unprocessed_buf,
+							unprocessed_size);
 		}
 
 		return true;
@@ -529,7 +552,7 @@ isc_dnsstream_assembler_incoming(isc_dnsstream_assembler_t *restrict dnsasm,
 			void  *unprocessed_buf = NULL;
 			size_t unprocessed_size;
 
-			isc_buffer_putmem(dnsasm->current, buf, 1);
+			isc__dnsstream_assembler_putmem(dnsasm, buf, 1);
 			unprocessed_buf = (uint8_t *)buf + 1;
 			unprocessed_size = buf_size - 1;
 
@@ -541,9 +564,9 @@ isc_dnsstream_assembler_incoming(isc_dnsstream_assembler_t *restrict dnsasm,
 			}
 
 			if (unprocessed_size > 0) {
-				isc_buffer_putmem(dnsasm->current,
-						  unprocessed_buf,
-						  unprocessed_size);
+				isc__dnsstream_assembler_putmem(
+					dnsasm, unprocessed_buf,
+					unprocessed_size);
 			}
 			/* let's continue processing via the generic path */
 		} else {
@@ -551,7 +574,7 @@ isc_dnsstream_assembler_incoming(isc_dnsstream_assembler_t *restrict dnsasm,
 			 * Put the data into the internal buffer for
 			 * processing.
 			 */
-			isc_buffer_putmem(dnsasm->current, buf, buf_size);
+			isc__dnsstream_assembler_putmem(dnsasm, buf, buf_size);
 		}
 	}
 
@@ -576,6 +599,14 @@ isc_dnsstream_assembler_remaininglength(
 	return isc_buffer_remaininglength(dnsasm->current);
 }
 
+static inline size_t
+isc_dnsstream_assembler_copiedlength(
+	const isc_dnsstream_assembler_t *restrict dnsasm) {
+	REQUIRE(dnsasm != NULL);
+
+	return dnsasm->copied;
+}
+
 static inline void
 isc_dnsstream_assembler_clear(isc_dnsstream_assembler_t *restrict dnsasm) {
 	REQUIRE(dnsasm != NULL);
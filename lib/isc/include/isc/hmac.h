@@ -89,6 +89,18 @@ isc_hmac_init(isc_hmac_t *hmac, const void *key, const size_t keylen,
 isc_result_t
 isc_hmac_reset(isc_hmac_t *hmac);
 
+/**
+ * isc_hmac_copy:
+ * @hmac: HMAC context
+ * @source: HMAC context to copy
+ *
+ * This function copies the state of @source, including its key, into @hmac.
+ * Copying a context set up with isc_hmac_init() is cheaper than setting up
+ * a new one with the same key.
+ */
+isc_result_t
+isc_hmac_copy(isc_hmac_t *hmac, isc_hmac_t *source);
+
 /**
  * isc_hmac_update:
  * @hmac: HMAC context
@@ -58,3 +58,16 @@ isc_httpdurl_loadtime(const isc_httpdurl_t *url);
 
 const isc_time_t *
 isc_httpd_if_modified_since(const isc_httpd_t *httpd);
+
+isc_result_t
+isc_httpd_getparam(const isc_httpd_t *httpd, const char *name,
+		   const char **valuep, size_t *lenp);
+/*%<
+ * Find the parameter 'name' in the query string of the request URL,
+ * and point '*valuep' at its value, which is '*lenp' characters long
+ * and not NUL terminated.
+ *
+ * Returns:
+ *\li	ISC_R_SUCCESS
+ *\li	ISC_R_NOTFOUND	the query string has no such parameter
+ */
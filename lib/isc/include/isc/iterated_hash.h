@@ -13,6 +13,8 @@
 
 #pragma once
 
+#include <stddef.h>
+
 /*
  * The maximal hash length that can be encoded in a name
  * using base32hex.  floor(255/8)*5
@@ -31,6 +33,25 @@ isc_iterated_hash(unsigned char *out, const unsigned int hashalg,
 		  const int saltlength, const unsigned char *in,
 		  const int inlength);
 
+/*
+ * The number of hashes computed at once by isc_iterated_hash_batch().
+ */
+#define ISC_ITERATED_HASH_LANES 8
+
+int
+isc_iterated_hash_batch(unsigned char *const out[],
+			const unsigned int hashalg, const int iterations,
+			const unsigned char *salt, const int saltlength,
+			const unsigned char *const in[], const int inlength[],
+			const size_t count);
+/*
+ * Like isc_iterated_hash(), for the 'count' inputs 'in[i]' of length
+ * 'inlength[i]', whose hashes are stored in 'out[i]'.  The hashes are
+ * computed ISC_ITERATED_HASH_LANES at a time, which is faster than
+ * one by one when there are several names to hash with the same
+ * parameters.
+ */
+
 /*
  * Private
  */
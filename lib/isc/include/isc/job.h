@@ -35,6 +35,7 @@ typedef struct isc_job isc_job_t;
 struct isc_job {
 	isc_job_cb cb;
 	void	  *cbarg;
+	uint64_t   enqueued; /*%< when isc_async_run() queued the job */
 	union {
 		struct cds_wfcq_node wfcq_node;
 		ISC_LINK(isc_job_t) link;
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*! \file isc/lockstat.h
+ * \brief
+ * Contention statistics of the mutexes and the read-write locks.
+ *
+ * A lock is first taken without waiting; only when that fails is the
+ * acquisition passed to the contended path, so the statistics cost
+ * nothing while a lock is free.  When they are enabled, the contended
+ * path counts the acquisition and measures how long it waited, and adds
+ * both to the place in the source where the lock was acquired (the
+ * LOCK(), RDLOCK() or WRLOCK() call).  As each kind of lock is taken in
+ * a few places of its own, this tells apart the node locks, the fetch
+ * context locks, the view locks and so on.
+ *
+ * The statistics are disabled by default.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*% Number of places in the source that can be told apart */
+#define ISC_LOCKSTAT_SITES 1024
+
+typedef enum {
+	isc_lockstattype_mutex = 0,
+	isc_lockstattype_read,
+	isc_lockstattype_write,
+} isc_lockstattype_t;
+
+/*%
+ * The contention at one place in the source.  The times are in
+ * nanoseconds.
+ */
+typedef struct isc_lockstat {
+	const char	  *file;
+	unsigned int	   line;
+	isc_lockstattype_t type;
+	uint64_t	   contended; /*%< acquisitions that had to wait */
+	uint64_t	   wait;      /*%< total time waited */
+	uint64_t	   maxwait;   /*%< longest time waited */
+} isc_lockstat_t;
+
+void
+isc_lockstat_enable(bool enable);
+/*%<
+ * Start or stop collecting the contention statistics.  The statistics
+ * collected so far are kept.
+ */
+
+bool
+isc_lockstat_enabled(void);
+/*%<
+ * Return true if the contention statistics are being collected.
+ */
+
+void
+isc_lockstat_reset(void);
+/*%<
+ * Set the statistics of all the places in the source to zero.
+ */
+
+size_t
+isc_lockstat_get(isc_lockstat_t *stats, size_t nstats);
+/*%<
+ * Fill 'stats' with the statistics of at most 'nstats' places in the
+ * source where the locks have been contended, the places where the
+ * acquisitions waited longest in total first.
+ *
+ * Returns the number of entries filled.
+ *
+ * Requires:
+ *\li	'stats' is not NULL.
+ */
+
+const char *
+isc_lockstattype_totext(isc_lockstattype_t type);
+/*%<
+ * Return "mutex", "read" or "write".
+ */
+
+void
+isc__lockstat_record(const char *file, unsigned int line,
+		     isc_lockstattype_t type, uint64_t wait);
+/*%<
+ * Add a contended acquisition that waited 'wait' nanoseconds to the
+ * statistics of 'file' and 'line'.  For the use of the locks.
+ */
@@ -758,6 +758,15 @@ isc_log_setforcelog(bool v);
  * a single task event.
  */
 
+void
+isc_log_setthreadstream(FILE *stream);
+/*%<
+ * Send the messages that the current thread logs to ISC_LOG_TOFILEDESC
+ * channels to 'stream' instead of the channel's own stream, so that
+ * several threads can each collect their own output.  A NULL 'stream'
+ * ends the redirection.
+ */
+
 void
 isc__log_initialize(void);
 void
@@ -18,6 +18,7 @@
 #include <isc/job.h>
 #include <isc/mem.h>
 #include <isc/refcount.h>
+#include <isc/result.h>
 #include <isc/types.h>
 
 typedef void (*isc_job_cb)(void *);
@@ -34,6 +35,29 @@ static inline isc_loop_t *
 isc_loop(void) {
 	return isc__loop_local;
 }
+/*%
+ * Statistics of a loop, see isc_loop_getstats().  The times are in
+ * nanoseconds.
+ */
+typedef struct isc_loopstats {
+	uint64_t busy; /*%< time spent running callbacks */
+	uint64_t idle; /*%< time spent waiting for events */
+
+	uint64_t jobs;	     /*%< isc_job_run() jobs that have run */
+	uint64_t jobsqueued; /*%< isc_job_run() jobs waiting to run */
+
+	uint64_t asyncs;	/*%< isc_async_run() jobs that have run */
+	uint64_t asyncsqueued;	/*%< isc_async_run() jobs waiting to run */
+	uint64_t asyncwait;	/*%< total time the jobs waited to run */
+	uint64_t asyncmaxwait;	/*%< longest time a job waited to run */
+	uint64_t asyncwakeups;	/*%< times the loop was woken up for them */
+
+	uint64_t works;	       /*%< isc_work_enqueue() work started */
+	uint64_t worksqueued;  /*%< work waiting for a worker thread */
+	uint64_t workwait;     /*%< total time the work waited to start */
+	uint64_t workmaxwait;  /*%< longest time the work waited to start */
+} isc_loopstats_t;
+
 void
 isc_loopmgr_create(isc_mem_t *mctx, uint32_t nloops, isc_loopmgr_t **loopmgrp);
 /*%<
@@ -213,6 +237,60 @@ isc_loop_now(isc_loop_t *loop);
  * \li 'loop' is a valid loop.
  */
 
+void
+isc_loop_getstats(isc_loop_t *loop, isc_loopstats_t *stats);
+/*%<
+ * Fill 'stats' with the statistics of 'loop': how much of its time
+ * the loop has been busy, and how many jobs and work items it has queued
+ * and how long they waited before they were run.  This can be called
+ * from any thread; the counters are read one at a time, so they are not
+ * an atomic snapshot.
+ *
+ * The busy and idle times are measured by libuv, and are only available
+ * with libuv 1.39.0 or newer; they are 0 otherwise.
+ *
+ * Requires:
+ *
+ * \li 'loop' is a valid loop.
+ * \li 'stats' is not NULL.
+ */
+
+isc_result_t
+isc_loopmgr_setaffinity(isc_loopmgr_t *loopmgr, bool enabled);
+/*%<
+ * If 'enabled' is true, bind the thread of each loop in 'loopmgr' to a
+ * CPU of its own; otherwise let the loop threads run on all the CPUs the
+ * process was started on again.  The CPUs are taken in the order of
+ * isc_os_cpulist(), so the loops fill the CPUs of one NUMA node before
+ * moving to the next one, and the memory that each loop allocates and
+ * touches first stays on its node.  If there are more loops than CPUs,
+ * the CPUs are reused from the start.
+ *
+ * The CPUs are assigned immediately, see isc_loop_getcpu(), but each
+ * thread is bound later from its own loop.
+ *
+ * Requires:
+ *
+ * \li 'loopmgr' is a valid loop manager.
+ *
+ * Returns:
+ *
+ * \li #ISC_R_SUCCESS
+ * \li #ISC_R_NOTIMPLEMENTED if the CPUs cannot be determined on this
+ *     system.
+ */
+
+int
+isc_loop_getcpu(isc_loop_t *loop);
+/*%<
+ * Return the CPU the thread of 'loop' is bound to, or -1 if it is not
+ * bound, see isc_loopmgr_setaffinity().
+ *
+ * Requires:
+ *
+ * \li 'loop' is a valid loop.
+ */
+
 bool
 isc_loop_shuttingdown(isc_loop_t *loop);
 /*%<
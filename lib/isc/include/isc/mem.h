@@ -229,6 +229,21 @@ isc__mem_create_arena(isc_mem_t **_ISC_MEM_FLARG);
  * mctxp != NULL && *mctxp == NULL */
 /*@}*/
 
+#define isc_mem_create_threadaffine(cp) \
+	isc__mem_create_threadaffine((cp)_ISC_MEM_FILELINE)
+void
+isc__mem_create_threadaffine(isc_mem_t **_ISC_MEM_FLARG);
+/*!<
+ * \brief Create a memory context for memory that is allocated and freed
+ * on all the threads.  Each thread allocates from its own jemalloc arena
+ * through its own tcache, shared by all such contexts, so memory that is
+ * freed on the thread that allocated it never crosses arenas.  Threads
+ * other than the loop threads, and all the threads when jemalloc is not
+ * available, allocate as from a context created with isc_mem_create().
+ *
+ * Requires:
+ * mctxp != NULL && *mctxp == NULL */
+
 isc_result_t
 isc_mem_arena_set_muzzy_decay_ms(isc_mem_t *mctx, const ssize_t decay_ms);
 
@@ -300,6 +315,14 @@ isc_mem_inuse(isc_mem_t *mctx);
  * allocated from the system but not yet used.
  */
 
+uint64_t
+isc_mem_allocations(isc_mem_t *mctx);
+/*%<
+ * Get the number of allocations made from 'mctx' since it was created,
+ * including reallocations and the items its memory pools had to
+ * allocate.
+ */
+
 bool
 isc_mem_isovermem(isc_mem_t *mctx);
 /*%<
@@ -308,6 +331,37 @@ isc_mem_isovermem(isc_mem_t *mctx);
  * the mark.
  */
 
+/*%
+ * The memory pressure returned by isc_mem_pressure() when the memory
+ * context is over memory.
+ */
+#define ISC_MEM_PRESSURE_MAX 100
+
+unsigned int
+isc_mem_pressure(isc_mem_t *mctx);
+/*%<
+ * Return how tight the memory of 'mctx' is, from 0 to
+ * #ISC_MEM_PRESSURE_MAX.  The pressure of a memory context rises
+ * linearly as its use grows from the low to the high water mark, and
+ * stays at #ISC_MEM_PRESSURE_MAX while isc_mem_isovermem() is true.  The
+ * pressure of the process, as last measured by isc_mem_checkpressure(),
+ * applies to all the memory contexts.
+ *
+ * The users of the memory contexts can then shed their memory gradually
+ * as the pressure rises, rather than all at once when the context
+ * becomes over memory.
+ */
+
+void
+isc_mem_checkpressure(void);
+/*%<
+ * Measure the memory pressure of the process, which rises linearly as
+ * its resident memory grows from 7/8ths to all of the memory limit of
+ * its control group.  There is no pressure when the limit is unknown.
+ *
+ * This is expected to be called periodically.
+ */
+
 void
 isc_mem_clearwater(isc_mem_t *mctx);
 void
@@ -411,6 +465,31 @@ isc__mempool_create(isc_mem_t *restrict mctx, const size_t element_size,
  *\li	#ISC_R_SUCCESS		-- all is well.
  */
 
+#define isc_mempool_create_shared(c, s, mp) \
+	isc__mempool_create_shared((c), (s), (mp)_ISC_MEM_FILELINE)
+void
+isc__mempool_create_shared(isc_mem_t *restrict mctx, const size_t element_size,
+			   isc_mempool_t **mpctxp _ISC_MEM_FLARG);
+/*%<
+ * Create a memory pool that can be used from all the loops, unlike the
+ * pools created with isc_mempool_create() that must only be used from
+ * one thread.  Each loop keeps the free items in two magazines of its
+ * own, and exchanges full and empty magazines with a locked depot
+ * shared by the loops, so an item can be freed on another loop than the
+ * one it was allocated on.  Outside of the loops, the items are
+ * allocated from and freed to the memory context directly.
+ *
+ * For these pools, the freemax is the number of free items that the
+ * depot keeps, which defaults to 64 items for each loop; the fillcount
+ * is not used, and isc_mempool_getfreecount() only counts the items in
+ * the depot.
+ *
+ * Requires:
+ *\li	mctx is a valid memory context.
+ *\li	size > 0
+ *\li	mpctxp != NULL and *mpctxp == NULL
+ */
+
 #define isc_mempool_destroy(mp) isc__mempool_destroy((mp)_ISC_MEM_FILELINE)
 void
 isc__mempool_destroy(isc_mempool_t **restrict mpctxp _ISC_MEM_FLARG);
@@ -23,3 +23,18 @@ isc_meminfo_totalphys(void);
  * Return total available physical memory in bytes, or 0 if this cannot
  * be determined
  */
+
+uint64_t
+isc_meminfo_rss(void);
+/*%<
+ * Return the resident memory of the process in bytes, or 0 if this
+ * cannot be determined
+ */
+
+uint64_t
+isc_meminfo_limit(void);
+/*%<
+ * Return the memory limit of the control group of the process in bytes:
+ * its "memory.high" or, if that isn't set, its "memory.max".  Return 0
+ * if there is no limit or it cannot be determined.
+ */
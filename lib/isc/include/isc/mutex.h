@@ -15,6 +15,7 @@
 
 /*! \file */
 
+#include <errno.h>
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -60,16 +61,29 @@ typedef pthread_mutex_t isc_mutex_t;
 
 extern pthread_mutexattr_t isc__mutex_init_attr;
 
+int
+isc__mutex_lock_contended(pthread_mutex_t *mp, const char *file,
+			  unsigned int line);
+
 #define isc__mutex_init(mp)                                               \
 	{                                                                 \
 		int _ret = pthread_mutex_init(mp, &isc__mutex_init_attr); \
 		PTHREADS_RUNTIME_CHECK(pthread_mutex_init, _ret);         \
 	}
 
-#define isc__mutex_lock(mp)                                       \
-	{                                                         \
-		int _ret = pthread_mutex_lock(mp);                \
-		PTHREADS_RUNTIME_CHECK(pthread_mutex_lock, _ret); \
+/*
+ * The lock is tried first, so that only the contended acquisitions go
+ * through isc__mutex_lock_contended(), which counts them in the lock
+ * contention statistics (see isc/lockstat.h).
+ */
+#define isc__mutex_lock(mp)                                                 \
+	{                                                                   \
+		int _ret = pthread_mutex_trylock(mp);                       \
+		if (_ret == EBUSY) {                                        \
+			_ret = isc__mutex_lock_contended(mp, __FILE__,      \
+							 __LINE__);         \
+		}                                                           \
+		PTHREADS_RUNTIME_CHECK(pthread_mutex_lock, _ret);           \
 	}
 
 #define isc__mutex_unlock(mp)                                       \
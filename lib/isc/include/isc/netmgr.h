@@ -17,6 +17,7 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <isc/histo.h>
 #include <isc/mem.h>
 #include <isc/refcount.h>
 #include <isc/region.h>
@@ -326,6 +327,30 @@ isc_nm_routeconnect(isc_nm_t *mgr, isc_nm_cb_t cb, void *cbarg);
  * are not supported.
  */
 
+isc_result_t
+isc_nm_listenxdp(isc_nm_t *mgr, uint32_t workers, const char *ifname,
+		 isc_sockaddr_t *iface, isc_nm_recv_cb_t cb, void *cbarg,
+		 isc_nmsocket_t **sockp);
+/*%<
+ * Start receiving UDP packets sent to 'iface' on the network interface
+ * 'ifname' over AF_XDP sockets, bypassing the kernel network stack.  An XDP
+ * program is attached to the interface that redirects the matching packets
+ * received on the queue 'n' to the AF_XDP socket of the loop 'n' and passes
+ * all the other traffic to the kernel, so a regular UDP listener should be
+ * opened for the same address to serve the packets arriving on the other
+ * queues.
+ *
+ * The handles passed to 'cb' behave as the UDP handles, and
+ * isc_nm_socket_type() reports them as such.  The responses are sent
+ * directly on the interface and they must fit into its MTU.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS on success
+ *\li	#ISC_R_NOTIMPLEMENTED if AF_XDP support is not compiled in
+ *\li	#ISC_R_NOTFOUND if the interface doesn't exist
+ *\li	any other error from the socket or bpf(2) operations
+ */
+
 isc_result_t
 isc_nm_listenproxyudp(isc_nm_t *mgr, uint32_t workers, isc_sockaddr_t *iface,
 		      isc_nm_recv_cb_t cb, void *cbarg, isc_nmsocket_t **sockp);
@@ -352,6 +377,52 @@ isc_nm_stoplistening(isc_nmsocket_t *sock);
  * Stop listening on socket 'sock'.
  */
 
+size_t
+isc_nm_listenerfds(isc_nmsocket_t *listener, int *fds, size_t size);
+/*%<
+ * Store up to 'size' descriptors of the UDP or TCP sockets underlying
+ * 'listener' in 'fds', and return how many of them there are.  With the
+ * load-balanced sockets, there is one socket per child of the listener.
+ *
+ * The descriptors remain owned by the listener; they are meant to be
+ * handed over to another process with isc_nm_inheritsocket().
+ *
+ * Requires:
+ * \li	'listener' is a valid listening socket.
+ */
+
+isc_result_t
+isc_nm_inheritsocket(isc_nm_t *mgr, int fd);
+/*%<
+ * Take over the bound UDP or listening TCP socket 'fd', received from
+ * another process.  The next UDP or TCP listener created for the address
+ * 'fd' is bound to uses it instead of opening and binding a new socket.
+ *
+ * This must be called before the listeners are created; the sockets that
+ * are not used are closed by isc_nm_inheritdone().
+ *
+ * Requires:
+ * \li	'mgr' is a valid netmgr.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_FAMILYNOSUPPORT	'fd' isn't an IPv4 or IPv6 socket
+ * \li	#ISC_R_NOTIMPLEMENTED	'fd' isn't a datagram or stream socket
+ * \li	Any error from getsockname() or getsockopt().
+ *
+ * On failure, 'fd' is closed.
+ */
+
+void
+isc_nm_inheritdone(isc_nm_t *mgr);
+/*%<
+ * Close the sockets passed to isc_nm_inheritsocket() that have not been
+ * taken by a listener.
+ *
+ * Requires:
+ * \li	'mgr' is a valid netmgr.
+ */
+
 void
 isc_nm_read(isc_nmhandle_t *handle, isc_nm_recv_cb_t cb, void *cbarg);
 /*
@@ -436,6 +507,19 @@ isc_nm_tcpconnect(isc_nm_t *mgr, isc_sockaddr_t *local, isc_sockaddr_t *peer,
  * 'cb'.
  */
 
+void
+isc_nm_listener_setfastopen(isc_nmsocket_t *listener, unsigned int qlen);
+/*%<
+ * Enable TCP Fast Open on the TCP sockets underlying 'listener', with at
+ * most 'qlen' connections carrying data in the SYN pending; 0 disables
+ * it.  The option is set by each listening socket's own loop, shortly
+ * after the call.  The listeners not over TCP are left alone.
+ *
+ * Requires:
+ * \li	'listener' is a valid listening socket;
+ * \li	the caller runs on the main loop.
+ */
+
 isc_result_t
 isc_nm_listenstreamdns(isc_nm_t *mgr, uint32_t workers, isc_sockaddr_t *iface,
 		       isc_nm_recv_cb_t recv_cb, void *recv_cbarg,
@@ -591,6 +675,62 @@ isc_nm_maxudp(isc_nm_t *mgr, uint32_t maxudp);
  * size.
  */
 
+void
+isc_nm_setudpgso(isc_nm_t *mgr, bool enabled);
+/*%<
+ * Enable or disable coalescing of the batched UDP responses for the same
+ * peer into UDP generic segmentation offload (UDP_SEGMENT) sends.  The
+ * support is detected when the listening sockets are opened, so the
+ * change only applies to the sockets opened afterwards.
+ *
+ * Requires:
+ * \li	'mgr' is a valid netmgr.
+ */
+
+void
+isc_nm_setudpcpusteering(isc_nm_t *mgr, bool enabled);
+/*%<
+ * Enable or disable steering of the datagrams received on the load-balanced
+ * UDP listeners by the receiving CPU: the datagrams processed by the CPU 'n'
+ * are delivered to the loop 'n' modulo the number of loops, instead of the
+ * loop picked by the kernel by the hash of the source and destination
+ * address.  Only the listeners opened afterwards are affected.
+ *
+ * Requires:
+ * \li	'mgr' is a valid netmgr.
+ */
+
+void
+isc_nm_settcpfastopen(isc_nm_t *mgr, bool enabled);
+/*%<
+ * Enable or disable TCP Fast Open on the outgoing TCP connections: the
+ * first data sent on a connection goes in the SYN when the kernel holds
+ * a Fast Open cookie from an earlier connection to the same server.  Only
+ * the connections opened afterwards are affected.
+ *
+ * Requires:
+ * \li	'mgr' is a valid netmgr.
+ */
+
+/*%
+ * The bounds of the HTTP/2 flow-control window: the default window size
+ * and the largest one allowed by the protocol.
+ */
+#define ISC_NM_HTTP_WINDOW_MIN UINT16_MAX
+#define ISC_NM_HTTP_WINDOW_MAX INT32_MAX
+
+void
+isc_nm_sethttpwindow(isc_nm_t *mgr, uint32_t window);
+/*%<
+ * Set the HTTP/2 flow-control window advertised to the peers, for each
+ * stream and for the whole connection; it is clamped to the
+ * ISC_NM_HTTP_WINDOW_MIN..ISC_NM_HTTP_WINDOW_MAX range.  Only the HTTP/2
+ * sessions established afterwards are affected.
+ *
+ * Requires:
+ * \li	'mgr' is a valid netmgr.
+ */
+
 void
 isc_nm_setstats(isc_nm_t *mgr, isc_stats_t *stats);
 /*%<
@@ -603,6 +743,32 @@ isc_nm_setstats(isc_nm_t *mgr, isc_stats_t *stats);
  *	full range of socket-related stats counter numbers.
  */
 
+void
+isc_nm_setloopstats(isc_nm_t *mgr, isc_stats_t *stats);
+/*%<
+ * Set a statistics counter set 'stats' for 'mgr' counting the datagrams
+ * received by the UDP listeners on each loop.
+ *
+ * Requires:
+ *\li	'mgr' is valid and doesn't have loop stats already set.
+ *
+ *\li	stats is a valid set of statistics counters with one counter
+ *	per loop.
+ */
+
+void
+isc_nm_getrecvbatch(isc_nm_t *mgr, uint32_t tid, isc_histo_t **hgp);
+/*%<
+ * Add the distribution of the number of datagrams received by the UDP
+ * listeners of the loop 'tid' per read (one recvmmsg(2) call, or all the
+ * datagrams read on a wakeup when recvmmsg(2) is not used) to '*hgp',
+ * creating it if it is NULL.
+ *
+ * Requires:
+ *\li	'mgr' is valid and 'tid' is less than the number of loops.
+ *\li	'hgp' is not NULL.
+ */
+
 isc_result_t
 isc_nm_checkaddr(const isc_sockaddr_t *addr, isc_socktype_t type);
 /*%<
@@ -45,3 +45,19 @@ isc_os_umask(void);
 /*%<
  * Return umask of the current process as initialized at the program start
  */
+
+unsigned int
+isc_os_cpulist(int *cpus, unsigned int size);
+/*%<
+ * Store up to 'size' of the CPUs the process was allowed to run on at the
+ * program start in 'cpus', grouped by their NUMA node and in ascending
+ * order within a node, and return how many were stored.
+ *
+ * Returns 0 if the CPUs cannot be determined on this system.
+ */
+
+int
+isc_os_cpunode(int cpu);
+/*%<
+ * Return the NUMA node of the CPU 'cpu', or -1 if it is not known.
+ */
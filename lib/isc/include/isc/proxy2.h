@@ -531,6 +531,10 @@ isc_proxy2_header_handle_directly(const isc_region_t *restrict header_data,
  * complete header and associated follow-up data is expected (for
  * example, when datagram transports are used, like UDP).
  *
+ * The headers carrying the addresses of a TCP or UDP connection over
+ * IPv4 or IPv6 and no TLVs, which are the ones sent by most proxies
+ * and load balancers, are decoded without setting up a handler.
+ *
  * Requires:
  *\li	'header_data' is not NULL;
  *\li	'cb' is not NULL.
@@ -53,6 +53,19 @@
  * synchronization between multiple threads (see urcu/wfcqueue.h for
  * detailed description).
  */
+/*%
+ * The share of a per-loop quota owned by one loop, on its own cache line.
+ * 'softfull' is set while 'used' has reached the share of the soft quota.
+ */
+typedef struct isc__quotashard {
+	atomic_uint_fast32_t max;
+	atomic_uint_fast32_t soft;
+	atomic_uint_fast32_t used;
+	atomic_uint_fast32_t softfull;
+	uint8_t		     __padding[ISC_OS_CACHELINE_SIZE -
+				       4 * sizeof(atomic_uint_fast32_t)];
+} isc__quotashard_t;
+
 STATIC_ASSERT(ISC_OS_CACHELINE_SIZE >= sizeof(struct __cds_wfcq_head),
 	      "ISC_OS_CACHELINE_SIZE smaller than "
 	      "sizeof(struct __cds_wfcq_head)");
@@ -68,6 +81,16 @@ struct isc_quota {
 		struct cds_wfcq_tail tail;
 	} jobs;
 	ISC_LINK(isc_quota_t) link;
+
+	/*%
+	 * Set by isc_quota_initperloop(): 'max' and 'soft' are split
+	 * between the loops and 'used' is unused.  'nsoftfull' counts
+	 * the shards with 'softfull' set.
+	 */
+	isc_mem_t	    *mctx;
+	unsigned int	     nshards;
+	isc__quotashard_t   *shards;
+	atomic_uint_fast32_t nsoftfull;
 };
 
 void
@@ -76,6 +99,19 @@ isc_quota_init(isc_quota_t *quota, unsigned int max);
  * Initialize a quota object.
  */
 
+void
+isc_quota_initperloop(isc_quota_t *quota, isc_mem_t *mctx, unsigned int max);
+/*%<
+ * Initialize a quota object whose maximum is split into a share for
+ * each loop, so that the loops acquiring and releasing it don't contend
+ * on a single counter.  A loop whose share is used up takes the spare
+ * capacity of the other loops, so the quota as a whole behaves like one
+ * initialized with isc_quota_init().
+ *
+ * The soft quota is split the same way.  The usage of all the loops is
+ * only added up to check it once a loop has reached its share of it.
+ */
+
 void
 isc_quota_destroy(isc_quota_t *quota);
 /*%<
@@ -112,6 +148,25 @@ isc_quota_getused(isc_quota_t *quota);
  * Get the current usage of quota.
  */
 
+unsigned int
+isc_quota_getloops(isc_quota_t *quota);
+/*%<
+ * Get the number of loops a per-loop quota is split between, or 0 if
+ * the quota is not split.
+ */
+
+void
+isc_quota_getloopusage(isc_quota_t *quota, unsigned int loop,
+		       unsigned int *usedp, unsigned int *maxp);
+/*%<
+ * Get the usage and the share of the maximum of 'loop' in a per-loop
+ * quota.  The usage includes the units taken from the share by other
+ * loops whose own share was used up.
+ *
+ * Requires:
+ *\li	'loop' is less than isc_quota_getloops(quota).
+ */
+
 #define isc_quota_acquire(quota) isc_quota_acquire_cb(quota, NULL, NULL, NULL)
 isc_result_t
 isc_quota_acquire_cb(isc_quota_t *quota, isc_job_t *job, isc_job_cb cb,
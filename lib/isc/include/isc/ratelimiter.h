@@ -40,7 +40,9 @@ struct isc_rlevent {
 	bool		   canceled;
 	isc_job_cb	   cb;
 	void		  *arg;
+	uint32_t	   group;
 	ISC_LINK(isc_rlevent_t) link;
+	ISC_LINK(isc_rlevent_t) glink;
 };
 
 /*****
@@ -79,6 +81,14 @@ isc_ratelimiter_setpushpop(isc_ratelimiter_t *restrict rl, const bool pushpop);
  * first in - first out mode (default).
  */
 
+void
+isc_ratelimiter_setburst(isc_ratelimiter_t *restrict rl, const uint32_t burst);
+/*%<
+ * Set the maximum number of events of the same group that are
+ * dispatched together, counting as a single event against the rate.
+ * If 'burst' is zero or one, the events are not grouped (the default).
+ */
+
 isc_result_t
 isc_ratelimiter_enqueue(isc_ratelimiter_t *restrict rl,
 			isc_loop_t *restrict loop, isc_job_cb cb, void *arg,
@@ -100,6 +110,22 @@ isc_ratelimiter_enqueue(isc_ratelimiter_t *restrict rl,
  *\li	'rlep' is non NULL and '*rlep' is NULL.
  */
 
+isc_result_t
+isc_ratelimiter_enqueuegroup(isc_ratelimiter_t *restrict rl,
+			     isc_loop_t *restrict loop, uint32_t group,
+			     isc_job_cb cb, void *arg, isc_rlevent_t **rlep);
+/*%<
+ * Like isc_ratelimiter_enqueue(), but when an event of 'group' is
+ * dispatched, the other queued events of the same group, up to the
+ * burst set with isc_ratelimiter_setburst(), are dispatched along with
+ * it.  This is used to send the messages queued for the same server in
+ * a single burst.
+ *
+ * The groups are only told apart by a hash of 'group', so the events
+ * of different groups may occasionally be dispatched together.  A
+ * 'group' of zero is never grouped.
+ */
+
 isc_result_t
 isc_ratelimiter_dequeue(isc_ratelimiter_t *restrict rl,
 			isc_rlevent_t **rleventp);
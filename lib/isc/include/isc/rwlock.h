@@ -28,6 +28,7 @@ typedef enum {
 } isc_rwlocktype_t;
 
 #if USE_PTHREAD_RWLOCK
+#include <errno.h>
 #include <pthread.h>
 
 /*
@@ -76,16 +77,32 @@ typedef pthread_rwlock_t isc__rwlock_t;
 		PTHREADS_RUNTIME_CHECK(pthread_rwlock_init, _ret); \
 	}
 
+int
+isc__rwlock_lock_contended(pthread_rwlock_t *rwl, isc_rwlocktype_t type,
+			   const char *file, unsigned int line);
+/*%<
+ * Wait for 'rwl' after it could not be taken at once, and count the wait
+ * in the lock contention statistics (see isc/lockstat.h).
+ */
+
 #define isc__rwlock_lock(rwl, type)                                          \
 	{                                                                    \
 		int _ret;                                                    \
 		switch (type) {                                              \
 		case isc_rwlocktype_read:                                    \
-			_ret = pthread_rwlock_rdlock(rwl);                   \
+			_ret = pthread_rwlock_tryrdlock(rwl);                \
+			if (_ret == EBUSY || _ret == EAGAIN) {               \
+				_ret = isc__rwlock_lock_contended(           \
+					rwl, type, __FILE__, __LINE__);      \
+			}                                                    \
 			PTHREADS_RUNTIME_CHECK(pthread_rwlock_rdlock, _ret); \
 			break;                                               \
 		case isc_rwlocktype_write:                                   \
-			_ret = pthread_rwlock_wrlock(rwl);                   \
+			_ret = pthread_rwlock_trywrlock(rwl);                \
+			if (_ret == EBUSY) {                                 \
+				_ret = isc__rwlock_lock_contended(           \
+					rwl, type, __FILE__, __LINE__);      \
+			}                                                    \
 			PTHREADS_RUNTIME_CHECK(pthread_rwlock_rwlock, _ret); \
 			break;                                               \
 		default:                                                     \
@@ -183,10 +200,18 @@ void
 isc_rwlock_init(isc_rwlock_t *rwl);
 
 void
-isc_rwlock_rdlock(isc_rwlock_t *rwl);
+isc__rwlock_rdlock(isc_rwlock_t *rwl, const char *file, unsigned int line);
 
 void
-isc_rwlock_wrlock(isc_rwlock_t *rwl);
+isc__rwlock_wrlock(isc_rwlock_t *rwl, const char *file, unsigned int line);
+/*%<
+ * Take 'rwl'; when the acquisition has to wait, the wait is counted in
+ * the lock contention statistics (see isc/lockstat.h) of 'file' and
+ * 'line'.
+ */
+
+#define isc_rwlock_rdlock(rwl) isc__rwlock_rdlock(rwl, __FILE__, __LINE__)
+#define isc_rwlock_wrlock(rwl) isc__rwlock_wrlock(rwl, __FILE__, __LINE__)
 
 isc_result_t
 isc_rwlock_tryrdlock(isc_rwlock_t *rwl);
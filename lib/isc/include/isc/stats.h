@@ -80,6 +80,18 @@ enum {
 	isc_sockstatscounter_tcp4clients,
 	isc_sockstatscounter_tcp6clients,
 
+	isc_sockstatscounter_udp4gsosegs,
+	isc_sockstatscounter_udp6gsosegs,
+
+	isc_sockstatscounter_tcp4fastopen,
+	isc_sockstatscounter_tcp6fastopen,
+
+	isc_sockstatscounter_tlshandshake,
+	isc_sockstatscounter_tlsresumed,
+
+	isc_sockstatscounter_streammsgs,
+	isc_sockstatscounter_streamcopied,
+
 	isc_sockstatscounter_max,
 };
 
@@ -105,6 +117,26 @@ isc_stats_create(isc_mem_t *mctx, isc_stats_t **statsp, int ncounters);
  *\li	'statsp' != NULL && '*statsp' == NULL.
  */
 
+void
+isc_stats_createperloop(isc_mem_t *mctx, isc_stats_t **statsp,
+			int ncounters);
+/*%<
+ * Like isc_stats_create(), but each loop counts into its own copy of
+ * the counters, so frequently updated counters don't bounce a cache
+ * line between threads.  Reading a counter adds up all the copies.
+ * isc_stats_set() only adjusts the copy that isn't owned by any loop,
+ * so the updates made concurrently by the loops are added to the new
+ * value rather than lost, and a counter updated with
+ * isc_stats_update_if_greater() must not be updated in any other way.
+ *
+ * Requires:
+ *\li	The loop manager has been created, so isc_tid_count() is known.
+ *
+ *\li	'mctx' must be a valid memory context.
+ *
+ *\li	'statsp' != NULL && '*statsp' == NULL.
+ */
+
 void
 isc_stats_attach(isc_stats_t *stats, isc_stats_t **statsp);
 /*%<
@@ -147,6 +179,18 @@ isc_stats_increment(isc_stats_t *stats, isc_statscounter_t counter);
  *	on creation.
  */
 
+void
+isc_stats_add(isc_stats_t *stats, isc_statscounter_t counter, uint64_t value);
+/*%<
+ * Add 'value' to the counter-th counter of stats.
+ *
+ * Requires:
+ *\li	'stats' is a valid isc_stats_t.
+ *
+ *\li	counter is less than the maximum available ID for the stats specified
+ *	on creation.
+ */
+
 void
 isc_stats_decrement(isc_stats_t *stats, isc_statscounter_t counter);
 /*%<
@@ -194,7 +238,9 @@ isc_stats_update_if_greater(isc_stats_t *stats, isc_statscounter_t counter,
  * Atomically assigns 'value' to 'counter' if value > counter.
  *
  * Requires:
- *\li	'stats' is a valid isc_stats_t.
+ *\li	'stats' is a valid isc_stats_t.  If it was created with
+ *	isc_stats_createperloop(), 'counter' is only ever updated with
+ *	this function.
  *
  *\li	counter is less than the maximum available ID for the stats specified
  *	on creation.
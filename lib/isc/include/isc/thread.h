@@ -51,4 +51,16 @@ isc_thread_yield(void);
 void
 isc_thread_setname(isc_thread_t thread, const char *name);
 
+isc_result_t
+isc_thread_setaffinity(int cpu);
+/*%<
+ * Bind the calling thread to the CPU 'cpu' or, if 'cpu' is -1, let it run
+ * on all the CPUs the process was started on again.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOTIMPLEMENTED if the threads cannot be bound on this system
+ *\li	other results converted from the errno
+ */
+
 #define isc_thread_self (uintptr_t)pthread_self
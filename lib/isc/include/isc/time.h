@@ -165,6 +165,12 @@ isc_time_monotonic(void);
  * Returns the system's monotonic time in linear nanoseconds.
  */
 
+isc_nanosecs_t
+isc_time_threadcpu(void);
+/*%<
+ * Returns the CPU time used by the calling thread in linear nanoseconds.
+ */
+
 isc_time_t
 isc_time_now(void);
 /*%<
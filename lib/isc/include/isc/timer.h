@@ -97,6 +97,28 @@ isc_timer_create(isc_loop_t *loop, isc_job_cb cb, void *cbarg,
  *\li	'*timerp' is attached to the newly created timer
  */
 
+void
+isc_timer_create_coarse(isc_loop_t *loop, isc_job_cb cb, void *cbarg,
+			isc_timer_t **timerp);
+/*%<
+ * Like isc_timer_create(), but the timer is kept in the timing wheel of
+ * 'loop' instead of having a libuv timer of its own: starting and
+ * stopping it costs the same no matter how many timers are running, and
+ * it fires on the first loop iteration after it has expired.  Use it for
+ * the timeouts that are numerous, usually stopped before they fire, and
+ * need no better than millisecond precision.
+ *
+ * Requires:
+ *
+ *\li	'loop' is a valid manager
+ *\li	'cb' is a valid job
+ *\li	'timerp' is a valid pointer, and *timerp == NULL
+ *
+ * Ensures:
+ *
+ *\li	'*timerp' is attached to the newly created timer
+ */
+
 void
 isc_timer_stop(isc_timer_t *timer);
 /*%<
@@ -182,6 +182,31 @@ isc_tlsctx_session_tickets(isc_tlsctx_t *ctx, const bool use);
  * \li	'ctx' != NULL.
  */
 
+isc_result_t
+isc_tlsctx_load_ticket_keys(isc_tlsctx_t *ctx, const char *keyfile,
+			    uint32_t rotation);
+/*%<
+ * Encrypt the session tickets issued by the server TLS context 'ctx'
+ * with keys derived from the secret read from 'keyfile', rotated every
+ * 'rotation' seconds.  The keys only depend on the secret and on the
+ * time, so the servers sharing the file accept each other's tickets.
+ * The tickets encrypted with the keys of the previous period are
+ * accepted and renewed.
+ *
+ * The session ID context of 'ctx' is also derived from the secret, as
+ * the sessions can only be resumed within the same context.
+ *
+ * Requires:
+ * \li	'ctx' != NULL;
+ * \li	'keyfile' != NULL;
+ * \li	'rotation' > 0.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_FILENOTFOUND - 'keyfile' can't be read;
+ * \li	#ISC_R_RANGE - 'keyfile' holds less than 32 or more than 1024 bytes.
+ */
+
 isc_tls_t *
 isc_tls_create(isc_tlsctx_t *ctx);
 /*%<
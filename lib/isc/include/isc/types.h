@@ -98,6 +98,7 @@ typedef enum isc_nmsocket_type {
 	isc_nm_streamdnssocket = 1 << 5,
 	isc_nm_proxystreamsocket = 1 << 6,
 	isc_nm_proxyudpsocket = 1 << 7,
+	isc_nm_xdpsocket = 1 << 8,
 	isc_nm_maxsocket,
 
 	isc_nm_udplistener, /* Aggregate of nm_udpsocks */
@@ -106,7 +107,8 @@ typedef enum isc_nmsocket_type {
 	isc_nm_httplistener,
 	isc_nm_streamdnslistener,
 	isc_nm_proxystreamlistener,
-	isc_nm_proxyudplistener
+	isc_nm_proxyudplistener,
+	isc_nm_xdplistener /* Aggregate of nm_xdpsocks */
 } isc_nmsocket_type;
 
 typedef isc_nmsocket_type isc_nmsocket_type_t;
@@ -21,14 +21,36 @@ typedef void (*isc_work_cb)(void *arg);
 typedef void (*isc_after_work_cb)(void *arg);
 typedef struct isc_work isc_work_t;
 
+/*%
+ * Work priority classes.  The worker threads always take the pending
+ * latency-sensitive work first, and at least one worker is kept free of
+ * bulk work whenever there are two or more, so that long-running work
+ * like zone loads and dumps can't hold up the short work that a client
+ * or a timer is waiting for.
+ */
+typedef enum isc_workprio {
+	ISC_WORK_LATENCY = 0,
+	ISC_WORK_BULK = 1,
+	ISC_WORK_MAXPRIO = 2,
+} isc_workprio_t;
+
 void
 isc_work_enqueue(isc_loop_t *loop, isc_work_cb work_cb,
 		 isc_after_work_cb after_work_cb, void *cbarg);
+void
+isc_work_enqueue_bulk(isc_loop_t *loop, isc_work_cb work_cb,
+		      isc_after_work_cb after_work_cb, void *cbarg);
 /*%<
- * Schedules work to be handled by the libuv thread pool (see uv_work_t).
- * The function specified in `work_cb` will be run by a thread in the
- * thread pool; when complete, the `after_work_cb` function will run
- * in 'loop' to inform the caller that the work was completed.
+ * Schedules work to be handled by the worker thread pool of the loop
+ * manager. The function specified in `work_cb` will be run by a worker
+ * thread; when complete, the `after_work_cb` function will run in
+ * 'loop' to inform the caller that the work was completed.
+ *
+ * isc_work_enqueue() queues latency-sensitive work, and
+ * isc_work_enqueue_bulk() queues bulk work (see isc_workprio_t).
+ *
+ * Each loop has its own work queue, served by its own worker thread; an
+ * idle worker steals the work queued on the other loops.
  *
  * Requires:
  * \li 'loop' is a valid event loop.
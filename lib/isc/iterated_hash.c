@@ -13,11 +13,13 @@
 
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 
 #include <openssl/err.h>
 #include <openssl/opensslv.h>
 
 #include <isc/crypto.h>
+#include <isc/endian.h>
 #include <isc/iterated_hash.h>
 #include <isc/thread.h>
 #include <isc/util.h>
@@ -171,3 +173,181 @@ isc__iterated_hash_shutdown(void) {
 }
 
 #endif /* HAVE_SHA1_INIT */
+
+/*
+ * Multi-buffer SHA-1 for isc_iterated_hash_batch().
+ *
+ * The states of ISC_ITERATED_HASH_LANES hash computations are kept in
+ * arrays indexed by lane, and each step of the compression function is
+ * a loop over the lanes, which the compiler turns into vector
+ * instructions.  A lane whose message has fewer blocks than the others
+ * is masked out of the last compressions.
+ */
+
+#define LANES	     ISC_ITERATED_HASH_LANES
+#define SHA1_BLOCK   64
+#define SHA1_DIGEST  20
+#define ROL(x, n)    (((x) << (n)) | ((x) >> (32 - (n))))
+#define SHA1_ROUNDS(from, to, F, K)                                      \
+	for (size_t t = (from); t < (to); t++) {                         \
+		for (size_t l = 0; l < LANES; l++) {                     \
+			uint32_t tmp = ROL(a[l], 5) + (F) + e[l] + (K) + \
+				       w[t][l];                          \
+			e[l] = d[l];                                     \
+			d[l] = c[l];                                     \
+			c[l] = ROL(b[l], 30);                            \
+			b[l] = a[l];                                     \
+			a[l] = tmp;                                      \
+		}                                                        \
+	}
+
+/*
+ * Fill 'block' with block 'n' of the padded message 'in' || 'salt'.
+ */
+static void
+sha1_block(unsigned char *block, size_t n, size_t nblocks,
+	   const unsigned char *in, size_t inlen, const unsigned char *salt,
+	   size_t saltlen) {
+	size_t start = n * SHA1_BLOCK, end = start + SHA1_BLOCK;
+	size_t total = inlen + saltlen;
+
+	memset(block, 0, SHA1_BLOCK);
+
+	if (start < inlen) {
+		memcpy(block, in + start, ISC_MIN(inlen, end) - start);
+	}
+	if (ISC_MAX(start, inlen) < ISC_MIN(total, end)) {
+		size_t from = ISC_MAX(start, inlen);
+		memcpy(block + from - start, salt + from - inlen,
+			ISC_MIN(total, end) - from);
+	}
+	if (total >= start && total < end) {
+		block[total - start] = 0x80;
+	}
+	if (n == nblocks - 1) {
+		uint64_t bits = (uint64_t)total * 8;
+		ISC_U64TO8_BE(block + SHA1_BLOCK - 8, bits);
+	}
+}
+
+static void
+sha1_compress(uint32_t h[5][LANES], unsigned char blocks[LANES][SHA1_BLOCK],
+	      const uint32_t mask[LANES]) {
+	uint32_t w[80][LANES];
+	uint32_t a[LANES], b[LANES], c[LANES], d[LANES], e[LANES];
+
+	for (size_t t = 0; t < 16; t++) {
+		for (size_t l = 0; l < LANES; l++) {
+			w[t][l] = ISC_U8TO32_BE(blocks[l] + 4 * t);
+		}
+	}
+	for (size_t t = 16; t < 80; t++) {
+		for (size_t l = 0; l < LANES; l++) {
+			uint32_t x = w[t - 3][l] ^ w[t - 8][l] ^
+				     w[t - 14][l] ^ w[t - 16][l];
+			w[t][l] = ROL(x, 1);
+		}
+	}
+
+	for (size_t l = 0; l < LANES; l++) {
+		a[l] = h[0][l];
+		b[l] = h[1][l];
+		c[l] = h[2][l];
+		d[l] = h[3][l];
+		e[l] = h[4][l];
+	}
+
+	SHA1_ROUNDS(0, 20, (b[l] & c[l]) | (~b[l] & d[l]), 0x5a827999);
+	SHA1_ROUNDS(20, 40, b[l] ^ c[l] ^ d[l], 0x6ed9eba1);
+	SHA1_ROUNDS(40, 60, (b[l] & c[l]) | (b[l] & d[l]) | (c[l] & d[l]),
+		    0x8f1bbcdc);
+	SHA1_ROUNDS(60, 80, b[l] ^ c[l] ^ d[l], 0xca62c1d6);
+
+	for (size_t l = 0; l < LANES; l++) {
+		h[0][l] += a[l] & mask[l];
+		h[1][l] += b[l] & mask[l];
+		h[2][l] += c[l] & mask[l];
+		h[3][l] += d[l] & mask[l];
+		h[4][l] += e[l] & mask[l];
+	}
+}
+
+/*
+ * Hash 'in[l]' || 'salt' into 'out[l]' for the first 'count' lanes.
+ * 'out[l]' may be 'in[l]'.
+ */
+static void
+sha1_lanes(unsigned char *const out[], const unsigned char *in[LANES],
+	   const size_t inlen[LANES], const unsigned char *salt,
+	   size_t saltlen, size_t count) {
+	uint32_t h[5][LANES];
+	unsigned char blocks[LANES][SHA1_BLOCK] = { 0 };
+	uint32_t mask[LANES];
+	size_t nblocks[LANES] = { 0 }, maxblocks = 0;
+
+	for (size_t l = 0; l < LANES; l++) {
+		h[0][l] = 0x67452301;
+		h[1][l] = 0xefcdab89;
+		h[2][l] = 0x98badcfe;
+		h[3][l] = 0x10325476;
+		h[4][l] = 0xc3d2e1f0;
+		if (l < count) {
+			nblocks[l] = (inlen[l] + saltlen + 8) / SHA1_BLOCK + 1;
+			maxblocks = ISC_MAX(maxblocks, nblocks[l]);
+		}
+	}
+
+	for (size_t n = 0; n < maxblocks; n++) {
+		for (size_t l = 0; l < LANES; l++) {
+			if (n < nblocks[l]) {
+				sha1_block(blocks[l], n, nblocks[l], in[l],
+					   inlen[l], salt, saltlen);
+				mask[l] = UINT32_MAX;
+			} else {
+				mask[l] = 0;
+			}
+		}
+		sha1_compress(h, blocks, mask);
+	}
+
+	for (size_t l = 0; l < count; l++) {
+		for (size_t i = 0; i < 5; i++) {
+			ISC_U32TO8_BE(out[l] + 4 * i, h[i][l]);
+		}
+	}
+}
+
+int
+isc_iterated_hash_batch(unsigned char *const out[],
+			const unsigned int hashalg, const int iterations,
+			const unsigned char *salt, const int saltlength,
+			const unsigned char *const in[], const int inlength[],
+			const size_t count) {
+	REQUIRE(count == 0 || (out != NULL && in != NULL && inlength != NULL));
+
+	if (hashalg != 1) {
+		return 0;
+	}
+
+	for (size_t i = 0; i < count; i += LANES) {
+		const unsigned char *buf[LANES];
+		size_t len[LANES];
+		size_t n = ISC_MIN(count - i, LANES);
+		int k = 0;
+
+		for (size_t l = 0; l < n; l++) {
+			buf[l] = in[i + l];
+			len[l] = inlength[i + l];
+		}
+
+		do {
+			sha1_lanes(&out[i], buf, len, salt, saltlength, n);
+			for (size_t l = 0; l < n; l++) {
+				buf[l] = out[i + l];
+				len[l] = SHA1_DIGEST;
+			}
+		} while (k++ < iterations);
+	}
+
+	return SHA1_DIGEST;
+}
@@ -25,6 +25,7 @@ const char *malloc_conf = NULL;
 #define MALLOCX_ZERO	    ((int)0x40)
 #define MALLOCX_TCACHE_NONE (0)
 #define MALLOCX_ARENA(a)    (0)
+#define MALLOCX_TCACHE(t)   (0)
 
 #include <stdlib.h>
 
@@ -52,6 +52,9 @@ isc_job_run(isc_loop_t *loop, isc_job_t *job, isc_job_cb cb, void *cbarg) {
 	ISC_LINK_INIT(job, link);
 
 	ISC_LIST_APPEND(loop->run_jobs, job, link);
+
+	atomic_store_relaxed(&loop->jobsqueued,
+			     atomic_load_relaxed(&loop->jobsqueued) + 1);
 }
 
 /*
@@ -74,6 +77,10 @@ isc__job_cb(uv_idle_t *handle) {
 		isc_job_cb cb = job->cb;
 		void *cbarg = job->cbarg;
 		ISC_LIST_UNLINK(jobs, job, link);
+		atomic_store_relaxed(&loop->jobsqueued,
+				     atomic_load_relaxed(&loop->jobsqueued) - 1);
+		atomic_store_relaxed(&loop->jobs,
+				     atomic_load_relaxed(&loop->jobs) + 1);
 		LIBISC_JOB_CB_BEFORE(job, cb, cbarg);
 		cb(cbarg);
 		LIBISC_JOB_CB_AFTER(job, cb, cbarg);
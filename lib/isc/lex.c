@@ -19,6 +19,12 @@
 #include <stdbool.h>
 #include <stdlib.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #include <isc/buffer.h>
 #include <isc/file.h>
 #include <isc/lex.h>
@@ -39,12 +45,22 @@ typedef struct inputsource {
 	isc_buffer_t *pushback;
 	unsigned int ignored;
 	void *input;
+	unsigned char *readahead; /* plain files only */
+	unsigned int readcur;
+	unsigned int readlen;
 	char *name;
 	unsigned long line;
 	unsigned long saved_line;
 	ISC_LINK(struct inputsource) link;
 } inputsource;
 
+/*
+ * The size of the blocks read from plain files, and the most printable
+ * characters that string_run() can look for a vector at a time.
+ */
+#define LEX_READAHEAD (16 * 1024)
+#define LEX_VSTOPS    16
+
 #define LEX_MAGIC    ISC_MAGIC('L', 'e', 'x', '!')
 #define VALID_LEX(l) ISC_MAGIC_VALID(l, LEX_MAGIC)
 
@@ -61,9 +77,108 @@ struct isc_lex {
 	unsigned int paren_count;
 	unsigned int saved_paren_count;
 	isc_lexspecials_t specials;
+	isc_lexspecials_t stops; /* characters that end a string run */
+	unsigned char vstops[LEX_VSTOPS];
+	unsigned int nvstops;
 	LIST(struct inputsource) sources;
 };
 
+/*
+ * Find the characters that may end a string token or change the lexer
+ * state, for string_run().
+ */
+static void
+setstops(isc_lex_t *lex) {
+	memmove(lex->stops, lex->specials, 256);
+	lex->stops[' '] = 1;
+	lex->stops['\t'] = 1;
+	lex->stops['\r'] = 1;
+	lex->stops['\n'] = 1;
+	lex->stops['\\'] = 1;
+	if ((lex->comments & ISC_LEXCOMMENT_DNSMASTERFILE) != 0) {
+		lex->stops[';'] = 1;
+	}
+	if ((lex->comments & (ISC_LEXCOMMENT_C | ISC_LEXCOMMENT_CPLUSPLUS)) !=
+	    0)
+	{
+		lex->stops['/'] = 1;
+	}
+	if ((lex->comments & ISC_LEXCOMMENT_SHELL) != 0) {
+		lex->stops['#'] = 1;
+	}
+
+	/*
+	 * The vector search stops at all the control, space and
+	 * non-ASCII characters, and at up to LEX_VSTOPS others.
+	 */
+	lex->nvstops = 0;
+	for (unsigned int c = '!'; c <= '~'; c++) {
+		if (lex->stops[c]) {
+			if (lex->nvstops < LEX_VSTOPS) {
+				lex->vstops[lex->nvstops] = c;
+			}
+			lex->nvstops++;
+		}
+	}
+}
+
+/*
+ * Return the length of the run of characters at the start of 's' that
+ * are not in 'lex->stops'.
+ */
+static size_t
+plain_run(isc_lex_t *lex, const unsigned char *s, size_t n) {
+	size_t i = 0;
+
+#if defined(__SSE2__)
+	if (lex->nvstops <= LEX_VSTOPS) {
+		/* the signed comparison also catches the non-ASCII bytes */
+		const __m128i space = _mm_set1_epi8('!');
+		const __m128i del = _mm_set1_epi8(0x7f);
+
+		for (; i + 16 <= n; i += 16) {
+			__m128i bytes = _mm_loadu_si128((const __m128i *)&s[i]);
+			__m128i stop = _mm_or_si128(_mm_cmplt_epi8(bytes, space),
+						    _mm_cmpeq_epi8(bytes, del));
+
+			for (unsigned int j = 0; j < lex->nvstops; j++) {
+				__m128i c = _mm_set1_epi8(lex->vstops[j]);
+				stop = _mm_or_si128(stop,
+						    _mm_cmpeq_epi8(bytes, c));
+			}
+			if (_mm_movemask_epi8(stop) != 0) {
+				break;
+			}
+		}
+	}
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+	if (lex->nvstops <= LEX_VSTOPS) {
+		const uint8x16_t space = vdupq_n_u8('!');
+		const uint8x16_t del = vdupq_n_u8(0x7f);
+
+		for (; i + 16 <= n; i += 16) {
+			uint8x16_t bytes = vld1q_u8(&s[i]);
+			uint8x16_t stop = vorrq_u8(vcltq_u8(bytes, space),
+						   vcgeq_u8(bytes, del));
+
+			for (unsigned int j = 0; j < lex->nvstops; j++) {
+				uint8x16_t c = vdupq_n_u8(lex->vstops[j]);
+				stop = vorrq_u8(stop, vceqq_u8(bytes, c));
+			}
+			if (vmaxvq_u8(stop) != 0) {
+				break;
+			}
+		}
+	}
+#endif
+
+	while (i < n && !lex->stops[s[i]]) {
+		i++;
+	}
+
+	return i;
+}
+
 static isc_result_t
 grow_data(isc_lex_t *lex, size_t *remainingp, char **currp, char **prevp) {
 	char *tmp;
@@ -105,6 +220,7 @@ isc_lex_create(isc_mem_t *mctx, size_t max_token, isc_lex_t **lexp) {
 	lex->paren_count = 0;
 	lex->saved_paren_count = 0;
 	memset(lex->specials, 0, 256);
+	setstops(lex);
 	INIT_LIST(lex->sources);
 	lex->magic = LEX_MAGIC;
 
@@ -154,6 +270,7 @@ isc_lex_setcomments(isc_lex_t *lex, unsigned int comments) {
 	REQUIRE(VALID_LEX(lex));
 
 	lex->comments = comments;
+	setstops(lex);
 }
 
 void
@@ -177,6 +294,7 @@ isc_lex_setspecials(isc_lex_t *lex, isc_lexspecials_t specials) {
 	REQUIRE(VALID_LEX(lex));
 
 	memmove(lex->specials, specials, 256);
+	setstops(lex);
 }
 
 static isc_result_t
@@ -191,6 +309,9 @@ new_source(isc_lex_t *lex, bool is_file, bool need_close, void *input,
 	source->at_eof = false;
 	source->last_was_eol = lex->last_was_eol;
 	source->input = input;
+	source->readahead = NULL;
+	source->readcur = 0;
+	source->readlen = 0;
 	source->name = isc_mem_strdup(lex->mctx, name);
 	source->pushback = NULL;
 	isc_buffer_allocate(lex->mctx, &source->pushback,
@@ -221,8 +342,19 @@ isc_lex_openfile(isc_lex_t *lex, const char *filename) {
 	result = new_source(lex, true, true, stream, filename);
 	if (result != ISC_R_SUCCESS) {
 		(void)fclose(stream);
+		return result;
 	}
-	return result;
+
+	/*
+	 * Nothing else reads from the file, so it can be read a block at
+	 * a time unless it is a pipe or a terminal.
+	 */
+	if (isc_file_isplainfilefd(fileno(stream)) == ISC_R_SUCCESS) {
+		inputsource *source = HEAD(lex->sources);
+		source->readahead = isc_mem_get(lex->mctx, LEX_READAHEAD);
+	}
+
+	return ISC_R_SUCCESS;
 }
 
 isc_result_t
@@ -277,6 +409,9 @@ isc_lex_close(isc_lex_t *lex) {
 			(void)fclose((FILE *)(source->input));
 		}
 	}
+	if (source->readahead != NULL) {
+		isc_mem_put(lex->mctx, source->readahead, LEX_READAHEAD);
+	}
 	isc_mem_free(lex->mctx, source->name);
 	isc_buffer_free(&source->pushback);
 	isc_mem_put(lex->mctx, source, sizeof(*source));
@@ -302,6 +437,44 @@ typedef enum {
 
 #define IWSEOL (ISC_LEXOPT_INITIALWS | ISC_LEXOPT_EOL)
 
+/*
+ * Point 'r' at the input of 'source' that hasn't been read yet, reading
+ * the next block of the file if needed.  'r' is empty at the end of the
+ * input.
+ */
+static isc_result_t
+input_peek(inputsource *source, isc_region_t *r) {
+	if (!source->is_file) {
+		isc_buffer_remainingregion(source->input, r);
+		return ISC_R_SUCCESS;
+	}
+
+	INSIST(source->readahead != NULL);
+	if (source->readcur == source->readlen) {
+		FILE *stream = source->input;
+
+		source->readcur = 0;
+		source->readlen = fread(source->readahead, 1, LEX_READAHEAD,
+					stream);
+		if (source->readlen == 0 && ferror(stream)) {
+			return isc__errno2result(errno);
+		}
+	}
+
+	r->base = source->readahead + source->readcur;
+	r->length = source->readlen - source->readcur;
+	return ISC_R_SUCCESS;
+}
+
+static void
+input_consume(inputsource *source, unsigned int n) {
+	if (source->is_file) {
+		source->readcur += n;
+	} else {
+		isc_buffer_forward(source->input, n);
+	}
+}
+
 static void
 pushback(inputsource *source, int c) {
 	REQUIRE(source->pushback->current > 0);
@@ -336,6 +509,60 @@ pushandgrow(isc_lex_t *lex, inputsource *source, int c) {
 	return ISC_R_SUCCESS;
 }
 
+/*
+ * Append to the string token being read the run of input characters
+ * that can neither end it nor change the lexer state, rather than going
+ * through the state machine for each of them.
+ */
+static isc_result_t
+string_run(isc_lex_t *lex, inputsource *source, unsigned int options,
+	   size_t *remainingp, char **currp, char **prevp) {
+	isc_region_t r;
+	isc_result_t result;
+	size_t n;
+
+	if (isc_buffer_remaininglength(source->pushback) != 0 ||
+	    (source->is_file && source->readahead == NULL))
+	{
+		return ISC_R_SUCCESS;
+	}
+
+	result = input_peek(source, &r);
+	if (result != ISC_R_SUCCESS) {
+		source->result = result;
+		return result;
+	}
+
+	n = plain_run(lex, r.base, r.length);
+	if ((options & ISC_LEXOPT_VPAIR) != 0) {
+		unsigned char *eq = memchr(r.base, '=', n);
+		if (eq != NULL) {
+			n = eq - r.base;
+		}
+	}
+	if (n == 0) {
+		return ISC_R_SUCCESS;
+	}
+
+	while (*remainingp < n) {
+		result = grow_data(lex, remainingp, currp, prevp);
+		if (result != ISC_R_SUCCESS) {
+			return result;
+		}
+	}
+	memmove(*currp, r.base, n);
+	*currp += n;
+	**currp = '\0';
+	*remainingp -= n;
+
+	/* The token is kept in the pushback buffer for isc_lex_ungettoken() */
+	isc_buffer_putmem(source->pushback, r.base, n);
+	isc_buffer_forward(source->pushback, n);
+	input_consume(source, n);
+
+	return ISC_R_SUCCESS;
+}
+
 isc_result_t
 isc_lex_gettoken(isc_lex_t *lex, unsigned int options, isc_token_t *tokenp) {
 	inputsource *source;
@@ -345,7 +572,6 @@ isc_lex_gettoken(isc_lex_t *lex, unsigned int options, isc_token_t *tokenp) {
 	bool escaped = false;
 	lexstate state = lexstate_start;
 	lexstate saved_state = lexstate_start;
-	isc_buffer_t *buffer;
 	FILE *stream;
 	char *curr, *prev;
 	size_t remaining;
@@ -417,7 +643,7 @@ isc_lex_gettoken(isc_lex_t *lex, unsigned int options, isc_token_t *tokenp) {
 
 	do {
 		if (isc_buffer_remaininglength(source->pushback) == 0) {
-			if (source->is_file) {
+			if (source->is_file && source->readahead == NULL) {
 				stream = source->input;
 
 #if defined(HAVE_FLOCKFILE) && defined(HAVE_GETC_UNLOCKED)
@@ -436,15 +662,19 @@ isc_lex_gettoken(isc_lex_t *lex, unsigned int options, isc_token_t *tokenp) {
 					source->at_eof = true;
 				}
 			} else {
-				buffer = source->input;
+				isc_region_t r;
 
-				if (buffer->current == buffer->used) {
+				result = input_peek(source, &r);
+				if (result != ISC_R_SUCCESS) {
+					source->result = result;
+					goto done;
+				}
+				if (r.length == 0) {
 					c = EOF;
 					source->at_eof = true;
 				} else {
-					c = *((unsigned char *)buffer->base +
-					      buffer->current);
-					buffer->current++;
+					c = r.base[0];
+					input_consume(source, 1);
 				}
 			}
 			if (c != EOF) {
@@ -754,6 +984,13 @@ isc_lex_gettoken(isc_lex_t *lex, unsigned int options, isc_token_t *tokenp) {
 			*curr++ = c;
 			*curr = '\0';
 			remaining--;
+			if (state == lexstate_string && !escaped) {
+				result = string_run(lex, source, options,
+						    &remaining, &curr, &prev);
+				if (result != ISC_R_SUCCESS) {
+					goto done;
+				}
+			}
 			break;
 		case lexstate_maybecomment:
 			if (c == '*' && (lex->comments & ISC_LEXCOMMENT_C) != 0)
@@ -0,0 +1,254 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <isc/atomic.h>
+#include <isc/lockstat.h>
+#include <isc/mutex.h>
+#include <isc/rwlock.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+/*
+ * The places in the source are kept in an open addressing hash table
+ * that only grows.  A place is looked up without locking; it is added
+ * under 'sitelock', and published by setting its 'file' last.
+ * 'sitelock' is a bare pthread mutex, so adding a place can't recurse
+ * into the statistics.
+ */
+typedef struct site {
+	atomic_ptr(const char) file;
+	unsigned int line;
+	isc_lockstattype_t type;
+	atomic_uint_fast64_t contended;
+	atomic_uint_fast64_t wait;
+	atomic_uint_fast64_t maxwait;
+} site_t;
+
+static site_t sites[ISC_LOCKSTAT_SITES];
+static pthread_mutex_t sitelock = PTHREAD_MUTEX_INITIALIZER;
+static atomic_bool enabled = false;
+
+STATIC_ASSERT(ISC_LOCKSTAT_SITES > 0 &&
+		      (ISC_LOCKSTAT_SITES & (ISC_LOCKSTAT_SITES - 1)) == 0,
+	      "ISC_LOCKSTAT_SITES must be a power of 2");
+
+static uint32_t
+site_hash(const char *file, unsigned int line, isc_lockstattype_t type) {
+	uint64_t h = ((uintptr_t)file ^ ((uint64_t)line << 2 | type)) *
+		     UINT64_C(0x9e3779b97f4a7c15);
+
+	return (uint32_t)(h >> 32) & (ISC_LOCKSTAT_SITES - 1);
+}
+
+static site_t *
+site_get(const char *file, unsigned int line, isc_lockstattype_t type) {
+	uint32_t first = site_hash(file, line, type);
+	uint32_t h = first;
+	site_t *site = NULL;
+
+	do {
+		const char *f = atomic_load_acquire(&sites[h].file);
+		if (f == NULL) {
+			break;
+		}
+		if (f == file && sites[h].line == line &&
+		    sites[h].type == type)
+		{
+			return &sites[h];
+		}
+		h = (h + 1) & (ISC_LOCKSTAT_SITES - 1);
+	} while (h != first);
+
+	/* Look again under the lock, the place might have just been added */
+	RUNTIME_CHECK(pthread_mutex_lock(&sitelock) == 0);
+	h = first;
+	do {
+		const char *f = atomic_load_relaxed(&sites[h].file);
+		if (f == NULL) {
+			site = &sites[h];
+			site->line = line;
+			site->type = type;
+			atomic_store_release(&site->file, file);
+			break;
+		}
+		if (f == file && sites[h].line == line &&
+		    sites[h].type == type)
+		{
+			site = &sites[h];
+			break;
+		}
+		h = (h + 1) & (ISC_LOCKSTAT_SITES - 1);
+	} while (h != first);
+	RUNTIME_CHECK(pthread_mutex_unlock(&sitelock) == 0);
+
+	/* NULL if the table is full */
+	return site;
+}
+
+void
+isc__lockstat_record(const char *file, unsigned int line,
+		     isc_lockstattype_t type, uint64_t wait) {
+	site_t *site = site_get(file, line, type);
+	if (site == NULL) {
+		return;
+	}
+
+	atomic_fetch_add_relaxed(&site->contended, 1);
+	atomic_fetch_add_relaxed(&site->wait, wait);
+
+	uint_fast64_t max = atomic_load_relaxed(&site->maxwait);
+	do {
+		if (max >= wait) {
+			break;
+		}
+	} while (!atomic_compare_exchange_weak_relaxed(&site->maxwait, &max,
+						       wait));
+}
+
+int
+isc__mutex_lock_contended(pthread_mutex_t *mp, const char *file,
+			  unsigned int line) {
+	if (!atomic_load_relaxed(&enabled)) {
+		return pthread_mutex_lock(mp);
+	}
+
+	isc_nanosecs_t start = isc_time_monotonic();
+	int ret = pthread_mutex_lock(mp);
+	if (ret == 0) {
+		isc__lockstat_record(file, line, isc_lockstattype_mutex,
+				     isc_time_monotonic() - start);
+	}
+
+	return ret;
+}
+
+#if USE_PTHREAD_RWLOCK
+int
+isc__rwlock_lock_contended(pthread_rwlock_t *rwl, isc_rwlocktype_t type,
+			   const char *file, unsigned int line) {
+	isc_lockstattype_t stattype = isc_lockstattype_read;
+	isc_nanosecs_t start = 0;
+	int ret;
+
+	if (atomic_load_relaxed(&enabled)) {
+		start = isc_time_monotonic();
+	}
+
+	switch (type) {
+	case isc_rwlocktype_read:
+		ret = pthread_rwlock_rdlock(rwl);
+		break;
+	case isc_rwlocktype_write:
+		ret = pthread_rwlock_wrlock(rwl);
+		stattype = isc_lockstattype_write;
+		break;
+	default:
+		UNREACHABLE();
+	}
+
+	if (ret == 0 && start != 0) {
+		isc__lockstat_record(file, line, stattype,
+				     isc_time_monotonic() - start);
+	}
+
+	return ret;
+}
+#endif /* USE_PTHREAD_RWLOCK */
+
+void
+isc_lockstat_enable(bool enable) {
+	atomic_store_relaxed(&enabled, enable);
+}
+
+bool
+isc_lockstat_enabled(void) {
+	return atomic_load_relaxed(&enabled);
+}
+
+void
+isc_lockstat_reset(void) {
+	for (size_t i = 0; i < ISC_LOCKSTAT_SITES; i++) {
+		atomic_store_relaxed(&sites[i].contended, 0);
+		atomic_store_relaxed(&sites[i].wait, 0);
+		atomic_store_relaxed(&sites[i].maxwait, 0);
+	}
+}
+
+size_t
+isc_lockstat_get(isc_lockstat_t *stats, size_t nstats) {
+	size_t count = 0;
+
+	REQUIRE(stats != NULL);
+
+	/*
+	 * Keep the 'nstats' places that waited longest, in order, by
+	 * inserting each place where it belongs.
+	 */
+	for (size_t i = 0; i < ISC_LOCKSTAT_SITES; i++) {
+		site_t *site = &sites[i];
+		const char *file = atomic_load_acquire(&site->file);
+		isc_lockstat_t stat;
+		size_t j;
+
+		if (file == NULL) {
+			continue;
+		}
+
+		stat = (isc_lockstat_t){
+			.file = file,
+			.line = site->line,
+			.type = site->type,
+			.contended = atomic_load_relaxed(&site->contended),
+			.wait = atomic_load_relaxed(&site->wait),
+			.maxwait = atomic_load_relaxed(&site->maxwait),
+		};
+		if (stat.contended == 0) {
+			continue;
+		}
+
+		for (j = count; j > 0 && stats[j - 1].wait < stat.wait; j--) {
+			if (j < nstats) {
+				stats[j] = stats[j - 1];
+			}
+		}
+		if (j < nstats) {
+			stats[j] = stat;
+			if (count < nstats) {
+				count++;
+			}
+		}
+	}
+
+	return count;
+}
+
+const char *
+isc_lockstattype_totext(isc_lockstattype_t type) {
+	switch (type) {
+	case isc_lockstattype_mutex:
+		return "mutex";
+	case isc_lockstattype_read:
+		return "read";
+	case isc_lockstattype_write:
+		return "write";
+	default:
+		UNREACHABLE();
+	}
+}
@@ -44,6 +44,7 @@
 #define VALID_CONFIG(lcfg) ISC_MAGIC_VALID(lcfg, LCFG_MAGIC)
 
 static thread_local bool forcelog = false;
+static thread_local FILE *threadstream = NULL;
 
 /*
  * XXXDCL make dynamic?
@@ -1271,6 +1272,7 @@ isc_log_doit(isc_logcategory_t category, isc_logmodule_t module, int level,
 	bool printcategory, printmodule, printlevel, buffered;
 	isc_logchannel_t *channel;
 	isc_logchannellist_t *category_channels;
+	FILE *stream = NULL;
 	int_fast32_t dlevel;
 	isc_result_t result;
 
@@ -1482,7 +1484,13 @@ isc_log_doit(isc_logcategory_t category, isc_logmodule_t module, int level,
 			FALLTHROUGH;
 
 		case ISC_LOG_TOFILEDESC:
-			fprintf(FILE_STREAM(channel), "%s%s%s%s%s%s%s%s%s%s\n",
+			stream = FILE_STREAM(channel);
+			if (channel->type == ISC_LOG_TOFILEDESC &&
+			    threadstream != NULL)
+			{
+				stream = threadstream;
+			}
+			fprintf(stream, "%s%s%s%s%s%s%s%s%s%s\n",
 				printtime ? time_string : "",
 				printtime ? " " : "", printtag ? lcfg->tag : "",
 				printcolon ? ": " : "",
@@ -1495,7 +1503,7 @@ isc_log_doit(isc_logcategory_t category, isc_logmodule_t module, int level,
 				isc__lctx->buffer);
 
 			if (!buffered) {
-				fflush(FILE_STREAM(channel));
+				fflush(stream);
 			}
 
 			/*
@@ -1557,6 +1565,11 @@ isc_log_setforcelog(bool v) {
 	forcelog = v;
 }
 
+void
+isc_log_setthreadstream(FILE *stream) {
+	threadstream = stream;
+}
+
 void
 isc__log_initialize(void) {
 	REQUIRE(isc__lctx == NULL);
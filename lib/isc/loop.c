@@ -26,6 +26,7 @@
 #include <isc/magic.h>
 #include <isc/mem.h>
 #include <isc/mutex.h>
+#include <isc/os.h>
 #include <isc/refcount.h>
 #include <isc/result.h>
 #include <isc/signal.h>
@@ -41,6 +42,8 @@
 #include "async_p.h"
 #include "job_p.h"
 #include "loop_p.h"
+#include "timer_p.h"
+#include "work_p.h"
 
 /**
  * Private
@@ -147,12 +150,15 @@ static void
 destroy_cb(uv_async_t *handle) {
 	isc_loop_t *loop = uv_handle_get_data(handle);
 
+	isc__async_flush(loop);
+
 	/* Again, the first close callback here is called last */
 	uv_close(&loop->async_trigger, isc__async_close);
 	uv_close(&loop->run_trigger, isc__job_close);
 	uv_close(&loop->destroy_trigger, NULL);
 	uv_close(&loop->pause_trigger, NULL);
 	uv_close(&loop->quiescent, NULL);
+	isc__timerwheel_close(loop);
 
 	uv_walk(&loop->loop, loop_walk_cb, (char *)"destroy_cb");
 }
@@ -191,6 +197,7 @@ loop_init(isc_loop_t *loop, isc_loopmgr_t *loopmgr, uint32_t tid,
 	  const char *kind) {
 	*loop = (isc_loop_t){
 		.tid = tid,
+		.cpu = -1,
 		.loopmgr = loopmgr,
 		.run_jobs = ISC_LIST_INITIALIZER,
 	};
@@ -202,6 +209,12 @@ loop_init(isc_loop_t *loop, isc_loopmgr_t *loopmgr, uint32_t tid,
 	int r = uv_loop_init(&loop->loop);
 	UV_RUNTIME_CHECK(uv_loop_init, r);
 
+#if UV_VERSION_HEX >= UV_VERSION(1, 39, 0)
+	/* Let libuv measure how long the loop waits for events */
+	r = uv_loop_configure(&loop->loop, UV_METRICS_IDLE_TIME);
+	UV_RUNTIME_CHECK(uv_loop_configure, r);
+#endif /* UV_VERSION_HEX >= UV_VERSION(1, 39, 0) */
+
 	r = uv_async_init(&loop->loop, &loop->pause_trigger, pauseresume_cb);
 	UV_RUNTIME_CHECK(uv_async_init, r);
 	uv_handle_set_data(&loop->pause_trigger, loop);
@@ -231,6 +244,8 @@ loop_init(isc_loop_t *loop, isc_loopmgr_t *loopmgr, uint32_t tid,
 	isc_mem_create(&loop->mctx);
 	isc_mem_setname(loop->mctx, name);
 
+	isc__timerwheel_init(loop);
+
 	isc_refcount_init(&loop->references, 1);
 
 	loop->magic = LOOP_MAGIC;
@@ -238,7 +253,10 @@ loop_init(isc_loop_t *loop, isc_loopmgr_t *loopmgr, uint32_t tid,
 
 static void
 quiescent_cb(uv_prepare_t *handle) {
-	UNUSED(handle);
+	isc_loop_t *loop = uv_handle_get_data(handle);
+
+	/* Send the jobs held back during this iteration */
+	isc__async_flush(loop);
 
 #if defined(RCU_QSBR)
 	/* safe memory reclamation */
@@ -258,6 +276,7 @@ helper_close(isc_loop_t *loop) {
 
 	INSIST(cds_wfcq_empty(&loop->async_jobs.head, &loop->async_jobs.tail));
 
+	isc__timerwheel_destroy(loop);
 	isc_mem_detach(&loop->mctx);
 }
 
@@ -269,6 +288,9 @@ loop_close(isc_loop_t *loop) {
 	INSIST(cds_wfcq_empty(&loop->async_jobs.head, &loop->async_jobs.tail));
 	INSIST(ISC_LIST_EMPTY(loop->run_jobs));
 
+	isc__async_batch_destroy(loop);
+	isc__timerwheel_destroy(loop);
+
 	loop->magic = 0;
 
 	isc_mem_detach(&loop->mctx);
@@ -315,6 +337,8 @@ loop_thread(void *arg) {
 	int r = uv_prepare_start(&loop->quiescent, quiescent_cb);
 	UV_RUNTIME_CHECK(uv_prepare_start, r);
 
+	loop->started = isc_time_monotonic();
+
 	isc_barrier_wait(&loopmgr->starting);
 
 	enum cds_wfcq_ret ret = __cds_wfcq_splice_blocking(
@@ -397,6 +421,7 @@ isc_loopmgr_create(isc_mem_t *mctx, uint32_t nloops, isc_loopmgr_t **loopmgrp) {
 	for (size_t i = 0; i < loopmgr->nloops; i++) {
 		isc_loop_t *loop = &loopmgr->loops[i];
 		loop_init(loop, loopmgr, i, "loop");
+		isc__async_batch_create(loop);
 	}
 
 	loopmgr->helpers = isc_mem_cget(loopmgr->mctx, loopmgr->nloops,
@@ -414,6 +439,9 @@ isc_loopmgr_create(isc_mem_t *mctx, uint32_t nloops, isc_loopmgr_t **loopmgrp) {
 	isc_signal_start(loopmgr->sigint);
 	isc_signal_start(loopmgr->sigterm);
 
+	isc__workpool_create(loopmgr->mctx, loopmgr->nloops, loopmgr->nloops,
+			     &loopmgr->workpool);
+
 	loopmgr->magic = LOOPMGR_MAGIC;
 
 	*loopmgrp = loopmgr;
@@ -600,6 +628,9 @@ isc_loopmgr_destroy(isc_loopmgr_t **loopmgrp) {
 
 	loopmgr->magic = 0;
 
+	/* All the work has been done before the loops could finish */
+	isc__workpool_destroy(&loopmgr->workpool);
+
 	for (size_t i = 0; i < loopmgr->nloops; i++) {
 		isc_loop_t *helper = &loopmgr->helpers[i];
 		helper_close(helper);
@@ -687,6 +718,106 @@ isc_loop_now(isc_loop_t *loop) {
 	return t;
 }
 
+void
+isc_loop_getstats(isc_loop_t *loop, isc_loopstats_t *stats) {
+	uint64_t sent;
+
+	REQUIRE(VALID_LOOP(loop));
+	REQUIRE(stats != NULL);
+
+	*stats = (isc_loopstats_t){
+		.jobs = atomic_load_relaxed(&loop->jobs),
+		.jobsqueued = atomic_load_relaxed(&loop->jobsqueued),
+		.asyncs = atomic_load_relaxed(&loop->asyncs),
+		.asyncwait = atomic_load_relaxed(&loop->asyncwait),
+		.asyncmaxwait = atomic_load_relaxed(&loop->asyncmaxwait),
+		.asyncwakeups = atomic_load_relaxed(&loop->asyncwakeups),
+		.works = atomic_load_relaxed(&loop->works),
+		.workwait = atomic_load_relaxed(&loop->workwait),
+		.workmaxwait = atomic_load_relaxed(&loop->workmaxwait),
+	};
+
+	/*
+	 * The counters are read one at a time, so more jobs might seem to
+	 * have run than have been queued.
+	 */
+	sent = atomic_load_relaxed(&loop->asyncssent);
+	stats->asyncsqueued = sent > stats->asyncs ? sent - stats->asyncs : 0;
+	sent = atomic_load_relaxed(&loop->workssent);
+	stats->worksqueued = sent > stats->works ? sent - stats->works : 0;
+
+#if UV_VERSION_HEX >= UV_VERSION(1, 39, 0)
+	if (loop->started != 0) {
+		uint64_t uptime = isc_time_monotonic() - loop->started;
+
+		stats->idle = uv_metrics_idle_time(&loop->loop);
+		stats->busy = uptime > stats->idle ? uptime - stats->idle : 0;
+	}
+#endif /* UV_VERSION_HEX >= UV_VERSION(1, 39, 0) */
+}
+
+static void
+loop_setaffinity_cb(void *arg) {
+	isc_loop_t *loop = arg;
+	isc_result_t result = isc_thread_setaffinity(loop->cpu);
+
+	if (result != ISC_R_SUCCESS) {
+		isc_log_write(ISC_LOGCATEGORY_GENERAL, ISC_LOGMODULE_OTHER,
+			      ISC_LOG_WARNING,
+			      "unable to bind loop %" PRIu32 " to CPU %d: %s",
+			      loop->tid, loop->cpu, isc_result_totext(result));
+	}
+}
+
+isc_result_t
+isc_loopmgr_setaffinity(isc_loopmgr_t *loopmgr, bool enabled) {
+	unsigned int size = isc_os_ncpus();
+	unsigned int count = 0;
+	int *cpus = NULL;
+
+	REQUIRE(VALID_LOOPMGR(loopmgr));
+
+	if (!enabled) {
+		for (size_t i = 0; i < loopmgr->nloops; i++) {
+			isc_loop_t *loop = &loopmgr->loops[i];
+
+			if (loop->cpu != -1) {
+				loop->cpu = -1;
+				isc_async_run(loop, loop_setaffinity_cb, loop);
+			}
+		}
+		return ISC_R_SUCCESS;
+	}
+
+	cpus = isc_mem_cget(loopmgr->mctx, size, sizeof(cpus[0]));
+	count = isc_os_cpulist(cpus, size);
+	if (count == 0) {
+		isc_mem_cput(loopmgr->mctx, cpus, size, sizeof(cpus[0]));
+		return ISC_R_NOTIMPLEMENTED;
+	}
+
+	for (size_t i = 0; i < loopmgr->nloops; i++) {
+		isc_loop_t *loop = &loopmgr->loops[i];
+		int cpu = cpus[i % count];
+
+		if (loop->cpu != cpu) {
+			loop->cpu = cpu;
+			isc_async_run(loop, loop_setaffinity_cb, loop);
+		}
+	}
+
+	isc_mem_cput(loopmgr->mctx, cpus, size, sizeof(cpus[0]));
+
+	return ISC_R_SUCCESS;
+}
+
+int
+isc_loop_getcpu(isc_loop_t *loop) {
+	REQUIRE(VALID_LOOP(loop));
+
+	return loop->cpu;
+}
+
 bool
 isc_loop_shuttingdown(isc_loop_t *loop) {
 	REQUIRE(VALID_LOOP(loop));
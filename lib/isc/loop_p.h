@@ -15,8 +15,10 @@
 
 #include <inttypes.h>
 
+#include <isc/atomic.h>
 #include <isc/barrier.h>
 #include <isc/job.h>
+#include <isc/list.h>
 #include <isc/loop.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
@@ -24,6 +26,7 @@
 #include <isc/result.h>
 #include <isc/signal.h>
 #include <isc/thread.h>
+#include <isc/time.h>
 #include <isc/types.h>
 #include <isc/urcu.h>
 #include <isc/uv.h>
@@ -31,6 +34,8 @@
 
 #include "async_p.h"
 #include "job_p.h"
+#include "timer_p.h"
+#include "work_p.h"
 
 /*
  * Per-thread loop
@@ -48,6 +53,9 @@ struct isc_loop {
 	uv_loop_t loop;
 	uint32_t tid;
 
+	/* The CPU the thread is bound to, or -1 */
+	int cpu;
+
 	isc_mem_t *mctx;
 
 	/* states */
@@ -58,6 +66,11 @@ struct isc_loop {
 	uv_async_t async_trigger;
 	isc_jobqueue_t async_jobs;
 
+	/* Async jobs held back until the end of the iteration, by loop */
+	isc_jobqueue_t *async_batch;
+	uint32_t *async_dirty;
+	uint32_t async_ndirty;
+
 	/* Jobs queue */
 	uv_idle_t run_trigger;
 	isc_joblist_t run_jobs;
@@ -75,6 +88,23 @@ struct isc_loop {
 
 	/* safe memory reclamation */
 	uv_prepare_t quiescent;
+
+	/* Coarse timers */
+	isc_timerwheel_t wheel;
+
+	/* Statistics, see isc_loopstats_t */
+	isc_nanosecs_t started;
+	atomic_uint_fast64_t jobs;
+	atomic_uint_fast64_t jobsqueued;
+	atomic_uint_fast64_t asyncs;
+	atomic_uint_fast64_t asyncssent;
+	atomic_uint_fast64_t asyncwait;
+	atomic_uint_fast64_t asyncmaxwait;
+	atomic_uint_fast64_t asyncwakeups;
+	atomic_uint_fast64_t works;
+	atomic_uint_fast64_t workssent;
+	atomic_uint_fast64_t workwait;
+	atomic_uint_fast64_t workmaxwait;
 };
 
 /*
@@ -110,6 +140,9 @@ struct isc_loopmgr {
 	/* per-thread objects */
 	isc_loop_t *loops;
 	isc_loop_t *helpers;
+
+	/* offloaded work */
+	isc__workpool_t *workpool;
 };
 
 /*
@@ -134,16 +167,31 @@ struct isc_signal {
 #define VALID_JOB(t) ISC_MAGIC_VALID(t, JOB_MAGIC)
 
 /*
- * Work to be offloaded to an external thread.
+ * Work to be offloaded to a worker thread.
  */
 struct isc_work {
-	uv_work_t work;
+	ISC_LINK(isc_work_t) link;
+	isc_workprio_t prio;
 	isc_loop_t *loop;
+	isc_nanosecs_t enqueued;
 	isc_work_cb work_cb;
 	isc_after_work_cb after_work_cb;
 	void *cbarg;
 };
 
+/*
+ * Raise the statistics counter 'max' to 'value'.
+ */
+static inline void
+isc__loop_statmax(atomic_uint_fast64_t *max, uint_fast64_t value) {
+	uint_fast64_t cur = atomic_load_relaxed(max);
+	do {
+		if (cur >= value) {
+			break;
+		}
+	} while (!atomic_compare_exchange_weak_relaxed(max, &cur, value));
+}
+
 #define DEFAULT_LOOP(loopmgr) (&(loopmgr)->loops[0])
 #define CURRENT_LOOP(loopmgr) (&(loopmgr)->loops[isc_tid()])
 #define LOOP(loopmgr, tid)    (&(loopmgr)->loops[tid])
@@ -23,6 +23,7 @@
 #include <isc/hash.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
+#include <isc/meminfo.h>
 #include <isc/mutex.h>
 #include <isc/once.h>
 #include <isc/os.h>
@@ -30,6 +31,7 @@
 #include <isc/refcount.h>
 #include <isc/strerr.h>
 #include <isc/string.h>
+#include <isc/tid.h>
 #include <isc/types.h>
 #include <isc/urcu.h>
 #include <isc/util.h>
@@ -116,17 +118,39 @@ static isc_once_t init_once = ISC_ONCE_INIT;
 static isc_once_t shut_once = ISC_ONCE_INIT;
 static isc_mutex_t contextslock;
 
+/*
+ * The jemalloc arena and tcache of each thread, shared by the memory
+ * contexts created with isc_mem_create_threadaffine().  They are created
+ * with the first such context; locked by 'contextslock'.
+ */
+typedef struct mem_thread {
+	unsigned int arena;
+	unsigned int tcache;
+	bool hastcache;
+	int jemalloc_flags;
+} mem_thread_t;
+
+static mem_thread_t *mem_threads = NULL;
+static uint32_t mem_nthreads = 0;
+
+/*
+ * The memory pressure of the process, set by isc_mem_checkpressure().
+ */
+static atomic_uint mem_syspressure = 0;
+
 struct isc_mem {
 	unsigned int magic;
 	unsigned int flags;
 	unsigned int jemalloc_flags;
 	unsigned int jemalloc_arena;
+	bool threadaffine;
 	unsigned int debugging;
 	isc_mutex_t lock;
 	bool checkfree;
 	isc_refcount_t references;
 	char name[16];
 	atomic_size_t inuse;
+	atomic_uint_fast64_t allocations;
 	atomic_bool hi_called;
 	atomic_bool is_overmem;
 	atomic_size_t hi_water;
@@ -145,6 +169,32 @@ struct isc_mem {
 #define MEMPOOL_MAGIC	 ISC_MAGIC('M', 'E', 'M', 'p')
 #define VALID_MEMPOOL(c) ISC_MAGIC_VALID(c, MEMPOOL_MAGIC)
 
+/*
+ * The shared pools keep the free items in magazines, fixed size stacks
+ * of items.  Each loop has a loaded and a previous magazine that only
+ * the loop uses; full and empty magazines are exchanged with the depot
+ * of the pool, which is locked.
+ */
+#define MEMPOOL_MAGAZINESIZE 64
+
+typedef struct mempool_magazine mempool_magazine_t;
+struct mempool_magazine {
+	mempool_magazine_t *next; /*%< next magazine in the depot */
+	size_t rounds;		  /*%< # of items in the magazine */
+	void *items[MEMPOOL_MAGAZINESIZE];
+};
+
+typedef struct mempool_cache {
+	mempool_magazine_t *loaded;
+	mempool_magazine_t *previous;
+	/* Only written by the loop, read by the statistics */
+	atomic_int_fast64_t allocated;
+	atomic_uint_fast64_t gets;
+	uint8_t __padding[ISC_OS_CACHELINE_SIZE - 2 * sizeof(void *) -
+			  sizeof(atomic_int_fast64_t) -
+			  sizeof(atomic_uint_fast64_t)];
+} mempool_cache_t;
+
 struct isc_mempool {
 	/* always unlocked */
 	unsigned int magic;
@@ -160,6 +210,14 @@ struct isc_mempool {
 	size_t gets; /*%< # of requests to this pool */
 	/*%< Debugging only. */
 	char name[16]; /*%< printed name in stats reports */
+	/*%< Shared pools only. */
+	mempool_cache_t *caches;	/*%< magazines of each loop */
+	uint32_t ncaches;		/*%< # of loops */
+	atomic_int_fast64_t otherallocated; /*%< # given out off the loops */
+	isc_mutex_t depotlock;
+	mempool_magazine_t *full;  /*%< full magazines in the depot */
+	mempool_magazine_t *empty; /*%< empty magazines in the depot */
+	size_t nfull;		   /*%< # of full magazines */
 };
 
 /*
@@ -291,6 +349,22 @@ unlock:
 		s = ZERO_ALLOCATION_SIZE; \
 	}
 
+/*!
+ * Return the jemalloc flags for an allocation from 'ctx' on this thread.
+ */
+static int
+mem_jemalloc_flags(isc_mem_t *ctx) {
+	if (ctx->threadaffine) {
+		uint32_t tid = isc_tid();
+
+		if (tid < mem_nthreads) {
+			return mem_threads[tid].jemalloc_flags;
+		}
+	}
+
+	return ctx->jemalloc_flags;
+}
+
 /*!
  * Perform a malloc, doing memory filling and overrun detection as necessary.
  */
@@ -300,7 +374,7 @@ mem_get(isc_mem_t *ctx, size_t size, int flags) {
 
 	ADJUST_ZERO_ALLOCATION_SIZE(size);
 
-	ret = mallocx(size, flags | ctx->jemalloc_flags);
+	ret = mallocx(size, flags | mem_jemalloc_flags(ctx));
 	INSIST(ret != NULL);
 
 	if ((flags & ISC__MEM_ZERO) == 0 &&
@@ -323,7 +397,7 @@ mem_put(isc_mem_t *ctx, void *mem, size_t size, int flags) {
 	if ((ctx->flags & ISC_MEMFLAG_FILL) != 0) {
 		memset(mem, 0xde, size); /* Mnemonic for "dead". */
 	}
-	sdallocx(mem, size, flags | ctx->jemalloc_flags);
+	sdallocx(mem, size, flags | mem_jemalloc_flags(ctx));
 }
 
 static void *
@@ -333,7 +407,7 @@ mem_realloc(isc_mem_t *ctx, void *old_ptr, size_t old_size, size_t new_size,
 
 	ADJUST_ZERO_ALLOCATION_SIZE(new_size);
 
-	new_ptr = rallocx(old_ptr, new_size, flags | ctx->jemalloc_flags);
+	new_ptr = rallocx(old_ptr, new_size, flags | mem_jemalloc_flags(ctx));
 	INSIST(new_ptr != NULL);
 
 	if ((flags & ISC__MEM_ZERO) == 0 &&
@@ -356,6 +430,7 @@ mem_realloc(isc_mem_t *ctx, void *old_ptr, size_t old_size, size_t new_size,
 static void
 mem_getstats(isc_mem_t *ctx, size_t size) {
 	atomic_fetch_add_relaxed(&ctx->inuse, size);
+	atomic_fetch_add_relaxed(&ctx->allocations, 1);
 }
 
 /*!
@@ -413,6 +488,107 @@ mem_jemalloc_arena_destroy(unsigned int arenano) {
 #endif /* JEMALLOC_API_SUPPORTED */
 }
 
+static bool
+mem_jemalloc_tcache_create(unsigned int *ptcacheno) {
+	REQUIRE(ptcacheno != NULL);
+
+#ifdef JEMALLOC_API_SUPPORTED
+	unsigned int tcacheno = 0;
+	size_t len = sizeof(tcacheno);
+
+	if (mallctl("tcache.create", &tcacheno, &len, NULL, 0) != 0) {
+		return false;
+	}
+
+	*ptcacheno = tcacheno;
+	return true;
+#else
+	*ptcacheno = 0;
+	return false;
+#endif /* JEMALLOC_API_SUPPORTED */
+}
+
+static void
+mem_jemalloc_tcache_destroy(unsigned int tcacheno) {
+#ifdef JEMALLOC_API_SUPPORTED
+	(void)mallctl("tcache.destroy", NULL, NULL, &tcacheno,
+		      sizeof(tcacheno));
+#else
+	UNUSED(tcacheno);
+#endif /* JEMALLOC_API_SUPPORTED */
+}
+
+/*
+ * Create the arena and the tcache of each thread.  When jemalloc doesn't
+ * provide them, the threads use the default flags.
+ */
+static void
+mem_threads_create(void) {
+	uint32_t nthreads = isc_tid_count();
+
+	if (mem_threads != NULL || nthreads == 0) {
+		return;
+	}
+
+	mem_threads = mallocx(ISC_CHECKED_MUL(nthreads, sizeof(mem_threads[0])),
+			      MALLOCX_ZERO);
+	INSIST(mem_threads != NULL);
+
+	for (uint32_t i = 0; i < nthreads; i++) {
+		mem_thread_t *thread = &mem_threads[i];
+
+		thread->arena = ISC_MEM_ILLEGAL_ARENA;
+		RUNTIME_CHECK(mem_jemalloc_arena_create(&thread->arena));
+		if (thread->arena == ISC_MEM_ILLEGAL_ARENA) {
+			continue;
+		}
+
+		thread->hastcache = mem_jemalloc_tcache_create(&thread->tcache);
+		if (thread->hastcache) {
+			thread->jemalloc_flags =
+				MALLOCX_ARENA(thread->arena) |
+				MALLOCX_TCACHE(thread->tcache);
+		} else {
+			thread->jemalloc_flags = MALLOCX_ARENA(thread->arena) |
+						 MALLOCX_TCACHE_NONE;
+		}
+	}
+
+	mem_nthreads = nthreads;
+}
+
+static void
+mem_threads_destroy(void) {
+	if (mem_threads == NULL) {
+		return;
+	}
+
+	/*
+	 * A thread cache may hold memory of any arena, so all of them are
+	 * flushed before the first arena is destroyed.
+	 */
+	for (uint32_t i = 0; i < mem_nthreads; i++) {
+		mem_thread_t *thread = &mem_threads[i];
+
+		if (thread->hastcache) {
+			mem_jemalloc_tcache_destroy(thread->tcache);
+		}
+	}
+
+	for (uint32_t i = 0; i < mem_nthreads; i++) {
+		mem_thread_t *thread = &mem_threads[i];
+
+		if (thread->arena == ISC_MEM_ILLEGAL_ARENA) {
+			continue;
+		}
+		RUNTIME_CHECK(mem_jemalloc_arena_destroy(thread->arena));
+	}
+
+	sdallocx(mem_threads, mem_nthreads * sizeof(mem_threads[0]), 0);
+	mem_threads = NULL;
+	mem_nthreads = 0;
+}
+
 static void
 mem_initialize(void) {
 /*
@@ -442,6 +618,7 @@ mem_shutdown(void) {
 	UNLOCK(&contextslock);
 
 	if (empty) {
+		mem_threads_destroy();
 		isc_mutex_destroy(&contextslock);
 	}
 }
@@ -474,6 +651,7 @@ mem_create(isc_mem_t **ctxp, unsigned int debugging, unsigned int flags,
 	isc_refcount_init(&ctx->references, 1);
 
 	atomic_init(&ctx->inuse, 0);
+	atomic_init(&ctx->allocations, 0);
 	atomic_init(&ctx->hi_water, 0);
 	atomic_init(&ctx->lo_water, 0);
 	atomic_init(&ctx->hi_called, false);
@@ -707,6 +885,34 @@ print_active(isc_mem_t *mctx, FILE *out) {
 }
 #endif /* if ISC_MEM_TRACKLINES */
 
+static size_t
+mempool_allocated(isc_mempool_t *mpctx) {
+	int_fast64_t allocated;
+
+	if (mpctx->caches == NULL) {
+		return mpctx->allocated;
+	}
+
+	/* The items can be freed on another loop than they came from */
+	allocated = atomic_load_relaxed(&mpctx->otherallocated);
+	for (uint32_t i = 0; i < mpctx->ncaches; i++) {
+		allocated += atomic_load_relaxed(&mpctx->caches[i].allocated);
+	}
+
+	return allocated > 0 ? (size_t)allocated : 0;
+}
+
+static size_t
+mempool_gets(isc_mempool_t *mpctx) {
+	size_t gets = mpctx->gets;
+
+	for (uint32_t i = 0; i < mpctx->ncaches; i++) {
+		gets += atomic_load_relaxed(&mpctx->caches[i].gets);
+	}
+
+	return gets;
+}
+
 /*
  * Print the stats[] on the stream "out" with suitable formatting.
  */
@@ -735,9 +941,11 @@ isc_mem_stats(isc_mem_t *ctx, FILE *out) {
 	while (pool != NULL) {
 		fprintf(out,
 			"%15s %10zu %10zu %10zu %10zu %10zu %10zu %10zu %s\n",
-			pool->name, pool->size, (size_t)0, pool->allocated,
-			pool->freecount, pool->freemax, pool->fillcount,
-			pool->gets, "N");
+			pool->name, pool->size, (size_t)0,
+			mempool_allocated(pool),
+			(size_t)isc_mempool_getfreecount(pool), pool->freemax,
+			pool->fillcount, mempool_gets(pool),
+			pool->caches != NULL ? "Y" : "N");
 		pool = ISC_LIST_NEXT(pool, link);
 	}
 
@@ -904,6 +1112,63 @@ isc_mem_inuse(isc_mem_t *ctx) {
 	return atomic_load_relaxed(&ctx->inuse);
 }
 
+uint64_t
+isc_mem_allocations(isc_mem_t *ctx) {
+	REQUIRE(VALID_CONTEXT(ctx));
+
+	return atomic_load_relaxed(&ctx->allocations);
+}
+
+unsigned int
+isc_mem_pressure(isc_mem_t *ctx) {
+	unsigned int pressure = atomic_load_relaxed(&mem_syspressure);
+
+	REQUIRE(VALID_CONTEXT(ctx));
+
+	if (isc_mem_isovermem(ctx)) {
+		return ISC_MEM_PRESSURE_MAX;
+	}
+
+	size_t hiwater = atomic_load_relaxed(&ctx->hi_water);
+	size_t lowater = atomic_load_relaxed(&ctx->lo_water);
+	if (hiwater <= lowater) {
+		return pressure;
+	}
+
+	/* The pressure rises from the low to the high water mark */
+	size_t inuse = atomic_load_relaxed(&ctx->inuse);
+	if (inuse > lowater) {
+		size_t ctxpressure = ISC_MIN(inuse - lowater,
+					     hiwater - lowater) *
+				     ISC_MEM_PRESSURE_MAX /
+				     (hiwater - lowater);
+		pressure = ISC_MAX(pressure, ctxpressure);
+	}
+
+	return pressure;
+}
+
+void
+isc_mem_checkpressure(void) {
+	uint64_t limit = isc_meminfo_limit();
+	uint64_t rss, start;
+	unsigned int pressure = 0;
+
+	if (limit != 0) {
+		/* The pressure rises from 7/8ths of the limit */
+		start = limit - (limit >> 3);
+		rss = isc_meminfo_rss();
+		if (rss >= limit) {
+			pressure = ISC_MEM_PRESSURE_MAX;
+		} else if (rss > start) {
+			pressure = (rss - start) * ISC_MEM_PRESSURE_MAX /
+				   (limit - start);
+		}
+	}
+
+	atomic_store_relaxed(&mem_syspressure, pressure);
+}
+
 void
 isc_mem_clearwater(isc_mem_t *mctx) {
 	isc_mem_setwater(mctx, 0, 0);
@@ -1039,6 +1304,31 @@ isc__mempool_create(isc_mem_t *restrict mctx, const size_t element_size,
 	MCTXUNLOCK(mctx);
 }
 
+void
+isc__mempool_create_shared(isc_mem_t *restrict mctx, const size_t element_size,
+			   isc_mempool_t **restrict mpctxp FLARG) {
+	isc_mempool_t *mpctx = NULL;
+
+	isc__mempool_create(mctx, element_size, mpctxp FLARG_PASS);
+	mpctx = *mpctxp;
+
+	mpctx->ncaches = isc_tid_count();
+	mpctx->freemax = mpctx->ncaches * MEMPOOL_MAGAZINESIZE;
+	isc_mutex_init(&mpctx->depotlock);
+
+	/* Without the loops, this is a pool only used off the loops */
+	mpctx->caches = isc_mem_cget(mctx, ISC_MAX(mpctx->ncaches, 1),
+				     sizeof(mpctx->caches[0]));
+	for (uint32_t i = 0; i < mpctx->ncaches; i++) {
+		mempool_cache_t *cache = &mpctx->caches[i];
+
+		cache->loaded = isc_mem_get(mctx, sizeof(*cache->loaded));
+		cache->loaded->rounds = 0;
+		cache->previous = isc_mem_get(mctx, sizeof(*cache->previous));
+		cache->previous->rounds = 0;
+	}
+}
+
 void
 isc_mempool_setname(isc_mempool_t *restrict mpctx, const char *name) {
 	REQUIRE(VALID_MEMPOOL(mpctx));
@@ -1047,6 +1337,44 @@ isc_mempool_setname(isc_mempool_t *restrict mpctx, const char *name) {
 	strlcpy(mpctx->name, name, sizeof(mpctx->name));
 }
 
+/*
+ * Return the items in 'mag' to the memory context and free it.
+ */
+static void
+mempool_magazine_free(isc_mempool_t *mpctx, mempool_magazine_t *mag) {
+	isc_mem_t *mctx = mpctx->mctx;
+
+	while (mag->rounds > 0) {
+		mem_putstats(mctx, mpctx->size);
+		mem_put(mctx, mag->items[--mag->rounds], mpctx->size, 0);
+	}
+	isc_mem_put(mctx, mag, sizeof(*mag));
+}
+
+static void
+mempool_depot_destroy(isc_mempool_t *mpctx) {
+	mempool_magazine_t *mag = NULL;
+
+	for (uint32_t i = 0; i < mpctx->ncaches; i++) {
+		mempool_magazine_free(mpctx, mpctx->caches[i].loaded);
+		mempool_magazine_free(mpctx, mpctx->caches[i].previous);
+	}
+	isc_mem_cput(mpctx->mctx, mpctx->caches, ISC_MAX(mpctx->ncaches, 1),
+		     sizeof(mpctx->caches[0]));
+
+	while ((mag = mpctx->full) != NULL) {
+		mpctx->full = mag->next;
+		mempool_magazine_free(mpctx, mag);
+	}
+	while ((mag = mpctx->empty) != NULL) {
+		mpctx->empty = mag->next;
+		mempool_magazine_free(mpctx, mag);
+	}
+	mpctx->nfull = 0;
+
+	isc_mutex_destroy(&mpctx->depotlock);
+}
+
 void
 isc__mempool_destroy(isc_mempool_t **restrict mpctxp FLARG) {
 	isc_mempool_t *restrict mpctx = NULL;
@@ -1068,10 +1396,14 @@ isc__mempool_destroy(isc_mempool_t **restrict mpctxp FLARG) {
 	}
 #endif
 
-	if (mpctx->allocated > 0) {
+	if (mempool_allocated(mpctx) > 0) {
 		UNEXPECTED_ERROR("mempool %s leaked memory", mpctx->name);
 	}
-	REQUIRE(mpctx->allocated == 0);
+	REQUIRE(mempool_allocated(mpctx) == 0);
+
+	if (mpctx->caches != NULL) {
+		mempool_depot_destroy(mpctx);
+	}
 
 	/*
 	 * Return any items on the free list
@@ -1100,12 +1432,148 @@ isc__mempool_destroy(isc_mempool_t **restrict mpctxp FLARG) {
 	isc_mem_putanddetach(&mpctx->mctx, mpctx, sizeof(isc_mempool_t));
 }
 
+#if !__SANITIZE_ADDRESS__
+/*
+ * Take an item from the magazines of 'cache', exchanging the empty
+ * magazine for a full one from the depot when both are empty.
+ */
+static void *
+mempool_cache_get(isc_mempool_t *restrict mpctx, mempool_cache_t *cache) {
+	mempool_magazine_t *mag = NULL;
+
+	if (cache->loaded->rounds == 0) {
+		if (cache->previous->rounds == 0) {
+			LOCK(&mpctx->depotlock);
+			mag = mpctx->full;
+			if (mag != NULL) {
+				mpctx->full = mag->next;
+				mpctx->nfull--;
+				cache->previous->next = mpctx->empty;
+				mpctx->empty = cache->previous;
+			}
+			UNLOCK(&mpctx->depotlock);
+
+			if (mag == NULL) {
+				return NULL;
+			}
+			cache->previous = mag;
+		}
+
+		mag = cache->loaded;
+		cache->loaded = cache->previous;
+		cache->previous = mag;
+	}
+
+	return cache->loaded->items[--cache->loaded->rounds];
+}
+
+/*
+ * Put an item in the magazines of 'cache', exchanging the full magazine
+ * for an empty one when both are full.  Returns false when the depot
+ * is full too.
+ */
+static bool
+mempool_cache_put(isc_mempool_t *restrict mpctx, mempool_cache_t *cache,
+		  void *item) {
+	mempool_magazine_t *mag = NULL;
+
+	if (cache->loaded->rounds == MEMPOOL_MAGAZINESIZE) {
+		if (cache->previous->rounds == MEMPOOL_MAGAZINESIZE) {
+			LOCK(&mpctx->depotlock);
+			if ((mpctx->nfull + 1) * MEMPOOL_MAGAZINESIZE >
+			    mpctx->freemax)
+			{
+				UNLOCK(&mpctx->depotlock);
+				return false;
+			}
+			cache->previous->next = mpctx->full;
+			mpctx->full = cache->previous;
+			mpctx->nfull++;
+			mag = mpctx->empty;
+			if (mag != NULL) {
+				mpctx->empty = mag->next;
+			}
+			UNLOCK(&mpctx->depotlock);
+
+			if (mag == NULL) {
+				mag = isc_mem_get(mpctx->mctx, sizeof(*mag));
+				mag->rounds = 0;
+			}
+			cache->previous = mag;
+		}
+
+		mag = cache->loaded;
+		cache->loaded = cache->previous;
+		cache->previous = mag;
+	}
+
+	cache->loaded->items[cache->loaded->rounds++] = item;
+
+	return true;
+}
+#endif /* !__SANITIZE_ADDRESS__ */
+
+static void *
+mempool_shared_get(isc_mempool_t *restrict mpctx) {
+	uint32_t tid = isc_tid();
+	void *item = NULL;
+
+	if (tid >= mpctx->ncaches) {
+		(void)atomic_fetch_add_relaxed(&mpctx->otherallocated, 1);
+	} else {
+		mempool_cache_t *cache = &mpctx->caches[tid];
+
+		atomic_store_relaxed(&cache->allocated,
+				     atomic_load_relaxed(&cache->allocated) + 1);
+		atomic_store_relaxed(&cache->gets,
+				     atomic_load_relaxed(&cache->gets) + 1);
+#if !__SANITIZE_ADDRESS__
+		item = mempool_cache_get(mpctx, cache);
+#endif
+	}
+
+	if (item == NULL) {
+		item = mem_get(mpctx->mctx, mpctx->size, 0);
+		mem_getstats(mpctx->mctx, mpctx->size);
+	}
+
+	return item;
+}
+
+static void
+mempool_shared_put(isc_mempool_t *restrict mpctx, void *mem) {
+	uint32_t tid = isc_tid();
+
+	if (tid >= mpctx->ncaches) {
+		(void)atomic_fetch_sub_relaxed(&mpctx->otherallocated, 1);
+	} else {
+		mempool_cache_t *cache = &mpctx->caches[tid];
+
+		atomic_store_relaxed(&cache->allocated,
+				     atomic_load_relaxed(&cache->allocated) - 1);
+#if !__SANITIZE_ADDRESS__
+		if (mempool_cache_put(mpctx, cache, mem)) {
+			return;
+		}
+#endif
+	}
+
+	mem_putstats(mpctx->mctx, mpctx->size);
+	mem_put(mpctx->mctx, mem, mpctx->size, 0);
+}
+
 void *
 isc__mempool_get(isc_mempool_t *restrict mpctx FLARG) {
 	element *restrict item = NULL;
 
 	REQUIRE(VALID_MEMPOOL(mpctx));
 
+	if (mpctx->caches != NULL) {
+		item = mempool_shared_get(mpctx);
+		ADD_TRACE(mpctx->mctx, item, mpctx->size, file, line);
+		return item;
+	}
+
 	mpctx->allocated++;
 
 	if (mpctx->items == NULL) {
@@ -1149,6 +1617,12 @@ isc__mempool_put(isc_mempool_t *restrict mpctx, void *mem FLARG) {
 	REQUIRE(VALID_MEMPOOL(mpctx));
 	REQUIRE(mem != NULL);
 
+	if (mpctx->caches != NULL) {
+		DELETE_TRACE(mpctx->mctx, mem, mpctx->size, file, line);
+		mempool_shared_put(mpctx, mem);
+		return;
+	}
+
 	isc_mem_t *mctx = mpctx->mctx;
 	const size_t freecount = mpctx->freecount;
 #if !__SANITIZE_ADDRESS__
@@ -1200,16 +1674,26 @@ isc_mempool_getfreemax(isc_mempool_t *restrict mpctx) {
 
 unsigned int
 isc_mempool_getfreecount(isc_mempool_t *restrict mpctx) {
+	unsigned int freecount;
+
 	REQUIRE(VALID_MEMPOOL(mpctx));
 
-	return mpctx->freecount;
+	if (mpctx->caches == NULL) {
+		return mpctx->freecount;
+	}
+
+	LOCK(&mpctx->depotlock);
+	freecount = mpctx->nfull * MEMPOOL_MAGAZINESIZE;
+	UNLOCK(&mpctx->depotlock);
+
+	return freecount;
 }
 
 unsigned int
 isc_mempool_getallocated(isc_mempool_t *restrict mpctx) {
 	REQUIRE(VALID_MEMPOOL(mpctx));
 
-	return mpctx->allocated;
+	return mempool_allocated(mpctx);
 }
 
 void
@@ -1340,6 +1824,11 @@ xml_renderctx(isc_mem_t *ctx, size_t *inuse, xmlTextWriterPtr writer) {
 		(uint64_t)atomic_load_relaxed(&ctx->lo_water)));
 	TRY0(xmlTextWriterEndElement(writer)); /* lowater */
 
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "pressure"));
+	TRY0(xmlTextWriterWriteFormatString(writer, "%u",
+					    isc_mem_pressure(ctx)));
+	TRY0(xmlTextWriterEndElement(writer)); /* pressure */
+
 	TRY0(xmlTextWriterEndElement(writer)); /* context */
 
 error:
@@ -1393,6 +1882,79 @@ error:
 #ifdef HAVE_JSON_C
 #define CHECKMEM(m) RUNTIME_CHECK(m != NULL)
 
+#ifdef JEMALLOC_API_SUPPORTED
+static size_t
+jemalloc_arena_stat(unsigned int arena, const char *name) {
+	char buf[256];
+	size_t value = 0, len = sizeof(value);
+
+	(void)snprintf(buf, sizeof(buf), "stats.arenas.%u.%s", arena, name);
+	if (mallctl(buf, &value, &len, NULL, 0) != 0) {
+		return 0;
+	}
+
+	return value;
+}
+#endif /* JEMALLOC_API_SUPPORTED */
+
+/*
+ * Add the statistics of the jemalloc 'arena' to 'array', if jemalloc
+ * keeps them.
+ */
+static void
+json_renderarena(unsigned int arena, uint32_t tid, json_object *array) {
+#ifdef JEMALLOC_API_SUPPORTED
+	json_object *arenaobj, *obj;
+	size_t page = 0, len = sizeof(page);
+
+	if (arena == ISC_MEM_ILLEGAL_ARENA ||
+	    mallctl("arenas.page", &page, &len, NULL, 0) != 0)
+	{
+		return;
+	}
+
+	arenaobj = json_object_new_object();
+	CHECKMEM(arenaobj);
+
+	obj = json_object_new_int64(arena);
+	CHECKMEM(obj);
+	json_object_object_add(arenaobj, "arena", obj);
+
+	if (tid != ISC_TID_UNKNOWN) {
+		obj = json_object_new_int64(tid);
+		CHECKMEM(obj);
+		json_object_object_add(arenaobj, "thread", obj);
+	}
+
+	obj = json_object_new_int64(
+		jemalloc_arena_stat(arena, "small.allocated") +
+		jemalloc_arena_stat(arena, "large.allocated"));
+	CHECKMEM(obj);
+	json_object_object_add(arenaobj, "allocated", obj);
+
+	obj = json_object_new_int64(jemalloc_arena_stat(arena, "pactive") *
+				    page);
+	CHECKMEM(obj);
+	json_object_object_add(arenaobj, "active", obj);
+
+	obj = json_object_new_int64(jemalloc_arena_stat(arena, "pdirty") *
+				    page);
+	CHECKMEM(obj);
+	json_object_object_add(arenaobj, "dirty", obj);
+
+	obj = json_object_new_int64(jemalloc_arena_stat(arena, "pmuzzy") *
+				    page);
+	CHECKMEM(obj);
+	json_object_object_add(arenaobj, "muzzy", obj);
+
+	json_object_array_add(array, arenaobj);
+#else
+	UNUSED(arena);
+	UNUSED(tid);
+	UNUSED(array);
+#endif /* JEMALLOC_API_SUPPORTED */
+}
+
 static isc_result_t
 json_renderctx(isc_mem_t *ctx, size_t *inuse, json_object *array) {
 	REQUIRE(VALID_CONTEXT(ctx));
@@ -1443,6 +2005,21 @@ json_renderctx(isc_mem_t *ctx, size_t *inuse, json_object *array) {
 	CHECKMEM(obj);
 	json_object_object_add(ctxobj, "lowater", obj);
 
+	obj = json_object_new_int64(isc_mem_pressure(ctx));
+	CHECKMEM(obj);
+	json_object_object_add(ctxobj, "pressure", obj);
+
+	if (ctx->jemalloc_arena != ISC_MEM_ILLEGAL_ARENA) {
+		obj = json_object_new_array();
+		CHECKMEM(obj);
+		json_renderarena(ctx->jemalloc_arena, ISC_TID_UNKNOWN, obj);
+		json_object_object_add(ctxobj, "arenas", obj);
+	} else if (ctx->threadaffine) {
+		obj = json_object_new_boolean(true);
+		CHECKMEM(obj);
+		json_object_object_add(ctxobj, "threadaffine", obj);
+	}
+
 	MCTXUNLOCK(ctx);
 	json_object_array_add(array, ctxobj);
 	return ISC_R_SUCCESS;
@@ -1453,12 +2030,19 @@ isc_mem_renderjson(void *memobj0) {
 	isc_result_t result = ISC_R_SUCCESS;
 	isc_mem_t *ctx;
 	size_t inuse = 0;
-	json_object *ctxarray, *obj;
+	json_object *ctxarray, *arenaarray, *obj;
 	json_object *memobj = (json_object *)memobj0;
 
 	ctxarray = json_object_new_array();
 	CHECKMEM(ctxarray);
 
+#ifdef JEMALLOC_API_SUPPORTED
+	/* Refresh the statistics of the arenas */
+	uint64_t epoch = 1;
+	size_t len = sizeof(epoch);
+	(void)mallctl("epoch", &epoch, &len, &epoch, len);
+#endif /* JEMALLOC_API_SUPPORTED */
+
 	LOCK(&contextslock);
 	for (ctx = ISC_LIST_HEAD(contexts); ctx != NULL;
 	     ctx = ISC_LIST_NEXT(ctx, link))
@@ -1480,6 +2064,16 @@ isc_mem_renderjson(void *memobj0) {
 	json_object_object_add(memobj, "Malloced", obj);
 
 	json_object_object_add(memobj, "contexts", ctxarray);
+
+	arenaarray = json_object_new_array();
+	CHECKMEM(arenaarray);
+	LOCK(&contextslock);
+	for (uint32_t i = 0; i < mem_nthreads; i++) {
+		json_renderarena(mem_threads[i].arena, i, arenaarray);
+	}
+	UNLOCK(&contextslock);
+	json_object_object_add(memobj, "arenas", arenaarray);
+
 	return ISC_R_SUCCESS;
 
 error:
@@ -1529,6 +2123,30 @@ isc__mem_create_arena(isc_mem_t **mctxp FLARG) {
 #endif /* ISC_MEM_TRACKLINES */
 }
 
+void
+isc__mem_create_threadaffine(isc_mem_t **mctxp FLARG) {
+	/*
+	 * The threads without an arena bypass their tcache, so that no
+	 * tcache other than those of the threads holds memory from their
+	 * arenas when the arenas are destroyed.
+	 */
+	mem_create(mctxp, isc_mem_debugging, isc_mem_defaultflags,
+		   MALLOCX_TCACHE_NONE);
+
+	LOCK(&contextslock);
+	mem_threads_create();
+	UNLOCK(&contextslock);
+
+	(*mctxp)->threadaffine = true;
+#if ISC_MEM_TRACKLINES
+	if ((isc_mem_debugging & ISC_MEM_DEBUGTRACE) != 0) {
+		fprintf(stderr,
+			"create mctx %p file %s line %u with thread arenas\n",
+			*mctxp, file, line);
+	}
+#endif /* ISC_MEM_TRACKLINES */
+}
+
 #ifdef JEMALLOC_API_SUPPORTED
 static bool
 jemalloc_set_ssize_value(const char *valname, ssize_t newval) {
@@ -12,10 +12,19 @@
  */
 
 #include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include <isc/meminfo.h>
 #include <isc/uv.h>
 
+/*
+ * The control group of the process, as seen from inside it with the
+ * cgroup v2 hierarchy.
+ */
+#define CGROUP_DIR "/sys/fs/cgroup/"
+
 uint64_t
 isc_meminfo_totalphys(void) {
 	uint64_t tmem = uv_get_total_memory();
@@ -27,3 +36,54 @@ isc_meminfo_totalphys(void) {
 #endif /* UV_VERSION_HEX >= UV_VERSION(1, 29, 0) */
 	return tmem;
 }
+
+uint64_t
+isc_meminfo_rss(void) {
+	size_t rss = 0;
+
+	if (uv_resident_set_memory(&rss) != 0) {
+		return 0;
+	}
+
+	return rss;
+}
+
+/*
+ * Read a memory limit of the control group, which is "max" when there is
+ * none.
+ */
+static uint64_t
+cgroup_limit(const char *filename) {
+	char buf[64];
+	char *end = NULL;
+	uint64_t limit = 0;
+	FILE *fp = fopen(filename, "r");
+
+	if (fp == NULL) {
+		return 0;
+	}
+
+	if (fgets(buf, sizeof(buf), fp) != NULL &&
+	    strncmp(buf, "max", 3) != 0)
+	{
+		limit = strtoull(buf, &end, 10);
+		if (end == buf) {
+			limit = 0;
+		}
+	}
+
+	(void)fclose(fp);
+
+	return limit;
+}
+
+uint64_t
+isc_meminfo_limit(void) {
+	uint64_t limit = cgroup_limit(CGROUP_DIR "memory.high");
+
+	if (limit == 0) {
+		limit = cgroup_limit(CGROUP_DIR "memory.max");
+	}
+
+	return limit;
+}
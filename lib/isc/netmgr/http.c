@@ -85,6 +85,15 @@
 
 #define INITIAL_DNS_MESSAGE_BUFFER_SIZE (512)
 
+/*
+ * The number of freed server stream objects kept by an HTTP/2 session
+ * for reuse by its next streams.
+ */
+#define HTTP_SSTREAMS_POOL_SIZE (32)
+
+/* The size of a serialized HTTP/2 frame header */
+#define HTTP2_FRAME_HEADER_SIZE (9)
+
 typedef struct isc_nm_http_response_status {
 	size_t code;
 	size_t content_length;
@@ -143,6 +152,9 @@ struct isc_nm_http_session {
 	ISC_LIST(http_cstream_t) cstreams;
 	ISC_LIST(isc_nmsocket_h2_t) sstreams;
 	size_t nsstreams;
+	ISC_LIST(isc_nmsocket_h2_t) freesstreams;
+	size_t nfreesstreams;
+	isc_nmsocket_h2_t *direct;
 
 	isc_nmhandle_t *handle;
 	isc_nmhandle_t *client_httphandle;
@@ -152,6 +164,7 @@ struct isc_nm_http_session {
 
 	isc_tlsctx_t *tlsctx;
 	uint32_t max_concurrent_streams;
+	uint32_t window; /* flow-control window we advertise */
 
 	isc__nm_http_pending_callbacks_t pending_write_callbacks;
 	isc_buffer_t *pending_write_data;
@@ -297,6 +310,7 @@ new_session(isc_mem_t *mctx, isc_tlsctx_t *tctx,
 	isc_mem_attach(mctx, &session->mctx);
 	ISC_LIST_INIT(session->cstreams);
 	ISC_LIST_INIT(session->sstreams);
+	ISC_LIST_INIT(session->freesstreams);
 	ISC_LIST_INIT(session->pending_write_callbacks);
 
 	*sessionp = session;
@@ -342,6 +356,12 @@ isc__nm_httpsession_detach(isc_nm_http_session_t **sessionp) {
 		isc_buffer_free(&session->buf);
 	}
 
+	while (!ISC_LIST_EMPTY(session->freesstreams)) {
+		isc_nmsocket_h2_t *h2 = ISC_LIST_HEAD(session->freesstreams);
+		ISC_LIST_UNLINK(session->freesstreams, h2, link);
+		isc_mem_put(session->mctx, h2, sizeof(*h2));
+	}
+
 	/* We need an acquire memory barrier here */
 	(void)isc_refcount_current(&session->references);
 
@@ -555,31 +575,81 @@ on_client_data_chunk_recv_callback(int32_t stream_id, const uint8_t *data,
 	return 0;
 }
 
+static void
+server_rbuf_putmem(isc_nmsocket_h2_t *h2, const uint8_t *data, size_t len) {
+	isc_mem_t *mctx = h2->psock->worker->mctx;
+
+	if (isc_buffer_base(&h2->rbuf) == NULL) {
+		isc_buffer_init(&h2->rbuf,
+				isc_mem_allocate(mctx, h2->content_length),
+				MAX_DNS_MESSAGE_SIZE);
+	}
+	isc_buffer_putmem(&h2->rbuf, data, len);
+	isc__nm_streamstats(h2->psock, 0, len);
+}
+
+static void
+server_clear_direct(isc_nmsocket_h2_t *h2) {
+	if (h2->session != NULL && h2->session->direct == h2) {
+		h2->session->direct = NULL;
+	}
+	h2->direct = (isc_region_t){ 0 };
+}
+
+static void
+server_flush_direct(isc_nm_http_session_t *session) {
+	isc_nmsocket_h2_t *h2 = session->direct;
+	isc_region_t direct;
+
+	/*
+	 * A request body referred to in place must not outlive the read
+	 * buffer it is in; copy it if the request is not complete yet.
+	 */
+	if (h2 == NULL) {
+		return;
+	}
+
+	direct = h2->direct;
+	server_clear_direct(h2);
+	server_rbuf_putmem(h2, direct.base, direct.length);
+}
+
+static size_t
+server_bodylength(isc_nmsocket_h2_t *h2) {
+	return isc_buffer_usedlength(&h2->rbuf) + h2->direct.length;
+}
+
 static int
 on_server_data_chunk_recv_callback(int32_t stream_id, const uint8_t *data,
 				   size_t len, isc_nm_http_session_t *session) {
 	isc_nmsocket_h2_t *h2 = ISC_LIST_HEAD(session->sstreams);
-	isc_mem_t *mctx = h2->psock->worker->mctx;
 
 	while (h2 != NULL) {
 		if (stream_id == h2->stream_id) {
-			if (isc_buffer_base(&h2->rbuf) == NULL) {
-				isc_buffer_init(
-					&h2->rbuf,
-					isc_mem_allocate(mctx,
-							 h2->content_length),
-					MAX_DNS_MESSAGE_SIZE);
-			}
-			size_t new_bufsize = isc_buffer_usedlength(&h2->rbuf) +
-					     len;
-			if (new_bufsize <= MAX_DNS_MESSAGE_SIZE &&
-			    new_bufsize <= h2->content_length)
+			size_t new_bufsize = server_bodylength(h2) + len;
+			if (new_bufsize > MAX_DNS_MESSAGE_SIZE ||
+			    new_bufsize > h2->content_length)
 			{
-				isc_buffer_putmem(&h2->rbuf, data, len);
+				return NGHTTP2_ERR_TEMPORAL_CALLBACK_FAILURE;
+			}
+
+			if (len == h2->content_length) {
+				/*
+				 * The whole body is in this chunk, so it
+				 * can be parsed straight from the read
+				 * buffer once the request is complete.
+				 */
+				server_flush_direct(session);
+				h2->direct = (isc_region_t){
+					.base = UNCONST(data),
+					.length = len,
+				};
+				session->direct = h2;
 				break;
 			}
 
-			return NGHTTP2_ERR_TEMPORAL_CALLBACK_FAILURE;
+			server_rbuf_putmem(h2, data, len);
+			break;
 		}
 		h2 = ISC_LIST_NEXT(h2, link);
 	}
@@ -664,6 +734,7 @@ on_server_stream_close_callback(int32_t stream_id,
 
 	ISC_LIST_UNLINK(session->sstreams, sock->h2, link);
 	session->nsstreams--;
+	server_clear_direct(sock->h2);
 
 	/*
 	 * By making a call to isc__nmsocket_prep_destroy(), we ensure that
@@ -844,9 +915,32 @@ initialize_nghttp2_client_session(isc_nm_http_session_t *session) {
 	nghttp2_session_callbacks_del(callbacks);
 }
 
+/*
+ * Advertise a larger connection flow-control window than the default
+ * one; the streams get theirs from the SETTINGS_INITIAL_WINDOW_SIZE.
+ */
+static int
+http_set_connection_window(isc_nm_http_session_t *session) {
+	if (session->window <= NGHTTP2_INITIAL_CONNECTION_WINDOW_SIZE) {
+		return 0;
+	}
+
+#if NGHTTP2_VERSION_NUM >= (0x010c00)
+	return nghttp2_session_set_local_window_size(
+		session->ngsession, NGHTTP2_FLAG_NONE, 0, session->window);
+#else
+	return nghttp2_submit_window_update(
+		session->ngsession, NGHTTP2_FLAG_NONE, 0,
+		session->window - NGHTTP2_INITIAL_CONNECTION_WINDOW_SIZE);
+#endif
+}
+
 static bool
 send_client_connection_header(isc_nm_http_session_t *session) {
-	nghttp2_settings_entry iv[] = { { NGHTTP2_SETTINGS_ENABLE_PUSH, 0 } };
+	nghttp2_settings_entry iv[] = {
+		{ NGHTTP2_SETTINGS_ENABLE_PUSH, 0 },
+		{ NGHTTP2_SETTINGS_INITIAL_WINDOW_SIZE, session->window }
+	};
 	int rv;
 
 	rv = nghttp2_submit_settings(session->ngsession, NGHTTP2_FLAG_NONE, iv,
@@ -855,6 +949,11 @@ send_client_connection_header(isc_nm_http_session_t *session) {
 		return false;
 	}
 
+	rv = http_set_connection_window(session);
+	if (rv != 0) {
+		return false;
+	}
+
 	return true;
 }
 
@@ -1003,6 +1102,7 @@ http_readcb(isc_nmhandle_t *handle ISC_ATTR_UNUSED, isc_result_t result,
 
 	readlen = nghttp2_session_mem_recv(session->ngsession, region->base,
 					   region->length);
+	server_flush_direct(session);
 	if (readlen < 0) {
 		failed_read_cb(ISC_R_UNEXPECTED, session);
 		goto done;
@@ -1083,6 +1183,15 @@ move_pending_send_callbacks(isc_nm_http_session_t *session,
 	ISC_LIST_INIT(session->pending_write_callbacks);
 }
 
+static size_t
+http_pending_write_length(isc_nm_http_session_t *session) {
+	if (session->pending_write_data == NULL) {
+		return 0;
+	}
+
+	return isc_buffer_usedlength(session->pending_write_data);
+}
+
 static bool
 http_send_outgoing(isc_nm_http_session_t *session, isc_nmhandle_t *httphandle,
 		   isc_nm_cb_t cb, void *cbarg) {
@@ -1113,27 +1222,35 @@ http_send_outgoing(isc_nm_http_session_t *session, isc_nmhandle_t *httphandle,
 
 	while (nghttp2_session_want_write(session->ngsession)) {
 		const uint8_t *data = NULL;
+		const size_t before = http_pending_write_length(session);
 		const size_t pending =
 			nghttp2_session_mem_send(session->ngsession, &data);
-		const size_t new_total = total + pending;
+		size_t after;
+
+		if (pending > 0 && data != NULL) {
+			/* reallocate buffer if required */
+			if (session->pending_write_data == NULL) {
+				isc_buffer_allocate(
+					session->mctx,
+					&session->pending_write_data,
+					INITIAL_DNS_MESSAGE_BUFFER_SIZE);
+			}
+			isc_buffer_putmem(session->pending_write_data, data,
+					  pending);
+		}
 
 		/*
 		 * Sometimes nghttp2_session_mem_send() does not return any
 		 * data to send even though nghttp2_session_want_write()
-		 * returns success.
+		 * returns success.  The DATA frames of the server are not
+		 * returned, but written into the buffer directly by
+		 * server_send_data_callback().
 		 */
-		if (pending == 0 || data == NULL) {
+		after = http_pending_write_length(session);
+		if (after == before) {
 			break;
 		}
-
-		/* reallocate buffer if required */
-		if (session->pending_write_data == NULL) {
-			isc_buffer_allocate(session->mctx,
-					    &session->pending_write_data,
-					    INITIAL_DNS_MESSAGE_BUFFER_SIZE);
-		}
-		isc_buffer_putmem(session->pending_write_data, data, pending);
-		total = new_total;
+		total += after - before;
 	}
 
 #ifdef ENABLE_HTTP_WRITE_BUFFERING
@@ -1286,6 +1403,7 @@ http_do_bio(isc_nm_http_session_t *session, isc_nmhandle_t *send_httphandle,
 			size_t readlen = nghttp2_session_mem_recv(
 				session->ngsession,
 				isc_buffer_current(session->buf), remaining);
+			server_flush_direct(session);
 
 			if (readlen == remaining) {
 				isc_buffer_free(&session->buf);
@@ -1394,6 +1512,8 @@ transport_connect_cb(isc_nmhandle_t *handle, isc_result_t result, void *cbarg) {
 	http_initsocket(transp_sock);
 	new_session(mctx, http_sock->h2->connect.tlsctx, &session);
 	session->client = true;
+	session->window =
+		atomic_load_relaxed(&transp_sock->worker->netmgr->http_window);
 	transp_sock->h2->session = session;
 	http_sock->h2->connect.tlsctx = NULL;
 	/* otherwise we will get some garbage output in DIG */
@@ -1705,7 +1825,13 @@ server_on_begin_headers_callback(nghttp2_session *ngsession,
 	socket = isc_mempool_get(worker->nmsocket_pool);
 	local = isc_nmhandle_localaddr(session->handle);
 	isc__nmsocket_init(socket, worker, isc_nm_httpsocket, &local, NULL);
-	http_initsocket(socket);
+	if (!ISC_LIST_EMPTY(session->freesstreams)) {
+		socket->h2 = ISC_LIST_HEAD(session->freesstreams);
+		ISC_LIST_UNLINK(session->freesstreams, socket->h2, link);
+		session->nfreesstreams--;
+	} else {
+		http_initsocket(socket);
+	}
 	socket->peer = isc_nmhandle_peeraddr(session->handle);
 	*socket->h2 = (isc_nmsocket_h2_t){
 		.psock = socket,
@@ -1950,24 +2076,57 @@ server_read_callback(nghttp2_session *ngsession, int32_t stream_id,
 	UNUSED(ngsession);
 	UNUSED(session);
 
+	UNUSED(buf);
+
 	buflen = isc_buffer_remaininglength(&socket->h2->wbuf);
 	if (buflen > length) {
 		buflen = length;
 	}
 
-	if (buflen > 0) {
-		(void)memmove(buf, isc_buffer_current(&socket->h2->wbuf),
-			      buflen);
-		isc_buffer_forward(&socket->h2->wbuf, buflen);
-	}
-
-	if (isc_buffer_remaininglength(&socket->h2->wbuf) == 0) {
+	/*
+	 * The data is written by server_send_data_callback() straight
+	 * from the response buffer.
+	 */
+	*data_flags |= NGHTTP2_DATA_FLAG_NO_COPY;
+	if (isc_buffer_remaininglength(&socket->h2->wbuf) == buflen) {
 		*data_flags |= NGHTTP2_DATA_FLAG_EOF;
 	}
 
 	return buflen;
 }
 
+static int
+server_send_data_callback(nghttp2_session *ngsession, nghttp2_frame *frame,
+			  const uint8_t *framehd, size_t length,
+			  nghttp2_data_source *source, void *user_data) {
+	isc_nm_http_session_t *session = (isc_nm_http_session_t *)user_data;
+	isc_nmsocket_t *socket = (isc_nmsocket_t *)source->ptr;
+	size_t padlen = frame->data.padlen;
+
+	UNUSED(ngsession);
+
+	INSIST(isc_buffer_remaininglength(&socket->h2->wbuf) >= length);
+
+	if (session->pending_write_data == NULL) {
+		isc_buffer_allocate(session->mctx, &session->pending_write_data,
+				    INITIAL_DNS_MESSAGE_BUFFER_SIZE);
+	}
+
+	isc_buffer_putmem(session->pending_write_data, framehd,
+			  HTTP2_FRAME_HEADER_SIZE);
+	if (padlen > 0) {
+		isc_buffer_putuint8(session->pending_write_data, padlen - 1);
+	}
+	isc_buffer_putmem(session->pending_write_data,
+			  isc_buffer_current(&socket->h2->wbuf), length);
+	isc_buffer_forward(&socket->h2->wbuf, length);
+	for (size_t i = 1; i < padlen; i++) {
+		isc_buffer_putuint8(session->pending_write_data, 0);
+	}
+
+	return 0;
+}
+
 static isc_result_t
 server_send_response(nghttp2_session *ngsession, int32_t stream_id,
 		     const nghttp2_nv *nva, size_t nvlen,
@@ -2052,6 +2211,7 @@ server_send_error_response(const isc_http_error_responses_t error,
 		isc_mem_free(socket->h2->session->mctx, base);
 		isc_buffer_initnull(&socket->h2->rbuf);
 	}
+	server_clear_direct(socket->h2);
 
 	/* We do not want the error response to be cached anywhere. */
 	socket->h2->min_ttl = 0;
@@ -2129,13 +2289,11 @@ server_on_request_recv(nghttp2_session *ngsession, isc_nmsocket_t *socket) {
 	{
 		code = ISC_HTTP_ERROR_BAD_REQUEST;
 	} else if (socket->h2->request_type == ISC_HTTP_REQ_POST &&
-		   isc_buffer_usedlength(&socket->h2->rbuf) >
-			   socket->h2->content_length)
+		   server_bodylength(socket->h2) > socket->h2->content_length)
 	{
 		code = ISC_HTTP_ERROR_PAYLOAD_TOO_LARGE;
 	} else if (socket->h2->request_type == ISC_HTTP_REQ_POST &&
-		   isc_buffer_usedlength(&socket->h2->rbuf) !=
-			   socket->h2->content_length)
+		   server_bodylength(socket->h2) != socket->h2->content_length)
 	{
 		code = ISC_HTTP_ERROR_BAD_REQUEST;
 	} else if (socket->h2->request_type == ISC_HTTP_REQ_POST &&
@@ -2175,9 +2333,16 @@ server_on_request_recv(nghttp2_session *ngsession, isc_nmsocket_t *socket) {
 			goto error;
 		}
 		isc_buffer_usedregion(&decoded_buf, &data);
+		isc__nm_streamstats(socket, 1, data.length);
 	} else if (socket->h2->request_type == ISC_HTTP_REQ_POST) {
 		INSIST(socket->h2->content_length > 0);
-		isc_buffer_usedregion(&socket->h2->rbuf, &data);
+		if (socket->h2->direct.base != NULL) {
+			data = socket->h2->direct;
+			server_clear_direct(socket->h2);
+		} else {
+			isc_buffer_usedregion(&socket->h2->rbuf, &data);
+		}
+		isc__nm_streamstats(socket, 1, 0);
 	} else {
 		UNREACHABLE();
 	}
@@ -2423,6 +2588,9 @@ initialize_nghttp2_server_session(isc_nm_http_session_t *session) {
 	nghttp2_session_callbacks_set_on_begin_headers_callback(
 		callbacks, server_on_begin_headers_callback);
 
+	nghttp2_session_callbacks_set_send_data_callback(
+		callbacks, server_send_data_callback);
+
 	nghttp2_session_callbacks_set_on_frame_recv_callback(
 		callbacks, server_on_frame_recv_callback);
 
@@ -2435,14 +2603,20 @@ initialize_nghttp2_server_session(isc_nm_http_session_t *session) {
 
 static int
 server_send_connection_header(isc_nm_http_session_t *session) {
-	nghttp2_settings_entry iv[1] = {
+	nghttp2_settings_entry iv[] = {
 		{ NGHTTP2_SETTINGS_MAX_CONCURRENT_STREAMS,
-		  session->max_concurrent_streams }
+		  session->max_concurrent_streams },
+		{ NGHTTP2_SETTINGS_INITIAL_WINDOW_SIZE, session->window }
 	};
 	int rv;
 
 	rv = nghttp2_submit_settings(session->ngsession, NGHTTP2_FLAG_NONE, iv,
-				     1);
+				     sizeof(iv) / sizeof(iv[0]));
+	if (rv != 0) {
+		return -1;
+	}
+
+	rv = http_set_connection_window(session);
 	if (rv != 0) {
 		return -1;
 	}
@@ -2485,6 +2659,8 @@ httplisten_acceptcb(isc_nmhandle_t *handle, isc_result_t result, void *cbarg) {
 	new_session(handle->sock->worker->mctx, NULL, &session);
 	session->max_concurrent_streams =
 		atomic_load_relaxed(&httpserver->h2->max_concurrent_streams);
+	session->window =
+		atomic_load_relaxed(&handle->sock->worker->netmgr->http_window);
 	initialize_nghttp2_server_session(session);
 	handle->sock->h2->session = session;
 
@@ -3245,17 +3421,36 @@ isc__nm_http_cleanup_data(isc_nmsocket_t *sock) {
 	case isc_nm_tcpsocket:
 	case isc_nm_tlssocket:
 		if (sock->h2 != NULL) {
-			if (sock->h2->session != NULL) {
-				if (sock->h2->connect.uri != NULL) {
-					isc_mem_free(sock->worker->mctx,
-						     sock->h2->connect.uri);
-					sock->h2->connect.uri = NULL;
-				}
-				isc__nm_httpsession_detach(&sock->h2->session);
+			isc_nm_http_session_t *session = sock->h2->session;
+
+			sock->h2->session = NULL;
+			if (session != NULL && sock->h2->connect.uri != NULL) {
+				isc_mem_free(sock->worker->mctx,
+					     sock->h2->connect.uri);
+				sock->h2->connect.uri = NULL;
+			}
+
+			/*
+			 * Keep the server stream objects for reuse by the
+			 * next streams of the session.
+			 */
+			if (session != NULL && !session->client &&
+			    sock->type == isc_nm_httpsocket &&
+			    !ISC_LINK_LINKED(sock->h2, link) &&
+			    session->nfreesstreams < HTTP_SSTREAMS_POOL_SIZE)
+			{
+				ISC_LIST_PREPEND(session->freesstreams,
+						 sock->h2, link);
+				session->nfreesstreams++;
+			} else {
+				isc_mem_put(sock->worker->mctx, sock->h2,
+					    sizeof(*sock->h2));
 			}
+			sock->h2 = NULL;
 
-			isc_mem_put(sock->worker->mctx, sock->h2,
-				    sizeof(*sock->h2));
+			if (session != NULL) {
+				isc__nm_httpsession_detach(&session);
+			}
 		};
 		break;
 	default:
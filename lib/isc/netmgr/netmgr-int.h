@@ -23,6 +23,7 @@
 #include <isc/buffer.h>
 #include <isc/condition.h>
 #include <isc/dnsstream.h>
+#include <isc/histo.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
 #include <isc/netmgr.h>
@@ -51,9 +52,11 @@
 #if HAVE_DECL_UV_UDP_MMSG_CHUNK
 /*
  * The value 20 here is UV__MMSG_MAXWIDTH taken from the current libuv source,
- * libuv will not receive more that 20 datagrams in a single recvmmsg call.
+ * libuv will not receive more that 20 datagrams in a single recvmmsg call,
+ * whatever the size of the buffer.
  */
-#define ISC_NETMGR_UDP_RECVBUF_SIZE (20 * UINT16_MAX)
+#define ISC_NETMGR_UDP_RECVBATCH    20
+#define ISC_NETMGR_UDP_RECVBUF_SIZE (ISC_NETMGR_UDP_RECVBATCH * UINT16_MAX)
 #else
 /*
  * A single DNS message size
@@ -62,6 +65,27 @@
 #endif
 #define ISC_NETMGR_UDP_SENDBUF_SIZE UINT16_MAX
 
+/*%
+ * Maximum number of queued UDP responses that are flushed with a single
+ * sendmmsg(2) call.
+ */
+#define ISC_NETMGR_UDP_SENDMMSG_MAX 64
+
+/*%
+ * Limits for coalescing the UDP responses into a single UDP_SEGMENT send;
+ * the number of segments matches the kernel UDP_MAX_SEGMENTS and the total
+ * size must fit into a single IPv6 datagram.
+ */
+#define ISC_NETMGR_UDP_GSO_MAX	   64
+#define ISC_NETMGR_UDP_GSO_MAXSIZE (UINT16_MAX - 8 - 40)
+
+/*%
+ * The largest response that is coalesced with others; the segments must
+ * fit the path MTU, so anything larger than what fits into the IPv6
+ * minimum MTU is sent on its own.
+ */
+#define ISC_NETMGR_UDP_GSO_MAXSEG (1280 - 40 - 8)
+
 /*
  * The TCP send and receive buffers can fit one maximum sized DNS message plus
  * its size, the receive buffer here affects TCP, DoT and DoH.
@@ -69,6 +93,19 @@
 #define ISC_NETMGR_TCP_SENDBUF_SIZE (sizeof(uint16_t) + UINT16_MAX)
 #define ISC_NETMGR_TCP_RECVBUF_SIZE (sizeof(uint16_t) + UINT16_MAX)
 
+/*%
+ * Limits for coalescing the queued TCP sends into a single write: the
+ * number of messages and their total size.
+ */
+#define ISC_NETMGR_TCP_SENDQ_MAX  32
+#define ISC_NETMGR_TCP_SENDQ_SIZE (2 * ISC_NETMGR_TCP_SENDBUF_SIZE)
+
+/*%
+ * The shortest idle timeout (in milliseconds) of the server TCP
+ * connections when the TCP quota is full.
+ */
+#define ISC_NETMGR_TCP_IDLE_MIN 2500
+
 /* Pick the larger buffer */
 #define ISC_NETMGR_RECVBUF_SIZE                                     \
 	(ISC_NETMGR_UDP_RECVBUF_SIZE >= ISC_NETMGR_TCP_RECVBUF_SIZE \
@@ -204,6 +241,8 @@ STATIC_ASSERT(ISC_NETMGR_TCP_RECVBUF_SIZE <= ISC_NETMGR_RECVBUF_SIZE,
 
 typedef struct isc__nm_uvreq isc__nm_uvreq_t;
 
+typedef struct isc__nm_xdp isc__nm_xdp_t;
+
 /*
  * Single network event loop worker.
  */
@@ -217,6 +256,14 @@ typedef struct isc__networker {
 	char *recvbuf;
 	bool recvbuf_inuse;
 
+	/*
+	 * The number of datagrams the UDP listeners have received into
+	 * 'recvbuf' during the current read, and the distribution of the
+	 * datagrams per read.
+	 */
+	unsigned int nrecvbatch;
+	isc_histo_t *recvbatch;
+
 	ISC_LIST(isc_nmsocket_t) active_sockets;
 
 	isc_mempool_t *nmsocket_pool;
@@ -267,6 +314,11 @@ struct isc_nmhandle {
 	struct isc_nmhandle *proxy_udphandle;
 	isc_nm_opaquecb_t doreset; /* reset extra callback, external */
 	isc_nm_opaquecb_t dofree;  /* free extra callback, external */
+	/*
+	 * The destination and source link-layer addresses of the datagram
+	 * received over AF_XDP, the response is sent back to the source.
+	 */
+	uint8_t xdp_hwaddr[12];
 #if ISC_NETMGR_TRACE
 	void *backtrace[TRACE_SIZE];
 	int backtrace_size;
@@ -294,6 +346,7 @@ typedef union {
 #define VALID_UVREQ(t) ISC_MAGIC_VALID(t, UVREQ_MAGIC)
 
 typedef struct isc__nm_uvreq isc__nm_uvreq_t;
+typedef ISC_LIST(isc__nm_uvreq_t) isc__nm_uvreq_list_t;
 struct isc__nm_uvreq {
 	int magic;
 	isc_nmsocket_t *sock;
@@ -317,6 +370,8 @@ struct isc__nm_uvreq {
 	} uv_req;
 	ISC_LINK(isc__nm_uvreq_t) link;
 	ISC_LINK(isc__nm_uvreq_t) active_link;
+	/*% TCP sends written with the same uv_write() as this one */
+	isc__nm_uvreq_list_t batch;
 
 	isc_job_t job;
 };
@@ -327,6 +382,16 @@ struct isc__nm_uvreq {
 #define NM_MAGIC    ISC_MAGIC('N', 'E', 'T', 'M')
 #define VALID_NM(t) ISC_MAGIC_VALID(t, NM_MAGIC)
 
+/*%
+ * A listening socket handed over by another process, see
+ * isc_nm_inheritsocket().
+ */
+typedef struct isc__nm_inherited {
+	uv_os_sock_t fd; /*%< -1 once taken by a listener */
+	int type;	 /*%< SOCK_DGRAM or SOCK_STREAM */
+	isc_sockaddr_t addr;
+} isc__nm_inherited_t;
+
 struct isc_nm {
 	int magic;
 	isc_refcount_t references;
@@ -337,10 +402,46 @@ struct isc_nm {
 
 	isc_stats_t *stats;
 
+	/*
+	 * Per-loop UDP receive counters, indexed by the loop's tid.
+	 */
+	isc_stats_t *loopstats;
+
 	atomic_uint_fast32_t maxudp;
 
 	bool load_balance_sockets;
 
+	/*
+	 * Batch the UDP responses with sendmmsg(2); cleared at runtime when
+	 * the kernel doesn't support the system call.
+	 */
+	atomic_bool udp_sendmmsg;
+
+	/*
+	 * Coalesce the batched UDP responses for the same peer into
+	 * UDP_SEGMENT (generic segmentation offload) sends.
+	 */
+	atomic_bool udp_gso;
+
+	/*
+	 * Steer the datagrams received on the load-balanced UDP listeners
+	 * to the socket picked by the receiving CPU instead of the 4-tuple
+	 * hash.
+	 */
+	atomic_bool udp_cpu_steering;
+
+	/*
+	 * Send the first data of the outgoing TCP connections in the SYN
+	 * (TCP_FASTOPEN_CONNECT).
+	 */
+	atomic_bool tcp_fastopen;
+
+	/*
+	 * The HTTP/2 flow-control window advertised for each stream and for
+	 * the whole connection.
+	 */
+	atomic_uint_fast32_t http_window;
+
 	/*
 	 * Active connections are being closed and new connections are
 	 * no longer allowed.
@@ -366,6 +467,13 @@ struct isc_nm {
 	atomic_int_fast32_t send_udp_buffer_size;
 	atomic_int_fast32_t recv_tcp_buffer_size;
 	atomic_int_fast32_t send_tcp_buffer_size;
+
+	/*
+	 * The listening sockets handed over by another process, waiting to
+	 * be taken by the listeners created for their addresses.
+	 */
+	isc__nm_inherited_t *inherited;
+	size_t ninherited;
 };
 
 /*%
@@ -391,17 +499,18 @@ typedef enum {
 	STATID_RECVFAIL = 9,
 	STATID_ACTIVE = 10,
 	STATID_CLIENTS = 11,
-	STATID_MAX = 12,
+	STATID_GSOSEGS = 12,
+	STATID_FASTOPEN = 13,
+	STATID_MAX = 14,
 } isc__nm_statid_t;
 
 typedef struct isc_nmsocket_tls_send_req {
 	isc_nmsocket_t *tlssock;
-	isc_buffer_t data;
+	BUF_MEM *data; /*%< swapped with the buffer of the outgoing BIO */
 	isc_nm_cb_t cb;
 	void *cbarg;
 	isc_nmhandle_t *handle;
 	bool finish;
-	uint8_t smallbuf[512];
 } isc_nmsocket_tls_send_req_t;
 
 #if HAVE_LIBNGHTTP2
@@ -445,6 +554,7 @@ typedef struct isc_nmsocket_h2 {
 
 	isc_buffer_t rbuf;
 	isc_buffer_t wbuf;
+	isc_region_t direct; /* the request body in the read buffer */
 
 	int32_t stream_id;
 	isc_nm_http_session_t *session;
@@ -541,6 +651,7 @@ struct isc_nmsocket {
 	struct {
 		isc_dnsstream_assembler_t *input;
 		bool reading;
+		unsigned int nprocessed; /*%< messages in this read */
 		isc_nmsocket_t *listener;
 		isc_nmsocket_t *sock;
 		size_t nsending;
@@ -613,6 +724,12 @@ struct isc_nmsocket {
 	/*% TCP backlog */
 	int backlog;
 
+	/*%
+	 * TCP Fast Open queue length of a TCP listener; non-zero in the
+	 * child listening sockets once it has been set on them.
+	 */
+	unsigned int fastopen;
+
 	/*% libuv data */
 	uv_os_sock_t fd;
 	union uv_any_handle uv_handle;
@@ -630,6 +747,19 @@ struct isc_nmsocket {
 
 	bool route_sock;
 
+	/*%
+	 * The children of the UDP listener are bound one after the other
+	 * in the tid order so the reuseport group index of each child
+	 * matches its tid (see isc__nm_socket_reuse_lb_cpu()).
+	 */
+	bool cpu_steering;
+
+	/*%
+	 * The socket was bound by the process that handed it over, see
+	 * isc_nm_inheritsocket().
+	 */
+	bool inherited;
+
 	/*%
 	 * Socket is closed if it's not active and all the possible
 	 * callbacks were fired, there are no active handles, etc.
@@ -706,6 +836,43 @@ struct isc_nmsocket {
 	isc_nm_accept_cb_t accept_cb;
 	void *accept_cbarg;
 
+	/*%
+	 * UDP responses queued during the current event loop iteration,
+	 * flushed with a single sendmmsg(2) call from the 'job'.  When 'gso'
+	 * is set, the responses for the same peer are sent as UDP segments;
+	 * 'gsoworks' is set once such a send went through.
+	 */
+	struct {
+		ISC_LIST(isc__nm_uvreq_t) reqs;
+		size_t len;
+		bool scheduled;
+		bool gso;
+		bool gsoworks;
+		isc_job_t job;
+	} udpsendq;
+
+	/*%
+	 * TCP sends queued while the socket is corked, flushed with a
+	 * single write when it is uncorked or when the queue is full.
+	 */
+	struct {
+		ISC_LIST(isc__nm_uvreq_t) reqs;
+		size_t len;
+		size_t size;
+		bool corked;
+	} tcpsendq;
+
+	/*%
+	 * AF_XDP sockets: the children own the UMEM area and the rings, the
+	 * listener owns the XDP program attached to the interface.
+	 */
+	struct {
+		isc__nm_xdp_t *umem;
+		int mapfd;
+		int progfd;
+		int linkfd;
+	} xdp;
+
 	bool barriers_initialised;
 	bool manual_read_timer;
 #if ISC_NETMGR_TRACE
@@ -940,6 +1107,17 @@ isc__nm_tcp_senddns(isc_nmhandle_t *handle, const isc_region_t *region,
  * ahead of data (two bytes (16 bit) in big-endian format).
  */
 
+void
+isc__nm_tcp_cork(isc_nmhandle_t *handle);
+void
+isc__nm_tcp_uncork(isc_nmhandle_t *handle);
+/*%<
+ * Cork and uncork the TCP socket of 'handle': while it is corked, the
+ * sends are queued, and they are written with as few writes as possible
+ * when it is uncorked, each write carrying up to ISC_NETMGR_TCP_SENDQ_MAX
+ * messages and ISC_NETMGR_TCP_SENDQ_SIZE bytes.
+ */
+
 void
 isc__nm_tls_send(isc_nmhandle_t *handle, const isc_region_t *region,
 		 isc_nm_cb_t cb, void *cbarg);
@@ -1297,6 +1475,37 @@ void
 isc__nm_proxyudp_send(isc_nmhandle_t *handle, isc_region_t *region,
 		      isc_nm_cb_t cb, void *cbarg);
 
+void
+isc__nm_xdp_send(isc_nmhandle_t *handle, const isc_region_t *region,
+		 isc_nm_cb_t cb, void *cbarg);
+/*%<
+ * Back-end implementation of isc_nm_send() for AF_XDP handles.
+ */
+
+void
+isc__nm_xdp_close(isc_nmsocket_t *sock);
+/*%<
+ * Close an AF_XDP socket.
+ */
+
+void
+isc__nm_xdp_shutdown(isc_nmsocket_t *sock);
+/*%<
+ * Called during the shutdown process to mark the AF_XDP socket inactive.
+ */
+
+void
+isc__nm_xdp_stoplistening(isc_nmsocket_t *sock);
+/*%<
+ * Detach the XDP program and stop listening on 'sock'.
+ */
+
+void
+isc__nm_xdp_cleanup_data(isc_nmsocket_t *sock);
+/*%<
+ * Release the AF_XDP resources held by the socket.
+ */
+
 void
 isc__nm_incstats(isc_nmsocket_t *sock, isc__nm_statid_t id);
 /*%<
@@ -1309,6 +1518,13 @@ isc__nm_decstats(isc_nmsocket_t *sock, isc__nm_statid_t id);
  * Decrement socket-related statistics counters.
  */
 
+void
+isc__nm_streamstats(isc_nmsocket_t *sock, unsigned int msgs, size_t copied);
+/*%<
+ * Count 'msgs' DNS messages received on a stream socket and 'copied'
+ * bytes of them copied out of the receive buffers before parsing.
+ */
+
 isc_result_t
 isc__nm_socket(int domain, int type, int protocol, uv_os_sock_t *sockp);
 /*%<
@@ -1321,6 +1537,13 @@ isc__nm_closesocket(uv_os_sock_t sock);
  * Platform independent closesocket() version
  */
 
+uv_os_sock_t
+isc__nm_takeinherited(isc_nm_t *mgr, int type, const isc_sockaddr_t *addr);
+/*%<
+ * Take the socket of 'type' bound to 'addr' out of the sockets handed
+ * over by another process; return -1 if there is none.
+ */
+
 isc_result_t
 isc__nm_socket_reuse(uv_os_sock_t fd, int val);
 /*%<
@@ -1333,6 +1556,19 @@ isc__nm_socket_reuse_lb(uv_os_sock_t fd);
  * Set the SO_REUSEPORT_LB (or equivalent) socket option on the fd
  */
 
+isc_result_t
+isc__nm_socket_reuse_lb_cpu(isc_mem_t *mctx, uv_os_sock_t fd, uint32_t nsocks,
+			    const int *cpus);
+/*%<
+ * Attach a classic BPF program to the reuseport group of the fd that
+ * selects the socket with the index equal to the receiving CPU modulo
+ * 'nsocks'.  The group index is the order in which the sockets were bound.
+ *
+ * If 'cpus' is not NULL, it holds the CPU the loop of each of the 'nsocks'
+ * sockets is bound to, or -1; the datagrams received on one of those CPUs
+ * are delivered to the socket of the loop bound to it instead.
+ */
+
 isc_result_t
 isc__nm_socket_disable_pmtud(uv_os_sock_t fd, sa_family_t sa_family);
 /*%<
@@ -1366,12 +1602,40 @@ isc__nm_socket_tcp_maxseg(uv_os_sock_t fd, int size);
  * Set the TCP maximum segment size
  */
 
+isc_result_t
+isc__nm_socket_tcp_fastopen(uv_os_sock_t fd, unsigned int qlen);
+/*%<
+ * Accept data in the SYN of the incoming connections on a TCP listening
+ * socket, with at most 'qlen' such connections pending (TCP_FASTOPEN).
+ */
+
+isc_result_t
+isc__nm_socket_tcp_fastopen_connect(uv_os_sock_t fd);
+/*%<
+ * Send the first data written to a TCP socket in the SYN, when the
+ * kernel has a Fast Open cookie for the peer (TCP_FASTOPEN_CONNECT).
+ */
+
+bool
+isc__nm_socket_tcp_fastopened(uv_os_sock_t fd);
+/*%<
+ * Return true if the TCP connection has been established with data in
+ * the SYN.
+ */
+
 isc_result_t
 isc__nm_socket_min_mtu(uv_os_sock_t fd, sa_family_t sa_family);
 /*%<
  * Use minimum MTU on IPv6 sockets
  */
 
+isc_result_t
+isc__nm_socket_udp_gso(uv_os_sock_t fd);
+/*%<
+ * Check whether the UDP generic segmentation offload (UDP_SEGMENT) is
+ * supported on the socket.
+ */
+
 void
 isc__nm_set_network_buffers(isc_nm_t *nm, uv_handle_t *handle);
 /*%>
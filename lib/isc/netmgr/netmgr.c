@@ -65,6 +65,8 @@ static const isc_statscounter_t udp4statsindex[] = {
 	isc_sockstatscounter_udp4recvfail,
 	isc_sockstatscounter_udp4active,
 	-1,
+	isc_sockstatscounter_udp4gsosegs,
+	-1,
 };
 
 static const isc_statscounter_t udp6statsindex[] = {
@@ -80,6 +82,8 @@ static const isc_statscounter_t udp6statsindex[] = {
 	isc_sockstatscounter_udp6recvfail,
 	isc_sockstatscounter_udp6active,
 	-1,
+	isc_sockstatscounter_udp6gsosegs,
+	-1,
 };
 
 static const isc_statscounter_t tcp4statsindex[] = {
@@ -89,6 +93,7 @@ static const isc_statscounter_t tcp4statsindex[] = {
 	isc_sockstatscounter_tcp4acceptfail,  isc_sockstatscounter_tcp4accept,
 	isc_sockstatscounter_tcp4sendfail,    isc_sockstatscounter_tcp4recvfail,
 	isc_sockstatscounter_tcp4active,      isc_sockstatscounter_tcp4clients,
+	-1,				      isc_sockstatscounter_tcp4fastopen,
 };
 
 static const isc_statscounter_t tcp6statsindex[] = {
@@ -98,6 +103,7 @@ static const isc_statscounter_t tcp6statsindex[] = {
 	isc_sockstatscounter_tcp6acceptfail,  isc_sockstatscounter_tcp6accept,
 	isc_sockstatscounter_tcp6sendfail,    isc_sockstatscounter_tcp6recvfail,
 	isc_sockstatscounter_tcp6active,      isc_sockstatscounter_tcp6clients,
+	-1,				      isc_sockstatscounter_tcp6fastopen,
 };
 
 static void
@@ -186,6 +192,15 @@ isc_netmgr_create(isc_mem_t *mctx, isc_loopmgr_t *loopmgr, isc_nm_t **netmgrp) {
 	atomic_init(&netmgr->send_tcp_buffer_size, 0);
 	atomic_init(&netmgr->recv_udp_buffer_size, 0);
 	atomic_init(&netmgr->send_udp_buffer_size, 0);
+#if HAVE_SENDMMSG
+	atomic_init(&netmgr->udp_sendmmsg, true);
+#else
+	atomic_init(&netmgr->udp_sendmmsg, false);
+#endif
+	atomic_init(&netmgr->udp_gso, false);
+	atomic_init(&netmgr->udp_cpu_steering, false);
+	atomic_init(&netmgr->tcp_fastopen, false);
+	atomic_init(&netmgr->http_window, ISC_NM_HTTP_WINDOW_MIN);
 #if HAVE_SO_REUSEPORT_LB
 	netmgr->load_balance_sockets = true;
 #else
@@ -222,6 +237,8 @@ isc_netmgr_create(isc_mem_t *mctx, isc_loopmgr_t *loopmgr, isc_nm_t **netmgrp) {
 
 		isc_mem_attach(loop->mctx, &worker->mctx);
 
+		isc_histo_create(worker->mctx, 4, &worker->recvbatch);
+
 		isc_mempool_create(worker->mctx, sizeof(isc_nmsocket_t),
 				   &worker->nmsocket_pool);
 		isc_mempool_setfreemax(worker->nmsocket_pool,
@@ -251,12 +268,18 @@ nm_destroy(isc_nm_t **mgr0) {
 
 	isc_refcount_destroy(&mgr->references);
 
+	isc_nm_inheritdone(mgr);
+
 	mgr->magic = 0;
 
 	if (mgr->stats != NULL) {
 		isc_stats_detach(&mgr->stats);
 	}
 
+	if (mgr->loopstats != NULL) {
+		isc_stats_detach(&mgr->loopstats);
+	}
+
 	isc_mem_cput(mgr->mctx, mgr->workers, mgr->nloops,
 		     sizeof(mgr->workers[0]));
 	isc_mem_putanddetach(&mgr->mctx, mgr, sizeof(*mgr));
@@ -307,6 +330,37 @@ isc_nm_maxudp(isc_nm_t *mgr, uint32_t maxudp) {
 	atomic_store_relaxed(&mgr->maxudp, maxudp);
 }
 
+void
+isc_nm_setudpgso(isc_nm_t *mgr, bool enabled) {
+	REQUIRE(VALID_NM(mgr));
+
+	atomic_store_relaxed(&mgr->udp_gso, enabled);
+}
+
+void
+isc_nm_setudpcpusteering(isc_nm_t *mgr, bool enabled) {
+	REQUIRE(VALID_NM(mgr));
+
+	atomic_store_relaxed(&mgr->udp_cpu_steering, enabled);
+}
+
+void
+isc_nm_settcpfastopen(isc_nm_t *mgr, bool enabled) {
+	REQUIRE(VALID_NM(mgr));
+
+	atomic_store_relaxed(&mgr->tcp_fastopen, enabled);
+}
+
+void
+isc_nm_sethttpwindow(isc_nm_t *mgr, uint32_t window) {
+	REQUIRE(VALID_NM(mgr));
+
+	window = ISC_MAX(window, ISC_NM_HTTP_WINDOW_MIN);
+	window = ISC_MIN(window, ISC_NM_HTTP_WINDOW_MAX);
+
+	atomic_store_relaxed(&mgr->http_window, window);
+}
+
 void
 isc_nmhandle_setwritetimeout(isc_nmhandle_t *handle, uint64_t write_timeout) {
 	REQUIRE(VALID_NMHANDLE(handle));
@@ -316,6 +370,7 @@ isc_nmhandle_setwritetimeout(isc_nmhandle_t *handle, uint64_t write_timeout) {
 	switch (handle->sock->type) {
 	case isc_nm_tcpsocket:
 	case isc_nm_udpsocket:
+	case isc_nm_xdpsocket:
 		handle->sock->write_timeout = write_timeout;
 		break;
 	case isc_nm_tlssocket:
@@ -483,6 +538,9 @@ nmsocket_cleanup(void *arg) {
 	isc__nm_streamdns_cleanup_data(sock);
 	isc__nm_proxystream_cleanup_data(sock);
 	isc__nm_proxyudp_cleanup_data(sock);
+#if USE_XDP
+	isc__nm_xdp_cleanup_data(sock);
+#endif /* USE_XDP */
 
 	if (sock->barriers_initialised) {
 		isc_barrier_destroy(&sock->listen_barrier);
@@ -621,6 +679,11 @@ isc___nmsocket_prep_destroy(isc_nmsocket_t *sock FLARG) {
 		case isc_nm_proxyudpsocket:
 			isc__nm_proxyudp_close(sock);
 			return;
+#if USE_XDP
+		case isc_nm_xdpsocket:
+			isc__nm_xdp_close(sock);
+			return;
+#endif /* USE_XDP */
 		default:
 			break;
 		}
@@ -667,7 +730,8 @@ isc_nmsocket_close(isc_nmsocket_t **sockp) {
 		(*sockp)->type == isc_nm_tlslistener ||
 		(*sockp)->type == isc_nm_httplistener ||
 		(*sockp)->type == isc_nm_proxystreamlistener ||
-		(*sockp)->type == isc_nm_proxyudplistener);
+		(*sockp)->type == isc_nm_proxyudplistener ||
+		(*sockp)->type == isc_nm_xdplistener);
 
 	isc__nmsocket_detach(sockp);
 }
@@ -685,11 +749,14 @@ isc___nmsocket_init(isc_nmsocket_t *sock, isc__networker_t *worker,
 		.type = type,
 		.tid = worker->loop->tid,
 		.fd = -1,
+		.xdp = { .mapfd = -1, .progfd = -1, .linkfd = -1 },
 		.inactive_handles = ISC_LIST_INITIALIZER,
 		.result = ISC_R_UNSET,
 		.active_handles = ISC_LIST_INITIALIZER,
 		.active_handles_max = ISC_NETMGR_MAX_STREAM_CLIENTS_PER_CONN,
 		.active_link = ISC_LINK_INITIALIZER,
+		.udpsendq.reqs = ISC_LIST_INITIALIZER,
+		.tcpsendq.reqs = ISC_LIST_INITIALIZER,
 		.active = true,
 	};
 
@@ -716,6 +783,8 @@ isc___nmsocket_init(isc_nmsocket_t *sock, isc__networker_t *worker,
 	switch (type) {
 	case isc_nm_udpsocket:
 	case isc_nm_udplistener:
+	case isc_nm_xdpsocket:
+	case isc_nm_xdplistener:
 		switch (family) {
 		case AF_INET:
 			sock->statsindex = udp4statsindex;
@@ -1570,6 +1639,7 @@ isc_nmhandle_localaddr(isc_nmhandle_t *handle) {
 
 	case isc_nm_proxystreamsocket:
 	case isc_nm_proxyudpsocket:
+	case isc_nm_xdpsocket:
 		break;
 
 	default:
@@ -1600,6 +1670,7 @@ isc___nm_uvreq_get(isc_nmsocket_t *sock FLARG) {
 		.connect_tries = 3,
 		.link = ISC_LINK_INITIALIZER,
 		.active_link = ISC_LINK_INITIALIZER,
+		.batch = ISC_LIST_INITIALIZER,
 		.magic = UVREQ_MAGIC,
 	};
 	uv_handle_set_data(&req->uv_req.handle, req);
@@ -1649,6 +1720,11 @@ isc_nm_send(isc_nmhandle_t *handle, isc_region_t *region, isc_nm_cb_t cb,
 	case isc_nm_udplistener:
 		isc__nm_udp_send(handle, region, cb, cbarg);
 		break;
+#if USE_XDP
+	case isc_nm_xdpsocket:
+		isc__nm_xdp_send(handle, region, cb, cbarg);
+		break;
+#endif /* USE_XDP */
 	case isc_nm_tcpsocket:
 		isc__nm_tcp_send(handle, region, cb, cbarg);
 		break;
@@ -1799,6 +1875,11 @@ isc_nm_stoplistening(isc_nmsocket_t *sock) {
 	case isc_nm_udplistener:
 		isc__nm_udp_stoplistening(sock);
 		break;
+#if USE_XDP
+	case isc_nm_xdplistener:
+		isc__nm_xdp_stoplistening(sock);
+		break;
+#endif /* USE_XDP */
 	case isc_nm_tcplistener:
 		isc__nm_tcp_stoplistening(sock);
 		break;
@@ -2004,8 +2085,14 @@ isc__nmsocket_shutdown(isc_nmsocket_t *sock) {
 	case isc_nm_tcpsocket:
 		isc__nm_tcp_shutdown(sock);
 		break;
+#if USE_XDP
+	case isc_nm_xdpsocket:
+		isc__nm_xdp_shutdown(sock);
+		break;
+#endif /* USE_XDP */
 	case isc_nm_udplistener:
 	case isc_nm_tcplistener:
+	case isc_nm_xdplistener:
 		return;
 	default:
 		UNREACHABLE();
@@ -2025,6 +2112,7 @@ shutdown_walk_cb(uv_handle_t *handle, void *arg) {
 
 	switch (handle->type) {
 	case UV_UDP:
+	case UV_POLL:
 		isc__nmsocket_shutdown(sock);
 		return;
 	case UV_TCP:
@@ -2055,6 +2143,23 @@ isc_nm_setstats(isc_nm_t *mgr, isc_stats_t *stats) {
 	isc_stats_attach(stats, &mgr->stats);
 }
 
+void
+isc_nm_setloopstats(isc_nm_t *mgr, isc_stats_t *stats) {
+	REQUIRE(VALID_NM(mgr));
+	REQUIRE(mgr->loopstats == NULL);
+	REQUIRE(isc_stats_ncounters(stats) == (int)mgr->nloops);
+
+	isc_stats_attach(stats, &mgr->loopstats);
+}
+
+void
+isc_nm_getrecvbatch(isc_nm_t *mgr, uint32_t tid, isc_histo_t **hgp) {
+	REQUIRE(VALID_NM(mgr));
+	REQUIRE(tid < mgr->nloops);
+
+	isc_histo_merge(hgp, mgr->workers[tid].recvbatch);
+}
+
 void
 isc__nm_incstats(isc_nmsocket_t *sock, isc__nm_statid_t id) {
 	REQUIRE(VALID_NMSOCK(sock));
@@ -2077,6 +2182,25 @@ isc__nm_decstats(isc_nmsocket_t *sock, isc__nm_statid_t id) {
 	}
 }
 
+void
+isc__nm_streamstats(isc_nmsocket_t *sock, unsigned int msgs, size_t copied) {
+	isc_stats_t *stats = NULL;
+
+	REQUIRE(VALID_NMSOCK(sock));
+
+	stats = sock->worker->netmgr->stats;
+	if (stats == NULL) {
+		return;
+	}
+
+	if (msgs > 0) {
+		isc_stats_add(stats, isc_sockstatscounter_streammsgs, msgs);
+	}
+	if (copied > 0) {
+		isc_stats_add(stats, isc_sockstatscounter_streamcopied, copied);
+	}
+}
+
 isc_result_t
 isc_nm_checkaddr(const isc_sockaddr_t *addr, isc_socktype_t type) {
 	int proto, pf, addrlen, fd, r;
@@ -2116,6 +2240,122 @@ isc_nm_checkaddr(const isc_sockaddr_t *addr, isc_socktype_t type) {
 	return ISC_R_SUCCESS;
 }
 
+size_t
+isc_nm_listenerfds(isc_nmsocket_t *listener, int *fds, size_t size) {
+	size_t n = 0;
+
+	REQUIRE(VALID_NMSOCK(listener));
+
+	/* The TLS, DNS and PROXY listeners wrap a TCP or UDP listener */
+	while (listener->outer != NULL) {
+		listener = listener->outer;
+	}
+
+	switch (listener->type) {
+	case isc_nm_udplistener:
+	case isc_nm_tcplistener:
+		break;
+	default:
+		return 0;
+	}
+
+	for (size_t i = 0; i < listener->nchildren; i++) {
+		/* Without load balancing, the children share a socket */
+		if (i > 0 && !listener->worker->netmgr->load_balance_sockets) {
+			break;
+		}
+		if (n < size) {
+			fds[n] = listener->children[i].fd;
+		}
+		n++;
+	}
+
+	return n;
+}
+
+isc_result_t
+isc_nm_inheritsocket(isc_nm_t *mgr, int fd) {
+	struct sockaddr_storage ss;
+	socklen_t len = sizeof(ss);
+	isc__nm_inherited_t *inherited = NULL;
+	isc_result_t result;
+	int type;
+
+	REQUIRE(VALID_NM(mgr));
+	REQUIRE(fd >= 0);
+
+	if (getsockname(fd, (struct sockaddr *)&ss, &len) < 0) {
+		result = isc_errno_toresult(errno);
+		goto cleanup;
+	}
+	if (ss.ss_family != AF_INET && ss.ss_family != AF_INET6) {
+		result = ISC_R_FAMILYNOSUPPORT;
+		goto cleanup;
+	}
+
+	len = sizeof(type);
+	if (getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &len) < 0) {
+		result = isc_errno_toresult(errno);
+		goto cleanup;
+	}
+	if (type != SOCK_DGRAM && type != SOCK_STREAM) {
+		result = ISC_R_NOTIMPLEMENTED;
+		goto cleanup;
+	}
+
+	mgr->inherited = isc_mem_creget(mgr->mctx, mgr->inherited,
+					mgr->ninherited, mgr->ninherited + 1,
+					sizeof(mgr->inherited[0]));
+	inherited = &mgr->inherited[mgr->ninherited++];
+	*inherited = (isc__nm_inherited_t){ .fd = fd, .type = type };
+
+	result = isc_sockaddr_fromsockaddr(&inherited->addr,
+					   (struct sockaddr *)&ss);
+	INSIST(result == ISC_R_SUCCESS);
+
+	return ISC_R_SUCCESS;
+
+cleanup:
+	isc__nm_closesocket(fd);
+	return result;
+}
+
+uv_os_sock_t
+isc__nm_takeinherited(isc_nm_t *mgr, int type, const isc_sockaddr_t *addr) {
+	REQUIRE(VALID_NM(mgr));
+
+	for (size_t i = 0; i < mgr->ninherited; i++) {
+		isc__nm_inherited_t *inherited = &mgr->inherited[i];
+		uv_os_sock_t fd = inherited->fd;
+
+		if (fd >= 0 && inherited->type == type &&
+		    isc_sockaddr_equal(&inherited->addr, addr))
+		{
+			inherited->fd = -1;
+			return fd;
+		}
+	}
+
+	return -1;
+}
+
+void
+isc_nm_inheritdone(isc_nm_t *mgr) {
+	REQUIRE(VALID_NM(mgr));
+
+	for (size_t i = 0; i < mgr->ninherited; i++) {
+		if (mgr->inherited[i].fd >= 0) {
+			isc__nm_closesocket(mgr->inherited[i].fd);
+		}
+	}
+
+	if (mgr->inherited != NULL) {
+		isc_mem_cput(mgr->mctx, mgr->inherited, mgr->ninherited,
+			     sizeof(mgr->inherited[0]));
+		mgr->ninherited = 0;
+	}
+}
+
 #if defined(TCP_CONNECTIONTIMEOUT)
 #define TIMEOUT_TYPE	int
 #define TIMEOUT_DIV	1000
@@ -2179,6 +2419,7 @@ isc_nm_bad_request(isc_nmhandle_t *handle) {
 	switch (sock->type) {
 	case isc_nm_udpsocket:
 	case isc_nm_proxyudpsocket:
+	case isc_nm_xdpsocket:
 		return;
 	case isc_nm_tcpsocket:
 	case isc_nm_streamdnssocket:
@@ -2414,6 +2655,7 @@ isc_nm_set_maxage(isc_nmhandle_t *handle, const uint32_t ttl) {
 	case isc_nm_udpsocket:
 	case isc_nm_proxyudpsocket:
 	case isc_nm_streamdnssocket:
+	case isc_nm_xdpsocket:
 		return;
 		break;
 	case isc_nm_tcpsocket:
@@ -2430,7 +2672,18 @@ isc_nm_socket_type(const isc_nmhandle_t *handle) {
 	REQUIRE(VALID_NMHANDLE(handle));
 	REQUIRE(VALID_NMSOCK(handle->sock));
 
-	return handle->sock->type;
+	/*
+	 * The AF_XDP sockets carry plain DNS over UDP, so present them as
+	 * such to the users.
+	 */
+	switch (handle->sock->type) {
+	case isc_nm_xdpsocket:
+		return isc_nm_udpsocket;
+	case isc_nm_xdplistener:
+		return isc_nm_udplistener;
+	default:
+		return handle->sock->type;
+	}
 }
 
 isc_nm_proxy_type_t
@@ -2631,6 +2884,8 @@ isc__networker_destroy(isc__networker_t *worker) {
 	isc_mempool_destroy(&worker->uvreq_pool);
 	isc_mempool_destroy(&worker->nmsocket_pool);
 
+	isc_histo_destroy(&worker->recvbatch);
+
 	isc_mem_putanddetach(&worker->mctx, worker->recvbuf,
 			     ISC_NETMGR_RECVBUF_SIZE);
 	isc_nm_detach(&netmgr);
@@ -2928,6 +3183,10 @@ nmsocket_type_totext(isc_nmsocket_type type) {
 		return "isc_nm_proxyudplistener";
 	case isc_nm_proxyudpsocket:
 		return "isc_nm_proxyudpsocket";
+	case isc_nm_xdplistener:
+		return "isc_nm_xdplistener";
+	case isc_nm_xdpsocket:
+		return "isc_nm_xdpsocket";
 	default:
 		UNREACHABLE();
 	}
@@ -11,6 +11,12 @@
  * information regarding copyright ownership.
  */
 
+#include <netinet/udp.h>
+
+#if defined(__linux__)
+#include <linux/filter.h>
+#endif /* defined(__linux__) */
+
 #include <isc/errno.h>
 #include <isc/uv.h>
 
@@ -218,6 +224,81 @@ isc__nm_socket_reuse_lb(uv_os_sock_t fd) {
 #endif
 }
 
+isc_result_t
+isc__nm_socket_reuse_lb_cpu(isc_mem_t *mctx, uv_os_sock_t fd, uint32_t nsocks,
+			    const int *cpus) {
+	REQUIRE(nsocks > 0);
+
+	/*
+	 * By default, the kernel picks the socket from the reuseport group
+	 * by the hash of the 4-tuple.  The attached program returns the
+	 * index into the group instead; use the CPU that processed the
+	 * packet, so all the datagrams received on the same CPU end up on
+	 * the same loop.  When the loops are bound to CPUs, the CPUs are
+	 * looked up first, so the datagrams stay on the CPU (and the NUMA
+	 * node) that took the interrupt.
+	 */
+#if defined(SO_ATTACH_REUSEPORT_CBPF) && defined(SKF_AD_CPU)
+	size_t len = 3, n = 0;
+	struct sock_filter *code = NULL;
+	struct sock_fprog prog;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	if (cpus != NULL) {
+		for (uint32_t i = 0; i < nsocks; i++) {
+			if (cpus[i] >= 0) {
+				len += 2;
+			}
+		}
+		if (len > BPF_MAXINSNS) {
+			len = 3;
+			cpus = NULL;
+		}
+	}
+
+	code = isc_mem_cget(mctx, len, sizeof(code[0]));
+
+	/* A = raw_smp_processor_id() */
+	code[n++] = (struct sock_filter){ BPF_LD | BPF_W | BPF_ABS, 0, 0,
+					  SKF_AD_OFF + SKF_AD_CPU };
+	for (uint32_t i = 0; cpus != NULL && i < nsocks; i++) {
+		if (cpus[i] < 0) {
+			continue;
+		}
+		/* if (A == cpus[i]) return i */
+		code[n++] = (struct sock_filter){ BPF_JMP | BPF_JEQ | BPF_K, 0,
+						  1, cpus[i] };
+		code[n++] = (struct sock_filter){ BPF_RET | BPF_K, 0, 0, i };
+	}
+	/* A = A % nsocks */
+	code[n++] = (struct sock_filter){ BPF_ALU | BPF_MOD | BPF_K, 0, 0,
+					  nsocks };
+	/* return A */
+	code[n++] = (struct sock_filter){ BPF_RET | BPF_A, 0, 0, 0 };
+	INSIST(n == len);
+
+	prog = (struct sock_fprog){
+		.len = len,
+		.filter = code,
+	};
+
+	if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog,
+		       sizeof(prog)) == -1)
+	{
+		result = ISC_R_FAILURE;
+	}
+
+	isc_mem_cput(mctx, code, len, sizeof(code[0]));
+
+	return result;
+#else
+	UNUSED(mctx);
+	UNUSED(fd);
+	UNUSED(cpus);
+	return ISC_R_NOTIMPLEMENTED;
+#endif
+}
+
 isc_result_t
 isc__nm_socket_disable_pmtud(uv_os_sock_t fd, sa_family_t sa_family) {
 	/*
@@ -348,6 +429,51 @@ isc__nm_socket_tcp_maxseg(uv_os_sock_t fd, int size) {
 #endif
 }
 
+isc_result_t
+isc__nm_socket_tcp_fastopen(uv_os_sock_t fd, unsigned int qlen) {
+#ifdef TCP_FASTOPEN
+	if (setsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN, &(int){ qlen },
+		       sizeof(int)) == -1)
+	{
+		return ISC_R_FAILURE;
+	}
+	return ISC_R_SUCCESS;
+#else
+	UNUSED(fd);
+	UNUSED(qlen);
+	return ISC_R_NOTIMPLEMENTED;
+#endif
+}
+
+isc_result_t
+isc__nm_socket_tcp_fastopen_connect(uv_os_sock_t fd) {
+#ifdef TCP_FASTOPEN_CONNECT
+	if (setsockopt_on(fd, IPPROTO_TCP, TCP_FASTOPEN_CONNECT) == -1) {
+		return ISC_R_FAILURE;
+	}
+	return ISC_R_SUCCESS;
+#else
+	UNUSED(fd);
+	return ISC_R_NOTIMPLEMENTED;
+#endif
+}
+
+bool
+isc__nm_socket_tcp_fastopened(uv_os_sock_t fd) {
+#if defined(TCP_INFO) && defined(TCPI_OPT_SYN_DATA)
+	struct tcp_info info;
+	socklen_t len = sizeof(info);
+
+	if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &len) == -1) {
+		return false;
+	}
+	return (info.tcpi_options & TCPI_OPT_SYN_DATA) != 0;
+#else
+	UNUSED(fd);
+	return false;
+#endif
+}
+
 isc_result_t
 isc__nm_socket_min_mtu(uv_os_sock_t fd, sa_family_t sa_family) {
 	if (sa_family != AF_INET6) {
@@ -369,3 +495,24 @@ isc__nm_socket_min_mtu(uv_os_sock_t fd, sa_family_t sa_family) {
 
 	return ISC_R_SUCCESS;
 }
+
+isc_result_t
+isc__nm_socket_udp_gso(uv_os_sock_t fd) {
+#if defined(SOL_UDP) && defined(UDP_SEGMENT)
+	int size = 0;
+	socklen_t len = sizeof(size);
+
+	/*
+	 * The kernels with the UDP_SEGMENT support allow reading the
+	 * socket option back; the actual segment size is set per message.
+	 */
+	if (getsockopt(fd, SOL_UDP, UDP_SEGMENT, &size, &len) == -1) {
+		return ISC_R_NOTIMPLEMENTED;
+	}
+
+	return ISC_R_SUCCESS;
+#else
+	UNUSED(fd);
+	return ISC_R_NOTIMPLEMENTED;
+#endif
+}
@@ -43,6 +43,11 @@
  * 'streamdns_handle_incoming_data()' which passes incoming data to
  * the 'isc_dnsstream_assembler_t' object within the socket.
  *
+ * Pipelined DNS messages are processed in place, right from the
+ * data that has been read, up to STREAMDNS_READ_BATCH of them per read.
+ * When the transport is TCP, the socket is corked meanwhile, so the
+ * responses that are ready by then are written together.
+ *
  * The writing is done in a simpler manner due to the fact that we
  * have full control over the data. For each write request we attempt
  * to allocate a 'streamdns_send_req_t' structure, whose main purpose
@@ -63,6 +68,13 @@
  * could be either TCP or TLS.
  */
 
+/*%
+ * The maximum number of DNS messages processed in place per read; the
+ * rest is processed in the next loop tick, so that a single connection
+ * can't hog the worker.
+ */
+#define STREAMDNS_READ_BATCH 32
+
 typedef struct streamdns_send_req {
 	isc_nm_cb_t cb;		   /* send callback */
 	void *cbarg;		   /* send callback argument */
@@ -134,7 +146,11 @@ streamdns_on_complete_dnsmessage(isc_dnsstream_assembler_t *dnsasm,
 	 */
 	bool stop = sock->client;
 
+	sock->streamdns.nprocessed++;
 	sock->reading = false;
+	if (!sock->client) {
+		isc__nm_streamstats(sock, 1, 0);
+	}
 	if (sock->recv_cb != NULL) {
 		if (!sock->client) {
 			/*
@@ -188,6 +204,11 @@ streamdns_on_complete_dnsmessage(isc_dnsstream_assembler_t *dnsasm,
 		 * The call also restarts the timer.
 		 */
 		streamdns_readmore(sock, transphandle);
+	} else if (sock->streamdns.nprocessed < STREAMDNS_READ_BATCH) {
+		/*
+		 * Process the next DNS message right away, in place.
+		 */
+		return true;
 	} else {
 		/*
 		 * Process more DNS messages in the next loop tick.
@@ -250,13 +271,42 @@ streamdns_handle_incoming_data(isc_nmsocket_t *sock,
 			       isc_nmhandle_t *transphandle,
 			       void *restrict data, size_t len) {
 	isc_dnsstream_assembler_t *dnsasm = sock->streamdns.input;
+	isc_nmhandle_t *corked = NULL;
+	size_t copied = isc_dnsstream_assembler_copiedlength(dnsasm);
+
+	/*
+	 * Cork the TCP connection, so the responses sent while the
+	 * messages are processed are written together.  The handle is
+	 * attached, as the connection could be detached from meanwhile.
+	 */
+	if (!sock->client && transphandle->sock->type == isc_nm_tcpsocket) {
+		isc_nmhandle_attach(transphandle, &corked);
+		isc__nm_tcp_cork(corked);
+	}
 
 	/*
 	 * Try to process the received data or, when 'data == NULL' and
 	 * 'len == 0', try to resume processing of the data within the
 	 * internal buffers or resume reading, if there is no any.
 	 */
+	sock->streamdns.nprocessed = 0;
 	isc_dnsstream_assembler_incoming(dnsasm, transphandle, data, len);
+
+	/*
+	 * Complete messages are parsed in place; count what had to be
+	 * copied because a message was split across reads.
+	 */
+	if (!sock->client) {
+		isc__nm_streamstats(
+			sock, 0,
+			isc_dnsstream_assembler_copiedlength(dnsasm) - copied);
+	}
+
+	if (corked != NULL) {
+		isc__nm_tcp_uncork(corked);
+		isc_nmhandle_detach(&corked);
+	}
+
 	streamdns_try_close_unused(sock);
 }
 
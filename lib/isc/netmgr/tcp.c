@@ -52,11 +52,48 @@ can_log_tcp_quota(void) {
 	return false;
 }
 
+/*
+ * The idle timeout of a connection.  On the server side, it is shortened
+ * as the TCP quota of the listener fills up, as suggested by RFC 7766,
+ * section 6.2.3: it stays the configured one until half of the quota is
+ * used, then decreases linearly down to ISC_NETMGR_TCP_IDLE_MIN when all
+ * of it is used.
+ */
+static uint32_t
+tcp_idle_timeout(isc_nmsocket_t *sock) {
+	uint32_t idle = atomic_load_relaxed(&sock->worker->netmgr->idle);
+	isc_quota_t *quota = NULL;
+	uint64_t used, max, low;
+
+	if (sock->client || sock->server == NULL ||
+	    sock->server->pquota == NULL || idle <= ISC_NETMGR_TCP_IDLE_MIN)
+	{
+		return idle;
+	}
+
+	quota = sock->server->pquota;
+	max = isc_quota_getmax(quota);
+	low = max / 2;
+	if (max == 0) {
+		return idle;
+	}
+
+	used = isc_quota_getused(quota);
+	if (used <= low) {
+		return idle;
+	} else if (used >= max) {
+		return ISC_NETMGR_TCP_IDLE_MIN;
+	}
+
+	return ISC_NETMGR_TCP_IDLE_MIN +
+	       (idle - ISC_NETMGR_TCP_IDLE_MIN) * (max - used) / (max - low);
+}
+
 static isc_result_t
 tcp_connect_direct(isc_nmsocket_t *sock, isc__nm_uvreq_t *req);
 
-static isc_result_t
-tcp_send_direct(isc_nmsocket_t *sock, isc__nm_uvreq_t *req);
+static void
+tcp_send_direct(isc_nmsocket_t *sock, isc__nm_uvreq_t **reqs, size_t nreqs);
 static void
 tcp_connect_cb(uv_connect_t *uvreq, int status);
 static void
@@ -294,6 +331,9 @@ isc_nm_tcpconnect(isc_nm_t *mgr, isc_sockaddr_t *local, isc_sockaddr_t *peer,
 
 	(void)isc__nm_socket_min_mtu(sock->fd, sa_family);
 	(void)isc__nm_socket_tcp_maxseg(sock->fd, NM_MAXSEG);
+	if (atomic_load_relaxed(&mgr->tcp_fastopen)) {
+		(void)isc__nm_socket_tcp_fastopen_connect(sock->fd);
+	}
 
 	sock->active = true;
 
@@ -373,7 +413,9 @@ start_tcp_child_job(void *arg) {
 		flags = UV_TCP_IPV6ONLY;
 	}
 
-	if (sock->worker->netmgr->load_balance_sockets) {
+	if (sock->inherited) {
+		/* The socket was bound by the process that handed it over */
+	} else if (sock->worker->netmgr->load_balance_sockets) {
 		r = isc__nm_tcp_freebind(&sock->uv_handle.tcp,
 					 &sock->iface.type.sa, flags);
 		if (r < 0) {
@@ -459,10 +501,15 @@ start_tcp_child(isc_nm_t *mgr, isc_sockaddr_t *iface, isc_nmsocket_t *sock,
 
 	if (mgr->load_balance_sockets) {
 		UNUSED(fd);
-		csock->fd = isc__nm_tcp_lb_socket(mgr,
-						  iface->type.sa.sa_family);
+		csock->fd = isc__nm_takeinherited(mgr, SOCK_STREAM, iface);
+		csock->inherited = (csock->fd >= 0);
+		if (!csock->inherited) {
+			csock->fd = isc__nm_tcp_lb_socket(
+				mgr, iface->type.sa.sa_family);
+		}
 	} else {
 		csock->fd = dup(fd);
+		csock->inherited = sock->inherited;
 	}
 	REQUIRE(csock->fd >= 0);
 
@@ -507,7 +554,12 @@ isc_nm_listentcp(isc_nm_t *mgr, uint32_t workers, isc_sockaddr_t *iface,
 	sock->pquota = quota;
 
 	if (!mgr->load_balance_sockets) {
-		fd = isc__nm_tcp_lb_socket(mgr, iface->type.sa.sa_family);
+		fd = isc__nm_takeinherited(mgr, SOCK_STREAM, iface);
+		sock->inherited = (fd >= 0);
+		if (!sock->inherited) {
+			fd = isc__nm_tcp_lb_socket(mgr,
+						   iface->type.sa.sa_family);
+		}
 	}
 
 	start_tcp_child(mgr, iface, sock, fd, 0);
@@ -550,6 +602,52 @@ isc_nm_listentcp(isc_nm_t *mgr, uint32_t workers, isc_sockaddr_t *iface,
 	return ISC_R_SUCCESS;
 }
 
+static void
+tcp_fastopen_job(void *arg) {
+	isc_nmsocket_t *sock = arg;
+	isc_result_t result;
+
+	REQUIRE(VALID_NMSOCK(sock));
+	REQUIRE(VALID_NMSOCK(sock->parent));
+	REQUIRE(sock->tid == isc_tid());
+
+	if (!sock->closing) {
+		result = isc__nm_socket_tcp_fastopen(sock->fd,
+						     sock->parent->fastopen);
+		if (result == ISC_R_SUCCESS) {
+			sock->fastopen = sock->parent->fastopen;
+		} else if (sock->tid == 0) {
+			isc__nmsocket_log(sock, ISC_LOG_WARNING,
+					  "enabling TCP Fast Open failed: %s",
+					  isc_result_totext(result));
+		}
+	}
+
+	isc__nmsocket_detach(&sock);
+}
+
+void
+isc_nm_listener_setfastopen(isc_nmsocket_t *listener, unsigned int qlen) {
+	REQUIRE(VALID_NMSOCK(listener));
+	REQUIRE(isc_tid() == 0);
+
+	while (listener->type != isc_nm_tcplistener) {
+		if (listener->outer == NULL) {
+			return;
+		}
+		listener = listener->outer;
+	}
+
+	listener->fastopen = qlen;
+
+	for (size_t i = 0; i < listener->nchildren; i++) {
+		isc_nmsocket_t *csock = NULL;
+
+		isc__nmsocket_attach(&listener->children[i], &csock);
+		isc_async_run(csock->worker->loop, tcp_fastopen_job, csock);
+	}
+}
+
 static void
 tcp_connection_cb(uv_stream_t *server, int status) {
 	isc_nmsocket_t *ssock = uv_handle_get_data((uv_handle_t *)server);
@@ -726,7 +824,7 @@ isc__nm_tcp_read(isc_nmhandle_t *handle, isc_nm_recv_cb_t cb, void *cbarg) {
 		sock->read_timeout =
 			sock->keepalive
 				? atomic_load_relaxed(&netmgr->keepalive)
-				: atomic_load_relaxed(&netmgr->idle);
+				: tcp_idle_timeout(sock);
 	}
 
 	if (isc__nmsocket_closing(sock)) {
@@ -808,7 +906,7 @@ isc__nm_tcp_read_cb(uv_stream_t *stream, ssize_t nread, const uv_buf_t *buf) {
 		sock->read_timeout =
 			sock->keepalive
 				? atomic_load_relaxed(&netmgr->keepalive)
-				: atomic_load_relaxed(&netmgr->idle);
+				: tcp_idle_timeout(sock);
 	}
 
 	isc__nm_readcb(sock, req, ISC_R_SUCCESS, false);
@@ -999,6 +1097,16 @@ accept_connection(isc_nmsocket_t *csock) {
 
 	isc__nm_incstats(csock, STATID_ACCEPT);
 
+	if (csock->server->fastopen != 0) {
+		uv_os_fd_t fd;
+
+		if (uv_fileno(&csock->uv_handle.handle, &fd) == 0 &&
+		    isc__nm_socket_tcp_fastopened(fd))
+		{
+			isc__nm_incstats(csock, STATID_FASTOPEN);
+		}
+	}
+
 	/*
 	 * The acceptcb needs to attach to the handle if it wants to keep the
 	 * connection alive
@@ -1032,6 +1140,59 @@ failure:
 	return result;
 }
 
+static void
+tcp_sendq_flush(isc_nmsocket_t *sock) {
+	isc__nm_uvreq_t *reqs[ISC_NETMGR_TCP_SENDQ_MAX];
+	size_t n = 0;
+
+	while (!ISC_LIST_EMPTY(sock->tcpsendq.reqs)) {
+		isc__nm_uvreq_t *uvreq = ISC_LIST_HEAD(sock->tcpsendq.reqs);
+		ISC_LIST_UNLINK(sock->tcpsendq.reqs, uvreq, link);
+		INSIST(n < ARRAY_SIZE(reqs));
+		reqs[n++] = uvreq;
+	}
+	sock->tcpsendq.len = 0;
+	sock->tcpsendq.size = 0;
+
+	if (n > 0) {
+		tcp_send_direct(sock, reqs, n);
+	}
+}
+
+static void
+tcp_sendq_enqueue(isc_nmsocket_t *sock, isc__nm_uvreq_t *uvreq) {
+	ISC_LIST_APPEND(sock->tcpsendq.reqs, uvreq, link);
+	sock->tcpsendq.len++;
+	sock->tcpsendq.size += sizeof(uint16_t) + uvreq->uvbuf.len;
+
+	if (sock->tcpsendq.len >= ISC_NETMGR_TCP_SENDQ_MAX ||
+	    sock->tcpsendq.size >= ISC_NETMGR_TCP_SENDQ_SIZE)
+	{
+		tcp_sendq_flush(sock);
+	}
+}
+
+void
+isc__nm_tcp_cork(isc_nmhandle_t *handle) {
+	REQUIRE(VALID_NMHANDLE(handle));
+	REQUIRE(VALID_NMSOCK(handle->sock));
+	REQUIRE(handle->sock->type == isc_nm_tcpsocket);
+	REQUIRE(handle->sock->tid == isc_tid());
+
+	handle->sock->tcpsendq.corked = true;
+}
+
+void
+isc__nm_tcp_uncork(isc_nmhandle_t *handle) {
+	REQUIRE(VALID_NMHANDLE(handle));
+	REQUIRE(VALID_NMSOCK(handle->sock));
+	REQUIRE(handle->sock->type == isc_nm_tcpsocket);
+	REQUIRE(handle->sock->tid == isc_tid());
+
+	handle->sock->tcpsendq.corked = false;
+	tcp_sendq_flush(handle->sock);
+}
+
 static void
 tcp_send(isc_nmhandle_t *handle, const isc_region_t *region, isc_nm_cb_t cb,
 	 void *cbarg, const bool dnsmsg) {
@@ -1039,7 +1200,6 @@ tcp_send(isc_nmhandle_t *handle, const isc_region_t *region, isc_nm_cb_t cb,
 	REQUIRE(VALID_NMSOCK(handle->sock));
 
 	isc_nmsocket_t *sock = handle->sock;
-	isc_result_t result;
 	isc__nm_uvreq_t *uvreq = NULL;
 	isc_nm_t *netmgr = sock->worker->netmgr;
 
@@ -1062,16 +1222,15 @@ tcp_send(isc_nmhandle_t *handle, const isc_region_t *region, isc_nm_cb_t cb,
 		sock->write_timeout =
 			sock->keepalive
 				? atomic_load_relaxed(&netmgr->keepalive)
-				: atomic_load_relaxed(&netmgr->idle);
+				: tcp_idle_timeout(sock);
 	}
 
-	result = tcp_send_direct(sock, uvreq);
-	if (result != ISC_R_SUCCESS) {
-		isc__nm_incstats(sock, STATID_SENDFAIL);
-		isc__nm_failed_send_cb(sock, uvreq, result, true);
+	if (sock->tcpsendq.corked) {
+		tcp_sendq_enqueue(sock, uvreq);
+		return;
 	}
 
-	return;
+	tcp_send_direct(sock, &uvreq, 1);
 }
 
 void
@@ -1117,6 +1276,8 @@ static void
 tcp_send_cb(uv_write_t *req, int status) {
 	isc__nm_uvreq_t *uvreq = (isc__nm_uvreq_t *)req->data;
 	isc_nmsocket_t *sock = NULL;
+	isc_result_t result = ISC_R_SUCCESS;
+	isc__nm_uvreq_list_t batch = ISC_LIST_INITIALIZER;
 
 	REQUIRE(VALID_UVREQ(uvreq));
 	REQUIRE(VALID_NMSOCK(uvreq->sock));
@@ -1126,10 +1287,29 @@ tcp_send_cb(uv_write_t *req, int status) {
 	isc_nm_timer_stop(uvreq->timer);
 	isc_nm_timer_detach(&uvreq->timer);
 
+	/* The requests written along with this one complete with it */
+	ISC_LIST_MOVE(batch, uvreq->batch);
+
 	if (status < 0) {
+		result = isc_uverr2result(status);
 		isc__nm_incstats(sock, STATID_SENDFAIL);
-		isc__nm_failed_send_cb(sock, uvreq, isc_uverr2result(status),
-				       false);
+		isc__nm_failed_send_cb(sock, uvreq, result, false);
+	} else {
+		isc__nm_sendcb(sock, uvreq, result, false);
+	}
+
+	while (!ISC_LIST_EMPTY(batch)) {
+		isc__nm_uvreq_t *breq = ISC_LIST_HEAD(batch);
+		ISC_LIST_UNLINK(batch, breq, link);
+		if (status < 0) {
+			isc__nm_incstats(sock, STATID_SENDFAIL);
+			isc__nm_failed_send_cb(sock, breq, result, false);
+		} else {
+			isc__nm_sendcb(sock, breq, result, false);
+		}
+	}
+
+	if (status < 0) {
 		if (!sock->client && sock->reading) {
 			/*
 			 * As we are resuming reading, it is not throttled
@@ -1142,72 +1322,74 @@ tcp_send_cb(uv_write_t *req, int status) {
 		return;
 	}
 
-	isc__nm_sendcb(sock, uvreq, ISC_R_SUCCESS, false);
 	tcp_maybe_restart_reading(sock);
 }
 
-static isc_result_t
-tcp_send_direct(isc_nmsocket_t *sock, isc__nm_uvreq_t *req) {
+/*
+ * Write the requests with a single uv_try_write() call.  Whatever the
+ * kernel doesn't accept right away is handed over to a single uv_write()
+ * call on the first request that hasn't been written completely; the
+ * requests after it are completed along with it.
+ */
+static void
+tcp_send_direct(isc_nmsocket_t *sock, isc__nm_uvreq_t **reqs, size_t nreqs) {
 	REQUIRE(VALID_NMSOCK(sock));
-	REQUIRE(VALID_UVREQ(req));
 	REQUIRE(sock->tid == isc_tid());
 	REQUIRE(sock->type == isc_nm_tcpsocket);
+	REQUIRE(nreqs > 0 && nreqs <= ISC_NETMGR_TCP_SENDQ_MAX);
 
+	uv_buf_t bufs[2 * ISC_NETMGR_TCP_SENDQ_MAX];
+	size_t owner[2 * ISC_NETMGR_TCP_SENDQ_MAX];
+	size_t nbufs = 0, b = 0, first = 0, written;
+	isc__nm_uvreq_t *req = NULL;
+	isc_result_t result;
 	int r;
-	uv_buf_t bufs[2] = { { 0 }, { 0 } }; /* ugly, but required for old GCC
-						versions */
-	size_t nbufs = 1;
 
 	if (isc__nmsocket_closing(sock)) {
-		return ISC_R_CANCELED;
+		result = ISC_R_CANCELED;
+		goto failure;
 	}
 
-	/* Check if we are not trying to send a DNS message */
-	if (*(uint16_t *)req->tcplen == 0) {
-		bufs[0].base = req->uvbuf.base;
-		bufs[0].len = req->uvbuf.len;
-
-		r = uv_try_write(&sock->uv_handle.stream, bufs, nbufs);
+	for (size_t i = 0; i < nreqs; i++) {
+		REQUIRE(VALID_UVREQ(reqs[i]));
 
-		if (r == (int)(bufs[0].len)) {
-			/* Wrote everything */
-			isc__nm_sendcb(sock, req, ISC_R_SUCCESS, true);
-			tcp_maybe_restart_reading(sock);
-			return ISC_R_SUCCESS;
-		} else if (r > 0) {
-			bufs[0].base += (size_t)r;
-			bufs[0].len -= (size_t)r;
-		} else if (!(r == UV_ENOSYS || r == UV_EAGAIN)) {
-			return isc_uverr2result(r);
-		}
-	} else {
-		nbufs = 2;
-		bufs[0].base = req->tcplen;
-		bufs[0].len = 2;
-		bufs[1].base = req->uvbuf.base;
-		bufs[1].len = req->uvbuf.len;
-
-		r = uv_try_write(&sock->uv_handle.stream, bufs, nbufs);
-
-		if (r == (int)(bufs[0].len + bufs[1].len)) {
-			/* Wrote everything */
-			isc__nm_sendcb(sock, req, ISC_R_SUCCESS, true);
-			tcp_maybe_restart_reading(sock);
-			return ISC_R_SUCCESS;
-		} else if (r == 1) {
-			/* Partial write of DNSMSG length */
-			bufs[0].base = req->tcplen + 1;
-			bufs[0].len = 1;
-		} else if (r > 0) {
-			/* Partial write of DNSMSG */
-			nbufs = 1;
-			bufs[0].base = req->uvbuf.base + (r - 2);
-			bufs[0].len = req->uvbuf.len - (r - 2);
-		} else if (!(r == UV_ENOSYS || r == UV_EAGAIN)) {
-			return isc_uverr2result(r);
+		/* Send the length ahead of a DNS message */
+		if (*(uint16_t *)reqs[i]->tcplen != 0) {
+			owner[nbufs] = i;
+			bufs[nbufs++] = uv_buf_init(reqs[i]->tcplen, 2);
 		}
+		owner[nbufs] = i;
+		bufs[nbufs++] = uv_buf_init(reqs[i]->uvbuf.base,
+					    reqs[i]->uvbuf.len);
+	}
+
+	r = uv_try_write(&sock->uv_handle.stream, bufs, nbufs);
+	if (r < 0 && !(r == UV_ENOSYS || r == UV_EAGAIN)) {
+		result = isc_uverr2result(r);
+		goto failure;
+	}
+
+	/* Skip the buffers that have been written */
+	written = (r > 0) ? (size_t)r : 0;
+	while (b < nbufs && written >= bufs[b].len) {
+		written -= bufs[b].len;
+		b++;
+	}
+	first = (b < nbufs) ? owner[b] : nreqs;
+
+	for (size_t i = 0; i < first; i++) {
+		isc__nm_sendcb(sock, reqs[i], ISC_R_SUCCESS, true);
 	}
 
+	if (first == nreqs) {
+		/* Wrote everything */
+		tcp_maybe_restart_reading(sock);
+		return;
+	}
+
+	bufs[b].base += written;
+	bufs[b].len -= written;
+
 	if (!sock->client && sock->reading) {
 		sock->reading_throttled = true;
 		isc__nm_stop_reading(sock);
@@ -1220,10 +1402,16 @@ tcp_send_direct(isc_nmsocket_t *sock, isc__nm_uvreq_t *req) {
 				  ? "throttling TCP connection, "
 				  : "");
 
-	r = uv_write(&req->uv_req.write, &sock->uv_handle.stream, bufs, nbufs,
-		     tcp_send_cb);
+	req = reqs[first];
+	r = uv_write(&req->uv_req.write, &sock->uv_handle.stream, &bufs[b],
+		     nbufs - b, tcp_send_cb);
 	if (r < 0) {
-		return isc_uverr2result(r);
+		result = isc_uverr2result(r);
+		goto failure;
+	}
+
+	for (size_t i = first + 1; i < nreqs; i++) {
+		ISC_LIST_APPEND(req->batch, reqs[i], link);
 	}
 
 	isc_nm_timer_create(req->handle, isc__nmsocket_writetimeout_cb, req,
@@ -1232,7 +1420,13 @@ tcp_send_direct(isc_nmsocket_t *sock, isc__nm_uvreq_t *req) {
 		isc_nm_timer_start(req->timer, sock->write_timeout);
 	}
 
-	return ISC_R_SUCCESS;
+	return;
+
+failure:
+	for (size_t i = first; i < nreqs; i++) {
+		isc__nm_incstats(sock, STATID_SENDFAIL);
+		isc__nm_failed_send_cb(sock, reqs[i], result, true);
+	}
 }
 
 static void
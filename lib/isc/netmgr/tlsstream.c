@@ -15,12 +15,12 @@
 #include <libgen.h>
 #include <unistd.h>
 
+#include <openssl/buffer.h>
 #include <openssl/err.h>
 #include <openssl/ssl.h>
 
 #include <isc/async.h>
 #include <isc/atomic.h>
-#include <isc/buffer.h>
 #include <isc/condition.h>
 #include <isc/log.h>
 #include <isc/magic.h>
@@ -33,6 +33,7 @@
 #include <isc/region.h>
 #include <isc/result.h>
 #include <isc/sockaddr.h>
+#include <isc/stats.h>
 #include <isc/stdtime.h>
 #include <isc/thread.h>
 #include <isc/util.h>
@@ -199,21 +200,15 @@ tls_senddone(isc_nmhandle_t *handle, isc_result_t eresult, void *cbarg) {
 		 * than 64 KB for this to work efficiently when combined with
 		 * DNS transports.
 		 */
-		if (isc_buffer_length(&send_req->data) > TLS_MAX_SEND_BUF_SIZE)
-		{
+		if (send_req->data->max > TLS_MAX_SEND_BUF_SIZE) {
 			/* free the underlying buffer */
-			isc_buffer_clearmctx(&send_req->data);
-			isc_buffer_invalidate(&send_req->data);
-			isc_buffer_init(&send_req->data, send_req->smallbuf,
-					sizeof(send_req->smallbuf));
-			isc_buffer_setmctx(&send_req->data,
-					   handle->sock->worker->mctx);
+			BUF_MEM_free(send_req->data);
+			send_req->data = NULL;
 		} else {
-			isc_buffer_clear(&send_req->data);
+			send_req->data->length = 0;
 		}
 	} else {
-		isc_buffer_clearmctx(&send_req->data);
-		isc_buffer_invalidate(&send_req->data);
+		BUF_MEM_free(send_req->data);
 		isc_mem_put(handle->sock->worker->mctx, send_req,
 			    sizeof(*send_req));
 	}
@@ -353,9 +348,7 @@ tls_send_outgoing(isc_nmsocket_t *sock, bool finish, isc_nmhandle_t *tlshandle,
 		  isc_nm_cb_t cb, void *cbarg) {
 	isc_nmsocket_tls_send_req_t *send_req = NULL;
 	int pending;
-	int rv;
-	size_t len = 0;
-	bool new_send_req = false;
+	BUF_MEM *data = NULL;
 	isc_region_t used_region = { 0 };
 	bool shutting_down = isc__nm_closing(sock->worker);
 
@@ -387,15 +380,13 @@ tls_send_outgoing(isc_nmsocket_t *sock, bool finish, isc_nmhandle_t *tlshandle,
 	} else {
 		send_req = isc_mem_get(sock->worker->mctx, sizeof(*send_req));
 		*send_req = (isc_nmsocket_tls_send_req_t){ .finish = finish };
-		new_send_req = true;
 	}
 
-	if (new_send_req) {
-		isc_buffer_init(&send_req->data, &send_req->smallbuf,
-				sizeof(send_req->smallbuf));
-		isc_buffer_setmctx(&send_req->data, sock->worker->mctx);
+	if (send_req->data == NULL) {
+		send_req->data = BUF_MEM_new();
+		RUNTIME_CHECK(send_req->data != NULL);
 	}
-	INSIST(isc_buffer_remaininglength(&send_req->data) == 0);
+	INSIST(send_req->data->length == 0);
 
 	isc__nmsocket_attach(sock, &send_req->tlssock);
 	if (cb != NULL) {
@@ -404,18 +395,25 @@ tls_send_outgoing(isc_nmsocket_t *sock, bool finish, isc_nmhandle_t *tlshandle,
 		isc_nmhandle_attach(tlshandle, &send_req->handle);
 	}
 
-	RUNTIME_CHECK(isc_buffer_reserve(&send_req->data, pending) ==
-		      ISC_R_SUCCESS);
-	isc_buffer_add(&send_req->data, pending);
-	rv = BIO_read_ex(sock->tlsstream.bio_out,
-			 isc_buffer_base(&send_req->data), pending, &len);
-	/* There's something pending, read must succeed */
-	RUNTIME_CHECK(rv == 1 && len == (size_t)pending);
+	/*
+	 * Nothing is ever read from the outgoing BIO: instead of copying
+	 * the pending data out of it, its buffer is handed over to the
+	 * send request in exchange for the empty buffer of the request.
+	 * The buffers thus alternate between the BIO and the send request
+	 * cached in the socket without being reallocated.
+	 */
+	RUNTIME_CHECK(BIO_get_mem_ptr(sock->tlsstream.bio_out, &data) == 1);
+	INSIST(data->length == (size_t)pending);
+	(void)BIO_set_close(sock->tlsstream.bio_out, BIO_NOCLOSE);
+	(void)BIO_set_mem_buf(sock->tlsstream.bio_out, send_req->data,
+			      BIO_CLOSE);
+	send_req->data = data;
 
 	INSIST(VALID_NMHANDLE(sock->outerhandle));
 
 	sock->tlsstream.nsending++;
-	isc_buffer_remainingregion(&send_req->data, &used_region);
+	used_region = (isc_region_t){ .base = (unsigned char *)data->data,
+				      .length = data->length };
 	isc_nm_send(sock->outerhandle, &used_region, tls_senddone, send_req);
 
 	return pending;
@@ -447,6 +445,25 @@ tls_process_outgoing(isc_nmsocket_t *sock, bool finish,
 	return pending;
 }
 
+/*
+ * Count the incoming TLS connections resumed from a session, to see how
+ * many of the clients reconnecting skip the full handshake.
+ */
+static void
+tls_handshake_stats(isc_nmsocket_t *sock) {
+	isc_stats_t *stats = sock->worker->netmgr->stats;
+
+	if (stats == NULL) {
+		return;
+	}
+
+	if (SSL_session_reused(sock->tlsstream.tls) == 1) {
+		isc_stats_increment(stats, isc_sockstatscounter_tlsresumed);
+	} else {
+		isc_stats_increment(stats, isc_sockstatscounter_tlshandshake);
+	}
+}
+
 static int
 tls_try_handshake(isc_nmsocket_t *sock, isc_result_t *presult) {
 	REQUIRE(sock->tlsstream.state == TLS_HANDSHAKE);
@@ -472,6 +489,8 @@ tls_try_handshake(isc_nmsocket_t *sock, isc_result_t *presult) {
 		}
 
 		if (sock->tlsstream.server) {
+			tls_handshake_stats(sock);
+
 			/*
 			 * The listening sockets are now closed from outer
 			 * to inner order, which means that this function
@@ -1357,8 +1376,7 @@ isc__nm_tls_cleanup_data(isc_nmsocket_t *sock) {
 		}
 
 		if (sock->tlsstream.send_req != NULL) {
-			isc_buffer_clearmctx(&sock->tlsstream.send_req->data);
-			isc_buffer_invalidate(&sock->tlsstream.send_req->data);
+			BUF_MEM_free(sock->tlsstream.send_req->data);
 			isc_mem_put(sock->worker->mctx,
 				    sock->tlsstream.send_req,
 				    sizeof(*sock->tlsstream.send_req));
@@ -11,6 +11,7 @@
  * information regarding copyright ownership.
  */
 
+#include <netinet/udp.h>
 #include <unistd.h>
 
 #include <isc/async.h>
@@ -19,6 +20,7 @@
 #include <isc/buffer.h>
 #include <isc/condition.h>
 #include <isc/errno.h>
+#include <isc/job.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
 #include <isc/netmgr.h>
@@ -110,6 +112,11 @@ start_udp_child_job(void *arg) {
 
 	(void)isc__nm_socket_min_mtu(sock->fd, sa_family);
 
+	if (atomic_load_relaxed(&mgr->udp_gso)) {
+		sock->udpsendq.gso = (isc__nm_socket_udp_gso(sock->fd) ==
+				      ISC_R_SUCCESS);
+	}
+
 #if HAVE_DECL_UV_UDP_RECVMMSG
 	uv_init_flags |= UV_UDP_RECVMMSG;
 #endif
@@ -135,7 +142,9 @@ start_udp_child_job(void *arg) {
 		uv_bind_flags |= UV_UDP_IPV6ONLY;
 	}
 
-	if (mgr->load_balance_sockets) {
+	if (sock->inherited) {
+		/* The socket was bound by the process that handed it over */
+	} else if (mgr->load_balance_sockets) {
 		r = isc__nm_udp_freebind(&sock->uv_handle.udp,
 					 &sock->parent->iface.type.sa,
 					 uv_bind_flags);
@@ -174,6 +183,18 @@ done:
 
 	REQUIRE(!loop->paused);
 
+	/*
+	 * With the CPU steering, the next child is bound only after this
+	 * one has joined the reuseport group.  The second child is started
+	 * from isc_nm_listenudp() after all the children are initialized.
+	 */
+	if (sock->parent->cpu_steering && sock->tid != 0 &&
+	    sock->tid + 1 < sock->parent->nchildren)
+	{
+		isc_nmsocket_t *next = &sock->parent->children[sock->tid + 1];
+		isc_async_run(next->worker->loop, start_udp_child_job, next);
+	}
+
 	if (sock->tid != 0) {
 		isc_barrier_wait(&sock->parent->listen_barrier);
 	}
@@ -191,16 +212,21 @@ start_udp_child(isc_nm_t *mgr, isc_sockaddr_t *iface, isc_nmsocket_t *sock,
 	csock->inactive_handles_max = ISC_NM_NMHANDLES_MAX;
 
 	if (mgr->load_balance_sockets) {
-		csock->fd = isc__nm_udp_lb_socket(mgr,
-						  iface->type.sa.sa_family);
+		csock->fd = isc__nm_takeinherited(mgr, SOCK_DGRAM, iface);
+		csock->inherited = (csock->fd >= 0);
+		if (!csock->inherited) {
+			csock->fd = isc__nm_udp_lb_socket(
+				mgr, iface->type.sa.sa_family);
+		}
 	} else {
 		csock->fd = dup(fd);
+		csock->inherited = sock->inherited;
 	}
 	INSIST(csock->fd >= 0);
 
 	if (tid == 0) {
 		start_udp_child_job(csock);
-	} else {
+	} else if (!sock->cpu_steering) {
 		isc_async_run(worker->loop, start_udp_child_job, csock);
 	}
 }
@@ -241,9 +267,21 @@ isc_nm_listenudp(isc_nm_t *mgr, uint32_t workers, isc_sockaddr_t *iface,
 	sock->recv_cbarg = cbarg;
 
 	if (!mgr->load_balance_sockets) {
-		fd = isc__nm_udp_lb_socket(mgr, iface->type.sa.sa_family);
+		fd = isc__nm_takeinherited(mgr, SOCK_DGRAM, iface);
+		sock->inherited = (fd >= 0);
+		if (!sock->inherited) {
+			fd = isc__nm_udp_lb_socket(mgr,
+						   iface->type.sa.sa_family);
+		}
+	} else if (sock->nchildren > 1) {
+		sock->cpu_steering = atomic_load_relaxed(&mgr->udp_cpu_steering);
 	}
 
+	/*
+	 * With the CPU steering enabled, the children are initialized here
+	 * and only the first one is bound; the others are started one by
+	 * one from the previous child's loop.
+	 */
 	start_udp_child(mgr, iface, sock, fd, 0);
 	result = sock->children[0].result;
 	INSIST(result != ISC_R_UNSET);
@@ -252,6 +290,11 @@ isc_nm_listenudp(isc_nm_t *mgr, uint32_t workers, isc_sockaddr_t *iface,
 		start_udp_child(mgr, iface, sock, fd, i);
 	}
 
+	if (sock->cpu_steering) {
+		isc_nmsocket_t *csock = &sock->children[1];
+		isc_async_run(csock->worker->loop, start_udp_child_job, csock);
+	}
+
 	isc_barrier_wait(&sock->listen_barrier);
 
 	if (!mgr->load_balance_sockets) {
@@ -270,6 +313,28 @@ isc_nm_listenudp(isc_nm_t *mgr, uint32_t workers, isc_sockaddr_t *iface,
 		}
 	}
 
+	if (result == ISC_R_SUCCESS && sock->cpu_steering) {
+		int *cpus = isc_mem_cget(worker->mctx, sock->nchildren,
+					 sizeof(cpus[0]));
+		isc_result_t r;
+
+		for (size_t i = 0; i < sock->nchildren; i++) {
+			isc_loop_t *loop = sock->children[i].worker->loop;
+			cpus[i] = isc_loop_getcpu(loop);
+		}
+		r = isc__nm_socket_reuse_lb_cpu(worker->mctx,
+						sock->children[0].fd,
+						sock->nchildren, cpus);
+		isc_mem_cput(worker->mctx, cpus, sock->nchildren,
+			     sizeof(cpus[0]));
+		if (r != ISC_R_SUCCESS && r != ISC_R_NOTIMPLEMENTED) {
+			isc__nmsocket_log(sock, ISC_LOG_WARNING,
+					  "unable to steer the UDP datagrams "
+					  "by the receiving CPU: %s",
+					  isc_result_totext(r));
+		}
+	}
+
 	if (result != ISC_R_SUCCESS) {
 		sock->active = false;
 		isc__nm_udp_stoplistening(sock);
@@ -467,6 +532,18 @@ isc__nm_udp_stoplistening(isc_nmsocket_t *sock) {
 	isc__nmsocket_prep_destroy(sock);
 }
 
+/*
+ * Record the number of datagrams received by the listeners during the read
+ * that has just ended.
+ */
+static void
+udp_recvbatch_done(isc__networker_t *worker) {
+	if (worker->nrecvbatch > 0) {
+		isc_histo_inc(worker->recvbatch, worker->nrecvbatch);
+		worker->nrecvbatch = 0;
+	}
+}
+
 /*
  * udp_recv_cb handles incoming UDP packet from uv.  The buffer here is
  * reused for a series of packets, so we need to allocate a new one.
@@ -494,6 +571,7 @@ isc__nm_udp_read_cb(uv_udp_t *handle, ssize_t nrecv, const uv_buf_t *buf,
 	if ((flags & UV_UDP_MMSG_FREE) == UV_UDP_MMSG_FREE) {
 		INSIST(nrecv == 0);
 		INSIST(addr == NULL);
+		udp_recvbatch_done(sock->worker);
 		goto free;
 	}
 #else
@@ -547,6 +625,7 @@ isc__nm_udp_read_cb(uv_udp_t *handle, ssize_t nrecv, const uv_buf_t *buf,
 	 */
 	if (nrecv == 0 && addr == NULL) {
 		INSIST(flags == 0);
+		udp_recvbatch_done(sock->worker);
 		goto free;
 	}
 
@@ -562,6 +641,14 @@ isc__nm_udp_read_cb(uv_udp_t *handle, ssize_t nrecv, const uv_buf_t *buf,
 		sa = &sockaddr;
 	}
 
+	if (sock->parent != NULL) {
+		sock->worker->nrecvbatch++;
+		if (sock->worker->netmgr->loopstats != NULL) {
+			isc_stats_increment(sock->worker->netmgr->loopstats,
+					    sock->tid);
+		}
+	}
+
 	req = isc__nm_get_read_req(sock, sa);
 
 	/*
@@ -654,6 +741,340 @@ can_log_udp_sends(void) {
 	return false;
 }
 
+static void
+udp_send_direct(isc_nmsocket_t *sock, isc__nm_uvreq_t *uvreq) {
+	isc__networker_t *worker = sock->worker;
+	const struct sockaddr *sa = NULL;
+	isc_result_t result;
+	int r;
+
+	sa = sock->connected ? NULL : &uvreq->handle->peer.type.sa;
+
+	if (uv_udp_get_send_queue_size(&sock->uv_handle.udp) >
+	    ISC_NETMGR_UDP_SENDBUF_SIZE)
+	{
+		/*
+		 * The kernel UDP send queue is full, try sending the UDP
+		 * response synchronously instead of just failing.
+		 */
+		r = uv_udp_try_send(&sock->uv_handle.udp, &uvreq->uvbuf, 1, sa);
+		if (r < 0) {
+			if (can_log_udp_sends()) {
+				isc__netmgr_log(
+					worker->netmgr, ISC_LOG_ERROR,
+					"Sending UDP messages failed: %s",
+					isc_result_totext(isc_uverr2result(r)));
+			}
+
+			isc__nm_incstats(sock, STATID_SENDFAIL);
+			result = isc_uverr2result(r);
+			goto fail;
+		}
+
+		RUNTIME_CHECK(r == (int)uvreq->uvbuf.len);
+		isc__nm_sendcb(sock, uvreq, ISC_R_SUCCESS, true);
+
+	} else {
+		/* Send the message asynchronously */
+		r = uv_udp_send(&uvreq->uv_req.udp_send, &sock->uv_handle.udp,
+				&uvreq->uvbuf, 1, sa, udp_send_cb);
+		if (r < 0) {
+			isc__nm_incstats(sock, STATID_SENDFAIL);
+			result = isc_uverr2result(r);
+			goto fail;
+		}
+	}
+	return;
+fail:
+	isc__nm_failed_send_cb(sock, uvreq, result, true);
+}
+
+#if HAVE_SENDMMSG
+typedef struct udp_sendmsg {
+	size_t first; /* the first request in the message */
+	size_t nreqs; /* number of requests (GSO segments) */
+#ifdef UDP_SEGMENT
+	union {
+		char buf[CMSG_SPACE(sizeof(uint16_t))];
+		struct cmsghdr align;
+	} control;
+#endif /* UDP_SEGMENT */
+} udp_sendmsg_t;
+
+/*
+ * Count how many consecutive requests starting at reqs[first] can be
+ * coalesced into a single UDP_SEGMENT send: they must go to the same
+ * peer and have the same size, only the last segment may be shorter.
+ */
+static size_t
+udp_gso_segments(isc_nmsocket_t *sock, isc__nm_uvreq_t **reqs, size_t first,
+		 size_t n) {
+#ifdef UDP_SEGMENT
+	isc_sockaddr_t *peer = &reqs[first]->handle->peer;
+	size_t seglen = reqs[first]->uvbuf.len;
+	size_t total = seglen;
+	size_t i;
+
+	if (!sock->udpsendq.gso || sock->connected ||
+	    seglen > ISC_NETMGR_UDP_GSO_MAXSEG)
+	{
+		return 1;
+	}
+
+	for (i = first + 1; i < n && i - first < ISC_NETMGR_UDP_GSO_MAX; i++) {
+		size_t len = reqs[i]->uvbuf.len;
+
+		if (len > seglen || total + len > ISC_NETMGR_UDP_GSO_MAXSIZE ||
+		    !isc_sockaddr_equal(&reqs[i]->handle->peer, peer))
+		{
+			break;
+		}
+		total += len;
+
+		if (len < seglen) {
+			i++;
+			break;
+		}
+	}
+
+	return i - first;
+#else
+	UNUSED(sock);
+	UNUSED(reqs);
+	UNUSED(first);
+	UNUSED(n);
+
+	return 1;
+#endif /* UDP_SEGMENT */
+}
+
+/*
+ * Flush the queued UDP responses with as few sendmmsg(2) calls as
+ * possible.  Whatever the kernel doesn't accept right away is handed
+ * over to libuv, which waits for the socket to become writable.
+ *
+ * The send callbacks must be called asynchronously ('async' is true)
+ * unless we are flushing from the loop job.
+ */
+static void
+udp_sendq_flush(isc_nmsocket_t *sock, bool async) {
+	struct mmsghdr msgs[ISC_NETMGR_UDP_SENDMMSG_MAX];
+	udp_sendmsg_t smsgs[ISC_NETMGR_UDP_SENDMMSG_MAX];
+	struct iovec iovs[ISC_NETMGR_UDP_SENDMMSG_MAX];
+	isc__nm_uvreq_t *reqs[ISC_NETMGR_UDP_SENDMMSG_MAX];
+	isc_nm_t *netmgr = sock->worker->netmgr;
+	uv_os_fd_t fd;
+	size_t n = 0, nmsgs = 0, i = 0;
+	int r;
+
+	while (!ISC_LIST_EMPTY(sock->udpsendq.reqs)) {
+		isc__nm_uvreq_t *uvreq = ISC_LIST_HEAD(sock->udpsendq.reqs);
+		ISC_LIST_UNLINK(sock->udpsendq.reqs, uvreq, link);
+		INSIST(n < ARRAY_SIZE(reqs));
+		reqs[n++] = uvreq;
+	}
+	sock->udpsendq.len = 0;
+
+	if (n == 0) {
+		return;
+	}
+
+	if (isc__nmsocket_closing(sock)) {
+		for (i = 0; i < n; i++) {
+			isc__nm_failed_send_cb(sock, reqs[i], ISC_R_CANCELED,
+					       async);
+		}
+		return;
+	}
+
+	r = uv_fileno(&sock->uv_handle.handle, &fd);
+	UV_RUNTIME_CHECK(uv_fileno, r);
+
+	for (i = 0; i < n; i = smsgs[nmsgs].first + smsgs[nmsgs].nreqs, nmsgs++)
+	{
+		isc_sockaddr_t *peer = &reqs[i]->handle->peer;
+		udp_sendmsg_t *smsg = &smsgs[nmsgs];
+		struct msghdr *msg = &msgs[nmsgs].msg_hdr;
+
+		*smsg = (udp_sendmsg_t){
+			.first = i,
+			.nreqs = udp_gso_segments(sock, reqs, i, n),
+		};
+
+		for (size_t j = i; j < i + smsg->nreqs; j++) {
+			iovs[j] = (struct iovec){
+				.iov_base = reqs[j]->uvbuf.base,
+				.iov_len = reqs[j]->uvbuf.len,
+			};
+		}
+
+		msgs[nmsgs] = (struct mmsghdr){
+			.msg_hdr = {
+				.msg_name = sock->connected ? NULL
+							    : &peer->type.sa,
+				.msg_namelen = sock->connected ? 0
+							       : peer->length,
+				.msg_iov = &iovs[i],
+				.msg_iovlen = smsg->nreqs,
+			},
+		};
+
+#ifdef UDP_SEGMENT
+		if (smsg->nreqs > 1) {
+			uint16_t seglen = reqs[i]->uvbuf.len;
+			struct cmsghdr *cmsg = NULL;
+
+			msg->msg_control = smsg->control.buf;
+			msg->msg_controllen = sizeof(smsg->control.buf);
+
+			cmsg = CMSG_FIRSTHDR(msg);
+			cmsg->cmsg_level = SOL_UDP;
+			cmsg->cmsg_type = UDP_SEGMENT;
+			cmsg->cmsg_len = CMSG_LEN(sizeof(seglen));
+			memmove(CMSG_DATA(cmsg), &seglen, sizeof(seglen));
+		}
+#else
+		UNUSED(msg);
+#endif /* UDP_SEGMENT */
+	}
+
+	i = 0;
+	while (i < nmsgs) {
+		udp_sendmsg_t *smsg = &smsgs[i];
+
+		r = sendmmsg(fd, &msgs[i], nmsgs - i, 0);
+		int err = (r == 0) ? EAGAIN : errno;
+		if (r > 0) {
+			for (size_t m = i; m < i + (size_t)r; m++) {
+				smsg = &smsgs[m];
+				if (smsg->nreqs > 1) {
+					sock->udpsendq.gsoworks = true;
+				}
+				for (size_t j = smsg->first;
+				     j < smsg->first + smsg->nreqs; j++)
+				{
+					if (smsg->nreqs > 1) {
+						isc__nm_incstats(
+							sock, STATID_GSOSEGS);
+					}
+					isc__nm_sendcb(sock, reqs[j],
+						       ISC_R_SUCCESS, async);
+				}
+			}
+			i += r;
+			continue;
+		}
+
+		switch (err) {
+		case EINTR:
+			continue;
+		case ENOSYS:
+			atomic_store_relaxed(&netmgr->udp_sendmmsg, false);
+			FALLTHROUGH;
+		case EAGAIN:
+#if defined(EWOULDBLOCK) && EWOULDBLOCK != EAGAIN
+		case EWOULDBLOCK:
+#endif
+		case ENOBUFS:
+			/* Let libuv queue the rest of the responses */
+			for (size_t j = smsg->first; j < n; j++) {
+				udp_send_direct(sock, reqs[j]);
+			}
+			return;
+		case ENOPROTOOPT:
+		case EOPNOTSUPP:
+		case EIO:
+		case EINVAL:
+			if (smsg->nreqs > 1) {
+				/*
+				 * Resend the segments as separate datagrams.
+				 * Once the offload has worked on this socket,
+				 * EINVAL and EIO are caused by this batch
+				 * alone; otherwise the socket or the device
+				 * can't do it, so stop using it.
+				 */
+				if ((err != EINVAL && err != EIO) ||
+				    !sock->udpsendq.gsoworks)
+				{
+					sock->udpsendq.gso = false;
+				}
+				for (size_t j = smsg->first;
+				     j < smsg->first + smsg->nreqs; j++)
+				{
+					udp_send_direct(sock, reqs[j]);
+				}
+				i++;
+				continue;
+			}
+			FALLTHROUGH;
+		default:
+			/* The first message in the batch was rejected */
+			if (can_log_udp_sends()) {
+				isc__netmgr_log(netmgr, ISC_LOG_ERROR,
+						"Sending UDP messages failed: "
+						"%s",
+						isc_result_totext(
+							isc_errno_toresult(
+								err)));
+			}
+			for (size_t j = smsg->first;
+			     j < smsg->first + smsg->nreqs; j++)
+			{
+				isc__nm_incstats(sock, STATID_SENDFAIL);
+				isc__nm_failed_send_cb(sock, reqs[j],
+						       isc_errno_toresult(err),
+						       async);
+			}
+			i++;
+		}
+	}
+}
+
+static void
+udp_sendq_job(void *arg) {
+	isc_nmsocket_t *sock = arg;
+
+	REQUIRE(VALID_NMSOCK(sock));
+	REQUIRE(sock->tid == isc_tid());
+
+	sock->udpsendq.scheduled = false;
+	udp_sendq_flush(sock, false);
+
+	isc__nmsocket_detach(&sock);
+}
+
+static void
+udp_sendq_enqueue(isc_nmsocket_t *sock, isc__nm_uvreq_t *uvreq) {
+	ISC_LIST_APPEND(sock->udpsendq.reqs, uvreq, link);
+	sock->udpsendq.len++;
+
+	if (sock->udpsendq.len >= ISC_NETMGR_UDP_SENDMMSG_MAX) {
+		udp_sendq_flush(sock, true);
+		return;
+	}
+
+	if (!sock->udpsendq.scheduled) {
+		sock->udpsendq.scheduled = true;
+		isc__nmsocket_attach(sock, &(isc_nmsocket_t *){ NULL });
+		isc_job_run(sock->worker->loop, &sock->udpsendq.job,
+			    udp_sendq_job, sock);
+	}
+}
+
+/*
+ * Only the server side sockets are worth batching, the client sockets
+ * usually send a single query and waiting would just add latency.  When
+ * libuv has sends of its own pending, we keep going through libuv, so
+ * the responses are not reordered.
+ */
+static bool
+udp_sendq_usable(isc_nmsocket_t *sock) {
+	return sock->parent != NULL &&
+	       atomic_load_relaxed(&sock->worker->netmgr->udp_sendmmsg) &&
+	       uv_udp_get_send_queue_count(&sock->uv_handle.udp) == 0;
+}
+#endif /* HAVE_SENDMMSG */
+
 /*
  * Send the data in 'region' to a peer via a UDP socket. We try to find
  * a proper sibling/child socket so that we won't have to jump to
@@ -663,12 +1084,9 @@ void
 isc__nm_udp_send(isc_nmhandle_t *handle, const isc_region_t *region,
 		 isc_nm_cb_t cb, void *cbarg) {
 	isc_nmsocket_t *sock = handle->sock;
-	const isc_sockaddr_t *peer = &handle->peer;
-	const struct sockaddr *sa = NULL;
 	isc__nm_uvreq_t *uvreq = NULL;
 	isc__networker_t *worker = NULL;
 	uint32_t maxudp;
-	int r;
 	isc_result_t result;
 
 	REQUIRE(VALID_NMSOCK(sock));
@@ -677,7 +1095,6 @@ isc__nm_udp_send(isc_nmhandle_t *handle, const isc_region_t *region,
 
 	worker = sock->worker;
 	maxudp = atomic_load(&worker->netmgr->maxudp);
-	sa = sock->connected ? NULL : &peer->type.sa;
 
 	/*
 	 * We're simulating a firewall blocking UDP packets bigger than
@@ -711,40 +1128,14 @@ isc__nm_udp_send(isc_nmhandle_t *handle, const isc_region_t *region,
 		goto fail;
 	}
 
-	if (uv_udp_get_send_queue_size(&sock->uv_handle.udp) >
-	    ISC_NETMGR_UDP_SENDBUF_SIZE)
-	{
-		/*
-		 * The kernel UDP send queue is full, try sending the UDP
-		 * response synchronously instead of just failing.
-		 */
-		r = uv_udp_try_send(&sock->uv_handle.udp, &uvreq->uvbuf, 1, sa);
-		if (r < 0) {
-			if (can_log_udp_sends()) {
-				isc__netmgr_log(
-					worker->netmgr, ISC_LOG_ERROR,
-					"Sending UDP messages failed: %s",
-					isc_result_totext(isc_uverr2result(r)));
-			}
-
-			isc__nm_incstats(sock, STATID_SENDFAIL);
-			result = isc_uverr2result(r);
-			goto fail;
-		}
-
-		RUNTIME_CHECK(r == (int)region->length);
-		isc__nm_sendcb(sock, uvreq, ISC_R_SUCCESS, true);
-
-	} else {
-		/* Send the message asynchronously */
-		r = uv_udp_send(&uvreq->uv_req.udp_send, &sock->uv_handle.udp,
-				&uvreq->uvbuf, 1, sa, udp_send_cb);
-		if (r < 0) {
-			isc__nm_incstats(sock, STATID_SENDFAIL);
-			result = isc_uverr2result(r);
-			goto fail;
-		}
+#if HAVE_SENDMMSG
+	if (udp_sendq_usable(sock)) {
+		udp_sendq_enqueue(sock, uvreq);
+		return;
 	}
+#endif /* HAVE_SENDMMSG */
+
+	udp_send_direct(sock, uvreq);
 	return;
 fail:
 	isc__nm_failed_send_cb(sock, uvreq, result, true);
@@ -997,6 +1388,11 @@ isc__nm_udp_close(isc_nmsocket_t *sock) {
 	REQUIRE(sock->tid == isc_tid());
 	REQUIRE(!sock->closing);
 
+#if HAVE_SENDMMSG
+	/* Flush the responses queued before the socket gets closed */
+	udp_sendq_flush(sock, true);
+#endif /* HAVE_SENDMMSG */
+
 	sock->closing = true;
 
 	isc__nmsocket_clearcb(sock);
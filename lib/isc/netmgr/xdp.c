@@ -0,0 +1,1277 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * AF_XDP receive/transmit path for the UDP listeners.
+ *
+ * The listener attaches a small XDP program to the network interface which
+ * redirects the UDP datagrams sent to the listening address and port to the
+ * AF_XDP socket bound to the receiving queue; everything else is passed to
+ * the kernel network stack.  There's one AF_XDP socket per loop, bound to the
+ * queue with the same number as the loop, each with its own UMEM area: half
+ * of the frames are used for receiving and the other half for sending.
+ *
+ * The datagrams are parsed in place and handed to the same receive callback
+ * as the regular UDP datagrams; the responses are assembled into the free
+ * transmit frames, with the link-layer and the IP addresses swapped.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#if USE_XDP
+#include <net/if.h>
+#include <netinet/in.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+#include <linux/bpf.h>
+#include <linux/if_ether.h>
+#include <linux/if_xdp.h>
+#endif /* USE_XDP */
+
+#include <isc/async.h>
+#include <isc/barrier.h>
+#include <isc/errno.h>
+#include <isc/mem.h>
+#include <isc/netmgr.h>
+#include <isc/result.h>
+#include <isc/sockaddr.h>
+#include <isc/stats.h>
+#include <isc/util.h>
+#include <isc/uv.h>
+
+#include "../loop_p.h"
+#include "netmgr-int.h"
+
+#if USE_XDP
+
+#define NM_XDP_FRAME_SIZE 2048
+#define NM_XDP_NUM_FRAMES 4096
+#define NM_XDP_RING_SIZE  2048
+#define NM_XDP_RX_BATCH	  64
+
+#define NM_XDP_ETH_HLEN	 14
+#define NM_XDP_IPV4_HLEN 20
+#define NM_XDP_IPV6_HLEN 40
+#define NM_XDP_UDP_HLEN	 8
+
+#define NM_XDP_TTL 64
+
+STATIC_ASSERT(NM_XDP_NUM_FRAMES / 2 <= NM_XDP_RING_SIZE,
+	      "the fill ring must be able to hold all the receive frames");
+
+typedef struct nm_xdp_ring {
+	uint32_t cached_prod;
+	uint32_t cached_cons;
+	uint32_t mask;
+	uint32_t size;
+	uint32_t *producer;
+	uint32_t *consumer;
+	uint32_t *flags;
+	void *ring;
+	void *map;
+	size_t maplen;
+} nm_xdp_ring_t;
+
+struct isc__nm_xdp {
+	isc_mem_t *mctx;
+	int fd;
+	uint8_t *area;
+	size_t arealen;
+	size_t maxpayload;
+	nm_xdp_ring_t fill;
+	nm_xdp_ring_t comp;
+	nm_xdp_ring_t rx;
+	nm_xdp_ring_t tx;
+	size_t nframes;
+	uint64_t frames[NM_XDP_NUM_FRAMES / 2];
+};
+
+/*
+ * The rings are shared with the kernel; the producer and the consumer
+ * indices are published with the release and read with the acquire
+ * semantics.
+ */
+static uint32_t
+ring_load(uint32_t *p) {
+	return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static void
+ring_store(uint32_t *p, uint32_t v) {
+	__atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+static uint32_t
+ring_prod_reserve(nm_xdp_ring_t *ring, uint32_t n, uint32_t *idx) {
+	if (ring->cached_cons - ring->cached_prod < n) {
+		ring->cached_cons = ring_load(ring->consumer) + ring->size;
+		if (ring->cached_cons - ring->cached_prod < n) {
+			return 0;
+		}
+	}
+
+	*idx = ring->cached_prod;
+	ring->cached_prod += n;
+
+	return n;
+}
+
+static void
+ring_prod_submit(nm_xdp_ring_t *ring) {
+	ring_store(ring->producer, ring->cached_prod);
+}
+
+static uint32_t
+ring_cons_peek(nm_xdp_ring_t *ring, uint32_t n, uint32_t *idx) {
+	uint32_t entries = ring->cached_prod - ring->cached_cons;
+
+	if (entries == 0) {
+		ring->cached_prod = ring_load(ring->producer);
+		entries = ring->cached_prod - ring->cached_cons;
+	}
+
+	if (entries > n) {
+		entries = n;
+	}
+
+	*idx = ring->cached_cons;
+	ring->cached_cons += entries;
+
+	return entries;
+}
+
+static void
+ring_cons_release(nm_xdp_ring_t *ring) {
+	ring_store(ring->consumer, ring->cached_cons);
+}
+
+static bool
+ring_needs_wakeup(nm_xdp_ring_t *ring) {
+	return (__atomic_load_n(ring->flags, __ATOMIC_RELAXED) &
+		XDP_RING_NEED_WAKEUP) != 0;
+}
+
+static uint64_t *
+ring_addr(nm_xdp_ring_t *ring, uint32_t idx) {
+	return &((uint64_t *)ring->ring)[idx & ring->mask];
+}
+
+static struct xdp_desc *
+ring_desc(nm_xdp_ring_t *ring, uint32_t idx) {
+	return &((struct xdp_desc *)ring->ring)[idx & ring->mask];
+}
+
+static isc_result_t
+ring_map(int fd, nm_xdp_ring_t *ring, const struct xdp_ring_offset *off,
+	 size_t descsize, off_t pgoff, bool producer) {
+	ring->maplen = off->desc + NM_XDP_RING_SIZE * descsize;
+	ring->map = mmap(NULL, ring->maplen, PROT_READ | PROT_WRITE,
+			 MAP_SHARED | MAP_POPULATE, fd, pgoff);
+	if (ring->map == MAP_FAILED) {
+		ring->map = NULL;
+		return isc_errno_toresult(errno);
+	}
+
+	ring->producer = (uint32_t *)((uint8_t *)ring->map + off->producer);
+	ring->consumer = (uint32_t *)((uint8_t *)ring->map + off->consumer);
+	ring->flags = (uint32_t *)((uint8_t *)ring->map + off->flags);
+	ring->ring = (uint8_t *)ring->map + off->desc;
+	ring->size = NM_XDP_RING_SIZE;
+	ring->mask = NM_XDP_RING_SIZE - 1;
+	ring->cached_prod = ring_load(ring->producer);
+	ring->cached_cons = ring_load(ring->consumer);
+	if (producer) {
+		ring->cached_cons += ring->size;
+	}
+
+	return ISC_R_SUCCESS;
+}
+
+static void
+ring_unmap(nm_xdp_ring_t *ring) {
+	if (ring->map != NULL) {
+		munmap(ring->map, ring->maplen);
+		ring->map = NULL;
+	}
+}
+
+static void
+xdp_destroy(isc__nm_xdp_t **xdpp) {
+	isc__nm_xdp_t *xdp = *xdpp;
+	*xdpp = NULL;
+
+	ring_unmap(&xdp->fill);
+	ring_unmap(&xdp->comp);
+	ring_unmap(&xdp->rx);
+	ring_unmap(&xdp->tx);
+
+	if (xdp->fd >= 0) {
+		isc__nm_closesocket(xdp->fd);
+	}
+
+	if (xdp->area != NULL) {
+		munmap(xdp->area, xdp->arealen);
+	}
+
+	isc_mem_putanddetach(&xdp->mctx, xdp, sizeof(*xdp));
+}
+
+static isc_result_t
+xdp_create(isc_mem_t *mctx, unsigned int ifindex, uint32_t queue,
+	   size_t maxpayload, isc__nm_xdp_t **xdpp) {
+	isc_result_t result;
+	isc__nm_xdp_t *xdp = NULL;
+	struct xdp_mmap_offsets off = { 0 };
+	socklen_t optlen = sizeof(off);
+	struct xdp_umem_reg reg = { 0 };
+	struct sockaddr_xdp sxdp = { 0 };
+	uint32_t idx;
+
+	xdp = isc_mem_get(mctx, sizeof(*xdp));
+	*xdp = (isc__nm_xdp_t){
+		.fd = -1,
+		.maxpayload = maxpayload,
+	};
+	isc_mem_attach(mctx, &xdp->mctx);
+
+	xdp->fd = socket(AF_XDP, SOCK_RAW | SOCK_CLOEXEC, 0);
+	if (xdp->fd < 0) {
+		result = isc_errno_toresult(errno);
+		goto fail;
+	}
+
+	xdp->arealen = NM_XDP_NUM_FRAMES * NM_XDP_FRAME_SIZE;
+	xdp->area = mmap(NULL, xdp->arealen, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (xdp->area == MAP_FAILED) {
+		xdp->area = NULL;
+		result = isc_errno_toresult(errno);
+		goto fail;
+	}
+
+	reg.addr = (uintptr_t)xdp->area;
+	reg.len = xdp->arealen;
+	reg.chunk_size = NM_XDP_FRAME_SIZE;
+	reg.headroom = 0;
+	if (setsockopt(xdp->fd, SOL_XDP, XDP_UMEM_REG, &reg, sizeof(reg)) < 0 ||
+	    setsockopt(xdp->fd, SOL_XDP, XDP_UMEM_FILL_RING,
+		       &(int){ NM_XDP_RING_SIZE }, sizeof(int)) < 0 ||
+	    setsockopt(xdp->fd, SOL_XDP, XDP_UMEM_COMPLETION_RING,
+		       &(int){ NM_XDP_RING_SIZE }, sizeof(int)) < 0 ||
+	    setsockopt(xdp->fd, SOL_XDP, XDP_RX_RING,
+		       &(int){ NM_XDP_RING_SIZE }, sizeof(int)) < 0 ||
+	    setsockopt(xdp->fd, SOL_XDP, XDP_TX_RING,
+		       &(int){ NM_XDP_RING_SIZE }, sizeof(int)) < 0 ||
+	    getsockopt(xdp->fd, SOL_XDP, XDP_MMAP_OFFSETS, &off, &optlen) < 0)
+	{
+		result = isc_errno_toresult(errno);
+		goto fail;
+	}
+
+	result = ring_map(xdp->fd, &xdp->fill, &off.fr, sizeof(uint64_t),
+			  XDP_UMEM_PGOFF_FILL_RING, true);
+	if (result != ISC_R_SUCCESS) {
+		goto fail;
+	}
+	result = ring_map(xdp->fd, &xdp->comp, &off.cr, sizeof(uint64_t),
+			  XDP_UMEM_PGOFF_COMPLETION_RING, false);
+	if (result != ISC_R_SUCCESS) {
+		goto fail;
+	}
+	result = ring_map(xdp->fd, &xdp->rx, &off.rx, sizeof(struct xdp_desc),
+			  XDP_PGOFF_RX_RING, false);
+	if (result != ISC_R_SUCCESS) {
+		goto fail;
+	}
+	result = ring_map(xdp->fd, &xdp->tx, &off.tx, sizeof(struct xdp_desc),
+			  XDP_PGOFF_TX_RING, true);
+	if (result != ISC_R_SUCCESS) {
+		goto fail;
+	}
+
+	/*
+	 * The first half of the frames is given to the kernel for receiving,
+	 * the second half is kept for sending.
+	 */
+	RUNTIME_CHECK(ring_prod_reserve(&xdp->fill, NM_XDP_NUM_FRAMES / 2,
+					&idx) == NM_XDP_NUM_FRAMES / 2);
+	for (size_t i = 0; i < NM_XDP_NUM_FRAMES / 2; i++) {
+		*ring_addr(&xdp->fill, idx + i) = i * NM_XDP_FRAME_SIZE;
+	}
+	ring_prod_submit(&xdp->fill);
+
+	for (size_t i = NM_XDP_NUM_FRAMES / 2; i < NM_XDP_NUM_FRAMES; i++) {
+		xdp->frames[xdp->nframes++] = i * NM_XDP_FRAME_SIZE;
+	}
+
+	sxdp.sxdp_family = AF_XDP;
+	sxdp.sxdp_flags = XDP_USE_NEED_WAKEUP;
+	sxdp.sxdp_ifindex = ifindex;
+	sxdp.sxdp_queue_id = queue;
+	if (bind(xdp->fd, (struct sockaddr *)&sxdp, sizeof(sxdp)) < 0) {
+		result = isc_errno_toresult(errno);
+		goto fail;
+	}
+
+	*xdpp = xdp;
+	return ISC_R_SUCCESS;
+
+fail:
+	xdp_destroy(&xdp);
+	return result;
+}
+
+/*
+ * bpf(2) helpers; there's no libc wrapper for the system call.
+ */
+static int
+sys_bpf(int cmd, union bpf_attr *attr) {
+	return syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+}
+
+#define NM_BPF_INSN(c, d, s, o, i)                \
+	((struct bpf_insn){ .code = (c),          \
+			    .dst_reg = (d),       \
+			    .src_reg = (s),       \
+			    .off = (o),           \
+			    .imm = (i) })
+#define NM_BPF_MOV64_REG(d, s) \
+	NM_BPF_INSN(BPF_ALU64 | BPF_MOV | BPF_X, d, s, 0, 0)
+#define NM_BPF_MOV64_IMM(d, i) \
+	NM_BPF_INSN(BPF_ALU64 | BPF_MOV | BPF_K, d, 0, 0, i)
+#define NM_BPF_MOV32_IMM(d, i) \
+	NM_BPF_INSN(BPF_ALU | BPF_MOV | BPF_K, d, 0, 0, i)
+#define NM_BPF_ADD64_IMM(d, i) \
+	NM_BPF_INSN(BPF_ALU64 | BPF_ADD | BPF_K, d, 0, 0, i)
+#define NM_BPF_AND64_IMM(d, i) \
+	NM_BPF_INSN(BPF_ALU64 | BPF_AND | BPF_K, d, 0, 0, i)
+#define NM_BPF_LDX(sz, d, s, o) \
+	NM_BPF_INSN(BPF_LDX | BPF_MEM | (sz), d, s, o, 0)
+#define NM_BPF_CALL(f) NM_BPF_INSN(BPF_JMP | BPF_CALL, 0, 0, 0, f)
+#define NM_BPF_EXIT()  NM_BPF_INSN(BPF_JMP | BPF_EXIT, 0, 0, 0, 0)
+
+/*
+ * The jumps to the "pass" label at the end of the program are emitted with
+ * a placeholder offset and fixed up once the program is complete.
+ */
+typedef struct xdp_prog {
+	struct bpf_insn insns[64];
+	size_t len;
+	size_t fixups[32];
+	size_t nfixups;
+} xdp_prog_t;
+
+static void
+emit(xdp_prog_t *prog, struct bpf_insn insn) {
+	INSIST(prog->len < ARRAY_SIZE(prog->insns));
+	prog->insns[prog->len++] = insn;
+}
+
+static void
+emit_pass_unless_imm(xdp_prog_t *prog, int reg, int32_t imm) {
+	INSIST(prog->nfixups < ARRAY_SIZE(prog->fixups));
+	prog->fixups[prog->nfixups++] = prog->len;
+	emit(prog, NM_BPF_INSN(BPF_JMP | BPF_JNE | BPF_K, reg, 0, 0, imm));
+}
+
+static void
+emit_pass_unless_u32(xdp_prog_t *prog, int reg, uint32_t value) {
+	/* The immediates are sign extended, compare with a register */
+	emit(prog, NM_BPF_MOV32_IMM(BPF_REG_7, (int32_t)value));
+	INSIST(prog->nfixups < ARRAY_SIZE(prog->fixups));
+	prog->fixups[prog->nfixups++] = prog->len;
+	emit(prog, NM_BPF_INSN(BPF_JMP | BPF_JNE | BPF_X, reg, BPF_REG_7, 0, 0));
+}
+
+static void
+xdp_prog_build(xdp_prog_t *prog, const isc_sockaddr_t *iface, int mapfd) {
+	int family = iface->type.sa.sa_family;
+	size_t hdrlen = NM_XDP_ETH_HLEN + NM_XDP_UDP_HLEN +
+			(family == AF_INET ? NM_XDP_IPV4_HLEN
+					   : NM_XDP_IPV6_HLEN);
+	uint16_t port = htons(isc_sockaddr_getport(iface));
+	bool any;
+	size_t pass;
+
+	if (family == AF_INET) {
+		any = iface->type.sin.sin_addr.s_addr == htonl(INADDR_ANY);
+	} else {
+		any = IN6_IS_ADDR_UNSPECIFIED(&iface->type.sin6.sin6_addr);
+	}
+
+	/*
+	 * The values loaded from the packet are in the network byte order,
+	 * so they are compared with the constants in the network byte order.
+	 *
+	 * r6 = ctx; r2 = data; r3 = data_end
+	 */
+	emit(prog, NM_BPF_MOV64_REG(BPF_REG_6, BPF_REG_1));
+	emit(prog, NM_BPF_LDX(BPF_W, BPF_REG_2, BPF_REG_6,
+			   offsetof(struct xdp_md, data)));
+	emit(prog, NM_BPF_LDX(BPF_W, BPF_REG_3, BPF_REG_6,
+			   offsetof(struct xdp_md, data_end)));
+
+	/* if (data + hdrlen > data_end) goto pass */
+	emit(prog, NM_BPF_MOV64_REG(BPF_REG_4, BPF_REG_2));
+	emit(prog, NM_BPF_ADD64_IMM(BPF_REG_4, hdrlen));
+	prog->fixups[prog->nfixups++] = prog->len;
+	emit(prog, NM_BPF_INSN(BPF_JMP | BPF_JGT | BPF_X, BPF_REG_4, BPF_REG_3, 0,
+			    0));
+
+	/* Ethernet type */
+	emit(prog, NM_BPF_LDX(BPF_H, BPF_REG_5, BPF_REG_2, 12));
+
+	if (family == AF_INET) {
+		const uint8_t *ip = (const uint8_t *)&iface->type.sin.sin_addr;
+		uint32_t addr;
+
+		memmove(&addr, ip, sizeof(addr));
+
+		emit_pass_unless_imm(prog, BPF_REG_5, htons(ETH_P_IP));
+
+		/* Version 4 without options, UDP, not a fragment */
+		emit(prog, NM_BPF_LDX(BPF_B, BPF_REG_5, BPF_REG_2, 14));
+		emit_pass_unless_imm(prog, BPF_REG_5, 0x45);
+		emit(prog, NM_BPF_LDX(BPF_B, BPF_REG_5, BPF_REG_2, 23));
+		emit_pass_unless_imm(prog, BPF_REG_5, IPPROTO_UDP);
+		emit(prog, NM_BPF_LDX(BPF_H, BPF_REG_5, BPF_REG_2, 20));
+		emit(prog, NM_BPF_AND64_IMM(BPF_REG_5, htons(0x3fff)));
+		emit_pass_unless_imm(prog, BPF_REG_5, 0);
+
+		/* Destination address */
+		if (!any) {
+			emit(prog, NM_BPF_LDX(BPF_W, BPF_REG_5, BPF_REG_2, 30));
+			emit_pass_unless_u32(prog, BPF_REG_5, addr);
+		}
+
+		/* Destination port */
+		emit(prog, NM_BPF_LDX(BPF_H, BPF_REG_5, BPF_REG_2, 36));
+		emit_pass_unless_imm(prog, BPF_REG_5, port);
+	} else {
+		const uint8_t *ip6 =
+			(const uint8_t *)&iface->type.sin6.sin6_addr;
+
+		emit_pass_unless_imm(prog, BPF_REG_5, htons(ETH_P_IPV6));
+
+		/* UDP without extension headers */
+		emit(prog, NM_BPF_LDX(BPF_B, BPF_REG_5, BPF_REG_2, 20));
+		emit_pass_unless_imm(prog, BPF_REG_5, IPPROTO_UDP);
+
+		/* Destination address */
+		for (size_t i = 0; !any && i < 4; i++) {
+			uint32_t word;
+
+			memmove(&word, ip6 + i * 4, sizeof(word));
+			emit(prog, NM_BPF_LDX(BPF_W, BPF_REG_5, BPF_REG_2,
+					   38 + i * 4));
+			emit_pass_unless_u32(prog, BPF_REG_5, word);
+		}
+
+		/* Destination port */
+		emit(prog, NM_BPF_LDX(BPF_H, BPF_REG_5, BPF_REG_2, 56));
+		emit_pass_unless_imm(prog, BPF_REG_5, port);
+	}
+
+	/*
+	 * return bpf_redirect_map(&xsks, ctx->rx_queue_index, XDP_PASS);
+	 *
+	 * The lower bits of the flags are returned when the queue has no
+	 * AF_XDP socket in the map.
+	 */
+	emit(prog, NM_BPF_LDX(BPF_W, BPF_REG_2, BPF_REG_6,
+			   offsetof(struct xdp_md, rx_queue_index)));
+	emit(prog, NM_BPF_INSN(BPF_LD | BPF_DW | BPF_IMM, BPF_REG_1,
+			    BPF_PSEUDO_MAP_FD, 0, mapfd));
+	emit(prog, NM_BPF_INSN(0, 0, 0, 0, 0));
+	emit(prog, NM_BPF_MOV64_IMM(BPF_REG_3, XDP_PASS));
+	emit(prog, NM_BPF_CALL(BPF_FUNC_redirect_map));
+	emit(prog, NM_BPF_EXIT());
+
+	/* pass: return XDP_PASS; */
+	pass = prog->len;
+	emit(prog, NM_BPF_MOV64_IMM(BPF_REG_0, XDP_PASS));
+	emit(prog, NM_BPF_EXIT());
+
+	for (size_t i = 0; i < prog->nfixups; i++) {
+		size_t at = prog->fixups[i];
+		prog->insns[at].off = pass - at - 1;
+	}
+}
+
+static void
+xdp_prog_detach(isc_nmsocket_t *sock) {
+	if (sock->xdp.linkfd >= 0) {
+		close(sock->xdp.linkfd);
+		sock->xdp.linkfd = -1;
+	}
+	if (sock->xdp.progfd >= 0) {
+		close(sock->xdp.progfd);
+		sock->xdp.progfd = -1;
+	}
+	if (sock->xdp.mapfd >= 0) {
+		close(sock->xdp.mapfd);
+		sock->xdp.mapfd = -1;
+	}
+}
+
+static isc_result_t
+xdp_prog_attach(isc_nmsocket_t *sock, unsigned int ifindex,
+		isc__nm_xdp_t **xdps) {
+	isc_result_t result;
+	union bpf_attr attr;
+	xdp_prog_t prog = { 0 };
+	static const char license[] = "MPL-2.0";
+
+	memset(&attr, 0, sizeof(attr));
+	attr.map_type = BPF_MAP_TYPE_XSKMAP;
+	attr.key_size = sizeof(uint32_t);
+	attr.value_size = sizeof(int);
+	attr.max_entries = sock->nchildren;
+	sock->xdp.mapfd = sys_bpf(BPF_MAP_CREATE, &attr);
+	if (sock->xdp.mapfd < 0) {
+		goto fail;
+	}
+
+	for (uint32_t i = 0; i < sock->nchildren; i++) {
+		memset(&attr, 0, sizeof(attr));
+		attr.map_fd = sock->xdp.mapfd;
+		attr.key = (uintptr_t)&i;
+		attr.value = (uintptr_t)&xdps[i]->fd;
+		attr.flags = BPF_ANY;
+		if (sys_bpf(BPF_MAP_UPDATE_ELEM, &attr) < 0) {
+			goto fail;
+		}
+	}
+
+	xdp_prog_build(&prog, &sock->iface, sock->xdp.mapfd);
+
+	memset(&attr, 0, sizeof(attr));
+	attr.prog_type = BPF_PROG_TYPE_XDP;
+	attr.insns = (uintptr_t)prog.insns;
+	attr.insn_cnt = prog.len;
+	attr.license = (uintptr_t)license;
+	sock->xdp.progfd = sys_bpf(BPF_PROG_LOAD, &attr);
+	if (sock->xdp.progfd < 0) {
+		goto fail;
+	}
+
+	/*
+	 * The program stays attached for as long as the link is open, so it
+	 * goes away with the listener even if named crashes.
+	 */
+	memset(&attr, 0, sizeof(attr));
+	attr.link_create.prog_fd = sock->xdp.progfd;
+	attr.link_create.target_ifindex = ifindex;
+	attr.link_create.attach_type = BPF_XDP;
+	sock->xdp.linkfd = sys_bpf(BPF_LINK_CREATE, &attr);
+	if (sock->xdp.linkfd < 0) {
+		goto fail;
+	}
+
+	return ISC_R_SUCCESS;
+
+fail:
+	result = isc_errno_toresult(errno);
+	xdp_prog_detach(sock);
+	return result;
+}
+
+/*
+ * Checksums of the outgoing packets.
+ */
+static uint32_t
+csum_add(uint32_t sum, const uint8_t *p, size_t len) {
+	while (len > 1) {
+		sum += (p[0] << 8) | p[1];
+		p += 2;
+		len -= 2;
+	}
+	if (len > 0) {
+		sum += p[0] << 8;
+	}
+	return sum;
+}
+
+static uint16_t
+csum_fold(uint32_t sum) {
+	while ((sum >> 16) != 0) {
+		sum = (sum & 0xffff) + (sum >> 16);
+	}
+	return ~sum & 0xffff;
+}
+
+static uint16_t
+get16(const uint8_t *p) {
+	return (p[0] << 8) | p[1];
+}
+
+static void
+put16(uint8_t *p, uint16_t v) {
+	p[0] = v >> 8;
+	p[1] = v & 0xff;
+}
+
+static bool
+xdp_parse(const uint8_t *frame, size_t len, int family, isc_sockaddr_t *peer,
+	  isc_region_t *payload) {
+	const uint8_t *ip = frame + NM_XDP_ETH_HLEN;
+	const uint8_t *udp = NULL;
+	size_t iplen, udplen;
+
+	if (family == AF_INET) {
+		struct in_addr ina;
+
+		if (len < NM_XDP_ETH_HLEN + NM_XDP_IPV4_HLEN + NM_XDP_UDP_HLEN ||
+		    get16(frame + 12) != ETH_P_IP || ip[0] != 0x45 ||
+		    ip[9] != IPPROTO_UDP)
+		{
+			return false;
+		}
+
+		iplen = get16(ip + 2);
+		if (iplen < NM_XDP_IPV4_HLEN + NM_XDP_UDP_HLEN ||
+		    NM_XDP_ETH_HLEN + iplen > len)
+		{
+			return false;
+		}
+
+		udp = ip + NM_XDP_IPV4_HLEN;
+		udplen = get16(udp + 4);
+		if (udplen < NM_XDP_UDP_HLEN ||
+		    udplen > iplen - NM_XDP_IPV4_HLEN)
+		{
+			return false;
+		}
+
+		memmove(&ina, ip + 12, sizeof(ina));
+		isc_sockaddr_fromin(peer, &ina, get16(udp));
+	} else {
+		struct in6_addr ina6;
+
+		if (len < NM_XDP_ETH_HLEN + NM_XDP_IPV6_HLEN + NM_XDP_UDP_HLEN ||
+		    get16(frame + 12) != ETH_P_IPV6 || (ip[0] >> 4) != 6 ||
+		    ip[6] != IPPROTO_UDP)
+		{
+			return false;
+		}
+
+		iplen = get16(ip + 4);
+		if (iplen < NM_XDP_UDP_HLEN ||
+		    NM_XDP_ETH_HLEN + NM_XDP_IPV6_HLEN + iplen > len)
+		{
+			return false;
+		}
+
+		udp = ip + NM_XDP_IPV6_HLEN;
+		udplen = get16(udp + 4);
+		if (udplen < NM_XDP_UDP_HLEN || udplen > iplen) {
+			return false;
+		}
+
+		memmove(&ina6, ip + 8, sizeof(ina6));
+		isc_sockaddr_fromin6(peer, &ina6, get16(udp));
+	}
+
+	payload->base = UNCONST(udp + NM_XDP_UDP_HLEN);
+	payload->length = udplen - NM_XDP_UDP_HLEN;
+
+	return true;
+}
+
+static size_t
+xdp_build(uint8_t *frame, const isc_nmhandle_t *handle,
+	  const isc_region_t *region) {
+	const isc_sockaddr_t *peer = &handle->peer;
+	const isc_sockaddr_t *local = &handle->local;
+	size_t udplen = NM_XDP_UDP_HLEN + region->length;
+	uint8_t *ip = frame + NM_XDP_ETH_HLEN;
+	uint8_t *udp = NULL;
+	uint32_t sum;
+	uint16_t csum;
+
+	/* Send the response back to the sender of the query */
+	memmove(frame, handle->xdp_hwaddr + ETH_ALEN, ETH_ALEN);
+	memmove(frame + ETH_ALEN, handle->xdp_hwaddr, ETH_ALEN);
+
+	if (peer->type.sa.sa_family == AF_INET) {
+		put16(frame + 12, ETH_P_IP);
+
+		ip[0] = 0x45;
+		ip[1] = 0;
+		put16(ip + 2, NM_XDP_IPV4_HLEN + udplen);
+		put16(ip + 4, 0);
+		put16(ip + 6, 0x4000); /* DF */
+		ip[8] = NM_XDP_TTL;
+		ip[9] = IPPROTO_UDP;
+		put16(ip + 10, 0);
+		memmove(ip + 12, &local->type.sin.sin_addr, 4);
+		memmove(ip + 16, &peer->type.sin.sin_addr, 4);
+		put16(ip + 10, csum_fold(csum_add(0, ip, NM_XDP_IPV4_HLEN)));
+
+		udp = ip + NM_XDP_IPV4_HLEN;
+		sum = csum_add(0, ip + 12, 8);
+	} else {
+		put16(frame + 12, ETH_P_IPV6);
+
+		ip[0] = 0x60;
+		ip[1] = ip[2] = ip[3] = 0;
+		put16(ip + 4, udplen);
+		ip[6] = IPPROTO_UDP;
+		ip[7] = NM_XDP_TTL;
+		memmove(ip + 8, &local->type.sin6.sin6_addr, 16);
+		memmove(ip + 24, &peer->type.sin6.sin6_addr, 16);
+
+		udp = ip + NM_XDP_IPV6_HLEN;
+		sum = csum_add(0, ip + 8, 32);
+	}
+
+	put16(udp, isc_sockaddr_getport(local));
+	put16(udp + 2, isc_sockaddr_getport(peer));
+	put16(udp + 4, udplen);
+	put16(udp + 6, 0);
+	memmove(udp + NM_XDP_UDP_HLEN, region->base, region->length);
+
+	sum += IPPROTO_UDP + udplen;
+	csum = csum_fold(csum_add(sum, udp, udplen));
+	put16(udp + 6, csum == 0 ? 0xffff : csum);
+
+	return (udp - frame) + udplen;
+}
+
+static void
+xdp_kick(isc__nm_xdp_t *xdp) {
+	/* EAGAIN, EBUSY and ENOBUFS only mean the kernel is busy */
+	(void)sendto(xdp->fd, NULL, 0, MSG_DONTWAIT, NULL, 0);
+}
+
+static void
+xdp_complete(isc__nm_xdp_t *xdp) {
+	uint32_t idx;
+	uint32_t n = ring_cons_peek(&xdp->comp, NM_XDP_RING_SIZE, &idx);
+
+	for (uint32_t i = 0; i < n; i++) {
+		INSIST(xdp->nframes < ARRAY_SIZE(xdp->frames));
+		xdp->frames[xdp->nframes++] = *ring_addr(&xdp->comp, idx + i) &
+					      ~(uint64_t)(NM_XDP_FRAME_SIZE -
+							  1);
+	}
+
+	if (n > 0) {
+		ring_cons_release(&xdp->comp);
+	}
+}
+
+static void
+xdp_recv(isc_nmsocket_t *sock) {
+	isc__nm_xdp_t *xdp = sock->xdp.umem;
+	isc_stats_t *loopstats = sock->worker->netmgr->loopstats;
+	int family = sock->iface.type.sa.sa_family;
+	uint32_t idx, fidx;
+	uint32_t n = ring_cons_peek(&xdp->rx, NM_XDP_RX_BATCH, &idx);
+
+	if (n == 0) {
+		return;
+	}
+
+	/* All the receive frames fit into the fill ring */
+	RUNTIME_CHECK(ring_prod_reserve(&xdp->fill, n, &fidx) == n);
+
+	for (uint32_t i = 0; i < n; i++) {
+		struct xdp_desc *desc = ring_desc(&xdp->rx, idx + i);
+		uint8_t *frame = xdp->area + desc->addr;
+		isc_sockaddr_t peer;
+		isc_region_t payload;
+
+		if (!isc__nmsocket_active(sock)) {
+			/* Just recycle the frame */
+		} else if (!xdp_parse(frame, desc->len, family, &peer,
+				      &payload))
+		{
+			isc__nm_incstats(sock, STATID_RECVFAIL);
+		} else {
+			isc__nm_uvreq_t *req = isc__nm_get_read_req(sock,
+								    &peer);
+
+			if (loopstats != NULL) {
+				isc_stats_increment(loopstats, sock->tid);
+			}
+
+			memmove(req->handle->xdp_hwaddr, frame,
+				sizeof(req->handle->xdp_hwaddr));
+
+			/*
+			 * The callback is called synchronously, the frame is
+			 * given back to the kernel only after it returns.
+			 */
+			req->uvbuf.base = (char *)payload.base;
+			req->uvbuf.len = payload.length;
+			isc__nm_readcb(sock, req, ISC_R_SUCCESS, false);
+		}
+
+		*ring_addr(&xdp->fill, fidx + i) =
+			desc->addr & ~(uint64_t)(NM_XDP_FRAME_SIZE - 1);
+	}
+
+	ring_cons_release(&xdp->rx);
+	ring_prod_submit(&xdp->fill);
+
+	if (ring_needs_wakeup(&xdp->fill)) {
+		(void)recvfrom(xdp->fd, NULL, 0, MSG_DONTWAIT, NULL, NULL);
+	}
+}
+
+static void
+xdp_poll_cb(uv_poll_t *handle, int status, int events) {
+	isc_nmsocket_t *sock = uv_handle_get_data((uv_handle_t *)handle);
+
+	UNUSED(events);
+
+	REQUIRE(VALID_NMSOCK(sock));
+	REQUIRE(sock->tid == isc_tid());
+
+	if (status < 0) {
+		isc__nm_incstats(sock, STATID_RECVFAIL);
+		return;
+	}
+
+	if (isc__nm_closing(sock->worker) || sock->closing) {
+		return;
+	}
+
+	xdp_complete(sock->xdp.umem);
+	xdp_recv(sock);
+}
+
+static void
+start_xdp_child_job(void *arg) {
+	isc_nmsocket_t *sock = arg;
+	isc_loop_t *loop = NULL;
+	int r;
+
+	REQUIRE(VALID_NMSOCK(sock));
+	REQUIRE(VALID_NMSOCK(sock->parent));
+	REQUIRE(sock->type == isc_nm_xdpsocket);
+	REQUIRE(sock->tid == isc_tid());
+
+	loop = sock->worker->loop;
+
+	r = uv_poll_init_socket(&loop->loop, &sock->uv_handle.poll, sock->fd);
+	UV_RUNTIME_CHECK(uv_poll_init_socket, r);
+	uv_handle_set_data(&sock->uv_handle.handle, sock);
+	/* This keeps the socket alive after everything else is gone */
+	isc__nmsocket_attach(sock, &(isc_nmsocket_t *){ NULL });
+
+	r = uv_poll_start(&sock->uv_handle.poll, UV_READABLE, xdp_poll_cb);
+	if (r == 0) {
+		isc__nm_incstats(sock, STATID_OPEN);
+	} else {
+		isc__nm_incstats(sock, STATID_OPENFAIL);
+	}
+
+	sock->result = isc_uverr2result(r);
+
+	REQUIRE(!loop->paused);
+
+	if (sock->tid != 0) {
+		isc_barrier_wait(&sock->parent->listen_barrier);
+	}
+}
+
+static isc_result_t
+xdp_maxpayload(const char *ifname, int family, size_t *maxpayloadp) {
+	struct ifreq ifr = { 0 };
+	size_t hdrlen = (family == AF_INET ? NM_XDP_IPV4_HLEN
+					   : NM_XDP_IPV6_HLEN) +
+			NM_XDP_UDP_HLEN;
+	size_t mtu;
+	int fd;
+
+	if (strlcpy(ifr.ifr_name, ifname, sizeof(ifr.ifr_name)) >=
+	    sizeof(ifr.ifr_name))
+	{
+		return ISC_R_NOTFOUND;
+	}
+
+	fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		return isc_errno_toresult(errno);
+	}
+	if (ioctl(fd, SIOCGIFMTU, &ifr) < 0) {
+		int err = errno;
+		isc__nm_closesocket(fd);
+		return isc_errno_toresult(err);
+	}
+	isc__nm_closesocket(fd);
+
+	/* The responses are never fragmented */
+	mtu = ISC_MIN((size_t)ifr.ifr_mtu,
+		      NM_XDP_FRAME_SIZE - NM_XDP_ETH_HLEN);
+	if (mtu <= hdrlen) {
+		return ISC_R_RANGE;
+	}
+
+	*maxpayloadp = mtu - hdrlen;
+	return ISC_R_SUCCESS;
+}
+
+isc_result_t
+isc_nm_listenxdp(isc_nm_t *mgr, uint32_t workers, const char *ifname,
+		 isc_sockaddr_t *iface, isc_nm_recv_cb_t cb, void *cbarg,
+		 isc_nmsocket_t **sockp) {
+	isc_result_t result;
+	isc_nmsocket_t *sock = NULL;
+	isc__networker_t *worker = NULL;
+	isc__nm_xdp_t **xdps = NULL;
+	unsigned int ifindex;
+	size_t maxpayload = 0;
+	uint32_t nchildren;
+	int family;
+
+	REQUIRE(VALID_NM(mgr));
+	REQUIRE(isc_tid() == 0);
+	REQUIRE(ifname != NULL);
+	REQUIRE(sockp != NULL && *sockp == NULL);
+
+	worker = &mgr->workers[0];
+
+	if (isc__nm_closing(worker)) {
+		return ISC_R_SHUTTINGDOWN;
+	}
+
+	family = iface->type.sa.sa_family;
+	if (family != AF_INET && family != AF_INET6) {
+		return ISC_R_FAMILYNOSUPPORT;
+	}
+
+	ifindex = if_nametoindex(ifname);
+	if (ifindex == 0) {
+		return ISC_R_NOTFOUND;
+	}
+
+	result = xdp_maxpayload(ifname, family, &maxpayload);
+	if (result != ISC_R_SUCCESS) {
+		return result;
+	}
+
+	if (workers == 0) {
+		workers = mgr->nloops;
+	}
+	REQUIRE(workers <= mgr->nloops);
+	nchildren = (workers == ISC_NM_LISTEN_ALL) ? (uint32_t)mgr->nloops
+						   : workers;
+
+	/*
+	 * Set up all the AF_XDP sockets first, so the failures don't leave
+	 * a half-open listener around.
+	 */
+	xdps = isc_mem_cget(worker->mctx, nchildren, sizeof(xdps[0]));
+	for (uint32_t i = 0; i < nchildren; i++) {
+		result = xdp_create(worker->mctx, ifindex, i, maxpayload,
+				    &xdps[i]);
+		if (result != ISC_R_SUCCESS) {
+			goto fail;
+		}
+	}
+
+	sock = isc_mempool_get(worker->nmsocket_pool);
+	isc__nmsocket_init(sock, worker, isc_nm_xdplistener, iface, NULL);
+
+	sock->nchildren = nchildren;
+	sock->children = isc_mem_cget(worker->mctx, sock->nchildren,
+				      sizeof(sock->children[0]));
+
+	result = xdp_prog_attach(sock, ifindex, xdps);
+	if (result != ISC_R_SUCCESS) {
+		isc_mem_cput(worker->mctx, sock->children, sock->nchildren,
+			     sizeof(sock->children[0]));
+		sock->nchildren = 0;
+		sock->closed = true;
+		isc__nmsocket_detach(&sock);
+		goto fail;
+	}
+
+	isc__nmsocket_barrier_init(sock);
+
+	sock->recv_cb = cb;
+	sock->recv_cbarg = cbarg;
+
+	for (uint32_t i = 0; i < sock->nchildren; i++) {
+		isc_nmsocket_t *csock = &sock->children[i];
+
+		isc__nmsocket_init(csock, &mgr->workers[i], isc_nm_xdpsocket,
+				   iface, sock);
+		csock->recv_cb = sock->recv_cb;
+		csock->recv_cbarg = sock->recv_cbarg;
+		csock->inactive_handles_max = ISC_NM_NMHANDLES_MAX;
+		csock->xdp.umem = xdps[i];
+		csock->fd = xdps[i]->fd;
+		xdps[i] = NULL;
+	}
+	isc_mem_cput(worker->mctx, xdps, nchildren, sizeof(xdps[0]));
+
+	start_xdp_child_job(&sock->children[0]);
+	result = sock->children[0].result;
+	INSIST(result != ISC_R_UNSET);
+
+	for (size_t i = 1; i < sock->nchildren; i++) {
+		isc_nmsocket_t *csock = &sock->children[i];
+		isc_async_run(csock->worker->loop, start_xdp_child_job, csock);
+	}
+
+	isc_barrier_wait(&sock->listen_barrier);
+
+	for (size_t i = 1; i < sock->nchildren; i++) {
+		if (result == ISC_R_SUCCESS &&
+		    sock->children[i].result != ISC_R_SUCCESS)
+		{
+			result = sock->children[i].result;
+		}
+	}
+
+	if (result != ISC_R_SUCCESS) {
+		sock->active = false;
+		isc__nm_xdp_stoplistening(sock);
+		isc_nmsocket_close(&sock);
+
+		return result;
+	}
+
+	sock->active = true;
+
+	*sockp = sock;
+	return ISC_R_SUCCESS;
+
+fail:
+	for (uint32_t i = 0; i < nchildren; i++) {
+		if (xdps[i] != NULL) {
+			xdp_destroy(&xdps[i]);
+		}
+	}
+	isc_mem_cput(worker->mctx, xdps, nchildren, sizeof(xdps[0]));
+
+	return result;
+}
+
+static void
+stop_xdp_child_job(void *arg) {
+	isc_nmsocket_t *sock = arg;
+
+	REQUIRE(VALID_NMSOCK(sock));
+	REQUIRE(sock->tid == isc_tid());
+	REQUIRE(sock->parent != NULL);
+
+	sock->active = false;
+
+	isc__nm_xdp_close(sock);
+
+	REQUIRE(!sock->worker->loop->paused);
+	isc_barrier_wait(&sock->parent->stop_barrier);
+}
+
+void
+isc__nm_xdp_stoplistening(isc_nmsocket_t *sock) {
+	REQUIRE(VALID_NMSOCK(sock));
+	REQUIRE(sock->type == isc_nm_xdplistener);
+	REQUIRE(sock->tid == isc_tid());
+	REQUIRE(sock->tid == 0);
+	REQUIRE(!sock->closing);
+
+	sock->closing = true;
+
+	/* Mark the parent socket inactive */
+	sock->active = false;
+
+	/* Give the traffic back to the kernel first */
+	xdp_prog_detach(sock);
+
+	/* Stop all the other threads' children */
+	for (size_t i = 1; i < sock->nchildren; i++) {
+		isc_async_run(sock->children[i].worker->loop,
+			      stop_xdp_child_job, &sock->children[i]);
+	}
+
+	/* Stop the child for the main thread */
+	stop_xdp_child_job(&sock->children[0]);
+
+	/* Stop the parent */
+	sock->closed = true;
+	isc__nmsocket_prep_destroy(sock);
+}
+
+static void
+xdp_close_cb(uv_handle_t *handle) {
+	isc_nmsocket_t *sock = uv_handle_get_data(handle);
+	uv_handle_set_data(handle, NULL);
+
+	REQUIRE(VALID_NMSOCK(sock));
+	REQUIRE(sock->tid == isc_tid());
+	REQUIRE(sock->closing);
+	REQUIRE(!sock->closed);
+
+	sock->closed = true;
+
+	isc__nm_incstats(sock, STATID_CLOSE);
+
+	/* uv_poll doesn't own the descriptor */
+	xdp_destroy(&sock->xdp.umem);
+	sock->fd = -1;
+
+	isc__nmsocket_detach(&sock);
+}
+
+void
+isc__nm_xdp_close(isc_nmsocket_t *sock) {
+	REQUIRE(VALID_NMSOCK(sock));
+	REQUIRE(sock->type == isc_nm_xdpsocket);
+	REQUIRE(sock->tid == isc_tid());
+	REQUIRE(!sock->closing);
+
+	sock->closing = true;
+
+	isc__nmsocket_clearcb(sock);
+	(void)uv_poll_stop(&sock->uv_handle.poll);
+	uv_close(&sock->uv_handle.handle, xdp_close_cb);
+}
+
+void
+isc__nm_xdp_shutdown(isc_nmsocket_t *sock) {
+	REQUIRE(VALID_NMSOCK(sock));
+	REQUIRE(sock->tid == isc_tid());
+	REQUIRE(sock->type == isc_nm_xdpsocket);
+	REQUIRE(sock->parent != NULL);
+
+	if (!sock->active) {
+		return;
+	}
+	sock->active = false;
+
+	/* Destroy the listening socket if on the same loop */
+	if (sock->tid == sock->parent->tid) {
+		isc__nmsocket_prep_destroy(sock->parent);
+	}
+}
+
+static isc_result_t
+xdp_send_direct(isc_nmsocket_t *sock, isc_nmhandle_t *handle,
+		const isc_region_t *region) {
+	isc__nm_xdp_t *xdp = sock->xdp.umem;
+	struct xdp_desc *desc = NULL;
+	uint64_t addr;
+	uint32_t idx;
+
+	if (region->length > xdp->maxpayload) {
+		return ISC_R_MAXSIZE;
+	}
+
+	xdp_complete(xdp);
+	if (xdp->nframes == 0) {
+		xdp_kick(xdp);
+		xdp_complete(xdp);
+		if (xdp->nframes == 0) {
+			return ISC_R_NORESOURCES;
+		}
+	}
+
+	if (ring_prod_reserve(&xdp->tx, 1, &idx) != 1) {
+		xdp_kick(xdp);
+		return ISC_R_NORESOURCES;
+	}
+
+	addr = xdp->frames[--xdp->nframes];
+
+	desc = ring_desc(&xdp->tx, idx);
+	desc->addr = addr;
+	desc->len = xdp_build(xdp->area + addr, handle, region);
+	desc->options = 0;
+
+	ring_prod_submit(&xdp->tx);
+
+	if (ring_needs_wakeup(&xdp->tx)) {
+		xdp_kick(xdp);
+	}
+
+	return ISC_R_SUCCESS;
+}
+
+void
+isc__nm_xdp_send(isc_nmhandle_t *handle, const isc_region_t *region,
+		 isc_nm_cb_t cb, void *cbarg) {
+	isc_nmsocket_t *sock = handle->sock;
+	isc__nm_uvreq_t *uvreq = NULL;
+	isc_result_t result;
+
+	REQUIRE(VALID_NMSOCK(sock));
+	REQUIRE(sock->type == isc_nm_xdpsocket);
+	REQUIRE(sock->tid == isc_tid());
+
+	uvreq = isc__nm_uvreq_get(sock);
+	isc_nmhandle_attach(handle, &uvreq->handle);
+	uvreq->cb.send = cb;
+	uvreq->cbarg = cbarg;
+
+	if (isc__nm_closing(sock->worker)) {
+		result = ISC_R_SHUTTINGDOWN;
+	} else if (isc__nmsocket_closing(sock)) {
+		result = ISC_R_CANCELED;
+	} else {
+		result = xdp_send_direct(sock, handle, region);
+		if (result != ISC_R_SUCCESS) {
+			isc__nm_incstats(sock, STATID_SENDFAIL);
+		}
+	}
+
+	/* The data has been copied to the frame, so the send is done */
+	isc__nm_sendcb(sock, uvreq, result, true);
+}
+
+void
+isc__nm_xdp_cleanup_data(isc_nmsocket_t *sock) {
+	switch (sock->type) {
+	case isc_nm_xdplistener:
+		xdp_prog_detach(sock);
+		break;
+	case isc_nm_xdpsocket:
+		if (sock->xdp.umem != NULL) {
+			xdp_destroy(&sock->xdp.umem);
+			sock->fd = -1;
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+#else /* USE_XDP */
+
+isc_result_t
+isc_nm_listenxdp(isc_nm_t *mgr, uint32_t workers, const char *ifname,
+		 isc_sockaddr_t *iface, isc_nm_recv_cb_t cb, void *cbarg,
+		 isc_nmsocket_t **sockp) {
+	UNUSED(mgr);
+	UNUSED(workers);
+	UNUSED(ifname);
+	UNUSED(iface);
+	UNUSED(cb);
+	UNUSED(cbarg);
+	UNUSED(sockp);
+
+	return ISC_R_NOTIMPLEMENTED;
+}
+
+#endif /* USE_XDP */
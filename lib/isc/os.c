@@ -12,8 +12,19 @@
  */
 
 #include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
 
+#if defined(HAVE_SCHED_GETAFFINITY)
+#include <sched.h>
+#endif /* if defined(HAVE_SCHED_GETAFFINITY) */
+
+#if defined(__linux__)
+#include <dirent.h>
+#endif /* if defined(__linux__) */
+
 #include <isc/os.h>
 #include <isc/types.h>
 #include <isc/util.h>
@@ -25,6 +36,18 @@ static unsigned int isc__os_ncpus = 0;
 static unsigned long isc__os_cacheline = ISC_OS_CACHELINE_SIZE;
 static mode_t isc__os_umask = 0;
 
+/*
+ * The CPUs the process was started on and their NUMA nodes.  They are
+ * recorded at the start, because /sys might not be available after
+ * chroot().
+ */
+#if defined(HAVE_SCHED_GETAFFINITY) && defined(CPU_SETSIZE)
+#define HAVE_OS_CPUSET 1
+static cpu_set_t isc__os_cpuset;
+static bool isc__os_hascpuset = false;
+static int16_t isc__os_cpunode[CPU_SETSIZE];
+#endif /* if defined(HAVE_SCHED_GETAFFINITY) && defined(CPU_SETSIZE) */
+
 /*
  * The affinity support for non-Linux is in the review in the upstream
  * yet, but will be included in the upcoming version of libuv.
@@ -170,6 +193,97 @@ ncpus_initialize(void) {
 
 #endif /* UV_VERSION_HEX >= UV_VERSION(1, 38, 0) */
 
+#if HAVE_OS_CPUSET
+#if defined(__linux__)
+/*
+ * Read the list of the CPUs of the NUMA node 'node', in the "0-15,32-47"
+ * format of /sys/devices/system/node/node<N>/cpulist.
+ */
+static void
+cpunode_read(const char *name, int node) {
+	char path[64], buf[4096];
+	FILE *fp = NULL;
+
+	snprintf(path, sizeof(path), "/sys/devices/system/node/%s/cpulist",
+		 name);
+	fp = fopen(path, "r");
+	if (fp == NULL) {
+		return;
+	}
+	if (fgets(buf, sizeof(buf), fp) == NULL) {
+		buf[0] = '\0';
+	}
+	fclose(fp);
+
+	for (char *p = buf; *p != '\0' && *p != '\n';) {
+		char *end = NULL;
+		unsigned long first = strtoul(p, &end, 10), last = first;
+
+		if (end == p) {
+			break;
+		}
+		if (*end == '-') {
+			p = end + 1;
+			last = strtoul(p, &end, 10);
+			if (end == p) {
+				break;
+			}
+		}
+		last = ISC_MIN(last, CPU_SETSIZE - 1);
+		for (unsigned long cpu = first; cpu <= last; cpu++) {
+			isc__os_cpunode[cpu] = node;
+		}
+		p = (*end == ',') ? end + 1 : end;
+	}
+}
+#endif /* if defined(__linux__) */
+
+static void
+cpuset_initialize(void) {
+	for (size_t cpu = 0; cpu < ARRAY_SIZE(isc__os_cpunode); cpu++) {
+		isc__os_cpunode[cpu] = -1;
+	}
+
+	CPU_ZERO(&isc__os_cpuset);
+	if (sched_getaffinity(0, sizeof(isc__os_cpuset), &isc__os_cpuset) ==
+	    -1)
+	{
+		return;
+	}
+	isc__os_hascpuset = true;
+
+#if defined(__linux__)
+	DIR *dir = opendir("/sys/devices/system/node");
+	struct dirent *de = NULL;
+
+	if (dir == NULL) {
+		return;
+	}
+	while ((de = readdir(dir)) != NULL) {
+		unsigned int node;
+
+		if (sscanf(de->d_name, "node%u", &node) == 1 &&
+		    node <= INT16_MAX)
+		{
+			cpunode_read(de->d_name, node);
+		}
+	}
+	closedir(dir);
+#endif /* if defined(__linux__) */
+}
+
+static int
+cpulist_cmp(const void *a, const void *b) {
+	int cpua = *(const int *)a, cpub = *(const int *)b;
+	int nodea = isc__os_cpunode[cpua], nodeb = isc__os_cpunode[cpub];
+
+	if (nodea != nodeb) {
+		return (nodea < nodeb) ? -1 : 1;
+	}
+	return (cpua < cpub) ? -1 : (cpua > cpub);
+}
+#endif /* HAVE_OS_CPUSET */
+
 static void
 umask_initialize(void) {
 	isc__os_umask = umask(0);
@@ -191,10 +305,55 @@ isc_os_umask(void) {
 	return isc__os_umask;
 }
 
+unsigned int
+isc_os_cpulist(int *cpus, unsigned int size) {
+#if HAVE_OS_CPUSET
+	int all[CPU_SETSIZE];
+	unsigned int count = 0;
+
+	REQUIRE(cpus != NULL || size == 0);
+
+	if (!isc__os_hascpuset) {
+		return 0;
+	}
+
+	for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (CPU_ISSET(cpu, &isc__os_cpuset)) {
+			all[count++] = cpu;
+		}
+	}
+	qsort(all, count, sizeof(all[0]), cpulist_cmp);
+
+	count = ISC_MIN(count, size);
+	memmove(cpus, all, count * sizeof(cpus[0]));
+
+	return count;
+#else  /* HAVE_OS_CPUSET */
+	UNUSED(cpus);
+	UNUSED(size);
+	return 0;
+#endif /* HAVE_OS_CPUSET */
+}
+
+int
+isc_os_cpunode(int cpu) {
+#if HAVE_OS_CPUSET
+	if (cpu >= 0 && cpu < CPU_SETSIZE) {
+		return isc__os_cpunode[cpu];
+	}
+#else  /* HAVE_OS_CPUSET */
+	UNUSED(cpu);
+#endif /* HAVE_OS_CPUSET */
+	return -1;
+}
+
 void
 isc__os_initialize(void) {
 	umask_initialize();
 	ncpus_initialize();
+#if HAVE_OS_CPUSET
+	cpuset_initialize();
+#endif /* HAVE_OS_CPUSET */
 #if defined(_SC_LEVEL1_DCACHE_LINESIZE)
 	long s = sysconf(_SC_LEVEL1_DCACHE_LINESIZE);
 	if (s > 0 && (unsigned long)s > isc__os_cacheline) {
@@ -1053,6 +1053,92 @@ isc_proxy2_tlv_data_verify(const isc_region_t *restrict tlv_data) {
 	return cbarg.verify_result;
 }
 
+/*
+ * Handle the common case of a PROXY command header carrying the TCP or
+ * UDP endpoints over IPv4 or IPv6 and no TLVs, as sent by the load
+ * balancers, without going through the generic state machine.  Return
+ * false if the header is anything else.
+ */
+static bool
+proxy2_handle_directly_fast(const isc_region_t *restrict header_data,
+			    const isc_proxy2_handler_cb_t cb, void *cbarg) {
+	const uint8_t *p = header_data->base;
+	isc_sockaddr_t src_addr, dst_addr;
+	isc_region_t extra;
+	uint16_t len, src_port, dst_port;
+	int socktype;
+
+	if (header_data->length < ISC_PROXY2_MIN_AF_INET_SIZE ||
+	    memcmp(p, ISC_PROXY2_HEADER_SIGNATURE,
+		   ISC_PROXY2_HEADER_SIGNATURE_SIZE) != 0)
+	{
+		return false;
+	}
+	p += ISC_PROXY2_HEADER_SIGNATURE_SIZE;
+
+	/* version 2, PROXY command */
+	if (p[0] != (0x20 | ISC_PROXY2_CMD_PROXY)) {
+		return false;
+	}
+
+	switch (p[1] & 0xFU) {
+	case ISC_PROXY2_SOCK_STREAM:
+		socktype = SOCK_STREAM;
+		break;
+	case ISC_PROXY2_SOCK_DGRAM:
+		socktype = SOCK_DGRAM;
+		break;
+	default:
+		return false;
+	}
+
+	len = ISC_U8TO16_BE(p + 2);
+	switch ((p[1] & 0xF0U) >> 4) {
+	case ISC_PROXY2_AF_INET:
+		if (len + ISC_PROXY2_HEADER_SIZE !=
+		    ISC_PROXY2_MIN_AF_INET_SIZE)
+		{
+			return false;
+		}
+		p += 4;
+		src_port = ISC_U8TO16_BE(p + 8);
+		dst_port = ISC_U8TO16_BE(p + 10);
+		isc_sockaddr_fromin(&src_addr, (const struct in_addr *)p,
+				    src_port);
+		isc_sockaddr_fromin(&dst_addr, (const struct in_addr *)(p + 4),
+				    dst_port);
+		break;
+	case ISC_PROXY2_AF_INET6:
+		if (len + ISC_PROXY2_HEADER_SIZE !=
+			    ISC_PROXY2_MIN_AF_INET6_SIZE ||
+		    header_data->length < ISC_PROXY2_MIN_AF_INET6_SIZE)
+		{
+			return false;
+		}
+		p += 4;
+		src_port = ISC_U8TO16_BE(p + 32);
+		dst_port = ISC_U8TO16_BE(p + 34);
+		isc_sockaddr_fromin6(&src_addr, (const struct in6_addr *)p,
+				     src_port);
+		isc_sockaddr_fromin6(&dst_addr,
+				     (const struct in6_addr *)(p + 16),
+				     dst_port);
+		break;
+	default:
+		return false;
+	}
+
+	extra = (isc_region_t){
+		.base = header_data->base + ISC_PROXY2_HEADER_SIZE + len,
+		.length = header_data->length - ISC_PROXY2_HEADER_SIZE - len,
+	};
+
+	cb(ISC_R_SUCCESS, ISC_PROXY2_CMD_PROXY, socktype, &src_addr, &dst_addr,
+	   NULL, extra.length == 0 ? NULL : &extra, cbarg);
+
+	return true;
+}
+
 isc_result_t
 isc_proxy2_header_handle_directly(const isc_region_t *restrict header_data,
 				  const isc_proxy2_handler_cb_t cb,
@@ -1063,6 +1149,10 @@ isc_proxy2_header_handle_directly(const isc_region_t *restrict header_data,
 	REQUIRE(header_data != NULL);
 	REQUIRE(cb != NULL);
 
+	if (proxy2_handle_directly_fast(header_data, cb, cbarg)) {
+		return ISC_R_SUCCESS;
+	}
+
 	isc__proxy2_handler_init_direct(&handler, 0, header_data, cb, cbarg);
 
 	result = isc__proxy2_handler_process_data(&handler);
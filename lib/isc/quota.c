@@ -16,7 +16,9 @@
 #include <stddef.h>
 
 #include <isc/atomic.h>
+#include <isc/mem.h>
 #include <isc/quota.h>
+#include <isc/tid.h>
 #include <isc/urcu.h>
 #include <isc/util.h>
 
@@ -30,19 +32,164 @@ isc_quota_init(isc_quota_t *quota, unsigned int max) {
 	atomic_init(&quota->soft, 0);
 	cds_wfcq_init(&quota->jobs.head, &quota->jobs.tail);
 	ISC_LINK_INIT(quota, link);
+	quota->mctx = NULL;
+	quota->nshards = 0;
+	quota->shards = NULL;
+	atomic_init(&quota->nsoftfull, 0);
 	quota->magic = QUOTA_MAGIC;
 }
 
+/*
+ * Split 'value' evenly between the shards, the first ones taking the
+ * remainder.
+ */
+static unsigned int
+share(isc_quota_t *quota, unsigned int value, unsigned int i) {
+	return value / quota->nshards + (i < value % quota->nshards ? 1 : 0);
+}
+
+static void
+setshards(isc_quota_t *quota, unsigned int max) {
+	for (unsigned int i = 0; i < quota->nshards; i++) {
+		atomic_store_relaxed(&quota->shards[i].max,
+				     share(quota, max, i));
+	}
+}
+
+/*
+ * Keep 'softfull' and 'nsoftfull' up to date after the usage of a shard
+ * changed.  A shard with no share of the soft quota is always full.
+ *
+ * Another thread may change 'used' between our read of it and the
+ * transition of 'softfull', and find 'softfull' already matching its own
+ * value of 'used'.  So 'used' is read again after every transition, until
+ * 'softfull' matches it: the last thread to flip it leaves it right.
+ */
+static void
+shard_checksoft(isc_quota_t *quota, isc__quotashard_t *shard) {
+	for (;;) {
+		uint_fast32_t used = atomic_load(&shard->used);
+		uint_fast32_t soft = atomic_load_relaxed(&shard->soft);
+		uint_fast32_t full = (used >= soft) ? 1 : 0;
+		uint_fast32_t old = 1 - full;
+
+		if (!atomic_compare_exchange_strong(&shard->softfull, &old,
+						    full))
+		{
+			return;
+		}
+
+		if (full) {
+			atomic_fetch_add_relaxed(&quota->nsoftfull, 1);
+		} else {
+			atomic_fetch_sub_relaxed(&quota->nsoftfull, 1);
+		}
+	}
+}
+
+void
+isc_quota_initperloop(isc_quota_t *quota, isc_mem_t *mctx, unsigned int max) {
+	unsigned int nshards = isc_tid_count();
+
+	isc_quota_init(quota, max);
+
+	if (nshards <= 1) {
+		return;
+	}
+
+	isc_mem_attach(mctx, &quota->mctx);
+	quota->nshards = nshards;
+	quota->shards = isc_mem_cget(mctx, nshards, sizeof(quota->shards[0]));
+	for (unsigned int i = 0; i < nshards; i++) {
+		atomic_init(&quota->shards[i].max, 0);
+		atomic_init(&quota->shards[i].soft, 0);
+		atomic_init(&quota->shards[i].used, 0);
+		atomic_init(&quota->shards[i].softfull, 0);
+	}
+	setshards(quota, max);
+}
+
+/*
+ * The shard of the calling loop; the threads that don't run a loop
+ * start from the first one.
+ */
+static unsigned int
+ownshard(isc_quota_t *quota) {
+	uint32_t tid = isc_tid();
+
+	return tid < quota->nshards ? tid : 0;
+}
+
+/*
+ * Take one unit from the shard of the calling loop, or from the first
+ * other shard with some left.
+ */
+static bool
+shards_acquire(isc_quota_t *quota, bool unlimited) {
+	unsigned int own = ownshard(quota);
+
+	for (unsigned int i = 0; i < quota->nshards; i++) {
+		isc__quotashard_t *shard =
+			&quota->shards[(own + i) % quota->nshards];
+		uint_fast32_t used = atomic_load_relaxed(&shard->used);
+
+		while (unlimited || used < atomic_load_relaxed(&shard->max)) {
+			if (atomic_compare_exchange_weak(&shard->used, &used,
+							 used + 1))
+			{
+				shard_checksoft(quota, shard);
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+/*
+ * Give one unit back to the shard of the calling loop, or to the first
+ * other shard that has some in use.
+ */
+static void
+shards_release(isc_quota_t *quota) {
+	unsigned int own = ownshard(quota);
+
+	for (unsigned int i = 0; i < quota->nshards; i++) {
+		isc__quotashard_t *shard =
+			&quota->shards[(own + i) % quota->nshards];
+		uint_fast32_t used = atomic_load_relaxed(&shard->used);
+
+		while (used > 0) {
+			if (atomic_compare_exchange_weak(&shard->used, &used,
+							 used - 1))
+			{
+				shard_checksoft(quota, shard);
+				return;
+			}
+		}
+	}
+
+	UNREACHABLE();
+}
+
 void
 isc_quota_soft(isc_quota_t *quota, unsigned int soft) {
 	REQUIRE(VALID_QUOTA(quota));
 	atomic_store_relaxed(&quota->soft, soft);
+
+	for (unsigned int i = 0; i < quota->nshards; i++) {
+		isc__quotashard_t *shard = &quota->shards[i];
+
+		atomic_store_relaxed(&shard->soft, share(quota, soft, i));
+		shard_checksoft(quota, shard);
+	}
 }
 
 void
 isc_quota_max(isc_quota_t *quota, unsigned int max) {
 	REQUIRE(VALID_QUOTA(quota));
 	atomic_store_relaxed(&quota->max, max);
+	setshards(quota, max);
 }
 
 unsigned int
@@ -57,10 +204,39 @@ isc_quota_getsoft(isc_quota_t *quota) {
 	return atomic_load_relaxed(&quota->soft);
 }
 
+static unsigned int
+getused(isc_quota_t *quota) {
+	if (quota->nshards > 0) {
+		unsigned int used = 0;
+		for (unsigned int i = 0; i < quota->nshards; i++) {
+			used += atomic_load_relaxed(&quota->shards[i].used);
+		}
+		return used;
+	}
+
+	return atomic_load_relaxed(&quota->used);
+}
+
 unsigned int
 isc_quota_getused(isc_quota_t *quota) {
 	REQUIRE(VALID_QUOTA(quota));
-	return atomic_load_relaxed(&quota->used);
+	return getused(quota);
+}
+
+unsigned int
+isc_quota_getloops(isc_quota_t *quota) {
+	REQUIRE(VALID_QUOTA(quota));
+	return quota->nshards;
+}
+
+void
+isc_quota_getloopusage(isc_quota_t *quota, unsigned int loop,
+		       unsigned int *usedp, unsigned int *maxp) {
+	REQUIRE(VALID_QUOTA(quota));
+	REQUIRE(loop < quota->nshards);
+
+	SET_IF_NOT_NULL(usedp, atomic_load_relaxed(&quota->shards[loop].used));
+	SET_IF_NOT_NULL(maxp, atomic_load_relaxed(&quota->shards[loop].max));
 }
 
 void
@@ -77,6 +253,10 @@ isc_quota_release(isc_quota_t *quota) {
 	struct cds_wfcq_node *node =
 		cds_wfcq_dequeue_blocking(&quota->jobs.head, &quota->jobs.tail);
 	if (node == NULL) {
+		if (quota->nshards > 0) {
+			shards_release(quota);
+			return;
+		}
 		uint_fast32_t used = atomic_fetch_sub_relaxed(&quota->used, 1);
 		INSIST(used > 0);
 		return;
@@ -92,10 +272,21 @@ isc_quota_acquire_cb(isc_quota_t *quota, isc_job_t *job, isc_job_cb cb,
 	REQUIRE(VALID_QUOTA(quota));
 	REQUIRE(job == NULL || cb != NULL);
 
-	uint_fast32_t used = atomic_fetch_add_relaxed(&quota->used, 1);
-	uint_fast32_t max = atomic_load_relaxed(&quota->max);
-	if (max != 0 && used >= max) {
-		(void)atomic_fetch_sub_relaxed(&quota->used, 1);
+	uint_fast32_t used, max = atomic_load_relaxed(&quota->max);
+	bool full;
+
+	if (quota->nshards > 0) {
+		full = !shards_acquire(quota, max == 0);
+		used = 0;
+	} else {
+		used = atomic_fetch_add_relaxed(&quota->used, 1);
+		full = (max != 0 && used >= max);
+		if (full) {
+			(void)atomic_fetch_sub_relaxed(&quota->used, 1);
+		}
+	}
+
+	if (full) {
 		if (job != NULL) {
 			job->cb = cb;
 			job->cbarg = cbarg;
@@ -112,6 +303,17 @@ isc_quota_acquire_cb(isc_quota_t *quota, isc_job_t *job, isc_job_cb cb,
 	}
 
 	uint_fast32_t soft = atomic_load_relaxed(&quota->soft);
+	if (soft != 0 && quota->nshards > 0) {
+		/*
+		 * The total can only have reached the soft quota if one
+		 * of the shards has reached its share of it.
+		 */
+		if (atomic_load_relaxed(&quota->nsoftfull) == 0) {
+			return ISC_R_SUCCESS;
+		}
+		/* the unit just taken is counted */
+		used = getused(quota) - 1;
+	}
 	if (soft != 0 && used >= soft) {
 		return ISC_R_SOFTQUOTA;
 	}
@@ -124,8 +326,14 @@ isc_quota_destroy(isc_quota_t *quota) {
 	REQUIRE(VALID_QUOTA(quota));
 	quota->magic = 0;
 
-	INSIST(atomic_load(&quota->used) == 0);
+	INSIST(getused(quota) == 0);
 	INSIST(cds_wfcq_empty(&quota->jobs.head, &quota->jobs.tail));
 
 	cds_wfcq_destroy(&quota->jobs.head, &quota->jobs.tail);
+
+	if (quota->shards != NULL) {
+		isc_mem_cput(quota->mctx, quota->shards, quota->nshards,
+			     sizeof(quota->shards[0]));
+		isc_mem_detach(&quota->mctx);
+	}
 }
@@ -217,10 +217,9 @@ isc_result_t
 isc_radix_search(isc_radix_tree_t *radix, isc_radix_node_t **target,
 		 isc_prefix_t *prefix) {
 	isc_radix_node_t *node;
-	isc_radix_node_t *stack[RADIX_MAXBITS + 1];
 	u_char *addr;
 	uint32_t bitlen;
-	int tfam = -1, cnt = 0;
+	int fam;
 
 	REQUIRE(radix != NULL);
 	REQUIRE(prefix != NULL);
@@ -237,10 +236,33 @@ isc_radix_search(isc_radix_tree_t *radix, isc_radix_node_t **target,
 
 	addr = isc_prefix_touchar(prefix);
 	bitlen = prefix->bitlen;
+	fam = ISC_RADIX_FAMILY(prefix);
 
-	while (node != NULL && node->bit < bitlen) {
-		if (node->prefix) {
-			stack[cnt++] = node;
+	/*
+	 * Every node below a node shares the first node->bit bits of its
+	 * prefix, so the matching prefixes are all on the path from the
+	 * head, and the walk can stop at the first one that doesn't match.
+	 * The path is walked once, keeping the node that was added first.
+	 */
+	while (node != NULL && node->bit <= bitlen) {
+		if (node->prefix != NULL) {
+			if (!_comp_with_mask(isc_prefix_tochar(node->prefix),
+					     isc_prefix_tochar(prefix),
+					     node->prefix->bitlen))
+			{
+				break;
+			}
+
+			if (node->node_num[fam] != -1 &&
+			    ((*target == NULL) ||
+			     (*target)->node_num[fam] > node->node_num[fam]))
+			{
+				*target = node;
+			}
+		}
+
+		if (node->bit == bitlen) {
+			break;
 		}
 
 		if (BIT_TEST(addr[node->bit >> 3], 0x80 >> (node->bit & 0x07)))
@@ -251,32 +273,6 @@ isc_radix_search(isc_radix_tree_t *radix, isc_radix_node_t **target,
 		}
 	}
 
-	if (node != NULL && node->prefix) {
-		stack[cnt++] = node;
-	}
-
-	while (cnt-- > 0) {
-		node = stack[cnt];
-
-		if (prefix->bitlen < node->bit) {
-			continue;
-		}
-
-		if (_comp_with_mask(isc_prefix_tochar(node->prefix),
-				    isc_prefix_tochar(prefix),
-				    node->prefix->bitlen))
-		{
-			int fam = ISC_RADIX_FAMILY(prefix);
-			if (node->node_num[fam] != -1 &&
-			    ((*target == NULL) ||
-			     (*target)->node_num[tfam] > node->node_num[fam]))
-			{
-				*target = node;
-				tfam = fam;
-			}
-		}
-	}
-
 	if (*target == NULL) {
 		return ISC_R_NOTFOUND;
 	} else {
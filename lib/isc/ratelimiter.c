@@ -35,6 +35,13 @@ typedef enum {
 #define RATELIMITER_MAGIC     ISC_MAGIC('R', 't', 'L', 'm')
 #define VALID_RATELIMITER(rl) ISC_MAGIC_VALID(rl, RATELIMITER_MAGIC)
 
+/*
+ * Number of buckets the queued events are hashed into by group.
+ */
+#define RATELIMITER_GROUPS 256
+
+typedef ISC_LIST(isc_rlevent_t) isc_rleventlist_t;
+
 struct isc_ratelimiter {
 	int magic;
 	isc_mem_t *mctx;
@@ -45,8 +52,10 @@ struct isc_ratelimiter {
 	isc_interval_t interval;
 	uint32_t pertic;
 	bool pushpop;
+	uint32_t burst;
 	isc_ratelimiter_state_t state;
-	ISC_LIST(isc_rlevent_t) pending;
+	isc_rleventlist_t pending;
+	isc_rleventlist_t *groups; /* allocated when burst > 1 */
 };
 
 static void
@@ -120,6 +129,35 @@ isc_ratelimiter_setpushpop(isc_ratelimiter_t *restrict rl, const bool pushpop) {
 	UNLOCK(&rl->lock);
 }
 
+void
+isc_ratelimiter_setburst(isc_ratelimiter_t *restrict rl, const uint32_t burst) {
+	REQUIRE(VALID_RATELIMITER(rl));
+
+	LOCK(&rl->lock);
+	if (burst > 1 && rl->groups == NULL) {
+		rl->groups = isc_mem_cget(rl->mctx, RATELIMITER_GROUPS,
+					  sizeof(rl->groups[0]));
+		for (size_t i = 0; i < RATELIMITER_GROUPS; i++) {
+			ISC_LIST_INIT(rl->groups[i]);
+		}
+	}
+	rl->burst = burst;
+	UNLOCK(&rl->lock);
+}
+
+/*
+ * Remove a queued event from the pending list, and from its group
+ * bucket.  Must be called with the lock held.
+ */
+static void
+ratelimiter_unlink(isc_ratelimiter_t *rl, isc_rlevent_t *rle) {
+	ISC_LIST_UNLINK(rl->pending, rle, link);
+	if (ISC_LINK_LINKED(rle, glink)) {
+		ISC_LIST_UNLINK(rl->groups[rle->group % RATELIMITER_GROUPS],
+				rle, glink);
+	}
+}
+
 static void
 isc__ratelimiter_start(void *arg) {
 	isc_ratelimiter_t *rl = arg;
@@ -155,6 +193,13 @@ isc_result_t
 isc_ratelimiter_enqueue(isc_ratelimiter_t *restrict rl,
 			isc_loop_t *restrict loop, isc_job_cb cb, void *arg,
 			isc_rlevent_t **rlep) {
+	return isc_ratelimiter_enqueuegroup(rl, loop, 0, cb, arg, rlep);
+}
+
+isc_result_t
+isc_ratelimiter_enqueuegroup(isc_ratelimiter_t *restrict rl,
+			     isc_loop_t *restrict loop, uint32_t group,
+			     isc_job_cb cb, void *arg, isc_rlevent_t **rlep) {
 	isc_result_t result = ISC_R_SUCCESS;
 	isc_rlevent_t *rle = NULL;
 
@@ -178,7 +223,9 @@ isc_ratelimiter_enqueue(isc_ratelimiter_t *restrict rl,
 		*rle = (isc_rlevent_t){
 			.cb = cb,
 			.arg = arg,
+			.group = group,
 			.link = ISC_LINK_INITIALIZER,
+			.glink = ISC_LINK_INITIALIZER,
 		};
 		isc_loop_attach(loop, &rle->loop);
 		isc_ratelimiter_attach(rl, &rle->rl);
@@ -188,6 +235,10 @@ isc_ratelimiter_enqueue(isc_ratelimiter_t *restrict rl,
 		} else {
 			ISC_LIST_APPEND(rl->pending, rle, link);
 		}
+		if (group != 0 && rl->groups != NULL) {
+			ISC_LIST_APPEND(rl->groups[group % RATELIMITER_GROUPS],
+					rle, glink);
+		}
 		*rlep = rle;
 		break;
 	default:
@@ -206,7 +257,7 @@ isc_ratelimiter_dequeue(isc_ratelimiter_t *restrict rl, isc_rlevent_t **rlep) {
 
 	LOCK(&rl->lock);
 	if (ISC_LINK_LINKED(*rlep, link)) {
-		ISC_LIST_UNLINK(rl->pending, *rlep, link);
+		ratelimiter_unlink(rl, *rlep);
 		isc_rlevent_free(rlep);
 	} else {
 		result = ISC_R_NOTFOUND;
@@ -220,7 +271,7 @@ isc__ratelimiter_tick(void *arg) {
 	isc_ratelimiter_t *rl = (isc_ratelimiter_t *)arg;
 	isc_rlevent_t *rle = NULL;
 	uint32_t pertic;
-	ISC_LIST(isc_rlevent_t) pending;
+	isc_rleventlist_t pending;
 
 	REQUIRE(VALID_RATELIMITER(rl));
 
@@ -240,8 +291,32 @@ isc__ratelimiter_tick(void *arg) {
 		rle = ISC_LIST_HEAD(rl->pending);
 		if (rle != NULL) {
 			/* There is work to do.  Let's do it after unlocking. */
-			ISC_LIST_UNLINK(rl->pending, rle, link);
+			ratelimiter_unlink(rl, rle);
 			ISC_LIST_APPEND(pending, rle, link);
+
+			/*
+			 * The queued events of the same group are
+			 * dispatched along with it.
+			 */
+			if (rle->group != 0 && rl->groups != NULL) {
+				isc_rleventlist_t *bucket =
+					&rl->groups[rle->group %
+						    RATELIMITER_GROUPS];
+				isc_rlevent_t *ev = ISC_LIST_HEAD(*bucket);
+				uint32_t burst = rl->burst;
+
+				while (ev != NULL && burst > 1) {
+					isc_rlevent_t *next =
+						ISC_LIST_NEXT(ev, glink);
+					if (ev->group == rle->group) {
+						ratelimiter_unlink(rl, ev);
+						ISC_LIST_APPEND(pending, ev,
+								link);
+						burst--;
+					}
+					ev = next;
+				}
+			}
 		} else {
 			/*
 			 * We processed all the scheduled work, but there's a
@@ -289,7 +364,7 @@ isc__ratelimiter_doshutdown(void *arg) {
 void
 isc_ratelimiter_shutdown(isc_ratelimiter_t *restrict rl) {
 	isc_rlevent_t *rle = NULL;
-	ISC_LIST(isc_rlevent_t) pending;
+	isc_rleventlist_t pending;
 
 	REQUIRE(VALID_RATELIMITER(rl));
 
@@ -299,6 +374,11 @@ isc_ratelimiter_shutdown(isc_ratelimiter_t *restrict rl) {
 	if (rl->state != isc_ratelimiter_shuttingdown) {
 		rl->state = isc_ratelimiter_shuttingdown;
 		ISC_LIST_MOVE(pending, rl->pending);
+		if (rl->groups != NULL) {
+			for (size_t i = 0; i < RATELIMITER_GROUPS; i++) {
+				ISC_LIST_INIT(rl->groups[i]);
+			}
+		}
 		isc_ratelimiter_ref(rl);
 		isc_async_run(rl->loop, isc__ratelimiter_doshutdown, rl);
 	}
@@ -317,6 +397,10 @@ ratelimiter_destroy(isc_ratelimiter_t *restrict rl) {
 	REQUIRE(rl->state == isc_ratelimiter_shuttingdown);
 	UNLOCK(&rl->lock);
 
+	if (rl->groups != NULL) {
+		isc_mem_cput(rl->mctx, rl->groups, RATELIMITER_GROUPS,
+			     sizeof(rl->groups[0]));
+	}
 	isc_mutex_destroy(&rl->lock);
 	isc_mem_putanddetach(&rl->mctx, rl, sizeof(*rl));
 }
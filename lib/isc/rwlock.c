@@ -56,10 +56,12 @@
 
 #include <isc/atomic.h>
 #include <isc/hash.h>
+#include <isc/lockstat.h>
 #include <isc/pause.h>
 #include <isc/rwlock.h>
 #include <isc/thread.h>
 #include <isc/tid.h>
+#include <isc/time.h>
 #include <isc/util.h>
 
 #include "probes.h"
@@ -78,7 +80,7 @@ static atomic_uint_fast16_t isc__crwlock_workers = 128;
 #endif /* ifndef RWLOCK_MAX_READER_PATIENCE */
 
 static void
-read_indicator_wait_until_empty(isc_rwlock_t *rwl);
+read_indicator_wait_until_empty(isc_rwlock_t *rwl, isc_nanosecs_t *startp);
 
 #include <stdio.h>
 
@@ -134,10 +136,31 @@ writers_lock_release(isc_rwlock_t *rwl) {
 
 #define ran_out_of_patience(cnt) (cnt >= RWLOCK_MAX_READER_PATIENCE)
 
+/*
+ * The time the lock has been waited for is only taken when the lock
+ * can't be acquired at once and the contention statistics are enabled.
+ */
+static void
+wait_start(isc_nanosecs_t *startp) {
+	if (*startp == 0 && isc_lockstat_enabled()) {
+		*startp = isc_time_monotonic();
+	}
+}
+
+static void
+wait_end(isc_nanosecs_t start, const char *file, unsigned int line,
+	 isc_lockstattype_t type) {
+	if (start != 0) {
+		isc__lockstat_record(file, line, type,
+				     isc_time_monotonic() - start);
+	}
+}
+
 void
-isc_rwlock_rdlock(isc_rwlock_t *rwl) {
+isc__rwlock_rdlock(isc_rwlock_t *rwl, const char *file, unsigned int line) {
 	uint32_t cnt = 0;
 	bool barrier_raised = false;
+	isc_nanosecs_t start = 0;
 
 	LIBISC_RWLOCK_RDLOCK_REQ(rwl);
 
@@ -150,6 +173,7 @@ isc_rwlock_rdlock(isc_rwlock_t *rwl) {
 
 		/* Writer has acquired the lock, must reset to 0 and wait */
 		read_indicator_depart(rwl);
+		wait_start(&start);
 
 		while (writers_lock_islocked(rwl)) {
 			isc_pause();
@@ -162,6 +186,7 @@ isc_rwlock_rdlock(isc_rwlock_t *rwl) {
 	if (barrier_raised) {
 		writers_barrier_lower(rwl);
 	}
+	wait_end(start, file, line, isc_lockstattype_read);
 
 	LIBISC_RWLOCK_RDLOCK_ACQ(rwl);
 }
@@ -219,31 +244,37 @@ isc_rwlock_tryupgrade(isc_rwlock_t *rwl) {
 }
 
 static void
-read_indicator_wait_until_empty(isc_rwlock_t *rwl) {
+read_indicator_wait_until_empty(isc_rwlock_t *rwl, isc_nanosecs_t *startp) {
 	/* Write-lock was acquired, now wait for running Readers to finish */
 	while (true) {
 		if (read_indicator_isempty(rwl)) {
 			break;
 		}
+		wait_start(startp);
 		isc_pause();
 	}
 }
 
 void
-isc_rwlock_wrlock(isc_rwlock_t *rwl) {
+isc__rwlock_wrlock(isc_rwlock_t *rwl, const char *file, unsigned int line) {
+	isc_nanosecs_t start = 0;
+
 	LIBISC_RWLOCK_WRLOCK_REQ(rwl);
 
 	/* Write Barriers has been raised, wait */
 	while (writers_barrier_israised(rwl)) {
+		wait_start(&start);
 		isc_pause();
 	}
 
 	/* Try to acquire the write-lock */
 	while (!writers_lock_acquire(rwl)) {
+		wait_start(&start);
 		isc_pause();
 	}
 
-	read_indicator_wait_until_empty(rwl);
+	read_indicator_wait_until_empty(rwl, &start);
+	wait_end(start, file, line, isc_lockstattype_write);
 
 	LIBISC_RWLOCK_WRLOCK_ACQ(rwl);
 }
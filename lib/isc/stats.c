@@ -20,8 +20,10 @@
 #include <isc/buffer.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
+#include <isc/os.h>
 #include <isc/refcount.h>
 #include <isc/stats.h>
+#include <isc/tid.h>
 #include <isc/util.h>
 
 #define ISC_STATS_MAGIC	   ISC_MAGIC('S', 't', 'a', 't')
@@ -37,14 +39,81 @@
 STATIC_ASSERT(sizeof(isc_statscounter_t) <= sizeof(uint64_t),
 	      "Exported statistics must fit into the statistic counter size");
 
+/*
+ * A statistics set is made of 'nshards' blocks of 'stride' counters.
+ * Ordinary sets have a single shard.  Per-loop sets have one shard for
+ * each loop, padded to a cache line, so that loops never write to the
+ * same cache line, plus shard 0 for threads that aren't loops; the
+ * value of a counter is the sum over all shards.  The memory allocator
+ * doesn't align to cache lines, so the counters are allocated with one
+ * more cache line and start at the first cache line boundary in it.
+ */
 struct isc_stats {
 	unsigned int magic;
 	isc_mem_t *mctx;
 	isc_refcount_t references;
 	int ncounters;
+	size_t stride;
+	size_t nshards;
+	void *base;
 	isc_atomic_statscounter_t *counters;
 };
 
+#define STATS_PERLINE \
+	(ISC_OS_CACHELINE_SIZE / sizeof(isc_atomic_statscounter_t))
+
+/*
+ * Add 'value' to 'counter' and return its previous value in the shard
+ * that was updated.  The shard of a loop is only ever written by that
+ * loop, so it is updated with a plain load and store rather than an
+ * atomic read-modify-write; readers may see the new value a little late.
+ */
+static isc_statscounter_t
+addcounter(isc_stats_t *stats, isc_statscounter_t counter,
+	   isc_statscounter_t value) {
+	if (stats->nshards > 1) {
+		uint32_t tid = isc_tid();
+		if (tid < stats->nshards - 1) {
+			isc_atomic_statscounter_t *shard =
+				&stats->counters[(tid + 1) * stats->stride +
+						 counter];
+			isc_statscounter_t prev = atomic_load_relaxed(shard);
+			atomic_store_relaxed(shard, prev + value);
+			return prev;
+		}
+	}
+
+	return atomic_fetch_add_relaxed(&stats->counters[counter], value);
+}
+
+static isc_statscounter_t
+sumcounter(isc_stats_t *stats, isc_statscounter_t counter) {
+	isc_statscounter_t value = 0;
+
+	for (size_t i = 0; i < stats->nshards; i++) {
+		value += atomic_load_acquire(
+			&stats->counters[i * stats->stride + counter]);
+	}
+
+	return value;
+}
+
+#define COUNTERS_SIZE(n) \
+	((n) * sizeof(isc_atomic_statscounter_t) + ISC_OS_CACHELINE_SIZE)
+
+static isc_atomic_statscounter_t *
+newcounters(isc_mem_t *mctx, size_t n, void **basep) {
+	isc_atomic_statscounter_t *counters = NULL;
+
+	*basep = isc_mem_get(mctx, COUNTERS_SIZE(n));
+	counters = (isc_atomic_statscounter_t *)ISC_ALIGN(
+		(uintptr_t)*basep, ISC_OS_CACHELINE_SIZE);
+	for (size_t i = 0; i < n; i++) {
+		atomic_init(&counters[i], 0);
+	}
+	return counters;
+}
+
 void
 isc_stats_attach(isc_stats_t *stats, isc_stats_t **statsp) {
 	REQUIRE(ISC_STATS_VALID(stats));
@@ -65,8 +134,8 @@ isc_stats_detach(isc_stats_t **statsp) {
 
 	if (isc_refcount_decrement(&stats->references) == 1) {
 		isc_refcount_destroy(&stats->references);
-		isc_mem_cput(stats->mctx, stats->counters, stats->ncounters,
-			     sizeof(isc_atomic_statscounter_t));
+		isc_mem_put(stats->mctx, stats->base,
+			    COUNTERS_SIZE(stats->nshards * stats->stride));
 		isc_mem_putanddetach(&stats->mctx, stats, sizeof(*stats));
 	}
 }
@@ -78,31 +147,51 @@ isc_stats_ncounters(isc_stats_t *stats) {
 	return stats->ncounters;
 }
 
-void
-isc_stats_create(isc_mem_t *mctx, isc_stats_t **statsp, int ncounters) {
+static void
+stats_create(isc_mem_t *mctx, isc_stats_t **statsp, int ncounters,
+	     size_t stride, size_t nshards) {
 	REQUIRE(statsp != NULL && *statsp == NULL);
 
 	isc_stats_t *stats = isc_mem_get(mctx, sizeof(*stats));
-	size_t counters_alloc_size = sizeof(isc_atomic_statscounter_t) *
-				     ncounters;
-	stats->counters = isc_mem_get(mctx, counters_alloc_size);
+	*stats = (isc_stats_t){
+		.ncounters = ncounters,
+		.stride = stride,
+		.nshards = nshards,
+	};
+	stats->counters = newcounters(mctx, nshards * stride, &stats->base);
 	isc_refcount_init(&stats->references, 1);
-	for (int i = 0; i < ncounters; i++) {
-		atomic_init(&stats->counters[i], 0);
-	}
-	stats->mctx = NULL;
 	isc_mem_attach(mctx, &stats->mctx);
-	stats->ncounters = ncounters;
 	stats->magic = ISC_STATS_MAGIC;
 	*statsp = stats;
 }
 
+void
+isc_stats_create(isc_mem_t *mctx, isc_stats_t **statsp, int ncounters) {
+	stats_create(mctx, statsp, ncounters, ncounters, 1);
+}
+
+void
+isc_stats_createperloop(isc_mem_t *mctx, isc_stats_t **statsp,
+			int ncounters) {
+	stats_create(mctx, statsp, ncounters,
+		     ISC_ALIGN((size_t)ncounters, STATS_PERLINE),
+		     isc_tid_count() + 1);
+}
+
 isc_statscounter_t
 isc_stats_increment(isc_stats_t *stats, isc_statscounter_t counter) {
 	REQUIRE(ISC_STATS_VALID(stats));
 	REQUIRE(counter < stats->ncounters);
 
-	return atomic_fetch_add_relaxed(&stats->counters[counter], 1);
+	return addcounter(stats, counter, 1);
+}
+
+void
+isc_stats_add(isc_stats_t *stats, isc_statscounter_t counter, uint64_t value) {
+	REQUIRE(ISC_STATS_VALID(stats));
+	REQUIRE(counter < stats->ncounters);
+
+	addcounter(stats, counter, value);
 }
 
 void
@@ -110,9 +199,11 @@ isc_stats_decrement(isc_stats_t *stats, isc_statscounter_t counter) {
 	REQUIRE(ISC_STATS_VALID(stats));
 	REQUIRE(counter < stats->ncounters);
 #if ISC_STATS_CHECKUNDERFLOW
-	REQUIRE(atomic_fetch_sub_release(&stats->counters[counter], 1) > 0);
+	/* A single shard of a per-loop set can legitimately go below 0 */
+	isc_statscounter_t prev = addcounter(stats, counter, -1);
+	REQUIRE(stats->nshards > 1 || prev > 0);
 #else
-	atomic_fetch_sub_release(&stats->counters[counter], 1);
+	addcounter(stats, counter, -1);
 #endif
 }
 
@@ -124,8 +215,7 @@ isc_stats_dump(isc_stats_t *stats, isc_stats_dumper_t dump_fn, void *arg,
 	REQUIRE(ISC_STATS_VALID(stats));
 
 	for (i = 0; i < stats->ncounters; i++) {
-		isc_statscounter_t counter =
-			atomic_load_acquire(&stats->counters[i]);
+		isc_statscounter_t counter = sumcounter(stats, i);
 		if ((options & ISC_STATSDUMP_VERBOSE) == 0 && counter == 0) {
 			continue;
 		}
@@ -138,7 +228,19 @@ isc_stats_set(isc_stats_t *stats, uint64_t val, isc_statscounter_t counter) {
 	REQUIRE(ISC_STATS_VALID(stats));
 	REQUIRE(counter < stats->ncounters);
 
-	atomic_store_release(&stats->counters[counter], val);
+	if (stats->nshards == 1) {
+		atomic_store_release(&stats->counters[counter], val);
+		return;
+	}
+
+	/*
+	 * The shard of a loop must only be written by that loop, or the
+	 * store would race with its increments: adjust shard 0 instead,
+	 * so that the sum of the shards becomes 'val'.
+	 */
+	atomic_fetch_add_release(&stats->counters[counter],
+				 (isc_statscounter_t)val -
+					 sumcounter(stats, counter));
 }
 
 void
@@ -147,6 +249,10 @@ isc_stats_update_if_greater(isc_stats_t *stats, isc_statscounter_t counter,
 	REQUIRE(ISC_STATS_VALID(stats));
 	REQUIRE(counter < stats->ncounters);
 
+	/*
+	 * In a per-loop set the counter is only kept in shard 0, which
+	 * holds its whole value as the other shards are never updated.
+	 */
 	isc_statscounter_t curr_value =
 		atomic_load_acquire(&stats->counters[counter]);
 	do {
@@ -162,14 +268,15 @@ isc_stats_get_counter(isc_stats_t *stats, isc_statscounter_t counter) {
 	REQUIRE(ISC_STATS_VALID(stats));
 	REQUIRE(counter < stats->ncounters);
 
-	return atomic_load_acquire(&stats->counters[counter]);
+	return sumcounter(stats, counter);
 }
 
 void
 isc_stats_resize(isc_stats_t **statsp, int ncounters) {
 	isc_stats_t *stats;
-	size_t counters_alloc_size;
-	isc_atomic_statscounter_t *newcounters;
+	size_t stride;
+	isc_atomic_statscounter_t *counters;
+	void *base = NULL;
 
 	REQUIRE(statsp != NULL && *statsp != NULL);
 	REQUIRE(ISC_STATS_VALID(*statsp));
@@ -182,17 +289,22 @@ isc_stats_resize(isc_stats_t **statsp, int ncounters) {
 	}
 
 	/* Grow number of counters. */
-	counters_alloc_size = sizeof(isc_atomic_statscounter_t) * ncounters;
-	newcounters = isc_mem_get(stats->mctx, counters_alloc_size);
-	for (int i = 0; i < ncounters; i++) {
-		atomic_init(&newcounters[i], 0);
-	}
-	for (int i = 0; i < stats->ncounters; i++) {
-		uint32_t counter = atomic_load_acquire(&stats->counters[i]);
-		atomic_store_release(&newcounters[i], counter);
+	stride = (stats->nshards > 1)
+			 ? ISC_ALIGN((size_t)ncounters, STATS_PERLINE)
+			 : (size_t)ncounters;
+	counters = newcounters(stats->mctx, stats->nshards * stride, &base);
+	for (size_t s = 0; s < stats->nshards; s++) {
+		for (int i = 0; i < stats->ncounters; i++) {
+			isc_statscounter_t counter = atomic_load_acquire(
+				&stats->counters[s * stats->stride + i]);
+			atomic_store_release(&counters[s * stride + i],
+					     counter);
+		}
 	}
-	isc_mem_cput(stats->mctx, stats->counters, stats->ncounters,
-		     sizeof(isc_atomic_statscounter_t));
-	stats->counters = newcounters;
+	isc_mem_put(stats->mctx, stats->base,
+		    COUNTERS_SIZE(stats->nshards * stats->stride));
+	stats->base = base;
+	stats->counters = counters;
+	stats->stride = stride;
 	stats->ncounters = ncounters;
 }
@@ -13,9 +13,9 @@
 
 /*! \file */
 
-#if defined(HAVE_SCHED_H)
+#if defined(HAVE_SCHED_H) || defined(HAVE_PTHREAD_SETAFFINITY_NP)
 #include <sched.h>
-#endif /* if defined(HAVE_SCHED_H) */
+#endif /* if defined(HAVE_SCHED_H) || defined(HAVE_PTHREAD_SETAFFINITY_NP) */
 
 #if defined(HAVE_CPUSET_H)
 #include <sys/cpuset.h>
@@ -31,7 +31,9 @@
 #include <stdlib.h>
 
 #include <isc/atomic.h>
+#include <isc/errno.h>
 #include <isc/iterated_hash.h>
+#include <isc/os.h>
 #include <isc/strerr.h>
 #include <isc/thread.h>
 #include <isc/tid.h>
@@ -169,6 +171,41 @@ isc_thread_setname(isc_thread_t thread, const char *name) {
 #endif /* if defined(HAVE_PTHREAD_SETNAME_NP) && !defined(__APPLE__) */
 }
 
+isc_result_t
+isc_thread_setaffinity(int cpu) {
+#if defined(HAVE_PTHREAD_SETAFFINITY_NP) && defined(CPU_SETSIZE)
+	cpu_set_t set;
+	int ret;
+
+	REQUIRE(cpu >= -1 && cpu < CPU_SETSIZE);
+
+	CPU_ZERO(&set);
+	if (cpu >= 0) {
+		CPU_SET(cpu, &set);
+	} else {
+		int cpus[CPU_SETSIZE];
+		unsigned int count = isc_os_cpulist(cpus, ARRAY_SIZE(cpus));
+
+		if (count == 0) {
+			return ISC_R_NOTIMPLEMENTED;
+		}
+		for (unsigned int i = 0; i < count; i++) {
+			CPU_SET(cpus[i], &set);
+		}
+	}
+
+	ret = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+	if (ret != 0) {
+		return isc_errno_toresult(ret);
+	}
+
+	return ISC_R_SUCCESS;
+#else  /* if defined(HAVE_PTHREAD_SETAFFINITY_NP) && defined(CPU_SETSIZE) */
+	UNUSED(cpu);
+	return ISC_R_NOTIMPLEMENTED;
+#endif /* if defined(HAVE_PTHREAD_SETAFFINITY_NP) && defined(CPU_SETSIZE) */
+}
+
 void
 isc_thread_yield(void) {
 #if defined(HAVE_SCHED_YIELD)
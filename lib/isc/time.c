@@ -125,6 +125,20 @@ isc_time_monotonic(void) {
 	return isc_nanosecs_fromtime(time);
 }
 
+isc_nanosecs_t
+isc_time_threadcpu(void) {
+	struct timespec ts;
+
+	RUNTIME_CHECK(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != -1);
+
+	isc_time_t time = {
+		.seconds = ts.tv_sec,
+		.nanoseconds = ts.tv_nsec,
+	};
+
+	return isc_nanosecs_fromtime(time);
+}
+
 isc_result_t
 isc_time_nowplusinterval(isc_time_t *t, const isc_interval_t *i) {
 	struct timespec ts;
@@ -31,6 +31,7 @@
 #include <isc/uv.h>
 
 #include "loop_p.h"
+#include "timer_p.h"
 
 #define TIMER_MAGIC    ISC_MAGIC('T', 'I', 'M', 'R')
 #define VALID_TIMER(t) ISC_MAGIC_VALID(t, TIMER_MAGIC)
@@ -44,18 +45,221 @@ struct isc_timer {
 	uint64_t timeout;
 	uint64_t repeat;
 	atomic_bool running;
+
+	/* Coarse timers, kept in the timing wheel of the loop */
+	bool coarse;
+	uint64_t expires;
+	isc_timerlist_t *list;
+	ISC_LINK(isc_timer_t) link;
 };
 
+/*
+ * The timing wheel.
+ *
+ * A coarse timer is appended to the slot of the tick it expires at, so
+ * starting and stopping it is a list operation, and the wheel is driven
+ * by a single libuv timer that is set for the first tick that has any
+ * timers in it.  The timers that expire more than one turn of the wheel
+ * ahead stay in their slot until the wheel comes round to them again.
+ */
+
+static void
+wheel_cb(uv_timer_t *handle);
+
 void
-isc_timer_create(isc_loop_t *loop, isc_job_cb cb, void *cbarg,
-		 isc_timer_t **timerp) {
+isc__timerwheel_init(isc_loop_t *loop) {
+	isc_timerwheel_t *wheel = &loop->wheel;
 	int r;
+
+	*wheel = (isc_timerwheel_t){
+		.expired = ISC_LIST_INITIALIZER,
+	};
+
+	wheel->slots = isc_mem_cget(loop->mctx, TIMERWHEEL_SLOTS,
+				    sizeof(wheel->slots[0]));
+	for (size_t i = 0; i < TIMERWHEEL_SLOTS; i++) {
+		ISC_LIST_INIT(wheel->slots[i]);
+	}
+
+	r = uv_timer_init(&loop->loop, &wheel->timer);
+	UV_RUNTIME_CHECK(uv_timer_init, r);
+	uv_handle_set_data(&wheel->timer, loop);
+}
+
+void
+isc__timerwheel_close(isc_loop_t *loop) {
+	isc_timerwheel_t *wheel = &loop->wheel;
+
+	uv_timer_stop(&wheel->timer);
+	uv_close(&wheel->timer, NULL);
+}
+
+void
+isc__timerwheel_destroy(isc_loop_t *loop) {
+	isc_timerwheel_t *wheel = &loop->wheel;
+
+	INSIST(wheel->count == 0);
+	INSIST(ISC_LIST_EMPTY(wheel->expired));
+
+	isc_mem_cput(loop->mctx, wheel->slots, TIMERWHEEL_SLOTS,
+		     sizeof(wheel->slots[0]));
+}
+
+static void
+wheel_schedule(isc_loop_t *loop, uint64_t tick) {
+	isc_timerwheel_t *wheel = &loop->wheel;
+	uint64_t now = uv_now(&loop->loop);
+	int r;
+
+	if (wheel->due != 0 && wheel->due <= tick) {
+		return;
+	}
+
+	wheel->due = tick;
+	r = uv_timer_start(&wheel->timer, wheel_cb, tick > now ? tick - now : 0,
+			   0);
+	UV_RUNTIME_CHECK(uv_timer_start, r);
+}
+
+static void
+wheel_insert(isc_loop_t *loop, isc_timer_t *timer, uint64_t timeout) {
+	isc_timerwheel_t *wheel = &loop->wheel;
+	uint64_t now = uv_now(&loop->loop);
+	uint64_t tick;
+	size_t slot;
+
+	INSIST(timer->list == NULL);
+
+	if (wheel->count == 0) {
+		wheel->current = now;
+	}
+
+	timer->expires = now + timeout;
+	tick = ISC_MAX(timer->expires, wheel->current);
+	slot = tick & TIMERWHEEL_MASK;
+
+	ISC_LIST_APPEND(wheel->slots[slot], timer, link);
+	timer->list = &wheel->slots[slot];
+	wheel->bitmap[slot / 64] |= UINT64_C(1) << (slot % 64);
+	wheel->count++;
+
+	wheel_schedule(loop, tick);
+}
+
+static void
+wheel_unlink(isc_loop_t *loop, isc_timer_t *timer) {
+	isc_timerwheel_t *wheel = &loop->wheel;
+	isc_timerlist_t *list = timer->list;
+
+	if (list == NULL) {
+		return;
+	}
+
+	ISC_LIST_UNLINK(*list, timer, link);
+	timer->list = NULL;
+
+	if (list != &wheel->expired) {
+		size_t slot = list - wheel->slots;
+
+		wheel->count--;
+		if (ISC_LIST_EMPTY(*list)) {
+			wheel->bitmap[slot / 64] &= ~(UINT64_C(1)
+						      << (slot % 64));
+		}
+	}
+}
+
+/*
+ * Find the first tick from 'current' on whose slot has any timers in it.
+ */
+static uint64_t
+wheel_next(isc_timerwheel_t *wheel) {
+	size_t start = wheel->current & TIMERWHEEL_MASK;
+	size_t distance = 0;
+
+	while (distance < TIMERWHEEL_SLOTS) {
+		size_t slot = (start + distance) & TIMERWHEEL_MASK;
+		uint64_t bits = wheel->bitmap[slot / 64] >> (slot % 64);
+
+		if (bits != 0) {
+			return wheel->current + distance +
+			       __builtin_ctzll(bits);
+		}
+		distance += 64 - slot % 64;
+	}
+
+	UNREACHABLE();
+}
+
+static void
+wheel_cb(uv_timer_t *handle) {
+	isc_loop_t *loop = uv_handle_get_data(handle);
+	isc_timerwheel_t *wheel = &loop->wheel;
+	uint64_t now = uv_now(&loop->loop);
+	uint64_t last = ISC_MIN(now, wheel->current + TIMERWHEEL_SLOTS - 1);
+	isc_timer_t *timer = NULL;
+
+	wheel->due = 0;
+
+	/*
+	 * Collect the expired timers before running any of them, so the
+	 * callbacks can start and stop the timers freely.
+	 */
+	for (uint64_t tick = wheel->current; tick <= last; tick++) {
+		size_t slot = tick & TIMERWHEEL_MASK;
+		isc_timer_t *next = NULL;
+
+		if ((wheel->bitmap[slot / 64] & (UINT64_C(1) << (slot % 64))) ==
+		    0)
+		{
+			continue;
+		}
+
+		for (timer = ISC_LIST_HEAD(wheel->slots[slot]); timer != NULL;
+		     timer = next)
+		{
+			next = ISC_LIST_NEXT(timer, link);
+
+			if (!atomic_load_acquire(&timer->running)) {
+				/* Stopped from another loop */
+				wheel_unlink(loop, timer);
+			} else if (timer->expires <= now) {
+				wheel_unlink(loop, timer);
+				ISC_LIST_APPEND(wheel->expired, timer, link);
+				timer->list = &wheel->expired;
+			}
+		}
+	}
+	wheel->current = now + 1;
+
+	while ((timer = ISC_LIST_HEAD(wheel->expired)) != NULL) {
+		wheel_unlink(loop, timer);
+
+		if (!atomic_load_acquire(&timer->running)) {
+			continue;
+		}
+
+		if (timer->repeat > 0) {
+			wheel_insert(loop, timer, timer->repeat);
+		}
+
+		timer->cb(timer->cbarg);
+	}
+
+	if (wheel->count > 0) {
+		wheel_schedule(loop, wheel_next(wheel));
+	} else if (wheel->due != 0) {
+		uv_timer_stop(&wheel->timer);
+		wheel->due = 0;
+	}
+}
+
+static isc_timer_t *
+timer_new(isc_loop_t *loop, isc_job_cb cb, void *cbarg, bool coarse) {
 	isc_timer_t *timer;
 	isc_loopmgr_t *loopmgr = NULL;
 
 	REQUIRE(cb != NULL);
-	REQUIRE(timerp != NULL && *timerp == NULL);
-
 	REQUIRE(VALID_LOOP(loop));
 
 	loopmgr = loop->loopmgr;
@@ -67,11 +271,26 @@ isc_timer_create(isc_loop_t *loop, isc_job_cb cb, void *cbarg,
 	*timer = (isc_timer_t){
 		.cb = cb,
 		.cbarg = cbarg,
+		.coarse = coarse,
+		.link = ISC_LINK_INITIALIZER,
 		.magic = TIMER_MAGIC,
 	};
 
 	isc_loop_attach(loop, &timer->loop);
 
+	return timer;
+}
+
+void
+isc_timer_create(isc_loop_t *loop, isc_job_cb cb, void *cbarg,
+		 isc_timer_t **timerp) {
+	int r;
+	isc_timer_t *timer;
+
+	REQUIRE(timerp != NULL && *timerp == NULL);
+
+	timer = timer_new(loop, cb, cbarg, false);
+
 	r = uv_timer_init(&loop->loop, &timer->timer);
 	UV_RUNTIME_CHECK(uv_timer_init, r);
 	uv_handle_set_data(&timer->timer, timer);
@@ -79,6 +298,14 @@ isc_timer_create(isc_loop_t *loop, isc_job_cb cb, void *cbarg,
 	*timerp = timer;
 }
 
+void
+isc_timer_create_coarse(isc_loop_t *loop, isc_job_cb cb, void *cbarg,
+			isc_timer_t **timerp) {
+	REQUIRE(timerp != NULL && *timerp == NULL);
+
+	*timerp = timer_new(loop, cb, cbarg, true);
+}
+
 void
 isc_timer_stop(isc_timer_t *timer) {
 	REQUIRE(VALID_TIMER(timer));
@@ -91,7 +318,13 @@ isc_timer_stop(isc_timer_t *timer) {
 	}
 
 	/* Stop the timer, if the loops are matching */
-	if (timer->loop == isc_loop()) {
+	if (timer->loop != isc_loop()) {
+		return;
+	}
+
+	if (timer->coarse) {
+		wheel_unlink(timer->loop, timer);
+	} else {
 		uv_timer_stop(&timer->timer);
 	}
 }
@@ -142,6 +375,12 @@ isc_timer_start(isc_timer_t *timer, isc_timertype_t type,
 	}
 
 	atomic_store_release(&timer->running, true);
+	if (timer->coarse) {
+		wheel_unlink(loop, timer);
+		wheel_insert(loop, timer, timer->timeout);
+		return;
+	}
+
 	r = uv_timer_start(&timer->timer, timer_cb, timer->timeout,
 			   timer->repeat);
 	UV_RUNTIME_CHECK(uv_timer_start, r);
@@ -166,6 +405,16 @@ timer_destroy(void *arg) {
 	isc_timer_t *timer = arg;
 
 	atomic_store_release(&timer->running, false);
+	if (timer->coarse) {
+		isc_loop_t *loop = timer->loop;
+
+		wheel_unlink(loop, timer);
+		timer->magic = 0;
+		isc_mem_put(loop->mctx, timer, sizeof(*timer));
+		isc_loop_detach(&loop);
+		return;
+	}
+
 	uv_timer_stop(&timer->timer);
 	uv_close(&timer->timer, timer_close);
 }
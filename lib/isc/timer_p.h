@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+#include <inttypes.h>
+
+#include <isc/list.h>
+#include <isc/loop.h>
+#include <isc/types.h>
+#include <isc/uv.h>
+
+/*
+ * The timing wheel of the coarse timers: a slot for each millisecond
+ * tick, and a bitmap of the slots that hold timers.  A timer that
+ * expires more than one turn of the wheel ahead is skipped over until
+ * its turn comes.
+ */
+#define TIMERWHEEL_BITS	 10
+#define TIMERWHEEL_SLOTS (1U << TIMERWHEEL_BITS)
+#define TIMERWHEEL_MASK	 (TIMERWHEEL_SLOTS - 1)
+#define TIMERWHEEL_WORDS (TIMERWHEEL_SLOTS / 64)
+
+typedef ISC_LIST(isc_timer_t) isc_timerlist_t;
+
+typedef struct isc_timerwheel {
+	uv_timer_t timer;
+	isc_timerlist_t *slots;
+	isc_timerlist_t expired;
+	uint64_t bitmap[TIMERWHEEL_WORDS];
+	uint64_t current; /* the next tick to look at */
+	uint64_t due;	  /* the tick 'timer' fires at, 0 when stopped */
+	size_t count;
+} isc_timerwheel_t;
+
+void
+isc__timerwheel_init(isc_loop_t *loop);
+/*%<
+ * Initialize the timing wheel of 'loop'.
+ */
+
+void
+isc__timerwheel_close(isc_loop_t *loop);
+/*%<
+ * Close the libuv timer handle that drives the timing wheel.
+ */
+
+void
+isc__timerwheel_destroy(isc_loop_t *loop);
+/*%<
+ * Free the timing wheel of 'loop'; it must be empty.
+ */
@@ -27,7 +27,12 @@
 #include <openssl/dh.h>
 #include <openssl/err.h>
 #include <openssl/evp.h>
+#include <openssl/hmac.h>
 #include <openssl/opensslv.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#include <openssl/params.h>
+#endif /* OPENSSL_VERSION_NUMBER >= 0x30000000L */
 #include <openssl/rand.h>
 #include <openssl/rsa.h>
 #include <openssl/x509_vfy.h>
@@ -47,6 +52,7 @@
 #include <isc/refcount.h>
 #include <isc/rwlock.h>
 #include <isc/sockaddr.h>
+#include <isc/stdtime.h>
 #include <isc/thread.h>
 #include <isc/tls.h>
 #include <isc/util.h>
@@ -632,6 +638,272 @@ isc_tlsctx_session_tickets(isc_tlsctx_t *ctx, const bool use) {
 	}
 }
 
+/*
+ * Session ticket keys.  The keys are derived from the secret read from
+ * the ticket key file and from the number of the current rotation
+ * period, so every context, and every server, that reads the same file
+ * uses the same keys at the same time without any coordination.  The
+ * tickets issued with the keys of the previous period are still
+ * accepted, and renewed.
+ */
+#define TICKET_SECRET_MINLEN 32
+#define TICKET_SECRET_MAXLEN 1024
+#define TICKET_KEY_NAMELEN   16
+#define TICKET_KEY_LEN	     32
+
+typedef struct ticket_keys {
+	uint32_t rotation;
+	size_t secretlen;
+	unsigned char secret[TICKET_SECRET_MAXLEN];
+} ticket_keys_t;
+
+typedef struct ticket_key {
+	unsigned char name[TICKET_KEY_NAMELEN];
+	unsigned char hmac[TICKET_KEY_LEN];
+	unsigned char aes[TICKET_KEY_LEN];
+} ticket_key_t;
+
+static isc_once_t ticket_keys_once = ISC_ONCE_INIT;
+static int ticket_keys_index = -1;
+
+static void
+ticket_keys_free(void *parent ISC_ATTR_UNUSED, void *ptr,
+		 CRYPTO_EX_DATA *ad ISC_ATTR_UNUSED, int idx ISC_ATTR_UNUSED,
+		 long argl ISC_ATTR_UNUSED, void *argp ISC_ATTR_UNUSED) {
+	if (ptr != NULL) {
+		OPENSSL_clear_free(ptr, sizeof(ticket_keys_t));
+	}
+}
+
+static void
+ticket_keys_initialize(void) {
+	ticket_keys_index = SSL_CTX_get_ex_new_index(0, NULL, NULL, NULL,
+						     ticket_keys_free);
+	RUNTIME_CHECK(ticket_keys_index >= 0);
+}
+
+static void
+ticket_derive(const ticket_keys_t *keys, const char *label, uint64_t period,
+	      unsigned char *out, size_t outlen) {
+	unsigned char data[16] = { 0 };
+	unsigned char md[EVP_MAX_MD_SIZE];
+	unsigned int mdlen = sizeof(md);
+	size_t labellen = strlen(label);
+
+	INSIST(labellen <= sizeof(data) - sizeof(period));
+	memmove(data, label, labellen);
+	for (size_t i = 0; i < sizeof(period); i++) {
+		data[labellen + i] = (period >> (56 - 8 * i)) & 0xff;
+	}
+
+	RUNTIME_CHECK(HMAC(EVP_sha256(), keys->secret, (int)keys->secretlen,
+			   data, labellen + sizeof(period), md,
+			   &mdlen) != NULL);
+	INSIST(outlen <= mdlen);
+	memmove(out, md, outlen);
+}
+
+static void
+ticket_key_get(const ticket_keys_t *keys, uint64_t period, ticket_key_t *key) {
+	ticket_derive(keys, "name", period, key->name, sizeof(key->name));
+	ticket_derive(keys, "hmac", period, key->hmac, sizeof(key->hmac));
+	ticket_derive(keys, "aes", period, key->aes, sizeof(key->aes));
+}
+
+/*
+ * Find the key to encrypt a new ticket with, or the key named
+ * 'key_name' to decrypt a ticket with.  Returns what the ticket key
+ * callback is expected to return: 1 when the key was found, 2 when the
+ * ticket should also be renewed and 0 when the key is unknown.
+ */
+static int
+ticket_key_find(SSL *ssl, unsigned char *key_name, bool enc,
+		ticket_key_t *key) {
+	const ticket_keys_t *keys =
+		SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), ticket_keys_index);
+	uint64_t period;
+
+	if (keys == NULL) {
+		return -1;
+	}
+
+	period = isc_stdtime_now() / keys->rotation;
+
+	ticket_key_get(keys, period, key);
+	if (enc) {
+		memmove(key_name, key->name, sizeof(key->name));
+		return 1;
+	}
+	if (memcmp(key_name, key->name, sizeof(key->name)) == 0) {
+		return 1;
+	}
+
+	/*
+	 * The previous key, or the next one if another server has already
+	 * moved on to the next period.
+	 */
+	ticket_key_get(keys, period - 1, key);
+	if (memcmp(key_name, key->name, sizeof(key->name)) == 0) {
+		return 2;
+	}
+	ticket_key_get(keys, period + 1, key);
+	if (memcmp(key_name, key->name, sizeof(key->name)) == 0) {
+		return 2;
+	}
+
+	return 0;
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+static int
+ticket_key_cb(SSL *ssl, unsigned char *key_name, unsigned char *iv,
+	      EVP_CIPHER_CTX *cctx, EVP_MAC_CTX *hctx, int enc) {
+	ticket_key_t key;
+	OSSL_PARAM params[3];
+	int ret;
+
+	ret = ticket_key_find(ssl, key_name, enc == 1, &key);
+	if (ret <= 0) {
+		goto done;
+	}
+
+	params[0] = OSSL_PARAM_construct_octet_string(
+		OSSL_MAC_PARAM_KEY, key.hmac, sizeof(key.hmac));
+	params[1] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST,
+						     (char *)"SHA256", 0);
+	params[2] = OSSL_PARAM_construct_end();
+
+	if (enc == 1) {
+		if (RAND_bytes(iv, EVP_MAX_IV_LENGTH) != 1 ||
+		    EVP_EncryptInit_ex(cctx, EVP_aes_256_cbc(), NULL, key.aes,
+				       iv) != 1)
+		{
+			ret = -1;
+			goto done;
+		}
+	} else if (EVP_DecryptInit_ex(cctx, EVP_aes_256_cbc(), NULL, key.aes,
+				      iv) != 1)
+	{
+		ret = -1;
+		goto done;
+	}
+
+	if (EVP_MAC_CTX_set_params(hctx, params) != 1) {
+		ret = -1;
+	}
+
+done:
+	OPENSSL_cleanse(&key, sizeof(key));
+	return ret;
+}
+#else  /* OPENSSL_VERSION_NUMBER >= 0x30000000L */
+static int
+ticket_key_cb(SSL *ssl, unsigned char *key_name, unsigned char *iv,
+	      EVP_CIPHER_CTX *cctx, HMAC_CTX *hctx, int enc) {
+	ticket_key_t key;
+	int ret;
+
+	ret = ticket_key_find(ssl, key_name, enc == 1, &key);
+	if (ret <= 0) {
+		goto done;
+	}
+
+	if (enc == 1) {
+		if (RAND_bytes(iv, EVP_MAX_IV_LENGTH) != 1 ||
+		    EVP_EncryptInit_ex(cctx, EVP_aes_256_cbc(), NULL, key.aes,
+				       iv) != 1)
+		{
+			ret = -1;
+			goto done;
+		}
+	} else if (EVP_DecryptInit_ex(cctx, EVP_aes_256_cbc(), NULL, key.aes,
+				      iv) != 1)
+	{
+		ret = -1;
+		goto done;
+	}
+
+	if (HMAC_Init_ex(hctx, key.hmac, sizeof(key.hmac), EVP_sha256(),
+			 NULL) != 1)
+	{
+		ret = -1;
+	}
+
+done:
+	OPENSSL_cleanse(&key, sizeof(key));
+	return ret;
+}
+#endif /* OPENSSL_VERSION_NUMBER >= 0x30000000L */
+
+isc_result_t
+isc_tlsctx_load_ticket_keys(isc_tlsctx_t *ctx, const char *keyfile,
+			    uint32_t rotation) {
+	ticket_keys_t *keys = NULL;
+	unsigned char sid_ctx[SSL_MAX_SID_CTX_LENGTH];
+	BIO *bio = NULL;
+	unsigned char extra;
+	size_t secretlen = 0;
+	int len;
+
+	REQUIRE(ctx != NULL);
+	REQUIRE(keyfile != NULL);
+	REQUIRE(rotation > 0);
+
+	isc_once_do(&ticket_keys_once, ticket_keys_initialize);
+
+	bio = BIO_new_file(keyfile, "rb");
+	if (bio == NULL) {
+		ERR_clear_error();
+		return ISC_R_FILENOTFOUND;
+	}
+
+	keys = OPENSSL_zalloc(sizeof(*keys));
+	RUNTIME_CHECK(keys != NULL);
+
+	/*
+	 * A read can return less than asked for; read until the end of the
+	 * file, and refuse a secret that doesn't fit rather than use only
+	 * a part of it.
+	 */
+	while (secretlen < sizeof(keys->secret)) {
+		len = BIO_read(bio, keys->secret + secretlen,
+			       (int)(sizeof(keys->secret) - secretlen));
+		if (len <= 0) {
+			break;
+		}
+		secretlen += len;
+	}
+	len = (secretlen == sizeof(keys->secret)) ? BIO_read(bio, &extra, 1)
+						  : 0;
+	BIO_free(bio);
+	OPENSSL_cleanse(&extra, sizeof(extra));
+	if (secretlen < TICKET_SECRET_MINLEN || len > 0) {
+		OPENSSL_clear_free(keys, sizeof(*keys));
+		ERR_clear_error();
+		return ISC_R_RANGE;
+	}
+	keys->secretlen = secretlen;
+	keys->rotation = rotation;
+
+	/*
+	 * A session is only resumed within the same session ID context,
+	 * so it has to be the same on all the servers sharing the keys.
+	 */
+	ticket_derive(keys, "sidctx", 0, sid_ctx, 20);
+	RUNTIME_CHECK(SSL_CTX_set_session_id_context(ctx, sid_ctx, 20) == 1);
+
+	RUNTIME_CHECK(SSL_CTX_set_ex_data(ctx, ticket_keys_index, keys) == 1);
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+	RUNTIME_CHECK(SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx,
+							  ticket_key_cb) == 1);
+#else  /* OPENSSL_VERSION_NUMBER >= 0x30000000L */
+	RUNTIME_CHECK(SSL_CTX_set_tlsext_ticket_key_cb(ctx, ticket_key_cb) ==
+		      1);
+#endif /* OPENSSL_VERSION_NUMBER >= 0x30000000L */
+
+	return ISC_R_SUCCESS;
+}
+
 isc_tls_t *
 isc_tls_create(isc_tlsctx_t *ctx) {
 	isc_tls_t *newctx = NULL;
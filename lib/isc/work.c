@@ -11,34 +11,89 @@
  * information regarding copyright ownership.
  */
 
+/*
+ * The worker thread pool.
+ *
+ * Every loop has a work queue for each priority class, and every worker
+ * thread has a home queue that it serves first.  A worker looks for the
+ * latency-sensitive work in its home queue and then in all the other
+ * queues, and only then for bulk work in the same order, so an idle
+ * worker steals the work that is waiting behind a busy one.  The number
+ * of workers that run bulk work at once is capped, leaving one of them
+ * for the latency-sensitive work.
+ *
+ * The queues have their own locks and counters, so queueing work on one
+ * loop doesn't contend with the other loops; the pool-wide lock is only
+ * taken to put an idle worker to sleep and to wake it up.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
 #include <stdlib.h>
 
+#include <isc/async.h>
+#include <isc/atomic.h>
+#include <isc/condition.h>
 #include <isc/job.h>
+#include <isc/list.h>
 #include <isc/loop.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/os.h>
+#include <isc/thread.h>
+#include <isc/time.h>
 #include <isc/urcu.h>
+#include <isc/util.h>
 #include <isc/uv.h>
 #include <isc/work.h>
 
 #include "loop_p.h"
+#include "work_p.h"
 
-static void
-isc__work_cb(uv_work_t *req) {
-	isc_work_t *work = uv_req_get_data((uv_req_t *)req);
+typedef ISC_LIST(isc_work_t) isc_worklist_t;
 
-	rcu_register_thread();
+typedef struct workqueue {
+	isc_mutex_t lock;
+	isc_worklist_t works[ISC_WORK_MAXPRIO];
+	/* The length of 'works', readable without the lock */
+	atomic_uint_fast32_t queued[ISC_WORK_MAXPRIO];
+	uint8_t __padding[ISC_OS_CACHELINE_SIZE];
+} workqueue_t;
 
-	work->work_cb(work->cbarg);
+typedef struct worker {
+	isc__workpool_t *pool;
+	isc_thread_t thread;
+	uint32_t home;
+} worker_t;
 
-	rcu_unregister_thread();
-}
+struct isc__workpool {
+	isc_mem_t *mctx;
+
+	uint32_t nqueues;
+	workqueue_t *queues;
+
+	uint32_t nworkers;
+	worker_t *workers;
+
+	/* Work queued in any queue, by priority */
+	atomic_uint_fast32_t pending[ISC_WORK_MAXPRIO];
+
+	/* Bulk work running, and how much of it may run at once */
+	atomic_uint_fast32_t bulkrunning;
+	uint32_t bulkmax;
+
+	/* Idle workers sleep here */
+	isc_mutex_t lock;
+	isc_condition_t cond;
+	atomic_uint_fast32_t idle;
+	bool shuttingdown;
+};
 
 static void
-isc__after_work_cb(uv_work_t *req, int status) {
-	isc_work_t *work = uv_req_get_data((uv_req_t *)req);
+isc__after_work_cb(void *arg) {
+	isc_work_t *work = arg;
 	isc_loop_t *loop = work->loop;
 
-	UV_RUNTIME_CHECK(uv_after_work_cb, status);
-
 	work->after_work_cb(work->cbarg);
 
 	isc_mem_put(loop->mctx, work, sizeof(*work));
@@ -46,28 +101,267 @@ isc__after_work_cb(uv_work_t *req, int status) {
 	isc_loop_detach(&loop);
 }
 
-void
-isc_work_enqueue(isc_loop_t *loop, isc_work_cb work_cb,
-		 isc_after_work_cb after_work_cb, void *cbarg) {
+static void
+work_run(isc_work_t *work) {
+	isc_loop_t *loop = work->loop;
+	uint64_t wait = isc_time_monotonic() - work->enqueued;
+
+	/* The work of a loop can run on several worker threads at once */
+	atomic_fetch_add_relaxed(&loop->workwait, wait);
+	isc__loop_statmax(&loop->workmaxwait, wait);
+	atomic_fetch_add_relaxed(&loop->works, 1);
+
+	work->work_cb(work->cbarg);
+
+#if defined(RCU_QSBR)
+	rcu_quiescent_state();
+#endif
+
+	isc_async_run(loop, isc__after_work_cb, work);
+}
+
+/*
+ * Wake up an idle worker, if there is one.
+ */
+static void
+workpool_wake(isc__workpool_t *pool) {
+	if (atomic_load(&pool->idle) > 0) {
+		LOCK(&pool->lock);
+		SIGNAL(&pool->cond);
+		UNLOCK(&pool->lock);
+	}
+}
+
+/*
+ * Can a worker take any of the pending work?
+ */
+static bool
+workpool_ready(isc__workpool_t *pool) {
+	return atomic_load(&pool->pending[ISC_WORK_LATENCY]) > 0 ||
+	       (atomic_load(&pool->pending[ISC_WORK_BULK]) > 0 &&
+		atomic_load(&pool->bulkrunning) < pool->bulkmax);
+}
+
+static isc_work_t *
+workpool_take(isc__workpool_t *pool, uint32_t home, isc_workprio_t prio) {
+	for (uint32_t i = 0; i < pool->nqueues; i++) {
+		workqueue_t *queue = &pool->queues[(home + i) % pool->nqueues];
+		isc_work_t *work = NULL;
+
+		if (atomic_load_relaxed(&queue->queued[prio]) == 0) {
+			continue;
+		}
+
+		LOCK(&queue->lock);
+		work = ISC_LIST_HEAD(queue->works[prio]);
+		if (work != NULL) {
+			ISC_LIST_UNLINK(queue->works[prio], work, link);
+			atomic_fetch_sub_relaxed(&queue->queued[prio], 1);
+		}
+		UNLOCK(&queue->lock);
+
+		if (work != NULL) {
+			atomic_fetch_sub(&pool->pending[prio], 1);
+			return work;
+		}
+	}
+
+	return NULL;
+}
+
+static isc_work_t *
+workpool_next(isc__workpool_t *pool, uint32_t home) {
+	isc_work_t *work = workpool_take(pool, home, ISC_WORK_LATENCY);
+	if (work != NULL) {
+		return work;
+	}
+
+	if (atomic_fetch_add(&pool->bulkrunning, 1) < pool->bulkmax) {
+		work = workpool_take(pool, home, ISC_WORK_BULK);
+		if (work != NULL) {
+			return work;
+		}
+	}
+
+	atomic_fetch_sub(&pool->bulkrunning, 1);
+	return NULL;
+}
+
+static void *
+worker_thread(void *arg) {
+	worker_t *worker = arg;
+	isc__workpool_t *pool = worker->pool;
+
+	for (;;) {
+		isc_work_t *work = workpool_next(pool, worker->home);
+		if (work != NULL) {
+			isc_workprio_t prio = work->prio;
+
+			work_run(work);
+
+			if (prio == ISC_WORK_BULK) {
+				atomic_fetch_sub(&pool->bulkrunning, 1);
+				if (atomic_load(&pool->pending[prio]) > 0) {
+					workpool_wake(pool);
+				}
+			}
+			continue;
+		}
+
+		/* The worker threads are registered by isc_thread_create() */
+		rcu_thread_offline();
+
+		LOCK(&pool->lock);
+		atomic_fetch_add(&pool->idle, 1);
+		while (!pool->shuttingdown && !workpool_ready(pool)) {
+			WAIT(&pool->cond, &pool->lock);
+		}
+		atomic_fetch_sub(&pool->idle, 1);
+		bool done = pool->shuttingdown;
+		UNLOCK(&pool->lock);
+
+		rcu_thread_online();
+
+		if (done) {
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+static void
+work_enqueue(isc_loop_t *loop, isc_workprio_t prio, isc_work_cb work_cb,
+	     isc_after_work_cb after_work_cb, void *cbarg) {
+	isc__workpool_t *pool = NULL;
+	workqueue_t *queue = NULL;
 	isc_work_t *work = NULL;
-	int r;
 
 	REQUIRE(VALID_LOOP(loop));
 	REQUIRE(work_cb != NULL);
 	REQUIRE(after_work_cb != NULL);
 
+	pool = loop->loopmgr->workpool;
+	queue = &pool->queues[loop->tid % pool->nqueues];
+
 	work = isc_mem_get(loop->mctx, sizeof(*work));
 	*work = (isc_work_t){
 		.work_cb = work_cb,
 		.after_work_cb = after_work_cb,
 		.cbarg = cbarg,
+		.prio = prio,
+		.enqueued = isc_time_monotonic(),
+		.link = ISC_LINK_INITIALIZER,
 	};
 
 	isc_loop_attach(loop, &work->loop);
 
-	uv_req_set_data((uv_req_t *)&work->work, work);
+	atomic_fetch_add_relaxed(&loop->workssent, 1);
+
+	LOCK(&queue->lock);
+	ISC_LIST_APPEND(queue->works[prio], work, link);
+	atomic_fetch_add_relaxed(&queue->queued[prio], 1);
+	UNLOCK(&queue->lock);
+
+	atomic_fetch_add(&pool->pending[prio], 1);
+	workpool_wake(pool);
+}
+
+void
+isc_work_enqueue(isc_loop_t *loop, isc_work_cb work_cb,
+		 isc_after_work_cb after_work_cb, void *cbarg) {
+	work_enqueue(loop, ISC_WORK_LATENCY, work_cb, after_work_cb, cbarg);
+}
+
+void
+isc_work_enqueue_bulk(isc_loop_t *loop, isc_work_cb work_cb,
+		      isc_after_work_cb after_work_cb, void *cbarg) {
+	work_enqueue(loop, ISC_WORK_BULK, work_cb, after_work_cb, cbarg);
+}
+
+void
+isc__workpool_create(isc_mem_t *mctx, uint32_t nqueues, uint32_t nworkers,
+		     isc__workpool_t **poolp) {
+	isc__workpool_t *pool = NULL;
+
+	REQUIRE(nqueues > 0);
+	REQUIRE(nworkers > 0);
+	REQUIRE(poolp != NULL && *poolp == NULL);
+
+	pool = isc_mem_get(mctx, sizeof(*pool));
+	*pool = (isc__workpool_t){
+		.nqueues = nqueues,
+		.nworkers = nworkers,
+		.bulkmax = (nworkers > 1) ? nworkers - 1 : 1,
+	};
+	isc_mem_attach(mctx, &pool->mctx);
+
+	isc_mutex_init(&pool->lock);
+	isc_condition_init(&pool->cond);
+
+	pool->queues = isc_mem_cget(pool->mctx, nqueues,
+				    sizeof(pool->queues[0]));
+	for (uint32_t i = 0; i < nqueues; i++) {
+		workqueue_t *queue = &pool->queues[i];
+
+		isc_mutex_init(&queue->lock);
+		for (size_t prio = 0; prio < ISC_WORK_MAXPRIO; prio++) {
+			ISC_LIST_INIT(queue->works[prio]);
+		}
+	}
+
+	pool->workers = isc_mem_cget(pool->mctx, nworkers,
+				     sizeof(pool->workers[0]));
+	for (uint32_t i = 0; i < nworkers; i++) {
+		worker_t *worker = &pool->workers[i];
+		char name[32];
+
+		*worker = (worker_t){
+			.pool = pool,
+			.home = i % nqueues,
+		};
+
+		isc_thread_create(worker_thread, worker, &worker->thread);
+		snprintf(name, sizeof(name), "isc-work-%04" PRIu32, i);
+		isc_thread_setname(worker->thread, name);
+	}
+
+	*poolp = pool;
+}
+
+void
+isc__workpool_destroy(isc__workpool_t **poolp) {
+	isc__workpool_t *pool = NULL;
+
+	REQUIRE(poolp != NULL && *poolp != NULL);
+
+	pool = *poolp;
+	*poolp = NULL;
+
+	LOCK(&pool->lock);
+	pool->shuttingdown = true;
+	BROADCAST(&pool->cond);
+	UNLOCK(&pool->lock);
+
+	for (uint32_t i = 0; i < pool->nworkers; i++) {
+		isc_thread_join(pool->workers[i].thread, NULL);
+	}
+	isc_mem_cput(pool->mctx, pool->workers, pool->nworkers,
+		     sizeof(pool->workers[0]));
+
+	for (uint32_t i = 0; i < pool->nqueues; i++) {
+		workqueue_t *queue = &pool->queues[i];
+
+		for (size_t prio = 0; prio < ISC_WORK_MAXPRIO; prio++) {
+			INSIST(ISC_LIST_EMPTY(queue->works[prio]));
+		}
+		isc_mutex_destroy(&queue->lock);
+	}
+	isc_mem_cput(pool->mctx, pool->queues, pool->nqueues,
+		     sizeof(pool->queues[0]));
+
+	isc_condition_destroy(&pool->cond);
+	isc_mutex_destroy(&pool->lock);
 
-	r = uv_queue_work(&loop->loop, &work->work, isc__work_cb,
-			  isc__after_work_cb);
-	UV_RUNTIME_CHECK(uv_queue_work, r);
+	isc_mem_putanddetach(&pool->mctx, pool, sizeof(*pool));
 }
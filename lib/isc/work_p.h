@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+#include <isc/loop.h>
+#include <isc/mem.h>
+#include <isc/work.h>
+
+typedef struct isc__workpool isc__workpool_t;
+
+void
+isc__workpool_create(isc_mem_t *mctx, uint32_t nqueues, uint32_t nworkers,
+		     isc__workpool_t **poolp);
+/*%<
+ * Create a pool of 'nworkers' threads, serving 'nqueues' work queues,
+ * one for each loop.
+ */
+
+void
+isc__workpool_destroy(isc__workpool_t **poolp);
+/*%<
+ * Stop the worker threads and destroy the pool.  All the work must
+ * have been completed.
+ */
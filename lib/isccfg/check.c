@@ -2231,7 +2231,7 @@ check_tls_defintion(const cfg_obj_t *tlsobj, const char *name,
 	isc_result_t result, tresult;
 	const cfg_obj_t *tls_proto_list = NULL, *tls_key = NULL,
 			*tls_cert = NULL, *tls_ciphers = NULL,
-			*tls_cipher_suites = NULL;
+			*tls_cipher_suites = NULL, *tls_rotation = NULL;
 	uint32_t tls_protos = 0;
 	isc_symvalue_t symvalue;
 
@@ -2357,6 +2357,15 @@ check_tls_defintion(const cfg_obj_t *tlsobj, const char *name,
 		}
 	}
 
+	tresult = cfg_map_get(tlsobj, "session-ticket-rotation", &tls_rotation);
+	if (tresult == ISC_R_SUCCESS && cfg_obj_asduration(tls_rotation) == 0) {
+		cfg_obj_log(tls_rotation, ISC_LOG_ERROR,
+			    "'session-ticket-rotation' in the 'tls' clause "
+			    "'%s' must be greater than zero",
+			    name);
+		result = ISC_R_FAILURE;
+	}
+
 	return result;
 }
 
@@ -3614,6 +3623,32 @@ check_zoneconf(const cfg_obj_t *zconfig, const cfg_obj_t *voptions,
 			}
 		}
 
+		/*
+		 * A zone loaded on demand is unloaded when idle, so it
+		 * cannot be changed or signed by the server.
+		 */
+		obj = NULL;
+		res1 = cfg_map_get(zoptions, "load-on-demand", &obj);
+		if (res1 == ISC_R_SUCCESS && cfg_obj_asboolean(obj) &&
+		    (ddns || signing || has_dnssecpolicy))
+		{
+			cfg_obj_log(obj, ISC_LOG_ERROR,
+				    "zone '%s': 'load-on-demand' cannot be "
+				    "used in dynamic or signed zones",
+				    znamestr);
+			result = ISC_R_FAILURE;
+		}
+
+		obj = NULL;
+		res1 = cfg_map_get(zoptions, "load-on-demand-idle-time", &obj);
+		if (res1 == ISC_R_SUCCESS && cfg_obj_asduration(obj) == 0) {
+			cfg_obj_log(obj, ISC_LOG_ERROR,
+				    "zone '%s': 'load-on-demand-idle-time' "
+				    "must be greater than zero",
+				    znamestr);
+			result = ISC_R_FAILURE;
+		}
+
 		obj = NULL;
 		res1 = cfg_map_get(zoptions, "sig-signing-type", &obj);
 		if (res1 == ISC_R_SUCCESS) {
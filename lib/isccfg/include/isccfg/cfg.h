@@ -512,6 +512,7 @@ cfg_printx(const cfg_obj_t *obj, unsigned int flags,
 	     * options, omitting ancient,      \
 	     * obsolete, nonimplemented,       \
 	     * and test-only options. */
+#define CFG_PRINTER_NOZONES 0x8 /* omit the zone statements */
 
 /*%<
  * Print the configuration object 'obj' by repeatedly calling the
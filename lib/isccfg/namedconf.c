@@ -113,6 +113,7 @@ static cfg_type_t cfg_type_logversions;
 static cfg_type_t cfg_type_remoteselement;
 static cfg_type_t cfg_type_maxduration;
 static cfg_type_t cfg_type_minimal;
+static cfg_type_t cfg_type_namelist;
 static cfg_type_t cfg_type_nameportiplist;
 static cfg_type_t cfg_type_notifytype;
 static cfg_type_t cfg_type_optional_allow;
@@ -152,6 +153,7 @@ static cfg_type_t cfg_type_zone;
 
 static cfg_tuplefielddef_t listenon_tuple_fields[] = {
 	{ "port", &cfg_type_optional_port, 0 },
+	{ "fastopen", &cfg_type_uint32, 0 },
 	/*
 	 * Let's follow the protocols encapsulation order (lower->upper), at
 	 * least roughly.
@@ -1205,9 +1207,12 @@ static cfg_clausedef_t options_clauses[] = {
 	{ "avoid-v6-udp-ports", NULL, CFG_CLAUSEFLAG_ANCIENT },
 	{ "bindkeys-file", &cfg_type_qstring, CFG_CLAUSEFLAG_TESTONLY },
 	{ "blackhole", &cfg_type_bracketed_aml, 0 },
+	{ "client-pool-preallocate", &cfg_type_uint32, 0 },
+	{ "client-pool-size", &cfg_type_uint32, 0 },
 	{ "cookie-algorithm", &cfg_type_cookiealg, 0 },
 	{ "cookie-secret", &cfg_type_sstring, CFG_CLAUSEFLAG_MULTI },
 	{ "coresize", NULL, CFG_CLAUSEFLAG_ANCIENT },
+	{ "cpu-affinity", &cfg_type_boolean, 0 },
 	{ "datasize", NULL, CFG_CLAUSEFLAG_ANCIENT },
 	{ "deallocate-on-exit", NULL, CFG_CLAUSEFLAG_ANCIENT },
 	{ "directory", &cfg_type_qstring, CFG_CLAUSEFLAG_CALLBACK },
@@ -1215,11 +1220,13 @@ static cfg_clausedef_t options_clauses[] = {
 #ifdef HAVE_DNSTAP
 	{ "dnstap-output", &cfg_type_dnstapoutput, CFG_CLAUSEFLAG_OPTIONAL },
 	{ "dnstap-identity", &cfg_type_serverid, CFG_CLAUSEFLAG_OPTIONAL },
+	{ "dnstap-sample", &cfg_type_uint32, CFG_CLAUSEFLAG_OPTIONAL },
 	{ "dnstap-version", &cfg_type_qstringornone, CFG_CLAUSEFLAG_OPTIONAL },
 #else  /* ifdef HAVE_DNSTAP */
 	{ "dnstap-output", &cfg_type_dnstapoutput,
 	  CFG_CLAUSEFLAG_NOTCONFIGURED },
 	{ "dnstap-identity", &cfg_type_serverid, CFG_CLAUSEFLAG_NOTCONFIGURED },
+	{ "dnstap-sample", &cfg_type_uint32, CFG_CLAUSEFLAG_NOTCONFIGURED },
 	{ "dnstap-version", &cfg_type_qstringornone,
 	  CFG_CLAUSEFLAG_NOTCONFIGURED },
 #endif /* ifdef HAVE_DNSTAP */
@@ -1292,6 +1299,8 @@ static cfg_clausedef_t options_clauses[] = {
 	{ "http-listener-clients", &cfg_type_uint32, CFG_CLAUSEFLAG_OPTIONAL },
 	{ "http-streams-per-connection", &cfg_type_uint32,
 	  CFG_CLAUSEFLAG_OPTIONAL },
+	{ "http-window-size", &cfg_type_sizenodefault,
+	  CFG_CLAUSEFLAG_OPTIONAL },
 	{ "https-port", &cfg_type_uint32, CFG_CLAUSEFLAG_OPTIONAL },
 #else
 	{ "http-port", &cfg_type_uint32, CFG_CLAUSEFLAG_NOTCONFIGURED },
@@ -1299,9 +1308,12 @@ static cfg_clausedef_t options_clauses[] = {
 	  CFG_CLAUSEFLAG_NOTCONFIGURED },
 	{ "http-streams-per-connection", &cfg_type_uint32,
 	  CFG_CLAUSEFLAG_NOTCONFIGURED },
+	{ "http-window-size", &cfg_type_sizenodefault,
+	  CFG_CLAUSEFLAG_NOTCONFIGURED },
 	{ "https-port", &cfg_type_uint32, CFG_CLAUSEFLAG_NOTCONFIGURED },
 #endif
 	{ "querylog", &cfg_type_boolean, 0 },
+	{ "querylog-file", &cfg_type_qstring, 0 },
 	{ "random-device", NULL, CFG_CLAUSEFLAG_ANCIENT },
 	{ "recursing-file", &cfg_type_qstring, 0 },
 	{ "recursive-clients", &cfg_type_uint32, 0 },
@@ -1325,29 +1337,38 @@ static cfg_clausedef_t options_clauses[] = {
 	{ "statistics-interval", NULL, CFG_CLAUSEFLAG_ANCIENT },
 	{ "tcp-advertised-timeout", &cfg_type_uint32, 0 },
 	{ "tcp-clients", &cfg_type_uint32, 0 },
+	{ "tcp-fastopen-connect", &cfg_type_boolean, 0 },
 	{ "tcp-idle-timeout", &cfg_type_uint32, 0 },
 	{ "tcp-initial-timeout", &cfg_type_uint32, 0 },
 	{ "tcp-keepalive-timeout", &cfg_type_uint32, 0 },
 	{ "tcp-listen-queue", &cfg_type_uint32, 0 },
 	{ "tcp-receive-buffer", &cfg_type_uint32, 0 },
 	{ "tcp-send-buffer", &cfg_type_uint32, 0 },
+	{ "tcp-upstream-connections", &cfg_type_uint32, 0 },
+	{ "tcp-upstream-idle-timeout", &cfg_type_uint32, 0 },
+	{ "tcp-upstream-pipeline", &cfg_type_uint32, 0 },
 	{ "tkey-dhkey", NULL, CFG_CLAUSEFLAG_ANCIENT },
 	{ "tkey-domain", &cfg_type_qstring, 0 },
 	{ "tkey-gssapi-credential", &cfg_type_qstring, 0 },
 	{ "tkey-gssapi-keytab", &cfg_type_qstring, 0 },
+	{ "transfer-cache-size", &cfg_type_sizeval, 0 },
 	{ "transfer-message-size", &cfg_type_uint32, 0 },
 	{ "transfers-in", &cfg_type_uint32, 0 },
 	{ "transfers-out", &cfg_type_uint32, 0 },
 	{ "transfers-per-ns", &cfg_type_uint32, 0 },
 	{ "treat-cr-as-space", NULL, CFG_CLAUSEFLAG_ANCIENT },
+	{ "udp-cpu-steering", &cfg_type_boolean, 0 },
 	{ "udp-receive-buffer", &cfg_type_uint32, 0 },
+	{ "udp-segmentation-offload", &cfg_type_boolean, 0 },
 	{ "udp-send-buffer", &cfg_type_uint32, 0 },
+	{ "udp-upstream-reuse", &cfg_type_boolean, 0 },
 	{ "update-quota", &cfg_type_uint32, 0 },
 	{ "use-id-pool", NULL, CFG_CLAUSEFLAG_ANCIENT },
 	{ "use-ixfr", NULL, CFG_CLAUSEFLAG_ANCIENT },
 	{ "use-v4-udp-ports", NULL, CFG_CLAUSEFLAG_ANCIENT },
 	{ "use-v6-udp-ports", NULL, CFG_CLAUSEFLAG_ANCIENT },
 	{ "version", &cfg_type_qstringornone, 0 },
+	{ "xdp-interfaces", &cfg_type_namelist, 0 },
 	{ NULL, NULL, 0 }
 };
 
@@ -1429,6 +1450,12 @@ static cfg_type_t cfg_type_masterformat = {
 	cfg_doc_enum,	&cfg_rep_string, &masterformat_enums
 };
 
+static const char *cacheevict_enums[] = { "lru", "sieve", NULL };
+static cfg_type_t cfg_type_cacheevict = {
+	"cacheevict", cfg_parse_enum,  cfg_print_ustring,
+	cfg_doc_enum, &cfg_rep_string, &cacheevict_enums
+};
+
 static const char *masterstyle_enums[] = { "full", "relative", NULL };
 static cfg_type_t cfg_type_masterstyle = {
 	"masterstyle", cfg_parse_enum,	cfg_print_ustring,
@@ -1905,6 +1932,7 @@ static cfg_clausedef_t rrl_clauses[] = {
 	{ "referrals-per-second", &cfg_type_uint32, 0 },
 	{ "responses-per-second", &cfg_type_uint32, 0 },
 	{ "slip", &cfg_type_uint32, 0 },
+	{ "table-shards", &cfg_type_uint32, 0 },
 	{ "window", &cfg_type_uint32, 0 },
 	{ NULL, NULL, 0 }
 };
@@ -2014,7 +2042,10 @@ static cfg_clausedef_t view_clauses[] = {
 	{ "allow-v6-synthesis", NULL, CFG_CLAUSEFLAG_ANCIENT },
 	{ "attach-cache", &cfg_type_astring, 0 },
 	{ "auth-nxdomain", &cfg_type_boolean, 0 },
+	{ "auth-response-cache", &cfg_type_boolean, 0 },
+	{ "cache-eviction-policy", &cfg_type_cacheevict, 0 },
 	{ "cache-file", NULL, CFG_CLAUSEFLAG_ANCIENT },
+	{ "cache-snapshot", &cfg_type_boolean, 0 },
 	{ "catalog-zones", &cfg_type_catz, 0 },
 	{ "check-names", &cfg_type_checknames, CFG_CLAUSEFLAG_MULTI },
 	{ "cleaning-interval", NULL, CFG_CLAUSEFLAG_ANCIENT },
@@ -2066,11 +2097,13 @@ static cfg_clausedef_t view_clauses[] = {
 #else  /* ifdef HAVE_LMDB */
 	{ "lmdb-mapsize", &cfg_type_sizeval, CFG_CLAUSEFLAG_NOTCONFIGURED },
 #endif /* ifdef HAVE_LMDB */
+	{ "lock-free-cache-reads", &cfg_type_boolean, 0 },
 	{ "max-acache-size", NULL, CFG_CLAUSEFLAG_ANCIENT },
 	{ "max-cache-size", &cfg_type_sizeorpercent, 0 },
 	{ "max-cache-ttl", &cfg_type_duration, 0 },
 	{ "max-clients-per-query", &cfg_type_uint32, 0 },
 	{ "max-ncache-ttl", &cfg_type_duration, 0 },
+	{ "max-offloaded-validations", &cfg_type_uint32, 0 },
 	{ "max-recursion-depth", &cfg_type_uint32, 0 },
 	{ "max-recursion-queries", &cfg_type_uint32, 0 },
 	{ "max-query-count", &cfg_type_uint32, 0 },
@@ -2094,6 +2127,8 @@ static cfg_clausedef_t view_clauses[] = {
 	{ "nta-lifetime", &cfg_type_duration, 0 },
 	{ "nta-recheck", &cfg_type_duration, 0 },
 	{ "nxdomain-redirect", &cfg_type_astring, 0 },
+	{ "popular-refresh-limit", &cfg_type_uint32, 0 },
+	{ "popular-refresh-rate", &cfg_type_uint32, 0 },
 	{ "preferred-glue", &cfg_type_astring, 0 },
 	{ "prefetch", &cfg_type_prefetch, 0 },
 	{ "provide-ixfr", &cfg_type_boolean, 0 },
@@ -2111,6 +2146,7 @@ static cfg_clausedef_t view_clauses[] = {
 	{ "request-nsid", &cfg_type_boolean, 0 },
 	{ "request-sit", NULL, CFG_CLAUSEFLAG_ANCIENT },
 	{ "require-server-cookie", &cfg_type_boolean, 0 },
+	{ "resolver-hedge-queries", &cfg_type_boolean, 0 },
 	{ "resolver-nonbackoff-tries", NULL, CFG_CLAUSEFLAG_ANCIENT },
 	{ "resolver-query-timeout", &cfg_type_uint32, 0 },
 	{ "resolver-retry-interval", NULL, CFG_CLAUSEFLAG_ANCIENT },
@@ -2277,6 +2313,7 @@ static cfg_clausedef_t zone_clauses[] = {
 	{ "forwarders", &cfg_type_portiplist,
 	  CFG_ZONE_PRIMARY | CFG_ZONE_SECONDARY | CFG_ZONE_STUB |
 		  CFG_ZONE_STATICSTUB | CFG_ZONE_FORWARD },
+	{ "journal-group-commit", &cfg_type_boolean, CFG_ZONE_PRIMARY },
 	{ "key-directory", &cfg_type_qstring,
 	  CFG_ZONE_PRIMARY | CFG_ZONE_SECONDARY },
 	{ "maintain-ixfr-base", NULL, CFG_CLAUSEFLAG_ANCIENT },
@@ -2345,6 +2382,8 @@ static cfg_clausedef_t zone_clauses[] = {
 	{ "request-ixfr-max-diffs", &cfg_type_uint32,
 	  CFG_ZONE_SECONDARY | CFG_ZONE_MIRROR },
 	{ "serial-update-method", &cfg_type_updatemethod, CFG_ZONE_PRIMARY },
+	{ "share-identical-rrsets", &cfg_type_boolean,
+	  CFG_ZONE_PRIMARY | CFG_ZONE_SECONDARY | CFG_ZONE_MIRROR },
 	{ "sig-signing-nodes", &cfg_type_uint32,
 	  CFG_ZONE_PRIMARY | CFG_ZONE_SECONDARY },
 	{ "sig-signing-signatures", &cfg_type_uint32,
@@ -2361,6 +2400,7 @@ static cfg_clausedef_t zone_clauses[] = {
 	  CFG_ZONE_SECONDARY | CFG_ZONE_MIRROR | CFG_ZONE_STUB },
 	{ "try-tcp-refresh", &cfg_type_boolean,
 	  CFG_ZONE_SECONDARY | CFG_ZONE_MIRROR },
+	{ "update-batch-window", &cfg_type_uint32, CFG_ZONE_PRIMARY },
 	{ "update-check-ksk", &cfg_type_boolean,
 	  CFG_ZONE_PRIMARY | CFG_ZONE_SECONDARY | CFG_CLAUSEFLAG_OBSOLETE },
 	{ "use-alt-transfer-source", NULL,
@@ -2371,6 +2411,7 @@ static cfg_clausedef_t zone_clauses[] = {
 	{ "zone-statistics", &cfg_type_zonestat,
 	  CFG_ZONE_PRIMARY | CFG_ZONE_SECONDARY | CFG_ZONE_MIRROR |
 		  CFG_ZONE_STUB | CFG_ZONE_STATICSTUB | CFG_ZONE_REDIRECT },
+	{ "zone-update-quota", &cfg_type_uint32, CFG_ZONE_PRIMARY },
 	{ NULL, NULL, 0 }
 };
 
@@ -2414,6 +2455,10 @@ static cfg_clausedef_t zone_only_clauses[] = {
 	{ "ixfr-tmp-file", NULL, CFG_CLAUSEFLAG_ANCIENT },
 	{ "journal", &cfg_type_qstring,
 	  CFG_ZONE_PRIMARY | CFG_ZONE_SECONDARY | CFG_ZONE_MIRROR },
+	{ "journal-dump-ratio", &cfg_type_percentage,
+	  CFG_ZONE_SECONDARY | CFG_ZONE_MIRROR },
+	{ "load-on-demand", &cfg_type_boolean, CFG_ZONE_PRIMARY },
+	{ "load-on-demand-idle-time", &cfg_type_duration, CFG_ZONE_PRIMARY },
 	{ "log-report-channel", &cfg_type_boolean,
 	  CFG_ZONE_PRIMARY | CFG_ZONE_SECONDARY },
 	{ "masters", &cfg_type_namesockaddrkeylist,
@@ -3941,6 +3986,8 @@ static cfg_clausedef_t tls_clauses[] = {
 	{ "cipher-suites", &cfg_type_astring, 0 },
 	{ "prefer-server-ciphers", &cfg_type_boolean, 0 },
 	{ "session-tickets", &cfg_type_boolean, 0 },
+	{ "session-ticket-key-file", &cfg_type_qstring, 0 },
+	{ "session-ticket-rotation", &cfg_type_duration, 0 },
 	{ NULL, NULL, 0 }
 };
 
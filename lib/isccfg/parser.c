@@ -2555,6 +2555,11 @@ cfg_print_mapbody(cfg_printer_t *pctx, const cfg_obj_t *obj) {
 
 		for (clause = *clauseset; clause->name != NULL; clause++) {
 			isc_result_t result;
+			if ((pctx->flags & CFG_PRINTER_NOZONES) != 0 &&
+			    strcmp(clause->name, "zone") == 0)
+			{
+				continue;
+			}
 			result = isc_symtab_lookup(obj->value.map.symtab,
 						   clause->name, 0, &symval);
 			if (result == ISC_R_SUCCESS) {
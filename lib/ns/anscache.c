@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <isc/hash.h>
+#include <isc/hashmap.h>
+#include <isc/list.h>
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/util.h>
+
+#include <dns/db.h>
+#include <dns/view.h>
+
+#include <ns/anscache.h>
+
+#define ANSCACHE_MAGIC	  ISC_MAGIC('A', 'n', 's', 'C')
+#define VALID_ANSCACHE(c) ISC_MAGIC_VALID(c, ANSCACHE_MAGIC)
+
+#define ANSCACHE_HASH_BITS 10
+
+struct ns_anscache {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	isc_hashmap_t *entries;
+	ISC_LIST(ns_anscacheentry_t) lru; /* most recently used first */
+	unsigned int count;
+};
+
+static uint32_t
+key_hash(const ns_anscachekey_t *key) {
+	isc_hash32_t state;
+
+	isc_hash32_init(&state);
+	isc_hash32_hash(&state, &key->view, sizeof(key->view), true);
+	isc_hash32_hash(&state, &key->db, sizeof(key->db), true);
+	isc_hash32_hash(&state, &key->attributes, sizeof(key->attributes),
+			true);
+	isc_hash32_hash(&state, &key->flags, sizeof(key->flags), true);
+	isc_hash32_hash(&state, &key->udpsize, sizeof(key->udpsize), true);
+	isc_hash32_hash(&state, &key->qtype, sizeof(key->qtype), true);
+	isc_hash32_hash(&state, &key->qclass, sizeof(key->qclass), true);
+	isc_hash32_hash(&state, &key->family, sizeof(key->family), true);
+	isc_hash32_hash(&state, key->qname, key->qnamelen, true);
+
+	return isc_hash32_finalize(&state);
+}
+
+static bool
+key_match(void *node, const void *arg) {
+	const ns_anscacheentry_t *entry = node;
+	const ns_anscachekey_t *a = &entry->key;
+	const ns_anscachekey_t *b = arg;
+
+	return a->view == b->view && a->db == b->db &&
+	       a->attributes == b->attributes && a->flags == b->flags &&
+	       a->udpsize == b->udpsize && a->qtype == b->qtype &&
+	       a->qclass == b->qclass && a->family == b->family &&
+	       a->qnamelen == b->qnamelen &&
+	       memcmp(a->qname, b->qname, a->qnamelen) == 0;
+}
+
+static void
+entry_destroy(ns_anscache_t *cache, ns_anscacheentry_t *entry) {
+	isc_result_t result = isc_hashmap_delete(cache->entries,
+						 entry->hashval, key_match,
+						 &entry->key);
+	INSIST(result == ISC_R_SUCCESS);
+
+	ISC_LIST_UNLINK(cache->lru, entry, link);
+	cache->count--;
+
+	dns_view_weakdetach(&entry->key.view);
+	isc_mem_put(cache->mctx, entry->wire.base, entry->wire.length);
+	isc_mem_put(cache->mctx, entry, sizeof(*entry));
+}
+
+void
+ns_anscache_create(isc_mem_t *mctx, ns_anscache_t **cachep) {
+	ns_anscache_t *cache = NULL;
+
+	REQUIRE(cachep != NULL && *cachep == NULL);
+
+	cache = isc_mem_get(mctx, sizeof(*cache));
+	*cache = (ns_anscache_t){
+		.magic = ANSCACHE_MAGIC,
+		.lru = ISC_LIST_INITIALIZER,
+	};
+	isc_mem_attach(mctx, &cache->mctx);
+	isc_hashmap_create(cache->mctx, ANSCACHE_HASH_BITS, &cache->entries);
+
+	*cachep = cache;
+}
+
+void
+ns_anscache_destroy(ns_anscache_t **cachep) {
+	ns_anscache_t *cache = NULL;
+	ns_anscacheentry_t *entry = NULL;
+
+	REQUIRE(cachep != NULL && VALID_ANSCACHE(*cachep));
+
+	cache = *cachep;
+	*cachep = NULL;
+
+	while ((entry = ISC_LIST_HEAD(cache->lru)) != NULL) {
+		entry_destroy(cache, entry);
+	}
+	INSIST(cache->count == 0);
+
+	isc_hashmap_destroy(&cache->entries);
+	cache->magic = 0;
+	isc_mem_putanddetach(&cache->mctx, cache, sizeof(*cache));
+}
+
+void
+ns_anscache_initkey(ns_anscachekey_t *key, dns_view_t *view, dns_db_t *db,
+		    const dns_name_t *qname) {
+	REQUIRE(key != NULL);
+	REQUIRE(DNS_VIEW_VALID(view));
+	REQUIRE(DNS_DB_VALID(db));
+	REQUIRE(qname->length <= sizeof(key->qname));
+
+	*key = (ns_anscachekey_t){
+		.view = view,
+		.db = db,
+		.qnamelen = qname->length,
+	};
+	memmove(key->qname, qname->ndata, qname->length);
+}
+
+ns_anscacheentry_t *
+ns_anscache_find(ns_anscache_t *cache, const ns_anscachekey_t *key) {
+	ns_anscacheentry_t *entry = NULL;
+	isc_result_t result;
+
+	REQUIRE(VALID_ANSCACHE(cache));
+	REQUIRE(key != NULL);
+
+	result = isc_hashmap_find(cache->entries, key_hash(key), key_match,
+				  key, (void **)&entry);
+	if (result != ISC_R_SUCCESS) {
+		return NULL;
+	}
+
+	if (entry->generation != dns_db_generation()) {
+		entry_destroy(cache, entry);
+		return NULL;
+	}
+
+	ISC_LIST_UNLINK(cache->lru, entry, link);
+	ISC_LIST_PREPEND(cache->lru, entry, link);
+
+	return entry;
+}
+
+void
+ns_anscache_add(ns_anscache_t *cache, const ns_anscachekey_t *key,
+		uint64_t generation, const isc_region_t *wire,
+		const dns_name_t *rrlname, isc_result_t rrlresult,
+		isc_statscounter_t counter) {
+	ns_anscacheentry_t *entry = NULL;
+	ns_anscacheentry_t *found = NULL;
+	isc_result_t result;
+
+	REQUIRE(VALID_ANSCACHE(cache));
+	REQUIRE(key != NULL && DNS_VIEW_VALID(key->view));
+	REQUIRE(wire != NULL && wire->length > 0);
+
+	/*
+	 * Don't store anything the zones have moved on from.
+	 */
+	if (generation != dns_db_generation()) {
+		return;
+	}
+
+	entry = isc_mem_get(cache->mctx, sizeof(*entry));
+	*entry = (ns_anscacheentry_t){
+		.key = *key,
+		.hashval = key_hash(key),
+		.generation = generation,
+		.rrlresult = rrlresult,
+		.counter = counter,
+		.link = ISC_LINK_INITIALIZER,
+	};
+
+	result = isc_hashmap_add(cache->entries, entry->hashval, key_match,
+				 &entry->key, entry, (void **)&found);
+	if (result == ISC_R_EXISTS) {
+		/* Replace the old response */
+		entry_destroy(cache, found);
+		result = isc_hashmap_add(cache->entries, entry->hashval,
+					 key_match, &entry->key, entry, NULL);
+	}
+	INSIST(result == ISC_R_SUCCESS);
+
+	entry->key.view = NULL;
+	dns_view_weakattach(key->view, &entry->key.view);
+
+	entry->wire.base = isc_mem_get(cache->mctx, wire->length);
+	entry->wire.length = wire->length;
+	memmove(entry->wire.base, wire->base, wire->length);
+
+	dns_fixedname_init(&entry->rrlname);
+	if (rrlname != NULL) {
+		dns_name_copy(rrlname, dns_fixedname_name(&entry->rrlname));
+	}
+
+	ISC_LIST_PREPEND(cache->lru, entry, link);
+	cache->count++;
+
+	if (cache->count > NS_ANSCACHE_MAXENTRIES) {
+		entry_destroy(cache, ISC_LIST_TAIL(cache->lru));
+	}
+}
@@ -17,6 +17,7 @@
 
 #include <isc/async.h>
 #include <isc/atomic.h>
+#include <isc/endian.h>
 #include <isc/formatcheck.h>
 #include <isc/fuzz.h>
 #include <isc/hmac.h>
@@ -32,6 +33,7 @@
 #include <isc/string.h>
 #include <isc/thread.h>
 #include <isc/tid.h>
+#include <isc/time.h>
 #include <isc/timer.h>
 #include <isc/util.h>
 
@@ -56,13 +58,18 @@
 #include <dns/view.h>
 #include <dns/zone.h>
 
+#include <ns/anscache.h>
 #include <ns/client.h>
+#include <ns/hitters.h>
 #include <ns/interfacemgr.h>
 #include <ns/notify.h>
+#include <ns/querylog.h>
 #include <ns/server.h>
 #include <ns/stats.h>
 #include <ns/update.h>
 
+#include "probes.h"
+
 /***
  *** Client
  ***/
@@ -95,6 +102,13 @@
 #define TCP_CLIENT(c) (((c)->attributes & NS_CLIENTATTR_TCP) != 0)
 
 #define COOKIE_SIZE 24U /* 8 + 4 + 4 + 8 */
+
+/*
+ * A valid server cookie is returned unchanged to the client until it is
+ * this old (in seconds), as RFC 9018 allows, instead of being made anew
+ * for every response.
+ */
+#define COOKIE_REUSE_TIME 1800
 #define ECS_SIZE    20U /* 2 + 1 + 1 + [0..16] */
 
 #define USEKEEPALIVE(x) (((x)->attributes & NS_CLIENTATTR_USEKEEPALIVE) != 0)
@@ -176,6 +190,9 @@ ns_client_transport_type(const ns_client_t *client) {
 	case isc_nm_tcpsocket:
 	case isc_nm_tcplistener:
 		return DNS_TRANSPORT_TCP;
+	case isc_nm_xdpsocket:
+	case isc_nm_xdplistener:
+		/* Reported as UDP by isc_nm_socket_type() */
 	case isc_nm_maxsocket:
 	case isc_nm_nonesocket:
 		UNREACHABLE();
@@ -218,17 +235,175 @@ ns_client_settimeout(ns_client_t *client, unsigned int seconds) {
 	/* XXXWPK TODO use netmgr to set timeout */
 }
 
+void
+ns_client_latency(ns_client_t *client, ns_latency_t stage) {
+	isc_nanosecs_t now = isc_time_monotonic();
+
+	REQUIRE(NS_CLIENT_VALID(client));
+	REQUIRE(stage < ns_latency_total);
+
+	client->latency[stage] += now - client->latencymark;
+	client->latencymark = now;
+	client->latencystages |= 1 << stage;
+}
+
+/*%
+ * Write a query that has been answered to the binary query log.
+ */
+static void
+client_querylog_entry(ns_client_t *client, uint64_t latency) {
+	ns_server_t *sctx = client->manager->sctx;
+	dns_message_t *message = client->message;
+	dns_rdataset_t *rdataset = NULL;
+	ns_querylogentry_t entry;
+
+	if (!ns_querylog_binary(sctx->querylog) ||
+	    message->opcode != dns_opcode_query)
+	{
+		return;
+	}
+
+	entry = (ns_querylogentry_t){
+		.time = client->requesttime,
+		.latency = ISC_MIN(latency, UINT32_MAX),
+		.rcode = message->rcode,
+		.port = isc_sockaddr_getport(&client->peeraddr),
+		.qname = client->query.origqname != NULL
+				 ? client->query.origqname
+				 : client->query.qname,
+	};
+	if (entry.qname == NULL) {
+		return;
+	}
+
+	rdataset = ISC_LIST_HEAD(entry.qname->list);
+	if (rdataset != NULL) {
+		entry.qtype = rdataset->type;
+		entry.qclass = rdataset->rdclass;
+	}
+	isc_netaddr_fromsockaddr(&entry.address, &client->peeraddr);
+
+	if ((message->flags & DNS_MESSAGEFLAG_RD) != 0) {
+		entry.flags |= NS_QUERYLOG_FLAG_RECURSION;
+	}
+	if (client->ednsversion >= 0) {
+		entry.flags |= NS_QUERYLOG_FLAG_EDNS;
+	}
+	if (client->signer != NULL) {
+		entry.flags |= NS_QUERYLOG_FLAG_SIGNED;
+	}
+	if (TCP_CLIENT(client)) {
+		entry.flags |= NS_QUERYLOG_FLAG_TCP;
+	}
+	if ((client->extflags & DNS_MESSAGEEXTFLAG_DO) != 0) {
+		entry.flags |= NS_QUERYLOG_FLAG_DO;
+	}
+	if ((message->flags & DNS_MESSAGEFLAG_CD) != 0) {
+		entry.flags |= NS_QUERYLOG_FLAG_CD;
+	}
+	if ((client->attributes & NS_CLIENTATTR_HAVECOOKIE) != 0) {
+		entry.flags |= NS_QUERYLOG_FLAG_COOKIE;
+	} else if ((client->attributes & NS_CLIENTATTR_WANTCOOKIE) != 0) {
+		entry.flags |= NS_QUERYLOG_FLAG_NEWCOOKIE;
+	}
+
+	if (!ns_querylog_writeentry(sctx->querylog, &entry)) {
+		ns_stats_increment(sctx->nsstats,
+				   ns_statscounter_querylogdropped);
+	}
+}
+
+/*%
+ * Add the latencies of the stages the request went through, and of the
+ * whole request, to the histograms of the server.
+ */
+static void
+client_latency_done(ns_client_t *client) {
+	ns_server_t *sctx = client->manager->sctx;
+	uint64_t latency;
+
+	if (client->latencystart == 0) {
+		return;
+	}
+
+	for (size_t i = 0; i < ns_latency_total; i++) {
+		if ((client->latencystages & (1 << i)) != 0) {
+			isc_histomulti_inc(sctx->latency[i],
+					   client->latency[i] / NS_PER_US);
+		}
+	}
+	latency = (isc_time_monotonic() - client->latencystart) / NS_PER_US;
+	isc_histomulti_inc(sctx->latency[ns_latency_total], latency);
+	client_querylog_entry(client, latency);
+
+	if (client->message->rcode == dns_rcode_nxdomain) {
+		isc_netaddr_t netaddr;
+		isc_netaddr_fromsockaddr(&netaddr, &client->peeraddr);
+		ns_hitters_addnxdomain(sctx->hitters, &netaddr);
+	}
+
+	if (LIBNS_REQUEST_DONE_ENABLED()) {
+		const dns_name_t *qname = client->query.origqname != NULL
+						  ? client->query.origqname
+						  : client->query.qname;
+
+		LIBNS_REQUEST_DONE(client,
+				   qname != NULL ? qname->ndata : NULL,
+				   qname != NULL ? qname->length : 0,
+				   client->query.qtype, client->message->rcode,
+				   latency);
+	}
+
+	memset(client->latency, 0, sizeof(client->latency));
+	client->latencystages = 0;
+	client->latencystart = 0;
+}
+
+/*
+ * Allocate memory that is freed at the end of the request, from the
+ * client's arena if it fits, or from the memory context otherwise.
+ */
+static void *
+client_arena_get(ns_client_t *client, size_t size) {
+	size_t used = ISC_ALIGN(client->arena_used, sizeof(void *));
+
+	if (size <= sizeof(client->arena) - used) {
+		client->arena_used = used + size;
+		return client->arena + used;
+	}
+
+	return isc_mem_get(client->manager->mctx, size);
+}
+
+static void
+client_arena_put(ns_client_t *client, void *ptr, size_t size) {
+	uint8_t *p = ptr;
+
+	if (p >= client->arena && p < client->arena + sizeof(client->arena)) {
+		return;
+	}
+
+	isc_mem_put(client->manager->mctx, ptr, size);
+}
+
 static void
 client_extendederror_reset(ns_client_t *client) {
 	if (client->ede == NULL) {
 		return;
 	}
-	isc_mem_put(client->manager->mctx, client->ede->value,
-		    client->ede->length);
-	isc_mem_put(client->manager->mctx, client->ede, sizeof(dns_ednsopt_t));
+	client_arena_put(client, client->ede->value, client->ede->length);
+	client_arena_put(client, client->ede, sizeof(dns_ednsopt_t));
 	client->ede = NULL;
 }
 
+static void
+client_aclcache_reset(ns_client_t *client) {
+	for (unsigned int i = 0; i < client->naclcache; i++) {
+		dns_acl_detach(&client->aclcache[i].acl);
+	}
+	client->naclcache = 0;
+}
+
 void
 ns_client_extendederror(ns_client_t *client, uint16_t code, const char *text) {
 	unsigned char ede[DNS_EDE_EXTRATEXT_LEN + 2];
@@ -262,10 +437,10 @@ ns_client_extendederror(ns_client_t *client, uint16_t code, const char *text) {
 		}
 	}
 
-	client->ede = isc_mem_get(client->manager->mctx, sizeof(dns_ednsopt_t));
+	client->ede = client_arena_get(client, sizeof(dns_ednsopt_t));
 	client->ede->code = DNS_OPT_EDE;
 	client->ede->length = len;
-	client->ede->value = isc_mem_get(client->manager->mctx, len);
+	client->ede->value = client_arena_get(client, len);
 	memmove(client->ede->value, ede, len);
 }
 
@@ -276,6 +451,8 @@ ns_client_endrequest(ns_client_t *client) {
 
 	CTRACE("endrequest");
 
+	client_latency_done(client);
+
 	if (client->state == NS_CLIENTSTATE_RECURSING) {
 		LOCK(&client->manager->reclock);
 		if (ISC_LINK_LINKED(client, rlink)) {
@@ -301,8 +478,14 @@ ns_client_endrequest(ns_client_t *client) {
 			}
 		}
 #endif /* ifdef ENABLE_AFL */
+		if (client->view->resolver != NULL) {
+			dns_resolver_addstats(client->view->resolver,
+					      dns_resstatscounter_querycpu,
+					      client->cputime);
+		}
 		dns_view_detach(&client->view);
 	}
+	client->cputime = 0;
 	if (client->opt != NULL) {
 		INSIST(dns_rdataset_isassociated(client->opt));
 		dns_rdataset_disassociate(client->opt);
@@ -310,6 +493,7 @@ ns_client_endrequest(ns_client_t *client) {
 	}
 
 	client_extendederror_reset(client);
+	client_aclcache_reset(client);
 	client->signer = NULL;
 	client->udpsize = 512;
 	client->extflags = 0;
@@ -358,6 +542,8 @@ client_senddone(isc_nmhandle_t *handle, isc_result_t result, void *cbarg) {
 
 	CTRACE("senddone");
 
+	ns_client_latency(client, ns_latency_send);
+
 	/*
 	 * Set sendhandle to NULL, but don't detach it immediately, in
 	 * case we need to retry the send. If we do resend, then
@@ -387,6 +573,54 @@ client_senddone(isc_nmhandle_t *handle, isc_result_t result, void *cbarg) {
 	isc_nmhandle_detach(&handle);
 }
 
+/*%
+ * Size classes of the buffers holding TCP responses larger than
+ * NS_CLIENT_SEND_BUFFER_SIZE.
+ */
+static const size_t sendbuf_sizes[NS_CLIENT_SENDBUF_CLASSES] = {
+	8192,
+	16384,
+	32768,
+	NS_CLIENT_TCP_BUFFER_SIZE,
+};
+
+static unsigned int
+sendbuf_class(size_t size) {
+	for (unsigned int i = 0; i < NS_CLIENT_SENDBUF_CLASSES; i++) {
+		if (size <= sendbuf_sizes[i]) {
+			return i;
+		}
+	}
+	UNREACHABLE();
+}
+
+static unsigned char *
+clientmgr_getsendbuf(ns_clientmgr_t *manager, size_t size, size_t *sizep) {
+	unsigned int i = sendbuf_class(size);
+
+	*sizep = sendbuf_sizes[i];
+	if (manager->nsendbufs[i] > 0) {
+		return manager->sendbufs[i][--manager->nsendbufs[i]];
+	}
+
+	return isc_mem_get(manager->mctx, sendbuf_sizes[i]);
+}
+
+static void
+clientmgr_putsendbuf(ns_clientmgr_t *manager, unsigned char *buf,
+		     size_t size) {
+	unsigned int i = sendbuf_class(size);
+
+	INSIST(size == sendbuf_sizes[i]);
+
+	if (manager->nsendbufs[i] < NS_CLIENT_SENDBUF_POOLSIZE) {
+		manager->sendbufs[i][manager->nsendbufs[i]++] = buf;
+		return;
+	}
+
+	isc_mem_put(manager->mctx, buf, size);
+}
+
 static void
 client_setup_tcp_buffer(ns_client_t *client) {
 	REQUIRE(client->tcpbuf == NULL);
@@ -402,8 +636,8 @@ client_put_tcp_buffer(ns_client_t *client) {
 	}
 
 	if (client->tcpbuf != client->manager->tcp_buffer) {
-		isc_mem_put(client->manager->mctx, client->tcpbuf,
-			    client->tcpbuf_size);
+		clientmgr_putsendbuf(client->manager, client->tcpbuf,
+				     client->tcpbuf_size);
 	}
 
 	client->tcpbuf = NULL;
@@ -463,11 +697,12 @@ client_sendpkg(ns_client_t *client, isc_buffer_t *buffer) {
 		 */
 		if (used > NS_CLIENT_SEND_BUFFER_SIZE) {
 			/*
-			 * We can save space by allocating a new buffer with a
-			 * correct size and freeing the big buffer.
+			 * We can save space by taking a buffer of the
+			 * nearest size class from the manager's pool.
 			 */
-			unsigned char *new_tcpbuf =
-				isc_mem_get(client->manager->mctx, used);
+			size_t size;
+			unsigned char *new_tcpbuf = clientmgr_getsendbuf(
+				client->manager, used, &size);
 			memmove(new_tcpbuf, buffer->base, used);
 
 			/*
@@ -480,7 +715,7 @@ client_sendpkg(ns_client_t *client, isc_buffer_t *buffer) {
 			 * Keep the new buffer's information so it can be freed.
 			 */
 			client->tcpbuf = new_tcpbuf;
-			client->tcpbuf_size = used;
+			client->tcpbuf_size = size;
 
 			r.base = new_tcpbuf;
 		} else {
@@ -528,6 +763,8 @@ ns_client_sendraw(ns_client_t *client, dns_message_t *message) {
 
 	CTRACE("sendraw");
 
+	ns_client_latency(client, ns_latency_lookup);
+
 	mr = dns_message_getrawmessage(message);
 	if (mr == NULL) {
 		result = ISC_R_UNEXPECTEDEND;
@@ -580,6 +817,239 @@ done:
 	ns_client_drop(client, result);
 }
 
+void
+ns_client_sendcached(ns_client_t *client, const isc_region_t *wire) {
+	isc_result_t result;
+	unsigned char *data = NULL;
+	isc_buffer_t buffer;
+	isc_region_t r;
+	dns_compress_t cctx;
+	bool opt_included = false;
+	dns_rcode_t rcode;
+	size_t respsize;
+#ifdef HAVE_DNSTAP
+	unsigned char zone[DNS_NAME_MAXWIRE];
+	dns_transport_type_t transport_type;
+	dns_dtmsgtype_t dtmsgtype;
+	isc_region_t zr;
+#endif /* HAVE_DNSTAP */
+
+	REQUIRE(NS_CLIENT_VALID(client));
+	REQUIRE(!TCP_CLIENT(client));
+	REQUIRE(wire != NULL && wire->length >= DNS_MESSAGE_HEADERLEN);
+
+	CTRACE("sendcached");
+
+	ns_client_latency(client, ns_latency_lookup);
+
+	if ((client->attributes & NS_CLIENTATTR_WANTOPT) != 0) {
+		result = ns_client_addopt(client, client->message,
+					  &client->opt);
+		if (result != ISC_R_SUCCESS) {
+			goto done;
+		}
+	}
+
+	client_allocsendbuf(client, &buffer, &data);
+
+	if (wire->length > isc_buffer_length(&buffer)) {
+		result = ISC_R_NOSPACE;
+		goto done;
+	}
+
+	/*
+	 * Copy the response to the buffer, fixup the id, and append the
+	 * OPT record for this client.
+	 */
+	isc_buffer_availableregion(&buffer, &r);
+	isc_buffer_putmem(&buffer, wire->base, wire->length);
+	r.base[0] = (client->message->id >> 8) & 0xff;
+	r.base[1] = client->message->id & 0xff;
+	rcode = r.base[3] & 0x0f; /* the low bits of the RCODE */
+
+	dns_compress_init(&cctx, client->manager->mctx, DNS_COMPRESS_DISABLED);
+	if (client->opt != NULL) {
+		unsigned int count = 0;
+
+		result = dns_rdataset_towire(client->opt, dns_rootname, &cctx,
+					     &buffer, 0, &count);
+		dns_rdataset_disassociate(client->opt);
+		dns_message_puttemprdataset(client->message, &client->opt);
+		if (result != ISC_R_SUCCESS) {
+			dns_compress_invalidate(&cctx);
+			goto done;
+		}
+		opt_included = true;
+	}
+
+#ifdef HAVE_DNSTAP
+	memset(&zr, 0, sizeof(zr));
+	if ((r.base[2] & (DNS_MESSAGEFLAG_AA >> 8)) != 0 &&
+	    client->query.authzone != NULL)
+	{
+		isc_result_t eresult;
+		isc_buffer_t b;
+		dns_name_t *zo = dns_zone_getorigin(client->query.authzone);
+
+		isc_buffer_init(&b, zone, sizeof(zone));
+		eresult = dns_name_towire(zo, &cctx, &b, NULL);
+		if (eresult == ISC_R_SUCCESS) {
+			isc_buffer_usedregion(&b, &zr);
+		}
+	}
+
+	if ((client->message->flags & DNS_MESSAGEFLAG_RD) != 0) {
+		dtmsgtype = DNS_DTTYPE_CR;
+	} else {
+		dtmsgtype = DNS_DTTYPE_AR;
+	}
+
+	transport_type = ns_client_transport_type(client);
+
+	if (client->view != NULL) {
+		dns_dt_send(client->view, dtmsgtype, &client->peeraddr,
+			    &client->destsockaddr, transport_type, &zr,
+			    &client->requesttime, NULL, &buffer);
+	}
+#endif /* HAVE_DNSTAP */
+
+	dns_compress_invalidate(&cctx);
+
+	respsize = isc_buffer_usedlength(&buffer);
+
+	client_sendpkg(client, &buffer);
+
+	switch (isc_sockaddr_pf(&client->peeraddr)) {
+	case AF_INET:
+		isc_histomulti_inc(client->manager->sctx->udpoutstats4,
+				   DNS_SIZEHISTO_BUCKETOUT(respsize));
+		break;
+	case AF_INET6:
+		isc_histomulti_inc(client->manager->sctx->udpoutstats6,
+				   DNS_SIZEHISTO_BUCKETOUT(respsize));
+		break;
+	default:
+		UNREACHABLE();
+	}
+
+	ns_stats_increment(client->manager->sctx->nsstats,
+			   ns_statscounter_response);
+	dns_rcodestats_increment(client->manager->sctx->rcodestats, rcode);
+	if (opt_included) {
+		ns_stats_increment(client->manager->sctx->nsstats,
+				   ns_statscounter_edns0out);
+	}
+
+	client->query.attributes |= NS_QUERYATTR_ANSWERED;
+
+	return;
+done:
+	if (client->opt != NULL) {
+		dns_rdataset_disassociate(client->opt);
+		dns_message_puttemprdataset(client->message, &client->opt);
+	}
+
+	ns_client_drop(client, result);
+}
+
+/*%
+ * Returns true if any rdataset in the response would be shuffled when
+ * rendered, so that a stored copy of the response would pin the order.
+ */
+static bool
+client_shuffled(dns_message_t *message) {
+	for (dns_section_t section = DNS_SECTION_ANSWER;
+	     section < DNS_SECTION_MAX; section++)
+	{
+		dns_name_t *name = NULL;
+
+		ISC_LIST_FOREACH (message->sections[section], name, link) {
+			dns_rdataset_t *rdataset = NULL;
+
+			ISC_LIST_FOREACH (name->list, rdataset, link) {
+				if ((rdataset->attributes &
+				     (DNS_RDATASETATTR_RANDOMIZE |
+				      DNS_RDATASETATTR_CYCLIC)) != 0 &&
+				    rdataset->type != dns_rdatatype_rrsig &&
+				    dns_rdataset_count(rdataset) > 1)
+				{
+					return true;
+				}
+			}
+		}
+	}
+
+	return false;
+}
+
+/*%
+ * Store the rendered response in 'buffer' in the response cache, less the
+ * OPT record, if the query was marked as cacheable by query.c.
+ */
+static void
+client_anscache_store(ns_client_t *client, isc_buffer_t *buffer) {
+	dns_message_t *message = client->message;
+	dns_name_t *rrlname = NULL;
+	isc_region_t r;
+
+	if ((client->query.attributes & NS_QUERYATTR_ANSCACHE) == 0) {
+		return;
+	}
+
+	if ((message->flags & DNS_MESSAGEFLAG_TC) != 0 ||
+	    (message->rcode != dns_rcode_noerror &&
+	     message->rcode != dns_rcode_nxdomain) ||
+	    client->ede != NULL ||
+	    (client->attributes & NS_CLIENTATTR_HAVEEXPIRE) != 0 ||
+	    client_shuffled(message))
+	{
+		return;
+	}
+
+	/*
+	 * The rate limiting has to be repeated when the response is
+	 * reused, so it's not stored if we don't know how it was done.
+	 */
+	if (client->query.anscache.rrlresult != ISC_R_UNSET) {
+		rrlname = dns_fixedname_name(&client->query.anscache.rrlname);
+	} else if (client->view->rrl != NULL) {
+		return;
+	}
+
+	isc_buffer_usedregion(buffer, &r);
+
+	if (message->opt != NULL) {
+		dns_rdata_t rdata = DNS_RDATA_INIT;
+		unsigned int optlen;
+
+		if (dns_rdataset_first(message->opt) != ISC_R_SUCCESS) {
+			return;
+		}
+		dns_rdataset_current(message->opt, &rdata);
+
+		/*
+		 * The OPT record was rendered last: a root owner name,
+		 * the type, the class, the TTL and the RDLENGTH.
+		 */
+		optlen = 11 + rdata.length;
+		if (r.length < DNS_MESSAGE_HEADERLEN + optlen) {
+			return;
+		}
+		r.length -= optlen;
+		if (r.base[r.length] != 0 ||
+		    r.base[r.length + 1] != (dns_rdatatype_opt >> 8) ||
+		    r.base[r.length + 2] != (dns_rdatatype_opt & 0xff))
+		{
+			return;
+		}
+	}
+
+	ns_anscache_add(client->manager->anscache, &client->query.anscache.key,
+			client->query.anscache.generation, &r, rrlname,
+			client->query.anscache.rrlresult,
+			client->query.anscache.counter);
+}
+
 void
 ns_client_send(ns_client_t *client) {
 	isc_result_t result;
@@ -616,6 +1086,8 @@ ns_client_send(ns_client_t *client) {
 
 	CTRACE("send");
 
+	ns_client_latency(client, ns_latency_lookup);
+
 	if (client->message->opcode == dns_opcode_query &&
 	    (client->attributes & NS_CLIENTATTR_RA) != 0)
 	{
@@ -740,6 +1212,10 @@ renderend:
 		goto cleanup;
 	}
 
+	ns_client_latency(client, ns_latency_render);
+
+	client_anscache_store(client, &buffer);
+
 #ifdef HAVE_DNSTAP
 	memset(&zr, 0, sizeof(zr));
 	if (((client->message->flags & DNS_MESSAGEFLAG_AA) != 0) &&
@@ -1129,7 +1605,17 @@ ns_client_addopt(ns_client_t *client, dns_message_t *message,
 		count++;
 	}
 no_nsid:
-	if ((client->attributes & NS_CLIENTATTR_WANTCOOKIE) != 0) {
+	if ((client->attributes & NS_CLIENTATTR_REUSECOOKIE) != 0) {
+		memmove(cookie, client->cookie, sizeof(client->cookie));
+		memmove(cookie + sizeof(client->cookie), client->servercookie,
+			sizeof(client->servercookie));
+
+		INSIST(count < DNS_EDNSOPTIONS);
+		ednsopts[count].code = DNS_OPT_COOKIE;
+		ednsopts[count].length = COOKIE_SIZE;
+		ednsopts[count].value = cookie;
+		count++;
+	} else if ((client->attributes & NS_CLIENTATTR_WANTCOOKIE) != 0) {
 		isc_buffer_t buf;
 		isc_stdtime_t now = isc_stdtime_now();
 
@@ -1328,14 +1814,82 @@ compute_cookie(ns_client_t *client, uint32_t when, const unsigned char *secret,
 	}
 }
 
+/*
+ * The hash at the end of a server cookie is unpredictable without the
+ * secret, so it can index the cache directly.
+ */
+static ns_cookiecache_entry_t *
+cookiecache_entry(ns_client_t *client, const unsigned char *cookie) {
+	STATIC_ASSERT((NS_CLIENT_COOKIECACHE_SIZE &
+		       (NS_CLIENT_COOKIECACHE_SIZE - 1)) == 0,
+		      "NS_CLIENT_COOKIECACHE_SIZE must be a power of 2");
+	uint32_t hash = ISC_U8TO32_LE(cookie + COOKIE_SIZE - 4);
+
+	return &client->manager
+			->cookiecache[hash & (NS_CLIENT_COOKIECACHE_SIZE - 1)];
+}
+
+/*
+ * Look for a server cookie verified recently for the same client, and
+ * return whether it was made with the primary secret.
+ */
+static bool
+cookiecache_find(ns_client_t *client, const isc_netaddr_t *netaddr,
+		 const unsigned char *cookie, bool *primaryp) {
+	ns_cookiecache_entry_t *entry = cookiecache_entry(client, cookie);
+	uint32_t gen = atomic_load_acquire(&client->manager->sctx->cookiegen);
+
+	if (entry->gen != gen || !isc_netaddr_equal(&entry->addr, netaddr) ||
+	    memcmp(entry->cookie, cookie, COOKIE_SIZE) != 0)
+	{
+		return false;
+	}
+
+	*primaryp = entry->primary;
+	return true;
+}
+
+static void
+cookiecache_add(ns_client_t *client, const isc_netaddr_t *netaddr,
+		const unsigned char *cookie, bool primary) {
+	ns_cookiecache_entry_t *entry = cookiecache_entry(client, cookie);
+
+	entry->addr = *netaddr;
+	memmove(entry->cookie, cookie, COOKIE_SIZE);
+	entry->gen = atomic_load_acquire(&client->manager->sctx->cookiegen);
+	entry->primary = primary;
+}
+
+/*
+ * The client has presented a valid cookie: if it was made with the
+ * primary secret and is fresh enough, it can be sent back as it is.
+ */
+static void
+cookie_match(ns_client_t *client, const unsigned char *cookie, bool primary,
+	     uint32_t when, isc_stdtime_t now) {
+	ns_stats_increment(client->manager->sctx->nsstats,
+			   ns_statscounter_cookiematch);
+	client->attributes |= NS_CLIENTATTR_HAVECOOKIE;
+
+	if (primary && isc_serial_le(when, now) &&
+	    isc_serial_gt(when, now - COOKIE_REUSE_TIME))
+	{
+		memmove(client->servercookie, cookie + sizeof(client->cookie),
+			sizeof(client->servercookie));
+		client->attributes |= NS_CLIENTATTR_REUSECOOKIE;
+	}
+}
+
 static void
 process_cookie(ns_client_t *client, isc_buffer_t *buf, size_t optlen) {
 	ns_altsecret_t *altsecret;
 	unsigned char dbuf[COOKIE_SIZE];
 	unsigned char *old;
+	isc_netaddr_t netaddr;
 	isc_stdtime_t now;
 	uint32_t when;
 	isc_buffer_t db;
+	bool primary;
 
 	/*
 	 * If we have already seen a cookie option skip this cookie option.
@@ -1395,13 +1949,18 @@ process_cookie(ns_client_t *client, isc_buffer_t *buf, size_t optlen) {
 		return;
 	}
 
+	isc_netaddr_fromsockaddr(&netaddr, &client->peeraddr);
+	if (cookiecache_find(client, &netaddr, old, &primary)) {
+		cookie_match(client, old, primary, when, now);
+		return;
+	}
+
 	isc_buffer_init(&db, dbuf, sizeof(dbuf));
 	compute_cookie(client, when, client->manager->sctx->secret, &db);
 
 	if (isc_safe_memequal(old, dbuf, COOKIE_SIZE)) {
-		ns_stats_increment(client->manager->sctx->nsstats,
-				   ns_statscounter_cookiematch);
-		client->attributes |= NS_CLIENTATTR_HAVECOOKIE;
+		cookiecache_add(client, &netaddr, old, true);
+		cookie_match(client, old, true, when, now);
 		return;
 	}
 
@@ -1411,9 +1970,8 @@ process_cookie(ns_client_t *client, isc_buffer_t *buf, size_t optlen) {
 		isc_buffer_init(&db, dbuf, sizeof(dbuf));
 		compute_cookie(client, when, altsecret->secret, &db);
 		if (isc_safe_memequal(old, dbuf, COOKIE_SIZE)) {
-			ns_stats_increment(client->manager->sctx->nsstats,
-					   ns_statscounter_cookiematch);
-			client->attributes |= NS_CLIENTATTR_HAVECOOKIE;
+			cookiecache_add(client, &netaddr, old, false);
+			cookie_match(client, old, false, when, now);
 			return;
 		}
 	}
@@ -1555,7 +2113,7 @@ process_keytag(ns_client_t *client, isc_buffer_t *buf, size_t optlen) {
 		return ISC_R_SUCCESS;
 	}
 
-	client->keytag = isc_mem_get(client->manager->mctx, optlen);
+	client->keytag = client_arena_get(client, optlen);
 	{
 		client->keytag_len = (uint16_t)optlen;
 		memmove(client->keytag, isc_buffer_current(buf), optlen);
@@ -1727,10 +2285,11 @@ ns__client_reset_cb(void *client0) {
 	}
 
 	if (client->keytag != NULL) {
-		isc_mem_put(client->manager->mctx, client->keytag,
-			    client->keytag_len);
+		client_arena_put(client, client->keytag, client->keytag_len);
+		client->keytag = NULL;
 		client->keytag_len = 0;
 	}
+	client->arena_used = 0;
 
 	ns_client_async_reset(client);
 
@@ -1741,23 +2300,14 @@ ns__client_reset_cb(void *client0) {
 #endif /* WANT_SINGLETRACE */
 }
 
-void
-ns__client_put_cb(void *client0) {
-	ns_client_t *client = client0;
-	ns_clientmgr_t *manager = NULL;
-
-	REQUIRE(NS_CLIENT_VALID(client));
-
-	manager = client->manager;
-
-	ns_client_log(client, DNS_LOGCATEGORY_SECURITY, NS_LOGMODULE_CLIENT,
-		      ISC_LOG_DEBUG(3), "freeing client");
-
+static void
+client_free(ns_client_t *client) {
 	/*
 	 * Call this first because it requires a valid client.
 	 */
 	ns_query_free(client);
 	client_extendederror_reset(client);
+	client_aclcache_reset(client);
 
 	client->magic = 0;
 
@@ -1777,11 +2327,70 @@ ns__client_put_cb(void *client0) {
 	 */
 	isc_mutex_destroy(&client->query.fetchlock);
 
-	isc_mem_put(manager->mctx, client, sizeof(*client));
+	isc_mem_put(client->manager->mctx, client, sizeof(*client));
+}
+
+void
+ns__client_put_cb(void *client0) {
+	ns_client_t *client = client0;
+	ns_clientmgr_t *manager = NULL;
+
+	REQUIRE(NS_CLIENT_VALID(client));
+
+	manager = client->manager;
+
+	/*
+	 * The client has been reset, so it is in the same state as the
+	 * ones reused by the handles: keep it for the next connection
+	 * unless the pool is full.  The pooled clients don't hold a
+	 * reference to the manager, which frees them when destroyed.
+	 */
+	if (manager->tid == (uint32_t)isc_tid() &&
+	    manager->nfreeclients < atomic_load_relaxed(&manager->poolmax))
+	{
+		ns_client_log(client, DNS_LOGCATEGORY_SECURITY,
+			      NS_LOGMODULE_CLIENT, ISC_LOG_DEBUG(3),
+			      "pooling client");
+		ISC_LIST_PREPEND(manager->freeclients, client, freelink);
+		manager->nfreeclients++;
+	} else {
+		ns_client_log(client, DNS_LOGCATEGORY_SECURITY,
+			      NS_LOGMODULE_CLIENT, ISC_LOG_DEBUG(3),
+			      "freeing client");
+		client_free(client);
+	}
 
 	ns_clientmgr_detach(&manager);
 }
 
+/*
+ * Get a client for a new handle, from the pool if there is one.
+ */
+static ns_client_t *
+clientmgr_getclient(ns_clientmgr_t *manager) {
+	ns_client_t *client = ISC_LIST_HEAD(manager->freeclients);
+
+	if (client != NULL) {
+		ISC_LIST_UNLINK(manager->freeclients, client, freelink);
+		manager->nfreeclients--;
+		client->manager = ns_clientmgr_ref(manager);
+		ns__client_setup(client, NULL, false);
+		ns_stats_increment(manager->sctx->nsstats,
+				   ns_statscounter_clientpoolhit);
+		return client;
+	}
+
+	client = isc_mem_get(manager->mctx, sizeof(*client));
+	ns__client_setup(client, manager, true);
+	ns_stats_increment(manager->sctx->nsstats,
+			   ns_statscounter_clientpoolmiss);
+
+	ns_client_log(client, DNS_LOGCATEGORY_SECURITY, NS_LOGMODULE_CLIENT,
+		      ISC_LOG_DEBUG(3), "allocate new client");
+
+	return client;
+}
+
 static isc_result_t
 ns_client_setup_view(ns_client_t *client, isc_netaddr_t *netaddr) {
 	isc_result_t result;
@@ -1822,9 +2431,9 @@ ns_client_setup_view(ns_client_t *client, isc_netaddr_t *netaddr) {
  * Handle an incoming request event from the socket (UDP case)
  * or tcpmsg (TCP case).
  */
-void
-ns_client_request(isc_nmhandle_t *handle, isc_result_t eresult,
-		  isc_region_t *region, void *arg) {
+static void
+client_request(isc_nmhandle_t *handle, isc_result_t eresult,
+	       isc_region_t *region, void *arg) {
 	ns_client_t *client = NULL;
 	isc_result_t result;
 	dns_rdataset_t *opt = NULL;
@@ -1849,13 +2458,7 @@ ns_client_request(isc_nmhandle_t *handle, isc_result_t eresult,
 		INSIST(VALID_MANAGER(clientmgr));
 		INSIST(clientmgr->tid == isc_tid());
 
-		client = isc_mem_get(clientmgr->mctx, sizeof(*client));
-
-		ns__client_setup(client, clientmgr, true);
-
-		ns_client_log(client, DNS_LOGCATEGORY_SECURITY,
-			      NS_LOGMODULE_CLIENT, ISC_LOG_DEBUG(3),
-			      "allocate new client");
+		client = clientmgr_getclient(clientmgr);
 	} else {
 		ns__client_setup(client, NULL, false);
 	}
@@ -1890,6 +2493,8 @@ ns_client_request(isc_nmhandle_t *handle, isc_result_t eresult,
 	client->requesttime = isc_time_now();
 	client->tnow = client->requesttime;
 	client->now = isc_time_seconds(&client->tnow);
+	client->latencystart = isc_time_monotonic();
+	client->latencymark = client->latencystart;
 
 	isc_netaddr_fromsockaddr(&netaddr, &client->peeraddr);
 
@@ -1997,7 +2602,8 @@ ns_client_request(isc_nmhandle_t *handle, isc_result_t eresult,
 	/*
 	 * It's a request.  Parse it.
 	 */
-	result = dns_message_parse(client->message, client->buffer, 0);
+	result = dns_message_parse(client->message, client->buffer,
+				   DNS_MESSAGEPARSE_DEFER);
 	if (result != ISC_R_SUCCESS) {
 		/*
 		 * Parsing the request failed.  Send a response
@@ -2019,6 +2625,8 @@ ns_client_request(isc_nmhandle_t *handle, isc_result_t eresult,
 		return;
 	}
 
+	ns_client_latency(client, ns_latency_parse);
+
 	dns_opcodestats_increment(client->manager->sctx->opcodestats,
 				  client->message->opcode);
 	switch (client->message->opcode) {
@@ -2142,6 +2750,29 @@ ns_client_request(isc_nmhandle_t *handle, isc_result_t eresult,
 	ns_client_request_continue(client);
 }
 
+void
+ns_client_request(isc_nmhandle_t *handle, isc_result_t eresult,
+		  isc_region_t *region, void *arg) {
+	ns_client_t *client = NULL;
+	isc_nanosecs_t start;
+
+	if (eresult != ISC_R_SUCCESS) {
+		return;
+	}
+
+	/*
+	 * The netmgr holds the handle, and so the client, until this
+	 * returns; the time is charged to the view when the request ends.
+	 */
+	start = isc_time_threadcpu();
+	client_request(handle, eresult, region, arg);
+
+	client = isc_nmhandle_getdata(handle);
+	if (client != NULL) {
+		client->cputime += isc_time_threadcpu() - start;
+	}
+}
+
 static void
 ns_client_request_continue(void *arg) {
 	ns_client_t *client = arg;
@@ -2173,6 +2804,8 @@ ns_client_request_continue(void *arg) {
 
 	INSIST(client->viewmatchresult != ISC_R_UNSET);
 
+	ns_client_latency(client, ns_latency_view);
+
 	/*
 	 * This function could be running asynchronously, in which case update
 	 * the current 'now' for correct timekeeping.
@@ -2542,6 +3175,7 @@ ns__client_setup(ns_client_t *client, ns_clientmgr_t *mgr, bool new) {
 		*client = (ns_client_t){ .magic = 0 };
 
 		ns_clientmgr_attach(mgr, &client->manager);
+		ISC_LINK_INIT(client, freelink);
 
 		dns_message_create(client->manager->mctx,
 				   client->manager->namepool,
@@ -2581,6 +3215,7 @@ ns__client_setup(ns_client_t *client, ns_clientmgr_t *mgr, bool new) {
 	client->formerrcache.time = 0;
 	client->formerrcache.id = 0;
 	ISC_LINK_INIT(client, rlink);
+	ISC_LINK_INIT(client, freelink);
 	client->rcode_override = -1; /* not set */
 
 	client->magic = NS_CLIENT_MAGIC;
@@ -2592,11 +3227,64 @@ ns__client_setup(ns_client_t *client, ns_clientmgr_t *mgr, bool new) {
  *** Client Manager
  ***/
 
+static void
+clientmgr_trimpool(ns_clientmgr_t *manager, uint32_t max) {
+	while (manager->nfreeclients > max) {
+		ns_client_t *client = ISC_LIST_TAIL(manager->freeclients);
+
+		ISC_LIST_UNLINK(manager->freeclients, client, freelink);
+		manager->nfreeclients--;
+		client_free(client);
+	}
+}
+
+static void
+clientmgr_fillpool_cb(void *arg) {
+	ns_clientmgr_t *manager = (ns_clientmgr_t *)arg;
+	uint32_t initial = atomic_load_relaxed(&manager->poolinitial);
+	uint32_t max = atomic_load_relaxed(&manager->poolmax);
+
+	clientmgr_trimpool(manager, max);
+
+	while (manager->nfreeclients < ISC_MIN(initial, max)) {
+		ns_client_t *client = isc_mem_get(manager->mctx,
+						  sizeof(*client));
+		ns__client_setup(client, manager, true);
+		ns_clientmgr_unref(manager);
+		ISC_LIST_APPEND(manager->freeclients, client, freelink);
+		manager->nfreeclients++;
+	}
+
+	ns_clientmgr_detach(&manager);
+}
+
+void
+ns_clientmgr_setpool(ns_clientmgr_t *manager, uint32_t initial,
+		     uint32_t max) {
+	REQUIRE(VALID_MANAGER(manager));
+
+	atomic_store_relaxed(&manager->poolinitial, initial);
+	atomic_store_relaxed(&manager->poolmax, max);
+
+	isc_async_run(manager->loop, clientmgr_fillpool_cb,
+		      ns_clientmgr_ref(manager));
+}
+
 static void
 clientmgr_destroy_cb(void *arg) {
 	ns_clientmgr_t *manager = (ns_clientmgr_t *)arg;
 	MTRACE("clientmgr_destroy");
 
+	clientmgr_trimpool(manager, 0);
+
+	for (unsigned int i = 0; i < NS_CLIENT_SENDBUF_CLASSES; i++) {
+		while (manager->nsendbufs[i] > 0) {
+			unsigned int n = --manager->nsendbufs[i];
+			isc_mem_put(manager->mctx, manager->sendbufs[i][n],
+				    sendbuf_sizes[i]);
+		}
+	}
+
 	manager->magic = 0;
 
 	isc_loop_detach(&manager->loop);
@@ -2609,6 +3297,12 @@ clientmgr_destroy_cb(void *arg) {
 
 	dns_message_destroypools(&manager->rdspool, &manager->namepool);
 
+	ns_anscache_destroy(&manager->anscache);
+
+	isc_mem_cput(manager->mctx, manager->cookiecache,
+		     NS_CLIENT_COOKIECACHE_SIZE,
+		     sizeof(manager->cookiecache[0]));
+
 	isc_mem_putanddetach(&manager->mctx, manager, sizeof(*manager));
 }
 
@@ -2634,6 +3328,7 @@ ns_clientmgr_create(ns_server_t *sctx, isc_loopmgr_t *loopmgr,
 		.mctx = mctx,
 		.tid = tid,
 		.recursing = ISC_LIST_INITIALIZER,
+		.freeclients = ISC_LIST_INITIALIZER,
 	};
 	isc_loop_attach(isc_loop_get(loopmgr, tid), &manager->loop);
 	isc_mutex_init(&manager->reclock);
@@ -2643,6 +3338,11 @@ ns_clientmgr_create(ns_server_t *sctx, isc_loopmgr_t *loopmgr,
 
 	dns_message_createpools(mctx, &manager->namepool, &manager->rdspool);
 
+	ns_anscache_create(mctx, &manager->anscache);
+
+	manager->cookiecache = isc_mem_cget(mctx, NS_CLIENT_COOKIECACHE_SIZE,
+					    sizeof(manager->cookiecache[0]));
+
 	manager->magic = MANAGER_MAGIC;
 
 	MTRACE("create");
@@ -2689,11 +3389,7 @@ ns_client_checkaclsilent(ns_client_t *client, isc_netaddr_t *netaddr,
 	isc_sockaddr_t local;
 
 	if (acl == NULL) {
-		if (default_allow) {
-			goto allow;
-		} else {
-			goto deny;
-		}
+		return default_allow ? ISC_R_SUCCESS : DNS_R_REFUSED;
 	}
 
 	if (netaddr == NULL) {
@@ -2701,6 +3397,15 @@ ns_client_checkaclsilent(ns_client_t *client, isc_netaddr_t *netaddr,
 		netaddr = &tmpnetaddr;
 	}
 
+	for (unsigned int i = 0; i < client->naclcache; i++) {
+		if (client->aclcache[i].acl == acl &&
+		    client->aclcache[i].signer == client->signer &&
+		    isc_netaddr_equal(&client->aclcache[i].addr, netaddr))
+		{
+			return client->aclcache[i].result;
+		}
+	}
+
 	local = isc_nmhandle_localaddr(client->handle);
 	result = dns_acl_match_port_transport(
 		netaddr, isc_sockaddr_getport(&local),
@@ -2708,20 +3413,23 @@ ns_client_checkaclsilent(ns_client_t *client, isc_netaddr_t *netaddr,
 		isc_nm_has_encryption(client->handle), client->signer, acl, env,
 		&match, NULL);
 
-	if (result != ISC_R_SUCCESS) {
-		goto deny; /* Internal error, already logged. */
-	}
+	/*
+	 * An internal error, which is already logged, a negative match
+	 * or no match at all deny the request.
+	 */
+	result = (result == ISC_R_SUCCESS && match > 0) ? ISC_R_SUCCESS
+							: DNS_R_REFUSED;
 
-	if (match > 0) {
-		goto allow;
+	if (client->naclcache < NS_CLIENT_ACLCACHE_SIZE) {
+		unsigned int i = client->naclcache++;
+		client->aclcache[i].acl = NULL;
+		dns_acl_attach(acl, &client->aclcache[i].acl);
+		client->aclcache[i].addr = *netaddr;
+		client->aclcache[i].signer = client->signer;
+		client->aclcache[i].result = result;
 	}
-	goto deny; /* Negative match or no match. */
-
-allow:
-	return ISC_R_SUCCESS;
 
-deny:
-	return DNS_R_REFUSED;
+	return result;
 }
 
 isc_result_t
@@ -2805,6 +3513,27 @@ ns_client_logv(ns_client_t *client, isc_logcategory_t category,
 		snprintf(peerbuf, sizeof(peerbuf), "(no-peer)");
 	}
 
+	/*
+	 * The query log is written by the query log thread, so that
+	 * logging every query doesn't hold up the loop.
+	 */
+	if (category == NS_LOGCATEGORY_QUERIES && client->manager != NULL) {
+		ns_server_t *sctx = client->manager->sctx;
+		char linebuf[sizeof(msgbuf) + 3 * DNS_NAME_FORMATSIZE];
+
+		snprintf(linebuf, sizeof(linebuf),
+			 "client @%p %s%s%s%s%s%s%s%s: %s", client, peerbuf,
+			 sep1, signer, sep2, qname, sep3, sep4, viewname,
+			 msgbuf);
+		if (!ns_querylog_write(sctx->querylog, category, module,
+				       level, linebuf))
+		{
+			ns_stats_increment(sctx->nsstats,
+					   ns_statscounter_querylogdropped);
+		}
+		return;
+	}
+
 	isc_log_write(category, module, level,
 		      "client @%p %s%s%s%s%s%s%s%s: %s", client, peerbuf, sep1,
 		      signer, sep2, qname, sep3, sep4, viewname, msgbuf);
@@ -0,0 +1,444 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <isc/ascii.h>
+#include <isc/atomic.h>
+#include <isc/hash.h>
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/netaddr.h>
+#include <isc/tid.h>
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rdatatype.h>
+
+#include <ns/hitters.h>
+
+#define HITTERS_MAGIC	 ISC_MAGIC('H', 'i', 't', 's')
+#define VALID_HITTERS(h) ISC_MAGIC_VALID(h, HITTERS_MAGIC)
+
+#define BUCKET_MASK (NS_HITTERS_SLOTS / NS_HITTERS_WAYS - 1)
+
+/*% Attempts to read a counter that the loop keeps replacing */
+#define READ_RETRIES 8
+
+STATIC_ASSERT(NS_HITTERS_WAYS > 0 &&
+		      (NS_HITTERS_WAYS & (NS_HITTERS_WAYS - 1)) == 0,
+	      "NS_HITTERS_WAYS must be a power of 2");
+STATIC_ASSERT(NS_HITTERS_SLOTS >= NS_HITTERS_WAYS &&
+		      (NS_HITTERS_SLOTS & (NS_HITTERS_SLOTS - 1)) == 0,
+	      "NS_HITTERS_SLOTS must be a power of 2");
+
+/*
+ * A counter.  Only the loop that owns the table writes it.  When the
+ * key is replaced, 'seq' is odd until the new key and counts are in
+ * place, so that a reader can tell it copied a consistent counter; an
+ * increment of 'count' alone needs no such care.  The key follows the
+ * structure; its size depends on the kind of key.  Query names are kept
+ * in lower case, so that they can be compared as bytes.
+ */
+typedef struct slot {
+	atomic_uint_fast32_t seq;
+	uint32_t hash;
+	atomic_uint_fast64_t count;
+	atomic_uint_fast64_t error;
+	unsigned int length;
+	unsigned char key[];
+} slot_t;
+
+struct ns_hitters {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	uint32_t ntables;
+	unsigned char *tables[ns_hitters_max];
+};
+
+/*% A counter copied out of a table, to be merged */
+typedef struct entry {
+	uint32_t hash;
+	unsigned int length;
+	uint64_t count;
+	uint64_t error;
+	const unsigned char *key;
+} entry_t;
+
+static size_t
+keysize(ns_hitterstype_t type) {
+	switch (type) {
+	case ns_hitters_qname:
+		return DNS_NAME_MAXWIRE;
+	case ns_hitters_qtype:
+		return 2;
+	case ns_hitters_client:
+	case ns_hitters_nxdomain:
+		return 1 + 16;
+	default:
+		UNREACHABLE();
+	}
+}
+
+static size_t
+slotsize(ns_hitterstype_t type) {
+	return ISC_ALIGN(sizeof(slot_t) + keysize(type), sizeof(uint64_t));
+}
+
+static slot_t *
+getslot(ns_hitters_t *h, ns_hitterstype_t type, uint32_t table,
+	uint32_t n) {
+	size_t offset = ((size_t)table * NS_HITTERS_SLOTS + n) * slotsize(type);
+
+	return (slot_t *)(h->tables[type] + offset);
+}
+
+void
+ns_hitters_create(isc_mem_t *mctx, ns_hitters_t **hp) {
+	ns_hitters_t *h = NULL;
+
+	REQUIRE(hp != NULL && *hp == NULL);
+
+	h = isc_mem_get(mctx, sizeof(*h));
+	*h = (ns_hitters_t){
+		.magic = HITTERS_MAGIC,
+		.ntables = isc_tid_count(),
+	};
+	isc_mem_attach(mctx, &h->mctx);
+
+	for (size_t i = 0; i < ns_hitters_max; i++) {
+		h->tables[i] = isc_mem_cget(mctx,
+					    h->ntables * NS_HITTERS_SLOTS,
+					    slotsize(i));
+	}
+
+	*hp = h;
+}
+
+void
+ns_hitters_destroy(ns_hitters_t **hp) {
+	ns_hitters_t *h = NULL;
+
+	REQUIRE(hp != NULL && VALID_HITTERS(*hp));
+
+	h = *hp;
+	*hp = NULL;
+	h->magic = 0;
+
+	for (size_t i = 0; i < ns_hitters_max; i++) {
+		isc_mem_cput(h->mctx, h->tables[i],
+			     h->ntables * NS_HITTERS_SLOTS, slotsize(i));
+	}
+	isc_mem_putanddetach(&h->mctx, h, sizeof(*h));
+}
+
+/*
+ * Count 'key' in the table of the current loop: add one to its counter
+ * if it is in its bucket, or else take over the smallest counter of the
+ * bucket.
+ */
+static void
+hitters_add(ns_hitters_t *h, ns_hitterstype_t type, const unsigned char *key,
+	    unsigned int length) {
+	uint32_t tid = isc_tid();
+	uint32_t hash = isc_hash32(key, length, true);
+	uint32_t first = (hash & BUCKET_MASK) * NS_HITTERS_WAYS;
+	slot_t *min = NULL;
+	uint_fast64_t mincount = UINT64_MAX;
+
+	if (tid >= h->ntables) {
+		return;
+	}
+
+	for (uint32_t i = first; i < first + NS_HITTERS_WAYS; i++) {
+		slot_t *slot = getslot(h, type, tid, i);
+		uint_fast64_t count = atomic_load_relaxed(&slot->count);
+
+		if (count != 0 && slot->hash == hash &&
+		    slot->length == length &&
+		    memcmp(slot->key, key, length) == 0)
+		{
+			atomic_store_relaxed(&slot->count, count + 1);
+			return;
+		}
+		if (count < mincount) {
+			min = slot;
+			mincount = count;
+		}
+	}
+
+	uint_fast32_t seq = atomic_load_relaxed(&min->seq);
+	atomic_store_relaxed(&min->seq, seq + 1);
+	atomic_thread_fence(memory_order_release);
+	min->hash = hash;
+	min->length = length;
+	memmove(min->key, key, length);
+	atomic_store_relaxed(&min->error, mincount);
+	atomic_store_relaxed(&min->count, mincount + 1);
+	atomic_store_release(&min->seq, seq + 2);
+}
+
+/*
+ * The key of a client: the address family, and the address with all but
+ * the prefix cleared.
+ */
+static unsigned int
+clientkey(const isc_netaddr_t *netaddr, unsigned char *key) {
+	switch (netaddr->family) {
+	case AF_INET:
+		key[0] = 4;
+		memmove(key + 1, &netaddr->type.in, 4);
+		memset(key + 1 + NS_HITTERS_PREFIX4 / 8, 0,
+		       4 - NS_HITTERS_PREFIX4 / 8);
+		return 1 + 4;
+	case AF_INET6:
+		key[0] = 6;
+		memmove(key + 1, &netaddr->type.in6, 16);
+		memset(key + 1 + NS_HITTERS_PREFIX6 / 8, 0,
+		       16 - NS_HITTERS_PREFIX6 / 8);
+		return 1 + 16;
+	default:
+		return 0;
+	}
+}
+
+void
+ns_hitters_addquery(ns_hitters_t *h, const dns_name_t *qname,
+		    dns_rdatatype_t qtype, const isc_netaddr_t *client) {
+	unsigned char key[DNS_NAME_MAXWIRE];
+	unsigned int length;
+
+	REQUIRE(VALID_HITTERS(h));
+	REQUIRE(DNS_NAME_VALID(qname));
+	REQUIRE(client != NULL);
+
+	isc_ascii_lowercopy(key, qname->ndata, qname->length);
+	hitters_add(h, ns_hitters_qname, key, qname->length);
+
+	key[0] = qtype >> 8;
+	key[1] = qtype & 0xff;
+	hitters_add(h, ns_hitters_qtype, key, 2);
+
+	length = clientkey(client, key);
+	if (length != 0) {
+		hitters_add(h, ns_hitters_client, key, length);
+	}
+}
+
+void
+ns_hitters_addnxdomain(ns_hitters_t *h, const isc_netaddr_t *client) {
+	unsigned char key[1 + 16];
+	unsigned int length;
+
+	REQUIRE(VALID_HITTERS(h));
+	REQUIRE(client != NULL);
+
+	length = clientkey(client, key);
+	if (length != 0) {
+		hitters_add(h, ns_hitters_nxdomain, key, length);
+	}
+}
+
+static int
+entry_cmpkey(const void *a, const void *b) {
+	const entry_t *ea = a, *eb = b;
+
+	if (ea->hash != eb->hash) {
+		return ea->hash < eb->hash ? -1 : 1;
+	}
+	if (ea->length != eb->length) {
+		return ea->length < eb->length ? -1 : 1;
+	}
+	return memcmp(ea->key, eb->key, ea->length);
+}
+
+static int
+entry_cmpcount(const void *a, const void *b) {
+	const entry_t *ea = a, *eb = b;
+
+	if (ea->count != eb->count) {
+		return ea->count > eb->count ? -1 : 1;
+	}
+	return 0;
+}
+
+size_t
+ns_hitters_top(ns_hitters_t *h, ns_hitterstype_t type, ns_hitter_t *top,
+	       size_t ntop) {
+	size_t nslots, nentries = 0, nmerged = 0, size;
+	entry_t *entries = NULL;
+	unsigned char *keys = NULL;
+
+	REQUIRE(VALID_HITTERS(h));
+	REQUIRE(type < ns_hitters_max);
+	REQUIRE(top != NULL);
+
+	nslots = (size_t)h->ntables * NS_HITTERS_SLOTS;
+	size = keysize(type);
+	entries = isc_mem_cget(h->mctx, nslots, sizeof(entries[0]));
+	keys = isc_mem_cget(h->mctx, nslots, size);
+
+	/*
+	 * Copy the counters in use.  A counter whose key the loop replaced
+	 * while it was copied is copied again, and skipped if that keeps
+	 * happening.
+	 */
+	for (uint32_t t = 0; t < h->ntables; t++) {
+		for (uint32_t i = 0; i < NS_HITTERS_SLOTS; i++) {
+			slot_t *slot = getslot(h, type, t, i);
+			entry_t *entry = &entries[nentries];
+			unsigned char *key = keys + nentries * size;
+
+			for (size_t retry = 0; retry < READ_RETRIES; retry++) {
+				uint_fast32_t seq =
+					atomic_load_acquire(&slot->seq);
+				if ((seq & 1) != 0) {
+					continue;
+				}
+				*entry = (entry_t){
+					.hash = slot->hash,
+					.length = ISC_MIN(slot->length, size),
+					.count = atomic_load_relaxed(
+						&slot->count),
+					.error = atomic_load_relaxed(
+						&slot->error),
+					.key = key,
+				};
+				memmove(key, slot->key, entry->length);
+				atomic_thread_fence(memory_order_acquire);
+				if (atomic_load_relaxed(&slot->seq) == seq) {
+					if (entry->count != 0) {
+						nentries++;
+					}
+					break;
+				}
+			}
+		}
+	}
+
+	/* Add up the counts of the same key in different loops */
+	qsort(entries, nentries, sizeof(entries[0]), entry_cmpkey);
+	for (size_t i = 0; i < nentries; i++) {
+		if (nmerged > 0 &&
+		    entry_cmpkey(&entries[nmerged - 1], &entries[i]) == 0)
+		{
+			entries[nmerged - 1].count += entries[i].count;
+			entries[nmerged - 1].error += entries[i].error;
+		} else {
+			entries[nmerged++] = entries[i];
+		}
+	}
+
+	qsort(entries, nmerged, sizeof(entries[0]), entry_cmpcount);
+	ntop = ISC_MIN(ntop, nmerged);
+	for (size_t i = 0; i < ntop; i++) {
+		top[i] = (ns_hitter_t){
+			.count = entries[i].count,
+			.error = entries[i].error,
+			.length = entries[i].length,
+		};
+		memmove(top[i].key, entries[i].key, entries[i].length);
+	}
+
+	isc_mem_cput(h->mctx, keys, nslots, size);
+	isc_mem_cput(h->mctx, entries, nslots, sizeof(entries[0]));
+
+	return ntop;
+}
+
+void
+ns_hitters_reset(ns_hitters_t *h) {
+	REQUIRE(VALID_HITTERS(h));
+
+	for (size_t type = 0; type < ns_hitters_max; type++) {
+		for (uint32_t t = 0; t < h->ntables; t++) {
+			for (uint32_t i = 0; i < NS_HITTERS_SLOTS; i++) {
+				slot_t *slot = getslot(h, type, t, i);
+				atomic_store_relaxed(&slot->count, 0);
+				atomic_store_relaxed(&slot->error, 0);
+			}
+		}
+	}
+}
+
+void
+ns_hitter_format(ns_hitterstype_t type, const ns_hitter_t *hitter, char *buf,
+		 size_t size) {
+	isc_netaddr_t netaddr;
+	struct in_addr in;
+	struct in6_addr in6;
+	isc_region_t r;
+	dns_fixedname_t fixed;
+	dns_name_t *name = NULL;
+	unsigned int prefix;
+	size_t len;
+
+	REQUIRE(hitter != NULL);
+	REQUIRE(buf != NULL && size > 0);
+
+	switch (type) {
+	case ns_hitters_qname:
+		name = dns_fixedname_initname(&fixed);
+		r = (isc_region_t){
+			.base = UNCONST(hitter->key),
+			.length = hitter->length,
+		};
+		dns_name_fromregion(name, &r);
+		dns_name_format(name, buf, size);
+		break;
+	case ns_hitters_qtype:
+		dns_rdatatype_format(hitter->key[0] << 8 | hitter->key[1], buf,
+				     size);
+		break;
+	case ns_hitters_client:
+	case ns_hitters_nxdomain:
+		if (hitter->key[0] == 4) {
+			memmove(&in, &hitter->key[1], sizeof(in));
+			isc_netaddr_fromin(&netaddr, &in);
+			prefix = NS_HITTERS_PREFIX4;
+		} else {
+			memmove(&in6, &hitter->key[1], sizeof(in6));
+			isc_netaddr_fromin6(&netaddr, &in6);
+			prefix = NS_HITTERS_PREFIX6;
+		}
+		isc_netaddr_format(&netaddr, buf, size);
+		len = strlen(buf);
+		snprintf(buf + len, size - len, "/%u", prefix);
+		break;
+	default:
+		UNREACHABLE();
+	}
+}
+
+const char *
+ns_hitterstype_totext(ns_hitterstype_t type) {
+	switch (type) {
+	case ns_hitters_qname:
+		return "qname";
+	case ns_hitters_qtype:
+		return "qtype";
+	case ns_hitters_client:
+		return "client";
+	case ns_hitters_nxdomain:
+		return "nxdomain";
+	default:
+		UNREACHABLE();
+	}
+}
@@ -318,6 +318,7 @@ ns_hook_add(ns_hooktable_t *hooktable, isc_mem_t *mctx,
 	*copy = (ns_hook_t){
 		.action = hook->action,
 		.action_data = hook->action_data,
+		.qtype = hook->qtype,
 	};
 	isc_mem_attach(mctx, &copy->mctx);
 
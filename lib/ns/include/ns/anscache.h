@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*! \file include/ns/anscache.h
+ * \brief
+ * A cache of rendered authoritative responses.
+ *
+ * Each client manager (that is, each loop) owns one cache, so the cache is
+ * not locked.  The responses are stored in the wire format, without the OPT
+ * record, and keyed on everything in the query and in the client state that
+ * shapes the response; when the same query is received again, the stored
+ * response only needs its message ID changed and a fresh OPT record appended
+ * before it is sent.
+ *
+ * The entries are validated against dns_db_generation(), so they become
+ * stale whenever any zone database is changed.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/list.h>
+#include <isc/mem.h>
+#include <isc/region.h>
+#include <isc/stats.h>
+
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/types.h>
+
+#include <ns/types.h>
+
+#define NS_ANSCACHE_MAXENTRIES 1024
+
+typedef struct ns_anscachekey {
+	dns_view_t  *view;
+	dns_db_t    *db;
+	unsigned int attributes; /*%< client attributes shaping the response */
+	unsigned int flags;	 /*%< query flags echoed in the response */
+	uint16_t     udpsize;
+	uint16_t     qtype;
+	uint16_t     qclass;
+	uint8_t	     family;
+	uint8_t	     qnamelen;
+	uint8_t	     qname[DNS_NAME_MAXWIRE];
+} ns_anscachekey_t;
+
+typedef struct ns_anscacheentry ns_anscacheentry_t;
+struct ns_anscacheentry {
+	ns_anscachekey_t key;
+	uint32_t	 hashval;
+	uint64_t	 generation;
+
+	/*% The rendered response without the OPT record */
+	isc_region_t wire;
+
+	/*%
+	 * The name and the response type used for the response rate
+	 * limiting when the response was built, if it was rate limited.
+	 */
+	dns_fixedname_t rrlname;
+	isc_result_t	rrlresult;
+
+	/*% The query statistics counter the response was counted in */
+	isc_statscounter_t counter;
+
+	ISC_LINK(ns_anscacheentry_t) link;
+};
+
+void
+ns_anscache_create(isc_mem_t *mctx, ns_anscache_t **cachep);
+/*%<
+ * Create an empty response cache.
+ *
+ * Requires:
+ *\li	'cachep' is not NULL and '*cachep' is NULL.
+ */
+
+void
+ns_anscache_destroy(ns_anscache_t **cachep);
+/*%<
+ * Destroy the response cache and all its entries.
+ */
+
+void
+ns_anscache_initkey(ns_anscachekey_t *key, dns_view_t *view, dns_db_t *db,
+		    const dns_name_t *qname);
+/*%<
+ * Initialize 'key' for a query for 'qname' answered from 'db' in 'view';
+ * the rest of the key is filled in by the caller.  The name is compared
+ * case-sensitively, as its case is preserved in the response.
+ */
+
+ns_anscacheentry_t *
+ns_anscache_find(ns_anscache_t *cache, const ns_anscachekey_t *key);
+/*%<
+ * Find the response for 'key'.  The entries that have become stale are
+ * removed.
+ *
+ * Returns:
+ *\li	the entry, which is valid until the cache is next modified, or
+ *	NULL if there's no usable entry.
+ */
+
+void
+ns_anscache_add(ns_anscache_t *cache, const ns_anscachekey_t *key,
+		uint64_t generation, const isc_region_t *wire,
+		const dns_name_t *rrlname, isc_result_t rrlresult,
+		isc_statscounter_t counter);
+/*%<
+ * Add the rendered response 'wire' for 'key', computed from the zone
+ * contents of the 'generation'.  The least recently used entry is
+ * evicted when the cache is full.
+ *
+ * 'rrlname' may be NULL if the response was not rate limited.
+ */
@@ -61,9 +61,11 @@
 #include <isc/atomic.h>
 #include <isc/buffer.h>
 #include <isc/magic.h>
+#include <isc/netaddr.h>
 #include <isc/netmgr.h>
 #include <isc/quota.h>
 #include <isc/stdtime.h>
+#include <isc/time.h>
 
 #include <dns/db.h>
 #include <dns/ecs.h>
@@ -82,6 +84,11 @@
 
 #define NS_CLIENT_TCP_BUFFER_SIZE  65535
 #define NS_CLIENT_SEND_BUFFER_SIZE 4096
+#define NS_CLIENT_ARENA_SIZE	   512
+#define NS_CLIENT_SENDBUF_CLASSES  4
+#define NS_CLIENT_SENDBUF_POOLSIZE 8
+#define NS_CLIENT_ACLCACHE_SIZE	   8
+#define NS_CLIENT_COOKIECACHE_SIZE 1024
 
 /*!
  * Client object states.  Ordering is significant: higher-numbered
@@ -139,6 +146,17 @@ typedef enum {
 typedef ISC_LIST(ns_client_t) client_list_t;
 
 /*% nameserver client manager structure */
+/*%
+ * A server cookie that has been verified recently, see 'cookiecache' in
+ * ns_clientmgr_t.
+ */
+typedef struct ns_cookiecache_entry {
+	isc_netaddr_t addr;
+	unsigned char cookie[24];
+	uint32_t      gen;     /*%< 'cookiegen' of the server when verified */
+	bool	      primary; /*%< made with the primary secret */
+} ns_cookiecache_entry_t;
+
 struct ns_clientmgr {
 	/* Unlocked. */
 	unsigned int magic;
@@ -158,7 +176,35 @@ struct ns_clientmgr {
 	isc_mutex_t   reclock;
 	client_list_t recursing; /*%< Recursing clients */
 
+	ns_anscache_t *anscache; /*%< Rendered authoritative responses */
+
+	/*%
+	 * Idle clients, with their message and query state set up, kept
+	 * for reuse by the requests on new connections.  Only used on the
+	 * manager's loop.
+	 */
+	client_list_t	     freeclients;
+	uint32_t	     nfreeclients;
+	atomic_uint_fast32_t poolinitial;
+	atomic_uint_fast32_t poolmax;
+
+	/*%
+	 * Buffers for the TCP responses too large for the client's
+	 * 'sendbuf', by size class, kept for reuse.  Only used on the
+	 * manager's loop.
+	 */
+	unsigned char *sendbufs[NS_CLIENT_SENDBUF_CLASSES]
+			       [NS_CLIENT_SENDBUF_POOLSIZE];
+	unsigned int nsendbufs[NS_CLIENT_SENDBUF_CLASSES];
+
 	uint8_t tcp_buffer[NS_CLIENT_TCP_BUFFER_SIZE];
+
+	/*%
+	 * The server cookies verified recently, indexed by their hash, so
+	 * that the same cookie presented again by the same client is not
+	 * verified again.  Only used on the manager's loop.
+	 */
+	ns_cookiecache_entry_t *cookiecache;
 };
 
 /*% nameserver client structure */
@@ -190,6 +236,20 @@ struct ns_client {
 	isc_time_t    requesttime;
 	isc_stdtime_t now;
 	isc_time_t    tnow;
+
+	/*%
+	 * Monotonic time of the last latency mark, and the time charged
+	 * to each stage of the current request so far.
+	 */
+	isc_nanosecs_t latencystart;
+	isc_nanosecs_t latencymark;
+	isc_nanosecs_t latency[ns_latency_max];
+	unsigned int   latencystages;
+	/*%
+	 * CPU time used by the current request so far; charged to the
+	 * view's resolver statistics at the end of the request.
+	 */
+	isc_nanosecs_t cputime;
 	dns_name_t    signername; /*%< [T]SIG key name */
 	dns_name_t   *signer;	  /*%< NULL if not valid sig */
 	isc_result_t  sigresult;
@@ -222,7 +282,9 @@ struct ns_client {
 	void (*sendcb)(isc_buffer_t *buf);
 
 	ISC_LINK(ns_client_t) rlink;
+	ISC_LINK(ns_client_t) freelink;
 	unsigned char  cookie[8];
+	unsigned char  servercookie[16]; /*%< with NS_CLIENTATTR_REUSECOOKIE */
 	uint32_t       expire;
 	unsigned char *keytag;
 	uint16_t       keytag_len;
@@ -236,6 +298,27 @@ struct ns_client {
 	int32_t rcode_override;
 
 	uint8_t sendbuf[NS_CLIENT_SEND_BUFFER_SIZE];
+
+	/*%
+	 * Space for the small allocations that only live as long as
+	 * the request, such as the EDE and keytag options; it is
+	 * emptied when the client is reset for the next request.
+	 */
+	size_t	arena_used;
+	uint8_t arena[NS_CLIENT_ARENA_SIZE];
+
+	/*%
+	 * The outcome of the ACL checks made for the request, so that
+	 * the ACLs consulted more than once, such as allow-query-cache,
+	 * are only matched once.  The ACLs are attached.
+	 */
+	struct {
+		dns_acl_t     *acl;
+		isc_netaddr_t  addr;
+		dns_name_t    *signer;
+		isc_result_t   result;
+	} aclcache[NS_CLIENT_ACLCACHE_SIZE];
+	unsigned int naclcache;
 };
 
 #define NS_CLIENT_MAGIC	   ISC_MAGIC('N', 'S', 'C', 'c')
@@ -261,6 +344,7 @@ struct ns_client {
 #define NS_CLIENTATTR_USEKEEPALIVE 0x10000 /*%< use TCP keepalive */
 #define NS_CLIENTATTR_NOSETFC	   0x20000 /*%< don't set servfail cache */
 #define NS_CLIENTATTR_NEEDTCP	   0x40000 /*%< send TC=1 */
+#define NS_CLIENTATTR_REUSECOOKIE  0x80000 /*%< return the same COOKIE */
 
 /*
  * Flag to use with the SERVFAIL cache to indicate
@@ -296,6 +380,14 @@ ns_client_sendraw(ns_client_t *client, dns_message_t *msg);
  * send msg as a response using client->message->id for the id.
  */
 
+void
+ns_client_sendcached(ns_client_t *client, const isc_region_t *wire);
+/*%<
+ * Finish processing the current client request and send the response
+ * 'wire' taken from the response cache, using client->message->id for
+ * the id and appending a new OPT record if the client wants one.
+ */
+
 void
 ns_client_error(ns_client_t *client, isc_result_t result);
 /*%<
@@ -331,6 +423,14 @@ ns_client_settimeout(ns_client_t *client, unsigned int seconds);
  * Set a timer in the client to go off in the specified amount of time.
  */
 
+void
+ns_client_latency(ns_client_t *client, ns_latency_t stage);
+/*%<
+ * Charge the time elapsed since the previous mark to 'stage' of the
+ * current request.  The stages are added to the latency histograms
+ * of the server when the request ends.
+ */
+
 isc_result_t
 ns_clientmgr_create(ns_server_t *sctx, isc_loopmgr_t *loopmgr,
 		    dns_aclenv_t *aclenv, int tid, ns_clientmgr_t **managerp);
@@ -345,6 +445,14 @@ ns_clientmgr_shutdown(ns_clientmgr_t *manager);
  * managed by it
  */
 
+void
+ns_clientmgr_setpool(ns_clientmgr_t *manager, uint32_t initial, uint32_t max);
+/*%<
+ * Keep up to 'max' idle clients for reuse instead of freeing them, and
+ * preallocate 'initial' of them.  The pool is filled, or trimmed down
+ * to 'max', asynchronously on the manager's loop.
+ */
+
 isc_sockaddr_t *
 ns_client_getsockaddr(ns_client_t *client);
 /*%<
@@ -371,6 +479,9 @@ ns_client_checkaclsilent(ns_client_t *client, isc_netaddr_t *netaddr,
  * If netaddr is NULL, check the ACL against client->peeraddr;
  * otherwise check it against netaddr.
  *
+ * The result is remembered until the end of the request, so checking
+ * the same ACL and address again does not match the ACL again.
+ *
  * Notes:
  *\li	This is appropriate for checking allow-update,
  * 	allow-query, allow-transfer, etc.  It is not appropriate
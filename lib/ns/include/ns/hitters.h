@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*! \file include/ns/hitters.h
+ * \brief
+ * Approximate counts of the query names, query types and client
+ * prefixes seen most often, and of the client prefixes that receive the
+ * most NXDOMAIN answers.
+ *
+ * Each loop keeps a Space-Saving summary of each kind of key, which only
+ * the loop updates: a table of #NS_HITTERS_SLOTS counters, divided into
+ * buckets of #NS_HITTERS_WAYS.  A key is counted in the bucket its hash
+ * selects; a key that isn't there takes over the smallest counter of the
+ * bucket, and starts from its count.  A key's count is therefore never
+ * less than the true count, and exceeds it by at most the count it took
+ * over, which is kept as the error of the count.  Every key seen more
+ * often than the keys it shares a bucket with is counted.
+ *
+ * The summaries of the loops are merged when they are read.
+ */
+
+#include <inttypes.h>
+
+#include <isc/mem.h>
+#include <isc/netaddr.h>
+
+#include <dns/name.h>
+#include <dns/types.h>
+
+#include <ns/types.h>
+
+/*% Counters for each kind of key in each loop; a power of 2 */
+#define NS_HITTERS_SLOTS 256
+
+/*% Counters in a bucket; a power of 2 */
+#define NS_HITTERS_WAYS 4
+
+/*% Length of the prefixes the clients are counted by */
+#define NS_HITTERS_PREFIX4 24
+#define NS_HITTERS_PREFIX6 56
+
+typedef enum {
+	ns_hitters_qname = 0,
+	ns_hitters_qtype,
+	ns_hitters_client,
+	ns_hitters_nxdomain,
+	ns_hitters_max,
+} ns_hitterstype_t;
+
+/*%
+ * A key and its approximate count.  The key is the query name in wire
+ * format, the query type in network byte order, or the address family
+ * (4 or 6) followed by the address of the client prefix.
+ */
+typedef struct ns_hitter {
+	uint64_t      count; /*%< never less than the true count */
+	uint64_t      error; /*%< the most 'count' can exceed it by */
+	unsigned int  length;
+	unsigned char key[DNS_NAME_MAXWIRE];
+} ns_hitter_t;
+
+void
+ns_hitters_create(isc_mem_t *mctx, ns_hitters_t **hp);
+/*%<
+ * Create empty summaries for each loop.
+ *
+ * Requires:
+ *\li	'hp' is not NULL and '*hp' is NULL.
+ */
+
+void
+ns_hitters_destroy(ns_hitters_t **hp);
+/*%<
+ * Destroy the summaries.
+ */
+
+void
+ns_hitters_addquery(ns_hitters_t *h, const dns_name_t *qname,
+		    dns_rdatatype_t qtype, const isc_netaddr_t *client);
+/*%<
+ * Count a query for 'qname' and 'qtype' from 'client' in the summaries
+ * of the current loop.  Outside of the loops, nothing is counted.
+ */
+
+void
+ns_hitters_addnxdomain(ns_hitters_t *h, const isc_netaddr_t *client);
+/*%<
+ * Count an NXDOMAIN answer to 'client' in the summary of the current
+ * loop.  Outside of the loops, nothing is counted.
+ */
+
+size_t
+ns_hitters_top(ns_hitters_t *h, ns_hitterstype_t type, ns_hitter_t *top,
+	       size_t ntop);
+/*%<
+ * Merge the summaries of 'type' of all the loops, and fill 'top' with
+ * at most 'ntop' of the keys with the highest counts, the highest first.
+ *
+ * Returns the number of entries filled.
+ *
+ * Requires:
+ *\li	'top' is not NULL.
+ */
+
+void
+ns_hitters_reset(ns_hitters_t *h);
+/*%<
+ * Set all the counts to zero.
+ */
+
+void
+ns_hitter_format(ns_hitterstype_t type, const ns_hitter_t *hitter, char *buf,
+		 size_t size);
+/*%<
+ * Format the key of 'hitter' as text into 'buf': a name, a type name, or
+ * an address prefix such as "192.0.2.0/24".
+ */
+
+const char *
+ns_hitterstype_totext(ns_hitterstype_t type);
+/*%<
+ * Return "qname", "qtype", "client" or "nxdomain".
+ */
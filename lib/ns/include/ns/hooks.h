@@ -401,6 +401,11 @@ typedef struct ns_hook {
 	ns_hook_action_t action;
 	void		*action_data;
 	ISC_LINK(struct ns_hook) link;
+	/*
+	 * If non-zero, the action is only called while the query type
+	 * is 'qtype'.
+	 */
+	dns_rdatatype_t qtype;
 } ns_hook_t;
 
 typedef ISC_LIST(ns_hook_t) ns_hooklist_t;
@@ -456,7 +461,7 @@ typedef struct ns_hook_resume {
  * as well; if not, set NS_PLUGIN_AGE to 0.
  */
 #ifndef NS_PLUGIN_VERSION
-#define NS_PLUGIN_VERSION 2
+#define NS_PLUGIN_VERSION 3
 #define NS_PLUGIN_AGE	  0
 #endif /* ifndef NS_PLUGIN_VERSION */
 
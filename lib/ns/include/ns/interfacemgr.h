@@ -75,6 +75,7 @@ struct ns_interface {
 	unsigned int	   flags;      /*%< Interface flags */
 	char		   name[32];   /*%< Null terminated. */
 	isc_nmsocket_t	  *udplistensocket;
+	isc_nmsocket_t	  *xdplistensocket;
 	isc_nmsocket_t	  *tcplistensocket;
 	isc_nmsocket_t	  *tlslistensocket;
 	isc_nmsocket_t	  *http_listensocket;
@@ -90,6 +91,7 @@ struct ns_interface {
 					   *   connected) */
 	ns_clientmgr_t	   *clientmgr;	  /*%< Client manager. */
 	isc_nm_proxy_type_t proxy_type;
+	unsigned int	    fastopen; /*%< TCP Fast Open queue length */
 	ISC_LINK(ns_interface_t) link;
 };
 
@@ -139,6 +141,24 @@ ns_interfacemgr_setbacklog(ns_interfacemgr_t *mgr, int backlog);
  * Set the size of the listen() backlog queue.
  */
 
+void
+ns_interfacemgr_setclientpool(ns_interfacemgr_t *mgr, uint32_t initial,
+			      uint32_t max);
+/*%<
+ * Set the number of idle clients each client manager preallocates and
+ * the maximum number it keeps for reuse; see ns_clientmgr_setpool().
+ */
+
+void
+ns_interfacemgr_setxdpinterfaces(ns_interfacemgr_t *mgr,
+				 const char *const *names, size_t count);
+/*%<
+ * Set the names of the network interfaces on which the UDP listeners
+ * should also use the AF_XDP fast path.  The names are copied; the
+ * previous list is freed.  The list is only consulted when new listening
+ * sockets are created.
+ */
+
 isc_result_t
 ns_interfacemgr_scan(ns_interfacemgr_t *mgr, bool verbose, bool config);
 /*%<
@@ -184,6 +204,14 @@ ns_interfacemgr_dumprecursing(FILE *f, ns_interfacemgr_t *mgr);
 bool
 ns_interfacemgr_listeningon(ns_interfacemgr_t *mgr, const isc_sockaddr_t *addr);
 
+size_t
+ns_interfacemgr_listenerfds(ns_interfacemgr_t *mgr, int *fds, size_t size);
+/*%<
+ * Store up to 'size' descriptors of the UDP and TCP sockets the
+ * interfaces of 'mgr' listen on in 'fds', and return how many of them
+ * there are; see isc_nm_listenerfds().
+ */
+
 ns_server_t *
 ns_interfacemgr_getserver(ns_interfacemgr_t *mgr);
 /*%<
@@ -53,6 +53,7 @@ struct ns_listenelt {
 	uint32_t	    http_max_clients;
 	uint32_t	    max_concurrent_streams;
 	isc_nm_proxy_type_t proxy;
+	unsigned int	    fastopen; /*%< TCP Fast Open queue length */
 	ISC_LINK(ns_listenelt_t) link;
 };
 
@@ -75,6 +76,8 @@ typedef struct ns_listen_tls_params {
 	bool	    prefer_server_ciphers_set;
 	bool	    session_tickets;
 	bool	    session_tickets_set;
+	const char *ticket_key_file;
+	uint32_t    ticket_rotation;
 } ns_listen_tls_params_t;
 
 /***
@@ -26,6 +26,7 @@
 #include <dns/rpz.h>
 #include <dns/types.h>
 
+#include <ns/anscache.h>
 #include <ns/types.h>
 
 /*% nameserver database version structure */
@@ -154,6 +155,15 @@ struct ns_query {
 	dns_keytag_t root_key_sentinel_keyid;
 	bool	     root_key_sentinel_is_ta;
 	bool	     root_key_sentinel_not_ta;
+
+	/*% State for storing the response in the response cache */
+	struct {
+		ns_anscachekey_t   key;
+		uint64_t	   generation;
+		dns_fixedname_t	   rrlname;
+		isc_result_t	   rrlresult;
+		isc_statscounter_t counter;
+	} anscache;
 };
 
 #define NS_QUERYATTR_RECURSIONOK     0x000001
@@ -175,6 +185,7 @@ struct ns_query {
 #define NS_QUERYATTR_REDIRECT	     0x020000
 #define NS_QUERYATTR_ANSWERED	     0x040000
 #define NS_QUERYATTR_STALEOK	     0x080000
+#define NS_QUERYATTR_ANSCACHE	     0x100000
 
 typedef struct query_ctx query_ctx_t;
 
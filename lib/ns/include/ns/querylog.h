@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*! \file include/ns/querylog.h
+ * \brief
+ * An asynchronous writer for the query log.
+ *
+ * Each loop has a ring of formatted log messages that only the loop adds
+ * to and only the writer thread takes from, so adding a message takes no
+ * locks.  The writer thread drains the rings and hands the messages to
+ * isc_log_write(), so the logging context lock and the writes to the log
+ * channels are kept off the loops.  When the ring of a loop is full, the
+ * message is dropped rather than making the loop wait.
+ *
+ * The writer can also write a binary query log to a file: each query is
+ * written at the end of the request as a record with a fixed layout, which
+ * takes much less work on the loop than formatting a line of text.  The
+ * records are read back with the named-querylog tool.
+ *
+ * The file starts with the four bytes of #NS_QUERYLOG_MAGIC and the
+ * two byte #NS_QUERYLOG_VERSION, which are followed by the records.  All
+ * the numbers are in network byte order, and each record is:
+ *
+ *\li	uint16	length of the rest of the record
+ *\li	uint32	seconds since the epoch when the request was received
+ *\li	uint32	nanoseconds
+ *\li	uint32	time taken to answer the request, in microseconds
+ *\li	uint16	flags, NS_QUERYLOG_FLAG_*
+ *\li	uint16	query type
+ *\li	uint16	query class
+ *\li	uint16	response code
+ *\li	uint16	port of the client
+ *\li	uint8	address family of the client, 4 or 6
+ *\li	4 or 16	address of the client
+ *\li	the query name in uncompressed wire format
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/log.h>
+#include <isc/mem.h>
+#include <isc/netaddr.h>
+#include <isc/time.h>
+
+#include <dns/name.h>
+
+#include <ns/types.h>
+
+/*% Size of the ring of each loop, in bytes; a power of 2 */
+#define NS_QUERYLOG_RINGSIZE (256 * 1024)
+
+/*% How long the writer thread sleeps when all the rings are empty */
+#define NS_QUERYLOG_INTERVAL 10 /* milliseconds */
+
+#define NS_QUERYLOG_MAGIC   "BQLG"
+#define NS_QUERYLOG_VERSION 1
+
+/*%
+ * Flags of a binary query log record; they match the flags of the
+ * text query log.
+ */
+#define NS_QUERYLOG_FLAG_RECURSION 0x0001 /*%< '+', recursion desired */
+#define NS_QUERYLOG_FLAG_EDNS	   0x0002 /*%< 'E', EDNS */
+#define NS_QUERYLOG_FLAG_SIGNED	   0x0004 /*%< 'S', signed */
+#define NS_QUERYLOG_FLAG_TCP	   0x0008 /*%< 'T', TCP */
+#define NS_QUERYLOG_FLAG_DO	   0x0010 /*%< 'D', DNSSEC OK */
+#define NS_QUERYLOG_FLAG_CD	   0x0020 /*%< 'C', checking disabled */
+#define NS_QUERYLOG_FLAG_COOKIE	   0x0040 /*%< 'V', valid cookie */
+#define NS_QUERYLOG_FLAG_NEWCOOKIE 0x0080 /*%< 'K', cookie to be checked */
+
+/*% The fixed part of a record, after the length */
+#define NS_QUERYLOG_RECORDSIZE 23
+
+/*%
+ * A query to be written to the binary query log.
+ */
+typedef struct ns_querylogentry {
+	isc_time_t	  time;
+	uint32_t	  latency; /*%< microseconds */
+	uint16_t	  flags;
+	dns_rdatatype_t	  qtype;
+	dns_rdataclass_t  qclass;
+	dns_rcode_t	  rcode;
+	in_port_t	  port;
+	isc_netaddr_t	  address;
+	const dns_name_t *qname;
+} ns_querylogentry_t;
+
+void
+ns_querylog_create(isc_mem_t *mctx, ns_querylog_t **qlp);
+/*%<
+ * Create a query log writer with one ring for each loop.  The writer
+ * thread is started when the first message is added.
+ *
+ * Requires:
+ *\li	'qlp' is not NULL and '*qlp' is NULL.
+ */
+
+void
+ns_querylog_destroy(ns_querylog_t **qlp);
+/*%<
+ * Stop the writer thread after it has written the messages left in the
+ * rings, and destroy the query log writer.
+ */
+
+bool
+ns_querylog_write(ns_querylog_t *ql, isc_logcategory_t category,
+		  isc_logmodule_t module, int level, const char *msg);
+/*%<
+ * Queue 'msg' to be logged by the writer thread.  Outside of the loops,
+ * 'msg' is logged at once.
+ *
+ * Returns:
+ *\li	true	the message has been queued or logged
+ *\li	false	the ring of the current loop is full and the message
+ *		has been dropped
+ */
+
+isc_result_t
+ns_querylog_setfile(ns_querylog_t *ql, const char *filename);
+/*%<
+ * Write the binary query log to 'filename', or stop writing it if
+ * 'filename' is NULL.  The records are appended to an existing file.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	any error from opening or writing to the file
+ */
+
+bool
+ns_querylog_writeentry(ns_querylog_t *ql, const ns_querylogentry_t *entry);
+/*%<
+ * Queue 'entry' to be written to the binary query log.
+ *
+ * Returns:
+ *\li	true	the record has been queued, or no binary query log is
+ *		being written
+ *\li	false	the ring of the current loop is full and the record
+ *		has been dropped
+ */
+
+bool
+ns_querylog_binary(ns_querylog_t *ql);
+/*%<
+ * Return true if a binary query log is being written.
+ */
+
+void
+ns_querylog_flush(ns_querylog_t *ql);
+/*%<
+ * Wait until the writer thread has taken all the messages queued so far
+ * from the rings.
+ */
+
+void
+ns_querylog_getcounters(ns_querylog_t *ql, uint64_t *loggedp,
+			uint64_t *droppedp);
+/*%<
+ * Get the number of messages the writer thread has logged and the
+ * number of messages that have been dropped.
+ */
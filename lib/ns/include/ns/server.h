@@ -18,6 +18,7 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+#include <isc/atomic.h>
 #include <isc/fuzz.h>
 #include <isc/histo.h>
 #include <isc/log.h>
@@ -51,6 +52,12 @@
 #define NS_SERVER_TRANSFERSTUCK	 0x00020000U /*%< -T transferstuck */
 #define NS_SERVER_LOGRESPONSES	 0x00040000U /*%< log responses */
 
+/*%
+ * Precision of the request latency histograms: with 3 significant bits
+ * each bucket is within 12.5% of the values it counts.
+ */
+#define NS_LATENCY_SIGBITS 3
+
 /*%
  * Type for callback function to get hostname.
  */
@@ -81,10 +88,11 @@ struct ns_server {
 	isc_refcount_t references;
 
 	/*% Server cookie secret and algorithm */
-	unsigned char	   secret[32];
-	ns_cookiealg_t	   cookiealg;
-	ns_altsecretlist_t altsecrets;
-	bool		   answercookie;
+	unsigned char	     secret[32];
+	ns_cookiealg_t	     cookiealg;
+	ns_altsecretlist_t   altsecrets;
+	bool		     answercookie;
+	atomic_uint_fast32_t cookiegen; /*%< bumped when the secrets change */
 
 	/*% Quotas */
 	isc_quota_t recursionquota;
@@ -106,6 +114,9 @@ struct ns_server {
 	dns_tkeyctx_t *tkeyctx;
 	uint8_t	       max_restarts;
 
+	/*% Rendered outgoing zone transfer messages */
+	ns_xfrcache_t *xfrcache;
+
 	/*% Server id for NSID */
 	char *server_id;
 	bool  usehostname;
@@ -132,6 +143,15 @@ struct ns_server {
 	isc_histomulti_t *tcpoutstats4;
 	isc_histomulti_t *tcpinstats6;
 	isc_histomulti_t *tcpoutstats6;
+
+	/*% Asynchronous writer for the query log */
+	ns_querylog_t *querylog;
+
+	/*% Request latencies in microseconds, per stage */
+	isc_histomulti_t *latency[ns_latency_max];
+
+	/*% The most frequent query names, types and clients */
+	ns_hitters_t *hitters;
 };
 
 struct ns_altsecret {
@@ -126,7 +126,16 @@ enum {
 	ns_statscounter_encryptedproxydot = 77,
 	ns_statscounter_encryptedproxydoh = 78,
 
-	ns_statscounter_max = 79,
+	ns_statscounter_respcachehit = 79,
+
+	ns_statscounter_xfrcachehit = 80,
+
+	ns_statscounter_clientpoolhit = 81,
+	ns_statscounter_clientpoolmiss = 82,
+
+	ns_statscounter_querylogdropped = 83,
+
+	ns_statscounter_max = 84,
 };
 
 void
@@ -138,6 +147,13 @@ ns_stats_detach(ns_stats_t **statsp);
 void
 ns_stats_create(isc_mem_t *mctx, int ncounters, ns_stats_t **statsp);
 
+void
+ns_stats_createperloop(isc_mem_t *mctx, int ncounters, ns_stats_t **statsp);
+/*%<
+ * Like ns_stats_create(), but the counters are kept per loop, see
+ * isc_stats_createperloop().
+ */
+
 isc_statscounter_t
 ns_stats_increment(ns_stats_t *stats, isc_statscounter_t counter);
 
@@ -17,17 +17,36 @@
 
 typedef struct ns_altsecret ns_altsecret_t;
 typedef ISC_LIST(ns_altsecret_t) ns_altsecretlist_t;
+typedef struct ns_anscache  ns_anscache_t;
 typedef struct ns_client    ns_client_t;
 typedef struct ns_clientmgr ns_clientmgr_t;
+typedef struct ns_hitters   ns_hitters_t;
 typedef struct ns_plugin    ns_plugin_t;
 typedef ISC_LIST(ns_plugin_t) ns_plugins_t;
 typedef struct ns_interface    ns_interface_t;
 typedef struct ns_interfacemgr ns_interfacemgr_t;
 typedef struct ns_query	       ns_query_t;
+typedef struct ns_querylog     ns_querylog_t;
 typedef struct ns_server       ns_server_t;
 typedef struct ns_stats	       ns_stats_t;
 typedef struct ns_hookasync    ns_hookasync_t;
+typedef struct ns_xfrcache     ns_xfrcache_t;
+typedef struct ns_xfrcacheentry ns_xfrcacheentry_t;
 
 typedef enum { ns_cookiealg_siphash24 } ns_cookiealg_t;
 
+/*%
+ * The stages of processing a request whose latency is measured.
+ */
+typedef enum {
+	ns_latency_parse = 0, /*%< from receipt until the message is parsed */
+	ns_latency_view,      /*%< matching the ACLs and the view */
+	ns_latency_lookup,    /*%< processing, apart from recursion */
+	ns_latency_recursion, /*%< waiting for the resolver and validator */
+	ns_latency_render,    /*%< rendering the response */
+	ns_latency_send,      /*%< until the response has been sent */
+	ns_latency_total,     /*%< from receipt until the request ends */
+	ns_latency_max
+} ns_latency_t;
+
 #define NS_COOKIE_VERSION_1 1
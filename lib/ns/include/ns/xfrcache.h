@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*! \file include/ns/xfrcache.h
+ * \brief
+ * A cache of rendered outgoing AXFR messages.
+ *
+ * When the same version of a zone is transferred to many secondaries,
+ * the messages of the transfer only differ in the message ID, the flags,
+ * the EDNS OPT record and the TSIG record.  The cache stores the question
+ * and answer sections of each message, rendered and compressed, so that
+ * the zone database is walked and the messages are compressed only once
+ * per version of the zone.
+ *
+ * The messages of an entry are rendered on demand by a builder supplied
+ * when the entry is added: whichever transfer is the first to need the
+ * next message renders it, under the entry lock, and all the others copy
+ * it.  The transfers running concurrently thus share the work whatever
+ * order they progress in.
+ *
+ * The cache is shared by all the client managers, so it is locked.  Its
+ * size is bounded by the total size of the stored messages; unused
+ * entries are evicted in the least recently used order, and after
+ * NS_XFRCACHE_IDLETIME seconds without a transfer.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/buffer.h>
+#include <isc/list.h>
+#include <isc/mem.h>
+#include <isc/refcount.h>
+#include <isc/region.h>
+
+#include <dns/name.h>
+#include <dns/types.h>
+
+#include <ns/types.h>
+
+/*%
+ * The space left free in each cached message for the OPT and TSIG
+ * records of the transfers it is sent in.  The transfers that need
+ * more than this are not served from the cache.
+ */
+#define NS_XFRCACHE_RESERVE 1024
+
+#define NS_XFRCACHE_IDLETIME 600
+
+typedef struct ns_xfrcachekey {
+	/*%
+	 * The zone is only compared, to find the entries of the older
+	 * versions of the zone; the database is referenced by the entry.
+	 */
+	dns_zone_t *zone;
+	dns_db_t   *db;
+	uint32_t    serial;
+	uint16_t    msgsize; /*%< transfer-message-size at rendering time */
+	uint16_t    qclass;
+	uint8_t	    qnamelen;
+	uint8_t	    qname[DNS_NAME_MAXWIRE];
+} ns_xfrcachekey_t;
+
+typedef struct ns_xfrmsg ns_xfrmsg_t;
+struct ns_xfrmsg {
+	isc_region_t question; /*%< empty except in the first message */
+	isc_region_t answer;
+	unsigned int ancount;
+	bool	     last; /*%< the last message of the transfer */
+	ISC_LINK(ns_xfrmsg_t) link;
+};
+
+/*%
+ * Render the next message of the transfer into 'target', which is
+ * large enough for any DNS message.  The message header is rendered but
+ * not used; it must be followed by '*questionlenp' bytes of question
+ * section and by the '*ancountp' answer records.  '*lastp' is set to
+ * true when the message is the last one.
+ */
+typedef isc_result_t (*ns_xfrcache_render_t)(void *arg, isc_buffer_t *target,
+					     unsigned int *questionlenp,
+					     unsigned int *ancountp,
+					     bool	  *lastp);
+
+/*%
+ * Free the builder state; called when the last message has been
+ * rendered, when rendering failed, or when the entry is destroyed.
+ */
+typedef void (*ns_xfrcache_free_t)(void *arg);
+
+void
+ns_xfrcache_create(isc_mem_t *mctx, ns_xfrcache_t **cachep);
+/*%<
+ * Create an empty transfer cache.  Nothing is cached until a maximum
+ * size is set with ns_xfrcache_setmaxsize().
+ *
+ * Requires:
+ *\li	'cachep' is not NULL and '*cachep' is NULL.
+ */
+
+void
+ns_xfrcache_destroy(ns_xfrcache_t **cachep);
+/*%<
+ * Destroy the transfer cache and all its entries.
+ *
+ * Requires:
+ *\li	No entry is attached by anything but the cache.
+ */
+
+void
+ns_xfrcache_setmaxsize(ns_xfrcache_t *cache, uint64_t maxsize);
+/*%<
+ * Set the maximum total size of the cached messages; 0 disables the
+ * cache.  The entries that are not in use are evicted until the cache
+ * fits.
+ */
+
+void
+ns_xfrcache_initkey(ns_xfrcachekey_t *key, dns_zone_t *zone, dns_db_t *db,
+		    uint32_t serial, const dns_name_t *qname);
+/*%<
+ * Initialize 'key' for a transfer of 'serial' from 'db' of 'zone' asked
+ * for with 'qname'; the rest of the key is filled in by the caller.  The
+ * name is compared case-sensitively, as its case is preserved in the
+ * question section and it is the target of the name compression.
+ */
+
+isc_result_t
+ns_xfrcache_find(ns_xfrcache_t *cache, const ns_xfrcachekey_t *key,
+		 uint64_t estimate, ns_xfrcacheentry_t **entryp);
+/*%<
+ * Find the entry for 'key', and attach it to '*entryp'.  The entries
+ * for other versions of the same zone are removed from the cache.
+ *
+ * 'estimate' is the expected size of the transfer; if the cache can't
+ * hold it, the transfer shouldn't be cached.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOTFOUND		the entry can be added
+ *\li	#ISC_R_NOSPACE		the cache is disabled or too small
+ */
+
+void
+ns_xfrcache_add(ns_xfrcache_t *cache, const ns_xfrcachekey_t *key,
+		ns_xfrcache_render_t render, ns_xfrcache_free_t freebuilder,
+		void *arg, ns_xfrcacheentry_t **entryp);
+/*%<
+ * Add an entry for 'key', whose messages are rendered by 'render' called
+ * with 'arg', and attach it to '*entryp'.  If an entry for 'key' has
+ * been added in the meantime, it is attached instead and the builder is
+ * freed.
+ */
+
+isc_result_t
+ns_xfrcache_next(ns_xfrcacheentry_t *entry, const ns_xfrmsg_t *prev,
+		 const ns_xfrmsg_t **msgp);
+/*%<
+ * Set '*msgp' to the message following 'prev', or to the first message
+ * if 'prev' is NULL, rendering it if no transfer has needed it yet.  The
+ * message stays valid as long as the entry is attached.
+ *
+ * Requires:
+ *\li	'prev' is NULL or is not the last message.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	any error returned by the builder, for this and all the later
+ *	calls.
+ */
+
+ISC_REFCOUNT_DECL(ns_xfrcacheentry);
+/*%<
+ * Attach to and detach from a cache entry.
+ */
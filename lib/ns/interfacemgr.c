@@ -46,6 +46,7 @@
 #define LINUX_NETLINK_AVAILABLE
 #include <linux/netlink.h>
 #include <linux/rtnetlink.h>
+#include <net/if.h>
 #if defined(RTM_NEWADDR) && defined(RTM_DELADDR)
 #define MSGHDR	nlmsghdr
 #define MSGTYPE nlmsg_type
@@ -55,6 +56,16 @@
 
 #define LISTENING(ifp) (((ifp)->flags & NS_INTERFACEFLAG_LISTENING) != 0)
 
+/*%
+ * A local address found by the last scan or reported by the kernel
+ * since; the localhost and localnets ACLs are built from them.
+ */
+typedef struct localaddr localaddr_t;
+struct localaddr {
+	isc_interface_t interface;
+	ISC_LINK(localaddr_t) link;
+};
+
 #define IFMGR_MAGIC		 ISC_MAGIC('I', 'F', 'M', 'G')
 #define NS_INTERFACEMGR_VALID(t) ISC_MAGIC_VALID(t, IFMGR_MAGIC)
 
@@ -75,7 +86,10 @@ struct ns_interfacemgr {
 	dns_aclenv_t *aclenv;		     /*%< Localhost/localnets ACLs */
 	ISC_LIST(ns_interface_t) interfaces; /*%< List of interfaces */
 	ISC_LIST(isc_sockaddr_t) listenon;
+	ISC_LIST(localaddr_t) localaddrs;
 	int backlog;		     /*%< Listen queue size */
+	char **xdpifaces;	     /*%< AF_XDP interface names */
+	size_t nxdpifaces;
 	atomic_bool shuttingdown;    /*%< Interfacemgr shutting down */
 	ns_clientmgr_t **clientmgrs; /*%< Client managers */
 	isc_nmhandle_t *route;
@@ -87,111 +101,22 @@ purge_old_interfaces(ns_interfacemgr_t *mgr);
 static void
 clearlistenon(ns_interfacemgr_t *mgr);
 
-static bool
-need_rescan(ns_interfacemgr_t *mgr, struct MSGHDR *rtm, size_t len) {
-	if (rtm->MSGTYPE != RTM_NEWADDR && rtm->MSGTYPE != RTM_DELADDR) {
-		return false;
-	}
-
-#ifndef LINUX_NETLINK_AVAILABLE
-	UNUSED(mgr);
-	UNUSED(len);
-	/* On most systems, any NEWADDR or DELADDR means we rescan */
-	return true;
-#else  /* LINUX_NETLINK_AVAILABLE */
-	/* ...but on linux we need to check the messages more carefully */
-	for (struct MSGHDR *nlh = rtm;
-	     NLMSG_OK(nlh, len) && nlh->nlmsg_type != NLMSG_DONE;
-	     nlh = NLMSG_NEXT(nlh, len))
-	{
-		struct ifaddrmsg *ifa = (struct ifaddrmsg *)NLMSG_DATA(nlh);
-		struct rtattr *rth = IFA_RTA(ifa);
-		size_t rtl = IFA_PAYLOAD(nlh);
+static void
+clearxdpinterfaces(ns_interfacemgr_t *mgr);
 
-		while (rtl > 0 && RTA_OK(rth, rtl)) {
-			/*
-			 * Look for IFA_ADDRESS to detect IPv6 interface
-			 * state changes.
-			 */
-			if (rth->rta_type == IFA_ADDRESS &&
-			    ifa->ifa_family == AF_INET6)
-			{
-				bool existed = false;
-				bool was_listening = false;
-				isc_netaddr_t addr = { 0 };
-				ns_interface_t *ifp = NULL;
-
-				isc_netaddr_fromin6(&addr, RTA_DATA(rth));
-				INSIST(isc_netaddr_getzone(&addr) == 0);
-
-				/*
-				 * Check whether we were listening on the
-				 * address. We need to do this as the
-				 * Linux kernel seems to issue messages
-				 * containing IFA_ADDRESS far more often
-				 * than the actual state changes (on
-				 * router advertisements?)
-				 */
-				LOCK(&mgr->lock);
-				for (ifp = ISC_LIST_HEAD(mgr->interfaces);
-				     ifp != NULL;
-				     ifp = ISC_LIST_NEXT(ifp, link))
-				{
-					isc_netaddr_t tmp = { 0 };
-					isc_netaddr_fromsockaddr(&tmp,
-								 &ifp->addr);
-					if (tmp.family != AF_INET6) {
-						continue;
-					}
-
-					/*
-					 * We have to nullify the zone (IPv6
-					 * scope ID) because we haven't got one
-					 * from the kernel. Otherwise match
-					 * could fail even for an existing
-					 * address.
-					 */
-					isc_netaddr_setzone(&tmp, 0);
-					if (isc_netaddr_equal(&tmp, &addr)) {
-						was_listening = LISTENING(ifp);
-						existed = true;
-						break;
-					}
-				}
-				UNLOCK(&mgr->lock);
-
-				/*
-				 * Do rescan if the state of the interface
-				 * has changed.
-				 */
-				if ((!existed && rtm->MSGTYPE == RTM_NEWADDR) ||
-				    (existed && was_listening &&
-				     rtm->MSGTYPE == RTM_DELADDR))
-				{
-					return true;
-				}
-			} else if (rth->rta_type == IFA_ADDRESS &&
-				   ifa->ifa_family == AF_INET)
-			{
-				/*
-				 * It seems that the IPv4 P2P link state
-				 * has changed.
-				 */
-				return true;
-			} else if (rth->rta_type == IFA_LOCAL) {
-				/*
-				 * Local address state has changed - do
-				 * rescan.
-				 */
-				return true;
-			}
-			rth = RTA_NEXT(rth, rtl);
-		}
-	}
-#endif /* LINUX_NETLINK_AVAILABLE */
+static void
+clearlocaladdrs(ns_interfacemgr_t *mgr);
 
-	return false;
+#ifdef LINUX_NETLINK_AVAILABLE
+static void
+route_update(ns_interfacemgr_t *mgr, struct MSGHDR *rtm, size_t len);
+#else  /* LINUX_NETLINK_AVAILABLE */
+static bool
+need_rescan(struct MSGHDR *rtm) {
+	/* Any NEWADDR or DELADDR means we rescan */
+	return rtm->MSGTYPE == RTM_NEWADDR || rtm->MSGTYPE == RTM_DELADDR;
 }
+#endif /* LINUX_NETLINK_AVAILABLE */
 
 static void
 route_recv(isc_nmhandle_t *handle, isc_result_t eresult, isc_region_t *region,
@@ -243,9 +168,17 @@ route_recv(isc_nmhandle_t *handle, isc_result_t eresult, isc_region_t *region,
 
 	REQUIRE(mgr->route != NULL);
 
-	if (need_rescan(mgr, rtm, rtmlen) && mgr->sctx->interface_auto) {
+#ifdef LINUX_NETLINK_AVAILABLE
+	if (mgr->sctx->interface_auto) {
+		route_update(mgr, rtm, rtmlen);
+	}
+#else  /* LINUX_NETLINK_AVAILABLE */
+	UNUSED(rtmlen);
+
+	if (need_rescan(rtm) && mgr->sctx->interface_auto) {
 		ns_interfacemgr_scan(mgr, false, false);
 	}
+#endif /* LINUX_NETLINK_AVAILABLE */
 
 	isc_nm_read(handle, route_recv, mgr);
 	return;
@@ -300,6 +233,7 @@ ns_interfacemgr_create(isc_mem_t *mctx, ns_server_t *sctx,
 
 	ISC_LIST_INIT(mgr->interfaces);
 	ISC_LIST_INIT(mgr->listenon);
+	ISC_LIST_INIT(mgr->localaddrs);
 
 	/*
 	 * The listen-on lists are initially empty.
@@ -384,6 +318,8 @@ ns_interfacemgr__destroy(ns_interfacemgr_t *mgr) {
 	ns_listenlist_detach(&mgr->listenon4);
 	ns_listenlist_detach(&mgr->listenon6);
 	clearlistenon(mgr);
+	clearlocaladdrs(mgr);
+	clearxdpinterfaces(mgr);
 	isc_mutex_destroy(&mgr->lock);
 	for (size_t i = 0; i < mgr->ncpus; i++) {
 		ns_clientmgr_detach(&mgr->clientmgrs[i]);
@@ -406,6 +342,62 @@ ns_interfacemgr_setbacklog(ns_interfacemgr_t *mgr, int backlog) {
 	UNLOCK(&mgr->lock);
 }
 
+void
+ns_interfacemgr_setclientpool(ns_interfacemgr_t *mgr, uint32_t initial,
+			      uint32_t max) {
+	REQUIRE(NS_INTERFACEMGR_VALID(mgr));
+
+	for (size_t i = 0; i < mgr->ncpus; i++) {
+		ns_clientmgr_setpool(mgr->clientmgrs[i], initial, max);
+	}
+}
+
+static void
+clearxdpinterfaces(ns_interfacemgr_t *mgr) {
+	for (size_t i = 0; i < mgr->nxdpifaces; i++) {
+		isc_mem_free(mgr->mctx, mgr->xdpifaces[i]);
+	}
+	if (mgr->xdpifaces != NULL) {
+		isc_mem_cput(mgr->mctx, mgr->xdpifaces, mgr->nxdpifaces,
+			     sizeof(mgr->xdpifaces[0]));
+	}
+	mgr->nxdpifaces = 0;
+}
+
+void
+ns_interfacemgr_setxdpinterfaces(ns_interfacemgr_t *mgr,
+				 const char *const *names, size_t count) {
+	REQUIRE(NS_INTERFACEMGR_VALID(mgr));
+	REQUIRE(names != NULL || count == 0);
+
+	LOCK(&mgr->lock);
+	clearxdpinterfaces(mgr);
+	if (count > 0) {
+		mgr->xdpifaces = isc_mem_cget(mgr->mctx, count,
+					      sizeof(mgr->xdpifaces[0]));
+		for (size_t i = 0; i < count; i++) {
+			mgr->xdpifaces[i] = isc_mem_strdup(mgr->mctx,
+							   names[i]);
+		}
+		mgr->nxdpifaces = count;
+	}
+	UNLOCK(&mgr->lock);
+}
+
+static bool
+usexdp(ns_interface_t *ifp) {
+	ns_interfacemgr_t *mgr = ifp->mgr;
+	bool found = false;
+
+	LOCK(&mgr->lock);
+	for (size_t i = 0; !found && i < mgr->nxdpifaces; i++) {
+		found = (strcmp(mgr->xdpifaces[i], ifp->name) == 0);
+	}
+	UNLOCK(&mgr->lock);
+
+	return found;
+}
+
 dns_aclenv_t *
 ns_interfacemgr_getaclenv(ns_interfacemgr_t *mgr) {
 	dns_aclenv_t *aclenv = NULL;
@@ -494,6 +486,30 @@ ns_interface_listenudp(ns_interface_t *ifp, isc_nm_proxy_type_t proxy) {
 					       &ifp->addr, ns_client_request,
 					       ifp, &ifp->udplistensocket);
 	}
+
+	/*
+	 * The AF_XDP fast path is an addition to the regular UDP listener,
+	 * which keeps serving the traffic the XDP program passes on to the
+	 * kernel; failing to set it up is not fatal.
+	 */
+	if (result == ISC_R_SUCCESS && proxy == ISC_NM_PROXY_NONE &&
+	    usexdp(ifp))
+	{
+		isc_result_t xresult = isc_nm_listenxdp(
+			ifp->mgr->nm, ISC_NM_LISTEN_ALL, ifp->name, &ifp->addr,
+			ns_client_request, ifp, &ifp->xdplistensocket);
+		if (xresult != ISC_R_SUCCESS) {
+			char sabuf[ISC_SOCKADDR_FORMATSIZE];
+			isc_sockaddr_format(&ifp->addr, sabuf, sizeof(sabuf));
+			isc_log_write(NS_LOGCATEGORY_NETWORK,
+				      NS_LOGMODULE_INTERFACEMGR,
+				      ISC_LOG_WARNING,
+				      "AF_XDP listener on %s (%s) failed: %s",
+				      ifp->name, sabuf,
+				      isc_result_totext(xresult));
+		}
+	}
+
 	return result;
 }
 
@@ -655,6 +671,28 @@ ns_interface_listenhttp(ns_interface_t *ifp, isc_nm_proxy_type_t proxy,
 #endif
 }
 
+/*
+ * Set the TCP Fast Open queue length of the TCP based listeners of the
+ * interface, if it has changed.
+ */
+static void
+interface_setfastopen(ns_interface_t *ifp, unsigned int qlen) {
+	isc_nmsocket_t *socks[] = { ifp->tcplistensocket, ifp->tlslistensocket,
+				    ifp->http_listensocket,
+				    ifp->http_secure_listensocket };
+
+	if (ifp->fastopen == qlen) {
+		return;
+	}
+	ifp->fastopen = qlen;
+
+	for (size_t i = 0; i < ARRAY_SIZE(socks); i++) {
+		if (socks[i] != NULL) {
+			isc_nm_listener_setfastopen(socks[i], qlen);
+		}
+	}
+}
+
 static isc_result_t
 interface_setup(ns_interfacemgr_t *mgr, isc_sockaddr_t *addr, const char *name,
 		ns_interface_t **ifpret, ns_listenelt_t *elt,
@@ -687,6 +725,7 @@ interface_setup(ns_interfacemgr_t *mgr, isc_sockaddr_t *addr, const char *name,
 		if (result != ISC_R_SUCCESS) {
 			goto cleanup_interface;
 		}
+		interface_setfastopen(ifp, elt->fastopen);
 		*ifpret = ifp;
 		return result;
 	}
@@ -696,6 +735,7 @@ interface_setup(ns_interfacemgr_t *mgr, isc_sockaddr_t *addr, const char *name,
 		if (result != ISC_R_SUCCESS) {
 			goto cleanup_interface;
 		}
+		interface_setfastopen(ifp, elt->fastopen);
 		*ifpret = ifp;
 		return result;
 	}
@@ -726,6 +766,7 @@ interface_setup(ns_interfacemgr_t *mgr, isc_sockaddr_t *addr, const char *name,
 			result = ISC_R_SUCCESS;
 		}
 	}
+	interface_setfastopen(ifp, elt->fastopen);
 	*ifpret = ifp;
 	return result;
 
@@ -737,11 +778,16 @@ cleanup_interface:
 void
 ns_interface_shutdown(ns_interface_t *ifp) {
 	ifp->flags &= ~NS_INTERFACEFLAG_LISTENING;
+	ifp->fastopen = 0;
 
 	if (ifp->udplistensocket != NULL) {
 		isc_nm_stoplistening(ifp->udplistensocket);
 		isc_nmsocket_close(&ifp->udplistensocket);
 	}
+	if (ifp->xdplistensocket != NULL) {
+		isc_nm_stoplistening(ifp->xdplistensocket);
+		isc_nmsocket_close(&ifp->xdplistensocket);
+	}
 	if (ifp->tcplistensocket != NULL) {
 		isc_nm_stoplistening(ifp->tcplistensocket);
 		isc_nmsocket_close(&ifp->tcplistensocket);
@@ -1019,6 +1065,8 @@ update_listener_configuration(ns_interfacemgr_t *mgr, ns_interface_t *ifp,
 	}
 #endif /* HAVE_LIBNGHTTP2 */
 
+	interface_setfastopen(ifp, le->fastopen);
+
 	UNLOCK(&mgr->lock);
 }
 
@@ -1074,6 +1122,118 @@ interface_update_or_shutdown(ns_interfacemgr_t *mgr, ns_interface_t *ifp,
 	return false;
 }
 
+/*
+ * Listen on 'interface' on the ports of the listen-on statements whose
+ * ACL it matches.
+ */
+static void
+interface_listen(ns_interfacemgr_t *mgr, isc_interface_t *interface,
+		 bool config, bool *tried_listening,
+		 bool *all_addresses_in_use) {
+	isc_result_t result;
+	unsigned int family = interface->address.family;
+	ns_listenlist_t *ll = (family == AF_INET) ? mgr->listenon4
+						  : mgr->listenon6;
+	ns_listenelt_t *le = NULL;
+	ns_interface_t *ifp = NULL;
+	bool dolistenon = true;
+	char sabuf[ISC_SOCKADDR_FORMATSIZE];
+
+	for (le = ISC_LIST_HEAD(ll->elts); le != NULL;
+	     le = ISC_LIST_NEXT(le, link))
+	{
+		int match;
+		bool addr_in_use = false;
+		isc_sockaddr_t listen_sockaddr;
+
+		isc_sockaddr_fromnetaddr(&listen_sockaddr, &interface->address,
+					 le->port);
+
+		/*
+		 * See if the address matches the listen-on statement;
+		 * if not, ignore the interface, but store it in
+		 * the interface table so we know we've seen it
+		 * before.
+		 */
+		(void)dns_acl_match(&interface->address, NULL, le->acl,
+				    mgr->aclenv, &match, NULL);
+		if (match <= 0) {
+			ns_interface_t *new = NULL;
+			ns_interface_create(mgr, &listen_sockaddr,
+					    interface->name, &new);
+			continue;
+		}
+
+		if (dolistenon) {
+			setup_listenon(mgr, interface, le->port);
+			dolistenon = false;
+		}
+
+		ifp = find_matching_interface(mgr, &listen_sockaddr);
+		if (ifp != NULL) {
+			bool cont = interface_update_or_shutdown(mgr, ifp, le,
+								 config);
+			if (cont) {
+				continue;
+			}
+		}
+
+		isc_sockaddr_format(&listen_sockaddr, sabuf, sizeof(sabuf));
+		isc_log_write(NS_LOGCATEGORY_NETWORK, NS_LOGMODULE_INTERFACEMGR,
+			      ISC_LOG_INFO, "listening on %s interface %s, %s",
+			      (family == AF_INET) ? "IPv4" : "IPv6",
+			      interface->name, sabuf);
+
+		result = interface_setup(mgr, &listen_sockaddr, interface->name,
+					 &ifp, le, &addr_in_use);
+
+		*tried_listening = true;
+		if (!addr_in_use) {
+			*all_addresses_in_use = false;
+		}
+
+		if (result != ISC_R_SUCCESS) {
+			isc_log_write(NS_LOGCATEGORY_NETWORK,
+				      NS_LOGMODULE_INTERFACEMGR, ISC_LOG_ERROR,
+				      "creating %s interface %s failed; "
+				      "interface ignored",
+				      (family == AF_INET) ? "IPv4" : "IPv6",
+				      interface->name);
+		}
+	}
+}
+
+static void
+add_localaddr(ns_interfacemgr_t *mgr, isc_interface_t *interface) {
+	localaddr_t *la = isc_mem_get(mgr->mctx, sizeof(*la));
+
+	*la = (localaddr_t){ .interface = *interface };
+	ISC_LINK_INIT(la, link);
+
+	LOCK(&mgr->lock);
+	ISC_LIST_APPEND(mgr->localaddrs, la, link);
+	UNLOCK(&mgr->lock);
+}
+
+static void
+clearlocaladdrs(ns_interfacemgr_t *mgr) {
+	ISC_LIST(localaddr_t) localaddrs;
+	localaddr_t *la = NULL;
+
+	ISC_LIST_INIT(localaddrs);
+
+	LOCK(&mgr->lock);
+	ISC_LIST_MOVE(localaddrs, mgr->localaddrs);
+	UNLOCK(&mgr->lock);
+
+	la = ISC_LIST_HEAD(localaddrs);
+	while (la != NULL) {
+		ISC_LIST_UNLINK(localaddrs, la, link);
+		isc_mem_put(mgr->mctx, la, sizeof(*la));
+		la = ISC_LIST_HEAD(localaddrs);
+	}
+}
+
 static isc_result_t
 do_scan(ns_interfacemgr_t *mgr, bool verbose, bool config) {
 	isc_interfaceiter_t *iter = NULL;
@@ -1081,10 +1241,6 @@ do_scan(ns_interfacemgr_t *mgr, bool verbose, bool config) {
 	bool scan_ipv6 = false;
 	isc_result_t result;
 	isc_netaddr_t zero_address, zero_address6;
-	ns_listenelt_t *le = NULL;
-	ns_interface_t *ifp = NULL;
-	bool dolistenon;
-	char sabuf[ISC_SOCKADDR_FORMATSIZE];
 	bool tried_listening;
 	bool all_addresses_in_use;
 	dns_acl_t *localhost = NULL;
@@ -1118,6 +1274,7 @@ do_scan(ns_interfacemgr_t *mgr, bool verbose, bool config) {
 	dns_acl_create(mgr->mctx, 0, &localnets);
 
 	clearlistenon(mgr);
+	clearlocaladdrs(mgr);
 
 	tried_listening = false;
 	all_addresses_in_use = true;
@@ -1125,7 +1282,6 @@ do_scan(ns_interfacemgr_t *mgr, bool verbose, bool config) {
 	     result = isc_interfaceiter_next(iter))
 	{
 		isc_interface_t interface;
-		ns_listenlist_t *ll = NULL;
 		unsigned int family;
 
 		result = isc_interfaceiter_current(iter, &interface);
@@ -1178,77 +1334,9 @@ do_scan(ns_interfacemgr_t *mgr, bool verbose, bool config) {
 		}
 
 	listenon:
-		ll = (family == AF_INET) ? mgr->listenon4 : mgr->listenon6;
-		dolistenon = true;
-		for (le = ISC_LIST_HEAD(ll->elts); le != NULL;
-		     le = ISC_LIST_NEXT(le, link))
-		{
-			int match;
-			bool addr_in_use = false;
-			isc_sockaddr_t listen_sockaddr;
-
-			isc_sockaddr_fromnetaddr(&listen_sockaddr,
-						 &interface.address, le->port);
-
-			/*
-			 * See if the address matches the listen-on statement;
-			 * if not, ignore the interface, but store it in
-			 * the interface table so we know we've seen it
-			 * before.
-			 */
-			(void)dns_acl_match(&interface.address, NULL, le->acl,
-					    mgr->aclenv, &match, NULL);
-			if (match <= 0) {
-				ns_interface_t *new = NULL;
-				ns_interface_create(mgr, &listen_sockaddr,
-						    interface.name, &new);
-				continue;
-			}
-
-			if (dolistenon) {
-				setup_listenon(mgr, &interface, le->port);
-				dolistenon = false;
-			}
-
-			ifp = find_matching_interface(mgr, &listen_sockaddr);
-			if (ifp != NULL) {
-				bool cont = interface_update_or_shutdown(
-					mgr, ifp, le, config);
-				if (cont) {
-					continue;
-				}
-			}
-
-			isc_sockaddr_format(&listen_sockaddr, sabuf,
-					    sizeof(sabuf));
-			isc_log_write(NS_LOGCATEGORY_NETWORK,
-				      NS_LOGMODULE_INTERFACEMGR, ISC_LOG_INFO,
-				      "listening on %s interface "
-				      "%s, %s",
-				      (family == AF_INET) ? "IPv4" : "IPv6",
-				      interface.name, sabuf);
-
-			result = interface_setup(mgr, &listen_sockaddr,
-						 interface.name, &ifp, le,
-						 &addr_in_use);
-
-			tried_listening = true;
-			if (!addr_in_use) {
-				all_addresses_in_use = false;
-			}
-
-			if (result != ISC_R_SUCCESS) {
-				isc_log_write(NS_LOGCATEGORY_NETWORK,
-					      NS_LOGMODULE_INTERFACEMGR,
-					      ISC_LOG_ERROR,
-					      "creating %s interface "
-					      "%s failed; interface ignored",
-					      (family == AF_INET) ? "IPv4"
-								  : "IPv6",
-					      interface.name);
-			}
-			/* Continue. */
-		}
+		add_localaddr(mgr, &interface);
+		interface_listen(mgr, &interface, config, &tried_listening,
+				 &all_addresses_in_use);
 		continue;
 
 	ignore_interface:
@@ -1276,6 +1364,290 @@ do_scan(ns_interfacemgr_t *mgr, bool verbose, bool config) {
 	return result;
 }
 
+#ifdef LINUX_NETLINK_AVAILABLE
+static localaddr_t *
+find_localaddr(ns_interfacemgr_t *mgr, isc_netaddr_t *addr) {
+	localaddr_t *la = NULL;
+
+	LOCK(&mgr->lock);
+	for (la = ISC_LIST_HEAD(mgr->localaddrs); la != NULL;
+	     la = ISC_LIST_NEXT(la, link))
+	{
+		if (isc_netaddr_equal(&la->interface.address, addr)) {
+			break;
+		}
+	}
+	UNLOCK(&mgr->lock);
+
+	return la;
+}
+
+/*%
+ * Rebuild the localhost and localnets ACLs from the local addresses,
+ * adding 'interface' to them if it is not NULL.
+ */
+static isc_result_t
+update_locals(ns_interfacemgr_t *mgr, isc_interface_t *interface) {
+	isc_result_t result = ISC_R_SUCCESS;
+	dns_acl_t *localhost = NULL;
+	dns_acl_t *localnets = NULL;
+	localaddr_t *la = NULL;
+	bool fixedlocal = ((mgr->sctx->options & NS_SERVER_FIXEDLOCAL) != 0);
+
+	dns_acl_create(mgr->mctx, 0, &localhost);
+	dns_acl_create(mgr->mctx, 0, &localnets);
+
+	if (interface != NULL &&
+	    (!fixedlocal || isc_netaddr_isloopback(&interface->address)))
+	{
+		result = setup_locals(interface, localhost, localnets);
+		if (result != ISC_R_SUCCESS) {
+			goto cleanup;
+		}
+	}
+
+	LOCK(&mgr->lock);
+	for (la = ISC_LIST_HEAD(mgr->localaddrs); la != NULL;
+	     la = ISC_LIST_NEXT(la, link))
+	{
+		if (fixedlocal &&
+		    !isc_netaddr_isloopback(&la->interface.address))
+		{
+			continue;
+		}
+		result = setup_locals(&la->interface, localhost, localnets);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+	}
+	UNLOCK(&mgr->lock);
+
+	if (result == ISC_R_SUCCESS) {
+		dns_aclenv_set(mgr->aclenv, localhost, localnets);
+	}
+
+cleanup:
+	dns_acl_detach(&localnets);
+	dns_acl_detach(&localhost);
+
+	return result;
+}
+
+/*%
+ * Fill in 'interface' from the RTM_NEWADDR or RTM_DELADDR message 'nlh'.
+ */
+static isc_result_t
+route_getaddr(struct nlmsghdr *nlh, isc_interface_t *interface) {
+	struct ifaddrmsg *ifa = NLMSG_DATA(nlh);
+	struct rtattr *rta = IFA_RTA(ifa);
+	int rtalen = IFA_PAYLOAD(nlh);
+	void *address = NULL, *local = NULL;
+	const char *label = NULL;
+	unsigned int prefixlen = ifa->ifa_prefixlen;
+	uint8_t *mask = NULL;
+	size_t addrlen;
+
+	*interface = (isc_interface_t){ .af = ifa->ifa_family };
+
+	switch (ifa->ifa_family) {
+	case AF_INET:
+		if (isc_net_probeipv4() != ISC_R_SUCCESS || prefixlen > 32) {
+			return ISC_R_FAMILYNOSUPPORT;
+		}
+		addrlen = sizeof(struct in_addr);
+		break;
+	case AF_INET6:
+		if (isc_net_probeipv6() != ISC_R_SUCCESS || prefixlen > 128) {
+			return ISC_R_FAMILYNOSUPPORT;
+		}
+		addrlen = sizeof(struct in6_addr);
+		break;
+	default:
+		return ISC_R_FAMILYNOSUPPORT;
+	}
+
+	for (; RTA_OK(rta, rtalen); rta = RTA_NEXT(rta, rtalen)) {
+		switch (rta->rta_type) {
+		case IFA_ADDRESS:
+			address = RTA_DATA(rta);
+			break;
+		case IFA_LOCAL:
+			local = RTA_DATA(rta);
+			break;
+		case IFA_LABEL:
+			label = RTA_DATA(rta);
+			break;
+		default:
+			continue;
+		}
+		if (rta->rta_type != IFA_LABEL && RTA_PAYLOAD(rta) < addrlen) {
+			return ISC_R_UNEXPECTEDEND;
+		}
+	}
+
+	/* On point-to-point links, IFA_ADDRESS is the peer address */
+	if (local != NULL) {
+		address = local;
+	}
+	if (address == NULL) {
+		return ISC_R_NOTFOUND;
+	}
+
+	if (ifa->ifa_family == AF_INET) {
+		isc_netaddr_fromin(&interface->address, address);
+	} else {
+		isc_netaddr_fromin6(&interface->address, address);
+		if (isc_netaddr_islinklocal(&interface->address)) {
+			isc_netaddr_setzone(&interface->address,
+					    ifa->ifa_index);
+		}
+	}
+
+	/* Build the netmask from the prefix length */
+	interface->netmask.family = ifa->ifa_family;
+	mask = (uint8_t *)&interface->netmask.type;
+	for (unsigned int i = 0; i < prefixlen; i++) {
+		mask[i / 8] |= 0x80 >> (i % 8);
+	}
+
+	if (label != NULL) {
+		strlcpy(interface->name, label, sizeof(interface->name));
+	} else if (if_indextoname(ifa->ifa_index, interface->name) == NULL) {
+		snprintf(interface->name, sizeof(interface->name), "%u",
+			 ifa->ifa_index);
+	}
+
+	return ISC_R_SUCCESS;
+}
+
+/*%
+ * Start listening on a new local address.
+ */
+static void
+route_newaddr(ns_interfacemgr_t *mgr, isc_interface_t *interface) {
+	isc_result_t result;
+	bool tried_listening = false, all_addresses_in_use = true;
+
+	if (find_localaddr(mgr, &interface->address) != NULL) {
+		return;
+	}
+
+	result = update_locals(mgr, interface);
+	if (result != ISC_R_SUCCESS) {
+		isc_log_write(NS_LOGCATEGORY_NETWORK, NS_LOGMODULE_INTERFACEMGR,
+			      ISC_LOG_ERROR, "ignoring %s interface %s: %s",
+			      (interface->af == AF_INET) ? "IPv4" : "IPv6",
+			      interface->name, isc_result_totext(result));
+		return;
+	}
+
+	add_localaddr(mgr, interface);
+	interface_listen(mgr, interface, false, &tried_listening,
+			 &all_addresses_in_use);
+}
+
+/*%
+ * Stop listening on a local address that has been removed.
+ */
+static void
+route_deladdr(ns_interfacemgr_t *mgr, isc_interface_t *interface) {
+	localaddr_t *la = NULL;
+	ns_interface_t *ifp = NULL, *next = NULL;
+	isc_sockaddr_t *old = NULL, *nextold = NULL;
+	ISC_LIST(ns_interface_t) interfaces;
+	isc_netaddr_t netaddr;
+
+	la = find_localaddr(mgr, &interface->address);
+	if (la == NULL) {
+		return;
+	}
+
+	LOCK(&mgr->lock);
+	ISC_LIST_UNLINK(mgr->localaddrs, la, link);
+	UNLOCK(&mgr->lock);
+	isc_mem_put(mgr->mctx, la, sizeof(*la));
+
+	(void)update_locals(mgr, NULL);
+
+	ISC_LIST_INIT(interfaces);
+
+	LOCK(&mgr->lock);
+	for (ifp = ISC_LIST_HEAD(mgr->interfaces); ifp != NULL; ifp = next) {
+		INSIST(NS_INTERFACE_VALID(ifp));
+		next = ISC_LIST_NEXT(ifp, link);
+		isc_netaddr_fromsockaddr(&netaddr, &ifp->addr);
+		if (isc_netaddr_equal(&netaddr, &interface->address)) {
+			ISC_LIST_UNLINK(mgr->interfaces, ifp, link);
+			ISC_LIST_APPEND(interfaces, ifp, link);
+		}
+	}
+	for (old = ISC_LIST_HEAD(mgr->listenon); old != NULL; old = nextold) {
+		nextold = ISC_LIST_NEXT(old, link);
+		isc_netaddr_fromsockaddr(&netaddr, old);
+		if (isc_netaddr_equal(&netaddr, &interface->address)) {
+			ISC_LIST_UNLINK(mgr->listenon, old, link);
+			isc_mem_put(mgr->mctx, old, sizeof(*old));
+		}
+	}
+	UNLOCK(&mgr->lock);
+
+	for (ifp = ISC_LIST_HEAD(interfaces); ifp != NULL; ifp = next) {
+		next = ISC_LIST_NEXT(ifp, link);
+		if (LISTENING(ifp)) {
+			log_interface_shutdown(ifp);
+			ns_interface_shutdown(ifp);
+		}
+		ISC_LIST_UNLINK(interfaces, ifp, link);
+		interface_destroy(&ifp);
+	}
+}
+
+/*%
+ * Apply the address changes reported by the kernel to the listening
+ * sockets and the localhost and localnets ACLs, without walking all
+ * the interfaces.
+ */
+static void
+route_update(ns_interfacemgr_t *mgr, struct MSGHDR *rtm, size_t len) {
+	struct nlmsghdr *nlh = NULL;
+	int left = (int)len;
+
+	REQUIRE(isc_tid() == 0);
+
+	for (nlh = rtm; NLMSG_OK(nlh, left); nlh = NLMSG_NEXT(nlh, left)) {
+		isc_interface_t interface;
+		isc_result_t result;
+
+		if (nlh->nlmsg_type != RTM_NEWADDR &&
+		    nlh->nlmsg_type != RTM_DELADDR)
+		{
+			continue;
+		}
+
+		if (nlh->nlmsg_len < NLMSG_LENGTH(sizeof(struct ifaddrmsg))) {
+			continue;
+		}
+
+		result = route_getaddr(nlh, &interface);
+		if (result != ISC_R_SUCCESS) {
+			continue;
+		}
+
+		if (nlh->nlmsg_type == RTM_NEWADDR) {
+			route_newaddr(mgr, &interface);
+		} else {
+			route_deladdr(mgr, &interface);
+		}
+	}
+
+	if (ISC_LIST_EMPTY(mgr->interfaces)) {
+		isc_log_write(NS_LOGCATEGORY_NETWORK, NS_LOGMODULE_INTERFACEMGR,
+			      ISC_LOG_WARNING,
+			      "not listening on any interfaces");
+	}
+}
+#endif /* LINUX_NETLINK_AVAILABLE */
+
 isc_result_t
 ns_interfacemgr_scan(ns_interfacemgr_t *mgr, bool verbose, bool config) {
 	isc_result_t result;
@@ -1372,6 +1744,35 @@ ns_interfacemgr_listeningon(ns_interfacemgr_t *mgr,
 	return result;
 }
 
+size_t
+ns_interfacemgr_listenerfds(ns_interfacemgr_t *mgr, int *fds, size_t size) {
+	size_t n = 0;
+
+	REQUIRE(NS_INTERFACEMGR_VALID(mgr));
+
+	LOCK(&mgr->lock);
+	for (ns_interface_t *ifp = ISC_LIST_HEAD(mgr->interfaces); ifp != NULL;
+	     ifp = ISC_LIST_NEXT(ifp, link))
+	{
+		isc_nmsocket_t *socks[] = { ifp->udplistensocket,
+					    ifp->tcplistensocket,
+					    ifp->tlslistensocket,
+					    ifp->http_listensocket,
+					    ifp->http_secure_listensocket };
+
+		for (size_t i = 0; i < ARRAY_SIZE(socks); i++) {
+			if (socks[i] != NULL) {
+				n += isc_nm_listenerfds(
+					socks[i], fds + ISC_MIN(n, size),
+					size - ISC_MIN(n, size));
+			}
+		}
+	}
+	UNLOCK(&mgr->lock);
+
+	return n;
+}
+
 ns_server_t *
 ns_interfacemgr_getserver(ns_interfacemgr_t *mgr) {
 	REQUIRE(NS_INTERFACEMGR_VALID(mgr));
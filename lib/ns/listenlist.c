@@ -150,6 +150,24 @@ listenelt_create(isc_mem_t *mctx, in_port_t port, dns_acl_t *acl,
 					sslctx, tls_params->session_tickets);
 			}
 
+			if (tls_params->ticket_key_file != NULL) {
+				result = isc_tlsctx_load_ticket_keys(
+					sslctx, tls_params->ticket_key_file,
+					tls_params->ticket_rotation);
+				if (result != ISC_R_SUCCESS) {
+					isc_log_write(
+						NS_LOGCATEGORY_GENERAL,
+						NS_LOGMODULE_INTERFACEMGR,
+						ISC_LOG_ERROR,
+						"loading of "
+						"session-ticket-key-file "
+						"'%s' failed: %s",
+						tls_params->ticket_key_file,
+						isc_result_totext(result));
+					goto tls_error;
+				}
+			}
+
 #ifdef HAVE_LIBNGHTTP2
 			if (is_http) {
 				isc_tlsctx_enable_http2server_alpn(sslctx);
@@ -198,6 +216,7 @@ listenelt_create(isc_mem_t *mctx, in_port_t port, dns_acl_t *acl,
 	elt->http_max_clients = 0;
 	elt->max_concurrent_streams = 0;
 	elt->proxy = proxy;
+	elt->fastopen = 0;
 
 	*target = elt;
 	return ISC_R_SUCCESS;
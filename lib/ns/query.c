@@ -21,6 +21,7 @@
 
 #include <isc/async.h>
 #include <isc/counter.h>
+#include <isc/hash.h>
 #include <isc/hex.h>
 #include <isc/log.h>
 #include <isc/mem.h>
@@ -32,6 +33,7 @@
 #include <isc/stats.h>
 #include <isc/string.h>
 #include <isc/thread.h>
+#include <isc/time.h>
 #include <isc/util.h>
 
 #include <dns/adb.h>
@@ -65,7 +67,9 @@
 #include <dns/zone.h>
 #include <dns/zt.h>
 
+#include <ns/anscache.h>
 #include <ns/client.h>
+#include <ns/hitters.h>
 #include <ns/hooks.h>
 #include <ns/interfacemgr.h>
 #include <ns/server.h>
@@ -259,6 +263,20 @@ get_hooktab(query_ctx_t *qctx) {
 	return qctx->view->hooktable;
 }
 
+/*
+ * Skip the hooks that only want queries of another type.
+ */
+static ns_hook_t *
+next_hook(ns_hook_t *hook, query_ctx_t *qctx) {
+	while (hook != NULL && hook->qtype != 0 && qctx != NULL &&
+	       hook->qtype != qctx->qtype)
+	{
+		hook = ISC_LIST_NEXT(hook, link);
+	}
+
+	return hook;
+}
+
 /*
  * Call the specified hook function in every configured module that implements
  * that function. If any hook function returns NS_HOOK_RETURN, we
@@ -275,7 +293,7 @@ get_hooktab(query_ctx_t *qctx) {
 		ns_hooktable_t *_tab = get_hooktab(_qctx);          \
 		ns_hook_t *_hook;                                   \
 		_hook = ISC_LIST_HEAD((*_tab)[_id]);                \
-		while (_hook != NULL) {                             \
+		while ((_hook = next_hook(_hook, _qctx)) != NULL) { \
 			ns_hook_action_t _func = _hook->action;     \
 			void *_data = _hook->action_data;           \
 			INSIST(_func != NULL);                      \
@@ -301,19 +319,19 @@ get_hooktab(query_ctx_t *qctx) {
  * (This could be implemented as a static void function, but is left as a
  * macro for symmetry with CALL_HOOK above.)
  */
-#define CALL_HOOK_NORETURN(_id, _qctx)                          \
-	do {                                                    \
-		isc_result_t _res;                              \
-		ns_hooktable_t *_tab = get_hooktab(_qctx);      \
-		ns_hook_t *_hook;                               \
-		_hook = ISC_LIST_HEAD((*_tab)[_id]);            \
-		while (_hook != NULL) {                         \
-			ns_hook_action_t _func = _hook->action; \
-			void *_data = _hook->action_data;       \
-			INSIST(_func != NULL);                  \
-			_func(_qctx, _data, &_res);             \
-			_hook = ISC_LIST_NEXT(_hook, link);     \
-		}                                               \
+#define CALL_HOOK_NORETURN(_id, _qctx)                              \
+	do {                                                        \
+		isc_result_t _res;                                  \
+		ns_hooktable_t *_tab = get_hooktab(_qctx);          \
+		ns_hook_t *_hook;                                   \
+		_hook = ISC_LIST_HEAD((*_tab)[_id]);                \
+		while ((_hook = next_hook(_hook, _qctx)) != NULL) { \
+			ns_hook_action_t _func = _hook->action;     \
+			void *_data = _hook->action_data;           \
+			INSIST(_func != NULL);                      \
+			_func(_qctx, _data, &_res);                 \
+			_hook = ISC_LIST_NEXT(_hook, link);         \
+		}                                                   \
 	} while (false)
 
 /*
@@ -415,6 +433,10 @@ recparam_update(ns_query_recparam_t *param, dns_rdatatype_t qtype,
 static isc_result_t
 query_resume(query_ctx_t *qctx);
 
+static isc_result_t
+query_rrl(query_ctx_t *qctx, const dns_name_t *constname,
+	  isc_result_t resp_result);
+
 static isc_result_t
 query_checkrrl(query_ctx_t *qctx, isc_result_t result);
 
@@ -668,6 +690,7 @@ query_send(ns_client_t *client) {
 	}
 
 	inc_stats(client, counter);
+	client->query.anscache.counter = counter;
 	ns_client_send(client);
 
 	if ((client->manager->sctx->options & NS_SERVER_LOGRESPONSES) != 0) {
@@ -876,6 +899,7 @@ query_reset(ns_client_t *client, bool everything) {
 	client->query.root_key_sentinel_keyid = 0;
 	client->query.root_key_sentinel_is_ta = false;
 	client->query.root_key_sentinel_not_ta = false;
+	client->query.anscache.rrlresult = ISC_R_UNSET;
 }
 
 static void
@@ -906,6 +930,7 @@ ns_query_init(ns_client_t *client) {
 	isc_mutex_init(&client->query.fetchlock);
 	client->query.redirect.fname =
 		dns_fixedname_initname(&client->query.redirect.fixed);
+	dns_fixedname_init(&client->query.anscache.rrlname);
 	query_reset(client, false);
 	ns_client_newdbversion(client, 3);
 	ns_client_newnamebuf(client);
@@ -1965,155 +1990,89 @@ found:
 	}
 
 	if (qtype == dns_rdatatype_a) {
+		dns_rdatatype_t types[2];
+		dns_rdataset_t *rdatasets[2] = { NULL };
+		dns_rdataset_t *sigrdatasets[2] = { NULL };
+		isc_result_t results[2];
+		unsigned int count = 0;
+
 		/*
 		 * We now go looking for A and AAAA records, along with
-		 * their signatures.
-		 *
-		 * XXXRTH  This code could be more efficient.
+		 * their signatures, in a single pass over the node.
 		 */
-		if (rdataset != NULL) {
-			if (dns_rdataset_isassociated(rdataset)) {
-				dns_rdataset_disassociate(rdataset);
-			}
-		} else {
-			rdataset = ns_client_newrdataset(client);
+		if (!query_isduplicate(client, fname, dns_rdatatype_a, NULL)) {
+			types[count++] = dns_rdatatype_a;
 		}
-		if (sigrdataset != NULL) {
-			if (dns_rdataset_isassociated(sigrdataset)) {
-				dns_rdataset_disassociate(sigrdataset);
-			}
-		} else if (WANTDNSSEC(client)) {
-			sigrdataset = ns_client_newrdataset(client);
-		}
-		if (query_isduplicate(client, fname, dns_rdatatype_a, NULL)) {
-			goto aaaa_lookup;
+		if (!query_isduplicate(client, fname, dns_rdatatype_aaaa, NULL))
+		{
+			types[count++] = dns_rdatatype_aaaa;
 		}
-		result = dns_db_findrdataset(db, node, version, dns_rdatatype_a,
-					     0, client->now, rdataset,
-					     sigrdataset);
-		if (result == DNS_R_NCACHENXDOMAIN) {
+		if (count == 0) {
 			goto addname;
-		} else if (result == DNS_R_NCACHENXRRSET) {
-			dns_rdataset_disassociate(rdataset);
-			if (sigrdataset != NULL &&
-			    dns_rdataset_isassociated(sigrdataset))
-			{
-				dns_rdataset_disassociate(sigrdataset);
+		}
+
+		for (unsigned int i = 0; i < count; i++) {
+			rdatasets[i] = ns_client_newrdataset(client);
+			if (WANTDNSSEC(client)) {
+				sigrdatasets[i] = ns_client_newrdataset(client);
 			}
-		} else if (result == ISC_R_SUCCESS) {
+		}
+		dns_db_findrdatasets(db, node, version, count, types,
+				     client->now, rdatasets, sigrdatasets,
+				     results);
+
+		for (unsigned int i = 0; i < count; i++) {
 			bool invalid = false;
-			mname = NULL;
+
+			if (results[i] == DNS_R_NCACHENXDOMAIN) {
+				break;
+			} else if (results[i] != ISC_R_SUCCESS) {
+				continue;
+			}
+
 			if (additionaltype ==
 				    dns_rdatasetadditional_fromcache &&
-			    (DNS_TRUST_PENDING(rdataset->trust) ||
-			     DNS_TRUST_GLUE(rdataset->trust)))
+			    (DNS_TRUST_PENDING(rdatasets[i]->trust) ||
+			     DNS_TRUST_GLUE(rdatasets[i]->trust)))
 			{
 				/* validate() may change rdataset->trust */
-				invalid = !validate(client, db, fname, rdataset,
-						    sigrdataset);
+				invalid = !validate(client, db, fname,
+						    rdatasets[i],
+						    sigrdatasets[i]);
 			}
-			if (invalid && DNS_TRUST_PENDING(rdataset->trust)) {
-				dns_rdataset_disassociate(rdataset);
-				if (sigrdataset != NULL &&
-				    dns_rdataset_isassociated(sigrdataset))
-				{
-					dns_rdataset_disassociate(sigrdataset);
-				}
-			} else if (!query_isduplicate(client, fname,
-						      dns_rdatatype_a, &mname))
-			{
-				if (mname != fname) {
-					if (mname != NULL) {
-						ns_client_releasename(client,
-								      &fname);
-						fname = mname;
-					} else {
-						need_addname = true;
-					}
-				}
-				ISC_LIST_APPEND(fname->list, rdataset, link);
-				added_something = true;
-				if (sigrdataset != NULL &&
-				    dns_rdataset_isassociated(sigrdataset))
-				{
-					ISC_LIST_APPEND(fname->list,
-							sigrdataset, link);
-					sigrdataset =
-						ns_client_newrdataset(client);
-				}
-				rdataset = ns_client_newrdataset(client);
-			} else {
-				dns_rdataset_disassociate(rdataset);
-				if (sigrdataset != NULL &&
-				    dns_rdataset_isassociated(sigrdataset))
-				{
-					dns_rdataset_disassociate(sigrdataset);
-				}
-			}
-		}
-	aaaa_lookup:
-		if (query_isduplicate(client, fname, dns_rdatatype_aaaa, NULL))
-		{
-			goto addname;
-		}
-		result = dns_db_findrdataset(db, node, version,
-					     dns_rdatatype_aaaa, 0, client->now,
-					     rdataset, sigrdataset);
-		if (result == DNS_R_NCACHENXDOMAIN) {
-			goto addname;
-		} else if (result == DNS_R_NCACHENXRRSET) {
-			dns_rdataset_disassociate(rdataset);
-			if (sigrdataset != NULL &&
-			    dns_rdataset_isassociated(sigrdataset))
-			{
-				dns_rdataset_disassociate(sigrdataset);
+			if (invalid && DNS_TRUST_PENDING(rdatasets[i]->trust)) {
+				continue;
 			}
-		} else if (result == ISC_R_SUCCESS) {
-			bool invalid = false;
-			mname = NULL;
 
-			if (additionaltype ==
-				    dns_rdatasetadditional_fromcache &&
-			    (DNS_TRUST_PENDING(rdataset->trust) ||
-			     DNS_TRUST_GLUE(rdataset->trust)))
+			mname = NULL;
+			if (query_isduplicate(client, fname, types[i], &mname))
 			{
-				/* validate() may change rdataset->trust */
-				invalid = !validate(client, db, fname, rdataset,
-						    sigrdataset);
+				continue;
 			}
-
-			if (invalid && DNS_TRUST_PENDING(rdataset->trust)) {
-				dns_rdataset_disassociate(rdataset);
-				if (sigrdataset != NULL &&
-				    dns_rdataset_isassociated(sigrdataset))
-				{
-					dns_rdataset_disassociate(sigrdataset);
+			if (mname != fname) {
+				if (mname != NULL) {
+					ns_client_releasename(client, &fname);
+					fname = mname;
+				} else {
+					need_addname = true;
 				}
-			} else if (!query_isduplicate(client, fname,
-						      dns_rdatatype_aaaa,
-						      &mname))
+			}
+			ISC_LIST_APPEND(fname->list, rdatasets[i], link);
+			rdatasets[i] = NULL;
+			added_something = true;
+			if (sigrdatasets[i] != NULL &&
+			    dns_rdataset_isassociated(sigrdatasets[i]))
 			{
-				if (mname != fname) {
-					if (mname != NULL) {
-						ns_client_releasename(client,
-								      &fname);
-						fname = mname;
-					} else {
-						need_addname = true;
-					}
-				}
-				ISC_LIST_APPEND(fname->list, rdataset, link);
-				added_something = true;
-				if (sigrdataset != NULL &&
-				    dns_rdataset_isassociated(sigrdataset))
-				{
-					ISC_LIST_APPEND(fname->list,
-							sigrdataset, link);
-					sigrdataset = NULL;
-				}
-				rdataset = NULL;
+				ISC_LIST_APPEND(fname->list, sigrdatasets[i],
+						link);
+				sigrdatasets[i] = NULL;
 			}
 		}
+
+		for (unsigned int i = 0; i < count; i++) {
+			ns_client_putrdataset(client, &rdatasets[i]);
+			ns_client_putrdataset(client, &sigrdatasets[i]);
+		}
 	}
 
 addname:
@@ -2588,12 +2547,18 @@ recursionquotatype_attach(ns_client_t *client, bool soft_limit) {
 		return result;
 	}
 
-	recurscount = ns_stats_increment(client->manager->sctx->nsstats,
-					 ns_statscounter_recursclients);
+	ns_stats_increment(client->manager->sctx->nsstats,
+			   ns_statscounter_recursclients);
 
+	/*
+	 * The counters are kept per loop, so the number of recursing
+	 * clients is the total over all of them.
+	 */
+	recurscount = ns_stats_get_counter(client->manager->sctx->nsstats,
+					   ns_statscounter_recursclients);
 	ns_stats_update_if_greater(client->manager->sctx->nsstats,
 				   ns_statscounter_recurshighwater,
-				   recurscount + 1);
+				   recurscount);
 
 	return result;
 }
@@ -2815,6 +2780,15 @@ query_prefetch(ns_client_t *client, dns_name_t *qname,
 	       dns_rdataset_t *rdataset) {
 	CTRACE(ISC_LOG_DEBUG(3), "query_prefetch");
 
+	/*
+	 * The cache flags an RRset as popular once, when it has been used
+	 * often enough; ask the resolver to refresh it before it expires.
+	 */
+	if ((rdataset->attributes & DNS_RDATASETATTR_POPULAR) != 0) {
+		dns_resolver_refresh(client->view->resolver, qname,
+				     rdataset->type, rdataset->ttl);
+	}
+
 	if (FETCH_RECTYPE_PREFETCH(client) != NULL ||
 	    client->view->prefetch_trigger == 0U ||
 	    rdataset->ttl > client->view->prefetch_trigger ||
@@ -2830,6 +2804,42 @@ query_prefetch(ns_client_t *client, dns_name_t *qname,
 			   ns_statscounter_prefetch);
 }
 
+/*
+ * A refresh of the stale RRset 'qname'/qtype has been started: start
+ * its 'stale-refresh-time' window right away, so the queries arriving
+ * while the refresh is in progress are answered from the cache without
+ * starting more refreshes.  If the refresh succeeds the stale RRset is
+ * replaced; if it fails, stale_refresh_aftermath() restarts the window.
+ */
+static void
+query_stale_startwindow(ns_client_t *client, dns_name_t *qname) {
+	dns_db_t *db = NULL;
+	dns_dbnode_t *node = NULL;
+	dns_fixedname_t fixed;
+	dns_rdataset_t rdataset;
+	dns_ttl_t stale_refresh = 0;
+
+	(void)dns_db_getservestalerefresh(client->view->cachedb,
+					  &stale_refresh);
+	if (stale_refresh == 0) {
+		return;
+	}
+
+	dns_rdataset_init(&rdataset);
+	dns_db_attach(client->view->cachedb, &db);
+	(void)dns_db_find(db, qname, NULL, client->query.qtype,
+			  DNS_DBFIND_STALEOK | DNS_DBFIND_STALESTART,
+			  client->now, &node, dns_fixedname_initname(&fixed),
+			  &rdataset, NULL);
+	if (dns_rdataset_isassociated(&rdataset)) {
+		dns_rdataset_disassociate(&rdataset);
+	}
+	if (node != NULL) {
+		dns_db_detachnode(db, &node);
+	}
+	dns_db_detach(&db);
+}
+
 static void
 query_stale_refresh(ns_client_t *client) {
 	dns_name_t *qname;
@@ -2852,6 +2862,10 @@ query_stale_refresh(ns_client_t *client) {
 
 	fetch_and_forget(client, qname, client->query.qtype,
 			 RECTYPE_STALE_REFRESH);
+
+	if (FETCH_RECTYPE_STALE_REFRESH(client) != NULL) {
+		query_stale_startwindow(client, qname);
+	}
 }
 
 static void
@@ -3775,12 +3789,11 @@ rpz_rewrite_name(ns_client_t *client, dns_name_t *trig_name,
 	 * Most of the time there are no eligible zones and the summary data
 	 * keeps us from getting this far.
 	 * We check the most eligible zone first and so usually check only
-	 * one policy zone.
+	 * one policy zone.  Go straight from one zone with a hit to the
+	 * next instead of looking at the bits of all of the zones.
 	 */
-	for (rpz_num = 0; zbits != 0; ++rpz_num, zbits >>= 1) {
-		if ((zbits & 1) == 0) {
-			continue;
-		}
+	for (; zbits != 0; zbits &= zbits - 1) {
+		rpz_num = __builtin_ctzll(zbits);
 
 		/*
 		 * Do not check policy zones that cannot replace a previously
@@ -4494,6 +4507,84 @@ warn_rfc1918(ns_client_t *client, dns_name_t *fname, dns_rdataset_t *rdataset) {
 	}
 }
 
+/*
+ * Under a flood of queries for random names in an NSEC3 signed zone,
+ * every NXDOMAIN response hashes the same closest encloser and the
+ * same wildcard name over again; only the next closer name changes
+ * from one query to the next.  The recent hashes are kept in a small
+ * cache, in thread specific memory so that it needs no locking.  A
+ * hash depends only on the name and the NSEC3 parameters, so the
+ * entries never go stale when the zone changes.
+ */
+#define NSEC3HASH_CACHE_SIZE 64
+
+typedef struct nsec3hash {
+	bool valid;
+	dns_hash_t hash;
+	uint16_t iterations;
+	size_t salt_length;
+	unsigned char salt[255];
+	dns_fixedname_t name;
+	dns_fixedname_t hashed;
+} nsec3hash_t;
+
+static thread_local nsec3hash_t nsec3hash_cache[NSEC3HASH_CACHE_SIZE];
+
+static isc_result_t
+query_nsec3hash(dns_fixedname_t *fixed, const dns_name_t *name,
+		const dns_name_t *origin, dns_hash_t hash, uint16_t iterations,
+		const unsigned char *salt, size_t salt_length) {
+	nsec3hash_t *entry = NULL;
+	dns_name_t *hashed = NULL;
+	isc_hash32_t state;
+	isc_result_t result;
+
+	isc_hash32_init(&state);
+	isc_hash32_hash(&state, name->ndata, name->length, false);
+	isc_hash32_hash(&state, salt, salt_length, true);
+	isc_hash32_hash(&state, &iterations, sizeof(iterations), true);
+	entry = &nsec3hash_cache[isc_hash32_finalize(&state) %
+				 NSEC3HASH_CACHE_SIZE];
+
+	/*
+	 * The hashed name is the hash label prepended to the zone
+	 * origin, so the same name hashes alike in a parent and a
+	 * child zone with the same parameters: check the origin too.
+	 */
+	if (entry->valid && entry->hash == hash &&
+	    entry->iterations == iterations &&
+	    entry->salt_length == salt_length &&
+	    memcmp(entry->salt, salt, salt_length) == 0 &&
+	    dns_name_equal(dns_fixedname_name(&entry->name), name))
+	{
+		hashed = dns_fixedname_name(&entry->hashed);
+		if (dns_name_countlabels(hashed) ==
+			    dns_name_countlabels(origin) + 1 &&
+		    dns_name_issubdomain(hashed, origin))
+		{
+			dns_name_copy(hashed, dns_fixedname_initname(fixed));
+			return ISC_R_SUCCESS;
+		}
+	}
+
+	result = dns_nsec3_hashname(fixed, NULL, NULL, name, origin, hash,
+				    iterations, salt, salt_length);
+	if (result != ISC_R_SUCCESS) {
+		return result;
+	}
+
+	entry->valid = true;
+	entry->hash = hash;
+	entry->iterations = iterations;
+	entry->salt_length = salt_length;
+	memmove(entry->salt, salt, salt_length);
+	dns_name_copy(name, dns_fixedname_initname(&entry->name));
+	dns_name_copy(dns_fixedname_name(fixed),
+		      dns_fixedname_initname(&entry->hashed));
+
+	return ISC_R_SUCCESS;
+}
+
 static void
 query_findclosestnsec3(dns_name_t *qname, dns_db_t *db,
 		       dns_dbversion_t *version, ns_client_t *client,
@@ -4535,10 +4626,8 @@ query_findclosestnsec3(dns_name_t *qname, dns_db_t *db,
 	}
 
 again:
-	dns_fixedname_init(&fixed);
-	result = dns_nsec3_hashname(&fixed, NULL, NULL, &name,
-				    dns_db_origin(db), hash, iterations, salt,
-				    salt_length);
+	result = query_nsec3hash(&fixed, &name, dns_db_origin(db), hash,
+				 iterations, salt, salt_length);
 	if (result != ISC_R_SUCCESS) {
 		return;
 	}
@@ -5373,6 +5462,236 @@ qctx_setrad(query_ctx_t *qctx) {
 	}
 }
 
+/*%
+ * Returns true if the response to the query in 'qctx' may be stored in, or
+ * taken from, the response cache: a plain UDP query answered directly from
+ * a primary or secondary zone, in a view without any feature that would
+ * change the response after it has been rendered or that needs to see it
+ * being built.
+ */
+static bool
+query_anscacheok(query_ctx_t *qctx) {
+	ns_client_t *client = qctx->client;
+	ns_hooktable_t *tab = get_hooktab(qctx);
+
+	if (!qctx->view->authrespcache || client->manager->anscache == NULL ||
+	    TCP(client) || client->query.restarts != 0 || qctx->fresp != NULL ||
+	    !qctx->is_zone || qctx->zone == NULL || RECURSIONOK(client))
+	{
+		return false;
+	}
+
+	switch (dns_zone_gettype(qctx->zone)) {
+	case dns_zone_primary:
+	case dns_zone_secondary:
+		break;
+	default:
+		return false;
+	}
+
+	if (qctx->view->rpzs != NULL || qctx->view->dns64cnt != 0 ||
+	    qctx->view->nocasecompress != NULL ||
+	    (qctx->view->padding != 0 &&
+	     (client->attributes & NS_CLIENTATTR_WANTPAD) != 0))
+	{
+		return false;
+	}
+
+	if (client->message->tsigkey != NULL ||
+	    client->message->sig0key != NULL ||
+	    (client->attributes &
+	     (NS_CLIENTATTR_HAVEECS | NS_CLIENTATTR_WANTEXPIRE)) != 0 ||
+	    client->sendcb != NULL ||
+	    (client->manager->sctx->options & NS_SERVER_LOGRESPONSES) != 0 ||
+	    client->query.root_key_sentinel_is_ta ||
+	    client->query.root_key_sentinel_not_ta)
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < NS_HOOKPOINTS_COUNT; i++) {
+		if (!ISC_LIST_EMPTY((*tab)[i])) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*%
+ * Answer the query from the response cache if possible.  Otherwise, mark
+ * the query so that ns_client_send() stores the response once it's been
+ * rendered.
+ *
+ * Returns ISC_R_NOTFOUND if the query needs to be answered normally.
+ */
+static isc_result_t
+query_anscache(query_ctx_t *qctx) {
+	ns_client_t *client = qctx->client;
+	ns_query_t *query = &client->query;
+	ns_anscacheentry_t *entry = NULL;
+	isc_result_t result;
+
+	if (!query_anscacheok(qctx)) {
+		return ISC_R_NOTFOUND;
+	}
+
+	ns_anscache_initkey(&query->anscache.key, qctx->view, qctx->db,
+			    query->qname);
+	query->anscache.key.attributes =
+		client->attributes &
+		(NS_CLIENTATTR_RA | NS_CLIENTATTR_WANTDNSSEC |
+		 NS_CLIENTATTR_WANTNSID | NS_CLIENTATTR_WANTRC |
+		 NS_CLIENTATTR_WANTAD | NS_CLIENTATTR_WANTCOOKIE |
+		 NS_CLIENTATTR_HAVECOOKIE | NS_CLIENTATTR_WANTOPT);
+	query->anscache.key.flags = client->message->flags &
+				    (DNS_MESSAGEFLAG_RD | DNS_MESSAGEFLAG_CD);
+	query->anscache.key.udpsize = client->udpsize;
+	query->anscache.key.qtype = qctx->qtype;
+	query->anscache.key.qclass = client->message->rdclass;
+	query->anscache.key.family = isc_sockaddr_pf(&client->peeraddr);
+	query->anscache.generation = dns_db_generation();
+
+	entry = ns_anscache_find(client->manager->anscache,
+				 &query->anscache.key);
+	if (entry == NULL ||
+	    (qctx->view->rrl != NULL && !HAVECOOKIE(client) &&
+	     entry->rrlresult == ISC_R_UNSET))
+	{
+		query->attributes |= NS_QUERYATTR_ANSCACHE;
+		return ISC_R_NOTFOUND;
+	}
+
+	/*
+	 * The response is rate limited the same way it was when it was
+	 * built; when it's dropped or slipped, finish the query the usual
+	 * way.
+	 */
+	if (qctx->view->rrl != NULL && !HAVECOOKIE(client)) {
+		query->attributes |= NS_QUERYATTR_RRL_CHECKED;
+		result = query_rrl(qctx, dns_fixedname_name(&entry->rrlname),
+				   entry->rrlresult);
+		if (result != ISC_R_SUCCESS) {
+			return ns_query_done(qctx);
+		}
+	}
+
+	CCTRACE(ISC_LOG_DEBUG(3), "query_anscache: hit");
+
+	if ((entry->wire.base[2] & (DNS_MESSAGEFLAG_AA >> 8)) == 0) {
+		inc_stats(client, ns_statscounter_nonauthans);
+	} else {
+		inc_stats(client, ns_statscounter_authans);
+	}
+	inc_stats(client, entry->counter);
+	ns_stats_increment(client->manager->sctx->nsstats,
+			   ns_statscounter_respcachehit);
+
+	ns_client_sendcached(client, &entry->wire);
+	isc_nmhandle_detach(&client->reqhandle);
+
+	qctx_clean(qctx);
+	qctx_freedata(qctx);
+	qctx->detach_client = true;
+
+	return ISC_R_SUCCESS;
+}
+
+static void
+demandload_cancel(ns_hookasync_t *ctx) {
+	/*
+	 * The load cannot be stopped for one client; query_hookresume()
+	 * notices the cancellation when the load completes.
+	 */
+	UNUSED(ctx);
+}
+
+static void
+demandload_destroy(ns_hookasync_t **ctxp) {
+	ns_hookasync_t *ctx = *ctxp;
+
+	*ctxp = NULL;
+	isc_mem_putanddetach(&ctx->mctx, ctx, sizeof(*ctx));
+}
+
+/*
+ * 'runasync' function for ns_query_hookasync(): wait for the zone passed
+ * in 'arg' to be loaded, then restart the query from ns__query_start().
+ */
+static isc_result_t
+demandload_start(query_ctx_t *qctx, isc_mem_t *mctx, void *arg,
+		 isc_loop_t *loop, isc_job_cb cb, void *evarg,
+		 ns_hookasync_t **ctxp) {
+	dns_zone_t *zone = arg;
+	ns_hookasync_t *ctx = NULL;
+	ns_hook_resume_t *rev = NULL;
+	isc_result_t result;
+
+	ctx = isc_mem_get(mctx, sizeof(*ctx));
+	rev = isc_mem_get(mctx, sizeof(*rev));
+	*rev = (ns_hook_resume_t){
+		.hookpoint = NS_QUERY_START_BEGIN,
+		.origresult = DNS_R_NOTLOADED,
+		.saved_qctx = qctx,
+		.ctx = ctx,
+		.loop = loop,
+		.cb = cb,
+		.arg = evarg,
+	};
+	*ctx = (ns_hookasync_t){
+		.cancel = demandload_cancel,
+		.destroy = demandload_destroy,
+	};
+	isc_mem_attach(mctx, &ctx->mctx);
+
+	result = dns_zone_demandload(zone, loop, cb, rev);
+	if (result == DNS_R_UPTODATE) {
+		/* Loaded in the meantime; restart right away. */
+		isc_async_run(loop, cb, rev);
+		result = ISC_R_SUCCESS;
+	}
+	if (result != ISC_R_SUCCESS) {
+		isc_mem_put(mctx, rev, sizeof(*rev));
+		demandload_destroy(&ctx);
+		return result;
+	}
+
+	*ctxp = ctx;
+	return ISC_R_SUCCESS;
+}
+
+/*
+ * The database for the query name was not loaded.  If it belongs to a
+ * zone that is loaded on demand, park the client until the zone has
+ * been loaded.  Returns true if the client has been dealt with.
+ */
+static bool
+query_demandload(query_ctx_t *qctx) {
+	dns_zone_t *zone = NULL;
+	unsigned int ztoptions = DNS_ZTFIND_MIRROR;
+	isc_result_t result;
+	bool parked = false;
+
+	if (qctx->options.noexact) {
+		ztoptions |= DNS_ZTFIND_NOEXACT;
+	}
+
+	result = dns_view_findzone(qctx->view, qctx->client->query.qname,
+				   ztoptions, &zone);
+	if (result != ISC_R_SUCCESS && result != DNS_R_PARTIALMATCH) {
+		return false;
+	}
+
+	if ((dns_zone_getoptions(zone) & DNS_ZONEOPT_LOADONDEMAND) != 0) {
+		/* On failure, this has already sent SERVFAIL. */
+		(void)ns_query_hookasync(qctx, demandload_start, zone);
+		parked = true;
+	}
+
+	dns_zone_detach(&zone);
+	return parked;
+}
+
 /*%
  * Starting point for a client query or a chaining query.
  *
@@ -5384,6 +5703,8 @@ isc_result_t
 ns__query_start(query_ctx_t *qctx) {
 	isc_result_t result = ISC_R_UNSET;
 	CCTRACE(ISC_LOG_DEBUG(3), "ns__query_start");
+	LIBNS_QUERY_START(qctx->client, qctx->client->query.qname->ndata,
+			  qctx->client->query.qname->length, qctx->qtype);
 	qctx->want_restart = false;
 	qctx->authoritative = false;
 	qctx->version = NULL;
@@ -5525,6 +5846,14 @@ ns__query_start(query_ctx_t *qctx) {
 			}
 		}
 	}
+	/*
+	 * A zone that is loaded on demand has no database until the first
+	 * query for it; wait for the load.
+	 */
+	if (result == DNS_R_NOTLOADED && query_demandload(qctx)) {
+		return ISC_R_COMPLETE;
+	}
+
 	/*
 	 * If we did not find a database from which we can answer the query,
 	 * respond with either REFUSED or SERVFAIL, depending on what the
@@ -5567,6 +5896,9 @@ ns__query_start(query_ctx_t *qctx) {
 				qctx->is_staticstub_zone = true;
 				break;
 			case dns_zone_primary:
+				dns_zone_setlastquery(qctx->zone,
+						      qctx->client->now);
+				FALLTHROUGH;
 			case dns_zone_secondary:
 				qctx_reportquery(qctx);
 				qctx_setrad(qctx);
@@ -5687,6 +6019,11 @@ ns__query_start(query_ctx_t *qctx) {
 		qctx->options.stalefirst = true;
 	}
 
+	result = query_anscache(qctx);
+	if (result != ISC_R_NOTFOUND) {
+		return result;
+	}
+
 	result = query_lookup(qctx);
 
 	/*
@@ -5787,6 +6124,8 @@ query_lookup(query_ctx_t *qctx) {
 	uint16_t ede = 0;
 
 	CCTRACE(ISC_LOG_DEBUG(3), "query_lookup");
+	LIBNS_QUERY_LOOKUP(qctx->client, qctx->client->query.qname->ndata,
+			   qctx->client->query.qname->length, qctx->qtype);
 
 	CALL_HOOK(NS_QUERY_LOOKUP_BEGIN, qctx);
 
@@ -6094,12 +6433,15 @@ fetch_callback(void *arg) {
 	isc_result_t result;
 	int errorloglevel;
 	query_ctx_t qctx;
+	isc_nanosecs_t start = isc_time_threadcpu();
 
 	REQUIRE(NS_CLIENT_VALID(client));
 	REQUIRE(RECURSING(client));
 
 	CTRACE(ISC_LOG_DEBUG(3), "fetch_callback");
 
+	ns_client_latency(client, ns_latency_recursion);
+
 	/*
 	 * We are resuming from recursion. Reset any attributes, options
 	 * that a lookup due to stale-answer-client-timeout may have set.
@@ -6179,6 +6521,7 @@ fetch_callback(void *arg) {
 		 * service the client, then detach the client object.
 		 */
 		qctx.detach_client = true;
+		client->cputime += isc_time_threadcpu() - start;
 		qctx_destroy(&qctx);
 	} else {
 		/*
@@ -6200,6 +6543,8 @@ fetch_callback(void *arg) {
 			}
 		}
 
+		/* qctx_destroy() can end the request */
+		client->cputime += isc_time_threadcpu() - start;
 		qctx_destroy(&qctx);
 	}
 
@@ -6320,6 +6665,7 @@ ns_query_recurse(ns_client_t *client, dns_rdatatype_t qtype, dns_name_t *qname,
 	isc_sockaddr_t *peeraddr = NULL;
 
 	CTRACE(ISC_LOG_DEBUG(3), "ns_query_recurse");
+	LIBNS_QUERY_RECURSE(client, qname->ndata, qname->length, qtype);
 
 	/*
 	 * Check recursion parameters from the previous query to see if they
@@ -6380,6 +6726,8 @@ ns_query_recurse(ns_client_t *client, dns_rdatatype_t qtype, dns_name_t *qname,
 		}
 
 		isc_nmhandle_detach(&HANDLE_RECTYPE_NORMAL(client));
+	} else {
+		ns_client_latency(client, ns_latency_lookup);
 	}
 
 	/*
@@ -6407,6 +6755,10 @@ query_resume(query_ctx_t *qctx) {
 #endif /* ifdef WANT_QUERYTRACE */
 
 	CCTRACE(ISC_LOG_DEBUG(3), "query_resume");
+	LIBNS_QUERY_RESUME(qctx->client, qctx->client->query.qname->ndata,
+			   qctx->client->query.qname->length, qctx->qtype,
+			   qctx->fresp != NULL ? qctx->fresp->result
+					       : ISC_R_UNSET);
 
 	CALL_HOOK(NS_QUERY_RESUME_BEGIN, qctx);
 
@@ -6854,7 +7206,7 @@ ns__query_sfcache(query_ctx_t *qctx) {
 }
 
 static void
-query_trace_rrldrop(query_ctx_t *qctx,
+query_trace_rrldrop(query_ctx_t *qctx, const dns_name_t *constname,
 		    dns_rrl_result_t rrl_result ISC_ATTR_UNUSED) {
 	if (!LIBNS_RRL_DROP_ENABLED()) {
 		return;
@@ -6868,10 +7220,86 @@ query_trace_rrldrop(query_ctx_t *qctx,
 	char qnamebuf[DNS_NAME_FORMATSIZE];
 	char fnamebuf[DNS_NAME_FORMATSIZE];
 	dns_name_format(qctx->client->query.qname, qnamebuf, sizeof(qnamebuf));
-	dns_name_format(qctx->fname, fnamebuf, sizeof(fnamebuf));
+	dns_name_format(qctx->fname != NULL ? qctx->fname : constname, fnamebuf,
+			sizeof(fnamebuf));
 	LIBNS_RRL_DROP(peerbuf, qnamebuf, fnamebuf, rrl_result);
 }
 
+/*%
+ * Apply the response rate limiting to a response of type 'resp_result'
+ * for 'constname'.  Returns DNS_R_DROP if the response is dropped or
+ * slipped.
+ */
+static isc_result_t
+query_rrl(query_ctx_t *qctx, const dns_name_t *constname,
+	  isc_result_t resp_result) {
+	ns_client_t *client = qctx->client;
+	bool wouldlog = isc_log_wouldlog(DNS_RRL_LOG_DROP);
+	char log_buf[DNS_RRL_LOG_BUF_LEN];
+	dns_rrl_result_t rrl_result;
+
+	rrl_result = dns_rrl(qctx->view, qctx->zone, &client->peeraddr,
+			     TCP(client), client->message->rdclass,
+			     qctx->qtype, constname, resp_result, client->now,
+			     wouldlog, log_buf, sizeof(log_buf));
+	if (rrl_result == DNS_RRL_RESULT_OK) {
+		return ISC_R_SUCCESS;
+	}
+
+	/*
+	 * Log dropped or slipped responses in the query
+	 * category so that requests are not silently lost.
+	 * Starts of rate-limited bursts are logged in
+	 * DNS_LOGCATEGORY_RRL.
+	 *
+	 * Dropped responses are counted with dropped queries
+	 * in QryDropped while slipped responses are counted
+	 * with other truncated responses in RespTruncated.
+	 */
+	if (wouldlog) {
+		ns_client_log(client, DNS_LOGCATEGORY_RRL, NS_LOGMODULE_QUERY,
+			      DNS_RRL_LOG_DROP, "%s", log_buf);
+	}
+
+	/*
+	 * If tracing is enabled, format some extra information
+	 * to pass along.
+	 */
+	query_trace_rrldrop(qctx, constname, rrl_result);
+
+	if (qctx->view->rrl->log_only) {
+		return ISC_R_SUCCESS;
+	}
+
+	if (rrl_result == DNS_RRL_RESULT_DROP) {
+		/*
+		 * These will also be counted in
+		 * ns_statscounter_dropped
+		 */
+		inc_stats(client, ns_statscounter_ratedropped);
+		QUERY_ERROR(qctx, DNS_R_DROP);
+	} else {
+		/*
+		 * These will also be counted in
+		 * ns_statscounter_truncatedresp
+		 */
+		inc_stats(client, ns_statscounter_rateslipped);
+		if (WANTCOOKIE(client)) {
+			client->message->flags &= ~DNS_MESSAGEFLAG_AA;
+			client->message->flags &= ~DNS_MESSAGEFLAG_AD;
+			client->message->rcode = dns_rcode_badcookie;
+			client->attributes &= ~NS_CLIENTATTR_WANTRC;
+		} else {
+			client->message->flags |= DNS_MESSAGEFLAG_TC;
+			if (resp_result == DNS_R_NXDOMAIN) {
+				client->message->rcode = dns_rcode_nxdomain;
+			}
+		}
+	}
+
+	return DNS_R_DROP;
+}
+
 /*%
  * Handle response rate limiting (RRL).
  */
@@ -6921,16 +7349,12 @@ query_checkrrl(query_ctx_t *qctx, isc_result_t result) {
 	    (qctx->client->query.attributes & NS_QUERYATTR_RRL_CHECKED) == 0)
 	{
 		dns_rdataset_t nc_rdataset;
-		bool wouldlog;
 		dns_fixedname_t fixed;
 		const dns_name_t *constname;
-		char log_buf[DNS_RRL_LOG_BUF_LEN];
 		isc_result_t nc_result, resp_result;
-		dns_rrl_result_t rrl_result;
 
 		qctx->client->query.attributes |= NS_QUERYATTR_RRL_CHECKED;
 
-		wouldlog = isc_log_wouldlog(DNS_RRL_LOG_DROP);
 		constname = qctx->fname;
 		if (result == DNS_R_NXDOMAIN) {
 			/*
@@ -6983,74 +7407,20 @@ query_checkrrl(query_ctx_t *qctx, isc_result_t result) {
 			resp_result = ISC_R_SUCCESS;
 		}
 
-		rrl_result = dns_rrl(
-			qctx->view, qctx->zone, &qctx->client->peeraddr,
-			TCP(qctx->client), qctx->client->message->rdclass,
-			qctx->qtype, constname, resp_result, qctx->client->now,
-			wouldlog, log_buf, sizeof(log_buf));
-		if (rrl_result != DNS_RRL_RESULT_OK) {
-			/*
-			 * Log dropped or slipped responses in the query
-			 * category so that requests are not silently lost.
-			 * Starts of rate-limited bursts are logged in
-			 * DNS_LOGCATEGORY_RRL.
-			 *
-			 * Dropped responses are counted with dropped queries
-			 * in QryDropped while slipped responses are counted
-			 * with other truncated responses in RespTruncated.
-			 */
-			if (wouldlog) {
-				ns_client_log(qctx->client, DNS_LOGCATEGORY_RRL,
-					      NS_LOGMODULE_QUERY,
-					      DNS_RRL_LOG_DROP, "%s", log_buf);
-			}
-
-			/*
-			 * If tracing is enabled, format some extra information
-			 * to pass along.
-			 */
-			query_trace_rrldrop(qctx, rrl_result);
-
-			if (!qctx->view->rrl->log_only) {
-				if (rrl_result == DNS_RRL_RESULT_DROP) {
-					/*
-					 * These will also be counted in
-					 * ns_statscounter_dropped
-					 */
-					inc_stats(qctx->client,
-						  ns_statscounter_ratedropped);
-					QUERY_ERROR(qctx, DNS_R_DROP);
-				} else {
-					/*
-					 * These will also be counted in
-					 * ns_statscounter_truncatedresp
-					 */
-					inc_stats(qctx->client,
-						  ns_statscounter_rateslipped);
-					if (WANTCOOKIE(qctx->client)) {
-						qctx->client->message->flags &=
-							~DNS_MESSAGEFLAG_AA;
-						qctx->client->message->flags &=
-							~DNS_MESSAGEFLAG_AD;
-						qctx->client->message->rcode =
-							dns_rcode_badcookie;
-						qctx->client->attributes &=
-							~NS_CLIENTATTR_WANTRC;
-					} else {
-						qctx->client->message->flags |=
-							DNS_MESSAGEFLAG_TC;
-						if (resp_result ==
-						    DNS_R_NXDOMAIN)
-						{
-							qctx->client->message
-								->rcode =
-								dns_rcode_nxdomain;
-						}
-					}
-				}
-				return DNS_R_DROP;
-			}
+		/*
+		 * Remember how the response was rate limited, so that
+		 * it can be done again when the response is reused.
+		 */
+		if ((qctx->client->query.attributes & NS_QUERYATTR_ANSCACHE) !=
+		    0)
+		{
+			ns_query_t *query = &qctx->client->query;
+			dns_name_copy(constname,
+				      dns_fixedname_name(&query->anscache.rrlname));
+			query->anscache.rrlresult = resp_result;
 		}
+
+		return query_rrl(qctx, constname, resp_result);
 	}
 
 	return ISC_R_SUCCESS;
@@ -7495,6 +7865,9 @@ query_gotanswer(query_ctx_t *qctx, isc_result_t result) {
 	char errmsg[256];
 
 	CCTRACE(ISC_LOG_DEBUG(3), "query_gotanswer");
+	LIBNS_QUERY_GOTANSWER(qctx->client, qctx->client->query.qname->ndata,
+			      qctx->client->query.qname->length, qctx->qtype,
+			      result);
 
 	CALL_HOOK(NS_QUERY_GOT_ANSWER_BEGIN, qctx);
 
@@ -8248,19 +8621,28 @@ query_dns64(query_ctx_t *qctx) {
 		flags |= DNS_DNS64_DNSSEC;
 	}
 
-	for (result = dns_rdataset_first(qctx->rdataset);
-	     result == ISC_R_SUCCESS;
-	     result = dns_rdataset_next(qctx->rdataset))
+	/*
+	 * Whether a prefix may be used for this client doesn't depend on
+	 * the A record, so it is only checked once for each prefix.
+	 */
+	for (dns64 = ISC_LIST_HEAD(client->view->dns64); dns64 != NULL;
+	     dns64 = dns_dns64_next(dns64))
 	{
-		for (dns64 = ISC_LIST_HEAD(client->view->dns64); dns64 != NULL;
-		     dns64 = dns_dns64_next(dns64))
+		result = dns_dns64_clientok(dns64, &netaddr, client->signer,
+					    env, flags);
+		if (result != ISC_R_SUCCESS) {
+			continue;
+		}
+
+		for (result = dns_rdataset_first(qctx->rdataset);
+		     result == ISC_R_SUCCESS;
+		     result = dns_rdataset_next(qctx->rdataset))
 		{
 			dns_rdataset_current(qctx->rdataset, &rdata);
 			isc_buffer_availableregion(buffer, &r);
 			INSIST(r.length >= 16);
-			result = dns_dns64_aaaafroma(dns64, &netaddr,
-						     client->signer, env, flags,
-						     rdata.data, r.base);
+			result = dns_dns64_aaaafroma(dns64, NULL, NULL, env,
+						     flags, rdata.data, r.base);
 			if (result != ISC_R_SUCCESS) {
 				dns_rdata_reset(&rdata);
 				continue;
@@ -8277,9 +8659,9 @@ query_dns64(query_ctx_t *qctx) {
 			dns64_rdata = NULL;
 			dns_rdata_reset(&rdata);
 		}
-	}
-	if (result != ISC_R_NOMORE) {
-		goto cleanup;
+		if (result != ISC_R_NOMORE) {
+			goto cleanup;
+		}
 	}
 
 	if (ISC_LIST_EMPTY(dns64_rdatalist->rdata)) {
@@ -11376,6 +11758,9 @@ ns_query_done(query_ctx_t *qctx) {
 	bool partial_result_with_servfail = false;
 
 	CCTRACE(ISC_LOG_DEBUG(3), "ns_query_done");
+	LIBNS_QUERY_DONE(qctx->client, qctx->client->query.qname->ndata,
+			 qctx->client->query.qname->length, qctx->qtype,
+			 qctx->client->message->rcode);
 
 	CALL_HOOK(NS_QUERY_DONE_BEGIN, qctx);
 
@@ -11679,6 +12064,7 @@ ns_query_start(ns_client_t *client, isc_nmhandle_t *handle) {
 	dns_message_t *message;
 	dns_rdataset_t *rdataset;
 	dns_rdatatype_t qtype;
+	isc_netaddr_t netaddr;
 	unsigned int saved_extflags;
 	unsigned int saved_flags;
 
@@ -11792,6 +12178,10 @@ ns_query_start(ns_client_t *client, isc_nmhandle_t *handle) {
 	dns_rdatatypestats_increment(client->manager->sctx->rcvquerystats,
 				     qtype);
 
+	isc_netaddr_fromsockaddr(&netaddr, &client->peeraddr);
+	ns_hitters_addquery(client->manager->sctx->hitters,
+			    client->query.qname, qtype, &netaddr);
+
 	log_tat(client);
 
 	if (dns_rdatatype_ismeta(qtype)) {
@@ -0,0 +1,463 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <isc/atomic.h>
+#include <isc/buffer.h>
+#include <isc/log.h>
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/os.h>
+#include <isc/stdio.h>
+#include <isc/thread.h>
+#include <isc/tid.h>
+#include <isc/util.h>
+#include <isc/uv.h>
+
+#include <ns/querylog.h>
+
+#define QUERYLOG_MAGIC	  ISC_MAGIC('Q', 'L', 'o', 'g')
+#define VALID_QUERYLOG(q) ISC_MAGIC_VALID(q, QUERYLOG_MAGIC)
+
+#define RING_MASK (NS_QUERYLOG_RINGSIZE - 1)
+
+/*% Longest message that is queued; longer ones are truncated */
+#define MAXMSG (NS_QUERYLOG_RINGSIZE / 8)
+
+/*% The length of the header that marks the end of the used ring */
+#define RECORD_WRAP UINT16_MAX
+
+/*% The category of a record for the binary query log */
+#define RECORD_BINARY INT16_MIN
+
+/*% Longest record of the binary query log */
+#define MAXENTRY (2 + NS_QUERYLOG_RECORDSIZE + 16 + DNS_NAME_MAXWIRE)
+
+STATIC_ASSERT((NS_QUERYLOG_RINGSIZE & RING_MASK) == 0,
+	      "NS_QUERYLOG_RINGSIZE must be a power of 2");
+STATIC_ASSERT(MAXMSG < RECORD_WRAP, "MAXMSG must fit in a record header");
+STATIC_ASSERT(MAXENTRY < MAXMSG, "MAXENTRY must fit in a record");
+
+/*
+ * A message in a ring: the header is followed by the NUL terminated
+ * message, or by the data of a binary query log record when the category
+ * is RECORD_BINARY, and the record is padded to a multiple of the header
+ * size.
+ * When a record doesn't fit at the end of the ring, the rest of the ring
+ * is skipped, which a header with the length RECORD_WRAP marks.
+ */
+typedef struct record {
+	uint16_t length; /*%< of the message, with the NUL, or of the data */
+	int16_t	 category;
+	int16_t	 module;
+	int16_t	 level;
+} record_t;
+
+#define RECORD_SIZE(length) \
+	ISC_ALIGN(sizeof(record_t) + (length), sizeof(record_t))
+
+/*
+ * 'tail' is only advanced by the loop and 'head' only by the writer
+ * thread; both count bytes from the creation of the ring, and they are
+ * kept on separate cache lines.
+ */
+typedef struct ring {
+	atomic_uint_fast64_t tail;
+	atomic_uint_fast64_t dropped;
+	unsigned char	    *buf;
+	uint8_t __padding0[ISC_OS_CACHELINE_SIZE -
+			   2 * sizeof(atomic_uint_fast64_t) -
+			   sizeof(unsigned char *)];
+	atomic_uint_fast64_t head;
+	uint8_t __padding1[ISC_OS_CACHELINE_SIZE -
+			   sizeof(atomic_uint_fast64_t)];
+} ring_t;
+
+struct ns_querylog {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	uint32_t nrings;
+	ring_t *rings;
+	atomic_bool started;
+	atomic_bool shutdown;
+	atomic_bool binary;
+	atomic_uint_fast64_t logged;
+	isc_thread_t thread;
+
+	/*% The binary query log; locked by the writer while it drains */
+	isc_mutex_t lock;
+	FILE *fp;
+};
+
+void
+ns_querylog_create(isc_mem_t *mctx, ns_querylog_t **qlp) {
+	ns_querylog_t *ql = NULL;
+
+	REQUIRE(qlp != NULL && *qlp == NULL);
+
+	ql = isc_mem_get(mctx, sizeof(*ql));
+	*ql = (ns_querylog_t){
+		.magic = QUERYLOG_MAGIC,
+		.nrings = isc_tid_count(),
+	};
+	isc_mem_attach(mctx, &ql->mctx);
+	isc_mutex_init(&ql->lock);
+
+	ql->rings = isc_mem_cget(mctx, ql->nrings, sizeof(ql->rings[0]));
+	for (size_t i = 0; i < ql->nrings; i++) {
+		ql->rings[i].buf = isc_mem_get(mctx, NS_QUERYLOG_RINGSIZE);
+	}
+
+	*qlp = ql;
+}
+
+/*
+ * Log the messages queued in all the rings, and return how many there
+ * were.
+ */
+static size_t
+querylog_drain(ns_querylog_t *ql) {
+	size_t n = 0;
+	bool written = false;
+
+	LOCK(&ql->lock);
+	for (size_t i = 0; i < ql->nrings; i++) {
+		ring_t *ring = &ql->rings[i];
+		uint64_t head = atomic_load_relaxed(&ring->head);
+		uint64_t tail = atomic_load_acquire(&ring->tail);
+
+		while (head != tail) {
+			size_t pos = head & RING_MASK;
+			record_t *rec = (record_t *)(ring->buf + pos);
+
+			if (rec->length == RECORD_WRAP) {
+				head += NS_QUERYLOG_RINGSIZE - pos;
+			} else if (rec->category == RECORD_BINARY) {
+				if (ql->fp != NULL) {
+					(void)isc_stdio_write(rec + 1,
+							      rec->length, 1,
+							      ql->fp, NULL);
+					written = true;
+				}
+				head += RECORD_SIZE(rec->length);
+				n++;
+			} else {
+				isc_log_write(rec->category, rec->module,
+					      rec->level, "%s",
+					      (const char *)(rec + 1));
+				head += RECORD_SIZE(rec->length);
+				n++;
+			}
+			atomic_store_release(&ring->head, head);
+		}
+	}
+	if (written) {
+		(void)isc_stdio_flush(ql->fp);
+	}
+	UNLOCK(&ql->lock);
+
+	if (n > 0) {
+		atomic_fetch_add_relaxed(&ql->logged, n);
+	}
+
+	return n;
+}
+
+static void *
+querylog_writer(void *arg) {
+	ns_querylog_t *ql = arg;
+
+	while (!atomic_load_acquire(&ql->shutdown)) {
+		if (querylog_drain(ql) == 0) {
+			uv_sleep(NS_QUERYLOG_INTERVAL);
+		}
+	}
+
+	(void)querylog_drain(ql);
+
+	return NULL;
+}
+
+void
+ns_querylog_destroy(ns_querylog_t **qlp) {
+	ns_querylog_t *ql = NULL;
+
+	REQUIRE(qlp != NULL && VALID_QUERYLOG(*qlp));
+
+	ql = *qlp;
+	*qlp = NULL;
+
+	if (atomic_load_acquire(&ql->started)) {
+		atomic_store_release(&ql->shutdown, true);
+		isc_thread_join(ql->thread, NULL);
+	}
+
+	for (size_t i = 0; i < ql->nrings; i++) {
+		isc_mem_put(ql->mctx, ql->rings[i].buf, NS_QUERYLOG_RINGSIZE);
+	}
+	isc_mem_cput(ql->mctx, ql->rings, ql->nrings, sizeof(ql->rings[0]));
+
+	if (ql->fp != NULL) {
+		(void)isc_stdio_close(ql->fp);
+	}
+	isc_mutex_destroy(&ql->lock);
+
+	ql->magic = 0;
+	isc_mem_putanddetach(&ql->mctx, ql, sizeof(*ql));
+}
+
+/*
+ * Reserve room for a record of 'length' bytes in the ring of the current
+ * loop, starting the writer thread if needed.  Returns NULL if the ring is
+ * full.  The record is queued by querylog_commit().
+ */
+static record_t *
+querylog_reserve(ns_querylog_t *ql, ring_t *ring, size_t length) {
+	uint64_t head, tail;
+	size_t size = RECORD_SIZE(length), pos, skip = 0;
+	record_t *rec = NULL;
+
+	if (!atomic_load_acquire(&ql->started) &&
+	    atomic_compare_exchange_strong_acq_rel(&ql->started, &(bool){ false },
+						   true))
+	{
+		isc_thread_create(querylog_writer, ql, &ql->thread);
+	}
+
+	tail = atomic_load_relaxed(&ring->tail);
+	head = atomic_load_acquire(&ring->head);
+	pos = tail & RING_MASK;
+	if (pos + size > NS_QUERYLOG_RINGSIZE) {
+		skip = NS_QUERYLOG_RINGSIZE - pos;
+	}
+
+	if (tail + skip + size - head > NS_QUERYLOG_RINGSIZE) {
+		atomic_fetch_add_relaxed(&ring->dropped, 1);
+		return NULL;
+	}
+
+	if (skip > 0) {
+		rec = (record_t *)(ring->buf + pos);
+		rec->length = RECORD_WRAP;
+		atomic_store_release(&ring->tail, tail + skip);
+		pos = 0;
+	}
+
+	return (record_t *)(ring->buf + pos);
+}
+
+static void
+querylog_commit(ring_t *ring, record_t *rec) {
+	uint64_t tail = atomic_load_relaxed(&ring->tail);
+
+	atomic_store_release(&ring->tail, tail + RECORD_SIZE(rec->length));
+}
+
+bool
+ns_querylog_write(ns_querylog_t *ql, isc_logcategory_t category,
+		  isc_logmodule_t module, int level, const char *msg) {
+	uint32_t tid = isc_tid();
+	ring_t *ring = NULL;
+	record_t *rec = NULL;
+	size_t length;
+
+	REQUIRE(VALID_QUERYLOG(ql));
+	REQUIRE(msg != NULL);
+
+	if (tid >= ql->nrings) {
+		isc_log_write(category, module, level, "%s", msg);
+		return true;
+	}
+
+	ring = &ql->rings[tid];
+	length = ISC_MIN(strlen(msg), MAXMSG - 1) + 1;
+	rec = querylog_reserve(ql, ring, length);
+	if (rec == NULL) {
+		return false;
+	}
+
+	*rec = (record_t){
+		.length = length,
+		.category = category,
+		.module = module,
+		.level = level,
+	};
+	memmove(rec + 1, msg, length - 1);
+	((char *)(rec + 1))[length - 1] = '\0';
+
+	querylog_commit(ring, rec);
+
+	return true;
+}
+
+static void
+querylog_render(const ns_querylogentry_t *entry, isc_buffer_t *b) {
+	isc_region_t r;
+
+	isc_buffer_putuint16(b, 0);
+	isc_buffer_putuint32(b, isc_time_seconds(&entry->time));
+	isc_buffer_putuint32(b, isc_time_nanoseconds(&entry->time));
+	isc_buffer_putuint32(b, entry->latency);
+	isc_buffer_putuint16(b, entry->flags);
+	isc_buffer_putuint16(b, entry->qtype);
+	isc_buffer_putuint16(b, entry->qclass);
+	isc_buffer_putuint16(b, entry->rcode);
+	isc_buffer_putuint16(b, entry->port);
+	if (entry->address.family == AF_INET6) {
+		isc_buffer_putuint8(b, 6);
+		isc_buffer_putmem(b, entry->address.type.in6.s6_addr, 16);
+	} else {
+		const unsigned char *in = (const void *)&entry->address.type.in;
+
+		isc_buffer_putuint8(b, 4);
+		isc_buffer_putmem(b, in, 4);
+	}
+	dns_name_toregion(entry->qname, &r);
+	isc_buffer_putmem(b, r.base, r.length);
+
+	/* The length doesn't include itself */
+	r = (isc_region_t){ .base = isc_buffer_base(b),
+			    .length = isc_buffer_usedlength(b) };
+	r.base[0] = (r.length - 2) >> 8;
+	r.base[1] = (r.length - 2) & 0xff;
+}
+
+bool
+ns_querylog_writeentry(ns_querylog_t *ql, const ns_querylogentry_t *entry) {
+	uint32_t tid = isc_tid();
+	unsigned char data[MAXENTRY];
+	isc_buffer_t b;
+	ring_t *ring = NULL;
+	record_t *rec = NULL;
+
+	REQUIRE(VALID_QUERYLOG(ql));
+	REQUIRE(entry != NULL && entry->qname != NULL);
+
+	if (!atomic_load_relaxed(&ql->binary)) {
+		return true;
+	}
+
+	isc_buffer_init(&b, data, sizeof(data));
+	querylog_render(entry, &b);
+
+	if (tid >= ql->nrings) {
+		LOCK(&ql->lock);
+		if (ql->fp != NULL) {
+			(void)isc_stdio_write(data, isc_buffer_usedlength(&b),
+					      1, ql->fp, NULL);
+		}
+		UNLOCK(&ql->lock);
+		return true;
+	}
+
+	ring = &ql->rings[tid];
+	rec = querylog_reserve(ql, ring, isc_buffer_usedlength(&b));
+	if (rec == NULL) {
+		return false;
+	}
+
+	*rec = (record_t){
+		.length = isc_buffer_usedlength(&b),
+		.category = RECORD_BINARY,
+	};
+	memmove(rec + 1, data, rec->length);
+
+	querylog_commit(ring, rec);
+
+	return true;
+}
+
+isc_result_t
+ns_querylog_setfile(ns_querylog_t *ql, const char *filename) {
+	isc_result_t result;
+	FILE *fp = NULL;
+	off_t offset;
+
+	REQUIRE(VALID_QUERYLOG(ql));
+
+	if (filename != NULL) {
+		result = isc_stdio_open(filename, "a", &fp);
+		if (result != ISC_R_SUCCESS) {
+			return result;
+		}
+
+		result = isc_stdio_seek(fp, 0, SEEK_END);
+		if (result == ISC_R_SUCCESS) {
+			result = isc_stdio_tell(fp, &offset);
+		}
+		if (result == ISC_R_SUCCESS && offset == 0) {
+			unsigned char header[6] = NS_QUERYLOG_MAGIC;
+
+			header[4] = NS_QUERYLOG_VERSION >> 8;
+			header[5] = NS_QUERYLOG_VERSION & 0xff;
+			result = isc_stdio_write(header, sizeof(header), 1, fp,
+						 NULL);
+		}
+		if (result != ISC_R_SUCCESS) {
+			(void)isc_stdio_close(fp);
+			return result;
+		}
+	}
+
+	LOCK(&ql->lock);
+	atomic_store_relaxed(&ql->binary, fp != NULL);
+	if (ql->fp != NULL) {
+		(void)isc_stdio_close(ql->fp);
+	}
+	ql->fp = fp;
+	UNLOCK(&ql->lock);
+
+	return ISC_R_SUCCESS;
+}
+
+bool
+ns_querylog_binary(ns_querylog_t *ql) {
+	REQUIRE(VALID_QUERYLOG(ql));
+
+	return atomic_load_relaxed(&ql->binary);
+}
+
+void
+ns_querylog_flush(ns_querylog_t *ql) {
+	REQUIRE(VALID_QUERYLOG(ql));
+
+	for (size_t i = 0; i < ql->nrings; i++) {
+		ring_t *ring = &ql->rings[i];
+		uint64_t tail = atomic_load_acquire(&ring->tail);
+
+		while (atomic_load_acquire(&ring->head) < tail) {
+			uv_sleep(1);
+		}
+	}
+}
+
+void
+ns_querylog_getcounters(ns_querylog_t *ql, uint64_t *loggedp,
+			uint64_t *droppedp) {
+	uint64_t dropped = 0;
+
+	REQUIRE(VALID_QUERYLOG(ql));
+
+	for (size_t i = 0; i < ql->nrings; i++) {
+		dropped += atomic_load_relaxed(&ql->rings[i].dropped);
+	}
+
+	SET_IF_NOT_NULL(loggedp, atomic_load_relaxed(&ql->logged));
+	SET_IF_NOT_NULL(droppedp, dropped);
+}
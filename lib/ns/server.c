@@ -23,8 +23,11 @@
 #include <dns/tkey.h>
 
 #include <ns/query.h>
+#include <ns/hitters.h>
+#include <ns/querylog.h>
 #include <ns/server.h>
 #include <ns/stats.h>
+#include <ns/xfrcache.h>
 
 #define SCTX_MAGIC    ISC_MAGIC('S', 'c', 't', 'x')
 #define SCTX_VALID(s) ISC_MAGIC_VALID(s, SCTX_MAGIC)
@@ -63,20 +66,26 @@ ns_server_create(isc_mem_t *mctx, ns_matchview_t matchingview,
 	isc_refcount_init(&sctx->references, 1);
 
 	isc_quota_init(&sctx->xfroutquota, 10);
-	isc_quota_init(&sctx->tcpquota, 10);
-	isc_quota_init(&sctx->recursionquota, 100);
+	isc_quota_initperloop(&sctx->tcpquota, mctx, 10);
+	isc_quota_initperloop(&sctx->recursionquota, mctx, 100);
 	isc_quota_init(&sctx->updquota, 100);
 	isc_quota_init(&sctx->sig0checksquota, 1);
 	ISC_LIST_INIT(sctx->http_quotas);
 	isc_mutex_init(&sctx->http_quotas_lock);
 
-	ns_stats_create(mctx, ns_statscounter_max, &sctx->nsstats);
+	ns_xfrcache_create(mctx, &sctx->xfrcache);
 
-	dns_rdatatypestats_create(mctx, &sctx->rcvquerystats);
+	/*
+	 * These are updated on every query, so each loop keeps its own
+	 * copy of the counters.
+	 */
+	ns_stats_createperloop(mctx, ns_statscounter_max, &sctx->nsstats);
 
-	dns_opcodestats_create(mctx, &sctx->opcodestats);
+	dns_rdatatypestats_createperloop(mctx, &sctx->rcvquerystats);
 
-	dns_rcodestats_create(mctx, &sctx->rcodestats);
+	dns_opcodestats_createperloop(mctx, &sctx->opcodestats);
+
+	dns_rcodestats_createperloop(mctx, &sctx->rcodestats);
 
 	isc_histomulti_create(mctx, DNS_SIZEHISTO_SIGBITSIN,
 			      &sctx->udpinstats4);
@@ -102,6 +111,14 @@ ns_server_create(isc_mem_t *mctx, ns_matchview_t matchingview,
 	isc_histomulti_create(mctx, DNS_SIZEHISTO_SIGBITSOUT,
 			      &sctx->tcpoutstats6);
 
+	for (size_t i = 0; i < ns_latency_max; i++) {
+		isc_histomulti_create(mctx, NS_LATENCY_SIGBITS,
+				      &sctx->latency[i]);
+	}
+
+	ns_querylog_create(mctx, &sctx->querylog);
+	ns_hitters_create(mctx, &sctx->hitters);
+
 	ISC_LIST_INIT(sctx->altsecrets);
 
 	sctx->magic = SCTX_MAGIC;
@@ -169,6 +186,8 @@ ns_server_detach(ns_server_t **sctxp) {
 			dns_tkeyctx_destroy(&sctx->tkeyctx);
 		}
 
+		ns_xfrcache_destroy(&sctx->xfrcache);
+
 		if (sctx->nsstats != NULL) {
 			ns_stats_detach(&sctx->nsstats);
 		}
@@ -209,6 +228,20 @@ ns_server_detach(ns_server_t **sctxp) {
 			isc_histomulti_destroy(&sctx->tcpoutstats6);
 		}
 
+		for (size_t i = 0; i < ns_latency_max; i++) {
+			if (sctx->latency[i] != NULL) {
+				isc_histomulti_destroy(&sctx->latency[i]);
+			}
+		}
+
+		if (sctx->querylog != NULL) {
+			ns_querylog_destroy(&sctx->querylog);
+		}
+
+		if (sctx->hitters != NULL) {
+			ns_hitters_destroy(&sctx->hitters);
+		}
+
 		sctx->magic = 0;
 
 		isc_mem_putanddetach(&sctx->mctx, sctx, sizeof(*sctx));
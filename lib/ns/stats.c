@@ -58,8 +58,9 @@ ns_stats_detach(ns_stats_t **statsp) {
 	}
 }
 
-void
-ns_stats_create(isc_mem_t *mctx, int ncounters, ns_stats_t **statsp) {
+static void
+stats_create(isc_mem_t *mctx, int ncounters, bool perloop,
+	     ns_stats_t **statsp) {
 	REQUIRE(statsp != NULL && *statsp == NULL);
 
 	ns_stats_t *stats = isc_mem_get(mctx, sizeof(*stats));
@@ -67,7 +68,11 @@ ns_stats_create(isc_mem_t *mctx, int ncounters, ns_stats_t **statsp) {
 
 	isc_refcount_init(&stats->references, 1);
 
-	isc_stats_create(mctx, &stats->counters, ncounters);
+	if (perloop) {
+		isc_stats_createperloop(mctx, &stats->counters, ncounters);
+	} else {
+		isc_stats_create(mctx, &stats->counters, ncounters);
+	}
 
 	stats->magic = NS_STATS_MAGIC;
 	stats->mctx = NULL;
@@ -75,6 +80,16 @@ ns_stats_create(isc_mem_t *mctx, int ncounters, ns_stats_t **statsp) {
 	*statsp = stats;
 }
 
+void
+ns_stats_create(isc_mem_t *mctx, int ncounters, ns_stats_t **statsp) {
+	stats_create(mctx, ncounters, false, statsp);
+}
+
+void
+ns_stats_createperloop(isc_mem_t *mctx, int ncounters, ns_stats_t **statsp) {
+	stats_create(mctx, ncounters, true, statsp);
+}
+
 /*%
  * Increment/Decrement methods
  */
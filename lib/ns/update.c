@@ -17,10 +17,14 @@
 #include <isc/async.h>
 #include <isc/log.h>
 #include <isc/netaddr.h>
+#include <isc/quota.h>
 #include <isc/serial.h>
 #include <isc/stats.h>
 #include <isc/string.h>
+#include <isc/time.h>
+#include <isc/timer.h>
 #include <isc/util.h>
+#include <isc/work.h>
 
 #include <dns/db.h>
 #include <dns/dbiterator.h>
@@ -231,8 +235,27 @@ struct update {
 	dns_message_t *answer;
 	unsigned int *maxbytype;
 	size_t maxbytypelen;
+	isc_quota_t *zonequota;
+	ISC_LINK(update_t) link;
 };
 
+/*%
+ * The updates to a zone that are applied to the same version of it,
+ * see update_action().  A batch is only used on the zone's loop.
+ */
+typedef struct update_batch {
+	dns_zone_t *zone;
+	isc_timer_t *timer;
+	unsigned int count;
+	ISC_LIST(update_t) updates;
+} update_batch_t;
+
+/*%
+ * Maximum number of updates in a batch; a full batch is applied
+ * without waiting for the end of the window.
+ */
+#define UPDATE_BATCH_MAX 1000
+
 /*%
  * Prepare an RR for the addition of the new RR 'ctx->update_rr',
  * with TTL 'ctx->update_rr_ttl', to its rdataset, by deleting
@@ -1629,9 +1652,15 @@ check_soa_increment(dns_db_t *db, dns_dbversion_t *ver,
  * the RFC2136 pseudocode as closely as possible.
  */
 
+/*%
+ * Prescan the update section, checking for updates that are illegal or
+ * violate policy.  This runs on a work thread, see send_update().
+ */
 static isc_result_t
-send_update(ns_client_t *client, dns_zone_t *zone) {
+prescan_update(update_t *uev) {
 	isc_result_t result = ISC_R_SUCCESS;
+	ns_client_t *client = uev->client;
+	dns_zone_t *zone = uev->zone;
 	dns_ssutable_t *ssutable = NULL;
 	dns_message_t *request = client->message;
 	isc_mem_t *mctx = client->manager->mctx;
@@ -1644,7 +1673,6 @@ send_update(ns_client_t *client, dns_zone_t *zone) {
 	dns_zoneopt_t options;
 	dns_db_t *db = NULL;
 	dns_dbversion_t *ver = NULL;
-	update_t *uev = NULL;
 
 	CHECK(dns_zone_getdb(zone, &db));
 	zonename = dns_db_origin(db);
@@ -1653,37 +1681,6 @@ send_update(ns_client_t *client, dns_zone_t *zone) {
 	options = dns_zone_getoptions(zone);
 	dns_db_currentversion(db, &ver);
 
-	/*
-	 * Update message processing can leak record existence information
-	 * so check that we are allowed to query this zone.  Additionally,
-	 * if we would refuse all updates for this zone, we bail out here.
-	 */
-	CHECK(checkqueryacl(client, dns_zone_getqueryacl(zone),
-			    dns_zone_getorigin(zone),
-			    dns_zone_getupdateacl(zone), ssutable));
-
-	/*
-	 * Check requestor's permissions.
-	 */
-	if (ssutable == NULL) {
-		CHECK(checkupdateacl(client, dns_zone_getupdateacl(zone),
-				     "update", dns_zone_getorigin(zone), false,
-				     false));
-	} else if (client->signer == NULL && !TCPCLIENT(client)) {
-		CHECK(checkupdateacl(client, NULL, "update",
-				     dns_zone_getorigin(zone), false, true));
-	}
-
-	if (dns_zone_getupdatedisabled(zone)) {
-		FAILC(DNS_R_REFUSED,
-		      "dynamic update temporarily disabled because the zone is "
-		      "frozen.  Use 'rndc thaw' to re-enable updates.");
-	}
-
-	/*
-	 * Prescan the update section, checking for updates that
-	 * are illegal or violate policy.
-	 */
 	if (ssutable != NULL) {
 		maxbytypelen = request->counts[DNS_SECTION_UPDATE];
 		maxbytype = isc_mem_cget(mctx, maxbytypelen,
@@ -1866,7 +1863,93 @@ send_update(ns_client_t *client, dns_zone_t *zone) {
 		FAIL(result);
 	}
 
-	update_log(client, zone, LOGLEVEL_DEBUG, "update section prescan OK");
+
+	uev->maxbytype = maxbytype;
+	uev->maxbytypelen = maxbytypelen;
+	maxbytype = NULL;
+	result = ISC_R_SUCCESS;
+
+failure:
+	if (db != NULL) {
+		dns_db_closeversion(db, &ver, false);
+		dns_db_detach(&db);
+	}
+
+	if (maxbytype != NULL) {
+		isc_mem_cput(mctx, maxbytype, maxbytypelen, sizeof(*maxbytype));
+	}
+
+	if (ssutable != NULL) {
+		dns_ssutable_detach(&ssutable);
+	}
+
+	return result;
+}
+
+static void
+prescan_work(void *arg) {
+	update_t *uev = arg;
+
+	uev->result = prescan_update(uev);
+}
+
+static void
+prescan_done(void *arg) {
+	update_t *uev = arg;
+
+	if (uev->result != ISC_R_SUCCESS) {
+		updatedone_action(uev);
+		return;
+	}
+
+	update_log(uev->client, uev->zone, LOGLEVEL_DEBUG,
+		   "update section prescan OK");
+	isc_async_run(dns_zone_getloop(uev->zone), update_action, uev);
+}
+
+/*%
+ * Check the permissions of the requestor and hand the update over to a
+ * work thread for the prescan of the update section, which can involve
+ * many database lookups and update-policy rules, and then to the zone
+ * loop.  Each zone has its own quota of updates in progress on top of
+ * the server-wide one, so that a flood of updates to one zone is dropped
+ * early rather than queued.
+ */
+static isc_result_t
+send_update(ns_client_t *client, dns_zone_t *zone) {
+	isc_result_t result = ISC_R_SUCCESS;
+	dns_ssutable_t *ssutable = NULL;
+	isc_quota_t *zonequota = dns_zone_getupdatequota(zone);
+	update_t *uev = NULL;
+
+	dns_zone_getssutable(zone, &ssutable);
+
+	/*
+	 * Update message processing can leak record existence information
+	 * so check that we are allowed to query this zone.  Additionally,
+	 * if we would refuse all updates for this zone, we bail out here.
+	 */
+	CHECK(checkqueryacl(client, dns_zone_getqueryacl(zone),
+			    dns_zone_getorigin(zone),
+			    dns_zone_getupdateacl(zone), ssutable));
+
+	/*
+	 * Check requestor's permissions.
+	 */
+	if (ssutable == NULL) {
+		CHECK(checkupdateacl(client, dns_zone_getupdateacl(zone),
+				     "update", dns_zone_getorigin(zone), false,
+				     false));
+	} else if (client->signer == NULL && !TCPCLIENT(client)) {
+		CHECK(checkupdateacl(client, NULL, "update",
+				     dns_zone_getorigin(zone), false, true));
+	}
+
+	if (dns_zone_getupdatedisabled(zone)) {
+		FAILC(DNS_R_REFUSED,
+		      "dynamic update temporarily disabled because the zone is "
+		      "frozen.  Use 'rndc thaw' to re-enable updates.");
+	}
 
 	result = isc_quota_acquire(&client->manager->sctx->updquota);
 	if (result != ISC_R_SUCCESS) {
@@ -1878,29 +1961,32 @@ send_update(ns_client_t *client, dns_zone_t *zone) {
 		CHECK(DNS_R_DROP);
 	}
 
+	result = isc_quota_acquire(zonequota);
+	if (result != ISC_R_SUCCESS) {
+		isc_quota_release(&client->manager->sctx->updquota);
+		update_log(client, zone, LOGLEVEL_PROTOCOL,
+			   "update failed: too many DNS UPDATEs queued "
+			   "for the zone (%s)",
+			   isc_result_totext(result));
+		ns_stats_increment(client->manager->sctx->nsstats,
+				   ns_statscounter_updatequota);
+		CHECK(DNS_R_DROP);
+	}
+
 	uev = isc_mem_get(client->manager->mctx, sizeof(*uev));
 	*uev = (update_t){
 		.zone = zone,
 		.client = client,
-		.maxbytype = maxbytype,
-		.maxbytypelen = maxbytypelen,
+		.zonequota = zonequota,
 		.result = ISC_R_SUCCESS,
+		.link = ISC_LINK_INITIALIZER,
 	};
 
 	isc_nmhandle_attach(client->handle, &client->updatehandle);
-	isc_async_run(dns_zone_getloop(zone), update_action, uev);
-	maxbytype = NULL;
+	isc_work_enqueue(client->manager->loop, prescan_work, prescan_done,
+			 uev);
 
 failure:
-	if (db != NULL) {
-		dns_db_closeversion(db, &ver, false);
-		dns_db_detach(&db);
-	}
-
-	if (maxbytype != NULL) {
-		isc_mem_cput(mctx, maxbytype, maxbytypelen, sizeof(*maxbytype));
-	}
-
 	if (ssutable != NULL) {
 		dns_ssutable_detach(&ssutable);
 	}
@@ -2724,20 +2810,19 @@ isdnssec(dns_db_t *db, dns_dbversion_t *ver, dns_rdatatype_t privatetype) {
 	return build_nsec || build_nsec3;
 }
 
-static void
-update_action(void *arg) {
-	update_t *uev = (update_t *)arg;
+/*%
+ * Check the prerequisites of the update in 'uev' against 'ver' and apply
+ * its update section to 'ver', recording the changes in 'diff'.
+ */
+static isc_result_t
+update_apply(update_t *uev, dns_db_t *db, dns_dbversion_t *ver,
+	     dns_diff_t *diff, bool *soa_serial_changedp) {
 	dns_zone_t *zone = uev->zone;
 	ns_client_t *client = uev->client;
 	unsigned int *maxbytype = uev->maxbytype;
 	size_t update = 0, maxbytypelen = uev->maxbytypelen;
 	isc_result_t result;
-	dns_db_t *db = NULL;
-	dns_dbversion_t *oldver = NULL;
-	dns_dbversion_t *ver = NULL;
-	dns_diff_t diff; /* Pending updates. */
 	dns_diff_t temp; /* Pending RR existence assertions. */
-	bool soa_serial_changed = false;
 	isc_mem_t *mctx = client->manager->mctx;
 	dns_rdatatype_t covers;
 	dns_message_t *request = client->message;
@@ -2747,17 +2832,12 @@ update_action(void *arg) {
 	dns_fixedname_t tmpnamefixed;
 	dns_name_t *tmpname = NULL;
 	dns_zoneopt_t options;
-	bool had_dnskey;
 	dns_rdatatype_t privatetype = dns_zone_getprivatetype(zone);
 	dns_ttl_t maxttl = 0;
-	uint32_t maxrecords;
-	uint64_t records;
 	bool is_inline, is_maintain, is_signing;
 
-	dns_diff_init(mctx, &diff);
 	dns_diff_init(mctx, &temp);
 
-	CHECK(dns_zone_getdb(zone, &db));
 	zonename = dns_db_origin(db);
 	zoneclass = dns_db_class(db);
 	dns_zone_getssutable(zone, &ssutable);
@@ -2767,12 +2847,6 @@ update_action(void *arg) {
 	is_maintain = ((dns_zone_getkeyopts(zone) & DNS_ZONEKEY_MAINTAIN) != 0);
 	is_signing = is_inline || (!is_inline && is_maintain);
 
-	/*
-	 * Get old and new versions now that queryacl has been checked.
-	 */
-	dns_db_currentversion(db, &oldver);
-	CHECK(dns_db_newversion(db, &ver));
-
 	/*
 	 * Check prerequisites.
 	 */
@@ -2985,7 +3059,7 @@ update_action(void *arg) {
 						   "it");
 					continue;
 				}
-				soa_serial_changed = true;
+				*soa_serial_changedp = true;
 			}
 
 			if (dns_rdatatype_atparent(rdata.type) &&
@@ -3100,7 +3174,7 @@ update_action(void *arg) {
 				add_rr_prepare_ctx_t ctx;
 				ctx.db = db;
 				ctx.ver = ver;
-				ctx.diff = &diff;
+				ctx.diff = diff;
 				ctx.name = name;
 				ctx.oldname = name;
 				ctx.update_rr = &rdata;
@@ -3117,11 +3191,11 @@ update_action(void *arg) {
 					dns_diff_clear(&ctx.add_diff);
 				} else {
 					result = do_diff(&ctx.del_diff, db, ver,
-							 &diff);
+							 diff);
 					if (result == ISC_R_SUCCESS) {
 						result = do_diff(&ctx.add_diff,
 								 db, ver,
-								 &diff);
+								 diff);
 					}
 					if (result != ISC_R_SUCCESS) {
 						dns_diff_clear(&ctx.del_diff);
@@ -3129,7 +3203,7 @@ update_action(void *arg) {
 						goto failure;
 					}
 					result = update_one_rr(
-						db, ver, &diff, DNS_DIFFOP_ADD,
+						db, ver, diff, DNS_DIFFOP_ADD,
 						name, ttl, &rdata);
 					if (result != ISC_R_SUCCESS) {
 						update_log(client, zone,
@@ -3158,12 +3232,12 @@ update_action(void *arg) {
 					CHECK(delete_if(type_not_soa_nor_ns_p,
 							db, ver, name,
 							dns_rdatatype_any, 0,
-							&rdata, &diff));
+							&rdata, diff));
 				} else {
 					CHECK(delete_if(type_not_dnssec, db,
 							ver, name,
 							dns_rdatatype_any, 0,
-							&rdata, &diff));
+							&rdata, diff));
 				}
 			} else if (dns_name_equal(name, zonename) &&
 				   (rdata.type == dns_rdatatype_soa ||
@@ -3189,7 +3263,7 @@ update_action(void *arg) {
 				}
 				CHECK(delete_if(true_p, db, ver, name,
 						rdata.type, covers, &rdata,
-						&diff));
+						diff));
 			}
 		} else if (update_class == dns_rdataclass_none) {
 			char namestr[DNS_NAME_FORMATSIZE];
@@ -3254,7 +3328,7 @@ update_action(void *arg) {
 			update_log(client, zone, LOGLEVEL_PROTOCOL,
 				   "deleting an RR at %s %s", namestr, typestr);
 			CHECK(delete_if(rr_equal_p, db, ver, name, rdata.type,
-					covers, &rdata, &diff));
+					covers, &rdata, diff));
 		}
 	}
 	if (result != ISC_R_NOMORE) {
@@ -3266,11 +3340,11 @@ update_action(void *arg) {
 	 * If they don't then back out all changes to DNSKEY/NSEC3PARAM
 	 * records.
 	 */
-	if (!ISC_LIST_EMPTY(diff.tuples)) {
-		CHECK(check_dnssec(client, zone, db, ver, &diff));
+	if (!ISC_LIST_EMPTY(diff->tuples)) {
+		CHECK(check_dnssec(client, zone, db, ver, diff));
 	}
 
-	if (!ISC_LIST_EMPTY(diff.tuples)) {
+	if (!ISC_LIST_EMPTY(diff->tuples)) {
 		unsigned int errors = 0;
 		CHECK(dns_zone_nscheck(zone, db, ver, &errors));
 		if (errors != 0) {
@@ -3281,7 +3355,7 @@ update_action(void *arg) {
 			goto failure;
 		}
 	}
-	if (!ISC_LIST_EMPTY(diff.tuples) && is_signing) {
+	if (!ISC_LIST_EMPTY(diff->tuples) && is_signing) {
 		result = dns_zone_cdscheck(zone, db, ver);
 		if (result == DNS_R_BADCDS || result == DNS_R_BADCDNSKEY) {
 			update_log(client, zone, LOGLEVEL_PROTOCOL,
@@ -3295,12 +3369,49 @@ update_action(void *arg) {
 		}
 	}
 
+	result = ISC_R_SUCCESS;
+
+failure:
+	dns_diff_clear(&temp);
+
+	if (ssutable != NULL) {
+		dns_ssutable_detach(&ssutable);
+	}
+
+	return result;
+}
+
+/*%
+ * Finish the changes in 'diff', made to '*verp' by one or more updates:
+ * bump the SOA serial, update the DNSSEC records, write the journal and
+ * commit the version.  '*journalsyncp' is set if the journal still has
+ * to be synced before responding.
+ */
+static isc_result_t
+update_commit(ns_client_t *client, dns_zone_t *zone, dns_db_t *db,
+	      dns_dbversion_t *oldver, dns_dbversion_t **verp,
+	      dns_diff_t *diff, bool soa_serial_changed, bool *journalsyncp) {
+	dns_dbversion_t *ver = *verp;
+	isc_result_t result;
+	isc_mem_t *mctx = client->manager->mctx;
+	dns_name_t *zonename = dns_db_origin(db);
+	dns_zoneopt_t options = dns_zone_getoptions(zone);
+	dns_rdatatype_t privatetype = dns_zone_getprivatetype(zone);
+	bool had_dnskey;
+	uint32_t maxrecords;
+	uint64_t records;
+	bool is_inline, is_maintain, is_signing;
+
+	is_inline = (!dns_zone_israw(zone) && dns_zone_issecure(zone));
+	is_maintain = ((dns_zone_getkeyopts(zone) & DNS_ZONEKEY_MAINTAIN) != 0);
+	is_signing = is_inline || (!is_inline && is_maintain);
+
 	/*
 	 * If any changes were made, increment the SOA serial number,
 	 * update RRSIGs and NSECs (if zone is secure), and write the update
 	 * to the journal.
 	 */
-	if (!ISC_LIST_EMPTY(diff.tuples)) {
+	if (!ISC_LIST_EMPTY(diff->tuples)) {
 		char *journalfile;
 		dns_journal_t *journal;
 		bool has_dnskey;
@@ -3311,13 +3422,13 @@ update_action(void *arg) {
 		 */
 		if (!soa_serial_changed) {
 			CHECK(update_soa_serial(
-				db, ver, &diff, mctx,
+				db, ver, diff, mctx,
 				dns_zone_getserialupdatemethod(zone)));
 		}
 
-		CHECK(check_mx(client, zone, db, ver, &diff));
+		CHECK(check_mx(client, zone, db, ver, diff));
 
-		CHECK(remove_orphaned_ds(db, ver, &diff));
+		CHECK(remove_orphaned_ds(db, ver, diff));
 
 		CHECK(rrset_exists(db, ver, zonename, dns_rdatatype_dnskey, 0,
 				   &has_dnskey));
@@ -3325,9 +3436,9 @@ update_action(void *arg) {
 		CHECK(rrset_exists(db, oldver, zonename, dns_rdatatype_dnskey,
 				   0, &had_dnskey));
 
-		CHECK(rollback_private(db, privatetype, ver, &diff));
+		CHECK(rollback_private(db, privatetype, ver, diff));
 
-		CHECK(add_nsec3param_records(client, zone, db, ver, &diff));
+		CHECK(add_nsec3param_records(client, zone, db, ver, diff));
 
 		if (is_signing && had_dnskey && !has_dnskey) {
 			/*
@@ -3337,7 +3448,7 @@ update_action(void *arg) {
 			 * remove any NSEC chain present will also be removed.
 			 */
 			CHECK(dns_nsec3param_deletechains(db, ver, zone, true,
-							  &diff));
+							  diff));
 		} else if (has_dnskey && isdnssec(db, ver, privatetype)) {
 			dns_update_log_t log;
 			uint32_t interval =
@@ -3346,7 +3457,7 @@ update_action(void *arg) {
 			log.func = update_log_cb;
 			log.arg = client;
 			result = dns_update_signatures(&log, zone, db, oldver,
-						       ver, &diff, interval);
+						       ver, diff, interval);
 
 			if (result != ISC_R_SUCCESS) {
 				update_log(client, zone, ISC_LOG_ERROR,
@@ -3371,23 +3482,37 @@ update_action(void *arg) {
 
 		journalfile = dns_zone_getjournal(zone);
 		if (journalfile != NULL) {
+			unsigned int mode = DNS_JOURNAL_CREATE;
+
 			update_log(client, zone, LOGLEVEL_DEBUG,
 				   "writing journal %s", journalfile);
 
+			/*
+			 * With group commit the journal is synced later,
+			 * together with the other journals written
+			 * meanwhile, and the response waits for that.
+			 */
+			if ((options & DNS_ZONEOPT_JOURNALGROUPCOMMIT) != 0) {
+				mode |= DNS_JOURNAL_NOSYNC;
+			}
+
 			journal = NULL;
-			result = dns_journal_open(mctx, journalfile,
-						  DNS_JOURNAL_CREATE, &journal);
+			result = dns_journal_open(mctx, journalfile, mode,
+						  &journal);
 			if (result != ISC_R_SUCCESS) {
 				FAILS(result, "journal open failed");
 			}
+			dns_journal_setindex(journal,
+					     dns_zone_getjournalindex(zone));
 
-			result = dns_journal_write_transaction(journal, &diff);
+			result = dns_journal_write_transaction(journal, diff);
 			if (result != ISC_R_SUCCESS) {
 				dns_journal_destroy(&journal);
 				FAILS(result, "journal write failed");
 			}
 
 			dns_journal_destroy(&journal);
+			*journalsyncp = ((mode & DNS_JOURNAL_NOSYNC) != 0);
 		}
 
 		/*
@@ -3398,7 +3523,7 @@ update_action(void *arg) {
 		update_log(client, zone, LOGLEVEL_DEBUG,
 			   "committing update transaction");
 
-		dns_db_closeversion(db, &ver, true);
+		dns_db_closeversion(db, verp, true);
 
 		/*
 		 * Mark the zone as dirty so that it will be written to disk.
@@ -3411,22 +3536,141 @@ update_action(void *arg) {
 		dns_zone_notify(zone);
 	} else {
 		update_log(client, zone, LOGLEVEL_DEBUG, "redundant request");
-		dns_db_closeversion(db, &ver, true);
+		dns_db_closeversion(db, verp, true);
+	}
+	result = ISC_R_SUCCESS;
+
+failure:
+	return result;
+}
+
+/*%
+ * Back out the changes recorded in 'diff' from 'ver', newest first.
+ */
+static isc_result_t
+undo_diff(dns_db_t *db, dns_dbversion_t *ver, dns_diff_t *diff) {
+	isc_result_t result;
+	dns_diff_t undo;
+	dns_difftuple_t *tuple = NULL;
+
+	dns_diff_init(diff->mctx, &undo);
+	ISC_LIST_FOREACH_REV (diff->tuples, tuple, link) {
+		dns_difftuple_t *copy = NULL;
+		dns_diffop_t op;
+
+		switch (tuple->op) {
+		case DNS_DIFFOP_ADD:
+			op = DNS_DIFFOP_DEL;
+			break;
+		case DNS_DIFFOP_DEL:
+			op = DNS_DIFFOP_ADD;
+			break;
+		case DNS_DIFFOP_ADDRESIGN:
+			op = DNS_DIFFOP_DELRESIGN;
+			break;
+		case DNS_DIFFOP_DELRESIGN:
+			op = DNS_DIFFOP_ADDRESIGN;
+			break;
+		default:
+			UNREACHABLE();
+		}
+		dns_difftuple_create(diff->mctx, op, &tuple->name, tuple->ttl,
+				     &tuple->rdata, &copy);
+		dns_diff_append(&undo, &copy);
+	}
+	result = dns_diff_apply(&undo, db, ver);
+	dns_diff_clear(&undo);
+
+	return result;
+}
+
+/*%
+ * Apply the updates queued on 'batch' one after the other to a single
+ * new version of the zone, so that each update sees the changes made by
+ * the ones before it, and commit them together.  An update that fails
+ * is backed out on its own; the others are still committed.
+ */
+static void
+update_batch_run(void *arg) {
+	update_batch_t *batch = arg;
+	dns_zone_t *zone = batch->zone;
+	isc_mem_t *mctx = dns_zone_getmctx(zone);
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	dns_dbversion_t *oldver = NULL;
+	dns_dbversion_t *ver = NULL;
+	dns_diff_t diff; /* Pending updates. */
+	ns_client_t *client = NULL;
+	update_t *uev = NULL, *next = NULL;
+	bool soa_serial_changed = false;
+	bool journalsync = false;
+
+	if (batch->timer != NULL) {
+		isc_timer_stop(batch->timer);
+		isc_timer_destroy(&batch->timer);
+	}
+	if (dns_zone_getupdatebatch(zone) == batch) {
+		dns_zone_setupdatebatch(zone, NULL);
+	}
+
+	dns_diff_init(mctx, &diff);
+
+	CHECK(dns_zone_getdb(zone, &db));
+
+	/*
+	 * Get old and new versions now that queryacl has been checked.
+	 */
+	dns_db_currentversion(db, &oldver);
+	CHECK(dns_db_newversion(db, &ver));
+
+	ISC_LIST_FOREACH (batch->updates, uev, link) {
+		dns_diff_t udiff;
+		bool changed = false;
+
+		dns_diff_init(mctx, &udiff);
+		uev->result = update_apply(uev, db, ver, &udiff, &changed);
+		if (uev->result == ISC_R_SUCCESS) {
+			dns_difftuple_t *tuple = NULL;
+
+			while ((tuple = ISC_LIST_HEAD(udiff.tuples)) != NULL) {
+				ISC_LIST_UNLINK(udiff.tuples, tuple, link);
+				udiff.size--;
+				dns_diff_appendminimal(&diff, &tuple);
+			}
+			soa_serial_changed = soa_serial_changed || changed;
+			if (client == NULL) {
+				client = uev->client;
+			}
+		} else if (batch->count > 1) {
+			update_log(uev->client, zone, LOGLEVEL_DEBUG,
+				   "rolling back");
+			result = undo_diff(db, ver, &udiff);
+			if (result != ISC_R_SUCCESS) {
+				dns_diff_clear(&udiff);
+				goto failure;
+			}
+		}
+		dns_diff_clear(&udiff);
+	}
+
+	if (client != NULL) {
+		CHECK(update_commit(client, zone, db, oldver, &ver, &diff,
+				    soa_serial_changed, &journalsync));
 	}
 	result = ISC_R_SUCCESS;
-	goto common;
 
 failure:
 	/*
 	 * The reason for failure should have been logged at this point.
+	 * The updates that were applied share its result.
 	 */
 	if (ver != NULL) {
-		update_log(client, zone, LOGLEVEL_DEBUG, "rolling back");
+		uev = ISC_LIST_HEAD(batch->updates);
+		update_log(client != NULL ? client : uev->client, zone,
+			   LOGLEVEL_DEBUG, "rolling back");
 		dns_db_closeversion(db, &ver, false);
 	}
 
-common:
-	dns_diff_clear(&temp);
 	dns_diff_clear(&diff);
 
 	if (oldver != NULL) {
@@ -3437,21 +3681,67 @@ common:
 		dns_db_detach(&db);
 	}
 
-	if (maxbytype != NULL) {
-		isc_mem_cput(mctx, maxbytype, maxbytypelen, sizeof(*maxbytype));
+	ISC_LIST_FOREACH_SAFE (batch->updates, uev, link, next) {
+		ISC_LIST_UNLINK(batch->updates, uev, link);
+		INSIST(uev->zone == zone);
+		if (result != ISC_R_SUCCESS && uev->result == ISC_R_SUCCESS) {
+			uev->result = result;
+		}
+		if (journalsync && uev->result == ISC_R_SUCCESS) {
+			dns_zone_journalsync(zone, uev->client->manager->loop,
+					     updatedone_action, uev,
+					     &uev->result);
+		} else {
+			isc_async_run(uev->client->manager->loop,
+				      updatedone_action, uev);
+		}
 	}
 
-	if (ssutable != NULL) {
-		dns_ssutable_detach(&ssutable);
+	dns_zone_detach(&batch->zone);
+	isc_mem_put(mctx, batch, sizeof(*batch));
+}
+
+/*%
+ * Queue the update in 'arg' on the batch of its zone.  Without
+ * update-batch-window the batch is run straight away; otherwise the first
+ * update of a batch starts the window and the updates arriving within it
+ * join the batch.
+ */
+static void
+update_action(void *arg) {
+	update_t *uev = (update_t *)arg;
+	dns_zone_t *zone = uev->zone;
+	uint32_t window = dns_zone_getupdatebatchwindow(zone);
+	update_batch_t *batch = NULL;
+	isc_interval_t interval;
+
+	if (window != 0) {
+		batch = dns_zone_getupdatebatch(zone);
+	}
+	if (batch == NULL) {
+		batch = isc_mem_get(dns_zone_getmctx(zone), sizeof(*batch));
+		*batch = (update_batch_t){
+			.updates = ISC_LIST_INITIALIZER,
+		};
+		dns_zone_attach(zone, &batch->zone);
 	}
 
-	uev->result = result;
-	if (zone != NULL) {
-		INSIST(uev->zone == zone); /* we use this later */
+	ISC_LIST_APPEND(batch->updates, uev, link);
+	batch->count++;
+
+	if (window == 0 || batch->count >= UPDATE_BATCH_MAX) {
+		update_batch_run(batch);
+		return;
 	}
 
-	isc_async_run(client->manager->loop, updatedone_action, uev);
-	INSIST(ver == NULL);
+	if (batch->timer == NULL) {
+		dns_zone_setupdatebatch(zone, batch);
+		isc_timer_create(dns_zone_getloop(zone), update_batch_run,
+				 batch, &batch->timer);
+		isc_interval_set(&interval, window / 1000,
+				 (window % 1000) * NS_PER_MS);
+		isc_timer_start(batch->timer, isc_timertype_once, &interval);
+	}
 }
 
 static void
@@ -3476,6 +3766,11 @@ updatedone_action(void *arg) {
 	respond(client, uev->result);
 
 	isc_quota_release(&client->manager->sctx->updquota);
+	isc_quota_release(uev->zonequota);
+	if (uev->maxbytype != NULL) {
+		isc_mem_cput(client->manager->mctx, uev->maxbytype,
+			     uev->maxbytypelen, sizeof(*uev->maxbytype));
+	}
 	if (uev->zone != NULL) {
 		dns_zone_detach(&uev->zone);
 	}
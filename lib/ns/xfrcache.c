@@ -0,0 +1,401 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <isc/buffer.h>
+#include <isc/list.h>
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/refcount.h>
+#include <isc/stdtime.h>
+#include <isc/util.h>
+
+#include <dns/db.h>
+#include <dns/message.h>
+
+#include <ns/xfrcache.h>
+
+#define XFRCACHE_MAGIC	  ISC_MAGIC('X', 'f', 'r', 'C')
+#define VALID_XFRCACHE(c) ISC_MAGIC_VALID(c, XFRCACHE_MAGIC)
+
+#define XFRENTRY_MAGIC	  ISC_MAGIC('X', 'f', 'r', 'E')
+#define VALID_XFRENTRY(e) ISC_MAGIC_VALID(e, XFRENTRY_MAGIC)
+
+struct ns_xfrcache {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	isc_mutex_t lock;
+	ISC_LIST(ns_xfrcacheentry_t) lru; /* most recently used first */
+	uint64_t size;
+	uint64_t maxsize;
+};
+
+struct ns_xfrcacheentry {
+	unsigned int magic;
+	isc_refcount_t references;
+	ns_xfrcache_t *cache;
+	ns_xfrcachekey_t key;
+
+	/* Protected by the entry lock */
+	isc_mutex_t lock;
+	ISC_LIST(ns_xfrmsg_t) messages;
+	ns_xfrcache_render_t render;
+	ns_xfrcache_free_t freebuilder;
+	void *builder;
+	isc_result_t result;
+	isc_buffer_t *buffer;
+
+	/* Protected by the cache lock */
+	uint64_t size;
+	isc_stdtime_t lastused;
+	bool linked;
+	ISC_LINK(ns_xfrcacheentry_t) link;
+};
+
+static bool
+key_match(const ns_xfrcachekey_t *a, const ns_xfrcachekey_t *b) {
+	return a->zone == b->zone && a->db == b->db && a->serial == b->serial &&
+	       a->msgsize == b->msgsize && a->qclass == b->qclass &&
+	       a->qnamelen == b->qnamelen &&
+	       memcmp(a->qname, b->qname, a->qnamelen) == 0;
+}
+
+static void
+builder_free(ns_xfrcacheentry_t *entry) {
+	if (entry->builder != NULL) {
+		(entry->freebuilder)(entry->builder);
+		entry->builder = NULL;
+	}
+	if (entry->buffer != NULL) {
+		isc_buffer_free(&entry->buffer);
+	}
+}
+
+static void
+entry_destroy(ns_xfrcacheentry_t *entry) {
+	isc_mem_t *mctx = entry->cache->mctx;
+	ns_xfrmsg_t *msg = NULL;
+
+	INSIST(!entry->linked);
+
+	builder_free(entry);
+	while ((msg = ISC_LIST_HEAD(entry->messages)) != NULL) {
+		ISC_LIST_UNLINK(entry->messages, msg, link);
+		isc_mem_put(mctx, msg,
+			    sizeof(*msg) + msg->question.length +
+				    msg->answer.length);
+	}
+
+	dns_db_detach(&entry->key.db);
+	isc_mutex_destroy(&entry->lock);
+	isc_refcount_destroy(&entry->references);
+	entry->magic = 0;
+	isc_mem_put(mctx, entry, sizeof(*entry));
+}
+
+ISC_REFCOUNT_IMPL(ns_xfrcacheentry, entry_destroy);
+
+/*
+ * Remove 'entry' from the cache; it's destroyed when the last transfer
+ * using it ends.  The cache must be locked.
+ */
+static void
+entry_unlink(ns_xfrcache_t *cache, ns_xfrcacheentry_t *entry) {
+	INSIST(entry->linked);
+
+	ISC_LIST_UNLINK(cache->lru, entry, link);
+	INSIST(cache->size >= entry->size);
+	cache->size -= entry->size;
+	entry->linked = false;
+
+	ns_xfrcacheentry_detach(&entry);
+}
+
+static bool
+entry_inuse(ns_xfrcacheentry_t *entry) {
+	return isc_refcount_current(&entry->references) > 1;
+}
+
+/*
+ * Evict the unused entries until 'needed' more bytes fit into the cache,
+ * and those that have been idle for too long.  The cache must be locked.
+ */
+static void
+cache_evict(ns_xfrcache_t *cache, uint64_t needed, isc_stdtime_t now) {
+	ns_xfrcacheentry_t *entry = NULL, *prev = NULL;
+
+	for (entry = ISC_LIST_TAIL(cache->lru); entry != NULL; entry = prev) {
+		prev = ISC_LIST_PREV(entry, link);
+
+		if (entry_inuse(entry)) {
+			continue;
+		}
+		if (cache->size + needed > cache->maxsize ||
+		    entry->lastused + NS_XFRCACHE_IDLETIME < now)
+		{
+			entry_unlink(cache, entry);
+		}
+	}
+}
+
+void
+ns_xfrcache_create(isc_mem_t *mctx, ns_xfrcache_t **cachep) {
+	ns_xfrcache_t *cache = NULL;
+
+	REQUIRE(cachep != NULL && *cachep == NULL);
+
+	cache = isc_mem_get(mctx, sizeof(*cache));
+	*cache = (ns_xfrcache_t){
+		.magic = XFRCACHE_MAGIC,
+		.lru = ISC_LIST_INITIALIZER,
+	};
+	isc_mem_attach(mctx, &cache->mctx);
+	isc_mutex_init(&cache->lock);
+
+	*cachep = cache;
+}
+
+void
+ns_xfrcache_destroy(ns_xfrcache_t **cachep) {
+	ns_xfrcache_t *cache = NULL;
+	ns_xfrcacheentry_t *entry = NULL;
+
+	REQUIRE(cachep != NULL && VALID_XFRCACHE(*cachep));
+
+	cache = *cachep;
+	*cachep = NULL;
+
+	while ((entry = ISC_LIST_HEAD(cache->lru)) != NULL) {
+		INSIST(!entry_inuse(entry));
+		entry_unlink(cache, entry);
+	}
+	INSIST(cache->size == 0);
+
+	isc_mutex_destroy(&cache->lock);
+	cache->magic = 0;
+	isc_mem_putanddetach(&cache->mctx, cache, sizeof(*cache));
+}
+
+void
+ns_xfrcache_setmaxsize(ns_xfrcache_t *cache, uint64_t maxsize) {
+	REQUIRE(VALID_XFRCACHE(cache));
+
+	LOCK(&cache->lock);
+	cache->maxsize = maxsize;
+	cache_evict(cache, 0, isc_stdtime_now());
+	UNLOCK(&cache->lock);
+}
+
+void
+ns_xfrcache_initkey(ns_xfrcachekey_t *key, dns_zone_t *zone, dns_db_t *db,
+		    uint32_t serial, const dns_name_t *qname) {
+	REQUIRE(key != NULL);
+	REQUIRE(DNS_DB_VALID(db));
+	REQUIRE(qname->length <= sizeof(key->qname));
+
+	*key = (ns_xfrcachekey_t){
+		.zone = zone,
+		.db = db,
+		.serial = serial,
+		.qnamelen = qname->length,
+	};
+	memmove(key->qname, qname->ndata, qname->length);
+}
+
+isc_result_t
+ns_xfrcache_find(ns_xfrcache_t *cache, const ns_xfrcachekey_t *key,
+		 uint64_t estimate, ns_xfrcacheentry_t **entryp) {
+	ns_xfrcacheentry_t *entry = NULL, *next = NULL;
+	isc_stdtime_t now = isc_stdtime_now();
+	isc_result_t result = ISC_R_NOTFOUND;
+
+	REQUIRE(VALID_XFRCACHE(cache));
+	REQUIRE(key != NULL);
+	REQUIRE(entryp != NULL && *entryp == NULL);
+
+	LOCK(&cache->lock);
+	if (estimate > cache->maxsize) {
+		result = ISC_R_NOSPACE;
+		goto unlock;
+	}
+
+	for (entry = ISC_LIST_HEAD(cache->lru); entry != NULL; entry = next) {
+		next = ISC_LIST_NEXT(entry, link);
+
+		if (key_match(&entry->key, key)) {
+			ISC_LIST_UNLINK(cache->lru, entry, link);
+			ISC_LIST_PREPEND(cache->lru, entry, link);
+			entry->lastused = now;
+			ns_xfrcacheentry_attach(entry, entryp);
+			result = ISC_R_SUCCESS;
+		} else if (entry->key.zone == key->zone &&
+			   (entry->key.db != key->db ||
+			    entry->key.serial != key->serial))
+		{
+			/* An older (or newer) version of the zone */
+			entry_unlink(cache, entry);
+		}
+	}
+
+	if (result == ISC_R_NOTFOUND) {
+		cache_evict(cache, estimate, now);
+	}
+
+unlock:
+	UNLOCK(&cache->lock);
+
+	return result;
+}
+
+void
+ns_xfrcache_add(ns_xfrcache_t *cache, const ns_xfrcachekey_t *key,
+		ns_xfrcache_render_t render, ns_xfrcache_free_t freebuilder,
+		void *arg, ns_xfrcacheentry_t **entryp) {
+	ns_xfrcacheentry_t *entry = NULL;
+
+	REQUIRE(VALID_XFRCACHE(cache));
+	REQUIRE(key != NULL && DNS_DB_VALID(key->db));
+	REQUIRE(render != NULL && freebuilder != NULL);
+	REQUIRE(entryp != NULL && *entryp == NULL);
+
+	LOCK(&cache->lock);
+	ISC_LIST_FOREACH (cache->lru, entry, link) {
+		if (key_match(&entry->key, key)) {
+			ns_xfrcacheentry_attach(entry, entryp);
+			UNLOCK(&cache->lock);
+			(freebuilder)(arg);
+			return;
+		}
+	}
+
+	entry = isc_mem_get(cache->mctx, sizeof(*entry));
+	*entry = (ns_xfrcacheentry_t){
+		.magic = XFRENTRY_MAGIC,
+		.cache = cache,
+		.key = *key,
+		.messages = ISC_LIST_INITIALIZER,
+		.render = render,
+		.freebuilder = freebuilder,
+		.builder = arg,
+		.result = ISC_R_SUCCESS,
+		.lastused = isc_stdtime_now(),
+		.linked = true,
+		.link = ISC_LINK_INITIALIZER,
+	};
+	isc_refcount_init(&entry->references, 1); /* the cache's reference */
+	entry->key.db = NULL;
+	dns_db_attach(key->db, &entry->key.db);
+	isc_mutex_init(&entry->lock);
+	isc_buffer_allocate(cache->mctx, &entry->buffer, 65535);
+
+	ISC_LIST_PREPEND(cache->lru, entry, link);
+	ns_xfrcacheentry_attach(entry, entryp);
+	UNLOCK(&cache->lock);
+}
+
+/*
+ * Render the next message of 'entry' and append it to the messages.
+ * The entry must be locked.
+ */
+static isc_result_t
+entry_render(ns_xfrcacheentry_t *entry) {
+	ns_xfrcache_t *cache = entry->cache;
+	ns_xfrmsg_t *msg = NULL;
+	isc_region_t r;
+	unsigned int qlen = 0, ancount = 0;
+	bool last = false;
+	isc_result_t result;
+
+	if (entry->result != ISC_R_SUCCESS) {
+		return entry->result;
+	}
+
+	INSIST(entry->builder != NULL);
+
+	isc_buffer_clear(entry->buffer);
+	result = (entry->render)(entry->builder, entry->buffer, &qlen,
+				 &ancount, &last);
+	if (result != ISC_R_SUCCESS) {
+		entry->result = result;
+		builder_free(entry);
+
+		/* Let the next transfer try again with a new entry */
+		LOCK(&cache->lock);
+		if (entry->linked) {
+			entry_unlink(cache, entry);
+		}
+		UNLOCK(&cache->lock);
+		return result;
+	}
+
+	isc_buffer_usedregion(entry->buffer, &r);
+	INSIST(r.length >= DNS_MESSAGE_HEADERLEN + qlen);
+	isc_region_consume(&r, DNS_MESSAGE_HEADERLEN);
+
+	msg = isc_mem_get(cache->mctx, sizeof(*msg) + r.length);
+	*msg = (ns_xfrmsg_t){
+		.question.base = (unsigned char *)(msg + 1),
+		.question.length = qlen,
+		.ancount = ancount,
+		.last = last,
+		.link = ISC_LINK_INITIALIZER,
+	};
+	msg->answer.base = msg->question.base + qlen;
+	msg->answer.length = r.length - qlen;
+	memmove(msg->question.base, r.base, r.length);
+	ISC_LIST_APPEND(entry->messages, msg, link);
+
+	if (last) {
+		builder_free(entry);
+	}
+
+	LOCK(&cache->lock);
+	entry->size += sizeof(*msg) + r.length;
+	if (entry->linked) {
+		cache->size += sizeof(*msg) + r.length;
+	}
+	UNLOCK(&cache->lock);
+
+	return ISC_R_SUCCESS;
+}
+
+isc_result_t
+ns_xfrcache_next(ns_xfrcacheentry_t *entry, const ns_xfrmsg_t *prev,
+		 const ns_xfrmsg_t **msgp) {
+	ns_xfrmsg_t *msg = NULL;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	REQUIRE(VALID_XFRENTRY(entry));
+	REQUIRE(prev == NULL || !prev->last);
+	REQUIRE(msgp != NULL);
+
+	LOCK(&entry->lock);
+	msg = (prev == NULL) ? ISC_LIST_HEAD(entry->messages)
+			     : ISC_LIST_NEXT(prev, link);
+	if (msg == NULL) {
+		result = entry_render(entry);
+		if (result == ISC_R_SUCCESS) {
+			msg = ISC_LIST_TAIL(entry->messages);
+		}
+	}
+	UNLOCK(&entry->lock);
+
+	*msgp = msg;
+	return result;
+}
@@ -44,6 +44,7 @@
 #include <ns/client.h>
 #include <ns/server.h>
 #include <ns/stats.h>
+#include <ns/xfrcache.h>
 #include <ns/xfrout.h>
 
 /*! \file
@@ -202,7 +203,9 @@ rrstream_noop_pause(rrstream_t *rs) {
 /**************************************************************************/
 /*
  * An 'ixfr_rrstream_t' is an 'rrstream_t' that returns
- * an IXFR-like RR stream from a journal file.
+ * an IXFR-like RR stream from a journal file.  The journal is read in
+ * raw mode: the rdata is returned as stored in the journal, to be
+ * copied to the messages with dns_message_renderrr().
  *
  * The SOA at the beginning of each sequence of additions
  * or deletions are included in the stream, but the extra
@@ -228,8 +231,8 @@ static rrstream_methods_t ixfr_rrstream_methods;
 
 static isc_result_t
 ixfr_rrstream_create(isc_mem_t *mctx, const char *journal_filename,
-		     uint32_t begin_serial, uint32_t end_serial, size_t *sizep,
-		     rrstream_t **sp) {
+		     dns_journalindex_t *journal_index, uint32_t begin_serial,
+		     uint32_t end_serial, size_t *sizep, rrstream_t **sp) {
 	isc_result_t result;
 	ixfr_rrstream_t *s = NULL;
 
@@ -241,8 +244,10 @@ ixfr_rrstream_create(isc_mem_t *mctx, const char *journal_filename,
 	s->common.methods = &ixfr_rrstream_methods;
 	s->journal = NULL;
 
-	CHECK(dns_journal_open(mctx, journal_filename, DNS_JOURNAL_READ,
+	CHECK(dns_journal_open(mctx, journal_filename,
+			       DNS_JOURNAL_READ | DNS_JOURNAL_RAW,
 			       &s->journal));
+	dns_journal_setindex(s->journal, journal_index);
 	CHECK(dns_journal_iter_init(s->journal, begin_serial, end_serial,
 				    sizep));
 
@@ -656,6 +661,7 @@ typedef struct {
 			      * names and rdatas */
 	isc_buffer_t txbuf;  /* Transmit message buffer */
 	size_t cbytes;	     /* Length of current message */
+	dns_compress_t cctx; /* Reset for each message */
 	void *txmem;
 	unsigned int txmemlen;
 	dns_tsigkey_t *tsigkey; /* Key used to create TSIG */
@@ -677,6 +683,12 @@ typedef struct {
 
 	/* Delayed send */
 	isc_nm_timer_t *delayed_send_timer;
+
+	/* Messages sent from the transfer cache, if any */
+	ns_xfrcacheentry_t *cache;
+	const ns_xfrmsg_t *cachemsg; /* the last message sent */
+
+	bool rawrrs; /* The stream returns unparsed rdata */
 } xfrout_ctx_t;
 
 static void
@@ -689,6 +701,9 @@ xfrout_ctx_create(isc_mem_t *mctx, ns_client_t *client, unsigned int id,
 		  unsigned int idletime, bool many_answers,
 		  xfrout_ctx_t **xfrp);
 
+static void
+xfrout_cachesetup(xfrout_ctx_t *xfr);
+
 static void
 sendstream(xfrout_ctx_t *xfr);
 
@@ -870,8 +885,14 @@ ns_xfr_start(ns_client_t *client, dns_rdatatype_t reqtype) {
 
 	/*
 	 * Check the authority section.  Look for a SOA record with
-	 * the same name and class as the question.
+	 * the same name and class as the question.  The request was
+	 * parsed without it, see ns_client_request().
 	 */
+	result = dns_message_parsedeferred(request);
+	if (result != ISC_R_SUCCESS) {
+		FAILC(DNS_R_FORMERR, "malformed authority section");
+	}
+
 	for (result = dns_message_firstname(request, DNS_SECTION_AUTHORITY);
 	     result == ISC_R_SUCCESS;
 	     result = dns_message_nextname(request, DNS_SECTION_AUTHORITY))
@@ -1025,8 +1046,9 @@ got_soa:
 		journalfile = is_dlz ? NULL : dns_zone_getjournal(zone);
 		if (journalfile != NULL) {
 			result = ixfr_rrstream_create(
-				mctx, journalfile, begin_serial, current_serial,
-				&jsize, &data_stream);
+				mctx, journalfile,
+				dns_zone_getjournalindex(zone), begin_serial,
+				current_serial, &jsize, &data_stream);
 		} else {
 			result = ISC_R_NOTFOUND;
 		}
@@ -1106,10 +1128,19 @@ have_stream:
 
 	xfr->end_serial = current_serial;
 	xfr->mnemonic = mnemonic;
+	xfr->rawrrs = is_ixfr;
 	stream = NULL;
 
 	CHECK(xfr->stream->methods->first(xfr->stream));
 
+	/*
+	 * Full zone transfers in the many-answers format may be sent from
+	 * the messages rendered for an earlier transfer of this version.
+	 */
+	if (reqtype == dns_rdatatype_axfr && !is_dlz && xfr->many_answers) {
+		xfrout_cachesetup(xfr);
+	}
+
 	if (xfr->tsigkey != NULL) {
 		dns_name_format(xfr->tsigkey->name, keyname, sizeof(keyname));
 	} else {
@@ -1243,6 +1274,13 @@ xfrout_ctx_create(isc_mem_t *mctx, ns_client_t *client, unsigned int id,
 
 	isc_mem_attach(mctx, &xfr->mctx);
 
+	/*
+	 * The compression table of a zone transfer message is large;
+	 * it is allocated once and emptied for each message.
+	 */
+	dns_compress_init(&xfr->cctx, xfr->mctx,
+			  DNS_COMPRESS_CASE | DNS_COMPRESS_LARGE);
+
 	if (zone != NULL) { /* zone will be NULL if it's DLZ */
 		dns_zone_attach(zone, &xfr->zone);
 	}
@@ -1358,6 +1396,407 @@ xfrout_enqueue_send(xfrout_ctx_t *xfr) {
 	isc_nm_timer_start(xfr->delayed_send_timer, timeout);
 }
 
+/*
+ * Add the question section to 'msg', storing the name in 'buf' after
+ * the reserved space for the message header.
+ */
+static void
+addquestion(dns_message_t *msg, isc_buffer_t *buf, const dns_name_t *name,
+	    dns_rdataclass_t rdclass, dns_rdatatype_t type) {
+	dns_rdataset_t *qrdataset = NULL;
+	dns_name_t *qname = NULL;
+	isc_region_t r;
+
+	/*
+	 * Reserve space for the 12-byte message header
+	 * and 4 bytes of question.
+	 */
+	isc_buffer_add(buf, 12 + 4);
+
+	dns_message_gettemprdataset(msg, &qrdataset);
+	dns_rdataset_makequestion(qrdataset, rdclass, type);
+
+	dns_message_gettempname(msg, &qname);
+	isc_buffer_availableregion(buf, &r);
+	INSIST(r.length >= name->length);
+	r.length = name->length;
+	isc_buffer_putmem(buf, name->ndata, name->length);
+	dns_name_fromregion(qname, &r);
+	ISC_LIST_INIT(qname->list);
+	ISC_LIST_APPEND(qname->list, qrdataset, link);
+
+	dns_message_addname(msg, qname, DNS_SECTION_QUESTION);
+}
+
+/*
+ * Add as many RRs from 'stream' to the answer section of 'msg' as fit
+ * into 'buf', the raw owner names and RR data being stored in 'buf'.
+ * Only one RR is added unless 'many_answers' is set, and in TCP
+ * messages no more RRs are added once 'msgsize' bytes are used.
+ *
+ * '*nrrsp' is set to the number of RRs added and '*eosp' to true if the
+ * end of the stream was reached.  If the first RR doesn't fit by
+ * itself, ISC_R_NOSPACE is returned and '*sizep' is set to its size.
+ */
+static isc_result_t
+addrrs(rrstream_t *stream, dns_message_t *msg, isc_buffer_t *buf,
+       bool many_answers, bool is_tcp, unsigned int msgsize,
+       unsigned int *nrrsp, bool *eosp, unsigned int *sizep) {
+	isc_result_t result = ISC_R_SUCCESS;
+	unsigned int n_rrs;
+
+	/*
+	 * Try to fit in as many RRs as possible, unless "one-answer"
+	 * format has been requested.
+	 */
+	for (n_rrs = 0;; n_rrs++) {
+		dns_name_t *name = NULL;
+		uint32_t ttl;
+		dns_rdata_t *rdata = NULL;
+		dns_name_t *msgname = NULL;
+		dns_rdata_t *msgrdata = NULL;
+		dns_rdatalist_t *msgrdl = NULL;
+		dns_rdataset_t *msgrds = NULL;
+		unsigned int size;
+		isc_region_t r;
+
+		stream->methods->current(stream, &name, &ttl, &rdata);
+		size = name->length + 10 + rdata->length;
+		isc_buffer_availableregion(buf, &r);
+		if (size >= r.length) {
+			/*
+			 * RR would not fit.  If there are other RRs in the
+			 * buffer, send them now and leave this RR to the
+			 * next message.  If this RR overflows the buffer
+			 * all by itself, fail.
+			 *
+			 * In theory some RRs might fit in a TCP message
+			 * when compressed even if they do not fit when
+			 * uncompressed, but surely we don't want
+			 * to send such monstrosities to an unsuspecting
+			 * secondary.
+			 */
+			if (n_rrs == 0) {
+				*sizep = size;
+				/* XXX DNS_R_RRTOOLARGE? */
+				result = ISC_R_NOSPACE;
+			}
+			break;
+		}
+
+		if (isc_log_wouldlog(XFROUT_RR_LOGLEVEL)) {
+			log_rr(name, rdata, ttl); /* XXX */
+		}
+
+		dns_message_gettempname(msg, &msgname);
+		isc_buffer_availableregion(buf, &r);
+		INSIST(r.length >= name->length);
+		r.length = name->length;
+		isc_buffer_putmem(buf, name->ndata, name->length);
+		dns_name_fromregion(msgname, &r);
+
+		/* Reserve space for RR header. */
+		isc_buffer_add(buf, 10);
+
+		dns_message_gettemprdata(msg, &msgrdata);
+		isc_buffer_availableregion(buf, &r);
+		r.length = rdata->length;
+		isc_buffer_putmem(buf, rdata->data, rdata->length);
+		dns_rdata_init(msgrdata);
+		dns_rdata_fromregion(msgrdata, rdata->rdclass, rdata->type, &r);
+
+		dns_message_gettemprdatalist(msg, &msgrdl);
+		msgrdl->type = rdata->type;
+		msgrdl->rdclass = rdata->rdclass;
+		msgrdl->ttl = ttl;
+		if (rdata->type == dns_rdatatype_sig ||
+		    rdata->type == dns_rdatatype_rrsig)
+		{
+			msgrdl->covers = dns_rdata_covers(rdata);
+		} else {
+			msgrdl->covers = dns_rdatatype_none;
+		}
+		ISC_LIST_APPEND(msgrdl->rdata, msgrdata, link);
+
+		dns_message_gettemprdataset(msg, &msgrds);
+		dns_rdatalist_tordataset(msgrdl, msgrds);
+
+		ISC_LIST_APPEND(msgname->list, msgrds, link);
+
+		dns_message_addname(msg, msgname, DNS_SECTION_ANSWER);
+
+		result = stream->methods->next(stream);
+		if (result == ISC_R_NOMORE) {
+			*eosp = true;
+			result = ISC_R_SUCCESS;
+			n_rrs++;
+			break;
+		}
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+
+		if (!many_answers) {
+			n_rrs++;
+			break;
+		}
+		/*
+		 * At this stage, at least 1 RR has been rendered into
+		 * the message. Check if we want to clamp this message
+		 * here (TCP only).
+		 */
+		if ((isc_buffer_usedlength(buf) >= msgsize) && is_tcp) {
+			n_rrs++;
+			break;
+		}
+	}
+
+	*nrrsp = n_rrs;
+	return result;
+}
+
+/*
+ * Render as many RRs from 'stream' to the answer section of 'msg' as
+ * fit, copying the RR data to the wire without parsing it; only the
+ * owner names are compressed.  The arguments and the return values are
+ * those of addrrs(), with 'msgsize' applied to the rendered message.
+ */
+static isc_result_t
+addrawrrs(rrstream_t *stream, dns_message_t *msg, bool many_answers,
+	  unsigned int msgsize, unsigned int *nrrsp, bool *eosp,
+	  unsigned int *sizep) {
+	isc_result_t result = ISC_R_SUCCESS;
+	unsigned int n_rrs;
+
+	for (n_rrs = 0;; n_rrs++) {
+		dns_name_t *name = NULL;
+		uint32_t ttl;
+		dns_rdata_t *rdata = NULL;
+
+		stream->methods->current(stream, &name, &ttl, &rdata);
+		result = dns_message_renderrr(msg, DNS_SECTION_ANSWER, name,
+					      ttl, rdata);
+		if (result == ISC_R_NOSPACE) {
+			/*
+			 * Leave the RR to the next message, unless it
+			 * doesn't fit by itself.
+			 */
+			if (n_rrs == 0) {
+				*sizep = name->length + 10 + rdata->length;
+			} else {
+				result = ISC_R_SUCCESS;
+			}
+			break;
+		}
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+
+		if (isc_log_wouldlog(XFROUT_RR_LOGLEVEL)) {
+			log_rr(name, rdata, ttl);
+		}
+
+		result = stream->methods->next(stream);
+		if (result == ISC_R_NOMORE) {
+			*eosp = true;
+			result = ISC_R_SUCCESS;
+			n_rrs++;
+			break;
+		}
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+
+		if (!many_answers ||
+		    isc_buffer_usedlength(msg->buffer) >= msgsize)
+		{
+			n_rrs++;
+			break;
+		}
+	}
+
+	*nrrsp = n_rrs;
+	return result;
+}
+
+/**************************************************************************/
+/*
+ * An 'xfrout_builder_t' renders the messages of an AXFR into the
+ * transfer cache.  It has a stream of its own, independent from the
+ * transfers the messages are sent in, and is driven by whichever
+ * transfer needs the next message first.
+ */
+
+typedef struct xfrout_builder {
+	isc_mem_t *mctx;
+	dns_db_t *db;
+	dns_dbversion_t *ver;
+	rrstream_t *stream;
+	dns_fixedname_t fqname;
+	dns_name_t *qname;
+	dns_rdataclass_t qclass;
+	unsigned int msgsize;
+	bool question_added;
+	isc_buffer_t *buf;   /* Owner names and rdatas */
+	dns_compress_t cctx; /* Reset for each message */
+} xfrout_builder_t;
+
+static void
+builder_free(void *arg) {
+	xfrout_builder_t *b = arg;
+
+	if (b->stream != NULL) {
+		b->stream->methods->destroy(&b->stream);
+	}
+	if (b->buf != NULL) {
+		isc_buffer_free(&b->buf);
+	}
+	dns_compress_invalidate(&b->cctx);
+	dns_db_closeversion(b->db, &b->ver, false);
+	dns_db_detach(&b->db);
+	isc_mem_putanddetach(&b->mctx, b, sizeof(*b));
+}
+
+static isc_result_t
+builder_render(void *arg, isc_buffer_t *target, unsigned int *questionlenp,
+	       unsigned int *ancountp, bool *lastp) {
+	xfrout_builder_t *b = arg;
+	dns_message_t *msg = NULL;
+	unsigned int size = 0;
+	isc_result_t result;
+
+	isc_buffer_clear(b->buf);
+
+	dns_message_create(b->mctx, NULL, NULL, DNS_MESSAGE_INTENTRENDER,
+			   &msg);
+	msg->flags = DNS_MESSAGEFLAG_QR | DNS_MESSAGEFLAG_AA;
+
+	/*
+	 * Leave room for the OPT and TSIG records of the transfers
+	 * the message will be sent in.
+	 */
+	isc_buffer_add(b->buf, NS_XFRCACHE_RESERVE);
+
+	if (!b->question_added) {
+		addquestion(msg, b->buf, b->qname, b->qclass,
+			    dns_rdatatype_axfr);
+		b->question_added = true;
+	} else {
+		isc_buffer_add(b->buf, 12);
+	}
+
+	result = addrrs(b->stream, msg, b->buf, true, true, b->msgsize,
+			ancountp, lastp, &size);
+	if (result == ISC_R_NOSPACE) {
+		char namebuf[DNS_NAME_FORMATSIZE];
+		char classbuf[DNS_RDATACLASS_FORMATSIZE];
+
+		dns_name_format(b->qname, namebuf, sizeof(namebuf));
+		dns_rdataclass_format(b->qclass, classbuf, sizeof(classbuf));
+		isc_log_write(DNS_LOGCATEGORY_XFER_OUT, NS_LOGMODULE_XFER_OUT,
+			      ISC_LOG_WARNING,
+			      "transfer of '%s/%s': RR too large for zone "
+			      "transfer (%d bytes)",
+			      namebuf, classbuf, size);
+	}
+	if (result != ISC_R_SUCCESS) {
+		goto failure;
+	}
+
+	dns_compress_reset(&b->cctx);
+	result = dns_message_renderbegin(msg, &b->cctx, target);
+	if (result == ISC_R_SUCCESS) {
+		result = dns_message_rendersection(msg, DNS_SECTION_QUESTION,
+						   0);
+	}
+	if (result == ISC_R_SUCCESS) {
+		*questionlenp = isc_buffer_usedlength(target) -
+				DNS_MESSAGE_HEADERLEN;
+		result = dns_message_rendersection(msg, DNS_SECTION_ANSWER, 0);
+	}
+	if (result == ISC_R_SUCCESS) {
+		result = dns_message_renderend(msg);
+	}
+
+failure:
+	/*
+	 * The next message may be rendered on another thread;
+	 * release any locks held by the database iterators.
+	 */
+	b->stream->methods->pause(b->stream);
+	dns_message_detach(&msg);
+
+	return result;
+}
+
+/*
+ * Serve the transfer from the transfer cache if possible, adding the
+ * entry for this version of the zone if it's the first transfer of it.
+ */
+static void
+xfrout_cachesetup(xfrout_ctx_t *xfr) {
+	ns_server_t *sctx = xfr->client->manager->sctx;
+	ns_xfrcachekey_t key;
+	xfrout_builder_t *b = NULL;
+	rrstream_t *soa_stream = NULL;
+	rrstream_t *data_stream = NULL;
+	uint64_t xfrsize = 0;
+	isc_result_t result;
+
+	ns_xfrcache_initkey(&key, xfr->zone, xfr->db, xfr->end_serial,
+			    xfr->qname);
+	key.msgsize = sctx->transfer_tcp_message_size;
+	key.qclass = xfr->qclass;
+
+	(void)dns_db_getsize(xfr->db, xfr->ver, NULL, &xfrsize);
+
+	result = ns_xfrcache_find(sctx->xfrcache, &key, xfrsize, &xfr->cache);
+	if (result == ISC_R_SUCCESS) {
+		inc_stats(xfr->client, xfr->zone, ns_statscounter_xfrcachehit);
+		return;
+	}
+	if (result != ISC_R_NOTFOUND) {
+		return;
+	}
+
+	b = isc_mem_get(sctx->mctx, sizeof(*b));
+	*b = (xfrout_builder_t){
+		.qclass = xfr->qclass,
+		.msgsize = key.msgsize,
+	};
+	isc_mem_attach(sctx->mctx, &b->mctx);
+	dns_db_attach(xfr->db, &b->db);
+	dns_db_attachversion(b->db, xfr->ver, &b->ver);
+	b->qname = dns_fixedname_initname(&b->fqname);
+	dns_name_copy(xfr->qname, b->qname);
+	isc_buffer_allocate(b->mctx, &b->buf, NS_CLIENT_TCP_BUFFER_SIZE);
+	dns_compress_init(&b->cctx, b->mctx,
+			  DNS_COMPRESS_CASE | DNS_COMPRESS_LARGE);
+
+	/*
+	 * Bracket the data stream with SOAs.
+	 */
+	CHECK(axfr_rrstream_create(b->mctx, b->db, b->ver, &data_stream));
+	CHECK(soa_rrstream_create(b->mctx, b->db, b->ver, &soa_stream));
+	CHECK(compound_rrstream_create(b->mctx, &soa_stream, &data_stream,
+				       &b->stream));
+	CHECK(b->stream->methods->first(b->stream));
+	b->stream->methods->pause(b->stream);
+
+	ns_xfrcache_add(sctx->xfrcache, &key, builder_render, builder_free, b,
+			&xfr->cache);
+	return;
+
+failure:
+	if (soa_stream != NULL) {
+		soa_stream->methods->destroy(&soa_stream);
+	}
+	if (data_stream != NULL) {
+		data_stream->methods->destroy(&data_stream);
+	}
+	builder_free(b);
+}
+
 /*
  * Arrange to send as much as we can of "stream" without blocking.
  *
@@ -1371,15 +1810,9 @@ sendstream(xfrout_ctx_t *xfr) {
 	dns_message_t *tcpmsg = NULL;
 	dns_message_t *msg = NULL; /* Client message if UDP, tcpmsg if TCP */
 	isc_result_t result;
-	dns_rdataset_t *qrdataset;
-	dns_name_t *msgname = NULL;
-	dns_rdata_t *msgrdata = NULL;
-	dns_rdatalist_t *msgrdl = NULL;
-	dns_rdataset_t *msgrds = NULL;
-	dns_compress_t cctx;
-	bool cleanup_cctx = false;
+	const ns_xfrmsg_t *cachemsg = NULL;
 	bool is_tcp;
-	int n_rrs;
+	unsigned int n_rrs = 0, size = 0;
 
 	isc_buffer_clear(&xfr->buf);
 	isc_buffer_clear(&xfr->txbuf);
@@ -1439,6 +1872,31 @@ sendstream(xfrout_ctx_t *xfr) {
 		if (xfr->tsigkey != NULL) {
 			INSIST(msg->reserved != 0U);
 		}
+
+		/*
+		 * The cached messages only leave NS_XFRCACHE_RESERVE
+		 * bytes for the OPT and TSIG records.  The first message
+		 * has the largest ones, so if they don't fit, the whole
+		 * transfer is sent from our own stream.
+		 */
+		if (xfr->cache != NULL && msg->reserved > NS_XFRCACHE_RESERVE)
+		{
+			INSIST(xfr->cachemsg == NULL);
+			ns_xfrcacheentry_detach(&xfr->cache);
+		}
+		if (xfr->cache != NULL) {
+			CHECK(ns_xfrcache_next(xfr->cache, xfr->cachemsg,
+					       &cachemsg));
+			xfr->cachemsg = cachemsg;
+			if (cachemsg->question.length == 0) {
+				msg->tcp_continuation = 1;
+			}
+			xfr->question_added = true;
+			xfr->end_of_stream = cachemsg->last;
+			n_rrs = cachemsg->ancount;
+			goto render;
+		}
+
 		isc_buffer_add(&xfr->buf, msg->reserved);
 
 		/*
@@ -1447,32 +1905,8 @@ sendstream(xfrout_ctx_t *xfr) {
 		 * have a question section.
 		 */
 		if (!xfr->question_added) {
-			dns_name_t *qname = NULL;
-			isc_region_t r;
-
-			/*
-			 * Reserve space for the 12-byte message header
-			 * and 4 bytes of question.
-			 */
-			isc_buffer_add(&xfr->buf, 12 + 4);
-
-			qrdataset = NULL;
-			dns_message_gettemprdataset(msg, &qrdataset);
-			dns_rdataset_makequestion(qrdataset,
-						  xfr->client->message->rdclass,
-						  xfr->qtype);
-
-			dns_message_gettempname(msg, &qname);
-			isc_buffer_availableregion(&xfr->buf, &r);
-			INSIST(r.length >= xfr->qname->length);
-			r.length = xfr->qname->length;
-			isc_buffer_putmem(&xfr->buf, xfr->qname->ndata,
-					  xfr->qname->length);
-			dns_name_fromregion(qname, &r);
-			ISC_LIST_INIT(qname->list);
-			ISC_LIST_APPEND(qname->list, qrdataset, link);
-
-			dns_message_addname(msg, qname, DNS_SECTION_QUESTION);
+			addquestion(msg, &xfr->buf, xfr->qname,
+				    xfr->client->message->rdclass, xfr->qtype);
 			xfr->question_added = true;
 		} else {
 			/*
@@ -1484,127 +1918,55 @@ sendstream(xfrout_ctx_t *xfr) {
 	}
 
 	/*
-	 * Try to fit in as many RRs as possible, unless "one-answer"
-	 * format has been requested.
+	 * Unparsed RRs are rendered straight into the message below.
 	 */
-	for (n_rrs = 0;; n_rrs++) {
-		dns_name_t *name = NULL;
-		uint32_t ttl;
-		dns_rdata_t *rdata = NULL;
-
-		unsigned int size;
-		isc_region_t r;
-
-		msgname = NULL;
-		msgrdata = NULL;
-		msgrdl = NULL;
-		msgrds = NULL;
+	if (!is_tcp || !xfr->rawrrs) {
+		result = addrrs(
+			xfr->stream, msg, &xfr->buf, xfr->many_answers, is_tcp,
+			xfr->client->manager->sctx->transfer_tcp_message_size,
+			&n_rrs, &xfr->end_of_stream, &size);
+		if (result == ISC_R_NOSPACE) {
+			xfrout_log(xfr, ISC_LOG_WARNING,
+				   "RR too large for zone transfer (%d bytes)",
+				   size);
+		}
+		CHECK(result);
+	}
 
-		xfr->stream->methods->current(xfr->stream, &name, &ttl, &rdata);
-		size = name->length + 10 + rdata->length;
-		isc_buffer_availableregion(&xfr->buf, &r);
-		if (size >= r.length) {
-			/*
-			 * RR would not fit.  If there are other RRs in the
-			 * buffer, send them now and leave this RR to the
-			 * next message.  If this RR overflows the buffer
-			 * all by itself, fail.
-			 *
-			 * In theory some RRs might fit in a TCP message
-			 * when compressed even if they do not fit when
-			 * uncompressed, but surely we don't want
-			 * to send such monstrosities to an unsuspecting
-			 * secondary.
-			 */
-			if (n_rrs == 0) {
+render:
+	if (is_tcp) {
+		dns_compress_reset(&xfr->cctx);
+		CHECK(dns_message_renderbegin(msg, &xfr->cctx, &xfr->txbuf));
+		if (cachemsg != NULL) {
+			CHECK(dns_message_renderwire(
+				msg, DNS_SECTION_QUESTION, &cachemsg->question,
+				(cachemsg->question.length != 0) ? 1 : 0));
+			CHECK(dns_message_renderwire(msg, DNS_SECTION_ANSWER,
+						     &cachemsg->answer,
+						     cachemsg->ancount));
+		} else if (xfr->rawrrs) {
+			CHECK(dns_message_rendersection(
+				msg, DNS_SECTION_QUESTION, 0));
+			result = addrawrrs(
+				xfr->stream, msg, xfr->many_answers,
+				xfr->client->manager->sctx
+					->transfer_tcp_message_size,
+				&n_rrs, &xfr->end_of_stream, &size);
+			if (result == ISC_R_NOSPACE) {
 				xfrout_log(xfr, ISC_LOG_WARNING,
 					   "RR too large for zone transfer "
 					   "(%d bytes)",
 					   size);
-				/* XXX DNS_R_RRTOOLARGE? */
-				result = ISC_R_NOSPACE;
-				goto failure;
 			}
-			break;
-		}
-
-		if (isc_log_wouldlog(XFROUT_RR_LOGLEVEL)) {
-			log_rr(name, rdata, ttl); /* XXX */
-		}
-
-		dns_message_gettempname(msg, &msgname);
-		isc_buffer_availableregion(&xfr->buf, &r);
-		INSIST(r.length >= name->length);
-		r.length = name->length;
-		isc_buffer_putmem(&xfr->buf, name->ndata, name->length);
-		dns_name_fromregion(msgname, &r);
-
-		/* Reserve space for RR header. */
-		isc_buffer_add(&xfr->buf, 10);
-
-		dns_message_gettemprdata(msg, &msgrdata);
-		isc_buffer_availableregion(&xfr->buf, &r);
-		r.length = rdata->length;
-		isc_buffer_putmem(&xfr->buf, rdata->data, rdata->length);
-		dns_rdata_init(msgrdata);
-		dns_rdata_fromregion(msgrdata, rdata->rdclass, rdata->type, &r);
-
-		dns_message_gettemprdatalist(msg, &msgrdl);
-		msgrdl->type = rdata->type;
-		msgrdl->rdclass = rdata->rdclass;
-		msgrdl->ttl = ttl;
-		if (rdata->type == dns_rdatatype_sig ||
-		    rdata->type == dns_rdatatype_rrsig)
-		{
-			msgrdl->covers = dns_rdata_covers(rdata);
+			CHECK(result);
 		} else {
-			msgrdl->covers = dns_rdatatype_none;
-		}
-		ISC_LIST_APPEND(msgrdl->rdata, msgrdata, link);
-
-		dns_message_gettemprdataset(msg, &msgrds);
-		dns_rdatalist_tordataset(msgrdl, msgrds);
-
-		ISC_LIST_APPEND(msgname->list, msgrds, link);
-
-		dns_message_addname(msg, msgname, DNS_SECTION_ANSWER);
-		msgname = NULL;
-
-		xfr->stats.nrecs++;
-
-		result = xfr->stream->methods->next(xfr->stream);
-		if (result == ISC_R_NOMORE) {
-			xfr->end_of_stream = true;
-			break;
+			CHECK(dns_message_rendersection(
+				msg, DNS_SECTION_QUESTION, 0));
+			CHECK(dns_message_rendersection(msg, DNS_SECTION_ANSWER,
+							0));
 		}
-		CHECK(result);
-
-		if (!xfr->many_answers) {
-			break;
-		}
-		/*
-		 * At this stage, at least 1 RR has been rendered into
-		 * the message. Check if we want to clamp this message
-		 * here (TCP only).
-		 */
-		if ((isc_buffer_usedlength(&xfr->buf) >=
-		     xfr->client->manager->sctx->transfer_tcp_message_size) &&
-		    is_tcp)
-		{
-			break;
-		}
-	}
-
-	if (is_tcp) {
-		dns_compress_init(&cctx, xfr->mctx,
-				  DNS_COMPRESS_CASE | DNS_COMPRESS_LARGE);
-		cleanup_cctx = true;
-		CHECK(dns_message_renderbegin(msg, &cctx, &xfr->txbuf));
-		CHECK(dns_message_rendersection(msg, DNS_SECTION_QUESTION, 0));
-		CHECK(dns_message_rendersection(msg, DNS_SECTION_ANSWER, 0));
 		CHECK(dns_message_renderend(msg));
-		dns_compress_invalidate(&cctx);
-		cleanup_cctx = false;
+		xfr->stats.nrecs += n_rrs;
 
 		xfrout_log(xfr, ISC_LOG_DEBUG(8),
 			   "sending TCP message of %d bytes",
@@ -1612,6 +1974,7 @@ sendstream(xfrout_ctx_t *xfr) {
 
 		xfrout_enqueue_send(xfr);
 	} else {
+		xfr->stats.nrecs += n_rrs;
 		xfrout_log(xfr, ISC_LOG_DEBUG(8), "sending IXFR UDP response");
 
 		xfrout_enqueue_send(xfr);
@@ -1626,9 +1989,6 @@ failure:
 		dns_message_detach(&tcpmsg);
 	}
 
-	if (cleanup_cctx) {
-		dns_compress_invalidate(&cctx);
-	}
 	/*
 	 * Make sure to release any locks held by database
 	 * iterators before returning from the event handler.
@@ -1658,12 +2018,16 @@ xfrout_ctx_destroy(xfrout_ctx_t **xfrp) {
 	if (xfr->stream != NULL) {
 		xfr->stream->methods->destroy(&xfr->stream);
 	}
+	if (xfr->cache != NULL) {
+		ns_xfrcacheentry_detach(&xfr->cache);
+	}
 	if (xfr->buf.base != NULL) {
 		isc_mem_put(xfr->mctx, xfr->buf.base, xfr->buf.length);
 	}
 	if (xfr->txmem != NULL) {
 		isc_mem_put(xfr->mctx, xfr->txmem, xfr->txmemlen);
 	}
+	dns_compress_invalidate(&xfr->cctx);
 	if (xfr->lasttsig != NULL) {
 		isc_buffer_free(&xfr->lasttsig);
 	}
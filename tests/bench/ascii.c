@@ -168,6 +168,24 @@ diff:
 	return;
 }
 
+static int order_result;
+
+static void
+cmp_orderchunks(void *va, void *vb, unsigned int size) {
+	uint8_t *a = va, *b = vb;
+
+	while (size >= chunk_size) {
+		order_result = isc_ascii_lowercmp(a, b, chunk_size);
+		if (order_result != 0) {
+			return;
+		}
+		size -= chunk_size;
+		a += chunk_size;
+		b += chunk_size;
+	}
+	order_result = isc_ascii_lowercmp(a, b, size);
+}
+
 static void
 cmp_oldchunks(void *va, void *vb, unsigned int size) {
 	uint8_t *a = va, *b = vb;
@@ -211,7 +229,7 @@ main(void) {
 	time_it(cmp_swar, toupper_dest, tolower8_dest, "swar");
 	printf("-> %s\n", swar_result ? "same" : "WAT");
 
-	for (chunk_size = 3; chunk_size <= 15; chunk_size += 2) {
+	for (chunk_size = 1; chunk_size <= 15; chunk_size++) {
 		time_it(cmp_chunks1, toupper_dest, raw_dest, "chunks1");
 		printf("%u -> %s\n", chunk_size, chunk_result ? "same" : "WAT");
 		time_it(cmp_chunks8, toupper_dest, raw_dest, "chunks8");
@@ -219,5 +237,8 @@ main(void) {
 		time_it(cmp_oldchunks, toupper_dest, raw_dest, "oldchunks");
 		printf("%u -> %s\n", chunk_size,
 		       oldskool_result ? "same" : "WAT");
+		time_it(cmp_orderchunks, toupper_dest, raw_dest, "order");
+		printf("%u -> %s\n", chunk_size,
+		       order_result == 0 ? "same" : "WAT");
 	}
 }
@@ -0,0 +1,316 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Measure how the shared synchronization primitives scale with the
+ * number of loops, with every loop hammering the same object: a
+ * reader-writer lock and a per-loop reader lock (isc_brlock) taken for
+ * reading and writing, statistics counters
+ * incremented from every loop, and a quota acquired and released in
+ * bursts.  The counters and the quota are measured both shared and
+ * split per loop.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <isc/async.h>
+#include <isc/brlock.h>
+#include <isc/loop.h>
+#include <isc/mem.h>
+#include <isc/os.h>
+#include <isc/quota.h>
+#include <isc/result.h>
+#include <isc/rwlock.h>
+#include <isc/stats.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#define RUNTIME (1 * NS_PER_SEC)
+#define BATCH	1024
+
+/* Counters updated round-robin by the statistics tests */
+#define NCOUNTERS 4
+
+/* Units each loop holds at once in the quota tests */
+#define QUOTA_BURST 16
+
+struct bench_state;
+
+struct test {
+	const char *name;
+	void (*setup)(struct bench_state *bctx);
+	void (*batch)(struct bench_state *bctx);
+	void (*teardown)(struct bench_state *bctx);
+	/* One in 'writes' operations takes the lock for writing */
+	unsigned int writes;
+};
+
+struct bench_state {
+	isc_mem_t *mctx;
+	isc_loopmgr_t *loopmgr;
+	const struct test *test;
+	uint32_t nloops;
+	uint32_t done;
+	uint64_t ops;
+	isc_nanosecs_t elapsed;
+	isc_rwlock_t rwlock;
+	isc_brlock_t brlock;
+	uint64_t shared;
+	isc_stats_t *stats;
+	isc_quota_t quota;
+};
+
+struct thread_args {
+	struct bench_state *bctx;
+	uint64_t ops;
+	isc_nanosecs_t start;
+	isc_nanosecs_t stop;
+};
+
+static void
+rwlock_setup(struct bench_state *bctx) {
+	isc_rwlock_init(&bctx->rwlock);
+	bctx->shared = 0;
+}
+
+static void
+rwlock_batch(struct bench_state *bctx) {
+	unsigned int writes = bctx->test->writes;
+	uint64_t sum = 0;
+
+	for (unsigned int n = 0; n < BATCH; n++) {
+		if (writes != 0 && n % writes == 0) {
+			isc_rwlock_wrlock(&bctx->rwlock);
+			bctx->shared++;
+			isc_rwlock_wrunlock(&bctx->rwlock);
+		} else {
+			isc_rwlock_rdlock(&bctx->rwlock);
+			sum += bctx->shared;
+			isc_rwlock_rdunlock(&bctx->rwlock);
+		}
+	}
+
+	/* Keep the reads from being optimized away */
+	INSIST(sum != UINT64_MAX);
+}
+
+static void
+rwlock_teardown(struct bench_state *bctx) {
+	isc_rwlock_destroy(&bctx->rwlock);
+}
+
+static void
+brlock_setup(struct bench_state *bctx) {
+	isc_brlock_init(&bctx->brlock, bctx->mctx);
+	bctx->shared = 0;
+}
+
+static void
+brlock_batch(struct bench_state *bctx) {
+	unsigned int writes = bctx->test->writes;
+	uint64_t sum = 0;
+
+	for (unsigned int n = 0; n < BATCH; n++) {
+		if (writes != 0 && n % writes == 0) {
+			isc_brlock_wrlock(&bctx->brlock);
+			bctx->shared++;
+			isc_brlock_wrunlock(&bctx->brlock);
+		} else {
+			isc_brlock_rdlock(&bctx->brlock);
+			sum += bctx->shared;
+			isc_brlock_rdunlock(&bctx->brlock);
+		}
+	}
+
+	INSIST(sum != UINT64_MAX);
+}
+
+static void
+brlock_teardown(struct bench_state *bctx) {
+	isc_brlock_destroy(&bctx->brlock);
+}
+
+static void
+stats_setup(struct bench_state *bctx) {
+	isc_stats_create(bctx->mctx, &bctx->stats, NCOUNTERS);
+}
+
+static void
+stats_perloop_setup(struct bench_state *bctx) {
+	isc_stats_createperloop(bctx->mctx, &bctx->stats, NCOUNTERS);
+}
+
+static void
+stats_batch(struct bench_state *bctx) {
+	for (unsigned int n = 0; n < BATCH; n++) {
+		isc_stats_increment(bctx->stats, n % NCOUNTERS);
+	}
+}
+
+static void
+stats_teardown(struct bench_state *bctx) {
+	uint64_t total = 0;
+
+	for (unsigned int i = 0; i < NCOUNTERS; i++) {
+		total += isc_stats_get_counter(bctx->stats, i);
+	}
+	INSIST(total == bctx->ops);
+
+	isc_stats_detach(&bctx->stats);
+}
+
+static void
+quota_setup(struct bench_state *bctx) {
+	isc_quota_init(&bctx->quota, QUOTA_BURST * bctx->nloops);
+}
+
+static void
+quota_perloop_setup(struct bench_state *bctx) {
+	isc_quota_initperloop(&bctx->quota, bctx->mctx,
+			      QUOTA_BURST * bctx->nloops);
+}
+
+static void
+quota_batch(struct bench_state *bctx) {
+	for (unsigned int n = 0; n < BATCH; n += QUOTA_BURST) {
+		for (unsigned int i = 0; i < QUOTA_BURST; i++) {
+			isc_result_t result = isc_quota_acquire(&bctx->quota);
+			INSIST(result == ISC_R_SUCCESS);
+		}
+		for (unsigned int i = 0; i < QUOTA_BURST; i++) {
+			isc_quota_release(&bctx->quota);
+		}
+	}
+}
+
+static void
+quota_teardown(struct bench_state *bctx) {
+	INSIST(isc_quota_getused(&bctx->quota) == 0);
+	isc_quota_destroy(&bctx->quota);
+}
+
+static const struct test tests[] = {
+	{ "rwlock 100/0", rwlock_setup, rwlock_batch, rwlock_teardown, 0 },
+	{ "rwlock 99/1", rwlock_setup, rwlock_batch, rwlock_teardown, 100 },
+	{ "rwlock 90/10", rwlock_setup, rwlock_batch, rwlock_teardown, 10 },
+	{ "brlock 100/0", brlock_setup, brlock_batch, brlock_teardown, 0 },
+	{ "brlock 99/1", brlock_setup, brlock_batch, brlock_teardown, 100 },
+	{ "brlock 90/10", brlock_setup, brlock_batch, brlock_teardown, 10 },
+	{ "stats", stats_setup, stats_batch, stats_teardown, 0 },
+	{ "stats/loop", stats_perloop_setup, stats_batch, stats_teardown, 0 },
+	{ "quota", quota_setup, quota_batch, quota_teardown, 0 },
+	{ "quota/loop", quota_perloop_setup, quota_batch, quota_teardown, 0 },
+};
+
+static void
+collect(void *varg) {
+	struct thread_args *args = varg;
+	struct bench_state *bctx = args->bctx;
+
+	bctx->ops += args->ops;
+	bctx->elapsed += args->stop - args->start;
+	isc_mem_put(bctx->mctx, args, sizeof(*args));
+
+	if (++bctx->done < bctx->nloops) {
+		return;
+	}
+
+	printf("%-14s %3" PRIu32 " loops %12.0f ops/s %10.3f ops/us/loop\n",
+	       bctx->test->name, bctx->nloops,
+	       (double)bctx->ops * NS_PER_SEC /
+		       ((double)bctx->elapsed / bctx->nloops),
+	       (double)bctx->ops / ((double)bctx->elapsed / 1000.0));
+
+	bctx->test->teardown(bctx);
+	isc_loopmgr_shutdown(bctx->loopmgr);
+}
+
+static void
+hammer(void *varg) {
+	struct thread_args *args = varg;
+	struct bench_state *bctx = args->bctx;
+
+	args->start = isc_time_monotonic();
+	do {
+		bctx->test->batch(bctx);
+		args->ops += BATCH;
+		args->stop = isc_time_monotonic();
+	} while (args->stop - args->start < RUNTIME);
+
+	isc_async_run(isc_loop_main(bctx->loopmgr), collect, args);
+}
+
+static void
+startup(void *arg) {
+	struct bench_state *bctx = arg;
+
+	bctx->test->setup(bctx);
+
+	for (uint32_t t = 0; t < bctx->nloops; t++) {
+		struct thread_args *args = isc_mem_get(bctx->mctx,
+						       sizeof(*args));
+		*args = (struct thread_args){ .bctx = bctx };
+		isc_async_run(isc_loop_get(bctx->loopmgr, t), hammer, args);
+	}
+}
+
+static void
+run(isc_mem_t *mctx, uint32_t nloops, const struct test *test) {
+	struct bench_state bctx = {
+		.mctx = mctx,
+		.test = test,
+		.nloops = nloops,
+	};
+
+	/* As isc_managers_create() does */
+	isc_rwlock_setworkers(nloops);
+	isc_loopmgr_create(mctx, nloops, &bctx.loopmgr);
+	isc_loop_setup(isc_loop_main(bctx.loopmgr), startup, &bctx);
+	isc_loopmgr_run(bctx.loopmgr);
+	isc_loopmgr_destroy(&bctx.loopmgr);
+}
+
+int
+main(void) {
+	isc_mem_t *mctx = NULL;
+	uint32_t maxloops;
+	const char *env_workers = getenv("ISC_TASK_WORKERS");
+
+	setlinebuf(stdout);
+
+	if (env_workers != NULL) {
+		maxloops = atoi(env_workers);
+	} else {
+		maxloops = isc_os_ncpus();
+	}
+	INSIST(maxloops > 0);
+
+	isc_mem_create(&mctx);
+
+	for (size_t i = 0; i < ARRAY_SIZE(tests); i++) {
+		for (uint32_t nloops = 1; nloops <= maxloops; nloops *= 2) {
+			run(mctx, nloops, &tests[i]);
+		}
+		if ((maxloops & (maxloops - 1)) != 0) {
+			run(mctx, maxloops, &tests[i]);
+		}
+	}
+
+	isc_mem_destroy(&mctx);
+
+	return 0;
+}
@@ -0,0 +1,239 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Measure isc_hashmap at a range of load factors: a table of a fixed
+ * size is filled to each load factor, then timed for successful and
+ * unsuccessful lookups, and for a churn of deletions and additions.
+ * Finally, a table is grown from the smallest size, and the latency of
+ * every addition is recorded to show the cost of the incremental
+ * resizing.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <isc/commandline.h>
+#include <isc/hash.h>
+#include <isc/hashmap.h>
+#include <isc/histo.h>
+#include <isc/mem.h>
+#include <isc/random.h>
+#include <isc/result.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+/* Significant bits of the latency histogram, about two digits */
+#define LATENCY_SIGBITS 7
+
+#define TABLESIZE(bits) ((size_t)1 << (bits))
+
+struct item {
+	uint64_t key;
+	uint32_t hashval;
+};
+
+static const unsigned int loads[] = { 25, 50, 75, 85 };
+
+static void
+usage(void) {
+	fprintf(stderr, "usage: hashmap [-b bits] [-o ops]\n");
+	fprintf(stderr, "\t-b bits\tlog2 of the table size (default 20)\n");
+	fprintf(stderr,
+		"\t-o ops\toperations timed per test (default 4000000)\n");
+	exit(1);
+}
+
+static void
+CHECKRESULT(isc_result_t result, const char *msg) {
+	if (result != ISC_R_SUCCESS) {
+		fprintf(stderr, "%s: %s\n", msg, isc_result_totext(result));
+		exit(1);
+	}
+}
+
+static bool
+item_match(void *node, const void *key) {
+	const struct item *item = node;
+	return item->key == *(const uint64_t *)key;
+}
+
+static void
+item_init(struct item *item) {
+	item->key = (uint64_t)isc_random32() << 32 | isc_random32();
+	item->hashval = isc_hash32(&item->key, sizeof(item->key), true);
+}
+
+static void
+item_add(isc_hashmap_t *hashmap, struct item *item) {
+	isc_result_t result = isc_hashmap_add(hashmap, item->hashval,
+					      item_match, &item->key, item,
+					      NULL);
+	CHECKRESULT(result, "isc_hashmap_add");
+}
+
+static void
+item_delete(isc_hashmap_t *hashmap, struct item *item) {
+	isc_result_t result = isc_hashmap_delete(hashmap, item->hashval,
+						 item_match, &item->key);
+	CHECKRESULT(result, "isc_hashmap_delete");
+}
+
+static void
+report(const char *what, unsigned int load, size_t ops,
+       isc_nanosecs_t elapsed) {
+	printf("%3u%% %-12s %8.1f ns/op %10.0f ops/s\n", load, what,
+	       (double)elapsed / ops, (double)ops * NS_PER_SEC / elapsed);
+}
+
+static void
+fixed(isc_mem_t *mctx, uint8_t bits, size_t ops, unsigned int load,
+      struct item *items, struct item *misses, uint32_t *order) {
+	isc_hashmap_t *hashmap = NULL;
+	size_t count = (TABLESIZE(bits) * load) / 100;
+	isc_nanosecs_t start;
+	isc_result_t result;
+
+	isc_hashmap_create(mctx, bits, &hashmap);
+	for (size_t i = 0; i < count; i++) {
+		item_add(hashmap, &items[i]);
+	}
+
+	start = isc_time_monotonic();
+	for (size_t n = 0; n < ops; n++) {
+		struct item *item = &items[order[n] % count];
+		void *found = NULL;
+
+		result = isc_hashmap_find(hashmap, item->hashval, item_match,
+					  &item->key, &found);
+		INSIST(result == ISC_R_SUCCESS && found == item);
+	}
+	report("find hit", load, ops, isc_time_monotonic() - start);
+
+	start = isc_time_monotonic();
+	for (size_t n = 0; n < ops; n++) {
+		struct item *item = &misses[order[n] % count];
+
+		result = isc_hashmap_find(hashmap, item->hashval, item_match,
+					  &item->key, NULL);
+		INSIST(result == ISC_R_NOTFOUND);
+	}
+	report("find miss", load, ops, isc_time_monotonic() - start);
+
+	/* Each operation is a deletion followed by an addition */
+	start = isc_time_monotonic();
+	for (size_t n = 0; n < ops; n++) {
+		struct item *item = &items[order[n] % count];
+
+		item_delete(hashmap, item);
+		item_add(hashmap, item);
+	}
+	report("delete+add", load, ops, isc_time_monotonic() - start);
+
+	INSIST(isc_hashmap_count(hashmap) == count);
+	isc_hashmap_destroy(&hashmap);
+}
+
+static void
+growing(isc_mem_t *mctx, size_t count, struct item *items) {
+	static const double fractions[] = { 1.0, 0.999, 0.99, 0.5 };
+	uint64_t values[ARRAY_SIZE(fractions)];
+	isc_hashmap_t *hashmap = NULL;
+	isc_histo_t *latency = NULL;
+	isc_nanosecs_t start, elapsed;
+	isc_result_t result;
+
+	isc_histo_create(mctx, LATENCY_SIGBITS, &latency);
+	isc_hashmap_create(mctx, 1, &hashmap);
+
+	start = isc_time_monotonic();
+	for (size_t i = 0; i < count; i++) {
+		isc_nanosecs_t before = isc_time_monotonic();
+		item_add(hashmap, &items[i]);
+		isc_histo_inc(latency, isc_time_monotonic() - before);
+	}
+	elapsed = isc_time_monotonic() - start;
+
+	result = isc_histo_quantiles(latency, ARRAY_SIZE(fractions), fractions,
+				     values);
+	CHECKRESULT(result, "isc_histo_quantiles");
+
+	printf("grow %zu: %8.1f ns/add; 50%% %" PRIu64 " 99%% %" PRIu64
+	       " 99.9%% %" PRIu64 " max %" PRIu64 " ns\n",
+	       count, (double)elapsed / count, values[3], values[2], values[1],
+	       values[0]);
+
+	isc_hashmap_destroy(&hashmap);
+	isc_histo_destroy(&latency);
+}
+
+int
+main(int argc, char **argv) {
+	isc_mem_t *mctx = NULL;
+	struct item *items = NULL, *misses = NULL;
+	uint32_t *order = NULL;
+	unsigned int bits = 20;
+	size_t ops = 4000000;
+	size_t size;
+	int ch;
+
+	while ((ch = isc_commandline_parse(argc, argv, "b:o:")) != -1) {
+		switch (ch) {
+		case 'b':
+			bits = strtoul(isc_commandline_argument, NULL, 10);
+			break;
+		case 'o':
+			ops = strtoul(isc_commandline_argument, NULL, 10);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (bits < 8 || bits > 28 || ops == 0) {
+		usage();
+	}
+
+	setlinebuf(stdout);
+
+	isc_mem_create(&mctx);
+
+	size = TABLESIZE(bits);
+	items = isc_mem_cget(mctx, size, sizeof(items[0]));
+	misses = isc_mem_cget(mctx, size, sizeof(misses[0]));
+	order = isc_mem_cget(mctx, ops, sizeof(order[0]));
+
+	for (size_t i = 0; i < size; i++) {
+		item_init(&items[i]);
+		item_init(&misses[i]);
+	}
+	for (size_t n = 0; n < ops; n++) {
+		order[n] = isc_random32();
+	}
+
+	printf("table of %zu slots, %zu operations per test\n", size, ops);
+	for (size_t i = 0; i < ARRAY_SIZE(loads); i++) {
+		fixed(mctx, bits, ops, loads[i], items, misses, order);
+	}
+
+	growing(mctx, size, items);
+
+	isc_mem_cput(mctx, order, ops, sizeof(order[0]));
+	isc_mem_cput(mctx, misses, size, sizeof(misses[0]));
+	isc_mem_cput(mctx, items, size, sizeof(items[0]));
+	isc_mem_destroy(&mctx);
+
+	return 0;
+}
@@ -79,6 +79,44 @@ const dns_qpmethods_t qpmethods = {
 	testname,
 };
 
+/*
+ * The key conversion done by dns_qpkey_fromname() without its vector
+ * code, to see how much difference that makes.
+ */
+static size_t
+qpkey_fromname_bytes(dns_qpkey_t key, const dns_name_t *name) {
+	size_t len = 0, label = name->labels;
+
+	while (label-- > 0) {
+		const uint8_t *ldata = name->ndata + name->offsets[label];
+		size_t label_len = *ldata++;
+		while (label_len-- > 0) {
+			uint16_t bits = dns_qp_bits_for_byte[*ldata++];
+			key[len++] = bits & 0xFF;
+			if ((bits >> 8) != 0) {
+				key[len++] = bits >> 8;
+			}
+		}
+		key[len++] = SHIFT_NOBYTE;
+	}
+	key[len] = SHIFT_NOBYTE;
+	return len;
+}
+
+static size_t
+item_makekey_bytes(dns_qpkey_t key, void *ctx, void *pval, uint32_t ival) {
+	UNUSED(ctx);
+	assert(pval == &item[ival]);
+	return qpkey_fromname_bytes(key, &item[ival].fixed.name);
+}
+
+const dns_qpmethods_t qpmethods_bytes = {
+	item_check,
+	item_check,
+	item_makekey_bytes,
+	testname,
+};
+
 #define CHECK(count, result)                                        \
 	do {                                                        \
 		if (result != ISC_R_SUCCESS) {                      \
@@ -309,6 +347,13 @@ new_qp(isc_mem_t *mem) {
 	return qpmulti;
 }
 
+static void *
+new_qp_bytes(isc_mem_t *mem) {
+	dns_qpmulti_t *qpmulti = NULL;
+	dns_qpmulti_create(mem, &qpmethods_bytes, NULL, &qpmulti);
+	return qpmulti;
+}
+
 static isc_result_t
 add_qp(void *qp, size_t count) {
 	isc_result_t result = dns_qp_insert(qp, &item[count], count);
@@ -325,8 +370,15 @@ get_qp(void *qp, size_t count, void **pval) {
 	return dns_qp_getname(qp, &item[count].fixed.name, pval, NULL);
 }
 
+static isc_result_t
+get_qp_bytes(void *qp, size_t count, void **pval) {
+	dns_qpkey_t key;
+	size_t keylen = qpkey_fromname_bytes(key, &item[count].fixed.name);
+	return dns_qp_getkey(qp, key, keylen, pval, NULL);
+}
+
 static void *
-_thread_qp(void *arg0, bool sqz, bool brr) {
+_thread_qp(void *arg0, bool sqz, bool brr, bool bytes) {
 	struct thread_s *arg = arg0;
 
 	isc_barrier_wait(&barrier);
@@ -354,7 +406,8 @@ _thread_qp(void *arg0, bool sqz, bool brr) {
 
 	for (size_t n = arg->start; n < arg->end; n++) {
 		void *pval = NULL;
-		isc_result_t result = get_qp(&qpr, n, &pval);
+		isc_result_t result = bytes ? get_qp_bytes(&qpr, n, &pval)
+					    : get_qp(&qpr, n, &pval);
 		CHECK(n, result);
 		assert(pval == &item[n]);
 	}
@@ -371,17 +424,22 @@ _thread_qp(void *arg0, bool sqz, bool brr) {
 
 static void *
 thread_qp(void *arg0) {
-	return _thread_qp(arg0, true, false);
+	return _thread_qp(arg0, true, false, false);
 }
 
 static void *
 thread_qp_nosqz(void *arg0) {
-	return _thread_qp(arg0, false, false);
+	return _thread_qp(arg0, false, false, false);
 }
 
 static void *
 thread_qp_brr(void *arg0) {
-	return _thread_qp(arg0, true, true);
+	return _thread_qp(arg0, true, true, false);
+}
+
+static void *
+thread_qp_bytes(void *arg0) {
+	return _thread_qp(arg0, true, false, true);
 }
 
 /*
@@ -394,6 +452,7 @@ static struct fun fun_list[] = {
 	{ "qp", new_qp, thread_qp },
 	{ "qp+nosqz", new_qp, thread_qp_nosqz },
 	{ "qp+barrier", new_qp, thread_qp_brr },
+	{ "qp+bytes", new_qp_bytes, thread_qp_bytes },
 	{ NULL, NULL, NULL },
 };
 
@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Compare the time taken to decode the PROXYv2 header of a UDP datagram
+ * with isc_proxy2_header_handle_directly() and with a handler, as done
+ * on streams.  The header carries IPv4 or IPv6 addresses and, optionally,
+ * a TLV, which is not decoded on the fast path.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <arpa/inet.h>
+
+#include <isc/buffer.h>
+#include <isc/mem.h>
+#include <isc/proxy2.h>
+#include <isc/result.h>
+#include <isc/sockaddr.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#define ITERATIONS ((uint32_t)10000000)
+
+static uint8_t payload[512];
+
+static void
+header_cb(const isc_result_t result, const isc_proxy2_command_t cmd,
+	  const int socktype, const isc_sockaddr_t *restrict src_addr,
+	  const isc_sockaddr_t *restrict dst_addr,
+	  const isc_region_t *restrict tlvs, const isc_region_t *restrict extra,
+	  void *cbarg) {
+	size_t *sum = cbarg;
+
+	UNUSED(cmd);
+	UNUSED(socktype);
+	UNUSED(dst_addr);
+	UNUSED(tlvs);
+
+	if (result != ISC_R_SUCCESS) {
+		printf("header: %s\n", isc_result_totext(result));
+		exit(EXIT_FAILURE);
+	}
+
+	*sum += isc_sockaddr_getport(src_addr) + extra->length;
+}
+
+static void
+parse(isc_sockaddr_t *addr, const char *str, in_port_t port) {
+	struct in_addr in4;
+	struct in6_addr in6;
+
+	if (inet_pton(AF_INET, str, &in4) == 1) {
+		isc_sockaddr_fromin(addr, &in4, port);
+	} else if (inet_pton(AF_INET6, str, &in6) == 1) {
+		isc_sockaddr_fromin6(addr, &in6, port);
+	} else {
+		UNREACHABLE();
+	}
+}
+
+static void
+make_datagram(isc_buffer_t *buf, const char *src, const char *dst,
+	      bool tlv) {
+	isc_sockaddr_t src_addr, dst_addr;
+	isc_result_t result;
+
+	parse(&src_addr, src, 5300);
+	parse(&dst_addr, dst, 53);
+
+	result = isc_proxy2_make_header(buf, ISC_PROXY2_CMD_PROXY, SOCK_DGRAM,
+					&src_addr, &dst_addr, NULL);
+	INSIST(result == ISC_R_SUCCESS);
+	if (tlv) {
+		result = isc_proxy2_header_append_tlv_string(
+			buf, ISC_PROXY2_TLV_TYPE_AUTHORITY, "example.com");
+		INSIST(result == ISC_R_SUCCESS);
+	}
+	isc_buffer_putmem(buf, payload, sizeof(payload));
+}
+
+static void
+bench(isc_mem_t *mctx, const char *name, const char *src, const char *dst,
+      bool tlv) {
+	uint8_t data[1024];
+	isc_buffer_t buf;
+	isc_region_t region;
+	isc_proxy2_handler_t *handler = NULL;
+	isc_nanosecs_t start, stop;
+	size_t sum = 0;
+
+	isc_buffer_init(&buf, data, sizeof(data));
+	make_datagram(&buf, src, dst, tlv);
+	isc_buffer_usedregion(&buf, &region);
+
+	start = isc_time_monotonic();
+	for (uint32_t i = 0; i < ITERATIONS; i++) {
+		(void)isc_proxy2_header_handle_directly(&region, header_cb,
+							&sum);
+	}
+	stop = isc_time_monotonic();
+	printf("%-10s direct  %8.2f ns\n", name,
+	       (double)(stop - start) / ITERATIONS);
+
+	handler = isc_proxy2_handler_new(mctx, 0, header_cb, &sum);
+	start = isc_time_monotonic();
+	for (uint32_t i = 0; i < ITERATIONS; i++) {
+		isc_proxy2_handler_clear(handler);
+		(void)isc_proxy2_handler_push(handler, &region);
+	}
+	stop = isc_time_monotonic();
+	printf("%-10s handler %8.2f ns\n", name,
+	       (double)(stop - start) / ITERATIONS);
+	isc_proxy2_handler_free(&handler);
+
+	INSIST(sum != 0);
+}
+
+int
+main(void) {
+	isc_mem_t *mctx = NULL;
+
+	isc_mem_create(&mctx);
+
+	bench(mctx, "ipv4", "192.0.2.1", "198.51.100.1", false);
+	bench(mctx, "ipv6", "2001:db8::1", "2001:db8::53", false);
+	bench(mctx, "ipv4+tlv", "192.0.2.1", "198.51.100.1", true);
+
+	isc_mem_destroy(&mctx);
+
+	return 0;
+}
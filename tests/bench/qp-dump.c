@@ -185,6 +185,7 @@ main(int argc, char *argv[]) {
 	filetext[filesize] = '\0';
 
 	dns_qp_create(mctx, &methods, NULL, &qp);
+	dns_qp_sethugepages(qp);
 
 	pos = filetext;
 	file_end = pos + filesize;
@@ -244,10 +245,13 @@ main(int argc, char *argv[]) {
 		       "  free %zu\n"
 		       "   cow %zu\n"
 		       "chunks %zu\n"
-		       " bytes %zu\n",
+		       "regions %zu\n"
+		       " bytes %zu\n"
+		       " huge %zu\n",
 		       memusage.leaves, memusage.live, memusage.used,
 		       memusage.free, memusage.hold, memusage.chunk_count,
-		       memusage.bytes);
+		       memusage.region_count, memusage.bytes,
+		       memusage.hugepage_bytes);
 
 		printf("%f compaction\n", (double)compaction_us / 1000000);
 		printf("%f recovery\n", (double)recovery_us / 1000000);
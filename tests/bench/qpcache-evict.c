@@ -0,0 +1,566 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Measure the eviction from a cache that is smaller than its working
+ * set, with each eviction policy.  Every loop looks up names drawn from
+ * a Zipf distribution and adds the RRsets that it misses, much as the
+ * resolver does, while the cache is limited to the max-cache-size given
+ * with -m.  The RRsets have the shapes of a typical resolver cache: a few
+ * addresses, name servers, aliases, mail exchangers and text records.
+ *
+ * The report gives the hit ratio, the memory used per cached node, the
+ * latency of the lookups, and the latency of the additions by the memory
+ * pressure at the time, which is when they purge the cache to make room.
+ */
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <isc/async.h>
+#include <isc/buffer.h>
+#include <isc/commandline.h>
+#include <isc/histo.h>
+#include <isc/loop.h>
+#include <isc/mem.h>
+#include <isc/os.h>
+#include <isc/random.h>
+#include <isc/result.h>
+#include <isc/stdtime.h>
+#include <isc/time.h>
+#include <isc/urcu.h>
+#include <isc/util.h>
+
+#include <dns/db.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+
+#include "qpcache_p.h"
+
+/* Significant bits of the latency histograms, about two digits */
+#define LATENCY_SIGBITS 7
+
+/* The most rdatas in an RRset, and the space for all of them */
+#define MAX_RDATAS 4
+#define RDATA_SIZE 1024
+
+#define TTL 3600
+
+/* Additions by the memory pressure of the cache when they were made */
+enum {
+	PRESSURE_NONE,
+	PRESSURE_PARTIAL,
+	PRESSURE_FULL,
+	PRESSURE_LEVELS
+};
+
+static const char *pressure_names[PRESSURE_LEVELS] = {
+	"no pressure",
+	"partial pressure",
+	"overmem",
+};
+
+struct bench_state {
+	isc_loopmgr_t *loopmgr;
+	isc_mem_t *cmctx;
+	isc_mem_t *hmctx;
+	dns_db_t *db;
+	const char *policy;
+	uint32_t nloops;
+	uint32_t done;
+	isc_nanosecs_t start;
+	uint64_t lookups;
+	uint64_t hits;
+	isc_histo_t *latency;
+	isc_histo_t *adds[PRESSURE_LEVELS];
+};
+
+struct thread_args {
+	struct bench_state *bctx;
+	uint64_t lookups;
+	uint64_t hits;
+	isc_histo_t *latency;
+	isc_histo_t *adds[PRESSURE_LEVELS];
+};
+
+static isc_mem_t *mctx = NULL;
+
+static uint32_t nnames = 1000000;
+static uint64_t nlookups = 4000000;
+static size_t cachesize = 32;
+static double exponent = 0.9;
+
+static double *zipf = NULL;
+
+static void
+CHECKRESULT(isc_result_t result, const char *msg) {
+	if (result != ISC_R_SUCCESS) {
+		printf("%s: %s\n", msg, isc_result_totext(result));
+		exit(EXIT_FAILURE);
+	}
+}
+
+/*
+ * Cumulative weights of the names: name 'k' is looked up in proportion
+ * to 1 / (k + 1) ^ exponent.
+ */
+static void
+generate_zipf(void) {
+	double sum = 0.0;
+
+	zipf = isc_mem_cget(mctx, nnames, sizeof(zipf[0]));
+	for (uint32_t k = 0; k < nnames; k++) {
+		sum += 1.0 / pow((double)k + 1.0, exponent);
+		zipf[k] = sum;
+	}
+}
+
+static uint32_t
+zipf_rank(void) {
+	double u = (double)isc_random32() / UINT32_MAX * zipf[nnames - 1];
+	uint32_t lo = 0, hi = nnames - 1;
+
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+		if (zipf[mid] < u) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+/*
+ * The shape of the RRset of name 'k' depends only on 'k', so that a
+ * name that is evicted and added again is the same size as before.
+ */
+static uint32_t
+shape(uint32_t k) {
+	return k * UINT32_C(2654435761);
+}
+
+static dns_rdatatype_t
+nametype(uint32_t k) {
+	uint32_t percent = shape(k) % 100;
+
+	if (percent < 50) {
+		return dns_rdatatype_a;
+	} else if (percent < 75) {
+		return dns_rdatatype_aaaa;
+	} else if (percent < 83) {
+		return dns_rdatatype_ns;
+	} else if (percent < 91) {
+		return dns_rdatatype_cname;
+	} else if (percent < 96) {
+		return dns_rdatatype_txt;
+	} else {
+		return dns_rdatatype_mx;
+	}
+}
+
+static void
+makename(uint32_t k, dns_name_t *name) {
+	char text[DNS_NAME_FORMATSIZE];
+	isc_result_t result;
+
+	snprintf(text, sizeof(text), "n%" PRIu32 ".d%" PRIu32 ".example.", k,
+		 k % 10000);
+	result = dns_name_fromstring(name, text, dns_rootname, 0, NULL);
+	CHECKRESULT(result, "dns_name_fromstring");
+}
+
+static void
+putname(isc_buffer_t *buffer, const char *text) {
+	dns_fixedname_t fixed;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	isc_region_t r;
+	isc_result_t result;
+
+	result = dns_name_fromstring(name, text, dns_rootname, 0, NULL);
+	CHECKRESULT(result, "dns_name_fromstring");
+	dns_name_toregion(name, &r);
+	isc_buffer_putmem(buffer, r.base, r.length);
+}
+
+/*
+ * Fill 'rdatalist' with the RRset of name 'k', using 'rdata' and
+ * 'space' for its records.
+ */
+static void
+makerdataset(uint32_t k, dns_rdatalist_t *rdatalist,
+	     dns_rdata_t rdata[MAX_RDATAS], unsigned char *space) {
+	uint32_t bits = shape(k) >> 8;
+	dns_rdatatype_t type = nametype(k);
+	isc_buffer_t buffer;
+	unsigned int count = 1;
+	char text[DNS_NAME_FORMATSIZE];
+
+	switch (type) {
+	case dns_rdatatype_a:
+		count = 1 + bits % 4;
+		break;
+	case dns_rdatatype_aaaa:
+		count = 1 + bits % 2;
+		break;
+	case dns_rdatatype_ns:
+		count = 2 + bits % 3;
+		break;
+	case dns_rdatatype_txt:
+	case dns_rdatatype_mx:
+		count = 1 + bits % 3;
+		break;
+	default:
+		break;
+	}
+
+	dns_rdatalist_init(rdatalist);
+	rdatalist->rdclass = dns_rdataclass_in;
+	rdatalist->type = type;
+	rdatalist->ttl = TTL;
+
+	isc_buffer_init(&buffer, space, RDATA_SIZE);
+	for (unsigned int i = 0; i < count; i++) {
+		unsigned int start = isc_buffer_usedlength(&buffer);
+		isc_region_t region;
+
+		switch (type) {
+		case dns_rdatatype_a:
+			isc_buffer_putuint32(&buffer, 0xc0000200 + i);
+			break;
+		case dns_rdatatype_aaaa:
+			isc_buffer_putuint32(&buffer, 0x20010db8);
+			isc_buffer_putuint32(&buffer, 0);
+			isc_buffer_putuint32(&buffer, k);
+			isc_buffer_putuint32(&buffer, i);
+			break;
+		case dns_rdatatype_ns:
+			snprintf(text, sizeof(text),
+				 "ns%u.d%" PRIu32 ".example.", i, k % 10000);
+			putname(&buffer, text);
+			break;
+		case dns_rdatatype_cname:
+			snprintf(text, sizeof(text),
+				 "n%" PRIu32 ".cdn%" PRIu32 ".example.net.", k,
+				 k % 1000);
+			putname(&buffer, text);
+			break;
+		case dns_rdatatype_txt: {
+			/* Strings of 20 to 200 octets */
+			unsigned int length = 20 + (bits >> (4 * i)) % 181;
+			isc_buffer_putuint8(&buffer, length);
+			for (unsigned int n = 0; n < length; n++) {
+				isc_buffer_putuint8(&buffer, 'a' + n % 26);
+			}
+			break;
+		}
+		case dns_rdatatype_mx:
+			isc_buffer_putuint16(&buffer, 10 * i);
+			snprintf(text, sizeof(text),
+				 "mx%u.d%" PRIu32 ".example.", i, k % 10000);
+			putname(&buffer, text);
+			break;
+		default:
+			UNREACHABLE();
+		}
+
+		region.base = space + start;
+		region.length = isc_buffer_usedlength(&buffer) - start;
+		dns_rdata_init(&rdata[i]);
+		dns_rdata_fromregion(&rdata[i], dns_rdataclass_in, type,
+				     &region);
+		ISC_LIST_APPEND(rdatalist->rdata, &rdata[i], link);
+	}
+}
+
+static unsigned int
+pressure_level(isc_mem_t *cmctx) {
+	unsigned int pressure = isc_mem_pressure(cmctx);
+
+	if (pressure == 0) {
+		return PRESSURE_NONE;
+	} else if (pressure < ISC_MEM_PRESSURE_MAX) {
+		return PRESSURE_PARTIAL;
+	} else {
+		return PRESSURE_FULL;
+	}
+}
+
+static void
+addname(struct thread_args *args, uint32_t k, const dns_name_t *name,
+	isc_stdtime_t now) {
+	struct bench_state *bctx = args->bctx;
+	dns_rdata_t rdata[MAX_RDATAS];
+	unsigned char space[RDATA_SIZE];
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset = DNS_RDATASET_INIT;
+	dns_dbnode_t *node = NULL;
+	unsigned int level;
+	isc_nanosecs_t start;
+	isc_result_t result;
+
+	makerdataset(k, &rdatalist, rdata, space);
+	dns_rdatalist_tordataset(&rdatalist, &rdataset);
+	rdataset.trust = dns_trust_answer;
+
+	result = dns_db_findnode(bctx->db, name, true, &node);
+	CHECKRESULT(result, "dns_db_findnode");
+
+	/* The addition purges the cache when there is memory pressure */
+	level = pressure_level(bctx->cmctx);
+	start = isc_time_monotonic();
+	result = dns_db_addrdataset(bctx->db, node, NULL, now, &rdataset, 0,
+				    NULL);
+	isc_histo_inc(args->adds[level], isc_time_monotonic() - start);
+	if (result != DNS_R_UNCHANGED) {
+		CHECKRESULT(result, "dns_db_addrdataset");
+	}
+
+	dns_db_detachnode(bctx->db, &node);
+	dns_rdataset_disassociate(&rdataset);
+}
+
+static void
+printquantiles(const char *what, const isc_histo_t *hg) {
+	static const double fractions[] = { 0.99, 0.9, 0.5 };
+	uint64_t values[ARRAY_SIZE(fractions)];
+	double count = 0.0;
+	isc_result_t result;
+
+	isc_histo_moments(hg, &count, NULL, NULL);
+	if (count == 0.0) {
+		printf("  %-30s %10s\n", what, "none");
+		return;
+	}
+
+	result = isc_histo_quantiles(hg, ARRAY_SIZE(fractions), fractions,
+				     values);
+	CHECKRESULT(result, "isc_histo_quantiles");
+	printf("  %-30s %10.0f 50%% %8.3f 90%% %8.3f 99%% %8.3f us\n",
+	       what, count, (double)values[2] / NS_PER_US,
+	       (double)values[1] / NS_PER_US, (double)values[0] / NS_PER_US);
+}
+
+static void
+collect(void *varg) {
+	struct thread_args *args = varg;
+	struct bench_state *bctx = args->bctx;
+	isc_nanosecs_t elapsed;
+	size_t inuse, nodes;
+	char what[64];
+
+	bctx->lookups += args->lookups;
+	bctx->hits += args->hits;
+	isc_histo_merge(&bctx->latency, args->latency);
+	isc_histo_destroy(&args->latency);
+	for (unsigned int i = 0; i < PRESSURE_LEVELS; i++) {
+		isc_histo_merge(&bctx->adds[i], args->adds[i]);
+		isc_histo_destroy(&args->adds[i]);
+	}
+	isc_mem_put(mctx, args, sizeof(*args));
+
+	if (++bctx->done < bctx->nloops) {
+		return;
+	}
+
+	elapsed = isc_time_monotonic() - bctx->start;
+	inuse = isc_mem_inuse(bctx->cmctx) + isc_mem_inuse(bctx->hmctx);
+	nodes = ISC_MAX(dns_db_nodecount(bctx->db, dns_dbtree_main), 1);
+
+	printf("%s: %" PRIu32 " loops, %" PRIu64 " lookups in %.3f s, "
+	       "%.0f lookups/s\n",
+	       bctx->policy, bctx->nloops, bctx->lookups,
+	       (double)elapsed / NS_PER_SEC,
+	       (double)bctx->lookups * NS_PER_SEC / (double)elapsed);
+	printf("  hit ratio %.2f%%, %zu nodes, %.1f MB in use, "
+	       "%.1f bytes per node\n",
+	       100.0 * (double)bctx->hits / (double)bctx->lookups, nodes,
+	       (double)inuse / (1024 * 1024), (double)inuse / (double)nodes);
+
+	printquantiles("lookup", bctx->latency);
+	isc_histo_destroy(&bctx->latency);
+	for (unsigned int i = 0; i < PRESSURE_LEVELS; i++) {
+		snprintf(what, sizeof(what), "add, %s", pressure_names[i]);
+		printquantiles(what, bctx->adds[i]);
+		isc_histo_destroy(&bctx->adds[i]);
+	}
+
+	dns_db_detach(&bctx->db);
+	isc_loopmgr_shutdown(bctx->loopmgr);
+}
+
+static void
+lookups(void *varg) {
+	struct thread_args *args = varg;
+	struct bench_state *bctx = args->bctx;
+	isc_stdtime_t now = isc_stdtime_now();
+	uint64_t todo = nlookups / bctx->nloops;
+	dns_fixedname_t fname, ffound;
+	dns_name_t *name = dns_fixedname_initname(&fname);
+	dns_name_t *found = dns_fixedname_initname(&ffound);
+
+	for (uint64_t n = 0; n < todo; n++) {
+		uint32_t k = zipf_rank();
+		dns_rdataset_t rdataset = DNS_RDATASET_INIT;
+		isc_nanosecs_t start;
+		isc_result_t result;
+
+		makename(k, name);
+
+		start = isc_time_monotonic();
+		result = dns_db_find(bctx->db, name, NULL, nametype(k), 0, now,
+				     NULL, found, &rdataset, NULL);
+		isc_histo_inc(args->latency, isc_time_monotonic() - start);
+		if (dns_rdataset_isassociated(&rdataset)) {
+			dns_rdataset_disassociate(&rdataset);
+		}
+
+		args->lookups++;
+		if (result == ISC_R_SUCCESS) {
+			args->hits++;
+		} else {
+			addname(args, k, name, now);
+		}
+	}
+
+	isc_async_run(isc_loop_main(bctx->loopmgr), collect, args);
+}
+
+static void
+startup(void *arg) {
+	struct bench_state *bctx = arg;
+	char *argv[2] = { (char *)bctx->hmctx, NULL };
+	isc_result_t result;
+
+	if (strcmp(bctx->policy, "sieve") == 0) {
+		argv[1] = (char *)DNS_QPCACHE_SIEVE;
+	}
+
+	result = dns_db_create(bctx->cmctx, "qpcache", dns_rootname,
+			       dns_dbtype_cache, dns_rdataclass_in, 2, argv,
+			       &bctx->db);
+	CHECKRESULT(result, "dns_db_create");
+
+	isc_histo_create(mctx, LATENCY_SIGBITS, &bctx->latency);
+	for (unsigned int i = 0; i < PRESSURE_LEVELS; i++) {
+		isc_histo_create(mctx, LATENCY_SIGBITS, &bctx->adds[i]);
+	}
+
+	bctx->start = isc_time_monotonic();
+	for (uint32_t t = 0; t < bctx->nloops; t++) {
+		struct thread_args *args = isc_mem_get(mctx, sizeof(*args));
+		*args = (struct thread_args){ .bctx = bctx };
+		isc_histo_create(mctx, LATENCY_SIGBITS, &args->latency);
+		for (unsigned int i = 0; i < PRESSURE_LEVELS; i++) {
+			isc_histo_create(mctx, LATENCY_SIGBITS,
+					 &args->adds[i]);
+		}
+		isc_async_run(isc_loop_get(bctx->loopmgr, t), lookups, args);
+	}
+}
+
+static void
+run(uint32_t nloops, const char *policy) {
+	size_t size = cachesize * 1024 * 1024;
+	struct bench_state bctx = {
+		.policy = policy,
+		.nloops = nloops,
+	};
+
+	/* The cache memory limits are set as by dns_cache_setcachesize() */
+	isc_mem_create(&bctx.cmctx);
+	isc_mem_setname(bctx.cmctx, "cache");
+	isc_mem_create(&bctx.hmctx);
+	isc_mem_setname(bctx.hmctx, "cache_heap");
+	isc_mem_setwater(bctx.cmctx, size - (size >> 3), size - (size >> 2));
+
+	isc_loopmgr_create(mctx, nloops, &bctx.loopmgr);
+	isc_loop_setup(isc_loop_main(bctx.loopmgr), startup, &bctx);
+	isc_loopmgr_run(bctx.loopmgr);
+	isc_loopmgr_destroy(&bctx.loopmgr);
+
+	/* The cache is freed after an RCU grace period */
+	rcu_barrier();
+	isc_mem_destroy(&bctx.hmctx);
+	isc_mem_destroy(&bctx.cmctx);
+}
+
+static void
+usage(void) {
+	fprintf(stderr,
+		"usage: qpcache-evict [-l lookups] [-m megabytes] [-n names]"
+		" [-s exponent]\n"
+		"	-l	number of lookups (4000000)\n"
+		"	-m	max-cache-size in megabytes (32)\n"
+		"	-n	number of distinct names (1000000)\n"
+		"	-s	exponent of the Zipf distribution (0.9)\n");
+}
+
+int
+main(int argc, char **argv) {
+	uint32_t nloops;
+	const char *env_workers = getenv("ISC_TASK_WORKERS");
+	int opt;
+
+	setlinebuf(stdout);
+
+	while ((opt = isc_commandline_parse(argc, argv, "l:m:n:s:")) != -1) {
+		switch (opt) {
+		case 'l':
+			nlookups = strtoull(isc_commandline_argument, NULL, 10);
+			break;
+		case 'm':
+			cachesize = strtoul(isc_commandline_argument, NULL, 10);
+			break;
+		case 'n':
+			nnames = strtoul(isc_commandline_argument, NULL, 10);
+			break;
+		case 's':
+			exponent = strtod(isc_commandline_argument, NULL);
+			break;
+		default:
+			usage();
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (nnames == 0 || nlookups == 0 || cachesize == 0) {
+		usage();
+		exit(EXIT_FAILURE);
+	}
+
+	if (env_workers != NULL) {
+		nloops = atoi(env_workers);
+	} else {
+		nloops = isc_os_ncpus();
+	}
+	INSIST(nloops > 0);
+
+	isc_mem_create(&mctx);
+	generate_zipf();
+
+	run(nloops, "lru");
+	run(nloops, "sieve");
+
+	isc_mem_cput(mctx, zipf, nnames, sizeof(zipf[0]));
+	isc_mem_destroy(&mctx);
+
+	return 0;
+}
@@ -0,0 +1,236 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Compare the cache lookup throughput with and without the lock-free
+ * reads mode, with every loop looking up random names in a shared cache.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <isc/async.h>
+#include <isc/loop.h>
+#include <isc/mem.h>
+#include <isc/os.h>
+#include <isc/random.h>
+#include <isc/stdtime.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#include <dns/db.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+
+#include "qpcache_p.h"
+
+#define NAME_COUNT ((uint32_t)100000)
+#define RUNTIME	   (1 * NS_PER_SEC)
+#define BATCH	   1024
+
+struct bench_state {
+	isc_mem_t *mctx;
+	isc_loopmgr_t *loopmgr;
+	dns_db_t *db;
+	bool lockfree;
+	uint32_t nloops;
+	uint32_t done;
+	uint64_t lookups;
+	isc_nanosecs_t elapsed;
+};
+
+struct thread_args {
+	struct bench_state *bctx;
+	uint64_t lookups;
+	isc_nanosecs_t start;
+	isc_nanosecs_t stop;
+};
+
+static dns_fixedname_t *names = NULL;
+
+static void
+init_names(isc_mem_t *mctx) {
+	char buf[DNS_NAME_FORMATSIZE];
+
+	names = isc_mem_cget(mctx, NAME_COUNT, sizeof(names[0]));
+	for (uint32_t i = 0; i < NAME_COUNT; i++) {
+		dns_name_t *name = dns_fixedname_initname(&names[i]);
+		isc_result_t result;
+
+		snprintf(buf, sizeof(buf), "n%" PRIu32 ".example.", i);
+		result = dns_name_fromstring(name, buf, dns_rootname, 0, NULL);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	}
+}
+
+static void
+populate(dns_db_t *db) {
+	unsigned char addr[4] = { 192, 0, 2, 1 };
+	isc_stdtime_t now = isc_stdtime_now();
+
+	for (uint32_t i = 0; i < NAME_COUNT; i++) {
+		dns_rdata_t rdata = DNS_RDATA_INIT;
+		dns_rdatalist_t rdatalist;
+		dns_rdataset_t rdataset;
+		dns_dbnode_t *node = NULL;
+		isc_result_t result;
+
+		result = dns_db_findnode(db, dns_fixedname_name(&names[i]),
+					 true, &node);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+
+		rdata.data = addr;
+		rdata.length = sizeof(addr);
+		rdata.rdclass = dns_rdataclass_in;
+		rdata.type = dns_rdatatype_a;
+
+		dns_rdatalist_init(&rdatalist);
+		rdatalist.rdclass = dns_rdataclass_in;
+		rdatalist.type = dns_rdatatype_a;
+		rdatalist.ttl = 3600;
+		ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+
+		dns_rdataset_init(&rdataset);
+		dns_rdatalist_tordataset(&rdatalist, &rdataset);
+		rdataset.trust = dns_trust_answer;
+
+		result = dns_db_addrdataset(db, node, NULL, now, &rdataset, 0,
+					    NULL);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+
+		dns_db_detachnode(db, &node);
+	}
+}
+
+static void
+collect(void *varg) {
+	struct thread_args *args = varg;
+	struct bench_state *bctx = args->bctx;
+
+	bctx->lookups += args->lookups;
+	bctx->elapsed += args->stop - args->start;
+	isc_mem_put(bctx->mctx, args, sizeof(*args));
+
+	if (++bctx->done < bctx->nloops) {
+		return;
+	}
+
+	printf("%-10s %3" PRIu32 " loops %10.3f lookups/us/loop\n",
+	       bctx->lockfree ? "lock-free" : "locked", bctx->nloops,
+	       (double)bctx->lookups / ((double)bctx->elapsed / 1000.0));
+
+	dns_db_detach(&bctx->db);
+	isc_loopmgr_shutdown(bctx->loopmgr);
+}
+
+static void
+lookups(void *varg) {
+	struct thread_args *args = varg;
+	dns_db_t *db = args->bctx->db;
+	isc_stdtime_t now = isc_stdtime_now();
+	dns_fixedname_t ffound;
+	dns_name_t *found = dns_fixedname_initname(&ffound);
+
+	args->start = isc_time_monotonic();
+	do {
+		for (uint32_t n = 0; n < BATCH; n++) {
+			uint32_t i = isc_random_uniform(NAME_COUNT);
+			dns_rdataset_t rdataset = DNS_RDATASET_INIT;
+			isc_result_t result;
+
+			result = dns_db_find(db, dns_fixedname_name(&names[i]),
+					     NULL, dns_rdatatype_a, 0, now,
+					     NULL, found, &rdataset, NULL);
+			RUNTIME_CHECK(result == ISC_R_SUCCESS);
+			dns_rdataset_disassociate(&rdataset);
+		}
+		args->lookups += BATCH;
+		args->stop = isc_time_monotonic();
+	} while (args->stop - args->start < RUNTIME);
+
+	isc_async_run(isc_loop_main(args->bctx->loopmgr), collect, args);
+}
+
+static void
+startup(void *arg) {
+	struct bench_state *bctx = arg;
+	char *argv[2] = { (char *)bctx->mctx, NULL };
+	isc_result_t result;
+
+	if (bctx->lockfree) {
+		argv[1] = (char *)DNS_QPCACHE_LOCKFREE;
+	}
+
+	result = dns_db_create(bctx->mctx, "qpcache", dns_rootname,
+			       dns_dbtype_cache, dns_rdataclass_in, 2, argv,
+			       &bctx->db);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+
+	populate(bctx->db);
+
+	for (uint32_t t = 0; t < bctx->nloops; t++) {
+		struct thread_args *args = isc_mem_get(bctx->mctx,
+						       sizeof(*args));
+		*args = (struct thread_args){ .bctx = bctx };
+		isc_async_run(isc_loop_get(bctx->loopmgr, t), lookups, args);
+	}
+}
+
+static void
+run(isc_mem_t *mctx, uint32_t nloops, bool lockfree) {
+	struct bench_state bctx = {
+		.mctx = mctx,
+		.lockfree = lockfree,
+		.nloops = nloops,
+	};
+
+	isc_loopmgr_create(mctx, nloops, &bctx.loopmgr);
+	isc_loop_setup(isc_loop_main(bctx.loopmgr), startup, &bctx);
+	isc_loopmgr_run(bctx.loopmgr);
+	isc_loopmgr_destroy(&bctx.loopmgr);
+}
+
+int
+main(void) {
+	isc_mem_t *mctx = NULL;
+	uint32_t maxloops;
+	const char *env_workers = getenv("ISC_TASK_WORKERS");
+
+	setlinebuf(stdout);
+
+	if (env_workers != NULL) {
+		maxloops = atoi(env_workers);
+	} else {
+		maxloops = isc_os_ncpus();
+	}
+	INSIST(maxloops > 0);
+
+	isc_mem_create(&mctx);
+	init_names(mctx);
+
+	for (uint32_t nloops = 1; nloops <= maxloops; nloops *= 2) {
+		run(mctx, nloops, false);
+		run(mctx, nloops, true);
+	}
+
+	isc_mem_cput(mctx, names, NAME_COUNT, sizeof(names[0]));
+	isc_mem_destroy(&mctx);
+
+	return 0;
+}
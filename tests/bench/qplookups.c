@@ -17,6 +17,7 @@
 #include <isc/commandline.h>
 #include <isc/file.h>
 #include <isc/ht.h>
+#include <isc/random.h>
 #include <isc/rwlock.h>
 #include <isc/time.h>
 #include <isc/util.h>
@@ -196,11 +197,16 @@ load_qp(dns_qp_t *qp, const char *filename) {
 
 int
 main(int argc, char **argv) {
-	dns_qp_t *qp = NULL;
+	dns_qp_t *qp = NULL, *sorted = NULL;
+	dns_qpbuild_t *build = NULL;
 	isc_nanosecs_t start, stop;
 	dns_fixedname_t *items = NULL;
 	dns_qpiter_t it = { 0 };
 	dns_name_t *name = NULL;
+	void **pvals = NULL;
+	uint32_t *ivals = NULL;
+	const dns_name_t **names = NULL;
+	isc_result_t *results = NULL;
 	size_t i = 0, n = 0;
 	char buf[BUFSIZ];
 
@@ -221,12 +227,16 @@ main(int argc, char **argv) {
 	printf("%-57s%7.3fsec\n", buf, (stop - start) / (double)NS_PER_SEC);
 
 	items = isc_mem_cget(mctx, n, sizeof(dns_fixedname_t));
+	pvals = isc_mem_cget(mctx, n, sizeof(pvals[0]));
+	ivals = isc_mem_cget(mctx, n, sizeof(ivals[0]));
 	dns_qpiter_init(qp, &it);
 
 	start = isc_time_monotonic();
-	for (i = 0;; i++) {
+	for (i = 0; i < n; i++) {
 		name = dns_fixedname_initname(&items[i]);
-		if (dns_qpiter_next(&it, name, NULL, NULL) != ISC_R_SUCCESS) {
+		if (dns_qpiter_next(&it, name, &pvals[i], &ivals[i]) !=
+		    ISC_R_SUCCESS)
+		{
 			break;
 		}
 	}
@@ -235,6 +245,35 @@ main(int argc, char **argv) {
 	snprintf(buf, sizeof(buf), "iterate %zd names:", n);
 	printf("%-57s%7.3fsec\n", buf, (stop - start) / (double)NS_PER_SEC);
 
+	/*
+	 * the iterator returned the names in order, so they can be
+	 * used to compare the ways of loading a trie from sorted input
+	 */
+	start = isc_time_monotonic();
+	dns_qp_create(mctx, &methods, NULL, &sorted);
+	for (i = 0; i < n; i++) {
+		dns_qp_insert(sorted, pvals[i], ivals[i]);
+	}
+	dns_qp_compact(sorted, DNS_QPGC_ALL);
+	stop = isc_time_monotonic();
+	dns_qp_destroy(&sorted);
+
+	snprintf(buf, sizeof(buf), "load %zd sorted names (dns_qp_insert):", n);
+	printf("%-57s%7.3fsec\n", buf, (stop - start) / (double)NS_PER_SEC);
+
+	start = isc_time_monotonic();
+	dns_qp_create(mctx, &methods, NULL, &sorted);
+	dns_qpbuild_start(sorted, &build);
+	for (i = 0; i < n; i++) {
+		dns_qpbuild_add(build, pvals[i], ivals[i]);
+	}
+	dns_qpbuild_finish(&build);
+	stop = isc_time_monotonic();
+	dns_qp_destroy(&sorted);
+
+	snprintf(buf, sizeof(buf), "load %zd sorted names (dns_qpbuild):", n);
+	printf("%-57s%7.3fsec\n", buf, (stop - start) / (double)NS_PER_SEC);
+
 	n = i;
 	start = isc_time_monotonic();
 	for (i = 0; i < n; i++) {
@@ -246,6 +285,61 @@ main(int argc, char **argv) {
 	snprintf(buf, sizeof(buf), "look up %zd names (dns_qp_getname):", n);
 	printf("%-57s%7.3fsec\n", buf, (stop - start) / (double)NS_PER_SEC);
 
+	/*
+	 * the same lookups, DNS_QP_BATCH names at a time
+	 */
+	names = isc_mem_cget(mctx, n, sizeof(names[0]));
+	results = isc_mem_cget(mctx, n, sizeof(results[0]));
+	for (i = 0; i < n; i++) {
+		names[i] = dns_fixedname_name(&items[i]);
+	}
+
+	start = isc_time_monotonic();
+	for (i = 0; i < n; i += DNS_QP_BATCH) {
+		size_t count = ISC_MIN(n - i, DNS_QP_BATCH);
+		dns_qp_getnames(qp, &names[i], count, &results[i], NULL, NULL);
+	}
+	stop = isc_time_monotonic();
+
+	snprintf(buf, sizeof(buf), "look up %zd names (dns_qp_getnames):", n);
+	printf("%-57s%7.3fsec\n", buf, (stop - start) / (double)NS_PER_SEC);
+
+	/*
+	 * the names come out of the iterator in trie order, so
+	 * consecutive lookups share most of their path; shuffle them
+	 * to see the cost of cache misses
+	 */
+	for (i = n; i > 1; i--) {
+		size_t j = isc_random_uniform(i);
+		const dns_name_t *tmp = names[i - 1];
+		names[i - 1] = names[j];
+		names[j] = tmp;
+	}
+
+	start = isc_time_monotonic();
+	for (i = 0; i < n; i++) {
+		dns_qp_getname(qp, names[i], NULL, NULL);
+	}
+	stop = isc_time_monotonic();
+
+	snprintf(buf, sizeof(buf),
+		 "look up %zd shuffled names (dns_qp_getname):", n);
+	printf("%-57s%7.3fsec\n", buf, (stop - start) / (double)NS_PER_SEC);
+
+	start = isc_time_monotonic();
+	for (i = 0; i < n; i += DNS_QP_BATCH) {
+		size_t count = ISC_MIN(n - i, DNS_QP_BATCH);
+		dns_qp_getnames(qp, &names[i], count, &results[i], NULL, NULL);
+	}
+	stop = isc_time_monotonic();
+
+	snprintf(buf, sizeof(buf),
+		 "look up %zd shuffled names (dns_qp_getnames):", n);
+	printf("%-57s%7.3fsec\n", buf, (stop - start) / (double)NS_PER_SEC);
+
+	isc_mem_cput(mctx, results, n, sizeof(results[0]));
+	isc_mem_cput(mctx, names, n, sizeof(names[0]));
+
 	start = isc_time_monotonic();
 	for (i = 0; i < n; i++) {
 		name = dns_fixedname_name(&items[i]);
@@ -282,6 +376,8 @@ main(int argc, char **argv) {
 		 "look up %zd wrong names (dns_qp_lookup):", n);
 	printf("%-57s%7.3fsec\n", buf, (stop - start) / (double)NS_PER_SEC);
 
+	isc_mem_cput(mctx, ivals, n, sizeof(ivals[0]));
+	isc_mem_cput(mctx, pvals, n, sizeof(pvals[0]));
 	isc_mem_cput(mctx, items, n, sizeof(dns_fixedname_t));
 	return 0;
 }
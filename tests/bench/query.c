@@ -0,0 +1,521 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Measure how fast each loop answers queries from a zone, taking the
+ * steps the server takes for an authoritative answer: parse the query,
+ * turn the message into a reply, look the name up in the zone database,
+ * add the answer, the referral or the SOA of a negative answer, and
+ * render the response.  For 1, 2, 4... loops it reports the queries per
+ * second, the allocations per query and the quantiles of the time a
+ * query takes.
+ *
+ * A zone file, its origin and a file of queries, one "name type" per
+ * line, can be given on the command line; otherwise a zone is generated
+ * and queried for a mix of names that exist, names that don't, types
+ * that don't and names below delegations.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <isc/async.h>
+#include <isc/buffer.h>
+#include <isc/histo.h>
+#include <isc/loop.h>
+#include <isc/mem.h>
+#include <isc/os.h>
+#include <isc/random.h>
+#include <isc/result.h>
+#include <isc/time.h>
+#include <isc/urcu.h>
+#include <isc/util.h>
+
+#include <dns/compress.h>
+#include <dns/db.h>
+#include <dns/fixedname.h>
+#include <dns/message.h>
+#include <dns/name.h>
+#include <dns/rcode.h>
+#include <dns/rdataset.h>
+#include <dns/rdatatype.h>
+
+#define NAME_COUNT  ((uint32_t)100000)
+#define QUERY_COUNT ((uint32_t)100000)
+#define RUNTIME	    (1 * NS_PER_SEC)
+#define BATCH	    256
+
+/* Significant bits of the latency histograms, about two digits */
+#define LATENCY_SIGBITS 7
+
+/* Largest query with a single question and no EDNS */
+#define QUERY_MAXWIRE (DNS_MESSAGE_HEADERLEN + DNS_NAME_MAXWIRE + 4)
+
+/* Size of the responses, as for a UDP client with EDNS */
+#define RESPONSE_SIZE 1232
+
+struct query {
+	unsigned int length;
+	unsigned char wire[QUERY_MAXWIRE];
+};
+
+struct bench_state {
+	isc_mem_t *mctx;
+	isc_loopmgr_t *loopmgr;
+	uint32_t nloops;
+	uint32_t done;
+	uint64_t queries;
+	uint64_t allocations;
+	double qps;
+	isc_histo_t *latency;
+};
+
+struct thread_args {
+	struct bench_state *bctx;
+	isc_histo_t *latency;
+	uint64_t queries;
+	isc_nanosecs_t start;
+	isc_nanosecs_t stop;
+	unsigned char response[RESPONSE_SIZE];
+};
+
+static dns_db_t *db = NULL;
+static dns_dbversion_t *version = NULL;
+static dns_fixedname_t forigin;
+static dns_name_t *origin = NULL;
+static struct query *queries = NULL;
+static uint32_t nqueries = 0;
+
+static void
+CHECKRESULT(isc_result_t result, const char *msg) {
+	if (result != ISC_R_SUCCESS) {
+		printf("%s: %s\n", msg, isc_result_totext(result));
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void
+generate(const char *filename) {
+	FILE *fp = fopen(filename, "w");
+
+	if (fp == NULL) {
+		perror(filename);
+		exit(EXIT_FAILURE);
+	}
+
+	fprintf(fp, "$TTL 3600\n"
+		    "@ SOA ns1 hostmaster 1 3600 900 604800 300\n"
+		    "@ NS ns1\n"
+		    "@ NS ns2\n"
+		    "ns1 A 192.0.2.1\n"
+		    "ns2 A 192.0.2.2\n");
+	for (uint32_t i = 0; i < NAME_COUNT; i++) {
+		fprintf(fp, "h%" PRIu32 " A 198.51.100.%" PRIu32 "\n", i,
+			i % 256);
+		if (i % 10 == 0) {
+			fprintf(fp,
+				"d%" PRIu32 " NS ns1.d%" PRIu32 "\n"
+				"ns1.d%" PRIu32 " A 203.0.113.%" PRIu32 "\n",
+				i, i, i, i % 256);
+		}
+	}
+
+	if (fclose(fp) != 0) {
+		perror(filename);
+		exit(EXIT_FAILURE);
+	}
+}
+
+/*
+ * Render a query for 'qname' and 'qtype' into the next slot of
+ * 'queries'.
+ */
+static void
+addquery(isc_mem_t *mctx, const char *qname, dns_rdatatype_t qtype) {
+	isc_result_t result;
+	dns_message_t *msg = NULL;
+	dns_name_t *name = NULL;
+	dns_rdataset_t *rdataset = NULL;
+	dns_compress_t cctx;
+	isc_buffer_t buffer;
+	struct query *query = &queries[nqueries];
+
+	dns_message_create(mctx, NULL, NULL, DNS_MESSAGE_INTENTRENDER, &msg);
+	msg->id = (dns_messageid_t)isc_random16();
+	msg->opcode = dns_opcode_query;
+
+	dns_message_gettempname(msg, &name);
+	result = dns_name_fromstring(name, qname, origin, 0, NULL);
+	CHECKRESULT(result, qname);
+
+	dns_message_gettemprdataset(msg, &rdataset);
+	dns_rdataset_makequestion(rdataset, dns_rdataclass_in, qtype);
+	ISC_LIST_APPEND(name->list, rdataset, link);
+	dns_message_addname(msg, name, DNS_SECTION_QUESTION);
+
+	isc_buffer_init(&buffer, query->wire, sizeof(query->wire));
+	dns_compress_init(&cctx, mctx, DNS_COMPRESS_DISABLED);
+	result = dns_message_renderbegin(msg, &cctx, &buffer);
+	CHECKRESULT(result, "dns_message_renderbegin");
+	result = dns_message_rendersection(msg, DNS_SECTION_QUESTION, 0);
+	CHECKRESULT(result, "dns_message_rendersection");
+	result = dns_message_renderend(msg);
+	CHECKRESULT(result, "dns_message_renderend");
+	dns_compress_invalidate(&cctx);
+
+	query->length = isc_buffer_usedlength(&buffer);
+	nqueries++;
+
+	dns_message_detach(&msg);
+}
+
+static void
+generate_queries(isc_mem_t *mctx) {
+	char qname[DNS_NAME_FORMATSIZE];
+
+	queries = isc_mem_cget(mctx, QUERY_COUNT, sizeof(queries[0]));
+	for (uint32_t i = 0; i < QUERY_COUNT; i++) {
+		uint32_t n = isc_random_uniform(NAME_COUNT);
+		dns_rdatatype_t qtype = dns_rdatatype_a;
+
+		switch (isc_random_uniform(10)) {
+		case 0:
+			/* NXDOMAIN */
+			snprintf(qname, sizeof(qname), "x%" PRIu32, n);
+			break;
+		case 1:
+			/* no data */
+			snprintf(qname, sizeof(qname), "h%" PRIu32, n);
+			qtype = dns_rdatatype_aaaa;
+			break;
+		case 2:
+			/* referral */
+			snprintf(qname, sizeof(qname), "www.d%" PRIu32,
+				 n - n % 10);
+			break;
+		default:
+			snprintf(qname, sizeof(qname), "h%" PRIu32, n);
+			break;
+		}
+		addquery(mctx, qname, qtype);
+	}
+}
+
+static void
+read_queries(isc_mem_t *mctx, const char *filename) {
+	FILE *fp = fopen(filename, "r");
+	char line[DNS_NAME_FORMATSIZE + 64];
+	uint32_t size = 0;
+
+	if (fp == NULL) {
+		perror(filename);
+		exit(EXIT_FAILURE);
+	}
+
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		char qname[DNS_NAME_FORMATSIZE], type[64];
+		dns_rdatatype_t qtype;
+		isc_textregion_t r;
+		isc_result_t result;
+
+		if (sscanf(line, "%1023s %63s", qname, type) != 2) {
+			continue;
+		}
+		r = (isc_textregion_t){ .base = type, .length = strlen(type) };
+		result = dns_rdatatype_fromtext(&qtype, &r);
+		CHECKRESULT(result, type);
+
+		if (nqueries == size) {
+			uint32_t newsize = size == 0 ? 1024 : size * 2;
+			queries = isc_mem_creget(mctx, queries, size, newsize,
+						 sizeof(queries[0]));
+			size = newsize;
+		}
+		addquery(mctx, qname, qtype);
+	}
+	fclose(fp);
+
+	if (nqueries == 0) {
+		fprintf(stderr, "%s: no queries\n", filename);
+		exit(EXIT_FAILURE);
+	}
+	queries = isc_mem_creget(mctx, queries, size, nqueries,
+				 sizeof(queries[0]));
+}
+
+/*
+ * Answer 'query' in 'msg', and render the response into the buffer of
+ * 'args'.
+ */
+static void
+answer(struct thread_args *args, dns_message_t *msg,
+       const struct query *query) {
+	isc_result_t result;
+	isc_buffer_t source, target;
+	dns_compress_t cctx;
+	dns_fixedname_t ffound;
+	dns_name_t *found = dns_fixedname_initname(&ffound);
+	dns_name_t *qname = NULL, *name = NULL;
+	dns_rdataset_t *rdataset = NULL;
+	dns_rdatatype_t qtype;
+	dns_section_t section = DNS_SECTION_ANSWER;
+
+	dns_message_reset(msg, DNS_MESSAGE_INTENTPARSE);
+	isc_buffer_constinit(&source, query->wire, query->length);
+	isc_buffer_add(&source, query->length);
+	result = dns_message_parse(msg, &source, 0);
+	CHECKRESULT(result, "dns_message_parse");
+
+	result = dns_message_firstname(msg, DNS_SECTION_QUESTION);
+	CHECKRESULT(result, "dns_message_firstname");
+	dns_message_currentname(msg, DNS_SECTION_QUESTION, &qname);
+	qtype = ISC_LIST_HEAD(qname->list)->type;
+
+	result = dns_message_reply(msg, true);
+	CHECKRESULT(result, "dns_message_reply");
+	msg->flags |= DNS_MESSAGEFLAG_AA;
+
+	dns_message_gettemprdataset(msg, &rdataset);
+	result = dns_db_find(db, qname, version, qtype, 0, 0, NULL, found,
+			     rdataset, NULL);
+	switch (result) {
+	case ISC_R_SUCCESS:
+	case DNS_R_CNAME:
+		break;
+	case DNS_R_DELEGATION:
+		msg->flags &= ~DNS_MESSAGEFLAG_AA;
+		section = DNS_SECTION_AUTHORITY;
+		break;
+	case DNS_R_NXDOMAIN:
+	case DNS_R_NXRRSET:
+		if (result == DNS_R_NXDOMAIN) {
+			msg->rcode = dns_rcode_nxdomain;
+		}
+		if (dns_rdataset_isassociated(rdataset)) {
+			dns_rdataset_disassociate(rdataset);
+		}
+		result = dns_db_find(db, origin, version, dns_rdatatype_soa, 0,
+				     0, NULL, found, rdataset, NULL);
+		CHECKRESULT(result, "SOA");
+		section = DNS_SECTION_AUTHORITY;
+		break;
+	default:
+		msg->rcode = dns_rcode_servfail;
+		break;
+	}
+
+	if (dns_rdataset_isassociated(rdataset)) {
+		dns_message_gettempname(msg, &name);
+		dns_name_copy(found, name);
+		ISC_LIST_APPEND(name->list, rdataset, link);
+		dns_message_addname(msg, name, section);
+	} else {
+		dns_message_puttemprdataset(msg, &rdataset);
+	}
+
+	isc_buffer_init(&target, args->response, sizeof(args->response));
+	dns_compress_init(&cctx, args->bctx->mctx, DNS_COMPRESS_CASE);
+	result = dns_message_renderbegin(msg, &cctx, &target);
+	CHECKRESULT(result, "dns_message_renderbegin");
+	for (section = DNS_SECTION_QUESTION; section <= DNS_SECTION_ADDITIONAL;
+	     section++)
+	{
+		result = dns_message_rendersection(msg, section, 0);
+		if (result == ISC_R_NOSPACE) {
+			msg->flags |= DNS_MESSAGEFLAG_TC;
+			break;
+		}
+		CHECKRESULT(result, "dns_message_rendersection");
+	}
+	result = dns_message_renderend(msg);
+	CHECKRESULT(result, "dns_message_renderend");
+	dns_compress_invalidate(&cctx);
+}
+
+static void
+collect(void *varg) {
+	struct thread_args *args = varg;
+	struct bench_state *bctx = args->bctx;
+	static const double fractions[] = { 0.99, 0.9, 0.5 };
+	uint64_t values[ARRAY_SIZE(fractions)];
+	isc_result_t result;
+
+	bctx->queries += args->queries;
+	bctx->qps += (double)args->queries * NS_PER_SEC /
+		     (double)(args->stop - args->start);
+	isc_histo_merge(&bctx->latency, args->latency);
+	isc_histo_destroy(&args->latency);
+	isc_mem_put(bctx->mctx, args, sizeof(*args));
+
+	if (++bctx->done < bctx->nloops) {
+		return;
+	}
+
+	bctx->allocations = isc_mem_allocations(bctx->mctx) -
+			    bctx->allocations;
+	result = isc_histo_quantiles(bctx->latency, ARRAY_SIZE(fractions),
+				     fractions, values);
+	CHECKRESULT(result, "isc_histo_quantiles");
+
+	printf("%3" PRIu32 " loops %12.0f qps %8.2f allocs/query"
+	       " %8.2f %8.2f %8.2f us\n",
+	       bctx->nloops, bctx->qps,
+	       (double)bctx->allocations / (double)bctx->queries,
+	       (double)values[2] / NS_PER_US, (double)values[1] / NS_PER_US,
+	       (double)values[0] / NS_PER_US);
+
+	isc_histo_destroy(&bctx->latency);
+	isc_loopmgr_shutdown(bctx->loopmgr);
+}
+
+static void
+answers(void *varg) {
+	struct thread_args *args = varg;
+	dns_message_t *msg = NULL;
+	uint32_t i = isc_random_uniform(nqueries);
+
+	dns_message_create(args->bctx->mctx, NULL, NULL,
+			   DNS_MESSAGE_INTENTPARSE, &msg);
+	isc_histo_create(args->bctx->mctx, LATENCY_SIGBITS, &args->latency);
+
+	args->start = isc_time_monotonic();
+	do {
+		for (uint32_t n = 0; n < BATCH; n++) {
+			isc_nanosecs_t start = isc_time_monotonic();
+
+			answer(args, msg, &queries[i]);
+			isc_histo_inc(args->latency,
+				      isc_time_monotonic() - start);
+			if (++i == nqueries) {
+				i = 0;
+			}
+		}
+		args->queries += BATCH;
+		args->stop = isc_time_monotonic();
+	} while (args->stop - args->start < RUNTIME);
+
+	dns_message_detach(&msg);
+
+	isc_async_run(isc_loop_main(args->bctx->loopmgr), collect, args);
+}
+
+static void
+startup(void *arg) {
+	struct bench_state *bctx = arg;
+
+	bctx->allocations = isc_mem_allocations(bctx->mctx);
+
+	for (uint32_t t = 0; t < bctx->nloops; t++) {
+		struct thread_args *args = isc_mem_get(bctx->mctx,
+						       sizeof(*args));
+		*args = (struct thread_args){ .bctx = bctx };
+		isc_async_run(isc_loop_get(bctx->loopmgr, t), answers, args);
+	}
+}
+
+static void
+run(isc_mem_t *mctx, uint32_t nloops) {
+	struct bench_state bctx = {
+		.mctx = mctx,
+		.nloops = nloops,
+	};
+
+	isc_loopmgr_create(mctx, nloops, &bctx.loopmgr);
+	isc_loop_setup(isc_loop_main(bctx.loopmgr), startup, &bctx);
+	isc_loopmgr_run(bctx.loopmgr);
+	isc_loopmgr_destroy(&bctx.loopmgr);
+}
+
+int
+main(int argc, char *argv[]) {
+	isc_result_t result;
+	isc_mem_t *mctx = NULL;
+	char tmpname[] = "query.XXXXXX";
+	const char *filename = NULL;
+	const char *zonename = "example.";
+	const char *queryfile = NULL;
+	bool generated = false;
+	uint32_t maxloops;
+	const char *env_workers = getenv("ISC_TASK_WORKERS");
+
+	setlinebuf(stdout);
+
+	if (argc == 4) {
+		filename = argv[1];
+		zonename = argv[2];
+		queryfile = argv[3];
+	} else if (argc == 1) {
+		int fd = mkstemp(tmpname);
+		if (fd == -1) {
+			perror("mkstemp");
+			exit(EXIT_FAILURE);
+		}
+		close(fd);
+		filename = tmpname;
+		generate(filename);
+		generated = true;
+	} else {
+		fprintf(stderr,
+			"usage: query [<zonefile> <origin> <queryfile>]\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (env_workers != NULL) {
+		maxloops = atoi(env_workers);
+	} else {
+		maxloops = isc_os_ncpus();
+	}
+	INSIST(maxloops > 0);
+
+	origin = dns_fixedname_initname(&forigin);
+	result = dns_name_fromstring(origin, zonename, dns_rootname, 0, NULL);
+	CHECKRESULT(result, "dns_name_fromstring");
+
+	isc_mem_create(&mctx);
+
+	result = dns_db_create(mctx, ZONEDB_DEFAULT, origin, dns_dbtype_zone,
+			       dns_rdataclass_in, 0, NULL, &db);
+	CHECKRESULT(result, "dns_db_create");
+	result = dns_db_load(db, filename, dns_masterformat_text, 0);
+	CHECKRESULT(result, "dns_db_load");
+	dns_db_currentversion(db, &version);
+
+	if (queryfile != NULL) {
+		read_queries(mctx, queryfile);
+	} else {
+		generate_queries(mctx);
+	}
+
+	printf("%" PRIu32 " queries, latency quantiles 50%% 90%% 99%%\n",
+	       nqueries);
+	for (uint32_t nloops = 1; nloops <= maxloops; nloops *= 2) {
+		run(mctx, nloops);
+	}
+
+	isc_mem_cput(mctx, queries, nqueries, sizeof(queries[0]));
+	dns_db_closeversion(db, &version, false);
+	dns_db_detach(&db);
+	rcu_barrier();
+	isc_mem_destroy(&mctx);
+
+	if (generated) {
+		unlink(filename);
+	}
+
+	return 0;
+}
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Measure isc_radix_search() the way an address match list uses it: a
+ * tree of a range of sizes is filled with random IPv4 and IPv6 prefixes,
+ * then searched for host addresses inside the prefixes and for random
+ * host addresses that mostly match nothing.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <isc/commandline.h>
+#include <isc/mem.h>
+#include <isc/netaddr.h>
+#include <isc/radix.h>
+#include <isc/random.h>
+#include <isc/result.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+static const size_t sizes[] = { 16, 256, 4096, 65536 };
+
+static void
+usage(void) {
+	fprintf(stderr, "usage: radix [-o ops]\n");
+	fprintf(stderr,
+		"\t-o ops\tsearches timed per test (default 4000000)\n");
+	exit(1);
+}
+
+static void
+random_addr(isc_netaddr_t *na, bool v6) {
+	struct in6_addr in6;
+	struct in_addr in;
+
+	if (v6) {
+		isc_random_buf(&in6, sizeof(in6));
+		isc_netaddr_fromin6(na, &in6);
+	} else {
+		isc_random_buf(&in, sizeof(in));
+		isc_netaddr_fromin(na, &in);
+	}
+}
+
+/*
+ * Fill 'radix' with 'count' random prefixes, and put a host address
+ * inside each of them in 'hits'.
+ */
+static void
+fill(isc_radix_tree_t *radix, size_t count, isc_netaddr_t *hits) {
+	for (size_t i = 0; i < count; i++) {
+		bool v6 = (i % 2) != 0;
+		unsigned int bits = v6 ? 16 + isc_random_uniform(113)
+				       : 8 + isc_random_uniform(25);
+		isc_radix_node_t *node = NULL;
+		isc_result_t result;
+		isc_prefix_t pfx;
+
+		random_addr(&hits[i], v6);
+		NETADDR_TO_PREFIX_T(&hits[i], pfx, bits);
+		result = isc_radix_insert(radix, &node, NULL, &pfx);
+		INSIST(result == ISC_R_SUCCESS);
+		isc_refcount_destroy(&pfx.refcount);
+	}
+}
+
+static size_t
+search(isc_radix_tree_t *radix, size_t count, isc_netaddr_t *addrs,
+       size_t ops) {
+	size_t found = 0;
+
+	for (size_t n = 0; n < ops; n++) {
+		isc_netaddr_t *na = &addrs[n % count];
+		unsigned int bits = (na->family == AF_INET6) ? 128 : 32;
+		isc_radix_node_t *node = NULL;
+		isc_prefix_t pfx;
+
+		NETADDR_TO_PREFIX_T(na, pfx, bits);
+		if (isc_radix_search(radix, &node, &pfx) == ISC_R_SUCCESS) {
+			found++;
+		}
+		isc_refcount_destroy(&pfx.refcount);
+	}
+
+	return found;
+}
+
+static void
+report(const char *what, size_t count, size_t ops, size_t found,
+       isc_nanosecs_t elapsed) {
+	printf("%6zu prefixes %-6s %8.1f ns/op %10.0f ops/s %5.1f%% found\n",
+	       count, what, (double)elapsed / ops,
+	       (double)ops * NS_PER_SEC / elapsed, 100.0 * found / ops);
+}
+
+static void
+run(isc_mem_t *mctx, size_t count, size_t ops) {
+	isc_radix_tree_t *radix = NULL;
+	isc_netaddr_t *hits = NULL, *misses = NULL;
+	isc_nanosecs_t start;
+	size_t found;
+
+	hits = isc_mem_cget(mctx, count, sizeof(hits[0]));
+	misses = isc_mem_cget(mctx, count, sizeof(misses[0]));
+
+	isc_radix_create(mctx, &radix, RADIX_MAXBITS);
+	fill(radix, count, hits);
+	for (size_t i = 0; i < count; i++) {
+		random_addr(&misses[i], (i % 2) != 0);
+	}
+
+	start = isc_time_monotonic();
+	found = search(radix, count, hits, ops);
+	report("hit", count, ops, found, isc_time_monotonic() - start);
+	INSIST(found == ops);
+
+	start = isc_time_monotonic();
+	found = search(radix, count, misses, ops);
+	report("random", count, ops, found, isc_time_monotonic() - start);
+
+	isc_radix_destroy(radix, NULL);
+	isc_mem_cput(mctx, misses, count, sizeof(misses[0]));
+	isc_mem_cput(mctx, hits, count, sizeof(hits[0]));
+}
+
+int
+main(int argc, char **argv) {
+	isc_mem_t *mctx = NULL;
+	size_t ops = 4000000;
+	int ch;
+
+	while ((ch = isc_commandline_parse(argc, argv, "o:")) != -1) {
+		switch (ch) {
+		case 'o':
+			ops = strtoul(isc_commandline_argument, NULL, 10);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (ops == 0) {
+		usage();
+	}
+
+	setlinebuf(stdout);
+
+	isc_mem_create(&mctx);
+
+	for (size_t i = 0; i < ARRAY_SIZE(sizes); i++) {
+		run(mctx, sizes[i], ops);
+	}
+
+	isc_mem_destroy(&mctx);
+
+	return 0;
+}
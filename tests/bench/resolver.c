@@ -0,0 +1,953 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Measure the resolver against a simulated hierarchy of authoritative
+ * servers.  Three responders in this process serve the root zone on
+ * 127.0.0.1, the top-level domains "t<n>." on 127.0.0.2 and the
+ * second-level domains "s<m>.t<n>." on 127.0.0.3, where 'n' is 'm'
+ * modulo the number of top-level domains.  Each response is made up
+ * from the name queried: the root and the top-level domains refer the
+ * resolver to the level below, and a second-level domain answers the
+ * "h<k>" names with an address and any other name with NXDOMAIN.  The
+ * responders can delay each response and drop a fraction of the queries.
+ *
+ * Each loop keeps a number of lookups in flight.  A lookup is answered
+ * from the cache if it can be, as the server does, and otherwise by a
+ * fetch started with dns_resolver_createfetch().  The names looked up
+ * are "h<k>.s<m>.t<n>.", with 'k' drawn from a Zipf distribution and
+ * 'm' being 'k' modulo the number of second-level domains, and a tail of
+ * names that are looked up only once.  The bench reports the fraction of
+ * lookups answered from the cache, the queries sent to the responders
+ * per lookup, the resolver's CPU time per fetch and the quantiles of the
+ * time a lookup takes.
+ *
+ * The responders listen on 127.0.0.2 and 127.0.0.3 as well as on
+ * 127.0.0.1, which needs a system that routes all of 127/8 to the
+ * loopback interface, as Linux does.
+ */
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <isc/ascii.h>
+#include <isc/async.h>
+#include <isc/atomic.h>
+#include <isc/buffer.h>
+#include <isc/commandline.h>
+#include <isc/histo.h>
+#include <isc/loop.h>
+#include <isc/managers.h>
+#include <isc/mem.h>
+#include <isc/netmgr.h>
+#include <isc/os.h>
+#include <isc/random.h>
+#include <isc/result.h>
+#include <isc/sockaddr.h>
+#include <isc/stats.h>
+#include <isc/time.h>
+#include <isc/timer.h>
+#include <isc/tls.h>
+#include <isc/urcu.h>
+#include <isc/util.h>
+
+#include <dns/cache.h>
+#include <dns/compress.h>
+#include <dns/db.h>
+#include <dns/dispatch.h>
+#include <dns/fixedname.h>
+#include <dns/message.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+#include <dns/rdatastruct.h>
+#include <dns/resolver.h>
+#include <dns/rootns.h>
+#include <dns/stats.h>
+#include <dns/view.h>
+
+/* Levels of the hierarchy: the root, top-level and second-level domains */
+#define LEVELS 3
+
+#define REFERRAL_TTL 86400
+#define ANSWER_TTL   3600
+#define NEGATIVE_TTL 300
+
+/* Significant bits of the latency histograms, about two digits */
+#define LATENCY_SIGBITS 7
+
+/* Size of the responses, as for a UDP client with EDNS */
+#define RESPONSE_SIZE 1232
+
+/* Space for the rdata of a response */
+#define RDATA_SIZE 1024
+
+struct responder {
+	unsigned int level;
+	isc_sockaddr_t addr;
+	isc_nmsocket_t *sock;
+	atomic_uint_fast64_t queries;
+};
+
+struct response {
+	isc_nmhandle_t *handle;
+	isc_timer_t *timer;
+	isc_region_t region;
+	unsigned char wire[RESPONSE_SIZE];
+};
+
+struct bench_state {
+	uint32_t nloops;
+	uint32_t done;
+	isc_nanosecs_t start;
+	uint64_t lookups;
+	uint64_t hits;
+	uint64_t failures;
+	isc_histo_t *latency;
+};
+
+struct thread_args {
+	struct bench_state *bctx;
+	uint32_t tid;
+	uint32_t todo;
+	uint32_t inflight;
+	uint64_t lookups;
+	uint64_t hits;
+	uint64_t failures;
+	uint64_t cold;
+	isc_histo_t *latency;
+};
+
+struct lookup {
+	struct thread_args *args;
+	isc_nanosecs_t start;
+	dns_fixedname_t fname;
+	dns_name_t *name;
+	dns_rdataset_t rdataset;
+	dns_rdataset_t sigrdataset;
+	dns_fetch_t *fetch;
+};
+
+/* Parameters, set on the command line */
+static uint32_t ntlds = 10;
+static uint32_t nslds = 10000;
+static uint32_t nnames = 100000;
+static uint32_t nlookups = 100000;
+static uint32_t maxinflight = 100;
+static uint32_t coldpct = 10;
+static uint32_t losspct = 0;
+static uint32_t latency_ms = 0;
+static in_port_t port = 5300;
+static double exponent = 0.9;
+
+static isc_mem_t *mctx = NULL;
+static isc_loopmgr_t *loopmgr = NULL;
+static isc_nm_t *netmgr = NULL;
+static isc_tlsctx_cache_t *tlsctx_cache = NULL;
+static dns_dispatch_t *dispatch = NULL;
+static dns_view_t *view = NULL;
+static isc_stats_t *resstats = NULL;
+static const char *hintsfile = NULL;
+static struct responder responders[LEVELS];
+static double *zipf = NULL;
+
+static void
+CHECKRESULT(isc_result_t result, const char *msg) {
+	if (result != ISC_R_SUCCESS) {
+		printf("%s: %s\n", msg, isc_result_totext(result));
+		exit(EXIT_FAILURE);
+	}
+}
+
+/*
+ * If label 'n' of 'name' is 'prefix' followed by a decimal number less
+ * than 'limit', store the number in '*valuep'.
+ */
+static bool
+labelnumber(const dns_name_t *name, unsigned int n, char prefix,
+	    uint32_t limit, uint32_t *valuep) {
+	dns_label_t label;
+	uint64_t value = 0;
+
+	/* The first octet of the label is its length */
+	dns_name_getlabel(name, n, &label);
+	if (label.length < 3 || isc_ascii_tolower(label.base[1]) != prefix) {
+		return false;
+	}
+	for (unsigned int i = 2; i < label.length; i++) {
+		if (label.base[i] < '0' || label.base[i] > '9' ||
+		    value >= limit)
+		{
+			return false;
+		}
+		value = value * 10 + label.base[i] - '0';
+	}
+	if (value >= limit) {
+		return false;
+	}
+
+	*valuep = (uint32_t)value;
+	return true;
+}
+
+/*
+ * Return the level of the deepest zone of the hierarchy that 'name' is
+ * in: 0 for the root, 1 for a top-level and 2 for a second-level domain.
+ */
+static unsigned int
+zonelevel(const dns_name_t *name) {
+	unsigned int labels = dns_name_countlabels(name);
+	uint32_t tld, sld;
+
+	if (labels < 2 || !labelnumber(name, labels - 2, 't', ntlds, &tld)) {
+		return 0;
+	}
+	if (labels < 3 || !labelnumber(name, labels - 3, 's', nslds, &sld) ||
+	    sld % ntlds != tld)
+	{
+		return 1;
+	}
+	return 2;
+}
+
+static void
+addrdata(dns_message_t *msg, dns_section_t section, const dns_name_t *owner,
+	 dns_rdatatype_t type, uint32_t ttl, void *source,
+	 isc_buffer_t *buffer) {
+	isc_result_t result;
+	dns_rdata_t *rdata = NULL;
+	dns_rdatalist_t *rdatalist = NULL;
+	dns_rdataset_t *rdataset = NULL;
+	dns_name_t *name = NULL;
+
+	dns_message_gettemprdata(msg, &rdata);
+	result = dns_rdata_fromstruct(rdata, dns_rdataclass_in, type, source,
+				      buffer);
+	CHECKRESULT(result, "dns_rdata_fromstruct");
+
+	dns_message_gettemprdatalist(msg, &rdatalist);
+	rdatalist->type = type;
+	rdatalist->rdclass = dns_rdataclass_in;
+	rdatalist->ttl = ttl;
+	ISC_LIST_APPEND(rdatalist->rdata, rdata, link);
+
+	dns_message_gettemprdataset(msg, &rdataset);
+	dns_rdatalist_tordataset(rdatalist, rdataset);
+
+	dns_message_gettempname(msg, &name);
+	dns_name_copy(owner, name);
+	ISC_LIST_APPEND(name->list, rdataset, link);
+	dns_message_addname(msg, name, section);
+}
+
+static void
+addaddress(dns_message_t *msg, dns_section_t section, const dns_name_t *owner,
+	   const struct in_addr *address, uint32_t ttl, isc_buffer_t *buffer) {
+	dns_rdata_in_a_t a = { .in_addr = *address };
+
+	DNS_RDATACOMMON_INIT(&a, dns_rdatatype_a, dns_rdataclass_in);
+	addrdata(msg, section, owner, dns_rdatatype_a, ttl, &a, buffer);
+}
+
+/*
+ * Add the NS record of 'zone', the zone of the responder at 'level', to
+ * 'section', and the address of the name server as glue.
+ */
+static void
+addns(dns_message_t *msg, dns_section_t section, const dns_name_t *zone,
+      unsigned int level, isc_buffer_t *buffer) {
+	isc_result_t result;
+	dns_fixedname_t fixed;
+	dns_rdata_ns_t ns = { .mctx = NULL };
+
+	DNS_RDATACOMMON_INIT(&ns, dns_rdatatype_ns, dns_rdataclass_in);
+	dns_name_init(&ns.name, NULL);
+	dns_fixedname_init(&fixed);
+	result = dns_name_fromstring(dns_fixedname_name(&fixed), "ns", zone,
+				     0, NULL);
+	CHECKRESULT(result, "dns_name_fromstring");
+	dns_name_clone(dns_fixedname_name(&fixed), &ns.name);
+
+	addrdata(msg, section, zone, dns_rdatatype_ns, REFERRAL_TTL, &ns,
+		 buffer);
+	addaddress(msg, DNS_SECTION_ADDITIONAL, &ns.name,
+		   &responders[level].addr.type.sin.sin_addr, REFERRAL_TTL,
+		   buffer);
+}
+
+static void
+addsoa(dns_message_t *msg, dns_section_t section, const dns_name_t *zone,
+       isc_buffer_t *buffer) {
+	dns_rdata_soa_t soa = {
+		.serial = 1,
+		.refresh = 3600,
+		.retry = 900,
+		.expire = 604800,
+		.minimum = NEGATIVE_TTL,
+	};
+
+	DNS_RDATACOMMON_INIT(&soa, dns_rdatatype_soa, dns_rdataclass_in);
+	dns_name_init(&soa.origin, NULL);
+	dns_name_init(&soa.contact, NULL);
+	dns_name_clone(zone, &soa.origin);
+	dns_name_clone(zone, &soa.contact);
+
+	addrdata(msg, section, zone, dns_rdatatype_soa, NEGATIVE_TTL, &soa,
+		 buffer);
+}
+
+/*
+ * Answer the query in 'msg' as the responder for 'level' would.
+ */
+static void
+answer(dns_message_t *msg, unsigned int level, const dns_name_t *qname,
+       dns_rdatatype_t qtype, isc_buffer_t *buffer) {
+	isc_result_t result;
+	unsigned int labels = dns_name_countlabels(qname);
+	unsigned int zlevel = zonelevel(qname);
+	dns_fixedname_t fns;
+	dns_name_t *nsname = dns_fixedname_initname(&fns);
+	dns_name_t zone;
+	uint32_t k;
+
+	if (zlevel < level) {
+		msg->rcode = dns_rcode_refused;
+		return;
+	}
+
+	dns_name_init(&zone, NULL);
+	if (zlevel > level) {
+		/* Refer to the zone one level down */
+		dns_name_getlabelsequence(qname, labels - level - 2, level + 2,
+					  &zone);
+		addns(msg, DNS_SECTION_AUTHORITY, &zone, level + 1, buffer);
+		return;
+	}
+
+	msg->flags |= DNS_MESSAGEFLAG_AA;
+	dns_name_getlabelsequence(qname, labels - level - 1, level + 1, &zone);
+	result = dns_name_fromstring(nsname, "ns", &zone, 0, NULL);
+	CHECKRESULT(result, "dns_name_fromstring");
+
+	if (dns_name_equal(qname, &zone)) {
+		if (qtype == dns_rdatatype_ns) {
+			addns(msg, DNS_SECTION_ANSWER, &zone, level, buffer);
+		} else if (qtype == dns_rdatatype_soa) {
+			addsoa(msg, DNS_SECTION_ANSWER, &zone, buffer);
+		} else {
+			addsoa(msg, DNS_SECTION_AUTHORITY, &zone, buffer);
+		}
+	} else if (dns_name_equal(qname, nsname)) {
+		if (qtype == dns_rdatatype_a) {
+			addaddress(msg, DNS_SECTION_ANSWER, qname,
+				   &responders[level].addr.type.sin.sin_addr,
+				   REFERRAL_TTL, buffer);
+		} else {
+			addsoa(msg, DNS_SECTION_AUTHORITY, &zone, buffer);
+		}
+	} else if (level == LEVELS - 1 && labels == level + 2 &&
+		   labelnumber(qname, 0, 'h', nnames, &k))
+	{
+		if (qtype == dns_rdatatype_a) {
+			struct in_addr address = {
+				.s_addr = htonl(0xc6336400 + k % 256),
+			};
+			addaddress(msg, DNS_SECTION_ANSWER, qname, &address,
+				   ANSWER_TTL, buffer);
+		} else {
+			addsoa(msg, DNS_SECTION_AUTHORITY, &zone, buffer);
+		}
+	} else {
+		msg->rcode = dns_rcode_nxdomain;
+		addsoa(msg, DNS_SECTION_AUTHORITY, &zone, buffer);
+	}
+}
+
+/*
+ * Parse the query in 'region' and render the response into 'resp'.
+ * Returns false if the query is to be dropped.
+ */
+static bool
+respond(struct responder *r, isc_region_t *region, struct response *resp) {
+	isc_result_t result;
+	isc_buffer_t source, target, buffer;
+	unsigned char rdata[RDATA_SIZE];
+	dns_message_t *msg = NULL;
+	dns_rdataset_t *opt = NULL;
+	dns_name_t *qname = NULL;
+	dns_rdatatype_t qtype;
+	dns_compress_t cctx;
+	bool edns;
+
+	dns_message_create(mctx, NULL, NULL, DNS_MESSAGE_INTENTPARSE, &msg);
+	isc_buffer_init(&source, region->base, region->length);
+	isc_buffer_add(&source, region->length);
+	result = dns_message_parse(msg, &source, 0);
+	if (result != ISC_R_SUCCESS ||
+	    (msg->flags & DNS_MESSAGEFLAG_QR) != 0 ||
+	    dns_message_firstname(msg, DNS_SECTION_QUESTION) != ISC_R_SUCCESS)
+	{
+		dns_message_detach(&msg);
+		return false;
+	}
+	dns_message_currentname(msg, DNS_SECTION_QUESTION, &qname);
+	qtype = ISC_LIST_HEAD(qname->list)->type;
+	edns = (dns_message_getopt(msg) != NULL);
+
+	result = dns_message_reply(msg, true);
+	CHECKRESULT(result, "dns_message_reply");
+
+	isc_buffer_init(&buffer, rdata, sizeof(rdata));
+	answer(msg, r->level, qname, qtype, &buffer);
+
+	isc_buffer_init(&target, resp->wire, sizeof(resp->wire));
+	dns_compress_init(&cctx, mctx, 0);
+	result = dns_message_renderbegin(msg, &cctx, &target);
+	CHECKRESULT(result, "dns_message_renderbegin");
+	if (edns) {
+		result = dns_message_buildopt(msg, &opt, 0, RESPONSE_SIZE, 0,
+					      NULL, 0);
+		CHECKRESULT(result, "dns_message_buildopt");
+		result = dns_message_setopt(msg, opt);
+		CHECKRESULT(result, "dns_message_setopt");
+	}
+	for (dns_section_t section = DNS_SECTION_QUESTION;
+	     section <= DNS_SECTION_ADDITIONAL; section++)
+	{
+		result = dns_message_rendersection(msg, section, 0);
+		CHECKRESULT(result, "dns_message_rendersection");
+	}
+	result = dns_message_renderend(msg);
+	CHECKRESULT(result, "dns_message_renderend");
+	dns_compress_invalidate(&cctx);
+	dns_message_detach(&msg);
+
+	isc_buffer_usedregion(&target, &resp->region);
+	return true;
+}
+
+static void
+response_sent(isc_nmhandle_t *handle ISC_ATTR_UNUSED,
+	      isc_result_t eresult ISC_ATTR_UNUSED, void *arg) {
+	struct response *resp = arg;
+
+	isc_nmhandle_detach(&resp->handle);
+	isc_mem_put(mctx, resp, sizeof(*resp));
+}
+
+static void
+response_send(void *arg) {
+	struct response *resp = arg;
+
+	if (resp->timer != NULL) {
+		isc_timer_destroy(&resp->timer);
+	}
+	isc_nm_send(resp->handle, &resp->region, response_sent, resp);
+}
+
+static void
+responder_recv(isc_nmhandle_t *handle, isc_result_t eresult,
+	       isc_region_t *region, void *arg) {
+	struct responder *r = arg;
+	struct response *resp = NULL;
+
+	if (eresult != ISC_R_SUCCESS) {
+		return;
+	}
+
+	atomic_fetch_add_relaxed(&r->queries, 1);
+	if (losspct > 0 && isc_random_uniform(100) < losspct) {
+		return;
+	}
+
+	resp = isc_mem_get(mctx, sizeof(*resp));
+	*resp = (struct response){ .handle = NULL };
+	if (!respond(r, region, resp)) {
+		isc_mem_put(mctx, resp, sizeof(*resp));
+		return;
+	}
+
+	isc_nmhandle_attach(handle, &resp->handle);
+	if (latency_ms == 0) {
+		response_send(resp);
+	} else {
+		isc_interval_t interval;
+
+		isc_interval_set(&interval, latency_ms / 1000,
+				 (latency_ms % 1000) * NS_PER_MS);
+		isc_timer_create(isc_loop(), response_send, resp, &resp->timer);
+		isc_timer_start(resp->timer, isc_timertype_once, &interval);
+	}
+}
+
+static void
+generate_hints(const char *filename) {
+	FILE *fp = fopen(filename, "w");
+
+	if (fp == NULL) {
+		perror(filename);
+		exit(EXIT_FAILURE);
+	}
+
+	fprintf(fp, ". 3600000 NS ns.\n"
+		    "ns. 3600000 A 127.0.0.1\n");
+
+	if (fclose(fp) != 0) {
+		perror(filename);
+		exit(EXIT_FAILURE);
+	}
+}
+
+/*
+ * Cumulative weights of the "h<k>" names: name 'k' is looked up in
+ * proportion to 1 / (k + 1) ^ exponent.
+ */
+static void
+generate_zipf(void) {
+	double sum = 0.0;
+
+	zipf = isc_mem_cget(mctx, nnames, sizeof(zipf[0]));
+	for (uint32_t k = 0; k < nnames; k++) {
+		sum += 1.0 / pow((double)k + 1.0, exponent);
+		zipf[k] = sum;
+	}
+}
+
+static uint32_t
+zipf_rank(void) {
+	double u = (double)isc_random32() / UINT32_MAX * zipf[nnames - 1];
+	uint32_t lo = 0, hi = nnames - 1;
+
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+		if (zipf[mid] < u) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+static void
+pickname(struct thread_args *args, dns_name_t *name) {
+	isc_result_t result;
+	char text[DNS_NAME_FORMATSIZE];
+	uint32_t sld;
+
+	if (coldpct > 0 && isc_random_uniform(100) < coldpct) {
+		/* A name nobody asks for again, which doesn't exist */
+		sld = isc_random_uniform(nslds);
+		snprintf(text, sizeof(text),
+			 "c%" PRIu32 "-%" PRIu64 ".s%" PRIu32 ".t%" PRIu32 ".",
+			 args->tid, args->cold++, sld, sld % ntlds);
+	} else {
+		uint32_t k = zipf_rank();
+		sld = k % nslds;
+		snprintf(text, sizeof(text),
+			 "h%" PRIu32 ".s%" PRIu32 ".t%" PRIu32 ".", k, sld,
+			 sld % ntlds);
+	}
+
+	result = dns_name_fromstring(name, text, dns_rootname, 0, NULL);
+	CHECKRESULT(result, text);
+}
+
+static void
+collect(void *varg) {
+	struct thread_args *args = varg;
+	struct bench_state *bctx = args->bctx;
+	static const double fractions[] = { 0.99, 0.9, 0.5 };
+	uint64_t values[ARRAY_SIZE(fractions)];
+	uint64_t queries[LEVELS], upstream = 0;
+	uint64_t fetches, cputime;
+	isc_nanosecs_t elapsed;
+	isc_result_t result;
+
+	bctx->lookups += args->lookups;
+	bctx->hits += args->hits;
+	bctx->failures += args->failures;
+	isc_histo_merge(&bctx->latency, args->latency);
+	isc_histo_destroy(&args->latency);
+	isc_mem_put(mctx, args, sizeof(*args));
+
+	if (++bctx->done < bctx->nloops) {
+		return;
+	}
+
+	elapsed = isc_time_monotonic() - bctx->start;
+	for (unsigned int level = 0; level < LEVELS; level++) {
+		struct responder *r = &responders[level];
+		queries[level] = atomic_load_relaxed(&r->queries);
+		upstream += queries[level];
+	}
+	fetches = ISC_MAX(bctx->lookups - bctx->hits, 1);
+	cputime = isc_stats_get_counter(resstats,
+					dns_resstatscounter_resolvercpu);
+	result = isc_histo_quantiles(bctx->latency, ARRAY_SIZE(fractions),
+				     fractions, values);
+	CHECKRESULT(result, "isc_histo_quantiles");
+
+	printf("%" PRIu64 " lookups in %.3f s, %.0f lookups/s, "
+	       "%" PRIu64 " failed\n",
+	       bctx->lookups, (double)elapsed / NS_PER_SEC,
+	       (double)bctx->lookups * NS_PER_SEC / (double)elapsed,
+	       bctx->failures);
+	printf("cache hits %.2f%%\n",
+	       100.0 * (double)bctx->hits / (double)bctx->lookups);
+	printf("upstream queries per lookup %.3f"
+	       " (root %" PRIu64 ", tld %" PRIu64 ", sld %" PRIu64 ")\n",
+	       (double)upstream / (double)bctx->lookups, queries[0],
+	       queries[1], queries[2]);
+	printf("resolver CPU per fetch %.2f us\n",
+	       (double)cputime / (double)fetches / NS_PER_US);
+	printf("lookup latency quantiles 50%% %.3f 90%% %.3f 99%% %.3f ms\n",
+	       (double)values[2] / NS_PER_MS, (double)values[1] / NS_PER_MS,
+	       (double)values[0] / NS_PER_MS);
+
+	isc_histo_destroy(&bctx->latency);
+
+	for (unsigned int level = 0; level < LEVELS; level++) {
+		isc_nm_stoplistening(responders[level].sock);
+		isc_nmsocket_close(&responders[level].sock);
+	}
+	dns_dispatch_detach(&dispatch);
+	dns_view_detach(&view);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+static void
+lookups(struct thread_args *args);
+
+static void
+lookup_done(struct lookup *l) {
+	struct thread_args *args = l->args;
+
+	isc_histo_inc(args->latency, isc_time_monotonic() - l->start);
+	if (dns_rdataset_isassociated(&l->rdataset)) {
+		dns_rdataset_disassociate(&l->rdataset);
+	}
+	if (dns_rdataset_isassociated(&l->sigrdataset)) {
+		dns_rdataset_disassociate(&l->sigrdataset);
+	}
+	isc_mem_put(mctx, l, sizeof(*l));
+}
+
+static void
+fetch_done(void *arg) {
+	dns_fetchresponse_t *resp = arg;
+	struct lookup *l = resp->arg;
+	struct thread_args *args = l->args;
+
+	switch (resp->result) {
+	case ISC_R_SUCCESS:
+	case DNS_R_NCACHENXDOMAIN:
+	case DNS_R_NCACHENXRRSET:
+	case DNS_R_NXDOMAIN:
+	case DNS_R_NXRRSET:
+		break;
+	default:
+		args->failures++;
+		break;
+	}
+
+	if (resp->node != NULL) {
+		dns_db_detachnode(resp->db, &resp->node);
+	}
+	if (resp->db != NULL) {
+		dns_db_detach(&resp->db);
+	}
+	dns_resolver_destroyfetch(&l->fetch);
+	dns_resolver_freefresp(&resp);
+
+	lookup_done(l);
+	args->inflight--;
+	lookups(args);
+}
+
+/*
+ * Look a name up in the cache, and start a fetch if it isn't there.
+ */
+static void
+lookup(struct thread_args *args) {
+	isc_result_t result;
+	struct lookup *l = isc_mem_get(mctx, sizeof(*l));
+	dns_fixedname_t ffound;
+	dns_name_t *found = dns_fixedname_initname(&ffound);
+
+	*l = (struct lookup){
+		.args = args,
+		.start = isc_time_monotonic(),
+	};
+	l->name = dns_fixedname_initname(&l->fname);
+	dns_rdataset_init(&l->rdataset);
+	dns_rdataset_init(&l->sigrdataset);
+	pickname(args, l->name);
+	args->lookups++;
+
+	result = dns_view_find(view, l->name, dns_rdatatype_a, 0, 0, false,
+			       false, NULL, NULL, found, &l->rdataset,
+			       &l->sigrdataset);
+	switch (result) {
+	case ISC_R_SUCCESS:
+	case DNS_R_NCACHENXDOMAIN:
+	case DNS_R_NCACHENXRRSET:
+		args->hits++;
+		lookup_done(l);
+		return;
+	default:
+		break;
+	}
+
+	if (dns_rdataset_isassociated(&l->rdataset)) {
+		dns_rdataset_disassociate(&l->rdataset);
+	}
+	if (dns_rdataset_isassociated(&l->sigrdataset)) {
+		dns_rdataset_disassociate(&l->sigrdataset);
+	}
+
+	result = dns_resolver_createfetch(
+		view->resolver, l->name, dns_rdatatype_a, NULL, NULL, NULL,
+		NULL, 0, 0, 0, NULL, NULL, isc_loop(), fetch_done, l,
+		&l->rdataset, &l->sigrdataset, &l->fetch);
+	if (result != ISC_R_SUCCESS) {
+		args->failures++;
+		lookup_done(l);
+		return;
+	}
+	args->inflight++;
+}
+
+/*
+ * Keep up to 'maxinflight' lookups in flight until all have been made.
+ */
+static void
+lookups(struct thread_args *args) {
+	while (args->todo > 0 && args->inflight < maxinflight) {
+		args->todo--;
+		lookup(args);
+	}
+
+	if (args->todo == 0 && args->inflight == 0) {
+		isc_async_run(isc_loop_main(loopmgr), collect, args);
+	}
+}
+
+static void
+start_lookups(void *arg) {
+	struct thread_args *args = arg;
+
+	isc_histo_create(mctx, LATENCY_SIGBITS, &args->latency);
+	lookups(args);
+}
+
+static void
+startup(void *arg) {
+	struct bench_state *bctx = arg;
+	isc_result_t result;
+	isc_sockaddr_t any;
+	dns_dispatchmgr_t *dispatchmgr = NULL;
+	dns_cache_t *cache = NULL;
+	dns_db_t *hints = NULL;
+
+	result = dns_dispatchmgr_create(mctx, loopmgr, netmgr, &dispatchmgr);
+	CHECKRESULT(result, "dns_dispatchmgr_create");
+	isc_sockaddr_any(&any);
+	result = dns_dispatch_createudp(dispatchmgr, &any, &dispatch);
+	CHECKRESULT(result, "dns_dispatch_createudp");
+
+	result = dns_view_create(mctx, loopmgr, dispatchmgr, dns_rdataclass_in,
+				 "_default", &view);
+	CHECKRESULT(result, "dns_view_create");
+	dns_dispatchmgr_detach(&dispatchmgr);
+
+	result = dns_cache_create(loopmgr, dns_rdataclass_in, "", mctx,
+				  &cache);
+	CHECKRESULT(result, "dns_cache_create");
+	dns_view_setcache(view, cache, false);
+	dns_cache_detach(&cache);
+	dns_view_setdstport(view, port);
+
+	result = dns_rootns_create(mctx, dns_rdataclass_in, hintsfile, &hints);
+	CHECKRESULT(result, "dns_rootns_create");
+	dns_view_sethints(view, hints);
+	dns_db_detach(&hints);
+
+	result = dns_view_createresolver(view, netmgr, 0, tlsctx_cache,
+					 dispatch, NULL);
+	CHECKRESULT(result, "dns_view_createresolver");
+	isc_stats_create(mctx, &resstats, dns_resstatscounter_max);
+	dns_resolver_setstats(view->resolver, resstats);
+	dns_view_freeze(view);
+
+	for (unsigned int level = 0; level < LEVELS; level++) {
+		struct responder *r = &responders[level];
+		struct in_addr ina = {
+			.s_addr = htonl(0x7f000001 + level),
+		};
+
+		r->level = level;
+		isc_sockaddr_fromin(&r->addr, &ina, port);
+		result = isc_nm_listenudp(netmgr, ISC_NM_LISTEN_ALL, &r->addr,
+					  responder_recv, r, &r->sock);
+		CHECKRESULT(result, "isc_nm_listenudp");
+	}
+
+	bctx->start = isc_time_monotonic();
+	for (uint32_t t = 0; t < bctx->nloops; t++) {
+		struct thread_args *args = isc_mem_get(mctx, sizeof(*args));
+		*args = (struct thread_args){
+			.bctx = bctx,
+			.tid = t,
+			.todo = nlookups / bctx->nloops +
+				(t < nlookups % bctx->nloops ? 1 : 0),
+		};
+		isc_async_run(isc_loop_get(loopmgr, t), start_lookups, args);
+	}
+}
+
+static void
+usage(void) {
+	fprintf(stderr,
+		"usage: resolver [-c cold%%] [-d domains] [-f inflight]"
+		" [-l latency] [-n lookups]\n"
+		"                [-p port] [-q loss%%] [-s exponent]"
+		" [-t tlds] [-z names]\n"
+		"	-c	percentage of lookups for names asked for once"
+		" (10)\n"
+		"	-d	number of second-level domains (10000)\n"
+		"	-f	lookups in flight per loop (100)\n"
+		"	-l	delay of each response in milliseconds (0)\n"
+		"	-n	number of lookups (100000)\n"
+		"	-p	port of the responders (5300)\n"
+		"	-q	percentage of queries dropped (0)\n"
+		"	-s	exponent of the Zipf distribution (0.9)\n"
+		"	-t	number of top-level domains (10)\n"
+		"	-z	number of names in the Zipf distribution"
+		" (100000)\n");
+}
+
+static uint32_t
+number(const char *arg, uint32_t min, uint32_t max) {
+	char *end = NULL;
+	unsigned long value = strtoul(arg, &end, 10);
+
+	if (*arg == '\0' || *end != '\0' || value < min || value > max) {
+		usage();
+		exit(EXIT_FAILURE);
+	}
+	return (uint32_t)value;
+}
+
+int
+main(int argc, char *argv[]) {
+	struct bench_state bctx = { .nloops = 0 };
+	char tmpname[] = "resolver.XXXXXX";
+	const char *env_workers = getenv("ISC_TASK_WORKERS");
+	int opt, fd;
+
+	setlinebuf(stdout);
+
+	while ((opt = isc_commandline_parse(argc, argv,
+					    "c:d:f:l:n:p:q:s:t:z:")) != -1)
+	{
+		switch (opt) {
+		case 'c':
+			coldpct = number(isc_commandline_argument, 0, 100);
+			break;
+		case 'd':
+			nslds = number(isc_commandline_argument, 1, 1000000);
+			break;
+		case 'f':
+			maxinflight = number(isc_commandline_argument, 1,
+					     10000);
+			break;
+		case 'l':
+			latency_ms = number(isc_commandline_argument, 0, 10000);
+			break;
+		case 'n':
+			nlookups = number(isc_commandline_argument, 1,
+					  UINT32_MAX);
+			break;
+		case 'p':
+			port = number(isc_commandline_argument, 1, 65535);
+			break;
+		case 'q':
+			losspct = number(isc_commandline_argument, 0, 99);
+			break;
+		case 's':
+			exponent = strtod(isc_commandline_argument, NULL);
+			break;
+		case 't':
+			ntlds = number(isc_commandline_argument, 1, 1000);
+			break;
+		case 'z':
+			nnames = number(isc_commandline_argument, 1,
+					10000000);
+			break;
+		default:
+			usage();
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (isc_commandline_index != argc) {
+		usage();
+		exit(EXIT_FAILURE);
+	}
+
+	if (env_workers != NULL) {
+		bctx.nloops = atoi(env_workers);
+	} else {
+		bctx.nloops = isc_os_ncpus();
+	}
+	INSIST(bctx.nloops > 0);
+
+	fd = mkstemp(tmpname);
+	if (fd == -1) {
+		perror("mkstemp");
+		exit(EXIT_FAILURE);
+	}
+	close(fd);
+	hintsfile = tmpname;
+	generate_hints(hintsfile);
+
+	isc_managers_create(&mctx, bctx.nloops, &loopmgr, &netmgr);
+	isc_tlsctx_cache_create(mctx, &tlsctx_cache);
+	generate_zipf();
+
+	printf("%" PRIu32 " loops, %" PRIu32 " tlds, %" PRIu32 " domains, "
+	       "%" PRIu32 " names, exponent %.2f, %" PRIu32 "%% cold, "
+	       "%" PRIu32 " ms latency, %" PRIu32 "%% loss\n",
+	       bctx.nloops, ntlds, nslds, nnames, exponent, coldpct,
+	       latency_ms, losspct);
+
+	isc_loop_setup(isc_loop_main(loopmgr), startup, &bctx);
+	isc_loopmgr_run(loopmgr);
+
+	isc_stats_detach(&resstats);
+	isc_mem_cput(mctx, zipf, nnames, sizeof(zipf[0]));
+	isc_tlsctx_cache_detach(&tlsctx_cache);
+	rcu_barrier();
+	isc_managers_destroy(&mctx, &loopmgr, &netmgr);
+
+	unlink(hintsfile);
+
+	return 0;
+}
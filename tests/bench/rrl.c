@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Compare the time taken by several threads to rate limit responses
+ * when the rate limiting table has a single lock and when it is split
+ * into one shard per thread.
+ */
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <isc/barrier.h>
+#include <isc/loop.h>
+#include <isc/mem.h>
+#include <isc/netaddr.h>
+#include <isc/os.h>
+#include <isc/random.h>
+#include <isc/result.h>
+#include <isc/sockaddr.h>
+#include <isc/stdtime.h>
+#include <isc/thread.h>
+#include <isc/time.h>
+#include <isc/urcu.h>
+#include <isc/util.h>
+#include <isc/uv.h>
+
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rrl.h>
+#include <dns/view.h>
+
+#define RESPONSES_PER_THREAD ((uint32_t)1000000)
+#define MAX_THREADS	     128
+
+static isc_barrier_t barrier;
+static dns_view_t *view = NULL;
+static dns_name_t *qname = NULL;
+
+struct thread_s {
+	isc_thread_t thread;
+	uint32_t dropped;
+} threads[MAX_THREADS];
+
+static void
+CHECKRESULT(isc_result_t result, const char *msg) {
+	if (result != ISC_R_SUCCESS) {
+		printf("%s: %s\n", msg, isc_result_totext(result));
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void *
+respond(void *arg0) {
+	struct thread_s *arg = arg0;
+	char log_buf[DNS_RRL_LOG_BUF_LEN];
+	isc_stdtime_t now = isc_stdtime_now();
+
+	isc_barrier_wait(&barrier);
+
+	for (uint32_t n = 0; n < RESPONSES_PER_THREAD; n++) {
+		struct in_addr ina;
+		isc_sockaddr_t client;
+		dns_rrl_result_t rrl_result;
+
+		/*
+		 * Clients in a few thousand /24 blocks, some of which
+		 * are over the limit.
+		 */
+		ina.s_addr = htonl(0x0a000000 | isc_random_uniform(1 << 20));
+		isc_sockaddr_fromin(&client, &ina, 53);
+
+		rrl_result = dns_rrl(view, NULL, &client, false,
+				     dns_rdataclass_in, dns_rdatatype_a, qname,
+				     ISC_R_SUCCESS, now, false, log_buf,
+				     sizeof(log_buf));
+		if (rrl_result != DNS_RRL_RESULT_OK) {
+			arg->dropped++;
+		}
+	}
+
+	return NULL;
+}
+
+static void
+run(isc_mem_t *mctx, isc_loopmgr_t *loopmgr, unsigned int nthreads,
+    unsigned int nshards) {
+	isc_result_t result;
+	dns_rrl_t *rrl = NULL;
+	isc_nanosecs_t start, stop;
+	uint64_t dropped = 0;
+
+	result = dns_view_create(mctx, loopmgr, NULL, dns_rdataclass_in,
+				 "bench", &view);
+	CHECKRESULT(result, "dns_view_create");
+
+	result = dns_rrl_init(&rrl, view, 500, nshards);
+	CHECKRESULT(result, "dns_rrl_init");
+
+	rrl->max_entries = 100000;
+	rrl->responses_per_second.r = 100;
+	atomic_init(&rrl->responses_per_second.scaled, 100);
+	rrl->slip.r = 2;
+	atomic_init(&rrl->slip.scaled, 2);
+	rrl->window = 15;
+	rrl->ipv4_prefixlen = 24;
+	rrl->ipv4_mask = htonl(0xffffff00);
+
+	isc_barrier_init(&barrier, nthreads);
+
+	start = isc_time_monotonic();
+	for (unsigned int i = 0; i < nthreads; i++) {
+		threads[i] = (struct thread_s){ 0 };
+		isc_thread_create(respond, &threads[i], &threads[i].thread);
+	}
+	for (unsigned int i = 0; i < nthreads; i++) {
+		isc_thread_join(threads[i].thread, NULL);
+		dropped += threads[i].dropped;
+	}
+	stop = isc_time_monotonic();
+
+	isc_barrier_destroy(&barrier);
+
+	printf("%7u %7u %10.3f s %12" PRIu64 "\n", nthreads, nshards,
+	       (double)(stop - start) / NS_PER_SEC, dropped);
+
+	dns_rrl_view_destroy(view);
+	dns_view_detach(&view);
+	rcu_barrier();
+}
+
+int
+main(void) {
+	isc_mem_t *mctx = NULL;
+	isc_loopmgr_t *loopmgr = NULL;
+	dns_fixedname_t fixed;
+	isc_result_t result;
+	unsigned int ncpus = ISC_MIN(isc_os_ncpus(), MAX_THREADS);
+
+	qname = dns_fixedname_initname(&fixed);
+	result = dns_name_fromstring(qname, "www.example.", dns_rootname, 0,
+				     NULL);
+	CHECKRESULT(result, "dns_name_fromstring");
+
+	isc_mem_create(&mctx);
+	isc_loopmgr_create(mctx, 1, &loopmgr);
+
+	printf("%u responses per thread\n", RESPONSES_PER_THREAD);
+	printf("%7s %7s %12s %12s\n", "threads", "shards", "time",
+	       "limited");
+	for (unsigned int nthreads = 1; nthreads <= ncpus; nthreads *= 2) {
+		run(mctx, loopmgr, nthreads, 1);
+		run(mctx, loopmgr, nthreads, nthreads);
+	}
+
+	isc_loopmgr_destroy(&loopmgr);
+	isc_mem_destroy(&mctx);
+
+	return 0;
+}
@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Measure how many TSIG signed messages can be rendered and verified
+ * per second with each HMAC algorithm.
+ */
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <isc/buffer.h>
+#include <isc/mem.h>
+#include <isc/random.h>
+#include <isc/result.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#include <dns/compress.h>
+#include <dns/fixedname.h>
+#include <dns/message.h>
+#include <dns/name.h>
+#include <dns/tsig.h>
+
+#define MESSAGES ((uint32_t)100000)
+
+static isc_mem_t *mctx = NULL;
+
+static void
+CHECKRESULT(isc_result_t result, const char *msg) {
+	if (result != ISC_R_SUCCESS) {
+		printf("%s: %s\n", msg, isc_result_totext(result));
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void
+sign(dns_tsigkey_t *key, isc_buffer_t *buf) {
+	isc_result_t result;
+	dns_message_t *msg = NULL;
+	dns_compress_t cctx;
+
+	dns_message_create(mctx, NULL, NULL, DNS_MESSAGE_INTENTRENDER, &msg);
+	msg->id = 50;
+	msg->rcode = dns_rcode_noerror;
+
+	result = dns_message_settsigkey(msg, key);
+	CHECKRESULT(result, "dns_message_settsigkey");
+
+	dns_compress_init(&cctx, mctx, 0);
+	isc_buffer_clear(buf);
+	result = dns_message_renderbegin(msg, &cctx, buf);
+	CHECKRESULT(result, "dns_message_renderbegin");
+	result = dns_message_renderend(msg);
+	CHECKRESULT(result, "dns_message_renderend");
+
+	dns_compress_invalidate(&cctx);
+	dns_message_detach(&msg);
+}
+
+static void
+verify(dns_tsigkey_t *key, isc_buffer_t *buf) {
+	isc_result_t result;
+	dns_message_t *msg = NULL;
+
+	dns_message_create(mctx, NULL, NULL, DNS_MESSAGE_INTENTPARSE, &msg);
+
+	result = dns_message_settsigkey(msg, key);
+	CHECKRESULT(result, "dns_message_settsigkey");
+
+	isc_buffer_first(buf);
+	result = dns_message_parse(msg, buf, 0);
+	CHECKRESULT(result, "dns_message_parse");
+
+	result = dns_tsig_verify(buf, msg, NULL, NULL);
+	CHECKRESULT(result, "dns_tsig_verify");
+
+	dns_message_detach(&msg);
+}
+
+static void
+run(const char *name, dst_algorithm_t alg) {
+	isc_result_t result;
+	dns_fixedname_t fixed;
+	dns_name_t *keyname = dns_fixedname_initname(&fixed);
+	dns_tsigkey_t *key = NULL;
+	unsigned char secret[32];
+	unsigned char data[512];
+	isc_buffer_t buf;
+	isc_nanosecs_t start, signtime, verifytime;
+
+	isc_random_buf(secret, sizeof(secret));
+
+	result = dns_name_fromstring(keyname, "bench.key.", dns_rootname, 0,
+				     NULL);
+	CHECKRESULT(result, "dns_name_fromstring");
+	result = dns_tsigkey_create(keyname, alg, secret, sizeof(secret), mctx,
+				    &key);
+	CHECKRESULT(result, "dns_tsigkey_create");
+
+	isc_buffer_init(&buf, data, sizeof(data));
+
+	start = isc_time_monotonic();
+	for (uint32_t n = 0; n < MESSAGES; n++) {
+		sign(key, &buf);
+	}
+	signtime = isc_time_monotonic() - start;
+
+	start = isc_time_monotonic();
+	for (uint32_t n = 0; n < MESSAGES; n++) {
+		verify(key, &buf);
+	}
+	verifytime = isc_time_monotonic() - start;
+
+	printf("%-12s %12.0f %12.0f\n", name,
+	       (double)MESSAGES * NS_PER_SEC / signtime,
+	       (double)MESSAGES * NS_PER_SEC / verifytime);
+
+	dns_tsigkey_detach(&key);
+}
+
+int
+main(void) {
+	isc_mem_create(&mctx);
+
+	printf("%-12s %12s %12s\n", "algorithm", "signed/s", "verified/s");
+	run("hmac-sha1", DST_ALG_HMACSHA1);
+	run("hmac-sha256", DST_ALG_HMACSHA256);
+	run("hmac-sha512", DST_ALG_HMACSHA512);
+
+	isc_mem_destroy(&mctx);
+
+	return 0;
+}
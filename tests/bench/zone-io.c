@@ -0,0 +1,548 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Time the ways a zone gets into and out of a zone database: loading a
+ * text zone file, dumping it as text and in raw format, loading the raw
+ * file, rendering the zone into AXFR messages, and loading a zone from
+ * those messages.
+ *
+ * The AXFR messages are rendered as xfrout does for TCP, from a
+ * dns_rriterator with the raw RRs staged in a 64k buffer and no more
+ * than 'transfer-message-size' bytes per message, and are applied as
+ * xfrin does, in diffs of about 128 RRs ending at a name boundary that
+ * are loaded with dns_diff_load().  The work xfrin hands to a helper
+ * thread is done inline here.
+ *
+ * For each phase it reports the time taken, the rate in RRs per second,
+ * the memory in use afterwards and the peak resident size of the
+ * process so far.
+ *
+ * A zone file and its origin can be given on the command line;
+ * otherwise a zone of random names with A records is generated, as
+ * bin/tests/startperf/mkzonefile.pl does, with 100000 records or as
+ * many as the -n option asks for.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <isc/buffer.h>
+#include <isc/commandline.h>
+#include <isc/mem.h>
+#include <isc/random.h>
+#include <isc/result.h>
+#include <isc/time.h>
+#include <isc/urcu.h>
+#include <isc/util.h>
+
+#include <dns/callbacks.h>
+#include <dns/compress.h>
+#include <dns/db.h>
+#include <dns/diff.h>
+#include <dns/fixedname.h>
+#include <dns/master.h>
+#include <dns/masterdump.h>
+#include <dns/message.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+#include <dns/rriterator.h>
+
+#define RECORD_COUNT ((uint64_t)100000)
+
+/* Size of xfrout's buffer of raw RRs, and of a TCP DNS message */
+#define XFR_BUFFER_SIZE 65535
+
+/* The default 'transfer-message-size' */
+#define XFR_MESSAGE_SIZE 20480
+
+/* Number of RRs after which xfrin applies its diff at a name boundary */
+#define XFR_DIFF_SIZE 128
+
+static isc_mem_t *mctx = NULL;
+static dns_fixedname_t forigin;
+static dns_name_t *origin = NULL;
+static uint64_t records = 0;
+
+static void
+CHECKRESULT(isc_result_t result, const char *msg) {
+	if (result != ISC_R_SUCCESS) {
+		printf("%s: %s\n", msg, isc_result_totext(result));
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void
+tempfile(char *name) {
+	int fd = mkstemp(name);
+
+	if (fd == -1) {
+		perror("mkstemp");
+		exit(EXIT_FAILURE);
+	}
+	close(fd);
+}
+
+static void
+generate(const char *filename, uint64_t count) {
+	FILE *fp = fopen(filename, "w");
+
+	if (fp == NULL) {
+		perror(filename);
+		exit(EXIT_FAILURE);
+	}
+
+	fprintf(fp, "$TTL 300\n"
+		    "@ SOA mname1. . 2011080201 20 20 1814400 600\n"
+		    "@ NS ns\n"
+		    "ns A 10.53.0.3\n");
+	for (uint64_t i = 0; i < count; i++) {
+		char name[9];
+
+		for (size_t j = 0; j < sizeof(name) - 1; j++) {
+			name[j] = 'a' + isc_random_uniform(25);
+		}
+		name[sizeof(name) - 1] = '\0';
+		fprintf(fp, "%s A 10.%" PRIu32 ".%" PRIu32 ".%" PRIu32 "\n",
+			name, isc_random_uniform(254), isc_random_uniform(254),
+			isc_random_uniform(254));
+	}
+
+	if (fclose(fp) != 0) {
+		perror(filename);
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void
+report(const char *phase, isc_nanosecs_t start) {
+	isc_nanosecs_t elapsed = isc_time_monotonic() - start;
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	printf("%-12s %10.3f s %12.0f rr/s %10.1f MB in use"
+	       " %10.1f MB peak\n",
+	       phase, (double)elapsed / NS_PER_SEC,
+	       (double)records * NS_PER_SEC / (double)ISC_MAX(elapsed, 1),
+	       (double)isc_mem_inuse(mctx) / (1024 * 1024),
+	       (double)ru.ru_maxrss / 1024);
+}
+
+static dns_db_t *
+load(const char *filename, dns_masterformat_t format) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	dns_rdatacallbacks_t callbacks;
+	isc_nanosecs_t start = isc_time_monotonic();
+
+	result = dns_db_create(mctx, ZONEDB_DEFAULT, origin, dns_dbtype_zone,
+			       dns_rdataclass_in, 0, NULL, &db);
+	CHECKRESULT(result, "dns_db_create");
+
+	dns_rdatacallbacks_init(&callbacks);
+	result = dns_db_beginload(db, &callbacks);
+	CHECKRESULT(result, "dns_db_beginload");
+	result = dns_master_loadfile(filename, origin, origin,
+				     dns_rdataclass_in, DNS_MASTER_ZONE, 0,
+				     &callbacks, NULL, NULL, mctx, format, 0);
+	CHECKRESULT(result, "dns_master_loadfile");
+	result = dns_db_endload(db, &callbacks);
+	CHECKRESULT(result, "dns_db_endload");
+
+	report(format == dns_masterformat_raw ? "load raw" : "load text",
+	       start);
+
+	return db;
+}
+
+static void
+dump(dns_db_t *db, const char *filename, dns_masterformat_t format) {
+	isc_result_t result;
+	dns_dbversion_t *version = NULL;
+	isc_nanosecs_t start = isc_time_monotonic();
+
+	dns_db_currentversion(db, &version);
+	result = dns_master_dump(mctx, db, version, &dns_master_style_default,
+				 filename, format, NULL);
+	CHECKRESULT(result, "dns_master_dump");
+	dns_db_closeversion(db, &version, false);
+
+	report(format == dns_masterformat_raw ? "dump raw" : "dump text",
+	       start);
+}
+
+/*
+ * Add the question of the first AXFR message, with its name stored in
+ * 'buf' after space for the message header, as xfrout does.
+ */
+static void
+addquestion(dns_message_t *msg, isc_buffer_t *buf) {
+	dns_rdataset_t *qrdataset = NULL;
+	dns_name_t *qname = NULL;
+	isc_region_t r;
+
+	isc_buffer_add(buf, 12 + 4);
+
+	dns_message_gettemprdataset(msg, &qrdataset);
+	dns_rdataset_makequestion(qrdataset, dns_rdataclass_in,
+				  dns_rdatatype_axfr);
+
+	dns_message_gettempname(msg, &qname);
+	isc_buffer_availableregion(buf, &r);
+	r.length = origin->length;
+	isc_buffer_putmem(buf, origin->ndata, origin->length);
+	dns_name_fromregion(qname, &r);
+	ISC_LIST_APPEND(qname->list, qrdataset, link);
+
+	dns_message_addname(msg, qname, DNS_SECTION_QUESTION);
+}
+
+/*
+ * Add RRs from 'it' to the answer section of 'msg' until 'buf' holds
+ * XFR_MESSAGE_SIZE bytes of them, as xfrout's addrrs() does.  Sets
+ * '*eosp' at the end of the zone.
+ */
+static uint64_t
+addrrs(dns_rriterator_t *it, dns_message_t *msg, isc_buffer_t *buf,
+       bool *eosp) {
+	isc_result_t result;
+	uint64_t n = 0;
+
+	do {
+		dns_name_t *name = NULL, *msgname = NULL;
+		dns_rdata_t *rdata = NULL, *msgrdata = NULL;
+		dns_rdatalist_t *msgrdl = NULL;
+		dns_rdataset_t *msgrds = NULL;
+		uint32_t ttl;
+		unsigned int size;
+		isc_region_t r;
+
+		dns_rriterator_current(it, &name, &ttl, NULL, &rdata);
+		size = name->length + 10 + rdata->length;
+		isc_buffer_availableregion(buf, &r);
+		if (size >= r.length) {
+			INSIST(n > 0);
+			break;
+		}
+
+		dns_message_gettempname(msg, &msgname);
+		r.length = name->length;
+		isc_buffer_putmem(buf, name->ndata, name->length);
+		dns_name_fromregion(msgname, &r);
+		isc_buffer_add(buf, 10);
+
+		dns_message_gettemprdata(msg, &msgrdata);
+		isc_buffer_availableregion(buf, &r);
+		r.length = rdata->length;
+		isc_buffer_putmem(buf, rdata->data, rdata->length);
+		dns_rdata_init(msgrdata);
+		dns_rdata_fromregion(msgrdata, rdata->rdclass, rdata->type,
+				     &r);
+
+		dns_message_gettemprdatalist(msg, &msgrdl);
+		msgrdl->type = rdata->type;
+		msgrdl->rdclass = rdata->rdclass;
+		msgrdl->ttl = ttl;
+		if (rdata->type == dns_rdatatype_rrsig) {
+			msgrdl->covers = dns_rdata_covers(rdata);
+		}
+		ISC_LIST_APPEND(msgrdl->rdata, msgrdata, link);
+
+		dns_message_gettemprdataset(msg, &msgrds);
+		dns_rdatalist_tordataset(msgrdl, msgrds);
+		ISC_LIST_APPEND(msgname->list, msgrds, link);
+		dns_message_addname(msg, msgname, DNS_SECTION_ANSWER);
+		n++;
+
+		result = dns_rriterator_next(it);
+		if (result == ISC_R_NOMORE) {
+			*eosp = true;
+			break;
+		}
+		CHECKRESULT(result, "dns_rriterator_next");
+	} while (isc_buffer_usedlength(buf) < XFR_MESSAGE_SIZE);
+
+	return n;
+}
+
+/*
+ * Render the zone in 'db' into AXFR messages, which are appended to
+ * 'messages' with a two octet length in front of each, as on TCP.
+ */
+static void
+render(dns_db_t *db, isc_buffer_t *messages) {
+	isc_result_t result;
+	dns_dbversion_t *version = NULL;
+	dns_rriterator_t it;
+	dns_compress_t cctx;
+	unsigned char *rrmem = isc_mem_get(mctx, XFR_BUFFER_SIZE);
+	unsigned char *txmem = isc_mem_get(mctx, XFR_BUFFER_SIZE);
+	uint64_t nrrs = 0;
+	bool eos = false;
+	isc_nanosecs_t start = isc_time_monotonic();
+
+	dns_db_currentversion(db, &version);
+	result = dns_rriterator_init(&it, db, version, 0);
+	CHECKRESULT(result, "dns_rriterator_init");
+	result = dns_rriterator_first(&it);
+	CHECKRESULT(result, "dns_rriterator_first");
+	dns_compress_init(&cctx, mctx, 0);
+
+	while (!eos) {
+		dns_message_t *msg = NULL;
+		isc_buffer_t rrbuf, txbuf;
+
+		dns_message_create(mctx, NULL, NULL, DNS_MESSAGE_INTENTRENDER,
+				   &msg);
+		msg->flags = DNS_MESSAGEFLAG_QR | DNS_MESSAGEFLAG_AA;
+
+		isc_buffer_init(&rrbuf, rrmem, XFR_BUFFER_SIZE);
+		if (nrrs == 0) {
+			addquestion(msg, &rrbuf);
+		} else {
+			isc_buffer_add(&rrbuf, 12);
+			msg->tcp_continuation = 1;
+		}
+		nrrs += addrrs(&it, msg, &rrbuf, &eos);
+
+		dns_compress_reset(&cctx);
+		isc_buffer_init(&txbuf, txmem, XFR_BUFFER_SIZE);
+		result = dns_message_renderbegin(msg, &cctx, &txbuf);
+		CHECKRESULT(result, "dns_message_renderbegin");
+		result = dns_message_rendersection(msg, DNS_SECTION_QUESTION,
+						   0);
+		CHECKRESULT(result, "dns_message_rendersection");
+		result = dns_message_rendersection(msg, DNS_SECTION_ANSWER, 0);
+		CHECKRESULT(result, "dns_message_rendersection");
+		result = dns_message_renderend(msg);
+		CHECKRESULT(result, "dns_message_renderend");
+
+		isc_buffer_putuint16(messages, isc_buffer_usedlength(&txbuf));
+		isc_buffer_putmem(messages, txmem,
+				  isc_buffer_usedlength(&txbuf));
+		dns_message_detach(&msg);
+	}
+
+	dns_compress_invalidate(&cctx);
+	dns_rriterator_destroy(&it);
+	dns_db_closeversion(db, &version, false);
+	isc_mem_put(mctx, rrmem, XFR_BUFFER_SIZE);
+	isc_mem_put(mctx, txmem, XFR_BUFFER_SIZE);
+
+	report("axfr render", start);
+	if (nrrs != records) {
+		printf("rendered %" PRIu64 " of %" PRIu64 " records\n", nrrs,
+		       records);
+		exit(EXIT_FAILURE);
+	}
+}
+
+/*
+ * Add the current RR of 'rds' to 'diff', first loading the RRs already
+ * there if there are enough of them and 'name' starts a new name, as
+ * xfrin's axfr_putdata() does.
+ */
+static void
+putdata(dns_diff_t *diff, dns_rdatacallbacks_t *callbacks, dns_name_t *name,
+	dns_rdataset_t *rds) {
+	isc_result_t result;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_difftuple_t *tuple = NULL;
+
+	if (dns_diff_size(diff) > XFR_DIFF_SIZE &&
+	    dns_diff_is_boundary(diff, name))
+	{
+		result = dns_diff_load(diff, callbacks);
+		CHECKRESULT(result, "dns_diff_load");
+		dns_diff_clear(diff);
+	}
+
+	dns_rdataset_current(rds, &rdata);
+	dns_difftuple_create(mctx, DNS_DIFFOP_ADD, name, rds->ttl, &rdata,
+			     &tuple);
+	dns_diff_append(diff, &tuple);
+}
+
+/*
+ * Load a new zone database from the AXFR messages in 'messages'.
+ */
+static dns_db_t *
+apply(isc_buffer_t *messages) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	dns_rdatacallbacks_t callbacks;
+	dns_message_t *msg = NULL;
+	dns_diff_t diff;
+	uint64_t nrrs = 0;
+	isc_nanosecs_t start = isc_time_monotonic();
+
+	result = dns_db_create(mctx, ZONEDB_DEFAULT, origin, dns_dbtype_zone,
+			       dns_rdataclass_in, 0, NULL, &db);
+	CHECKRESULT(result, "dns_db_create");
+	dns_rdatacallbacks_init(&callbacks);
+	result = dns_db_beginload(db, &callbacks);
+	CHECKRESULT(result, "dns_db_beginload");
+
+	dns_diff_init(mctx, &diff);
+	dns_message_create(mctx, NULL, NULL, DNS_MESSAGE_INTENTPARSE, &msg);
+
+	while (isc_buffer_remaininglength(messages) > 0) {
+		unsigned int length = isc_buffer_getuint16(messages);
+		isc_buffer_t source;
+
+		isc_buffer_init(&source, isc_buffer_current(messages), length);
+		isc_buffer_add(&source, length);
+		isc_buffer_forward(messages, length);
+
+		dns_message_reset(msg, DNS_MESSAGE_INTENTPARSE);
+		dns_message_setclass(msg, dns_rdataclass_in);
+		result = dns_message_parse(msg, &source,
+					   DNS_MESSAGEPARSE_PRESERVEORDER);
+		CHECKRESULT(result, "dns_message_parse");
+
+		for (result = dns_message_firstname(msg, DNS_SECTION_ANSWER);
+		     result == ISC_R_SUCCESS;
+		     result = dns_message_nextname(msg, DNS_SECTION_ANSWER))
+		{
+			dns_name_t *name = NULL;
+
+			dns_message_currentname(msg, DNS_SECTION_ANSWER,
+						&name);
+			for (dns_rdataset_t *rds = ISC_LIST_HEAD(name->list);
+			     rds != NULL; rds = ISC_LIST_NEXT(rds, link))
+			{
+				for (result = dns_rdataset_first(rds);
+				     result == ISC_R_SUCCESS;
+				     result = dns_rdataset_next(rds))
+				{
+					nrrs++;
+					putdata(&diff, &callbacks, name, rds);
+				}
+			}
+		}
+	}
+
+	result = dns_diff_load(&diff, &callbacks);
+	CHECKRESULT(result, "dns_diff_load");
+	dns_diff_clear(&diff);
+	dns_message_detach(&msg);
+
+	result = dns_db_endload(db, &callbacks);
+	CHECKRESULT(result, "dns_db_endload");
+
+	report("axfr apply", start);
+	if (nrrs != records) {
+		printf("applied %" PRIu64 " of %" PRIu64 " records\n", nrrs,
+		       records);
+		exit(EXIT_FAILURE);
+	}
+
+	return db;
+}
+
+static void
+usage(void) {
+	fprintf(stderr,
+		"usage: zone-io [-n records] [<zonefile> <origin>]\n"
+		"	-n	number of records to generate (100000)\n");
+}
+
+int
+main(int argc, char *argv[]) {
+	isc_result_t result;
+	char zonefile[] = "zone-io.XXXXXX";
+	char textfile[] = "zone-io.XXXXXX";
+	char rawfile[] = "zone-io.XXXXXX";
+	const char *filename = zonefile;
+	const char *zonename = "example";
+	uint64_t count = RECORD_COUNT;
+	dns_db_t *db = NULL, *rawdb = NULL, *xfrdb = NULL;
+	dns_dbversion_t *version = NULL;
+	isc_buffer_t *messages = NULL;
+	bool generated = false;
+	int opt;
+
+	while ((opt = isc_commandline_parse(argc, argv, "n:")) != -1) {
+		switch (opt) {
+		case 'n':
+			count = strtoull(isc_commandline_argument, NULL, 10);
+			break;
+		default:
+			usage();
+			exit(EXIT_FAILURE);
+		}
+	}
+	argc -= isc_commandline_index;
+	argv += isc_commandline_index;
+
+	if (argc == 2) {
+		filename = argv[0];
+		zonename = argv[1];
+	} else if (argc == 0) {
+		tempfile(zonefile);
+		generate(zonefile, count);
+		generated = true;
+	} else {
+		usage();
+		exit(EXIT_FAILURE);
+	}
+	tempfile(textfile);
+	tempfile(rawfile);
+
+	origin = dns_fixedname_initname(&forigin);
+	result = dns_name_fromstring(origin, zonename, dns_rootname, 0, NULL);
+	CHECKRESULT(result, "dns_name_fromstring");
+
+	isc_mem_create(&mctx);
+
+	db = load(filename, dns_masterformat_text);
+	dns_db_currentversion(db, &version);
+	result = dns_db_getsize(db, version, &records, NULL);
+	CHECKRESULT(result, "dns_db_getsize");
+	dns_db_closeversion(db, &version, false);
+	printf("%" PRIu64 " records\n", records);
+
+	dump(db, textfile, dns_masterformat_text);
+	dump(db, rawfile, dns_masterformat_raw);
+
+	rawdb = load(rawfile, dns_masterformat_raw);
+	dns_db_detach(&rawdb);
+	rcu_barrier();
+
+	isc_buffer_allocate(mctx, &messages, XFR_BUFFER_SIZE);
+	render(db, messages);
+	dns_db_detach(&db);
+	rcu_barrier();
+
+	xfrdb = apply(messages);
+	isc_buffer_free(&messages);
+	dns_db_detach(&xfrdb);
+	rcu_barrier();
+
+	isc_mem_destroy(&mctx);
+
+	unlink(textfile);
+	unlink(rawfile);
+	if (generated) {
+		unlink(zonefile);
+	}
+
+	return 0;
+}
@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Compare the time taken to load a text zone file into a zone database
+ * when it is parsed on one thread and on several threads.
+ *
+ * The zone file and its origin can be given on the command line;
+ * otherwise a zone with NAME_COUNT delegations is generated, which is
+ * large enough to be parsed on several threads.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <isc/mem.h>
+#include <isc/os.h>
+#include <isc/result.h>
+#include <isc/time.h>
+#include <isc/urcu.h>
+#include <isc/util.h>
+
+#include <dns/callbacks.h>
+#include <dns/db.h>
+#include <dns/fixedname.h>
+#include <dns/master.h>
+#include <dns/name.h>
+
+#define NAME_COUNT ((uint32_t)1000000)
+
+static void
+CHECKRESULT(isc_result_t result, const char *msg) {
+	if (result != ISC_R_SUCCESS) {
+		printf("%s: %s\n", msg, isc_result_totext(result));
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void
+generate(const char *filename) {
+	FILE *fp = fopen(filename, "w");
+
+	if (fp == NULL) {
+		perror(filename);
+		exit(EXIT_FAILURE);
+	}
+
+	fprintf(fp, "$TTL 3600\n"
+		    "@ SOA ns1 hostmaster 1 3600 900 604800 300\n"
+		    "@ NS ns1\n"
+		    "ns1 A 192.0.2.1\n");
+	for (uint32_t i = 0; i < NAME_COUNT; i++) {
+		fprintf(fp,
+			"d%" PRIu32 " NS ns1.d%" PRIu32 "\n"
+			"d%" PRIu32 " NS ns2.d%" PRIu32 "\n"
+			"ns1.d%" PRIu32 " A 198.51.100.%" PRIu32 "\n"
+			"ns2.d%" PRIu32 " AAAA 2001:db8::%" PRIx32 "\n",
+			i, i, i, i, i, i % 256, i, i & 0xffff);
+	}
+
+	if (fclose(fp) != 0) {
+		perror(filename);
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void
+load(isc_mem_t *mctx, const char *filename, dns_name_t *origin,
+     unsigned int options) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	dns_rdatacallbacks_t callbacks;
+	isc_nanosecs_t start, stop;
+
+	result = dns_db_create(mctx, ZONEDB_DEFAULT, origin, dns_dbtype_zone,
+			       dns_rdataclass_in, 0, NULL, &db);
+	CHECKRESULT(result, "dns_db_create");
+
+	dns_rdatacallbacks_init(&callbacks);
+	result = dns_db_beginload(db, &callbacks);
+	CHECKRESULT(result, "dns_db_beginload");
+
+	start = isc_time_monotonic();
+	result = dns_master_loadfile(
+		filename, origin, origin, dns_rdataclass_in,
+		DNS_MASTER_ZONE | options, 0, &callbacks, NULL, NULL, mctx,
+		dns_masterformat_text, 0);
+	stop = isc_time_monotonic();
+	CHECKRESULT(result, "dns_master_loadfile");
+
+	result = dns_db_endload(db, &callbacks);
+	CHECKRESULT(result, "dns_db_endload");
+
+	printf("%-8s %10.3f s\n",
+	       (options & DNS_MASTER_NOTHREADS) != 0 ? "serial" : "parallel",
+	       (double)(stop - start) / NS_PER_SEC);
+
+	dns_db_detach(&db);
+	rcu_barrier();
+}
+
+int
+main(int argc, char *argv[]) {
+	isc_result_t result;
+	isc_mem_t *mctx = NULL;
+	dns_fixedname_t fixed;
+	dns_name_t *origin = dns_fixedname_initname(&fixed);
+	char tmpname[] = "zone-load.XXXXXX";
+	const char *filename = NULL;
+	const char *zonename = "example.";
+	bool generated = false;
+
+	if (argc == 3) {
+		filename = argv[1];
+		zonename = argv[2];
+	} else if (argc == 1) {
+		int fd = mkstemp(tmpname);
+		if (fd == -1) {
+			perror("mkstemp");
+			exit(EXIT_FAILURE);
+		}
+		close(fd);
+		filename = tmpname;
+		generate(filename);
+		generated = true;
+	} else {
+		fprintf(stderr, "usage: zone-load [<zonefile> <origin>]\n");
+		exit(EXIT_FAILURE);
+	}
+
+	result = dns_name_fromstring(origin, zonename, dns_rootname, 0, NULL);
+	CHECKRESULT(result, "dns_name_fromstring");
+
+	isc_mem_create(&mctx);
+
+	printf("%u cpus\n", isc_os_ncpus());
+	load(mctx, filename, origin, DNS_MASTER_NOTHREADS);
+	load(mctx, filename, origin, 0);
+
+	isc_mem_destroy(&mctx);
+
+	if (generated) {
+		unlink(filename);
+	}
+
+	return 0;
+}
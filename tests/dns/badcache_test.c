@@ -98,8 +98,9 @@ ISC_LOOP_TEST_IMPL(expire) {
 	result = dns_badcache_find(bc, name, dns_rdatatype_aaaa, &flags, now);
 	assert_int_equal(result, ISC_R_NOTFOUND);
 
+	/* Lookups only expire the entry they are looking for. */
 	result = dns_badcache_find(bc, name, dns_rdatatype_a, &flags, now);
-	assert_int_equal(result, ISC_R_NOTFOUND);
+	assert_int_equal(result, ISC_R_SUCCESS);
 
 	dns_badcache_add(bc, name, dns_rdatatype_a, flags, now + 120);
 
@@ -371,6 +372,45 @@ ISC_LOOP_TEST_IMPL(purge) {
 	isc_loopmgr_shutdown(loopmgr);
 }
 
+/* entries that are added again after being evicted are found */
+ISC_LOOP_TEST_IMPL(readd) {
+	dns_badcache_t *bc = NULL;
+	dns_fixedname_t fname = { 0 };
+	dns_name_t *name = dns_fixedname_initname(&fname);
+	isc_stdtime_t now = isc_stdtime_now();
+	isc_result_t result;
+	uint32_t flags = BADCACHE_TEST_FLAG;
+
+	bc = dns_badcache_new(mctx, loopmgr);
+
+	dns_name_fromstring(name, "example.com.", NULL, 0, NULL);
+	for (size_t i = 0; i < 3; i++) {
+		dns_badcache_add(bc, name, dns_rdatatype_aaaa, flags, now + 60);
+		dns_badcache_add(bc, name, dns_rdatatype_aaaa, flags, now + 60);
+		result = dns_badcache_find(bc, name, dns_rdatatype_aaaa, &flags,
+					   now);
+		assert_int_equal(result, ISC_R_SUCCESS);
+
+		dns_badcache_flushname(bc, name);
+		result = dns_badcache_find(bc, name, dns_rdatatype_aaaa, &flags,
+					   now);
+		assert_int_equal(result, ISC_R_NOTFOUND);
+	}
+
+	dns_badcache_add(bc, name, dns_rdatatype_aaaa, flags, now + 60);
+	result = dns_badcache_find(bc, name, dns_rdatatype_aaaa, &flags,
+				   now + 61);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	dns_badcache_add(bc, name, dns_rdatatype_aaaa, flags, now + 60);
+	result = dns_badcache_find(bc, name, dns_rdatatype_aaaa, &flags, now);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_badcache_destroy(&bc);
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY_CUSTOM(basic, setup_managers, teardown_managers)
 ISC_TEST_ENTRY_CUSTOM(expire, setup_managers, teardown_managers)
@@ -379,6 +419,7 @@ ISC_TEST_ENTRY_CUSTOM(flush, setup_managers, teardown_managers)
 ISC_TEST_ENTRY_CUSTOM(flushname, setup_managers, teardown_managers)
 ISC_TEST_ENTRY_CUSTOM(flushtree, setup_managers, teardown_managers)
 ISC_TEST_ENTRY_CUSTOM(purge, setup_managers, teardown_managers)
+ISC_TEST_ENTRY_CUSTOM(readd, setup_managers, teardown_managers)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
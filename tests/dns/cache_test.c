@@ -0,0 +1,454 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/buffer.h>
+#include <isc/file.h>
+#include <isc/stdio.h>
+#include <isc/util.h>
+
+#include <dns/cache.h>
+#include <dns/db.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+
+#include <tests/dns.h>
+
+#define SNAPSHOT "cache_test.snapshot"
+
+/*
+ * Must match the definitions in lib/dns/cache.c.
+ */
+#define SNAPSHOT_MAGIC	  ISC_MAGIC('C', 'S', 'n', 'p')
+#define SNAPSHOT_VERSION  1
+#define SNAPSHOT_NEGATIVE 0x01
+#define SNAPSHOT_STALE	  0x08
+
+static const unsigned char address[] = { 10, 53, 0, 1 };
+
+/*
+ * Add an A RRset holding 'address' at 'namestr' to 'cache'.
+ */
+static void
+addrdataset(dns_cache_t *cache, const char *namestr, dns_ttl_t ttl,
+	    dns_trust_t trust) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	dns_dbnode_t *node = NULL;
+	dns_fixedname_t fname;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset = DNS_RDATASET_INIT;
+
+	dns_test_namefromstring(namestr, &fname);
+
+	rdata.data = UNCONST(address);
+	rdata.length = sizeof(address);
+	rdata.rdclass = dns_rdataclass_in;
+	rdata.type = dns_rdatatype_a;
+
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.rdclass = dns_rdataclass_in;
+	rdatalist.type = dns_rdatatype_a;
+	rdatalist.ttl = ttl;
+	ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+	dns_rdatalist_tordataset(&rdatalist, &rdataset);
+	rdataset.trust = trust;
+
+	dns_cache_attachdb(cache, &db);
+	result = dns_db_findnode(db, dns_fixedname_name(&fname), true, &node);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_addrdataset(db, node, NULL, isc_stdtime_now(),
+				    &rdataset, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_rdataset_disassociate(&rdataset);
+	dns_db_detachnode(db, &node);
+	dns_db_detach(&db);
+}
+
+/*
+ * Look up the A RRset at 'namestr' in 'cache'.
+ */
+static isc_result_t
+findrdataset(dns_cache_t *cache, const char *namestr,
+	     dns_rdataset_t *rdataset) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	dns_fixedname_t fname, ffound;
+
+	dns_test_namefromstring(namestr, &fname);
+
+	dns_cache_attachdb(cache, &db);
+	result = dns_db_find(db, dns_fixedname_name(&fname), NULL,
+			     dns_rdatatype_a, 0, isc_stdtime_now(), NULL,
+			     dns_fixedname_initname(&ffound), rdataset, NULL);
+	dns_db_detach(&db);
+
+	return result;
+}
+
+/*
+ * Append the header of a snapshot to 'b'.
+ */
+static void
+putheader(isc_buffer_t *b, uint32_t magic, uint32_t version,
+	  dns_rdataclass_t rdclass) {
+	isc_buffer_putuint32(b, magic);
+	isc_buffer_putuint32(b, version);
+	isc_buffer_putuint16(b, rdclass);
+	isc_buffer_putuint16(b, 0);
+	isc_buffer_putuint32(b, isc_stdtime_now());
+}
+
+/*
+ * Append a record for an RRset of 'type' at 'namestr', holding the single
+ * rdata 'data', to 'b'.
+ */
+static void
+putrrset(isc_buffer_t *b, const char *namestr, uint32_t expire,
+	 dns_rdatatype_t type, dns_rdatatype_t covers, unsigned int flags,
+	 const unsigned char *data, size_t length) {
+	dns_fixedname_t fname;
+	dns_name_t *name = NULL;
+
+	dns_test_namefromstring(namestr, &fname);
+	name = dns_fixedname_name(&fname);
+
+	isc_buffer_putuint32(b, expire);
+	isc_buffer_putuint16(b, type);
+	isc_buffer_putuint16(b, covers);
+	isc_buffer_putuint8(b, dns_trust_answer);
+	isc_buffer_putuint8(b, flags);
+	isc_buffer_putuint16(b, 1);
+	isc_buffer_putuint8(b, name->length);
+	isc_buffer_putmem(b, name->ndata, name->length);
+	isc_buffer_putuint16(b, length);
+	isc_buffer_putmem(b, data, length);
+}
+
+/*
+ * Append a record for an A RRset at 'namestr' holding 'address' to 'b'.
+ */
+static void
+putrecord(isc_buffer_t *b, const char *namestr, uint32_t expire,
+	  unsigned int flags) {
+	putrrset(b, namestr, expire, dns_rdatatype_a, 0, flags, address,
+		 sizeof(address));
+}
+
+static void
+writefile(isc_buffer_t *b, size_t length) {
+	isc_result_t result;
+	FILE *fp = NULL;
+
+	result = isc_stdio_open(SNAPSHOT, "w", &fp);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = isc_stdio_write(isc_buffer_base(b), 1, length, fp, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = isc_stdio_close(fp);
+	assert_int_equal(result, ISC_R_SUCCESS);
+}
+
+/* the RRsets written to a snapshot are restored by loading it */
+ISC_LOOP_TEST_IMPL(snapshot_roundtrip) {
+	isc_result_t result;
+	dns_cache_t *cache = NULL;
+	dns_rdataset_t rdataset = DNS_RDATASET_INIT;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	size_t loaded = 0;
+
+	result = dns_cache_create(loopmgr, dns_rdataclass_in, "", mctx,
+				  &cache);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	addrdataset(cache, "a.example.", 3600, dns_trust_answer);
+	addrdataset(cache, "b.example.", 600, dns_trust_glue);
+	addrdataset(cache, "c.b.example.", 60, dns_trust_secure);
+
+	result = dns_cache_savesnapshot(cache, SNAPSHOT);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_cache_detach(&cache);
+
+	result = dns_cache_create(loopmgr, dns_rdataclass_in, "", mctx,
+				  &cache);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_cache_loadsnapshot(cache, SNAPSHOT, &loaded);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(loaded, 3);
+
+	result = findrdataset(cache, "a.example.", &rdataset);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(rdataset.trust, dns_trust_answer);
+	assert_true(rdataset.ttl <= 3600 && rdataset.ttl > 3500);
+	assert_int_equal(dns_rdataset_count(&rdataset), 1);
+	result = dns_rdataset_first(&rdataset);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_rdataset_current(&rdataset, &rdata);
+	assert_int_equal(rdata.length, sizeof(address));
+	assert_memory_equal(rdata.data, address, sizeof(address));
+	dns_rdataset_disassociate(&rdataset);
+
+	result = findrdataset(cache, "b.example.", &rdataset);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(rdataset.trust, dns_trust_glue);
+	assert_true(rdataset.ttl <= 600);
+	dns_rdataset_disassociate(&rdataset);
+
+	result = findrdataset(cache, "c.b.example.", &rdataset);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(rdataset.trust, dns_trust_secure);
+	assert_true(rdataset.ttl <= 60);
+	dns_rdataset_disassociate(&rdataset);
+
+	dns_cache_detach(&cache);
+	isc_file_remove(SNAPSHOT);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/* a truncated snapshot is reported, and the records before it are kept */
+ISC_LOOP_TEST_IMPL(snapshot_truncated) {
+	isc_result_t result;
+	dns_cache_t *cache = NULL;
+	dns_rdataset_t rdataset = DNS_RDATASET_INIT;
+	isc_stdtime_t now = isc_stdtime_now();
+	isc_buffer_t *b = NULL;
+
+	result = dns_cache_create(loopmgr, dns_rdataclass_in, "", mctx,
+				  &cache);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	isc_buffer_allocate(mctx, &b, 1024);
+	putheader(b, SNAPSHOT_MAGIC, SNAPSHOT_VERSION, dns_rdataclass_in);
+	putrecord(b, "a.example.", now + 3600, 0);
+	putrecord(b, "b.example.", now + 3600, 0);
+
+	/* shorter than the header */
+	writefile(b, 10);
+	result = dns_cache_loadsnapshot(cache, SNAPSHOT, NULL);
+	assert_int_equal(result, ISC_R_UNEXPECTEDEND);
+
+	/* the second record is cut in the middle of its rdata */
+	writefile(b, isc_buffer_usedlength(b) - 2);
+	result = dns_cache_loadsnapshot(cache, SNAPSHOT, NULL);
+	assert_int_equal(result, ISC_R_UNEXPECTEDEND);
+
+	result = findrdataset(cache, "a.example.", &rdataset);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_rdataset_disassociate(&rdataset);
+
+	result = findrdataset(cache, "b.example.", &rdataset);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	isc_buffer_free(&b);
+	dns_cache_detach(&cache);
+	isc_file_remove(SNAPSHOT);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/* files that are not snapshots of a cache of this class are refused */
+ISC_LOOP_TEST_IMPL(snapshot_badheader) {
+	isc_result_t result;
+	dns_cache_t *cache = NULL;
+	dns_rdataset_t rdataset = DNS_RDATASET_INIT;
+	isc_stdtime_t now = isc_stdtime_now();
+	isc_buffer_t *b = NULL;
+
+	result = dns_cache_create(loopmgr, dns_rdataclass_in, "", mctx,
+				  &cache);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	isc_file_remove(SNAPSHOT);
+	result = dns_cache_loadsnapshot(cache, SNAPSHOT, NULL);
+	assert_int_equal(result, ISC_R_FILENOTFOUND);
+
+	isc_buffer_allocate(mctx, &b, 1024);
+
+	putheader(b, ISC_MAGIC('J', 'u', 'n', 'k'), SNAPSHOT_VERSION,
+		  dns_rdataclass_in);
+	putrecord(b, "a.example.", now + 3600, 0);
+	writefile(b, isc_buffer_usedlength(b));
+	result = dns_cache_loadsnapshot(cache, SNAPSHOT, NULL);
+	assert_int_equal(result, ISC_R_NOTIMPLEMENTED);
+
+	isc_buffer_clear(b);
+	putheader(b, SNAPSHOT_MAGIC, SNAPSHOT_VERSION + 1, dns_rdataclass_in);
+	putrecord(b, "a.example.", now + 3600, 0);
+	writefile(b, isc_buffer_usedlength(b));
+	result = dns_cache_loadsnapshot(cache, SNAPSHOT, NULL);
+	assert_int_equal(result, ISC_R_NOTIMPLEMENTED);
+
+	isc_buffer_clear(b);
+	putheader(b, SNAPSHOT_MAGIC, SNAPSHOT_VERSION, dns_rdataclass_chaos);
+	putrecord(b, "a.example.", now + 3600, 0);
+	writefile(b, isc_buffer_usedlength(b));
+	result = dns_cache_loadsnapshot(cache, SNAPSHOT, NULL);
+	assert_int_equal(result, DNS_R_BADCLASS);
+
+	/* nothing was added from the refused files */
+	result = findrdataset(cache, "a.example.", &rdataset);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	isc_buffer_free(&b);
+	dns_cache_detach(&cache);
+	isc_file_remove(SNAPSHOT);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/* malformed rdata are refused, and the records after them are skipped */
+ISC_LOOP_TEST_IMPL(snapshot_badrdata) {
+	isc_result_t result;
+	dns_cache_t *cache = NULL;
+	dns_rdataset_t rdataset = DNS_RDATASET_INIT;
+	isc_stdtime_t now = isc_stdtime_now();
+	isc_buffer_t *b = NULL;
+	/* example. SOA . . 0 0 0 0 0, for the A RRset of "nx.example." */
+	unsigned char ncache[] = { 7, 'e', 'x', 'a', 'm', 'p', 'l', 'e', 0,
+				   0, dns_rdatatype_soa, dns_trust_answer,
+				   0, 1, 0, 22, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+				   0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+	result = dns_cache_create(loopmgr, dns_rdataclass_in, "", mctx,
+				  &cache);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	isc_buffer_allocate(mctx, &b, 1024);
+	putheader(b, SNAPSHOT_MAGIC, SNAPSHOT_VERSION, dns_rdataclass_in);
+	putrecord(b, "a.example.", now + 3600, 0);
+	putrrset(b, "nx.example.", now + 3600, 0, dns_rdatatype_a,
+		 SNAPSHOT_NEGATIVE, ncache, sizeof(ncache));
+	/* an A rdata one octet short */
+	putrrset(b, "b.example.", now + 3600, dns_rdatatype_a, 0, 0, address,
+		 sizeof(address) - 1);
+	putrecord(b, "c.example.", now + 3600, 0);
+	writefile(b, isc_buffer_usedlength(b));
+
+	result = dns_cache_loadsnapshot(cache, SNAPSHOT, NULL);
+	assert_int_not_equal(result, ISC_R_SUCCESS);
+
+	result = findrdataset(cache, "a.example.", &rdataset);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_rdataset_disassociate(&rdataset);
+
+	result = findrdataset(cache, "nx.example.", &rdataset);
+	assert_int_equal(result, DNS_R_NCACHENXRRSET);
+	dns_rdataset_disassociate(&rdataset);
+
+	result = findrdataset(cache, "b.example.", &rdataset);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+	result = findrdataset(cache, "c.example.", &rdataset);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+	dns_cache_detach(&cache);
+
+	/* an SOA rdata in the negative RRset that is cut short */
+	result = dns_cache_create(loopmgr, dns_rdataclass_in, "", mctx,
+				  &cache);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	ncache[15] = 21;
+	isc_buffer_clear(b);
+	putheader(b, SNAPSHOT_MAGIC, SNAPSHOT_VERSION, dns_rdataclass_in);
+	putrrset(b, "nx.example.", now + 3600, 0, dns_rdatatype_a,
+		 SNAPSHOT_NEGATIVE, ncache, sizeof(ncache) - 1);
+	writefile(b, isc_buffer_usedlength(b));
+
+	result = dns_cache_loadsnapshot(cache, SNAPSHOT, NULL);
+	assert_int_not_equal(result, ISC_R_SUCCESS);
+
+	result = findrdataset(cache, "nx.example.", &rdataset);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	isc_buffer_free(&b);
+	dns_cache_detach(&cache);
+	isc_file_remove(SNAPSHOT);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/* the RRsets that expired since the snapshot was taken are skipped */
+ISC_LOOP_TEST_IMPL(snapshot_expired) {
+	isc_result_t result;
+	dns_cache_t *cache = NULL;
+	dns_rdataset_t rdataset = DNS_RDATASET_INIT;
+	isc_stdtime_t now = isc_stdtime_now();
+	isc_buffer_t *b = NULL;
+	size_t loaded = 0;
+
+	isc_buffer_allocate(mctx, &b, 1024);
+	putheader(b, SNAPSHOT_MAGIC, SNAPSHOT_VERSION, dns_rdataclass_in);
+	putrecord(b, "active.example.", now + 3600, 0);
+	putrecord(b, "expired.example.", now - 60, 0);
+	putrecord(b, "stale.example.", now - 60, SNAPSHOT_STALE);
+	writefile(b, isc_buffer_usedlength(b));
+	isc_buffer_free(&b);
+
+	/* without serve-stale, the stale RRset is skipped too */
+	result = dns_cache_create(loopmgr, dns_rdataclass_in, "", mctx,
+				  &cache);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_cache_loadsnapshot(cache, SNAPSHOT, &loaded);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(loaded, 1);
+
+	result = findrdataset(cache, "active.example.", &rdataset);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_rdataset_disassociate(&rdataset);
+
+	result = findrdataset(cache, "expired.example.", &rdataset);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	dns_cache_detach(&cache);
+
+	/* inside the stale window, the stale RRset is kept */
+	result = dns_cache_create(loopmgr, dns_rdataclass_in, "", mctx,
+				  &cache);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_cache_setservestalettl(cache, 3600);
+
+	result = dns_cache_loadsnapshot(cache, SNAPSHOT, &loaded);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(loaded, 2);
+
+	result = findrdataset(cache, "expired.example.", &rdataset);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	dns_cache_detach(&cache);
+	isc_file_remove(SNAPSHOT);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY_CUSTOM(snapshot_roundtrip, setup_managers, teardown_managers)
+ISC_TEST_ENTRY_CUSTOM(snapshot_truncated, setup_managers, teardown_managers)
+ISC_TEST_ENTRY_CUSTOM(snapshot_badheader, setup_managers, teardown_managers)
+ISC_TEST_ENTRY_CUSTOM(snapshot_badrdata, setup_managers, teardown_managers)
+ISC_TEST_ENTRY_CUSTOM(snapshot_expired, setup_managers, teardown_managers)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
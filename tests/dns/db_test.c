@@ -356,6 +356,95 @@ ISC_LOOP_TEST_IMPL(version) {
 	isc_loopmgr_shutdown(loopmgr);
 }
 
+/* identical rdatasets share their rdata */
+ISC_LOOP_TEST_IMPL(shareslabs) {
+	isc_result_t result;
+	dns_fixedname_t fname;
+	dns_name_t *name = NULL;
+	dns_db_t *db = NULL;
+	dns_dbnode_t *node = NULL;
+	dns_rdataset_t rdataset;
+	uint64_t saved;
+
+	result = dns_db_create(mctx, ZONEDB_DEFAULT, dns_rootname,
+			       dns_dbtype_zone, dns_rdataclass_in, 0, NULL,
+			       &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_db_setshareslabs(db, true);
+
+	result = dns_db_load(db, TESTS_DIR "/testdata/db/shared.db",
+			     dns_masterformat_text, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	/* The NS RRsets of 'b' and 'c' are the same as the one of 'a' */
+	saved = dns_db_getsharedsize(db);
+	assert_int_not_equal(saved, 0);
+
+	dns_test_namefromstring("c.", &fname);
+	name = dns_fixedname_name(&fname);
+	dns_rdataset_init(&rdataset);
+	result = dns_db_findnode(db, name, false, &node);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_findrdataset(db, node, NULL, dns_rdatatype_ns, 0, 0,
+				     &rdataset, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(dns_rdataset_count(&rdataset), 2);
+	dns_rdataset_disassociate(&rdataset);
+	dns_db_detachnode(db, &node);
+
+	dns_db_detach(&db);
+
+	/* Nothing is shared unless asked for */
+	result = dns_db_create(mctx, ZONEDB_DEFAULT, dns_rootname,
+			       dns_dbtype_zone, dns_rdataclass_in, 0, NULL,
+			       &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_load(db, TESTS_DIR "/testdata/db/shared.db",
+			     dns_masterformat_text, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(dns_db_getsharedsize(db), 0);
+
+	dns_db_detach(&db);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/* several types looked up at once */
+ISC_LOOP_TEST_IMPL(findrdatasets) {
+	isc_result_t result;
+	dns_fixedname_t fname;
+	dns_name_t *name = NULL;
+	dns_db_t *db = NULL;
+	dns_dbnode_t *node = NULL;
+	dns_rdatatype_t types[] = { dns_rdatatype_a, dns_rdatatype_aaaa };
+	dns_rdataset_t a, aaaa;
+	dns_rdataset_t *rdatasets[] = { &a, &aaaa };
+	isc_result_t results[ARRAY_SIZE(types)];
+
+	result = dns_test_loaddb(&db, dns_dbtype_zone, "test.test",
+				 TESTS_DIR "/testdata/db/data.db");
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_test_namefromstring("b.test.test.", &fname);
+	name = dns_fixedname_name(&fname);
+	result = dns_db_findnode(db, name, false, &node);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_rdataset_init(&a);
+	dns_rdataset_init(&aaaa);
+	dns_db_findrdatasets(db, node, NULL, ARRAY_SIZE(types), types, 0,
+			     rdatasets, NULL, results);
+	assert_int_equal(results[0], ISC_R_SUCCESS);
+	assert_int_equal(a.type, dns_rdatatype_a);
+	assert_int_equal(dns_rdataset_count(&a), 1);
+	assert_int_equal(results[1], ISC_R_NOTFOUND);
+	assert_false(dns_rdataset_isassociated(&aaaa));
+	dns_rdataset_disassociate(&a);
+
+	dns_db_detachnode(db, &node);
+	dns_db_detach(&db);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY_CUSTOM(getoriginnode, setup_managers, teardown_managers)
 ISC_TEST_ENTRY_CUSTOM(getsetservestalettl, setup_managers, teardown_managers)
@@ -363,6 +452,8 @@ ISC_TEST_ENTRY_CUSTOM(dns_dbfind_staleok, setup_managers, teardown_managers)
 ISC_TEST_ENTRY_CUSTOM(class, setup_managers, teardown_managers)
 ISC_TEST_ENTRY_CUSTOM(dbtype, setup_managers, teardown_managers)
 ISC_TEST_ENTRY_CUSTOM(version, setup_managers, teardown_managers)
+ISC_TEST_ENTRY_CUSTOM(shareslabs, setup_managers, teardown_managers)
+ISC_TEST_ENTRY_CUSTOM(findrdatasets, setup_managers, teardown_managers)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
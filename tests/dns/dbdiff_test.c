@@ -30,6 +30,15 @@
 #include <dns/journal.h>
 #include <dns/name.h>
 
+/* Include the main file */
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wshadow"
+#undef CHECK
+#include "journal.c"
+#pragma GCC diagnostic pop
+
+#undef CHECK
 #include <tests/dns.h>
 
 #define BUFLEN	    255
@@ -135,10 +144,123 @@ ISC_RUN_TEST_IMPL(diffx_remove) {
 	dns_db_detach(&olddb);
 }
 
+#define SHARD_NAMES (3 * DIFF_SHARDNODES)
+
+/*
+ * Write a zone of SHARD_NAMES names to 'filename'.  The new version of
+ * the zone changes the address of every third name, lacks every fifth
+ * name and has an extra name after every fourth one, so that there are
+ * differences on both sides of every shard boundary.
+ */
+static void
+shard_zone(const char *filename, bool newer) {
+	FILE *fp = fopen(filename, "w");
+	assert_non_null(fp);
+
+	fprintf(fp, "$TTL 300\n");
+	fprintf(fp, "@ SOA ns.test. hostmaster.test. %u 3600 1200 604800 300\n",
+		newer ? 2 : 1);
+	fprintf(fp, "@ NS ns.test.\n");
+	for (unsigned int i = 0; i < SHARD_NAMES; i++) {
+		if (newer && i % 5 == 0) {
+			continue;
+		}
+		fprintf(fp, "n%05u A 10.%u.%u.%u\n", i,
+			(unsigned int)(newer && i % 3 == 0), i / 256, i % 256);
+		if (newer && i % 4 == 0) {
+			fprintf(fp, "n%05ua TXT \"new\"\n", i);
+		}
+	}
+
+	assert_int_equal(fclose(fp), 0);
+}
+
+static void
+assert_diff_equal(dns_diff_t *a, dns_diff_t *b) {
+	dns_difftuple_t *ta = ISC_LIST_HEAD(a->tuples);
+	dns_difftuple_t *tb = ISC_LIST_HEAD(b->tuples);
+
+	while (ta != NULL && tb != NULL) {
+		assert_int_equal(ta->op, tb->op);
+		assert_true(dns_name_equal(&ta->name, &tb->name));
+		assert_int_equal(ta->ttl, tb->ttl);
+		assert_int_equal(dns_rdata_compare(&ta->rdata, &tb->rdata), 0);
+		ta = ISC_LIST_NEXT(ta, link);
+		tb = ISC_LIST_NEXT(tb, link);
+	}
+	assert_null(ta);
+	assert_null(tb);
+}
+
+/* the shards of a big zone add up to the diff of a single walk */
+ISC_RUN_TEST_IMPL(diffx_shards) {
+	dns_db_t *newdb = NULL, *olddb = NULL;
+	dshard_t single = { .result = ISC_R_UNSET };
+	dshard_t shards[DIFF_THREADS];
+	unsigned int nshards = 0;
+	dns_diff_t joined, diff;
+	size_t count = 0;
+	isc_result_t result;
+
+	UNUSED(state);
+
+	shard_zone("dbdiff_test.old", false);
+	shard_zone("dbdiff_test.new", true);
+	test_create("dbdiff_test.old", &olddb, "dbdiff_test.new", &newdb);
+
+	dwork_t work = {
+		.db = { newdb, olddb },
+		.options = DNS_DB_NONSEC3,
+	};
+
+	/* the whole namespace in one walk */
+	dns_diff_init(mctx, &single.diff);
+	result = diff_range(&work, &single);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	/* the same namespace in shards */
+	memset(shards, 0, sizeof(shards));
+	result = split_namespace(&work, shards, DIFF_THREADS, &nshards);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_true(nshards > 1);
+
+	dns_diff_init(mctx, &joined);
+	for (unsigned int i = 0; i < nshards; i++) {
+		dns_diff_init(mctx, &shards[i].diff);
+		result = diff_range(&work, &shards[i]);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		ISC_LIST_APPENDLIST(joined.tuples, shards[i].diff.tuples,
+				    link);
+	}
+	assert_diff_equal(&single.diff, &joined);
+
+	/* the zones differ a lot, and dns_db_diffx() finds the same */
+	for (dns_difftuple_t *tuple = ISC_LIST_HEAD(joined.tuples);
+	     tuple != NULL; tuple = ISC_LIST_NEXT(tuple, link))
+	{
+		count++;
+	}
+	assert_true(count > SHARD_NAMES / 2);
+
+	dns_diff_init(mctx, &diff);
+	result = dns_db_diffx(&diff, newdb, NULL, olddb, NULL, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_diff_equal(&single.diff, &diff);
+
+	dns_diff_clear(&diff);
+	dns_diff_clear(&joined);
+	dns_diff_clear(&single.diff);
+	dns_db_detach(&newdb);
+	dns_db_detach(&olddb);
+	(void)unlink("dbdiff_test.old");
+	(void)unlink("dbdiff_test.new");
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY(diffx_same)
 ISC_TEST_ENTRY(diffx_add)
 ISC_TEST_ENTRY(diffx_remove)
+ISC_TEST_ENTRY(diffx_shards)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
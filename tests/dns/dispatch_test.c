@@ -24,6 +24,7 @@
 #define UNIT_TESTING
 #include <cmocka.h>
 
+#include <isc/async.h>
 #include <isc/buffer.h>
 #include <isc/managers.h>
 #include <isc/refcount.h>
@@ -800,6 +801,86 @@ ISC_LOOP_TEST_IMPL(dispatch_getnext) {
 	dns_dispatch_connect(test->dispentry);
 }
 
+static in_port_t reuse_port = 0;
+
+static void
+response_reuse(isc_result_t eresult, isc_region_t *region, void *arg);
+
+static void
+udp_reuse_add(void *arg) {
+	test_dispatch_t *test = arg;
+	isc_result_t result;
+
+	result = dns_dispatch_add(
+		test->dispatch, isc_loop_main(loopmgr), 0, T_CLIENT_CONNECT,
+		&udp_server_addr, NULL, NULL, connected, client_senddone,
+		response_reuse, test, &test->id, &test->dispentry);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	testdata.message[0] = (test->id >> 8) & 0xff;
+	testdata.message[1] = test->id & 0xff;
+
+	dns_dispatch_connect(test->dispentry);
+}
+
+static void
+response_reuse(isc_result_t eresult, isc_region_t *region ISC_ATTR_UNUSED,
+	       void *arg) {
+	test_dispatch_t *test = arg;
+	isc_sockaddr_t local;
+	isc_result_t result;
+
+	assert_int_equal(eresult, ISC_R_SUCCESS);
+
+	result = dns_dispentry_getlocaladdress(test->dispentry, &local);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	if (reuse_port == 0) {
+		/*
+		 * The socket is pooled once the response is released;
+		 * the next query to the same server must use it.
+		 */
+		reuse_port = isc_sockaddr_getport(&local);
+		dns_dispatch_done(&test->dispentry);
+		isc_async_current(udp_reuse_add, test);
+	} else {
+		assert_int_equal(isc_sockaddr_getport(&local), reuse_port);
+		test_dispatch_shutdown(test);
+	}
+}
+
+/* test reusing the UDP socket for the next query to the same server */
+ISC_LOOP_TEST_IMPL(dispatch_udp_reuse) {
+	isc_result_t result;
+	test_dispatch_t *test = isc_mem_get(mctx, sizeof(*test));
+	*test = (test_dispatch_t){ 0 };
+
+	reuse_port = 0;
+
+	/* Server */
+	result = isc_nm_listenudp(netmgr, ISC_NM_LISTEN_ONE, &udp_server_addr,
+				  nameserver, NULL, &sock);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	isc_loop_teardown(isc_loop_main(loopmgr), stop_listening, sock);
+
+	/* Client */
+	testdata.region.base = testdata.message;
+	testdata.region.length = sizeof(testdata.message);
+
+	result = dns_dispatchmgr_create(mctx, loopmgr, connect_nm,
+					&test->dispatchmgr);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_dispatchmgr_setudpreuse(test->dispatchmgr, true);
+
+	result = dns_dispatch_createudp(test->dispatchmgr, &udp_connect_addr,
+					&test->dispatch);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	udp_reuse_add(test);
+}
+
 ISC_LOOP_TEST_IMPL(dispatch_gettcp) {
 	isc_result_t result;
 	test_dispatch_t *test = isc_mem_get(mctx, sizeof(*test));
@@ -877,6 +958,7 @@ ISC_TEST_ENTRY_CUSTOM(dispatch_timeout_tcp_connect, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(dispatch_tcp_response, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(dispatch_tls_response, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(dispatch_getnext, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(dispatch_udp_reuse, setup_test, teardown_test)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
@@ -299,6 +299,75 @@ ISC_LOOP_TEST_IMPL(dns_dt_send) {
 	isc_loopmgr_shutdown(loopmgr);
 }
 
+/* only the sampled dnstap messages are sent */
+ISC_LOOP_TEST_IMPL(dns_dt_sample) {
+	isc_result_t result;
+	dns_dtenv_t *dtenv = NULL;
+	dns_dthandle_t *handle = NULL;
+	dns_view_t *view = NULL;
+	struct fstrm_iothr_options *fopt = NULL;
+	unsigned char msgbuffer[4096];
+	isc_buffer_t msg;
+	size_t msgsize;
+	uint8_t *data = NULL;
+	size_t dsize;
+	unsigned int n = 0;
+
+	result = dns_test_makeview("test", false, false, &view);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	fopt = fstrm_iothr_options_init();
+	assert_non_null(fopt);
+	fstrm_iothr_options_set_num_input_queues(fopt, 1);
+
+	result = dns_dt_create(mctx, dns_dtmode_file, TAPFILE, &fopt, NULL,
+			       &dtenv);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_dt_setsample(dtenv, 4);
+
+	dns_dt_attach(dtenv, &view->dtenv);
+	view->dttypes = DNS_DTTYPE_ALL;
+
+	result = dns_test_getdata(TESTS_DIR "/testdata/dnstap/query.auth",
+				  msgbuffer, sizeof(msgbuffer), &msgsize);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	isc_buffer_init(&msg, msgbuffer, msgsize);
+	isc_buffer_add(&msg, msgsize);
+
+	/* Message IDs 0 to 15, of which 0, 4, 8 and 12 are sent */
+	for (unsigned int id = 0; id < 16; id++) {
+		msgbuffer[0] = 0;
+		msgbuffer[1] = id;
+		dns_dt_send(view, DNS_DTTYPE_AQ, NULL, NULL, DNS_TRANSPORT_UDP,
+			    NULL, NULL, NULL, &msg);
+	}
+
+	dns_dt_detach(&view->dtenv);
+	dns_dt_detach(&dtenv);
+	dns_view_detach(&view);
+
+	result = dns_dt_open(TAPFILE, dns_dtmode_file, mctx, &handle);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	while (dns_dt_getframe(handle, &data, &dsize) == ISC_R_SUCCESS) {
+		dns_dtdata_t *dtdata = NULL;
+		isc_region_t r = { .base = data, .length = dsize };
+
+		result = dns_dt_parse(mctx, &r, &dtdata);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_int_equal(dtdata->type, DNS_DTTYPE_AQ);
+		assert_int_equal(dtdata->msg->id, 4 * n);
+		n++;
+
+		dns_dtdata_free(&dtdata);
+	}
+	assert_int_equal(n, 4);
+
+	dns_dt_close(&handle);
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
 /* dnstap message to text */
 ISC_LOOP_TEST_IMPL(dns_dt_totext) {
 	isc_result_t result;
@@ -367,6 +436,7 @@ ISC_TEST_LIST_START
 
 ISC_TEST_ENTRY_CUSTOM(dns_dt_create, setup, teardown)
 ISC_TEST_ENTRY_CUSTOM(dns_dt_send, setup, teardown)
+ISC_TEST_ENTRY_CUSTOM(dns_dt_sample, setup, teardown)
 ISC_TEST_ENTRY_CUSTOM(dns_dt_totext, setup, teardown)
 
 ISC_TEST_LIST_END
@@ -483,10 +483,116 @@ ISC_RUN_TEST_IMPL(ecdsa_determinism_test) {
 	dst_key_free(&key);
 }
 
+/* keys parsed from the same DNSKEY rdata are shared */
+ISC_RUN_TEST_IMPL(keycache_test) {
+	isc_result_t result;
+	isc_buffer_t keybuf, b;
+	unsigned char data[DST_KEY_MAXSIZE];
+	dns_fixedname_t fname, fupper;
+	dns_name_t *name = NULL, *upper = NULL;
+	dst_key_t *key = NULL, *key1 = NULL, *key2 = NULL, *key3 = NULL;
+
+	name = dns_fixedname_initname(&fname);
+	isc_buffer_constinit(&keybuf, "example.", strlen("example."));
+	isc_buffer_add(&keybuf, strlen("example."));
+	result = dns_name_fromtext(name, &keybuf, dns_rootname, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dst_key_fromfile(name, 19786, DST_ALG_ECDSA256,
+				  DST_TYPE_PUBLIC, TESTS_DIR "/comparekeys",
+				  mctx, &key);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	isc_buffer_init(&b, data, sizeof(data));
+	result = dst_key_todns(key, &b);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dst_key_fromdns_cached(name, dns_rdataclass_in, &b, &key1);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(isc_buffer_remaininglength(&b), 0);
+	assert_true(dst_key_compare(key, key1));
+
+	isc_buffer_first(&b);
+	result = dst_key_fromdns_cached(name, dns_rdataclass_in, &b, &key2);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(isc_buffer_remaininglength(&b), 0);
+	assert_ptr_equal(key1, key2);
+
+	/* the owner name is compared case insensitively */
+	upper = dns_fixedname_initname(&fupper);
+	isc_buffer_constinit(&keybuf, "EXAMPLE.", strlen("EXAMPLE."));
+	isc_buffer_add(&keybuf, strlen("EXAMPLE."));
+	result = dns_name_fromtext(upper, &keybuf, dns_rootname, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	isc_buffer_first(&b);
+	result = dst_key_fromdns_cached(upper, dns_rdataclass_in, &b, &key3);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_ptr_equal(key1, key3);
+	dst_key_free(&key3);
+
+	/* but not the class */
+	isc_buffer_first(&b);
+	result = dst_key_fromdns_cached(name, dns_rdataclass_ch, &b, &key3);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_ptr_not_equal(key1, key3);
+	dst_key_free(&key3);
+
+	dst_key_free(&key2);
+	dst_key_free(&key1);
+	dst_key_free(&key);
+}
+
+/* keys read through the file cache are private copies */
+ISC_RUN_TEST_IMPL(filecache_test) {
+	isc_result_t result;
+	dst_key_t *key1 = NULL, *key2 = NULL, *key3 = NULL;
+	isc_stdtime_t when;
+	int type = DST_TYPE_PUBLIC | DST_TYPE_PRIVATE;
+
+	result = dst_key_fromnamedfile_cached("Kexample.+013+19786.private",
+					      TESTS_DIR "/comparekeys", type,
+					      mctx, &key1);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_true(dst_key_isprivate(key1));
+
+	result = dst_key_fromnamedfile_cached("Kexample.+013+19786.private",
+					      TESTS_DIR "/comparekeys", type,
+					      mctx, &key2);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_ptr_not_equal(key1, key2);
+	assert_true(dst_key_compare(key1, key2));
+	assert_true(dst_key_isprivate(key2));
+	assert_int_equal(dst_key_id(key1), dst_key_id(key2));
+
+	/* changing one copy leaves the others alone */
+	dst_key_settime(key1, DST_TIME_INACTIVE, 1);
+	result = dst_key_fromnamedfile_cached("Kexample.+013+19786.private",
+					      TESTS_DIR "/comparekeys", type,
+					      mctx, &key3);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(dst_key_gettime(key2, DST_TIME_INACTIVE, &when),
+			 ISC_R_NOTFOUND);
+	assert_int_equal(dst_key_gettime(key3, DST_TIME_INACTIVE, &when),
+			 ISC_R_NOTFOUND);
+
+	/* a missing key is not found, cached or not */
+	dst_key_free(&key3);
+	result = dst_key_fromnamedfile_cached("Kexample.+013+00001.private",
+					      TESTS_DIR "/comparekeys", type,
+					      mctx, &key3);
+	assert_int_equal(result, ISC_R_FILENOTFOUND);
+	assert_null(key3);
+
+	dst_key_free(&key2);
+	dst_key_free(&key1);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY(sig_test)
 ISC_TEST_ENTRY(cmp_test)
 ISC_TEST_ENTRY(ecdsa_determinism_test)
+ISC_TEST_ENTRY(keycache_test)
+ISC_TEST_ENTRY(filecache_test)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
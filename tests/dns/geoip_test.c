@@ -89,6 +89,7 @@ load_geoip(const char *dir) {
 
 static void
 close_geoip(void) {
+	dns_geoip_flush();
 	MMDB_close(&geoip_country);
 	MMDB_close(&geoip_city);
 	MMDB_close(&geoip_as);
@@ -25,6 +25,7 @@
 #include <cmocka.h>
 
 #include <isc/dir.h>
+#include <isc/file.h>
 #include <isc/string.h>
 #include <isc/util.h>
 
@@ -457,6 +458,7 @@ ISC_RUN_TEST_IMPL(dumpraw) {
 	dns_name_t dnsorigin;
 	isc_buffer_t source, target;
 	unsigned char namebuf[BUFLEN];
+	off_t size;
 	int len;
 
 	UNUSED(state);
@@ -515,6 +517,29 @@ ISC_RUN_TEST_IMPL(dumpraw) {
 	assert_true((header.flags & DNS_MASTERRAW_SOURCESERIALSET) != 0);
 	assert_int_equal(header.sourceserial, 12345);
 
+	/* Version 2, with an index */
+	dns_master_initrawheader(&header);
+	header.flags |= DNS_MASTERRAW_INDEXED;
+
+	unlink("test.dump");
+	result = dns_master_dump(mctx, db, version, &dns_master_style_default,
+				 "test.dump", dns_masterformat_raw, &header);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = test_master(NULL, "test.dump", dns_masterformat_raw, nullmsg,
+			     nullmsg);
+	assert_string_equal(isc_result_totext(result), "success");
+	assert_true(headerset);
+	assert_int_equal(header.version, DNS_RAWFORMAT_INDEXED);
+
+	/* A truncated file is rejected */
+	result = isc_file_getsize("test.dump", &size);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(truncate("test.dump", size - 1), 0);
+	result = test_master(NULL, "test.dump", dns_masterformat_raw, nullmsg,
+			     nullmsg);
+	assert_int_equal(result, ISC_R_RANGE);
+
 	unlink("test.dump");
 	dns_db_closeversion(db, &version, false);
 	dns_db_detach(&db);
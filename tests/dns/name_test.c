@@ -452,6 +452,110 @@ ISC_RUN_TEST_IMPL(collision) {
 	dns_compress_invalidate(&cctx);
 }
 
+/*
+ * test reusing a compression context for another message
+ */
+ISC_RUN_TEST_IMPL(compression_reset) {
+	isc_result_t result;
+	dns_compress_t cctx;
+	isc_buffer_t message;
+	uint8_t msgbuf[512];
+	dns_fixedname_t fname;
+	dns_name_t *name = NULL;
+	unsigned int prefix_len, suffix_coff;
+
+	UNUSED(state);
+
+	name = dns_fixedname_initname(&fname);
+	result = dns_name_fromstring(name, "www.example.", NULL, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_compress_init(&cctx, mctx, DNS_COMPRESS_LARGE);
+
+	for (int i = 0; i < 2; i++) {
+		isc_buffer_init(&message, msgbuf, sizeof(msgbuf));
+		isc_buffer_putuint16(&message, 0xEAD);
+
+		/* nothing from the previous message can be matched */
+		prefix_len = name->length;
+		suffix_coff = 0;
+		dns_compress_name(&cctx, &message, name, &prefix_len,
+				  &suffix_coff);
+		assert_int_equal(prefix_len, name->length);
+		assert_int_equal(suffix_coff, 0);
+		dns_compress_rollback(&cctx, 2);
+
+		result = dns_name_towire(name, &cctx, &message, NULL);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_int_not_equal(cctx.count, 0);
+
+		prefix_len = name->length;
+		suffix_coff = 0;
+		dns_compress_name(&cctx, &message, name, &prefix_len,
+				  &suffix_coff);
+		assert_int_equal(prefix_len, 0);
+		assert_int_equal(suffix_coff, 2);
+
+		dns_compress_setpermitted(&cctx, false);
+		dns_compress_reset(&cctx);
+		assert_int_equal(cctx.count, 0);
+		assert_true(dns_compress_getpermitted(&cctx));
+	}
+
+	dns_compress_invalidate(&cctx);
+}
+
+/*
+ * test that a small compression context grows when it fills up
+ */
+ISC_RUN_TEST_IMPL(compression_grow) {
+	isc_result_t result;
+	dns_compress_t cctx;
+	isc_buffer_t message;
+	uint8_t msgbuf[4096];
+	dns_fixedname_t fname;
+	dns_name_t *name = NULL;
+	char namebuf[64];
+	unsigned int coff[200];
+	unsigned int prefix_len, suffix_coff;
+
+	UNUSED(state);
+
+	name = dns_fixedname_initname(&fname);
+
+	dns_compress_init(&cctx, mctx, 0);
+	isc_buffer_init(&message, msgbuf, sizeof(msgbuf));
+	isc_buffer_putuint16(&message, 0xEAD);
+
+	for (unsigned int i = 0; i < ARRAY_SIZE(coff); i++) {
+		snprintf(namebuf, sizeof(namebuf), "n%u.example.", i);
+		result = dns_name_fromstring(name, namebuf, NULL, 0, NULL);
+		assert_int_equal(result, ISC_R_SUCCESS);
+
+		coff[i] = isc_buffer_usedlength(&message);
+		result = dns_name_towire(name, &cctx, &message, NULL);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+
+	assert_ptr_not_equal(cctx.set, cctx.smallset);
+
+	/* every name can still be found, including the early ones */
+	for (unsigned int i = 0; i < ARRAY_SIZE(coff); i++) {
+		snprintf(namebuf, sizeof(namebuf), "n%u.example.", i);
+		result = dns_name_fromstring(name, namebuf, NULL, 0, NULL);
+		assert_int_equal(result, ISC_R_SUCCESS);
+
+		prefix_len = name->length;
+		suffix_coff = 0;
+		dns_compress_name(&cctx, &message, name, &prefix_len,
+				  &suffix_coff);
+		assert_int_equal(prefix_len, 0);
+		assert_int_equal(suffix_coff, coff[i]);
+	}
+
+	dns_compress_invalidate(&cctx);
+}
+
 ISC_RUN_TEST_IMPL(fromregion) {
 	dns_name_t name;
 	isc_buffer_t b;
@@ -1006,6 +1110,8 @@ ISC_TEST_LIST_START
 ISC_TEST_ENTRY(fullcompare)
 ISC_TEST_ENTRY(compression)
 ISC_TEST_ENTRY(collision)
+ISC_TEST_ENTRY(compression_reset)
+ISC_TEST_ENTRY(compression_grow)
 ISC_TEST_ENTRY(fromregion)
 ISC_TEST_ENTRY(istat)
 ISC_TEST_ENTRY(init)
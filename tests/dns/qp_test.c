@@ -128,6 +128,75 @@ ISC_RUN_TEST_IMPL(qpkey_name) {
 	}
 }
 
+/*
+ * This is how dns_qpkey_fromname() converts names without the vector
+ * code, one byte at a time.
+ */
+static size_t
+qpkey_fromname_bytes(dns_qpkey_t key, const dns_name_t *name) {
+	size_t len = 0, label = name->labels;
+
+	while (label-- > 0) {
+		const uint8_t *ldata = name->ndata + name->offsets[label];
+		size_t label_len = *ldata++;
+		while (label_len-- > 0) {
+			uint16_t bits = dns_qp_bits_for_byte[*ldata++];
+			key[len++] = bits & 0xFF;
+			if ((bits >> 8) != 0) {
+				key[len++] = bits >> 8;
+			}
+		}
+		key[len++] = SHIFT_NOBYTE;
+	}
+	key[len] = SHIFT_NOBYTE;
+	return len;
+}
+
+/* keys match the byte at a time conversion, whatever the labels contain */
+ISC_RUN_TEST_IMPL(qpkey_bytes) {
+	static const char hostchars[] = "abcdefghijklmnopqrstuvwxyz"
+					"ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+					"0123456789-_";
+	const size_t nchars = sizeof(hostchars) - 1;
+
+	for (size_t i = 0; i < 100000; i++) {
+		uint8_t wire[DNS_NAME_MAXWIRE];
+		size_t wirelen = 0, keylen;
+		isc_region_t r;
+		dns_fixedname_t fn;
+		dns_name_t *name = dns_fixedname_initname(&fn);
+		dns_qpkey_t key, expected;
+
+		/* a few labels, mostly of hostname characters */
+		for (size_t labels = isc_random_uniform(5); labels > 0;
+		     labels--)
+		{
+			size_t label_len = 1 + isc_random_uniform(40);
+			if (wirelen + label_len + 2 > sizeof(wire)) {
+				break;
+			}
+			wire[wirelen++] = label_len;
+			while (label_len-- > 0) {
+				size_t c = isc_random_uniform(nchars + 1);
+				if (c < nchars) {
+					wire[wirelen++] = hostchars[c];
+				} else {
+					wire[wirelen++] = isc_random8();
+				}
+			}
+		}
+		wire[wirelen++] = 0;
+
+		r.base = wire;
+		r.length = wirelen;
+		dns_name_fromregion(name, &r);
+
+		keylen = dns_qpkey_fromname(key, name);
+		assert_int_equal(keylen, qpkey_fromname_bytes(expected, name));
+		assert_memory_equal(key, expected, keylen + 1);
+	}
+}
+
 ISC_RUN_TEST_IMPL(qpkey_sort) {
 	struct {
 		const char *namestr;
@@ -512,6 +581,252 @@ ISC_RUN_TEST_IMPL(partialmatch) {
 	dns_qp_destroy(&qp);
 }
 
+static void
+check_getnames(dns_qp_t *qp, const char *queries[], size_t count) {
+	dns_fixedname_t fn[40];
+	const dns_name_t *names[40];
+	isc_result_t results[40];
+	void *pvals[40];
+
+	INSIST(count <= ARRAY_SIZE(names));
+
+	for (size_t i = 0; i < count; i++) {
+		dns_test_namefromstring(queries[i], &fn[i]);
+		names[i] = dns_fixedname_name(&fn[i]);
+		pvals[i] = NULL;
+	}
+
+	dns_qp_getnames(qp, names, count, results, pvals, NULL);
+
+	for (size_t i = 0; i < count; i++) {
+		void *pval = NULL;
+		isc_result_t result = dns_qp_getname(qp, names[i], &pval,
+						     NULL);
+		assert_int_equal(results[i], result);
+		assert_ptr_equal(pvals[i], pval);
+	}
+}
+
+/* batched lookups match the single lookups */
+ISC_RUN_TEST_IMPL(getnames) {
+	dns_qp_t *qp = NULL;
+	const char *queries[40];
+	size_t count = 0;
+
+	/*
+	 * Fixed size strings [16] should ensure leaf-compatible alignment.
+	 */
+	const char insert[][16] = {
+		"a.b.",	     "b.",	     "fo.bar.", "foo.bar.", "fooo.bar.",
+		"web.foo.bar.", "x.",	     "y.",	"z.y.",	    "",
+	};
+
+	/* nothing is found in an empty trie */
+	dns_qp_create(mctx, &string_methods, NULL, &qp);
+	queries[0] = "a.b.";
+	queries[1] = "foo.bar.";
+	check_getnames(qp, queries, 2);
+
+	/* or in a trie whose root is a leaf */
+	insert_str(qp, insert[0]);
+	check_getnames(qp, queries, 2);
+
+	for (size_t i = 1; insert[i][0] != '\0'; i++) {
+		insert_str(qp, insert[i]);
+	}
+
+	/* more names than fit in one batch, found or not */
+	for (size_t i = 0; count < ARRAY_SIZE(queries); i++) {
+		static const char *other[] = {
+			"b.c.", "bar.", "f.bar.", "www.foo.bar.", "y.z.",
+		};
+		if (insert[i % 10][0] != '\0') {
+			queries[count++] = insert[i % 10];
+		}
+		if (count < ARRAY_SIZE(queries)) {
+			queries[count++] = other[i % ARRAY_SIZE(other)];
+		}
+	}
+	INSIST(count > DNS_QP_BATCH);
+	check_getnames(qp, queries, count);
+
+	dns_qp_destroy(&qp);
+}
+
+static isc_result_t
+savestring(void *arg, void *pval, uint32_t *ivalp, isc_buffer_t *payload) {
+	UNUSED(arg);
+	UNUSED(ivalp);
+	isc_buffer_putstr(payload, pval);
+	isc_buffer_putuint8(payload, 0);
+	return ISC_R_SUCCESS;
+}
+
+static dns_qpimage_t *test_image = NULL;
+
+static size_t
+qpkey_fromimage(dns_qpkey_t key, void *uctx, void *pval, uint32_t ival) {
+	return qpkey_fromstring(key, uctx,
+				UNCONST(dns_qpimage_payload(test_image, pval)),
+				ival);
+}
+
+const dns_qpmethods_t image_methods = {
+	no_op,
+	no_op,
+	qpkey_fromimage,
+	getname,
+};
+
+/* a trie saved as an image can be searched in place */
+ISC_RUN_TEST_IMPL(qpimage) {
+	isc_result_t result;
+	dns_qp_t *qp = NULL;
+	dns_qpreader_t *reader = NULL;
+	dns_qpiter_t it;
+	dns_fixedname_t fixed;
+	void *pval = NULL;
+	const char *filename = "qp_test.image";
+	size_t count = 0;
+
+	/*
+	 * Fixed size strings [16] should ensure leaf-compatible alignment.
+	 */
+	const char insert[][16] = {
+		"a.b.",	     "b.",	     "fo.bar.", "foo.bar.",
+		"fooo.bar.", "web.foo.bar.", ".",	"",
+	};
+
+	/* an empty trie */
+	dns_qp_create(mctx, &string_methods, NULL, &qp);
+	result = dns_qp_saveimage(qp, mctx, filename, savestring, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_qpimage_open(mctx, filename, &image_methods, NULL,
+				  &test_image);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	reader = dns_qpimage_reader(test_image);
+	result = dns_qp_getname(reader, dns_rootname, NULL, NULL);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+	dns_qpimage_destroy(&test_image);
+
+	for (size_t i = 0; insert[i][0] != '\0'; i++) {
+		insert_str(qp, insert[i]);
+	}
+	result = dns_qp_saveimage(qp, mctx, filename, savestring, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_qpimage_open(mctx, filename, &image_methods, NULL,
+				  &test_image);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	reader = dns_qpimage_reader(test_image);
+
+	for (size_t i = 0; insert[i][0] != '\0'; i++) {
+		dns_fixedname_t fn1, fn2;
+		dns_name_t *name = dns_fixedname_initname(&fn1);
+		dns_name_t *found = dns_fixedname_initname(&fn2);
+
+		dns_test_namefromstring(insert[i], &fn1);
+		result = dns_qp_lookup(reader, name, found, NULL, NULL, &pval,
+				       NULL);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_true(dns_name_equal(name, found));
+		assert_string_equal(dns_qpimage_payload(test_image, pval),
+				    insert[i]);
+	}
+
+	dns_qpiter_init(reader, &it);
+	while (dns_qpiter_next(&it, NULL, NULL, NULL) == ISC_R_SUCCESS) {
+		count++;
+	}
+	assert_int_equal(count, ARRAY_SIZE(insert) - 1);
+
+	dns_test_namefromstring("www.b.c.", &fixed);
+	result = dns_qp_lookup(reader, dns_fixedname_name(&fixed), NULL, NULL,
+			       NULL, &pval, NULL);
+	assert_int_equal(result, DNS_R_PARTIALMATCH);
+	assert_string_equal(dns_qpimage_payload(test_image, pval), ".");
+
+	dns_qpimage_destroy(&test_image);
+	assert_null(test_image);
+	dns_qp_destroy(&qp);
+	(void)unlink(filename);
+}
+
+/* a trie built from sorted leaves is the same as one built by inserting */
+ISC_RUN_TEST_IMPL(qpbuild) {
+	static char names[200][32];
+	void *sorted[ARRAY_SIZE(names)];
+	dns_qp_t *qp = NULL, *built = NULL;
+	dns_qpbuild_t *build = NULL;
+	dns_qpiter_t it1, it2;
+	dns_qp_memusage_t memusage;
+	void *pval1 = NULL, *pval2 = NULL;
+	size_t count = 0;
+	isc_result_t result;
+
+	dns_qp_create(mctx, &string_methods, NULL, &qp);
+	for (size_t i = 0; i < ARRAY_SIZE(names); i++) {
+		snprintf(names[i], sizeof(names[i]), "%u.x%u.%s.",
+			 isc_random_uniform(1000), isc_random_uniform(20),
+			 i % 2 == 0 ? "a" : "b-c");
+		(void)dns_qp_insert(qp, names[i], 0);
+	}
+
+	dns_qpiter_init(qp, &it1);
+	while (dns_qpiter_next(&it1, NULL, &pval1, NULL) == ISC_R_SUCCESS) {
+		sorted[count++] = pval1;
+	}
+
+	dns_qp_create(mctx, &string_methods, NULL, &built);
+	dns_qpbuild_start(built, &build);
+	for (size_t i = 0; i < count; i++) {
+		result = dns_qpbuild_add(build, sorted[i], 0);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+	result = dns_qpbuild_add(build, sorted[count - 1], 0);
+	assert_int_equal(result, ISC_R_EXISTS);
+	result = dns_qpbuild_add(build, sorted[0], 0);
+	assert_int_equal(result, ISC_R_RANGE);
+	dns_qpbuild_finish(&build);
+	assert_null(build);
+
+	dns_qpiter_init(qp, &it1);
+	dns_qpiter_init(built, &it2);
+	for (size_t i = 0; i < count; i++) {
+		result = dns_qpiter_next(&it1, NULL, &pval1, NULL);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		result = dns_qpiter_next(&it2, NULL, &pval2, NULL);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_ptr_equal(pval1, pval2);
+
+		dns_fixedname_t fixed;
+		dns_test_namefromstring(pval1, &fixed);
+		result = dns_qp_getname(built, dns_fixedname_name(&fixed),
+					&pval2, NULL);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_ptr_equal(pval1, pval2);
+	}
+	result = dns_qpiter_next(&it2, NULL, NULL, NULL);
+	assert_int_equal(result, ISC_R_NOMORE);
+
+	/* nothing was wasted */
+	memusage = dns_qp_memusage(built);
+	assert_int_equal(memusage.leaves, count);
+	assert_int_equal(memusage.free, 0);
+	assert_int_equal(memusage.live, memusage.used);
+
+	/* the trie can be modified as usual */
+	dns_fixedname_t fixed;
+	dns_test_namefromstring(sorted[0], &fixed);
+	result = dns_qp_deletename(built, dns_fixedname_name(&fixed), NULL,
+				   NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_qp_insert(built, sorted[0], 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_qp_destroy(&built);
+	dns_qp_destroy(&qp);
+}
+
 struct check_qpchain {
 	const char *query;
 	isc_result_t result;
@@ -927,14 +1242,116 @@ ISC_RUN_TEST_IMPL(fixiterator) {
 	dns_qp_destroy(&qp);
 }
 
+#define REGION_ITEMS (1U << 20)
+
+static size_t
+region_makekey(dns_qpkey_t key, void *uctx, void *pval, uint32_t ival) {
+	UNUSED(uctx);
+	UNUSED(pval);
+
+	char str[16];
+	snprintf(str, sizeof(str), "%07u", ival);
+
+	size_t i = 0;
+	while (str[i] != '\0') {
+		key[i] = str[i] - '0' + SHIFT_BITMAP;
+		i++;
+	}
+	key[i++] = SHIFT_NOBYTE;
+
+	return i;
+}
+
+const dns_qpmethods_t region_methods = {
+	no_op,
+	no_op,
+	region_makekey,
+	getname,
+};
+
+/* a big trie uses huge page regions, and frees them when it shrinks */
+ISC_RUN_TEST_IMPL(qpregions) {
+	dns_qp_t *qp = NULL;
+	dns_qp_memusage_t memusage;
+	uint32_t *item = isc_mem_cget(mctx, REGION_ITEMS, sizeof(*item));
+	size_t before = isc_mem_inuse(mctx);
+	size_t count = 0;
+
+	dns_qp_create(mctx, &region_methods, NULL, &qp);
+	dns_qp_sethugepages(qp);
+
+	/* a small trie uses ordinary chunks */
+	for (count = 0; count < 1000; count++) {
+		item[count] = count;
+		assert_int_equal(dns_qp_insert(qp, &item[count], count),
+				 ISC_R_SUCCESS);
+	}
+	memusage = dns_qp_memusage(qp);
+	assert_int_equal(memusage.region_count, 0);
+	assert_int_equal(memusage.hugepage_bytes, 0);
+
+	/* until it has grown past the threshold */
+	while (count < REGION_ITEMS && memusage.region_count == 0) {
+		item[count] = count;
+		assert_int_equal(dns_qp_insert(qp, &item[count], count),
+				 ISC_R_SUCCESS);
+		count++;
+		if (count % QP_CHUNK_SIZE == 0) {
+			memusage = dns_qp_memusage(qp);
+		}
+	}
+	assert_int_not_equal(memusage.region_count, 0);
+
+	/* grow it some more so that the regions hold most of the trie */
+	for (size_t end = count * 2; count < end; count++) {
+		item[count] = count;
+		assert_int_equal(dns_qp_insert(qp, &item[count], count),
+				 ISC_R_SUCCESS);
+	}
+
+	/* the whole regions are counted, instead of their chunks */
+	memusage = dns_qp_memusage(qp);
+	assert_int_equal(memusage.leaves, count);
+	assert_int_not_equal(memusage.region_count, 0);
+	assert_true(memusage.hugepage_bytes > 0);
+	assert_int_equal(memusage.hugepage_bytes % (2 * 1024 * 1024), 0);
+	assert_true(memusage.hugepage_bytes <= memusage.bytes);
+	assert_true(memusage.bytes >= memusage.used * memusage.node_size);
+	assert_true(memusage.bytes <= isc_mem_inuse(mctx) - before);
+
+	/* the regions are freed once the trie is empty */
+	for (size_t i = 0; i < count; i++) {
+		dns_qpkey_t key;
+		size_t len = region_makekey(key, NULL, NULL, i);
+		assert_int_equal(dns_qp_deletekey(qp, key, len, NULL, NULL),
+				 ISC_R_SUCCESS);
+	}
+	dns_qp_compact(qp, DNS_QPGC_ALL);
+
+	memusage = dns_qp_memusage(qp);
+	assert_int_equal(memusage.leaves, 0);
+	assert_int_equal(memusage.region_count, 0);
+	assert_int_equal(memusage.hugepage_bytes, 0);
+	assert_true(memusage.bytes <= isc_mem_inuse(mctx) - before);
+
+	dns_qp_destroy(&qp);
+	assert_int_equal(isc_mem_inuse(mctx), before);
+	isc_mem_cput(mctx, item, REGION_ITEMS, sizeof(*item));
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY(qpkey_name)
+ISC_TEST_ENTRY(qpkey_bytes)
 ISC_TEST_ENTRY(qpkey_sort)
 ISC_TEST_ENTRY(qpiter)
 ISC_TEST_ENTRY(partialmatch)
+ISC_TEST_ENTRY(getnames)
+ISC_TEST_ENTRY(qpimage)
+ISC_TEST_ENTRY(qpbuild)
 ISC_TEST_ENTRY(qpchain)
 ISC_TEST_ENTRY(predecessors)
 ISC_TEST_ENTRY(fixiterator)
+ISC_TEST_ENTRY(qpregions)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
@@ -210,9 +210,223 @@ ISC_LOOP_TEST_IMPL(overmempurge_longname) {
 	isc_loopmgr_shutdown(loopmgr);
 }
 
+static void
+overmempurge_find(dns_db_t *db, isc_stdtime_t now, const dns_name_t *name,
+		  dns_rdatatype_t rtype) {
+	isc_result_t result;
+	dns_fixedname_t ffound;
+	dns_rdataset_t rdataset = DNS_RDATASET_INIT;
+
+	result = dns_db_find(db, name, NULL, rtype, 0, now, NULL,
+			     dns_fixedname_initname(&ffound), &rdataset, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_rdataset_disassociate(&rdataset);
+}
+
+ISC_LOOP_TEST_IMPL(overmempurge_sieve) {
+	size_t maxcache = 2097152U; /* 2MB - same as DNS_CACHE_MINSIZE */
+	size_t hiwater = maxcache - (maxcache >> 3); /* borrowed from cache.c */
+	size_t lowater = maxcache - (maxcache >> 2); /* ditto */
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	isc_mem_t *mctx2 = NULL;
+	isc_stdtime_t now = isc_stdtime_now();
+	dns_fixedname_t fname;
+	dns_name_t *hotname = NULL;
+	char *argv[2] = { NULL, (char *)DNS_QPCACHE_SIEVE };
+	size_t i;
+
+	isc_mem_create(&mctx2);
+
+	argv[0] = (char *)mctx2;
+	result = dns_db_create(mctx2, CACHEDB_DEFAULT, dns_rootname,
+			       dns_dbtype_cache, dns_rdataclass_in, 2, argv,
+			       &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	isc_mem_setwater(mctx2, hiwater, lowater);
+
+	dns_test_namefromstring("0.example.com.", &fname);
+	hotname = dns_fixedname_name(&fname);
+
+	for (i = 0; !isc_mem_isovermem(mctx2) && i < (maxcache / 10); i++) {
+		overmempurge_addrdataset(db, now, i, 50053, 0, false);
+		if (i == 0) {
+			overmempurge_find(db, now, hotname, 50053);
+		}
+	}
+	assert_true(isc_mem_isovermem(mctx2));
+
+	/*
+	 * Flood the cache with large entries used only once, while the
+	 * entry at 0.example.com keeps being used: SIEVE should keep it
+	 * in the cache and evict the others instead.
+	 */
+	while (i-- > 1) {
+		overmempurge_find(db, now, hotname, 50053);
+		overmempurge_addrdataset(db, now, i, 50054, 65535, false);
+		if (verbose) {
+			print_message("# inuse: %zd max: %zd\n",
+				      isc_mem_inuse(mctx2), maxcache);
+		}
+		assert_true(isc_mem_inuse(mctx2) < maxcache);
+	}
+
+	dns_db_detach(&db);
+	isc_mem_destroy(&mctx2);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/*
+ * Add to 'db' a negative cache entry for <idx>.example.com holding the
+ * SOA of example.com, and an NSEC record as well if 'nsec' is true.
+ */
+static void
+ncache_addrdataset(dns_db_t *db, isc_stdtime_t now, int idx, bool nsec) {
+	static const unsigned char apex[] = "\007example\003com";
+	isc_result_t result;
+	dns_rdata_t rdata[2] = { DNS_RDATA_INIT, DNS_RDATA_INIT };
+	unsigned char data[2][64];
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	dns_dbnode_t *node = NULL;
+	dns_fixedname_t fname;
+	char namebuf[DNS_NAME_FORMATSIZE];
+
+	snprintf(namebuf, sizeof(namebuf), "%d.example.com.", idx);
+	dns_test_namefromstring(namebuf, &fname);
+
+	result = dns_db_findnode(db, dns_fixedname_name(&fname), true, &node);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.rdclass = dns_rdataclass_in;
+	rdatalist.covers = dns_rdatatype_any;
+	rdatalist.ttl = 3600;
+
+	for (size_t i = 0; i < (nsec ? 2 : 1); i++) {
+		/* An SOA of root names and zero timers, or an NSEC to root */
+		dns_rdatatype_t type = (i == 0) ? dns_rdatatype_soa
+						: dns_rdatatype_nsec;
+		unsigned int length = (i == 0) ? 22 : 1;
+		isc_buffer_t b;
+
+		isc_buffer_init(&b, data[i], sizeof(data[i]));
+		isc_buffer_putmem(&b, apex, sizeof(apex));
+		isc_buffer_putuint16(&b, type);
+		isc_buffer_putuint8(&b, dns_trust_authauthority);
+		isc_buffer_putuint16(&b, 1);
+		isc_buffer_putuint16(&b, length);
+		for (unsigned int j = 0; j < length; j++) {
+			isc_buffer_putuint8(&b, 0);
+		}
+
+		rdata[i].data = data[i];
+		rdata[i].length = isc_buffer_usedlength(&b);
+		rdata[i].rdclass = dns_rdataclass_in;
+		ISC_LIST_APPEND(rdatalist.rdata, &rdata[i], link);
+	}
+
+	dns_rdataset_init(&rdataset);
+	dns_rdatalist_tordataset(&rdatalist, &rdataset);
+	rdataset.trust = dns_trust_authauthority;
+	rdataset.attributes |= DNS_RDATASETATTR_NEGATIVE |
+			       DNS_RDATASETATTR_NXDOMAIN;
+
+	result = dns_db_addrdataset(db, node, NULL, now, &rdataset, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_db_detachnode(db, &node);
+}
+
+/* identical negative entries holding only the SOA share their rdata */
+ISC_LOOP_TEST_IMPL(ncache_share) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	qpcache_t *qpdb = NULL;
+	isc_stdtime_t now = isc_stdtime_now();
+	uint64_t shared;
+
+	result = dns_db_create(mctx, CACHEDB_DEFAULT, dns_rootname,
+			       dns_dbtype_cache, dns_rdataclass_in, 0, NULL,
+			       &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	qpdb = (qpcache_t *)db;
+
+	ncache_addrdataset(db, now, 1, false);
+	assert_int_equal(isc_hashmap_count(qpdb->slabs), 1);
+	assert_int_equal(dns_db_getsharedsize(db), 0);
+
+	ncache_addrdataset(db, now, 2, false);
+	assert_int_equal(isc_hashmap_count(qpdb->slabs), 1);
+	shared = dns_db_getsharedsize(db);
+	assert_true(shared > 0);
+
+	/* entries with DNSSEC proofs are kept to themselves */
+	ncache_addrdataset(db, now, 3, true);
+	assert_int_equal(isc_hashmap_count(qpdb->slabs), 1);
+	assert_int_equal(dns_db_getsharedsize(db), shared);
+
+	/* the shared slab is released with the last entry */
+	dns_db_detach(&db);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/* expired headers found by lookups are left to the sweeper */
+ISC_LOOP_TEST_IMPL(sweep_expired) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	qpcache_t *qpdb = NULL;
+	isc_stdtime_t now = isc_stdtime_now();
+	char namebuf[DNS_NAME_FORMATSIZE];
+
+	result = dns_db_create(mctx, CACHEDB_DEFAULT, dns_rootname,
+			       dns_dbtype_cache, dns_rdataclass_in, 0, NULL,
+			       &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	qpdb = (qpcache_t *)db;
+
+	/* entries added a day ago with a TTL of an hour */
+	for (int i = 0; i < 100; i++) {
+		overmempurge_addrdataset(db, now - 86400, i, 50053, 0, false);
+	}
+
+	/*
+	 * No node is referenced when the lookups find the expired headers,
+	 * so the runs of the sweeper they schedule reference the buckets.
+	 */
+	for (int i = 0; i < 100; i++) {
+		dns_fixedname_t fname, ffound;
+		dns_rdataset_t rdataset = DNS_RDATASET_INIT;
+
+		snprintf(namebuf, sizeof(namebuf), "%d.example.com.", i);
+		dns_test_namefromstring(namebuf, &fname);
+		result = dns_db_find(db, dns_fixedname_name(&fname), NULL,
+				     50053, 0, now, NULL,
+				     dns_fixedname_initname(&ffound),
+				     &rdataset, NULL);
+		assert_int_equal(result, ISC_R_NOTFOUND);
+		assert_false(dns_rdataset_isassociated(&rdataset));
+	}
+
+	for (size_t i = 0; i < qpdb->node_lock_count; i++) {
+		isc_refcount_t *references = &qpdb->node_locks[i].references;
+		if (atomic_load_acquire(&qpdb->sweep[i].scheduled)) {
+			assert_true(isc_refcount_current(references) > 0);
+		}
+	}
+
+	/* the database is freed once the sweeper has run */
+	dns_db_detach(&db);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY_CUSTOM(overmempurge_bigrdata, setup_managers, teardown_managers)
 ISC_TEST_ENTRY_CUSTOM(overmempurge_longname, setup_managers, teardown_managers)
+ISC_TEST_ENTRY_CUSTOM(overmempurge_sieve, setup_managers, teardown_managers)
+ISC_TEST_ENTRY_CUSTOM(ncache_share, setup_managers, teardown_managers)
+ISC_TEST_ENTRY_CUSTOM(sweep_expired, setup_managers, teardown_managers)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
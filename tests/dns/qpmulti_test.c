@@ -376,8 +376,74 @@ ISC_RUN_TEST_IMPL(qpmulti) {
 	isc_loopmgr_destroy(&loopmgr);
 }
 
+static void
+budget_transactions(void *arg) {
+	isc_result_t result;
+	dns_qpmulti_t *qpm = NULL;
+	dns_qp_t *qpw = NULL;
+	dns_qpread_t qpr = { 0 };
+	dns_qp_memusage_t memusage;
+	size_t n;
+
+	UNUSED(arg);
+
+	dns_qpmulti_create(mctx, &test_methods, NULL, &qpm);
+	dns_qpmulti_setcompactbudget(qpm, 64);
+
+	/* make plenty of garbage in one light transaction */
+	dns_qpmulti_write(qpm, &qpw);
+	for (size_t i = 0; i < ARRAY_SIZE(item); i++) {
+		result = dns_qp_insert(qpw, &item[i], i);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		item[i].in_rw = true;
+	}
+	for (size_t i = 0; i < ARRAY_SIZE(item); i++) {
+		if (i % 8 != 0) {
+			result = dns_qp_deletekey(qpw, item[i].key,
+						  item[i].len, NULL, NULL);
+			assert_int_equal(result, ISC_R_SUCCESS);
+			item[i].in_rw = false;
+		}
+	}
+	assert_true(checkallrw(qpw));
+	dns_qpmulti_commit(qpm, &qpw);
+
+	memusage = dns_qpmulti_memusage(qpm);
+	assert_int_equal(memusage.compact_budget, 64);
+	assert_true(memusage.compact_unfinished);
+
+	/* empty transactions carry on where the compaction stopped */
+	for (n = 0; memusage.compact_unfinished && n < ITEM_COUNT; n++) {
+		dns_qpmulti_write(qpm, &qpw);
+		dns_qpmulti_commit(qpm, &qpw);
+		rcu_quiescent_state();
+		memusage = dns_qpmulti_memusage(qpm);
+	}
+	assert_false(memusage.compact_unfinished);
+	assert_true(n > 1);
+
+	dns_qpmulti_query(qpm, &qpr);
+	assert_true(checkallrw(&qpr));
+	dns_qpread_destroy(qpm, &qpr);
+
+	dns_qpmulti_destroy(&qpm);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/* compaction can be spread over several transactions */
+ISC_RUN_TEST_IMPL(qpmulti_budget) {
+	setup_loopmgr(NULL);
+	setup_logging();
+	setup_items();
+	isc_loop_setup(isc_loop_main(loopmgr), budget_transactions, NULL);
+	isc_loopmgr_run(loopmgr);
+	rcu_barrier();
+	isc_loopmgr_destroy(&loopmgr);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY(qpmulti)
+ISC_TEST_ENTRY(qpmulti_budget)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
@@ -23,8 +23,12 @@
 #define UNIT_TESTING
 #include <cmocka.h>
 
+#include <isc/buffer.h>
 #include <isc/util.h>
 
+#include <dns/compress.h>
+#include <dns/db.h>
+#include <dns/fixedname.h>
 #include <dns/rdataset.h>
 #include <dns/rdatastruct.h>
 
@@ -101,8 +105,76 @@ ISC_RUN_TEST_IMPL(trimttl) {
 	assert_int_equal(sigrdataset.ttl, 0);
 }
 
+/* render records streamed out of a slab */
+ISC_RUN_TEST_IMPL(towire_slab) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	dns_dbnode_t *node = NULL;
+	dns_rdataset_t rdataset = DNS_RDATASET_INIT;
+	dns_fixedname_t fname;
+	dns_name_t *name = NULL;
+	dns_compress_t cctx;
+	isc_buffer_t target;
+	unsigned char buf[64];
+	unsigned int count = 0;
+	const unsigned char expected[] = {
+		1,   'b', 4, 't', 'e', 's', 't', 0, /* owner */
+		0,   1,				    /* type A */
+		0,   1,				    /* class IN */
+		0,   0,	  3, 232,		    /* ttl 1000 */
+		0,   4,				    /* rdlen */
+		1,   2,	  3, 4,			    /* 1.2.3.4 */
+		192, 0,				    /* owner */
+		0,   1,	  0, 1, 0, 0, 3, 232, 0, 4, 1, 2, 3, 4,
+	};
+
+	result = dns_test_loaddb(&db, dns_dbtype_zone, "test",
+				 TESTS_DIR "/testdata/db/data.db");
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	name = dns_fixedname_initname(&fname);
+	result = dns_name_fromstring(name, "b.test", dns_rootname, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_db_findnode(db, name, false, &node);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_findrdataset(db, node, NULL, dns_rdatatype_a, 0, 0,
+				     &rdataset, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_non_null(rdataset.methods->getraw);
+
+	dns_compress_init(&cctx, mctx, 0);
+	isc_buffer_init(&target, buf, sizeof(buf));
+
+	/* The second time the owner name is compressed */
+	result = dns_rdataset_towire(&rdataset, name, &cctx, &target, 0,
+				     &count);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_rdataset_towire(&rdataset, name, &cctx, &target, 0,
+				     &count);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(count, 2);
+	assert_int_equal(isc_buffer_usedlength(&target), sizeof(expected));
+	assert_memory_equal(buf, expected, sizeof(expected));
+
+	/* A record that doesn't fit is rolled back */
+	isc_buffer_init(&target, buf, 14);
+	count = 0;
+	result = dns_rdataset_towire(&rdataset, name, &cctx, &target, 0,
+				     &count);
+	assert_int_equal(result, ISC_R_NOSPACE);
+	assert_int_equal(count, 0);
+	assert_int_equal(isc_buffer_usedlength(&target), 0);
+
+	dns_compress_invalidate(&cctx);
+	dns_rdataset_disassociate(&rdataset);
+	dns_db_detachnode(db, &node);
+	dns_db_detach(&db);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY(trimttl)
+ISC_TEST_ENTRY(towire_slab)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
@@ -33,6 +33,15 @@
 #include <dns/resolver.h>
 #include <dns/view.h>
 
+/* Include the main file */
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wshadow"
+#undef CHECK
+#include "resolver.c"
+#pragma GCC diagnostic pop
+
+#undef CHECK
 #include <tests/dns.h>
 
 static dns_dispatch_t *dispatch = NULL;
@@ -184,6 +193,75 @@ ISC_LOOP_TEST_IMPL(settimeout_overmax) {
 	isc_loopmgr_shutdown(loopmgr);
 }
 
+/* a zone whose fetches mostly end in NXDOMAIN is detected as attacked */
+ISC_LOOP_TEST_IMPL(fcount_attack) {
+	dns_resolver_t *resolver = NULL;
+	dns_fixedname_t fdomain, fname;
+	fetchctx_t holder, fctx;
+	fctxcount_t *counter = NULL;
+	char namebuf[DNS_NAME_FORMATSIZE];
+	isc_result_t result;
+
+	mkres(&resolver);
+	dns_resolver_setfetchesperzone(resolver, 1000);
+
+	dns_test_namefromstring("example.", &fdomain);
+
+	/* a fetch that stays in flight keeps the counter of the zone */
+	holder = (fetchctx_t){
+		.res = resolver,
+		.mctx = mctx,
+		.domain = dns_fixedname_name(&fdomain),
+		.name = dns_fixedname_name(&fdomain),
+	};
+	result = fcount_incr(&holder, false);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	counter = holder.counter;
+	assert_non_null(counter);
+
+	/*
+	 * Negative answers end the fetches with ISC_R_SUCCESS; only the
+	 * flag set when the NXDOMAIN was cached tells them apart.
+	 */
+	for (int i = 0; i < 1000; i++) {
+		snprintf(namebuf, sizeof(namebuf), "random%d.example.", i);
+		dns_test_namefromstring(namebuf, &fname);
+		fctx = (fetchctx_t){
+			.res = resolver,
+			.mctx = mctx,
+			.domain = dns_fixedname_name(&fdomain),
+			.name = dns_fixedname_name(&fname),
+			.nxdomain = true,
+		};
+		result = fcount_incr(&fctx, false);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_ptr_equal(fctx.counter, counter);
+		fcount_done(&fctx, ISC_R_SUCCESS);
+		fcount_decr(&fctx);
+	}
+	assert_int_equal(counter->done, 1000);
+	assert_int_equal(counter->nxdomain, 1000);
+	assert_false(fcount_attacked(&holder));
+
+	/* the next fetch after the end of the window sees the attack */
+	counter->window -= FCOUNT_WINDOW;
+	fctx = (fetchctx_t){
+		.res = resolver,
+		.mctx = mctx,
+		.domain = dns_fixedname_name(&fdomain),
+		.name = dns_fixedname_name(&fdomain),
+	};
+	result = fcount_incr(&fctx, false);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_not_equal(counter->attacked, 0);
+	assert_true(fcount_attacked(&holder));
+	fcount_decr(&fctx);
+
+	fcount_decr(&holder);
+	destroy_resolver(&resolver);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY_CUSTOM(create, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(gettimeout, setup_test, teardown_test)
@@ -191,6 +269,7 @@ ISC_TEST_ENTRY_CUSTOM(settimeout, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(settimeout_default, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(settimeout_belowmin, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(settimeout_overmax, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(fcount_attack, setup_test, teardown_test)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/util.h>
+
+#include <dns/db.h>
+#include <dns/dlz.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rdataset.h>
+#include <dns/sdlz.h>
+
+#include <tests/dns.h>
+
+/* How many times the driver was asked for www.example */
+static unsigned int lookups = 0;
+
+/* What the cacheable method of the driver returns */
+static bool cacheable = true;
+
+static isc_result_t
+test_create(const char *dlzname, unsigned int argc, char *argv[],
+	    void *driverarg, void **dbdata) {
+	UNUSED(dlzname);
+	UNUSED(argc);
+	UNUSED(argv);
+	UNUSED(driverarg);
+
+	*dbdata = &lookups;
+	return ISC_R_SUCCESS;
+}
+
+static isc_result_t
+test_findzone(void *driverarg, void *dbdata, const char *name,
+	      dns_clientinfomethods_t *methods, dns_clientinfo_t *clientinfo) {
+	UNUSED(driverarg);
+	UNUSED(dbdata);
+	UNUSED(methods);
+	UNUSED(clientinfo);
+
+	return strcmp(name, "example") == 0 ? ISC_R_SUCCESS : ISC_R_NOTFOUND;
+}
+
+static isc_result_t
+test_lookup(const char *zone, const char *name, void *driverarg, void *dbdata,
+	    dns_sdlzlookup_t *lookup, dns_clientinfomethods_t *methods,
+	    dns_clientinfo_t *clientinfo) {
+	isc_result_t result;
+
+	UNUSED(driverarg);
+	UNUSED(methods);
+	UNUSED(clientinfo);
+
+	if (strcmp(name, zone) == 0) {
+		result = dns_sdlz_putrr(lookup, "SOA", 300,
+					"ns.example. hostmaster.example. "
+					"1 3600 1200 604800 300");
+		if (result == ISC_R_SUCCESS) {
+			result = dns_sdlz_putrr(lookup, "NS", 300,
+						"ns.example.");
+		}
+		return result;
+	}
+
+	if (strcmp(name, "www.example") == 0) {
+		(*(unsigned int *)dbdata)++;
+		return dns_sdlz_putrr(lookup, "A", 300, "10.53.0.1");
+	}
+
+	return ISC_R_NOTFOUND;
+}
+
+static bool
+test_cacheable(void *driverarg, void *dbdata) {
+	UNUSED(driverarg);
+	UNUSED(dbdata);
+
+	return cacheable;
+}
+
+static dns_sdlzmethods_t test_methods = {
+	.create = test_create,
+	.findzone = test_findzone,
+	.lookup = test_lookup,
+	.cacheable = test_cacheable,
+};
+
+/*
+ * Look up the A record of www.example in 'db', and return its TTL.
+ */
+static dns_ttl_t
+findwww(dns_db_t *db) {
+	isc_result_t result;
+	dns_fixedname_t fname, ffound;
+	dns_name_t *found = dns_fixedname_initname(&ffound);
+	dns_rdataset_t rdataset = DNS_RDATASET_INIT;
+	dns_ttl_t ttl;
+
+	dns_test_namefromstring("www.example.", &fname);
+	result = dns_db_find(db, dns_fixedname_name(&fname), NULL,
+			     dns_rdatatype_a, 0, 0, NULL, found, &rdataset,
+			     NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	ttl = rdataset.ttl;
+	dns_rdataset_disassociate(&rdataset);
+
+	return ttl;
+}
+
+/* the answers of a cacheable database are reused for their TTL */
+ISC_RUN_TEST_IMPL(sdlz_cache) {
+	isc_result_t result;
+	dns_sdlzimplementation_t *imp = NULL;
+	dns_dlzdb_t *dlzdb = NULL;
+	dns_db_t *db = NULL;
+	dns_fixedname_t fname;
+	dns_ttl_t ttl;
+
+	result = dns_sdlzregister("test", &test_methods, NULL,
+				  DNS_SDLZFLAG_THREADSAFE | DNS_SDLZFLAG_CACHE,
+				  mctx, &imp);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_dlzcreate(mctx, "test", "test", 0, NULL, &dlzdb);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_test_namefromstring("example.", &fname);
+	result = dns_sdlz_setdb(dlzdb, dns_rdataclass_in,
+				dns_fixedname_name(&fname), &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	lookups = 0;
+	cacheable = true;
+
+	ttl = findwww(db);
+	assert_int_equal(lookups, 1);
+	assert_int_equal(ttl, 300);
+
+	/* the cached answer counts down the TTL */
+	sleep(1);
+	ttl = findwww(db);
+	assert_int_equal(lookups, 1);
+	assert_true(ttl < 300);
+
+	/* a database that isn't cacheable is always asked */
+	cacheable = false;
+	ttl = findwww(db);
+	assert_int_equal(lookups, 2);
+	assert_int_equal(ttl, 300);
+	ttl = findwww(db);
+	assert_int_equal(lookups, 3);
+
+	dns_db_detach(&db);
+	dns_dlzdestroy(&dlzdb);
+	dns_sdlzunregister(&imp);
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY(sdlz_cache)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
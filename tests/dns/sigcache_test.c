@@ -0,0 +1,276 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/buffer.h>
+#include <isc/stdtime.h>
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+#include <dns/sigcache.h>
+
+#include <dst/dst.h>
+
+#include <tests/dns.h>
+
+#define SIG_VALID                                               \
+	"A 8 1 300 20380101000000 20000101000000 29238 rsa. " \
+	"AAECAwQFBgcICQoLDA0ODw=="
+#define SIG_OTHER                                               \
+	"A 8 1 300 20380101000000 20000101000000 29238 rsa. " \
+	"DwAODQwLCgkIBwYFBAMCAQ=="
+#define SIG_EXPIRED                                             \
+	"A 8 1 300 20100101000000 20000101000000 29238 rsa. " \
+	"AAECAwQFBgcICQoLDA0ODw=="
+
+typedef struct {
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	dns_rdata_t rdatas[3];
+	unsigned char buf[3][16];
+} testset_t;
+
+static void
+make_rdataset(testset_t *set, const char **texts, size_t count) {
+	REQUIRE(count <= ARRAY_SIZE(set->rdatas));
+
+	dns_rdatalist_init(&set->rdatalist);
+	set->rdatalist.rdclass = dns_rdataclass_in;
+	set->rdatalist.type = dns_rdatatype_a;
+	set->rdatalist.ttl = 300;
+
+	for (size_t i = 0; i < count; i++) {
+		isc_result_t result;
+
+		dns_rdata_init(&set->rdatas[i]);
+		result = dns_test_rdatafromstring(
+			&set->rdatas[i], dns_rdataclass_in, dns_rdatatype_a,
+			set->buf[i], sizeof(set->buf[i]), texts[i], false);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		ISC_LIST_APPEND(set->rdatalist.rdata, &set->rdatas[i], link);
+	}
+
+	dns_rdataset_init(&set->rdataset);
+	dns_rdatalist_tordataset(&set->rdatalist, &set->rdataset);
+}
+
+static void
+make_sig(dns_rdata_t *rdata, unsigned char *buf, size_t size,
+	 const char *text) {
+	isc_result_t result;
+
+	dns_rdata_init(rdata);
+	result = dns_test_rdatafromstring(rdata, dns_rdataclass_in,
+					  dns_rdatatype_rrsig, buf, size, text,
+					  false);
+	assert_int_equal(result, ISC_R_SUCCESS);
+}
+
+static dst_key_t *
+load_key(const dns_name_t *name) {
+	dst_key_t *key = NULL;
+	isc_result_t result;
+
+	result = dst_key_fromfile(name, 29238, DST_ALG_RSASHA256,
+				  DST_TYPE_PUBLIC, TESTS_DIR, mctx, &key);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	return key;
+}
+
+/* a verification is only found after it has been added */
+ISC_RUN_TEST_IMPL(sigcache_basic) {
+	const char *texts[] = { "192.0.2.1", "192.0.2.2" };
+	dns_sigcache_t *sc = NULL;
+	dns_sigcachekey_t key;
+	dns_fixedname_t fname;
+	dns_name_t *name = NULL;
+	dns_rdata_t sig = DNS_RDATA_INIT;
+	unsigned char sigbuf[512];
+	testset_t set;
+	dst_key_t *dstkey = NULL;
+	isc_stdtime_t now = isc_stdtime_now();
+	isc_result_t result;
+
+	name = dns_fixedname_initname(&fname);
+	dns_test_namefromstring("rsa.", &fname);
+	dstkey = load_key(name);
+
+	make_rdataset(&set, texts, ARRAY_SIZE(texts));
+	make_sig(&sig, sigbuf, sizeof(sigbuf), SIG_VALID);
+
+	sc = dns_sigcache_new(mctx, 64);
+
+	result = dns_sigcache_makekey(sc, name, &set.rdataset, &sig, dstkey,
+				      &key);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_false(dns_sigcache_find(sc, &key, now));
+
+	dns_sigcache_add(sc, &key);
+	assert_true(dns_sigcache_find(sc, &key, now));
+
+	dns_sigcache_flush(sc);
+	assert_false(dns_sigcache_find(sc, &key, now));
+
+	dns_sigcache_destroy(&sc);
+	dns_rdataset_disassociate(&set.rdataset);
+	dst_key_free(&dstkey);
+}
+
+/* the key doesn't depend on the order of the records */
+ISC_RUN_TEST_IMPL(sigcache_order) {
+	const char *texts1[] = { "192.0.2.1", "192.0.2.2", "192.0.2.3" };
+	const char *texts2[] = { "192.0.2.3", "192.0.2.1", "192.0.2.2" };
+	dns_sigcache_t *sc = NULL;
+	dns_sigcachekey_t key1, key2;
+	dns_fixedname_t fname;
+	dns_name_t *name = NULL;
+	dns_rdata_t sig = DNS_RDATA_INIT;
+	unsigned char sigbuf[512];
+	testset_t set1, set2;
+	dst_key_t *dstkey = NULL;
+	isc_result_t result;
+
+	name = dns_fixedname_initname(&fname);
+	dns_test_namefromstring("rsa.", &fname);
+	dstkey = load_key(name);
+
+	make_rdataset(&set1, texts1, ARRAY_SIZE(texts1));
+	make_rdataset(&set2, texts2, ARRAY_SIZE(texts2));
+	make_sig(&sig, sigbuf, sizeof(sigbuf), SIG_VALID);
+
+	sc = dns_sigcache_new(mctx, 64);
+
+	result = dns_sigcache_makekey(sc, name, &set1.rdataset, &sig, dstkey,
+				      &key1);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_sigcache_makekey(sc, name, &set2.rdataset, &sig, dstkey,
+				      &key2);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	assert_memory_equal(key1.digest, key2.digest, sizeof(key1.digest));
+
+	dns_sigcache_destroy(&sc);
+	dns_rdataset_disassociate(&set1.rdataset);
+	dns_rdataset_disassociate(&set2.rdataset);
+	dst_key_free(&dstkey);
+}
+
+/* a different RRset or signature is a miss */
+ISC_RUN_TEST_IMPL(sigcache_mismatch) {
+	const char *texts1[] = { "192.0.2.1", "192.0.2.2" };
+	const char *texts2[] = { "192.0.2.1", "192.0.2.3" };
+	dns_sigcache_t *sc = NULL;
+	dns_sigcachekey_t key;
+	dns_fixedname_t fname;
+	dns_name_t *name = NULL;
+	dns_rdata_t sig = DNS_RDATA_INIT, othersig = DNS_RDATA_INIT;
+	unsigned char sigbuf[512], othersigbuf[512];
+	testset_t set1, set2;
+	dst_key_t *dstkey = NULL;
+	isc_stdtime_t now = isc_stdtime_now();
+	isc_result_t result;
+
+	name = dns_fixedname_initname(&fname);
+	dns_test_namefromstring("rsa.", &fname);
+	dstkey = load_key(name);
+
+	make_rdataset(&set1, texts1, ARRAY_SIZE(texts1));
+	make_rdataset(&set2, texts2, ARRAY_SIZE(texts2));
+	make_sig(&sig, sigbuf, sizeof(sigbuf), SIG_VALID);
+	make_sig(&othersig, othersigbuf, sizeof(othersigbuf), SIG_OTHER);
+
+	sc = dns_sigcache_new(mctx, 64);
+
+	result = dns_sigcache_makekey(sc, name, &set1.rdataset, &sig, dstkey,
+				      &key);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_sigcache_add(sc, &key);
+
+	result = dns_sigcache_makekey(sc, name, &set2.rdataset, &sig, dstkey,
+				      &key);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_false(dns_sigcache_find(sc, &key, now));
+
+	result = dns_sigcache_makekey(sc, name, &set1.rdataset, &othersig,
+				      dstkey, &key);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_false(dns_sigcache_find(sc, &key, now));
+
+	dns_sigcache_destroy(&sc);
+	dns_rdataset_disassociate(&set1.rdataset);
+	dns_rdataset_disassociate(&set2.rdataset);
+	dst_key_free(&dstkey);
+}
+
+/* a cached verification is not used outside of the validity window */
+ISC_RUN_TEST_IMPL(sigcache_expired) {
+	const char *texts[] = { "192.0.2.1" };
+	dns_sigcache_t *sc = NULL;
+	dns_sigcachekey_t key;
+	dns_fixedname_t fname;
+	dns_name_t *name = NULL;
+	dns_rdata_t sig = DNS_RDATA_INIT;
+	unsigned char sigbuf[512];
+	testset_t set;
+	dst_key_t *dstkey = NULL;
+	isc_result_t result;
+
+	name = dns_fixedname_initname(&fname);
+	dns_test_namefromstring("rsa.", &fname);
+	dstkey = load_key(name);
+
+	make_rdataset(&set, texts, ARRAY_SIZE(texts));
+	make_sig(&sig, sigbuf, sizeof(sigbuf), SIG_EXPIRED);
+
+	sc = dns_sigcache_new(mctx, 64);
+
+	result = dns_sigcache_makekey(sc, name, &set.rdataset, &sig, dstkey,
+				      &key);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_sigcache_add(sc, &key);
+
+	assert_true(dns_sigcache_find(sc, &key, key.expiration));
+	assert_false(dns_sigcache_find(sc, &key, key.expiration + 1));
+	assert_false(dns_sigcache_find(sc, &key, key.inception - 1));
+	assert_false(dns_sigcache_find(sc, &key, isc_stdtime_now()));
+
+	dns_sigcache_destroy(&sc);
+	dns_rdataset_disassociate(&set.rdataset);
+	dst_key_free(&dstkey);
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY(sigcache_basic)
+ISC_TEST_ENTRY(sigcache_order)
+ISC_TEST_ENTRY(sigcache_mismatch)
+ISC_TEST_ENTRY(sigcache_expired)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
@@ -89,6 +89,8 @@ ISC_LOOP_TEST_IMPL(zonemgr_managezone) {
 	dns_zone_detach(&zone);
 
 	assert_int_equal(dns_zonemgr_getcount(myzonemgr, DNS_ZONESTATE_ANY), 0);
+	assert_int_equal(
+		dns_zonemgr_getcount(myzonemgr, DNS_ZONESTATE_SCHEDULED), 0);
 
 	dns_zonemgr_shutdown(myzonemgr);
 	dns_zonemgr_detach(&myzonemgr);
@@ -27,6 +27,7 @@
 #include <isc/atomic.h>
 #include <isc/buffer.h>
 #include <isc/loop.h>
+#include <isc/thread.h>
 #include <isc/timer.h>
 #include <isc/urcu.h>
 #include <isc/util.h>
@@ -42,6 +43,7 @@
 static dns_db_t *db = NULL;
 static FILE *zonefile, *origfile;
 static dns_view_t *view = NULL;
+static dns_zone_t *zone_bar = NULL;
 
 static isc_result_t
 count_zone(dns_zone_t *zone, void *uap) {
@@ -88,6 +90,73 @@ ISC_LOOP_TEST_IMPL(apply) {
 	isc_loopmgr_shutdown(loopmgr);
 }
 
+static void *
+find_bar(void *arg) {
+	isc_result_t *resultp = arg;
+	dns_zone_t *zone = NULL;
+
+	*resultp = dns_view_findzone(view, dns_zone_getorigin(zone_bar),
+				     DNS_ZTFIND_EXACT, &zone);
+	if (zone != NULL) {
+		dns_zone_detach(&zone);
+	}
+
+	return NULL;
+}
+
+static isc_result_t
+find_bar_elsewhere(void) {
+	isc_result_t result = ISC_R_UNSET;
+	isc_thread_t thread;
+
+	isc_thread_create(find_bar, &result, &thread);
+	isc_thread_join(thread, NULL);
+
+	return result;
+}
+
+/* add zones to a zone table in a single update */
+ISC_LOOP_TEST_IMPL(bulk) {
+	isc_result_t result;
+	dns_zone_t *zone = NULL, *found = NULL;
+
+	result = dns_test_makezone("foo", &zone, NULL, true);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	view = dns_zone_getview(zone);
+
+	dns_view_beginzones(view);
+
+	result = dns_test_makezone("bar", &zone_bar, view, false);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	/* The zone is visible to the update, but not to the readers yet */
+	result = dns_view_findzone(view, dns_zone_getorigin(zone_bar),
+				   DNS_ZTFIND_EXACT, &found);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_ptr_equal(found, zone_bar);
+	dns_zone_detach(&found);
+
+	assert_int_equal(find_bar_elsewhere(), ISC_R_NOTFOUND);
+
+	dns_view_endzones(view);
+
+	assert_int_equal(find_bar_elsewhere(), ISC_R_SUCCESS);
+
+	dns_test_setupzonemgr();
+	result = dns_test_managezone(zone);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_test_managezone(zone_bar);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_test_releasezone(zone_bar);
+	dns_test_releasezone(zone);
+	dns_test_closezonemgr();
+
+	dns_view_detach(&view);
+	dns_zone_detach(&zone_bar);
+	dns_zone_detach(&zone);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
 static isc_result_t
 load_done_last(void *uap) {
 	dns_zone_t *zone = uap;
@@ -265,6 +334,11 @@ ISC_LOOP_TEST_IMPL(asyncload_zt) {
 	assert_false(dns__zone_loadpending(zone2));
 	assert_false(atomic_load(&done));
 
+	/* Zones are scheduled by the size of their files */
+	assert_int_equal(dns__zone_loadsize(zone1), dns__zone_loadsize(zone2));
+	assert_true(dns__zone_loadsize(zone1) > 0);
+	assert_int_equal(dns__zone_loadsize(zone3), 0);
+
 	rcu_read_lock();
 	zt = rcu_dereference(view->zonetable);
 	dns_zt_asyncload(zt, false, all_done, NULL);
@@ -273,6 +347,7 @@ ISC_LOOP_TEST_IMPL(asyncload_zt) {
 
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY_CUSTOM(apply, setup_managers, teardown_managers)
+ISC_TEST_ENTRY_CUSTOM(bulk, setup_managers, teardown_managers)
 ISC_TEST_ENTRY_CUSTOM(asyncload_zone, setup_managers, teardown_managers)
 ISC_TEST_ENTRY_CUSTOM(asyncload_zt, setup_managers, teardown_managers)
 ISC_TEST_LIST_END
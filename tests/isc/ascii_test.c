@@ -86,6 +86,13 @@ struct {
 	{ "barsuffix", "foosuffix", -1 },
 	{ "prefixfoo", "prefixbar", +1 },
 	{ "prefixbar", "prefixfoo", -1 },
+	{ "a", "b", -1 },
+	{ "abcz", "abcy", +1 },
+	{ "zbcda", "abcdz", +1 },
+	{ "abcdefgz", "ABCDEFGY", +1 },
+	{ "abcdefghy", "ABCDEFGHZ", -1 },
+	{ "zbcdefghijka", "abcdefghijkz", +1 },
+	{ "abcdefghijkz", "abcdefghijka", +1 },
 };
 
 ISC_RUN_TEST_IMPL(upperlower) {
@@ -372,6 +372,9 @@ ISC_RUN_TEST_IMPL(dnsasm_sequence_test) {
 					 sizeof(response_large));
 	assert_true(verified == 4);
 	assert_true(isc_dnsstream_assembler_result(dnsasm) == ISC_R_SUCCESS);
+
+	/* complete messages are processed in place */
+	assert_int_equal(isc_dnsstream_assembler_copiedlength(dnsasm), 0);
 }
 
 ISC_RUN_TEST_IMPL(dnsasm_multiple_messages_test) {
@@ -444,6 +447,8 @@ ISC_RUN_TEST_IMPL(dnsasm_torn_apart_test) {
 
 	assert_true(verified == 0);
 	assert_true(isc_dnsstream_assembler_result(dnsasm) == ISC_R_NOMORE);
+	assert_int_equal(isc_dnsstream_assembler_copiedlength(dnsasm),
+			 sizeof(response_large) / 3 * 2);
 
 	left = sizeof(response_large) -
 	       isc_dnsstream_assembler_remaininglength(dnsasm);
@@ -453,6 +458,8 @@ ISC_RUN_TEST_IMPL(dnsasm_torn_apart_test) {
 		left);
 	assert_true(verified == 1);
 	assert_true(isc_dnsstream_assembler_result(dnsasm) == ISC_R_SUCCESS);
+	assert_int_equal(isc_dnsstream_assembler_copiedlength(dnsasm),
+			 sizeof(response_large));
 }
 
 ISC_RUN_TEST_IMPL(dnsasm_error_data_test) {
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/iterated_hash.h>
+#include <isc/random.h>
+#include <isc/util.h>
+
+#include <tests/isc.h>
+
+#define SHA1_DIGEST 20
+
+/* The NSEC3 hashes of RFC 5155, Appendix A */
+ISC_RUN_TEST_IMPL(isc_iterated_hash_batch_rfc5155) {
+	static const unsigned char salt[] = { 0xaa, 0xbb, 0xcc, 0xdd };
+	static const struct {
+		const char *name;
+		int length;
+		unsigned char hash[SHA1_DIGEST];
+	} tests[] = {
+		{ "\007example", 9,
+		  { 0x06, 0x53, 0x68, 0xab, 0xee, 0xd7, 0xec, 0x6e, 0x9f, 0xeb,
+		    0xa9, 0x6b, 0x8c, 0x8b, 0xc3, 0xe8, 0xb7, 0x91, 0xf7,
+		    0x16 } },
+		{ "\001a\007example", 11,
+		  { 0x19, 0x6d, 0xd8, 0xc3, 0x30, 0x67, 0x83, 0xa8, 0x19, 0x0f,
+		    0x52, 0xc2, 0x62, 0xd2, 0xb7, 0xe5, 0xe8, 0x36, 0xe7,
+		    0xf5 } },
+		{ "\002ai\007example", 12,
+		  { 0x84, 0xdd, 0xa7, 0x14, 0x46, 0xcd, 0x56, 0xf0, 0xc1, 0x16,
+		    0xa5, 0x72, 0x54, 0xba, 0xef, 0x69, 0xd0, 0x9b, 0xce,
+		    0x12 } },
+	};
+	unsigned char hashes[ARRAY_SIZE(tests)][SHA1_DIGEST];
+	unsigned char *out[ARRAY_SIZE(tests)];
+	const unsigned char *in[ARRAY_SIZE(tests)];
+	int inlength[ARRAY_SIZE(tests)];
+	int ret;
+
+	UNUSED(state);
+
+	for (size_t i = 0; i < ARRAY_SIZE(tests); i++) {
+		out[i] = hashes[i];
+		in[i] = (const unsigned char *)tests[i].name;
+		/* Include the root label */
+		inlength[i] = tests[i].length;
+	}
+
+	ret = isc_iterated_hash_batch(out, 1, 12, salt, sizeof(salt), in,
+				      inlength, ARRAY_SIZE(tests));
+	assert_int_equal(ret, SHA1_DIGEST);
+
+	for (size_t i = 0; i < ARRAY_SIZE(tests); i++) {
+		assert_memory_equal(hashes[i], tests[i].hash, SHA1_DIGEST);
+	}
+
+	/* Unknown hash algorithm */
+	ret = isc_iterated_hash_batch(out, 2, 12, salt, sizeof(salt), in,
+				      inlength, ARRAY_SIZE(tests));
+	assert_int_equal(ret, 0);
+}
+
+/* the batched hashes are the same as the hashes computed one by one */
+ISC_RUN_TEST_IMPL(isc_iterated_hash_batch) {
+	unsigned char salt[255];
+	unsigned char input[20][255];
+	unsigned char hashes[20][SHA1_DIGEST];
+	unsigned char expected[SHA1_DIGEST];
+	unsigned char *out[20];
+	const unsigned char *in[20];
+	int inlength[20];
+	int ret;
+
+	UNUSED(state);
+
+	isc_random_buf(salt, sizeof(salt));
+	isc_random_buf(input, sizeof(input));
+
+	for (size_t i = 0; i < ARRAY_SIZE(input); i++) {
+		out[i] = hashes[i];
+		in[i] = input[i];
+	}
+
+	for (size_t n = 0; n < 200; n++) {
+		size_t count = isc_random_uniform(ARRAY_SIZE(input)) + 1;
+		int saltlength = (n % 2 == 0) ? isc_random_uniform(40)
+					      : isc_random_uniform(256);
+		int iterations = isc_random_uniform(10);
+
+		for (size_t i = 0; i < count; i++) {
+			inlength[i] = isc_random_uniform(256);
+		}
+
+		ret = isc_iterated_hash_batch(out, 1, iterations, salt,
+					      saltlength, in, inlength, count);
+		assert_int_equal(ret, SHA1_DIGEST);
+
+		for (size_t i = 0; i < count; i++) {
+			ret = isc_iterated_hash(expected, 1, iterations, salt,
+						saltlength, in[i], inlength[i]);
+			assert_int_equal(ret, SHA1_DIGEST);
+			assert_memory_equal(hashes[i], expected, SHA1_DIGEST);
+		}
+	}
+}
+
+ISC_TEST_LIST_START
+
+ISC_TEST_ENTRY(isc_iterated_hash_batch_rfc5155)
+ISC_TEST_ENTRY(isc_iterated_hash_batch)
+
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
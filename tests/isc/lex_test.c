@@ -338,9 +338,77 @@ ISC_RUN_TEST_IMPL(lex_keypair) {
 	}
 }
 
+/*%
+ * long strings, read a run of characters at a time
+ */
+ISC_RUN_TEST_IMPL(lex_longstring) {
+	isc_buffer_t buf;
+	isc_lex_t *lex = NULL;
+	isc_result_t result;
+	isc_token_t token;
+	isc_region_t r;
+	isc_lexspecials_t specials;
+	const char *text = "averyveryverylongtokenendedbyaparen(x) "
+			   "tokenwithan\\ escapedspaceinthemiddle;comment\n"
+			   "\\(escapedparenthesisatthestartofthetoken";
+	const char *expect[] = {
+		"averyveryverylongtokenendedbyaparen",
+		"(",
+		"x",
+		")",
+		"tokenwithan\\ escapedspaceinthemiddle",
+		"\\(escapedparenthesisatthestartofthetoken",
+	};
+	unsigned int options = ISC_LEXOPT_ESCAPE;
+
+	UNUSED(state);
+
+	/* A small initial size, for the token to be grown */
+	isc_lex_create(mctx, 4, &lex);
+	memset(specials, 0, sizeof(specials));
+	specials['('] = 1;
+	specials[')'] = 1;
+	specials['"'] = 1;
+	isc_lex_setspecials(lex, specials);
+	isc_lex_setcomments(lex, ISC_LEXCOMMENT_DNSMASTERFILE);
+
+	isc_buffer_constinit(&buf, text, strlen(text));
+	isc_buffer_add(&buf, strlen(text));
+	result = isc_lex_openbuffer(lex, &buf);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	for (size_t i = 0; i < ARRAY_SIZE(expect); i++) {
+		result = isc_lex_gettoken(lex, options, &token);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		if (token.type == isc_tokentype_special) {
+			assert_int_equal(token.value.as_char, expect[i][0]);
+			continue;
+		}
+		assert_int_equal(token.type, isc_tokentype_string);
+		assert_string_equal(AS_STR(token), expect[i]);
+
+		/* The whole token can be read again */
+		isc_lex_getlasttokentext(lex, &token, &r);
+		assert_int_equal(r.length, strlen(expect[i]));
+		assert_memory_equal(r.base, expect[i], r.length);
+		isc_lex_ungettoken(lex, &token);
+		result = isc_lex_gettoken(lex, options, &token);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_string_equal(AS_STR(token), expect[i]);
+	}
+
+	result = isc_lex_gettoken(lex, options | ISC_LEXOPT_EOF, &token);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(token.type, isc_tokentype_eof);
+	assert_int_equal(isc_lex_getsourceline(lex), 2);
+
+	isc_lex_destroy(&lex);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY(lex_0xff)
 ISC_TEST_ENTRY(lex_keypair)
+ISC_TEST_ENTRY(lex_longstring)
 ISC_TEST_ENTRY(lex_setline)
 ISC_TEST_ENTRY(lex_string)
 ISC_TEST_ENTRY(lex_qstring)
@@ -24,6 +24,7 @@
 #define UNIT_TESTING
 #include <cmocka.h>
 
+#include <isc/async.h>
 #include <isc/atomic.h>
 #include <isc/loop.h>
 #include <isc/os.h>
@@ -106,6 +107,133 @@ ISC_RUN_TEST_IMPL(isc_loopmgr_pause) {
 	isc_loopmgr_run(loopmgr);
 }
 
+#define NASYNCS 10
+
+static void
+stats_check(void *arg ISC_ATTR_UNUSED) {
+	isc_loopstats_t stats;
+
+	isc_loop_getstats(mainloop, &stats);
+
+	/* The setup jobs are not counted */
+	assert_true(stats.asyncs >= NASYNCS + 1);
+	assert_true(stats.asyncwait >= stats.asyncmaxwait);
+	assert_int_equal(atomic_load(&scheduled), NASYNCS);
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+static void
+stats_setup(void *arg ISC_ATTR_UNUSED) {
+	isc_loopstats_t stats;
+
+	for (size_t i = 0; i < NASYNCS; i++) {
+		isc_async_current(count, loopmgr);
+	}
+	isc_async_current(stats_check, loopmgr);
+
+	isc_loop_getstats(mainloop, &stats);
+	assert_true(stats.asyncsqueued >= NASYNCS + 1);
+}
+
+ISC_RUN_TEST_IMPL(isc_loop_getstats) {
+	atomic_store(&scheduled, 0);
+
+	isc_loop_setup(mainloop, stats_setup, loopmgr);
+	isc_loopmgr_run(loopmgr);
+}
+
+static void
+batch_check(void *arg ISC_ATTR_UNUSED) {
+	isc_loopstats_t stats;
+
+	isc_loop_getstats(isc_loop(), &stats);
+
+	/* All the jobs were passed with a single wakeup */
+	assert_int_equal(stats.asyncwakeups, 1);
+	assert_int_equal(atomic_load(&scheduled), NASYNCS);
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+static void
+batch_setup(void *arg ISC_ATTR_UNUSED) {
+	isc_loop_t *loop = isc_loop_get(loopmgr, 1);
+
+	for (size_t i = 0; i < NASYNCS; i++) {
+		isc_async_batch(loop, count, loopmgr);
+	}
+	isc_async_batch(loop, batch_check, loopmgr);
+
+	/* Nothing has been passed yet */
+	assert_int_equal(atomic_load(&loop->asyncwakeups), 0);
+}
+
+ISC_RUN_TEST_IMPL(isc_async_batch) {
+	atomic_store(&scheduled, 0);
+
+	isc_loop_setup(mainloop, batch_setup, loopmgr);
+	isc_loopmgr_run(loopmgr);
+}
+
+static void
+affinity_check(void *arg ISC_ATTR_UNUSED) {
+	isc_loop_t *loop = isc_loop();
+	int cpu = isc_loop_getcpu(loop);
+	unsigned int size = isc_os_ncpus();
+	int *cpus = isc_mem_cget(mctx, size, sizeof(cpus[0]));
+	unsigned int count = isc_os_cpulist(cpus, size);
+
+	/* The loops are bound in the order of the CPU list */
+	assert_true(count > 0);
+	assert_int_equal(cpu, cpus[isc_tid() % count]);
+	isc_mem_cput(mctx, cpus, size, sizeof(cpus[0]));
+
+#if defined(HAVE_PTHREAD_SETAFFINITY_NP) && defined(CPU_SETSIZE)
+	/* The thread has been bound before this job has run */
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	assert_int_equal(
+		pthread_getaffinity_np(pthread_self(), sizeof(set), &set), 0);
+	assert_int_equal(CPU_COUNT(&set), 1);
+	assert_true(CPU_ISSET(cpu, &set));
+#endif /* if defined(HAVE_PTHREAD_SETAFFINITY_NP) && defined(CPU_SETSIZE) */
+
+	if (atomic_fetch_add(&scheduled, 1) + 1 == isc_loopmgr_nloops(loopmgr))
+	{
+		assert_int_equal(isc_loopmgr_setaffinity(loopmgr, false),
+				 ISC_R_SUCCESS);
+		for (uint32_t i = 0; i < isc_loopmgr_nloops(loopmgr); i++) {
+			loop = isc_loop_get(loopmgr, i);
+			assert_int_equal(isc_loop_getcpu(loop), -1);
+		}
+		isc_loopmgr_shutdown(loopmgr);
+	}
+}
+
+static void
+affinity_setup(void *arg ISC_ATTR_UNUSED) {
+	isc_result_t result = isc_loopmgr_setaffinity(loopmgr, true);
+
+	if (result == ISC_R_NOTIMPLEMENTED) {
+		assert_int_equal(isc_loop_getcpu(mainloop), -1);
+		isc_loopmgr_shutdown(loopmgr);
+		return;
+	}
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	for (uint32_t i = 0; i < isc_loopmgr_nloops(loopmgr); i++) {
+		isc_async_run(isc_loop_get(loopmgr, i), affinity_check, NULL);
+	}
+}
+
+ISC_RUN_TEST_IMPL(isc_loopmgr_setaffinity) {
+	atomic_store(&scheduled, 0);
+
+	isc_loop_setup(mainloop, affinity_setup, loopmgr);
+	isc_loopmgr_run(loopmgr);
+}
+
 static void
 send_sigint(void *arg) {
 	UNUSED(arg);
@@ -136,6 +264,10 @@ ISC_TEST_ENTRY_CUSTOM(isc_loopmgr_pause, setup_loopmgr, teardown_loopmgr)
 ISC_TEST_ENTRY_CUSTOM(isc_loopmgr_runjob, setup_loopmgr, teardown_loopmgr)
 ISC_TEST_ENTRY_CUSTOM(isc_loopmgr_sigint, setup_loopmgr, teardown_loopmgr)
 ISC_TEST_ENTRY_CUSTOM(isc_loopmgr_sigterm, setup_loopmgr, teardown_loopmgr)
+ISC_TEST_ENTRY_CUSTOM(isc_loop_getstats, setup_loopmgr, teardown_loopmgr)
+ISC_TEST_ENTRY_CUSTOM(isc_async_batch, setup_loopmgr, teardown_loopmgr)
+ISC_TEST_ENTRY_CUSTOM(isc_loopmgr_setaffinity, setup_loopmgr,
+		      teardown_loopmgr)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
@@ -23,8 +23,10 @@
 #define UNIT_TESTING
 #include <cmocka.h>
 
+#include <isc/async.h>
 #include <isc/atomic.h>
 #include <isc/file.h>
+#include <isc/loop.h>
 #include <isc/mem.h>
 #include <isc/mutex.h>
 #include <isc/os.h>
@@ -199,6 +201,25 @@ ISC_RUN_TEST_IMPL(isc_mem_inuse) {
 	isc_mem_destroy(&mctx2);
 }
 
+/* test the count of allocations */
+ISC_RUN_TEST_IMPL(isc_mem_allocations) {
+	isc_mem_t *mctx2 = NULL;
+	uint64_t before;
+	void *ptr;
+
+	isc_mem_create(&mctx2);
+
+	before = isc_mem_allocations(mctx2);
+	ptr = isc_mem_get(mctx2, 100);
+	isc_mem_put(mctx2, ptr, 100);
+	ptr = isc_mem_allocate(mctx2, 100);
+	ptr = isc_mem_reallocate(mctx2, ptr, 200);
+	isc_mem_free(mctx2, ptr);
+	assert_int_equal(isc_mem_allocations(mctx2) - before, 3);
+
+	isc_mem_destroy(&mctx2);
+}
+
 ISC_RUN_TEST_IMPL(isc_mem_zeroget) {
 	uint8_t *data = NULL;
 
@@ -325,6 +346,126 @@ ISC_RUN_TEST_IMPL(isc_mem_overmem) {
 	isc_mem_destroy(&omctx);
 }
 
+ISC_RUN_TEST_IMPL(isc_mem_pressure) {
+	isc_mem_t *pmctx = NULL;
+	isc_mem_create(&pmctx);
+
+	/* No water marks, no pressure */
+	void *data1 = isc_mem_allocate(pmctx, 1024);
+	assert_int_equal(isc_mem_pressure(pmctx), 0);
+	isc_mem_free(pmctx, data1);
+
+	isc_mem_setwater(pmctx, 2048, 1024);
+
+	/* inuse < lo_water */
+	data1 = isc_mem_allocate(pmctx, 512);
+	assert_int_equal(isc_mem_pressure(pmctx), 0);
+
+	/* lo_water < inuse < hi_water */
+	void *data2 = isc_mem_allocate(pmctx, 1024);
+	assert_true(isc_mem_pressure(pmctx) > 0);
+	assert_true(isc_mem_pressure(pmctx) < ISC_MEM_PRESSURE_MAX);
+
+	/* hi_water < inuse */
+	void *data3 = isc_mem_allocate(pmctx, 1024);
+	assert_int_equal(isc_mem_pressure(pmctx), ISC_MEM_PRESSURE_MAX);
+
+	/* lo_water < inuse < hi_water, still overmem */
+	isc_mem_free(pmctx, data3);
+	assert_int_equal(isc_mem_pressure(pmctx), ISC_MEM_PRESSURE_MAX);
+
+	/* inuse < lo_water */
+	isc_mem_free(pmctx, data2);
+	assert_int_equal(isc_mem_pressure(pmctx), 0);
+
+	isc_mem_free(pmctx, data1);
+	isc_mem_destroy(&pmctx);
+}
+
+static isc_mem_t *tamctx = NULL;
+static void *taptrs[16];
+
+static void
+threadaffine_free(void *arg) {
+	UNUSED(arg);
+
+	/* Free the memory allocated by another thread */
+	for (size_t i = 0; i < ARRAY_SIZE(taptrs); i++) {
+		isc_mem_free(tamctx, taptrs[i]);
+	}
+	assert_int_equal(isc_mem_inuse(tamctx), 0);
+
+	isc_mem_destroy(&tamctx);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/* test the memory contexts with per-thread arenas */
+ISC_LOOP_TEST_IMPL(isc_mem_threadaffine) {
+	void *ptr = NULL;
+
+	isc_mem_create_threadaffine(&tamctx);
+	assert_non_null(tamctx);
+
+	ptr = isc_mem_get(tamctx, 100);
+	assert_non_null(ptr);
+	isc_mem_put(tamctx, ptr, 100);
+	assert_int_equal(isc_mem_inuse(tamctx), 0);
+
+	for (size_t i = 0; i < ARRAY_SIZE(taptrs); i++) {
+		taptrs[i] = isc_mem_allocate(tamctx, 16 << i);
+		assert_non_null(taptrs[i]);
+		taptrs[i] = isc_mem_reallocate(tamctx, taptrs[i], 32 << i);
+		assert_non_null(taptrs[i]);
+	}
+
+	isc_async_run(isc_loop_get(loopmgr, isc_loopmgr_nloops(loopmgr) - 1),
+		      threadaffine_free, NULL);
+}
+
+static isc_mempool_t *sharedpool = NULL;
+static void *sharedptrs[1000];
+
+static void
+mempool_shared_put(void *arg) {
+	UNUSED(arg);
+
+	/* Return the items to the magazines of another loop */
+	for (size_t i = 0; i < ARRAY_SIZE(sharedptrs); i++) {
+		isc_mempool_put(sharedpool, sharedptrs[i]);
+	}
+	assert_int_equal(isc_mempool_getallocated(sharedpool), 0);
+	assert_true(isc_mempool_getfreecount(sharedpool) <=
+		    isc_mempool_getfreemax(sharedpool));
+
+	isc_mempool_destroy(&sharedpool);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/* test the pools shared by the loops */
+ISC_LOOP_TEST_IMPL(isc_mempool_shared) {
+	isc_mempool_create_shared(mctx, 24, &sharedpool);
+	assert_non_null(sharedpool);
+
+	for (size_t n = 0; n < 3; n++) {
+		for (size_t i = 0; i < ARRAY_SIZE(sharedptrs); i++) {
+			sharedptrs[i] = isc_mempool_get(sharedpool);
+			assert_non_null(sharedptrs[i]);
+		}
+		assert_int_equal(isc_mempool_getallocated(sharedpool),
+				 ARRAY_SIZE(sharedptrs));
+		if (n == 2) {
+			break;
+		}
+		for (size_t i = 0; i < ARRAY_SIZE(sharedptrs); i++) {
+			isc_mempool_put(sharedpool, sharedptrs[i]);
+		}
+		assert_int_equal(isc_mempool_getallocated(sharedpool), 0);
+	}
+
+	isc_async_run(isc_loop_get(loopmgr, isc_loopmgr_nloops(loopmgr) - 1),
+		      mempool_shared_put, NULL);
+}
+
 #if ISC_MEM_TRACKLINES
 
 /* test mem with no flags */
@@ -517,10 +658,14 @@ ISC_TEST_ENTRY(isc_mem_get)
 ISC_TEST_ENTRY(isc_mem_cget_zero)
 ISC_TEST_ENTRY(isc_mem_callocate_zero)
 ISC_TEST_ENTRY(isc_mem_inuse)
+ISC_TEST_ENTRY(isc_mem_allocations)
 ISC_TEST_ENTRY(isc_mem_zeroget)
 ISC_TEST_ENTRY(isc_mem_reget)
 ISC_TEST_ENTRY(isc_mem_reallocate)
 ISC_TEST_ENTRY(isc_mem_overmem)
+ISC_TEST_ENTRY(isc_mem_pressure)
+ISC_TEST_ENTRY_CUSTOM(isc_mem_threadaffine, setup_loopmgr, teardown_loopmgr)
+ISC_TEST_ENTRY_CUSTOM(isc_mempool_shared, setup_loopmgr, teardown_loopmgr)
 
 #if ISC_MEM_TRACKLINES
 ISC_TEST_ENTRY(isc_mem_noflags)
@@ -18,6 +18,7 @@
 #include <stdarg.h>
 #include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #define UNIT_TESTING
@@ -25,6 +26,7 @@
 
 #include <isc/atomic.h>
 #include <isc/file.h>
+#include <isc/lockstat.h>
 #include <isc/mem.h>
 #include <isc/mutex.h>
 #include <isc/os.h>
@@ -71,6 +73,74 @@ ISC_RUN_TEST_IMPL(isc_mutex) {
 	isc_mutex_destroy(&lock);
 }
 
+static isc_mutex_t statlock;
+static atomic_bool statwaiting = false;
+
+static void *
+lockstat_thread(void *arg ISC_ATTR_UNUSED) {
+	atomic_store(&statwaiting, true);
+	isc_mutex_lock(&statlock);
+	isc_mutex_unlock(&statlock);
+
+	return NULL;
+}
+
+ISC_RUN_TEST_IMPL(isc_lockstat) {
+	isc_lockstat_t stats[64];
+	isc_thread_t thread;
+	size_t count;
+	bool found = false;
+
+	isc_mutex_init(&statlock);
+	isc_lockstat_reset();
+	isc_lockstat_enable(true);
+	assert_true(isc_lockstat_enabled());
+
+	/* Hold the lock while the thread waits for it */
+	isc_mutex_lock(&statlock);
+	isc_thread_create(lockstat_thread, NULL, &thread);
+	while (!atomic_load(&statwaiting)) {
+		isc_pause();
+	}
+	usleep(10000);
+	isc_mutex_unlock(&statlock);
+	isc_thread_join(thread, NULL);
+
+	isc_lockstat_enable(false);
+
+	count = isc_lockstat_get(stats, ARRAY_SIZE(stats));
+	for (size_t i = 0; i < count; i++) {
+		if (strcmp(stats[i].file, __FILE__) == 0) {
+			assert_int_equal(stats[i].type,
+					 isc_lockstattype_mutex);
+			assert_int_equal(stats[i].contended, 1);
+			assert_true(stats[i].wait > 0);
+			assert_int_equal(stats[i].wait, stats[i].maxwait);
+			found = true;
+		}
+		if (i > 0) {
+			assert_true(stats[i - 1].wait >= stats[i].wait);
+		}
+	}
+	assert_true(found);
+
+	/* Nothing is collected while the statistics are disabled */
+	isc_lockstat_reset();
+	atomic_store(&statwaiting, false);
+	isc_mutex_lock(&statlock);
+	isc_thread_create(lockstat_thread, NULL, &thread);
+	while (!atomic_load(&statwaiting)) {
+		isc_pause();
+	}
+	usleep(10000);
+	isc_mutex_unlock(&statlock);
+	isc_thread_join(thread, NULL);
+
+	assert_int_equal(isc_lockstat_get(stats, ARRAY_SIZE(stats)), 0);
+
+	isc_mutex_destroy(&statlock);
+}
+
 #define ITERS 20
 
 #define DC	200
@@ -207,6 +277,7 @@ ISC_RUN_TEST_IMPL(isc_mutex_benchmark) {
 ISC_TEST_LIST_START
 
 ISC_TEST_ENTRY(isc_mutex)
+ISC_TEST_ENTRY(isc_lockstat)
 #if !defined(__SANITIZE_THREAD__)
 ISC_TEST_ENTRY(isc_mutex_benchmark)
 #endif /* __SANITIZE_THREAD__ */
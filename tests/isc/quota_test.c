@@ -28,6 +28,7 @@
 #include <isc/quota.h>
 #include <isc/result.h>
 #include <isc/thread.h>
+#include <isc/tid.h>
 #include <isc/util.h>
 #include <isc/uv.h>
 
@@ -131,6 +132,134 @@ ISC_RUN_TEST_IMPL(isc_quota_soft) {
 	isc_quota_destroy(&quota);
 }
 
+ISC_RUN_TEST_IMPL(isc_quota_perloop) {
+	unsigned int used, max;
+	int i;
+	UNUSED(state);
+
+	isc__tid_initcount(4);
+	isc_quota_initperloop(&quota, mctx, 10);
+	isc_quota_soft(&quota, 8);
+
+	assert_int_equal(isc_quota_getloops(&quota), 4);
+	isc_quota_getloopusage(&quota, 0, &used, &max);
+	assert_int_equal(used, 0);
+	assert_int_equal(max, 3);
+	isc_quota_getloopusage(&quota, 3, &used, &max);
+	assert_int_equal(max, 2);
+
+	/* The other shares are used once the first one is */
+	for (i = 0; i < 8; i++) {
+		add_quota(&quota, ISC_R_SUCCESS, i + 1);
+	}
+	for (i = 8; i < 10; i++) {
+		add_quota(&quota, ISC_R_SOFTQUOTA, i + 1);
+	}
+	add_quota(&quota, ISC_R_QUOTA, 10);
+
+	for (unsigned int loop = 0; loop < 4; loop++) {
+		isc_quota_getloopusage(&quota, loop, &used, &max);
+		assert_int_equal(used, max);
+	}
+
+	/* A smaller limit applies to the units acquired later */
+	isc_quota_max(&quota, 4);
+	for (i = 10; i > 0; i--) {
+		isc_quota_release(&quota);
+		assert_int_equal(isc_quota_getused(&quota), i - 1);
+	}
+	for (i = 0; i < 4; i++) {
+		isc_quota_acquire(&quota);
+	}
+	add_quota(&quota, ISC_R_QUOTA, 4);
+	for (i = 0; i < 4; i++) {
+		isc_quota_release(&quota);
+	}
+
+	isc_quota_destroy(&quota);
+}
+
+ISC_RUN_TEST_IMPL(isc_quota_perloop_soft) {
+	int i;
+	UNUSED(state);
+
+	/* Two of the loops get no share of the soft quota */
+	isc__tid_initcount(4);
+	isc_quota_initperloop(&quota, mctx, 10);
+	isc_quota_soft(&quota, 2);
+
+	add_quota(&quota, ISC_R_SUCCESS, 1);
+	add_quota(&quota, ISC_R_SUCCESS, 2);
+	add_quota(&quota, ISC_R_SOFTQUOTA, 3);
+
+	/* The soft quota applies again once it is below it */
+	isc_quota_release(&quota);
+	isc_quota_release(&quota);
+	add_quota(&quota, ISC_R_SUCCESS, 2);
+
+	isc_quota_soft(&quota, 0);
+	for (i = 2; i < 10; i++) {
+		add_quota(&quota, ISC_R_SUCCESS, i + 1);
+	}
+	add_quota(&quota, ISC_R_QUOTA, 10);
+
+	for (i = 10; i > 0; i--) {
+		isc_quota_release(&quota);
+	}
+
+	isc_quota_destroy(&quota);
+}
+
+/*
+ * Threads acquiring and releasing around the share of the soft quota of
+ * a shard leave 'softfull' matching its usage.
+ */
+static void *
+quota_softflip(void *arg) {
+	UNUSED(arg);
+
+	for (int i = 0; i < 100000; i++) {
+		(void)isc_quota_acquire(&quota);
+		isc_quota_release(&quota);
+	}
+	return NULL;
+}
+
+ISC_RUN_TEST_IMPL(isc_quota_perloop_soft_mt) {
+	isc_thread_t threads[8];
+	int i;
+	UNUSED(state);
+
+	/* The threads without a loop all use the first shard */
+	isc__tid_initcount(4);
+	isc_quota_initperloop(&quota, mctx, 0);
+	isc_quota_soft(&quota, 4);
+
+	for (i = 0; i < 8; i++) {
+		isc_thread_create(quota_softflip, NULL, &threads[i]);
+	}
+	for (i = 0; i < 8; i++) {
+		isc_thread_join(threads[i], NULL);
+	}
+
+	assert_int_equal(isc_quota_getused(&quota), 0);
+	assert_int_equal(atomic_load(&quota.shards[0].softfull), 0);
+	assert_int_equal(atomic_load(&quota.nsoftfull), 0);
+
+	for (i = 0; i < 4; i++) {
+		add_quota(&quota, ISC_R_SUCCESS, i + 1);
+	}
+	assert_int_equal(atomic_load(&quota.shards[0].softfull), 1);
+	add_quota(&quota, ISC_R_SOFTQUOTA, 5);
+
+	for (i = 5; i > 0; i--) {
+		isc_quota_release(&quota);
+	}
+	assert_int_equal(atomic_load(&quota.nsoftfull), 0);
+
+	isc_quota_destroy(&quota);
+}
+
 static atomic_uint_fast32_t cb_calls = 0;
 static isc_job_t cbs[30];
 
@@ -309,6 +438,9 @@ ISC_TEST_LIST_START
 ISC_TEST_ENTRY(isc_quota_get_set)
 ISC_TEST_ENTRY(isc_quota_hard)
 ISC_TEST_ENTRY(isc_quota_soft)
+ISC_TEST_ENTRY(isc_quota_perloop)
+ISC_TEST_ENTRY(isc_quota_perloop_soft)
+ISC_TEST_ENTRY(isc_quota_perloop_soft_mt)
 ISC_TEST_ENTRY(isc_quota_callback)
 ISC_TEST_ENTRY(isc_quota_callback_mt)
 
@@ -125,10 +125,72 @@ ISC_RUN_TEST_IMPL(isc_radix_search) {
 	isc_radix_destroy(radix, NULL);
 }
 
+static void
+radix_insert(isc_radix_tree_t *radix, const char *addr, unsigned int bits,
+	     void *data) {
+	isc_radix_node_t *node = NULL;
+	isc_prefix_t prefix;
+	isc_result_t result;
+	struct in_addr in_addr;
+	isc_netaddr_t netaddr;
+
+	in_addr.s_addr = inet_addr(addr);
+	isc_netaddr_fromin(&netaddr, &in_addr);
+	NETADDR_TO_PREFIX_T(&netaddr, prefix, bits);
+
+	result = isc_radix_insert(radix, &node, NULL, &prefix);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	node->data[0] = data;
+	isc_refcount_destroy(&prefix.refcount);
+}
+
+static void *
+radix_search(isc_radix_tree_t *radix, const char *addr) {
+	isc_radix_node_t *node = NULL;
+	isc_prefix_t prefix;
+	isc_result_t result;
+	struct in_addr in_addr;
+	isc_netaddr_t netaddr;
+
+	in_addr.s_addr = inet_addr(addr);
+	isc_netaddr_fromin(&netaddr, &in_addr);
+	NETADDR_TO_PREFIX_T(&netaddr, prefix, 32);
+
+	result = isc_radix_search(radix, &node, &prefix);
+	isc_refcount_destroy(&prefix.refcount);
+
+	return (result == ISC_R_SUCCESS) ? node->data[0] : NULL;
+}
+
+/* test that searching returns the matching prefix that was added first */
+ISC_RUN_TEST_IMPL(isc_radix_firstmatch) {
+	isc_radix_tree_t *radix = NULL;
+
+	UNUSED(state);
+
+	isc_radix_create(mctx, &radix, 32);
+
+	radix_insert(radix, "10.1.0.0", 16, (void *)1);
+	radix_insert(radix, "10.0.0.0", 8, (void *)2);
+	radix_insert(radix, "10.1.2.0", 24, (void *)3);
+	radix_insert(radix, "10.1.3.4", 32, (void *)4);
+	radix_insert(radix, "10.128.0.0", 9, (void *)5);
+
+	assert_ptr_equal(radix_search(radix, "10.1.2.3"), (void *)1);
+	assert_ptr_equal(radix_search(radix, "10.1.3.4"), (void *)1);
+	assert_ptr_equal(radix_search(radix, "10.2.0.1"), (void *)2);
+	assert_ptr_equal(radix_search(radix, "10.200.0.1"), (void *)2);
+	assert_null(radix_search(radix, "11.1.2.3"));
+	assert_null(radix_search(radix, "1.1.2.3"));
+
+	isc_radix_destroy(radix, NULL);
+}
+
 ISC_TEST_LIST_START
 
 ISC_TEST_ENTRY(isc_radix_remove)
 ISC_TEST_ENTRY(isc_radix_search)
+ISC_TEST_ENTRY(isc_radix_firstmatch)
 
 ISC_TEST_LIST_END
 ISC_TEST_MAIN
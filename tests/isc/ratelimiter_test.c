@@ -276,6 +276,53 @@ ISC_LOOP_TEST_SETUP_TEARDOWN_IMPL(ratelimiter_pushpop) {
 			 ISC_R_SUCCESS);
 }
 
+ISC_LOOP_SETUP_IMPL(ratelimiter_burst) {
+	ticks = 0;
+	isc_time_set(&tock_time, 0, 0);
+	setup_loop_ratelimiter_common(arg);
+}
+
+ISC_LOOP_TEARDOWN_IMPL(ratelimiter_burst) {
+	uint64_t t = isc_time_microdiff(&tick_time, &tock_time);
+	assert_int_equal(ticks, 3);
+	assert_true(t >= 1000000);
+
+	t = isc_time_microdiff(&tock_time, &start_time);
+	assert_true(t < 1000000);
+}
+
+ISC_LOOP_TEST_SETUP_TEARDOWN_IMPL(ratelimiter_burst) {
+	rlstat_t *rlstat = NULL;
+	isc_interval_t interval;
+
+	isc_interval_set(&interval, 1, NS_PER_SEC / 10);
+
+	expect_assert_failure(isc_ratelimiter_setburst(NULL, 2));
+
+	isc_ratelimiter_setinterval(rl, &interval);
+	isc_ratelimiter_setpertic(rl, 1);
+	isc_ratelimiter_setburst(rl, 2);
+
+	/* The first and the third events are dispatched together */
+	rlstat = isc_mem_get(mctx, sizeof(*rlstat));
+	*rlstat = (rlstat_t){ 0 };
+	assert_int_equal(isc_ratelimiter_enqueuegroup(rl, mainloop, 1, tock,
+						      rlstat, &rlstat->event),
+			 ISC_R_SUCCESS);
+
+	rlstat = isc_mem_get(mctx, sizeof(*rlstat));
+	*rlstat = (rlstat_t){ 0 };
+	assert_int_equal(isc_ratelimiter_enqueuegroup(rl, mainloop, 2, tick,
+						      rlstat, &rlstat->event),
+			 ISC_R_SUCCESS);
+
+	rlstat = isc_mem_get(mctx, sizeof(*rlstat));
+	*rlstat = (rlstat_t){ 0 };
+	assert_int_equal(isc_ratelimiter_enqueuegroup(rl, mainloop, 1, tock,
+						      rlstat, &rlstat->event),
+			 ISC_R_SUCCESS);
+}
+
 static int
 setup_test(void **state) {
 	int r;
@@ -310,6 +357,7 @@ ISC_TEST_ENTRY_CUSTOM(ratelimiter_enqueue_shutdown, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(ratelimiter_dequeue, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(ratelimiter_pertick_interval, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(ratelimiter_pushpop, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(ratelimiter_burst, setup_test, teardown_test)
 
 ISC_TEST_LIST_END
 
@@ -24,6 +24,7 @@
 
 #include <isc/atomic.h>
 #include <isc/barrier.h>
+#include <isc/brlock.h>
 #include <isc/file.h>
 #include <isc/mem.h>
 #include <isc/os.h>
@@ -42,6 +43,7 @@ static unsigned int loops = 100;
 static unsigned int delay_loop = 1;
 
 static isc_rwlock_t rwlock;
+static isc_brlock_t brlock;
 static pthread_rwlock_t prwlock;
 static isc_barrier_t barrier1;
 static isc_barrier_t barrier2;
@@ -237,6 +239,55 @@ isc_rwlock_thread(void *arg __attribute__((__unused__))) {
 	return NULL;
 }
 
+static void *
+isc_brlock_thread(void *arg __attribute__((__unused__))) {
+	for (size_t i = 0; i < loops; i++) {
+		if (rnd[i] < boundary) {
+			isc_brlock_wrlock(&brlock);
+			size_t v = shared_counter;
+			isc_pause_n(delay_loop);
+			shared_counter = v + 1;
+			isc_brlock_wrunlock(&brlock);
+		} else {
+			isc_brlock_rdlock(&brlock);
+			isc_pause_n(delay_loop);
+			isc_brlock_rdunlock(&brlock);
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Check that the writers exclude each other
+ */
+ISC_RUN_TEST_IMPL(isc_brlock_threads) {
+	isc_thread_t *threads = isc_mem_cget(mctx, workers, sizeof(*threads));
+	size_t writes = 0;
+
+	boundary = 10;
+	for (size_t i = 0; i < loops; i++) {
+		if (rnd[i] < boundary) {
+			writes++;
+		}
+	}
+
+	isc_brlock_init(&brlock, mctx);
+
+	shared_counter = 0;
+	for (size_t i = 0; i < workers; i++) {
+		isc_thread_create(isc_brlock_thread, NULL, &threads[i]);
+	}
+	for (size_t i = 0; i < workers; i++) {
+		isc_thread_join(threads[i], NULL);
+	}
+	assert_int_equal(shared_counter, writes * workers);
+
+	isc_brlock_destroy(&brlock);
+
+	isc_mem_cput(mctx, threads, workers, sizeof(*threads));
+}
+
 static void
 isc__rwlock_benchmark(isc_thread_t *threads, unsigned int nthreads,
 		      uint8_t pct) {
@@ -342,6 +393,7 @@ ISC_TEST_ENTRY_CUSTOM(isc_rwlock_tryupgrade, rwlock_setup, rwlock_teardown)
 ISC_TEST_ENTRY_CUSTOM(isc_rwlock_trylock, rwlock_setup, rwlock_teardown)
 ISC_TEST_ENTRY_CUSTOM(isc_rwlock_benchmark, rwlock_setup, rwlock_teardown)
 #endif /* __SANITIZE_THREAD__ */
+ISC_TEST_ENTRY(isc_brlock_threads)
 
 ISC_TEST_LIST_END
 
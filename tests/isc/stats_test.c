@@ -15,6 +15,7 @@
 #include <sched.h> /* IWYU pragma: keep */
 #include <setjmp.h>
 #include <stdarg.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
@@ -25,15 +26,13 @@
 #include <isc/mem.h>
 #include <isc/result.h>
 #include <isc/stats.h>
+#include <isc/tid.h>
 #include <isc/util.h>
 
 #include <tests/isc.h>
 
-/* test stats */
-ISC_RUN_TEST_IMPL(isc_stats_basic) {
-	isc_stats_t *stats = NULL;
-
-	isc_stats_create(mctx, &stats, 4);
+static void
+check_stats(isc_stats_t *stats) {
 	assert_int_equal(isc_stats_ncounters(stats), 4);
 
 	/* Default all 0. */
@@ -57,6 +56,14 @@ ISC_RUN_TEST_IMPL(isc_stats_basic) {
 		assert_int_equal(isc_stats_get_counter(stats, i), 0);
 	}
 
+	/* Test add. */
+	for (int i = 0; i < isc_stats_ncounters(stats); i++) {
+		isc_stats_add(stats, i, 5);
+		assert_int_equal(isc_stats_get_counter(stats, i), 5);
+		isc_stats_add(stats, i, 1000);
+		assert_int_equal(isc_stats_get_counter(stats, i), 1005);
+	}
+
 	/* Test set. */
 	for (int i = 0; i < isc_stats_ncounters(stats); i++) {
 		isc_stats_set(stats, i, i);
@@ -87,6 +94,44 @@ ISC_RUN_TEST_IMPL(isc_stats_basic) {
 		}
 		assert_int_equal(isc_stats_get_counter(stats, i), expect);
 	}
+}
+
+/* test stats */
+ISC_RUN_TEST_IMPL(isc_stats_basic) {
+	isc_stats_t *stats = NULL;
+
+	isc_stats_create(mctx, &stats, 4);
+	check_stats(stats);
+	isc_stats_detach(&stats);
+}
+
+/* per-loop stats behave the same */
+ISC_RUN_TEST_IMPL(isc_stats_perloop) {
+	isc_stats_t *stats = NULL;
+
+	isc__tid_initcount(2);
+
+	isc_stats_createperloop(mctx, &stats, 4);
+	check_stats(stats);
+
+	/* a gauge may be decremented on another thread */
+	isc_stats_set(stats, 0, 0);
+	isc_stats_increment(stats, 0);
+	isc__tid_local = 1;
+	isc_stats_decrement(stats, 0);
+	assert_int_equal(isc_stats_get_counter(stats, 0), 0);
+	isc_stats_increment(stats, 1);
+	isc_stats_add(stats, 1, 10);
+	isc__tid_local = ISC_TID_UNKNOWN;
+	assert_int_equal(isc_stats_get_counter(stats, 1), 13);
+
+	/* setting a counter keeps the values counted by the loops */
+	isc_stats_set(stats, 5, 1);
+	assert_int_equal(isc_stats_get_counter(stats, 1), 5);
+	isc__tid_local = 1;
+	isc_stats_increment(stats, 1);
+	isc__tid_local = ISC_TID_UNKNOWN;
+	assert_int_equal(isc_stats_get_counter(stats, 1), 6);
 
 	isc_stats_detach(&stats);
 }
@@ -94,6 +139,7 @@ ISC_RUN_TEST_IMPL(isc_stats_basic) {
 ISC_TEST_LIST_START
 
 ISC_TEST_ENTRY(isc_stats_basic)
+ISC_TEST_ENTRY(isc_stats_perloop)
 
 ISC_TEST_LIST_END
 
@@ -520,6 +520,66 @@ ISC_LOOP_TEST_CUSTOM_IMPL(reschedule_ticker, setup_loop_reschedule_ticker,
 	isc_interval_set(&timer_interval, 0, NS_PER_SEC / 4);
 }
 
+ISC_LOOP_SETUP_IMPL(coarse_reschedule) {
+	timer_start = isc_loop_now(isc_loop());
+	timer_expect = 1;
+	timer_ticks = 2;
+	timer_type = isc_timertype_once;
+}
+
+ISC_LOOP_TEST_CUSTOM_IMPL(coarse_reschedule, setup_loop_coarse_reschedule,
+			  teardown_loop_timer_expect) {
+	isc_timer_create_coarse(mainloop, timer_event, NULL, &timer);
+
+	/* Schedule the timer past a full turn of the wheel */
+	isc_interval_set(&timer_interval, 10, 0);
+	isc_timer_start(timer, timer_type, &timer_interval);
+
+	/* And then reschedule it to fire twice, 1/2 second apart */
+	isc_interval_set(&timer_interval, 0, NS_PER_SEC / 2);
+	isc_timer_start(timer, timer_type, &timer_interval);
+}
+
+#define NCOARSE 1000
+
+static isc_timer_t *coarsetimers[NCOARSE];
+static size_t coarsefired;
+
+static void
+coarse_event(void *arg) {
+	isc_timer_t **timerp = arg;
+
+	/* Only the timers that were not stopped can fire */
+	assert_true((timerp - coarsetimers) % 2 == 0);
+
+	isc_timer_destroy(timerp);
+
+	if (++coarsefired == NCOARSE / 2) {
+		for (size_t i = 1; i < NCOARSE; i += 2) {
+			isc_timer_destroy(&coarsetimers[i]);
+		}
+		isc_loopmgr_shutdown(loopmgr);
+	}
+}
+
+ISC_LOOP_TEST_IMPL(coarse_many) {
+	isc_interval_t interval;
+
+	coarsefired = 0;
+
+	for (size_t i = 0; i < NCOARSE; i++) {
+		isc_timer_create_coarse(mainloop, coarse_event,
+					&coarsetimers[i], &coarsetimers[i]);
+		isc_interval_set(&interval, 0, (i % 300) * NS_PER_MS * 5);
+		isc_timer_start(coarsetimers[i], isc_timertype_once, &interval);
+	}
+
+	/* Stop every other timer */
+	for (size_t i = 1; i < NCOARSE; i += 2) {
+		isc_timer_stop(coarsetimers[i]);
+	}
+}
+
 ISC_TEST_LIST_START
 
 ISC_TEST_ENTRY_CUSTOM(ticker, setup_loopmgr, teardown_loopmgr)
@@ -531,6 +591,8 @@ ISC_TEST_ENTRY_CUSTOM(reschedule_down, setup_loopmgr, teardown_loopmgr)
 ISC_TEST_ENTRY_CUSTOM(reschedule_from_callback, setup_loopmgr, teardown_loopmgr)
 ISC_TEST_ENTRY_CUSTOM(zero, setup_loopmgr, teardown_loopmgr)
 ISC_TEST_ENTRY_CUSTOM(reschedule_ticker, setup_loopmgr, teardown_loopmgr)
+ISC_TEST_ENTRY_CUSTOM(coarse_reschedule, setup_loopmgr, teardown_loopmgr)
+ISC_TEST_ENTRY_CUSTOM(coarse_many, setup_loopmgr, teardown_loopmgr)
 
 ISC_TEST_LIST_END
 
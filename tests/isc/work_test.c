@@ -75,8 +75,71 @@ ISC_RUN_TEST_IMPL(isc_work_enqueue) {
 	assert_int_equal(atomic_load(&scheduled), 1);
 }
 
+static atomic_bool latency_done = false;
+static atomic_uint bulk_done = 0;
+
+static void
+bulk_work_cb(void *arg) {
+	UNUSED(arg);
+
+	/* Hold the worker until the latency-sensitive work has run */
+	while (!atomic_load(&latency_done)) {
+		usleep(1000);
+	}
+}
+
+static void
+bulk_after_work_cb(void *arg) {
+	UNUSED(arg);
+
+	if (atomic_fetch_add(&bulk_done, 1) + 1 == isc_loopmgr_nloops(loopmgr))
+	{
+		isc_loopmgr_shutdown(loopmgr);
+	}
+}
+
+static void
+latency_work_cb(void *arg) {
+	UNUSED(arg);
+
+	atomic_store(&latency_done, true);
+}
+
+static void
+latency_after_work_cb(void *arg) {
+	UNUSED(arg);
+}
+
+static void
+work_enqueue_bulk_cb(void *arg) {
+	UNUSED(arg);
+	uint32_t nloops = isc_loopmgr_nloops(loopmgr);
+
+	/* There are as many worker threads as loops */
+	for (uint32_t tid = 0; tid < nloops; tid++) {
+		isc_work_enqueue_bulk(isc_loop_get(loopmgr, tid), bulk_work_cb,
+				      bulk_after_work_cb, loopmgr);
+	}
+
+	isc_work_enqueue(isc_loop_main(loopmgr), latency_work_cb,
+			 latency_after_work_cb, loopmgr);
+}
+
+ISC_RUN_TEST_IMPL(isc_work_enqueue_bulk) {
+	atomic_init(&latency_done, false);
+	atomic_init(&bulk_done, 0);
+
+	isc_loop_setup(isc_loop_main(loopmgr), work_enqueue_bulk_cb, loopmgr);
+
+	isc_loopmgr_run(loopmgr);
+
+	assert_true(atomic_load(&latency_done));
+	assert_int_equal(atomic_load(&bulk_done), isc_loopmgr_nloops(loopmgr));
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY_CUSTOM(isc_work_enqueue, setup_loopmgr, teardown_loopmgr)
+ISC_TEST_ENTRY_CUSTOM(isc_work_enqueue_bulk, setup_loopmgr, teardown_loopmgr)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
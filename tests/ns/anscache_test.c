@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/util.h>
+
+#include <dns/db.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rdatatype.h>
+#include <dns/view.h>
+
+#include <ns/anscache.h>
+#include <ns/stats.h>
+
+#include <tests/ns.h>
+
+static unsigned char response[] = { 0x00, 0x00, 0x84, 0x00, 0x00, 0x01,
+				    0x00, 0x01, 0x00, 0x00, 0x00, 0x01 };
+
+static void
+makekey(ns_anscachekey_t *key, dns_view_t *view, dns_db_t *db,
+	const char *qname, dns_rdatatype_t qtype) {
+	dns_fixedname_t fname;
+
+	dns_test_namefromstring(qname, &fname);
+	ns_anscache_initkey(key, view, db, dns_fixedname_name(&fname));
+	key->qtype = qtype;
+	key->qclass = dns_rdataclass_in;
+	key->udpsize = 1232;
+	key->family = AF_INET;
+}
+
+/* store, find and invalidate responses */
+ISC_RUN_TEST_IMPL(ns_anscache_find) {
+	isc_result_t result;
+	ns_anscache_t *cache = NULL;
+	ns_anscachekey_t key, other;
+	ns_anscacheentry_t *entry = NULL;
+	isc_region_t wire = { .base = response, .length = sizeof(response) };
+	dns_view_t *view = NULL;
+	dns_db_t *db = NULL;
+	dns_dbversion_t *version = NULL;
+
+	result = dns_test_makeview("view", false, false, &view);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_test_loaddb(&db, dns_dbtype_zone, "foo",
+				 TESTS_DIR "/testdata/query/foo.db");
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	ns_anscache_create(mctx, &cache);
+
+	makekey(&key, view, db, "foo.", dns_rdatatype_a);
+	assert_null(ns_anscache_find(cache, &key));
+
+	ns_anscache_add(cache, &key, dns_db_generation(), &wire, NULL,
+			ISC_R_UNSET, ns_statscounter_success);
+	entry = ns_anscache_find(cache, &key);
+	assert_non_null(entry);
+	assert_int_equal(entry->wire.length, sizeof(response));
+	assert_memory_equal(entry->wire.base, response, sizeof(response));
+	assert_int_equal(entry->counter, ns_statscounter_success);
+
+	/* The query name is compared case-sensitively */
+	makekey(&other, view, db, "FOO.", dns_rdatatype_a);
+	assert_null(ns_anscache_find(cache, &other));
+
+	makekey(&other, view, db, "foo.", dns_rdatatype_aaaa);
+	assert_null(ns_anscache_find(cache, &other));
+
+	other = key;
+	other.udpsize = 512;
+	assert_null(ns_anscache_find(cache, &other));
+
+	/* A response from an older generation is not stored */
+	makekey(&other, view, db, "bar.foo.", dns_rdatatype_a);
+	ns_anscache_add(cache, &other, dns_db_generation() - 1, &wire, NULL,
+			ISC_R_UNSET, ns_statscounter_success);
+	assert_null(ns_anscache_find(cache, &other));
+
+	/* Committing a new version makes the stored responses stale */
+	result = dns_db_newversion(db, &version);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_db_closeversion(db, &version, true);
+	assert_null(ns_anscache_find(cache, &key));
+
+	ns_anscache_destroy(&cache);
+	assert_null(cache);
+
+	dns_db_detach(&db);
+	dns_view_detach(&view);
+}
+
+/* evict the least recently used response */
+ISC_RUN_TEST_IMPL(ns_anscache_evict) {
+	isc_result_t result;
+	ns_anscache_t *cache = NULL;
+	ns_anscachekey_t key;
+	isc_region_t wire = { .base = response, .length = sizeof(response) };
+	dns_view_t *view = NULL;
+	dns_db_t *db = NULL;
+
+	result = dns_test_makeview("view", false, false, &view);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_test_loaddb(&db, dns_dbtype_zone, "foo",
+				 TESTS_DIR "/testdata/query/foo.db");
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	ns_anscache_create(mctx, &cache);
+
+	for (unsigned int i = 0; i < NS_ANSCACHE_MAXENTRIES; i++) {
+		makekey(&key, view, db, "foo.", i + 1);
+		ns_anscache_add(cache, &key, dns_db_generation(), &wire, NULL,
+				ISC_R_UNSET, ns_statscounter_success);
+	}
+
+	/* Use the first entry, so that the second one is evicted */
+	makekey(&key, view, db, "foo.", 1);
+	assert_non_null(ns_anscache_find(cache, &key));
+
+	makekey(&key, view, db, "foo.", NS_ANSCACHE_MAXENTRIES + 1);
+	ns_anscache_add(cache, &key, dns_db_generation(), &wire, NULL,
+			ISC_R_UNSET, ns_statscounter_success);
+	assert_non_null(ns_anscache_find(cache, &key));
+
+	makekey(&key, view, db, "foo.", 1);
+	assert_non_null(ns_anscache_find(cache, &key));
+
+	makekey(&key, view, db, "foo.", 2);
+	assert_null(ns_anscache_find(cache, &key));
+
+	makekey(&key, view, db, "foo.", 3);
+	assert_non_null(ns_anscache_find(cache, &key));
+
+	ns_anscache_destroy(&cache);
+
+	dns_db_detach(&db);
+	dns_view_detach(&view);
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY(ns_anscache_find)
+ISC_TEST_ENTRY(ns_anscache_evict)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/loop.h>
+#include <isc/netaddr.h>
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/name.h>
+
+#include <ns/hitters.h>
+
+#include <tests/ns.h>
+
+#define NHEAVY 100
+#define NLIGHT 1000
+
+static void
+addquery(ns_hitters_t *h, const char *name, dns_rdatatype_t type,
+	 uint32_t addr) {
+	dns_fixedname_t fixed;
+	dns_name_t *qname = dns_fixedname_initname(&fixed);
+	struct in_addr ina = { .s_addr = htonl(addr) };
+	isc_netaddr_t netaddr;
+	isc_result_t result;
+
+	result = dns_name_fromstring(qname, name, dns_rootname, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	isc_netaddr_fromin(&netaddr, &ina);
+
+	ns_hitters_addquery(h, qname, type, &netaddr);
+}
+
+/* the most frequent keys are found among many infrequent ones */
+ISC_LOOP_TEST_IMPL(ns_hitters_top) {
+	ns_hitters_t *h = NULL;
+	ns_hitter_t top[2];
+	struct in6_addr in6 = { .s6_addr = { 0x20, 0x01, 0x0d, 0xb8, 0, 0, 0x55,
+					     0x01, 0, 0, 0, 0, 0, 0, 0, 1 } };
+	isc_netaddr_t netaddr;
+	char buf[DNS_NAME_FORMATSIZE];
+	char name[64];
+	size_t count;
+
+	ns_hitters_create(mctx, &h);
+
+	for (size_t i = 0; i < NLIGHT; i++) {
+		snprintf(name, sizeof(name), "n%zu.example.net", i);
+		addquery(h, name, dns_rdatatype_aaaa, 0xc6336400 + i % 256);
+		if (i % (NLIGHT / NHEAVY) == 0) {
+			/* Names are counted regardless of case */
+			addquery(h, i % 2 == 0 ? "example.com" : "EXAMPLE.com",
+				 dns_rdatatype_a, 0xc0000201);
+		}
+	}
+
+	count = ns_hitters_top(h, ns_hitters_qname, top, ARRAY_SIZE(top));
+	assert_int_equal(count, 2);
+	ns_hitter_format(ns_hitters_qname, &top[0], buf, sizeof(buf));
+	assert_string_equal(buf, "example.com");
+	assert_true(top[0].count >= NHEAVY);
+	assert_true(top[0].count - top[0].error <= NHEAVY);
+
+	count = ns_hitters_top(h, ns_hitters_qtype, top, ARRAY_SIZE(top));
+	assert_int_equal(count, 2);
+	ns_hitter_format(ns_hitters_qtype, &top[0], buf, sizeof(buf));
+	assert_string_equal(buf, "AAAA");
+	assert_int_equal(top[0].count, NLIGHT);
+	assert_int_equal(top[0].error, 0);
+	ns_hitter_format(ns_hitters_qtype, &top[1], buf, sizeof(buf));
+	assert_string_equal(buf, "A");
+	assert_int_equal(top[1].count, NHEAVY);
+
+	/* The clients are counted by prefix */
+	count = ns_hitters_top(h, ns_hitters_client, top, ARRAY_SIZE(top));
+	assert_int_equal(count, 2);
+	ns_hitter_format(ns_hitters_client, &top[0], buf, sizeof(buf));
+	assert_string_equal(buf, "198.51.100.0/24");
+	assert_int_equal(top[0].count, NLIGHT);
+	ns_hitter_format(ns_hitters_client, &top[1], buf, sizeof(buf));
+	assert_string_equal(buf, "192.0.2.0/24");
+	assert_int_equal(top[1].count, NHEAVY);
+
+	isc_netaddr_fromin6(&netaddr, &in6);
+	for (size_t i = 0; i < NHEAVY; i++) {
+		ns_hitters_addnxdomain(h, &netaddr);
+	}
+	count = ns_hitters_top(h, ns_hitters_nxdomain, top, ARRAY_SIZE(top));
+	assert_int_equal(count, 1);
+	ns_hitter_format(ns_hitters_nxdomain, &top[0], buf, sizeof(buf));
+	assert_string_equal(buf, "2001:db8:0:5500::/56");
+	assert_int_equal(top[0].count, NHEAVY);
+
+	ns_hitters_reset(h);
+	for (ns_hitterstype_t type = 0; type < ns_hitters_max; type++) {
+		count = ns_hitters_top(h, type, top, ARRAY_SIZE(top));
+		assert_int_equal(count, 0);
+	}
+
+	ns_hitters_destroy(&h);
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY_CUSTOM(ns_hitters_top, setup_loopmgr, teardown_loopmgr)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/file.h>
+#include <isc/log.h>
+#include <isc/loop.h>
+#include <isc/netaddr.h>
+#include <isc/stdio.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/name.h>
+
+#include <ns/querylog.h>
+
+#include <tests/ns.h>
+
+#define NMESSAGES 10
+
+#define QUERYLOG_FILE "querylog.bin"
+
+/* queued messages are logged by the writer thread, or dropped */
+ISC_LOOP_TEST_IMPL(ns_querylog_write) {
+	ns_querylog_t *ql = NULL;
+	uint64_t logged, dropped;
+	size_t nlong = 2 * NS_QUERYLOG_RINGSIZE / 1000;
+	size_t queued = 0;
+	char msg[1000];
+
+	ns_querylog_create(mctx, &ql);
+
+	for (size_t i = 0; i < NMESSAGES; i++) {
+		assert_true(ns_querylog_write(ql, NS_LOGCATEGORY_QUERIES,
+					      NS_LOGMODULE_QUERY,
+					      ISC_LOG_DEBUG(99), "query"));
+	}
+
+	ns_querylog_flush(ql);
+	ns_querylog_getcounters(ql, &logged, &dropped);
+	assert_int_equal(logged, NMESSAGES);
+	assert_int_equal(dropped, 0);
+
+	/* More than a ring can hold; some may be dropped */
+	memset(msg, 'x', sizeof(msg) - 1);
+	msg[sizeof(msg) - 1] = '\0';
+	for (size_t i = 0; i < nlong; i++) {
+		if (ns_querylog_write(ql, NS_LOGCATEGORY_QUERIES,
+				      NS_LOGMODULE_QUERY, ISC_LOG_DEBUG(99),
+				      msg))
+		{
+			queued++;
+		}
+	}
+
+	ns_querylog_flush(ql);
+	ns_querylog_getcounters(ql, &logged, &dropped);
+	assert_int_equal(logged, NMESSAGES + queued);
+	assert_int_equal(dropped, nlong - queued);
+
+	ns_querylog_destroy(&ql);
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/* queries are written to the binary query log */
+ISC_LOOP_TEST_IMPL(ns_querylog_writeentry) {
+	ns_querylog_t *ql = NULL;
+	ns_querylogentry_t entry;
+	struct in_addr ina = { .s_addr = htonl(0xc0000201) };
+	dns_fixedname_t fixed;
+	dns_name_t *qname = dns_fixedname_initname(&fixed);
+	unsigned char data[128];
+	size_t length;
+	isc_result_t result;
+	FILE *fp = NULL;
+
+	result = dns_name_fromstring(qname, "example.com", dns_rootname, 0,
+				     NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	entry = (ns_querylogentry_t){
+		.latency = 1234,
+		.flags = NS_QUERYLOG_FLAG_RECURSION | NS_QUERYLOG_FLAG_TCP,
+		.qtype = dns_rdatatype_a,
+		.qclass = dns_rdataclass_in,
+		.rcode = dns_rcode_nxdomain,
+		.port = 53000,
+		.qname = qname,
+	};
+	isc_time_set(&entry.time, 1700000000, 500);
+	isc_netaddr_fromin(&entry.address, &ina);
+
+	(void)isc_file_remove(QUERYLOG_FILE);
+
+	ns_querylog_create(mctx, &ql);
+
+	/* Nothing is written until there is a file */
+	assert_false(ns_querylog_binary(ql));
+	assert_true(ns_querylog_writeentry(ql, &entry));
+
+	result = ns_querylog_setfile(ql, QUERYLOG_FILE);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_true(ns_querylog_binary(ql));
+	assert_true(ns_querylog_writeentry(ql, &entry));
+	ns_querylog_flush(ql);
+
+	result = ns_querylog_setfile(ql, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_false(ns_querylog_binary(ql));
+
+	ns_querylog_destroy(&ql);
+
+	result = isc_stdio_open(QUERYLOG_FILE, "rb", &fp);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	length = fread(data, 1, sizeof(data), fp);
+	(void)isc_stdio_close(fp);
+	(void)isc_file_remove(QUERYLOG_FILE);
+
+	/* Header, record length, fixed fields, address, name */
+	assert_int_equal(length, 6 + 2 + NS_QUERYLOG_RECORDSIZE + 4 + 13);
+	assert_memory_equal(data, NS_QUERYLOG_MAGIC, 4);
+	assert_int_equal(data[4] << 8 | data[5], NS_QUERYLOG_VERSION);
+	assert_int_equal(data[6] << 8 | data[7],
+			 NS_QUERYLOG_RECORDSIZE + 4 + 13);
+	assert_memory_equal(data + 8,
+			    "\x65\x53\xf1\x00" /* seconds */
+			    "\x00\x00\x01\xf4" /* nanoseconds */
+			    "\x00\x00\x04\xd2" /* latency */
+			    "\x00\x09"	       /* flags */
+			    "\x00\x01"	       /* type */
+			    "\x00\x01"	       /* class */
+			    "\x00\x03"	       /* rcode */
+			    "\xcf\x08"	       /* port */
+			    "\x04\xc0\x00\x02\x01" /* address */
+			    "\x07"
+			    "example"
+			    "\x03"
+			    "com"
+			    "\x00",
+			    NS_QUERYLOG_RECORDSIZE + 4 + 13);
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY_CUSTOM(ns_querylog_write, setup_loopmgr, teardown_loopmgr)
+ISC_TEST_ENTRY_CUSTOM(ns_querylog_writeentry, setup_loopmgr,
+		      teardown_loopmgr)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
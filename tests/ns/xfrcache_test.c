@@ -0,0 +1,298 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/buffer.h>
+#include <isc/util.h>
+
+#include <dns/db.h>
+#include <dns/fixedname.h>
+#include <dns/message.h>
+#include <dns/name.h>
+
+#include <ns/xfrcache.h>
+
+#include <tests/ns.h>
+
+/*
+ * A builder producing 'nmsgs' messages, each with a 4-byte answer
+ * section holding the message number, the first one with a 5-byte
+ * question section.
+ */
+typedef struct {
+	unsigned int nmsgs;
+	unsigned int rendered;
+	isc_result_t result;
+	bool freed;
+} builder_t;
+
+static isc_result_t
+render(void *arg, isc_buffer_t *target, unsigned int *questionlenp,
+       unsigned int *ancountp, bool *lastp) {
+	builder_t *b = arg;
+
+	if (b->result != ISC_R_SUCCESS) {
+		return b->result;
+	}
+
+	isc_buffer_putmem(target, (const unsigned char *)"headerheader",
+			  DNS_MESSAGE_HEADERLEN);
+	if (b->rendered == 0) {
+		isc_buffer_putmem(target, (const unsigned char *)"quest", 5);
+		*questionlenp = 5;
+	}
+	isc_buffer_putuint32(target, b->rendered);
+	*ancountp = 1;
+
+	b->rendered++;
+	*lastp = (b->rendered == b->nmsgs);
+
+	return ISC_R_SUCCESS;
+}
+
+static void
+freebuilder(void *arg) {
+	builder_t *b = arg;
+
+	assert_false(b->freed);
+	b->freed = true;
+}
+
+static void
+makekey(ns_xfrcachekey_t *key, dns_zone_t *zone, dns_db_t *db,
+	uint32_t serial, const char *qname) {
+	dns_fixedname_t fname;
+
+	dns_test_namefromstring(qname, &fname);
+	ns_xfrcache_initkey(key, zone, db, serial, dns_fixedname_name(&fname));
+	key->msgsize = 20480;
+	key->qclass = dns_rdataclass_in;
+}
+
+/* render the messages once and share them */
+ISC_RUN_TEST_IMPL(ns_xfrcache_share) {
+	isc_result_t result;
+	ns_xfrcache_t *cache = NULL;
+	ns_xfrcachekey_t key, other;
+	ns_xfrcacheentry_t *entry1 = NULL, *entry2 = NULL;
+	const ns_xfrmsg_t *msg1 = NULL, *msg2 = NULL;
+	builder_t b = { .nmsgs = 3 }, b2 = { .nmsgs = 3 };
+	dns_db_t *db = NULL;
+	int zone;
+
+	result = dns_test_loaddb(&db, dns_dbtype_zone, "foo",
+				 TESTS_DIR "/testdata/query/foo.db");
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	ns_xfrcache_create(mctx, &cache);
+
+	/* Nothing is cached until the size is set */
+	makekey(&key, (dns_zone_t *)&zone, db, 1, "foo.");
+	result = ns_xfrcache_find(cache, &key, 0, &entry1);
+	assert_int_equal(result, ISC_R_NOSPACE);
+
+	ns_xfrcache_setmaxsize(cache, 1024 * 1024);
+	result = ns_xfrcache_find(cache, &key, 0, &entry1);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+	ns_xfrcache_add(cache, &key, render, freebuilder, &b, &entry1);
+	assert_non_null(entry1);
+
+	result = ns_xfrcache_next(entry1, NULL, &msg1);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(msg1->question.length, 5);
+	assert_memory_equal(msg1->question.base, "quest", 5);
+	assert_int_equal(msg1->answer.length, 4);
+	assert_int_equal(msg1->ancount, 1);
+	assert_false(msg1->last);
+	assert_int_equal(b.rendered, 1);
+
+	/* A second transfer reuses the first message... */
+	result = ns_xfrcache_find(cache, &key, 0, &entry2);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_ptr_equal(entry1, entry2);
+
+	/* ...and adding it again returns the same entry */
+	ns_xfrcacheentry_detach(&entry2);
+	ns_xfrcache_add(cache, &key, render, freebuilder, &b2, &entry2);
+	assert_ptr_equal(entry1, entry2);
+	assert_true(b2.freed);
+
+	result = ns_xfrcache_next(entry2, NULL, &msg2);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_ptr_equal(msg1, msg2);
+
+	/* ...and renders the next one for both */
+	result = ns_xfrcache_next(entry2, msg2, &msg2);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(msg2->question.length, 0);
+	assert_int_equal(b.rendered, 2);
+
+	result = ns_xfrcache_next(entry1, msg1, &msg1);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_ptr_equal(msg1, msg2);
+	assert_int_equal(b.rendered, 2);
+
+	/* The builder is freed after the last message */
+	result = ns_xfrcache_next(entry1, msg1, &msg1);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_true(msg1->last);
+	assert_true(b.freed);
+
+	ns_xfrcacheentry_detach(&entry1);
+	ns_xfrcacheentry_detach(&entry2);
+
+	/* The name is compared case-sensitively */
+	makekey(&other, (dns_zone_t *)&zone, db, 1, "FOO.");
+	result = ns_xfrcache_find(cache, &other, 0, &entry1);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	result = ns_xfrcache_find(cache, &key, 0, &entry1);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	ns_xfrcacheentry_detach(&entry1);
+
+	/* A newer version of the zone replaces the old one */
+	makekey(&other, (dns_zone_t *)&zone, db, 2, "foo.");
+	result = ns_xfrcache_find(cache, &other, 0, &entry1);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	result = ns_xfrcache_find(cache, &key, 0, &entry1);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	ns_xfrcache_destroy(&cache);
+	assert_null(cache);
+
+	dns_db_detach(&db);
+}
+
+/* evict the unused entries when the cache is full */
+ISC_RUN_TEST_IMPL(ns_xfrcache_evict) {
+	isc_result_t result;
+	ns_xfrcache_t *cache = NULL;
+	ns_xfrcachekey_t key1, key2, key3;
+	ns_xfrcacheentry_t *entry = NULL, *entry3 = NULL;
+	const ns_xfrmsg_t *msg = NULL;
+	builder_t b1 = { .nmsgs = 1 }, b2 = { .nmsgs = 1 },
+		  b3 = { .nmsgs = 1 };
+	dns_db_t *db = NULL;
+	int zones[3];
+
+	result = dns_test_loaddb(&db, dns_dbtype_zone, "foo",
+				 TESTS_DIR "/testdata/query/foo.db");
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	ns_xfrcache_create(mctx, &cache);
+	ns_xfrcache_setmaxsize(cache, 1024);
+
+	/* Too large to be cached at all */
+	makekey(&key1, (dns_zone_t *)&zones[0], db, 1, "foo.");
+	result = ns_xfrcache_find(cache, &key1, 2048, &entry);
+	assert_int_equal(result, ISC_R_NOSPACE);
+
+	result = ns_xfrcache_find(cache, &key1, 512, &entry);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+	ns_xfrcache_add(cache, &key1, render, freebuilder, &b1, &entry);
+	result = ns_xfrcache_next(entry, NULL, &msg);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	ns_xfrcacheentry_detach(&entry);
+
+	makekey(&key2, (dns_zone_t *)&zones[1], db, 1, "foo.");
+	result = ns_xfrcache_find(cache, &key2, 512, &entry);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+	ns_xfrcache_add(cache, &key2, render, freebuilder, &b2, &entry);
+	result = ns_xfrcache_next(entry, NULL, &msg);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	/*
+	 * The first entry is evicted to make room for the third one;
+	 * the second one is in use, so it stays.
+	 */
+	makekey(&key3, (dns_zone_t *)&zones[2], db, 1, "foo.");
+	result = ns_xfrcache_find(cache, &key3, 1000, &entry3);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+	ns_xfrcache_add(cache, &key3, render, freebuilder, &b3, &entry3);
+	ns_xfrcacheentry_detach(&entry3);
+
+	result = ns_xfrcache_find(cache, &key1, 0, &entry3);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	ns_xfrcacheentry_detach(&entry);
+	result = ns_xfrcache_find(cache, &key2, 0, &entry);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	ns_xfrcacheentry_detach(&entry);
+
+	ns_xfrcache_destroy(&cache);
+
+	dns_db_detach(&db);
+}
+
+/* a rendering failure is returned to all the transfers */
+ISC_RUN_TEST_IMPL(ns_xfrcache_fail) {
+	isc_result_t result;
+	ns_xfrcache_t *cache = NULL;
+	ns_xfrcachekey_t key;
+	ns_xfrcacheentry_t *entry1 = NULL, *entry2 = NULL;
+	const ns_xfrmsg_t *msg = NULL;
+	builder_t b = { .nmsgs = 2, .result = ISC_R_NOSPACE };
+	dns_db_t *db = NULL;
+	int zone;
+
+	result = dns_test_loaddb(&db, dns_dbtype_zone, "foo",
+				 TESTS_DIR "/testdata/query/foo.db");
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	ns_xfrcache_create(mctx, &cache);
+	ns_xfrcache_setmaxsize(cache, 1024 * 1024);
+
+	makekey(&key, (dns_zone_t *)&zone, db, 1, "foo.");
+	result = ns_xfrcache_find(cache, &key, 0, &entry1);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+	ns_xfrcache_add(cache, &key, render, freebuilder, &b, &entry1);
+	result = ns_xfrcache_find(cache, &key, 0, &entry2);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = ns_xfrcache_next(entry1, NULL, &msg);
+	assert_int_equal(result, ISC_R_NOSPACE);
+	assert_true(b.freed);
+
+	result = ns_xfrcache_next(entry2, NULL, &msg);
+	assert_int_equal(result, ISC_R_NOSPACE);
+
+	/* The next transfer starts afresh */
+	ns_xfrcacheentry_detach(&entry2);
+	result = ns_xfrcache_find(cache, &key, 0, &entry2);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	ns_xfrcacheentry_detach(&entry1);
+	ns_xfrcache_destroy(&cache);
+
+	dns_db_detach(&db);
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY(ns_xfrcache_share)
+ISC_TEST_ENTRY(ns_xfrcache_evict)
+ISC_TEST_ENTRY(ns_xfrcache_fail)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN